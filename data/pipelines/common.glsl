@@ -446,6 +446,14 @@ vec3 transformByDualQuat(mat2x4 dq, vec3 pos) {
 		+ 2 * (dq[0].w * dq[1].xyz - dq[1].w * dq[0].xyz + cross(dq[0].xyz, dq[1].xyz));
 }
 
+// inverse of octahedral encoding done by the model importer
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+	return normalize(n);
+}
+
 vec3 rotateByQuat(vec4 rot, vec3 pos)
 {
 	vec3 uv = cross(rot.xyz, pos);
@@ -59,6 +59,14 @@ function linkPlugin(plugin_name)
 	if build_app then
 		project "app"
 			links {plugin_name}
+		if build_anim_benchmark then
+			project "anim_benchmark"
+				links {plugin_name}
+		end
+		if build_bench then
+			project "bench"
+				links {plugin_name}
+		end
 	end
 end
 
@@ -152,6 +160,22 @@ newoption {
 	description = "Do not build Studio."
 }
 
+newoption {
+	trigger = "no-simd",
+	description = "Use scalar implementation of float4 (engine/simd.h)."
+}
+
+newoption {
+	trigger = "array-growth",
+	value = "PERCENT",
+	description = "Growth factor of Array's capacity in percent, default is 150."
+}
+
+newoption {
+	trigger = "with-avx2",
+	description = "Use AVX2 and FMA instructions."
+}
+
 if _OPTIONS["plugins"] then
 	plugins = string.explode( _OPTIONS["plugins"], ",")
 end
@@ -216,6 +240,11 @@ if _OPTIONS["with-app"] then
 	build_app = true
 end
 
+-- headless benchmark of animation system, built with app
+build_anim_benchmark = build_app and has_plugin("animation") and has_plugin("renderer") and not _OPTIONS["dynamic-plugins"]
+-- engine micro-benchmarks (job system, allocators, hash map, culling, draw stream, transforms), built with app
+build_bench = build_app and has_plugin("renderer") and not _OPTIONS["dynamic-plugins"]
+
 if _OPTIONS["with-basis-universal"] then
 	use_basisu = true
 end
@@ -482,6 +511,26 @@ solution "LumixEngine"
 		defines {"STATIC_PLUGINS"}
 	end
 
+	if _OPTIONS["no-simd"] then
+		defines {"LUMIX_NO_SIMD"}
+	end
+
+	if _OPTIONS["array-growth"] then
+		local growth = tonumber(_OPTIONS["array-growth"])
+		if growth == nil or growth <= 100 then
+			error("array-growth must be a number greater than 100")
+		end
+		defines {"LUMIX_ARRAY_GROWTH_PERCENT=" .. _OPTIONS["array-growth"]}
+	end
+
+	if _OPTIONS["with-avx2"] then
+		configuration { "vs*" }
+			buildoptions { "/arch:AVX2" }
+		configuration { "linux" }
+			buildoptions { "-mavx2", "-mfma" }
+		configuration {}
+	end
+
 project "engine"
 	libType()
 
@@ -571,15 +620,18 @@ if has_plugin("renderer") then
 			"../src/renderer/**.c",
 		}
 		files { "../data/pipelines/**.*" }
+		-- compressed vertex and index buffers are decoded when models are loaded
+		files {
+			"../external/meshoptimizer/indexcodec.cpp",
+			"../external/meshoptimizer/vertexcodec.cpp",
+		}
 		excludes { 
-			"../external/meshoptimizer/clusterizer.cpp",
 			"../external/meshoptimizer/overdrawanalyzer.cpp",
 			"../external/meshoptimizer/overdrawoptimizer.cpp",
 			"../external/meshoptimizer/spatialorder.cpp",
 			"../external/meshoptimizer/stripifier.cpp",
 			"../external/meshoptimizer/vcacheanalyzer.cpp",
 			"../external/meshoptimizer/vcacheoptimizer.cpp",
-			"../external/meshoptimizer/vertexcodec.cpp",
 			"../external/meshoptimizer/vertexfilter.cpp",
 			"../external/meshoptimizer/vfetchanalyzer.cpp",
 			"../external/meshoptimizer/vfetchoptimizer.cpp",
@@ -828,6 +880,70 @@ if build_app then
 		defaultConfigurations()
 end
 
+if build_anim_benchmark then
+	project "anim_benchmark"
+		kind "ConsoleApp"
+		debugdir "../data"
+		includedirs { "../src" }
+		files { "../src/app/anim_benchmark.cpp" }
+
+		linkOpenGL()
+		if has_plugin("physics") then
+			linkPhysX()
+		end
+		if build_studio then links {"editor"} end
+		links { "engine" }
+		if use_basisu then
+			linkLib "basisu"
+		end
+		linkLib "freetype"
+		linkLib "luajit"
+		linkLib "recast"
+
+		configuration { "vs*" }
+			links { "psapi", "dxguid", "winmm", "imm32", "version" }
+
+		configuration { "linux" }
+			links { "GL", "X11", "dl", "rt", "Xi" }
+
+		configuration {}
+
+		useLua()
+		defaultConfigurations()
+end
+
+if build_bench then
+	project "bench"
+		kind "ConsoleApp"
+		debugdir "../data"
+		includedirs { "../src" }
+		files { "../src/app/bench.cpp" }
+
+		linkOpenGL()
+		if has_plugin("physics") then
+			linkPhysX()
+		end
+		if build_studio then links {"editor"} end
+		links { "engine" }
+		if use_basisu then
+			linkLib "basisu"
+		end
+		linkLib "freetype"
+		linkLib "luajit"
+		linkLib "recast"
+
+		configuration { "vs*" }
+			links { "psapi", "dxguid", "winmm", "imm32", "version" }
+
+		configuration { "linux" }
+			links { "GL", "X11", "dl", "rt", "Xi" }
+
+		configuration {}
+
+		useLua()
+		defaultConfigurations()
+end
+
 -- write plugins.inl
 for _, plugin in ipairs(base_plugins) do
 	linkPlugin(plugin)
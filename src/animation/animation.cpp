@@ -1,7 +1,11 @@
 #include "animation/animation.h"
 #include "engine/log.h"
+#include "engine/atomic.h"
 #include "engine/math.h"
+#include "engine/os.h"
 #include "engine/profiler.h"
+#include "engine/resource_manager.h"
+#include "engine/simd.h"
 #include "engine/stream.h"
 #include "engine/math.h"
 #include "renderer/model.h"
@@ -17,23 +21,142 @@ const ResourceType Animation::TYPE("animation");
 
 Animation::Animation(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
+	, m_allocator(allocator)
 	, m_mem(allocator)
 	, m_translations(allocator)
 	, m_rotations(allocator)
+	, m_blocks(allocator)
+	, m_block_offsets(allocator)
 {
 }
 
 
+Animation::Block::Block(Animation& anim, u32 index)
+	: anim(&anim)
+	, index(index)
+	, m_translations(anim.m_allocator)
+	, m_rotations(anim.m_allocator)
+	, m_mem(anim.m_allocator)
+{}
+
+
+Vec3 Animation::TranslationCurve::get(u32 idx) const {
+	if (!quantized) return pos[idx];
+	const u16* k = quantized + idx * 3;
+	return offset_scale[0] + Vec3(k[0], k[1], k[2]) * offset_scale[1];
+}
+
+Quat Animation::RotationCurve::get(u32 idx) const {
+	if (!quantized) return rot[idx];
+	const u16* k = quantized + idx * 3;
+	const u32 largest = ((k[0] >> 15) << 1) | (k[1] >> 15);
+	auto unpack = [](u16 v){ return ((v & 0x7fff) / float(0x7fff) * 2 - 1) * 0.70710678f; };
+	const float a = unpack(k[0]);
+	const float b = unpack(k[1]);
+	const float c = unpack(k[2]);
+	const float d = sqrtf(maximum(0.f, 1 - a * a - b * b - c * c));
+	switch (largest) {
+		case 0: return Quat(d, a, b, c);
+		case 1: return Quat(a, d, b, c);
+		case 2: return Quat(a, b, d, c);
+		default: return Quat(a, b, c, d);
+	}
+}
+
+// index of the first key after `anim_t`, in [1, count - 1]
+static u32 findKey(const u16* times, u32 count, u16 anim_t) {
+	u32 lo = 1;
+	u32 hi = count - 1;
+	while (lo < hi) {
+		const u32 mid = (lo + hi) >> 1;
+		if (times[mid] > anim_t) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+// same as nlerp(const Quat&, const Quat&, float), 4 quaternions at once, components are in separate registers
+static LUMIX_FORCE_INLINE void nlerp4(const float4* a, const float4* b, float4 t, float4* out) {
+	const float4 zero = f4Splat(0);
+	const float4 inv = f4Sub(f4Splat(1), t);
+	float4 d = f4Mul(a[0], b[0]);
+	d = f4MulAdd(a[1], b[1], d);
+	d = f4MulAdd(a[2], b[2], d);
+	d = f4MulAdd(a[3], b[3], d);
+	t = f4Blend(t, f4Sub(zero, t), f4CmpLT(d, zero));
+	float4 l = zero;
+	for (u32 i = 0; i < 4; ++i) {
+		out[i] = f4MulAdd(a[i], inv, f4Mul(b[i], t));
+		l = f4MulAdd(out[i], out[i], l);
+	}
+	l = f4Div(f4Splat(1), f4Sqrt(l));
+	for (u32 i = 0; i < 4; ++i) out[i] = f4Mul(out[i], l);
+}
+
+// rotation curves are interpolated 4 at a time, quaternions are stored as structure of arrays
+struct RotationBatch {
+	void push(const Quat& a, const Quat& b, float t, int bone) {
+		k0[0][count] = a.x; k0[1][count] = a.y; k0[2][count] = a.z; k0[3][count] = a.w;
+		k1[0][count] = b.x; k1[1][count] = b.y; k1[2][count] = b.z; k1[3][count] = b.w;
+		ts[count] = t;
+		bones[count] = bone;
+		++count;
+	}
+
+	template <bool use_weight>
+	void flush(Quat* rot, float weight) {
+		if (count == 0) return;
+		// unused lanes repeat the first one, so they do not produce NaNs
+		for (u32 lane = count; lane < 4; ++lane) {
+			for (u32 i = 0; i < 4; ++i) {
+				k0[i][lane] = k0[i][0];
+				k1[i][lane] = k1[i][0];
+			}
+			ts[lane] = ts[0];
+			bones[lane] = bones[0];
+		}
+
+		float4 a[4], b[4], res[4];
+		for (u32 i = 0; i < 4; ++i) {
+			a[i] = f4Load(k0[i]);
+			b[i] = f4Load(k1[i]);
+		}
+		nlerp4(a, b, f4Load(ts), res);
+
+		if constexpr (use_weight) {
+			for (u32 lane = 0; lane < 4; ++lane) {
+				const Quat& q = rot[bones[lane]];
+				k0[0][lane] = q.x; k0[1][lane] = q.y; k0[2][lane] = q.z; k0[3][lane] = q.w;
+			}
+			for (u32 i = 0; i < 4; ++i) a[i] = f4Load(k0[i]);
+			nlerp4(a, res, f4Splat(weight), res);
+		}
+
+		for (u32 i = 0; i < 4; ++i) f4Store(k0[i], res[i]);
+		for (u32 lane = 0; lane < count; ++lane) {
+			rot[bones[lane]] = Quat(k0[0][lane], k0[1][lane], k0[2][lane], k0[3][lane]);
+		}
+		count = 0;
+	}
+
+	alignas(16) float k0[4][4]; // [component][lane]
+	alignas(16) float k1[4][4];
+	alignas(16) float ts[4];
+	int bones[4];
+	u32 count = 0;
+};
+
 struct AnimationSampler {
-	template <bool use_mask, bool use_weight>
-	static void getRelativePose(const Animation& anim, Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) {
+	// T is either Animation or Animation::Block
+	template <bool use_mask, bool use_weight, typename T>
+	static void getRelativePose(const T& anim, Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) {
 		ASSERT(!pose.is_absolute);
 		ASSERT(model.isReady());
 
 		Vec3* pos = pose.positions;
 		Quat* rot = pose.rotations;
 
-		if (time < anim.getLength()) {
+		if (time < anim.m_length) {
 			const u64 anim_t_highres = ((u64)time.raw() << 16) / (anim.m_length.raw());
 			ASSERT(anim_t_highres <= 0xffFF);
 			const u16 anim_t = u16(anim_t_highres);
@@ -50,16 +173,16 @@ struct AnimationSampler {
 				}
 
 				Vec3 anim_pos;
-				if (curve.times) {
-					u32 idx = 1;
-					for (u32 c = curve.count; idx < c; ++idx) {
-						if (curve.times[idx] > anim_t) break;
-					}
+				if (curve.count == 1) {
+					anim_pos = curve.get(0);
+				}
+				else if (curve.times) {
+					const u32 idx = findKey(curve.times, curve.count, anim_t);
 					const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-					anim_pos = lerp(curve.pos[idx - 1], curve.pos[idx], t);
+					anim_pos = lerp(curve.get(idx - 1), curve.get(idx), t);
 				}
 				else {
-					anim_pos = lerp(curve.pos[frame_idx], curve.pos[frame_idx + 1], frame_t);
+					anim_pos = lerp(curve.get(frame_idx), curve.get(frame_idx + 1), frame_t);
 				}
 
 				const int model_bone_index = iter.value();
@@ -71,6 +194,7 @@ struct AnimationSampler {
 				}
 			}
 
+			RotationBatch batch;
 			for (const Animation::RotationCurve& curve : anim.m_rotations) {
 				Model::BoneMap::ConstIterator iter = model.getBoneIndex(curve.name);
 				if (!iter.isValid()) continue;
@@ -78,27 +202,22 @@ struct AnimationSampler {
 					if (mask->bones.find(curve.name) == mask->bones.end()) continue;
 				}
 
-				Quat anim_rot;
-				if(curve.times) {
-					u32 idx = 1;
-					for (u32 c = curve.count; idx < c; ++idx) {
-						if (curve.times[idx] > anim_t) break;
-					}
-					const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-					anim_rot = nlerp(curve.rot[idx - 1], curve.rot[idx], t);
-				}
-				else {
-					anim_rot = nlerp(curve.rot[frame_idx], curve.rot[frame_idx + 1], frame_t);
-				}
-
 				const int model_bone_index = iter.value();
-				if constexpr (use_weight) {
-					rot[model_bone_index] = nlerp(rot[model_bone_index], anim_rot, weight);
+				if (curve.count == 1) {
+					const Quat q = curve.get(0);
+					batch.push(q, q, 0, model_bone_index);
+				}
+				else if (curve.times) {
+					const u32 idx = findKey(curve.times, curve.count, anim_t);
+					const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
+					batch.push(curve.get(idx - 1), curve.get(idx), t, model_bone_index);
 				}
 				else {
-					rot[model_bone_index] = anim_rot;
+					batch.push(curve.get(frame_idx), curve.get(frame_idx + 1), frame_t, model_bone_index);
 				}
+				if (batch.count == 4) batch.flush<use_weight>(rot, weight);
 			}
+			batch.flush<use_weight>(rot, weight);
 		}
 		else {
 			for (const Animation::TranslationCurve& curve : anim.m_translations) {
@@ -110,10 +229,10 @@ struct AnimationSampler {
 
 				const int model_bone_index = iter.value();
 				if constexpr (use_weight) {
-					pos[model_bone_index] = lerp(pos[model_bone_index], curve.pos[curve.count - 1], weight);
+					pos[model_bone_index] = lerp(pos[model_bone_index], curve.get(curve.count - 1), weight);
 				}
 				else {
-					pos[model_bone_index] = curve.pos[curve.count - 1];
+					pos[model_bone_index] = curve.get(curve.count - 1);
 				}
 			}
 
@@ -126,35 +245,48 @@ struct AnimationSampler {
 
 				const int model_bone_index = iter.value();
 				if constexpr (use_weight) {
-					rot[model_bone_index] = nlerp(rot[model_bone_index], curve.rot[curve.count - 1], weight);
+					rot[model_bone_index] = nlerp(rot[model_bone_index], curve.get(curve.count - 1), weight);
 				}
 				else {
-					rot[model_bone_index] = curve.rot[curve.count - 1];
+					rot[model_bone_index] = curve.get(curve.count - 1);
 				}
 			}
 		}
 	}
 }; // AnimationSampler
 
-void Animation::getRelativePose(Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) const {
+template <typename T>
+static void sample(const T& anim, Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) {
 	if (mask) {
 		if (weight < 0.9999f) {
-			AnimationSampler::getRelativePose<true, true>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<true, true>(anim, time, pose, model, weight, mask);
 		}
 		else {
-			AnimationSampler::getRelativePose<true, false>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<true, false>(anim, time, pose, model, weight, mask);
 		}
 	}
 	else {
 		if (weight < 0.9999f) {
-			AnimationSampler::getRelativePose<false, true>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<false, true>(anim, time, pose, model, weight, mask);
 		}
 		else {
-			AnimationSampler::getRelativePose<false, false>(*this, time, pose, model, weight, mask);
+			AnimationSampler::getRelativePose<false, false>(anim, time, pose, model, weight, mask);
 		}
 	}
 }
 
+void Animation::getRelativePose(Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) const {
+	if (m_blocks.empty()) {
+		sample(*this, time, pose, model, weight, mask);
+		return;
+	}
+
+	// bones keep their current transforms until the block is streamed in
+	Time local_time;
+	const Block* block = getBlock(time, local_time);
+	if (block) sample(*block, local_time, pose, model, weight, mask);
+}
+
 Vec3 Animation::getTranslation(Time time, u32 curve_idx) const
 {
 	const TranslationCurve& curve = m_translations[curve_idx];
@@ -163,6 +295,7 @@ Vec3 Animation::getTranslation(Time time, u32 curve_idx) const
 		ASSERT(anim_t_highres <= 0xffFF);
 		const u16 anim_t = u16(anim_t_highres);
 
+		if (curve.count == 1) return curve.get(0);
 		if (curve.times) {
 			u32 idx = 1;
 			for (u32 c = curve.count; idx < c; ++idx) {
@@ -170,7 +303,7 @@ Vec3 Animation::getTranslation(Time time, u32 curve_idx) const
 			}
 
 			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-			return lerp(curve.pos[idx - 1], curve.pos[idx], t);
+			return lerp(curve.get(idx - 1), curve.get(idx), t);
 		}
 
 		const u64 frame_48_16 = (m_frame_count - 1) * anim_t_highres;
@@ -178,10 +311,10 @@ Vec3 Animation::getTranslation(Time time, u32 curve_idx) const
 		const u32 frame_idx = u32(frame_48_16 >> 16);
 		const float frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
 
-		return lerp(curve.pos[frame_idx], curve.pos[frame_idx + 1], frame_t);
+		return lerp(curve.get(frame_idx), curve.get(frame_idx + 1), frame_t);
 	}
 
-	return curve.pos[curve.count - 1];
+	return curve.get(curve.count - 1);
 }
 
 int Animation::getTranslationCurveIndex(BoneNameHash name_hash) const {
@@ -206,6 +339,7 @@ Quat Animation::getRotation(Time time, u32 curve_idx) const
 		ASSERT(anim_t_highres <= 0xffFF);
 		const u16 anim_t = u16(anim_t_highres);
 
+		if (curve.count == 1) return curve.get(0);
 		if (curve.times) {
 			u32 idx = 1;
 			for (u32 c = curve.count; idx < c; ++idx) {
@@ -213,7 +347,7 @@ Quat Animation::getRotation(Time time, u32 curve_idx) const
 			}
 
 			const float t = float(anim_t - curve.times[idx - 1]) / (curve.times[idx] - curve.times[idx - 1]);
-			return nlerp(curve.rot[idx - 1], curve.rot[idx], t);
+			return nlerp(curve.get(idx - 1), curve.get(idx), t);
 		}
 
 		const u64 frame_48_16 = (m_frame_count - 1) * anim_t_highres;
@@ -221,84 +355,205 @@ Quat Animation::getRotation(Time time, u32 curve_idx) const
 		const u32 frame_idx = u32(frame_48_16 >> 16);
 		const float frame_t = (frame_48_16 & 0xffFF) / float(0xffFF);
 
-		return nlerp(curve.rot[frame_idx], curve.rot[frame_idx + 1], frame_t);
+		return nlerp(curve.get(frame_idx), curve.get(frame_idx + 1), frame_t);
 	}
 
-	return curve.rot[curve.count - 1];
+	return curve.get(curve.count - 1);
 }
 
 void Animation::getRelativePose(Time time, Pose& pose, const Model& model, const BoneMask* mask) const {
-	if(mask) {
-		AnimationSampler::getRelativePose<true, false>(*this, time, pose, model, 1, mask);
+	getRelativePose(time, pose, model, 1, mask);
+}
+
+// called from animation jobs
+const Animation::Block* Animation::getBlock(Time time, Time& local_time) const {
+	const u32 index = minimum(time.raw() / m_block_length.raw(), m_blocks.size() - 1);
+	local_time = Time(time.raw() - index * m_block_length.raw());
+	requestBlock(index);
+	// prefetch, so playback does not stall on block boundaries
+	if (index + 1 < (u32)m_blocks.size()) requestBlock(index + 1);
+
+	Block& block = m_blocks[index];
+	block.last_used = os::Timer::getRawTimestamp();
+	return block.state == Block::READY ? &block : nullptr;
+}
+
+void Animation::requestBlock(u32 index) const {
+	Block& block = m_blocks[index];
+	if (block.state != Block::EMPTY) return;
+	// several animators can sample the same animation at once
+	if (!compareAndExchange(&block.state, Block::LOADING, Block::EMPTY)) return;
+
+	block.last_used = os::Timer::getRawTimestamp();
+	const StaticString<LUMIX_MAX_PATH> compiled_path(".lumix/resources/", m_blocks_path.getHash().getHashValue(), ".res");
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	const u64 offset = sizeof(CompiledResourceHeader) + m_block_offsets[index];
+	const u64 size = m_block_offsets[index + 1] - m_block_offsets[index];
+	block.handle = fs.getContentRange(Path(compiled_path), offset, size, makeDelegate<&Block::onLoaded>(&block), FileSystem::Priority::HIGH);
+}
+
+// main thread
+void Animation::Block::onLoaded(u64 size, const u8* mem, bool success) {
+	handle = FileSystem::AsyncHandle::invalid();
+	if (!success) {
+		logError("Could not load block ", index, " of ", anim->getPath());
+		// do not request it again every frame
+		state = READY;
+		return;
 	}
-	else {
-		AnimationSampler::getRelativePose<false, false>(*this, time, pose, model, 1, mask);
+
+	InputMemoryStream blob(mem, size);
+	u32 block_frames;
+	if (!parseCurves(blob, anim->getPath(), m_length, m_frame_count, block_frames, m_translations, m_rotations, m_mem) || block_frames != 0) {
+		m_translations.clear();
+		m_rotations.clear();
 	}
+	state = READY;
+	last_used = os::Timer::getRawTimestamp();
+	anim->evictBlocks();
+}
+
+// main thread, blocks are not sampled at this point
+void Animation::evictBlocks() {
+	constexpr float EVICT_AFTER = 2; // seconds
+	const u64 now = os::Timer::getRawTimestamp();
+	const u64 limit = u64(EVICT_AFTER * os::Timer::getFrequency());
+	for (Block& block : m_blocks) {
+		if (block.state != Block::READY || now - block.last_used < limit) continue;
+
+		block.m_translations.clear();
+		block.m_rotations.clear();
+		block.m_mem.clear();
+		block.state = Block::EMPTY;
+	}
+}
+
+void Animation::clearBlocks() {
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	for (Block& block : m_blocks) {
+		if (block.handle.isValid()) fs.cancel(block.handle);
+	}
+	m_blocks.clear();
+	m_block_offsets.clear();
+	m_blocks_path = Path();
 }
 
 bool Animation::load(u64 mem_size, const u8* mem)
 {
-	m_translations.clear();
-	m_rotations.clear();
-	m_mem.clear();
+	return decode(mem_size, mem);
+}
+
+
+bool Animation::parseCurves(InputMemoryStream& file, const Path& path, Time& length, u32& frame_count, u32& block_frames, Array<TranslationCurve>& translations, Array<RotationCurve>& rotations, Array<u8>& mem) {
+	translations.clear();
+	rotations.clear();
+	mem.clear();
 	Header header;
-	InputMemoryStream file(mem, mem_size);
 	file.read(&header, sizeof(header));
 	if (header.magic != HEADER_MAGIC) {
-		logError("Invalid animation file ", getPath());
+		logError("Invalid animation file ", path);
 		return false;
 	}
 
 	if (header.version > Version::LAST) {
-		logError(getPath(), ": version not supported");
+		logError(path, ": version not supported");
 		return false;
 	}
 
 	if (header.version <= Version::FIRST) {
-		logError(getPath(), ": version not supported. Please delete '.lumix' directory and try again");
+		logError(path, ": version not supported. Please delete '.lumix' directory and try again");
 		return false;
 	}
 
-	m_length = header.length;
-	m_frame_count = header.frame_count;
+	length = header.length;
+	frame_count = header.frame_count;
+	block_frames = 0;
+	if (header.version > Version::QUANTIZED) {
+		file.read(block_frames);
+		// streamed animation, the rest is parsed by the caller
+		if (block_frames != 0) return true;
+	}
+
 	u32 translations_count;
 	file.read(&translations_count, sizeof(translations_count));
 	const u32 size = u32(file.size() - file.getPosition());
-	m_mem.resize(size);
-	file.read(&m_mem[0], size);
+	mem.resize(size);
+	file.read(&mem[0], size);
 
-	m_translations.resize(translations_count);
+	translations.resize(translations_count);
 
-	InputMemoryStream blob(&m_mem[0], size);
-	for (int i = 0; i < m_translations.size(); ++i) {
-		TranslationCurve& curve = m_translations[i];
+	const bool is_quantized = header.version > Version::UNCOMPRESSED;
+	InputMemoryStream blob(&mem[0], size);
+	for (int i = 0; i < translations.size(); ++i) {
+		TranslationCurve& curve = translations[i];
 		curve.name = blob.read<BoneNameHash>();
 		const Animation::CurveType type = blob.read<Animation::CurveType>();
 		curve.count = blob.read<u32>();
 		ASSERT(curve.count > 1 || type != Animation::CurveType::KEYFRAMED);
 		curve.times = type == Animation::CurveType::KEYFRAMED ? (const u16*)blob.skip(curve.count * sizeof(u16)) : nullptr;
-		curve.pos = (const Vec3*)blob.skip(curve.count * sizeof(Vec3));
+		if (is_quantized) {
+			curve.pos = nullptr;
+			curve.offset_scale = (const Vec3*)blob.skip(sizeof(Vec3) * 2);
+			curve.quantized = (const u16*)blob.skip(curve.count * sizeof(u16) * 3);
+		}
+		else {
+			curve.pos = (const Vec3*)blob.skip(curve.count * sizeof(Vec3));
+			curve.offset_scale = nullptr;
+			curve.quantized = nullptr;
+		}
 	}
 	
 	const u32 rotations_count = blob.read<u32>();
-	m_rotations.resize(rotations_count);
+	rotations.resize(rotations_count);
 
-	for (int i = 0; i < m_rotations.size(); ++i) {
-		RotationCurve& curve = m_rotations[i];
+	for (int i = 0; i < rotations.size(); ++i) {
+		RotationCurve& curve = rotations[i];
 		curve.name = blob.read<BoneNameHash>();
 		const Animation::CurveType type = blob.read<Animation::CurveType>();
 		curve.count = blob.read<u32>();
 		ASSERT(curve.count > 1 || type != Animation::CurveType::KEYFRAMED);
 		curve.times = type == Animation::CurveType::KEYFRAMED ? (const u16*)blob.skip(curve.count * sizeof(u16)) : nullptr;
-		curve.rot = (const Quat*)blob.skip(curve.count * sizeof(Quat));
+		if (is_quantized) {
+			curve.rot = nullptr;
+			curve.quantized = (const u16*)blob.skip(curve.count * sizeof(u16) * 3);
+		}
+		else {
+			curve.rot = (const Quat*)blob.skip(curve.count * sizeof(Quat));
+			curve.quantized = nullptr;
+		}
 	}
 
 	return true;
 }
 
 
+bool Animation::decode(u64 mem_size, const u8* mem)
+{
+	clearBlocks();
+	InputMemoryStream file(mem, mem_size);
+	u32 block_frames;
+	if (!parseCurves(file, getPath(), m_length, m_frame_count, block_frames, m_translations, m_rotations, m_mem)) return false;
+	if (block_frames == 0) return true;
+
+	file.read(m_block_length);
+	const u32 blocks_count = file.read<u32>();
+	if (blocks_count == 0 || m_block_length.raw() == 0) {
+		logError(getPath(), ": invalid streamed animation");
+		return false;
+	}
+	m_block_offsets.resize(blocks_count + 1);
+	file.read(m_block_offsets.begin(), m_block_offsets.byte_size());
+	m_blocks_path = file.readString();
+	// blocks are referenced by delegates, so they must not move
+	m_blocks.reserve(blocks_count);
+	for (u32 i = 0; i < blocks_count; ++i) m_blocks.emplace(*this, i);
+	return true;
+}
+
+
 void Animation::unload()
 {
+	clearBlocks();
 	m_translations.clear();
 	m_rotations.clear();
 	m_mem.clear();
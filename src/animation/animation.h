@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/file_system.h"
 #include "engine/hash.h"
 #include "engine/hash_map.h"
 #include "engine/resource.h"
@@ -56,11 +57,22 @@ struct Animation final : Resource
 	public:
 		enum class CurveType : u8 {
 			KEYFRAMED,
-			SAMPLED
+			SAMPLED,
+			// single key
+			CONSTANT
 		};
 
+		// since UNCOMPRESSED, keys are quantized:
+		// translation - Vec3 offset, Vec3 scale, then 3 x u16 per key, value = offset + key * scale
+		// rotation - 3 x u16 per key, smallest three components in 15 bits each, 
+		// top bits of the first two u16 are the index of the omitted (largest, positive) component
+		// since QUANTIZED, header is followed by u32 block_frames, if it's not 0 the animation is streamed:
+		// Time block_length, u32 blocks_count, u64 offsets[blocks_count + 1] and the locator of the blocks;
+		// every block is a complete non-streamed animation, stored uncompressed so it can be read alone
 		enum class Version : u32 {
 			FIRST = 3,
+			UNCOMPRESSED,
+			QUANTIZED,
 
 			LAST
 		};
@@ -84,31 +96,84 @@ struct Animation final : Resource
 		void getRelativePose(Time time, Pose& pose, const Model& model, const BoneMask* mask) const;
 		void getRelativePose(Time time, Pose& pose, const Model& model, float weight, const BoneMask* mask) const;
 		Time getLength() const { return m_length; }
+		bool isStreamed() const { return !m_blocks.empty(); }
+		Path getStreamedPath() const override { return m_blocks_path; }
 
 	private:
+		struct Block;
+
 		void unload() override;
 		bool load(u64 size, const u8* mem) override;
+		// parsing does not touch anything but the animation
+		bool isDecodedInBackground() const override { return true; }
+		bool decode(u64 size, const u8* mem) override;
 
 	private:
 		Time m_length;
 		struct TranslationCurve
 		{
+			Vec3 get(u32 idx) const;
+
 			BoneNameHash name;
 			u32 count;
 			const u16* times;
+			// either pos or quantized is set
 			const Vec3* pos;
+			const u16* quantized;
+			const Vec3* offset_scale;
 		};
 		struct RotationCurve
 		{
+			Quat get(u32 idx) const;
+
 			BoneNameHash name;
 			u32 count;
 			const u16* times;
+			// either rot or quantized is set
 			const Quat* rot;
+			const u16* quantized;
 		};
+		// fixed duration part of a streamed animation, same members as Animation so both are sampled by the same code
+		struct Block {
+			enum State : i32 {
+				EMPTY,
+				LOADING,
+				READY
+			};
+
+			Block(Animation& anim, u32 index);
+			void onLoaded(u64 size, const u8* mem, bool success);
+
+			Animation* anim;
+			u32 index;
+			Time m_length;
+			u32 m_frame_count = 0;
+			Array<TranslationCurve> m_translations;
+			Array<RotationCurve> m_rotations;
+			Array<u8> m_mem;
+			volatile i32 state = EMPTY;
+			u64 last_used = 0;
+			FileSystem::AsyncHandle handle = FileSystem::AsyncHandle::invalid();
+		};
+
+		static bool parseCurves(InputMemoryStream& file, const Path& path, Time& length, u32& frame_count, u32& block_frames, Array<TranslationCurve>& translations, Array<RotationCurve>& rotations, Array<u8>& mem);
+		// returns nullptr if the block is not resident yet, requests it and the following one
+		const Block* getBlock(Time time, Time& local_time) const;
+		void requestBlock(u32 index) const;
+		void evictBlocks();
+		void clearBlocks();
+
+		IAllocator& m_allocator;
 		Array<TranslationCurve> m_translations;
 		Array<RotationCurve> m_rotations;
 		Array<u8> m_mem;
 		u32 m_frame_count = 0;
+		// streamed animation, blocks are loaded ahead of the sampled time and evicted when not sampled for a while
+		// curves are only in blocks, so getTranslation, getRotation and root motion do not work with streamed animations
+		mutable Array<Block> m_blocks;
+		Time m_block_length;
+		Path m_blocks_path;
+		Array<u64> m_block_offsets;
 
 		friend struct AnimationSampler;
 };
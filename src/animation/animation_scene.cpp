@@ -19,6 +19,7 @@
 #include "renderer/model.h"
 #include "renderer/pose.h"
 #include "renderer/render_scene.h"
+#include "renderer/renderer.h"
 
 
 namespace Lumix
@@ -44,6 +45,11 @@ struct AnimationSceneImpl final : AnimationScene
 {
 	friend struct AnimationSystemImpl;
 	
+	enum : i32 {
+		POSE_EVALUATE = -1,
+		POSE_NONE = -2
+	};
+
 	struct Animator
 	{
 		EntityRef entity;
@@ -51,6 +57,8 @@ struct AnimationSceneImpl final : AnimationScene
 		u32 default_set = 0;
 		anim::RuntimeContext* ctx = nullptr;
 		LocalRigidTransform root_motion = {{0, 0, 0}, {0, 0, 0, 1}};
+		// time since the last update, animators with lod are not updated every frame
+		float skipped_time = 0;
 
 		struct IK {
 			float weight = 0;
@@ -85,6 +93,15 @@ struct AnimationSceneImpl final : AnimationScene
 	};
 
 
+	// sampled value of a property animation curve
+	struct PropertyWrite
+	{
+		EntityRef entity;
+		const PropertyAnimation::Curve* curve;
+		float value;
+	};
+
+
 	AnimationSceneImpl(Engine& engine, IPlugin& anim_system, Universe& universe, IAllocator& allocator)
 		: m_universe(universe)
 		, m_engine(engine)
@@ -94,6 +111,9 @@ struct AnimationSceneImpl final : AnimationScene
 		, m_animators(allocator)
 		, m_allocator(allocator)
 		, m_animator_map(allocator)
+		, m_pose_sources(allocator)
+		, m_property_writes(allocator)
+		, m_property_write_offsets(allocator)
 	{
 		m_is_game_running = false;
 	}
@@ -101,6 +121,8 @@ struct AnimationSceneImpl final : AnimationScene
 	void init() override {
 		m_render_scene = static_cast<RenderScene*>(m_universe.getScene("renderer"));
 		ASSERT(m_render_scene);
+		m_renderer = static_cast<Renderer*>(m_engine.getPluginManager().getPlugin("renderer"));
+		ASSERT(m_renderer);
 	}
 
 
@@ -494,7 +516,7 @@ struct AnimationSceneImpl final : AnimationScene
 
 		model->getRelativePose(*pose);
 		animable.animation->getRelativePose(animable.time, *pose, *model, nullptr);
-		pose->computeAbsolute(*model);
+		pose->computeSkinning(*model);
 
 		Time t = animable.time + Time::fromSeconds(time_delta);
 		const Time l = animable.animation->getLength();
@@ -618,51 +640,93 @@ struct AnimationSceneImpl final : AnimationScene
 
 	void updateAnimator(Animator& animator, float time_delta)
 	{
-		if (!animator.resource || !animator.resource->isReady()) return;
+		if (!updateAnimatorController(animator, time_delta)) return;
+		evaluateAnimatorPose(animator);
+	}
+
+	// returns false if there is no pose to evaluate
+	bool updateAnimatorController(Animator& animator, float time_delta)
+	{
+		if (!animator.resource || !animator.resource->isReady()) return false;
 		if (!animator.ctx) {
 			animator.ctx = animator.resource->createRuntime(animator.default_set);
 		}
 
 		const EntityRef entity = animator.entity;
-		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
+		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return false;
 
 		Model* model = m_render_scene->getModelInstanceModel(entity);
-		if (!model->isReady()) return;
-
-		Pose* pose = m_render_scene->lockPose(entity);
-		if (!pose) return;
+		if (!model->isReady()) return false;
+		if (!m_render_scene->lockPose(entity)) return false;
 
 		animator.ctx->model = model;
 		animator.ctx->time_delta = Time::fromSeconds(time_delta);
 		animator.ctx->root_bone_hash = BoneNameHash(animator.resource->m_root_motion_bone);
 		animator.resource->update(*animator.ctx, animator.root_motion);
+		return true;
+	}
+
+	void evaluateAnimatorPose(Animator& animator)
+	{
+		const EntityRef entity = animator.entity;
+		Model* model = animator.ctx->model;
+		Pose* pose = m_render_scene->lockPose(entity);
 
 		model->getRelativePose(*pose);
 		animator.resource->getPose(*animator.ctx, *pose);
 		
-		for (Animator::IK& ik : animator.inverse_kinematics) {
-			if (ik.weight == 0) break;
-			const u32 idx = u32(&ik - animator.inverse_kinematics);
-			updateIK(animator.resource->m_ik[idx], ik, *pose, *model);
+		if (animator.inverse_kinematics[0].weight != 0) {
+			// distant characters use fewer iterations, once the frame's budget is spent they skip IK
+			const ModelInstance* mi = m_render_scene->getModelInstance(entity);
+			const u32 lod = m_animator_lod ? u32(minimum(mi->lod, 4.f)) : 0;
+			for (Animator::IK& ik : animator.inverse_kinematics) {
+				if (ik.weight == 0) break;
+				const u32 solved = (u32)atomicIncrement(&m_ik_chains_solved);
+				if (solved > m_ik_budget && lod > 0) break;
+				const u32 idx = u32(&ik - animator.inverse_kinematics);
+				updateIK(animator.resource->m_ik[idx], ik, *pose, *model, lod);
+			}
 		}
 
-		pose->computeAbsolute(*model);
+		pose->computeSkinning(*model);
 
 		m_render_scene->unlockPose(entity, true);
 	}
 
 	static LocalRigidTransform getAbsolutePosition(const Pose& pose, const Model& model, int bone_index)
 	{
-		const Model::Bone& bone = model.getBone(bone_index);
-		LocalRigidTransform bone_transform{pose.positions[bone_index], pose.rotations[bone_index]};
-		if (bone.parent_idx < 0)
-		{
-			return bone_transform;
+		LocalRigidTransform res{pose.positions[bone_index], pose.rotations[bone_index]};
+		for (int i = model.getBone(bone_index).parent_idx; i >= 0; i = model.getBone(i).parent_idx) {
+			res = LocalRigidTransform{pose.positions[i], pose.rotations[i]} * res;
 		}
-		return getAbsolutePosition(pose, model, bone.parent_idx) * bone_transform;
+		return res;
 	}
 
-	static void updateIK(anim::Controller::IK& res_ik, Animator::IK& ik, Pose& pose, Model& model)
+	// moves 3 bones chain so the end reaches target, the chain keeps bending in its current plane
+	static void solveTwoBoneIK(LocalRigidTransform* transforms, const float* len, const Vec3& target)
+	{
+		const Vec3 a = transforms[0].pos;
+		const Vec3 to_target = target - a;
+		const float dist_sqr = squaredLength(to_target);
+		if (dist_sqr < 1e-8f) return;
+
+		const float dist = minimum(sqrtf(dist_sqr), len[0] + len[1] - 1e-4f);
+		const Vec3 dir = to_target / sqrtf(dist_sqr);
+
+		Vec3 bend = transforms[1].pos - a;
+		bend = bend - dir * dot(bend, dir);
+		if (squaredLength(bend) < 1e-8f) {
+			bend = cross(dir, fabsf(dir.y) < 0.99f ? Vec3(0, 1, 0) : Vec3(1, 0, 0));
+		}
+		bend = normalize(bend);
+
+		const float cos_a = clamp((len[0] * len[0] + dist * dist - len[1] * len[1]) / (2 * len[0] * dist), -1.f, 1.f);
+		const float sin_a = sqrtf(1 - cos_a * cos_a);
+		transforms[1].pos = a + dir * (len[0] * cos_a) + bend * (len[0] * sin_a);
+		transforms[2].pos = a + dir * dist;
+	}
+
+	static void updateIK(anim::Controller::IK& res_ik, Animator::IK& ik, Pose& pose, Model& model, u32 lod)
 	{
 		u32 indices[anim::Controller::IK::MAX_BONES_COUNT];
 		LocalRigidTransform transforms[anim::Controller::IK::MAX_BONES_COUNT];
@@ -676,7 +740,7 @@ struct AnimationSceneImpl final : AnimationScene
 			indices[i] = iter.value();
 		}
 
-		// convert from bone space to object space
+		// convert from bone space to object space, parents of the chain are walked only once
 		const Model::Bone& first_bone = model.getBone(indices[0]);
 		LocalRigidTransform roots_parent;
 		if (first_bone.parent_idx >= 0) {
@@ -700,23 +764,29 @@ struct AnimationSceneImpl final : AnimationScene
 		}
 
 		Vec3 target = ik.target;
-		Vec3 to_target = target - transforms[0].pos;
-		if (len_sum * len_sum < squaredLength(to_target)) {
-			to_target = normalize(to_target);
-			target = transforms[0].pos + to_target * len_sum;
-		}
-
-		for (int iteration = 0; iteration < res_ik.max_iterations; ++iteration) {
-			transforms[res_ik.bones_count - 1].pos = target;
-			
-			for (int i = res_ik.bones_count - 1; i > 1; --i) {
-				Vec3 dir = normalize((transforms[i - 1].pos - transforms[i].pos));
-				transforms[i - 1].pos = transforms[i].pos + dir * len[i - 1];
+		if (res_ik.solver == anim::Controller::IK::Solver::TWO_BONE && res_ik.bones_count == 3) {
+			solveTwoBoneIK(transforms, len, target);
+		}
+		else {
+			Vec3 to_target = target - transforms[0].pos;
+			if (len_sum * len_sum < squaredLength(to_target)) {
+				to_target = normalize(to_target);
+				target = transforms[0].pos + to_target * len_sum;
 			}
 
-			for (int i = 1; i < res_ik.bones_count; ++i) {
-				Vec3 dir = normalize((transforms[i].pos - transforms[i - 1].pos));
-				transforms[i].pos = transforms[i - 1].pos + dir * len[i - 1];
+			const int iterations = maximum(res_ik.max_iterations >> lod, 1);
+			for (int iteration = 0; iteration < iterations; ++iteration) {
+				transforms[res_ik.bones_count - 1].pos = target;
+				
+				for (int i = res_ik.bones_count - 1; i > 1; --i) {
+					Vec3 dir = normalize((transforms[i - 1].pos - transforms[i].pos));
+					transforms[i - 1].pos = transforms[i].pos + dir * len[i - 1];
+				}
+
+				for (int i = 1; i < res_ik.bones_count; ++i) {
+					Vec3 dir = normalize((transforms[i].pos - transforms[i - 1].pos));
+					transforms[i].pos = transforms[i - 1].pos + dir * len[i - 1];
+				}
 			}
 		}
 
@@ -757,29 +827,62 @@ struct AnimationSceneImpl final : AnimationScene
 	}
 
 
-	void applyPropertyAnimator(EntityRef entity, PropertyAnimator& animator)
+	// samples all curves of the animator to `out`, curves with less than 2 keys are marked by null curve
+	static void samplePropertyAnimator(EntityRef entity, const PropertyAnimator& animator, PropertyWrite* out)
 	{
 		const PropertyAnimation* animation = animator.animation;
 		int frame = int(animator.time * animation->fps + 0.5f);
 		frame = frame % animation->curves[0].frames.back();
-		for (PropertyAnimation::Curve& curve : animation->curves)
+		for (const PropertyAnimation::Curve& curve : animation->curves)
 		{
-			if (curve.frames.size() < 2) continue;
-			for (int i = 1, n = curve.frames.size(); i < n; ++i)
-			{
-				if (frame <= curve.frames[i])
-				{
-					float t = (frame - curve.frames[i - 1]) / float(curve.frames[i] - curve.frames[i - 1]);
-					float v = curve.values[i] * t + curve.values[i - 1] * (1 - t);
-					ComponentUID cmp;
-					cmp.type = curve.cmp_type;
-					cmp.scene = m_universe.getScene(cmp.type);
-					cmp.entity = entity;
-					ASSERT(curve.property->setter);
-					curve.property->set(cmp, -1, v);
-					break;
-				}
+			PropertyWrite& write = *out;
+			++out;
+			write.curve = nullptr;
+			const u32 n = curve.frames.size();
+			if (n < 2 || frame > curve.frames[n - 1]) continue;
+
+			// first key not before the frame
+			u32 lo = 1;
+			u32 hi = n - 1;
+			while (lo < hi) {
+				const u32 mid = (lo + hi) >> 1;
+				if (frame <= curve.frames[mid]) hi = mid;
+				else lo = mid + 1;
+			}
+			const float t = (frame - curve.frames[lo - 1]) / float(curve.frames[lo] - curve.frames[lo - 1]);
+			write.value = curve.values[lo] * t + curve.values[lo - 1] * (1 - t);
+			write.entity = entity;
+			write.curve = &curve;
+		}
+	}
+
+
+	void applyPropertyAnimator(EntityRef entity, PropertyAnimator& animator)
+	{
+		const PropertyAnimation* animation = animator.animation;
+		if (!animation || !animation->isReady() || animation->curves.empty() || animation->curves[0].frames.empty()) return;
+
+		Array<PropertyWrite> writes(m_allocator);
+		writes.resize(animation->curves.size());
+		samplePropertyAnimator(entity, animator, writes.begin());
+		applyPropertyWrites(writes);
+	}
+
+
+	// setters are not thread safe, so writes are applied here, not in sampling jobs
+	void applyPropertyWrites(const Array<PropertyWrite>& writes)
+	{
+		ComponentUID cmp;
+		cmp.type = INVALID_COMPONENT_TYPE;
+		for (const PropertyWrite& write : writes) {
+			if (!write.curve) continue;
+			if (write.curve->cmp_type != cmp.type) {
+				cmp.type = write.curve->cmp_type;
+				cmp.scene = m_universe.getScene(cmp.type);
 			}
+			cmp.entity = write.entity;
+			ASSERT(write.curve->property->setter);
+			write.curve->property->set(cmp, -1, write.value);
 		}
 	}
 
@@ -787,20 +890,38 @@ struct AnimationSceneImpl final : AnimationScene
 	void updatePropertyAnimators(float time_delta)
 	{
 		PROFILE_FUNCTION();
+		if (m_property_animators.size() == 0) return;
+
+		// each active animator gets a range of writes, one per curve
+		m_property_write_offsets.resize(m_property_animators.size());
+		u32 writes_count = 0;
 		for (int anim_idx = 0, c = m_property_animators.size(); anim_idx < c; ++anim_idx)
 		{
-			EntityRef entity = m_property_animators.getKey(anim_idx);
 			PropertyAnimator& animator = m_property_animators.at(anim_idx);
 			const PropertyAnimation* animation = animator.animation;
+			m_property_write_offsets[anim_idx] = 0xffFFffFF;
 			if (!animation || !animation->isReady()) continue;
 			if (animation->curves.empty()) continue;
 			if (animation->curves[0].frames.empty()) continue;
 			if (animator.flags.isSet(PropertyAnimator::DISABLED)) continue;
 
-			animator.time += time_delta;
-			
-			applyPropertyAnimator(entity, animator);
+			m_property_write_offsets[anim_idx] = writes_count;
+			writes_count += animation->curves.size();
 		}
+		m_property_writes.resize(writes_count);
+		if (writes_count == 0) return;
+
+		jobs::forEach(m_property_animators.size(), 64, [&](i32 from, i32 to){
+			PROFILE_BLOCK("sample property animators");
+			for (i32 i = from; i < to; ++i) {
+				if (m_property_write_offsets[i] == 0xffFFffFF) continue;
+				PropertyAnimator& animator = m_property_animators.at(i);
+				animator.time += time_delta;
+				samplePropertyAnimator(m_property_animators.getKey(i), animator, &m_property_writes[m_property_write_offsets[i]]);
+			}
+		});
+
+		applyPropertyWrites(m_property_writes);
 	}
 
 
@@ -809,9 +930,11 @@ struct AnimationSceneImpl final : AnimationScene
 		PROFILE_FUNCTION();
 		if (m_animables.size() == 0) return;
 
-		jobs::forEach(m_animables.size(), 1, [&](i32 idx, i32){
-			Animable& animable = m_animables.at(idx);
-			updateAnimable(animable, time_delta);
+		jobs::forEach(m_animables.size(), [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				Animable& animable = m_animables.at(i);
+				updateAnimable(animable, time_delta);
+			}
 		});
 	}
 
@@ -825,12 +948,120 @@ struct AnimationSceneImpl final : AnimationScene
 		updateAnimables(time_delta);
 		updatePropertyAnimators(time_delta);
 
-		jobs::forEach(m_animators.size(), 1, [&](i32 idx, i32){
-			updateAnimator(m_animators[idx], time_delta);
+		++m_frame;
+		m_ik_chains_solved = 0;
+		const u32 render_frame = m_renderer->frameNumber();
+		if (m_pose_sharing) m_pose_sources.resize(m_animators.size());
+		jobs::forEach(m_animators.size(), [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				Animator& animator = m_animators[i];
+				if (m_pose_sharing) m_pose_sources[i] = POSE_NONE;
+				animator.skipped_time += time_delta;
+				const u32 rate = getAnimatorUpdateRate(animator, render_frame);
+				// root motion of skipped frames is reported all at once in the next update
+				if (rate == 0 || (m_frame + animator.entity.index) % rate != 0) {
+					animator.root_motion = {{0, 0, 0}, {0, 0, 0, 1}};
+					continue;
+				}
+				if (m_pose_sharing) {
+					if (updateAnimatorController(animator, animator.skipped_time)) m_pose_sources[i] = POSE_EVALUATE;
+				}
+				else {
+					updateAnimator(animator, animator.skipped_time);
+				}
+				animator.skipped_time = 0;
+			}
+		});
+
+		if (m_pose_sharing) updateSharedPoses();
+	}
+
+
+	static bool isSameState(const Animator& a, const Animator& b) {
+		if (a.resource != b.resource || a.ctx->model != b.ctx->model) return false;
+		if (a.ctx->data.size() != b.ctx->data.size()) return false;
+		if (memcmp(a.ctx->data.data(), b.ctx->data.data(), a.ctx->data.size()) != 0) return false;
+		return memcmp(a.ctx->animations.begin(), b.ctx->animations.begin(), a.ctx->animations.byte_size()) == 0;
+	}
+
+
+	// animators with the same controller, model and runtime state evaluate the pose only once
+	// whole state is compared, so only animators started and driven in sync share poses
+	void updateSharedPoses() {
+		PROFILE_FUNCTION();
+		HashMap<RuntimeHash32, i32> leaders(m_allocator);
+		for (i32 i = 0, c = m_animators.size(); i < c; ++i) {
+			if (m_pose_sources[i] != POSE_EVALUATE) continue;
+			const Animator& animator = m_animators[i];
+			if (animator.inverse_kinematics[0].weight != 0) continue;
+
+			RollingHasher hasher;
+			hasher.begin();
+			hasher.update(&animator.resource, sizeof(animator.resource));
+			hasher.update(&animator.ctx->model, sizeof(animator.ctx->model));
+			hasher.update(animator.ctx->animations.begin(), animator.ctx->animations.byte_size());
+			hasher.update(animator.ctx->data.data(), (u32)animator.ctx->data.size());
+			const RuntimeHash32 key = hasher.end();
+
+			auto iter = leaders.find(key);
+			if (!iter.isValid()) {
+				leaders.insert(key, i);
+			}
+			// hash collision, evaluate own pose
+			else if (isSameState(m_animators[iter.value()], animator)) {
+				m_pose_sources[i] = iter.value();
+			}
+		}
+
+		jobs::forEach(m_animators.size(), [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				if (m_pose_sources[i] == POSE_EVALUATE) evaluateAnimatorPose(m_animators[i]);
+			}
 		});
+
+		jobs::forEach(m_animators.size(), [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				if (m_pose_sources[i] < 0) continue;
+				const EntityRef entity = m_animators[i].entity;
+				const Pose* src = m_render_scene->lockPose(m_animators[m_pose_sources[i]].entity);
+				Pose* dst = m_render_scene->lockPose(entity);
+				ASSERT(src->count == dst->count);
+				memcpy(dst->positions, src->positions, sizeof(dst->positions[0]) * dst->count);
+				memcpy(dst->rotations, src->rotations, sizeof(dst->rotations[0]) * dst->count);
+				dst->is_absolute = src->is_absolute;
+				dst->is_skinning_valid = src->is_skinning_valid;
+				if (src->is_skinning_valid) memcpy(dst->skinning, src->skinning, sizeof(dst->skinning[0]) * dst->count);
+				m_render_scene->unlockPose(entity, true);
+			}
+		});
+	}
+
+
+	void setIKBudget(u32 chains_per_frame) override { m_ik_budget = chains_per_frame; }
+	u32 getIKBudget() const override { return m_ik_budget; }
+	void enablePoseSharing(bool enable) override { m_pose_sharing = enable; }
+	bool isPoseSharingEnabled() const override { return m_pose_sharing; }
+
+
+	// 0 - do not update, otherwise update every `rate`-th frame, staggered by entity so updates are spread over frames
+	u32 getAnimatorUpdateRate(const Animator& animator, u32 render_frame) const {
+		if (!m_animator_lod) return 1;
+		if (!m_universe.hasComponent(animator.entity, MODEL_INSTANCE_TYPE)) return 1;
+		
+		const ModelInstance* mi = m_render_scene->getModelInstance(animator.entity);
+		// pipeline stamps instances it draws, including shadows, during the previous frame
+		if (render_frame - mi->visible_frame > 2) return 0;
+		if (mi->lod < 1) return 1;
+		if (mi->lod < 2) return 2;
+		if (mi->lod < 3) return 4;
+		return 8;
 	}
 
 
+	void enableAnimatorLOD(bool enable) override { m_animator_lod = enable; }
+	bool isAnimatorLODEnabled() const override { return m_animator_lod; }
+
+
 	PropertyAnimation* loadPropertyAnimation(const Path& path) const
 	{
 		if (path.isEmpty()) return nullptr;
@@ -886,6 +1117,19 @@ struct AnimationSceneImpl final : AnimationScene
 	IPlugin& getPlugin() const override { return m_anim_system; }
 
 
+	bool getComponentChunk(ComponentType type, ComponentChunk& chunk) override {
+		if (type == ANIMABLE_TYPE) {
+			chunk = ComponentChunk::fromArrays(m_animables.keys(), m_animables.values());
+			return true;
+		}
+		if (type == PROPERTY_ANIMATOR_TYPE) {
+			chunk = ComponentChunk::fromArrays(m_property_animators.keys(), m_property_animators.values());
+			return true;
+		}
+		return false;
+	}
+
+
 	IAllocator& m_allocator;
 	Universe& m_universe;
 	IPlugin& m_anim_system;
@@ -895,7 +1139,19 @@ struct AnimationSceneImpl final : AnimationScene
 	HashMap<EntityRef, u32> m_animator_map;
 	Array<Animator> m_animators;
 	RenderScene* m_render_scene;
+	Renderer* m_renderer;
 	bool m_is_game_running;
+	bool m_animator_lod = true;
+	u32 m_frame = 0;
+	bool m_pose_sharing = false;
+	// IK chains solved in the current frame, chains over budget are skipped on distant characters
+	volatile i32 m_ik_chains_solved = 0;
+	u32 m_ik_budget = 256;
+	// per animator, index of the animator whose pose is copied, or one of POSE_EVALUATE, POSE_NONE
+	Array<i32> m_pose_sources;
+	Array<PropertyWrite> m_property_writes;
+	// per property animator, index of its first write, 0xffFFffFF if it's not updated
+	Array<u32> m_property_write_offsets;
 };
 
 
@@ -49,6 +49,15 @@ struct AnimationScene : IScene {
 	virtual anim::Controller* getAnimatorController(EntityRef entity) = 0;
 	virtual void setAnimatorIK(EntityRef entity, u32 index, float weight, const struct Vec3& target) = 0;
 	virtual float getAnimationLength(int animation_idx) = 0;
+	// distant and small animators are updated less often, off-screen animators are not updated
+	virtual void enableAnimatorLOD(bool enable) = 0;
+	virtual bool isAnimatorLODEnabled() const = 0;
+	// number of IK chains solved per frame before IK is skipped on characters with lod > 0
+	virtual void setIKBudget(u32 chains_per_frame) = 0;
+	virtual u32 getIKBudget() const = 0;
+	// animators in exactly the same state of the same controller evaluate the pose once and copy it
+	virtual void enablePoseSharing(bool enable) = 0;
+	virtual bool isPoseSharingEnabled() const = 0;
 };
 
 
@@ -47,7 +47,10 @@ namespace Instruction
 		NOT,
 		INPUT_FLOAT,
 		INPUT_U32,
-		INPUT_BOOL
+		INPUT_BOOL,
+		// u16 operand - size of the right operand's code, skipped if the top of the stack decides `and` / `or`
+		JUMP_IF_FALSE_OR_POP,
+		JUMP_IF_TRUE_OR_POP
 	};
 }
 
@@ -125,6 +128,21 @@ public:
 		Operator oper;
 	};
 
+	// value on the stack during compilation
+	struct StackEntry
+	{
+		Types type;
+		bool is_const;
+		// offset of the first instruction computing the value
+		int start;
+		union
+		{
+			float f_value;
+			u32 u_value;
+			bool b_value;
+		};
+	};
+
 	public:
 		int tokenize(const char* src, const Span<Token>& tokens);
 		int compile(const char* src, const Token* tokens, int token_count, u8* byte_code, int max_size, InputDecl& decl);
@@ -233,6 +251,13 @@ public:
 private:
 	void callFunction(u16 idx, const RuntimeContext& rc);
 
+	template<typename T>
+	T& peek()
+	{
+		return *(T*)(m_stack + m_stack_pointer - sizeof(T));
+	}
+
+
 	template<typename T>
 	T& pop()
 	{
@@ -323,6 +348,22 @@ ExpressionVM::ReturnValue ExpressionVM::evaluate(const u8* code, const RuntimeCo
 			}
 			break;
 			case Instruction::NOT: push<bool>(!pop<bool>()); break;
+			case Instruction::JUMP_IF_FALSE_OR_POP:
+			{
+				const u16 offset = *(u16*)cp;
+				cp += sizeof(u16);
+				if (!peek<bool>()) cp += offset;
+				else pop<bool>();
+			}
+			break;
+			case Instruction::JUMP_IF_TRUE_OR_POP:
+			{
+				const u16 offset = *(u16*)cp;
+				cp += sizeof(u16);
+				if (peek<bool>()) cp += offset;
+				else pop<bool>();
+			}
+			break;
 		}
 	}
 }
@@ -564,6 +605,49 @@ int ExpressionCompiler::getPriority(const Token& token)
 }
 
 
+// folds operation with constant arguments, `args` are in push order
+static bool foldConstants(Instruction::Type instr, const ExpressionCompiler::StackEntry* args, ExpressionCompiler::StackEntry& res)
+{
+	res.is_const = true;
+	switch (instr)
+	{
+		case Instruction::ADD_FLOAT: res.f_value = args[0].f_value + args[1].f_value; return true;
+		case Instruction::SUB_FLOAT: res.f_value = args[0].f_value - args[1].f_value; return true;
+		case Instruction::MUL_FLOAT: res.f_value = args[0].f_value * args[1].f_value; return true;
+		case Instruction::DIV_FLOAT: res.f_value = args[0].f_value / args[1].f_value; return true;
+		case Instruction::UNARY_MINUS: res.f_value = -args[0].f_value; return true;
+		case Instruction::FLOAT_LT: res.b_value = args[0].f_value < args[1].f_value; return true;
+		case Instruction::FLOAT_GT: res.b_value = args[0].f_value > args[1].f_value; return true;
+		case Instruction::INT_EQ: res.b_value = args[0].u_value == args[1].u_value; return true;
+		case Instruction::INT_NEQ: res.b_value = args[0].u_value != args[1].u_value; return true;
+		case Instruction::AND: res.b_value = args[0].b_value && args[1].b_value; return true;
+		case Instruction::OR: res.b_value = args[0].b_value || args[1].b_value; return true;
+		case Instruction::NOT: res.b_value = !args[0].b_value; return true;
+		default: return false;
+	}
+}
+
+
+// same as ExpressionVM::callFunction, functions depending on runtime context are not folded
+static bool foldFunction(u16 idx, const ExpressionCompiler::StackEntry* args, ExpressionCompiler::StackEntry& res)
+{
+	res.is_const = true;
+	switch (idx)
+	{
+		case 0: res.f_value = sinf(args[0].f_value); return true;
+		case 1: res.f_value = cosf(args[0].f_value); return true;
+		case 2: {
+			const float a = args[2].f_value;
+			const float b = args[1].f_value;
+			const float epsilon = args[0].f_value;
+			res.b_value = a - b > -epsilon && a - b < epsilon;
+			return true;
+		}
+		default: return false;
+	}
+}
+
+
 int ExpressionCompiler::compile(const char* src,
 	const Token* tokens,
 	int token_count,
@@ -584,47 +668,153 @@ int ExpressionCompiler::compile(const char* src,
 		return int(out - byte_code);
 	}
 
-	Types type_stack[50];
-	int type_stack_idx = 0;
+	StackEntry stack[50];
+	int stack_idx = 0;
+
+	auto hasSpace = [&](int size){
+		if (max_size - (out - byte_code) >= size) return true;
+		m_compile_time_error = Condition::Error::OUT_OF_MEMORY;
+		return false;
+	};
+
+	// replaces code of the top `arity` values with a single constant
+	auto pushConst = [&](const StackEntry& value, int arity) -> bool {
+		stack_idx -= arity;
+		StackEntry& e = stack[stack_idx];
+		const int start = arity > 0 ? e.start : int(out - byte_code);
+		out = byte_code + start;
+		if (!hasSpace(1 + sizeof(float))) return false;
+		e = value;
+		e.start = start;
+		e.is_const = true;
+		switch (value.type)
+		{
+			case Types::FLOAT: *out = Instruction::PUSH_FLOAT; ++out; *(float*)out = value.f_value; out += sizeof(float); break;
+			case Types::U32: *out = Instruction::PUSH_U32; ++out; *(u32*)out = value.u_value; out += sizeof(u32); break;
+			case Types::BOOL: *out = Instruction::PUSH_BOOL; ++out; *(bool*)out = value.b_value; out += sizeof(bool); break;
+			default: ASSERT(false); break;
+		}
+		++stack_idx;
+		return true;
+	};
+
+	auto pushInput = [&](Instruction::Type instr, Types type, int offset) -> bool {
+		if (!hasSpace(1 + sizeof(int))) return false;
+		stack[stack_idx].type = type;
+		stack[stack_idx].is_const = false;
+		stack[stack_idx].start = int(out - byte_code);
+		++stack_idx;
+		*out = instr;
+		++out;
+		*(int*)out = offset;
+		out += sizeof(int);
+		return true;
+	};
+
+	// `and`, `or` - right operand is skipped if left one decides the result, constant operands are removed
+	auto logicOperator = [&](bool is_and) -> bool {
+		StackEntry& left = stack[stack_idx - 2];
+		StackEntry& right = stack[stack_idx - 1];
+		// `x and true`, `x or false`
+		if (right.is_const && right.b_value == is_and)
+		{
+			out = byte_code + right.start;
+			--stack_idx;
+			return true;
+		}
+		// `true and x`, `false or x`
+		if (left.is_const && left.b_value == is_and)
+		{
+			const int right_size = int(out - byte_code) - right.start;
+			memmove(byte_code + left.start, byte_code + right.start, right_size);
+			out = byte_code + left.start + right_size;
+			right.start = left.start;
+			left = right;
+			--stack_idx;
+			return true;
+		}
+		// `x and false`, `false and x`, `x or true`, `true or x`
+		if (left.is_const || right.is_const)
+		{
+			StackEntry res;
+			res.type = Types::BOOL;
+			res.b_value = !is_and;
+			return pushConst(res, 2);
+		}
+
+		if (!hasSpace(1 + sizeof(u16))) return false;
+		const int right_size = int(out - byte_code) - right.start;
+		if (right_size > 0xffFF)
+		{
+			m_compile_time_error = Condition::Error::OUT_OF_MEMORY;
+			return false;
+		}
+		u8* jump = byte_code + right.start;
+		memmove(jump + 1 + sizeof(u16), jump, right_size);
+		*jump = is_and ? Instruction::JUMP_IF_FALSE_OR_POP : Instruction::JUMP_IF_TRUE_OR_POP;
+		*(u16*)(jump + 1) = u16(right_size);
+		out += 1 + sizeof(u16);
+		left.is_const = false;
+		--stack_idx;
+		return true;
+	};
+
 	for (int i = 0; i < token_count; ++i)
 	{
 		auto& token = tokens[i];
 
 		switch(token.type)
 		{
-			case Token::NUMBER:
-				if (max_size - (out - byte_code) < sizeof(float) + 1)
-				{
-					m_compile_time_error = Condition::Error::OUT_OF_MEMORY;
-					return -1;
-				}
-				*out = Instruction::PUSH_FLOAT;
-				type_stack[type_stack_idx] = Types::FLOAT;
-				++type_stack_idx;
-				++out;
-				*(float*)out = token.number;
-				out += sizeof(float);
+			case Token::NUMBER: {
+				StackEntry value;
+				value.type = Types::FLOAT;
+				value.f_value = token.number;
+				if (!pushConst(value, 0)) return -1;
 				break;
+			}
 			case Token::OPERATOR:
 				for (auto& fn : OPERATOR_FUNCTIONS)
 				{
 					if (token.oper != fn.op) continue;
 
-					if (type_stack_idx < fn.arity())
+					if (stack_idx < fn.arity())
 					{
 						m_compile_time_error = Condition::Error::NOT_ENOUGH_PARAMETERS;
 						m_compile_time_offset = token.offset;
 						return -1;
 					}
-					if (!fn.checkArgTypes(type_stack, type_stack_idx))
+					Types arg_types[50];
+					for (int j = 0; j < stack_idx; ++j) arg_types[j] = stack[j].type;
+					if (!fn.checkArgTypes(arg_types, stack_idx))
 					{
 						m_compile_time_error = Condition::Error::INCORRECT_TYPE_ARGS;
 						m_compile_time_offset = token.offset;
 						return -1;
 					}
-					type_stack_idx -= fn.arity();
-					type_stack[type_stack_idx] = fn.ret_type;
-					++type_stack_idx;
+
+					if (fn.instr == Instruction::AND || fn.instr == Instruction::OR)
+					{
+						if (!logicOperator(fn.instr == Instruction::AND)) return -1;
+						break;
+					}
+
+					const StackEntry* args = stack + stack_idx - fn.arity();
+					bool all_const = true;
+					for (int j = 0; j < fn.arity(); ++j) all_const = all_const && args[j].is_const;
+					StackEntry res;
+					res.type = fn.ret_type;
+					if (all_const && foldConstants(fn.instr, args, res))
+					{
+						if (!pushConst(res, fn.arity())) return -1;
+						break;
+					}
+
+					if (!hasSpace(1)) return -1;
+					stack_idx -= fn.arity();
+					stack[stack_idx].type = fn.ret_type;
+					stack[stack_idx].is_const = false;
+					// start of the first argument stays
+					++stack_idx;
 					*out = fn.instr;
 					++out;
 					break;
@@ -636,23 +826,40 @@ int ExpressionCompiler::compile(const char* src,
 					if(func_idx != 0xffFF)
 					{
 						auto& fn = FUNCTIONS[func_idx];
-						if (type_stack_idx < fn.arity())
+						if (stack_idx < fn.arity())
 						{
 							m_compile_time_error = Condition::Error::NOT_ENOUGH_PARAMETERS;
 							m_compile_time_offset = token.offset;
 							return -1;
 						}
 
-						if (!fn.checkArgTypes(type_stack, type_stack_idx))
+						Types arg_types[50];
+						for (int j = 0; j < stack_idx; ++j) arg_types[j] = stack[j].type;
+						if (!fn.checkArgTypes(arg_types, stack_idx))
 						{
 							m_compile_time_error = Condition::Error::INCORRECT_TYPE_ARGS;
 							m_compile_time_offset = token.offset;
 							return -1;
 						}
 
-						type_stack_idx -= fn.arity();
-						type_stack[type_stack_idx] = fn.ret_type;
-						++type_stack_idx;
+						const StackEntry* args = stack + stack_idx - fn.arity();
+						bool all_const = true;
+						for (int j = 0; j < fn.arity(); ++j) all_const = all_const && args[j].is_const;
+						StackEntry res;
+						res.type = fn.ret_type;
+						if (all_const && foldFunction(func_idx, args, res))
+						{
+							if (!pushConst(res, fn.arity())) return -1;
+							break;
+						}
+
+						if (!hasSpace(1 + sizeof(u16))) return -1;
+						const int start = fn.arity() > 0 ? stack[stack_idx - fn.arity()].start : int(out - byte_code);
+						stack_idx -= fn.arity();
+						stack[stack_idx].type = fn.ret_type;
+						stack[stack_idx].is_const = false;
+						stack[stack_idx].start = start;
+						++stack_idx;
 						*out = Instruction::CALL;
 						++out;
 						*(u16*)out = func_idx;
@@ -667,82 +874,48 @@ int ExpressionCompiler::compile(const char* src,
 							auto& input = decl.inputs[input_idx];
 							switch (input.type)
 							{
-								case InputDecl::FLOAT:
-									*out = Instruction::INPUT_FLOAT;
-									type_stack[type_stack_idx] = Types::FLOAT;
-									++type_stack_idx;
-									++out;
-									*(int*)out = input.offset;
-									out += sizeof(int);
-									break;
-								case InputDecl::U32:
-									*out = Instruction::INPUT_U32;
-									type_stack[type_stack_idx] = Types::U32;
-									++type_stack_idx;
-									++out;
-									*(int*)out = input.offset;
-									out += sizeof(int);
-									break;
-								case InputDecl::BOOL:
-									*out = Instruction::INPUT_BOOL;
-									type_stack[type_stack_idx] = Types::BOOL;
-									++type_stack_idx;
-									++out;
-									*(int*)out = input.offset;
-									out += sizeof(int);
-									break;
+								case InputDecl::FLOAT: if (!pushInput(Instruction::INPUT_FLOAT, Types::FLOAT, input.offset)) return -1; break;
+								case InputDecl::U32: if (!pushInput(Instruction::INPUT_U32, Types::U32, input.offset)) return -1; break;
+								case InputDecl::BOOL: if (!pushInput(Instruction::INPUT_BOOL, Types::BOOL, input.offset)) return -1; break;
 								default: ASSERT(false); break;
 							}
 						}
 						else if (const_idx >= 0)
 						{
 							auto& constant = decl.constants[const_idx];
+							StackEntry value;
 							switch (constant.type)
 							{
 								case InputDecl::FLOAT:
-									*out = Instruction::PUSH_FLOAT;
-									type_stack[type_stack_idx] = Types::FLOAT;
-									++type_stack_idx;
-									++out;
-									*(float*)out = constant.f_value;
-									out += sizeof(float);
+									value.type = Types::FLOAT;
+									value.f_value = constant.f_value;
 									break;
 								case InputDecl::U32:
-									*out = Instruction::PUSH_U32;
-									type_stack[type_stack_idx] = Types::U32;
-									++type_stack_idx;
-									++out;
-									*(int*)out = constant.i_value;
-									out += sizeof(int);
+									value.type = Types::U32;
+									value.u_value = constant.i_value;
 									break;
 								default: ASSERT(false); break;
 							}
+							if (!pushConst(value, 0)) return -1;
 						}
 						else
 						{
-							float float_const_value;
-							if (!getFloatConstValue(src, token, float_const_value))
+							StackEntry value;
+							if (getFloatConstValue(src, token, value.f_value))
 							{
-								bool bool_const_value;
-								if (!getBoolConstValue(src, token, bool_const_value))
-								{
-									m_compile_time_error = Condition::Error::UNKNOWN_IDENTIFIER;
-									m_compile_time_offset = token.offset;
-									return -1;
-								}
-								*out = Instruction::PUSH_BOOL;
-								type_stack[type_stack_idx] = Types::BOOL;
-								++type_stack_idx;
-								++out;
-								*(bool*)out = bool_const_value;
-								out += sizeof(bool);
+								value.type = Types::FLOAT;
 							}
-							*out = Instruction::PUSH_FLOAT;
-							type_stack[type_stack_idx] = Types::FLOAT;
-							++type_stack_idx;
-							++out;
-							*(float*)out = float_const_value;
-							out += sizeof(float);
+							else if (getBoolConstValue(src, token, value.b_value))
+							{
+								value.type = Types::BOOL;
+							}
+							else
+							{
+								m_compile_time_error = Condition::Error::UNKNOWN_IDENTIFIER;
+								m_compile_time_offset = token.offset;
+								return -1;
+							}
+							if (!pushConst(value, 0)) return -1;
 						}
 					}
 				}
@@ -752,22 +925,18 @@ int ExpressionCompiler::compile(const char* src,
 				break;
 		}
 	}
-	if (max_size - (out - byte_code) < 1)
-	{
-		m_compile_time_error = Condition::Error::OUT_OF_MEMORY;
-		return -1;
-	}
-	if (type_stack_idx < 1)
+	if (!hasSpace(1)) return -1;
+	if (stack_idx < 1)
 	{
 		m_compile_time_error = Condition::Error::NO_RETURN_VALUE;
 		return -1;
 	}
-	else if (type_stack_idx > 1)
+	else if (stack_idx > 1)
 	{
 		m_compile_time_error = Condition::Error::UNKNOWN_ERROR;
 		return -1;
 	}
-	switch(type_stack[type_stack_idx - 1])
+	switch(stack[stack_idx - 1].type)
 	{
 		case Types::FLOAT: *out = Instruction::RET_FLOAT; break;
 		case Types::BOOL: *out = Instruction::RET_BOOL; break;
@@ -933,7 +1102,7 @@ void Condition::compile(const char* expression, InputDecl& decl)
 		error = compiler.getError();
 		return;
 	}
-	bytecode.resize(128);
+	bytecode.resize(256);
 	int size = compiler.compile(expression, postfix_tokens, tokens_count, &bytecode[0], bytecode.size(), decl);
 	if (size < 0)
 	{
@@ -258,6 +258,10 @@ bool Controller::deserialize(InputMemoryStream& stream) {
 	else {
 		stream.read(m_ik);
 		stream.read(m_ik_count);
+		// solver used to be padding
+		if (header.version <= ControllerVersion::IK_SOLVER) {
+			for (IK& ik : m_ik) ik.solver = IK::Solver::FABRIK;
+		}
 	}
 	m_root->deserialize(stream, *this, (u32)header.version);
 	return true;
@@ -21,6 +21,7 @@ enum class ControllerVersion : u32 {
 	EVENTS,
 	TRANSITIONS,
 	HASH64,
+	IK_SOLVER,
 
 	LATEST
 };
@@ -61,8 +62,14 @@ public:
 	FlagSet<Flags, u32> m_flags;
 	struct IK {
 		enum { MAX_BONES_COUNT = 8 };
+		enum class Solver : u8 {
+			FABRIK,
+			// analytic, for chains of exactly 3 bones, e.g. arm or leg
+			TWO_BONE
+		};
 		u16 max_iterations = 5;
 		u16 bones_count = 4;
+		Solver solver = Solver::FABRIK;
 		BoneNameHash bones[MAX_BONES_COUNT];
 	} m_ik[4];
 	u32 m_ik_count = 0;
@@ -92,6 +92,8 @@ struct PropertyAnimationPlugin : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	bool createResource(const char* path) override
 	{
 		os::OutputFile file;
@@ -302,6 +304,8 @@ struct AnimControllerAssetBrowserPlugin : AssetBrowser::Plugin, AssetCompiler::I
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	bool onGUI(Span<Resource*> resources) override {
 		if (resources.length() == 1 && ImGui::Button("Open in animation editor")) {
 			m_controller_editor->show(resources[0]->getPath().c_str());
@@ -1163,6 +1163,18 @@ struct ControllerEditorImpl : ControllerEditor {
 								if (ImGui::Button("Pop")) --ik.bones_count;
 							} 
 
+							ImGuiEx::Label("Solver");
+							int solver = (int)ik.solver;
+							if (ImGui::Combo("##solver", &solver, "FABRIK\0Two bone\0")) ik.solver = (Controller::IK::Solver)solver;
+							if (ik.solver == Controller::IK::Solver::TWO_BONE && ik.bones_count != 3) {
+								ImGui::TextUnformatted("Two bone solver needs exactly 3 bones, FABRIK is used instead.");
+							}
+							if (ik.solver == Controller::IK::Solver::FABRIK) {
+								ImGuiEx::Label("Max iterations");
+								int iterations = ik.max_iterations;
+								if (ImGui::DragInt("##iters", &iterations, 1, 1, 64)) ik.max_iterations = (u16)iterations;
+							}
+
 							ImGui::TreePop();
 						}
 					}
@@ -444,6 +444,22 @@ GroupNode::~GroupNode() {
 	}
 }
 
+// transitions and selection test the same children's conditions, each one is evaluated at most once per update
+struct ConditionCache {
+	bool eval(const GroupNode::Child& child, u32 idx, const RuntimeContext& ctx) {
+		if (idx >= 64) return child.condition.eval(ctx);
+		const u64 bit = u64(1) << idx;
+		if ((evaluated & bit) == 0) {
+			evaluated |= bit;
+			if (child.condition.eval(ctx)) results |= bit;
+		}
+		return results & bit;
+	}
+
+	u64 evaluated = 0;
+	u64 results = 0;
+};
+
 void GroupNode::update(RuntimeContext& ctx, LocalRigidTransform& root_motion) const {
 	RuntimeData data = ctx.input_runtime.read<RuntimeData>();
 	
@@ -469,7 +485,8 @@ void GroupNode::update(RuntimeContext& ctx, LocalRigidTransform& root_motion) co
 		return;
 	}
 
-	const bool is_current_matching = m_children[data.from].condition.eval(ctx);
+	ConditionCache conditions;
+	const bool is_current_matching = conditions.eval(m_children[data.from], data.from, ctx);
 	const bool is_selectable = m_children[data.from].flags & Child::SELECTABLE;
 
 	if (!is_current_matching || !is_selectable) {
@@ -478,7 +495,7 @@ void GroupNode::update(RuntimeContext& ctx, LocalRigidTransform& root_motion) co
 		for (const Transition& transition : m_transitions) {
 			if (transition.to == data.to) continue;
 			if (transition.from != data.from && transition.from != 0xffFFffFF) continue;
-			if (transition.to != 0xffFFffFF && !m_children[transition.to].condition.eval(ctx)) continue;
+			if (transition.to != 0xffFFffFF && !conditions.eval(m_children[transition.to], transition.to, ctx)) continue;
 			
 			if (transition.exit_time >= 0) {
 				waiting_for_exit_time = true;
@@ -510,7 +527,7 @@ void GroupNode::update(RuntimeContext& ctx, LocalRigidTransform& root_motion) co
 				const Child& child = m_children[i];
 				if (i == data.from) continue;
 				if ((child.flags & Child::SELECTABLE) == 0) continue;
-				if (!child.condition.eval(ctx)) continue;
+				if (!conditions.eval(child, i, ctx)) continue;
 
 				data.to = i;
 				data.blend_length = m_blend_length;
@@ -0,0 +1,378 @@
+// measures animation throughput without rendering anything
+// anim_benchmark -model <path> -controller <path> [-count 256] [-frames 200] [-workers 1,2,4,8] [-out anim_benchmark.csv]
+// results are in nanoseconds per animator per frame, written as JSON if the output ends with .json, as CSV otherwise
+
+#include "animation/animation.h"
+#include "animation/animation_scene.h"
+#include "animation/controller.h"
+#include "engine/allocators.h"
+#include "engine/array.h"
+#include "engine/command_line_parser.h"
+#include "engine/debug.h"
+#include "engine/engine.h"
+#include "engine/file_system.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/os.h"
+#include "engine/path.h"
+#include "engine/profiler.h"
+#include "engine/reflection.h"
+#include "engine/resource_manager.h"
+#include "engine/sync.h"
+#include "engine/universe.h"
+#include "renderer/model.h"
+#include "renderer/pose.h"
+#include "renderer/render_scene.h"
+#include "renderer/renderer.h"
+
+using namespace Lumix;
+
+static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("model_instance");
+static const ComponentType ANIMATOR_TYPE = reflection::getComponentType("animator");
+
+struct Config {
+	static constexpr u32 MAX_RUNS = 16;
+
+	char model[LUMIX_MAX_PATH] = "";
+	char controller[LUMIX_MAX_PATH] = "";
+	char out[LUMIX_MAX_PATH] = "anim_benchmark.csv";
+	u32 count = 256;
+	u32 frames = 200;
+	u8 workers[MAX_RUNS] = {};
+	u32 workers_count = 0;
+};
+
+// ns per animator per frame
+struct Result {
+	u32 workers = 0;
+	double sample = 0;
+	double blend = 0;
+	// whole AnimationScene::update, controllers, sampling, blending, IK and skinning
+	double update = 0;
+	// update with IK weights set to 1 minus update without IK
+	double ik = 0;
+	double finalize = 0;
+};
+
+static bool parseArgs(Config& cfg) {
+	char cmd_line[2048];
+	os::getCommandLine(Span(cmd_line));
+	CommandLineParser parser(cmd_line);
+	char tmp[64];
+	while (parser.next()) {
+		if (parser.currentEquals("-model")) {
+			if (!parser.next()) break;
+			parser.getCurrent(cfg.model, lengthOf(cfg.model));
+		}
+		else if (parser.currentEquals("-controller")) {
+			if (!parser.next()) break;
+			parser.getCurrent(cfg.controller, lengthOf(cfg.controller));
+		}
+		else if (parser.currentEquals("-out")) {
+			if (!parser.next()) break;
+			parser.getCurrent(cfg.out, lengthOf(cfg.out));
+		}
+		else if (parser.currentEquals("-count")) {
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(Span(tmp, stringLength(tmp)), cfg.count);
+		}
+		else if (parser.currentEquals("-frames")) {
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(Span(tmp, stringLength(tmp)), cfg.frames);
+		}
+		else if (parser.currentEquals("-workers")) {
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			// comma separated list
+			const char* c = tmp;
+			while (*c && cfg.workers_count < lengthOf(cfg.workers)) {
+				u32 workers = 0;
+				const char* end = fromCString(Span(c, stringLength(c)), workers);
+				if (!end || workers == 0) break;
+				cfg.workers[cfg.workers_count] = (u8)minimum(workers, 255);
+				++cfg.workers_count;
+				c = end;
+				if (*c == ',') ++c;
+			}
+		}
+	}
+
+	if (cfg.workers_count == 0) {
+		const u32 cpus = os::getCPUsCount();
+		for (u32 w = 1; w < cpus && cfg.workers_count + 1 < lengthOf(cfg.workers); w *= 2) {
+			cfg.workers[cfg.workers_count] = (u8)w;
+			++cfg.workers_count;
+		}
+		cfg.workers[cfg.workers_count] = (u8)minimum(cpus, 255);
+		++cfg.workers_count;
+	}
+
+	// there is no log callback before the engine is created
+	if (!cfg.model[0] || !cfg.controller[0]) {
+		debug::debugOutput("Usage: anim_benchmark -model <path> -controller <path> [-count 256] [-frames 200] [-workers 1,2,4,8] [-out anim_benchmark.csv]\n");
+		return false;
+	}
+	if (cfg.count == 0 || cfg.frames == 0) {
+		debug::debugOutput("-count and -frames must be positive\n");
+		return false;
+	}
+	return true;
+}
+
+struct Benchmark {
+	Benchmark(const Config& cfg, IAllocator& allocator)
+		: cfg(cfg)
+		, allocator(allocator)
+		, entities(allocator)
+	{}
+
+	// loads everything and returns once all animators are ready to be updated
+	bool init() {
+		Engine::InitArgs init_args;
+		init_args.window_title = "Animation benchmark";
+		if (os::fileExists("main.pak")) {
+			init_args.file_system = FileSystem::createPacked("main.pak", allocator);
+		}
+		engine = Engine::create(static_cast<Engine::InitArgs&&>(init_args), allocator);
+		renderer = static_cast<Renderer*>(engine->getPluginManager().getPlugin("renderer"));
+		universe = &engine->createUniverse(true);
+		render_scene = (RenderScene*)universe->getScene("renderer");
+		anim_scene = (AnimationScene*)universe->getScene("animation");
+		if (!renderer || !render_scene || !anim_scene) {
+			logError("Renderer and animation plugins are required");
+			return false;
+		}
+		// every animator is updated every frame
+		anim_scene->enableAnimatorLOD(false);
+
+		const Path model_path(cfg.model);
+		const Path controller_path(cfg.controller);
+		entities.reserve(cfg.count);
+		for (u32 i = 0; i < cfg.count; ++i) {
+			const EntityRef e = universe->createEntity(DVec3(double(i % 32) * 2, 0, double(i / 32) * 2), Quat::IDENTITY);
+			universe->createComponent(MODEL_INSTANCE_TYPE, e);
+			render_scene->setModelInstancePath(e, model_path);
+			universe->createComponent(ANIMATOR_TYPE, e);
+			anim_scene->setAnimatorSource(e, controller_path);
+			entities.push(e);
+		}
+
+		FileSystem& fs = engine->getFileSystem();
+		const EntityRef first = entities[0];
+		os::Timer timer;
+		for (;;) {
+			fs.processCallbacks();
+			engine->getResourceManager().update();
+			renderer->frame();
+
+			model = render_scene->getModelInstanceModel(first);
+			controller = anim_scene->getAnimatorController(first);
+			if ((model && model->isFailure()) || (controller && controller->isFailure())) {
+				logError("Failed to load ", cfg.model, " or ", cfg.controller);
+				return false;
+			}
+			if (!fs.hasWork() && model && model->isReady() && controller && controller->isReady()) break;
+			if (timer.getTimeSinceStart() > 60) {
+				logError("Loading timed out");
+				return false;
+			}
+			os::sleep(1);
+		}
+
+		for (const anim::Controller::AnimationEntry& entry : controller->m_animation_entries) {
+			if (entry.animation && entry.animation->isReady() && !entry.animation->isStreamed()) {
+				animation = entry.animation;
+				break;
+			}
+		}
+		engine->startGame(*universe);
+		is_game_running = true;
+		return true;
+	}
+
+	void shutdown() {
+		if (universe) {
+			if (is_game_running) engine->stopGame(*universe);
+			engine->destroyUniverse(*universe);
+		}
+		engine.reset();
+	}
+
+	static double toNs(u64 ticks, u64 count) {
+		return double(ticks) * 1e9 / double(os::Timer::getFrequency()) / double(count);
+	}
+
+	double measureUpdate(float ik_weight) {
+		for (EntityRef e : entities) {
+			for (u32 i = 0; i < controller->m_ik_count; ++i) {
+				anim_scene->setAnimatorIK(e, i, ik_weight, Vec3(0, 1, 0.5f));
+			}
+		}
+		// warmup
+		anim_scene->update(1 / 60.f, false);
+
+		const u64 start = os::Timer::getRawTimestamp();
+		for (u32 frame = 0; frame < cfg.frames; ++frame) {
+			anim_scene->update(1 / 60.f, false);
+		}
+		return toNs(os::Timer::getRawTimestamp() - start, u64(cfg.frames) * entities.size());
+	}
+
+	// sampler, blending and skinning measured on their own, outside of controllers
+	void measurePoses(Result& result) {
+		if (!animation) {
+			logWarning("Controller does not have any non-streamed animation, sampling is not measured");
+			return;
+		}
+
+		Array<Pose*> poses(allocator);
+		poses.reserve(entities.size());
+		for (u32 i = 0; i < (u32)entities.size(); ++i) {
+			Pose* pose = LUMIX_NEW(allocator, Pose)(allocator);
+			pose->resize(model->getBoneCount());
+			poses.push(pose);
+		}
+
+		const Time length = animation->getLength();
+		u64 sample_ticks = 0;
+		u64 blend_ticks = 0;
+		u64 finalize_ticks = 0;
+		for (u32 frame = 0; frame < cfg.frames; ++frame) {
+			const Time time = length.raw() > 0 ? Time(u32((frame * 7919ull) % length.raw())) : length;
+			const Time blend_time = length.raw() > 0 ? Time((time.raw() + length.raw() / 2) % length.raw()) : length;
+
+			u64 t = os::Timer::getRawTimestamp();
+			jobs::forEach(poses.size(), 1, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) {
+					model->getRelativePose(*poses[i]);
+					animation->getRelativePose(time, *poses[i], *model, nullptr);
+				}
+			});
+			u64 now = os::Timer::getRawTimestamp();
+			sample_ticks += now - t;
+			t = now;
+
+			jobs::forEach(poses.size(), 1, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) {
+					animation->getRelativePose(blend_time, *poses[i], *model, 0.5f, nullptr);
+				}
+			});
+			now = os::Timer::getRawTimestamp();
+			blend_ticks += now - t;
+			t = now;
+
+			jobs::forEach(poses.size(), 1, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) {
+					poses[i]->computeSkinning(*model);
+				}
+			});
+			finalize_ticks += os::Timer::getRawTimestamp() - t;
+		}
+
+		for (Pose* pose : poses) LUMIX_DELETE(allocator, pose);
+
+		const u64 count = u64(cfg.frames) * entities.size();
+		result.sample = toNs(sample_ticks, count);
+		result.blend = toNs(blend_ticks, count);
+		result.finalize = toNs(finalize_ticks, count);
+	}
+
+	void run(Result& result) {
+		result.workers = jobs::getWorkersCount();
+		measurePoses(result);
+		result.update = measureUpdate(0);
+		if (controller->m_ik_count > 0) {
+			result.ik = maximum(measureUpdate(1) - result.update, 0.0);
+		}
+	}
+
+	const Config& cfg;
+	IAllocator& allocator;
+	UniquePtr<Engine> engine;
+	Renderer* renderer = nullptr;
+	Universe* universe = nullptr;
+	RenderScene* render_scene = nullptr;
+	AnimationScene* anim_scene = nullptr;
+	Model* model = nullptr;
+	anim::Controller* controller = nullptr;
+	Animation* animation = nullptr;
+	Array<EntityRef> entities;
+	bool is_game_running = false;
+};
+
+static bool writeResults(const Config& cfg, Span<const Result> results) {
+	os::OutputFile file;
+	if (!file.open(cfg.out)) {
+		debug::debugOutput(StaticString<LUMIX_MAX_PATH + 32>("Could not create ", cfg.out, "\n"));
+		return false;
+	}
+
+	const bool json = Path::hasExtension(cfg.out, "json");
+	if (json) {
+		file << "{\n\t\"model\": \"" << cfg.model << "\",\n\t\"controller\": \"" << cfg.controller << "\",\n";
+		file << "\t\"animators\": " << cfg.count << ",\n\t\"frames\": " << cfg.frames << ",\n\t\"results\": [\n";
+		for (const Result& r : results) {
+			file << "\t\t{ \"workers\": " << r.workers << ", \"sample_ns\": " << r.sample << ", \"blend_ns\": " << r.blend
+				<< ", \"ik_ns\": " << r.ik << ", \"finalize_ns\": " << r.finalize << ", \"update_ns\": " << r.update << " }";
+			file << (&r == &results.back() ? "\n" : ",\n");
+		}
+		file << "\t]\n}\n";
+	}
+	else {
+		file << "workers,animators,sample_ns,blend_ns,ik_ns,finalize_ns,update_ns\n";
+		for (const Result& r : results) {
+			file << r.workers << "," << cfg.count << "," << r.sample << "," << r.blend << "," << r.ik << "," << r.finalize << "," << r.update << "\n";
+		}
+	}
+	file.close();
+	if (file.isError()) debug::debugOutput(StaticString<LUMIX_MAX_PATH + 32>("Could not write ", cfg.out, "\n"));
+	return !file.isError();
+}
+
+int main(int args, char* argv[]) {
+	profiler::setThreadName("Main thread");
+	DefaultAllocator allocator;
+	Config cfg;
+	if (!parseArgs(cfg)) return 1;
+
+	Result results[Config::MAX_RUNS];
+	u32 results_count = 0;
+	// job system can not change number of workers, so everything is recreated for every count
+	for (u32 i = 0; i < cfg.workers_count; ++i) {
+		if (!jobs::init(cfg.workers[i], allocator)) {
+			debug::debugOutput("Failed to initialize job system.\n");
+			return 1;
+		}
+
+		struct Data {
+			Data(const Config& cfg, IAllocator& allocator) : benchmark(cfg, allocator), semaphore(0, 1) {}
+			Benchmark benchmark;
+			Result result;
+			bool success = false;
+			Semaphore semaphore;
+		} data(cfg, allocator);
+
+		jobs::runEx(&data, [](void* ptr) {
+			Data* data = (Data*)ptr;
+			data->success = data->benchmark.init();
+			if (data->success) data->benchmark.run(data->result);
+			data->benchmark.shutdown();
+			data->semaphore.signal();
+		}, nullptr, 0);
+
+		data.semaphore.wait();
+		jobs::shutdown();
+		if (!data.success) return 1;
+
+		const Result& r = data.result;
+		const StaticString<256> summary(r.workers, " workers: sample ", r.sample, " ns, blend ", r.blend, " ns, IK ", r.ik, " ns, finalize ", r.finalize, " ns, update ", r.update, " ns per animator\n");
+		debug::debugOutput(summary);
+		results[results_count] = r;
+		++results_count;
+	}
+
+	return writeResults(cfg, Span(results, results_count)) ? 0 : 1;
+}
@@ -0,0 +1,442 @@
+// engine micro-benchmarks
+// bench [-filter <substring>] [-iterations 7] [-out bench.json]
+// every benchmark runs `iterations` times, reported are min and median of nanoseconds per operation,
+// written as JSON if the output ends with .json, as CSV otherwise
+
+#include "engine/allocators.h"
+#include "engine/array.h"
+#include "engine/command_line_parser.h"
+#include "engine/debug.h"
+#include "engine/engine.h"
+#include "engine/file_system.h"
+#include "engine/geometry.h"
+#include "engine/hash_map.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/os.h"
+#include "engine/page_allocator.h"
+#include "engine/path.h"
+#include "engine/profiler.h"
+#include "engine/simd.h"
+#include "engine/stream.h"
+#include "engine/string.h"
+#include "engine/sync.h"
+#include "engine/universe.h"
+#include "renderer/culling_system.h"
+#include "renderer/draw_stream.h"
+#include "renderer/renderer.h"
+
+using namespace Lumix;
+
+struct Config {
+	char filter[64] = "";
+	char out[LUMIX_MAX_PATH] = "bench.json";
+	u32 iterations = 7;
+};
+
+struct Result {
+	StaticString<64> name;
+	u64 ops = 0;
+	double min_ns = 0;
+	double median_ns = 0;
+};
+
+static bool parseArgs(Config& cfg) {
+	char cmd_line[2048];
+	os::getCommandLine(Span(cmd_line));
+	CommandLineParser parser(cmd_line);
+	char tmp[64];
+	while (parser.next()) {
+		if (parser.currentEquals("-filter")) {
+			if (!parser.next()) break;
+			parser.getCurrent(cfg.filter, lengthOf(cfg.filter));
+		}
+		else if (parser.currentEquals("-out")) {
+			if (!parser.next()) break;
+			parser.getCurrent(cfg.out, lengthOf(cfg.out));
+		}
+		else if (parser.currentEquals("-iterations")) {
+			if (!parser.next()) break;
+			parser.getCurrent(tmp, lengthOf(tmp));
+			fromCString(Span(tmp, stringLength(tmp)), cfg.iterations);
+		}
+	}
+
+	// there is no log callback before the engine is created
+	if (cfg.iterations == 0) {
+		debug::debugOutput("Usage: bench [-filter <substring>] [-iterations 7] [-out bench.json]\n");
+		return false;
+	}
+	return true;
+}
+
+struct Bench {
+	Bench(const Config& cfg, IAllocator& allocator)
+		: cfg(cfg)
+		, allocator(allocator)
+		, results(allocator)
+	{}
+
+	bool isEnabled(const char* name) const {
+		return !cfg.filter[0] || stristr(name, cfg.filter);
+	}
+
+	// `f` is called `cfg.iterations` times after one warmup call, each call does `ops` operations
+	template <typename F>
+	void measure(const char* name, u64 ops, F&& f) {
+		if (!isEnabled(name)) return;
+
+		f();
+		Array<u64> ticks(allocator);
+		for (u32 i = 0; i < cfg.iterations; ++i) {
+			const u64 start = os::Timer::getRawTimestamp();
+			f();
+			ticks.push(os::Timer::getRawTimestamp() - start);
+		}
+		add(name, ops, ticks);
+	}
+
+	// for benchmarks which measure only a part of each iteration
+	void add(const char* name, u64 ops, Array<u64>& ticks) {
+		qsort(ticks.begin(), ticks.size(), sizeof(ticks[0]), [](const void* a, const void* b){
+			const u64 i = *(const u64*)a;
+			const u64 j = *(const u64*)b;
+			return i < j ? -1 : (i > j ? 1 : 0);
+		});
+		const double to_ns = 1e9 / double(os::Timer::getFrequency()) / double(ops);
+		Result& r = results.emplace();
+		r.name = name;
+		r.ops = ops;
+		r.min_ns = ticks[0] * to_ns;
+		r.median_ns = ticks[ticks.size() / 2] * to_ns;
+		debug::debugOutput(StaticString<256>(name, ": ", r.min_ns, " ns min, ", r.median_ns, " ns median per op\n"));
+	}
+
+	// job system can not change number of workers, so it's reinitialized for every count
+	void benchForEach(u8 workers) {
+		static constexpr i32 COUNT = 1 << 20;
+		const StaticString<64> name("jobs::forEach/", workers);
+		if (!isEnabled(name)) return;
+
+		Array<float> data(allocator);
+		data.resize(COUNT);
+		for (i32 i = 0; i < COUNT; ++i) data[i] = float(i);
+
+		measure(name, COUNT, [&](){
+			jobs::forEach(COUNT, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) data[i] = sqrtf(data[i] * 1.0001f + 1);
+			});
+		});
+	}
+
+	void benchAllocators() {
+		static constexpr u32 COUNT = 4096;
+		void* ptrs[COUNT];
+		DefaultAllocator default_allocator;
+		const u32 sizes[] = {16, 64, 256, 4096};
+		for (u32 size : sizes) {
+			measure(StaticString<64>("DefaultAllocator/", size), COUNT * 2, [&](){
+				for (u32 i = 0; i < COUNT; ++i) ptrs[i] = default_allocator.allocate(size);
+				for (u32 i = 0; i < COUNT; ++i) default_allocator.deallocate(ptrs[i]);
+			});
+		}
+
+		PageAllocator page_allocator;
+		measure("PageAllocator", COUNT * 2, [&](){
+			for (u32 i = 0; i < COUNT; ++i) ptrs[i] = page_allocator.allocate(true);
+			for (u32 i = 0; i < COUNT; ++i) page_allocator.deallocate(ptrs[i], true);
+		});
+	}
+
+	void benchHashMap() {
+		static constexpr u32 COUNT = 100'000;
+		HashMap<u32, u32> map(allocator);
+		measure("HashMap::insert", COUNT, [&](){
+			map.clear();
+			for (u32 i = 0; i < COUNT; ++i) map.insert(i * 7919, i);
+		});
+
+		u32 found = 0;
+		measure("HashMap::find", COUNT, [&](){
+			for (u32 i = 0; i < COUNT; ++i) {
+				if (map.find(i * 7919).isValid()) ++found;
+			}
+		});
+		if (found == 0) logError("HashMap::find did not find anything");
+	}
+
+	void benchCulling(PageAllocator& page_allocator) {
+		const u32 counts[] = {10'000, 100'000, 1'000'000};
+		for (u32 count : counts) {
+			const StaticString<64> name("CullingSystem::cull/", count);
+			const StaticString<64> multi_name("CullingSystem::cull x5/", count);
+			if (!isEnabled(name) && !isEnabled(multi_name)) continue;
+
+			UniquePtr<CullingSystem> culling = CullingSystem::create(allocator, page_allocator);
+			RandomGenerator rng;
+			for (u32 i = 0; i < count; ++i) {
+				const DVec3 pos(rng.randFloat(-1000, 1000), rng.randFloat(-100, 100), rng.randFloat(-1000, 1000));
+				culling->add({(i32)i}, 0, pos, rng.randFloat(1, 5));
+			}
+			culling->update();
+
+			ShiftedFrustum frustum;
+			frustum.computePerspective(DVec3(0), Vec3(0, 0, -1), Vec3(0, 1, 0), degreesToRadians(60.f), 16 / 9.f, 0.1f, 1000.f);
+			if (isEnabled(name)) {
+				u32 visible = 0;
+				measure(name, count, [&](){
+					CullResult* result = culling->cull(frustum);
+					if (result) {
+						visible = result->count();
+						result->free(page_allocator);
+					}
+				});
+				if (visible == 0) logError(name, " did not find anything");
+			}
+
+			if (isEnabled(multi_name)) {
+				// main camera and 4 shadow cascades in one traversal
+				ShiftedFrustum frusta[5];
+				frusta[0] = frustum;
+				for (u32 i = 1; i < lengthOf(frusta); ++i) {
+					const float size = 100.f * i;
+					frusta[i].computeOrtho(DVec3(0, 500, -size), Vec3(0, -1, 0), Vec3(0, 0, -1), size, size, 0, 1000.f);
+				}
+				CullResult* results[lengthOf(frusta)];
+				u32 visible = 0;
+				measure(multi_name, count, [&](){
+					culling->cull(Span<const ShiftedFrustum>(frusta, lengthOf(frusta)), Span(results));
+					visible = 0;
+					for (CullResult* result : results) {
+						if (!result) continue;
+						visible += result->count();
+						result->free(page_allocator);
+					}
+				});
+				if (visible == 0) logError(multi_name, " did not find anything");
+			}
+		}
+	}
+
+	void benchDrawStream(Renderer& renderer) {
+		static constexpr u32 COUNT = 10'000;
+		if (!isEnabled("DrawStream::record") && !isEnabled("DrawStream::run")) return;
+
+		u32 ub_offset;
+		const gpu::BufferHandle ub = renderer.getMaterialUniformBuffer(0, ub_offset);
+		Array<u64> record_ticks(allocator);
+		Array<u64> run_ticks(allocator);
+		for (u32 iter = 0; iter < cfg.iterations + 1; ++iter) {
+			DrawStream stream(renderer);
+			u64 start = os::Timer::getRawTimestamp();
+			for (u32 i = 0; i < COUNT; ++i) {
+				stream.viewport(0, 0, 256 + (i & 1), 256);
+				stream.scissor(0, 0, 256, 256 + (i & 1));
+				stream.bindUniformBuffer(2, ub, ub_offset, 256);
+			}
+			const u64 record = os::Timer::getRawTimestamp() - start;
+
+			// gpu calls are valid only on the render thread
+			renderer.waitForRender();
+			u64 run = 0;
+			jobs::Signal signal;
+			jobs::runLambda([&](){
+				const u64 run_start = os::Timer::getRawTimestamp();
+				stream.run();
+				run = os::Timer::getRawTimestamp() - run_start;
+			}, &signal, 1);
+			jobs::wait(&signal);
+
+			// first iteration is warmup
+			if (iter == 0) continue;
+			record_ticks.push(record);
+			run_ticks.push(run);
+		}
+		if (isEnabled("DrawStream::record")) add("DrawStream::record", COUNT * 3, record_ticks);
+		if (isEnabled("DrawStream::run")) add("DrawStream::run", COUNT * 3, run_ticks);
+	}
+
+	void benchTransforms(Engine& engine) {
+		static constexpr u32 CHAINS = 64;
+		const u32 depths[] = {1, 8, 64};
+		for (u32 depth : depths) {
+			const StaticString<64> name("Universe::setTransform/depth ", depth);
+			if (!isEnabled(name)) continue;
+
+			Universe universe(engine, allocator);
+			EntityRef roots[CHAINS];
+			for (u32 i = 0; i < CHAINS; ++i) {
+				roots[i] = universe.createEntity(DVec3(i, 0, 0), Quat::IDENTITY);
+				EntityRef parent = roots[i];
+				for (u32 j = 1; j < depth; ++j) {
+					const EntityRef e = universe.createEntity(DVec3(i, j, 0), Quat::IDENTITY);
+					universe.setParent(parent, e);
+					parent = e;
+				}
+			}
+
+			// moving a root moves the whole chain
+			u32 frame = 0;
+			measure(name, CHAINS * depth, [&](){
+				++frame;
+				for (EntityRef root : roots) {
+					universe.setTransform(root, DVec3(frame, 0, 0), Quat::IDENTITY, 1);
+				}
+			});
+		}
+	}
+
+	void benchStream() {
+		static constexpr u32 COUNT = 1 << 20;
+		measure("OutputMemoryStream::write/u32", COUNT, [&](){
+			OutputMemoryStream blob(allocator);
+			for (u32 i = 0; i < COUNT; ++i) blob.write(i);
+		});
+
+		measure("OutputMemoryStream::write/u32 reserved", COUNT, [&](){
+			OutputMemoryStream blob(allocator);
+			blob.reserve(COUNT * sizeof(u32));
+			for (u32 i = 0; i < COUNT; ++i) blob.write(i);
+		});
+
+		measure("OutputMemoryStream::write/64B", COUNT / 16, [&](){
+			OutputMemoryStream blob(allocator);
+			u8 tmp[64] = {};
+			for (u32 i = 0; i < COUNT / 16; ++i) blob.write(tmp, sizeof(tmp));
+		});
+	}
+
+	// compare the compiled simd backend with plain floats, build with LUMIX_NO_SIMD to measure the scalar fallback
+	void benchSIMD() {
+		#if defined LUMIX_SIMD_SSE
+			const char* backend = "sse";
+		#elif defined LUMIX_SIMD_NEON
+			const char* backend = "neon";
+		#else
+			const char* backend = "scalar";
+		#endif
+		static constexpr u32 COUNT = 1 << 16;
+		Array<float> a(allocator);
+		Array<float> b(allocator);
+		a.resize(COUNT);
+		b.resize(COUNT);
+		for (u32 i = 0; i < COUNT; ++i) {
+			a[i] = float(i);
+			b[i] = 1.f;
+		}
+
+		measure("float/muladd", COUNT, [&](){
+			for (u32 i = 0; i < COUNT; ++i) b[i] = a[i] * 0.5f + b[i];
+		});
+
+		const StaticString<64> name("float4/muladd ", backend);
+		measure(name, COUNT, [&](){
+			const float4 half = f4Splat(0.5f);
+			for (u32 i = 0; i < COUNT; i += 4) {
+				f4StoreUnaligned(&b[i], f4MulAdd(f4LoadUnaligned(&a[i]), half, f4LoadUnaligned(&b[i])));
+			}
+		});
+	}
+
+	// benchmarks which need the engine, i.e. renderer and universe
+	bool runEngine() {
+		Engine::InitArgs init_args;
+		init_args.window_title = "Engine benchmark";
+		init_args.hidden_window = true;
+		UniquePtr<Engine> engine = Engine::create(static_cast<Engine::InitArgs&&>(init_args), allocator);
+		Renderer* renderer = static_cast<Renderer*>(engine->getPluginManager().getPlugin("renderer"));
+		if (!renderer) {
+			logError("Renderer plugin is required");
+			return false;
+		}
+
+		benchAllocators();
+		benchHashMap();
+		benchCulling(engine->getPageAllocator());
+		benchDrawStream(*renderer);
+		benchTransforms(*engine);
+		benchStream();
+		benchSIMD();
+
+		renderer->waitForRender();
+		engine.reset();
+		return true;
+	}
+
+	const Config& cfg;
+	IAllocator& allocator;
+	Array<Result> results;
+};
+
+static bool writeResults(const Config& cfg, Span<const Result> results) {
+	os::OutputFile file;
+	if (!file.open(cfg.out)) {
+		debug::debugOutput(StaticString<LUMIX_MAX_PATH + 32>("Could not create ", cfg.out, "\n"));
+		return false;
+	}
+
+	const bool json = Path::hasExtension(cfg.out, "json");
+	if (json) {
+		file << "{\n\t\"iterations\": " << cfg.iterations << ",\n\t\"results\": [\n";
+		for (const Result& r : results) {
+			file << "\t\t{ \"name\": \"" << r.name.data << "\", \"ops\": " << r.ops << ", \"min_ns\": " << r.min_ns << ", \"median_ns\": " << r.median_ns << " }";
+			file << (&r == &results.back() ? "\n" : ",\n");
+		}
+		file << "\t]\n}\n";
+	}
+	else {
+		file << "name,ops,min_ns,median_ns\n";
+		for (const Result& r : results) {
+			file << r.name.data << "," << r.ops << "," << r.min_ns << "," << r.median_ns << "\n";
+		}
+	}
+	file.close();
+	if (file.isError()) debug::debugOutput(StaticString<LUMIX_MAX_PATH + 32>("Could not write ", cfg.out, "\n"));
+	return !file.isError();
+}
+
+// runs `f` in a job on worker 0 and waits for it
+template <typename F>
+static void runInJobs(u8 workers, IAllocator& allocator, F&& f) {
+	if (!jobs::init(workers, allocator)) {
+		debug::debugOutput("Failed to initialize job system.\n");
+		return;
+	}
+
+	struct Data {
+		Data(F& f) : f(f), semaphore(0, 1) {}
+		F& f;
+		Semaphore semaphore;
+	} data(f);
+
+	jobs::runEx(&data, [](void* ptr) {
+		Data* data = (Data*)ptr;
+		data->f();
+		data->semaphore.signal();
+	}, nullptr, 0);
+
+	data.semaphore.wait();
+	jobs::shutdown();
+}
+
+int main(int args, char* argv[]) {
+	profiler::setThreadName("Main thread");
+	DefaultAllocator allocator;
+	Config cfg;
+	if (!parseArgs(cfg)) return 1;
+
+	Bench bench(cfg, allocator);
+	const u32 cpus = os::getCPUsCount();
+	for (u32 w = 1; ; w = minimum(w * 2, cpus)) {
+		runInJobs((u8)minimum(w, 255), allocator, [&](){ bench.benchForEach((u8)jobs::getWorkersCount()); });
+		if (w == cpus) break;
+	}
+
+	bool success = false;
+	// renderer needs at least 2 workers, the render thread is pinned to worker 1
+	runInJobs((u8)clamp(cpus, 2u, 255u), allocator, [&](){ success = bench.runEngine(); });
+	if (!success) return 1;
+
+	return writeResults(cfg, bench.results) ? 0 : 1;
+}
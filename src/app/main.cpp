@@ -3,6 +3,7 @@
 #include "engine/allocators.h"
 #include "engine/atomic.h"
 #include "engine/command_line_parser.h"
+#include "engine/crt.h"
 #include "engine/debug.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
@@ -17,8 +18,11 @@
 #include "engine/resource_manager.h"
 #include "engine/thread.h"
 #include "engine/universe.h"
+#include "engine/world_partition.h"
 #include "gui/gui_system.h"
 #include "lua_script/lua_script_system.h"
+#include "renderer/draw2d.h"
+#include "renderer/font.h"
 #include "renderer/pipeline.h"
 #include "renderer/render_scene.h"
 #include "renderer/renderer.h"
@@ -45,16 +49,348 @@ struct GUIInterface : GUISystem::Interface {
 };
 
 
+// -benchmark <universe> flies a camera path at fixed time delta and writes frame time percentiles,
+// CPU time per scene and GPU time per pass as JSON, options:
+//	-benchmark_path <path>, recorded with -benchmark_record <path> during normal run, active camera does not move without it
+//	-benchmark_frames <count> used if there is no path, default 1000
+//	-benchmark_dt <seconds>, default 1/60
+//	-benchmark_out <path>, default benchmark.json
+//	-benchmark_offscreen <width> <height>, window is hidden and pipeline renders in this resolution
+// camera path is a text file with a "time px py pz rx ry rz rw" keyframe on each line
+struct RenderBenchmark {
+	static constexpr u32 WARMUP_FRAMES = 30;
+
+	struct Keyframe {
+		float time;
+		DVec3 pos;
+		Quat rot;
+	};
+
+	struct Timing {
+		StaticString<64> name;
+		double total_ms = 0;
+		float max_ms = 0;
+	};
+
+	RenderBenchmark(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_path(allocator)
+		, m_frame_times(allocator)
+		, m_cpu(allocator)
+		, m_gpu(allocator)
+		, m_pass_stats(allocator)
+		, m_recording(allocator)
+	{}
+
+	// returns true in benchmark mode
+	bool parseArgs() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		char tmp[32];
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (parser.currentEquals("-benchmark")) {
+				if (!parser.next()) break;
+				parser.getCurrent(m_universe, sizeof(m_universe));
+				m_is_active = true;
+			}
+			else if (parser.currentEquals("-benchmark_path")) {
+				if (!parser.next()) break;
+				parser.getCurrent(m_path_file, sizeof(m_path_file));
+			}
+			else if (parser.currentEquals("-benchmark_record")) {
+				if (!parser.next()) break;
+				parser.getCurrent(m_record_file, sizeof(m_record_file));
+			}
+			else if (parser.currentEquals("-benchmark_out")) {
+				if (!parser.next()) break;
+				parser.getCurrent(m_out, sizeof(m_out));
+			}
+			else if (parser.currentEquals("-benchmark_frames")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_frames);
+			}
+			else if (parser.currentEquals("-benchmark_dt")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				m_dt = (float)atof(tmp);
+			}
+			else if (parser.currentEquals("-benchmark_offscreen")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_offscreen_size.x);
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_offscreen_size.y);
+				m_offscreen = m_offscreen_size.x > 0 && m_offscreen_size.y > 0;
+			}
+		}
+		if (m_dt <= 0) m_dt = 1 / 60.f;
+		if (m_is_active && m_path_file[0] && !loadPath()) m_is_active = false;
+		return m_is_active;
+	}
+
+	bool loadPath() {
+		os::InputFile file;
+		if (!file.open(m_path_file)) {
+			logError("Could not open ", m_path_file);
+			return false;
+		}
+		OutputMemoryStream content(m_allocator);
+		content.resize(file.size());
+		const bool read = file.read(content.getMutableData(), content.size());
+		file.close();
+		if (!read) {
+			logError("Could not read ", m_path_file);
+			return false;
+		}
+		content.write('\0');
+
+		const char* c = (const char*)content.data();
+		auto next = [&]() -> double {
+			while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') ++c;
+			char tmp[32];
+			u32 len = 0;
+			while (*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') {
+				if (len < lengthOf(tmp) - 1) tmp[len++] = *c;
+				++c;
+			}
+			tmp[len] = '\0';
+			return atof(tmp);
+		};
+		for (;;) {
+			while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') ++c;
+			if (!*c) break;
+			Keyframe& k = m_path.emplace();
+			k.time = (float)next();
+			k.pos.x = next();
+			k.pos.y = next();
+			k.pos.z = next();
+			k.rot.x = (float)next();
+			k.rot.y = (float)next();
+			k.rot.z = (float)next();
+			k.rot.w = (float)next();
+			k.rot = normalize(k.rot);
+		}
+		if (m_path.empty()) {
+			logError(m_path_file, " does not contain any keyframe");
+			return false;
+		}
+		m_frames = u32(m_path.back().time / m_dt) + 1;
+		return true;
+	}
+
+	// normal run, current camera is recorded to -benchmark_record
+	void recordCamera(const Viewport& vp) {
+		if (!m_record_file[0]) return;
+		if (m_recording.empty()) {
+			m_record_timer.tick();
+			m_record_time = 0;
+		}
+		else {
+			m_record_time += m_record_timer.tick();
+		}
+		const float time = m_record_time;
+		StaticString<256> line(time, " ", vp.pos.x, " ", vp.pos.y, " ", vp.pos.z, " ", vp.rot.x, " ", vp.rot.y, " ", vp.rot.z, " ", vp.rot.w, "\n");
+		m_recording.write(line.data, stringLength(line.data));
+	}
+
+	void saveRecording() {
+		if (!m_record_file[0] || m_recording.empty()) return;
+		os::OutputFile file;
+		if (!file.open(m_record_file)) {
+			logError("Could not create ", m_record_file);
+			return;
+		}
+		if (!file.write(m_recording.data(), m_recording.size())) logError("Could not write ", m_record_file);
+		file.close();
+	}
+
+	// moves camera along the path, returns false once the benchmark is finished
+	bool setupCamera(Viewport& vp) {
+		if (m_frame >= WARMUP_FRAMES + m_frames) return false;
+		if (m_offscreen) {
+			vp.w = m_offscreen_size.x;
+			vp.h = m_offscreen_size.y;
+		}
+		if (m_path.empty()) return true;
+
+		const float time = m_frame < WARMUP_FRAMES ? 0 : (m_frame - WARMUP_FRAMES) * m_dt;
+		u32 i = 0;
+		while (i + 1 < (u32)m_path.size() && m_path[i + 1].time <= time) ++i;
+		if (i + 1 == (u32)m_path.size()) {
+			vp.pos = m_path[i].pos;
+			vp.rot = m_path[i].rot;
+			return true;
+		}
+		const Keyframe& a = m_path[i];
+		const Keyframe& b = m_path[i + 1];
+		const float t = b.time > a.time ? clamp((time - a.time) / (b.time - a.time), 0.f, 1.f) : 0;
+		vp.pos = a.pos + (b.pos - a.pos) * t;
+		vp.rot = nlerp(a.rot, b.rot, t);
+		return true;
+	}
+
+	static void addTiming(Array<Timing>& timings, const char* name, float ms) {
+		Timing* timing = nullptr;
+		for (Timing& t : timings) {
+			if (equalStrings(t.name, name)) {
+				timing = &t;
+				break;
+			}
+		}
+		if (!timing) {
+			timing = &timings.emplace();
+			timing->name = name;
+		}
+		timing->total_ms += ms;
+		timing->max_ms = maximum(timing->max_ms, ms);
+	}
+
+	// engine_ms, render_ms and renderer_ms are CPU times of main thread's engine update, pipeline setup and renderer frame
+	void endFrame(Engine& engine, Renderer& renderer, float frame_ms, float engine_ms, float render_ms, float renderer_ms) {
+		++m_frame;
+		if (m_frame <= WARMUP_FRAMES) return;
+
+		m_frame_times.push(frame_ms);
+		addTiming(m_cpu, "engine update", engine_ms);
+		addTiming(m_cpu, "pipeline render", render_ms);
+		addTiming(m_cpu, "renderer frame", renderer_ms);
+		for (const Engine::SceneUpdateTime& t : engine.getSceneUpdateTimes()) {
+			addTiming(m_cpu, StaticString<64>("scene ", t.name), t.ms);
+		}
+		// GPU results lag a few frames behind, so it's not exactly the same frames as on CPU
+		renderer.getGPUPassStats(m_pass_stats);
+		for (const Renderer::GPUPassStats& s : m_pass_stats) {
+			addTiming(m_gpu, s.name, s.last_ms);
+		}
+	}
+
+	static void writeTimings(os::OutputFile& file, const char* key, const Array<Timing>& timings, u32 frames) {
+		file << "\t\"" << key << "\": [\n";
+		for (const Timing& t : timings) {
+			file << "\t\t{ \"name\": \"" << t.name.data << "\", \"avg\": " << t.total_ms / frames << ", \"max\": " << t.max_ms << " }";
+			file << (&t == &timings.back() ? "\n" : ",\n");
+		}
+		file << "\t]";
+	}
+
+	bool writeResults() {
+		if (m_frame_times.empty()) {
+			logError("Benchmark did not run any frame");
+			return false;
+		}
+		const u32 frames = m_frame_times.size();
+		double total = 0;
+		for (float t : m_frame_times) total += t;
+		qsort(m_frame_times.begin(), frames, sizeof(m_frame_times[0]), [](const void* a, const void* b){
+			const float ta = *(const float*)a;
+			const float tb = *(const float*)b;
+			return ta < tb ? -1 : (ta > tb ? 1 : 0);
+		});
+		// nearest rank
+		auto percentile = [&](u32 p) { return m_frame_times[minimum(frames - 1, (frames * p + 99) / 100 - 1)]; };
+
+		os::OutputFile file;
+		if (!file.open(m_out)) {
+			logError("Could not create ", m_out);
+			return false;
+		}
+		file << "{\n\t\"universe\": \"" << m_universe << "\",\n\t\"frames\": " << frames << ",\n\t\"dt\": " << m_dt << ",\n";
+		if (m_offscreen) file << "\t\"resolution\": [" << m_offscreen_size.x << ", " << m_offscreen_size.y << "],\n";
+		file << "\t\"frame_ms\": { \"avg\": " << total / frames << ", \"p50\": " << percentile(50) << ", \"p95\": " << percentile(95)
+			<< ", \"p99\": " << percentile(99) << ", \"max\": " << m_frame_times.back() << " },\n";
+		writeTimings(file, "cpu_ms", m_cpu, frames);
+		file << ",\n";
+		writeTimings(file, "gpu_ms", m_gpu, frames);
+		file << "\n}\n";
+		file.close();
+		if (file.isError()) {
+			logError("Could not write ", m_out);
+			return false;
+		}
+		logInfo("Benchmark results written to ", m_out, ", p50 ", percentile(50), " ms, p99 ", percentile(99), " ms");
+		return true;
+	}
+
+	IAllocator& m_allocator;
+	bool m_is_active = false;
+	bool m_offscreen = false;
+	IVec2 m_offscreen_size = IVec2(1920, 1080);
+	char m_universe[96] = "";
+	char m_path_file[LUMIX_MAX_PATH] = "";
+	char m_record_file[LUMIX_MAX_PATH] = "";
+	char m_out[LUMIX_MAX_PATH] = "benchmark.json";
+	u32 m_frames = 1000;
+	float m_dt = 1 / 60.f;
+	u32 m_frame = 0;
+	Array<Keyframe> m_path;
+	Array<float> m_frame_times;
+	Array<Timing> m_cpu;
+	Array<Timing> m_gpu;
+	Array<Renderer::GPUPassStats> m_pass_stats;
+	OutputMemoryStream m_recording;
+	os::Timer m_record_timer;
+	float m_record_time = 0;
+};
+
 struct Runner final
 {
 	Runner() 
 		: m_allocator(m_main_allocator) 
+		, m_gpu_pass_stats(m_allocator)
+		, m_benchmark(m_allocator)
+		, m_server_universes(m_allocator)
 	{
-		if (!jobs::init(os::getCPUsCount(), m_allocator)) {
+		parseServerArgs();
+		const u32 workers = m_workers_count ? m_workers_count : os::getCPUsCount();
+		if (!jobs::init(workers, m_allocator, m_first_cpu)) {
 			logError("Failed to initialize job system.");
 		}
 	}
 
+	// -server runs a dedicated server - window is hidden, nothing is rendered and the game ticks at a fixed rate paced by sleeping, options:
+	//	-tick_rate <Hz>, default 30
+	//	-instances <count>, number of independent universes (matches) loaded from the startup universe and updated in parallel, default 1
+	//	-workers <count>, default is the number of CPUs, works without -server too
+	//	-first_cpu <index>, workers are pinned to CPUs starting with this one, so several servers can share a machine
+	void parseServerArgs() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		char tmp[32];
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (parser.currentEquals("-server")) {
+				m_is_server = true;
+			}
+			else if (parser.currentEquals("-tick_rate")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_tick_rate);
+			}
+			else if (parser.currentEquals("-instances")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_instances_count);
+			}
+			else if (parser.currentEquals("-workers")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_workers_count);
+			}
+			else if (parser.currentEquals("-first_cpu")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), m_first_cpu);
+			}
+		}
+		if (m_tick_rate == 0) m_tick_rate = 30;
+		if (m_instances_count == 0) m_instances_count = 1;
+	}
+
 	~Runner() {
 		jobs::shutdown();
 		ASSERT(!m_universe); 
@@ -108,7 +444,7 @@ struct Runner final
 		lua_scene->setScriptPath(env, 0, Path("pipelines/atmo.lua"));
 	}
 
-	bool loadUniverse(const char* path, const char* universe_name) {
+	bool loadUniverse(Universe& universe, const char* path, const char* universe_name) {
 		FileSystem& fs = m_engine->getFileSystem();
 		OutputMemoryStream data(m_allocator);
 		if (!fs.getContentSync(Path(path), data)) return false;
@@ -133,26 +469,118 @@ struct Runner final
 			}
 		}
 
-		m_universe->setName(universe_name);
-		if (!m_engine->deserialize(*m_universe, blob, entity_map)) {
+		universe.setName(universe_name);
+		if (!m_engine->deserialize(universe, blob, entity_map)) {
 			logError("Failed to deserialize ", path);
 			return false;
 		}
 		return true;
 	}
 
-	static bool isWindowCommandLineOption() {
+	// universes with entities in folders are partitioned by studio, see WorldEditor::saveUniverse
+	bool loadPartitionedUniverse(Universe& universe, const char* universe_name) {
+		FileSystem& fs = m_engine->getFileSystem();
+		const StaticString<LUMIX_MAX_PATH> path("universes/", universe_name, ".lwp");
+		if (!fs.fileExists(path)) return false;
+
+		OutputMemoryStream data(m_allocator);
+		if (!fs.getContentSync(Path(path), data)) return false;
+
+		universe.setName(universe_name);
+		m_world_partition = WorldPartition::create(*m_engine, universe, m_allocator);
+		InputMemoryStream blob(data);
+		if (!m_world_partition->load(blob)) {
+			logError("Failed to load ", path);
+			m_world_partition.reset();
+			return false;
+		}
+		updateWorldPartitionSource();
+		m_world_partition->flush();
+		return true;
+	}
+
+	// sectors are streamed around the active camera
+	void updateWorldPartitionSource() {
+		RenderScene* scene = (RenderScene*)m_universe->getScene("renderer");
+		const EntityPtr camera = scene->getActiveCamera();
+		if (camera == m_world_partition_source) return;
+
+		if (m_world_partition_source.isValid()) m_world_partition->removeSource((EntityRef)m_world_partition_source);
+		if (camera.isValid()) m_world_partition->addSource((EntityRef)camera);
+		m_world_partition_source = camera;
+	}
+
+	static bool hasCommandLineOption(const char* option) {
 		char cmd_line[2048];
 		os::getCommandLine(Span(cmd_line));
 
 		CommandLineParser parser(cmd_line);
 		while (parser.next())
 		{
-			if (parser.currentEquals("-window")) return true;
+			if (parser.currentEquals(option)) return true;
 		}
 		return false;
 	}
 
+	// -profiler_server <port> lets studio's profiler connect to this process
+	static void startProfilerServer() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-profiler_server")) continue;
+
+			u32 port = profiler::remote::DEFAULT_PORT;
+			if (parser.next()) {
+				char tmp[16];
+				parser.getCurrent(tmp, sizeof(tmp));
+				fromCString(Span(tmp, stringLength(tmp)), port);
+			}
+			if (profiler::startServer((u16)port)) {
+				logInfo("Profiler server listening on port ", port);
+			}
+			else {
+				logError("Failed to start profiler server on port ", port);
+			}
+			return;
+		}
+	}
+
+	// -profiler_trigger <frame ms>, -profiler_trigger_block <block name> <ms>, -profiler_capture_path <path prefix>
+	static void setProfilerCaptureTrigger() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		float frame_ms = 0;
+		float block_ms = 0;
+		char block_name[64] = "";
+		char path[LUMIX_MAX_PATH] = "profiler_capture_";
+		char tmp[32];
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (parser.currentEquals("-profiler_trigger")) {
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				frame_ms = (float)atof(tmp);
+			}
+			else if (parser.currentEquals("-profiler_trigger_block")) {
+				if (!parser.next()) break;
+				parser.getCurrent(block_name, sizeof(block_name));
+				if (!parser.next()) break;
+				parser.getCurrent(tmp, sizeof(tmp));
+				block_ms = (float)atof(tmp);
+			}
+			else if (parser.currentEquals("-profiler_capture_path")) {
+				if (!parser.next()) break;
+				parser.getCurrent(path, sizeof(path));
+			}
+		}
+		if (frame_ms > 0 || (block_name[0] && block_ms > 0)) {
+			profiler::setCaptureTrigger(frame_ms, block_name, block_ms, path);
+		}
+	}
+
 	void loadProject() {
 		FileSystem& fs = m_engine->getFileSystem();
 		OutputMemoryStream data(m_allocator);
@@ -166,8 +594,12 @@ struct Runner final
 	}
 
 	void onInit() {
+		startProfilerServer();
+		setProfilerCaptureTrigger();
+		const bool is_benchmark = m_benchmark.parseArgs();
 		Engine::InitArgs init_data;
 		init_data.window_title = "On the hunt";
+		init_data.hidden_window = (is_benchmark && m_benchmark.m_offscreen) || m_is_server;
 
 		if (os::fileExists("main.pak")) {
 			init_data.file_system = FileSystem::createPacked("main.pak", m_allocator);
@@ -175,37 +607,289 @@ struct Runner final
 
 		m_engine = Engine::create(static_cast<Engine::InitArgs&&>(init_data), m_allocator);
 		
-		if (!isWindowCommandLineOption()) {
+		if (!is_benchmark && !m_is_server && !hasCommandLineOption("-window")) {
 			os::setFullscreen(m_engine->getWindowHandle());
 			captureMouse(true);
 		}
 
 		m_universe = &m_engine->createUniverse(true);
-		initRenderPipeline();
+		if (m_is_server) {
+			// renderer plugin stays, scenes and resources (models, terrains) used by physics and navigation depend on it
+			m_renderer = static_cast<Renderer*>(m_engine->getPluginManager().getPlugin("renderer"));
+		}
+		else {
+			initRenderPipeline();
 		
-		auto* gui = static_cast<GUISystem*>(m_engine->getPluginManager().getPlugin("gui"));
-		m_gui_interface.pipeline = m_pipeline.get();
-		gui->setInterface(&m_gui_interface);
+			auto* gui = static_cast<GUISystem*>(m_engine->getPluginManager().getPlugin("gui"));
+			m_gui_interface.pipeline = m_pipeline.get();
+			gui->setInterface(&m_gui_interface);
+
+			// -gpu_stats shows GPU memory and pass timings overlay, F3 toggles it
+			m_show_gpu_stats = hasCommandLineOption("-gpu_stats");
+			m_gpu_stats_font_res = m_engine->getResourceManager().load<FontResource>(Path("editor/fonts/notosans-regular.ttf"));
+		}
 
 		loadProject();
+		if (is_benchmark) copyString(m_startup_universe, m_benchmark.m_universe);
 
 		const StaticString<LUMIX_MAX_PATH> unv_path("universes/", m_startup_universe, ".unv");
-		if (!loadUniverse(unv_path, m_startup_universe)) {
+		m_engine->getResourceManager().resetLoadStats();
+		if ((m_is_server || !loadPartitionedUniverse(*m_universe, m_startup_universe)) && !loadUniverse(*m_universe, unv_path, m_startup_universe)) {
 			initDemoScene();
 		}
+		if (m_is_server) {
+			m_server_universes.push(m_universe);
+			for (u32 i = 1; i < m_instances_count; ++i) {
+				Universe& universe = m_engine->createUniverse(false);
+				if (!loadUniverse(universe, unv_path, m_startup_universe)) {
+					m_engine->destroyUniverse(universe);
+					break;
+				}
+				m_server_universes.push(&universe);
+			}
+		}
 		os::showCursor(false);
 		while (m_engine->getFileSystem().hasWork()) {
 			os::sleep(10);
 			m_engine->getFileSystem().processCallbacks();
 		}
 		m_engine->getFileSystem().processCallbacks();
+		m_engine->getResourceManager().update();
+		writeLoadReport();
+		if (!m_is_server) warmupShaders();
 
 		os::showCursor(false);
 		onResize();
 		m_engine->startGame(*m_universe);
+		if (!m_is_server) initInputReplay();
+		if (is_benchmark) m_engine->setFixedTimeDelta(m_benchmark.m_dt);
+		if (m_is_server) {
+			for (u32 i = 1; i < (u32)m_server_universes.size(); ++i) m_engine->startGame(*m_server_universes[i]);
+			m_engine->setFixedTimeDelta(1.f / m_tick_rate);
+			m_next_tick = os::Timer::getRawTimestamp();
+			logInfo("Running as server, ", m_server_universes.size(), " instances, ", m_tick_rate, " ticks per second");
+		}
+	}
+
+	void serverTick() {
+		m_engine->update(m_server_universes);
+		// nothing is rendered, but commands from resource loading still need to be executed
+		m_renderer->frame();
+
+		const u64 freq = os::Timer::getFrequency();
+		m_next_tick += freq / m_tick_rate;
+		const u64 now = os::Timer::getRawTimestamp();
+		if (now >= m_next_tick) {
+			// tick took too long, do not try to catch up
+			m_next_tick = now;
+			return;
+		}
+		os::sleep(u32((m_next_tick - now) * 1000 / freq));
+	}
+
+	// -record_input <path> records time deltas, random seeds and input of every frame, it is saved on exit
+	// -replay_input <path> plays such recording back and quits when it ends, e.g. to profile a reported session
+	// -replay_out <path> writes CSV with per-frame times of the replay, to compare builds frame by frame
+	void initInputReplay() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		char replay_path[LUMIX_MAX_PATH] = "";
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (parser.currentEquals("-record_input")) {
+				if (!parser.next()) break;
+				parser.getCurrent(m_input_record_path, sizeof(m_input_record_path));
+			}
+			else if (parser.currentEquals("-replay_input")) {
+				if (!parser.next()) break;
+				parser.getCurrent(replay_path, sizeof(replay_path));
+			}
+			else if (parser.currentEquals("-replay_out")) {
+				if (!parser.next()) break;
+				char path[LUMIX_MAX_PATH];
+				parser.getCurrent(path, sizeof(path));
+				if (m_replay_out.open(path)) {
+					m_is_replay_out_open = true;
+					m_replay_out << "frame,frame_ms,update_ms,render_ms,renderer_ms\n";
+				}
+				else {
+					logError("Could not create ", path);
+				}
+			}
+		}
+
+		if (replay_path[0]) {
+			os::InputFile file;
+			if (!file.open(replay_path)) {
+				logError("Could not open ", replay_path);
+				return;
+			}
+			OutputMemoryStream content(m_allocator);
+			content.resize(file.size());
+			const bool read = file.read(content.getMutableData(), content.size());
+			file.close();
+			if (!read) {
+				logError("Could not read ", replay_path);
+				return;
+			}
+			m_is_replay = m_engine->startReplay(content);
+			if (m_is_replay) logInfo("Replaying ", replay_path);
+		}
+		else if (m_input_record_path[0]) {
+			m_engine->startRecording();
+		}
+	}
+
+	void saveInputRecording() {
+		if (m_is_replay_out_open) m_replay_out.close();
+		if (!m_input_record_path[0] || m_is_replay) return;
+
+		OutputMemoryStream recording(m_allocator);
+		m_engine->stopRecording(recording);
+		os::OutputFile file;
+		if (!file.open(m_input_record_path)) {
+			logError("Could not create ", m_input_record_path);
+			return;
+		}
+		if (!file.write(recording.data(), recording.size())) logError("Could not write ", m_input_record_path);
+		file.close();
+	}
+
+	// compile shaders recorded in studio now, so they do not hitch during the game
+	void warmupShaders() {
+		FileSystem& fs = m_engine->getFileSystem();
+		OutputMemoryStream data(m_allocator);
+		if (!fs.getContentSync(Path(Renderer::SHADER_USAGE_PATH), data)) return;
+		
+		InputMemoryStream blob(data);
+		if (!m_renderer->warmupShaders(blob)) return;
+
+		while (!m_renderer->isShaderWarmupFinished()) {
+			fs.processCallbacks();
+			m_renderer->frame();
+		}
+	}
+
+	// -load_report <path> writes load times per resource type and the critical path of the startup universe load
+	void writeLoadReport() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-load_report")) continue;
+			if (!parser.next()) {
+				logError("command line option '-load_report' without value");
+				return;
+			}
+
+			char path[LUMIX_MAX_PATH];
+			parser.getCurrent(path, lengthOf(path));
+			OutputMemoryStream report(m_allocator);
+			m_engine->getResourceManager().writeLoadReport(report);
+
+			os::OutputFile file;
+			if (!file.open(path)) {
+				logError("Could not open ", path);
+				return;
+			}
+			if (!file.write(report.data(), report.size())) logError("Could not write ", path);
+			file.close();
+			return;
+		}
+	}
+
+	// -profiler_trace <path> saves profiler data as Chrome trace JSON on exit, e.g. for headless runs
+	void exportProfilerTrace() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-profiler_trace")) continue;
+			if (!parser.next()) {
+				logError("command line option '-profiler_trace' without value");
+				return;
+			}
+
+			char path[LUMIX_MAX_PATH];
+			parser.getCurrent(path, lengthOf(path));
+			OutputMemoryStream blob(m_allocator);
+			OutputMemoryStream json(m_allocator);
+			profiler::serialize(blob);
+			profiler::exportChromeTrace(blob, json);
+
+			os::OutputFile file;
+			if (!file.open(path)) {
+				logError("Could not open ", path);
+				return;
+			}
+			if (!file.write(json.data(), json.size())) {
+				logError("Could not write ", path);
+			}
+			file.close();
+			return;
+		}
+	}
+
+	void drawGPUStats() {
+		if (!m_show_gpu_stats) return;
+		if (!m_gpu_stats_font) {
+			if (!m_gpu_stats_font_res->isReady()) return;
+			m_gpu_stats_font = m_gpu_stats_font_res->addRef(14);
+		}
+
+		const Font& font = *m_gpu_stats_font;
+		const float line_height = getAdvanceY(font);
+		Draw2D& draw = m_pipeline->getDraw2D();
+		Vec2 pos(10, 10 + getAscender(font));
+		auto line = [&](const char* text){
+			draw.addText(font, pos + Vec2(1, 1), Color::BLACK, text);
+			draw.addText(font, pos, Color::WHITE, text);
+			pos.y += line_height;
+		};
+		auto to_MB = [](u64 B){
+			return u32(B / (1024 * 1024));
+		};
+
+		const gpu::MemoryStats mem = m_renderer->getGPUMemoryStats();
+		line(StaticString<128>("Textures: ", to_MB(mem.texture_mem), " MB (", mem.texture_count, ")"));
+		line(StaticString<128>("Render targets: ", to_MB(mem.render_target_mem), " MB (", mem.render_target_count, ")"));
+		line(StaticString<128>("Buffers: ", to_MB(mem.buffer_mem), " MB (", mem.buffer_count, "), transient: ", to_MB(mem.transient_mem), " MB"));
+		if (mem.total_available_mem != 0) {
+			line(StaticString<128>("Available: ", to_MB(mem.current_available_mem), " / ", to_MB(mem.total_available_mem), " MB"));
+		}
+
+		pos.y += line_height;
+		line("GPU pass: last / avg / max ms");
+		m_renderer->getGPUPassStats(m_gpu_pass_stats);
+		for (const Renderer::GPUPassStats& s : m_gpu_pass_stats) {
+			char indent[16];
+			const u32 indent_len = minimum(s.depth * 2, lengthOf(indent) - 1);
+			memset(indent, ' ', indent_len);
+			indent[indent_len] = '\0';
+			char last[16], avg[16], max[16];
+			toCString(s.last_ms, Span(last), 2);
+			toCString(s.avg_ms, Span(avg), 2);
+			toCString(s.max_ms, Span(max), 2);
+			line(StaticString<128>(indent, s.name, ": ", last, " / ", avg, " / ", max));
+		}
 	}
 
 	void shutdown() {
+		m_benchmark.saveRecording();
+		saveInputRecording();
+		exportProfilerTrace();
+		profiler::stopServer();
+		if (m_gpu_stats_font) m_gpu_stats_font_res->removeRef(*m_gpu_stats_font);
+		if (m_gpu_stats_font_res) m_gpu_stats_font_res->decRefCount();
+		for (u32 i = 1; i < (u32)m_server_universes.size(); ++i) {
+			m_engine->stopGame(*m_server_universes[i]);
+			m_engine->destroyUniverse(*m_server_universes[i]);
+		}
+		m_server_universes.clear();
+		m_world_partition.reset();
 		m_engine->destroyUniverse(*m_universe);
 		auto* gui = static_cast<GUISystem*>(m_engine->getPluginManager().getPlugin("gui"));
 		gui->setInterface(nullptr);
@@ -239,6 +923,9 @@ struct Runner final
 				m_focused = event.focus.gained;
 				captureMouse(m_focused);
 				break;
+			case os::Event::Type::KEY:
+				if (event.key.down && event.key.keycode == os::Keycode::F3) m_show_gpu_stats = !m_show_gpu_stats;
+				break;
 			case os::Event::Type::QUIT:
 			case os::Event::Type::WINDOW_CLOSE: 
 				m_finished = true;
@@ -253,7 +940,18 @@ struct Runner final
 	}
 
 	void onIdle() {
+		if (m_is_server) {
+			serverTick();
+			return;
+		}
+
+		const u64 frame_start = os::Timer::getRawTimestamp();
+		if (m_world_partition) {
+			updateWorldPartitionSource();
+			m_world_partition->update();
+		}
 		m_engine->update(*m_universe);
+		const u64 update_end = os::Timer::getRawTimestamp();
 
 		EntityPtr camera = m_pipeline->getScene()->getActiveCamera();
 		if (camera.isValid()) {
@@ -264,9 +962,36 @@ struct Runner final
 			m_viewport.h = h;
 		}
 
+		if (m_benchmark.m_is_active) {
+			if (!m_benchmark.setupCamera(m_viewport)) {
+				m_benchmark.writeResults();
+				m_finished = true;
+				return;
+			}
+		}
+		else {
+			m_benchmark.recordCamera(m_viewport);
+		}
+
 		m_pipeline->setViewport(m_viewport);
+		drawGPUStats();
 		m_pipeline->render(false);
+		const u64 render_end = os::Timer::getRawTimestamp();
 		m_renderer->frame();
+
+		const u64 frame_end = os::Timer::getRawTimestamp();
+		auto to_ms = [](u64 ticks) { return float(ticks / double(os::Timer::getFrequency()) * 1000); };
+		if (m_benchmark.m_is_active) {
+			m_benchmark.endFrame(*m_engine, *m_renderer, to_ms(frame_end - frame_start), to_ms(update_end - frame_start), to_ms(render_end - update_end), to_ms(frame_end - render_end));
+		}
+		if (m_is_replay) {
+			if (m_is_replay_out_open) {
+				m_replay_out << m_replay_frame << "," << to_ms(frame_end - frame_start) << ","
+					<< to_ms(update_end - frame_start) << "," << to_ms(render_end - update_end) << "," << to_ms(frame_end - render_end) << "\n";
+			}
+			++m_replay_frame;
+			if (!m_engine->isReplaying()) m_finished = true;
+		}
 	}
 
 	DefaultAllocator m_main_allocator;
@@ -274,8 +999,28 @@ struct Runner final
 	UniquePtr<Engine> m_engine;
 	Renderer* m_renderer = nullptr;
 	Universe* m_universe = nullptr;
+	UniquePtr<WorldPartition> m_world_partition;
+	EntityPtr m_world_partition_source = INVALID_ENTITY;
 	UniquePtr<Pipeline> m_pipeline;
+	FontResource* m_gpu_stats_font_res = nullptr;
+	Font* m_gpu_stats_font = nullptr;
+	Array<Renderer::GPUPassStats> m_gpu_pass_stats;
+	bool m_show_gpu_stats = false;
+	RenderBenchmark m_benchmark;
+	char m_input_record_path[LUMIX_MAX_PATH] = "";
+	bool m_is_replay = false;
+	u32 m_replay_frame = 0;
+	os::OutputFile m_replay_out;
+	bool m_is_replay_out_open = false;
 	char m_startup_universe[96] = "main";
+	bool m_is_server = false;
+	u32 m_tick_rate = 30;
+	u32 m_instances_count = 1;
+	// m_universe is the first one
+	Array<Universe*> m_server_universes;
+	u32 m_workers_count = 0;
+	u32 m_first_cpu = 0;
+	u64 m_next_tick = 0;
 
 	Viewport m_viewport;
 	bool m_finished = false;
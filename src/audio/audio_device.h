@@ -25,6 +25,14 @@ struct Path;
 template <typename T> struct UniquePtr;
 
 
+// 16 bit PCM decoded while the sound is playing, e.g. long ogg clips
+struct AudioStream {
+	virtual ~AudioStream() {}
+	// offset and size in bytes of decoded data, returns number of bytes decoded, rest of data is zeroed
+	virtual u32 read(void* data, u32 offset, u32 size) = 0;
+};
+
+
 struct LUMIX_AUDIO_API AudioDevice
 {
 	enum class BufferFlags {
@@ -41,6 +49,8 @@ struct LUMIX_AUDIO_API AudioDevice
 	static UniquePtr<AudioDevice> create(Engine& engine);
 
 	virtual BufferHandle createBuffer(const void* data, int size_bytes, int channels, int sample_rate, int flags) = 0;
+	// stream must be alive until the buffer is stopped, size_bytes is size of all decoded data
+	virtual BufferHandle createBuffer(AudioStream& stream, int size_bytes, int channels, int sample_rate, int flags) = 0;
 	virtual void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
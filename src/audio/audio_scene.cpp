@@ -9,6 +9,7 @@
 #include "engine/hash.h"
 #include "engine/log.h"
 #include "engine/math.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
@@ -23,6 +24,7 @@ static const ComponentType LISTENER_TYPE = reflection::getComponentType("audio_l
 static const ComponentType AMBIENT_SOUND_TYPE = reflection::getComponentType("ambient_sound");
 static const ComponentType ECHO_ZONE_TYPE = reflection::getComponentType("echo_zone");
 static const ComponentType CHORUS_ZONE_TYPE = reflection::getComponentType("chorus_zone");
+static const float MIN_DISTANCE = 2; // sounds closer than this are not attenuated, same as in device
 
 struct Listener
 {
@@ -41,10 +43,21 @@ struct AmbientSound
 
 struct PlayingSound
 {
+	bool isActive() const { return buffer_id != AudioDevice::INVALID_BUFFER_HANDLE || is_virtual; }
+
 	AudioDevice::BufferHandle buffer_id;
 	EntityPtr entity;
 	Clip* clip = nullptr;
+	// decoder of streamed clip
+	AudioStream* stream = nullptr;
 	bool is_3d;
+	// virtual sound is not in the device, only its playback time is tracked
+	bool is_virtual = false;
+	bool is_paused = false;
+	float volume = 1;
+	u32 frequency = 0; // 0 - not set
+	i32 priority = 0;
+	float time = 0; // seconds, valid only for virtual sounds
 };
 
 
@@ -64,6 +77,7 @@ struct AudioSceneImpl final : AudioScene
 		, m_ambient_sounds(allocator)
 		, m_echo_zones(allocator)
 		, m_chorus_zones(allocator)
+		, m_moved(allocator)
 	{
 		m_listener.entity = INVALID_ENTITY;
 		for (auto& i : m_playing_sounds)
@@ -73,6 +87,16 @@ struct AudioSceneImpl final : AudioScene
 		}
 	}
 
+	~AudioSceneImpl() {
+		if (m_is_transformed_reader) m_universe.transformedEvents().removeReader(m_transformed_reader);
+		// device reads from streams until their buffers are stopped
+		for (PlayingSound& sound : m_playing_sounds) {
+			if (!sound.stream) continue;
+			m_device.stop(sound.buffer_id);
+			destroyStream(sound);
+		}
+	}
+
 	i32 getVersion() const override { return (i32)Version::LATEST; }
 
 	void clear() override 	{
@@ -85,6 +109,52 @@ struct AudioSceneImpl final : AudioScene
 	}
 
 
+	// position of a real sound is set in makeReal, afterwards only if its entity moved
+	void updateSourcePositions() {
+		PROFILE_FUNCTION();
+		// reader is added in the first update, so universes which are never updated, e.g. prefabs, do not buffer events
+		if (!m_is_transformed_reader) {
+			m_universe.transformedEvents().addReader(m_transformed_reader);
+			m_is_transformed_reader = true;
+			for (const PlayingSound& sound : m_playing_sounds) {
+				if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE || !sound.is_3d || !sound.entity.isValid()) continue;
+				m_device.setSourcePosition(sound.buffer_id, m_universe.getPosition((EntityRef)sound.entity));
+			}
+			return;
+		}
+
+		const Span<const EntityRef> moved = m_universe.transformedEvents().read(m_transformed_reader);
+		if (moved.length() == 0) return;
+
+		bool has_real_3d_sounds = false;
+		for (const PlayingSound& sound : m_playing_sounds) {
+			if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE && sound.is_3d && sound.entity.isValid()) {
+				has_real_3d_sounds = true;
+				break;
+			}
+		}
+		if (!has_real_3d_sounds) return;
+
+		for (EntityRef e : moved) {
+			if (e.index >= m_moved.size()) {
+				const i32 old_size = m_moved.size();
+				m_moved.resize(e.index + 1);
+				memset(m_moved.begin() + old_size, 0, m_moved.size() - old_size);
+			}
+			m_moved[e.index] = 1;
+		}
+
+		for (const PlayingSound& sound : m_playing_sounds) {
+			if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE || !sound.is_3d || !sound.entity.isValid()) continue;
+			
+			const EntityRef e = (EntityRef)sound.entity;
+			if (e.index < m_moved.size() && m_moved[e.index]) m_device.setSourcePosition(sound.buffer_id, m_universe.getPosition(e));
+		}
+
+		for (EntityRef e : moved) m_moved[e.index] = 0;
+	}
+
+
 	void updateAnimationEvents()
 	{
 		/*if (!m_animation_scene) return;
@@ -116,6 +186,10 @@ struct AudioSceneImpl final : AudioScene
 		}*/
 	}
 
+	SceneUpdateAccess getUpdateAccess() const override {
+		return {true, SceneUpdateAccess::TRANSFORMS, 0};
+	}
+
 	void update(float time_delta, bool paused) override
 	{
 		if (m_listener.entity.isValid())
@@ -129,20 +203,19 @@ struct AudioSceneImpl final : AudioScene
 			m_device.setListenerOrientation(front.x, front.y, front.z, up.x, up.y, up.z);
 		}
 
+		updateVoices(time_delta);
+		updateSourcePositions();
+
 		for (PlayingSound & sound : m_playing_sounds)
 		{
 			if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE) continue;
-			if (sound.is_3d && sound.entity.isValid())
-			{
-				const DVec3 pos = m_universe.getPosition((EntityRef)sound.entity);
-				m_device.setSourcePosition(sound.buffer_id, pos);
-			}
 
 			Clip* clip_info = sound.clip;
 			if (!clip_info->m_looped && m_device.isEnd(sound.buffer_id))
 			{
 				m_device.stop(sound.buffer_id);
 				sound.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+				destroyStream(sound);
 			}
 		}
 		m_device.update(time_delta);
@@ -151,6 +224,146 @@ struct AudioSceneImpl final : AudioScene
 	}
 
 
+	float getAudibility(const PlayingSound& sound) const {
+		if (!m_listener.entity.isValid()) return sound.volume;
+		return getAudibility(sound, m_universe.getPosition((EntityRef)m_listener.entity));
+	}
+
+
+	float getAudibility(const PlayingSound& sound, const DVec3& listener_pos) const {
+		if (!sound.is_3d || !sound.entity.isValid() || !m_listener.entity.isValid()) return sound.volume;
+
+		const float dist2 = (float)squaredLength(m_universe.getPosition((EntityRef)sound.entity) - listener_pos);
+		if (dist2 <= MIN_DISTANCE * MIN_DISTANCE) return sound.volume;
+		// sounds too far to reach the threshold are rejected without the sqrt
+		const float max_dist = sound.volume * MIN_DISTANCE / m_audibility_threshold;
+		if (dist2 > max_dist * max_dist) return 0;
+		return sound.volume * MIN_DISTANCE / sqrtf(dist2);
+	}
+
+
+	u32 getRealVoicesCount() const {
+		u32 count = 0;
+		for (const PlayingSound& sound : m_playing_sounds) {
+			if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE) ++count;
+		}
+		return count;
+	}
+
+
+	// sounds which can not be heard or are over the voice budget are virtual, i.e. not mixed by the device,
+	// they become real again, at their current playback time, once they are audible and in the budget
+	void updateVoices(float time_delta) {
+		PROFILE_FUNCTION();
+		struct Candidate {
+			SoundHandle handle;
+			i32 priority;
+			float audibility;
+		};
+		Candidate candidates[AudioDevice::MAX_PLAYING_SOUNDS];
+		u32 count = 0;
+		const DVec3 listener_pos = m_listener.entity.isValid() ? m_universe.getPosition((EntityRef)m_listener.entity) : DVec3(0);
+		for (PlayingSound& sound : m_playing_sounds) {
+			if (!sound.isActive()) continue;
+
+			if (sound.is_virtual && !sound.is_paused) {
+				sound.time += time_delta;
+				const float length = sound.clip->getLengthSeconds();
+				if (sound.time >= length) {
+					if (!sound.clip->m_looped) {
+						sound.is_virtual = false;
+						continue;
+					}
+					sound.time = length > 0 ? fmodf(sound.time, length) : 0;
+				}
+			}
+			candidates[count].handle = SoundHandle(&sound - m_playing_sounds);
+			candidates[count].priority = sound.priority;
+			candidates[count].audibility = getAudibility(sound, listener_pos);
+			++count;
+		}
+
+		qsort(candidates, count, sizeof(candidates[0]), [](const void* a, const void* b){
+			const Candidate& ca = *(const Candidate*)a;
+			const Candidate& cb = *(const Candidate*)b;
+			if (ca.priority != cb.priority) return ca.priority > cb.priority ? -1 : 1;
+			if (ca.audibility != cb.audibility) return ca.audibility > cb.audibility ? -1 : 1;
+			return 0;
+		});
+
+		u32 real_count = 0;
+		for (u32 i = 0; i < count; ++i) {
+			PlayingSound& sound = m_playing_sounds[candidates[i].handle];
+			const bool is_real = real_count < m_max_voices && candidates[i].audibility >= m_audibility_threshold;
+			if (is_real && sound.is_virtual) makeReal(sound);
+			else if (!is_real && !sound.is_virtual) makeVirtual(sound);
+			if (!sound.is_virtual) ++real_count;
+		}
+	}
+
+
+	void makeVirtual(PlayingSound& sound) {
+		sound.time = m_device.getCurrentTime(sound.buffer_id);
+		m_device.stop(sound.buffer_id);
+		sound.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+		destroyStream(sound);
+		sound.is_virtual = true;
+	}
+
+
+	// sound stays virtual if the device can not create a buffer
+	void makeReal(PlayingSound& sound) {
+		ASSERT(sound.is_virtual);
+		Clip* clip = sound.clip;
+		int flags = sound.is_3d ? (int)AudioDevice::BufferFlags::IS3D : 0;
+		if (sound.is_3d && clip->getChannels() > 1) {
+			logWarning(clip->getPath(), ": can not play sound with 2 channels as 3d");
+			flags = 0;
+		}
+		AudioDevice::BufferHandle buffer;
+		if (clip->isStreamed()) {
+			sound.stream = clip->createStream(m_allocator);
+			buffer = m_device.createBuffer(*sound.stream, clip->getSize(), clip->getChannels(), clip->getSampleRate(), flags);
+		}
+		else {
+			buffer = m_device.createBuffer(clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), flags);
+		}
+		if (buffer == AudioDevice::INVALID_BUFFER_HANDLE) {
+			destroyStream(sound);
+			return;
+		}
+
+		sound.buffer_id = buffer;
+		sound.is_virtual = false;
+		if (sound.time > 0) m_device.setCurrentTime(buffer, sound.time);
+		if (!sound.is_paused) m_device.play(buffer, clip->m_looped);
+		m_device.setVolume(buffer, sound.volume);
+		if (sound.frequency != 0) m_device.setFrequency(buffer, sound.frequency);
+
+		const DVec3 pos = sound.entity.isValid() ? m_universe.getPosition((EntityRef)sound.entity) : DVec3(0);
+		m_device.setSourcePosition(buffer, pos);
+
+		for (const EchoZone& zone : m_echo_zones) {
+			const double dist2 = squaredLength(pos - m_universe.getPosition(zone.entity));
+			const double r2 = zone.radius * zone.radius;
+			if (dist2 > r2) continue;
+
+			const float w = float(dist2 / r2);
+			m_device.setEcho(buffer, 1, 1 - w, zone.delay, zone.delay);
+			break;
+		}
+
+		for (const ChorusZone& zone : m_chorus_zones) {
+			const double dist2 = squaredLength(pos - m_universe.getPosition(zone.entity));
+			double r2 = zone.radius * zone.radius;
+			if (dist2 > r2) continue;
+
+			m_device.setChorus(buffer, 1, 1, 0, 1, zone.delay, 0);
+			break;
+		}
+	}
+
+
 	bool isAmbientSound3D(EntityRef entity) override
 	{
 		return m_ambient_sounds[entity].is_3d;
@@ -165,14 +378,18 @@ struct AudioSceneImpl final : AudioScene
 	void pauseAmbientSound(EntityRef entity) override {
 		const i32 idx = m_ambient_sounds[entity].playing_sound;
 		if (idx < 0) return;
-		m_device.pause(m_playing_sounds[idx].buffer_id);
+		PlayingSound& sound = m_playing_sounds[idx];
+		sound.is_paused = true;
+		if (!sound.is_virtual) m_device.pause(sound.buffer_id);
 	}
 
 	void resumeAmbientSound(EntityRef entity) override {
 		const AmbientSound& as = m_ambient_sounds[entity];
 		const i32 idx = as.playing_sound;
 		if (idx < 0) return;
-		m_device.play(m_playing_sounds[idx].buffer_id, as.clip->m_looped);
+		PlayingSound& sound = m_playing_sounds[idx];
+		sound.is_paused = false;
+		if (!sound.is_virtual) m_device.play(sound.buffer_id, as.clip->m_looped);
 	}
 
 	void startGame() override
@@ -194,7 +411,9 @@ struct AudioSceneImpl final : AudioScene
 			{
 				m_device.stop(i.buffer_id);
 				i.buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+				destroyStream(i);
 			}
+			i.is_virtual = false;
 		}
 
 		for (AmbientSound& sound : m_ambient_sounds)
@@ -390,65 +609,51 @@ struct AudioSceneImpl final : AudioScene
 	
 	SoundHandle play(EntityRef entity, Clip* clip, bool is_3d) override {
 		for (PlayingSound& sound : m_playing_sounds) {
-			if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE) {
-				if (!clip->isReady()) return INVALID_SOUND_HANDLE;
-
-				int flags = is_3d ? (int)AudioDevice::BufferFlags::IS3D : 0;
-				if (is_3d && clip->getChannels() > 1) {
-					logWarning(clip->getPath(), ": can not play sound with 2 channels as 3d");
-					flags = 0;
-				}
-				auto buffer = m_device.createBuffer(clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), flags);
-				if (buffer == AudioDevice::INVALID_BUFFER_HANDLE) return INVALID_SOUND_HANDLE;
-
-				m_device.play(buffer, clip->m_looped);
-				m_device.setVolume(buffer, clip->m_volume);
-
-				const DVec3 pos = m_universe.getPosition(entity);
-				m_device.setSourcePosition(buffer, pos);
-
-				sound.is_3d = is_3d;
-				sound.buffer_id = buffer;
-				sound.entity = entity;
-				clip->incRefCount();
-				sound.clip = clip;
-
-				for (const EchoZone& zone : m_echo_zones) {
-					const double dist2 = squaredLength(pos - m_universe.getPosition(zone.entity));
-					const double r2 = zone.radius * zone.radius;
-					if (dist2 > r2) continue;
-
-					const float w = float(dist2 / r2);
-					m_device.setEcho(buffer, 1, 1 - w, zone.delay, zone.delay);
-					break;
-				}
-
-				for (const ChorusZone& zone : m_chorus_zones) {
-					const double dist2 = squaredLength(pos - m_universe.getPosition(zone.entity));
-					double r2 = zone.radius * zone.radius;
-					if (dist2 > r2) continue;
-
-					m_device.setChorus(buffer, 1, 1, 0, 1, zone.delay, 0);
-					break;
-				}
-
-				return SoundHandle(&sound - m_playing_sounds);
-			}
+			if (sound.isActive()) continue;
+			if (!clip->isReady()) return INVALID_SOUND_HANDLE;
+
+			sound.is_3d = is_3d;
+			sound.entity = entity;
+			clip->incRefCount();
+			sound.clip = clip;
+			sound.is_virtual = true;
+			sound.is_paused = false;
+			sound.volume = clip->m_volume;
+			sound.frequency = 0;
+			sound.priority = 0;
+			sound.time = 0;
+
+			// the rest is resolved in updateVoices
+			if (getRealVoicesCount() < m_max_voices && getAudibility(sound) >= m_audibility_threshold) makeReal(sound);
+			return SoundHandle(&sound - m_playing_sounds);
 		}
 
 		return INVALID_SOUND_HANDLE;
 	}
 
+	// device does not use the stream after the buffer is stopped
+	void destroyStream(PlayingSound& sound) {
+		LUMIX_DELETE(m_allocator, sound.stream);
+		sound.stream = nullptr;
+	}
+
 	bool isEnd(SoundHandle sound_id) override {
 		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
-		return m_device.isEnd(m_playing_sounds[sound_id].buffer_id);
+		const PlayingSound& sound = m_playing_sounds[sound_id];
+		if (sound.is_virtual) return !sound.clip->m_looped && sound.time >= sound.clip->getLengthSeconds();
+		if (sound.buffer_id == AudioDevice::INVALID_BUFFER_HANDLE) return true;
+		return m_device.isEnd(sound.buffer_id);
 	}
 
 	void stop(SoundHandle sound_id) override
 	{
 		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
-		m_device.stop(m_playing_sounds[sound_id].buffer_id);
+		if (m_playing_sounds[sound_id].buffer_id != AudioDevice::INVALID_BUFFER_HANDLE) {
+			m_device.stop(m_playing_sounds[sound_id].buffer_id);
+		}
 		m_playing_sounds[sound_id].buffer_id = AudioDevice::INVALID_BUFFER_HANDLE;
+		m_playing_sounds[sound_id].is_virtual = false;
+		destroyStream(m_playing_sounds[sound_id]);
 		if (m_playing_sounds[sound_id].clip) {
 			m_playing_sounds[sound_id].clip->decRefCount();
 			m_playing_sounds[sound_id].clip = nullptr;
@@ -463,18 +668,36 @@ struct AudioSceneImpl final : AudioScene
 	{
 		ASSERT(sound_id != AudioScene::INVALID_SOUND_HANDLE);
 		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
-		m_device.setVolume(m_playing_sounds[sound_id].buffer_id, volume);
+		PlayingSound& sound = m_playing_sounds[sound_id];
+		sound.volume = volume;
+		if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE) m_device.setVolume(sound.buffer_id, volume);
 	}
 
 	void setFrequency(SoundHandle sound_id, u32 frequency) override {
 		ASSERT(sound_id != AudioScene::INVALID_SOUND_HANDLE);
 		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
-		m_device.setFrequency(m_playing_sounds[sound_id].buffer_id, frequency);
+		PlayingSound& sound = m_playing_sounds[sound_id];
+		sound.frequency = frequency;
+		if (sound.buffer_id != AudioDevice::INVALID_BUFFER_HANDLE) m_device.setFrequency(sound.buffer_id, frequency);
+	}
+
+	void setPriority(SoundHandle sound_id, i32 priority) override {
+		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
+		m_playing_sounds[sound_id].priority = priority;
 	}
 
+	bool isVirtual(SoundHandle sound_id) override {
+		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
+		return m_playing_sounds[sound_id].is_virtual;
+	}
+
+	void setMaxVoices(u32 count) override { m_max_voices = minimum(count, (u32)AudioDevice::MAX_PLAYING_SOUNDS); }
+	void setAudibilityThreshold(float threshold) override { m_audibility_threshold = threshold; }
+
 	void setEcho(SoundHandle sound_id, float wet_dry_mix, float feedback, float left_delay, float right_delay) override
 	{
 		ASSERT(sound_id >= 0 && sound_id < (int)lengthOf(m_playing_sounds));
+		if (m_playing_sounds[sound_id].buffer_id == AudioDevice::INVALID_BUFFER_HANDLE) return;
 		m_device.setEcho(m_playing_sounds[sound_id].buffer_id, wet_dry_mix, feedback, left_delay, right_delay);
 	}
 
@@ -490,7 +713,14 @@ struct AudioSceneImpl final : AudioScene
 	Universe& m_universe;
 	AudioSystem& m_system;
 	PlayingSound m_playing_sounds[AudioDevice::MAX_PLAYING_SOUNDS];
+	EventChannel<EntityRef>::Reader m_transformed_reader;
+	bool m_is_transformed_reader = false;
+	// indexed by entity, set for entities moved since the last update, while updating source positions
+	Array<u8> m_moved;
 	AnimationScene* m_animation_scene = nullptr;
+	u32 m_max_voices = 32;
+	// sounds quieter than this, after distance attenuation, are virtual
+	float m_audibility_threshold = 0.01f;
 };
 
 
@@ -510,6 +740,10 @@ void AudioScene::reflect(Engine& engine) {
 		.LUMIX_FUNC(AudioScene::setFrequency)
 		.LUMIX_FUNC(AudioScene::setVolume)
 		.LUMIX_FUNC(AudioScene::setEcho)
+		.LUMIX_FUNC(AudioScene::setPriority)
+		.LUMIX_FUNC(AudioScene::isVirtual)
+		.LUMIX_FUNC(AudioScene::setMaxVoices)
+		.LUMIX_FUNC(AudioScene::setAudibilityThreshold)
 		.LUMIX_CMP(AmbientSound, "ambient_sound", "Audio / Ambient sound")
 			.LUMIX_FUNC_EX(AudioScene::pauseAmbientSound, "pause")
 			.LUMIX_FUNC_EX(AudioScene::resumeAmbientSound, "resume")
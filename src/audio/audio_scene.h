@@ -73,6 +73,12 @@ struct AudioScene : IScene
 	virtual void stop(SoundHandle sound_id) = 0;
 	virtual void setVolume(SoundHandle sound_id, float volume) = 0;
 	virtual void setFrequency(SoundHandle sound_id, u32 frequency_hz) = 0;
+	// sounds with higher priority are real first when there are more sounds than max voices
+	virtual void setPriority(SoundHandle sound_id, i32 priority) = 0;
+	// virtual sound is playing but not mixed, because it can not be heard or it's over the voice budget
+	virtual bool isVirtual(SoundHandle sound_id) = 0;
+	virtual void setMaxVoices(u32 count) = 0;
+	virtual void setAudibilityThreshold(float threshold) = 0;
 
 	virtual void setEcho(SoundHandle sound_id,
 		float wet_dry_mix,
@@ -1,4 +1,5 @@
 #include "clip.h"
+#include "audio_device.h"
 #include "engine/allocator.h"
 #include "engine/crt.h"
 #include "engine/lumix.h"
@@ -20,6 +21,50 @@ const ResourceType Clip::TYPE("clip");
 void Clip::unload()
 {
 	m_data.clear();
+	m_compressed.clear();
+	m_stream_size = 0;
+}
+
+
+struct OggStream final : AudioStream {
+	OggStream(const Array<u8>& data, int channels)
+		: channels(channels)
+	{
+		vorbis = stb_vorbis_open_memory(data.begin(), data.size(), nullptr, nullptr);
+	}
+
+	~OggStream() {
+		if (vorbis) stb_vorbis_close(vorbis);
+	}
+
+	u32 read(void* data, u32 offset, u32 size) override {
+		const u32 frame_size = channels * sizeof(short);
+		if (!vorbis) {
+			memset(data, 0, size);
+			return 0;
+		}
+
+		if (offset != cursor) {
+			stb_vorbis_seek(vorbis, offset / frame_size);
+			cursor = offset - offset % frame_size;
+		}
+
+		const i32 frames = stb_vorbis_get_samples_short_interleaved(vorbis, channels, (short*)data, size / sizeof(short));
+		const u32 decoded = frames * frame_size;
+		cursor += decoded;
+		if (decoded < size) memset((u8*)data + decoded, 0, size - decoded);
+		return decoded;
+	}
+
+	stb_vorbis* vorbis;
+	int channels;
+	u32 cursor = 0;
+};
+
+
+AudioStream* Clip::createStream(IAllocator& allocator) {
+	ASSERT(isStreamed());
+	return LUMIX_NEW(allocator, OggStream)(m_compressed, m_channels);
 }
 
 struct WAVHeader {
@@ -45,12 +90,14 @@ bool Clip::load(u64 size, const u8* mem)
 {
 	PROFILE_FUNCTION();
 	InputMemoryStream blob(mem, size);
-	const u32 version = blob.read<u32>();
-	if (version != 0) return false;
+	const Version version = blob.read<Version>();
+	if (version > Version::LATEST) return false;
 
 	const Format format = blob.read<Format>();
 	m_looped = blob.read<bool>();
 	m_volume = blob.read<float>();
+	m_streamed = false;
+	if (version > Version::FIRST) m_streamed = blob.read<bool>();
 	switch(format) {
 		case Format::WAV: {
 			WAVHeader header = blob.read<WAVHeader>();
@@ -73,6 +120,23 @@ bool Clip::load(u64 size, const u8* mem)
 		}
 		case Format::OGG: {
 			PROFILE_BLOCK("ogg");
+			const u8* ogg_data = (const u8*)blob.skip(0);
+			const u32 ogg_size = u32(size - blob.getPosition());
+			if (m_streamed || ogg_size > STREAM_THRESHOLD) {
+				// only the header is parsed here, audio is decoded while playing
+				stb_vorbis* vorbis = stb_vorbis_open_memory(ogg_data, ogg_size, nullptr, nullptr);
+				if (!vorbis) return false;
+				const stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+				m_channels = info.channels;
+				m_sample_rate = info.sample_rate;
+				m_stream_size = stb_vorbis_stream_length_in_samples(vorbis) * m_channels * sizeof(short);
+				stb_vorbis_close(vorbis);
+
+				m_compressed.resize(ogg_size);
+				memcpy(m_compressed.begin(), ogg_data, ogg_size);
+				return m_stream_size > 0;
+			}
+
 			short* output = nullptr;
 			auto res = stb_vorbis_decode_memory((unsigned char*)blob.skip(0), (int)(size - blob.getPosition()), &m_channels, &m_sample_rate, &output);
 			if (res <= 0) return false;
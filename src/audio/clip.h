@@ -8,6 +8,9 @@
 namespace Lumix {
 
 
+struct AudioStream;
+
+
 struct Clip final : Resource
 {
 	enum class Format : u8 {
@@ -18,27 +21,47 @@ struct Clip final : Resource
 	Clip(const Path& path, ResourceManager& manager, IAllocator& allocator)
 		: Resource(path, manager, allocator)
 		, m_data(allocator)
+		, m_compressed(allocator)
 	{
 	}
 
+	enum class Version : u32 {
+		FIRST,
+		STREAMED,
+
+		LATEST
+	};
+
+	// ogg files bigger than this are decoded while playing, unless the clip is explicitly streamed
+	static constexpr u32 STREAM_THRESHOLD = 512 * 1024;
+
 	ResourceType getType() const override { return TYPE; }
 
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
 	int getChannels() const { return m_channels; }
 	int getSampleRate() const { return m_sample_rate; }
-	int getSize() const { return m_data.size() * sizeof(m_data[0]); }
-	u16* getData() { return m_data.begin(); }
-	float getLengthSeconds() const { return m_data.size() / float(m_channels * m_sample_rate); }
+	// size of decoded data in bytes
+	int getSize() const { return isStreamed() ? m_stream_size : m_data.size() * sizeof(m_data[0]); }
+	// nullptr for streamed clips, use createStream
+	u16* getData() { return isStreamed() ? nullptr : m_data.begin(); }
+	float getLengthSeconds() const { return getSize() / float(sizeof(u16) * m_channels * m_sample_rate); }
+	bool isStreamed() const { return !m_compressed.empty(); }
+	// each playing sound needs its own stream, destroy it with LUMIX_DELETE
+	AudioStream* createStream(IAllocator& allocator);
 
 	static const ResourceType TYPE;
 	bool m_looped = false;
 	float m_volume = 1;
+	bool m_streamed = false;
 
 private:
 	int m_channels;
 	int m_sample_rate;
 	Array<u16> m_data;
+	// ogg data of streamed clip
+	Array<u8> m_compressed;
+	int m_stream_size = 0;
 };
 
 
@@ -37,6 +37,8 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 	struct Meta {
 		bool looped = true;
 		float volume = 1.f;
+		// decode while playing, big files are streamed even without this
+		bool streamed = false;
 	};
 
 	Meta getMeta(const Path& path) const {
@@ -44,6 +46,7 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		m_app.getAssetCompiler().getMeta(path, [&meta](lua_State* L){
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "looped", &meta.looped);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "volume", &meta.volume);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "streamed", &meta.streamed);
 		});
 		return meta;
 	}
@@ -57,11 +60,12 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 
 		OutputMemoryStream compiled(m_app.getAllocator());
 		compiled.reserve(64 + src_data.size());
-		compiled.write((u32)0);
+		compiled.write(Clip::Version::LATEST);
 		const bool is_wav = Path::hasExtension(src.c_str(), "wav");
 		compiled.write(is_wav ? Clip::Format::WAV : Clip::Format::OGG);
 		compiled.write(meta.looped);
 		compiled.write(meta.volume);
+		compiled.write(meta.streamed);
 		compiled.write(src_data.data(), src_data.size());
 		return m_app.getAssetCompiler().writeCompiledResource(src.c_str(), Span(compiled.data(), (i32)compiled.size()));
 	}
@@ -79,6 +83,8 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 
 		getAudioDevice(m_app.getEngine()).stop(m_playing_clip);
 		m_playing_clip = -1;
+		LUMIX_DELETE(m_app.getAllocator(), m_playing_stream);
+		m_playing_stream = nullptr;
 	}
 
 
@@ -98,6 +104,8 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		bool changed = ImGui::Checkbox("##loop", &m_meta.looped);
 		ImGuiEx::Label("Volume");
 		changed = ImGui::DragFloat("##vol", &m_meta.volume, 0.01f, 0, FLT_MAX) || changed;
+		ImGuiEx::Label("Streamed");
+		changed = ImGui::Checkbox("##streamed", &m_meta.streamed) || changed;
 
 		auto* clip = static_cast<Clip*>(resources[0]);
 		ImGuiEx::Label("Length");
@@ -123,18 +131,30 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		{
 			stopAudio();
 
-			AudioDevice::BufferHandle handle = device.createBuffer(clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), 0);
+			AudioDevice::BufferHandle handle;
+			if (clip->isStreamed()) {
+				m_playing_stream = clip->createStream(m_app.getAllocator());
+				handle = device.createBuffer(*m_playing_stream, clip->getSize(), clip->getChannels(), clip->getSampleRate(), 0);
+			}
+			else {
+				handle = device.createBuffer(clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), 0);
+			}
 			if (handle != AudioDevice::INVALID_BUFFER_HANDLE) {
 				device.setVolume(handle, clip->m_volume);
 				device.play(handle, true);
 				m_playing_clip = handle;
 			}
+			else {
+				LUMIX_DELETE(m_app.getAllocator(), m_playing_stream);
+				m_playing_stream = nullptr;
+			}
 		}
 
 		ImGui::SameLine();
 		if (ImGui::Button(ICON_FA_CHECK "Apply")) {
 			const StaticString<512> src("volume = ", m_meta.volume
 				, "\nlooped = ", m_meta.looped ? "true" : "false"
+				, "\nstreamed = ", m_meta.streamed ? "true" : "false"
 			);
 			AssetCompiler& compiler = m_app.getAssetCompiler();
 			compiler.updateMeta(resources[0]->getPath(), src);
@@ -159,6 +179,7 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 
 
 	int m_playing_clip;
+	AudioStream* m_playing_stream = nullptr;
 	StudioApp& m_app;
 	AssetBrowser& m_browser;
 	Meta m_meta;
@@ -5,6 +5,7 @@
 #include "engine/plugin.h"
 #include "engine/log.h"
 #include "engine/math.h"
+#include "engine/simd.h"
 #include "engine/sync.h"
 #include "engine/thread.h"
 #include "engine/os.h"
@@ -32,6 +33,13 @@ struct AudioTask : Thread
 
 struct AudioDeviceImpl : AudioDevice
 {
+	static constexpr u32 RESAMPLER_TAPS = 8;
+	static constexpr u32 RESAMPLER_PHASE_BITS = 5;
+	static constexpr u32 RESAMPLER_PHASES = 1 << RESAMPLER_PHASE_BITS;
+	static constexpr u64 STEP_ONE = u64(1) << 32;
+	static constexpr u32 MAX_STEP = 4;
+	static constexpr u32 MIX_CHUNK = 256; // output frames mixed at once
+
 	struct Buffer
 	{
 		enum class RuntimeFlags
@@ -42,16 +50,38 @@ struct AudioDeviceImpl : AudioDevice
 		};
 
 		Buffer(IAllocator& allocator) : data(allocator) {}
+
+		int getSize() const { return stream ? stream_size : data.size(); }
+
+		void resetResampler() {
+			fraction = 0;
+			memset(history, 0, sizeof(history));
+		}
 		
 		Array<u8> data;
+		// data are decoded from stream while mixing if it's not null
+		AudioStream* stream = nullptr;
+		int stream_size = 0;
 		int channels;
 		int sample_rate;
 		int flags;
-		int cursor;
+		int cursor; // bytes, next source frame to read
 		u8 runtime_flags;
+		float volume = 1;
+		// source frames per output frame, 32.32 fixed point
+		u64 step = STEP_ONE;
+		u32 fraction = 0;
+		// last source frames read, input of the resampling filter
+		float history[RESAMPLER_TAPS];
 	};
 
 
+	u64 getStep(u32 frequency_hz) const {
+		const u64 step = (u64(frequency_hz) << 32) / m_output_rate;
+		return minimum(step, MAX_STEP * STEP_ONE);
+	}
+
+
 	BufferHandle createBuffer(const void* data,
 		int size_bytes,
 		int channels,
@@ -71,6 +101,9 @@ struct AudioDeviceImpl : AudioDevice
 			buffer.data.resize(size_bytes);
 			buffer.runtime_flags = (u8)Buffer::RuntimeFlags::READY;
 			buffer.cursor = 0;
+			buffer.volume = 1;
+			buffer.step = getStep(sample_rate);
+			buffer.resetResampler();
 			memcpy(&buffer.data[0], data, size_bytes);
 
 			return i;
@@ -79,6 +112,37 @@ struct AudioDeviceImpl : AudioDevice
 	}
 
 
+	BufferHandle createBuffer(AudioStream& stream,
+		int size_bytes,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		MutexGuard lock(m_mutex);
+		ASSERT(flags == 0); // nothing else supported yet
+		for(int i = 0, c = m_buffers.size(); i < c; ++i)
+		{
+			Buffer& buffer = m_buffers[i];
+			if((buffer.runtime_flags & (u8)Buffer::RuntimeFlags::READY)) continue;
+
+			buffer.channels = channels;
+			buffer.sample_rate = sample_rate;
+			buffer.flags = flags;
+			buffer.data.clear();
+			buffer.stream = &stream;
+			buffer.stream_size = size_bytes;
+			buffer.runtime_flags = (u8)Buffer::RuntimeFlags::READY;
+			buffer.cursor = 0;
+			buffer.volume = 1;
+			buffer.step = getStep(sample_rate);
+			buffer.resetResampler();
+
+			return i;
+		}
+		return INVALID_BUFFER_HANDLE;
+	}
+
+
 	void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
@@ -103,35 +167,103 @@ struct AudioDeviceImpl : AudioDevice
 	}
 
 
-	void mix(u16* output, int size_bytes)
+	// voices are resampled and accumulated to a float bus, which is clamped and converted to output once
+	void mix(i16* output, u32 frames)
 	{
-		memset(output, 0, size_bytes);
-
 		MutexGuard lock(m_mutex);
-		for (Buffer& buffer : m_buffers)
-		{
-			if((buffer.runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING) == 0) continue;
-			
-			mixBuffer(output, size_bytes, buffer);
+		alignas(16) float bus[MIX_CHUNK];
+		const float4 lo = f4Splat(-1);
+		const float4 hi = f4Splat(1);
+		const float4 scale = f4Splat(32767.f * m_master_volume);
+		for (u32 offset = 0; offset < frames; offset += MIX_CHUNK) {
+			const u32 count = minimum(MIX_CHUNK, frames - offset);
+			ASSERT(count % 4 == 0);
+			memset(bus, 0, sizeof(bus));
+			for (Buffer& buffer : m_buffers)
+			{
+				if((buffer.runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING) == 0) continue;
+				
+				mixBuffer(bus, count, buffer);
+			}
+
+			i16* out = output + offset;
+			for (u32 i = 0; i < count; i += 4) {
+				const float4 v = f4Mul(f4Min(f4Max(f4Load(&bus[i]), lo), hi), scale);
+				alignas(16) float tmp[4];
+				f4Store(tmp, v);
+				out[i + 0] = (i16)tmp[0];
+				out[i + 1] = (i16)tmp[1];
+				out[i + 2] = (i16)tmp[2];
+				out[i + 3] = (i16)tmp[3];
+			}
+		}
+	}
+
+
+	// reads `count` source frames, wraps looped buffers, silence after the end of others
+	void readFrames(Buffer& buffer, float* out, u32 count)
+	{
+		const int size = buffer.getSize();
+		const bool is_looped = buffer.runtime_flags & (u8)Buffer::RuntimeFlags::LOOPED;
+		while (count > 0) {
+			if (buffer.cursor >= size) {
+				if (!is_looped || size == 0) {
+					memset(out, 0, count * sizeof(out[0]));
+					return;
+				}
+				buffer.cursor = 0;
+			}
+
+			i16 tmp[MIX_CHUNK];
+			const u32 to_read = minimum(count, (u32)lengthOf(tmp), u32(size - buffer.cursor) / sizeof(i16));
+			// streams are decoded here, on the audio thread, in chunks of the mix size
+			if (buffer.stream) buffer.stream->read(tmp, buffer.cursor, to_read * sizeof(i16));
+			else memcpy(tmp, &buffer.data[buffer.cursor], to_read * sizeof(i16));
+			for (u32 i = 0; i < to_read; ++i) out[i] = tmp[i] * (1 / 32768.f);
+			buffer.cursor += to_read * sizeof(i16);
+			out += to_read;
+			count -= to_read;
 		}
 	}
 
 
-	void mixBuffer(u16* output, int size_bytes, Buffer& buffer)
+	void mixBuffer(float* bus, u32 frames, Buffer& buffer)
 	{
 		ASSERT(buffer.runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING);
 		ASSERT(buffer.channels == 1); // nothing else supported yet
-		if (buffer.cursor >= buffer.data.size()) return;
-		int total = size_bytes;
-		bool is_looped = buffer.runtime_flags & (u8)Buffer::RuntimeFlags::LOOPED;
-		do
-		{
-			int to_copy = minimum(total, buffer.data.size() - buffer.cursor);
-			memcpy(output, &buffer.data[buffer.cursor], to_copy);
-			buffer.cursor += to_copy;
-			if(is_looped) buffer.cursor = buffer.cursor % buffer.data.size();
-			total -= to_copy;
-		} while(total > 0 && is_looped);
+		const bool is_looped = buffer.runtime_flags & (u8)Buffer::RuntimeFlags::LOOPED;
+		if (!is_looped && buffer.cursor >= buffer.getSize()) return;
+
+		alignas(16) float src[RESAMPLER_TAPS + MAX_STEP * MIX_CHUNK + 1];
+		alignas(16) float voice[MIX_CHUNK];
+		memcpy(src, buffer.history, sizeof(buffer.history));
+		const u64 end = buffer.fraction + frames * buffer.step;
+		const u32 consumed = u32(end >> 32);
+		readFrames(buffer, src + RESAMPLER_TAPS, consumed);
+
+		if (buffer.step == STEP_ONE && buffer.fraction == 0) {
+			// phase 0 of the filter is a delayed copy
+			memcpy(voice, src + RESAMPLER_TAPS / 2 - 1, frames * sizeof(voice[0]));
+		}
+		else {
+			// cost per output frame does not depend on frequency
+			u64 pos = buffer.fraction;
+			for (u32 i = 0; i < frames; ++i) {
+				const float* s = src + (pos >> 32);
+				const float* f = m_resampling_filter[u32(pos >> (32 - RESAMPLER_PHASE_BITS)) & (RESAMPLER_PHASES - 1)];
+				float4 acc = f4Mul(f4LoadUnaligned(s), f4LoadUnaligned(f));
+				acc = f4MulAdd(f4LoadUnaligned(s + 4), f4LoadUnaligned(f + 4), acc);
+				voice[i] = f4GetX(acc) + f4GetY(acc) + f4GetZ(acc) + f4GetW(acc);
+				pos += buffer.step;
+			}
+		}
+		memcpy(buffer.history, src + consumed, sizeof(buffer.history));
+		buffer.fraction = u32(end);
+
+		const float4 gain = f4Splat(buffer.volume);
+		for (u32 i = 0; i < frames; i += 4) {
+			f4Store(&bus[i], f4MulAdd(f4Load(&voice[i]), gain, f4Load(&bus[i])));
+		}
 	}
 
 	void play(BufferHandle buffer, bool looped) override 
@@ -164,6 +296,12 @@ struct AudioDeviceImpl : AudioDevice
 		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
 		m_buffers[buffer].runtime_flags &= ~(u8)Buffer::RuntimeFlags::PLAYING;
 		m_buffers[buffer].cursor = 0;
+		m_buffers[buffer].resetResampler();
+		// stream is destroyed by its owner after stop, so the buffer can not be played again
+		if (m_buffers[buffer].stream) {
+			m_buffers[buffer].stream = nullptr;
+			m_buffers[buffer].runtime_flags = 0;
+		}
 	}
 
 
@@ -171,7 +309,7 @@ struct AudioDeviceImpl : AudioDevice
 	{ 
 		MutexGuard lock(m_mutex);
 		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		return m_buffers[buffer].cursor >= m_buffers[buffer].data.size();
+		return m_buffers[buffer].cursor >= m_buffers[buffer].getSize();
 	}
 
 
@@ -186,7 +324,7 @@ struct AudioDeviceImpl : AudioDevice
 	void setMasterVolume(float volume) override 
 	{
 		MutexGuard lock(m_mutex);
-		ASSERT(false); // not implemented yet
+		m_master_volume = volume;
 	}
 
 
@@ -194,7 +332,7 @@ struct AudioDeviceImpl : AudioDevice
 	{
 		MutexGuard lock(m_mutex);
 		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		ASSERT(false); // not implemented yet
+		m_buffers[buffer].volume = volume;
 	}
 
 
@@ -202,7 +340,7 @@ struct AudioDeviceImpl : AudioDevice
 	{
 		MutexGuard lock(m_mutex);
 		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		ASSERT(false); // not implemented yet
+		m_buffers[buffer].step = getStep(frequency_hz);
 	}
 
 
@@ -212,10 +350,13 @@ struct AudioDeviceImpl : AudioDevice
 		ASSERT(m_buffers[handle].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
 		
 		Buffer& buffer = m_buffers[handle];
-		float length = float(buffer.data.size() / double(buffer.sample_rate * 2 * buffer.channels));
+		const int size = buffer.getSize();
+		float length = float(size / double(buffer.sample_rate * 2 * buffer.channels));
 		float rel = time_seconds / length;
-		buffer.cursor = rel * buffer.data.size();
-		buffer.cursor = clamp(buffer.cursor, 0, buffer.data.size());
+		buffer.cursor = rel * size;
+		buffer.cursor = clamp(buffer.cursor, 0, size);
+		buffer.cursor -= buffer.cursor % (2 * buffer.channels);
+		buffer.resetResampler();
 	}
 
 
@@ -225,8 +366,9 @@ struct AudioDeviceImpl : AudioDevice
 		ASSERT(m_buffers[handle].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
 		
 		Buffer& buffer = m_buffers[handle];
-		float length = float(buffer.data.size() / double(buffer.sample_rate * 2 * buffer.channels));
-		return float(length * double(buffer.cursor) / buffer.data.size());
+		const int size = buffer.getSize();
+		float length = float(size / double(buffer.sample_rate * 2 * buffer.channels));
+		return float(length * double(buffer.cursor) / size);
 	}
 
 
@@ -273,6 +415,20 @@ struct AudioDeviceImpl : AudioDevice
 			Buffer& buffer = m_buffers.emplace(m_allocator);
 			buffer.runtime_flags = 0;
 		}
+
+		// blackman windowed sinc, phase 0 is a unit impulse at RESAMPLER_TAPS / 2 - 1
+		for (u32 phase = 0; phase < RESAMPLER_PHASES; ++phase) {
+			float sum = 0;
+			for (u32 tap = 0; tap < RESAMPLER_TAPS; ++tap) {
+				const float x = float(tap) - (RESAMPLER_TAPS / 2 - 1) - phase / float(RESAMPLER_PHASES);
+				const float sinc = fabsf(x) < 1e-5f ? 1 : sinf(PI * x) / (PI * x);
+				const float t = (x + RESAMPLER_TAPS / 2) / RESAMPLER_TAPS;
+				const float window = 0.42f - 0.5f * cosf(2 * PI * t) + 0.08f * cosf(4 * PI * t);
+				m_resampling_filter[phase][tap] = sinc * window;
+				sum += sinc * window;
+			}
+			for (float& v : m_resampling_filter[phase]) v /= sum;
+		}
 	}
 
 
@@ -359,6 +515,7 @@ struct AudioDeviceImpl : AudioDevice
 		res = m_api.snd_pcm_start(m_device);
 		if(res < 0) goto error;
 
+		m_output_rate = rate;
 		logInfo("PCM name: '", m_api.snd_pcm_name(m_device), "'");
 		logInfo("PCM state: '", m_api.snd_pcm_state(m_device), "'");
 
@@ -410,6 +567,9 @@ struct AudioDeviceImpl : AudioDevice
 	void* m_alsa_lib = nullptr;
 	snd_pcm_t* m_device = nullptr;
 	API m_api;
+	u32 m_output_rate = 44100;
+	float m_master_volume = 1;
+	float m_resampling_filter[RESAMPLER_PHASES][RESAMPLER_TAPS];
 };
 
 
@@ -424,14 +584,14 @@ int AudioTask::task()
 {
 	while(!m_finished)
 	{
-		u16 buffer[2*1024];
+		i16 buffer[2*1024];
 		int frames_avail = lengthOf(buffer);
-		m_device.mix(buffer, frames_avail * 2);
+		m_device.mix(buffer, frames_avail);
 
-		u16* iter = buffer;
+		i16* iter = buffer;
 		while(frames_avail > 0)
 		{		
-			snd_pcm_sframes_t frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, buffer, frames_avail);
+			snd_pcm_sframes_t frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, iter, frames_avail);
 			if (frames_written < 0)
 			{
 				if (frames_written == -EAGAIN) continue;
@@ -444,7 +604,7 @@ int AudioTask::task()
 						break;
 					}
 
-					frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, buffer, frames_avail);
+					frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, iter, frames_avail);
 					if (frames_written < 0)
 					{
 						handleError(recover_result);
@@ -477,6 +637,14 @@ struct NullAudioDevice final : AudioDevice
 	{
 		return INVALID_BUFFER_HANDLE;
 	}
+	BufferHandle createBuffer(AudioStream& stream,
+		int size_bytes,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return INVALID_BUFFER_HANDLE;
+	}
 	void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
@@ -21,6 +21,8 @@ struct AudioDeviceImpl final : AudioDevice
 		LPDIRECTSOUND3DBUFFER8 handle_3d;
 		LPDIRECTSOUNDBUFFER8 handle8;
 		const void* data;
+		// if not null, data are decoded from stream when they are written to the buffer
+		AudioStream* stream;
 		DWORD data_size;
 		DWORD written;
 		i32 sparse_idx;
@@ -140,11 +142,38 @@ struct AudioDeviceImpl final : AudioDevice
 	}
 
 
+	static void readData(const Buffer& buffer, void* dst, DWORD offset, DWORD size) {
+		if (buffer.stream) buffer.stream->read(dst, offset, size);
+		else memcpy(dst, (const u8*)buffer.data + offset, size);
+	}
+
+
 	BufferHandle createBuffer(const void* data,
 		int data_size,
 		int channels,
 		int sample_rate,
 		int flags) override
+	{
+		return createBuffer(data, nullptr, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(AudioStream& stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return createBuffer(nullptr, &stream, data_size, channels, sample_rate, flags);
+	}
+
+
+	BufferHandle createBuffer(const void* data,
+		AudioStream* stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags)
 	{
 		if (m_buffer_count == MAX_PLAYING_SOUNDS) return INVALID_BUFFER_HANDLE;
 
@@ -177,7 +206,8 @@ struct AudioDeviceImpl final : AudioDevice
 			buffer->Release();
 			return INVALID_BUFFER_HANDLE;
 		}
-		memcpy(p1, data, s1);
+		if (stream) stream->read(p1, 0, s1);
+		else memcpy(p1, data, s1);
 		if (!SUCCEEDED(buffer->Unlock(p1, s1, p2, s2))) {
 			buffer->Release();
 			return INVALID_BUFFER_HANDLE;
@@ -202,6 +232,7 @@ struct AudioDeviceImpl final : AudioDevice
 				handle = m_buffer_count;
 				m_buffers[m_buffer_count].handle = buffer;
 				m_buffers[m_buffer_count].data = data;
+				m_buffers[m_buffer_count].stream = stream;
 				m_buffers[m_buffer_count].data_size = data_size;
 				m_buffers[m_buffer_count].written = buffer_size;
 				m_buffers[m_buffer_count].sparse_idx = i;
@@ -455,16 +486,16 @@ struct AudioDeviceImpl final : AudioDevice
 				memset(p, 0, size);
 			}
 			else if (written + size > buffer.data_size) {
-				memcpy(p, (u8*)buffer.data + written, buffer.data_size - written);
+				readData(buffer, p, written, buffer.data_size - written);
 				void* p_2 = (u8*)p + (buffer.data_size - written);
 				const DWORD size_2 = size - (buffer.data_size - written);
 				if (buffer.looped) {
-					memcpy(p_2, buffer.data, size_2);
+					readData(buffer, p_2, 0, size_2);
 				} else {
 					memset(p_2, 0, size_2);
 				}
 			} else {
-				memcpy(p, (u8*)buffer.data + written, size);
+				readData(buffer, p, written, size);
 			}
 
 			buffer.written += size;
@@ -540,6 +571,14 @@ struct NullAudioDevice final : AudioDevice
 	{
 		return INVALID_BUFFER_HANDLE;
 	}
+	BufferHandle createBuffer(AudioStream& stream,
+		int size_bytes,
+		int channels,
+		int sample_rate,
+		int flags) override
+	{
+		return INVALID_BUFFER_HANDLE;
+	}
 	void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
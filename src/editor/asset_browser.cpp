@@ -95,12 +95,20 @@ void AssetBrowser::Plugin::gui(Span<Resource*> resources) {
 }
 
 struct AssetBrowserImpl : AssetBrowser {
+	// max time per frame spent on checking, loading and creating tiles
+	static constexpr float TILE_REQUESTS_BUDGET_MS = 2;
+	// tiles which are being created or failed are checked again after this many frames
+	static constexpr u32 TILE_RETRY_FRAMES = 30;
+
 	struct FileInfo {
 		StaticString<LUMIX_MAX_PATH> clamped_filename;
 		StaticString<LUMIX_MAX_PATH> filepath;
 		FilePathHash file_path_hash;
 		void* tex = nullptr;
 		bool create_called = false;
+		bool requested = false;
+		u32 last_visible_frame = 0;
+		u32 retry_frame = 0;
 	};
 
 	struct ImmediateTile : FileInfo {
@@ -118,6 +126,7 @@ struct AssetBrowserImpl : AssetBrowser {
 		, m_show_subresources(true)
 		, m_file_infos(app.getAllocator())
 		, m_immediate_tiles(app.getAllocator())
+		, m_tile_requests(app.getAllocator())
 		, m_subdirs(app.getAllocator())
 	{
 		m_filter[0] = '\0';
@@ -168,6 +177,7 @@ struct AssetBrowserImpl : AssetBrowser {
 			ri->unloadTexture(info.tex);
 		}
 		m_immediate_tiles.clear();
+		m_tile_requests.clear();
 	}
 
 
@@ -289,9 +299,60 @@ struct AssetBrowserImpl : AssetBrowser {
 			}
 		}
 
+		++m_frame;
+		processTileRequests();
+
 		for (auto* plugin : m_plugins) plugin->update();
 	}
 
+	FileInfo* getTileInfo(FilePathHash hash) {
+		for (FileInfo& fi : m_file_infos) {
+			if (fi.file_path_hash == hash) return &fi;
+		}
+		for (FileInfo& fi : m_immediate_tiles) {
+			if (fi.file_path_hash == hash) return &fi;
+		}
+		return nullptr;
+	}
+
+	// visible tiles only put a request here, the most recent requests (i.e. what's on screen now) are handled first
+	// and only as many as fit in the time budget, so scrolling through big directories does not stutter
+	void processTileRequests() {
+		if (m_tile_requests.empty()) return;
+		PROFILE_FUNCTION();
+
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		RenderInterface* ri = m_app.getRenderInterface();
+		const u64 start = os::Timer::getRawTimestamp();
+		const u64 budget = u64(os::Timer::getFrequency() * TILE_REQUESTS_BUDGET_MS / 1000);
+		while (!m_tile_requests.empty() && os::Timer::getRawTimestamp() - start < budget) {
+			const FilePathHash hash = m_tile_requests.back();
+			m_tile_requests.pop();
+			FileInfo* tile = getTileInfo(hash);
+			if (!tile) continue;
+
+			tile->requested = false;
+			// scrolled out of view, it's requested again when it becomes visible
+			if (tile->last_visible_frame + 1 < m_frame) continue;
+			if (tile->tex) continue;
+
+			const StaticString<LUMIX_MAX_PATH> path(".lumix/asset_tiles/", hash, ".lbc");
+			switch (getState(*tile, fs)) {
+				case TileState::OK:
+					tile->tex = ri->loadTexture(Path(path));
+					break;
+				case TileState::NOT_CREATED:
+				case TileState::OUTDATED:
+					createTile(*tile, path);
+					tile->retry_frame = m_frame + TILE_RETRY_FRAMES;
+					break;
+				case TileState::DELETED:
+					tile->retry_frame = m_frame + TILE_RETRY_FRAMES;
+					break;
+			}
+		}
+	}
+
 	void addTile(const Path& path) {
 		if (!m_show_subresources && contains(path.c_str(), ':')) return;
 		if (m_filter[0] && !stristr(path.c_str(), m_filter)) return;
@@ -324,6 +385,7 @@ struct AssetBrowserImpl : AssetBrowser {
 			ri->unloadTexture(info.tex);
 		}
 		m_file_infos.clear();
+		m_tile_requests.clear();
 
 		Path::normalize(path, Span(m_dir.data));
 		if (push_history) pushDirHistory(m_dir);
@@ -346,21 +408,23 @@ struct AssetBrowserImpl : AssetBrowser {
 		char tmp[LUMIX_MAX_PATH];
 		makeLowercase(Span(tmp), m_dir.data);
 		const RuntimeHash dir_hash(equalStrings(".", tmp) ? "" : tmp);
-		auto& resources = compiler.lockResources();
 		if (m_filter[0]) {
-			for (const AssetCompiler::ResourceItem& res : resources) {
-				if (tmp[0] != '.' && tmp[1] != '\'' && !startsWithInsensitive(res.path.c_str(), tmp)) continue;
-				addTile(res.path);
+			Array<Path> found(m_app.getAllocator());
+			compiler.findResources(m_filter, found);
+			for (const Path& path : found) {
+				if (tmp[0] != '.' && tmp[1] != '\'' && !startsWithInsensitive(path.c_str(), tmp)) continue;
+				addTile(path);
 			}
 		}
 		else {
+			auto& resources = compiler.lockResources();
 			for (const AssetCompiler::ResourceItem& res : resources) {
 				if (res.dir_hash != dir_hash) continue;
 				addTile(res.path);
 			}
+			compiler.unlockResources();
 		}
 		sortTiles();
-		compiler.unlockResources();
 	}
 
 	void sortTiles() {
@@ -501,19 +565,10 @@ struct AssetBrowserImpl : AssetBrowser {
 		else
 		{
 			ImGuiEx::Rect(img_size.x, img_size.y, 0xffffFFFF);
-			StaticString<LUMIX_MAX_PATH> compiled_asset_path(".lumix/resources/", tile.file_path_hash, ".res");
-			StaticString<LUMIX_MAX_PATH> path(".lumix/asset_tiles/", tile.file_path_hash, ".lbc");
-			FileSystem& fs = m_app.getEngine().getFileSystem();
-			switch (getState(tile, fs)) {
-				case TileState::OK:
-					tile.tex = ri->loadTexture(Path(path));
-					break;
-				case TileState::NOT_CREATED:
-				case TileState::OUTDATED:
-					createTile(tile, path);
-					break;
-				case TileState::DELETED:
-					break;
+			tile.last_visible_frame = m_frame;
+			if (!tile.requested && m_frame >= tile.retry_frame) {
+				tile.requested = true;
+				m_tile_requests.push(tile.file_path_hash);
 			}
 		}
 		ImVec2 text_size = ImGui::CalcTextSize(tile.clamped_filename);
@@ -543,6 +598,7 @@ struct AssetBrowserImpl : AssetBrowser {
 			if (fi.file_path_hash == hash) {
 				m_app.getRenderInterface()->unloadTexture(fi.tex);
 				fi.tex = nullptr;
+				fi.retry_frame = 0;
 				break;
 			}
 		}
@@ -749,6 +805,20 @@ struct AssetBrowserImpl : AssetBrowser {
 		}
 	}
 
+	void dependentsGUI(const Path& path) {
+		if (!ImGui::CollapsingHeader("Used by")) return;
+
+		Array<Path> dependents(m_app.getAllocator());
+		m_app.getAssetCompiler().getDependents(path, dependents);
+		if (dependents.empty()) ImGui::TextUnformatted("Nothing");
+		for (const Path& dependent : dependents) {
+			if (ImGui::Selectable(dependent.c_str())) {
+				selectResource(dependent, true, false);
+				break;
+			}
+		}
+	}
+
 	void detailsGUI()
 	{
 		m_details_focused = false;
@@ -797,6 +867,7 @@ struct AssetBrowserImpl : AssetBrowser {
 						selectResource(Path(getResourceFilePath(m_selected_resources[0]->getPath().c_str())), true, false);
 					}
 				}
+				dependentsGUI(Path(getResourceFilePath(path)));
 			}
 			else {
 				ImGui::Separator();
@@ -1247,11 +1318,13 @@ struct AssetBrowserImpl : AssetBrowser {
 		ImGui::BeginChild("Resources", ImVec2(0, 200), false, ImGuiWindowFlags_HorizontalScrollbar);
 		AssetCompiler& compiler = m_app.getAssetCompiler();
 	
+		Array<Path> found(m_app.getAllocator());
+		if (filter[0] != '\0') compiler.findResources(filter, found);
 		const auto& resources = compiler.lockResources();
 		Path selected_path;
-		for (const auto& res : resources) {
-			if(res.type != type) continue;
-			if (filter[0] != '\0' && stristr(res.path.c_str(), filter) == nullptr) continue;
+		// returns true if the resource is picked
+		auto resource_gui = [&](const AssetCompiler::ResourceItem& res) {
+			if(res.type != type) return false;
 
 			const bool selected = selected_path_hash == res.path.getHash();
 			if(selected) selected_path = res.path;
@@ -1264,12 +1337,31 @@ struct AssetBrowserImpl : AssetBrowser {
 			
 				if (selected || ImGui::IsMouseDoubleClicked(0) || is_enter_submit) {
 					copyString(buf, res.path.c_str());
-					ImGui::CloseCurrentPopup();
-					ImGui::EndChild();
-					compiler.unlockResources();
 					return true;
 				}
 			}
+			return false;
+		};
+
+		bool picked = false;
+		if (filter[0] != '\0') {
+			for (const Path& path : found) {
+				auto iter = resources.find(path.getHash());
+				picked = iter.isValid() && resource_gui(iter.value());
+				if (picked) break;
+			}
+		}
+		else {
+			for (const auto& res : resources) {
+				picked = resource_gui(res);
+				if (picked) break;
+			}
+		}
+		if (picked) {
+			ImGui::CloseCurrentPopup();
+			ImGui::EndChild();
+			compiler.unlockResources();
+			return true;
 		}
 		ImGui::EndChild();
 		ImGui::Separator();
@@ -1355,6 +1447,8 @@ struct AssetBrowserImpl : AssetBrowser {
 	Array<StaticString<LUMIX_MAX_PATH> > m_subdirs;
 	Array<FileInfo> m_file_infos;
 	Array<ImmediateTile> m_immediate_tiles;
+	Array<FilePathHash> m_tile_requests;
+	u32 m_frame = 0;
 	
 	Array<Path> m_history;
 	i32 m_history_index = -1;
@@ -7,6 +7,7 @@
 #include "editor/utils.h"
 #include "editor/world_editor.h"
 #include "engine/atomic.h"
+#include "engine/command_line_parser.h"
 #include "engine/engine.h"
 #include "engine/hash.h"
 #include "engine/job_system.h"
@@ -58,6 +59,67 @@ struct AssetCompilerTask : Thread
 };
 
 
+// compiled resources shared between machines, keyed by AssetCompilerImpl::getCacheKey
+// entry: CacheEntryHeader, dependencies (path string, u64 content hash), outputs (u64 path hash, u64 size, .res file content)
+struct SharedCache {
+	virtual ~SharedCache() {}
+	virtual bool read(StableHash key, OutputMemoryStream& entry) = 0;
+	virtual bool write(StableHash key, Span<const u8> entry) = 0;
+};
+
+// e.g. a network share
+struct DirectoryCache final : SharedCache {
+	DirectoryCache(const char* dir) {
+		Path::normalize(dir, Span(m_dir.data));
+		if (!endsWith(m_dir, "/")) m_dir << '/';
+	}
+
+	bool read(StableHash key, OutputMemoryStream& entry) override {
+		const StaticString<LUMIX_MAX_PATH> path(m_dir, key.getHashValue(), ".lce");
+		os::InputFile file;
+		if (!file.open(path)) return false;
+		entry.resize(file.size());
+		const bool res = file.read(entry.getMutableData(), entry.size());
+		file.close();
+		return res;
+	}
+
+	bool write(StableHash key, Span<const u8> entry) override {
+		// other machines can read the entry while it's written, so it's written under a temporary name and renamed
+		const StaticString<LUMIX_MAX_PATH> path(m_dir, key.getHashValue(), ".lce");
+		const StaticString<LUMIX_MAX_PATH> tmp_path(path, os::Timer::getRawTimestamp(), ".tmp");
+		os::OutputFile file;
+		if (!file.open(tmp_path)) return false;
+		const bool res = file.write(entry.begin(), entry.length());
+		file.close();
+		if (!res || file.isError() || !os::moveFile(tmp_path, path)) {
+			os::deleteFile(tmp_path);
+			return false;
+		}
+		return true;
+	}
+
+	StaticString<LUMIX_MAX_PATH> m_dir;
+};
+
+struct CacheEntryHeader {
+	static constexpr u32 MAGIC = 'LCEN';
+	u32 magic = MAGIC;
+	u32 version = 0;
+};
+
+// what a compile running on this thread writes, stored in the shared cache when the compile finishes
+struct CacheRecord {
+	CacheRecord(IAllocator& allocator) : dependencies(allocator), outputs(allocator) {}
+
+	Array<Path> dependencies;
+	OutputMemoryStream outputs;
+	u32 output_count = 0;
+};
+
+static thread_local CacheRecord* g_cache_record = nullptr;
+
+
 void AssetCompiler::IPlugin::addSubresources(AssetCompiler& compiler, const char* path)
 {
 	const ResourceType type = compiler.getResourceType(path);
@@ -68,9 +130,16 @@ void AssetCompiler::IPlugin::addSubresources(AssetCompiler& compiler, const char
 
 
 struct AssetCompilerImpl : AssetCompiler {
+	// part of the shared cache key, bump when compiled resources change for reasons plugins' versions do not cover
+	static constexpr u32 COMPILER_VERSION = 0;
+	// watcher events are collected until nothing changes for this long, tools usually write many files at once
+	static constexpr float CHANGES_DEBOUNCE_TIME = 0.2f;
+
 	struct CompileJob {
 		u32 generation;
 		Path path;
+		// plugin is not thread safe
+		bool serial = true;
 	};
 
 	struct LoadHook : ResourceManagerHub::LoadHook
@@ -90,12 +159,14 @@ struct AssetCompilerImpl : AssetCompiler {
 		: m_app(app)
 		, m_load_hook(*this)
 		, m_plugins(app.getAllocator())
-		, m_task(*this, app.getAllocator())
+		, m_tasks(app.getAllocator())
+		, m_in_progress(app.getAllocator())
 		, m_to_compile(app.getAllocator())
 		, m_compiled(app.getAllocator())
 		, m_semaphore(0, 0x7fFFffFF)
 		, m_registered_extensions(app.getAllocator())
 		, m_resources(app.getAllocator())
+		, m_search_index(app.getAllocator())
 		, m_generations(app.getAllocator())
 		, m_dependencies(app.getAllocator())
 		, m_changed_files(app.getAllocator())
@@ -109,7 +180,8 @@ struct AssetCompilerImpl : AssetCompiler {
 		const char* base_path = fs.getBasePath();
 		m_watcher = FileSystemWatcher::create(base_path, app.getAllocator());
 		m_watcher->getCallback().bind<&AssetCompilerImpl::onFileChanged>(this);
-		m_task.create("Asset compiler", true);
+		createTasks();
+		createSharedCache();
 		StaticString<LUMIX_MAX_PATH> path(base_path, ".lumix/resources");
 		if (!os::dirExists(path)) {
 			if (!os::makePath(path)) logError("Could not create ", path);
@@ -196,10 +268,18 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 
 		ASSERT(m_plugins.empty());
-		m_task.m_finished = true;
-		m_to_compile.emplace();
-		m_semaphore.signal();
-		m_task.destroy();
+		{
+			MutexGuard lock(m_to_compile_mutex);
+			for (AssetCompilerTask* task : m_tasks) {
+				task->m_finished = true;
+				m_to_compile.emplace();
+				m_semaphore.signal();
+			}
+		}
+		for (AssetCompilerTask* task : m_tasks) {
+			task->destroy();
+			LUMIX_DELETE(m_app.getAllocator(), task);
+		}
 		ResourceManagerHub& rm = m_app.getEngine().getResourceManager();
 		rm.setLoadHook(nullptr);
 	}
@@ -210,11 +290,134 @@ struct AssetCompilerImpl : AssetCompiler {
 		const char* base_path = fs.getBasePath();
 		m_watcher = FileSystemWatcher::create(base_path, m_app.getAllocator());
 		m_watcher->getCallback().bind<&AssetCompilerImpl::onFileChanged>(this);
-		m_dependencies.clear();
+		{
+			MutexGuard lock(m_dependencies_mutex);
+			m_dependencies.clear();
+		}
 		m_resources.clear();
+		m_search_index.clear();
 		fillDB();
 	}
 
+	// -asset_compiler_threads <count>, default is one less than the number of CPUs
+	void createTasks() {
+		u32 count = maximum(os::getCPUsCount(), 2u) - 1;
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-asset_compiler_threads")) continue;
+			if (!parser.next()) {
+				logError("command line option '-asset_compiler_threads' without value");
+				break;
+			}
+			char tmp[16];
+			parser.getCurrent(tmp, sizeof(tmp));
+			fromCString(Span(tmp, stringLength(tmp)), count);
+			count = maximum(count, 1u);
+			break;
+		}
+
+		for (u32 i = 0; i < count; ++i) {
+			AssetCompilerTask* task = LUMIX_NEW(m_app.getAllocator(), AssetCompilerTask)(*this, m_app.getAllocator());
+			task->create("Asset compiler", true);
+			m_tasks.push(task);
+		}
+	}
+
+	// -asset_cache <dir> compiled resources are fetched from and stored to this directory, e.g. a network share
+	void createSharedCache() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (!parser.currentEquals("-asset_cache")) continue;
+			if (!parser.next()) {
+				logError("command line option '-asset_cache' without value");
+				return;
+			}
+			char dir[LUMIX_MAX_PATH];
+			parser.getCurrent(dir, sizeof(dir));
+			if (!os::dirExists(dir) && !os::makePath(dir)) {
+				logError("Could not create asset cache directory ", dir);
+				return;
+			}
+			m_shared_cache = UniquePtr<DirectoryCache>::create(m_app.getAllocator(), dir);
+			logInfo("Using shared asset cache ", dir);
+			return;
+		}
+	}
+
+	u64 getContentHash(const char* path) {
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		OutputMemoryStream content(m_app.getAllocator());
+		if (!fs.getContentSync(Path(path), content)) return 0;
+		return StableHash(content.data(), (u32)content.size()).getHashValue();
+	}
+
+	// content of source and its meta, path, compiler and plugin version, dependencies are checked when the entry is read
+	bool getCacheKey(const Path& src, const IPlugin& plugin, StableHash& key) {
+		u64 parts[5];
+		parts[0] = getContentHash(src.c_str());
+		if (parts[0] == 0) return false;
+		const StaticString<LUMIX_MAX_PATH> meta_path(src.c_str(), ".meta");
+		parts[1] = getContentHash(meta_path);
+		parts[2] = src.getHash().getHashValue();
+		parts[3] = COMPILER_VERSION;
+		parts[4] = plugin.getVersion();
+		key = StableHash(parts, sizeof(parts));
+		return true;
+	}
+
+	bool fetchFromCache(const Path& src, StableHash key) {
+		OutputMemoryStream entry(m_app.getAllocator());
+		if (!m_shared_cache->read(key, entry)) return false;
+
+		InputMemoryStream blob(entry);
+		CacheEntryHeader header;
+		blob.read(header);
+		if (header.magic != CacheEntryHeader::MAGIC || header.version != 0) return false;
+
+		Array<Path> dependencies(m_app.getAllocator());
+		const u32 dependency_count = blob.read<u32>();
+		for (u32 i = 0; i < dependency_count; ++i) {
+			const Path dependency(blob.readString());
+			const u64 hash = blob.read<u64>();
+			// e.g. an included file changed, not part of the key since it's known only after compile
+			if (getContentHash(dependency.c_str()) != hash) return false;
+			dependencies.push(dependency);
+		}
+
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		const u32 output_count = blob.read<u32>();
+		for (u32 i = 0; i < output_count; ++i) {
+			const u64 hash = blob.read<u64>();
+			const u64 size = blob.read<u64>();
+			if (blob.getPosition() + size > blob.size()) return false;
+			const StaticString<LUMIX_MAX_PATH> out_path(".lumix/resources/", hash, ".res");
+			if (!fs.saveContentSync(Path(out_path), Span((const u8*)blob.skip(size), (u32)size))) {
+				logError("Could not write ", out_path);
+				return false;
+			}
+		}
+
+		for (const Path& dependency : dependencies) registerDependency(src, dependency);
+		return true;
+	}
+
+	void storeToCache(StableHash key, const CacheRecord& record) {
+		OutputMemoryStream entry(m_app.getAllocator());
+		entry.write(CacheEntryHeader());
+		entry.write((u32)record.dependencies.size());
+		for (const Path& dependency : record.dependencies) {
+			entry.writeString(dependency.c_str());
+			entry.write(getContentHash(dependency.c_str()));
+		}
+		entry.write(record.output_count);
+		entry.write(record.outputs.data(), record.outputs.size());
+		if (!m_shared_cache->write(key, entry)) logWarning("Could not store compiled resource in the shared asset cache");
+	}
+
 	DelegateList<void(const Path&)>& listChanged() override {
 		return m_on_list_changed;
 	}
@@ -232,14 +435,54 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 
 		ASSERT(tmp.size() < 0xffFFffFF);
-		return writeCompiledResource(src.c_str(), Span(tmp.data(), (u32)tmp.size()));
+		return writeCompiledResource(src.c_str(), Span(tmp.data(), (u32)tmp.size()), true);
 	}
 
-	bool writeCompiledResource(const char* locator, Span<const u8> data) override {
+	// chunks are compressed in parallel, see CompiledResourceHeader::CHUNKED for the layout
+	void compressChunks(Span<const u8> data, OutputMemoryStream& out) {
+		const u32 chunk_size = CompiledResourceHeader::CHUNK_SIZE;
+		const u32 chunk_count = (data.length() + chunk_size - 1) / chunk_size;
+		const i32 cap = LZ4_compressBound(chunk_size);
+		OutputMemoryStream tmp(m_app.getAllocator());
+		tmp.resize(u64(cap) * chunk_count);
+		Array<u32> compressed_sizes(m_app.getAllocator());
+		compressed_sizes.resize(chunk_count);
+
+		jobs::forEach(chunk_count, 1, [&](i32 i, i32){
+			PROFILE_BLOCK("compress chunk");
+			const u8* src = data.begin() + u64(i) * chunk_size;
+			const u32 src_size = minimum(chunk_size, u32(data.length() - u64(i) * chunk_size));
+			char* dst = (char*)tmp.getMutableData() + u64(i) * cap;
+			const i32 size = LZ4_compress_default((const char*)src, dst, (i32)src_size, cap);
+			// incompressible chunks are stored as they are
+			if (size <= 0 || (u32)size >= src_size) {
+				memcpy(dst, src, src_size);
+				compressed_sizes[i] = src_size;
+			}
+			else {
+				compressed_sizes[i] = (u32)size;
+			}
+		});
+
+		out.write(chunk_size);
+		out.write(chunk_count);
+		out.write(compressed_sizes.begin(), compressed_sizes.byte_size());
+		for (u32 i = 0; i < chunk_count; ++i) {
+			out.write((const u8*)tmp.data() + u64(i) * cap, compressed_sizes[i]);
+		}
+	}
+
+	bool writeCompiledResource(const char* locator, Span<const u8> data, bool compress) override {
 		constexpr u32 COMPRESSION_SIZE_LIMIT = 4096;
 		OutputMemoryStream compressed(m_app.getAllocator());
 		i32 compressed_size = 0;
-		if (data.length() > COMPRESSION_SIZE_LIMIT) {
+		bool chunked = false;
+		if (compress && data.length() > CompiledResourceHeader::CHUNK_SIZE) {
+			compressChunks(data, compressed);
+			compressed_size = (i32)compressed.size();
+			chunked = true;
+		}
+		else if (compress && data.length() > COMPRESSION_SIZE_LIMIT) {
 			const i32 cap = LZ4_compressBound((i32)data.length());
 			compressed.resize(cap);
 			compressed_size = LZ4_compress_default((const char*)data.begin(), (char*)compressed.getMutableData(), (i32)data.length(), cap); 
@@ -263,17 +506,23 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 		CompiledResourceHeader header;
 		header.decompressed_size = data.length();
-		if (data.length() > COMPRESSION_SIZE_LIMIT && compressed_size < i32(data.length() / 4 * 3)) {
-			header.flags |= CompiledResourceHeader::COMPRESSED;
-			(void)file.write(&header, sizeof(header));
-			(void)file.write(compressed.data(), compressed_size);
-		}
-		else {
-			(void)file.write(&header, sizeof(header));
-			(void)file.write(data.begin(), data.length());
+		Span<const u8> content = data;
+		if (compress && data.length() > COMPRESSION_SIZE_LIMIT && compressed_size < i32(data.length() / 4 * 3)) {
+			header.flags |= chunked ? CompiledResourceHeader::CHUNKED : CompiledResourceHeader::COMPRESSED;
+			content = Span((const u8*)compressed.data(), (u32)compressed_size);
 		}
+		(void)file.write(&header, sizeof(header));
+		(void)file.write(content.begin(), content.length());
 		file.close();
 		if (file.isError()) logError("Could not write ", out_path);
+
+		if (g_cache_record && !file.isError()) {
+			g_cache_record->outputs.write(hash.getHashValue());
+			g_cache_record->outputs.write(u64(sizeof(header) + content.length()));
+			g_cache_record->outputs.write(header);
+			g_cache_record->outputs.write(content.begin(), content.length());
+			++g_cache_record->output_count;
+		}
 		return !file.isError();
 	}
 
@@ -288,6 +537,80 @@ struct AssetCompilerImpl : AssetCompiler {
 		return RuntimeHash(dir.begin(), dir.length());
 	}
 
+	static u32 getTrigram(const char* str) {
+		return u32(u8(str[0])) | (u32(u8(str[1])) << 8) | (u32(u8(str[2])) << 16);
+	}
+
+	// trigrams of lowercase `str`, sorted and unique
+	static void getTrigrams(const char* str, Array<u32>& out) {
+		out.clear();
+		char tmp[LUMIX_MAX_PATH];
+		makeLowercase(Span(tmp), str);
+		const i32 len = stringLength(tmp);
+		for (i32 i = 0; i < len - 2; ++i) out.push(getTrigram(tmp + i));
+		if (out.empty()) return;
+
+		qsort(out.begin(), out.size(), sizeof(out[0]), [](const void* a, const void* b) -> int {
+			const u32 x = *(const u32*)a;
+			const u32 y = *(const u32*)b;
+			return x < y ? -1 : (x > y ? 1 : 0);
+		});
+		u32 count = 1;
+		for (u32 i = 1; i < out.size(); ++i) {
+			if (out[i] != out[count - 1]) out[count++] = out[i];
+		}
+		out.resize(count);
+	}
+
+	// m_resources_mutex must be locked
+	void indexResource(const Path& path) {
+		Array<u32> trigrams(m_app.getAllocator());
+		getTrigrams(path.c_str(), trigrams);
+		for (u32 trigram : trigrams) {
+			auto iter = m_search_index.find(trigram);
+			if (!iter.isValid()) iter = m_search_index.insert(trigram, Array<FilePathHash>(m_app.getAllocator()));
+			iter.value().push(path.getHash());
+		}
+	}
+
+	// m_resources_mutex must be locked
+	void unindexResource(const Path& path) {
+		Array<u32> trigrams(m_app.getAllocator());
+		getTrigrams(path.c_str(), trigrams);
+		for (u32 trigram : trigrams) {
+			auto iter = m_search_index.find(trigram);
+			if (!iter.isValid()) continue;
+			iter.value().swapAndPopItem(path.getHash());
+			if (iter.value().empty()) m_search_index.erase(iter);
+		}
+	}
+
+	void findResources(const char* pattern, Array<Path>& out) override {
+		PROFILE_FUNCTION();
+		Array<u32> trigrams(m_app.getAllocator());
+		getTrigrams(pattern, trigrams);
+		jobs::MutexGuard lock(m_resources_mutex);
+		if (trigrams.empty()) {
+			// too short for the index
+			for (const ResourceItem& ri : m_resources) {
+				if (stristr(ri.path.c_str(), pattern)) out.push(ri.path);
+			}
+			return;
+		}
+
+		// candidates from the shortest posting list are checked against the whole pattern
+		const Array<FilePathHash>* candidates = nullptr;
+		for (u32 trigram : trigrams) {
+			auto iter = m_search_index.find(trigram);
+			if (!iter.isValid()) return;
+			if (!candidates || iter.value().size() < candidates->size()) candidates = &iter.value();
+		}
+		for (FilePathHash hash : *candidates) {
+			const ResourceItem& ri = m_resources[hash];
+			if (stristr(ri.path.c_str(), pattern)) out.push(ri.path);
+		}
+	}
+
 	void addResource(ResourceType type, const char* path) override {
 		const Path path_obj(path);
 		const FilePathHash hash = path_obj.getHash();
@@ -297,6 +620,7 @@ struct AssetCompilerImpl : AssetCompiler {
 		}
 		else {
 			m_resources.insert(hash, {path_obj, type, dirHash(path_obj.c_str())});
+			indexResource(path_obj);
 			m_on_list_changed.invoke(path_obj);
 		}
 	}
@@ -394,6 +718,9 @@ struct AssetCompilerImpl : AssetCompiler {
 
 	void registerDependency(const Path& included_from, const Path& dependency) override
 	{
+		if (g_cache_record && g_cache_record->dependencies.indexOf(dependency) < 0) g_cache_record->dependencies.push(dependency);
+		// called from compile, which can run on several threads
+		MutexGuard lock(m_dependencies_mutex);
 		auto iter = m_dependencies.find(dependency);
 		if (!iter.isValid()) {
 			IAllocator& allocator = m_app.getAllocator();
@@ -433,6 +760,7 @@ struct AssetCompilerImpl : AssetCompiler {
 							StaticString<LUMIX_MAX_PATH> res_path(".lumix/resources/", p.getHash(), ".res");
 							if (type.isValid() && fs.fileExists(res_path)) {
 								m_resources.insert(p.getHash(), {p, type, dirHash(p.c_str())});
+								indexResource(p);
 							}
 						#else
 							if (type.isValid()) {
@@ -441,6 +769,7 @@ struct AssetCompilerImpl : AssetCompiler {
 								copyString(Span(tmp), locator.resource);
 								if (fs.fileExists(tmp)) {
 									m_resources.insert(p.getHash(), {p, type, dirHash(p.c_str())});
+								indexResource(p);
 								}
 								else {
 									StaticString<LUMIX_MAX_PATH> res_path(".lumix/resources/", p.getHash(), ".res");
@@ -466,6 +795,7 @@ struct AssetCompilerImpl : AssetCompiler {
 					const char* key = lua_tostring(L, -2);
 					IAllocator& allocator = m_app.getAllocator();
 					const Path key_path(key);
+					MutexGuard lock(m_dependencies_mutex);
 					m_dependencies.insert(key_path, Array<Path>(allocator));
 					Array<Path>& values = m_dependencies.find(key_path).value();
 
@@ -506,14 +836,11 @@ struct AssetCompilerImpl : AssetCompiler {
 		const char* base_path = m_app.getEngine().getFileSystem().getBasePath();
 		const StaticString<LUMIX_MAX_PATH> full_path(base_path, "/", path);
 
-		if (os::dirExists(full_path)) {
-			MutexGuard lock(m_changed_mutex);
-			m_changed_dirs.push(Path(path));
-		}
-		else {
-			MutexGuard lock(m_changed_mutex);
-			m_changed_files.push(Path(path));
-		}
+		const bool is_dir = os::dirExists(full_path);
+		MutexGuard lock(m_changed_mutex);
+		if (is_dir) m_changed_dirs.push(Path(path));
+		else m_changed_files.push(Path(path));
+		m_last_change_time = os::Timer::getRawTimestamp();
 	}
 
 	bool getMeta(const Path& res, void* user_ptr, void (*callback)(void*, lua_State*)) const override
@@ -572,7 +899,19 @@ struct AssetCompilerImpl : AssetCompiler {
 			logError("Unknown resource type ", src);
 			return false;
 		}
-		return plugin->compile(src);
+		if (!m_shared_cache) return plugin->compile(src);
+
+		StableHash key;
+		const bool has_key = getCacheKey(src, *plugin, key);
+		if (has_key && fetchFromCache(src, key)) return true;
+
+		CacheRecord record(m_app.getAllocator());
+		ASSERT(!g_cache_record);
+		g_cache_record = &record;
+		const bool res = plugin->compile(src);
+		g_cache_record = nullptr;
+		if (res && has_key) storeToCache(key, record);
+		return res;
 	}
 	
 
@@ -624,6 +963,9 @@ struct AssetCompilerImpl : AssetCompiler {
 	}
 
 	void pushToCompileQueue(const Path& path) {
+		IPlugin* plugin = getPlugin(path);
+		const bool serial = !plugin || !plugin->isThreadSafe();
+
 		MutexGuard lock(m_to_compile_mutex);
 		auto iter = m_generations.find(path);
 		if (!iter.isValid()) {
@@ -636,6 +978,7 @@ struct AssetCompilerImpl : AssetCompiler {
 		CompileJob job;
 		job.path = path;
 		job.generation = iter.value();
+		job.serial = serial;
 
 		m_to_compile.push(job);
 		++m_compile_batch_count;
@@ -643,6 +986,32 @@ struct AssetCompilerImpl : AssetCompiler {
 		m_semaphore.signal();
 	}
 
+	// m_to_compile_mutex must be locked
+	bool dependsOnInProgress(const Path& path) {
+		MutexGuard lock(m_dependencies_mutex);
+		for (const Path& p : m_in_progress) {
+			auto iter = m_dependencies.find(p);
+			if (iter.isValid() && iter.value().indexOf(path) >= 0) return true;
+		}
+		return false;
+	}
+
+	// m_to_compile_mutex must be locked, index of the most recently queued job which can start now, -1 if there's none
+	i32 pickJob() {
+		for (i32 i = m_to_compile.size() - 1; i >= 0; --i) {
+			const CompileJob& job = m_to_compile[i];
+			// exit request or outdated, these are dropped immediately
+			if (job.path.isEmpty() || job.generation != m_generations[job.path]) return i;
+			
+			if (job.serial && m_serial_in_progress > 0) continue;
+			if (m_in_progress.indexOf(job.path) >= 0) continue;
+			// dependents are compiled after their dependencies, they are queued again when the dependency finishes anyway
+			if (dependsOnInProgress(job.path)) continue;
+			return i;
+		}
+		return -1;
+	}
+
 	CompileJob popCompiledResource()
 	{
 		MutexGuard lock(m_compiled_mutex);
@@ -720,85 +1089,112 @@ struct AssetCompilerImpl : AssetCompiler {
 			}
 
 			// compile all dependents
-			auto dep_iter = m_dependencies.find(job.path);
-			if (dep_iter.isValid()) {
-				for (const Path& p : dep_iter.value()) {
-					pushToCompileQueue(p);
-				}
-			}
+			pushDependents(job.path);
 		}
 
-		for (;;) {
-			Path path_obj;
-			{
-				MutexGuard lock(m_changed_mutex);
-				if (m_changed_dirs.empty()) break;
+		Array<Path> changed_dirs(m_app.getAllocator());
+		Array<Path> changed_files(m_app.getAllocator());
+		{
+			MutexGuard lock(m_changed_mutex);
+			const u64 since_last_change = os::Timer::getRawTimestamp() - m_last_change_time;
+			if (since_last_change < u64(CHANGES_DEBOUNCE_TIME * os::Timer::getFrequency())) return;
+			changed_dirs.swap(m_changed_dirs);
+			changed_files.swap(m_changed_files);
+		}
 
-				m_changed_dirs.removeDuplicates();
-				path_obj = m_changed_dirs.back();
-				m_changed_dirs.pop();
+		changed_dirs.removeDuplicates();
+		for (const Path& path_obj : changed_dirs) {
+			FileSystem& fs = m_app.getEngine().getFileSystem();
+			const StaticString<LUMIX_MAX_PATH> list_path(fs.getBasePath(), ".lumix/resources/_list.txt");
+			const u64 list_last_modified = os::getLastModified(list_path);
+			StaticString<LUMIX_MAX_PATH> fullpath(fs.getBasePath(), path_obj.c_str());
+			if (os::dirExists(fullpath)) {
+				processDir(path_obj.c_str(), list_last_modified);
+				m_on_list_changed.invoke(path_obj);
 			}
-
-			if (!path_obj.isEmpty()) {
-				FileSystem& fs = m_app.getEngine().getFileSystem();
-				const StaticString<LUMIX_MAX_PATH> list_path(fs.getBasePath(), ".lumix/resources/_list.txt");
-				const u64 list_last_modified = os::getLastModified(list_path);
-				StaticString<LUMIX_MAX_PATH> fullpath(fs.getBasePath(), path_obj.c_str());
-				if (os::dirExists(fullpath)) {
-					processDir(path_obj.c_str(), list_last_modified);
-					m_on_list_changed.invoke(path_obj);
-				}
-				else {
-					jobs::MutexGuard lock(m_resources_mutex);
-					m_resources.eraseIf([&](const ResourceItem& ri){
-						if (!startsWith(ri.path.c_str(), path_obj.c_str())) return false;
-						return true;
-					});
-					m_on_list_changed.invoke(path_obj);
-				}
+			else {
+				jobs::MutexGuard lock(m_resources_mutex);
+				m_resources.eraseIf([&](const ResourceItem& ri){
+					if (!startsWith(ri.path.c_str(), path_obj.c_str())) return false;
+					unindexResource(ri.path);
+					return true;
+				});
+				m_on_list_changed.invoke(path_obj);
 			}
 		}
 
-		for (;;) {
-			Path path_obj;
-			{
-				MutexGuard lock(m_changed_mutex);
-				if (m_changed_files.empty()) break;
-
-				m_changed_files.removeDuplicates();
-				path_obj = m_changed_files.back();
-				m_changed_files.pop();
-			}
-
+		for (Path& path_obj : changed_files) {
 			if (Path::hasExtension(path_obj.c_str(), "meta")) {
 				char tmp[LUMIX_MAX_PATH];
 				copyNString(Span(tmp), path_obj.c_str(), path_obj.length() - 5);
 				path_obj = tmp;
 			}
+		}
+		changed_files.removeDuplicates();
 
+		Array<Path> to_compile(m_app.getAllocator());
+		for (const Path& path_obj : changed_files) {
 			if (getResourceType(path_obj.c_str()) != INVALID_RESOURCE_TYPE) {
 				if (!m_app.getEngine().getFileSystem().fileExists(path_obj.c_str())) {
 					jobs::MutexGuard lock(m_resources_mutex);
 					m_resources.eraseIf([&](const ResourceItem& ri){
 						if (!endsWithInsensitive(ri.path.c_str(), path_obj.c_str())) return false;
+						unindexResource(ri.path);
 						return true;
 					});
 					m_on_list_changed.invoke(path_obj);
 				}
 				else {
 					addResource(path_obj.c_str());
-					pushToCompileQueue(path_obj);
+					to_compile.push(path_obj);
 				}
 			}
 			else {
-				auto dep_iter = m_dependencies.find(path_obj);
-				if (dep_iter.isValid()) {
-					for (const Path& p : dep_iter.value()) {
-						pushToCompileQueue(p);
+				getDependents(path_obj, to_compile);
+			}
+		}
+		pushToCompileQueue(to_compile);
+	}
+
+	// compile threads can register dependencies and pushToCompileQueue must not be called with m_dependencies_mutex locked, so dependents are copied
+	void getDependents(const Path& path, Array<Path>& out) override {
+		MutexGuard lock(m_dependencies_mutex);
+		auto iter = m_dependencies.find(path);
+		if (!iter.isValid()) return;
+		for (const Path& p : iter.value()) out.push(p);
+	}
+
+	void pushDependents(const Path& path) {
+		Array<Path> dependents(m_app.getAllocator());
+		getDependents(path, dependents);
+		for (const Path& p : dependents) {
+			pushToCompileQueue(p);
+		}
+	}
+
+	// queue all paths at once, dependencies are queued after their dependents in the batch
+	// pickJob takes the most recent jobs first, so dependencies start first and dependents wait for them
+	void pushToCompileQueue(Array<Path>& paths) {
+		paths.removeDuplicates();
+		Array<Path> dependencies(m_app.getAllocator());
+		Array<Path> dependents(m_app.getAllocator());
+		{
+			MutexGuard lock(m_dependencies_mutex);
+			for (const Path& path : paths) {
+				bool is_dependent = false;
+				for (const Path& p : paths) {
+					auto iter = m_dependencies.find(p);
+					if (iter.isValid() && iter.value().indexOf(path) >= 0) {
+						is_dependent = true;
+						break;
 					}
 				}
+				if (is_dependent) dependents.push(path);
+				else dependencies.push(path);
 			}
 		}
+		for (const Path& p : dependents) pushToCompileQueue(p);
+		for (const Path& p : dependencies) pushToCompileQueue(p);
 	}
 
 	void removePlugin(IPlugin& plugin) override
@@ -842,19 +1238,31 @@ struct AssetCompilerImpl : AssetCompiler {
 	Mutex m_compiled_mutex;
 	Mutex m_changed_mutex;
 	Mutex m_plugin_mutex;
+	// locked after m_to_compile_mutex if both are needed
+	Mutex m_dependencies_mutex;
 	jobs::Mutex m_resources_mutex;
 	HashMap<Path, u32> m_generations; 
 	HashMap<Path, Array<Path>> m_dependencies; 
 	Array<Path> m_changed_files;
 	Array<Path> m_changed_dirs;
+	// raw timestamp, guarded by m_changed_mutex
+	u64 m_last_change_time = 0;
 	Array<CompileJob> m_to_compile;
 	Array<CompileJob> m_compiled;
 	StudioApp& m_app;
 	LoadHook m_load_hook;
 	HashMap<RuntimeHash, IPlugin*> m_plugins;
-	AssetCompilerTask m_task;
+	Array<AssetCompilerTask*> m_tasks;
+	UniquePtr<SharedCache> m_shared_cache;
+	// paths being compiled right now, guarded by m_to_compile_mutex
+	Array<Path> m_in_progress;
+	u32 m_serial_in_progress = 0;
+	// tasks which woke up with no job they could start, they are signaled again when a compile finishes
+	u32 m_blocked_count = 0;
 	UniquePtr<FileSystemWatcher> m_watcher;
 	HashMap<FilePathHash, ResourceItem> m_resources;
+	// trigram -> resources with the trigram in their lowercase path, guarded by m_resources_mutex
+	HashMap<u32, Array<FilePathHash>> m_search_index;
 	HashMap<u32, ResourceType, HashFuncDirect<u32>> m_registered_extensions;
 	DelegateList<void(const Path&)> m_on_list_changed;
 	DelegateList<void(Resource&)> m_resource_compiled;
@@ -871,31 +1279,44 @@ int AssetCompilerTask::task()
 {
 	while (!m_finished) {
 		m_compiler.m_semaphore.wait();
-		const AssetCompilerImpl::CompileJob p = [&]{
+		AssetCompilerImpl::CompileJob p;
+		{
 			MutexGuard lock(m_compiler.m_to_compile_mutex);
-			AssetCompilerImpl::CompileJob p = m_compiler.m_to_compile.back();
-			if (p.path.isEmpty()) return p;
-
-			auto iter = m_compiler.m_generations.find(p.path);
-			const bool is_most_recent = p.generation == iter.value();
-			if (is_most_recent) {
-				m_compiler.m_res_in_progress = p.path.c_str();
+			const i32 idx = m_compiler.pickJob();
+			if (idx < 0) {
+				++m_compiler.m_blocked_count;
+				continue;
 			}
-			else {
-				p.path = Path();
+			p = m_compiler.m_to_compile[idx];
+			m_compiler.m_to_compile.erase(idx);
+			if (p.path.isEmpty()) continue;
+
+			const bool is_most_recent = p.generation == m_compiler.m_generations[p.path];
+			if (!is_most_recent) {
 				--m_compiler.m_batch_remaining_count;
+				continue;
 			}
-			m_compiler.m_to_compile.pop();
-			return p;
-		}();
-		if (!p.path.isEmpty()) {
+			m_compiler.m_res_in_progress = p.path.c_str();
+			m_compiler.m_in_progress.push(p.path);
+			if (p.serial) ++m_compiler.m_serial_in_progress;
+		}
+
+		{
 			PROFILE_BLOCK("compile asset");
 			profiler::pushString(p.path.c_str());
 			const bool compiled = m_compiler.compile(p.path);
 			if (!compiled) logError("Failed to compile resource ", p.path);
+		}
+		{
 			MutexGuard lock(m_compiler.m_compiled_mutex);
 			m_compiler.m_compiled.push(p);
 		}
+
+		MutexGuard lock(m_compiler.m_to_compile_mutex);
+		m_compiler.m_in_progress.swapAndPopItem(p.path);
+		if (p.serial) --m_compiler.m_serial_in_progress;
+		for (u32 i = 0; i < m_compiler.m_blocked_count; ++i) m_compiler.m_semaphore.signal();
+		m_compiler.m_blocked_count = 0;
 	}
 	return 0;
 }
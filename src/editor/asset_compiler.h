@@ -15,6 +15,11 @@ struct LUMIX_EDITOR_API AssetCompiler {
 	struct LUMIX_EDITOR_API IPlugin {
 		virtual ~IPlugin() {}
 		virtual bool compile(const Path& src) = 0;
+		// true if compile can run concurrently with any other compile, including of the same plugin
+		// other plugins' compiles run one at a time
+		virtual bool isThreadSafe() const { return false; }
+		// part of the shared cache key, bump when compiled output of the same source changes
+		virtual u32 getVersion() const { return 0; }
 		virtual void addSubresources(AssetCompiler& compiler, const char* path);
 	};
 
@@ -39,8 +44,13 @@ struct LUMIX_EDITOR_API AssetCompiler {
 	virtual const HashMap<FilePathHash, ResourceItem>& lockResources() = 0;
 	virtual void unlockResources() = 0;
 	virtual void registerDependency(const Path& included_from, const Path& dependency) = 0;
+	// files which registered `path` as their dependency, i.e. are recompiled when it changes
+	virtual void getDependents(const Path& path, Array<Path>& out) = 0;
+	// resources with `pattern` in their path, case insensitive, do not call with resources locked
+	virtual void findResources(const char* pattern, Array<Path>& out) = 0;
 	virtual void addResource(ResourceType type, const char* path) = 0;
-	virtual bool writeCompiledResource(const char* locator, Span<const u8> data) = 0;
+	// `compress = false` keeps data readable in ranges, see FileSystem::getContentRange
+	virtual bool writeCompiledResource(const char* locator, Span<const u8> data, bool compress = true) = 0;
 	virtual bool copyCompile(const Path& src) = 0;
 	virtual DelegateList<void(const Path&)>& listChanged() = 0;
 	virtual DelegateList<void(Resource&)>& resourceCompiled() = 0;
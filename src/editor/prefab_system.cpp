@@ -45,6 +45,8 @@ struct AssetBrowserPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 
 	void onResourceUnloaded(Resource* resource) override {}
 	const char* getName() const override { return "Prefab"; }
@@ -461,6 +463,23 @@ public:
 		return dst;
 	}
 
+	Universe& cloneHierarchies(Span<const EntityRef> roots) override {
+		Engine& engine = m_editor.getEngine();
+		Universe& dst = engine.createUniverse(false);
+		Universe& src = *m_editor.getUniverse();
+
+		HashMap<EntityPtr, EntityPtr> map(m_editor.getAllocator());
+		map.reserve(roots.length() * 2);
+		// all entities are mapped before components are cloned, so references between hierarchies are kept
+		for (EntityRef e : roots) cloneHierarchy(src, e, dst, false, map);
+		Array<EntityRef> entities(m_editor.getAllocator());
+		for (EntityRef e : roots) {
+			const EntityRef dst_e = cloneEntity(src, e, dst, INVALID_ENTITY, entities, map);
+			dst.setTransform(dst_e, src.getTransform(e));
+		}
+		return dst;
+	}
+
 
 	static void destroySubtree(Universe& universe, EntityPtr entity)
 	{
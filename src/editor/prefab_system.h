@@ -30,6 +30,9 @@ struct LUMIX_EDITOR_API PrefabSystem
 	virtual void savePrefab(EntityRef entity, const struct Path& path) = 0;
 	virtual void breakPrefab(EntityRef e) = 0;
 	virtual PrefabResource* getPrefabResource(EntityRef entity) = 0;
+	// copies hierarchies of `roots` with their transforms to a new universe, destroy it with Engine::destroyUniverse
+	// references to entities outside of the hierarchies are cleared
+	virtual struct Universe& cloneHierarchies(Span<const EntityRef> roots) = 0;
 };
 
 
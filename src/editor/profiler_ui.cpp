@@ -170,6 +170,262 @@ static void overwrite(ThreadContextProxy& ctx, u32 p, const T& v) {
 	}
 }
 
+// receives events streamed by profiler::startServer() in another process, e.g. a headless app
+// and keeps them in the same rings as the local profiler, so serialize() produces the same blob as profiler::serialize()
+struct RemoteProfiler {
+	static constexpr u32 CONTEXT_SIZE = 4 * 1024 * 1024;
+	static constexpr u32 HANDSHAKE_SIZE = sizeof(u32) * 2 + sizeof(u64);
+
+	struct Context {
+		Context(IAllocator& allocator) : buffer(allocator) { buffer.resize(CONTEXT_SIZE); }
+
+		StaticString<64> name;
+		u32 thread_id = 0;
+		bool show = false;
+		OutputMemoryStream buffer;
+		u32 begin = 0;
+		u32 end = 0;
+		u64 remote_time = 0;
+	};
+
+	RemoteProfiler(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_incoming(allocator)
+		, m_event(allocator)
+		, m_contexts(allocator)
+		, m_counters(allocator)
+		, m_strings(allocator)
+	{}
+
+	~RemoteProfiler() {
+		for (const char* str : m_strings) m_allocator.deallocate((void*)str);
+		for (Context* ctx : m_contexts) LUMIX_DELETE(m_allocator, ctx);
+	}
+
+	bool connect(const char* host, u16 port) { return m_socket.connect(host, port); }
+	bool isConnected() const { return m_socket.isOpen(); }
+
+	void update() {
+		if (!m_socket.isOpen()) return;
+
+		u8 tmp[64 * 1024];
+		for (;;) {
+			const i32 received = m_socket.receive(tmp, sizeof(tmp));
+			if (received < 0) {
+				logInfo("Remote profiler disconnected");
+				m_socket.close();
+				break;
+			}
+			if (received == 0) break;
+			m_incoming.write(tmp, received);
+		}
+
+		const u8* data = m_incoming.data();
+		const u64 size = m_incoming.size();
+		u64 pos = 0;
+		if (!m_handshake_done) {
+			if (size < HANDSHAKE_SIZE) return;
+			u32 magic, version;
+			u64 frequency;
+			memcpy(&magic, data, sizeof(magic));
+			memcpy(&version, data + sizeof(magic), sizeof(version));
+			memcpy(&frequency, data + sizeof(magic) + sizeof(version), sizeof(frequency));
+			if (magic != profiler::remote::MAGIC || version != profiler::remote::VERSION) {
+				logError("Remote profiler: unsupported stream");
+				m_socket.close();
+				m_incoming.clear();
+				return;
+			}
+			m_time_scale = double(profiler::frequency()) / double(frequency);
+			m_handshake_done = true;
+			pos = HANDSHAKE_SIZE;
+		}
+
+		while (pos + sizeof(u32) <= size) {
+			u32 packet_size;
+			memcpy(&packet_size, data + pos, sizeof(packet_size));
+			if (pos + sizeof(u32) + packet_size > size) break;
+			processPacket(data + pos + sizeof(u32), packet_size);
+			pos += sizeof(u32) + packet_size;
+		}
+
+		const u64 rest = size - pos;
+		memmove(m_incoming.getMutableData(), data + pos, rest);
+		m_incoming.resize(rest);
+	}
+
+	Context& getContext(u32 idx) {
+		while ((u32)m_contexts.size() <= idx) {
+			m_contexts.push(LUMIX_NEW(m_allocator, Context)(m_allocator));
+		}
+		return *m_contexts[idx];
+	}
+
+	// remote pointer to a local copy of the string
+	const char* getString(u64 id) {
+		auto iter = m_strings.find(id);
+		if (iter.isValid()) return iter.value();
+		return addString(id, "N/A");
+	}
+
+	const char* addString(u64 id, const char* value) {
+		const u32 len = stringLength(value);
+		char* copy = (char*)m_allocator.allocate(len + 1);
+		memcpy(copy, value, len + 1);
+		m_strings.insert(id, copy);
+		return copy;
+	}
+
+	u64 toLocalTime(u64 remote_time) const { return u64(remote_time * m_time_scale); }
+
+	void processPacket(const u8* data, u32 size) {
+		InputMemoryStream blob(data, size);
+		const profiler::remote::PacketType type = blob.read<profiler::remote::PacketType>();
+		switch (type) {
+			case profiler::remote::PacketType::COUNTERS: {
+				const u32 first = blob.read<u32>();
+				const u32 count = blob.read<u32>();
+				if ((u32)m_counters.size() < first + count) m_counters.resize(first + count);
+				blob.read(&m_counters[first], count * sizeof(profiler::Counter));
+				break;
+			}
+			case profiler::remote::PacketType::THREAD: {
+				Context& ctx = getContext(blob.read<u32>());
+				ctx.thread_id = blob.read<u32>();
+				ctx.show = blob.read<u8>() != 0;
+				ctx.name = blob.readString();
+				break;
+			}
+			case profiler::remote::PacketType::STRING: {
+				const u64 id = blob.read<u64>();
+				const char* value = blob.readString();
+				if (!m_strings.find(id).isValid()) addString(id, value);
+				break;
+			}
+			case profiler::remote::PacketType::EVENTS: {
+				Context& ctx = getContext(blob.read<u32>());
+				while (blob.getPosition() < size) {
+					const profiler::EventType event_type = blob.read<profiler::EventType>();
+					const u32 payload_size = (u32)blob.readVarint();
+					ctx.remote_time += blob.readZigzag();
+					if (blob.getPosition() + payload_size > size) break;
+					pushEvent(ctx, event_type, (const u8*)blob.skip(payload_size), payload_size);
+				}
+				break;
+			}
+		}
+	}
+
+	template <typename T> static T readValue(u8* payload) {
+		T v;
+		memcpy(&v, payload, sizeof(v));
+		return v;
+	}
+
+	template <typename T> static void writeValue(u8* payload, const T& v) { memcpy(payload, &v, sizeof(v)); }
+
+	// string ids are replaced with local pointers and timestamps converted to local frequency
+	void pushEvent(Context& ctx, profiler::EventType type, const u8* payload, u32 payload_size) {
+		profiler::EventHeader header;
+		header.type = type;
+		header.size = u16(sizeof(header) + payload_size);
+		header.time = toLocalTime(ctx.remote_time);
+		m_event.clear();
+		m_event.write(header);
+		m_event.write(payload, payload_size);
+		u8* p = m_event.getMutableData() + sizeof(header);
+
+		switch (type) {
+			case profiler::EventType::BEGIN_BLOCK: {
+				if (payload_size < sizeof(profiler::BlockRecord)) return;
+				profiler::BlockRecord r = readValue<profiler::BlockRecord>(p);
+				r.name = getString((u64)(uintptr)r.name);
+				writeValue(p, r);
+				break;
+			}
+			case profiler::EventType::INT: {
+				if (payload_size < sizeof(profiler::IntRecord)) return;
+				profiler::IntRecord r = readValue<profiler::IntRecord>(p);
+				r.key = getString((u64)(uintptr)r.key);
+				writeValue(p, r);
+				break;
+			}
+			case profiler::EventType::BEGIN_GPU_BLOCK: {
+				if (payload_size < sizeof(profiler::GPUBlock)) return;
+				profiler::GPUBlock r = readValue<profiler::GPUBlock>(p);
+				r.timestamp = toLocalTime(r.timestamp);
+				writeValue(p, r);
+				break;
+			}
+			case profiler::EventType::END_GPU_BLOCK: {
+				if (payload_size < sizeof(u64)) return;
+				writeValue(p, toLocalTime(readValue<u64>(p)));
+				break;
+			}
+			case profiler::EventType::CONTEXT_SWITCH: {
+				if (payload_size < sizeof(profiler::ContextSwitchRecord)) return;
+				profiler::ContextSwitchRecord r = readValue<profiler::ContextSwitchRecord>(p);
+				r.timestamp = toLocalTime(r.timestamp);
+				writeValue(p, r);
+				break;
+			}
+			default: break;
+		}
+
+		// same as the local profiler, the oldest events are dropped
+		u8* buf = ctx.buffer.getMutableData();
+		while (header.size + ctx.end - ctx.begin > CONTEXT_SIZE) {
+			u16 event_size;
+			const u32 l = ctx.begin % CONTEXT_SIZE;
+			if (l + 1 < CONTEXT_SIZE) memcpy(&event_size, buf + l, sizeof(event_size));
+			else event_size = buf[l] | (buf[0] << 8);
+			ctx.begin += event_size;
+		}
+		const u32 l = ctx.end % CONTEXT_SIZE;
+		if (CONTEXT_SIZE - l >= header.size) {
+			memcpy(buf + l, m_event.data(), header.size);
+		}
+		else {
+			memcpy(buf + l, m_event.data(), CONTEXT_SIZE - l);
+			memcpy(buf, m_event.data() + CONTEXT_SIZE - l, header.size - (CONTEXT_SIZE - l));
+		}
+		ctx.end += header.size;
+	}
+
+	// same layout as profiler::serialize
+	void serialize(OutputMemoryStream& blob) {
+		getContext(0);
+		blob.write(u32(0));
+		blob.write((u32)m_counters.size());
+		blob.write(m_counters.begin(), m_counters.byte_size());
+		blob.write(u32(m_contexts.size() - 1));
+		for (const Context* ctx : m_contexts) {
+			blob.writeString(ctx->name);
+			blob.write(ctx->thread_id);
+			blob.write(ctx->begin);
+			blob.write(ctx->end);
+			blob.write((u8)ctx->show);
+			blob.write(CONTEXT_SIZE);
+			blob.write(ctx->buffer.data(), CONTEXT_SIZE);
+		}
+		blob.write(m_strings.size());
+		for (const char* str : m_strings) {
+			blob.write((u64)(uintptr)str);
+			blob.write(str, stringLength(str) + 1);
+		}
+	}
+
+	IAllocator& m_allocator;
+	os::Socket m_socket;
+	bool m_handshake_done = false;
+	double m_time_scale = 1;
+	OutputMemoryStream m_incoming;
+	OutputMemoryStream m_event;
+	Array<Context*> m_contexts;
+	Array<profiler::Counter> m_counters;
+	HashMap<u64, const char*> m_strings;
+};
+
 struct ProfilerUIImpl final : ProfilerUI
 {
 	ProfilerUIImpl(StudioApp& app, debug::Allocator* allocator, Engine& engine)
@@ -219,7 +475,8 @@ struct ProfilerUIImpl final : ProfilerUI
 	void onPause() {
 		ASSERT(m_is_paused);
 		m_data.clear();
-		profiler::serialize(m_data);
+		if (m_remote) m_remote->serialize(m_data);
+		else profiler::serialize(m_data);
 		patchStrings();
 		findEnd();
 		preprocess();
@@ -248,6 +505,43 @@ struct ProfilerUIImpl final : ProfilerUI
 		return ThreadContextProxy(m_data.getMutableData() + blob.getPosition());
 	}
 
+	// one row per worker, each frame is a rect colored by worker's utilization in that frame
+	void workersUI(float from_x, float to_x) {
+		if (!ImGui::TreeNode("Workers")) return;
+		ImDrawList* dl = ImGui::GetWindowDrawList();
+		const u64 view_start = m_end - m_range;
+		const float row_height = ImGui::GetTextLineHeight();
+		const u32 prefix_len = stringLength(profiler::WORKER_UTILIZATION_COUNTER_PREFIX);
+
+		for (const Counter& counter : m_counters) {
+			if (!startsWith(counter.name, profiler::WORKER_UTILIZATION_COUNTER_PREFIX)) continue;
+
+			ImGui::Text("Worker %s", counter.name.data + prefix_len);
+			const float top = ImGui::GetCursorScreenPos().y;
+			for (i32 i = 1; i < counter.records.size(); ++i) {
+				const Counter::Record& prev = counter.records[i - 1];
+				const Counter::Record& r = counter.records[i];
+				if (r.time < view_start || prev.time > m_end) continue;
+
+				const float t_from = float(i64(prev.time - view_start) / double(m_range));
+				const float t_to = float(i64(r.time - view_start) / double(m_range));
+				const float x_from = maximum(from_x, from_x * (1 - t_from) + to_x * t_from);
+				const float x_to = minimum(to_x, from_x * (1 - t_to) + to_x * t_to);
+				const float t = clamp(r.value / 100.f, 0.f, 1.f);
+				const ImColor color(t, 1 - t, 0.f);
+				const ImVec2 a(x_from, top);
+				const ImVec2 b(x_to, top + row_height);
+				dl->AddRectFilled(a, b, color);
+				dl->AddRect(a, b, 0xff000000);
+				if (ImGui::IsMouseHoveringRect(a, b)) {
+					ImGui::SetTooltip("%.1f%%", r.value);
+				}
+			}
+			ImGui::Dummy(ImVec2(-1, row_height));
+		}
+		ImGui::TreePop();
+	}
+
 	void countersUI(float from_x, float to_x) {
 		if (!ImGui::TreeNode("Counters")) return;
 		ImDrawList* dl = ImGui::GetWindowDrawList();
@@ -496,18 +790,40 @@ struct ProfilerUIImpl final : ProfilerUI
 		}	
 	}
 
+	void exportChromeTrace() {
+		if (m_data.empty()) return;
+		char path[LUMIX_MAX_PATH];
+		if (!os::getSaveFilename(Span(path), "Chrome trace\0*.json\0", "json")) return;
+
+		OutputMemoryStream json(m_allocator);
+		profiler::exportChromeTrace(m_data, json);
+		os::OutputFile file;
+		if (!file.open(path)) {
+			logError("Could not open ", path);
+			return;
+		}
+		if (!file.write(json.data(), json.size())) {
+			logError("Could not write ", path);
+		}
+		file.close();
+	}
+
 	const char* getName() const override { return "profiler"; }
 
 	void onWindowGUI() override
 	{
 		PROFILE_FUNCTION();
 
+		if (m_remote) m_remote->update();
+
 		if (!m_is_open) return;
 		if (ImGui::Begin(ICON_FA_CHART_AREA "Profiler##profiler", &m_is_open))
 		{
 			onGUICPUProfiler();
 			onGUIMemoryProfiler();
+			onGUIJobs();
 			onGUIResources();
+			onGUILoading();
 		}
 		ImGui::End();
 	}
@@ -554,7 +870,9 @@ struct ProfilerUIImpl final : ProfilerUI
 
 	void onGUICPUProfiler();
 	void onGUIMemoryProfiler();
+	void onGUIJobs();
 	void onGUIResources();
+	void onGUILoading();
 	void onFrame();
 	void addToTree(debug::Allocator::AllocationInfo* info);
 	void refreshAllocations();
@@ -593,6 +911,9 @@ struct ProfilerUIImpl final : ProfilerUI
 	OutputMemoryStream m_data;
 	os::Timer m_timer;
 	float m_autopause = -33.3333f;
+	UniquePtr<RemoteProfiler> m_remote;
+	char m_remote_host[64] = "localhost";
+	i32 m_remote_port = profiler::remote::DEFAULT_PORT;
 	bool m_show_context_switches = false;
 	bool m_show_frames = true;
 	
@@ -731,6 +1052,106 @@ void ProfilerUIImpl::onGUIResources()
 }
 
 
+void ProfilerUIImpl::onGUILoading()
+{
+	if (!ImGui::CollapsingHeader("Loading")) return;
+
+	if (ImGui::Button("Reset")) m_resource_manager.resetLoadStats();
+	ImGui::SameLine();
+	if (ImGui::Button("Save report")) {
+		char path[LUMIX_MAX_PATH];
+		if (os::getSaveFilename(Span(path), "Text file\0*.txt\0", "txt")) {
+			OutputMemoryStream report(m_allocator);
+			m_resource_manager.writeLoadReport(report);
+			os::OutputFile file;
+			if (!file.open(path)) {
+				logError("Could not open ", path);
+			}
+			else {
+				if (!file.write(report.data(), report.size())) logError("Could not write ", path);
+				file.close();
+			}
+		}
+	}
+
+	const double to_ms = 1000.0 / os::Timer::getFrequency();
+	if (ImGui::BeginTable("load_types", 9, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("Type");
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableSetupColumn("Queue (ms)");
+		ImGui::TableSetupColumn("IO (ms)");
+		ImGui::TableSetupColumn("Wait (ms)");
+		ImGui::TableSetupColumn("Parse (ms)");
+		ImGui::TableSetupColumn("Dependencies (ms)");
+		ImGui::TableSetupColumn("Total (ms)");
+		ImGui::TableSetupColumn("Max (ms)");
+		ImGui::TableHeadersRow();
+		for (ResourceManager* manager : m_resource_manager.getAll()) {
+			const ResourceManager::LoadStats& stats = manager->getLoadStats();
+			if (stats.count == 0) continue;
+
+			Span<const char> type_name;
+			for (Resource* res : manager->getResourceTable()) {
+				type_name = Path::getExtension(Span(res->getPath().c_str(), res->getPath().length()));
+				break;
+			}
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(type_name.begin(), type_name.end());
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", stats.count);
+			const u64 values[] = { stats.queue, stats.io, stats.wait, stats.parse, stats.dependencies, stats.total, stats.max };
+			for (u64 v : values) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", float(v * to_ms));
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	Array<Resource*> critical_path(m_allocator);
+	m_resource_manager.getLoadCriticalPath(critical_path);
+	if (critical_path.empty() || !ImGui::TreeNodeEx("Critical path", ImGuiTreeNodeFlags_DefaultOpen)) return;
+
+	// the last resource to get ready is first, bars are aligned to the first queued resource on the path
+	u64 from = critical_path[0]->getLoadTimes().queued;
+	const u64 to = critical_path[0]->getLoadTimes().ready;
+	for (Resource* res : critical_path) from = minimum(from, res->getLoadTimes().queued);
+	const float range = float(maximum(to - from, (u64)1));
+
+	ImGui::TextDisabled("queue / io / wait / parse / dependencies");
+	ImDrawList* dl = ImGui::GetWindowDrawList();
+	const float bar_width = maximum(ImGui::GetContentRegionAvail().x * 0.5f, 100.f);
+	const float bar_height = ImGui::GetTextLineHeight();
+	static const u32 COLORS[] = { 0xff808080, 0xffff8040, 0xff40c0ff, 0xff40ff40, 0xff4040ff };
+	for (Resource* res : critical_path) {
+		const Resource::LoadTimes& t = res->getLoadTimes();
+		const u64 io_start = t.io_start ? t.io_start : t.queued;
+		const u64 io_end = t.io_end ? t.io_end : io_start;
+		const u64 stages[] = { t.queued, io_start, io_end, t.parse_start, t.parse_end, t.ready };
+
+		const ImVec2 p = ImGui::GetCursorScreenPos();
+		for (u32 i = 0; i < lengthOf(COLORS); ++i) {
+			if (stages[i + 1] <= stages[i]) continue;
+			const float x0 = p.x + (stages[i] - from) / range * bar_width;
+			const float x1 = p.x + (stages[i + 1] - from) / range * bar_width;
+			dl->AddRectFilled(ImVec2(x0, p.y), ImVec2(maximum(x1, x0 + 1), p.y + bar_height), COLORS[i]);
+		}
+		ImGui::Dummy(ImVec2(bar_width, bar_height));
+		if (ImGui::IsItemHovered()) {
+			ImGui::SetTooltip("queue %.1f ms\nio %.1f ms\nwait %.1f ms\nparse %.1f ms\ndependencies %.1f ms"
+				, float((io_start - t.queued) * to_ms)
+				, float((io_end - io_start) * to_ms)
+				, float((t.parse_start - io_end) * to_ms)
+				, float((t.parse_end - t.parse_start) * to_ms)
+				, float((t.ready - t.parse_end) * to_ms));
+		}
+		ImGui::SameLine();
+		ImGui::Text("%.1f ms %s", float((t.ready - t.queued) * to_ms), res->getPath().c_str());
+	}
+	ImGui::TreePop();
+}
+
+
 ProfilerUIImpl::AllocationStackNode* ProfilerUIImpl::getOrCreate(AllocationStackNode* my_node,
 	debug::StackNode* external_node,
 	size_t size)
@@ -841,10 +1262,102 @@ void ProfilerUIImpl::showAllocationTree(AllocationStackNode* node, int column) c
 }
 
 
+void ProfilerUIImpl::onGUIJobs()
+{
+	if (!ImGui::CollapsingHeader("Jobs")) return;
+
+	if (ImGui::Button("Reset")) jobs::getWaitSiteStats({}, true);
+	ImGui::SameLine();
+	ImGui::TextDisabled("Waits which switched fiber, by profiler block");
+
+	jobs::WaitSiteStats sites[128];
+	const u32 count = minimum(jobs::getWaitSiteStats(Span(sites), false), (u32)lengthOf(sites));
+	qsort(sites, count, sizeof(sites[0]), [](const void* a, const void* b){
+		const float ta = ((const jobs::WaitSiteStats*)a)->total_ms;
+		const float tb = ((const jobs::WaitSiteStats*)b)->total_ms;
+		return ta < tb ? 1 : (ta > tb ? -1 : 0);
+	});
+
+	if (ImGui::BeginTable("waits", 5, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("Block");
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableSetupColumn("Total (ms)");
+		ImGui::TableSetupColumn("Avg (ms)");
+		ImGui::TableSetupColumn("Max (ms)");
+		ImGui::TableHeadersRow();
+		for (u32 i = 0; i < count; ++i) {
+			const jobs::WaitSiteStats& site = sites[i];
+			ImGui::TableNextColumn();
+			ImGui::Text("%s%s", site.name, site.is_mutex ? " (mutex)" : "");
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", site.count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", site.total_ms);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", site.total_ms / maximum(site.count, 1u));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", site.max_ms);
+		}
+		ImGui::EndTable();
+	}
+}
+
+
 void ProfilerUIImpl::onGUIMemoryProfiler()
 {
 	if (!ImGui::CollapsingHeader("Memory")) return;
 
+	if (ImGui::TreeNode("Tags")) {
+		Array<TagAllocator::Stats> tags(m_allocator);
+		TagAllocator::getStats(tags);
+		if (ImGui::BeginTable("tags", 4, ImGuiTableFlags_Sortable)) {
+			ImGui::TableSetupColumn("Tag");
+			ImGui::TableSetupColumn("Live");
+			ImGui::TableSetupColumn("Peak");
+			ImGui::TableSetupColumn("Allocations per frame", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+			ImGui::TableHeadersRow();
+
+			// churn is what we look for, so sort by allocations per frame by default
+			ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs();
+			if (specs && specs->SpecsCount > 0) {
+				const ImGuiTableColumnSortSpecs& spec = specs->Specs[0];
+				const bool desc = spec.SortDirection == ImGuiSortDirection_Descending;
+				auto key = [&](const TagAllocator::Stats& s) -> i64 {
+					switch (spec.ColumnIndex) {
+						case 1: return s.live_bytes;
+						case 2: return s.peak_bytes;
+						case 3: return s.frame_allocations;
+						default: return 0;
+					}
+				};
+				for (i32 i = 1; i < tags.size(); ++i) {
+					for (i32 j = i; j > 0; --j) {
+						const bool swap = spec.ColumnIndex == 0
+							? (compareString(tags[j - 1].tag, tags[j].tag) > 0) != desc
+							: (key(tags[j - 1]) > key(tags[j])) != desc;
+						if (!swap) break;
+						const TagAllocator::Stats tmp = tags[j];
+						tags[j] = tags[j - 1];
+						tags[j - 1] = tmp;
+					}
+				}
+			}
+
+			for (const TagAllocator::Stats& s : tags) {
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(s.tag);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3fKB", s.live_bytes / 1024.0f);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3fKB", s.peak_bytes / 1024.0f);
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", s.frame_allocations);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::TreePop();
+	}
+
 	if (m_debug_allocator) {
 		if (ImGui::Button("Refresh"))
 		{
@@ -900,6 +1413,25 @@ void ProfilerUIImpl::onGUICPUProfiler()
 	if (ImGui::BeginPopup("profiler_advanced")) {
 		if (ImGui::MenuItem("Load")) load();
 		if (ImGui::MenuItem("Save")) save();
+		if (ImGui::MenuItem("Export Chrome trace")) exportChromeTrace();
+		if (ImGui::BeginMenu("Remote")) {
+			if (m_remote) {
+				ImGui::Text(m_remote->isConnected() ? "Connected to %s" : "Disconnected from %s", m_remote_host);
+				if (ImGui::MenuItem("Disconnect")) m_remote.reset();
+			}
+			else {
+				ImGui::InputText("Host", m_remote_host, sizeof(m_remote_host));
+				ImGui::InputInt("Port", &m_remote_port);
+				if (ImGui::MenuItem("Connect")) {
+					m_remote = UniquePtr<RemoteProfiler>::create(m_allocator, m_allocator);
+					if (!m_remote->connect(m_remote_host, (u16)m_remote_port)) {
+						logError("Could not connect to remote profiler ", m_remote_host, ":", m_remote_port);
+						m_remote.reset();
+					}
+				}
+			}
+			ImGui::EndMenu();
+		}
 		ImGui::Checkbox("Show frames", &m_show_frames);
 		ImGui::Text("Zoom: %f", m_range / double(DEFAULT_RANGE));
 		if (ImGui::MenuItem("Reset zoom")) m_range = DEFAULT_RANGE;
@@ -951,6 +1483,7 @@ void ProfilerUIImpl::onGUICPUProfiler()
 	const float from_y = ImGui::GetCursorScreenPos().y;
 	const float from_x = ImGui::GetCursorScreenPos().x;
 	const float to_x = from_x + ImGui::GetContentRegionAvail().x;
+	workersUI(from_x, to_x);
 	countersUI(from_x, to_x);
 
 	ThreadContextProxy global = getGlobalThreadContextProxy();
@@ -31,6 +31,7 @@
 #include "engine/resource_manager.h"
 #include "engine/universe.h"
 #include "log_ui.h"
+#include "lz4/lz4.h"
 #include "profiler_ui.h"
 #include "property_grid.h"
 #include "settings.h"
@@ -100,6 +101,7 @@ struct StudioAppImpl final : StudioApp
 		, m_events(m_allocator)
 		, m_windows(m_allocator)
 		, m_deferred_destroy_windows(m_allocator)
+		, m_filtered_entities(m_allocator)
 		, m_file_selector(*this)
 		, m_dir_selector(*this)
 	{
@@ -313,6 +315,21 @@ struct StudioAppImpl final : StudioApp
 		m_entity_selection_changed = true;
 	}
 
+	void onUniverseCreated() {
+		Universe* universe = m_editor->getUniverse();
+		universe->entityCreated().bind<&StudioAppImpl::onEntityCreatedOrDestroyed>(this);
+		universe->entityDestroyed().bind<&StudioAppImpl::onEntityCreatedOrDestroyed>(this);
+		m_filtered_entities.clear();
+		m_filtered_entities_dirty = true;
+	}
+
+	void onUniverseDestroyed() {
+		m_filtered_entities.clear();
+		m_filtered_entities_dirty = true;
+	}
+
+	void onEntityCreatedOrDestroyed(EntityRef) { m_filtered_entities_dirty = true; }
+
 	void onInit()
 	{
 		os::Timer init_timer;
@@ -358,6 +375,9 @@ struct StudioAppImpl final : StudioApp
 		m_asset_compiler = AssetCompiler::create(*this);
 		m_editor = WorldEditor::create(*m_engine, m_allocator);
 		m_editor->entitySelectionChanged().bind<&StudioAppImpl::onEntitySelectionChanged>(this);
+		m_editor->universeCreated().bind<&StudioAppImpl::onUniverseCreated>(this);
+		m_editor->universeDestroyed().bind<&StudioAppImpl::onUniverseDestroyed>(this);
+		onUniverseCreated();
 		scanUniverses();
 		loadUserPlugins();
 		addActions();
@@ -1423,6 +1443,15 @@ struct StudioAppImpl final : StudioApp
 		bool is_any_entity_selected = !m_editor->getSelectedEntities().empty();
 		menuItem("undo", m_editor->canUndo());
 		menuItem("redo", m_editor->canRedo());
+		const WorldEditor::UndoStats undo_stats = m_editor->getUndoStats();
+		ImGui::TextDisabled("Undo history: %.1f MB", undo_stats.memory / (1024.f * 1024.f));
+		if (ImGui::IsItemHovered()) {
+			ImGui::SetTooltip("%d commands\n%.1f MB uncompressed\n%.1f MB in memory\n%.1f MB spilled to disk"
+				, undo_stats.commands
+				, undo_stats.raw_size / (1024.f * 1024.f)
+				, undo_stats.memory / (1024.f * 1024.f)
+				, undo_stats.spilled / (1024.f * 1024.f));
+		}
 		ImGui::Separator();
 		menuItem("copy", is_any_entity_selected);
 		menuItem("paste", m_editor->canPasteEntities());
@@ -1626,7 +1655,7 @@ struct StudioAppImpl final : StudioApp
 	void showHierarchy(EntityRef entity, const Array<EntityRef>& selected_entities, Span<const EntityRef> selection_chain)
 	{
 		Universe* universe = m_editor->getUniverse();
-		bool is_selected = selected_entities.indexOf(entity) >= 0;
+		bool is_selected = m_editor->isEntitySelected(entity);
 		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_AllowItemOverlap;
 		bool has_child = universe->getFirstChild(entity).isValid();
 		if (!has_child) flags = ImGuiTreeNodeFlags_Leaf;
@@ -1648,6 +1677,7 @@ struct StudioAppImpl final : StudioApp
 			if (ImGui::InputText("##renamed_val", m_rename_buf, sizeof(m_rename_buf), ImGuiInputTextFlags_EnterReturnsTrue)) {
 				m_editor->setEntityName((EntityRef)m_renaming_entity, m_rename_buf);
 				m_renaming_entity = INVALID_ENTITY;
+				m_filtered_entities_dirty = true;
 			}
 			if (ImGui::IsItemDeactivated()) {
 				m_renaming_entity = INVALID_ENTITY;
@@ -1862,22 +1892,64 @@ struct StudioAppImpl final : StudioApp
 			child_id = child.next_folder;
 		}
 
+		// consecutive collapsed entities outside of the visible area are replaced by a single dummy item,
+		// so only what's on screen (and expanded subtrees) costs anything
+		Universe& universe = *m_editor->getUniverse();
+		ImGuiWindow* window = ImGui::GetCurrentWindow();
+		const float line_height = ImGui::GetTextLineHeightWithSpacing() + ImGui::GetStyle().ItemSpacing.y;
+		const float clip_min = window->ClipRect.Min.y;
+		const float clip_max = window->ClipRect.Max.y;
+		u32 skipped_lines = 0;
+		float y = ImGui::GetCursorScreenPos().y;
+		auto flush_skipped = [&](){
+			if (skipped_lines == 0) return;
+			ImGui::Dummy(ImVec2(1, skipped_lines * line_height - ImGui::GetStyle().ItemSpacing.y));
+			skipped_lines = 0;
+		};
+
 		EntityPtr child_e = folder.first_entity;
 		while (child_e.isValid()) {
-			if (!m_editor->getUniverse()->getParent((EntityRef)child_e).isValid()) {
-				showHierarchy((EntityRef)child_e, m_editor->getSelectedEntities(), selection_chain);
+			const EntityRef e = (EntityRef)child_e;
+			child_e = folders.getNextEntity(e);
+			if (universe.getParent(e).isValid()) continue;
+
+			const bool offscreen = y + line_height < clip_min || y > clip_max;
+			if (offscreen && m_renaming_entity != e && (selection_chain.length() == 0 || selection_chain[0] != e)) {
+				const bool has_child = universe.getFirstChild(e).isValid();
+				if (!has_child || !window->DC.StateStorage->GetInt(window->GetID((void*)(intptr_t)e.index), 0)) {
+					++skipped_lines;
+					y += line_height;
+					continue;
+				}
 			}
-			child_e = folders.getNextEntity((EntityRef)child_e);
+
+			flush_skipped();
+			showHierarchy(e, m_editor->getSelectedEntities(), selection_chain);
+			y = ImGui::GetCursorScreenPos().y;
 		}
+		flush_skipped();
 
 		ImGui::TreePop();
 		ImGui::PopID();
 	}
 
+	// matching entities are cached, names are evaluated only when the filter or the set of entities changes
+	void updateFilteredEntities(const char* filter) {
+		PROFILE_FUNCTION();
+		Universe& universe = *m_editor->getUniverse();
+		m_filtered_entities.clear();
+		for (EntityPtr e = universe.getFirstEntity(); e.isValid(); e = universe.getNextEntity((EntityRef)e)) {
+			char buffer[1024];
+			getEntityListDisplayName(*this, universe, Span(buffer), e);
+			if (stristr(buffer, filter)) m_filtered_entities.push((EntityRef)e);
+		}
+		copyString(m_filtered_entities_filter, filter);
+		m_filtered_entities_dirty = false;
+	}
+
 	void onEntityListGUI()
 	{
 		PROFILE_FUNCTION();
-		const Array<EntityRef>& entities = m_editor->getSelectedEntities();
 		static char filter[64] = "";
 		if (!m_is_entity_list_open) return;
 		if (ImGui::Begin(ICON_FA_STREAM "Hierarchy##hierarchy", &m_is_entity_list_open))
@@ -1897,22 +1969,28 @@ struct StudioAppImpl final : StudioApp
 					}
 					folderUI(folders.getRoot(), folders, 0, selection_chain);
 				} else {
-					for (EntityPtr e = universe->getFirstEntity(); e.isValid(); e = universe->getNextEntity((EntityRef)e)) {
-						char buffer[1024];
-						getEntityListDisplayName(*this, *universe, Span(buffer), e);
-						if (stristr(buffer, filter) == nullptr) continue;
-						ImGui::PushID(e.index);
-						const EntityRef e_ref = (EntityRef)e;
-						bool selected = entities.indexOf(e_ref) >= 0;
-						if (ImGui::Selectable(buffer, &selected, ImGuiSelectableFlags_SpanAvailWidth)) {
-							m_editor->selectEntities(Span(&e_ref, 1), ImGui::GetIO().KeyCtrl);
-						}
-						if (ImGui::BeginDragDropSource()) {
-							ImGui::Text("%s", buffer);
-							ImGui::SetDragDropPayload("entity", &e, sizeof(e));
-							ImGui::EndDragDropSource();
+					if (m_filtered_entities_dirty || !equalStrings(m_filtered_entities_filter, filter)) {
+						updateFilteredEntities(filter);
+					}
+					ImGuiListClipper clipper;
+					clipper.Begin(m_filtered_entities.size());
+					while (clipper.Step()) {
+						for (i32 i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+							const EntityRef e = m_filtered_entities[i];
+							char buffer[1024];
+							getEntityListDisplayName(*this, *universe, Span(buffer), e);
+							ImGui::PushID(e.index);
+							bool selected = m_editor->isEntitySelected(e);
+							if (ImGui::Selectable(buffer, &selected, ImGuiSelectableFlags_SpanAvailWidth)) {
+								m_editor->selectEntities(Span(&e, 1), ImGui::GetIO().KeyCtrl);
+							}
+							if (ImGui::BeginDragDropSource()) {
+								ImGui::Text("%s", buffer);
+								ImGui::SetDragDropPayload("entity", &e, sizeof(e));
+								ImGui::EndDragDropSource();
+							}
+							ImGui::PopID();
 						}
-						ImGui::PopID();
 					}
 				}
 				ImGui::PopItemWidth();
@@ -2180,6 +2258,8 @@ struct StudioAppImpl final : StudioApp
 		m_export.dest_dir = "";
 		m_settings.getValue(Settings::LOCAL, "export_dir", Span(m_export.dest_dir.data));
 		m_settings.getValue(Settings::LOCAL, "export_pack", m_export.pack);
+		m_settings.getValue(Settings::LOCAL, "export_incremental", m_export.incremental);
+		m_settings.getValue(Settings::LOCAL, "export_load_order", m_export.load_order);
 		m_file_selector.m_current_dir = m_settings.getStringValue(Settings::LOCAL, "fileselector_dir", "");
 	}
 
@@ -3025,6 +3105,16 @@ struct StudioAppImpl final : StudioApp
 				out_info.hash = hash;
 				out_info.size = os::getFileSize(baked_path);
 				out_info.offset = ~0UL;
+
+				const Path streamed = res->getStreamedPath();
+				if (!streamed.isEmpty() && infos.find(streamed.getHash()) < 0) {
+					const StaticString<LUMIX_MAX_PATH> streamed_path(".lumix/resources/", streamed.getHash(), ".res");
+					auto& streamed_info = infos.emplace(streamed.getHash());
+					copyString(Span(streamed_info.path), streamed_path);
+					streamed_info.hash = streamed.getHash();
+					streamed_info.size = os::getFileSize(streamed_path);
+					streamed_info.offset = ~0UL;
+				}
 			}
 		}
 		exportDataScan("pipelines/", infos);
@@ -3033,6 +3123,209 @@ struct StudioAppImpl final : StudioApp
 	}
 
 
+	// order of resources in the pak, resources loaded in this session first, in the order they were loaded
+	void sortByLoadOrder(Array<u32>& order, const AssociativeArray<FilePathHash, ExportFileInfo>& infos) {
+		HashMap<FilePathHash, u64> load_times(m_allocator);
+		ResourceManagerHub& rm = m_engine->getResourceManager();
+		for (ResourceManager* manager : rm.getAll()) {
+			for (Resource* res : manager->getResourceTable()) {
+				const u64 queued = res->getLoadTimes().queued;
+				if (queued == 0) continue;
+				load_times.insert(res->getPath().getHash(), queued);
+				const Path streamed = res->getStreamedPath();
+				// streamed data are read after the resource
+				if (!streamed.isEmpty() && !load_times.find(streamed.getHash()).isValid()) load_times.insert(streamed.getHash(), queued + 1);
+			}
+		}
+
+		struct SortItem {
+			u64 key;
+			u32 idx;
+		};
+		Array<SortItem> items(m_allocator);
+		items.reserve(order.size());
+		for (u32 idx : order) {
+			auto iter = load_times.find(infos.at(idx).hash);
+			items.push({iter.isValid() ? iter.value() : ~u64(0), idx});
+		}
+		qsort(items.begin(), items.size(), sizeof(items[0]), [](const void* a, const void* b) -> i32 {
+			const SortItem& ia = *(const SortItem*)a;
+			const SortItem& ib = *(const SortItem*)b;
+			if (ia.key != ib.key) return ia.key < ib.key ? -1 : 1;
+			return ia.idx < ib.idx ? -1 : (ia.idx > ib.idx ? 1 : 0);
+		});
+		for (u32 i = 0; i < (u32)items.size(); ++i) order[i] = items[i].idx;
+	}
+
+	// with incremental export, entries unchanged since the last export keep their offsets and changed entries are appended,
+	// so patches of the pak stay small, the pak is compacted only by a full export
+	bool exportPak(const char* dest, const AssociativeArray<FilePathHash, ExportFileInfo>& infos) {
+		FileSystem& fs = m_engine->getFileSystem();
+
+		// previous pak, if we can build on it
+		HashMap<FilePathHash, PackFileEntry> prev_entries(m_allocator);
+		os::InputFile prev_file;
+		u32 table_capacity = 0;
+		u64 append_offset = 0;
+		if (m_export.incremental && prev_file.open(dest)) {
+			PackFileHeader header;
+			Array<PackFileEntry> entries(m_allocator);
+			bool valid = prev_file.read(&header, sizeof(header)) && header.magic == PackFileHeader::MAGIC && header.version == PackFileHeader::VERSION;
+			if (valid) {
+				entries.resize(header.count);
+				valid = prev_file.read(entries.begin(), entries.byte_size());
+			}
+			const u32 prev_capacity = header.table_capacity ? header.table_capacity : header.count;
+			if (valid && (u32)infos.size() <= prev_capacity) {
+				table_capacity = prev_capacity;
+				append_offset = sizeof(PackFileHeader) + u64(table_capacity) * sizeof(PackFileEntry);
+				for (const PackFileEntry& e : entries) {
+					prev_entries.insert(e.hash, e);
+					append_offset = maximum(append_offset, e.offset + e.stored_size);
+				}
+			}
+			else {
+				logInfo(dest, " can not be updated incrementally, it's rebuilt");
+				prev_file.close();
+			}
+		}
+		if (prev_entries.empty()) {
+			// room for new entries in future incremental exports
+			table_capacity = infos.size() + infos.size() / 4 + 16;
+			append_offset = sizeof(PackFileHeader) + u64(table_capacity) * sizeof(PackFileEntry);
+		}
+
+		Array<u32> order(m_allocator);
+		order.resize(infos.size());
+		for (u32 i = 0; i < (u32)infos.size(); ++i) order[i] = i;
+		if (m_export.load_order) sortByLoadOrder(order, infos);
+
+		// compressing twice is cheaper than keeping everything in memory
+		OutputMemoryStream src(m_allocator);
+		OutputMemoryStream compressed(m_allocator);
+		auto compress = [&](const ExportFileInfo& info) -> bool {
+			src.clear();
+			if (!fs.getContentSync(Path(info.path), src)) {
+				logError("Could not read ", info.path);
+				return false;
+			}
+			const i32 cap = LZ4_compressBound((i32)src.size());
+			compressed.resize(cap);
+			const i32 compressed_size = LZ4_compress_default((const char*)src.data(), (char*)compressed.getMutableData(), (i32)src.size(), cap);
+			// keep it raw if it does not save at least 1/8, e.g. already compressed resources
+			compressed.resize(compressed_size > 0 && (u64)compressed_size < src.size() - src.size() / 8 ? compressed_size : 0);
+			return true;
+		};
+
+		// entries[i] belongs to infos.at(i)
+		Array<PackFileEntry> entries(m_allocator);
+		Array<bool> is_new(m_allocator);
+		entries.resize(infos.size());
+		is_new.resize(infos.size());
+		u32 kept_count = 0;
+		for (u32 idx : order) {
+			const ExportFileInfo& info = infos.at(idx);
+			if (!compress(info)) return false;
+			const StableHash32 content_hash(src.data(), (u32)src.size());
+			auto iter = prev_entries.find(info.hash);
+			if (iter.isValid() && iter.value().content_hash == content_hash && iter.value().size == src.size()) {
+				entries[idx] = iter.value();
+				is_new[idx] = false;
+				++kept_count;
+				continue;
+			}
+			PackFileEntry& entry = entries[idx];
+			entry.hash = info.hash;
+			entry.offset = append_offset;
+			entry.size = src.size();
+			entry.stored_size = compressed.size() > 0 ? compressed.size() : src.size();
+			entry.flags = compressed.size() > 0 ? PackFileEntry::COMPRESSED : 0;
+			entry.content_hash = content_hash;
+			is_new[idx] = true;
+			append_offset += entry.stored_size;
+		}
+
+		// data are written in offset order, gaps left by removed or changed entries are zeroed
+		struct OffsetItem {
+			u64 offset;
+			u32 idx;
+		};
+		Array<OffsetItem> by_offset(m_allocator);
+		by_offset.reserve(infos.size());
+		for (u32 i = 0; i < (u32)infos.size(); ++i) by_offset.push({entries[i].offset, i});
+		qsort(by_offset.begin(), by_offset.size(), sizeof(by_offset[0]), [](const void* a, const void* b) -> i32 {
+			const u64 oa = ((const OffsetItem*)a)->offset;
+			const u64 ob = ((const OffsetItem*)b)->offset;
+			return oa < ob ? -1 : (oa > ob ? 1 : 0);
+		});
+
+		Array<PackFileEntry> sorted_entries(m_allocator);
+		sorted_entries.reserve(table_capacity);
+		for (const PackFileEntry& e : entries) sorted_entries.push(e);
+		qsort(sorted_entries.begin(), sorted_entries.size(), sizeof(sorted_entries[0]), [](const void* a, const void* b) -> i32 {
+			const FilePathHash ha = ((const PackFileEntry*)a)->hash;
+			const FilePathHash hb = ((const PackFileEntry*)b)->hash;
+			if (ha < hb) return -1;
+			return hb < ha ? 1 : 0;
+		});
+		while ((u32)sorted_entries.size() < table_capacity) sorted_entries.emplace();
+
+		const StaticString<LUMIX_MAX_PATH> tmp_path(dest, ".tmp");
+		os::OutputFile file;
+		if (!file.open(tmp_path)) {
+			logError("Could not create ", tmp_path);
+			return false;
+		}
+
+		PackFileHeader header;
+		header.count = (u32)entries.size();
+		header.table_capacity = table_capacity;
+		bool success = file.write(&header, sizeof(header));
+		success = file.write(sorted_entries.begin(), sorted_entries.byte_size()) && success;
+
+		u64 pos = sizeof(header) + sorted_entries.byte_size();
+		u64 gap_size = 0;
+		static const u8 zeros[4096] = {};
+		for (const OffsetItem& item : by_offset) {
+			const u32 idx = item.idx;
+			const PackFileEntry& entry = entries[idx];
+			ASSERT(entry.offset >= pos);
+			gap_size += entry.offset - pos;
+			while (pos < entry.offset) {
+				const u64 size = minimum(entry.offset - pos, (u64)sizeof(zeros));
+				success = file.write(zeros, size) && success;
+				pos += size;
+			}
+
+			if (is_new[idx]) {
+				if (!compress(infos.at(idx))) {
+					file.close();
+					os::deleteFile(tmp_path);
+					return false;
+				}
+				if (compressed.size() > 0) success = file.write(compressed.data(), compressed.size()) && success;
+				else success = file.write(src.data(), src.size()) && success;
+			}
+			else {
+				src.resize(entry.stored_size);
+				success = prev_file.seek(entry.offset) && prev_file.read(src.getMutableData(), src.size()) && success;
+				success = file.write(src.data(), src.size()) && success;
+			}
+			pos += entry.stored_size;
+		}
+		file.close();
+		prev_file.close();
+
+		if (!success || !os::moveFile(tmp_path, dest)) {
+			logError("Could not write ", dest);
+			os::deleteFile(tmp_path);
+			return false;
+		}
+		logInfo("Exported ", dest, ", ", kept_count, " entries kept, ", infos.size() - kept_count, " written, ", gap_size / 1024, " KB unused");
+		return true;
+	}
+
+
 	void showExportGameDialog() { m_is_export_game_dialog_open = true; }
 
 
@@ -3052,6 +3345,18 @@ struct StudioAppImpl final : StudioApp
 			if (ImGui::Checkbox("##pack", &m_export.pack)) {
 				m_settings.setValue(Settings::LOCAL, "export_pack", m_export.pack);
 			}
+			if (m_export.pack) {
+				ImGuiEx::Label("Incremental");
+				if (ImGui::Checkbox("##incremental", &m_export.incremental)) {
+					m_settings.setValue(Settings::LOCAL, "export_incremental", m_export.incremental);
+				}
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Unchanged files keep their place in the pak, uncheck to compact it");
+				ImGuiEx::Label("Load order");
+				if (ImGui::Checkbox("##load_order", &m_export.load_order)) {
+					m_settings.setValue(Settings::LOCAL, "export_load_order", m_export.load_order);
+				}
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Place files in the order they were loaded in this session, e.g. after playing the game");
+			}
 			ImGuiEx::Label("Mode");
 			if (ImGui::Combo("##mode", (int*)&m_export.mode, "All files\0Loaded universe\0")) {
 				m_settings.setValue(Settings::LOCAL, "export_pack", (i32)m_export.mode);
@@ -3104,43 +3409,7 @@ struct StudioAppImpl final : StudioApp
 				logError("No files found while trying to create ", dest);
 				return;
 			}
-			u64 total_size = 0;
-			for (ExportFileInfo& info : infos) {
-				info.offset = total_size;
-				total_size += info.size;
-			}
-			
-			os::OutputFile file;
-			if (!file.open(dest)) {
-				logError("Could not create ", dest);
-				return;
-			}
-
-			const u32 count = (u32)infos.size();
-			bool success = file.write(&count, sizeof(count));
-
-			for (auto& info : infos) {
-				success = file.write(&info.hash, sizeof(info.hash)) && success;
-				success = file.write(&info.offset, sizeof(info.offset)) && success;
-				success = file.write(&info.size, sizeof(info.size)) && success;
-			}
-
-			OutputMemoryStream src(m_allocator);
-			for (const ExportFileInfo& info : infos) {
-				src.clear();
-				if (!fs.getContentSync(Path(info.path), src)) {
-					logError("Could not read ", info.path);
-					file.close();
-					return;
-				}
-				success = file.write(src.data(), src.size()) && success;
-			}
-			file.close();
-
-			if (!success) {
-				logError("Could not write ", dest);
-				return;
-			}
+			if (!exportPak(dest, infos)) return;
 		}
 		else {
 			char dest[LUMIX_MAX_PATH];
@@ -3340,6 +3609,10 @@ struct StudioAppImpl final : StudioApp
 		Mode mode = Mode::ALL_FILES;
 
 		bool pack = false;
+		// keep offsets of unchanged pak entries
+		bool incremental = true;
+		// pak entries in the order resources were loaded in this session
+		bool load_order = false;
 		StaticString<96> startup_universe;
 		StaticString<LUMIX_MAX_PATH> dest_dir;
 	};
@@ -3359,6 +3632,9 @@ struct StudioAppImpl final : StudioApp
 	bool m_set_rename_focus = false;
 	char m_rename_buf[Universe::ENTITY_NAME_MAX_LENGTH];
 	bool m_is_f2_pressed = false;
+	Array<EntityRef> m_filtered_entities;
+	char m_filtered_entities_filter[64] = "";
+	bool m_filtered_entities_dirty = true;
 	
 	ImFont* m_font;
 	ImFont* m_big_icon_font;
@@ -12,6 +12,7 @@
 #include "engine/file_system.h"
 #include "engine/geometry.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/plugin.h"
 #include "engine/log.h"
 #include "engine/math.h"
@@ -25,7 +26,9 @@
 #include "engine/stream.h"
 #include "engine/string.h"
 #include "engine/universe.h"
+#include "engine/world_partition.h"
 #include "render_interface.h"
+#include "lz4/lz4.h"
 
 
 namespace Lumix
@@ -570,6 +573,113 @@ static void load(ComponentUID cmp, InputMemoryStream& blob)
 }
 
 
+// set by WorldEditorImpl, spilled undo payloads of this session are in `<dir>/<session>_<spill_id>.undo`
+static StaticString<LUMIX_MAX_PATH> g_undo_spill_dir;
+static u64 g_undo_spill_session = 0;
+
+static StaticString<LUMIX_MAX_PATH> getUndoSpillPath(u64 spill_id) {
+	return StaticString<LUMIX_MAX_PATH>(g_undo_spill_dir, "/", g_undo_spill_session, "_", spill_id, ".undo");
+}
+
+UndoPayload::~UndoPayload() {
+	if (state == State::SPILLED) os::deleteFile(getUndoSpillPath(spill_id));
+}
+
+static Span<u8> getPayloadData(UndoPayload& payload) {
+	if (payload.stream) return Span(payload.stream->getMutableData(), (u32)payload.stream->size());
+	return Span(payload.array->begin(), payload.array->size());
+}
+
+// replaces the data with an exactly sized copy, so the memory of the old data is released
+static void replacePayloadData(UndoPayload& payload, const void* data, u64 size, IAllocator& allocator) {
+	if (payload.stream) {
+		OutputMemoryStream tmp(payload.stream->getAllocator());
+		if (size > 0) tmp.write(data, size);
+		*payload.stream = static_cast<OutputMemoryStream&&>(tmp);
+		return;
+	}
+
+	Array<u8> tmp(allocator);
+	tmp.resize((u32)size);
+	if (size > 0) memcpy(tmp.begin(), data, size);
+	payload.array->swap(tmp);
+}
+
+static void compressPayload(UndoPayload& payload, OutputMemoryStream& scratch, IAllocator& allocator) {
+	ASSERT(payload.state == UndoPayload::State::RAW);
+	const Span<u8> raw = getPayloadData(payload);
+	const i32 bound = LZ4_compressBound((i32)raw.length());
+	scratch.resize(bound);
+	const i32 size = LZ4_compress_default((const char*)raw.begin(), (char*)scratch.getMutableData(), (i32)raw.length(), bound);
+	// not worth it
+	if (size <= 0 || (u64)size > raw.length() * 9 / 10) {
+		payload.incompressible = true;
+		return;
+	}
+	payload.raw_size = raw.length();
+	replacePayloadData(payload, scratch.data(), size, allocator);
+	payload.state = UndoPayload::State::COMPRESSED;
+}
+
+static void spillPayload(UndoPayload& payload, IAllocator& allocator) {
+	ASSERT(payload.state != UndoPayload::State::SPILLED);
+	const StaticString<LUMIX_MAX_PATH> path = getUndoSpillPath(payload.spill_id);
+	const Span<u8> data = getPayloadData(payload);
+	os::OutputFile file;
+	if (!file.open(path)) {
+		logError("Could not create ", path);
+		return;
+	}
+	const bool success = file.write(data.begin(), data.length());
+	file.close();
+	if (!success) {
+		logError("Could not write ", path);
+		os::deleteFile(path);
+		return;
+	}
+	payload.spilled_size = data.length();
+	replacePayloadData(payload, nullptr, 0, allocator);
+	payload.state = UndoPayload::State::SPILLED;
+}
+
+// brings the payload back to memory in its original form
+static void restorePayload(UndoPayload& payload, IAllocator& allocator) {
+	if (payload.state == UndoPayload::State::SPILLED) {
+		const StaticString<LUMIX_MAX_PATH> path = getUndoSpillPath(payload.spill_id);
+		os::InputFile file;
+		OutputMemoryStream tmp(allocator);
+		if (file.open(path)) {
+			tmp.resize(file.size());
+			if (!file.read(tmp.getMutableData(), tmp.size())) {
+				logError("Could not read ", path);
+				tmp.clear();
+			}
+			file.close();
+		}
+		else {
+			logError("Could not open ", path);
+		}
+		os::deleteFile(path);
+		replacePayloadData(payload, tmp.data(), tmp.size(), allocator);
+		payload.spilled_size = 0;
+		payload.state = payload.raw_size > 0 ? UndoPayload::State::COMPRESSED : UndoPayload::State::RAW;
+	}
+
+	if (payload.state == UndoPayload::State::COMPRESSED) {
+		const Span<u8> compressed = getPayloadData(payload);
+		OutputMemoryStream tmp(allocator);
+		tmp.resize(payload.raw_size);
+		const i32 size = LZ4_decompress_safe((const char*)compressed.begin(), (char*)tmp.getMutableData(), (i32)compressed.length(), (i32)tmp.size());
+		if (size != (i32)payload.raw_size) {
+			logError("Failed to decompress undo data");
+		}
+		replacePayloadData(payload, tmp.data(), tmp.size(), allocator);
+		payload.raw_size = 0;
+		payload.state = UndoPayload::State::RAW;
+	}
+}
+
+
 struct BeginGroupCommand final : IEditorCommand
 {
 	BeginGroupCommand() = default;
@@ -1012,6 +1122,7 @@ public:
 		, m_index(index)
 		, m_property(property, editor.getAllocator())
 		, m_old_values(editor.getAllocator())
+		, m_undo_payload(m_old_values)
 	{
 		save(m_component, m_old_values);
 	}
@@ -1047,12 +1158,14 @@ public:
 
 
 	bool merge(IEditorCommand&) override { return false; }
+	void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
 
 private:
 	ComponentUID m_component;
 	int m_index;
 	String m_property;
 	OutputMemoryStream m_old_values;
+	UndoPayload m_undo_payload;
 };
 
 
@@ -1157,6 +1270,7 @@ public:
 		, m_index(index)
 		, m_array(array, editor.getAllocator())
 		, m_old_values(editor.getAllocator())
+		, m_undo_payload(m_old_values)
 		, m_new_value(StoredType<T>::construct(value, editor.getAllocator()))
 	{
 		m_entities.reserve(entities.length());
@@ -1194,11 +1308,13 @@ public:
 				if (array[0] != '\0') return;
 				if (!equalIStrings(prop_name, prop.name)) return;
 				found = true;
-				for (EntityPtr entity : cmd->m_entities) {
-					const ComponentUID cmp = cmd->m_editor.getUniverse()->getComponent((EntityRef)entity, cmd->m_component_type);
-					ASSERT(prop.setter);
-					prop.set(cmp, cmd->m_index, StoredType<T>::get(cmd->m_new_value));
-				}
+				ASSERT(prop.setter);
+				reflection::PropertyAccessor<T> accessor;
+				accessor.cmp_type = cmd->m_component_type;
+				accessor.getter = prop.getter;
+				accessor.setter = prop.setter;
+				IScene* scene = cmd->m_editor.getUniverse()->getScene(cmd->m_component_type);
+				accessor.set(scene, cmd->m_entities, StoredType<T>::get(cmd->m_new_value), cmd->m_index);
 			}
 
 			void visit(const reflection::ArrayProperty& prop) override { 
@@ -1282,6 +1398,7 @@ private:
 	Array<EntityRef> m_entities;
 	typename StoredType<T>::Type m_new_value;
 	OutputMemoryStream m_old_values;
+	UndoPayload m_undo_payload;
 	String m_array;
 	int m_index;
 	String m_property_name;
@@ -1545,6 +1662,7 @@ private:
 			, m_entities(editor.getAllocator())
 			, m_transformations(editor.getAllocator())
 			, m_old_values(editor.getAllocator())
+			, m_undo_payload(m_old_values)
 			, m_resources(editor.getAllocator())
 		{
 		}
@@ -1555,6 +1673,7 @@ private:
 			, m_entities(editor.getAllocator())
 			, m_transformations(editor.getAllocator())
 			, m_old_values(editor.getAllocator())
+			, m_undo_payload(m_old_values)
 			, m_resources(editor.getAllocator())
 		{
 			m_entities.reserve(count);
@@ -1714,6 +1833,7 @@ private:
 
 
 		const char* getType() override { return "destroy_entities"; }
+		void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
 
 
 	private:
@@ -1721,6 +1841,7 @@ private:
 		Array<EntityRef> m_entities;
 		Array<Transform> m_transformations;
 		OutputMemoryStream m_old_values;
+		UndoPayload m_undo_payload;
 		Array<Resource*> m_resources;
 	};
 
@@ -1731,6 +1852,7 @@ private:
 		explicit DestroyComponentCommand(WorldEditor& editor)
 			: m_editor(static_cast<WorldEditorImpl&>(editor))
 			, m_old_values(editor.getAllocator())
+			, m_undo_payload(m_old_values)
 			, m_entities(editor.getAllocator())
 			, m_cmp_type(INVALID_COMPONENT_TYPE)
 			, m_resources(editor.getAllocator())
@@ -1742,6 +1864,7 @@ private:
 			: m_cmp_type(cmp_type)
 			, m_editor(editor)
 			, m_old_values(editor.getAllocator())
+			, m_undo_payload(m_old_values)
 			, m_entities(editor.getAllocator())
 			, m_resources(editor.getAllocator())
 		{
@@ -1811,11 +1934,14 @@ private:
 			return true;
 		}
 
+		void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
+
 	private:
 		Array<EntityRef> m_entities;
 		ComponentType m_cmp_type;
 		WorldEditorImpl& m_editor;
 		OutputMemoryStream m_old_values;
+		UndoPayload m_undo_payload;
 		Array<Resource*> m_resources;
 	};
 
@@ -1889,12 +2015,14 @@ public:
 
 		Gizmo::frame();
 		m_prefab_system->update();
+		updateUndoHistory();
 	}
 
 
 	~WorldEditorImpl()
 	{
 		destroyUniverse();
+		waitForUndoJob();
 
 		m_prefab_system.reset();
 	}
@@ -1945,6 +2073,153 @@ public:
 
 
 	bool isUniverseChanged() const override { return m_is_universe_changed; }
+	UndoStats getUndoStats() const override { return m_undo_stats; }
+
+	// -undo_budget <MB>, default 512
+	// -undo_spill, move the oldest undo history to files instead of forgetting it when over the budget
+	void initUndoHistory() {
+		char cmd_line[2048];
+		os::getCommandLine(Span(cmd_line));
+		CommandLineParser parser(cmd_line);
+		while (parser.next()) {
+			if (parser.currentEquals("-undo_spill")) {
+				m_undo_spill = true;
+			}
+			else if (parser.currentEquals("-undo_budget")) {
+				if (!parser.next()) {
+					logError("command line option '-undo_budget' without value");
+					break;
+				}
+				char tmp[16];
+				parser.getCurrent(tmp, sizeof(tmp));
+				u64 mb = 0;
+				fromCString(Span(tmp, stringLength(tmp)), mb);
+				m_undo_budget = mb * 1024 * 1024;
+			}
+		}
+
+		if (m_undo_spill) {
+			g_undo_spill_dir = m_engine.getFileSystem().getBasePath();
+			g_undo_spill_dir << ".lumix/undo";
+			g_undo_spill_session = os::Timer::getRawTimestamp();
+			if (!os::makePath(g_undo_spill_dir)) {
+				logError("Could not create ", g_undo_spill_dir, ", undo history will not be spilled");
+				m_undo_spill = false;
+			}
+		}
+	}
+
+	void waitForUndoJob() {
+		if (!m_undo_job) return;
+		jobs::wait(&m_undo_job->signal);
+		m_undo_job.reset();
+	}
+
+	void restoreUndoPayloads(IEditorCommand& command) {
+		waitForUndoJob();
+		m_undo_payloads.clear();
+		command.getUndoPayloads(m_undo_payloads);
+		for (UndoPayload* payload : m_undo_payloads) {
+			restorePayload(*payload, m_allocator);
+		}
+	}
+
+	static u64 getPayloadMemory(const UndoPayload& payload) {
+		if (payload.state == UndoPayload::State::SPILLED) return 0;
+		return payload.stream ? payload.stream->size() : payload.array->size();
+	}
+
+	// forgets the oldest commands, only whole groups are removed
+	void dropOldestUndo(u64 size_to_free) {
+		i32 depth = 0;
+		i32 count = 0;
+		u64 freed = 0;
+		for (i32 i = 0; i < m_undo_index - (i32)UNDO_KEEP_RAW; ++i) {
+			const char* type = m_undo_stack[i]->getType();
+			if (equalStrings(type, "begin_group")) ++depth;
+			else if (equalStrings(type, "end_group")) --depth;
+
+			m_undo_payloads.clear();
+			m_undo_stack[i]->getUndoPayloads(m_undo_payloads);
+			for (const UndoPayload* payload : m_undo_payloads) freed += getPayloadMemory(*payload);
+
+			if (depth == 0) {
+				count = i + 1;
+				if (freed >= size_to_free) break;
+			}
+		}
+		if (count == 0) return;
+
+		for (i32 i = count; i < m_undo_stack.size(); ++i) {
+			m_undo_stack[i - count] = m_undo_stack[i].move();
+		}
+		for (i32 i = 0; i < count; ++i) m_undo_stack.pop();
+		m_undo_index -= count;
+	}
+
+	// large payloads of commands far from the undo index are compressed in a background job,
+	// if history is still over the budget, the oldest payloads are spilled to files or forgotten
+	void updateUndoHistory() {
+		PROFILE_FUNCTION();
+		if (m_undo_job) {
+			if (!m_undo_job->done) return;
+			waitForUndoJob();
+		}
+		if (m_is_game_mode) return;
+
+		m_undo_job_items.clear();
+		m_undo_stats = {};
+		m_undo_stats.commands = m_undo_stack.size();
+		for (i32 i = 0; i < m_undo_stack.size(); ++i) {
+			const bool keep_raw = i >= m_undo_index - (i32)UNDO_KEEP_RAW && i <= m_undo_index + (i32)UNDO_KEEP_RAW;
+			m_undo_payloads.clear();
+			m_undo_stack[i]->getUndoPayloads(m_undo_payloads);
+			for (UndoPayload* payload : m_undo_payloads) {
+				const u64 memory = getPayloadMemory(*payload);
+				m_undo_stats.memory += memory;
+				m_undo_stats.spilled += payload->spilled_size;
+				m_undo_stats.raw_size += payload->raw_size > 0 ? payload->raw_size : memory + payload->spilled_size;
+				if (keep_raw || payload->state != UndoPayload::State::RAW || payload->incompressible) continue;
+				if (memory < UNDO_MIN_COMPRESS_SIZE) continue;
+				m_undo_job_items.push({payload, false});
+			}
+		}
+
+		if (m_undo_job_items.empty() && m_undo_stats.memory > m_undo_budget) {
+			if (m_undo_spill) {
+				u64 memory = m_undo_stats.memory;
+				for (i32 i = 0; i < m_undo_index - (i32)UNDO_KEEP_RAW && memory > m_undo_budget; ++i) {
+					m_undo_payloads.clear();
+					m_undo_stack[i]->getUndoPayloads(m_undo_payloads);
+					for (UndoPayload* payload : m_undo_payloads) {
+						if (payload->state == UndoPayload::State::SPILLED) continue;
+						const u64 payload_memory = getPayloadMemory(*payload);
+						if (payload_memory < UNDO_MIN_COMPRESS_SIZE) continue;
+						payload->spill_id = ++m_undo_spill_counter;
+						m_undo_job_items.push({payload, true});
+						memory -= payload_memory;
+					}
+				}
+			}
+			else {
+				dropOldestUndo(m_undo_stats.memory - m_undo_budget);
+			}
+		}
+
+		if (m_undo_job_items.empty()) return;
+
+		m_undo_job = UniquePtr<UndoJob>::create(m_allocator, m_allocator);
+		m_undo_job->items.swap(m_undo_job_items);
+		jobs::runLambda([this](){
+			PROFILE_BLOCK("compress undo history");
+			OutputMemoryStream scratch(m_allocator);
+			for (const UndoJob::Item& item : m_undo_job->items) {
+				if (item.spill) spillPayload(*item.payload, m_allocator);
+				else compressPayload(*item.payload, scratch, m_allocator);
+			}
+			m_undo_job->done = 1;
+		}, &m_undo_job->signal, jobs::ANY_WORKER, jobs::Priority::BACKGROUND);
+	}
 
 	void saveUniverse(const char* basename, bool save_path) override
 	{
@@ -1965,6 +2240,7 @@ public:
 		if (file.open(path)) {
 			save(file);
 			file.close();
+			savePartition(basename);
 		}
 		else {
 			logError("Failed to save universe ", basename);
@@ -1976,6 +2252,101 @@ public:
 	}
 
 
+	static void expandBounds(const Universe& universe, EntityRef e, DVec3& min, DVec3& max) {
+		const DVec3 pos = universe.getPosition(e);
+		min = minimum(min, pos);
+		max = maximum(max, pos);
+		for (EntityPtr child = universe.getFirstChild(e); child.isValid(); child = universe.getNextSibling((EntityRef)child)) {
+			expandBounds(universe, (EntityRef)child, min, max);
+		}
+	}
+
+	// writes data for WorldPartition, entities in the root folder are always loaded,
+	// entities in other top level folders are split into WORLD_SECTOR_SIZE cells and streamed
+	// hierarchies (e.g. prefab instances) are not split, they belong to the sector of their root
+	void savePartition(const char* basename) {
+		PROFILE_FUNCTION();
+		FileSystem& fs = m_engine.getFileSystem();
+		const StaticString<LUMIX_MAX_PATH> index_path("universes/", basename, ".lwp");
+
+		struct Sector {
+			Sector(IAllocator& allocator) : roots(allocator) {}
+			Array<EntityRef> roots;
+			DVec3 min = DVec3(DBL_MAX, DBL_MAX, DBL_MAX);
+			DVec3 max = DVec3(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+			StaticString<LUMIX_MAX_PATH> path;
+		};
+		Array<Sector> sectors(m_allocator);
+		HashMap<u64, u32> cell_to_sector(m_allocator);
+		Array<EntityRef> persistent(m_allocator);
+
+		const EntityFolders::FolderID root_folder = m_entity_folders->getRoot();
+		for (EntityPtr e = m_universe->getFirstEntity(); e.isValid(); e = m_universe->getNextEntity((EntityRef)e)) {
+			const EntityRef entity = (EntityRef)e;
+			if (m_universe->getParent(entity).isValid()) continue;
+
+			EntityFolders::FolderID folder = m_entity_folders->getFolder(entity);
+			while (folder != root_folder && m_entity_folders->getFolder(folder).parent_folder != root_folder) {
+				folder = m_entity_folders->getFolder(folder).parent_folder;
+			}
+			if (folder == root_folder) {
+				persistent.push(entity);
+				continue;
+			}
+
+			const DVec3 pos = m_universe->getPosition(entity);
+			const i32 x = (i32)floor(pos.x / WORLD_SECTOR_SIZE);
+			const i32 z = (i32)floor(pos.z / WORLD_SECTOR_SIZE);
+			const u64 key = ((u64)folder << 48) | ((u64)(x & 0xffFFff) << 24) | (u64)(z & 0xffFFff);
+			auto iter = cell_to_sector.find(key);
+			if (!iter.isValid()) {
+				iter = cell_to_sector.insert(key, sectors.size());
+				Sector& sector = sectors.emplace(m_allocator);
+				sector.path = StaticString<LUMIX_MAX_PATH>("universes/", basename, "/", folder, "_", x, "_", z, ".sct");
+			}
+			Sector& sector = sectors[iter.value()];
+			sector.roots.push(entity);
+			expandBounds(*m_universe, entity, sector.min, sector.max);
+		}
+
+		if (sectors.empty()) {
+			// universe is not partitioned anymore
+			if (fs.fileExists(index_path)) fs.deleteFile(index_path);
+			return;
+		}
+
+		const StaticString<LUMIX_MAX_PATH> dir(fs.getBasePath(), "universes/", basename);
+		if (!os::makePath(dir)) logError("Could not create directory ", dir);
+
+		OutputMemoryStream index(m_allocator);
+		index.write(WorldPartitionHeader());
+		index.write((u32)sectors.size());
+		OutputMemoryStream blob(m_allocator);
+		for (const Sector& sector : sectors) {
+			index.write(sector.min);
+			index.write(sector.max);
+			index.writeString(sector.path);
+
+			Universe& sector_universe = m_prefab_system->cloneHierarchies(sector.roots);
+			blob.clear();
+			m_engine.serialize(sector_universe, blob);
+			m_engine.destroyUniverse(sector_universe);
+			if (!fs.saveContentSync(Path(sector.path), blob)) {
+				logError("Failed to save ", sector.path);
+				return;
+			}
+		}
+
+		Universe& persistent_universe = m_prefab_system->cloneHierarchies(persistent);
+		m_engine.serialize(persistent_universe, index);
+		m_engine.destroyUniverse(persistent_universe);
+		if (!fs.saveContentSync(Path(index_path), index)) {
+			logError("Failed to save ", index_path);
+			return;
+		}
+		logInfo("Universe partitioned into ", sectors.size(), " sectors");
+	}
+
 	void save(IOutputStream& file)
 	{
 		while (m_engine.getFileSystem().hasWork()) m_engine.getFileSystem().processCallbacks();
@@ -2164,6 +2535,7 @@ public:
 
 	void beginCommandGroup(const char* type_str) override
 	{
+		waitForUndoJob();
 		const RuntimeHash type(type_str);
 		while (m_undo_index < m_undo_stack.size() - 1)
 		{
@@ -2205,6 +2577,7 @@ public:
 
 	void endCommandGroup() override
 	{
+		waitForUndoJob();
 		if (m_undo_index < m_undo_stack.size() - 1)
 		{
 			for (int i = m_undo_stack.size() - 1; i > m_undo_index; --i)
@@ -2229,8 +2602,10 @@ public:
 	void doExecute(UniquePtr<IEditorCommand>&& command)
 	{
 		m_is_universe_changed = true;
+		waitForUndoJob();
 		if (m_undo_index >= 0 && command->getType() == m_undo_stack[m_undo_index]->getType())
 		{
+			restoreUndoPayloads(*m_undo_stack[m_undo_index]);
 			if (command->merge(*m_undo_stack[m_undo_index]))
 			{
 				m_undo_stack[m_undo_index]->execute();
@@ -2279,6 +2654,7 @@ public:
 
 	void stopGameMode(bool reload)
 	{
+		waitForUndoJob();
 		for (int i = 0; i < m_game_mode_commands; ++i)
 		{
 			m_undo_stack.pop();
@@ -2591,6 +2967,8 @@ public:
 		, m_selected_entities(m_allocator)
 		, m_entity_selection_changed(m_allocator)
 		, m_undo_stack(m_allocator)
+		, m_undo_job_items(m_allocator)
+		, m_undo_payloads(m_allocator)
 		, m_copy_buffer(m_allocator)
 		, m_is_loading(false)
 		, m_universe(nullptr)
@@ -2604,13 +2982,22 @@ public:
 		logInfo("Initializing editor...");
 
 		m_prefab_system = PrefabSystem::create(*this);
+		initUndoHistory();
 		createUniverse();
 	}
 
 
+	// m_selected_entities is kept sorted, see selectEntities
 	bool isEntitySelected(EntityRef entity) const override
 	{
-		return m_selected_entities.indexOf(entity) >= 0;
+		i32 lo = 0;
+		i32 hi = m_selected_entities.size();
+		while (lo < hi) {
+			const i32 mid = (lo + hi) / 2;
+			if (m_selected_entities[mid].index < entity.index) lo = mid + 1;
+			else hi = mid;
+		}
+		return lo < m_selected_entities.size() && m_selected_entities[lo] == entity;
 	}
 
 
@@ -2660,10 +3047,12 @@ public:
 
 	static void fastRemoveDuplicates(Array<EntityRef>& entities) {
 		qsort(entities.begin(), entities.size(), sizeof(entities[0]), [](const void* a, const void* b){
-			return memcmp(a, b, sizeof(EntityRef));
+			const i32 ia = ((const EntityRef*)a)->index;
+			const i32 ib = ((const EntityRef*)b)->index;
+			return ia < ib ? -1 : (ia > ib ? 1 : 0);
 		});
 		for (i32 i = entities.size() - 2; i >= 0; --i) {
-			if (entities[i] == entities[i + 1]) entities.swapAndPop(i);
+			if (entities[i] == entities[i + 1]) entities.erase(i);
 		}
 	}
 
@@ -2692,7 +3081,7 @@ public:
 
 	void onEntityDestroyed(EntityRef entity)
 	{
-		m_selected_entities.swapAndPopItem(entity);
+		m_selected_entities.eraseItem(entity);
 	}
 
 
@@ -2728,6 +3117,7 @@ public:
 
 	void destroyUndoStack()
 	{
+		waitForUndoJob();
 		m_undo_index = -1;
 		m_undo_stack.clear();
 	}
@@ -2774,6 +3164,7 @@ public:
 			--m_undo_index;
 			while (!equalStrings(m_undo_stack[m_undo_index]->getType(), "begin_group"))
 			{
+				restoreUndoPayloads(*m_undo_stack[m_undo_index]);
 				m_undo_stack[m_undo_index]->undo();
 				--m_undo_index;
 			}
@@ -2781,6 +3172,7 @@ public:
 		}
 		else
 		{
+			restoreUndoPayloads(*m_undo_stack[m_undo_index]);
 			m_undo_stack[m_undo_index]->undo();
 			--m_undo_index;
 		}
@@ -2799,12 +3191,14 @@ public:
 			++m_undo_index;
 			while(!equalStrings(m_undo_stack[m_undo_index]->getType(), "end_group"))
 			{
+				restoreUndoPayloads(*m_undo_stack[m_undo_index]);
 				m_undo_stack[m_undo_index]->execute();
 				++m_undo_index;
 			}
 		}
 		else
 		{
+			restoreUndoPayloads(*m_undo_stack[m_undo_index]);
 			m_undo_stack[m_undo_index]->execute();
 		}
 	}
@@ -2831,6 +3225,28 @@ private:
 	int m_undo_index;
 	RuntimeHash m_current_group_type;
 
+	struct UndoJob {
+		struct Item {
+			UndoPayload* payload;
+			bool spill;
+		};
+		UndoJob(IAllocator& allocator) : items(allocator) {}
+		Array<Item> items;
+		jobs::Signal signal;
+		volatile i32 done = 0;
+	};
+	// commands this close to the undo index keep their payloads uncompressed
+	static constexpr u32 UNDO_KEEP_RAW = 8;
+	static constexpr double WORLD_SECTOR_SIZE = 256;
+	static constexpr u64 UNDO_MIN_COMPRESS_SIZE = 16 * 1024;
+	UniquePtr<UndoJob> m_undo_job;
+	Array<UndoJob::Item> m_undo_job_items;
+	Array<UndoPayload*> m_undo_payloads;
+	UndoStats m_undo_stats;
+	u64 m_undo_budget = 512 * 1024 * 1024;
+	bool m_undo_spill = false;
+	u64 m_undo_spill_counter = 0;
+
 	Array<EntityRef> m_selected_entities;
 	EntityPtr m_selected_entity_on_game_mode;
 
@@ -2850,6 +3266,7 @@ struct PasteEntityCommand final : IEditorCommand
 public:
 	PasteEntityCommand(WorldEditor& editor, const OutputMemoryStream& copy_buffer, bool identity = false)
 		: m_copy_buffer(copy_buffer)
+		, m_undo_payload(m_copy_buffer)
 		, m_editor(editor)
 		, m_entities(editor.getAllocator())
 		, m_map(editor.getAllocator())
@@ -2963,10 +3380,12 @@ public:
 
 
 	const Array<EntityRef>& getEntities() { return m_entities; }
+	void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
 
 
 private:
 	OutputMemoryStream m_copy_buffer;
+	UndoPayload m_undo_payload;
 	WorldEditor& m_editor;
 	DVec3 m_position;
 	Array<EntityRef> m_entities;
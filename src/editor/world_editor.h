@@ -13,10 +13,36 @@ namespace Lumix
 namespace os { enum class MouseButton; }
 
 template <typename T> struct Array;
+struct OutputMemoryStream;
 template <typename T> struct DelegateList;
 template <typename T> struct UniquePtr;
 
 
+// big part of command's state, used only by execute() when redoing, undo() and merge(),
+// the editor compresses it and optionally moves it to a file while the command is deep in history
+struct LUMIX_EDITOR_API UndoPayload {
+	enum class State : u8 {
+		RAW,
+		COMPRESSED,
+		SPILLED
+	};
+
+	explicit UndoPayload(OutputMemoryStream& data) : stream(&data) {}
+	explicit UndoPayload(Array<u8>& data) : array(&data) {}
+	UndoPayload(const UndoPayload&) = delete;
+	~UndoPayload();
+
+	// exactly one of these is set
+	OutputMemoryStream* stream = nullptr;
+	Array<u8>* array = nullptr;
+
+	State state = State::RAW;
+	bool incompressible = false;
+	u64 raw_size = 0; // uncompressed size, 0 if the data is not compressed
+	u64 spilled_size = 0;
+	u64 spill_id = 0;
+};
+
 struct IEditorCommand
 {
 	virtual ~IEditorCommand() {}
@@ -25,6 +51,7 @@ struct IEditorCommand
 	virtual void undo() = 0;
 	virtual const char* getType() = 0;
 	virtual bool merge(IEditorCommand& command) = 0;
+	virtual void getUndoPayloads(Array<UndoPayload*>& payloads) {}
 };
 
 struct UniverseView {
@@ -99,6 +126,13 @@ struct LUMIX_EDITOR_API WorldEditor
 	virtual void lockGroupCommand() = 0;
 	virtual void executeCommand(UniquePtr<IEditorCommand>&& command) = 0;
 	virtual bool isUniverseChanged() const = 0;
+	struct UndoStats {
+		u32 commands = 0;
+		u64 raw_size = 0; // uncompressed size of all payloads
+		u64 memory = 0; // size of payloads in memory
+		u64 spilled = 0; // size of payloads spilled to files
+	};
+	virtual UndoStats getUndoStats() const = 0;
 	virtual bool canUndo() const = 0;
 	virtual bool canRedo() const = 0;
 	virtual void undo() = 0;
@@ -1,8 +1,11 @@
 #include "engine/allocators.h"
+#include "engine/array.h"
 #include "engine/atomic.h"
 #include "engine/crt.h"
 #include "engine/math.h"
 #include "engine/os.h"
+#include "engine/profiler.h"
+#include "engine/string.h"
 #if !defined __linux__ && defined __clang__
 	#include <intrin.h>
 #endif
@@ -17,6 +20,10 @@ namespace Lumix
 	static constexpr u32 PAGE_SIZE = 4096;
 	static constexpr size_t MAX_PAGE_COUNT = 16384;
 	static constexpr u32 SMALL_ALLOC_MAX_SIZE = 64;
+	static constexpr u32 THREAD_CACHE_COUNT = 64;
+	static constexpr u32 THREAD_CACHE_CAPACITY = 32;
+	static constexpr u32 THREAD_CACHE_BATCH = THREAD_CACHE_CAPACITY / 2;
+	static constexpr u32 NO_THREAD_CACHE = 0xffFFffFF;
 
 	struct DefaultAllocator::Page {
 		struct Header {
@@ -24,6 +31,7 @@ namespace Lumix
 			Page* next;
 			u32 first_free;
 			u32 item_size;
+			u32 thread_cache; // last cache refilled from this page, to detect cross-thread frees
 		};
 		u8 data[PAGE_SIZE - sizeof(Header)];
 		Header header;
@@ -31,6 +39,61 @@ namespace Lumix
 
 	static_assert(sizeof(DefaultAllocator::Page) == PAGE_SIZE);
 
+	// accessed only by the owning thread
+	struct DefaultAllocator::ThreadCache {
+		void* items[4][THREAD_CACHE_CAPACITY];
+		u32 counts[4];
+		u64 hits;
+		u64 misses;
+		u64 cross_thread_frees;
+	};
+
+	// guards cache slots and the list of allocators, function static so it outlives global allocators
+	static Mutex& getThreadCacheMutex() {
+		static Mutex mutex;
+		return mutex;
+	}
+
+	static u64 g_used_thread_caches = 0;
+	static DefaultAllocator* g_allocators = nullptr;
+	static thread_local u32 g_thread_cache_idx = NO_THREAD_CACHE;
+
+	static void flushThreadCache(DefaultAllocator& allocator, u32 cache_idx);
+
+	// returns the thread's slot when the thread exits, so it can be reused by new threads
+	struct ThreadCacheSlot {
+		~ThreadCacheSlot() {
+			if (idx == NO_THREAD_CACHE) return;
+			MutexGuard guard(getThreadCacheMutex());
+			for (DefaultAllocator* a = g_allocators; a; a = a->m_next) {
+				flushThreadCache(*a, idx);
+			}
+			g_used_thread_caches &= ~(u64(1) << idx);
+			g_thread_cache_idx = NO_THREAD_CACHE - 1;
+		}
+
+		u32 idx = NO_THREAD_CACHE;
+	};
+
+	static thread_local ThreadCacheSlot g_thread_cache_slot;
+
+	// threads get free cache slots when they first allocate, threads above THREAD_CACHE_COUNT live threads do not use caches
+	static u32 getThreadCacheIndex() {
+		if (g_thread_cache_idx == NO_THREAD_CACHE) {
+			static_assert(THREAD_CACHE_COUNT <= sizeof(g_used_thread_caches) * 8);
+			g_thread_cache_idx = NO_THREAD_CACHE - 1;
+			MutexGuard guard(getThreadCacheMutex());
+			for (u32 i = 0; i < THREAD_CACHE_COUNT; ++i) {
+				if (g_used_thread_caches & (u64(1) << i)) continue;
+				g_used_thread_caches |= u64(1) << i;
+				g_thread_cache_idx = i;
+				g_thread_cache_slot.idx = i;
+				break;
+			}
+		}
+		return g_thread_cache_idx < THREAD_CACHE_COUNT ? g_thread_cache_idx : NO_THREAD_CACHE;
+	}
+
 	static u32 sizeToBin(size_t n) {
 		ASSERT(n > 0);
 		ASSERT(n <= SMALL_ALLOC_MAX_SIZE);
@@ -49,6 +112,7 @@ namespace Lumix
 		page->header.prev = nullptr;
 		page->header.next = nullptr;
 		page->header.item_size = item_size;
+		page->header.thread_cache = NO_THREAD_CACHE;
 
 		for (u32 i = 0; i < sizeof(page->data) / item_size; ++i) {
 			*(u32*)&page->data[i * item_size] = u32(i * item_size + item_size);
@@ -59,11 +123,11 @@ namespace Lumix
 		return (DefaultAllocator::Page*)((uintptr)ptr & ~u64(PAGE_SIZE - 1));
 	}
 
-	static void freeSmall(DefaultAllocator& allocator, void* mem) {
+	// m_mutex must be locked
+	static void freeSmallLocked(DefaultAllocator& allocator, void* mem) {
 		u8* ptr = (u8*)mem;
 		DefaultAllocator::Page* page = getPage(ptr);
 		
-		MutexGuard guard(allocator.m_mutex);
 		if (page->header.first_free + page->header.item_size > sizeof(page->data)) {
 			ASSERT(!page->header.next);
 			ASSERT(!page->header.prev);
@@ -102,11 +166,8 @@ namespace Lumix
 		return new_mem;
 	}
 
-	static void* allocSmall(DefaultAllocator& allocator, size_t n) {
-		const u32 bin = sizeToBin(n);
-
-		MutexGuard guard(allocator.m_mutex);
-
+	// m_mutex must be locked
+	static void* allocSmallLocked(DefaultAllocator& allocator, u32 bin) {
 		if (!allocator.m_small_allocations) {
 			allocator.m_small_allocations = (u8*)os::memReserve(PAGE_SIZE * MAX_PAGE_COUNT);
 		}
@@ -121,7 +182,7 @@ namespace Lumix
 		}
 
 		ASSERT(p->header.item_size > 0);
-		ASSERT(p->header.first_free + n < sizeof(p->data));
+		ASSERT(p->header.first_free + p->header.item_size <= sizeof(p->data));
 		void* res = &p->data[p->header.first_free];
 		p->header.first_free = *(u32*)res;
 
@@ -142,6 +203,82 @@ namespace Lumix
 		return res;
 	}
 
+	static void* allocSmall(DefaultAllocator& allocator, size_t n) {
+		const u32 bin = sizeToBin(n);
+		const u32 cache_idx = getThreadCacheIndex();
+		DefaultAllocator::ThreadCache* caches = allocator.m_thread_caches;
+		
+		if (caches && cache_idx != NO_THREAD_CACHE) {
+			DefaultAllocator::ThreadCache& cache = caches[cache_idx];
+			if (cache.counts[bin] > 0) {
+				++cache.hits;
+				return cache.items[bin][--cache.counts[bin]];
+			}
+
+			++cache.misses;
+			MutexGuard guard(allocator.m_mutex);
+			while (cache.counts[bin] < THREAD_CACHE_BATCH) {
+				void* mem = allocSmallLocked(allocator, bin);
+				if (!mem) break;
+				getPage(mem)->header.thread_cache = cache_idx;
+				cache.items[bin][cache.counts[bin]++] = mem;
+			}
+			if (cache.counts[bin] == 0) return nullptr;
+			return cache.items[bin][--cache.counts[bin]];
+		}
+
+		MutexGuard guard(allocator.m_mutex);
+		if (!caches) {
+			const size_t caches_size = sizeof(DefaultAllocator::ThreadCache) * THREAD_CACHE_COUNT;
+			void* mem = os::memReserve(caches_size);
+			os::memCommit(mem, caches_size);
+			memset(mem, 0, caches_size);
+			memoryBarrier();
+			allocator.m_thread_caches = (DefaultAllocator::ThreadCache*)mem;
+		}
+		return allocSmallLocked(allocator, bin);
+	}
+
+	static void freeSmall(DefaultAllocator& allocator, void* mem) {
+		const u32 cache_idx = getThreadCacheIndex();
+		DefaultAllocator::ThreadCache* caches = allocator.m_thread_caches;
+		
+		if (caches && cache_idx != NO_THREAD_CACHE) {
+			DefaultAllocator::ThreadCache& cache = caches[cache_idx];
+			DefaultAllocator::Page* page = getPage(mem);
+			if (page->header.thread_cache != cache_idx) ++cache.cross_thread_frees;
+			
+			const u32 bin = sizeToBin(page->header.item_size);
+			if (cache.counts[bin] == THREAD_CACHE_CAPACITY) {
+				++cache.misses;
+				MutexGuard guard(allocator.m_mutex);
+				for (u32 i = 0; i < THREAD_CACHE_BATCH; ++i) {
+					freeSmallLocked(allocator, cache.items[bin][--cache.counts[bin]]);
+				}
+			}
+			else {
+				++cache.hits;
+			}
+			cache.items[bin][cache.counts[bin]++] = mem;
+			return;
+		}
+
+		MutexGuard guard(allocator.m_mutex);
+		freeSmallLocked(allocator, mem);
+	}
+
+	// moves all blocks cached by a thread back to pages
+	static void flushThreadCache(DefaultAllocator& allocator, u32 cache_idx) {
+		if (!allocator.m_thread_caches) return;
+		DefaultAllocator::ThreadCache& cache = allocator.m_thread_caches[cache_idx];
+		MutexGuard guard(allocator.m_mutex);
+		for (u32 bin = 0; bin < lengthOf(cache.counts); ++bin) {
+			while (cache.counts[bin] > 0) {
+				freeSmallLocked(allocator, cache.items[bin][--cache.counts[bin]]);
+			}
+		}
+	}
+
 	static bool isSmallAlloc(DefaultAllocator& allocator, void* p) {
 		return allocator.m_small_allocations && p >= allocator.m_small_allocations && p < allocator.m_small_allocations + (PAGE_SIZE * MAX_PAGE_COUNT);
 	}
@@ -149,10 +286,32 @@ namespace Lumix
 	DefaultAllocator::DefaultAllocator() {
 		m_page_count = 0;
 		memset(m_free_lists, 0, sizeof(m_free_lists));
+		MutexGuard guard(getThreadCacheMutex());
+		m_next = g_allocators;
+		g_allocators = this;
 	}
 
 	DefaultAllocator::~DefaultAllocator() {
+		{
+			MutexGuard guard(getThreadCacheMutex());
+			DefaultAllocator** iter = &g_allocators;
+			while (*iter != this) iter = &(*iter)->m_next;
+			*iter = m_next;
+		}
 		os::memRelease(m_small_allocations, PAGE_SIZE * MAX_PAGE_COUNT);
+		if (m_thread_caches) os::memRelease(m_thread_caches, sizeof(ThreadCache) * THREAD_CACHE_COUNT);
+	}
+
+	// not synchronized with owning threads, good enough for statistics
+	DefaultAllocator::CacheStats DefaultAllocator::getCacheStats() const {
+		CacheStats res;
+		if (!m_thread_caches) return res;
+		for (u32 i = 0; i < THREAD_CACHE_COUNT; ++i) {
+			res.hits += m_thread_caches[i].hits;
+			res.misses += m_thread_caches[i].misses;
+			res.cross_thread_frees += m_thread_caches[i].cross_thread_frees;
+		}
+		return res;
 	}
 
 	void* DefaultAllocator::allocate(size_t n)
@@ -296,6 +455,257 @@ void* BaseProxyAllocator::reallocate(void* ptr, size_t size)
 	return m_source.reallocate(ptr, size);
 }
 
+static constexpr size_t TAG_HEADER_SIZE = 16;
+
+struct TagHeader {
+	u64 size;
+	u64 offset; // from the pointer returned by the source allocator to the user pointer
+};
+
+static struct {
+	Mutex& getMutex() {
+		static Mutex mutex;
+		return mutex;
+	}
+	TagAllocator* head = nullptr;
+} g_tag_allocators;
+
+TagAllocator::TagAllocator(IAllocator& source, const char* tag_literal)
+	: m_source(source)
+	, m_tag(tag_literal)
+{
+	m_bytes_counter = profiler::createCounter(StaticString<64>(tag_literal, " (KB)"), 0);
+	m_allocations_counter = profiler::createCounter(StaticString<64>(tag_literal, " allocations per frame"), 0);
+
+	MutexGuard lock(g_tag_allocators.getMutex());
+	m_next = g_tag_allocators.head;
+	if (m_next) m_next->m_prev = this;
+	g_tag_allocators.head = this;
+}
+
+TagAllocator::~TagAllocator()
+{
+	ASSERT(m_live_bytes == 0);
+	MutexGuard lock(g_tag_allocators.getMutex());
+	if (m_prev) m_prev->m_next = m_next;
+	else g_tag_allocators.head = m_next;
+	if (m_next) m_next->m_prev = m_prev;
+}
+
+void TagAllocator::onAllocate(i64 size)
+{
+	atomicIncrement(&m_frame_allocations);
+	const i64 live = atomicAdd(&m_live_bytes, size) + size;
+	for (;;) {
+		const i64 peak = m_peak_bytes;
+		if (live <= peak || compareAndExchange64(&m_peak_bytes, live, peak)) break;
+	}
+}
+
+void TagAllocator::onDeallocate(i64 size)
+{
+	atomicAdd(&m_live_bytes, -size);
+}
+
+void* TagAllocator::allocate(size_t size)
+{
+	u8* mem = (u8*)m_source.allocate(size + TAG_HEADER_SIZE);
+	if (!mem) return nullptr;
+	TagHeader* header = (TagHeader*)mem;
+	header->size = size;
+	header->offset = TAG_HEADER_SIZE;
+	onAllocate(size);
+	return mem + TAG_HEADER_SIZE;
+}
+
+void TagAllocator::deallocate(void* ptr)
+{
+	if (!ptr) return;
+	TagHeader* header = (TagHeader*)((u8*)ptr - TAG_HEADER_SIZE);
+	onDeallocate(header->size);
+	m_source.deallocate(header);
+}
+
+void* TagAllocator::reallocate(void* ptr, size_t size)
+{
+	if (!ptr) return allocate(size);
+	if (size == 0) {
+		deallocate(ptr);
+		return nullptr;
+	}
+
+	TagHeader* header = (TagHeader*)((u8*)ptr - TAG_HEADER_SIZE);
+	const i64 old_size = header->size;
+	u8* mem = (u8*)m_source.reallocate(header, size + TAG_HEADER_SIZE);
+	if (!mem) return nullptr;
+	((TagHeader*)mem)->size = size;
+	onDeallocate(old_size);
+	onAllocate(size);
+	return mem + TAG_HEADER_SIZE;
+}
+
+void* TagAllocator::allocate_aligned(size_t size, size_t align)
+{
+	const size_t offset = maximum(align, TAG_HEADER_SIZE);
+	u8* mem = (u8*)m_source.allocate_aligned(size + offset, align);
+	if (!mem) return nullptr;
+	TagHeader* header = (TagHeader*)(mem + offset - TAG_HEADER_SIZE);
+	header->size = size;
+	header->offset = offset;
+	onAllocate(size);
+	return mem + offset;
+}
+
+void TagAllocator::deallocate_aligned(void* ptr)
+{
+	if (!ptr) return;
+	TagHeader* header = (TagHeader*)((u8*)ptr - TAG_HEADER_SIZE);
+	onDeallocate(header->size);
+	m_source.deallocate_aligned((u8*)ptr - header->offset);
+}
+
+void* TagAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+	if (size == 0) {
+		deallocate_aligned(ptr);
+		return nullptr;
+	}
+
+	// same align means the same offset, so the header moves with the data
+	TagHeader* header = (TagHeader*)((u8*)ptr - TAG_HEADER_SIZE);
+	const i64 old_size = header->size;
+	const u64 offset = header->offset;
+	ASSERT(offset == maximum(align, TAG_HEADER_SIZE));
+	u8* mem = (u8*)m_source.reallocate_aligned((u8*)ptr - offset, size + offset, align);
+	if (!mem) return nullptr;
+	((TagHeader*)(mem + offset - TAG_HEADER_SIZE))->size = size;
+	onDeallocate(old_size);
+	onAllocate(size);
+	return mem + offset;
+}
+
+void TagAllocator::endFrame()
+{
+	MutexGuard lock(g_tag_allocators.getMutex());
+	for (TagAllocator* a = g_tag_allocators.head; a; a = a->m_next) {
+		a->m_last_frame_allocations = a->m_frame_allocations;
+		atomicSubtract(&a->m_frame_allocations, a->m_last_frame_allocations);
+		profiler::pushCounter(a->m_bytes_counter, float(a->m_live_bytes / 1024.0));
+		profiler::pushCounter(a->m_allocations_counter, float(a->m_last_frame_allocations));
+	}
+}
+
+void TagAllocator::getStats(Array<Stats>& stats)
+{
+	MutexGuard lock(g_tag_allocators.getMutex());
+	for (TagAllocator* a = g_tag_allocators.head; a; a = a->m_next) {
+		Stats& s = stats.emplace();
+		s.tag = a->m_tag;
+		s.live_bytes = a->m_live_bytes;
+		s.peak_bytes = a->m_peak_bytes;
+		s.frame_allocations = a->m_last_frame_allocations;
+	}
+}
+
+// tuned for luajit objects - strings, tables, closures, upvalues and small hash parts
+static const u32 LUA_SIZE_CLASSES[] = { 16, 32, 48, 64, 80, 96, 128, 192, 256, 512 };
+
+static i32 getLuaSizeClass(size_t size) {
+	if (size > LUA_SIZE_CLASSES[lengthOf(LUA_SIZE_CLASSES) - 1]) return -1;
+	i32 i = 0;
+	while (LUA_SIZE_CLASSES[i] < size) ++i;
+	return i;
+}
+
+LuaAllocator::LuaAllocator(IAllocator& source)
+	: m_source(source)
+{
+	static_assert(lengthOf(LUA_SIZE_CLASSES) == CLASS_COUNT);
+}
+
+LuaAllocator::~LuaAllocator() {
+	while (m_slabs) {
+		u8* next = *(u8**)m_slabs;
+		m_source.deallocate_aligned(m_slabs);
+		m_slabs = next;
+	}
+}
+
+void* LuaAllocator::allocate(size_t size) {
+	m_stats.allocated += size;
+	m_stats.total += size;
+	m_stats.peak = maximum(m_stats.peak, m_stats.allocated);
+
+	const i32 size_class = getLuaSizeClass(size);
+	if (size_class < 0) {
+		++m_stats.big;
+		return m_source.allocate(size);
+	}
+
+	++m_stats.pooled;
+	void* free = m_free_lists[size_class];
+	if (free) {
+		m_free_lists[size_class] = *(void**)free;
+		return free;
+	}
+
+	const u32 class_size = LUA_SIZE_CLASSES[size_class];
+	if (m_slab_pos + class_size > m_slab_end) {
+		// rest of the current slab is lost, it's less than 512B
+		u8* slab = (u8*)m_source.allocate_aligned(SLAB_SIZE, 16);
+		*(u8**)slab = m_slabs;
+		m_slabs = slab;
+		m_slab_pos = slab + 16;
+		m_slab_end = slab + SLAB_SIZE;
+		m_stats.slabs_size += SLAB_SIZE;
+	}
+	void* res = m_slab_pos;
+	m_slab_pos += class_size;
+	return res;
+}
+
+void LuaAllocator::deallocate(void* ptr, size_t size) {
+	m_stats.allocated -= size;
+	const i32 size_class = getLuaSizeClass(size);
+	if (size_class < 0) {
+		m_source.deallocate(ptr);
+		return;
+	}
+	*(void**)ptr = m_free_lists[size_class];
+	m_free_lists[size_class] = ptr;
+}
+
+void* LuaAllocator::luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+	LuaAllocator& allocator = *(LuaAllocator*)ud;
+	if (nsize == 0) {
+		if (ptr) allocator.deallocate(ptr, osize);
+		return nullptr;
+	}
+	if (!ptr) return allocator.allocate(nsize);
+
+	const i32 old_class = getLuaSizeClass(osize);
+	const i32 new_class = getLuaSizeClass(nsize);
+	if (old_class >= 0 && old_class == new_class) {
+		allocator.m_stats.allocated += nsize - osize;
+		if (nsize > osize) allocator.m_stats.total += nsize - osize;
+		allocator.m_stats.peak = maximum(allocator.m_stats.peak, allocator.m_stats.allocated);
+		return ptr;
+	}
+	if (old_class < 0 && new_class < 0) {
+		allocator.m_stats.allocated += nsize - osize;
+		if (nsize > osize) allocator.m_stats.total += nsize - osize;
+		allocator.m_stats.peak = maximum(allocator.m_stats.peak, allocator.m_stats.allocated);
+		++allocator.m_stats.big;
+		return allocator.m_source.reallocate(ptr, nsize);
+	}
+
+	void* new_ptr = allocator.allocate(nsize);
+	memcpy(new_ptr, ptr, minimum(osize, nsize));
+	allocator.deallocate(ptr, osize);
+	return new_ptr;
+}
+
 LinearAllocator::LinearAllocator(u32 reserved) {
 	m_end = 0;
 	m_commited = 0;
@@ -5,11 +5,21 @@
 
 namespace Lumix {
 
+template <typename T> struct Array;
+
 // use buckets for small allocations - relatively fast
 // fallback to system allocator for big allocations
 // use case: use this unless you really require something special
+// small allocations go through per-thread caches, so the mutex is locked only to refill or flush a cache
 struct LUMIX_ENGINE_API DefaultAllocator final : IAllocator {
 	struct Page;
+	struct ThreadCache;
+
+	struct CacheStats {
+		u64 hits = 0;
+		u64 misses = 0; // cache had to be refilled or flushed
+		u64 cross_thread_frees = 0; // freed by other thread than the one which allocated it
+	};
 
 	DefaultAllocator();
 	~DefaultAllocator();
@@ -20,11 +30,14 @@ struct LUMIX_ENGINE_API DefaultAllocator final : IAllocator {
 	void* allocate_aligned(size_t size, size_t align) override;
 	void deallocate_aligned(void* ptr) override;
 	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	CacheStats getCacheStats() const;
 
 	u8* m_small_allocations = nullptr;
+	ThreadCache* volatile m_thread_caches = nullptr;
 	Page* m_free_lists[4];
 	u32 m_page_count = 0;
 	Mutex m_mutex;
+	DefaultAllocator* m_next = nullptr; // all allocators, so exiting threads can flush their caches
 };
 
 // detects memory leaks, just by counting number of allocations - very fast
@@ -45,6 +58,47 @@ private:
 	volatile i32 m_allocation_count;
 };
 
+// tracks live bytes, peak and allocations per frame of a subsystem, shown as profiler counters and in profiler UI
+// each allocation has a 16B header with its size
+struct LUMIX_ENGINE_API TagAllocator final : IAllocator {
+	struct Stats {
+		const char* tag;
+		i64 live_bytes;
+		i64 peak_bytes;
+		i32 frame_allocations; // in the last finished frame
+	};
+
+	TagAllocator(IAllocator& source, const char* tag_literal);
+	~TagAllocator();
+
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+	IAllocator& getSourceAllocator() { return m_source; }
+
+	// pushes profiler counters of all tags and starts counting the next frame
+	static void endFrame();
+	static void getStats(Array<Stats>& stats);
+
+private:
+	void onAllocate(i64 size);
+	void onDeallocate(i64 size);
+
+	IAllocator& m_source;
+	const char* m_tag;
+	volatile i64 m_live_bytes = 0;
+	volatile i64 m_peak_bytes = 0;
+	volatile i32 m_frame_allocations = 0;
+	i32 m_last_frame_allocations = 0;
+	u32 m_bytes_counter;
+	u32 m_allocations_counter;
+	TagAllocator* m_next = nullptr;
+	TagAllocator* m_prev = nullptr;
+};
+
 // allocations in a row one after another, deallocate everything at once
 // use case: data for one frame
 struct LUMIX_ENGINE_API LinearAllocator : IAllocator {
@@ -69,6 +123,43 @@ private:
 	Mutex m_mutex;
 };
 
+// lua_Alloc for a single lua_State, blocks up to 512B come from size class pools, bigger ones from the source allocator
+// not thread safe, a lua_State is used by one thread at a time, so there is no lock
+// lua passes the old size to free and realloc, so blocks do not need headers
+struct LUMIX_ENGINE_API LuaAllocator {
+	struct Stats {
+		u64 allocated = 0; // bytes currently used by lua
+		u64 peak = 0;
+		u64 total = 0; // bytes allocated since creation, delta over a call is what the call allocated
+		u64 pooled = 0; // number of allocations served by pools
+		u64 big = 0; // number of allocations forwarded to the source allocator
+		u64 slabs_size = 0;
+	};
+
+	explicit LuaAllocator(IAllocator& source);
+	~LuaAllocator();
+	LuaAllocator(const LuaAllocator&) = delete;
+	void operator =(const LuaAllocator&) = delete;
+
+	// use as lua_Alloc with the allocator as user data
+	static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	static constexpr u32 CLASS_COUNT = 10;
+	static constexpr u32 SLAB_SIZE = 64 * 1024;
+
+	void* allocate(size_t size);
+	void deallocate(void* ptr, size_t size);
+
+	IAllocator& m_source;
+	void* m_free_lists[CLASS_COUNT] = {};
+	u8* m_slabs = nullptr; // first pointer in each slab links to the next one
+	u8* m_slab_pos = nullptr;
+	u8* m_slab_end = nullptr;
+	Stats m_stats;
+};
+
 // one allocation from local memory backing (m_mem), use fallback allocator otherwise
 // use case: StackArray<T, N> to allocate on stack
 template <u32 CAPACITY, u32 ALIGN = 8>
@@ -3,8 +3,15 @@
 #include "engine/allocator.h"
 #include "engine/crt.h"
 
+// capacity of a full array is multiplied by this (in percent) when it grows, see `array-growth` option in genie.lua
+#ifndef LUMIX_ARRAY_GROWTH_PERCENT
+	#define LUMIX_ARRAY_GROWTH_PERCENT 150
+#endif
+
 namespace Lumix {
 
+static_assert(LUMIX_ARRAY_GROWTH_PERCENT > 100, "Arrays must grow geometrically");
+
 template <typename T> struct Array {
 	explicit Array(IAllocator& allocator)
 		: m_allocator(allocator)
@@ -230,7 +237,7 @@ template <typename T> struct Array {
 			new (NewPlaceholder(), (char*)(m_data + idx)) T(static_cast<Params&&>(params)...);
 		} else {
 			if (m_size == m_capacity) {
-				u32 new_capacity = m_capacity == 0 ? 4 : m_capacity * 2;
+				const u32 new_capacity = grownCapacity();
 				T* old_data = m_data;
 				m_data = (T*)m_allocator.allocate_aligned(new_capacity * sizeof(T), alignof(T));
 				moveRange(m_data, old_data, idx);
@@ -321,7 +328,14 @@ template <typename T> struct Array {
 	u32 capacity() const { return m_capacity; }
 
 protected:
-	void grow() { reserve(m_capacity < 4 ? 4 : m_capacity + m_capacity / 2); }
+	u32 grownCapacity() const {
+		if (m_capacity < 4) return 4;
+		// small factors truncate to no growth for small capacities
+		const u32 grown = u32((u64)m_capacity * LUMIX_ARRAY_GROWTH_PERCENT / 100);
+		return grown > m_capacity ? grown : m_capacity + 1;
+	}
+
+	void grow() { reserve(grownCapacity()); }
 
 	void callDestructors(T* begin, T* end) {
 		for (; begin < end; ++begin) {
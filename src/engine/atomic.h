@@ -11,6 +11,7 @@ LUMIX_ENGINE_API i32 atomicIncrement(i32 volatile* value);
 LUMIX_ENGINE_API i32 atomicDecrement(i32 volatile* value);
 // returns the initial value
 LUMIX_ENGINE_API i32 atomicAdd(i32 volatile* addend, i32 value);
+LUMIX_ENGINE_API i64 atomicAdd(i64 volatile* addend, i64 value);
 LUMIX_ENGINE_API i32 atomicSubtract(i32 volatile* addend, i32 value);
 LUMIX_ENGINE_API bool compareAndExchange(i32 volatile* dest, i32 exchange, i32 comperand);
 LUMIX_ENGINE_API bool compareAndExchange64(i64 volatile* dest, i64 exchange, i64 comperand);
@@ -14,6 +14,11 @@ Spline::Spline(IAllocator& allocator)
 {}
 
 struct CoreSceneImpl : CoreScene {
+	enum class Version : i32 {
+		SPLINE_MESH,
+		LATEST
+	};
+
 	CoreSceneImpl(Engine& engine, IPlugin& plugin, Universe& universe)
 		: m_plugin(plugin)
 		, m_allocator(engine.getAllocator())
@@ -28,6 +33,8 @@ struct CoreSceneImpl : CoreScene {
 			serializer.write(iter.key());
 			serializer.write((u32)spline.points.size());
 			serializer.write(spline.points.begin(), spline.points.byte_size());
+			serializer.write(spline.generate_mesh);
+			serializer.write(spline.mesh_width);
 		}
 	}
 
@@ -44,14 +51,21 @@ struct CoreSceneImpl : CoreScene {
 			serializer.read(pts_count);
 			spline.points.resize(pts_count);
 			serializer.read(spline.points.begin(), spline.points.byte_size());
+			if (version > (i32)Version::SPLINE_MESH) {
+				serializer.read(spline.generate_mesh);
+				serializer.read(spline.mesh_width);
+			}
 			
 			m_splines.insert(e, static_cast<Spline&&>(spline));
 			m_universe.onComponentCreated(e, SPLINE_TYPE, this);
 		}
 	}
 
+	i32 getVersion() const override { return (i32)Version::LATEST; }
+	bool canDeserializeOnWorker() const override { return true; }
 	IPlugin& getPlugin() const override { return m_plugin; }
 	void update(float time_delta, bool paused) override {}
+	SceneUpdateAccess getUpdateAccess() const override { return {true, 0, 0}; }
 	Universe& getUniverse() override { return m_universe; }
 	void clear() override { m_splines.clear(); }
 
@@ -75,7 +89,7 @@ struct CoreSceneImpl : CoreScene {
 	static void reflect() {
 		LUMIX_SCENE(CoreSceneImpl, "core")
 			.LUMIX_CMP(Spline, "spline", "Core / Spline")
-				//.LUMIX_PROP(BoneAttachmentParent, "Parent")
+				.var_prop<&CoreScene::getSpline, &Spline::mesh_width>("Mesh width").minAttribute(0)
 			;
 	}
 
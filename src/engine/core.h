@@ -11,6 +11,9 @@ struct Vec3;
 struct Spline {
 	Spline(struct IAllocator& allocator);
 	Array<Vec3> points;
+	// editor generates a ribbon of mesh_width along the spline into procedural geometry of the same entity
+	bool generate_mesh = false;
+	float mesh_width = 4;
 };
 
 struct CoreScene : IScene {
@@ -65,4 +65,66 @@ private:
 	Array<Delegate<R(Args...)>> m_delegates;
 };
 
+// batched alternative to DelegateList for hot events, producers append events to a buffer,
+// each reader gets all events pushed since its previous read as one span, there are no per-event calls
+// events are recorded only while there are readers, readers must read regularly, e.g. every update
+template <typename T> struct EventChannel {
+	struct Reader {
+		u32 offset = 0;
+	};
+
+	explicit EventChannel(IAllocator& allocator)
+		: m_events(allocator)
+		, m_readers(allocator)
+	{}
+
+	~EventChannel() { ASSERT(m_readers.empty()); }
+
+	// events pushed before this call are not visible to the reader
+	// events are kept until every reader read them, so add readers only where they are read regularly
+	void addReader(Reader& reader) {
+		reader.offset = m_events.size();
+		m_readers.push(&reader);
+	}
+
+	void removeReader(Reader& reader) {
+		m_readers.eraseItem(&reader);
+		compact();
+	}
+
+	void push(const T& event) {
+		if (!m_readers.empty()) m_events.push(event);
+	}
+
+	void push(Span<const T> events) {
+		if (m_readers.empty() || events.length() == 0) return;
+		const u32 offset = m_events.size();
+		m_events.resize(offset + events.length());
+		memcpy(m_events.begin() + offset, events.begin(), events.length() * sizeof(T));
+	}
+
+	// the span is valid until the next push or read
+	Span<const T> read(Reader& reader) {
+		ASSERT(m_readers.indexOf(&reader) >= 0);
+		const u32 offset = reader.offset;
+		reader.offset = m_events.size();
+		const Span<const T> res(m_events.begin() + offset, m_events.end());
+		compact();
+		return res;
+	}
+
+private:
+	// buffer is reset once all readers read everything, so it does not grow while they keep up
+	void compact() {
+		for (Reader* reader : m_readers) {
+			if (reader->offset != (u32)m_events.size()) return;
+		}
+		for (Reader* reader : m_readers) reader->offset = 0;
+		m_events.clear();
+	}
+
+	Array<T> m_events;
+	Array<Reader*> m_readers;
+};
+
 } // namespace Lumix
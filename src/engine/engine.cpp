@@ -9,6 +9,7 @@
 #include "engine/plugin.h"
 #include "engine/job_system.h"
 #include "engine/log.h"
+#include "engine/lua_wrapper.h"
 #include "engine/math.h"
 #include "engine/page_allocator.h"
 #include "engine/path.h"
@@ -27,6 +28,25 @@ void registerEngineAPI(lua_State* L, Engine* engine);
 
 static const u32 SERIALIZED_ENGINE_MAGIC = 0x5f4c454e; // == '_LEN'
 static const u32 SERIALIZED_PROJECT_MAGIC = 0x5f50524c; // == '_PRL'
+static const u32 RECORDING_MAGIC = 0x5f524543; // == '_REC'
+
+
+enum class RecordingVersion : u32 {
+	INITIAL,
+
+	LATEST
+};
+
+
+enum class SerializedEngineVersion : u32 {
+	INITIAL,
+	// scenes are in length-prefixed sections
+	SCENE_SECTIONS,
+	// universe stores all entity slots, so it can be copied directly
+	DENSE_ENTITIES,
+
+	LATEST
+};
 
 
 #pragma pack(1)
@@ -67,24 +87,32 @@ public:
 
 	EngineImpl(InitArgs&& init_data, IAllocator& allocator)
 		: m_allocator(allocator)
+		, m_lua_pools(m_lua_allocator)
 		, m_prefab_resource_manager(m_allocator)
 		, m_resource_manager(m_allocator)
 		, m_lua_resources(m_allocator)
 		, m_last_lua_resource_idx(-1)
-		, m_is_game_running(false)
 		, m_smooth_time_delta(1/60.f)
 		, m_time_multiplier(1.0f)
 		, m_paused(false)
 		, m_next_frame(false)
+		, m_recording(m_allocator)
+		, m_replay(m_allocator)
+		, m_scene_update_ticks(m_allocator)
+		, m_scene_update_times(m_allocator)
 	{
 		for (float& f : m_last_time_deltas) f = 1/60.f;
+		for (u32& c : m_worker_counters) c = 0xffFFffFF;
+		m_page_allocator.setLargePages(init_data.large_pages);
 		os::init();
 		registerLogCallback<&EngineImpl::logToFile>(this);
 		registerLogCallback<logToDebugOutput>();
+		if (init_data.async_log) startAsyncLog();
 
 		os::InitWindowArgs init_win_args;
 		init_win_args.handle_file_drops = init_data.handle_file_drops;
 		init_win_args.name = init_data.window_title;
+		if (init_data.hidden_window) init_win_args.flags |= os::InitWindowArgs::HIDDEN;
 		m_window_handle = os::createWindow(init_win_args);
 		if (m_window_handle == os::INVALID_WINDOW) {
 			logError("Failed to create main window.");
@@ -105,7 +133,7 @@ public:
 
 		m_state = luaL_newstate();
 		#ifdef _WIN32
-			lua_setallocf(m_state, luaAlloc, this);
+			lua_setallocf(m_state, LuaAllocator::luaAlloc, &m_lua_pools);
 		#endif
 		luaL_openlibs(m_state);
 
@@ -115,12 +143,12 @@ public:
 			m_file_system = static_cast<UniquePtr<FileSystem>&&>(init_data.file_system);
 		}
 		else if (init_data.working_dir) {
-			m_file_system = FileSystem::create(init_data.working_dir, m_allocator);
+			m_file_system = FileSystem::create(init_data.working_dir, m_allocator, init_data.io_workers);
 		}
 		else {
 			char current_dir[LUMIX_MAX_PATH];
 			os::getCurrentDirectory(Span(current_dir)); 
-			m_file_system = FileSystem::create(current_dir, m_allocator);
+			m_file_system = FileSystem::create(current_dir, m_allocator, init_data.io_workers);
 		}
 
 		m_resource_manager.init(*m_file_system);
@@ -155,6 +183,7 @@ public:
 
 	~EngineImpl()
 	{
+		jobs::wait(&m_page_allocator_trim);
 		m_prefab_resource_manager.destroy();
 		for (Resource* res : m_lua_resources) {
 			res->decRefCount();
@@ -166,24 +195,13 @@ public:
 
 		lua_close(m_state);
 
+		stopAsyncLog();
 		unregisterLogCallback<&EngineImpl::logToFile>(this);
 		m_log_file.close();
 		m_is_log_file_open = false;
 		os::destroyWindow(m_window_handle);
 	}
 
-	static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
-		EngineImpl* engine = (EngineImpl*)ud;
-		engine->m_lua_allocated = engine->m_lua_allocated + nsize - osize;
-		if (nsize == 0) {
-			if (osize > 0) engine->m_lua_allocator.deallocate(ptr);
-			return nullptr;
-		}
-		if (!ptr) return engine->m_lua_allocator.allocate(nsize);
-
-		return engine->m_lua_allocator.reallocate(ptr, nsize);
-	}
-
 	static void logToDebugOutput(LogLevel level, const char* message)
 	{
 		if(level == LogLevel::ERROR) {
@@ -219,9 +237,23 @@ public:
 	{
 		ASSERT(prefab.isReady());
 		InputMemoryStream blob(prefab.data);
-		if (!deserialize(universe, blob, entity_map)) {
-			logError("Failed to instantiate prefab ", prefab.getPath());
-			return false;
+		if (prefab.universe_offset == 0) {
+			if (!deserialize(universe, blob, entity_map, &prefab)) {
+				logError("Failed to instantiate prefab ", prefab.getPath());
+				return false;
+			}
+		}
+		else {
+			blob.setPosition(prefab.universe_offset);
+			universe.deserialize(blob, entity_map, prefab.dense_entities);
+			Array<SceneSection> sections(m_allocator);
+			for (const PrefabResource::SceneSection& section : prefab.scene_sections) {
+				const char* name = (const char*)prefab.data.data() + section.name_offset;
+				IScene* scene = universe.getScene(name);
+				if (!scene) continue;
+				sections.push({scene, name, section.version, prefab.data.data() + section.offset, section.size});
+			}
+			deserializeScenes(universe, sections, entity_map);
 		}
 
 		ASSERT(!entity_map.m_map.empty());
@@ -273,14 +305,15 @@ public:
 	}
 
 
+	// several universes can run a game at once, plugins are started with the first one and stopped with the last one
 	void startGame(Universe& context) override
 	{
-		ASSERT(!m_is_game_running);
-		m_is_game_running = true;
+		++m_running_games_count;
 		for (UniquePtr<IScene>& scene : context.getScenes())
 		{
 			scene->startGame();
 		}
+		if (m_running_games_count > 1) return;
 		for (auto* plugin : m_plugin_manager->getPlugins())
 		{
 			plugin->startGame();
@@ -290,12 +323,13 @@ public:
 
 	void stopGame(Universe& context) override
 	{
-		ASSERT(m_is_game_running);
-		m_is_game_running = false;
+		ASSERT(m_running_games_count > 0);
+		--m_running_games_count;
 		for (UniquePtr<IScene>& scene : context.getScenes())
 		{
 			scene->stopGame();
 		}
+		if (m_running_games_count > 0) return;
 		for (auto* plugin : m_plugin_manager->getPlugins())
 		{
 			plugin->stopGame();
@@ -318,6 +352,109 @@ public:
 	}
 
 
+	void setFixedTimeDelta(float dt) override { m_fixed_time_delta = maximum(dt, 0.f); }
+
+	void startRecording() override {
+		m_recording.clear();
+		m_recording.write(RECORDING_MAGIC);
+		m_recording.write(RecordingVersion::LATEST);
+		m_is_recording = true;
+	}
+
+	void stopRecording(OutputMemoryStream& blob) override {
+		m_is_recording = false;
+		blob.write(m_recording.data(), m_recording.size());
+		m_recording.free();
+	}
+
+	bool startReplay(Span<const u8> recording) override {
+		InputMemoryStream blob(recording.begin(), recording.length());
+		if (blob.read<u32>() != RECORDING_MAGIC) {
+			logError("Not a recording");
+			return false;
+		}
+		if ((u32)blob.read<RecordingVersion>() > (u32)RecordingVersion::LATEST) {
+			logError("Unsupported recording version");
+			return false;
+		}
+		m_replay.clear();
+		m_replay.write(recording.begin(), recording.length());
+		m_replay_offset = blob.getPosition();
+		m_is_replaying = true;
+		return true;
+	}
+
+	bool isReplaying() const override { return m_is_replaying; }
+
+	// scripts use lua's generator, so it is seeded too
+	void seedRandomGenerators(u32 seed) {
+		seedRandom(seed);
+		lua_getglobal(m_state, "math");
+		lua_getfield(m_state, -1, "randomseed");
+		lua_pushinteger(m_state, seed);
+		LuaWrapper::pcall(m_state, 1, 0);
+		lua_pop(m_state, 1);
+	}
+
+	// layout of a frame: dt, seed, event count, events (type, device index, data)
+	void recordFrame(float dt) {
+		const u32 seed = (u32)os::Timer::getRawTimestamp();
+		m_recording.write(dt);
+		m_recording.write(seed);
+
+		const InputSystem::Event* events = m_input_system->getEvents();
+		const u32 count = (u32)m_input_system->getEventsCount();
+		const u64 count_offset = m_recording.size();
+		m_recording.write(count);
+		u32 recorded = 0;
+		for (u32 i = 0; i < count; ++i) {
+			const InputSystem::Event& event = events[i];
+			// devices are not added or removed during replay
+			if (event.type == InputSystem::Event::DEVICE_ADDED || event.type == InputSystem::Event::DEVICE_REMOVED) continue;
+			i32 device_idx = -1;
+			for (i32 j = 0, c = m_input_system->getDevicesCount(); j < c; ++j) {
+				if (m_input_system->getDevice(j) == event.device) device_idx = j;
+			}
+			m_recording.write(event.type);
+			m_recording.write(device_idx);
+			m_recording.write(event.data);
+			++recorded;
+		}
+		memcpy(m_recording.getMutableData() + count_offset, &recorded, sizeof(recorded));
+		seedRandomGenerators(seed);
+	}
+
+	// returns recorded time delta
+	float replayFrame() {
+		InputMemoryStream blob(m_replay);
+		blob.setPosition(m_replay_offset);
+		const float dt = blob.read<float>();
+		const u32 seed = blob.read<u32>();
+		const u32 count = blob.read<u32>();
+		m_input_system->clearEvents();
+		for (u32 i = 0; i < count; ++i) {
+			InputSystem::Event event;
+			blob.read(event.type);
+			const i32 device_idx = blob.read<i32>();
+			blob.read(event.data);
+			// devices differ from the recording session
+			if (device_idx < 0 || device_idx >= m_input_system->getDevicesCount()) continue;
+			event.device = m_input_system->getDevice(device_idx);
+			m_input_system->injectEvent(event);
+		}
+		seedRandomGenerators(seed);
+
+		m_replay_offset = blob.getPosition();
+		if (m_replay_offset >= m_replay.size()) {
+			m_is_replaying = false;
+			m_replay.free();
+			logInfo("Replay finished");
+		}
+		return dt;
+	}
+
+	Span<const SceneUpdateTime> getSceneUpdateTimes() const override { return m_scene_update_times; }
+
 	void setTimeMultiplier(float multiplier) override
 	{
 		m_time_multiplier = maximum(multiplier, 0.001f);
@@ -338,11 +475,129 @@ public:
 		profiler::pushCounter(counter, m_smooth_time_delta * 1000.f);
 	}
 
+	static bool conflicts(const SceneUpdateAccess& a, const SceneUpdateAccess& b) {
+		return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+	}
+
+	// `shared_lock` is not null if other universes are updated at the same time
+	static void updateScene(IScene& scene, float dt, bool paused, bool late, u64& ticks, jobs::Mutex* shared_lock) {
+		// scenes of different universes share their plugin, the lua state and other process-wide data,
+		// only parallel scenes which do not call scripts are known to touch nothing but their own universe
+		const SceneUpdateAccess access = scene.getUpdateAccess();
+		const bool lock = shared_lock && (!access.is_parallel || ((access.reads | access.writes) & SceneUpdateAccess::SCRIPTS));
+		if (lock) jobs::enter(shared_lock);
+		const u64 start = os::Timer::getRawTimestamp();
+		if (late) scene.lateUpdate(dt, paused);
+		else scene.update(dt, paused);
+		ticks += os::Timer::getRawTimestamp() - start;
+		if (lock) jobs::exit(shared_lock);
+	}
+
+	// consecutive parallel scenes are updated as a job graph, the rest serially in the original order
+	void updateScenes(Universe& universe, float dt, bool late, Span<u64> update_ticks, jobs::Mutex* shared_lock) {
+		Array<UniquePtr<IScene>>& scenes = universe.getScenes();
+		const bool paused = m_paused;
+		u32 i = 0;
+		while (i < (u32)scenes.size()) {
+			IScene* scene = scenes[i].get();
+			if (!scene->getUpdateAccess().is_parallel) {
+				updateScene(*scene, dt, paused, late, update_ticks[i], shared_lock);
+				++i;
+				continue;
+			}
+
+			const u32 begin = i;
+			while (i < (u32)scenes.size() && scenes[i]->getUpdateAccess().is_parallel) ++i;
+			if (i - begin == 1) {
+				updateScene(*scene, dt, paused, late, update_ticks[begin], shared_lock);
+				continue;
+			}
+
+			jobs::Graph graph(m_allocator);
+			for (u32 j = begin; j < i; ++j) {
+				IScene* s = scenes[j].get();
+				// every scene has its own slot, so parallel updates do not race
+				u64* ticks = &update_ticks[j];
+				const u32 node = graph.addLambda([s, dt, paused, late, ticks, shared_lock](){
+					updateScene(*s, dt, paused, late, *ticks, shared_lock);
+				});
+				const SceneUpdateAccess access = s->getUpdateAccess();
+				for (u32 k = begin; k < j; ++k) {
+					if (conflicts(access, scenes[k]->getUpdateAccess())) {
+						graph.addDependency(node, k - begin);
+					}
+				}
+			}
+			jobs::Signal signal;
+			graph.run(&signal);
+			jobs::wait(&signal);
+		}
+	}
+
+	void updateUniverse(Universe& universe, float dt, Span<u64> update_ticks, jobs::Mutex* shared_lock) {
+		{
+			PROFILE_BLOCK("update scenes");
+			updateScenes(universe, dt, false, update_ticks, shared_lock);
+		}
+		{
+			PROFILE_BLOCK("late update scenes");
+			updateScenes(universe, dt, true, update_ticks, shared_lock);
+		}
+		universe.flushTransforms();
+	}
+
+	void pushJobStats(float frame_time) {
+		const jobs::Stats job_stats = jobs::getStats(true);
+		static u32 local_pushes_counter = profiler::createCounter("Jobs pushed to local queue", 0);
+		static u32 global_pushes_counter = profiler::createCounter("Jobs pushed to global queue", 0);
+		static u32 steals_counter = profiler::createCounter("Jobs stolen", 0);
+		static u32 steal_contentions_counter = profiler::createCounter("Job steal contentions", 0);
+		static u32 queued_counter = profiler::createCounter("Jobs queued", 0);
+		static u32 fiber_switches_counter = profiler::createCounter("Fiber switches", 0);
+		static u32 waits_counter = profiler::createCounter("Job waits", 0);
+		static u32 wait_time_counter = profiler::createCounter("Job wait time (ms)", 0);
+		static u32 fibers_counter = profiler::createCounter("Fibers created", 0);
+		profiler::pushCounter(local_pushes_counter, (float)job_stats.local_pushes);
+		profiler::pushCounter(global_pushes_counter, (float)job_stats.global_pushes);
+		profiler::pushCounter(steals_counter, (float)job_stats.steals);
+		profiler::pushCounter(steal_contentions_counter, (float)job_stats.steal_contentions);
+		profiler::pushCounter(queued_counter, (float)job_stats.queued);
+		profiler::pushCounter(fiber_switches_counter, (float)job_stats.fiber_switches);
+		profiler::pushCounter(waits_counter, (float)job_stats.waits);
+		profiler::pushCounter(wait_time_counter, job_stats.wait_ms);
+		profiler::pushCounter(fibers_counter, (float)job_stats.fibers_created);
+
+		// profiler UI shows counters with this prefix as worker timeline
+		const u8 workers_count = minimum(jobs::getWorkersCount(), (u8)lengthOf(m_worker_counters));
+		for (u8 i = 0; i < workers_count; ++i) {
+			if (m_worker_counters[i] == 0xffFFffFF) {
+				m_worker_counters[i] = profiler::createCounter(StaticString<64>(profiler::WORKER_UTILIZATION_COUNTER_PREFIX, i), 0);
+			}
+			const float idle = jobs::getWorkerIdleTime(i, true);
+			const float utilization = frame_time > 0 ? clamp(1 - idle / frame_time, 0.f, 1.f) : 0;
+			profiler::pushCounter(m_worker_counters[i], utilization * 100);
+		}
+	}
+
 	void update(Universe& context) override
+	{
+		Universe* universe = &context;
+		update(Span(&universe, 1));
+	}
+
+	void update(Span<Universe*> universes) override
 	{
 		PROFILE_FUNCTION();
+		jobs::nextFrame();
+
 		static u32 lua_mem_counter = profiler::createCounter("Lua Memory (KB)", 0);
-		profiler::pushCounter(lua_mem_counter, float(double(m_lua_allocated) / 1024.0));
+		profiler::pushCounter(lua_mem_counter, (float)lua_gc(m_state, LUA_GCCOUNT, 0));
+		#ifdef _WIN32
+			static u32 lua_peak_counter = profiler::createCounter("Lua Memory peak (KB)", 0);
+			static u32 lua_big_counter = profiler::createCounter("Lua big allocations", 0);
+			profiler::pushCounter(lua_peak_counter, float(double(m_lua_pools.getStats().peak) / 1024.0));
+			profiler::pushCounter(lua_big_counter, float(m_lua_pools.getStats().big));
+		#endif
 
 		if (m_allocator.isDebug()) {
 			debug::Allocator& a = (debug::Allocator&)m_allocator;
@@ -350,6 +605,25 @@ public:
 			profiler::pushCounter(mem_counter, float(double(a.getTotalSize()) / (1024.0 * 1024.0)));
 		}
 
+		// cache stats are cumulative, push only this frame's part
+		const DefaultAllocator::CacheStats lua_alloc_stats = m_lua_allocator.getCacheStats();
+		static u32 lua_alloc_hits_counter = profiler::createCounter("Lua allocator cache hits", 0);
+		static u32 lua_alloc_cross_thread_counter = profiler::createCounter("Lua allocator cross-thread frees", 0);
+		profiler::pushCounter(lua_alloc_hits_counter, float(lua_alloc_stats.hits - m_last_lua_alloc_stats.hits));
+		profiler::pushCounter(lua_alloc_cross_thread_counter, float(lua_alloc_stats.cross_thread_frees - m_last_lua_alloc_stats.cross_thread_frees));
+		m_last_lua_alloc_stats = lua_alloc_stats;
+
+		TagAllocator::endFrame();
+
+		// free pages above the watermark are returned to OS in background
+		static constexpr u32 PAGE_ALLOCATOR_WATERMARK = 2048;
+		if (m_page_allocator.getFreeCount() > PAGE_ALLOCATOR_WATERMARK && m_page_allocator_trim.counter == 0) {
+			jobs::runLambda([this](){
+				PROFILE_BLOCK("trim page allocator");
+				m_page_allocator.trim(PAGE_ALLOCATOR_WATERMARK);
+			}, &m_page_allocator_trim, jobs::ANY_WORKER, jobs::Priority::BACKGROUND);
+		}
+
 		const float reserved_pages_size = (m_page_allocator.getReservedCount() * PageAllocator::PAGE_SIZE) / (1024.f * 1024.f);
 		static u32 page_allocator_counter = profiler::createCounter("Page allocator (MB)", 0);
 		profiler::pushCounter(page_allocator_counter , reserved_pages_size);
@@ -360,12 +634,16 @@ public:
 			profiler::pushCounter(process_mem_counter, process_mem);
 		#endif
 
-		float dt = m_timer.tick() * m_time_multiplier;
+		const float frame_time = m_timer.tick();
+		pushJobStats(frame_time);
+		float dt = (m_fixed_time_delta > 0 ? m_fixed_time_delta : frame_time) * m_time_multiplier;
 		if (m_next_frame)
 		{
 			m_paused = false;
 			dt = 1 / 30.0f;
 		}
+		if (m_is_replaying) dt = replayFrame();
+		else if (m_is_recording) recordFrame(dt);
 		++m_last_time_deltas_frame;
 		m_last_time_deltas[m_last_time_deltas_frame % lengthOf(m_last_time_deltas)] = dt;
 		static u32 counter = profiler::createCounter("Raw time delta (ms)", 0);
@@ -373,23 +651,33 @@ public:
 
 		computeSmoothTimeDelta();
 
-		{
-			PROFILE_BLOCK("update scenes");
-			for (UniquePtr<IScene>& scene : context.getScenes())
-			{
-				scene->update(dt, m_paused);
-			}
+		// all universes have the same scenes, since they are created by the same plugins
+		const u32 universes_count = universes.length();
+		const u32 scenes_count = universes_count > 0 ? universes[0]->getScenes().size() : 0;
+		m_scene_update_ticks.resize(scenes_count * universes_count);
+		for (u64& ticks : m_scene_update_ticks) ticks = 0;
+		if (universes_count == 1) {
+			updateUniverse(*universes[0], dt, m_scene_update_ticks, nullptr);
 		}
-		{
-			PROFILE_BLOCK("late update scenes");
-			for (UniquePtr<IScene>& scene : context.getScenes())
-			{
-				scene->lateUpdate(dt, m_paused);
-			}
+		else if (universes_count > 1) {
+			PROFILE_BLOCK("update universes");
+			jobs::forEach(universes_count, 1, [&](i32 idx, i32){
+				Span<u64> ticks(m_scene_update_ticks.begin() + idx * scenes_count, scenes_count);
+				updateUniverse(*universes[idx], dt, ticks, &m_shared_update_mutex);
+			});
+		}
+		m_scene_update_times.resize(scenes_count);
+		for (u32 i = 0; i < scenes_count; ++i) {
+			u64 ticks = 0;
+			for (u32 j = 0; j < universes_count; ++j) ticks += m_scene_update_ticks[j * scenes_count + i];
+			m_scene_update_times[i].name = universes[0]->getScenes()[i]->getPlugin().getName();
+			m_scene_update_times[i].ms = float(ticks / double(os::Timer::getFrequency()) * 1000);
 		}
 		m_plugin_manager->update(dt, m_paused);
 		m_input_system->update(dt);
 		m_file_system->processCallbacks();
+		m_resource_manager.update();
+		LuaWrapper::stepGC(m_state, LuaWrapper::getGCBudget(frame_time));
 
 		if (m_next_frame)
 		{
@@ -479,7 +767,7 @@ public:
 	{
 		SerializedEngineHeader header;
 		header.magic = SERIALIZED_ENGINE_MAGIC; // == '_LEN'
-		header.version = 0;
+		header.version = u32(SerializedEngineVersion::LATEST) - 1;
 		serializer.write(header);
 		serializePluginList(serializer);
 		ctx.serialize(serializer);
@@ -487,12 +775,67 @@ public:
 		for (UniquePtr<IScene>& scene : ctx.getScenes()) {
 			serializer.writeString(scene->getPlugin().getName());
 			serializer.write(scene->getVersion());
+			const u64 size_offset = serializer.size();
+			serializer.write(u64(0));
 			scene->serialize(serializer);
+			const u64 section_size = serializer.size() - size_offset - sizeof(u64);
+			memcpy(serializer.getMutableData() + size_offset, &section_size, sizeof(section_size));
 		}
 	}
 
 
+	struct SceneSection {
+		IScene* scene;
+		const char* name;
+		i32 version;
+		const u8* data;
+		u64 size;
+	};
+
+	static void deserializeScene(const SceneSection& section, const EntityMap& entity_map) {
+		InputMemoryStream blob(section.data, section.size);
+		section.scene->deserialize(blob, entity_map, section.version);
+		// the next scene is still read correctly
+		if (blob.getPosition() != section.size) logWarning("Scene ", section.name, " did not read all its data");
+	}
+
+	// scenes which can be deserialized on a worker are, while the other scenes are deserialized here in order
+	void deserializeScenes(Universe& universe, Span<const SceneSection> sections, const EntityMap& entity_map) {
+		PROFILE_FUNCTION();
+		Array<IScene*> worker_scenes(m_allocator);
+		for (const SceneSection& section : sections) {
+			if (section.scene->canDeserializeOnWorker()) worker_scenes.push(section.scene);
+		}
+
+		jobs::Signal signal;
+		if (!worker_scenes.empty()) {
+			universe.beginDeferredComponents(worker_scenes);
+			for (const SceneSection& section : sections) {
+				if (!section.scene->canDeserializeOnWorker()) continue;
+				jobs::runLambda([&section, &entity_map](){
+					PROFILE_BLOCK("deserialize scene");
+					deserializeScene(section, entity_map);
+				}, &signal);
+			}
+		}
+
+		for (const SceneSection& section : sections) {
+			if (!section.scene->canDeserializeOnWorker()) deserializeScene(section, entity_map);
+		}
+
+		if (!worker_scenes.empty()) {
+			jobs::wait(&signal);
+			universe.endDeferredComponents();
+		}
+	}
+
 	bool deserialize(Universe& ctx, InputMemoryStream& serializer, EntityMap& entity_map) override
+	{
+		return deserialize(ctx, serializer, entity_map, nullptr);
+	}
+
+	// if prefab is not null, positions of universe and scene sections are stored in it
+	bool deserialize(Universe& ctx, InputMemoryStream& serializer, EntityMap& entity_map, const PrefabResource* prefab)
 	{
 		SerializedEngineHeader header;
 		serializer.read(header);
@@ -501,17 +844,49 @@ public:
 			logError("Wrong or corrupted file");
 			return false;
 		}
+		if (header.version >= (u32)SerializedEngineVersion::LATEST) {
+			logError("Unsupported version");
+			return false;
+		}
 		if (!hasSerializedPlugins(serializer)) return false;
 
-		ctx.deserialize(serializer, entity_map);
+		const u64 universe_offset = serializer.getPosition();
+		const bool dense_entities = header.version >= (u32)SerializedEngineVersion::DENSE_ENTITIES;
+		ctx.deserialize(serializer, entity_map, dense_entities);
 		i32 scene_count;
 		serializer.read(scene_count);
+		const bool has_sections = header.version >= (u32)SerializedEngineVersion::SCENE_SECTIONS;
+		if (prefab) prefab->scene_sections.clear();
+		Array<SceneSection> sections(m_allocator);
 		for (int i = 0; i < scene_count; ++i)
 		{
+			const u32 name_offset = (u32)serializer.getPosition();
 			const char* tmp = serializer.readString();
 			IScene* scene = ctx.getScene(tmp);
 			const i32 version = serializer.read<i32>();
-			scene->deserialize(serializer, entity_map, version);
+			if (!has_sections) {
+				scene->deserialize(serializer, entity_map, version);
+				continue;
+			}
+
+			const u64 section_size = serializer.read<u64>();
+			if (serializer.getPosition() + section_size > serializer.size()) {
+				logError("Wrong or corrupted file");
+				return false;
+			}
+			if (prefab) prefab->scene_sections.push({name_offset, version, serializer.getPosition(), section_size});
+			const u8* data = (const u8*)serializer.skip(section_size);
+			if (!scene) {
+				logWarning("Skipping unknown scene ", tmp);
+				continue;
+			}
+			sections.push({scene, tmp, version, data, section_size});
+		}
+		deserializeScenes(ctx, sections, entity_map);
+		// old files without sections are always fully deserialized
+		if (prefab && has_sections) {
+			prefab->universe_offset = universe_offset;
+			prefab->dense_entities = dense_entities;
 		}
 		return true;
 	}
@@ -550,13 +925,23 @@ public:
 	InputSystem& getInputSystem() override { return *m_input_system; }
 	ResourceManagerHub& getResourceManager() override { return m_resource_manager; }
 	lua_State* getState() override { return m_state; }
+
+	LuaAllocator* getLuaAllocator() override {
+		#ifdef _WIN32
+			return &m_lua_pools;
+		#else
+			return nullptr;
+		#endif
+	}
 	float getLastTimeDelta() const override { return m_smooth_time_delta / m_time_multiplier; }
 
 private:
 	IAllocator& m_allocator;
 	// lua callstacks are incomplete and they polute memory report if using main allocator 
 	DefaultAllocator m_lua_allocator; 
-	size_t m_lua_allocated = 0;
+	DefaultAllocator::CacheStats m_last_lua_alloc_stats;
+	// lua_setallocf is used only on windows, other luajit builds need memory from the low 2GB
+	LuaAllocator m_lua_pools;
 	PageAllocator m_page_allocator;
 	UniquePtr<FileSystem> m_file_system;
 	ResourceManagerHub m_resource_manager;
@@ -564,11 +949,20 @@ private:
 	PrefabResourceManager m_prefab_resource_manager;
 	UniquePtr<InputSystem> m_input_system;
 	os::Timer m_timer;
+	u32 m_worker_counters[64];
 	float m_time_multiplier;
+	float m_fixed_time_delta = 0;
+	OutputMemoryStream m_recording;
+	bool m_is_recording = false;
+	OutputMemoryStream m_replay;
+	u64 m_replay_offset = 0;
+	bool m_is_replaying = false;
+	Array<u64> m_scene_update_ticks;
+	Array<SceneUpdateTime> m_scene_update_times;
 	float m_last_time_deltas[11] = {};
 	u32 m_last_time_deltas_frame = 0;
 	float m_smooth_time_delta;
-	bool m_is_game_running;
+	u32 m_running_games_count = 0;
 	bool m_paused;
 	bool m_next_frame;
 	os::WindowHandle m_window_handle;
@@ -576,6 +970,9 @@ private:
 	os::OutputFile m_log_file;
 	bool m_is_log_file_open = false;
 	HashMap<int, Resource*> m_lua_resources;
+	// held by updates of scenes which can touch data shared by universes, see updateScene
+	jobs::Mutex m_shared_update_mutex;
+	jobs::Signal m_page_allocator_trim;
 	u32 m_last_lua_resource_idx;
 };
 
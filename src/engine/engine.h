@@ -22,12 +22,21 @@ struct LUMIX_ENGINE_API Engine {
 		const char* working_dir = nullptr;
 		Span<const char*> plugins;
 		bool handle_file_drops = false;
+		bool large_pages = false; // back page allocator with large pages
+		u32 io_workers = 2; // threads reading files, used if file_system is not provided
 		const char* window_title = "Lumix App";
+		bool hidden_window = false;
+		bool async_log = true; // pass log messages to callbacks (log file, ...) on a background thread
 		UniquePtr<struct FileSystem> file_system; 
 	};
 
 	using LuaResourceHandle = u32;
 
+	struct SceneUpdateTime {
+		const char* name; // name of scene's plugin
+		float ms; // update and late update
+	};
+
 	virtual ~Engine() {}
 
 	static UniquePtr<Engine> create(InitArgs&& init_data, struct IAllocator& allocator);
@@ -53,16 +62,32 @@ struct LUMIX_ENGINE_API Engine {
 	virtual void stopGame(Universe& context) = 0;
 
 	virtual void update(Universe& context) = 0;
+	// updates independent universes (e.g. match instances on a server) in one frame, each universe is updated as its own job,
+	// process-wide systems (file system, resources, plugins, lua GC) are updated once
+	virtual void update(Span<Universe*> universes) = 0;
 	virtual void serialize(Universe& ctx, struct OutputMemoryStream& serializer) = 0;
 	virtual bool deserialize(Universe& ctx, struct InputMemoryStream& serializer, struct EntityMap& entity_map) = 0;
 	[[nodiscard]] virtual DeserializeProjectResult deserializeProject(InputMemoryStream& serializer, Span<char> startup_universe) = 0;
 	virtual void serializeProject(OutputMemoryStream& serializer, const char* startup_universe) const = 0;
 	virtual float getLastTimeDelta() const = 0;
 	virtual void setTimeMultiplier(float multiplier) = 0;
+	// every update uses this time delta instead of measured one, 0 disables it
+	virtual void setFixedTimeDelta(float dt) = 0;
+	// records time delta, random seed and input events of every update
+	virtual void startRecording() = 0;
+	virtual void stopRecording(struct OutputMemoryStream& blob) = 0;
+	// following updates use time deltas, random seeds and input events from a recording instead of live ones
+	[[nodiscard]] virtual bool startReplay(Span<const u8> recording) = 0;
+	// true while there are frames left in the replayed recording
+	virtual bool isReplaying() const = 0;
+	// CPU time of each scene of the universe in the last update, summed over all universes if there are more
+	virtual Span<const SceneUpdateTime> getSceneUpdateTimes() const = 0;
 	virtual void pause(bool pause) = 0;
 	virtual bool isPaused() const = 0;
 	virtual void nextFrame() = 0;
 	virtual lua_State* getState() = 0;
+	// null if the state uses lua's default allocator
+	virtual struct LuaAllocator* getLuaAllocator() = 0;
 
 	virtual struct Resource* getLuaResource(LuaResourceHandle idx) const = 0;
 	virtual LuaResourceHandle addLuaResource(const struct Path& path, struct ResourceType type) = 0;
@@ -2,6 +2,7 @@
 
 #include "engine/allocator.h"
 #include "engine/array.h"
+#include "engine/crt.h"
 #include "engine/delegate_list.h"
 #include "engine/flag_set.h"
 #include "engine/hash_map.h"
@@ -14,24 +15,74 @@
 #include "engine/profiler.h"
 #include "engine/stream.h"
 #include "engine/string.h"
+#include "lz4/lz4.h"
 
 namespace Lumix {
 
+struct BatchRequest {
+	BatchRequest(IAllocator& allocator)
+		: allocator(allocator)
+		, paths(allocator)
+		, buffers(allocator)
+		, contents(allocator)
+	{}
+
+	IAllocator& allocator;
+	Array<Path> paths;
+	Array<OutputMemoryStream> buffers;
+	Array<FileSystem::Content> contents;
+	FileSystem::BatchCallback callback;
+};
+
+
 struct AsyncItem {
 	enum class Flags : u32 {
 		FAILED = 1 << 0,
 		CANCELED = 1 << 1,
+		IN_PROGRESS = 1 << 2,
 	};
 
 	AsyncItem(IAllocator& allocator) : data(allocator) {}
+
+	AsyncItem(AsyncItem&& rhs)
+		: callback(rhs.callback)
+		, data(static_cast<OutputMemoryStream&&>(rhs.data))
+		, mapped(rhs.mapped)
+		, mapped_size(rhs.mapped_size)
+		, batch(rhs.batch)
+		, path(rhs.path)
+		, range_offset(rhs.range_offset)
+		, range_size(rhs.range_size)
+		, id(rhs.id)
+		, times(rhs.times)
+		, priority(rhs.priority)
+		, flags(rhs.flags)
+	{
+		rhs.batch = nullptr;
+	}
+
+	~AsyncItem() {
+		if (batch) LUMIX_DELETE(batch->allocator, batch);
+	}
 	
 	bool isFailed() const { return flags.isSet(Flags::FAILED); }
 	bool isCanceled() const { return flags.isSet(Flags::CANCELED); }
+	bool isInProgress() const { return flags.isSet(Flags::IN_PROGRESS); }
 
 	FileSystem::ContentCallback callback;
 	OutputMemoryStream data;
+	// content not owned by the item, e.g. memory mapped pak, used instead of data if not null
+	const u8* mapped = nullptr;
+	u64 mapped_size = 0;
+	// owned, getContents request, path and callback are not used
+	BatchRequest* batch = nullptr;
 	StaticString<LUMIX_MAX_PATH> path;
+	// getContentRange request if range_size > 0
+	u64 range_offset = 0;
+	u64 range_size = 0;
 	u32 id = 0;
+	FileSystem::IOTimes times;
+	FileSystem::Priority priority = FileSystem::Priority::NORMAL;
 	FlagSet<Flags, u32> flags;
 };
 
@@ -47,32 +98,40 @@ struct FSTask final : Thread {
 
 	~FSTask() = default;
 
-	void stop();
 	int task() override;
 
 private:
 	FileSystemImpl& m_fs;
-	bool m_finish = false;
 };
 
 
 struct FileSystemImpl : FileSystem {
-	explicit FileSystemImpl(const char* base_path, IAllocator& allocator)
+	FileSystemImpl(const char* base_path, u32 io_workers, IAllocator& allocator)
 		: m_allocator(allocator)
+		, m_tasks(allocator)
 		, m_queue(allocator)	
 		, m_finished(allocator)	
 		, m_last_id(0)
 		, m_semaphore(0, 0xffFF)
 	{
 		setBasePath(base_path);
-		m_task.create(*this, m_allocator);
-		m_task->create("Filesystem", true);
+		if (io_workers == 0) io_workers = 1;
+		for (u32 i = 0; i < io_workers; ++i) {
+			FSTask* task = LUMIX_NEW(m_allocator, FSTask)(*this, m_allocator);
+			task->create("Filesystem", true);
+			m_tasks.push(task);
+		}
 	}
 
 	~FileSystemImpl() override {
-		m_task->stop();
-		m_task->destroy();
-		m_task.destroy();
+		m_finish = true;
+		for (u32 i = 0; i < (u32)m_tasks.size(); ++i) {
+			m_semaphore.signal();
+		}
+		for (FSTask* task : m_tasks) {
+			task->destroy();
+			LUMIX_DELETE(m_allocator, task);
+		}
 	}
 
 
@@ -118,7 +177,7 @@ struct FileSystemImpl : FileSystem {
 		return true;
 	}
 
-	AsyncHandle getContent(const Path& file, const ContentCallback& callback) override
+	AsyncHandle getContent(const Path& file, const ContentCallback& callback, Priority priority) override
 	{
 		if (file.isEmpty()) return AsyncHandle::invalid();
 
@@ -128,12 +187,116 @@ struct FileSystemImpl : FileSystem {
 		++m_last_id;
 		if (m_last_id == 0) ++m_last_id;
 		item.id = m_last_id;
+		item.times.queued = os::Timer::getRawTimestamp();
+		item.path = file.c_str();
+		item.callback = callback;
+		item.priority = priority;
+		m_semaphore.signal();
+		return AsyncHandle(item.id);
+	}
+
+
+	AsyncHandle getContentRange(const Path& file, u64 offset, u64 size, const ContentCallback& callback, Priority priority) override
+	{
+		if (file.isEmpty() || size == 0) return AsyncHandle::invalid();
+
+		MutexGuard lock(m_mutex);
+		++m_work_counter;
+		AsyncItem& item = m_queue.emplace(m_allocator);
+		++m_last_id;
+		if (m_last_id == 0) ++m_last_id;
+		item.id = m_last_id;
+		item.times.queued = os::Timer::getRawTimestamp();
 		item.path = file.c_str();
+		item.range_offset = offset;
+		item.range_size = size;
 		item.callback = callback;
+		item.priority = priority;
+		m_semaphore.signal();
+		return AsyncHandle(item.id);
+	}
+
+	virtual bool getContentRangeSync(const Path& path, u64 offset, u64 size, OutputMemoryStream& content) {
+		os::InputFile file;
+		StaticString<LUMIX_MAX_PATH> full_path(m_base_path, path.c_str());
+		if (!file.open(full_path)) return false;
+
+		if (offset + size > file.size() || !file.seek(offset)) {
+			logError("Could not read ", path, ", range is out of the file");
+			file.close();
+			return false;
+		}
+		content.resize(size);
+		if (!file.read(content.getMutableData(), size)) {
+			logError("Could not read ", path);
+			file.close();
+			return false;
+		}
+		file.close();
+		return true;
+	}
+
+
+	AsyncHandle getContents(Span<const Path> files, const BatchCallback& callback, Priority priority) override
+	{
+		if (files.length() == 0) return AsyncHandle::invalid();
+
+		BatchRequest* batch = LUMIX_NEW(m_allocator, BatchRequest)(m_allocator);
+		batch->callback = callback;
+		batch->paths.reserve(files.length());
+		for (const Path& path : files) batch->paths.push(path);
+		batch->contents.resize(files.length());
+
+		MutexGuard lock(m_mutex);
+		++m_work_counter;
+		AsyncItem& item = m_queue.emplace(m_allocator);
+		++m_last_id;
+		if (m_last_id == 0) ++m_last_id;
+		item.id = m_last_id;
+		item.times.queued = os::Timer::getRawTimestamp();
+		item.batch = batch;
+		item.priority = priority;
 		m_semaphore.signal();
 		return AsyncHandle(item.id);
 	}
 
+	// files in a batch are read in this order, equal keys must mean the same file
+	virtual u64 getReadOrderKey(const Path& path) { return path.getHash().getHashValue(); }
+
+	virtual Content readBatchItem(const Path& path, OutputMemoryStream& buffer) {
+		const bool success = getContentSync(path, buffer);
+		return { (const u8*)buffer.data(), buffer.size(), success };
+	}
+
+	void readBatch(BatchRequest& batch) {
+		struct SortItem {
+			u64 key;
+			u32 idx;
+		};
+		Array<SortItem> order(m_allocator);
+		order.resize(batch.paths.size());
+		for (u32 i = 0, c = batch.paths.size(); i < c; ++i) {
+			order[i] = { getReadOrderKey(batch.paths[i]), i };
+		}
+		qsort(order.begin(), order.size(), sizeof(order[0]), [](const void* a, const void* b) -> i32 {
+			const SortItem& ia = *(const SortItem*)a;
+			const SortItem& ib = *(const SortItem*)b;
+			if (ia.key != ib.key) return ia.key < ib.key ? -1 : 1;
+			return ia.idx < ib.idx ? -1 : (ia.idx > ib.idx ? 1 : 0);
+		});
+
+		// so contents do not point to moved buffers
+		batch.buffers.reserve(batch.paths.size());
+		for (u32 i = 0, c = order.size(); i < c; ++i) {
+			const u32 idx = order[i].idx;
+			if (i > 0 && order[i - 1].key == order[i].key) {
+				batch.contents[idx] = batch.contents[order[i - 1].idx];
+				continue;
+			}
+			OutputMemoryStream& buffer = batch.buffers.emplace(m_allocator);
+			batch.contents[idx] = readBatchItem(batch.paths[idx], buffer);
+		}
+	}
 
 	void cancel(AsyncHandle async) override
 	{
@@ -154,6 +317,8 @@ struct FileSystemImpl : FileSystem {
 		ASSERT(false);
 	}
 
+	IOTimes getCallbackIOTimes() const override { return m_callback_times; }
+
 
 	bool open(const char* path, os::InputFile& file) override
 	{
@@ -232,7 +397,18 @@ struct FileSystemImpl : FileSystem {
 			m_mutex.exit();
 
 			if(!item.isCanceled()) {
-				item.callback.invoke(item.data.size(), (const u8*)item.data.data(), !item.isFailed());
+				m_callback_times = item.times;
+				if (item.batch) {
+					const Span<const Content> contents(item.batch->contents.begin(), item.batch->contents.end());
+					item.batch->callback.invoke(contents);
+				}
+				else if (item.mapped) {
+					item.callback.invoke(item.mapped_size, item.mapped, !item.isFailed());
+				}
+				else {
+					item.callback.invoke(item.data.size(), (const u8*)item.data.data(), !item.isFailed());
+				}
+				m_callback_times = {};
 			}
 
 			if (timer.getTimeSinceStart() > 0.1f) {
@@ -241,14 +417,53 @@ struct FileSystemImpl : FileSystem {
 		}
 	}
 
+	// content is already in memory, callback is called in next processCallbacks without touching io workers
+	AsyncHandle pushFinished(const Path& file, const ContentCallback& callback, const u8* mem, u64 size, bool success) {
+		MutexGuard lock(m_mutex);
+		++m_work_counter;
+		AsyncItem& item = m_finished.emplace(m_allocator);
+		++m_last_id;
+		if (m_last_id == 0) ++m_last_id;
+		item.id = m_last_id;
+		item.times.queued = os::Timer::getRawTimestamp();
+		item.path = file.c_str();
+		item.callback = callback;
+		item.mapped = mem;
+		item.mapped_size = size;
+		if (!success) item.flags.set(AsyncItem::Flags::FAILED);
+		return AsyncHandle(item.id);
+	}
+
+	// first not yet started item with the highest priority
+	i32 pickItem() const {
+		i32 best = -1;
+		for (i32 i = 0, c = m_queue.size(); i < c; ++i) {
+			const AsyncItem& item = m_queue[i];
+			if (item.isInProgress()) continue;
+			if (best < 0 || item.priority < m_queue[best].priority) best = i;
+			if (item.priority == Priority::HIGH) break;
+		}
+		return best;
+	}
+
+	i32 findQueued(u32 id) const {
+		for (i32 i = 0, c = m_queue.size(); i < c; ++i) {
+			if (m_queue[i].id == id) return i;
+		}
+		return -1;
+	}
+
 	IAllocator& m_allocator;
-	Local<FSTask> m_task;
+	Array<FSTask*> m_tasks;
 	StaticString<LUMIX_MAX_PATH> m_base_path;
 	Array<AsyncItem> m_queue;
 	u32 m_work_counter = 0;
 	Array<AsyncItem> m_finished;
 	Mutex m_mutex;
 	Semaphore m_semaphore;
+	volatile bool m_finish = false;
+	// only accessed on the thread calling processCallbacks
+	IOTimes m_callback_times;
 
 	u32 m_last_id;
 };
@@ -256,70 +471,150 @@ struct FileSystemImpl : FileSystem {
 
 int FSTask::task()
 {
-	while (!m_finish) {
+	for (;;) {
+		// each queued item signals once, so there's always an item not in progress after wait
 		m_fs.m_semaphore.wait();
-		if (m_finish) break;
+		if (m_fs.m_finish) break;
 
 		StaticString<LUMIX_MAX_PATH> path;
+		BatchRequest* batch;
+		u64 range_offset;
+		u64 range_size;
+		u32 id;
 		{
 			MutexGuard lock(m_fs.m_mutex);
-			ASSERT(!m_fs.m_queue.empty());
-			path = m_fs.m_queue[0].path;
-			if (m_fs.m_queue[0].isCanceled()) {
-				m_fs.m_queue.erase(0);
+			const i32 idx = m_fs.pickItem();
+			ASSERT(idx >= 0);
+			AsyncItem& item = m_fs.m_queue[idx];
+			if (item.isCanceled()) {
+				m_fs.m_queue.erase(idx);
 				continue;
 			}
+			item.flags.set(AsyncItem::Flags::IN_PROGRESS);
+			item.times.io_start = os::Timer::getRawTimestamp();
+			path = item.path;
+			batch = item.batch;
+			range_offset = item.range_offset;
+			range_size = item.range_size;
+			id = item.id;
 		}
 
+		// batch stays alive until the item is removed from queue, which only we can do now
 		OutputMemoryStream data(m_fs.m_allocator);
-		bool success = m_fs.getContentSync(Path(path), data);
+		bool success = true;
+		if (batch) m_fs.readBatch(*batch);
+		else if (range_size > 0) success = m_fs.getContentRangeSync(Path(path), range_offset, range_size, data);
+		else success = m_fs.getContentSync(Path(path), data);
 
 		{
 			MutexGuard lock(m_fs.m_mutex);
-			if (!m_fs.m_queue[0].isCanceled()) {
-				m_fs.m_finished.emplace(static_cast<AsyncItem&&>(m_fs.m_queue[0]));
+			const i32 idx = m_fs.findQueued(id);
+			ASSERT(idx >= 0);
+			AsyncItem& item = m_fs.m_queue[idx];
+			if (!item.isCanceled()) {
+				item.times.io_end = os::Timer::getRawTimestamp();
+				m_fs.m_finished.emplace(static_cast<AsyncItem&&>(item));
 				m_fs.m_finished.back().data = static_cast<OutputMemoryStream&&>(data);
 				if(!success) {
 					m_fs.m_finished.back().flags.set(AsyncItem::Flags::FAILED);
 				}
 			}
-			m_fs.m_queue.erase(0);
+			m_fs.m_queue.erase(idx);
 		}
 	}
 	return 0;
 }
 
 
-void FSTask::stop()
-{
-	m_finish = true;
-	m_fs.m_semaphore.signal();
-}
-
 struct PackFileSystem : FileSystemImpl {
-	PackFileSystem(const char* pak_path, IAllocator& allocator) 
-		: FileSystemImpl("pack://", allocator) 
-		, m_map(allocator)
+	PackFileSystem(const char* pak_path, u32 io_workers, IAllocator& allocator) 
+		: FileSystemImpl("pack://", io_workers, allocator) 
+		, m_entries_storage(allocator)
 	{
+		m_mapped = (const u8*)os::mapFile(pak_path, m_mapped_size);
+		if (m_mapped) {
+			InputMemoryStream blob(m_mapped, m_mapped_size);
+			if (!readHeader(blob)) {
+				logError("Invalid pak file ", pak_path);
+				os::unmapFile(m_mapped, m_mapped_size);
+				m_mapped = nullptr;
+			}
+			return;
+		}
+
+		logWarning("Failed to map ", pak_path, ", falling back to reading it");
 		if (!m_file.open(pak_path)) {
-			logError("Failed to open game.pak");
+			logError("Failed to open ", pak_path);
 			return;
 		}
-		const u32 count = m_file.read<u32>();
-		for (u32 i = 0; i < count; ++i) {
-			const FilePathHash hash = m_file.read<FilePathHash>();
-			PackFile& f = m_map.insert(hash);
-			f.offset = m_file.read<u64>();
-			f.size = m_file.read<u64>();
+		if (!readHeader(m_file)) {
+			logError("Invalid pak file ", pak_path);
+			m_entries = {};
 		}
 	}
 
 	~PackFileSystem() {
-		m_file.close();
+		if (m_mapped) os::unmapFile(m_mapped, m_mapped_size);
+		else m_file.close();
 	}
 
-	bool getContentSync(const Path& path, OutputMemoryStream& content) override {
-		ASSERT(content.size() == 0);
+	bool readHeader(IInputStream& blob) {
+		u32 magic;
+		if (!blob.read(&magic, sizeof(magic))) return false;
+		if (magic != PackFileHeader::MAGIC) return readHeaderV1(blob, magic);
+
+		PackFileHeader header;
+		header.magic = magic;
+		if (!blob.read(&header.version, sizeof(header) - sizeof(header.magic))) return false;
+		if (header.version != PackFileHeader::VERSION) return false;
+
+		// mapped index is used in place
+		if (m_mapped) {
+			if (sizeof(header) + header.count * sizeof(PackFileEntry) > m_mapped_size) return false;
+			const PackFileEntry* entries = (const PackFileEntry*)(m_mapped + sizeof(header));
+			m_entries = Span(entries, header.count);
+			return true;
+		}
+
+		m_entries_storage.resize(header.count);
+		if (!blob.read(m_entries_storage.begin(), m_entries_storage.byte_size())) return false;
+		m_entries = Span<const PackFileEntry>(m_entries_storage.begin(), m_entries_storage.end());
+		return true;
+	}
+
+	bool readHeaderV1(IInputStream& blob, u32 count) {
+		const u64 header_size = sizeof(u32) + count * (2 * sizeof(u64) + sizeof(FilePathHash));
+		m_entries_storage.resize(count);
+		for (PackFileEntry& e : m_entries_storage) {
+			if (!blob.read(&e.hash, sizeof(e.hash))) return false;
+			if (!blob.read(&e.offset, sizeof(e.offset))) return false;
+			if (!blob.read(&e.size, sizeof(e.size))) return false;
+			e.offset += header_size;
+			e.stored_size = e.size;
+		}
+		qsort(m_entries_storage.begin(), m_entries_storage.size(), sizeof(PackFileEntry), [](const void* a, const void* b) -> i32 {
+			const FilePathHash ha = ((const PackFileEntry*)a)->hash;
+			const FilePathHash hb = ((const PackFileEntry*)b)->hash;
+			if (ha < hb) return -1;
+			return hb < ha ? 1 : 0;
+		});
+		m_entries = Span<const PackFileEntry>(m_entries_storage.begin(), m_entries_storage.end());
+		return true;
+	}
+
+	const PackFileEntry* findEntry(FilePathHash hash) const {
+		u32 lo = 0;
+		u32 hi = m_entries.length();
+		while (lo < hi) {
+			const u32 mid = (lo + hi) / 2;
+			if (m_entries.begin()[mid].hash < hash) lo = mid + 1;
+			else hi = mid;
+		}
+		if (lo < m_entries.length() && m_entries.begin()[lo].hash == hash) return &m_entries.begin()[lo];
+		return nullptr;
+	}
+
+	const PackFileEntry* findEntry(const Path& path) const {
 		Span<const char> basename = Path::getBasename(path.c_str());
 		u64 hashu64;
 		fromCString(basename, hashu64);
@@ -327,41 +622,139 @@ struct PackFileSystem : FileSystemImpl {
 		if (basename[0] < '0' || basename[0] > '9' || hashu64 == 0) {
 			hash = path.getHash();
 		}
-		auto iter = m_map.find(hash);
-		if (!iter.isValid()) {
-			iter = m_map.find(path.getHash());
-			if (!iter.isValid()) return false;
+		const PackFileEntry* entry = findEntry(hash);
+		if (!entry) entry = findEntry(path.getHash());
+		return entry;
+	}
+
+	bool decompress(const PackFileEntry& entry, const u8* src, OutputMemoryStream& content) {
+		content.resize(entry.size);
+		const i32 res = LZ4_decompress_safe((const char*)src, (char*)content.getMutableData(), (i32)entry.stored_size, (i32)entry.size);
+		return res == (i32)entry.size;
+	}
+
+	// uncompressed content points to the mapping, valid until the file system is destroyed
+	AsyncHandle getContent(const Path& path, const ContentCallback& callback, Priority priority) override {
+		if (!m_mapped) return FileSystemImpl::getContent(path, callback, priority);
+		if (path.isEmpty()) return AsyncHandle::invalid();
+
+		const PackFileEntry* entry = findEntry(path);
+		if (!entry || entry->offset + entry->stored_size > m_mapped_size) {
+			return pushFinished(path, callback, nullptr, 0, false);
 		}
+		// decompressed on io workers
+		if (entry->flags & PackFileEntry::COMPRESSED) return FileSystemImpl::getContent(path, callback, priority);
+		return pushFinished(path, callback, m_mapped + entry->offset, entry->size, true);
+	}
 
-		content.resize(iter.value().size);
-		MutexGuard lock(m_mutex);
-		const u32 header_size = sizeof(u32) + m_map.size() * (2 * sizeof(u64) + sizeof(u32));
-		if (!m_file.seek(iter.value().offset + header_size) || !m_file.read(content.getMutableData(), content.size())) {
+	AsyncHandle getContentRange(const Path& path, u64 offset, u64 size, const ContentCallback& callback, Priority priority) override {
+		if (!m_mapped) return FileSystemImpl::getContentRange(path, offset, size, callback, priority);
+		if (path.isEmpty() || size == 0) return AsyncHandle::invalid();
+
+		const PackFileEntry* entry = findEntry(path);
+		if (!entry || entry->offset + entry->stored_size > m_mapped_size || offset + size > entry->size) {
+			return pushFinished(path, callback, nullptr, 0, false);
+		}
+		if (entry->flags & PackFileEntry::COMPRESSED) return FileSystemImpl::getContentRange(path, offset, size, callback, priority);
+		return pushFinished(path, callback, m_mapped + entry->offset + offset, size, true);
+	}
+
+	bool getContentRangeSync(const Path& path, u64 offset, u64 size, OutputMemoryStream& content) override {
+		const PackFileEntry* entry = findEntry(path);
+		if (!entry || offset + size > entry->size) return false;
+
+		if (m_mapped || (entry->flags & PackFileEntry::COMPRESSED)) {
+			OutputMemoryStream whole(m_allocator);
+			if (!getContentSync(path, whole)) return false;
+			content.write((const u8*)whole.data() + offset, size);
+			return true;
+		}
+
+		content.resize(size);
+		MutexGuard lock(m_file_mutex);
+		if (!m_file.seek(entry->offset + offset) || !m_file.read(content.getMutableData(), size)) {
 			logError("Could not read ", path);
 			return false;
 		}
+		return true;
+	}
 
+	u64 getReadOrderKey(const Path& path) override {
+		const PackFileEntry* entry = findEntry(path);
+		// missing files at the end, they still need unique keys
+		return entry ? entry->offset : (u64(1) << 63) | path.getHash().getHashValue();
+	}
+
+	Content readBatchItem(const Path& path, OutputMemoryStream& buffer) override {
+		if (m_mapped) {
+			const PackFileEntry* entry = findEntry(path);
+			if (entry && !(entry->flags & PackFileEntry::COMPRESSED) && entry->offset + entry->size <= m_mapped_size) {
+				return { m_mapped + entry->offset, entry->size, true };
+			}
+		}
+		return FileSystemImpl::readBatchItem(path, buffer);
+	}
+
+	bool getContentSync(const Path& path, OutputMemoryStream& content) override {
+		ASSERT(content.size() == 0);
+		const PackFileEntry* entry = findEntry(path);
+		if (!entry) return false;
+
+		const bool compressed = entry->flags & PackFileEntry::COMPRESSED;
+		if (m_mapped) {
+			if (entry->offset + entry->stored_size > m_mapped_size) {
+				logError("Could not read ", path);
+				return false;
+			}
+			const u8* src = m_mapped + entry->offset;
+			if (compressed) {
+				if (!decompress(*entry, src, content)) {
+					logError("Could not decompress ", path);
+					return false;
+				}
+				return true;
+			}
+			content.write(src, entry->size);
+			return true;
+		}
+
+		OutputMemoryStream compressed_data(m_allocator);
+		OutputMemoryStream& dst = compressed ? compressed_data : content;
+		dst.resize(entry->stored_size);
+		{
+			MutexGuard lock(m_file_mutex);
+			if (!m_file.seek(entry->offset) || !m_file.read(dst.getMutableData(), dst.size())) {
+				logError("Could not read ", path);
+				return false;
+			}
+		}
+
+		if (compressed && !decompress(*entry, (const u8*)compressed_data.data(), content)) {
+			logError("Could not decompress ", path);
+			return false;
+		}
 		return true;
 	}
-	
-	struct PackFile {
-		u64 offset;
-		u64 size;
-	};
 
-	HashMap<FilePathHash, PackFile> m_map;
+	// points to the mapping or m_entries_storage
+	Span<const PackFileEntry> m_entries;
+	Array<PackFileEntry> m_entries_storage;
+	const u8* m_mapped = nullptr;
+	u64 m_mapped_size = 0;
 	os::InputFile m_file;
+	// not m_mutex, so io workers reading the pak do not block getContent
+	Mutex m_file_mutex;
 };
 
 
-UniquePtr<FileSystem> FileSystem::create(const char* base_path, IAllocator& allocator)
+UniquePtr<FileSystem> FileSystem::create(const char* base_path, IAllocator& allocator, u32 io_workers)
 {
-	return UniquePtr<FileSystemImpl>::create(allocator, base_path, allocator);
+	return UniquePtr<FileSystemImpl>::create(allocator, base_path, io_workers, allocator);
 }
 
-UniquePtr<FileSystem> FileSystem::createPacked(const char* pak_path, IAllocator& allocator)
+UniquePtr<FileSystem> FileSystem::createPacked(const char* pak_path, IAllocator& allocator, u32 io_workers)
 {
-	return UniquePtr<PackFileSystem>::create(allocator, pak_path, allocator);
+	return UniquePtr<PackFileSystem>::create(allocator, pak_path, io_workers, allocator);
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/hash.h"
 #include "engine/lumix.h"
 
 namespace Lumix {
@@ -13,9 +14,56 @@ namespace os {
 	struct OutputFile;
 }
 
+#pragma pack(1)
+// pak file v2: header, entries sorted by hash, unused entries up to table_capacity, data
+// data can contain unused gaps, left by incrementally rebuilt paks so existing entries keep their offsets
+// v1 (no header, count followed by hash, offset, size triples) can still be read
+struct PackFileHeader {
+	static constexpr u32 MAGIC = 'LPAK';
+	static constexpr u32 VERSION = 2;
+	u32 magic = MAGIC;
+	u32 version = VERSION;
+	u32 count = 0;
+	u32 table_capacity = 0; // 0 - same as count
+};
+
+struct PackFileEntry {
+	enum Flags : u32 {
+		COMPRESSED = 1 << 0 // LZ4
+	};
+	FilePathHash hash;
+	u64 offset = 0; // from the beginning of the pak
+	u64 size = 0; // uncompressed
+	u64 stored_size = 0;
+	u32 flags = 0;
+	StableHash32 content_hash; // of uncompressed content, used when the pak is rebuilt incrementally
+};
+#pragma pack()
+
 struct LUMIX_ENGINE_API FileSystem {
 	using ContentCallback = Delegate<void(u64, const u8*, bool)>;
 
+	struct Content {
+		const u8* data;
+		u64 size;
+		bool success;
+	};
+	using BatchCallback = Delegate<void(Span<const Content>)>;
+
+	// requests with higher priority are read first, FIFO within the same priority
+	enum class Priority : u8 {
+		HIGH,
+		NORMAL,
+		LOW
+	};
+
+	// os::Timer::getRawTimestamp() of an async request, io_* are 0 if the content was not read by io workers
+	struct IOTimes {
+		u64 queued = 0;
+		u64 io_start = 0;
+		u64 io_end = 0;
+	};
+
 	struct LUMIX_ENGINE_API AsyncHandle {
 		static AsyncHandle invalid() { return AsyncHandle(0xffFFffFF); };
 		explicit AsyncHandle(u32 value) : value(value) {}
@@ -23,8 +71,9 @@ struct LUMIX_ENGINE_API FileSystem {
 		bool isValid() const { return value != 0xffFFffFF; }
 	};
 
-	static UniquePtr<FileSystem> create(const char* base_path, struct IAllocator& allocator);
-	static UniquePtr<FileSystem> createPacked(const char* pak_path, struct IAllocator& allocator);
+	// io_workers - number of threads reading files for getContent
+	static UniquePtr<FileSystem> create(const char* base_path, struct IAllocator& allocator, u32 io_workers = 2);
+	static UniquePtr<FileSystem> createPacked(const char* pak_path, struct IAllocator& allocator, u32 io_workers = 2);
 
 	virtual ~FileSystem() {}
 
@@ -44,8 +93,15 @@ struct LUMIX_ENGINE_API FileSystem {
 
 	[[nodiscard]] virtual bool saveContentSync(const struct Path& file, Span<const u8> content) =  0;
 	[[nodiscard]] virtual bool getContentSync(const struct Path& file, struct OutputMemoryStream& content) =  0;
-	virtual AsyncHandle getContent(const Path& file, const ContentCallback& callback) = 0;
+	virtual AsyncHandle getContent(const Path& file, const ContentCallback& callback, Priority priority = Priority::NORMAL) = 0;
+	// `size` bytes starting at `offset`, fails if the file is shorter; compressed pak entries are decompressed whole
+	virtual AsyncHandle getContentRange(const Path& file, u64 offset, u64 size, const ContentCallback& callback, Priority priority = Priority::NORMAL) = 0;
+	// one request for many files, files are read in storage friendly order and duplicates are read once
+	// contents are in the same order as files and valid only during the callback
+	virtual AsyncHandle getContents(Span<const Path> files, const BatchCallback& callback, Priority priority = Priority::NORMAL) = 0;
 	virtual void cancel(AsyncHandle handle) = 0;
+	// times of the request whose callback is being called, valid only inside ContentCallback / BatchCallback
+	virtual IOTimes getCallbackIOTimes() const = 0;
 };
 
 } // namespace Lumix
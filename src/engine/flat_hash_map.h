@@ -0,0 +1,433 @@
+#pragma once
+
+
+#include "engine/allocator.h"
+#include "engine/hash_map.h"
+#include "engine/lumix.h"
+#include <string.h>
+
+#if defined __SSE2__ || defined _M_X64
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+	#define LUMIX_FLAT_HASH_MAP_SSE2
+#elif defined __ARM_NEON || defined _M_ARM64
+	#include <arm_neon.h>
+	#define LUMIX_FLAT_HASH_MAP_NEON
+#endif
+
+
+namespace Lumix
+{
+
+// open addressing hash map with control bytes probed 16 at a time (swiss table)
+// same API as HashMap, keys and values are stored in flat arrays
+template<typename Key, typename Value, typename Hasher = HashFunc<Key>>
+struct FlatHashMap
+{
+private:
+	static constexpr u32 GROUP_SIZE = 16;
+	static constexpr u32 MIN_CAPACITY = GROUP_SIZE;
+	static constexpr i8 EMPTY = -128; // 0x80
+	static constexpr i8 DELETED = -2; // 0xFE
+	// full slots contain lower 7 bits of hash
+
+	struct BitMask {
+		#ifdef LUMIX_FLAT_HASH_MAP_NEON
+			static constexpr u32 SHIFT = 2; // 4 bits per slot
+		#else
+			static constexpr u32 SHIFT = 0;
+		#endif
+
+		explicit operator bool() const { return mask != 0; }
+		u32 lowest() const {
+			#if defined _MSC_VER && !defined __clang__
+				unsigned long res;
+				_BitScanForward64(&res, mask);
+				return res >> SHIFT;
+			#else
+				return __builtin_ctzll(mask) >> SHIFT;
+			#endif
+		}
+		u32 highest() const {
+			#if defined _MSC_VER && !defined __clang__
+				unsigned long res;
+				_BitScanReverse64(&res, mask);
+				return res >> SHIFT;
+			#else
+				return (63 - __builtin_clzll(mask)) >> SHIFT;
+			#endif
+		}
+		void clearLowest() { mask &= mask - 1; }
+
+		u64 mask;
+	};
+
+	struct Group {
+		explicit Group(const i8* ctrl) {
+			#if defined LUMIX_FLAT_HASH_MAP_SSE2
+				value = _mm_loadu_si128((const __m128i*)ctrl);
+			#elif defined LUMIX_FLAT_HASH_MAP_NEON
+				value = vld1q_s8(ctrl);
+			#else
+				memcpy(value, ctrl, GROUP_SIZE);
+			#endif
+		}
+
+		BitMask match(i8 h2) const {
+			#if defined LUMIX_FLAT_HASH_MAP_SSE2
+				return { (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(value, _mm_set1_epi8(h2))) };
+			#elif defined LUMIX_FLAT_HASH_MAP_NEON
+				return toMask(vceqq_s8(value, vdupq_n_s8(h2)));
+			#else
+				u64 res = 0;
+				for (u32 i = 0; i < GROUP_SIZE; ++i) res |= u64(value[i] == h2) << i;
+				return { res };
+			#endif
+		}
+
+		BitMask matchEmpty() const { return match(EMPTY); }
+
+		BitMask matchEmptyOrDeleted() const {
+			#if defined LUMIX_FLAT_HASH_MAP_SSE2
+				return { (u64)(u32)_mm_movemask_epi8(value) };
+			#elif defined LUMIX_FLAT_HASH_MAP_NEON
+				return toMask(vcltq_s8(value, vdupq_n_s8(0)));
+			#else
+				u64 res = 0;
+				for (u32 i = 0; i < GROUP_SIZE; ++i) res |= u64(value[i] < 0) << i;
+				return { res };
+			#endif
+		}
+
+		#if defined LUMIX_FLAT_HASH_MAP_SSE2
+			__m128i value;
+		#elif defined LUMIX_FLAT_HASH_MAP_NEON
+			static BitMask toMask(uint8x16_t cmp) {
+				const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+				return { vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ULL };
+			}
+			int8x16_t value;
+		#else
+			i8 value[GROUP_SIZE];
+		#endif
+	};
+
+	template <typename HM, typename K, typename V>
+	struct IteratorBase {
+		HM* hm;
+		u32 idx;
+
+		template <typename HM2, typename K2, typename V2>
+		bool operator !=(const IteratorBase<HM2, K2, V2>& rhs) const {
+			ASSERT(hm == rhs.hm);
+			return idx != rhs.idx;
+		}
+
+		template <typename HM2, typename K2, typename V2>
+		bool operator ==(const IteratorBase<HM2, K2, V2>& rhs) const {
+			ASSERT(hm == rhs.hm);
+			return idx == rhs.idx;
+		}
+
+		void operator++() { idx = hm->nextFull(idx + 1); }
+
+		K& key() {
+			ASSERT(hm->m_ctrl[idx] >= 0);
+			return hm->m_keys[idx];
+		}
+
+		const V& value() const {
+			ASSERT(hm->m_ctrl[idx] >= 0);
+			return hm->m_values[idx];
+		}
+
+		V& value() {
+			ASSERT(hm->m_ctrl[idx] >= 0);
+			return hm->m_values[idx];
+		}
+
+		V& operator*() {
+			ASSERT(hm->m_ctrl[idx] >= 0);
+			return hm->m_values[idx];
+		}
+
+		bool isValid() const { return idx != hm->m_capacity; }
+	};
+
+public:
+	using Iterator = IteratorBase<FlatHashMap, Key, Value>;
+	using ConstIterator = IteratorBase<const FlatHashMap, const Key, const Value>;
+
+	explicit FlatHashMap(IAllocator& allocator)
+		: m_allocator(allocator)
+	{
+	}
+
+	FlatHashMap(u32 size, IAllocator& allocator)
+		: m_allocator(allocator)
+	{
+		reserve(size);
+	}
+
+	FlatHashMap(FlatHashMap&& rhs)
+		: m_allocator(rhs.m_allocator)
+	{
+		m_ctrl = rhs.m_ctrl;
+		m_keys = rhs.m_keys;
+		m_values = rhs.m_values;
+		m_capacity = rhs.m_capacity;
+		m_size = rhs.m_size;
+		m_deleted = rhs.m_deleted;
+
+		rhs.m_ctrl = nullptr;
+		rhs.m_keys = nullptr;
+		rhs.m_values = nullptr;
+		rhs.m_capacity = 0;
+		rhs.m_size = 0;
+		rhs.m_deleted = 0;
+	}
+
+	~FlatHashMap() {
+		destroyAll();
+		deallocate();
+	}
+
+	FlatHashMap&& move() {
+		return static_cast<FlatHashMap&&>(*this);
+	}
+
+	void operator =(FlatHashMap&& rhs) = delete;
+
+	Iterator begin() { return { this, nextFull(0) }; }
+	ConstIterator begin() const { return { this, nextFull(0) }; }
+	Iterator end() { return Iterator { this, m_capacity }; }
+	ConstIterator end() const { return ConstIterator { this, m_capacity }; }
+
+	// keeps allocated memory
+	void clear() {
+		destroyAll();
+		if (m_ctrl) memset(m_ctrl, EMPTY, m_capacity + GROUP_SIZE - 1);
+		m_size = 0;
+		m_deleted = 0;
+	}
+
+	ConstIterator find(const Key& key) const {
+		return { this, findPos(key) };
+	}
+
+	Iterator find(const Key& key) {
+		return { this, findPos(key) };
+	}
+
+	Value& operator[](const Key& key) {
+		const u32 pos = findPos(key);
+		ASSERT(pos < m_capacity);
+		return m_values[pos];
+	}
+
+	const Value& operator[](const Key& key) const {
+		const u32 pos = findPos(key);
+		ASSERT(pos < m_capacity);
+		return m_values[pos];
+	}
+
+	Value& insert(const Key& key) {
+		auto iter = insert(key, {});
+		return iter.value();
+	}
+
+	// key must not be in the map
+	Iterator insert(const Key& key, Value&& value) {
+		const u32 pos = prepareInsert(key);
+		new (NewPlaceholder(), &m_keys[pos]) Key(key);
+		new (NewPlaceholder(), &m_values[pos]) Value(static_cast<Value&&>(value));
+		return { this, pos };
+	}
+
+	Iterator insert(const Key& key, const Value& value) {
+		const u32 pos = prepareInsert(key);
+		new (NewPlaceholder(), &m_keys[pos]) Key(key);
+		new (NewPlaceholder(), &m_values[pos]) Value(value);
+		return { this, pos };
+	}
+
+	// bulk insert, grows at most once, keys must not be in the map
+	void insert(const Key* keys, const Value* values, u32 count) {
+		reserve(m_size + count);
+		for (u32 i = 0; i < count; ++i) {
+			insert(keys[i], values[i]);
+		}
+	}
+
+	template <typename F>
+	void eraseIf(F predicate) {
+		for (u32 i = 0; i < m_capacity; ++i) {
+			if (m_ctrl[i] < 0) continue;
+			if (predicate(m_values[i])) eraseAt(i);
+		}
+	}
+
+	void erase(const Iterator& key) {
+		ASSERT(key.isValid());
+		eraseAt(key.idx);
+	}
+
+	void erase(const Key& key) {
+		const u32 pos = findPos(key);
+		if (pos < m_capacity) eraseAt(pos);
+	}
+
+	bool empty() const { return m_size == 0; }
+	u32 size() const { return m_size; }
+
+	void reserve(u32 count) {
+		u32 capacity = MIN_CAPACITY;
+		while (maxLoad(capacity) < count) capacity <<= 1;
+		if (capacity > m_capacity) rehash(capacity);
+	}
+
+private:
+	static u32 maxLoad(u32 capacity) { return capacity - capacity / 8; }
+	static i8 h2(u32 hash) { return i8(hash & 0x7f); }
+	static u32 h1(u32 hash) { return hash >> 7; }
+
+	void setCtrl(u32 pos, i8 value) {
+		m_ctrl[pos] = value;
+		// first GROUP_SIZE - 1 control bytes are mirrored after the end, so groups can be loaded at any position
+		if (pos < GROUP_SIZE - 1) m_ctrl[m_capacity + pos] = value;
+	}
+
+	u32 nextFull(u32 pos) const {
+		for (u32 c = m_capacity; pos < c; ++pos) {
+			if (m_ctrl[pos] >= 0) return pos;
+		}
+		return m_capacity;
+	}
+
+	u32 findPos(const Key& key) const {
+		if (m_size == 0) return m_capacity;
+
+		const u32 hash = Hasher::get(key);
+		const i8 tag = h2(hash);
+		const u32 mask = m_capacity - 1;
+		u32 pos = h1(hash) & mask;
+		u32 step = 0;
+		for (;;) {
+			const Group group(m_ctrl + pos);
+			for (BitMask m = group.match(tag); m; m.clearLowest()) {
+				const u32 idx = (pos + m.lowest()) & mask;
+				if (m_keys[idx] == key) return idx;
+			}
+			if (group.matchEmpty()) return m_capacity;
+			step += GROUP_SIZE;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	u32 findFreeSlot(u32 hash) const {
+		const u32 mask = m_capacity - 1;
+		u32 pos = h1(hash) & mask;
+		u32 step = 0;
+		for (;;) {
+			const Group group(m_ctrl + pos);
+			const BitMask m = group.matchEmptyOrDeleted();
+			if (m) return (pos + m.lowest()) & mask;
+			step += GROUP_SIZE;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	u32 prepareInsert(const Key& key) {
+		if (m_size + m_deleted >= maxLoad(m_capacity)) {
+			// reuse tombstones if there are many of them, grow otherwise
+			const u32 capacity = m_capacity == 0 ? MIN_CAPACITY : m_deleted > m_capacity / 4 ? m_capacity : m_capacity << 1;
+			rehash(capacity);
+		}
+		const u32 hash = Hasher::get(key);
+		const u32 pos = findFreeSlot(hash);
+		if (m_ctrl[pos] == DELETED) --m_deleted;
+		setCtrl(pos, h2(hash));
+		++m_size;
+		return pos;
+	}
+
+	void eraseAt(u32 pos) {
+		ASSERT(m_ctrl[pos] >= 0);
+		m_keys[pos].~Key();
+		m_values[pos].~Value();
+		--m_size;
+
+		// slot can be empty only if no probe sequence skipped over it, i.e. it was never part of a full group
+		const u32 mask = m_capacity - 1;
+		const BitMask empty_after = Group(m_ctrl + pos).matchEmpty();
+		const BitMask empty_before = Group(m_ctrl + ((pos - GROUP_SIZE) & mask)).matchEmpty();
+		const u32 full_after = empty_after ? empty_after.lowest() : GROUP_SIZE;
+		const u32 full_before = empty_before ? GROUP_SIZE - 1 - empty_before.highest() : GROUP_SIZE;
+		if (m_capacity == GROUP_SIZE || full_after + full_before < GROUP_SIZE) {
+			setCtrl(pos, EMPTY);
+		}
+		else {
+			setCtrl(pos, DELETED);
+			++m_deleted;
+		}
+	}
+
+	void rehash(u32 new_capacity) {
+		ASSERT(new_capacity >= MIN_CAPACITY && (new_capacity & (new_capacity - 1)) == 0);
+		i8* old_ctrl = m_ctrl;
+		Key* old_keys = m_keys;
+		Value* old_values = m_values;
+		const u32 old_capacity = m_capacity;
+
+		m_capacity = new_capacity;
+		m_ctrl = (i8*)m_allocator.allocate(new_capacity + GROUP_SIZE - 1);
+		m_keys = (Key*)m_allocator.allocate_aligned(sizeof(Key) * new_capacity, alignof(Key));
+		m_values = (Value*)m_allocator.allocate_aligned(sizeof(Value) * new_capacity, alignof(Value));
+		memset(m_ctrl, EMPTY, new_capacity + GROUP_SIZE - 1);
+		m_deleted = 0;
+
+		for (u32 i = 0; i < old_capacity; ++i) {
+			if (old_ctrl[i] < 0) continue;
+			const u32 hash = Hasher::get(old_keys[i]);
+			const u32 pos = findFreeSlot(hash);
+			setCtrl(pos, h2(hash));
+			new (NewPlaceholder(), &m_keys[pos]) Key(static_cast<Key&&>(old_keys[i]));
+			new (NewPlaceholder(), &m_values[pos]) Value(static_cast<Value&&>(old_values[i]));
+			old_keys[i].~Key();
+			old_values[i].~Value();
+		}
+
+		m_allocator.deallocate(old_ctrl);
+		m_allocator.deallocate_aligned(old_keys);
+		m_allocator.deallocate_aligned(old_values);
+	}
+
+	void destroyAll() {
+		if (m_size == 0) return;
+		for (u32 i = 0; i < m_capacity; ++i) {
+			if (m_ctrl[i] < 0) continue;
+			m_keys[i].~Key();
+			m_values[i].~Value();
+		}
+	}
+
+	void deallocate() {
+		if (!m_ctrl) return;
+		m_allocator.deallocate(m_ctrl);
+		m_allocator.deallocate_aligned(m_keys);
+		m_allocator.deallocate_aligned(m_values);
+	}
+
+	IAllocator& m_allocator;
+	i8* m_ctrl = nullptr;
+	Key* m_keys = nullptr;
+	Value* m_values = nullptr;
+	u32 m_capacity = 0;
+	u32 m_size = 0;
+	u32 m_deleted = 0;
+};
+
+
+} // namespace Lumix
@@ -124,22 +124,11 @@ Frustum ShiftedFrustum::getRelative(const DVec3& origin) const
 	const Vec3 offset = Vec3(this->origin - origin);
 	memcpy(res.points, points, sizeof(points));
 
-	const Vec3 n_near = getNormal(Frustum::Planes::NEAR);
-	const Vec3 n_far = getNormal(Frustum::Planes::FAR);
-	const Vec3 n_left = getNormal(Frustum::Planes::LEFT);
-	const Vec3 n_right = getNormal(Frustum::Planes::RIGHT);
-	const Vec3 n_top = getNormal(Frustum::Planes::TOP);
-	const Vec3 n_bottom = getNormal(Frustum::Planes::BOTTOM);
-
-	res.setPlane(Frustum::Planes::EXTRA0, n_near, points[0] + offset);
-	res.setPlane(Frustum::Planes::EXTRA1, n_near, points[0] + offset);
-	res.setPlane(Frustum::Planes::NEAR, n_near, points[0] + offset);
-	res.setPlane(Frustum::Planes::FAR, n_far, points[4] + offset);
-
-	res.setPlane(Frustum::Planes::LEFT, n_left, points[1] + offset);
-	res.setPlane(Frustum::Planes::RIGHT, n_right, points[0] + offset);
-	res.setPlane(Frustum::Planes::TOP, n_top, points[0] + offset);
-	res.setPlane(Frustum::Planes::BOTTOM, n_bottom, points[2] + offset);
+	// all planes are shifted, so extra planes (e.g. shadow caster planes) are kept
+	for (u32 i = 0; i < (u32)Frustum::Planes::COUNT; ++i) {
+		const Vec3 n = getNormal((Frustum::Planes)i);
+		res.setPlane((Frustum::Planes)i, n, ds[i] - dot(n, offset));
+	}
 
 	for (Vec3& p : res.points) {
 		p += offset;
@@ -282,6 +271,189 @@ bool Frustum::isSphereInside(const Vec3& center, float radius) const
 }
 
 
+// last incomplete group of 4, missing lanes are zeros
+static LUMIX_FORCE_INLINE float4 loadTail(const float* src, u32 count) {
+	float tmp[4] = {};
+	memcpy(tmp, src, sizeof(float) * count);
+	return f4LoadUnaligned(tmp);
+}
+
+// bit per lane, set if sphere is completely behind any plane
+static LUMIX_FORCE_INLINE int spheresOutside(const Frustum& frustum, float4 x, float4 y, float4 z, float4 r) {
+	float4 dist = x * f4Splat(frustum.xs[0]) + y * f4Splat(frustum.ys[0]) + z * f4Splat(frustum.zs[0]) + f4Splat(frustum.ds[0]) + r;
+	for (u32 j = 1; j < (u32)Frustum::Planes::COUNT; ++j) {
+		dist = f4Min(dist, x * f4Splat(frustum.xs[j]) + y * f4Splat(frustum.ys[j]) + z * f4Splat(frustum.zs[j]) + f4Splat(frustum.ds[j]) + r);
+	}
+	return f4MoveMask(f4CmpLT(dist, f4Splat(0)));
+}
+
+static LUMIX_FORCE_INLINE u32 writeIndices(int outside, u32 from, u32 lanes, u32* out_indices) {
+	u32 written = 0;
+	for (u32 j = 0; j < lanes; ++j) {
+		if (outside & (1 << j)) continue;
+		out_indices[written] = from + j;
+		++written;
+	}
+	return written;
+}
+
+static LUMIX_FORCE_INLINE void writeMask(int outside, u32 from, u32 lanes, u32* out_mask) {
+	const u32 inside = ~u32(outside) & ((1 << lanes) - 1);
+	// groups of 4 never cross 32bit word boundary
+	out_mask[from >> 5] |= inside << (from & 31);
+}
+
+
+void Frustum::intersectSpheres(const float* x, const float* y, const float* z, const float* radius, u32 count, u32* out_mask) const
+{
+	memset(out_mask, 0, sizeof(u32) * ((count + 31) / 32));
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const int outside = spheresOutside(*this, f4LoadUnaligned(x + i), f4LoadUnaligned(y + i), f4LoadUnaligned(z + i), f4LoadUnaligned(radius + i));
+		writeMask(outside, i, 4, out_mask);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		const int outside = spheresOutside(*this, loadTail(x + i, lanes), loadTail(y + i, lanes), loadTail(z + i, lanes), loadTail(radius + i, lanes));
+		writeMask(outside, i, lanes, out_mask);
+	}
+}
+
+
+u32 Frustum::cullSpheres(const float* x, const float* y, const float* z, const float* radius, u32 count, u32* out_indices) const
+{
+	u32 written = 0;
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const int outside = spheresOutside(*this, f4LoadUnaligned(x + i), f4LoadUnaligned(y + i), f4LoadUnaligned(z + i), f4LoadUnaligned(radius + i));
+		if (outside == 0xf) continue;
+		written += writeIndices(outside, i, 4, out_indices + written);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		const int outside = spheresOutside(*this, loadTail(x + i, lanes), loadTail(y + i, lanes), loadTail(z + i, lanes), loadTail(radius + i, lanes));
+		written += writeIndices(outside, i, lanes, out_indices + written);
+	}
+	return written;
+}
+
+
+u32 Frustum::cullSpheres(const Sphere* spheres, u32 count, u32* out_indices) const
+{
+	static_assert(sizeof(Sphere) == sizeof(float4));
+	u32 written = 0;
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float4 x = f4LoadUnaligned(&spheres[i]);
+		float4 y = f4LoadUnaligned(&spheres[i + 1]);
+		float4 z = f4LoadUnaligned(&spheres[i + 2]);
+		float4 r = f4LoadUnaligned(&spheres[i + 3]);
+		f4Transpose(x, y, z, r);
+		const int outside = spheresOutside(*this, x, y, z, r);
+		if (outside == 0xf) continue;
+		written += writeIndices(outside, i, 4, out_indices + written);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		Sphere tmp[4];
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, spheres + i, sizeof(Sphere) * lanes);
+		float4 x = f4LoadUnaligned(&tmp[0]);
+		float4 y = f4LoadUnaligned(&tmp[1]);
+		float4 z = f4LoadUnaligned(&tmp[2]);
+		float4 r = f4LoadUnaligned(&tmp[3]);
+		f4Transpose(x, y, z, r);
+		const int outside = spheresOutside(*this, x, y, z, r);
+		written += writeIndices(outside, i, lanes, out_indices + written);
+	}
+	return written;
+}
+
+
+static LUMIX_FORCE_INLINE void writeFrustaMasks(Span<const Frustum> frusta, float4 x, float4 y, float4 z, float4 r, u32 lanes, u8* out_masks) {
+	u8 masks[4] = {};
+	for (u32 j = 0; j < frusta.length(); ++j) {
+		const int outside = spheresOutside(frusta[j], x, y, z, r);
+		for (u32 k = 0; k < 4; ++k) {
+			if ((outside & (1 << k)) == 0) masks[k] |= 1 << j;
+		}
+	}
+	memcpy(out_masks, masks, lanes);
+}
+
+
+void Frustum::intersectSpheres(Span<const Frustum> frusta, const Sphere* spheres, u32 count, u8* out_masks)
+{
+	ASSERT(frusta.length() <= 8);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float4 x = f4LoadUnaligned(&spheres[i]);
+		float4 y = f4LoadUnaligned(&spheres[i + 1]);
+		float4 z = f4LoadUnaligned(&spheres[i + 2]);
+		float4 r = f4LoadUnaligned(&spheres[i + 3]);
+		f4Transpose(x, y, z, r);
+		writeFrustaMasks(frusta, x, y, z, r, 4, out_masks + i);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		Sphere tmp[4];
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, spheres + i, sizeof(Sphere) * lanes);
+		float4 x = f4LoadUnaligned(&tmp[0]);
+		float4 y = f4LoadUnaligned(&tmp[1]);
+		float4 z = f4LoadUnaligned(&tmp[2]);
+		float4 r = f4LoadUnaligned(&tmp[3]);
+		f4Transpose(x, y, z, r);
+		writeFrustaMasks(frusta, x, y, z, r, lanes, out_masks + i);
+	}
+}
+
+
+void Frustum::intersectSpheres(Span<const Frustum> frusta, const float* x, const float* y, const float* z, const float* radius, u32 count, u8* out_masks)
+{
+	ASSERT(frusta.length() <= 8);
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		writeFrustaMasks(frusta, f4LoadUnaligned(x + i), f4LoadUnaligned(y + i), f4LoadUnaligned(z + i), f4LoadUnaligned(radius + i), 4, out_masks + i);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		writeFrustaMasks(frusta, loadTail(x + i, lanes), loadTail(y + i, lanes), loadTail(z + i, lanes), loadTail(radius + i, lanes), lanes, out_masks + i);
+	}
+}
+
+
+void Frustum::intersectAABBs(const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z, u32 count, float size_offset, u32* out_mask) const
+{
+	memset(out_mask, 0, sizeof(u32) * ((count + 31) / 32));
+	
+	// the most positive corner in direction of plane's normal is tested, same as intersectAABBWithOffset
+	auto test = [&](float4 x0, float4 y0, float4 z0, float4 x1, float4 y1, float4 z1) {
+		float4 dist = f4Splat(FLT_MAX);
+		for (u32 j = 0; j < 6; ++j) {
+			const float4 x = xs[j] > 0 ? x1 : x0;
+			const float4 y = ys[j] > 0 ? y1 : y0;
+			const float4 z = zs[j] > 0 ? z1 : z0;
+			dist = f4Min(dist, x * f4Splat(xs[j]) + y * f4Splat(ys[j]) + z * f4Splat(zs[j]) + f4Splat(ds[j] + size_offset));
+		}
+		return f4MoveMask(f4CmpLT(dist, f4Splat(0)));
+	};
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const int outside = test(f4LoadUnaligned(min_x + i), f4LoadUnaligned(min_y + i), f4LoadUnaligned(min_z + i)
+			, f4LoadUnaligned(max_x + i), f4LoadUnaligned(max_y + i), f4LoadUnaligned(max_z + i));
+		writeMask(outside, i, 4, out_mask);
+	}
+	if (i < count) {
+		const u32 lanes = count - i;
+		const int outside = test(loadTail(min_x + i, lanes), loadTail(min_y + i, lanes), loadTail(min_z + i, lanes)
+			, loadTail(max_x + i, lanes), loadTail(max_y + i, lanes), loadTail(max_z + i, lanes));
+		writeMask(outside, i, lanes, out_mask);
+	}
+}
+
+
 void Frustum::computeOrtho(const Vec3& position,
 	const Vec3& direction,
 	const Vec3& up,
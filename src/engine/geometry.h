@@ -63,6 +63,17 @@ struct alignas(16) LUMIX_ENGINE_API Frustum {
 	bool intersectAABB(const AABB& aabb) const;
 	bool intersectAABBWithOffset(const AABB& aabb, float size_offset) const;
 	bool isSphereInside(const Vec3& center, float radius) const;
+	// batch versions of isSphereInside and intersectAABBWithOffset, inputs are SoA arrays of `count` elements
+	// bit i of out_mask is set if element i is (partially) inside, out_mask has (count + 31) / 32 words
+	void intersectSpheres(const float* x, const float* y, const float* z, const float* radius, u32 count, u32* out_mask) const;
+	void intersectAABBs(const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z, u32 count, float size_offset, u32* out_mask) const;
+	// writes indices of (partially) inside spheres to out_indices, returns number of written indices
+	u32 cullSpheres(const float* x, const float* y, const float* z, const float* radius, u32 count, u32* out_indices) const;
+	u32 cullSpheres(const Sphere* spheres, u32 count, u32* out_indices) const;
+	// tests spheres against up to 8 frusta, each group of spheres is loaded only once for all frusta
+	// bit j of out_masks[i] is set if sphere i is (partially) inside frusta[j]
+	static void intersectSpheres(Span<const Frustum> frusta, const Sphere* spheres, u32 count, u8* out_masks);
+	static void intersectSpheres(Span<const Frustum> frusta, const float* x, const float* y, const float* z, const float* radius, u32 count, u8* out_masks);
 	Sphere computeBoundingSphere() const;
 	void transform(const Matrix& mtx);
 	Frustum transformed(const Matrix& mtx) const;
@@ -4,6 +4,7 @@
 #include "engine/delegate.h"
 #include "engine/delegate_list.h"
 #include "engine/engine.h"
+#include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/profiler.h"
 #include "engine/math.h"
@@ -33,7 +34,6 @@ struct InputSystemImpl final : InputSystem
 	explicit InputSystemImpl(Engine& engine)
 		: m_engine(engine)
 		, m_allocator(engine.getAllocator())
-		, m_events(m_allocator)
 		, m_devices(m_allocator)
 		, m_to_remove(m_allocator)
 	{
@@ -94,7 +94,11 @@ struct InputSystemImpl final : InputSystem
 			LUMIX_DELETE(m_allocator, device);
 		}
 
-		m_events.clear();
+		if (m_dropped_events > 0) {
+			logWarning("Too many input events in one frame, ", m_dropped_events, " dropped");
+			m_dropped_events = 0;
+		}
+		m_events_count = 0;
 
 		for (Device* device : m_devices) device->update(dt);
 		ControllerDevice::frame(dt);
@@ -150,14 +154,51 @@ struct InputSystemImpl final : InputSystem
 	}
 
 	
+	// consecutive axis events of the same device and axis are merged into the last one
+	// mouse moves are relative, so they are summed, controllers' axes are absolute, so the last value wins
+	bool coalesce(const Event& event) {
+		if (event.type != Event::AXIS || m_events_count == 0) return false;
+
+		Event& last = m_events[m_events_count - 1];
+		if (last.type != Event::AXIS || last.device != event.device) return false;
+
+		AxisEvent& axis = last.data.axis;
+		if (event.device->type == Device::MOUSE) {
+			axis.x += event.data.axis.x;
+			axis.y += event.data.axis.y;
+		}
+		else {
+			if (axis.axis != event.data.axis.axis) return false;
+			axis.x = event.data.axis.x;
+			axis.y = event.data.axis.y;
+		}
+		axis.x_abs = event.data.axis.x_abs;
+		axis.y_abs = event.data.axis.y_abs;
+		last.timestamp = event.timestamp;
+		return true;
+	}
+
+	
+	void clearEvents() override { m_events_count = 0; }
+
+
 	void injectEvent(const Event& event) override
 	{
-		m_events.push(event);
+		Event tmp = event;
+		tmp.timestamp = os::Timer::getRawTimestamp();
+		if (coalesce(tmp)) return;
+
+		if (m_events_count == MAX_EVENTS) {
+			++m_dropped_events;
+			return;
+		}
+		m_events[m_events_count] = tmp;
+		++m_events_count;
 	}
 
 
-	int getEventsCount() const override { return m_events.size(); }
-	const Event* getEvents() const override { return m_events.empty() ? nullptr : &m_events[0]; }
+	int getEventsCount() const override { return m_events_count; }
+	const Event* getEvents() const override { return m_events_count == 0 ? nullptr : m_events; }
 
 	int getDevicesCount() const override { return m_devices.size(); }
 	Device* getDevice(int index) override { return m_devices[index]; }
@@ -168,7 +209,9 @@ struct InputSystemImpl final : InputSystem
 	IAllocator& m_allocator;
 	MouseDevice* m_mouse_device;
 	KeyboardDevice* m_keyboard_device;
-	Array<Event> m_events;
+	Event m_events[MAX_EVENTS];
+	u32 m_events_count = 0;
+	u32 m_dropped_events = 0;
 	Array<Device*> m_devices;
 	Array<Device*> m_to_remove;
 };
@@ -60,6 +60,8 @@ struct LUMIX_ENGINE_API InputSystem {
 
 		Type type;
 		Device* device;
+		// os::Timer::getRawTimestamp() when the event was injected
+		u64 timestamp;
 		union EventData {
 			ButtonEvent button;
 			AxisEvent axis;
@@ -67,12 +69,17 @@ struct LUMIX_ENGINE_API InputSystem {
 		} data;
 	};
 
+	// events of one frame are kept in a fixed buffer, events over the limit are dropped
+	static constexpr u32 MAX_EVENTS = 1024;
+
 	static UniquePtr<InputSystem> create(struct Engine& engine);
 
 	virtual ~InputSystem() {}
 	virtual struct IAllocator& getAllocator() = 0;
 	virtual void update(float dt) = 0;
 
+	// drops events of the current frame, e.g. live input while recorded input is replayed
+	virtual void clearEvents() = 0;
 	virtual void injectEvent(const Event& event) = 0;
 	virtual void injectEvent(const os::Event& event, int mouse_base_x, int mouse_base_y) = 0;
 	virtual int getEventsCount() const = 0;
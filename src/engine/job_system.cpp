@@ -1,3 +1,4 @@
+#include "engine/allocators.h"
 #include "engine/atomic.h"
 #include "engine/array.h"
 #include "engine/engine.h"
@@ -19,6 +20,7 @@ struct Job {
 	void* data = nullptr;
 	Signal* dec_on_finish;
 	u8 worker_index;
+	Priority priority = Priority::NORMAL;
 };
 
 template <typename T, u32 CAPACITY>
@@ -97,6 +99,74 @@ struct RingBuffer {
 	Array<T> m_fallback;
 };
 
+// Chase-Lev deque, owner pushes and pops at the bottom, other workers steal from the top
+template <typename T, u32 CAPACITY>
+struct WorkStealingQueue {
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0);
+
+	// owner thread only
+	LUMIX_FORCE_INLINE bool push(const T& obj) {
+		const i32 b = bottom;
+		const i32 t = top;
+		if (b - t >= (i32)CAPACITY) return false;
+		objects[u32(b) % CAPACITY] = obj;
+		memoryBarrier();
+		bottom = b + 1;
+		return true;
+	}
+
+	// owner thread only
+	LUMIX_FORCE_INLINE bool pop(T& obj) {
+		const i32 b = bottom - 1;
+		bottom = b;
+		memoryBarrier();
+		const i32 t = top;
+		if (t > b) {
+			bottom = t;
+			return false;
+		}
+		obj = objects[u32(b) % CAPACITY];
+		if (t != b) return true;
+		
+		// last item, race with thieves
+		const bool res = compareAndExchange(&top, t + 1, t);
+		bottom = t + 1;
+		return res;
+	}
+
+	// any thread
+	LUMIX_FORCE_INLINE bool steal(T& obj, bool& contended) {
+		const i32 t = top;
+		memoryBarrier();
+		const i32 b = bottom;
+		if (t >= b) return false;
+		obj = objects[u32(t) % CAPACITY];
+		if (compareAndExchange(&top, t + 1, t)) return true;
+		contended = true;
+		return false;
+	}
+
+	LUMIX_FORCE_INLINE bool empty() const { return top >= bottom; }
+
+	T objects[CAPACITY];
+	volatile i32 top = 0;
+	volatile i32 bottom = 0;
+};
+
+static constexpr u32 FRAME_ALLOCATOR_RESERVE = 64 * 1024 * 1024;
+
+struct FrameAllocators {
+	FrameAllocators() {
+		for (Local<LinearAllocator>& a : allocators) a.create(FRAME_ALLOCATOR_RESERVE);
+	}
+
+	~FrameAllocators() {
+		for (Local<LinearAllocator>& a : allocators) a->reset();
+	}
+
+	Local<LinearAllocator> allocators[FRAME_ALLOCATORS_COUNT];
+};
+
 struct WorkerTask;
 
 struct FiberDecl {
@@ -111,6 +181,8 @@ struct FiberDecl {
 	static void manage(void* data);
 #endif
 
+static FiberDecl* popFreeFiber();
+
 struct Work {
 	Work() : type(NONE) {}
 	Work(const Job& job) : job(job), type(JOB) {}
@@ -132,9 +204,12 @@ struct System
 	System(IAllocator& allocator) 
 		: m_allocator(allocator)
 		, m_workers(allocator)
+		, m_fiber_pool(allocator)
 		, m_free_fibers(allocator)
 		, m_backup_workers(allocator)
+		, m_high_queue(allocator)
 		, m_work_queue(allocator)
+		, m_background_queue(allocator)
 		, m_sleeping_workers(allocator)
 	{}
 
@@ -145,10 +220,39 @@ struct System
 	Array<WorkerTask*> m_sleeping_workers;
 	Array<WorkerTask*> m_workers;
 	Array<WorkerTask*> m_backup_workers;
-	FiberDecl m_fiber_pool[512];
+	Array<FiberDecl> m_fiber_pool;
 	Array<FiberDecl*> m_free_fibers;
+	u32 m_fiber_stack_size = 64 * 1024;
+	volatile i32 m_fibers_created = 0;
 	IAllocator& m_allocator;
+	RingBuffer<Work, 64> m_high_queue;
 	RingBuffer<Work, 64> m_work_queue;
+	RingBuffer<Work, 64> m_background_queue;
+	FrameAllocators m_frame_allocators;
+	volatile u32 m_frame = 0;
+	volatile i32 m_running_background_jobs = 0;
+	i32 m_background_workers_limit = 1;
+	bool m_is_numa = false; // workers are on more than one numa node
+	
+	volatile i32 m_local_pushes = 0;
+	volatile i32 m_global_pushes = 0;
+	volatile i32 m_steals = 0;
+	volatile i32 m_steal_contentions = 0;
+	volatile i32 m_queued = 0;
+	volatile i32 m_fiber_switches = 0;
+	volatile i32 m_waits = 0;
+	volatile i64 m_wait_ticks = 0;
+
+	struct WaitSite {
+		const char* name;
+		bool is_mutex;
+		u32 count;
+		u64 total_ticks;
+		u64 max_ticks;
+	};
+	// guarded by m_sync
+	WaitSite m_wait_sites[128];
+	u32 m_wait_sites_count = 0;
 };
 
 
@@ -191,11 +295,7 @@ struct WorkerTask : Thread
 	#endif
 	{
 		g_system->m_sync.enter();
-		FiberDecl* fiber = g_system->m_free_fibers.back();
-		g_system->m_free_fibers.pop();
-		if (!Fiber::isValid(fiber->fiber)) {
-			fiber->fiber = Fiber::create(64 * 1024, manage, fiber);
-		}
+		FiberDecl* fiber = popFreeFiber();
 		getWorker()->m_current_fiber = fiber;
 		Fiber::switchTo(&getWorker()->m_primary_fiber, fiber->fiber);
 	}
@@ -206,9 +306,16 @@ struct WorkerTask : Thread
 	Fiber::Handle m_primary_fiber;
 	System& m_system;
 	RingBuffer<Work, 4> m_work_queue;
+	WorkStealingQueue<Work, 256> m_local_queue;
+	WorkStealingQueue<Work, 64> m_local_high_queue;
+	FrameAllocators m_frame_allocators;
 	u8 m_worker_index;
+	u8 m_numa_node = 0;
+	// on hybrid CPUs only workers on performance cores run high priority jobs
+	bool m_is_performance = true;
 	bool m_is_enabled = false;
 	bool m_is_backup = false;
+	volatile i64 m_idle_ticks = 0;
 };
 
 struct Waitor {
@@ -225,6 +332,29 @@ void wake() {
 	g_system->m_sleeping_workers.clear();
 }
 
+// jobs pushed from a worker go to its local queue, external threads use the global queue
+// background jobs always go to the global queue, so we can limit number of workers running them
+static void pushAnyWorker(const Work& work, Priority priority) {
+	atomicIncrement(&g_system->m_queued);
+	if (priority == Priority::BACKGROUND) {
+		atomicIncrement(&g_system->m_global_pushes);
+		g_system->m_background_queue.push(work, g_system->m_job_queue_sync);
+		return;
+	}
+	
+	const bool is_high = priority == Priority::HIGH;
+	WorkerTask* worker = getWorker();
+	if (worker && !worker->m_is_backup && (!is_high || worker->m_is_performance)) {
+		const bool pushed = is_high ? worker->m_local_high_queue.push(work) : worker->m_local_queue.push(work);
+		if (pushed) {
+			atomicIncrement(&g_system->m_local_pushes);
+			return;
+		}
+	}
+	atomicIncrement(&g_system->m_global_pushes);
+	(is_high ? g_system->m_high_queue : g_system->m_work_queue).push(work, g_system->m_job_queue_sync);
+}
+
 template <bool ZERO>
 LUMIX_FORCE_INLINE static bool trigger(Signal* signal)
 {
@@ -251,10 +381,13 @@ LUMIX_FORCE_INLINE static bool trigger(Signal* signal)
 			Waitor* next = waitor->next;
 			const u8 worker_idx = waitor->fiber->current_job.worker_index;
 			if (worker_idx == ANY_WORKER) {
-				g_system->m_work_queue.push(waitor->fiber, g_system->m_job_queue_sync);
+				// resumed background jobs do not wait for a free background worker, they already started
+				const Priority priority = waitor->fiber->current_job.priority;
+				pushAnyWorker(waitor->fiber, priority == Priority::HIGH ? Priority::HIGH : Priority::NORMAL);
 			}
 			else {
 				WorkerTask* worker = g_system->m_workers[worker_idx % g_system->m_workers.size()];
+				atomicIncrement(&g_system->m_queued);
 				worker->m_work_queue.push(waitor->fiber, g_system->m_job_queue_sync);
 			}
 			waitor = next;
@@ -314,48 +447,97 @@ void setGreen(Signal* signal) {
 }
 
 
-void run(void* data, void(*task)(void*), Signal* on_finished)
+static void increment(Signal* signal) {
+	Lumix::MutexGuard guard(g_system->m_sync);
+	++signal->counter;
+	if (signal->counter == 1) {
+		signal->generation = atomicIncrement(&g_generation);
+	}
+}
+
+void run(void* data, void(*task)(void*), Signal* on_finished, Priority priority)
 {
-	runEx(data, task, on_finished, ANY_WORKER);
+	runEx(data, task, on_finished, ANY_WORKER, priority);
 }
 
 
-void runEx(void* data, void(*task)(void*), Signal* on_finished, u8 worker_index)
+void runEx(void* data, void(*task)(void*), Signal* on_finished, u8 worker_index, Priority priority)
 {
 	Job job;
 	job.data = data;
 	job.task = task;
 	job.worker_index = worker_index != ANY_WORKER ? worker_index % getWorkersCount() : worker_index;
 	job.dec_on_finish = on_finished;
+	job.priority = priority;
 
-	if (on_finished) {
-		Lumix::MutexGuard guard(g_system->m_sync);
-		++on_finished->counter;
-		if (on_finished->counter == 1) {
-			on_finished->generation = atomicIncrement(&g_generation);
-		}
-	}
+	if (on_finished) increment(on_finished);
 
 	if (worker_index != ANY_WORKER) {
 		WorkerTask* worker = g_system->m_workers[worker_index % g_system->m_workers.size()];
+		atomicIncrement(&g_system->m_queued);
 		worker->m_work_queue.push(job, g_system->m_job_queue_sync);
 		wake();
 		return;
 	}
 
-	g_system->m_work_queue.push(job, g_system->m_job_queue_sync);
+	pushAnyWorker(job, priority);
 	wake();
 }
 
+// workers on the same numa node are tried first, their jobs likely touch memory local to us
+template <auto QUEUE>
+static bool steal(Work& work, WorkerTask* worker) {
+	const u32 count = g_system->m_workers.size();
+	const u32 start = worker->m_is_backup ? 0 : worker->m_worker_index + 1;
+	for (u32 pass = 0; pass < (g_system->m_is_numa ? 2u : 1u); ++pass) {
+		for (u32 i = 0; i < count; ++i) {
+			WorkerTask* victim = g_system->m_workers[(start + i) % count];
+			if (victim == worker) continue;
+			if (g_system->m_is_numa && (victim->m_numa_node == worker->m_numa_node) != (pass == 0)) continue;
+			
+			bool contended = false;
+			if ((victim->*QUEUE).steal(work, contended)) {
+				atomicIncrement(&g_system->m_steals);
+				return true;
+			}
+			if (contended) atomicIncrement(&g_system->m_steal_contentions);
+		}
+	}
+	return false;
+}
+
+static bool popBackgroundWork(Work& work) {
+	if (atomicIncrement(&g_system->m_running_background_jobs) <= g_system->m_background_workers_limit) {
+		if (g_system->m_background_queue.pop(work)) return true;
+		Lumix::MutexGuard lock(g_system->m_job_queue_sync);
+		if (g_system->m_background_queue.popSecondary(work)) return true;
+	}
+	atomicDecrement(&g_system->m_running_background_jobs);
+	return false;
+}
+
 static bool popWork(Work& work, WorkerTask* worker) {
 	if (worker->m_work_queue.pop(work)) return true;
+	if (worker->m_is_performance) {
+		if (!worker->m_is_backup && worker->m_local_high_queue.pop(work)) return true;
+		if (g_system->m_high_queue.pop(work)) return true;
+		if (steal<&WorkerTask::m_local_high_queue>(work, worker)) return true;
+	}
+	
+	if (!worker->m_is_backup && worker->m_local_queue.pop(work)) return true;
+	{
+		Lumix::MutexGuard lock(g_system->m_job_queue_sync);
+		if (worker->m_work_queue.popSecondary(work)) return true;
+		if (worker->m_is_performance && g_system->m_high_queue.popSecondary(work)) return true;
+	}
 	if (g_system->m_work_queue.pop(work)) return true;
+	if (steal<&WorkerTask::m_local_queue>(work, worker)) return true;
+	{
+		Lumix::MutexGuard lock(g_system->m_job_queue_sync);
+		if (g_system->m_work_queue.popSecondary(work)) return true;
+	}
 
-	Lumix::MutexGuard lock(g_system->m_job_queue_sync);
-	if (worker->m_work_queue.popSecondary(work)) return true;
-	if (g_system->m_work_queue.popSecondary(work)) return true;
-
-	return false;
+	return popBackgroundWork(work);
 }
 
 #ifdef _WIN32
@@ -390,18 +572,22 @@ static bool popWork(Work& work, WorkerTask* worker) {
 				PROFILE_BLOCK("sleeping");
 				profiler::blockColor(0x30, 0x30, 0x30);
 				g_system->m_sleeping_workers.push(worker);
+				const u64 sleep_start = os::Timer::getRawTimestamp();
 				worker->sleep(g_system->m_sleeping_sync);
+				atomicAdd(&worker->m_idle_ticks, i64(os::Timer::getRawTimestamp() - sleep_start));
 			}
 
 			if (worker->m_is_backup) break;
 		}
 		if (worker->m_finished) break;
+		atomicDecrement(&g_system->m_queued);
 
 		if (work.type == Work::FIBER) {
 			worker->m_current_fiber = work.fiber;
 
 			g_system->m_sync.enter();
 			g_system->m_free_fibers.push(this_fiber);
+			atomicIncrement(&g_system->m_fiber_switches);
 			Fiber::switchTo(&this_fiber->fiber, work.fiber->fiber);
 			g_system->m_sync.exit();
 
@@ -411,14 +597,30 @@ static bool popWork(Work& work, WorkerTask* worker) {
 		else if (work.type == Work::JOB) {
 			if (!work.job.task) continue;
 
-			profiler::beginBlock("job");
-			profiler::blockColor(0x60, 0x60, 0x60);
+			const bool is_background = work.job.priority == Priority::BACKGROUND && work.job.worker_index == ANY_WORKER;
+			switch (work.job.priority) {
+				case Priority::HIGH:
+					profiler::beginBlock("high priority job");
+					profiler::blockColor(0x80, 0x50, 0x50);
+					break;
+				case Priority::NORMAL:
+					profiler::beginBlock("job");
+					profiler::blockColor(0x60, 0x60, 0x60);
+					break;
+				case Priority::BACKGROUND:
+					profiler::beginBlock("background job");
+					profiler::blockColor(0x40, 0x40, 0x60);
+					break;
+			}
 			if (work.job.dec_on_finish) {
 				profiler::pushJobInfo(work.job.dec_on_finish->generation);
 			}
 			this_fiber->current_job = work.job;
 			work.job.task(work.job.data);
 			this_fiber->current_job.task = nullptr;
+			if (is_background) {
+				atomicDecrement(&g_system->m_running_background_jobs);
+			}
 			if (work.job.dec_on_finish) {
 				trigger<false>(work.job.dec_on_finish);
 			}
@@ -430,28 +632,41 @@ static bool popWork(Work& work, WorkerTask* worker) {
 }
 
 
-bool init(u8 workers_count, IAllocator& allocator)
+// m_sync must be locked
+static FiberDecl* popFreeFiber() {
+	// each worker needs one fiber and each waiting job keeps one, see fibers_count in init()
+	ASSERT(!g_system->m_free_fibers.empty());
+	FiberDecl* fiber = g_system->m_free_fibers.back();
+	g_system->m_free_fibers.pop();
+	if (!Fiber::isValid(fiber->fiber)) {
+		fiber->fiber = Fiber::create(g_system->m_fiber_stack_size, manage, fiber);
+		++g_system->m_fibers_created;
+	}
+	return fiber;
+}
+
+bool init(u8 workers_count, IAllocator& allocator, u32 first_cpu, u32 fibers_count, u32 fiber_stack_size)
 {
 	g_system.create(allocator);
 
-	g_system->m_free_fibers.reserve(lengthOf(g_system->m_fiber_pool));
-	for (FiberDecl& fiber : g_system->m_fiber_pool) {
-		g_system->m_free_fibers.push(&fiber);
-	}
-
-	const int fiber_num = lengthOf(g_system->m_fiber_pool);
-	for(int i = 0; i < fiber_num; ++i) { 
-		FiberDecl& decl = g_system->m_fiber_pool[i];
-		decl.idx = i;
+	// free fibers are reused in LIFO order, so only as many stacks as needed at peak are ever allocated
+	const u32 fiber_num = maximum(fibers_count, u32(workers_count) * 2);
+	g_system->m_fiber_stack_size = fiber_stack_size;
+	g_system->m_fiber_pool.resize(fiber_num);
+	g_system->m_free_fibers.reserve(fiber_num);
+	for (u32 i = 0; i < fiber_num; ++i) {
+		FiberDecl& decl = g_system->m_fiber_pool[fiber_num - i - 1];
+		decl.idx = fiber_num - i - 1;
+		g_system->m_free_fibers.push(&decl);
 	}
 
 	int count = maximum(1, int(workers_count));
 	for (int i = 0; i < count; ++i) {
-		WorkerTask* task = LUMIX_NEW(allocator, WorkerTask)(*g_system, i < 64 ? u64(1) << i : 0);
+		WorkerTask* task = LUMIX_NEW(allocator, WorkerTask)(*g_system, i);
 		if (task->create("Worker", false)) {
 			task->m_is_enabled = true;
 			g_system->m_workers.push(task);
-			task->setAffinityMask((u64)1 << i);
+			task->setAffinityMask((u64)1 << ((first_cpu + i) & 63));
 		}
 		else {
 			logError("Job system worker failed to initialize.");
@@ -459,9 +674,109 @@ bool init(u8 workers_count, IAllocator& allocator)
 		}
 	}
 
+	g_system->m_background_workers_limit = maximum(1, g_system->m_workers.size() / 2);
+
+	// classify workers by the CPU they are pinned to
+	os::CPUInfo cpus[64];
+	const u32 cpus_count = os::getCPUTopology(Span(cpus));
+	u8 max_efficiency_class = 0;
+	for (WorkerTask* task : g_system->m_workers) {
+		const u32 cpu = (first_cpu + task->m_worker_index) & 63;
+		if (cpu >= cpus_count) continue;
+		task->m_numa_node = cpus[cpu].numa_node;
+		max_efficiency_class = maximum(max_efficiency_class, cpus[cpu].efficiency_class);
+		if (task->m_numa_node != g_system->m_workers[0]->m_numa_node) g_system->m_is_numa = true;
+	}
+	u32 performance_workers = 0;
+	for (WorkerTask* task : g_system->m_workers) {
+		const u32 cpu = (first_cpu + task->m_worker_index) & 63;
+		task->m_is_performance = cpu >= cpus_count || cpus[cpu].efficiency_class == max_efficiency_class;
+		if (task->m_is_performance) ++performance_workers;
+	}
+	if (g_system->m_is_numa || performance_workers != (u32)g_system->m_workers.size()) {
+		logInfo("Job system: ", performance_workers, " of ", g_system->m_workers.size(), " workers on performance cores", g_system->m_is_numa ? ", multiple NUMA nodes" : "");
+	}
+
 	return !g_system->m_workers.empty();
 }
 
+void setBackgroundWorkersLimit(u8 count) {
+	g_system->m_background_workers_limit = maximum(1, (i32)count);
+}
+
+
+IAllocator& getFrameAllocator() {
+	const u32 idx = g_system->m_frame % FRAME_ALLOCATORS_COUNT;
+	WorkerTask* worker = getWorker();
+	if (worker) return *worker->m_frame_allocators.allocators[idx];
+	return *g_system->m_frame_allocators.allocators[idx];
+}
+
+void nextFrame() {
+	const u32 idx = (g_system->m_frame + 1) % FRAME_ALLOCATORS_COUNT;
+	
+	// nobody can allocate from idx until m_frame is incremented
+	g_system->m_frame_allocators.allocators[idx]->reset();
+	for (WorkerTask* worker : g_system->m_workers) {
+		worker->m_frame_allocators.allocators[idx]->reset();
+	}
+	{
+		Lumix::MutexGuard lock(g_system->m_sync);
+		for (WorkerTask* worker : g_system->m_backup_workers) {
+			worker->m_frame_allocators.allocators[idx]->reset();
+		}
+	}
+	memoryBarrier();
+	++g_system->m_frame;
+}
+
+Stats getStats(bool reset) {
+	Stats res;
+	res.local_pushes = g_system->m_local_pushes;
+	res.global_pushes = g_system->m_global_pushes;
+	res.steals = g_system->m_steals;
+	res.steal_contentions = g_system->m_steal_contentions;
+	res.queued = maximum(0, g_system->m_queued);
+	res.fiber_switches = g_system->m_fiber_switches;
+	res.waits = g_system->m_waits;
+	const i64 wait_ticks = g_system->m_wait_ticks;
+	res.wait_ms = float(wait_ticks / double(os::Timer::getFrequency()) * 1000);
+	res.fibers_created = g_system->m_fibers_created;
+	if (reset) {
+		atomicSubtract(&g_system->m_local_pushes, res.local_pushes);
+		atomicSubtract(&g_system->m_global_pushes, res.global_pushes);
+		atomicSubtract(&g_system->m_steals, res.steals);
+		atomicSubtract(&g_system->m_steal_contentions, res.steal_contentions);
+		atomicSubtract(&g_system->m_fiber_switches, res.fiber_switches);
+		atomicSubtract(&g_system->m_waits, res.waits);
+		atomicAdd(&g_system->m_wait_ticks, -wait_ticks);
+	}
+	return res;
+}
+
+u32 getWaitSiteStats(Span<WaitSiteStats> stats, bool reset) {
+	Lumix::MutexGuard lock(g_system->m_sync);
+	const double to_ms = 1000.0 / os::Timer::getFrequency();
+	const u32 count = g_system->m_wait_sites_count;
+	for (u32 i = 0, c = minimum(count, stats.length()); i < c; ++i) {
+		const System::WaitSite& site = g_system->m_wait_sites[i];
+		stats[i].name = site.name;
+		stats[i].is_mutex = site.is_mutex;
+		stats[i].count = site.count;
+		stats[i].total_ms = float(site.total_ticks * to_ms);
+		stats[i].max_ms = float(site.max_ticks * to_ms);
+	}
+	if (reset) g_system->m_wait_sites_count = 0;
+	return count;
+}
+
+float getWorkerIdleTime(u8 worker_index, bool reset) {
+	if (worker_index >= g_system->m_workers.size()) return 0;
+	WorkerTask* worker = g_system->m_workers[worker_index];
+	const i64 ticks = worker->m_idle_ticks;
+	if (reset) atomicAdd(&worker->m_idle_ticks, -ticks);
+	return float(ticks / double(os::Timer::getFrequency()));
+}
 
 u8 getWorkersCount()
 {
@@ -512,6 +827,43 @@ void shutdown()
 	g_system.destroy();
 }
 
+// m_sync must be locked
+static void recordWait(const profiler::FiberSwitchData& switch_data, bool is_mutex, u64 ticks) {
+	atomicIncrement(&g_system->m_waits);
+	atomicAdd(&g_system->m_wait_ticks, (i64)ticks);
+
+	const char* name = "unknown";
+	for (u32 i = minimum(switch_data.count, lengthOf(switch_data.block_names)); i > 0; --i) {
+		if (switch_data.block_names[i - 1]) {
+			name = switch_data.block_names[i - 1];
+			break;
+		}
+	}
+
+	// block names are literals, so we can compare pointers
+	System::WaitSite* site = nullptr;
+	for (u32 i = 0; i < g_system->m_wait_sites_count; ++i) {
+		System::WaitSite& s = g_system->m_wait_sites[i];
+		if (s.name == name && s.is_mutex == is_mutex) {
+			site = &s;
+			break;
+		}
+	}
+	if (!site) {
+		if (g_system->m_wait_sites_count == lengthOf(g_system->m_wait_sites)) return;
+		site = &g_system->m_wait_sites[g_system->m_wait_sites_count];
+		++g_system->m_wait_sites_count;
+		site->name = name;
+		site->is_mutex = is_mutex;
+		site->count = 0;
+		site->total_ticks = 0;
+		site->max_ticks = 0;
+	}
+	++site->count;
+	site->total_ticks += ticks;
+	site->max_ticks = maximum(site->max_ticks, ticks);
+}
+
 static void waitEx(Signal* signal, bool is_mutex)
 {
 	ASSERT(signal);
@@ -533,6 +885,11 @@ static void waitEx(Signal* signal, bool is_mutex)
 	}
 
 	FiberDecl* this_fiber = getWorker()->m_current_fiber;
+	
+	// waiting background job does not occupy a background worker, otherwise jobs spawned by it could never run
+	const Job& job = this_fiber->current_job;
+	const bool is_background = job.task && job.priority == Priority::BACKGROUND && job.worker_index == ANY_WORKER;
+	if (is_background) atomicDecrement(&g_system->m_running_background_jobs);
 
 	Waitor waitor;
 	waitor.fiber = this_fiber;
@@ -540,15 +897,15 @@ static void waitEx(Signal* signal, bool is_mutex)
 	signal->waitor = &waitor;
 
 	const profiler::FiberSwitchData& switch_data = profiler::beginFiberWait(signal->generation, is_mutex);
-	FiberDecl* new_fiber = g_system->m_free_fibers.back();
-	g_system->m_free_fibers.pop();
-	if (!Fiber::isValid(new_fiber->fiber)) {
-		new_fiber->fiber = Fiber::create(64 * 1024, manage, new_fiber);
-	}
+	const u64 wait_start = os::Timer::getRawTimestamp();
+	FiberDecl* new_fiber = popFreeFiber();
 	getWorker()->m_current_fiber = new_fiber;
+	atomicIncrement(&g_system->m_fiber_switches);
 	Fiber::switchTo(&this_fiber->fiber, new_fiber->fiber);
 	getWorker()->m_current_fiber = this_fiber;
+	recordWait(switch_data, is_mutex, os::Timer::getRawTimestamp() - wait_start);
 	g_system->m_sync.exit();
+	if (is_background) atomicIncrement(&g_system->m_running_background_jobs);
 	profiler::endFiberWait(switch_data);
 }
 
@@ -571,4 +928,96 @@ void wait(Signal* handle) {
 	waitEx(handle, false);
 }
 
+Graph::Graph(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_nodes(allocator)
+	, m_edges(allocator)
+	, m_dependents(allocator)
+{}
+
+Graph::~Graph() {
+	clear();
+}
+
+void Graph::clear() {
+	for (Node& node : m_nodes) {
+		if (node.destructor) node.destructor(m_allocator, node.data);
+	}
+	m_nodes.clear();
+	m_edges.clear();
+	m_dependents.clear();
+}
+
+u32 Graph::addNode(void* data, void (*task)(void*), Priority priority) {
+	Node& node = m_nodes.emplace();
+	node.task = task;
+	node.data = data;
+	node.destructor = nullptr;
+	node.graph = this;
+	node.priority = priority;
+	node.dependencies_count = 0;
+	node.first_dependent = 0;
+	node.dependents_count = 0;
+	node.pending = 0;
+	return m_nodes.size() - 1;
+}
+
+void Graph::addDependency(u32 node, u32 dependency) {
+	ASSERT(node != dependency);
+	m_edges.push({node, dependency});
+}
+
+void Graph::execute(void* data) {
+	Node* node = (Node*)data;
+	node->task(node->data);
+	
+	// dependents are queued before this job finishes, so on_finish can not turn green in between
+	Graph& graph = *node->graph;
+	for (u32 i = 0; i < node->dependents_count; ++i) {
+		Node& dependent = graph.m_nodes[graph.m_dependents[node->first_dependent + i]];
+		if (atomicDecrement(&dependent.pending) == 0) {
+			runEx(&dependent, &Graph::execute, graph.m_on_finish, ANY_WORKER, dependent.priority);
+		}
+	}
+}
+
+void Graph::run(Signal* on_finish) {
+	if (m_nodes.empty()) return;
+	
+	for (Node& node : m_nodes) {
+		node.dependencies_count = 0;
+		node.dependents_count = 0;
+	}
+	for (const Edge& edge : m_edges) {
+		++m_nodes[edge.node].dependencies_count;
+		++m_nodes[edge.dependency].dependents_count;
+	}
+	u32 offset = 0;
+	for (Node& node : m_nodes) {
+		node.first_dependent = offset;
+		node.pending = node.dependencies_count;
+		offset += node.dependents_count;
+		node.dependents_count = 0;
+	}
+	m_dependents.resize(offset);
+	for (const Edge& edge : m_edges) {
+		Node& dependency = m_nodes[edge.dependency];
+		m_dependents[dependency.first_dependent + dependency.dependents_count] = edge.node;
+		++dependency.dependents_count;
+	}
+
+	m_on_finish = on_finish;
+	// keep on_finish red until all roots are queued, a root can finish with all its dependents before the rest is queued
+	if (on_finish) increment(on_finish);
+	bool any_root = false;
+	for (Node& node : m_nodes) {
+		if (node.dependencies_count == 0) {
+			any_root = true;
+			runEx(&node, &Graph::execute, on_finish, ANY_WORKER, node.priority);
+		}
+	}
+	ASSERT(any_root); // cycle
+	if (on_finish) trigger<false>(on_finish);
+}
+
 } // namespace Lumix::jobs
@@ -1,5 +1,7 @@
 #pragma once
 #include "lumix.h"
+#include "engine/array.h"
+#include "engine/atomic.h"
 
 namespace Lumix {
 
@@ -8,16 +10,60 @@ struct IAllocator;
 namespace jobs {
 
 constexpr u8 ANY_WORKER = 0xff;
+constexpr u32 FRAME_ALLOCATORS_COUNT = 4;
 
 struct Mutex;
 struct Signal;
 
-LUMIX_ENGINE_API bool init(u8 workers_count, IAllocator& allocator);
+enum class Priority : u8 {
+	HIGH, // frame-critical work, always picked first
+	NORMAL,
+	BACKGROUND // runs only on limited number of workers, see setBackgroundWorkersLimit
+};
+
+struct Stats {
+	i32 local_pushes; // pushed to worker's own queue
+	i32 global_pushes; // pushed to shared queue, e.g. from non-worker threads or when local queue is full
+	i32 steals;
+	i32 steal_contentions; // steal attempts lost to another thread
+	i32 queued; // jobs and resumed fibers waiting in queues right now, not affected by reset
+	i32 fiber_switches;
+	i32 waits; // waits in wait() and enter() which had to switch fiber
+	float wait_ms; // total time of such waits, can be more than frame time since many fibers wait at once
+	i32 fibers_created; // fibers with allocated stack, i.e. peak number of parked fibers, not affected by reset
+};
+
+// waits aggregated by the innermost profiler block open at the time of wait
+struct WaitSiteStats {
+	const char* name; // profiler block name, "unknown" if there's none
+	bool is_mutex;
+	u32 count;
+	float total_ms;
+	float max_ms;
+};
+
+// worker i is pinned to CPU first_cpu + i
+// jobs run on the worker's current fiber, another fiber is taken from the pool only when a job waits,
+// so fibers_count limits the number of jobs waiting at once, stacks are allocated on first use
+LUMIX_ENGINE_API bool init(u8 workers_count, IAllocator& allocator, u32 first_cpu = 0, u32 fibers_count = 512, u32 fiber_stack_size = 64 * 1024);
 LUMIX_ENGINE_API IAllocator& getAllocator();
 LUMIX_ENGINE_API void shutdown();
 LUMIX_ENGINE_API u8 getWorkersCount();
+LUMIX_ENGINE_API Stats getStats(bool reset);
+// returns number of sites, only first stats.length() are written
+LUMIX_ENGINE_API u32 getWaitSiteStats(Span<WaitSiteStats> stats, bool reset);
+// seconds the worker spent sleeping because it had no work
+LUMIX_ENGINE_API float getWorkerIdleTime(u8 worker_index, bool reset);
+
+// linear allocator owned by the calling worker, memory must not be freed but it's valid 
+// for FRAME_ALLOCATORS_COUNT - 1 calls of nextFrame(), non-worker threads share one allocator
+LUMIX_ENGINE_API IAllocator& getFrameAllocator();
+// resets the oldest frame allocators, call once per frame
+LUMIX_ENGINE_API void nextFrame();
 
 LUMIX_ENGINE_API void enableBackupWorker(bool enable);
+// max number of workers executing background jobs at the same time, default is half of the workers
+LUMIX_ENGINE_API void setBackgroundWorkersLimit(u8 count);
 
 LUMIX_ENGINE_API void enter(Mutex* mutex);
 LUMIX_ENGINE_API void exit(Mutex* mutex);
@@ -25,19 +71,19 @@ LUMIX_ENGINE_API void exit(Mutex* mutex);
 LUMIX_ENGINE_API void setRed(Signal* signal);
 LUMIX_ENGINE_API void setGreen(Signal* signal);
 
-LUMIX_ENGINE_API void run(void* data, void(*task)(void*), Signal* on_finish);
-LUMIX_ENGINE_API void runEx(void* data, void (*task)(void*), Signal* on_finish, u8 worker_index);
+LUMIX_ENGINE_API void run(void* data, void(*task)(void*), Signal* on_finish, Priority priority = Priority::NORMAL);
+LUMIX_ENGINE_API void runEx(void* data, void (*task)(void*), Signal* on_finish, u8 worker_index, Priority priority = Priority::NORMAL);
 LUMIX_ENGINE_API void wait(Signal* signal);
 
 template <typename F>
-void runLambda(F&& f, Signal* on_finish, u8 worker = ANY_WORKER) {
+void runLambda(F&& f, Signal* on_finish, u8 worker = ANY_WORKER, Priority priority = Priority::NORMAL) {
 	void* arg;
 	if constexpr (sizeof(f) == sizeof(void*) && __is_trivially_copyable(F)) {
 		memcpy(&arg, &f, sizeof(arg));
 		runEx(arg, [](void* arg){
 			F* f = (F*)&arg;
 			(*f)();
-		}, on_finish, worker);
+		}, on_finish, worker, priority);
 	}
 	else {
 		F* tmp = LUMIX_NEW(getAllocator(), F)(static_cast<F&&>(f));
@@ -45,7 +91,7 @@ void runLambda(F&& f, Signal* on_finish, u8 worker = ANY_WORKER) {
 			F* f = (F*)arg;
 			(*f)();
 			LUMIX_DELETE(getAllocator(), f);
-		}, on_finish, worker);
+		}, on_finish, worker, priority);
 
 	}
 }
@@ -86,6 +132,80 @@ void forEach(i32 count, i32 step, const F& f)
 	});
 }
 
+// picks chunk size automatically, chunks get smaller as the remaining work shrinks,
+// so large ranges need only a few atomic operations per worker while the tail is still balanced
+template <typename F>
+void forEach(i32 count, const F& f)
+{
+	if (count == 0) return;
+	const i32 workers_count = getWorkersCount();
+	if (count == 1 || workers_count == 1) {
+		f(0, count);
+		return;
+	}
+
+	volatile i32 offset = 0;
+
+	jobs::runOnWorkers([&](){
+		for(;;) {
+			const i32 idx = offset;
+			if (idx >= count) break;
+			i32 step = (count - idx) / (workers_count * 2);
+			step = step < 1 ? 1 : step;
+			if (!compareAndExchange(&offset, idx + step, idx)) continue;
+			f(idx, idx + step);
+		}
+	});
+}
+
+// set of jobs with dependencies between them, submitted with a single call
+// a node is queued as soon as all its dependencies are finished, there are no intermediate waits
+struct LUMIX_ENGINE_API Graph {
+	explicit Graph(IAllocator& allocator);
+	~Graph();
+
+	u32 addNode(void* data, void (*task)(void*), Priority priority = Priority::NORMAL);
+	// `node` runs after `dependency` is finished
+	void addDependency(u32 node, u32 dependency);
+	// on_finish is green when all nodes are finished, graph must not be modified nor destroyed before that
+	void run(Signal* on_finish);
+	void clear();
+
+	template <typename F>
+	u32 addLambda(F&& f, Priority priority = Priority::NORMAL) {
+		F* tmp = LUMIX_NEW(m_allocator, F)(static_cast<F&&>(f));
+		const u32 idx = addNode(tmp, [](void* arg){ (*(F*)arg)(); }, priority);
+		m_nodes[idx].destructor = [](IAllocator& allocator, void* arg){ LUMIX_DELETE(allocator, (F*)arg); };
+		return idx;
+	}
+
+	struct Node {
+		void (*task)(void*);
+		void* data;
+		void (*destructor)(IAllocator&, void*);
+		Graph* graph;
+		Priority priority;
+		u32 dependencies_count;
+		u32 first_dependent;
+		u32 dependents_count;
+		volatile i32 pending;
+	};
+
+	struct Edge {
+		u32 node;
+		u32 dependency;
+	};
+
+private:
+	static void execute(void* data);
+
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<Edge> m_edges;
+	Array<u32> m_dependents;
+	Signal* m_on_finish = nullptr;
+};
+
 struct MutexGuard {
 	MutexGuard(Mutex& mutex) : mutex(mutex) { enter(&mutex); }
 	~MutexGuard() { exit(&mutex); }
@@ -4,6 +4,8 @@
 #include <ucontext.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace Lumix
 {
@@ -25,12 +27,20 @@ void initThread(FiberProc proc, Handle* out)
 }
 
 
+// stack is reserved with an inaccessible guard page below it, so an overflow crashes right away,
+// pages are committed by the OS on first touch
 Handle create(int stack_size, FiberProc proc, void* parameter)
 {
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t size = (size_t(stack_size) + page_size - 1) / page_size * page_size;
+	u8* mem = (u8*)mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	ASSERT(mem != MAP_FAILED);
+	mprotect(mem, page_size, PROT_NONE);
+
 	ucontext_t fib;
 	getcontext(&fib);
-    fib.uc_stack.ss_sp = (::malloc)(stack_size);
-    fib.uc_stack.ss_size = stack_size;
+    fib.uc_stack.ss_sp = mem + page_size;
+    fib.uc_stack.ss_size = size;
     fib.uc_link = 0;
     makecontext(&fib, (void(*)())proc, 1, parameter); 
 	return fib;
@@ -43,7 +53,8 @@ bool isValid(Handle handle)
 
 void destroy(Handle fiber)
 {
-	ASSERT(false);
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	munmap((u8*)fiber.uc_stack.ss_sp - page_size, fiber.uc_stack.ss_size + page_size);
 }
 
 
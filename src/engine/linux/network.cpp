@@ -0,0 +1,117 @@
+#include "engine/os.h"
+#include "engine/string.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace Lumix::os {
+
+
+static constexpr uintptr INVALID_SOCKET = ~uintptr(0);
+
+
+Socket::Socket() : m_handle(INVALID_SOCKET) {}
+
+
+Socket::~Socket() { close(); }
+
+
+bool Socket::isOpen() const { return m_handle != INVALID_SOCKET; }
+
+
+void Socket::close() {
+	if (m_handle == INVALID_SOCKET) return;
+	::close((int)m_handle);
+	m_handle = INVALID_SOCKET;
+}
+
+
+bool Socket::listen(u16 port) {
+	close();
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) return false;
+
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 1) != 0) {
+		::close(fd);
+		return false;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	m_handle = (uintptr)fd;
+	return true;
+}
+
+
+bool Socket::accept(Socket& client) {
+	if (m_handle == INVALID_SOCKET) return false;
+	const int fd = ::accept((int)m_handle, nullptr, nullptr);
+	if (fd < 0) return false;
+
+	// accepted sockets inherit O_NONBLOCK on some systems
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	int nodelay = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	client.close();
+	client.m_handle = (uintptr)fd;
+	return true;
+}
+
+
+bool Socket::connect(const char* host, u16 port) {
+	close();
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* result;
+	char port_str[8];
+	toCString(port, Span(port_str));
+	if (getaddrinfo(host, port_str, &hints, &result) != 0) return false;
+
+	const int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	if (fd < 0 || ::connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+		if (fd >= 0) ::close(fd);
+		freeaddrinfo(result);
+		return false;
+	}
+	freeaddrinfo(result);
+	m_handle = (uintptr)fd;
+	return true;
+}
+
+
+bool Socket::send(const void* data, u32 size) {
+	if (m_handle == INVALID_SOCKET) return false;
+	const u8* ptr = (const u8*)data;
+	while (size > 0) {
+		const ssize_t sent = ::send((int)m_handle, ptr, size, MSG_NOSIGNAL);
+		if (sent <= 0) return false;
+		ptr += sent;
+		size -= (u32)sent;
+	}
+	return true;
+}
+
+
+i32 Socket::receive(void* data, u32 size) {
+	if (m_handle == INVALID_SOCKET) return -1;
+	const ssize_t received = recv((int)m_handle, data, size, MSG_DONTWAIT);
+	if (received > 0) return (i32)received;
+	if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+	return -1;
+}
+
+
+} // namespace Lumix::os
@@ -409,6 +409,50 @@ bool InputFile::seek(u64 pos) {
 u32 getCPUsCount() {
 	return sysconf(_SC_NPROCESSORS_ONLN);
 }
+
+static u32 readSysU32(const char* path) {
+	FILE* fp = fopen(path, "rb");
+	if (!fp) return 0;
+	u32 value = 0;
+	if (fscanf(fp, "%u", &value) != 1) value = 0;
+	fclose(fp);
+	return value;
+}
+
+// linux does not report core types, so cores with max frequency in the upper half of the range are considered performance cores
+u32 getCPUTopology(Span<CPUInfo> cpus) {
+	const u32 count = minimum(getCPUsCount(), 64u);
+	u32 max_freqs[64];
+	u32 min_freq = 0xffFFffFF;
+	u32 max_freq = 0;
+	for (u32 i = 0; i < count; ++i) {
+		StaticString<LUMIX_MAX_PATH> path("/sys/devices/system/cpu/cpu", i, "/cpufreq/cpuinfo_max_freq");
+		max_freqs[i] = readSysU32(path);
+		min_freq = minimum(min_freq, max_freqs[i]);
+		max_freq = maximum(max_freq, max_freqs[i]);
+	}
+
+	for (u32 i = 0; i < minimum(count, cpus.length()); ++i) {
+		cpus[i] = {};
+		cpus[i].efficiency_class = max_freq != min_freq && max_freqs[i] * 2 > max_freq + min_freq ? 1 : 0;
+
+		// cpu directory contains a nodeN link to its numa node
+		StaticString<LUMIX_MAX_PATH> dir_path("/sys/devices/system/cpu/cpu", i);
+		DIR* dir = opendir(dir_path);
+		if (!dir) continue;
+		while (dirent* entry = readdir(dir)) {
+			if (startsWith(entry->d_name, "node")) {
+				u32 node = 0;
+				const char* node_str = entry->d_name + 4;
+				fromCString(Span(node_str, stringLength(node_str)), node);
+				cpus[i].numa_node = (u8)node;
+				break;
+			}
+		}
+		closedir(dir);
+	}
+	return count;
+}
 void sleep(u32 milliseconds) {
 	if (milliseconds) usleep(useconds_t(milliseconds * 1000));
 }
@@ -640,7 +684,7 @@ WindowHandle createWindow(const InitWindowArgs& args) {
 	XSetWindowAttributes attr = {};
 	XChangeWindowAttributes(display, win, CWBackPixel, &attr);
 
-	XMapWindow(display, win);
+	if (!(args.flags & InitWindowArgs::HIDDEN)) XMapWindow(display, win);
 	XStoreName(display, win, args.name && args.name[0] ? args.name : "Lumix App");
 
 	G.ic = XCreateIC(G.im, XNInputStyle, 0 | XIMPreeditNothing | XIMStatusNothing, XNClientWindow, win, NULL);
@@ -916,6 +960,34 @@ void memRelease(void* ptr, size_t size) {
 	munmap(ptr, size);
 }
 
+void memDecommit(void* ptr, size_t size) {
+	madvise(ptr, size, MADV_DONTNEED);
+}
+
+size_t getLargeMemPageSize() {
+	return 2 * 1024 * 1024;
+}
+
+void* memReserveLargePages(size_t size) {
+	const size_t large_page_size = getLargeMemPageSize();
+	ASSERT(size % large_page_size == 0);
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (mem != MAP_FAILED) return mem;
+
+	// no preallocated huge pages, try transparent huge pages, they need aligned memory
+	u8* unaligned = (u8*)mmap(nullptr, size + large_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (unaligned == MAP_FAILED) return nullptr;
+	
+	u8* aligned = (u8*)(((uintptr)unaligned + large_page_size - 1) & ~(uintptr)(large_page_size - 1));
+	if (aligned != unaligned) munmap(unaligned, aligned - unaligned);
+	munmap(aligned + size, unaligned + large_page_size - aligned);
+	if (madvise(aligned, size, MADV_HUGEPAGE) != 0) {
+		munmap(aligned, size);
+		return nullptr;
+	}
+	return aligned;
+}
+
 struct FileIterator {};
 
 FileIterator* createFileIterator(const char* path, IAllocator& allocator) {
@@ -1083,6 +1155,31 @@ size_t getFileSize(const char* path) {
 }
 
 
+const void* mapFile(const char* path, u64& size) {
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return nullptr;
+
+	struct stat tmp;
+	if (fstat(fd, &tmp) != 0 || tmp.st_size == 0) {
+		::close(fd);
+		return nullptr;
+	}
+
+	void* mem = mmap(nullptr, tmp.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// mapping keeps the file referenced
+	::close(fd);
+	if (mem == MAP_FAILED) return nullptr;
+
+	size = tmp.st_size;
+	return mem;
+}
+
+
+void unmapFile(const void* ptr, u64 size) {
+	munmap((void*)ptr, size);
+}
+
+
 bool fileExists(const char* path) {
 	struct stat tmp;
 	return ((stat(path, &tmp) == 0) && (((tmp.st_mode) & S_IFMT) != S_IFDIR));
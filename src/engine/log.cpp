@@ -1,11 +1,17 @@
 #include "engine/allocators.h"
+#include "engine/array.h"
+#include "engine/atomic.h"
 #include "engine/crt.h"
 #include "engine/delegate_list.h"
+#include "engine/hash.h"
 #include "engine/log.h"
+#include "engine/math.h"
+#include "engine/os.h"
 #include "engine/path.h"
 #include "engine/stream.h"
 #include "engine/string.h"
 #include "engine/sync.h"
+#include "engine/thread.h"
 
 
 namespace Lumix
@@ -13,18 +19,91 @@ namespace Lumix
 
 
 namespace detail {
+	// ring buffer with a single producer - the thread owning it, drained by the flush thread
+	struct LogBuffer {
+		static constexpr u32 SIZE = 64 * 1024;
+
+		u32 free() const { return SIZE - (end - begin); }
+
+		u8 data[SIZE];
+		volatile u32 begin = 0;
+		volatile u32 end = 0;
+		// set when the owning thread exits, the buffer can be reused by another thread
+		volatile i32 is_free = 0;
+		// duplicates of the last record, taken by the owning thread before its next record or by the flush thread
+		// seq of the summary << 32 | level << 24 | count
+		volatile i64 repeats = 0;
+		LogBuffer* next = nullptr;
+	};
+
+	static constexpr u64 REPEATS_COUNT_MASK = 0xffFFff;
+
+	struct RecordHeader {
+		u32 size; // including header
+		u32 seq;
+		LogLevel level;
+	};
+
+	struct FlushTask final : Thread {
+		FlushTask(IAllocator& allocator) : Thread(allocator) {}
+		int task() override;
+
+		Semaphore semaphore{0, 0xffFF};
+		volatile i32 wakeup_pending = 0;
+		volatile bool finished = false;
+	};
+
 	struct Logger {
-		Logger() : callback(allocator) {}
+		Logger()
+			: callback(allocator)
+			, entries(allocator)
+			, scratch(allocator)
+		{}
+
+		~Logger() {
+			ASSERT(!flush_task);
+			while (buffers) {
+				LogBuffer* next = buffers->next;
+				LUMIX_DELETE(allocator, buffers);
+				buffers = next;
+			}
+		}
+
+		struct Entry {
+			u32 seq;
+			LogLevel level;
+			u32 offset;
+		};
 
 		Mutex mutex;
 		DefaultAllocator allocator;
 		LogCallback callback;
+
+		// async mode
+		FlushTask* flush_task = nullptr;
+		volatile bool is_async = false;
+		volatile i32 seq = 0;
+		// threads writing to buffers, stopAsyncLog waits for them before it destroys the flush thread
+		volatile i32 producers = 0;
+		// protects buffers list and entries, held while draining
+		Mutex drain_mutex;
+		LogBuffer* buffers = nullptr;
+		Array<Entry> entries;
+		OutputMemoryStream scratch;
 	};
 
 	struct Log {
 		Log() : message(allocator) { message.reserve(4096); }
+		~Log() { if (buffer) buffer->is_free = 1; }
+
 		DefaultAllocator allocator;
 		OutputMemoryStream message;
+		LogBuffer* buffer = nullptr;
+		// callbacks logging from the flush thread must not wait for the flush thread
+		bool is_draining = false;
+		// consecutive identical messages are reported only once in async mode, see LogBuffer::repeats
+		RuntimeHash32 last_hash;
+		LogLevel last_level = LogLevel::COUNT;
 	};
 
 	static Logger g_logger;
@@ -41,11 +120,177 @@ namespace detail {
 	void lock() { g_logger.mutex.enter(); }
 	void unlock() { g_logger.mutex.exit(); }
 
+	static void ringWrite(LogBuffer& buffer, u32 pos, const void* src, u32 size) {
+		const u32 offset = pos & (LogBuffer::SIZE - 1);
+		const u32 first = minimum(size, LogBuffer::SIZE - offset);
+		memcpy(buffer.data + offset, src, first);
+		memcpy(buffer.data, (const u8*)src + first, size - first);
+	}
+
+	static void ringRead(const LogBuffer& buffer, u32 pos, void* dst, u32 size) {
+		const u32 offset = pos & (LogBuffer::SIZE - 1);
+		const u32 first = minimum(size, LogBuffer::SIZE - offset);
+		memcpy(dst, buffer.data + offset, first);
+		memcpy((u8*)dst + first, buffer.data, size - first);
+	}
+
+	// only producers call this, so the flush task can not be destroyed in the meantime
+	static void wakeupFlushTask() {
+		FlushTask* task = g_logger.flush_task;
+		if (compareAndExchange(&task->wakeup_pending, 1, 0)) task->semaphore.signal();
+	}
+
+	static u64 takeRepeats(LogBuffer& buffer) {
+		for (;;) {
+			const i64 repeats = buffer.repeats;
+			if ((repeats & REPEATS_COUNT_MASK) == 0) return 0;
+			if (compareAndExchange64(&buffer.repeats, 0, repeats)) return (u64)repeats;
+		}
+	}
+
+	// the summary gets seq of the first duplicate, so it's ordered before later messages of other threads
+	static void addRepeat(LogBuffer& buffer, LogLevel level) {
+		for (;;) {
+			const i64 repeats = buffer.repeats;
+			u64 value = (u64)repeats;
+			if ((value & REPEATS_COUNT_MASK) == REPEATS_COUNT_MASK) return;
+			if ((value & REPEATS_COUNT_MASK) == 0) value = (u64((u32)atomicIncrement(&g_logger.seq)) << 32) | (u64(level) << 24);
+			if (compareAndExchange64(&buffer.repeats, i64(value + 1), repeats)) return;
+		}
+	}
+
+	static StaticString<64> repeatsMessage(u64 repeats) {
+		return StaticString<64>("Last message repeated ", u32(repeats & REPEATS_COUNT_MASK), " times");
+	}
+
+	static void drain() {
+		MutexGuard guard(g_logger.drain_mutex);
+		g_log.is_draining = true;
+		g_logger.entries.clear();
+		g_logger.scratch.clear();
+		for (LogBuffer* buffer = g_logger.buffers; buffer; buffer = buffer->next) {
+			// taken before end, so the repeated message is drained no later than its summary
+			const u64 repeats = takeRepeats(*buffer);
+			const u32 end = buffer->end;
+			memoryBarrier();
+			u32 pos = buffer->begin;
+			while (pos != end) {
+				RecordHeader header;
+				ringRead(*buffer, pos, &header, sizeof(header));
+				const u32 offset = (u32)g_logger.scratch.size();
+				g_logger.entries.push({header.seq, header.level, offset});
+				g_logger.scratch.resize(offset + header.size - sizeof(header));
+				ringRead(*buffer, pos + sizeof(header), g_logger.scratch.getMutableData() + offset, header.size - sizeof(header));
+				pos += header.size;
+			}
+			memoryBarrier();
+			buffer->begin = end;
+
+			if (repeats) {
+				const StaticString<64> msg = repeatsMessage(repeats);
+				const u32 offset = (u32)g_logger.scratch.size();
+				g_logger.entries.push({u32(repeats >> 32), LogLevel((repeats >> 24) & 0xff), offset});
+				g_logger.scratch.write(msg.data, stringLength(msg.data) + 1);
+			}
+		}
+
+		// restore global order of messages from different threads
+		qsort(g_logger.entries.begin(), g_logger.entries.size(), sizeof(g_logger.entries[0]), [](const void* a, const void* b) -> int {
+			const u32 seq_a = ((const Logger::Entry*)a)->seq;
+			const u32 seq_b = ((const Logger::Entry*)b)->seq;
+			return i32(seq_a - seq_b);
+		});
+
+		{
+			MutexGuard lock(g_logger.mutex);
+			for (const Logger::Entry& e : g_logger.entries) {
+				g_logger.callback.invoke(e.level, (const char*)g_logger.scratch.data() + e.offset);
+			}
+		}
+		g_log.is_draining = false;
+	}
+
+	int FlushTask::task() {
+		while (!finished) {
+			semaphore.wait();
+			wakeup_pending = 0;
+			drain();
+		}
+		return 0;
+	}
+
+	static LogBuffer* acquireBuffer() {
+		MutexGuard guard(g_logger.drain_mutex);
+		for (LogBuffer* buffer = g_logger.buffers; buffer; buffer = buffer->next) {
+			if (compareAndExchange(&buffer->is_free, 0, 1)) return buffer;
+		}
+		LogBuffer* buffer = LUMIX_NEW(g_logger.allocator, LogBuffer);
+		buffer->next = g_logger.buffers;
+		g_logger.buffers = buffer;
+		return buffer;
+	}
+
+	static void writeRecord(LogBuffer& buffer, u32 seq, LogLevel level, const char* message, u32 len) {
+		len = minimum(len, LogBuffer::SIZE - (u32)sizeof(RecordHeader) - 1);
+		RecordHeader header;
+		header.size = sizeof(header) + len + 1;
+		header.seq = seq;
+		header.level = level;
+		while (buffer.free() < header.size) {
+			// flush thread is behind, wait for it instead of losing messages
+			wakeupFlushTask();
+			os::sleep(1);
+		}
+
+		const u32 end = buffer.end;
+		ringWrite(buffer, end, &header, sizeof(header));
+		ringWrite(buffer, end + sizeof(header), message, len);
+		ringWrite(buffer, end + sizeof(header) + len, "", 1);
+		memoryBarrier();
+		buffer.end = end + header.size;
+
+		wakeupFlushTask();
+	}
+
+	static void emitAsync(LogLevel level, const char* message, u32 len) {
+		if (!g_log.buffer) g_log.buffer = acquireBuffer();
+		LogBuffer& buffer = *g_log.buffer;
+
+		const RuntimeHash32 hash(message, len);
+		if (hash == g_log.last_hash && level == g_log.last_level) {
+			addRepeat(buffer, level);
+			return;
+		}
+
+		const u64 repeats = takeRepeats(buffer);
+		if (repeats) {
+			const StaticString<64> msg = repeatsMessage(repeats);
+			writeRecord(buffer, u32(repeats >> 32), LogLevel((repeats >> 24) & 0xff), msg, stringLength(msg));
+		}
+		g_log.last_hash = hash;
+		g_log.last_level = level;
+
+		writeRecord(buffer, (u32)atomicIncrement(&g_logger.seq), level, message, len);
+	}
+
 	void emitLog(LogLevel level) {
 		g_log.message.write('\0');
+		const char* message = (const char*)g_log.message.data();
+		const u32 len = (u32)g_log.message.size() - 1;
+
+		atomicIncrement(&g_logger.producers);
+		if (g_logger.is_async && !g_log.is_draining) {
+			emitAsync(level, message, len);
+			atomicDecrement(&g_logger.producers);
+			g_log.message.clear();
+			return;
+		}
+		atomicDecrement(&g_logger.producers);
+
+		g_log.last_level = LogLevel::COUNT;
 		{
 			MutexGuard lock(g_logger.mutex);
-			g_logger.callback.invoke(level, (const char*)g_log.message.data());
+			g_logger.callback.invoke(level, message);
 		}
 		g_log.message.clear();
 	}
@@ -54,4 +299,42 @@ namespace detail {
 } // namespace detail
 
 
+void startAsyncLog() {
+	using namespace detail;
+	if (g_logger.flush_task) return;
+
+	g_logger.flush_task = LUMIX_NEW(g_logger.allocator, FlushTask)(g_logger.allocator);
+	if (!g_logger.flush_task->create("Log flush", true)) {
+		LUMIX_DELETE(g_logger.allocator, g_logger.flush_task);
+		g_logger.flush_task = nullptr;
+		logError("Failed to create log flush thread, logging synchronously.");
+		return;
+	}
+	memoryBarrier();
+	g_logger.is_async = true;
+}
+
+
+void stopAsyncLog() {
+	using namespace detail;
+	if (!g_logger.flush_task) return;
+
+	g_logger.is_async = false;
+	memoryBarrier();
+	// producers which saw is_async before it was cleared can still write and wait for the flush thread
+	while (g_logger.producers > 0) os::sleep(1);
+	g_logger.flush_task->finished = true;
+	g_logger.flush_task->semaphore.signal();
+	g_logger.flush_task->destroy();
+	LUMIX_DELETE(g_logger.allocator, g_logger.flush_task);
+	g_logger.flush_task = nullptr;
+	drain();
+}
+
+
+void flushLog() {
+	if (detail::g_logger.is_async) detail::drain();
+}
+
+
 } // namespace Lumix
@@ -37,6 +37,13 @@ namespace detail {
 	}
 } // namespace detail
 
+// messages are queued in per-thread buffers and passed to callbacks on a background thread
+LUMIX_ENGINE_API void startAsyncLog();
+// passes all queued messages to callbacks, which are then invoked on the logging thread again
+LUMIX_ENGINE_API void stopAsyncLog();
+// blocks until messages queued so far are passed to callbacks
+LUMIX_ENGINE_API void flushLog();
+
 template <typename... T> void logInfo(const T&... args) { detail::log(LogLevel::INFO, args...); }
 template <typename... T> void logWarning(const T&... args) { detail::log(LogLevel::WARNING, args...); }
 template <typename... T> void logError(const T&... args) { detail::log(LogLevel::ERROR, args...); }
@@ -698,6 +698,168 @@ static int LUA_instantiatePrefab(lua_State* L) {
 }
 
 
+// plain layouts shared with LuaJIT FFI, must match ffi_cdef
+struct FFIInputEvent {
+	u32 type;
+	u32 device_type;
+	u32 key_id;
+	u32 down;
+	float x, y, x_abs, y_abs;
+};
+
+struct FFIProperty {
+	enum Type : u32 {
+		NONE,
+		FLOAT,
+		VEC3
+	};
+	const reflection::PropertyBase* prop;
+	u32 cmp_type;
+	Type type;
+};
+
+static_assert(sizeof(DVec3) == 3 * sizeof(double));
+static_assert(sizeof(Vec3) == 3 * sizeof(float));
+static_assert(sizeof(Quat) == 4 * sizeof(float));
+
+static const char* ffi_cdef = R"#(
+	typedef struct { double x, y, z; } LumixDVec3;
+	typedef struct { float x, y, z; } LumixVec3;
+	typedef struct { float x, y, z, w; } LumixQuat;
+	typedef struct { LumixVec3 position; LumixVec3 normal; int32_t entity; } LumixRaycastHit;
+	typedef struct { uint32_t type; uint32_t device_type; uint32_t key_id; uint32_t down; float x, y, x_abs, y_abs; } LumixInputEvent;
+	typedef struct { const void* prop; uint32_t cmp_type; uint32_t type; } LumixProperty;
+)#";
+
+// hot functions for LuaJIT FFI, no argument checking, entities must be valid
+extern "C" {
+
+static void FFI_getEntityPosition(Universe* universe, i32 entity, DVec3* out) { *out = universe->getPosition({entity}); }
+static void FFI_setEntityPosition(Universe* universe, i32 entity, const DVec3* pos) { universe->setPosition({entity}, *pos); }
+static void FFI_getEntityRotation(Universe* universe, i32 entity, Quat* out) { *out = universe->getRotation({entity}); }
+static void FFI_setEntityRotation(Universe* universe, i32 entity, const Quat* rot) { universe->setRotation({entity}, *rot); }
+static float FFI_getEntityScale(Universe* universe, i32 entity) { return universe->getScale({entity}); }
+static void FFI_setEntityScale(Universe* universe, i32 entity, float scale) { universe->setScale({entity}, scale); }
+
+static i32 FFI_getInputEventsCount(Engine* engine) { return engine->getInputSystem().getEventsCount(); }
+
+static void FFI_getInputEvent(Engine* engine, i32 idx, FFIInputEvent* out) {
+	const InputSystem::Event& event = engine->getInputSystem().getEvents()[idx];
+	*out = {};
+	out->type = event.type;
+	out->device_type = event.device ? event.device->type : 0;
+	switch (event.type) {
+		case InputSystem::Event::BUTTON:
+			out->key_id = event.data.button.key_id;
+			out->down = event.data.button.down;
+			out->x = event.data.button.x;
+			out->y = event.data.button.y;
+			break;
+		case InputSystem::Event::AXIS:
+			out->key_id = event.data.axis.axis;
+			out->x = event.data.axis.x;
+			out->y = event.data.axis.y;
+			out->x_abs = event.data.axis.x_abs;
+			out->y_abs = event.data.axis.y_abs;
+			break;
+		case InputSystem::Event::TEXT_INPUT:
+			out->key_id = event.data.text.utf8;
+			break;
+		default: break;
+	}
+}
+
+// resolve once, then use with get/set*Property
+static bool FFI_getProperty(const char* cmp, const char* prop, FFIProperty* out) {
+	struct : reflection::IEmptyPropertyVisitor {
+		void visit(const reflection::Property<float>& prop) override { type = FFIProperty::FLOAT; }
+		void visit(const reflection::Property<Vec3>& prop) override { type = FFIProperty::VEC3; }
+		FFIProperty::Type type = FFIProperty::NONE;
+	} visitor;
+
+	const ComponentType cmp_type = reflection::getComponentType(cmp);
+	out->prop = reflection::getProperty(cmp_type, prop);
+	out->cmp_type = cmp_type.index;
+	out->type = FFIProperty::NONE;
+	if (!out->prop) return false;
+	out->prop->visit(visitor);
+	out->type = visitor.type;
+	return out->type != FFIProperty::NONE;
+}
+
+static ComponentUID toComponentUID(Universe* universe, i32 entity, const FFIProperty* prop) {
+	const ComponentType cmp_type = {(i32)prop->cmp_type};
+	return ComponentUID(EntityRef{entity}, cmp_type, universe->getScene(cmp_type));
+}
+
+static float FFI_getFloatProperty(Universe* universe, i32 entity, const FFIProperty* prop) {
+	ASSERT(prop->type == FFIProperty::FLOAT);
+	return ((const reflection::Property<float>*)prop->prop)->get(toComponentUID(universe, entity, prop), -1);
+}
+
+static void FFI_setFloatProperty(Universe* universe, i32 entity, const FFIProperty* prop, float value) {
+	ASSERT(prop->type == FFIProperty::FLOAT);
+	((const reflection::Property<float>*)prop->prop)->set(toComponentUID(universe, entity, prop), -1, value);
+}
+
+static void FFI_getVec3Property(Universe* universe, i32 entity, const FFIProperty* prop, Vec3* out) {
+	ASSERT(prop->type == FFIProperty::VEC3);
+	*out = ((const reflection::Property<Vec3>*)prop->prop)->get(toComponentUID(universe, entity, prop), -1);
+}
+
+static void FFI_setVec3Property(Universe* universe, i32 entity, const FFIProperty* prop, const Vec3* value) {
+	ASSERT(prop->type == FFIProperty::VEC3);
+	((const reflection::Property<Vec3>*)prop->prop)->set(toComponentUID(universe, entity, prop), -1, *value);
+}
+
+} // extern "C"
+
+
+static void registerFFI(lua_State* L) {
+	#define REGISTER_FFI(name, signature) \
+		LuaWrapper::createFFIFunction(L, #name, signature, (void*)&FFI_##name)
+
+	REGISTER_FFI(getEntityPosition, "void(*)(void*, int32_t, LumixDVec3*)");
+	REGISTER_FFI(setEntityPosition, "void(*)(void*, int32_t, const LumixDVec3*)");
+	REGISTER_FFI(getEntityRotation, "void(*)(void*, int32_t, LumixQuat*)");
+	REGISTER_FFI(setEntityRotation, "void(*)(void*, int32_t, const LumixQuat*)");
+	REGISTER_FFI(getEntityScale, "float(*)(void*, int32_t)");
+	REGISTER_FFI(setEntityScale, "void(*)(void*, int32_t, float)");
+	REGISTER_FFI(getInputEventsCount, "int32_t(*)(void*)");
+	REGISTER_FFI(getInputEvent, "void(*)(void*, int32_t, LumixInputEvent*)");
+	REGISTER_FFI(getProperty, "bool(*)(const char*, const char*, LumixProperty*)");
+	REGISTER_FFI(getFloatProperty, "float(*)(void*, int32_t, const LumixProperty*)");
+	REGISTER_FFI(setFloatProperty, "void(*)(void*, int32_t, const LumixProperty*, float)");
+	REGISTER_FFI(getVec3Property, "void(*)(void*, int32_t, const LumixProperty*, LumixVec3*)");
+	REGISTER_FFI(setVec3Property, "void(*)(void*, int32_t, const LumixProperty*, const LumixVec3*)");
+
+	#undef REGISTER_FFI
+
+	lua_getglobal(L, "LumixAPI");
+	lua_pushstring(L, ffi_cdef);
+	lua_setfield(L, -2, "ffi_cdef");
+	lua_pop(L, 1);
+
+	// LumixFFI.<name> casts the registered pointer on first use, plugins can register more functions later
+	const char* src = R"#(
+		local ok, ffi = pcall(require, "ffi")
+		if ok then
+			ffi.cdef(LumixAPI.ffi_cdef)
+			LumixFFI = setmetatable({}, { __index = function(t, name)
+				local decl = LumixFFIDecls and LumixFFIDecls[name]
+				if decl == nil then return nil end
+				local f = ffi.cast(decl[1], decl[2])
+				rawset(t, name, f)
+				return f
+			end })
+		end
+	)#";
+	if (!LuaWrapper::execute(L, Span(src, stringLength(src)), "ffi api", 0)) {
+		logError("Failed to init ffi api");
+	}
+}
+
+
 void registerEngineAPI(lua_State* L, Engine* engine)
 {
 	LuaWrapper::createSystemVariable(L, "LumixAPI", "engine", engine);
@@ -960,6 +1122,7 @@ void registerEngineAPI(lua_State* L, Engine* engine)
 	}
 
 	installLuaPackageLoader(L);
+	registerFFI(L);
 }
 
 
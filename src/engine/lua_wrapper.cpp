@@ -1,5 +1,7 @@
 #include "lua_wrapper.h"
 #include "log.h"
+#include "math.h"
+#include "os.h"
 #include "string.h"
 
 namespace Lumix::LuaWrapper {
@@ -198,6 +200,36 @@ void createSystemFunction(lua_State* L, const char* system, const char* var_name
 	lua_pop(L, 1);
 }
 
+// LumixFFI casts these lazily, see lua_api.cpp
+float getGCBudget(float frame_time) {
+	return clamp(frame_time * 0.05f, 0.0002f, 0.002f);
+}
+
+void stepGC(lua_State* L, float time_budget) {
+	os::Timer timer;
+	do {
+		// returns 1 when a cycle is finished, the next cycle would start from scratch
+		if (lua_gc(L, LUA_GCSTEP, 0)) break;
+	} while (timer.getTimeSinceStart() < time_budget);
+}
+
+void createFFIFunction(lua_State* L, const char* name, const char* signature, void* fn) {
+	lua_getglobal(L, "LumixFFIDecls");
+	if (lua_type(L, -1) == LUA_TNIL) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_setglobal(L, "LumixFFIDecls");
+	}
+	lua_createtable(L, 2, 0);
+	lua_pushstring(L, signature);
+	lua_rawseti(L, -2, 1);
+	lua_pushlightuserdata(L, fn);
+	lua_rawseti(L, -2, 2);
+	lua_setfield(L, -2, name);
+	lua_pop(L, 1);
+}
+
 void createSystemClosure(lua_State* L, const char* system, void* system_ptr, const char* var_name, lua_CFunction fn) {
 	lua_getglobal(L, system);
 	if (lua_type(L, -1) == LUA_TNIL) {
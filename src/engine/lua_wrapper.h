@@ -550,6 +550,13 @@ LUMIX_ENGINE_API void createSystemVariable(lua_State* L, const char* system, con
 LUMIX_ENGINE_API void createSystemVariable(lua_State* L, const char* system, const char* var_name, int value);
 LUMIX_ENGINE_API void createSystemFunction(lua_State* L, const char* system, const char* var_name, lua_CFunction fn);
 LUMIX_ENGINE_API void createSystemClosure(lua_State* L, const char* system, void* system_ptr, const char* var_name, lua_CFunction fn);
+// makes `fn` available as LumixFFI.<name>, a LuaJIT FFI function pointer, so JIT compiled traces do not abort on the call
+// `signature` is a C function pointer type, e.g. "void(*)(void*, int32_t, LumixDVec3*)", types are declared in lua_api.cpp
+// time in seconds for incremental gc in a frame, part of the frame time
+LUMIX_ENGINE_API float getGCBudget(float frame_time);
+// runs incremental gc steps until the budget is spent or the cycle finishes
+LUMIX_ENGINE_API void stepGC(lua_State* L, float time_budget);
+LUMIX_ENGINE_API void createFFIFunction(lua_State* L, const char* name, const char* signature, void* fn);
 LUMIX_ENGINE_API const char* luaTypeToString(int type);
 LUMIX_ENGINE_API void argError(lua_State* L, int index, const char* expected_type);
 LUMIX_ENGINE_API void checkTableArg(lua_State* L, int index);
@@ -1258,6 +1258,10 @@ u32 rand() {
 	return rg.rand();
 }
 
+void seedRandom(u32 seed) {
+	rg = RandomGenerator(521288629 ^ seed, 362436069);
+}
+
 u64 randGUID() {
 	return (u64(rand()) << 32) + u64(rand());
 }
@@ -1471,4 +1475,171 @@ void Matrix::setTranslation(const Vec3& t) {
 	columns[3].z = t.z;
 }
 
+
+namespace {
+	struct Vec3x4 { float4 x, y, z; };
+	struct Quatx4 { float4 x, y, z, w; };
+}
+
+static LUMIX_FORCE_INLINE Vec3x4 load(const Vec3SoA& v, u32 i) {
+	return { f4LoadUnaligned(v.x + i), f4LoadUnaligned(v.y + i), f4LoadUnaligned(v.z + i) };
+}
+
+static LUMIX_FORCE_INLINE Quatx4 load(const QuatSoA& q, u32 i) {
+	return { f4LoadUnaligned(q.x + i), f4LoadUnaligned(q.y + i), f4LoadUnaligned(q.z + i), f4LoadUnaligned(q.w + i) };
+}
+
+static LUMIX_FORCE_INLINE void store(const Vec3SoA& v, u32 i, const Vec3x4& value) {
+	f4StoreUnaligned(v.x + i, value.x);
+	f4StoreUnaligned(v.y + i, value.y);
+	f4StoreUnaligned(v.z + i, value.z);
+}
+
+static LUMIX_FORCE_INLINE void store(const QuatSoA& q, u32 i, const Quatx4& value) {
+	f4StoreUnaligned(q.x + i, value.x);
+	f4StoreUnaligned(q.y + i, value.y);
+	f4StoreUnaligned(q.z + i, value.z);
+	f4StoreUnaligned(q.w + i, value.w);
+}
+
+static LUMIX_FORCE_INLINE Quat getQuat(const QuatSoA& q, u32 i) { return {q.x[i], q.y[i], q.z[i], q.w[i]}; }
+static LUMIX_FORCE_INLINE Vec3 getVec3(const Vec3SoA& v, u32 i) { return {v.x[i], v.y[i], v.z[i]}; }
+static LUMIX_FORCE_INLINE void setQuat(const QuatSoA& q, u32 i, const Quat& value) { q.x[i] = value.x; q.y[i] = value.y; q.z[i] = value.z; q.w[i] = value.w; }
+static LUMIX_FORCE_INLINE void setVec3(const Vec3SoA& v, u32 i, const Vec3& value) { v.x[i] = value.x; v.y[i] = value.y; v.z[i] = value.z; }
+
+static LUMIX_FORCE_INLINE Quatx4 mul(const Quatx4& a, const Quatx4& b) {
+	return {
+		a.w * b.x + b.w * a.x + a.y * b.z - b.y * a.z,
+		a.w * b.y + b.w * a.y + a.z * b.x - b.z * a.x,
+		a.w * b.z + b.w * a.z + a.x * b.y - b.x * a.y,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+	};
+}
+
+static LUMIX_FORCE_INLINE Vec3x4 cross(const Vec3x4& a, const Vec3x4& b) {
+	return {
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x
+	};
+}
+
+// same as Quat::rotate
+static LUMIX_FORCE_INLINE Vec3x4 rotate(const Quatx4& q, const Vec3x4& v) {
+	const Vec3x4 qvec = { q.x, q.y, q.z };
+	const Vec3x4 uv = cross(qvec, v);
+	const Vec3x4 uuv = cross(qvec, uv);
+	const float4 w2 = q.w + q.w;
+	const float4 two = f4Splat(2);
+	return {
+		v.x + uv.x * w2 + uuv.x * two,
+		v.y + uv.y * w2 + uuv.y * two,
+		v.z + uv.z * w2 + uuv.z * two
+	};
+}
+
+void mulQuats(const QuatSoA& a, const QuatSoA& b, const QuatSoA& out, u32 count) {
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		store(out, i, mul(load(a, i), load(b, i)));
+	}
+	for (; i < count; ++i) {
+		setQuat(out, i, getQuat(a, i) * getQuat(b, i));
+	}
+}
+
+void rotateVec3s(const QuatSoA& rot, const Vec3SoA& v, const Vec3SoA& out, u32 count) {
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		store(out, i, rotate(load(rot, i), load(v, i)));
+	}
+	for (; i < count; ++i) {
+		setVec3(out, i, getQuat(rot, i).rotate(getVec3(v, i)));
+	}
+}
+
+void mulTransforms(const TransformSoA& parent, const TransformSoA& child, const TransformSoA& out, u32 count) {
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float4 parent_scale = f4LoadUnaligned(parent.scale + i);
+		const Quatx4 parent_rot = load(parent.rot, i);
+		float tmp[3][4];
+		for (u32 j = 0; j < 4; ++j) {
+			tmp[0][j] = (float)child.pos.x[i + j];
+			tmp[1][j] = (float)child.pos.y[i + j];
+			tmp[2][j] = (float)child.pos.z[i + j];
+		}
+		Vec3x4 offset = { f4LoadUnaligned(tmp[0]), f4LoadUnaligned(tmp[1]), f4LoadUnaligned(tmp[2]) };
+		offset = rotate(parent_rot, { offset.x * parent_scale, offset.y * parent_scale, offset.z * parent_scale });
+		f4StoreUnaligned(tmp[0], offset.x);
+		f4StoreUnaligned(tmp[1], offset.y);
+		f4StoreUnaligned(tmp[2], offset.z);
+
+		store(out.rot, i, mul(parent_rot, load(child.rot, i)));
+		f4StoreUnaligned(out.scale + i, parent_scale * f4LoadUnaligned(child.scale + i));
+		// positions are double, compiler vectorizes this
+		for (u32 j = 0; j < 4; ++j) {
+			out.pos.x[i + j] = parent.pos.x[i + j] + tmp[0][j];
+			out.pos.y[i + j] = parent.pos.y[i + j] + tmp[1][j];
+			out.pos.z[i + j] = parent.pos.z[i + j] + tmp[2][j];
+		}
+	}
+	for (; i < count; ++i) {
+		const Quat parent_rot = getQuat(parent.rot, i);
+		const Vec3 child_pos((float)child.pos.x[i], (float)child.pos.y[i], (float)child.pos.z[i]);
+		const Vec3 offset = parent_rot.rotate(child_pos * parent.scale[i]);
+		setQuat(out.rot, i, parent_rot * getQuat(child.rot, i));
+		out.scale[i] = parent.scale[i] * child.scale[i];
+		out.pos.x[i] = parent.pos.x[i] + offset.x;
+		out.pos.y[i] = parent.pos.y[i] + offset.y;
+		out.pos.z[i] = parent.pos.z[i] + offset.z;
+	}
+}
+
+void toMatrices(const Vec3SoA& pos, const QuatSoA& rot, const float* scale, Matrix* out, u32 count) {
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const Quatx4 q = load(rot, i);
+		const Vec3x4 p = load(pos, i);
+		const float4 s = f4LoadUnaligned(scale + i);
+		const float4 fx = q.x + q.x;
+		const float4 fy = q.y + q.y;
+		const float4 fz = q.z + q.z;
+		const float4 fwx = fx * q.w, fwy = fy * q.w, fwz = fz * q.w;
+		const float4 fxx = fx * q.x, fxy = fy * q.x, fxz = fz * q.x;
+		const float4 fyy = fy * q.y, fyz = fz * q.y, fzz = fz * q.z;
+		const float4 one = f4Splat(1);
+		const float4 zero = f4Splat(0);
+
+		// rows of the results, transposed to columns of 4 matrices
+		float4 c0[4] = { (one - (fyy + fzz)) * s, (fxy + fwz) * s, (fxz - fwy) * s, zero };
+		float4 c1[4] = { (fxy - fwz) * s, (one - (fxx + fzz)) * s, (fyz + fwx) * s, zero };
+		float4 c2[4] = { (fxz + fwy) * s, (fyz - fwx) * s, (one - (fxx + fyy)) * s, zero };
+		float4 c3[4] = { p.x, p.y, p.z, one };
+		f4Transpose(c0[0], c0[1], c0[2], c0[3]);
+		f4Transpose(c1[0], c1[1], c1[2], c1[3]);
+		f4Transpose(c2[0], c2[1], c2[2], c2[3]);
+		f4Transpose(c3[0], c3[1], c3[2], c3[3]);
+		for (u32 j = 0; j < 4; ++j) {
+			f4StoreUnaligned(&out[i + j].columns[0], c0[j]);
+			f4StoreUnaligned(&out[i + j].columns[1], c1[j]);
+			f4StoreUnaligned(&out[i + j].columns[2], c2[j]);
+			f4StoreUnaligned(&out[i + j].columns[3], c3[j]);
+		}
+	}
+	for (; i < count; ++i) {
+		out[i] = Matrix(getVec3(pos, i), getQuat(rot, i));
+		out[i].multiply3x3(scale[i]);
+	}
+}
+
+void toRelative(const DVec3SoA& pos, const DVec3& origin, const Vec3SoA& out, u32 count) {
+	// subtraction must be done in double precision, plain loop so compiler can vectorize it
+	for (u32 i = 0; i < count; ++i) {
+		out.x[i] = float(pos.x[i] - origin.x);
+		out.y[i] = float(pos.y[i] - origin.y);
+		out.z[i] = float(pos.z[i] - origin.z);
+	}
+}
+
 } // namespace Lumix
\ No newline at end of file
@@ -510,6 +510,8 @@ LUMIX_ENGINE_API u32 rand();
 LUMIX_ENGINE_API u32 rand(u32 from, u32 to);
 LUMIX_ENGINE_API float randFloat();
 LUMIX_ENGINE_API float randFloat(float from, float to);
+// reseeds generator used by rand() and randFloat() on the calling thread
+LUMIX_ENGINE_API void seedRandom(u32 seed);
 LUMIX_ENGINE_API DVec2 normalize(const DVec2& value);
 LUMIX_ENGINE_API Vec2 normalize(const Vec2& value);
 LUMIX_ENGINE_API Vec3 normalize(const Vec3& value);
@@ -523,6 +525,24 @@ LUMIX_ENGINE_API double squaredLength(const DVec2& value);
 LUMIX_ENGINE_API double squaredLength(const DVec3& value);
 LUMIX_ENGINE_API float halton(u32 index, i32 base);
 
+// SoA views for batch kernels, an output can be the same arrays as an input
+struct Vec3SoA { float* x; float* y; float* z; };
+struct DVec3SoA { double* x; double* y; double* z; };
+struct QuatSoA { float* x; float* y; float* z; float* w; };
+struct TransformSoA { DVec3SoA pos; QuatSoA rot; float* scale; };
+
+// batch kernels, `count` elements are processed 4 at a time with simd
+// out[i] = a[i] * b[i]
+LUMIX_ENGINE_API void mulQuats(const QuatSoA& a, const QuatSoA& b, const QuatSoA& out, u32 count);
+// out[i] = rot[i].rotate(v[i])
+LUMIX_ENGINE_API void rotateVec3s(const QuatSoA& rot, const Vec3SoA& v, const Vec3SoA& out, u32 count);
+// out[i] = parent[i] * child[i], child positions are local offsets and are rotated in float precision
+LUMIX_ENGINE_API void mulTransforms(const TransformSoA& parent, const TransformSoA& child, const TransformSoA& out, u32 count);
+// same as Matrix(pos[i], rot[i]) scaled by scale[i]
+LUMIX_ENGINE_API void toMatrices(const Vec3SoA& pos, const QuatSoA& rot, const float* scale, Matrix* out, u32 count);
+// out[i] = Vec3(pos[i] - origin)
+LUMIX_ENGINE_API void toRelative(const DVec3SoA& pos, const DVec3& origin, const Vec3SoA& out, u32 count);
+
 struct LUMIX_ENGINE_API RandomGenerator {
 	RandomGenerator(u32 u = 521288629, u32 v = 362436069);
 	u32 rand();
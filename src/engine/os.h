@@ -90,7 +90,8 @@ struct Event {
 struct InitWindowArgs {
 	enum Flags {
 		NO_DECORATION = 1 << 0,
-		NO_TASKBAR_ICON = 1 << 1
+		NO_TASKBAR_ICON = 1 << 1,
+		HIDDEN = 1 << 2 // e.g. for offscreen rendering
 	};
 	const char* name = ""; 
 	bool handle_file_drops = false;
@@ -146,6 +147,28 @@ private:
 };
 	
 
+// TCP connection, send blocks until everything is sent, accept and receive do not block
+struct LUMIX_ENGINE_API Socket {
+	Socket();
+	~Socket();
+	Socket(const Socket&) = delete;
+	void operator =(const Socket&) = delete;
+
+	[[nodiscard]] bool listen(u16 port);
+	// false if there is no pending connection
+	[[nodiscard]] bool accept(Socket& client);
+	[[nodiscard]] bool connect(const char* host, u16 port);
+	[[nodiscard]] bool send(const void* data, u32 size);
+	// number of received bytes, 0 if there is nothing to read, -1 if the connection is closed
+	i32 receive(void* data, u32 size);
+	void close();
+	bool isOpen() const;
+
+private:
+	uintptr m_handle;
+};
+
+
 struct FileInfo {
 	bool is_directory;
 	char filename[LUMIX_MAX_PATH];
@@ -161,12 +184,27 @@ struct WindowState {
 LUMIX_ENGINE_API void init();
 LUMIX_ENGINE_API void logInfo();
 LUMIX_ENGINE_API u32 getCPUsCount();
+
+struct CPUInfo {
+	u8 numa_node = 0;
+	// relative performance of the core, on hybrid CPUs performance cores have higher class than efficiency cores
+	u8 efficiency_class = 0;
+};
+
+// fills info about logical CPUs, index is the same as the bit in thread affinity mask, returns number of CPUs
+LUMIX_ENGINE_API u32 getCPUTopology(Span<CPUInfo> cpus);
 LUMIX_ENGINE_API void sleep(u32 milliseconds);
 LUMIX_ENGINE_API ThreadID getCurrentThreadID();
 
 LUMIX_ENGINE_API void* memReserve(size_t size);
 LUMIX_ENGINE_API void memCommit(void* ptr, size_t size);
 LUMIX_ENGINE_API void memRelease(void* ptr, size_t size); // size must be full size used in reserve
+// memory can be commited again with memCommit, content is lost
+LUMIX_ENGINE_API void memDecommit(void* ptr, size_t size);
+// reserved and commited memory backed by large pages, returns nullptr if large pages are not available
+// size must be multiple of getLargeMemPageSize(), release with memRelease
+LUMIX_ENGINE_API void* memReserveLargePages(size_t size);
+LUMIX_ENGINE_API size_t getLargeMemPageSize();
 LUMIX_ENGINE_API u32 getMemPageSize();
 LUMIX_ENGINE_API u32 getMemPageAlignment();
 LUMIX_ENGINE_API u64 getProcessMemory();
@@ -187,6 +225,9 @@ LUMIX_ENGINE_API void copyToClipboard(const char* text);
 LUMIX_ENGINE_API bool deleteFile(const char* path);
 LUMIX_ENGINE_API [[nodiscard]] bool moveFile(const char* from, const char* to);
 LUMIX_ENGINE_API size_t getFileSize(const char* path);
+// read-only mapping of the whole file, returns nullptr on failure, file can be deleted or moved only after unmapFile
+LUMIX_ENGINE_API const void* mapFile(const char* path, u64& size);
+LUMIX_ENGINE_API void unmapFile(const void* ptr, u64 size);
 LUMIX_ENGINE_API bool fileExists(const char* path);
 LUMIX_ENGINE_API bool dirExists(const char* path);
 LUMIX_ENGINE_API u64 getLastModified(const char* file);
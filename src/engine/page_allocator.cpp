@@ -2,6 +2,7 @@
 #include "engine/atomic.h"
 #include "engine/crt.h"
 #include "engine/log.h"
+#include "engine/math.h"
 #include "engine/page_allocator.h"
 #include "engine/os.h"
 
@@ -9,6 +10,21 @@
 namespace Lumix
 {
 
+// first page of each chunk
+struct PageAllocator::ChunkHeader {
+	ChunkHeader* next;
+	size_t size;
+};
+
+// free page used to keep pointers to decommited pages, since we can not store anything in them
+struct PageAllocator::DecommitedPages {
+	DecommitedPages* next;
+	u32 count;
+	void* pages[(PAGE_SIZE - sizeof(DecommitedPages*) - sizeof(u32)) / sizeof(void*) - 1];
+};
+
+static_assert(sizeof(PageAllocator::DecommitedPages) <= PageAllocator::PAGE_SIZE);
+
 PageAllocator::PageAllocator() {
 	ASSERT(os::getMemPageAlignment() % PAGE_SIZE == 0);
 }
@@ -16,15 +32,21 @@ PageAllocator::PageAllocator() {
 PageAllocator::~PageAllocator()
 {
 	ASSERT(allocated_count == 0);
-	void* p = free_pages;
-	while (p) {
-		void* tmp = p;
-		memcpy(&p, p, sizeof(p));
-		os::memRelease(tmp, PAGE_SIZE);
+	ChunkHeader* chunk = chunks;
+	while (chunk) {
+		ChunkHeader* next = chunk->next;
+		os::memRelease(chunk, chunk->size);
+		chunk = next;
 	}
 }
 
 
+void PageAllocator::setLargePages(bool enable) {
+	ASSERT(!chunks);
+	large_pages = enable;
+}
+
+
 void PageAllocator::lock()
 {
 	mutex.enter();
@@ -37,21 +59,74 @@ void PageAllocator::unlock()
 }
 
 
+void PageAllocator::reserveChunk() {
+	ChunkHeader* chunk = nullptr;
+	size_t size = CHUNK_SIZE;
+	bool commited = false;
+	if (large_pages) {
+		const size_t large_page_size = os::getLargeMemPageSize();
+		if (large_page_size > 0) {
+			size = (CHUNK_SIZE + large_page_size - 1) / large_page_size * large_page_size;
+			chunk = (ChunkHeader*)os::memReserveLargePages(size);
+			commited = chunk != nullptr;
+		}
+		if (!chunk) {
+			logWarning("Large pages are not available, using normal pages.");
+			large_pages = false;
+			size = CHUNK_SIZE;
+		}
+	}
+	if (!chunk) {
+		chunk = (ChunkHeader*)os::memReserve(size);
+		os::memCommit(chunk, PAGE_SIZE);
+	}
+	ASSERT(uintptr(chunk) % PAGE_SIZE == 0);
+	chunk->next = chunks;
+	chunk->size = size;
+	chunks = chunk;
+	chunk_cursor = (u8*)chunk + PAGE_SIZE;
+	chunk_end = (u8*)chunk + size;
+	chunk_commited = commited;
+}
+
+
 void* PageAllocator::allocate(bool lock)
 {
 	if (lock) mutex.enter();
 	++allocated_count;
+	
 	if (free_pages) {
 		void* tmp = free_pages;
 		memcpy(&free_pages, free_pages, sizeof(free_pages));
+		--free_count;
 		if (lock) mutex.exit();
 		return tmp;
 	}
+
+	if (decommited) {
+		DecommitedPages* dir = decommited;
+		void* mem;
+		if (dir->count > 0) {
+			mem = dir->pages[--dir->count];
+			os::memCommit(mem, PAGE_SIZE);
+			++reserved_count;
+		}
+		else {
+			decommited = dir->next;
+			mem = dir;
+		}
+		if (lock) mutex.exit();
+		return mem;
+	}
+	
+	if (chunk_cursor == chunk_end) reserveChunk();
+	void* mem = chunk_cursor;
+	chunk_cursor += PAGE_SIZE;
 	++reserved_count;
+	const bool commit = !chunk_commited;
 	if (lock) mutex.exit();
-	void* mem = os::memReserve(PAGE_SIZE);
-	ASSERT(uintptr(mem) % PAGE_SIZE == 0);
-	os::memCommit(mem, PAGE_SIZE);
+	
+	if (commit) os::memCommit(mem, PAGE_SIZE);
 	return mem;
 }
 
@@ -60,10 +135,37 @@ void PageAllocator::deallocate(void* mem, bool lock)
 {
 	if (lock) mutex.enter();
 	--allocated_count;
+	++free_count;
 	memcpy(mem, &free_pages, sizeof(free_pages));
 	free_pages = mem;
 	if (lock) mutex.exit();
 }
 
 
-} // namespace Lumix
\ No newline at end of file
+void PageAllocator::trim(u32 max_free_pages) {
+	// large pages can not be decommited on Windows and splitting them defeats their purpose on Linux
+	if (large_pages) return;
+
+	MutexGuard guard(mutex);
+	while (free_count > max_free_pages) {
+		void* page = free_pages;
+		memcpy(&free_pages, free_pages, sizeof(free_pages));
+		--free_count;
+
+		if (!decommited || decommited->count == lengthOf(decommited->pages)) {
+			DecommitedPages* dir = new (NewPlaceholder(), page) DecommitedPages;
+			dir->count = 0;
+			dir->next = decommited;
+			decommited = dir;
+			continue;
+		}
+
+		os::memDecommit(page, PAGE_SIZE);
+		--reserved_count;
+		decommited->pages[decommited->count] = page;
+		++decommited->count;
+	}
+}
+
+
+} // namespace Lumix
@@ -10,26 +10,47 @@ namespace Lumix
 {
 
 
+// pages are reserved in chunks, optionally backed by large pages to reduce TLB misses
+// free pages are kept until trim() decommits them
 struct LUMIX_ENGINE_API PageAllocator final
 {
 public:
 	enum { PAGE_SIZE = 4096 };
+	enum { CHUNK_SIZE = 2 * 1024 * 1024 };
+	struct ChunkHeader;
+	struct DecommitedPages;
 
 	PageAllocator();
 	~PageAllocator();
-		
+	
+	// call before the first allocation, falls back to normal pages if large pages are not available
+	void setLargePages(bool enable);
 	void* allocate(bool lock);
 	void deallocate(void* mem, bool lock);
+	// decommits free pages above max_free_pages, noop with large pages
+	void trim(u32 max_free_pages);
 	u32 getAllocatedCount() const { return allocated_count; }
+	// number of commited pages
 	u32 getReservedCount() const { return reserved_count; }
+	u32 getFreeCount() const { return free_count; }
+	bool usesLargePages() const { return large_pages; }
 
 	void lock();
 	void unlock();
 		
 private:
+	void reserveChunk();
+
 	u32 allocated_count = 0;
 	u32 reserved_count = 0;
+	u32 free_count = 0;
+	bool large_pages = false;
 	void* free_pages = nullptr;
+	DecommitedPages* decommited = nullptr;
+	ChunkHeader* chunks = nullptr;
+	u8* chunk_cursor = nullptr;
+	u8* chunk_end = nullptr;
+	bool chunk_commited = false;
 	Mutex mutex;
 };
 
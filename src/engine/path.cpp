@@ -1,10 +1,12 @@
 #include "engine/lumix.h"
 #include "engine/path.h"
 
+#include "engine/allocators.h"
+#include "engine/atomic.h"
+#include "engine/crt.h"
 #include "engine/hash.h"
 #include "engine/hash_map.h"
 #include "engine/sync.h"
-#include "engine/path.h"
 #include "engine/stream.h"
 #include "engine/string.h"
 
@@ -13,51 +15,174 @@ namespace Lumix
 {
 
 
-Path::Path()
-	: m_path{}
-{}
+struct Path::Data {
+	volatile i32 refs;
+	FilePathHash hash;
+	u32 length;
+	char str[1];
+};
+
+
+namespace {
+
+// all live paths are interned here, paths with the same hash share one string
+struct PathTable {
+	static constexpr u32 SHARDS_COUNT = 16;
+
+	struct Shard {
+		Shard(IAllocator& allocator) : map(allocator) {}
+
+		Mutex mutex;
+		HashMap<FilePathHash, Path::Data*> map;
+	};
+
+	PathTable()
+		: shards{allocator, allocator, allocator, allocator, allocator, allocator, allocator, allocator
+			, allocator, allocator, allocator, allocator, allocator, allocator, allocator, allocator}
+	{}
+
+	Shard& getShard(FilePathHash hash) { return shards[hash.getHashValue() % SHARDS_COUNT]; }
+
+	Path::Data* intern(const char* str, u32 len, FilePathHash hash) {
+		Shard& shard = getShard(hash);
+		MutexGuard guard(shard.mutex);
+		auto iter = shard.map.find(hash);
+		if (iter.isValid()) {
+			Path::Data* data = iter.value();
+			atomicIncrement(&data->refs);
+			return data;
+		}
+
+		Path::Data* data = (Path::Data*)allocator.allocate(sizeof(Path::Data) + len);
+		data->refs = 1;
+		data->hash = hash;
+		data->length = len;
+		memcpy(data->str, str, len + 1);
+		shard.map.insert(hash, data);
+		return data;
+	}
+
+	void release(Path::Data* data) {
+		// fast path, we are not the last owner
+		for (;;) {
+			const i32 refs = data->refs;
+			if (refs == 1) break;
+			if (compareAndExchange(&data->refs, refs - 1, refs)) return;
+		}
+
+		Shard& shard = getShard(data->hash);
+		MutexGuard guard(shard.mutex);
+		// someone could have interned the same path while we were waiting for the lock
+		if (atomicDecrement(&data->refs) > 0) return;
+		shard.map.erase(data->hash);
+		allocator.deallocate(data);
+	}
+
+	DefaultAllocator allocator;
+	Shard shards[SHARDS_COUNT];
+};
+
+// never destroyed, static paths can outlive anything we could register a destructor after
+alignas(PathTable) static u8 g_path_table_storage[sizeof(PathTable)];
+
+PathTable& getPathTable() {
+	static PathTable* table = new (NewPlaceholder(), g_path_table_storage) PathTable;
+	return *table;
+}
+
+} // anonymous namespace
+
+
+Path::Path() {}
 
 
 Path::Path(const char* path) {
-	normalize(path, Span(m_path));
-	endUpdate();
+	*this = path;
+}
+
+Path::Path(const Path& rhs)
+	: m_data(rhs.m_data)
+	, m_hash(rhs.m_hash)
+{
+	if (m_data) atomicIncrement(&m_data->refs);
+}
+
+Path::Path(Path&& rhs)
+	: m_data(rhs.m_data)
+	, m_hash(rhs.m_hash)
+{
+	rhs.m_data = nullptr;
+	rhs.m_hash = FilePathHash();
+}
+
+Path::~Path() {
+	if (m_data) getPathTable().release(m_data);
 }
 
 i32 Path::length() const {
-	return stringLength(m_path);
+	return m_data ? m_data->length : 0;
+}
+
+const char* Path::c_str() const {
+	return m_data ? m_data->str : "";
+}
+
+u32 Path::getInternedCount() {
+	PathTable& table = getPathTable();
+	u32 count = 0;
+	for (PathTable::Shard& shard : table.shards) {
+		MutexGuard guard(shard.mutex);
+		count += shard.map.size();
+	}
+	return count;
 }
 
-void Path::endUpdate() {
+void Path::operator =(const char* rhs) {
+	char tmp[LUMIX_MAX_PATH];
+	normalize(rhs, Span(tmp));
 	#ifdef _WIN32
-		char tmp[LUMIX_MAX_PATH];
-		makeLowercase(Span(tmp), m_path);
-		m_hash = FilePathHash(tmp);
+		char lower[LUMIX_MAX_PATH];
+		makeLowercase(Span(lower), tmp);
+		const FilePathHash hash(lower);
 	#else
-		m_hash = FilePathHash(m_path);
+		const FilePathHash hash(tmp);
 	#endif
+
+	Data* data = tmp[0] ? getPathTable().intern(tmp, stringLength(tmp), hash) : nullptr;
+	if (m_data) getPathTable().release(m_data);
+	m_data = data;
+	m_hash = hash;
 }
 
-void Path::operator =(const char* rhs) {
-	normalize(rhs, Span(m_path));
-	endUpdate();
+void Path::operator =(const Path& rhs) {
+	if (rhs.m_data) atomicIncrement(&rhs.m_data->refs);
+	if (m_data) getPathTable().release(m_data);
+	m_data = rhs.m_data;
+	m_hash = rhs.m_hash;
+}
+
+void Path::operator =(Path&& rhs) {
+	if (this == &rhs) return;
+	if (m_data) getPathTable().release(m_data);
+	m_data = rhs.m_data;
+	m_hash = rhs.m_hash;
+	rhs.m_data = nullptr;
+	rhs.m_hash = FilePathHash();
 }
 
 bool Path::operator==(const char* rhs) const {
-	return equalStrings(rhs, m_path);
+	return equalStrings(rhs, c_str());
 }
 
 bool Path::operator==(const Path& rhs) const {
-	ASSERT(equalIStrings(m_path, rhs.m_path) == (m_hash == rhs.m_hash));
+	ASSERT(equalIStrings(c_str(), rhs.c_str()) == (m_hash == rhs.m_hash));
 	return m_hash == rhs.m_hash;
 }
 
 bool Path::operator!=(const Path& rhs) const {
-	ASSERT(equalIStrings(m_path, rhs.m_path) == (m_hash == rhs.m_hash));
-	#ifdef _WIN32
-		return m_hash != rhs.m_hash || !equalIStrings(m_path, rhs.m_path);
-	#else
-		return m_hash != rhs.m_hash || !equalStrings(m_path, rhs.m_path);
-	#endif
+	ASSERT(equalIStrings(c_str(), rhs.c_str()) == (m_hash == rhs.m_hash));
+	// equal hashes share the same interned string
+	return m_hash != rhs.m_hash;
 }
 
 void Path::normalize(const char* path, Span<char> output)
@@ -218,7 +343,8 @@ bool Path::hasExtension(const char* filename, const char* ext)
 }
 
 Path::operator Span<const char>() const {
-	return Span(m_path, stringLength(m_path));
+	if (!m_data) return Span<const char>("", (u32)0);
+	return Span<const char>(m_data->str, m_data->length);
 }
 
 PathInfo::PathInfo(const char* path) {
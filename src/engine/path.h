@@ -28,23 +28,32 @@ struct LUMIX_ENGINE_API Path {
 
 	Path();
 	explicit Path(const char* path);
+	Path(const Path& rhs);
+	Path(Path&& rhs);
+	~Path();
 
 	void operator=(const char* rhs);
+	void operator=(const Path& rhs);
+	void operator=(Path&& rhs);
 	bool operator==(const char* rhs) const;
 	bool operator==(const Path& rhs) const;
 	bool operator!=(const Path& rhs) const;
 
 	i32 length() const;
 	FilePathHash getHash() const { return m_hash; }
-	char* beginUpdate() { return m_path; }
-	void endUpdate();
-	const char* c_str() const { return m_path; }
-	bool isEmpty() const { return m_path[0] == '\0'; }
+	const char* c_str() const;
+	bool isEmpty() const { return !m_data; }
 	static u32 capacity() { return LUMIX_MAX_PATH; }
 	operator Span<const char>() const;
 
+	// number of distinct paths currently alive, for debugging
+	static u32 getInternedCount();
+
+	struct Data;
+
 private:
-	char m_path[LUMIX_MAX_PATH];
+	// interned, refcounted string shared by all paths with the same hash; null if empty
+	Data* m_data = nullptr;
 	FilePathHash m_hash;
 };
 
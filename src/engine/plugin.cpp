@@ -2,6 +2,7 @@
 #include "engine/debug.h"
 #include "engine/delegate_list.h"
 #include "engine/engine.h"
+#include "engine/job_system.h"
 #include "engine/plugin.h"
 #include "engine/log.h"
 #include "engine/os.h"
@@ -47,10 +48,25 @@ namespace Lumix
 			void initPlugins() override
 			{
 				PROFILE_FUNCTION();
+				os::Timer timer;
+				// initAsync of all plugins run in parallel on workers, while init() runs in load order
+				// once the plugin's own initAsync is done, so it can still use plugins loaded before it
+				Array<jobs::Signal> signals(m_allocator);
+				signals.reserve(m_plugins.size());
+				for (IPlugin* plugin : m_plugins) {
+					jobs::runLambda([plugin](){
+						profiler::Scope scope(plugin->getName());
+						plugin->initAsync();
+					}, &signals.emplace());
+				}
+
 				for (int i = 0, c = m_plugins.size(); i < c; ++i)
 				{
+					jobs::wait(&signals[i]);
+					profiler::Scope scope(m_plugins[i]->getName());
 					m_plugins[i]->init();
 				}
+				logInfo("Plugins initialized in ", u32(timer.getTimeSinceStart() * 1000), " ms");
 			}
 
 
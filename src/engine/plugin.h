@@ -30,6 +30,39 @@ struct LUMIX_ENGINE_API PluginManager
 	virtual DelegateList<void(void*)>& libraryLoaded() = 0;
 };
 
+// what a scene touches in update and lateUpdate, scenes with nonconflicting access are updated in parallel
+struct SceneUpdateAccess {
+	enum Flags : u32 {
+		TRANSFORMS = 1 << 0,
+		ENTITIES = 1 << 1, // creating or destroying entities and components
+		SCRIPTS = 1 << 2, // calling into scripts, e.g. callbacks
+		INPUT = 1 << 3
+	};
+
+	bool is_parallel = false; // false means the scene is updated serially, in its order, on the calling thread
+	u32 reads = 0;
+	u32 writes = 0;
+};
+
+// components of one type stored contiguously, element i is at data + i * stride and belongs to entities[i]
+struct ComponentChunk {
+	template <typename T>
+	static ComponentChunk fromArrays(Span<const EntityRef> entities, Span<T> values) {
+		ASSERT(entities.length() == values.length());
+		ComponentChunk res;
+		res.entities = entities.begin();
+		res.data = values.begin();
+		res.stride = sizeof(T);
+		res.count = entities.length();
+		return res;
+	}
+
+	const EntityRef* entities = nullptr;
+	void* data = nullptr;
+	u32 stride = 0;
+	u32 count = 0;
+};
+
 struct LUMIX_ENGINE_API IScene
 {
 	virtual ~IScene() {}
@@ -37,11 +70,17 @@ struct LUMIX_ENGINE_API IScene
 	virtual void init() {}
 	virtual void serialize(struct OutputMemoryStream& serializer) = 0;
 	virtual void deserialize(struct InputMemoryStream& serialize, const struct EntityMap& entity_map, i32 version) = 0;
+	// true if deserialize only reads its data and creates its components, e.g. does not load resources or query other scenes,
+	// such scenes are deserialized on a job worker while other scenes are deserialized, see Universe::beginDeferredComponents
+	virtual bool canDeserializeOnWorker() const { return false; }
 	virtual void beforeReload(OutputMemoryStream& serializer) {}
 	virtual void afterReload(InputMemoryStream& serializer) {}
 	virtual IPlugin& getPlugin() const = 0;
 	virtual void update(float time_delta, bool paused) = 0;
 	virtual void lateUpdate(float time_delta, bool paused) {}
+	virtual SceneUpdateAccess getUpdateAccess() const { return {}; }
+	// scenes storing components of `type` densely can expose them for bulk iteration, see Universe::getComponentChunks
+	virtual bool getComponentChunk(ComponentType type, ComponentChunk& chunk) { return false; }
 	virtual struct Universe& getUniverse() = 0;
 	virtual void startGame() {}
 	virtual void stopGame() {}
@@ -54,6 +93,9 @@ struct LUMIX_ENGINE_API IPlugin
 {
 	virtual ~IPlugin();
 
+	// called on a worker, in parallel with other plugins, before init()
+	// only for expensive self-contained setup, must not touch other plugins or lua state
+	virtual void initAsync() {}
 	virtual void init() {}
 	virtual void update(float) {}
 	virtual const char* getName() const = 0;
@@ -12,6 +12,7 @@ const ResourceType PrefabResource::TYPE("prefab");
 PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, data(allocator)
+	, scene_sections(allocator)
 {
 }
 
@@ -19,7 +20,11 @@ PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manag
 ResourceType PrefabResource::getType() const { return TYPE; }
 
 
-void PrefabResource::unload() { data.clear(); }
+void PrefabResource::unload() {
+	data.clear();
+	scene_sections.clear();
+	universe_offset = 0;
+}
 
 
 bool PrefabResource::load(u64 size, const u8* mem)
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "engine/array.h"
 #include "engine/hash.h"
 #include "engine/resource.h"
 #include "engine/stream.h"
@@ -28,6 +29,18 @@ struct LUMIX_ENGINE_API PrefabResource final : Resource
 
 	OutputMemoryStream data;
 	StableHash content_hash;
+
+	// filled by the first instantiation, following instances skip validation and read sections directly
+	struct SceneSection {
+		u32 name_offset;
+		i32 version;
+		u64 offset;
+		u64 size;
+	};
+	mutable Array<SceneSection> scene_sections;
+	// 0 if sections are not parsed yet
+	mutable u64 universe_offset = 0;
+	mutable bool dense_entities = false;
 	static const ResourceType TYPE;
 };
 
@@ -9,6 +9,7 @@
 #include "engine/array.h"
 #include "engine/crt.h"
 #include "engine/hash_map.h"
+#include "engine/log.h"
 #include "engine/allocators.h"
 #include "engine/atomic.h"
 #include "engine/math.h"
@@ -16,6 +17,7 @@
 #include "engine/sync.h"
 #include "engine/thread.h"
 #include "engine/os.h"
+#include "engine/stream.h"
 #include "profiler.h"
 
 namespace Lumix
@@ -45,10 +47,20 @@ struct ThreadContext
 		open_blocks.reserve(64);
 	}
 
-	Array<i32> open_blocks;
+	struct OpenBlock {
+		i32 id;
+		const char* name; // null for blocks continued after a fiber switch if they did not fit in FiberSwitchData
+		u64 start; // 0 if there is no block capture trigger
+	};
+
+	Array<OpenBlock> open_blocks;
+	// ring buffer with a single producer, readers copy it without blocking the producer, see serialize()
 	OutputMemoryStream buffer;
-	u32 begin = 0;
-	u32 end = 0;
+	volatile u32 begin = 0;
+	volatile u32 end = 0;
+	// contexts with more producers, e.g. the global context, serialize them with this
+	Mutex* producer_mutex = nullptr;
+	// protects name and show_in_profiler, events do not need it
 	Mutex mutex;
 	StaticString<64> name;
 	bool show_in_profiler = false;
@@ -102,6 +114,22 @@ struct ThreadContext
 	void CloseTrace(int) {}
 #endif
 
+// saves profiler data when a frame or a block takes too long, see setCaptureTrigger()
+struct CaptureTrigger
+{
+	static constexpr u32 FRAMES_AFTER = 2; // recorded after the spike before saving
+	static constexpr u32 COOLDOWN_FRAMES = 120; // no captures of the frames right after a capture
+
+	u64 frame_limit = 0; // in ticks, 0 - disabled
+	u64 block_limit = 0;
+	StaticString<64> block_name;
+	StaticString<LUMIX_MAX_PATH> path_prefix;
+	volatile i32 block_triggered = 0;
+	i32 countdown = -1;
+	u32 cooldown = 0;
+	u32 captures_count = 0;
+};
+
 static struct Instance
 {
 	Instance()
@@ -110,12 +138,14 @@ static struct Instance
 		, counters(allocator)
 		, global_context(default_global_context_size, allocator)
 	{
+		global_context.producer_mutex = &global_context_mutex;
 		startTrace();
 	}
 
 
 	~Instance()
 	{
+		stopServer();
 		CloseTrace(trace_task.open_handle);
 		trace_task.destroy();
 	}
@@ -185,10 +215,76 @@ static struct Instance
 	u64 last_frame_time = 0;
 	volatile i32 fiber_wait_id = 0;
 	TraceTask trace_task;
+	CaptureTrigger trigger;
+	struct RemoteServer* server = nullptr;
+	Mutex global_context_mutex;
 	ThreadContext global_context;
 } g_instance;
 
 
+static void signalServer();
+
+
+// x64 keeps the order of stores and the order of loads, so these only stop the compiler from reordering
+#ifdef _WIN32
+	#define LUMIX_PROFILER_RELEASE_FENCE() _ReadWriteBarrier()
+	#define LUMIX_PROFILER_ACQUIRE_FENCE() _ReadWriteBarrier()
+#else
+	#define LUMIX_PROFILER_RELEASE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+	#define LUMIX_PROFILER_ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+// drops the oldest events until there is `size` bytes of free space
+// begin is published before the space is overwritten, so a reader copying the buffer meanwhile
+// can find out which part of its copy is not valid, see snapshot()
+static LUMIX_FORCE_INLINE void makeSpace(ThreadContext& ctx, u32 size)
+{
+	const u8* buf = ctx.buffer.data();
+	const u32 buf_size = (u32)ctx.buffer.size();
+	const u32 end = ctx.end;
+	u32 begin = ctx.begin;
+	if (size + end - begin <= buf_size) return;
+
+	while (size + end - begin > buf_size) {
+		u16 event_size;
+		const u32 l = begin % buf_size;
+		if (l + 1 < buf_size) memcpy(&event_size, buf + l, sizeof(event_size));
+		else event_size = buf[l] | (buf[0] << 8);
+		begin += event_size;
+	}
+	ctx.begin = begin;
+	LUMIX_PROFILER_RELEASE_FENCE();
+}
+
+static LUMIX_FORCE_INLINE void copyToRing(ThreadContext& ctx, u32 pos, const void* data, u32 size)
+{
+	u8* buf = ctx.buffer.getMutableData();
+	const u32 buf_size = (u32)ctx.buffer.size();
+	const u32 l = pos % buf_size;
+	if (buf_size - l >= size) {
+		memcpy(buf + l, data, size);
+	}
+	else {
+		memcpy(buf + l, data, buf_size - l);
+		memcpy(buf, (const u8*)data + buf_size - l, size - (buf_size - l));
+	}
+}
+
+// events are visible to readers only after end is published
+static LUMIX_FORCE_INLINE void publish(ThreadContext& ctx, u32 size)
+{
+	LUMIX_PROFILER_RELEASE_FENCE();
+	ctx.end = ctx.end + size;
+}
+
+template <typename T>
+static void push(ThreadContext& ctx, const T& value)
+{
+	makeSpace(ctx, sizeof(value));
+	copyToRing(ctx, ctx.end, &value, sizeof(value));
+	publish(ctx, sizeof(value));
+}
+
 template <typename T>
 void write(ThreadContext& ctx, u64 timestamp, EventType type, const T& value)
 {
@@ -205,25 +301,13 @@ void write(ThreadContext& ctx, u64 timestamp, EventType type, const T& value)
 	v.header.time = timestamp;
 	v.value = value;
 
-	MutexGuard lock(ctx.mutex);
-	u8* buf = ctx.buffer.getMutableData();
-	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (sizeof(v) + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
-	}
-
-	const u32 lend = ctx.end % buf_size;
-	if (buf_size - lend >= sizeof(v)) {
-		memcpy(buf + lend, &v, sizeof(v));
+	if (ctx.producer_mutex) {
+		MutexGuard lock(*ctx.producer_mutex);
+		push(ctx, v);
 	}
 	else {
-		memcpy(buf + lend, &v, buf_size - lend);
-		memcpy(buf, ((u8*)&v) + buf_size - lend, sizeof(v) - (buf_size - lend));
+		push(ctx, v);
 	}
-
-	ctx.end += sizeof(v);
 };
 
 template <typename T>
@@ -242,25 +326,13 @@ void write(ThreadContext& ctx, EventType type, const T& value)
 	v.header.time = os::Timer::getRawTimestamp();
 	v.value = value;
 
-	MutexGuard lock(ctx.mutex);
-	u8* buf = ctx.buffer.getMutableData();
-	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (sizeof(v) + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
-	}
-
-	const u32 lend = ctx.end % buf_size;
-	if (buf_size - lend >= sizeof(v)) {
-		memcpy(buf + lend, &v, sizeof(v));
+	if (ctx.producer_mutex) {
+		MutexGuard lock(*ctx.producer_mutex);
+		push(ctx, v);
 	}
 	else {
-		memcpy(buf + lend, &v, buf_size - lend);
-		memcpy(buf, ((u8*)&v) + buf_size - lend, sizeof(v) - (buf_size - lend));
+		push(ctx, v);
 	}
-
-	ctx.end += sizeof(v);
 };
 
 
@@ -274,30 +346,20 @@ void write(ThreadContext& ctx, EventType type, const u8* data, int size)
 	header.size = u16(sizeof(header) + size);
 	header.time = os::Timer::getRawTimestamp();
 
-	MutexGuard lock(ctx.mutex);
-	u8* buf = ctx.buffer.getMutableData();
-	const u32 buf_size = (u32)ctx.buffer.size();
-
-	while (header.size + ctx.end - ctx.begin > buf_size) {
-		const u8 size = buf[ctx.begin % buf_size];
-		ctx.begin += size;
-	}
-
-	auto cpy = [&](const u8* ptr, u32 size) {
-		const u32 lend = ctx.end % buf_size;
-		if (buf_size - lend >= size) {
-			memcpy(buf + lend, ptr, size);
-		}
-		else {
-			memcpy(buf + lend, ptr, buf_size - lend);
-			memcpy(buf, ((u8*)ptr) + buf_size - lend, size - (buf_size - lend));
-		}
-
-		ctx.end += size;
+	auto write_event = [&](){
+		makeSpace(ctx, header.size);
+		copyToRing(ctx, ctx.end, &header, sizeof(header));
+		copyToRing(ctx, ctx.end + sizeof(header), data, size);
+		publish(ctx, header.size);
 	};
 
-	cpy((u8*)&header, sizeof(header));
-	cpy(data, size);
+	if (ctx.producer_mutex) {
+		MutexGuard lock(*ctx.producer_mutex);
+		write_event();
+	}
+	else {
+		write_event();
+	}
 };
 
 #ifdef _WIN32
@@ -327,6 +389,7 @@ void write(ThreadContext& ctx, EventType type, const u8* data, int size)
 #endif
 
 u32 createCounter(const char* key_literal, float min) {
+	MutexGuard lock(g_instance.mutex);
 	Counter& c = g_instance.counters.emplace();
 	copyString(Span(c.name), key_literal);
 	c.min = min;
@@ -366,9 +429,9 @@ void blockColor(u8 r, u8 g, u8 b)
 
 static volatile i32 last_block_id = 0;
 
-static void continueBlock(i32 block_id) {
+static void continueBlock(i32 block_id, const char* name) {
 	ThreadContext* ctx = g_instance.getThreadContext();
-	ctx->open_blocks.push(block_id);
+	ctx->open_blocks.push({block_id, name, 0});
 	write(*ctx, EventType::CONTINUE_BLOCK, block_id);
 }
 
@@ -378,7 +441,8 @@ void beginBlock(const char* name)
 	r.id = atomicIncrement(&last_block_id);
 	r.name = name;
 	ThreadContext* ctx = g_instance.getThreadContext();
-	ctx->open_blocks.push(r.id);
+	const u64 start = g_instance.trigger.block_limit != 0 ? os::Timer::getRawTimestamp() : 0;
+	ctx->open_blocks.push({r.id, name, start});
 	write(*ctx, EventType::BEGIN_BLOCK, r);
 }
 
@@ -458,7 +522,10 @@ FiberSwitchData beginFiberWait(i32 job_system_signal, bool is_mutex)
 	res.count = ctx->open_blocks.size();
 	res.id = r.id;
 	res.signal = job_system_signal;
-	memcpy(res.blocks, ctx->open_blocks.begin(), minimum(res.count, lengthOf(res.blocks)) * sizeof(res.blocks[0]));
+	for (u32 i = 0, c = minimum(res.count, lengthOf(res.blocks)); i < c; ++i) {
+		res.blocks[i] = ctx->open_blocks[i].id;
+		res.block_names[i] = ctx->open_blocks[i].name;
+	}
 	write(*ctx, EventType::BEGIN_FIBER_WAIT, r);
 	return res;
 }
@@ -477,18 +544,30 @@ void endFiberWait(const FiberSwitchData& switch_data)
 	
 	for (u32 i = 0; i < count; ++i) {
 		if(i < lengthOf(switch_data.blocks)) {
-			continueBlock(switch_data.blocks[i]);
+			continueBlock(switch_data.blocks[i], switch_data.block_names[i]);
 		} else {
-			continueBlock(-1);
+			continueBlock(-1, nullptr);
 		}
 	}
 }
 
 
+static void checkBlockTrigger(const ThreadContext::OpenBlock& block)
+{
+	CaptureTrigger& trigger = g_instance.trigger;
+	if (trigger.block_limit == 0 || !block.name) return;
+	if (os::Timer::getRawTimestamp() - block.start <= trigger.block_limit) return;
+	if (!equalStrings(block.name, trigger.block_name)) return;
+	trigger.block_triggered = 1;
+}
+
+
 void endBlock()
 {
 	ThreadContext* ctx = g_instance.getThreadContext();
 	if(!ctx->open_blocks.empty()) {
+		const ThreadContext::OpenBlock& block = ctx->open_blocks.last();
+		if (block.start != 0) checkBlockTrigger(block);
 		ctx->open_blocks.pop();
 		write(*ctx, EventType::END_BLOCK, 0);
 	}
@@ -507,6 +586,9 @@ bool contextSwitchesEnabled()
 }
 
 
+static void checkCaptureTrigger();
+
+
 void frame()
 {
 	const u64 n = os::Timer::getRawTimestamp();
@@ -515,6 +597,74 @@ void frame()
 	}
 	g_instance.last_frame_time = n;
 	write(g_instance.global_context, EventType::FRAME, 0);
+	checkCaptureTrigger();
+	if (g_instance.server) signalServer();
+}
+
+
+void setCaptureTrigger(float frame_ms, const char* block_name, float block_ms, const char* path_prefix)
+{
+	CaptureTrigger& trigger = g_instance.trigger;
+	const double ticks_per_ms = frequency() / 1000.0;
+	trigger.block_limit = 0;
+	trigger.block_name = block_name ? block_name : "";
+	trigger.path_prefix = path_prefix;
+	trigger.frame_limit = u64(frame_ms * ticks_per_ms);
+	trigger.block_triggered = 0;
+	trigger.countdown = -1;
+	trigger.cooldown = 0;
+	// enables checks in endBlock, so it's set after the name
+	trigger.block_limit = trigger.block_name[0] ? u64(block_ms * ticks_per_ms) : 0;
+}
+
+
+static void saveCapture()
+{
+	CaptureTrigger& trigger = g_instance.trigger;
+	const StaticString<LUMIX_MAX_PATH> path(trigger.path_prefix, trigger.captures_count, ".lpd");
+	++trigger.captures_count;
+
+	OutputMemoryStream blob(g_instance.allocator);
+	serialize(blob);
+	os::OutputFile file;
+	if (!file.open(path)) {
+		logError("Could not open ", path);
+		return;
+	}
+	if (!file.write(blob.data(), blob.size())) {
+		logError("Could not write ", path);
+	}
+	file.close();
+	logInfo("Profiler capture saved to ", path);
+}
+
+
+// the spike is saved a few frames later, so the capture contains frames around it
+static void checkCaptureTrigger()
+{
+	CaptureTrigger& trigger = g_instance.trigger;
+	if (g_instance.paused || (trigger.frame_limit == 0 && trigger.block_limit == 0)) return;
+
+	if (trigger.countdown < 0) {
+		if (trigger.cooldown > 0) {
+			--trigger.cooldown;
+			trigger.block_triggered = 0;
+			return;
+		}
+		const bool frame_spike = trigger.frame_limit != 0 && g_instance.last_frame_duration > trigger.frame_limit;
+		if (frame_spike || trigger.block_triggered) trigger.countdown = CaptureTrigger::FRAMES_AFTER;
+		return;
+	}
+
+	if (trigger.countdown > 0) {
+		--trigger.countdown;
+		return;
+	}
+
+	trigger.countdown = -1;
+	trigger.block_triggered = 0;
+	trigger.cooldown = CaptureTrigger::COOLDOWN_FRAMES;
+	saveCapture();
 }
 
 
@@ -535,11 +685,19 @@ void setThreadName(const char* name)
 	ctx->name = name;
 }
 
+// events of a context copied to the serialized blob
+struct RingSnapshot
+{
+	u64 data_offset; // in the blob
+	u32 size;
+	u32 begin;
+	u32 end;
+};
+
 template <typename T>
-static void read(const ThreadContext& ctx, u32 p, T& value)
+static void read(const u8* buf, const RingSnapshot& ring, u32 p, T& value)
 {
-	const u8* buf = ctx.buffer.data();
-	const u32 buf_size = (u32)ctx.buffer.size();
+	const u32 buf_size = ring.size;
 	const u32 l = p % buf_size;
 	if (l + sizeof(value) <= buf_size) {
 		memcpy(&value, buf + l, sizeof(value));
@@ -550,19 +708,19 @@ static void read(const ThreadContext& ctx, u32 p, T& value)
 	memcpy((u8*)&value + (buf_size - l), buf, sizeof(value) - (buf_size - l));
 }
 
-static void saveStrings(OutputMemoryStream& blob) {
+static void saveStrings(OutputMemoryStream& blob, Span<const RingSnapshot> rings) {
 	HashMap<const char*, const char*> map(g_instance.allocator);
 	map.reserve(512);
-	auto gather = [&](const ThreadContext& ctx){
-		u32 p = ctx.begin;
-		const u32 end = ctx.end;
-		while (p != end) {
+	auto gather = [&](const RingSnapshot& ring){
+		const u8* buf = blob.data() + ring.data_offset;
+		u32 p = ring.begin;
+		while (p != ring.end) {
 			profiler::EventHeader header;
-			read(ctx, p, header);
+			read(buf, ring, p, header);
 			switch (header.type) {
 				case profiler::EventType::BEGIN_BLOCK: {
 					BlockRecord b;
-					read(ctx, p + sizeof(profiler::EventHeader), b);
+					read(buf, ring, p + sizeof(profiler::EventHeader), b);
 					if (!map.find(b.name).isValid()) {
 						map.insert(b.name, b.name);
 					}
@@ -570,7 +728,7 @@ static void saveStrings(OutputMemoryStream& blob) {
 				}
 				case profiler::EventType::INT: {
 					IntRecord r;
-					read(ctx, p + sizeof(profiler::EventHeader), r);
+					read(buf, ring, p + sizeof(profiler::EventHeader), r);
 					if (!map.find(r.key).isValid()) {
 						map.insert(r.key, r.key);
 					}
@@ -582,9 +740,9 @@ static void saveStrings(OutputMemoryStream& blob) {
 		}
 	};
 
-	gather(g_instance.global_context);
-	for (const ThreadContext* ctx : g_instance.contexts) {
-		gather(*ctx);
+	// gather everything first, writing to the blob could reallocate the snapshots
+	for (const RingSnapshot& ring : rings) {
+		gather(ring);
 	}
 
 	blob.write(map.size());
@@ -594,15 +752,37 @@ static void saveStrings(OutputMemoryStream& blob) {
 	}
 }
 
-void serialize(OutputMemoryStream& blob, ThreadContext& ctx) {
-	MutexGuard lock(ctx.mutex);
-	blob.writeString(ctx.name);
+// copies the ring without blocking its writer
+// the writer publishes begin before it overwrites anything, so everything in [begin read after the copy, end read before the copy)
+// was not touched during the copy, the rest is cut off
+static RingSnapshot serialize(OutputMemoryStream& blob, ThreadContext& ctx) {
+	bool show_in_profiler;
+	{
+		MutexGuard lock(ctx.mutex);
+		blob.writeString(ctx.name);
+		show_in_profiler = ctx.show_in_profiler;
+	}
 	blob.write(ctx.thread_id);
-	blob.write(ctx.begin);
-	blob.write(ctx.end);
-	blob.write((u8)ctx.show_in_profiler);
-	blob.write((u32)ctx.buffer.size());
-	blob.write(ctx.buffer.data(), ctx.buffer.size());
+	const u64 range_offset = blob.size();
+	blob.write(u32(0)); // begin
+	blob.write(u32(0)); // end
+	blob.write((u8)show_in_profiler);
+
+	RingSnapshot ring;
+	ring.size = (u32)ctx.buffer.size();
+	blob.write(ring.size);
+	ring.data_offset = blob.size();
+	ring.end = ctx.end;
+	LUMIX_PROFILER_ACQUIRE_FENCE();
+	blob.write(ctx.buffer.data(), ring.size);
+	LUMIX_PROFILER_ACQUIRE_FENCE();
+	ring.begin = ctx.begin;
+	// the writer dropped events we have not copied yet
+	if (ring.end - ring.begin > ring.size) ring.begin = ring.end;
+
+	memcpy(blob.getMutableData() + range_offset, &ring.begin, sizeof(ring.begin));
+	memcpy(blob.getMutableData() + range_offset + sizeof(ring.begin), &ring.end, sizeof(ring.end));
+	return ring;
 }
 
 void serialize(OutputMemoryStream& blob) {
@@ -614,13 +794,486 @@ void serialize(OutputMemoryStream& blob) {
 	blob.write(g_instance.counters.begin(), g_instance.counters.byte_size());
 
 	blob.write((u32)g_instance.contexts.size());
-	serialize(blob, g_instance.global_context);
+	Array<RingSnapshot> rings(g_instance.allocator);
+	rings.reserve(g_instance.contexts.size() + 1);
+	rings.push(serialize(blob, g_instance.global_context));
 	for (ThreadContext* ctx : g_instance.contexts) {
-		serialize(blob, *ctx);
+		rings.push(serialize(blob, *ctx));
 	}	
-	saveStrings(blob);
+	saveStrings(blob, rings);
+}
+
+static void writeJSONString(OutputMemoryStream& out, const char* str)
+{
+	out << "\"";
+	for (const char* c = str; *c; ++c) {
+		switch (*c) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if ((u8)*c < 0x20) out << " ";
+				else out.write(c, 1);
+				break;
+		}
+	}
+	out << "\"";
+}
+
+// context of a serialized blob
+struct SerializedContext
+{
+	const char* name;
+	u32 thread_id;
+	RingSnapshot ring;
+	const u8* buf;
+};
+
+void exportChromeTrace(Span<const u8> serialized, OutputMemoryStream& out)
+{
+	InputMemoryStream blob(serialized.begin(), serialized.length());
+	const u32 version = blob.read<u32>();
+	ASSERT(version == 0);
+	const u32 counters_count = blob.read<u32>();
+	const Counter* counters = (const Counter*)blob.skip(counters_count * sizeof(Counter));
+	const u32 contexts_count = blob.read<u32>() + 1; // + global context
+
+	Array<SerializedContext> contexts(g_instance.allocator);
+	contexts.reserve(contexts_count);
+	for (u32 i = 0; i < contexts_count; ++i) {
+		SerializedContext& ctx = contexts.emplace();
+		ctx.name = blob.readString();
+		blob.read(ctx.thread_id);
+		blob.read(ctx.ring.begin);
+		blob.read(ctx.ring.end);
+		blob.read<u8>(); // show in profiler
+		blob.read(ctx.ring.size);
+		ctx.ring.data_offset = blob.getPosition();
+		ctx.buf = (const u8*)blob.skip(ctx.ring.size);
+	}
+
+	// names of blocks resumed after a fiber switch, and the start of the timeline
+	HashMap<i32, const char*> block_names(g_instance.allocator);
+	u64 start = 0xffFFffFFffFFffFF;
+	for (const SerializedContext& ctx : contexts) {
+		for (u32 p = ctx.ring.begin; p != ctx.ring.end;) {
+			EventHeader header;
+			read(ctx.buf, ctx.ring, p, header);
+			start = minimum(start, header.time);
+			if (header.type == EventType::BEGIN_BLOCK) {
+				BlockRecord r;
+				read(ctx.buf, ctx.ring, p + sizeof(header), r);
+				block_names.insert(r.id, r.name);
+			}
+			p += header.size;
+		}
+	}
+
+	const double to_us = 1e6 / double(frequency());
+	char tmp[64];
+	auto event = [&](const char* name, const char* phase, u32 tid, u64 time) {
+		out << ",\n{\"name\":";
+		writeJSONString(out, name);
+		out << ",\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":" << tid << ",\"ts\":";
+		toCString((time - start) * to_us, Span(tmp), 3);
+		out << tmp;
+	};
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Lumix\"}}";
+
+	// gpu blocks and engine wide events get their own tracks
+	enum : u32 {
+		GPU_TID = 0xffFFffFF,
+		GLOBAL_TID = 0xffFFffFE
+	};
+	for (u32 i = 0; i < contexts_count; ++i) {
+		const u32 tid = i == 0 ? GLOBAL_TID : contexts[i].thread_id;
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":";
+		writeJSONString(out, i == 0 ? "Global" : (contexts[i].name[0] ? contexts[i].name : "Unnamed thread"));
+		out << "}}";
+	}
+	out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << (u32)GPU_TID << ",\"args\":{\"name\":\"GPU\"}}";
+
+	for (u32 i = 0; i < contexts_count; ++i) {
+		const SerializedContext& ctx = contexts[i];
+		const u32 tid = i == 0 ? GLOBAL_TID : ctx.thread_id;
+		// the oldest events could be dropped, so there can be ends without begins
+		u32 depth = 0;
+		u32 gpu_depth = 0;
+		for (u32 p = ctx.ring.begin; p != ctx.ring.end;) {
+			EventHeader header;
+			read(ctx.buf, ctx.ring, p, header);
+			const u32 value_pos = p + sizeof(header);
+			switch (header.type) {
+				case EventType::BEGIN_BLOCK: {
+					BlockRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					event(r.name, "B", tid, header.time);
+					out << "}";
+					++depth;
+					break;
+				}
+				case EventType::CONTINUE_BLOCK: {
+					i32 id;
+					read(ctx.buf, ctx.ring, value_pos, id);
+					auto iter = block_names.find(id);
+					event(iter.isValid() ? iter.value() : "N/A", "B", tid, header.time);
+					out << "}";
+					++depth;
+					break;
+				}
+				case EventType::END_BLOCK:
+					if (depth == 0) break;
+					event("", "E", tid, header.time);
+					out << "}";
+					--depth;
+					break;
+				case EventType::FRAME:
+					event("frame", "i", tid, header.time);
+					out << ",\"s\":\"g\"}";
+					break;
+				case EventType::PAUSE:
+					event("pause", "i", tid, header.time);
+					out << ",\"s\":\"g\"}";
+					break;
+				case EventType::STRING: {
+					char str[256];
+					const u32 len = minimum(header.size - (u32)sizeof(header), (u32)sizeof(str));
+					for (u32 j = 0; j < len; ++j) str[j] = ctx.buf[(value_pos + j) % ctx.ring.size];
+					str[len - 1] = '\0';
+					event("string", "i", tid, header.time);
+					out << ",\"s\":\"t\",\"args\":{\"value\":";
+					writeJSONString(out, str);
+					out << "}}";
+					break;
+				}
+				case EventType::INT: {
+					IntRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					event(r.key, "i", tid, header.time);
+					out << ",\"s\":\"t\",\"args\":{\"value\":" << (i32)r.value << "}}";
+					break;
+				}
+				case EventType::JOB_INFO: {
+					JobRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					event("job", "i", tid, header.time);
+					out << ",\"s\":\"t\",\"args\":{\"signal_on_finish\":" << r.signal_on_finish << "}}";
+					break;
+				}
+				case EventType::SIGNAL_TRIGGERED: {
+					i32 signal;
+					read(ctx.buf, ctx.ring, value_pos, signal);
+					event("signal", "s", tid, header.time);
+					out << ",\"cat\":\"job\",\"id\":" << signal << "}";
+					break;
+				}
+				// fibers can resume on another thread, so waits are async events
+				case EventType::BEGIN_FIBER_WAIT:
+				case EventType::END_FIBER_WAIT: {
+					FiberWaitRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					const bool begin = header.type == EventType::BEGIN_FIBER_WAIT;
+					event(r.is_mutex ? "mutex wait" : "fiber wait", begin ? "b" : "e", tid, header.time);
+					out << ",\"cat\":\"fiber\",\"id\":" << r.id << ",\"args\":{\"signal\":" << r.job_system_signal << "}}";
+					if (!begin) {
+						event("signal", "f", tid, header.time);
+						out << ",\"cat\":\"job\",\"bp\":\"e\",\"id\":" << r.job_system_signal << "}";
+					}
+					break;
+				}
+				case EventType::LINK: {
+					i64 link;
+					read(ctx.buf, ctx.ring, value_pos, link);
+					event("link", "s", tid, header.time);
+					out << ",\"cat\":\"link\",\"id\":" << link << "}";
+					break;
+				}
+				case EventType::BEGIN_GPU_BLOCK: {
+					GPUBlock r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					r.name[lengthOf(r.name) - 1] = '\0';
+					event(r.name, "B", GPU_TID, r.timestamp);
+					out << "}";
+					++gpu_depth;
+					if (r.profiler_link != 0) {
+						event("link", "f", GPU_TID, r.timestamp);
+						out << ",\"cat\":\"link\",\"bp\":\"e\",\"id\":" << r.profiler_link << "}";
+					}
+					break;
+				}
+				case EventType::END_GPU_BLOCK: {
+					u64 timestamp;
+					read(ctx.buf, ctx.ring, value_pos, timestamp);
+					if (gpu_depth == 0) break;
+					event("", "E", GPU_TID, timestamp);
+					out << "}";
+					--gpu_depth;
+					break;
+				}
+				case EventType::GPU_STATS: {
+					u64 primitives;
+					read(ctx.buf, ctx.ring, value_pos, primitives);
+					event("GPU primitives", "C", GPU_TID, header.time);
+					out << ",\"args\":{\"value\":" << primitives << "}}";
+					break;
+				}
+				case EventType::COUNTER: {
+					CounterRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					if (r.counter >= counters_count) break;
+					event(counters[r.counter].name, "C", tid, header.time);
+					out << ",\"args\":{\"value\":" << r.value << "}}";
+					break;
+				}
+				case EventType::CONTEXT_SWITCH: {
+					ContextSwitchRecord r;
+					read(ctx.buf, ctx.ring, value_pos, r);
+					event("switch in", "i", r.new_thread_id, r.timestamp);
+					out << ",\"s\":\"t\",\"args\":{\"reason\":" << (i32)r.reason << "}}";
+					event("switch out", "i", r.old_thread_id, r.timestamp);
+					out << ",\"s\":\"t\"}";
+					break;
+				}
+				case EventType::BLOCK_COLOR: break;
+			}
+			p += header.size;
+		}
+	}
+	out << "\n]}\n";
 }
 
+// sends new events of all contexts to a connected remote profiler, runs on its own thread and wakes up in frame()
+struct RemoteServer : Thread
+{
+	struct Cursor {
+		u32 pos;
+		u64 time = 0;
+		StaticString<64> name;
+		bool show = false;
+		bool announced = false;
+	};
+
+	RemoteServer(IAllocator& allocator)
+		: Thread(allocator)
+		, semaphore(0, 1)
+		, cursors(allocator)
+		, contexts(allocator)
+		, strings(allocator)
+		, packet(allocator)
+		, events(allocator)
+		, copy(allocator)
+	{}
+
+	void signal() {
+		if (compareAndExchange(&pending, 1, 0)) semaphore.signal();
+	}
+
+	int task() override {
+		for (;;) {
+			semaphore.wait();
+			pending = 0;
+			if (finished) break;
+
+			if (!client.isOpen()) {
+				if (!listener.accept(client)) continue;
+				onConnect();
+			}
+			packet.clear();
+			gatherPackets();
+			if (!client.send(packet.data(), (u32)packet.size())) client.close();
+		}
+		return 0;
+	}
+
+	void onConnect() {
+		cursors.clear();
+		strings.clear();
+		counters_sent = 0;
+		packet.clear();
+		packet.write(remote::MAGIC);
+		packet.write(remote::VERSION);
+		packet.write(frequency());
+		if (!client.send(packet.data(), (u32)packet.size())) client.close();
+	}
+
+	u64 beginPacket(remote::PacketType type) {
+		const u64 offset = packet.size();
+		packet.write(u32(0));
+		packet.write(type);
+		return offset;
+	}
+
+	void endPacket(u64 offset) {
+		const u32 size = u32(packet.size() - offset - sizeof(u32));
+		memcpy(packet.getMutableData() + offset, &size, sizeof(size));
+	}
+
+	void intern(const char* str) {
+		if (strings.find(str).isValid()) return;
+		strings.insert(str, true);
+		const u64 offset = beginPacket(remote::PacketType::STRING);
+		packet.write((u64)(uintptr)str);
+		packet.write(str, stringLength(str) + 1);
+		endPacket(offset);
+	}
+
+	void gatherPackets() {
+		{
+			MutexGuard lock(g_instance.mutex);
+			const u32 counters_count = g_instance.counters.size();
+			if (counters_count > counters_sent) {
+				const u64 offset = beginPacket(remote::PacketType::COUNTERS);
+				packet.write(counters_sent);
+				packet.write(counters_count - counters_sent);
+				packet.write(&g_instance.counters[counters_sent], (counters_count - counters_sent) * sizeof(Counter));
+				endPacket(offset);
+				counters_sent = counters_count;
+			}
+			contexts.clear();
+			contexts.push(&g_instance.global_context);
+			for (ThreadContext* ctx : g_instance.contexts) contexts.push(ctx);
+		}
+
+		for (u32 i = 0, c = contexts.size(); i < c; ++i) {
+			ThreadContext& ctx = *contexts[i];
+			if (i >= (u32)cursors.size()) {
+				// start with the current frame, the history would take too long to send
+				cursors.emplace().pos = ctx.end;
+			}
+			Cursor& cursor = cursors[i];
+
+			{
+				MutexGuard lock(ctx.mutex);
+				if (!cursor.announced || cursor.name != ctx.name || cursor.show != ctx.show_in_profiler) {
+					cursor.announced = true;
+					cursor.name = ctx.name;
+					cursor.show = ctx.show_in_profiler;
+					const u64 offset = beginPacket(remote::PacketType::THREAD);
+					packet.write(i);
+					packet.write(ctx.thread_id);
+					packet.write((u8)cursor.show);
+					packet.write(cursor.name.data, stringLength(cursor.name.data) + 1);
+					endPacket(offset);
+				}
+			}
+			gatherEvents(i, ctx, cursor);
+		}
+	}
+
+	// same as serialize(), the writer is not blocked and only events not overwritten during the copy are sent
+	void gatherEvents(u32 context_index, ThreadContext& ctx, Cursor& cursor) {
+		const u32 buf_size = (u32)ctx.buffer.size();
+		const u32 end = ctx.end;
+		LUMIX_PROFILER_ACQUIRE_FENCE();
+		u32 from = cursor.pos;
+		const u32 begin = ctx.begin;
+		if (i32(begin - from) > 0) from = begin;
+		cursor.pos = end;
+		if (i32(end - from) <= 0) return;
+
+		const u32 size = end - from;
+		copy.resize(size);
+		const u32 l = from % buf_size;
+		if (l + size <= buf_size) {
+			memcpy(copy.getMutableData(), ctx.buffer.data() + l, size);
+		}
+		else {
+			memcpy(copy.getMutableData(), ctx.buffer.data() + l, buf_size - l);
+			memcpy(copy.getMutableData() + buf_size - l, ctx.buffer.data(), size - (buf_size - l));
+		}
+		LUMIX_PROFILER_ACQUIRE_FENCE();
+		const u32 valid_from = ctx.begin;
+		u32 p = from;
+		if (i32(valid_from - p) > 0) p = valid_from;
+		if (i32(end - p) <= 0) return;
+
+		events.clear();
+		while (p != end) {
+			const u8* ptr = copy.data() + (p - from);
+			EventHeader header;
+			memcpy(&header, ptr, sizeof(header));
+			const u8* payload = ptr + sizeof(header);
+			const u32 payload_size = header.size - sizeof(header);
+			switch (header.type) {
+				case EventType::BEGIN_BLOCK: {
+					BlockRecord r;
+					memcpy(&r, payload, sizeof(r));
+					intern(r.name);
+					break;
+				}
+				case EventType::INT: {
+					IntRecord r;
+					memcpy(&r, payload, sizeof(r));
+					intern(r.key);
+					break;
+				}
+				default: break;
+			}
+			events.write(header.type);
+			events.writeVarint(payload_size);
+			events.writeZigzag(i64(header.time - cursor.time));
+			events.write(payload, payload_size);
+			cursor.time = header.time;
+			p += header.size;
+		}
+
+		const u64 offset = beginPacket(remote::PacketType::EVENTS);
+		packet.write(context_index);
+		packet.write(events.data(), events.size());
+		endPacket(offset);
+	}
+
+	Semaphore semaphore;
+	volatile i32 pending = 0;
+	volatile bool finished = false;
+	os::Socket listener;
+	os::Socket client;
+	u32 counters_sent = 0;
+	Array<Cursor> cursors;
+	Array<ThreadContext*> contexts;
+	HashMap<const char*, bool> strings;
+	OutputMemoryStream packet;
+	OutputMemoryStream events;
+	OutputMemoryStream copy;
+};
+
+
+bool startServer(u16 port)
+{
+	if (g_instance.server) return true;
+
+	RemoteServer* server = LUMIX_NEW(g_instance.allocator, RemoteServer)(g_instance.allocator);
+	if (!server->listener.listen(port) || !server->create("profiler server", true)) {
+		LUMIX_DELETE(g_instance.allocator, server);
+		return false;
+	}
+	g_instance.server = server;
+	return true;
+}
+
+
+static void signalServer()
+{
+	g_instance.server->signal();
+}
+
+
+void stopServer()
+{
+	RemoteServer* server = g_instance.server;
+	if (!server) return;
+
+	g_instance.server = nullptr;
+	server->finished = true;
+	server->semaphore.signal();
+	server->destroy();
+	LUMIX_DELETE(g_instance.allocator, server);
+}
+
+
 void pause(bool paused)
 {
 	if (paused) write(g_instance.global_context, EventType::PAUSE, 0);
@@ -24,6 +24,8 @@ LUMIX_ENGINE_API void pushInt(const char* key_literal, int value);
 
 LUMIX_ENGINE_API u32 createCounter(const char* key_literal, float min);
 LUMIX_ENGINE_API void pushCounter(u32 counter, float value);
+// counters named prefix + worker index, shown in profiler UI as per-frame workers' utilization
+constexpr const char* WORKER_UTILIZATION_COUNTER_PREFIX = "Worker utilization (%) ";
 
 LUMIX_ENGINE_API void beginGPUBlock(const char* name, u64 timestamp, i64 profiler_link);
 LUMIX_ENGINE_API void endGPUBlock(u64 timestamp);
@@ -31,10 +33,21 @@ LUMIX_ENGINE_API void gpuStats(u64 primitives_generated);
 LUMIX_ENGINE_API void link(i64 link);
 LUMIX_ENGINE_API i64 createNewLinkID();
 LUMIX_ENGINE_API void serialize(OutputMemoryStream& blob);
+// writes Chrome trace event JSON (chrome://tracing, ui.perfetto.dev) from serialize()'s output
+// block names in `serialized` must be valid pointers, i.e. it comes from this process or its strings are patched
+LUMIX_ENGINE_API void exportChromeTrace(Span<const u8> serialized, OutputMemoryStream& json);
+// streams events to a remote profiler (studio's profiler window) connected to `port`, sends once per frame()
+// when a frame takes longer than frame_ms or a block named block_name longer than block_ms,
+// a few more frames are recorded and everything is saved to <path_prefix><N>.lpd, which can be loaded in studio
+// 0 or null disables a condition
+LUMIX_ENGINE_API void setCaptureTrigger(float frame_ms, const char* block_name, float block_ms, const char* path_prefix);
+LUMIX_ENGINE_API bool startServer(u16 port);
+LUMIX_ENGINE_API void stopServer();
 
 struct FiberSwitchData {
 	i32 id;
 	i32 blocks[16];
+	const char* block_names[16];
 	u32 count;
 	i32 signal;
 };
@@ -131,6 +144,29 @@ enum class EventType : u8
 	COUNTER
 };
 
+// remote profiler stream, all values are little endian
+// handshake: u32 MAGIC, u32 VERSION, u64 frequency
+// then packets: u32 size of the rest of the packet, PacketType, data
+// COUNTERS: u32 first counter index, u32 count, Counter[count]
+// THREAD: u32 context index (0 is the global context), u32 thread id, u8 show in profiler, zero terminated name
+// STRING: u64 id, zero terminated string; string pointers in events are ids sent before the events
+// EVENTS: u32 context index, events up to the end of the packet, each event is
+//		EventType, varint payload size, varint zigzag encoded time delta from the previous event in the context, payload
+namespace remote {
+
+static constexpr u32 MAGIC = 0x4c505246; // "LPRF"
+static constexpr u32 VERSION = 0;
+static constexpr u16 DEFAULT_PORT = 27600;
+
+enum class PacketType : u8 {
+	COUNTERS,
+	THREAD,
+	STRING,
+	EVENTS
+};
+
+} // namespace remote
+
 #pragma pack(1)
 struct EventHeader
 {
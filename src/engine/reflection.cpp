@@ -3,6 +3,7 @@
 #include "engine/allocators.h"
 #include "engine/hash.h"
 #include "engine/log.h"
+#include "engine/plugin.h"
 #include "engine/stream.h"
 #include "engine/string.h"
 #include "engine/universe.h"
@@ -25,6 +26,16 @@ static Context& getContext() {
 	return ctx;
 }
 
+void onPropertyChanged(ComponentUID cmp) {
+	cmp.scene->getUniverse().markComponentChanged((EntityRef)cmp.entity, cmp.type);
+}
+
+void onPropertiesChanged(IScene* scene, ComponentType cmp_type, Span<const EntityRef> entities) {
+	Universe& universe = scene->getUniverse();
+	if (!universe.isTrackingChanges()) return;
+	for (EntityRef e : entities) universe.markComponentChanged(e, cmp_type);
+}
+
 static IAllocator& getAllocator() {
 	static DefaultAllocator alloc;
 	return alloc;
@@ -244,6 +255,7 @@ void BlobProperty::getValue(ComponentUID cmp, u32 idx, OutputMemoryStream& strea
 
 void BlobProperty::setValue(ComponentUID cmp, u32 idx, InputMemoryStream& stream) const {
 	setter(cmp.scene, (EntityRef)cmp.entity, idx, stream);
+	onPropertyChanged(cmp);
 }
 
 ArrayProperty::ArrayProperty(IAllocator& allocator)
@@ -257,10 +269,12 @@ u32 ArrayProperty::getCount(ComponentUID cmp) const {
 
 void ArrayProperty::addItem(ComponentUID cmp, u32 idx) const {
 	adder(cmp.scene, (EntityRef)cmp.entity, idx);
+	onPropertyChanged(cmp);
 }
 
 void ArrayProperty::removeItem(ComponentUID cmp, u32 idx) const {
 	remover(cmp.scene, (EntityRef)cmp.entity, idx);
+	onPropertyChanged(cmp);
 }
 
 
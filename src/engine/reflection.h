@@ -67,6 +67,9 @@ LUMIX_ENGINE_API const PropertyBase* getPropertyFromHash(StableHash hash);
 LUMIX_ENGINE_API StableHash getPropertyHash(ComponentType cmp, const char* property_name);
 LUMIX_ENGINE_API ComponentType getComponentType(const char* id);
 LUMIX_ENGINE_API ComponentType getComponentTypeFromHash(RuntimeHash hash);
+// marks the component as changed for universe's change tracking
+LUMIX_ENGINE_API void onPropertyChanged(ComponentUID cmp);
+LUMIX_ENGINE_API void onPropertiesChanged(IScene* scene, ComponentType cmp_type, Span<const EntityRef> entities);
 
 struct ResourceAttribute : IAttribute
 {
@@ -194,6 +197,7 @@ struct Property : PropertyBase {
 
 	virtual void set(ComponentUID cmp, u32 idx, T val) const {
 		setter(cmp.scene, (EntityRef)cmp.entity, idx, val);
+		onPropertyChanged(cmp);
 	}
 
 	virtual bool isReadonly() const { return setter == nullptr; }
@@ -552,6 +556,67 @@ bool getPropertyValue(IScene& scene, EntityRef e, ComponentType cmp_type, const
 	return visitor.found;
 }
 
+// property resolved once, then accessed directly through its getter and setter
+// without visitors and string compares, e.g. for scripts or editing many entities at once
+template <typename T>
+struct PropertyAccessor {
+	bool isValid() const { return getter != nullptr; }
+	bool isReadonly() const { return setter == nullptr; }
+
+	T get(IScene* scene, EntityRef e, u32 idx = -1) const { return getter(scene, e, idx); }
+
+	void set(IScene* scene, EntityRef e, const T& value, u32 idx = -1) const {
+		setter(scene, e, idx, value);
+		onPropertiesChanged(scene, cmp_type, Span<const EntityRef>(&e, 1));
+	}
+
+	void get(IScene* scene, Span<const EntityRef> entities, Span<T> values, u32 idx = -1) const {
+		ASSERT(entities.length() == values.length());
+		for (u32 i = 0, c = entities.length(); i < c; ++i) {
+			values[i] = getter(scene, entities[i], idx);
+		}
+	}
+
+	void set(IScene* scene, Span<const EntityRef> entities, Span<const T> values, u32 idx = -1) const {
+		ASSERT(entities.length() == values.length());
+		for (u32 i = 0, c = entities.length(); i < c; ++i) {
+			setter(scene, entities[i], idx, values[i]);
+		}
+		onPropertiesChanged(scene, cmp_type, entities);
+	}
+
+	// sets the same value to all entities
+	void set(IScene* scene, Span<const EntityRef> entities, const T& value, u32 idx = -1) const {
+		for (EntityRef e : entities) setter(scene, e, idx, value);
+		onPropertiesChanged(scene, cmp_type, entities);
+	}
+
+	ComponentType cmp_type = INVALID_COMPONENT_TYPE;
+	typename Property<T>::Getter getter = nullptr;
+	typename Property<T>::Setter setter = nullptr;
+};
+
+// returns invalid accessor if there's no such property or it's not of type T
+template <typename T>
+PropertyAccessor<T> getPropertyAccessor(ComponentType cmp_type, const char* prop_name) {
+	struct : IEmptyPropertyVisitor {
+		void visit(const Property<T>& prop) override { found = &prop; }
+		const Property<T>* found = nullptr;
+	} visitor;
+
+	PropertyAccessor<T> accessor;
+	const PropertyBase* prop = getProperty(cmp_type, prop_name);
+	if (!prop) return accessor;
+	
+	prop->visit(visitor);
+	if (!visitor.found) return accessor;
+
+	accessor.cmp_type = cmp_type;
+	accessor.getter = visitor.found->getter;
+	accessor.setter = visitor.found->setter;
+	return accessor;
+}
+
 struct Scene {
 	Scene(IAllocator& allocator);
 
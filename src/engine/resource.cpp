@@ -1,8 +1,13 @@
 #include "engine/resource.h"
+#include "engine/crt.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lumix.h"
+#include "engine/math.h"
+#include "engine/os.h"
 #include "engine/path.h"
+#include "engine/profiler.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/string.h"
@@ -29,6 +34,9 @@ Resource::Resource(const Path& path, ResourceManager& resource_manager, IAllocat
 	, m_path(path)
 	, m_size()
 	, m_cb(allocator)
+	, m_dependents(allocator)
+	, m_dependencies(allocator)
+	, m_prefetched(allocator)
 	, m_resource_manager(resource_manager)
 	, m_async_op(FileSystem::AsyncHandle::invalid())
 {
@@ -38,23 +46,34 @@ Resource::Resource(const Path& path, ResourceManager& resource_manager, IAllocat
 Resource::~Resource() = default;
 
 
+void Resource::setState(State new_state) {
+	const State old_state = m_current_state;
+	m_current_state = new_state;
+	if (new_state == State::READY && m_load_times.queued != 0 && m_load_times.ready == 0) {
+		m_load_times.ready = os::Timer::getRawTimestamp();
+		m_resource_manager.onLoadFinished(*this);
+	}
+	for (i32 i = 0, c = m_dependents.size(); i < c; ++i) {
+		m_dependents[i]->onDependencyStateChanged(old_state, new_state);
+	}
+	m_cb.invoke(old_state, new_state, *this);
+	if (new_state != State::EMPTY) releasePrefetched();
+}
+
+
 void Resource::refresh() {
 	if (m_current_state == State::EMPTY) return;
 
-	const State old_state = m_current_state;
-	m_current_state = State::EMPTY;	
-	m_cb.invoke(old_state, m_current_state, *this);
+	setState(State::EMPTY);
 	checkState();
 }
 
 
 void Resource::checkState()
 {
-	auto old_state = m_current_state;
 	if (m_failed_dep_count > 0 && m_current_state != State::FAILURE)
 	{
-		m_current_state = State::FAILURE;
-		m_cb.invoke(old_state, m_current_state, *this);
+		setState(State::FAILURE);
 	}
 
 	if (m_failed_dep_count == 0)
@@ -76,14 +95,12 @@ void Resource::checkState()
 				return;
 			}
 
-			m_current_state = State::READY;
-			m_cb.invoke(old_state, m_current_state, *this);
+			setState(State::READY);
 		}
 
 		if (m_empty_dep_count > 0 && m_current_state != State::EMPTY)
 		{
-			m_current_state = State::EMPTY;
-			m_cb.invoke(old_state, m_current_state, *this);
+			setState(State::EMPTY);
 		}
 	}
 }
@@ -97,6 +114,11 @@ void Resource::fileLoaded(u64 size, const u8* mem, bool success) {
 	ASSERT(m_current_state != State::READY);
 	ASSERT(m_empty_dep_count == 1);
 
+	const FileSystem::IOTimes io_times = m_resource_manager.getOwner().getFileSystem().getCallbackIOTimes();
+	m_load_times.io_start = io_times.io_start;
+	m_load_times.io_end = io_times.io_end;
+	m_load_times.parse_start = os::Timer::getRawTimestamp();
+
 	if (!success) {
 		ResourceManagerHub& hub = m_resource_manager.getOwner();
 		if (!m_hooked && hub.isHooked()) {
@@ -118,40 +140,129 @@ void Resource::fileLoaded(u64 size, const u8* mem, bool success) {
 		return;
 	}
 
+	u64 content_size = 0;
+	u64 resource_size = 0;
+	OutputMemoryStream tmp(m_resource_manager.m_allocator);
+	const u8* content = unpack(size, mem, tmp, content_size, resource_size);
+
+	if (content && isDecodedInBackground()) {
+		ResourceManagerHub& hub = m_resource_manager.getOwner();
+		ResourceDecodeJob* job = LUMIX_NEW(hub.m_allocator, ResourceDecodeJob)(*this, hub.m_allocator);
+		job->resource_size = resource_size;
+		// mem is valid only in this callback
+		if (content == tmp.data()) job->data = static_cast<OutputMemoryStream&&>(tmp);
+		else job->data.write(content, content_size);
+		m_decoding = true;
+		jobs::runLambda([job, &hub](){
+			PROFILE_BLOCK("decode resource");
+			job->decode_start = os::Timer::getRawTimestamp();
+			job->success = job->resource.decode(job->data.size(), (const u8*)job->data.data());
+			MutexGuard lock(hub.m_decoded_mutex);
+			hub.m_decoded.push(job);
+		}, hub.m_decode_signal);
+		return;
+	}
+
+	const bool loaded = content && load(content_size, content);
+	contentLoaded(resource_size, loaded);
+}
+
+
+const u8* Resource::unpack(u64 size, const u8* mem, OutputMemoryStream& tmp, u64& content_size, u64& resource_size) const {
 	const CompiledResourceHeader* header = (const CompiledResourceHeader*)mem;
 	if (startsWith(getPath().c_str(), ".lumix/asset_tiles/")) {
-		if (!load(size, mem)) {
-			++m_failed_dep_count;
-		}
-		m_size = size;
+		content_size = size;
+		resource_size = size;
+		return mem;
 	}
-	else if (size < sizeof(*header)) {
+	
+	if (size < sizeof(*header)) {
 		logError("Invalid resource file, please delete .lumix directory");
-		++m_failed_dep_count;
+		return nullptr;
 	}
-	else if (header->magic != CompiledResourceHeader::MAGIC) {
+	
+	if (header->magic != CompiledResourceHeader::MAGIC) {
 		logError("Invalid resource file, please delete .lumix directory");
-		++m_failed_dep_count;
+		return nullptr;
 	}
-	else if (header->version != 0) {
+	
+	if (header->version != 0) {
 		logError("Unsupported resource file version, please delete .lumix directory");
-		++m_failed_dep_count;
+		return nullptr;
 	}
-	else if (header->flags & CompiledResourceHeader::COMPRESSED) {
-		OutputMemoryStream tmp(m_resource_manager.m_allocator);
+	
+	resource_size = header->decompressed_size;
+	if (header->flags & CompiledResourceHeader::CHUNKED) {
+		content_size = header->decompressed_size;
+		return unpackChunks(mem + sizeof(*header), size - sizeof(*header), tmp, header->decompressed_size) ? (const u8*)tmp.data() : nullptr;
+	}
+
+	if (header->flags & CompiledResourceHeader::COMPRESSED) {
 		tmp.resize(header->decompressed_size);
 		const i32 res = LZ4_decompress_safe((const char*)mem + sizeof(*header), (char*)tmp.getMutableData(), i32(size - sizeof(*header)), (i32)tmp.size());
-		if (res != header->decompressed_size || !load(header->decompressed_size, tmp.data())) {
-			++m_failed_dep_count;
-		}
-		m_size = header->decompressed_size;
+		if (res != header->decompressed_size) return nullptr;
+		content_size = tmp.size();
+		return (const u8*)tmp.data();
 	}
-	else {
-		if (!load(size - sizeof(*header), mem + sizeof(*header))) {
-			++m_failed_dep_count;
+
+	content_size = size - sizeof(*header);
+	return mem + sizeof(*header);
+}
+
+
+bool Resource::unpackChunks(const u8* mem, u64 size, OutputMemoryStream& tmp, u64 decompressed_size) const {
+	InputMemoryStream blob(mem, size);
+	const u32 chunk_size = blob.read<u32>();
+	const u32 chunk_count = blob.read<u32>();
+	if (chunk_size == 0 || u64(chunk_count) * chunk_size < decompressed_size || blob.getPosition() + chunk_count * sizeof(u32) > size) {
+		logError("Invalid resource file, please delete .lumix directory");
+		return false;
+	}
+
+	const u32* compressed_sizes = (const u32*)blob.skip(chunk_count * sizeof(u32));
+	Array<u64> offsets(m_resource_manager.m_allocator);
+	offsets.resize(chunk_count);
+	u64 offset = blob.getPosition();
+	for (u32 i = 0; i < chunk_count; ++i) {
+		offsets[i] = offset;
+		offset += compressed_sizes[i];
+	}
+	if (offset > size) {
+		logError("Invalid resource file, please delete .lumix directory");
+		return false;
+	}
+
+	tmp.resize(decompressed_size);
+	volatile i32 failed = 0;
+	jobs::forEach(chunk_count, 1, [&](i32 i, i32){
+		PROFILE_BLOCK("decompress chunk");
+		const u64 dst_offset = u64(i) * chunk_size;
+		const u32 dst_size = (u32)minimum(u64(chunk_size), decompressed_size - dst_offset);
+		u8* dst = (u8*)tmp.getMutableData() + dst_offset;
+		if (compressed_sizes[i] == dst_size) {
+			memcpy(dst, mem + offsets[i], dst_size);
+			return;
 		}
-		m_size = header->decompressed_size;
-	} 
+		const i32 res = LZ4_decompress_safe((const char*)mem + offsets[i], (char*)dst, (i32)compressed_sizes[i], (i32)dst_size);
+		if (res != (i32)dst_size) failed = 1;
+	});
+	return failed == 0;
+}
+
+
+Path Resource::getCompiledPath() const {
+	if (startsWith(m_path.c_str(), ".lumix/asset_tiles/")) return m_path;
+	
+	const StaticString<LUMIX_MAX_PATH> res_path(".lumix/resources/", m_path.getHash().getHashValue(), ".res");
+	return Path(res_path);
+}
+
+
+void Resource::contentLoaded(u64 resource_size, bool success) {
+	m_load_times.parse_end = os::Timer::getRawTimestamp();
+	if (!success) ++m_failed_dep_count;
+	m_size = resource_size;
+	m_resource_manager.m_loaded_size += m_size;
 
 	ASSERT(m_empty_dep_count > 0);
 	--m_empty_dep_count;
@@ -160,6 +271,38 @@ void Resource::fileLoaded(u64 size, const u8* mem, bool success) {
 }
 
 
+void Resource::decodeFinished(ResourceDecodeJob* job) {
+	Resource& res = job->resource;
+	ASSERT(res.m_decoding);
+	res.m_decoding = false;
+	if (res.m_decode_canceled) {
+		res.m_decode_canceled = false;
+		res.unload();
+		// requested again while decoding
+		if (res.m_desired_state == State::READY) {
+			res.m_desired_state = State::EMPTY;
+			res.doLoad();
+		}
+	}
+	else {
+		// time between fileLoaded and decode start is spent waiting for a worker, it's not counted as parsing
+		res.m_load_times.parse_start = job->decode_start;
+		const bool success = job->success && res.finishLoad();
+		res.contentLoaded(job->resource_size, success);
+	}
+	LUMIX_DELETE(res.m_resource_manager.getOwner().m_allocator, job);
+}
+
+
+void Resource::decodeCanceled(ResourceDecodeJob* job) {
+	Resource& res = job->resource;
+	res.m_decoding = false;
+	res.m_decode_canceled = false;
+	res.unload();
+	LUMIX_DELETE(res.m_resource_manager.getOwner().m_allocator, job);
+}
+
+
 void Resource::doUnload()
 {
 	if (m_async_op.isValid())
@@ -169,11 +312,18 @@ void Resource::doUnload()
 		m_async_op = FileSystem::AsyncHandle::invalid();
 	}
 
+	if (m_in_lru) m_resource_manager.removeLRU(*this);
+	releasePrefetched();
+
 	m_hooked = false;
 	m_desired_state = State::EMPTY;
-	unload();
+	// worker still owns the resource's data, unloaded when decode finishes
+	if (m_decoding) m_decode_canceled = true;
+	else unload();
 	ASSERT(m_empty_dep_count <= 1);
 
+	ASSERT(m_resource_manager.m_loaded_size >= m_size);
+	m_resource_manager.m_loaded_size -= m_size;
 	m_size = 0;
 	m_empty_dep_count = 1;
 	m_failed_dep_count = 0;
@@ -199,20 +349,71 @@ void Resource::doLoad()
 	m_desired_state = State::READY;
 
 	if (m_async_op.isValid()) return;
+	// loaded again after decode finishes
+	if (m_decoding) return;
 
 	ASSERT(m_current_state != State::READY);
 
+	m_load_times = {};
+	m_load_times.queued = os::Timer::getRawTimestamp();
 	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
 	FileSystem::ContentCallback cb = makeDelegate<&Resource::fileLoaded>(this);
 
-	const FilePathHash hash = m_path.getHash();
-	if (startsWith(m_path.c_str(), ".lumix/asset_tiles/")) {
-		m_async_op = fs.getContent(m_path, cb);
+	m_async_op = fs.getContent(getCompiledPath(), cb, getLoadPriority());
+	prefetchDependencies();
+}
+
+
+void Resource::doReloadInPlace()
+{
+	ASSERT(!m_async_op.isValid());
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	FileSystem::ContentCallback cb = makeDelegate<&Resource::fileReloaded>(this);
+	m_async_op = fs.getContent(getCompiledPath(), cb, getLoadPriority());
+}
+
+
+void Resource::fileReloaded(u64 size, const u8* mem, bool success) {
+	ASSERT(m_async_op.isValid());
+	m_async_op = FileSystem::AsyncHandle::invalid();
+
+	if (success) {
+		u64 content_size = 0;
+		u64 resource_size = 0;
+		OutputMemoryStream tmp(m_resource_manager.m_allocator);
+		const u8* content = unpack(size, mem, tmp, content_size, resource_size);
+		if (content && reloadInPlace(content_size, content)) {
+			m_resource_manager.m_loaded_size = m_resource_manager.m_loaded_size - m_size + resource_size;
+			m_size = resource_size;
+			return;
+		}
 	}
-	else {	
-		const StaticString<LUMIX_MAX_PATH> res_path(".lumix/resources/", hash.getHashValue(), ".res");
-		m_async_op = fs.getContent(Path(res_path), cb);
+
+	logInfo("Reloading ", getPath(), " including its dependents");
+	doUnload();
+	doLoad();
+}
+
+
+void Resource::prefetchDependencies() {
+	// dependencies are known from the previous load, request them now instead of after this file is parsed
+	// they prefetch their own dependencies, so the whole graph is requested at once
+	for (Resource* dep : m_dependencies) {
+		if (dep == this) continue;
+		Resource* res = dep->m_resource_manager.load(dep->getPath());
+		if (res) m_prefetched.push(res);
 	}
+	// filled again by addDependency
+	m_dependencies.clear();
+}
+
+
+void Resource::releasePrefetched() {
+	if (m_prefetched.empty()) return;
+	
+	// decRefCount can unload resources, which can change m_prefetched
+	Array<Resource*> prefetched(m_prefetched.move());
+	for (Resource* res : prefetched) res->decRefCount();
 }
 
 
@@ -220,7 +421,8 @@ void Resource::addDependency(Resource& dependent_resource)
 {
 	ASSERT(m_desired_state != State::EMPTY);
 
-	dependent_resource.m_cb.bind<&Resource::onStateChanged>(this);
+	dependent_resource.m_dependents.push(this);
+	if (m_dependencies.indexOf(&dependent_resource) < 0) m_dependencies.push(&dependent_resource);
 	if (dependent_resource.isEmpty()) ++m_empty_dep_count;
 	if (dependent_resource.isFailure()) {
 		++m_failed_dep_count;
@@ -232,7 +434,7 @@ void Resource::addDependency(Resource& dependent_resource)
 
 void Resource::removeDependency(Resource& dependent_resource)
 {
-	dependent_resource.m_cb.unbind<&Resource::onStateChanged>(this);
+	dependent_resource.m_dependents.swapAndPopItem(this);
 	if (dependent_resource.isEmpty()) 
 	{
 		ASSERT(m_empty_dep_count > 1 || (m_empty_dep_count == 1 && !m_async_op.isValid())); 
@@ -247,17 +449,29 @@ void Resource::removeDependency(Resource& dependent_resource)
 	checkState();
 }
 
+u32 Resource::incRefCount() {
+	if (m_in_lru) m_resource_manager.removeLRU(*this);
+	return ++m_ref_count;
+}
+
+
 u32 Resource::decRefCount() {
 	ASSERT(m_ref_count > 0);
 	--m_ref_count;
 	if (m_ref_count == 0 && m_resource_manager.m_is_unload_enabled) {
-		doUnload();
+		// keep it cached, evicted later if the manager is over budget
+		if (m_resource_manager.m_budget > 0 && isReady()) {
+			m_resource_manager.pushLRU(*this);
+		}
+		else {
+			doUnload();
+		}
 	}
 	return m_ref_count;
 }
 
 
-void Resource::onStateChanged(State old_state, State new_state, Resource&)
+void Resource::onDependencyStateChanged(State old_state, State new_state)
 {
 	ASSERT(old_state != new_state);
 	ASSERT(m_current_state != State::EMPTY || m_desired_state != State::EMPTY);
@@ -5,6 +5,7 @@
 #include "engine/file_system.h"
 #include "engine/hash.h"
 #include "engine/path.h"
+#include "engine/stream.h"
 
 
 namespace Lumix {
@@ -27,8 +28,13 @@ template <> struct HashFunc<ResourceType> {
 #pragma pack(1)
 struct CompiledResourceHeader {
 	static constexpr u32 MAGIC = 'LRES';
+	// large compressed resources are split into independent chunks, compressed and decompressed in parallel
+	static constexpr u32 CHUNK_SIZE = 256 * 1024;
 	enum Flags {
-		COMPRESSED = 1 << 0
+		COMPRESSED = 1 << 0, // LZ4, one block
+		// LZ4, header is followed by u32 chunk size, u32 chunk count and u32 compressed size of each chunk
+		// chunk with compressed size equal to its decompressed size is stored uncompressed
+		CHUNKED = 1 << 1
 	};
 	u32 magic = MAGIC;
 	u32 version = 0;
@@ -50,8 +56,20 @@ struct LUMIX_ENGINE_API Resource {
 
 	using ObserverCallback = DelegateList<void(State, State, Resource&)>;
 
+	// os::Timer::getRawTimestamp() of the stages of the last load, 0 if the stage did not happen
+	// parse is load(), or decode() and finishLoad(), ready - parse_end is spent waiting for dependencies
+	struct LoadTimes {
+		u64 queued = 0;
+		u64 io_start = 0;
+		u64 io_end = 0;
+		u64 parse_start = 0;
+		u64 parse_end = 0;
+		u64 ready = 0;
+	};
+
 	virtual ~Resource();
 	virtual ResourceType getType() const = 0;
+	virtual FileSystem::Priority getLoadPriority() const { return FileSystem::Priority::NORMAL; }
 	State getState() const { return m_current_state; }
 
 	bool isEmpty() const { return State::EMPTY == m_current_state; }
@@ -63,9 +81,14 @@ struct LUMIX_ENGINE_API Resource {
 	const Path& getPath() const { return m_path; }
 	struct ResourceManager& getResourceManager() { return m_resource_manager; }
 	u32 decRefCount();
-	u32 incRefCount() { return ++m_ref_count; }
+	u32 incRefCount();
 	bool wantReady() const { return m_desired_state == State::READY; }
 	bool isHooked() const { return m_hooked; }
+	const LoadTimes& getLoadTimes() const { return m_load_times; }
+	// resources added as dependencies by the last load
+	Span<Resource* const> getDependencies() const { return Span<Resource* const>(m_dependencies.begin(), m_dependencies.end()); }
+	// locator of compiled data the resource reads by itself after it's loaded, e.g. streamed data, exported with the resource
+	virtual Path getStreamedPath() const { return Path(); }
 
 	template <auto Function, typename C> void onLoaded(C* instance)
 	{
@@ -80,9 +103,26 @@ protected:
 	Resource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator);
 
 	virtual void onBeforeReady() {}
+	// must also release data from decode if finishLoad was not called
 	virtual void unload() = 0;
 	virtual bool load(u64 size, const u8* mem) = 0;
 
+	// opt-in, return true to have decode called on a job worker and then finishLoad on the main thread instead of load
+	virtual bool isDecodedInBackground() const { return false; }
+	// job worker, CPU only work on the resource's own data, no GPU, no dependencies
+	virtual bool decode(u64 size, const u8* mem) { ASSERT(false); return false; }
+	// main thread, after successful decode, e.g. creates GPU objects and adds dependencies
+	virtual bool finishLoad() { return true; }
+
+	// opt-in, return true to have reloadInPlace called with new content of a ready resource instead of unload and load
+	virtual bool isReloadedInPlace() const { return false; }
+	// main thread, resource stays ready and its dependents are not touched, return false to fall back to full reload
+	virtual bool reloadInPlace(u64 size, const u8* mem) { ASSERT(false); return false; }
+
+	// content of a file loaded from getCompiledPath(), nullptr if it is invalid, tmp holds decompressed data
+	const u8* unpack(u64 size, const u8* mem, OutputMemoryStream& tmp, u64& content_size, u64& resource_size) const;
+	Path getCompiledPath() const;
+
 	void onCreated(State state);
 	void doUnload();
 	void addDependency(Resource& dependent_resource);
@@ -95,22 +135,58 @@ protected:
 	ResourceManager& m_resource_manager;
 
 private:
+	friend struct ResourceDecodeJob;
+
 	void doLoad();
+	void doReloadInPlace();
+	void fileReloaded(u64 size, const u8* mem, bool success);
+	bool unpackChunks(const u8* mem, u64 size, OutputMemoryStream& tmp, u64 decompressed_size) const;
 	void fileLoaded(u64 size, const u8* mem, bool success);
-	void onStateChanged(State old_state, State new_state, Resource&);
+	void contentLoaded(u64 resource_size, bool success);
+	static void decodeFinished(struct ResourceDecodeJob* job);
+	static void decodeCanceled(struct ResourceDecodeJob* job);
+	void setState(State new_state);
+	void onDependencyStateChanged(State old_state, State new_state);
+	void prefetchDependencies();
+	void releasePrefetched();
 
 	Resource(const Resource&) = delete;
 	void operator=(const Resource&) = delete;
 
 	ObserverCallback m_cb;
+	// resources which added this one as a dependency, their counters are updated directly on state change
+	Array<Resource*> m_dependents;
+	// dependencies added during the last load, requested all at once when the resource is loaded again
+	Array<Resource*> m_dependencies;
+	// references held until this resource is ready
+	Array<Resource*> m_prefetched;
 	u64 m_size;
 	Path m_path;
 	u32 m_ref_count;
 	u16 m_failed_dep_count;
 	State m_current_state;
 	FileSystem::AsyncHandle m_async_op;
+	LoadTimes m_load_times;
 	bool m_hooked = false;
+	bool m_in_lru = false;
+	bool m_decoding = false;
+	// unloaded while decoding, decoded data are thrown away
+	bool m_decode_canceled = false;
+	// ResourceManager's list of unreferenced resources
+	Resource* m_lru_prev = nullptr;
+	Resource* m_lru_next = nullptr;
 }; // struct Resource
 
 
+struct ResourceDecodeJob {
+	ResourceDecodeJob(Resource& resource, IAllocator& allocator) : resource(resource), data(allocator) {}
+
+	Resource& resource;
+	OutputMemoryStream data;
+	u64 resource_size = 0;
+	u64 decode_start = 0;
+	bool success = false;
+};
+
+
 } // namespace Lumix
@@ -1,7 +1,13 @@
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lumix.h"
+#include "engine/math.h"
+#include "engine/os.h"
+#include "engine/profiler.h"
 #include "engine/resource.h"
 #include "engine/resource_manager.h"
+#include "engine/stream.h"
+#include "engine/string.h"
 
 
 namespace Lumix
@@ -15,6 +21,7 @@ void ResourceManager::create(ResourceType type, ResourceManagerHub& owner)
 
 void ResourceManager::destroy()
 {
+	if (m_owner) m_owner->cancelDecoding(*this);
 	for (auto iter = m_resources.begin(), end = m_resources.end(); iter != end; ++iter)
 	{
 		Resource* resource = iter.value();
@@ -25,6 +32,82 @@ void ResourceManager::destroy()
 		destroyResource(*resource);
 	}
 	m_resources.clear();
+	m_lru_head = m_lru_tail = nullptr;
+}
+
+void ResourceManager::setBudget(u64 bytes, const char* name)
+{
+	m_budget = bytes;
+	if (bytes > 0 && m_usage_counter == 0) {
+		const StaticString<128> usage_name(name, " (MB)");
+		const StaticString<128> evictions_name(name, " evictions");
+		m_usage_counter = profiler::createCounter(usage_name, 0);
+		m_evictions_counter = profiler::createCounter(evictions_name, 0);
+	}
+	// without budget nothing is cached
+	if (bytes == 0) {
+		while (m_lru_head) m_lru_head->doUnload();
+	}
+}
+
+void ResourceManager::pushLRU(Resource& resource)
+{
+	ASSERT(!resource.m_in_lru);
+	resource.m_in_lru = true;
+	resource.m_lru_prev = m_lru_tail;
+	resource.m_lru_next = nullptr;
+	if (m_lru_tail) m_lru_tail->m_lru_next = &resource;
+	else m_lru_head = &resource;
+	m_lru_tail = &resource;
+}
+
+void ResourceManager::removeLRU(Resource& resource)
+{
+	ASSERT(resource.m_in_lru);
+	if (resource.m_lru_prev) resource.m_lru_prev->m_lru_next = resource.m_lru_next;
+	else m_lru_head = resource.m_lru_next;
+	if (resource.m_lru_next) resource.m_lru_next->m_lru_prev = resource.m_lru_prev;
+	else m_lru_tail = resource.m_lru_prev;
+	resource.m_lru_prev = resource.m_lru_next = nullptr;
+	resource.m_in_lru = false;
+}
+
+void ResourceManager::evict(u32 max_count)
+{
+	for (u32 i = 0; i < max_count && m_lru_head && m_loaded_size > m_budget; ++i) {
+		// doUnload removes it from the list
+		m_lru_head->doUnload();
+		++m_evicted_count;
+	}
+
+	if (m_usage_counter) {
+		profiler::pushCounter(m_usage_counter, float(double(m_loaded_size) / (1024.0 * 1024.0)));
+		profiler::pushCounter(m_evictions_counter, (float)m_evicted_count);
+	}
+}
+
+static u64 ticksBetween(u64 from, u64 to) {
+	return to > from ? to - from : 0;
+}
+
+void ResourceManager::onLoadFinished(Resource& resource)
+{
+	const Resource::LoadTimes& t = resource.getLoadTimes();
+	if (t.ready < m_owner->m_load_stats_start) return;
+
+	// content not read by io workers, e.g. mapped from a pak
+	const u64 io_start = t.io_start ? t.io_start : t.queued;
+	const u64 io_end = t.io_end ? t.io_end : io_start;
+	const u64 total = ticksBetween(t.queued, t.ready);
+
+	++m_load_stats.count;
+	m_load_stats.queue += ticksBetween(t.queued, io_start);
+	m_load_stats.io += ticksBetween(io_start, io_end);
+	m_load_stats.wait += ticksBetween(io_end, t.parse_start);
+	m_load_stats.parse += ticksBetween(t.parse_start, t.parse_end);
+	m_load_stats.dependencies += ticksBetween(t.parse_end, t.ready);
+	m_load_stats.total += total;
+	m_load_stats.max = maximum(m_load_stats.max, total);
 }
 
 Resource* ResourceManager::get(const Path& path)
@@ -75,7 +158,8 @@ void ResourceManager::removeUnreferenced()
 	Array<Resource*> to_remove(m_allocator);
 	for (auto* i : m_resources)
 	{
-		if (i->getRefCount() == 0) to_remove.push(i);
+		// cached resources are evicted when over budget
+		if (i->getRefCount() == 0 && !i->m_in_lru) to_remove.push(i);
 	}
 
 	for (auto* i : to_remove)
@@ -93,19 +177,25 @@ void ResourceManager::reload(const Path& path)
 
 void ResourceManager::reload(Resource& resource)
 {
+	// ready resource keeps its data and dependents until the new content is applied
+	const bool in_place = resource.isReady() && resource.isReloadedInPlace() && !resource.m_async_op.isValid();
 	if (resource.m_current_state != Resource::State::EMPTY) {
-		resource.doUnload();
+		if (!in_place) resource.doUnload();
 	}
 	else if (resource.m_desired_state == Resource::State::READY) return;
 
 	if (m_owner->onBeforeLoad(resource) == ResourceManagerHub::LoadHook::Action::DEFERRED)
 	{
+		if (in_place) resource.doUnload();
 		ASSERT(!resource.m_hooked);
 		resource.m_hooked = true;
 		resource.m_desired_state = Resource::State::READY;
 		resource.incRefCount(); // for hook
 		resource.incRefCount(); // for return value
 	}
+	else if (in_place) {
+		resource.doReloadInPlace();
+	}
 	else {
 		resource.doLoad();
 	}
@@ -118,9 +208,10 @@ void ResourceManager::enableUnload(bool enable)
 
 	for (auto* resource : m_resources)
 	{
-		if (resource->getRefCount() == 0)
+		if (resource->getRefCount() == 0 && !resource->m_in_lru)
 		{
-			resource->doUnload();
+			if (m_budget > 0 && resource->isReady()) pushLRU(*resource);
+			else resource->doUnload();
 		}
 	}
 }
@@ -139,13 +230,19 @@ ResourceManager::~ResourceManager()
 
 ResourceManagerHub::ResourceManagerHub(IAllocator& allocator) 
 	: m_resource_managers(allocator)
+	, m_decoded(allocator)
 	, m_allocator(allocator)
 	, m_load_hook(nullptr)
 	, m_file_system(nullptr)
 {
+	m_decode_signal = LUMIX_NEW(m_allocator, jobs::Signal);
 }
 
-ResourceManagerHub::~ResourceManagerHub() = default;
+ResourceManagerHub::~ResourceManagerHub() {
+	jobs::wait(m_decode_signal);
+	ASSERT(m_decoded.empty());
+	LUMIX_DELETE(m_allocator, m_decode_signal);
+}
 
 
 void ResourceManagerHub::init(FileSystem& fs)
@@ -220,6 +317,44 @@ void ResourceManagerHub::removeUnreferenced()
 	}
 }
 
+void ResourceManagerHub::finishDecoded()
+{
+	for (;;) {
+		ResourceDecodeJob* job;
+		{
+			MutexGuard lock(m_decoded_mutex);
+			if (m_decoded.empty()) return;
+			job = m_decoded[0];
+			m_decoded.erase(0);
+		}
+		Resource::decodeFinished(job);
+	}
+}
+
+void ResourceManagerHub::cancelDecoding(ResourceManager& manager)
+{
+	jobs::wait(m_decode_signal);
+	MutexGuard lock(m_decoded_mutex);
+	for (i32 i = m_decoded.size() - 1; i >= 0; --i) {
+		ResourceDecodeJob* job = m_decoded[i];
+		if (&job->resource.getResourceManager() != &manager) continue;
+		m_decoded.erase(i);
+		Resource::decodeCanceled(job);
+	}
+}
+
+void ResourceManagerHub::update()
+{
+	PROFILE_FUNCTION();
+	finishDecoded();
+
+	// unloading can be expensive, spread it over frames
+	static constexpr u32 MAX_EVICTIONS_PER_FRAME = 16;
+	for (ResourceManager* manager : m_resource_managers) {
+		if (manager->m_budget > 0) manager->evict(MAX_EVICTIONS_PER_FRAME);
+	}
+}
+
 void ResourceManagerHub::enableUnload(bool enable)
 {
 	for (auto* manager : m_resource_managers)
@@ -228,6 +363,72 @@ void ResourceManagerHub::enableUnload(bool enable)
 	}
 }
 
+void ResourceManagerHub::resetLoadStats()
+{
+	m_load_stats_start = os::Timer::getRawTimestamp();
+	for (ResourceManager* manager : m_resource_managers) {
+		manager->m_load_stats = {};
+	}
+}
+
+void ResourceManagerHub::getLoadCriticalPath(Array<Resource*>& path)
+{
+	Resource* res = nullptr;
+	for (ResourceManager* manager : m_resource_managers) {
+		for (Resource* r : manager->getResourceTable()) {
+			const u64 ready = r->getLoadTimes().ready;
+			if (ready < m_load_stats_start || ready == 0) continue;
+			if (!res || ready > res->getLoadTimes().ready) res = r;
+		}
+	}
+
+	while (res && path.indexOf(res) < 0) {
+		path.push(res);
+		// dependency ready after the resource was parsed is what the resource waited for
+		Resource* next = nullptr;
+		for (Resource* dep : res->getDependencies()) {
+			const u64 ready = dep->getLoadTimes().ready;
+			if (ready <= res->getLoadTimes().parse_end) continue;
+			if (!next || ready > next->getLoadTimes().ready) next = dep;
+		}
+		res = next;
+	}
+}
+
+void ResourceManagerHub::writeLoadReport(IOutputStream& out)
+{
+	const double to_ms = 1000.0 / os::Timer::getFrequency();
+	auto ms = [&](u64 ticks){ return float(ticks * to_ms); };
+
+	out << "type\tcount\tqueue ms\tio ms\twait ms\tparse ms\tdependencies ms\ttotal ms\tmax ms\n";
+	for (ResourceManager* manager : m_resource_managers) {
+		const ResourceManager::LoadStats& stats = manager->getLoadStats();
+		if (stats.count == 0) continue;
+
+		// types do not know their names, resources of one type share the extension
+		Span<const char> type_name;
+		for (Resource* res : manager->getResourceTable()) {
+			type_name = Path::getExtension(Span(res->getPath().c_str(), res->getPath().length()));
+			break;
+		}
+		out << type_name << "\t" << stats.count << "\t" << ms(stats.queue) << "\t" << ms(stats.io) << "\t" << ms(stats.wait)
+			<< "\t" << ms(stats.parse) << "\t" << ms(stats.dependencies) << "\t" << ms(stats.total) << "\t" << ms(stats.max) << "\n";
+	}
+
+	Array<Resource*> critical_path(m_allocator);
+	getLoadCriticalPath(critical_path);
+	if (critical_path.empty()) return;
+
+	const u64 start = m_load_stats_start;
+	out << "\ncritical path, ms since reset\nqueued\tio start\tio end\tparse start\tparse end\tready\tpath\n";
+	for (Resource* res : critical_path) {
+		const Resource::LoadTimes& t = res->getLoadTimes();
+		out << ms(ticksBetween(start, t.queued)) << "\t" << ms(ticksBetween(start, t.io_start)) << "\t" << ms(ticksBetween(start, t.io_end))
+			<< "\t" << ms(ticksBetween(start, t.parse_start)) << "\t" << ms(ticksBetween(start, t.parse_end))
+			<< "\t" << ms(ticksBetween(start, t.ready)) << "\t" << res->getPath().c_str() << "\n";
+	}
+}
+
 void ResourceManagerHub::reloadAll() {
 	while (m_file_system->hasWork()) m_file_system->processCallbacks();
 	
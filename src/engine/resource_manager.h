@@ -1,19 +1,35 @@
 #pragma once
 
 
+#include "engine/array.h"
 #include "engine/hash.h"
 #include "engine/hash_map.h"
+#include "engine/sync.h"
 
 
 namespace Lumix
 {
 
+namespace jobs { struct Signal; }
+
 
 struct LUMIX_ENGINE_API ResourceManager {
 	friend struct Resource;
 	friend struct ResourceManagerHub;
 	using ResourceTable = HashMap<FilePathHash, struct Resource*>;
 
+	// sums of Resource::LoadTimes stages of resources loaded since the last ResourceManagerHub::resetLoadStats, in ticks
+	struct LoadStats {
+		u32 count = 0;
+		u64 queue = 0; // queued -> io start
+		u64 io = 0;
+		u64 wait = 0; // io end -> parse start, waiting for processCallbacks or a decode worker
+		u64 parse = 0;
+		u64 dependencies = 0; // parse end -> ready
+		u64 total = 0;
+		u64 max = 0;
+	};
+
 	void create(struct ResourceType type, struct ResourceManagerHub& owner);
 	void destroy();
 
@@ -21,6 +37,15 @@ struct LUMIX_ENGINE_API ResourceManager {
 
 	void removeUnreferenced();
 
+	// with a budget, unreferenced resources stay loaded until the manager is over budget, 0 - unload immediately
+	// name is used for profiler counters
+	void setBudget(u64 bytes, const char* name);
+	u64 getBudget() const { return m_budget; }
+	u64 getLoadedSize() const { return m_loaded_size; }
+	// unloads least recently used unreferenced resources while over budget, at most max_count
+	void evict(u32 max_count);
+	const LoadStats& getLoadStats() const { return m_load_stats; }
+
 	void reload(const Path& path);
 	void reload(Resource& resource);
 	ResourceTable& getResourceTable() { return m_resources; }
@@ -35,11 +60,27 @@ protected:
 	virtual void destroyResource(Resource& resource) = 0;
 	Resource* get(const Path& path);
 
+private:
+	void pushLRU(Resource& resource);
+	void removeLRU(Resource& resource);
+	void onLoadFinished(Resource& resource);
+
 protected:
 	IAllocator& m_allocator;
 	ResourceTable m_resources;
 	ResourceManagerHub* m_owner;
 	bool m_is_unload_enabled;
+
+private:
+	u64 m_budget = 0;
+	u64 m_loaded_size = 0;
+	u32 m_evicted_count = 0;
+	// unreferenced loaded resources, head is the least recently used
+	Resource* m_lru_head = nullptr;
+	Resource* m_lru_tail = nullptr;
+	u32 m_usage_counter = 0;
+	u32 m_evictions_counter = 0;
+	LoadStats m_load_stats;
 };
 
 
@@ -80,15 +121,36 @@ struct LUMIX_ENGINE_API ResourceManagerHub {
 	void reloadAll();
 	void removeUnreferenced();
 	void enableUnload(bool enable);
+	// load stats and critical path consider only resources loaded after this
+	void resetLoadStats();
+	// the resource which was ready last, followed by its dependencies which delayed it, recursively
+	void getLoadCriticalPath(Array<Resource*>& path);
+	// text report of load stats per resource type and of the critical path
+	void writeLoadReport(struct IOutputStream& out);
+	// call once per frame, finishes resources decoded in background and evicts resources of managers over budget
+	void update();
 
 	FileSystem& getFileSystem() { return *m_file_system; }
 
 private:
+	friend struct Resource;
+	friend struct ResourceManager;
+
 	Resource* load(ResourceManager& manager, const Path& path);
+	void finishDecoded();
+	// waits for all decode jobs, decoded resources of `manager` are unloaded instead of finished
+	void cancelDecoding(ResourceManager& manager);
+
 	IAllocator& m_allocator;
+	// green when no decode job is running
+	jobs::Signal* m_decode_signal;
+	Mutex m_decoded_mutex;
+	// decoded on workers, waiting for finishLoad on the main thread
+	Array<struct ResourceDecodeJob*> m_decoded;
 	ResourceManagerTable m_resource_managers;
 	FileSystem* m_file_system;
 	LoadHook* m_load_hook;
+	u64 m_load_stats_start = 0;
 };
 
 
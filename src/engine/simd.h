@@ -3,9 +3,16 @@
 
 #include "engine/lumix.h"
 
-
-#if defined _WIN32 && !defined __clang__
-	#include <xmmintrin.h>
+// LUMIX_NO_SIMD forces the scalar implementation, e.g. to compare it with the simd backends
+#if !defined LUMIX_NO_SIMD && (defined _M_X64 || defined __SSE2__)
+	#define LUMIX_SIMD_SSE
+	#include <emmintrin.h>
+	#if defined __FMA__ || defined __AVX2__
+		#include <immintrin.h>
+	#endif
+#elif !defined LUMIX_NO_SIMD && (defined _M_ARM64 || defined __aarch64__)
+	#define LUMIX_SIMD_NEON
+	#include <arm_neon.h>
 #else
 	#include <math.h>
 	#include <string.h>
@@ -15,7 +22,7 @@ namespace Lumix
 {
 
 
-#if defined _WIN32 && !defined __clang__
+#if defined LUMIX_SIMD_SSE
 	using float4 = __m128;
 
 
@@ -64,6 +71,11 @@ namespace Lumix
 		_mm_store_ps((float*)dest, src);
 	}
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		_mm_storeu_ps((float*)dest, src);
+	}
+
 	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
 	{
 		return _mm_cmpgt_ps(a, b);
@@ -133,18 +145,212 @@ namespace Lumix
 		return _mm_max_ps(a, b);
 	}
 
-	LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
-		return _mm_add_ps(a, b);
+
+	// per lane `mask ? b : a`, mask is a result of f4Cmp*
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
 	}
 
-	LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
-		return _mm_sub_ps(a, b);
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		#if defined __FMA__ || defined __AVX2__
+			return _mm_fmadd_ps(a, b, c);
+		#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+		#endif
 	}
 
-	LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
-		return _mm_mul_ps(a, b);
+
+	// rows to columns, e.g. 4 AoS xyzw to SoA xxxx, yyyy, zzzz, wwww
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+
+	// gcc and clang have builtin operators for vector types
+	#if defined _MSC_VER && !defined __clang__
+		LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
+			return _mm_add_ps(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
+			return _mm_sub_ps(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
+			return _mm_mul_ps(a, b);
+		}
+	#endif
+
+#elif defined LUMIX_SIMD_NEON
+	using float4 = float32x4_t;
+
+
+	LUMIX_FORCE_INLINE float4 f4LoadUnaligned(const void* src)
+	{
+		return vld1q_f32((const float*)src);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Load(const void* src)
+	{
+		return vld1q_f32((const float*)src);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Splat(float value)
+	{
+		return vdupq_n_f32(value);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetX(float4 v)
+	{
+		return vgetq_lane_f32(v, 0);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetY(float4 v)
+	{
+		return vgetq_lane_f32(v, 1);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetZ(float4 v)
+	{
+		return vgetq_lane_f32(v, 2);
+	}
+
+	LUMIX_FORCE_INLINE float f4GetW(float4 v)
+	{
+		return vgetq_lane_f32(v, 3);
+	}
+
+	LUMIX_FORCE_INLINE void f4Store(void* dest, float4 src)
+	{
+		vst1q_f32((float*)dest, src);
+	}
+
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		vst1q_f32((float*)dest, src);
+	}
+
+	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
+	{
+		return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+	}
+
+	LUMIX_FORCE_INLINE float4 f4CmpLT(float4 a, float4 b)
+	{
+		return vreinterpretq_f32_u32(vcltq_f32(a, b));
+	}
+	
+	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
+	{
+		static const int32x4_t shift = { 0, 1, 2, 3 };
+		const uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_f32(a), 31);
+		return (int)vaddvq_u32(vshlq_u32(sign, shift));
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Add(float4 a, float4 b)
+	{
+		return vaddq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Sub(float4 a, float4 b)
+	{
+		return vsubq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Mul(float4 a, float4 b)
+	{
+		return vmulq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Div(float4 a, float4 b)
+	{
+		return vdivq_f32(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Rcp(float4 a)
+	{
+		// estimate has ~8 bits, one newton step to get close to _mm_rcp_ps precision
+		const float4 e = vrecpeq_f32(a);
+		return vmulq_f32(e, vrecpsq_f32(a, e));
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Sqrt(float4 a)
+	{
+		return vsqrtq_f32(a);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Rsqrt(float4 a)
+	{
+		const float4 e = vrsqrteq_f32(a);
+		return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Min(float4 a, float4 b)
+	{
+		return vminq_f32(a, b);
 	}
 
+
+	LUMIX_FORCE_INLINE float4 f4Max(float4 a, float4 b)
+	{
+		return vmaxq_f32(a, b);
+	}
+
+
+	// per lane `mask ? b : a`, mask is a result of f4Cmp*
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		return vbslq_f32(vreinterpretq_u32_f32(mask), b, a);
+	}
+
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		return vfmaq_f32(c, a, b);
+	}
+
+
+	// rows to columns, e.g. 4 AoS xyzw to SoA xxxx, yyyy, zzzz, wwww
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		const float32x4x2_t ab = vtrnq_f32(a, b);
+		const float32x4x2_t cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+
+	// msvc does not have builtin operators for neon types
+	#if defined _MSC_VER && !defined __clang__
+		LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
+			return vaddq_f32(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator -(float4 a, float4 b) {
+			return vsubq_f32(a, b);
+		}
+
+		LUMIX_FORCE_INLINE float4 operator *(float4 a, float4 b) {
+			return vmulq_f32(a, b);
+		}
+	#endif
+
 #else 
 	struct float4
 	{
@@ -199,6 +405,11 @@ namespace Lumix
 		(*(float4*)dest) = src;
 	}
 
+	LUMIX_FORCE_INLINE void f4StoreUnaligned(void* dest, float4 src)
+	{
+		memcpy(dest, &src, sizeof(src));
+	}
+
 	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
 	{
 		static const float gt = [](){
@@ -232,10 +443,13 @@ namespace Lumix
 	}
 	LUMIX_FORCE_INLINE int f4MoveMask(float4 a)
 	{
-		return (a.w < 0 ? (1 << 3) : 0) | 
-			(a.z < 0 ? (1 << 2) : 0) | 
-			(a.y < 0 ? (1 << 1) : 0) | 
-			(a.x < 0 ? 1 : 0);
+		// sign bits, comparison results are NaNs so `< 0` does not work
+		u32 u[4];
+		memcpy(u, &a, sizeof(u));
+		return (u[3] >> 31 << 3) | 
+			(u[2] >> 31 << 2) | 
+			(u[1] >> 31 << 1) | 
+			(u[0] >> 31);
 	}
 
 
@@ -337,6 +551,40 @@ namespace Lumix
 		};
 	}
 
+	// per lane `mask ? b : a`, mask is a result of f4Cmp*
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		u32 m[4];
+		memcpy(m, &mask, sizeof(m));
+		return{
+			m[0] ? b.x : a.x,
+			m[1] ? b.y : a.y,
+			m[2] ? b.z : a.z,
+			m[3] ? b.w : a.w
+		};
+	}
+
+	// a * b + c
+	LUMIX_FORCE_INLINE float4 f4MulAdd(float4 a, float4 b, float4 c)
+	{
+		return{
+			a.x * b.x + c.x,
+			a.y * b.y + c.y,
+			a.z * b.z + c.z,
+			a.w * b.w + c.w
+		};
+	}
+
+	// rows to columns, e.g. 4 AoS xyzw to SoA xxxx, yyyy, zzzz, wwww
+	LUMIX_FORCE_INLINE void f4Transpose(float4& a, float4& b, float4& c, float4& d)
+	{
+		const float4 ta = a, tb = b, tc = c, td = d;
+		a = {ta.x, tb.x, tc.x, td.x};
+		b = {ta.y, tb.y, tc.y, td.y};
+		c = {ta.z, tb.z, tc.z, td.z};
+		d = {ta.w, tb.w, tc.w, td.w};
+	}
+
 	LUMIX_FORCE_INLINE float4 operator +(float4 a, float4 b) {
 		return f4Add(a, b);
 	}
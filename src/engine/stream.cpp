@@ -1,6 +1,7 @@
 #include "stream.h"
 #include "engine/allocator.h"
 #include "engine/crt.h"
+#include "engine/math.h"
 #include "engine/string.h"
 
 
@@ -133,6 +134,138 @@ IOutputStream& IOutputStream::operator << (double value)
 }
 
 
+bool IOutputStream::writeVarint(u64 value)
+{
+	u8 tmp[10];
+	u32 size = 0;
+	while (value >= 0x80) {
+		tmp[size] = u8(value) | 0x80;
+		value >>= 7;
+		++size;
+	}
+	tmp[size] = u8(value);
+	return write(tmp, size + 1);
+}
+
+
+bool IOutputStream::writeZigzag(i64 value)
+{
+	return writeVarint((u64(value) << 1) ^ u64(value >> 63));
+}
+
+
+u64 IInputStream::readVarint()
+{
+	u64 res = 0;
+	for (u32 shift = 0; shift < 64; shift += 7) {
+		u8 byte;
+		if (!read(&byte, sizeof(byte))) return res;
+		res |= u64(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) break;
+	}
+	return res;
+}
+
+
+i64 IInputStream::readZigzag()
+{
+	const u64 v = readVarint();
+	return i64(v >> 1) ^ -i64(v & 1);
+}
+
+
+void BitWriter::write(u32 value, u32 bits)
+{
+	ASSERT(bits <= 32);
+	ASSERT(bits == 32 || value < (1u << bits));
+	m_bits |= u64(value) << m_bits_count;
+	m_bits_count += bits;
+	while (m_bits_count >= 8) {
+		m_stream.write(u8(m_bits));
+		m_bits >>= 8;
+		m_bits_count -= 8;
+	}
+}
+
+
+void BitWriter::writeQuantized(float value, float min, float max, u32 bits)
+{
+	ASSERT(bits > 0 && bits < 32);
+	ASSERT(max > min);
+	const u32 steps = (1u << bits) - 1;
+	const float t = clamp((value - min) / (max - min), 0.f, 1.f);
+	write(u32(t * steps + 0.5f), bits);
+}
+
+
+// smaller three components of a normalized quaternion are in this range
+static constexpr float QUAT_COMPONENT_MAX = 0.70710678f;
+
+void BitWriter::writeQuat(const Quat& q, u32 bits_per_component)
+{
+	const float c[4] = { q.x, q.y, q.z, q.w };
+	u32 largest = 0;
+	for (u32 i = 1; i < 4; ++i) {
+		if (fabsf(c[i]) > fabsf(c[largest])) largest = i;
+	}
+	// q and -q are the same rotation, so the largest component is always positive
+	const float sign = c[largest] < 0 ? -1.f : 1.f;
+	write(largest, 2);
+	for (u32 i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		writeQuantized(c[i] * sign, -QUAT_COMPONENT_MAX, QUAT_COMPONENT_MAX, bits_per_component);
+	}
+}
+
+
+void BitWriter::flush()
+{
+	if (m_bits_count == 0) return;
+	m_stream.write(u8(m_bits));
+	m_bits = 0;
+	m_bits_count = 0;
+}
+
+
+u32 BitReader::read(u32 bits)
+{
+	ASSERT(bits <= 32);
+	while (m_bits_count < bits) {
+		u8 byte = 0;
+		m_stream.read(&byte, sizeof(byte));
+		m_bits |= u64(byte) << m_bits_count;
+		m_bits_count += 8;
+	}
+	const u32 res = u32(m_bits & ((u64(1) << bits) - 1));
+	m_bits >>= bits;
+	m_bits_count -= bits;
+	return res;
+}
+
+
+float BitReader::readQuantized(float min, float max, u32 bits)
+{
+	ASSERT(bits > 0 && bits < 32);
+	const u32 steps = (1u << bits) - 1;
+	return min + read(bits) / float(steps) * (max - min);
+}
+
+
+Quat BitReader::readQuat(u32 bits_per_component)
+{
+	const u32 largest = read(2);
+	float c[4];
+	float sum = 0;
+	for (u32 i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		c[i] = readQuantized(-QUAT_COMPONENT_MAX, QUAT_COMPONENT_MAX, bits_per_component);
+		sum += c[i] * c[i];
+	}
+	c[largest] = sqrtf(maximum(0.f, 1 - sum));
+	return Quat(c[0], c[1], c[2], c[3]);
+}
+
+
 OutputMemoryStream::OutputMemoryStream(OutputMemoryStream&& rhs)
 {
 	m_allocator = rhs.m_allocator;
@@ -306,7 +439,6 @@ void OutputMemoryStream::resize(u64 size)
 }
 
 
-
 InputMemoryStream::InputMemoryStream(const void* data, u64 size)
 	: m_data((const u8*)data)
 	, m_size(size)
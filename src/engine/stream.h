@@ -8,6 +8,9 @@ namespace Lumix
 {
 
 
+struct Quat;
+
+
 struct LUMIX_ENGINE_API IOutputStream {
 	virtual bool write(const void* buffer, u64 size) = 0;
 
@@ -21,6 +24,10 @@ struct LUMIX_ENGINE_API IOutputStream {
 	IOutputStream& operator << (double value);
 	template <typename T> bool write(const T& value);
 	template <typename T> bool writeArray(const Array<T>& value);
+	// 7 bits per byte, small values take less space
+	bool writeVarint(u64 value);
+	// varint with sign in the lowest bit, small negative values take less space too
+	bool writeZigzag(i64 value);
 };
 
 
@@ -32,6 +39,8 @@ struct LUMIX_ENGINE_API IInputStream {
 	template <typename T> void read(T& value) { read(&value, sizeof(T)); }
 	template <typename T> T read();
 	template <typename T> void readArray(Array<T>* array);
+	u64 readVarint();
+	i64 readZigzag();
 };
 
 
@@ -74,6 +83,43 @@ private:
 };
 
 
+// packs values with arbitrary number of bits, call flush() when done
+struct LUMIX_ENGINE_API BitWriter {
+	explicit BitWriter(IOutputStream& stream) : m_stream(stream) {}
+	~BitWriter() { ASSERT(m_bits_count == 0); }
+
+	void write(u32 value, u32 bits);
+	void writeBool(bool value) { write(value ? 1 : 0, 1); }
+	// value is clamped to [min, max]
+	void writeQuantized(float value, float min, float max, u32 bits);
+	// smallest three, 2 bits + 3 * bits_per_component, q must be normalized
+	void writeQuat(const Quat& q, u32 bits_per_component);
+	// writes partial byte, if any
+	void flush();
+
+private:
+	IOutputStream& m_stream;
+	u64 m_bits = 0;
+	u32 m_bits_count = 0;
+};
+
+
+// reads what BitWriter wrote, with the same number of bits
+struct LUMIX_ENGINE_API BitReader {
+	explicit BitReader(IInputStream& stream) : m_stream(stream) {}
+
+	u32 read(u32 bits);
+	bool readBool() { return read(1) != 0; }
+	float readQuantized(float min, float max, u32 bits);
+	Quat readQuat(u32 bits_per_component);
+
+private:
+	IInputStream& m_stream;
+	u64 m_bits = 0;
+	u32 m_bits_count = 0;
+};
+
+
 template <typename T> void OutputMemoryStream::write(const T& value)
 {
 	write(&value, sizeof(T));
@@ -1,12 +1,18 @@
 #include "universe.h"
+#include "engine/atomic.h"
+#include "engine/crt.h"
 #include "engine/engine.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/plugin.h"
 #include "engine/prefab.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
+#include "engine/stream.h"
 #include "engine/string.h"
+#include "engine/sync.h"
 
 
 namespace Lumix
@@ -49,18 +55,30 @@ Universe::Universe(Engine& engine, IAllocator& allocator)
 	, m_names(m_allocator)
 	, m_entities(m_allocator)
 	, m_component_added(m_allocator)
+	, m_deferred_components(m_allocator)
 	, m_component_destroyed(m_allocator)
 	, m_entity_destroyed(m_allocator)
 	, m_entity_moved(m_allocator)
+	, m_entities_moved(m_allocator)
+	, m_transformed_events(m_allocator)
 	, m_entity_created(m_allocator)
 	, m_first_free_slot(-1)
 	, m_scenes(m_allocator)
 	, m_hierarchy(m_allocator)
 	, m_transforms(m_allocator)
+	, m_positions(m_allocator)
+	, m_scales(m_allocator)
 	, m_name("")
+	, m_dirty_transforms(m_allocator)
+	, m_moved(m_allocator)
+	, m_transform_stamps(m_allocator)
+	, m_component_stamps(m_allocator)
+	, m_name_index(m_allocator)
 {
 	m_entities.reserve(RESERVED_ENTITIES_COUNT);
 	m_transforms.reserve(RESERVED_ENTITIES_COUNT);
+	m_positions.reserve(RESERVED_ENTITIES_COUNT);
+	m_scales.reserve(RESERVED_ENTITIES_COUNT);
 	memset(m_component_type_map, 0, sizeof(m_component_type_map));
 }
 
@@ -117,9 +135,30 @@ const Quat& Universe::getRotation(EntityRef entity) const
 
 
 void Universe::transformEntity(EntityRef entity, bool update_local)
+{
+	if (m_transforms_deferred) {
+		markTransformDirty(entity, update_local ? WORLD : LOCAL);
+		return;
+	}
+
+	if (m_notify_depth > 0) {
+		// an observer moved an entity, m_moved is still being notified
+		Array<EntityRef> moved(m_allocator);
+		propagateTransform(entity, update_local, moved);
+		notifyMoved(moved);
+		return;
+	}
+
+	m_moved.clear();
+	propagateTransform(entity, update_local, m_moved);
+	notifyMoved(m_moved);
+}
+
+
+void Universe::propagateTransform(EntityRef entity, bool update_local, Array<EntityRef>& moved)
 {
 	const int hierarchy_idx = m_entities[entity.index].hierarchy;
-	m_entity_moved.invoke(entity);
+	moved.push(entity);
 	if (hierarchy_idx >= 0) {
 		Hierarchy& h = m_hierarchy[hierarchy_idx];
 		const Transform my_transform = getTransform(entity);
@@ -135,7 +174,7 @@ void Universe::transformEntity(EntityRef entity, bool update_local)
 			const Transform abs_tr = my_transform * child_h.local_transform;
 			Transform& child_data = m_transforms[child.index];
 			child_data = abs_tr;
-			transformEntity((EntityRef)child, false);
+			propagateTransform((EntityRef)child, false, moved);
 
 			child = child_h.next_sibling;
 		}
@@ -143,6 +182,108 @@ void Universe::transformEntity(EntityRef entity, bool update_local)
 }
 
 
+void Universe::notifyMoved(Span<const EntityRef> entities)
+{
+	for (EntityRef e : entities) {
+		const Transform& tr = m_transforms[e.index];
+		m_positions[e.index] = tr.pos;
+		m_scales[e.index] = tr.scale;
+	}
+
+	if (m_track_changes) {
+		if (m_transform_stamps.size() < m_entities.size()) {
+			const u32 old_size = m_transform_stamps.size();
+			m_transform_stamps.resize(m_entities.size());
+			memset(m_transform_stamps.begin() + old_size, 0, (m_entities.size() - old_size) * sizeof(u32));
+		}
+		for (EntityRef e : entities) m_transform_stamps[e.index] = m_change_stamp;
+	}
+
+	++m_notify_depth;
+	for (EntityRef e : entities) m_entity_moved.invoke(e);
+	m_entities_moved.invoke(entities);
+	--m_notify_depth;
+	m_transformed_events.push(entities);
+}
+
+
+void Universe::markTransformDirty(EntityRef entity, DirtyTransform dirty)
+{
+	EntityData& data = m_entities[entity.index];
+	if (data.dirty_transform == NONE) m_dirty_transforms.push(entity);
+	// the last write wins
+	data.dirty_transform = dirty;
+}
+
+
+bool Universe::hasDirtyAncestor(EntityRef entity) const
+{
+	for (EntityPtr e = getParent(entity); e.isValid(); e = getParent((EntityRef)e)) {
+		if (m_entities[e.index].dirty_transform != NONE) return true;
+	}
+	return false;
+}
+
+
+void Universe::flushTransform(EntityRef entity, Array<EntityRef>& moved)
+{
+	EntityData& data = m_entities[entity.index];
+	const int hierarchy_idx = data.hierarchy;
+	if (hierarchy_idx >= 0) {
+		Hierarchy& h = m_hierarchy[hierarchy_idx];
+		if (h.parent.isValid()) {
+			// parent is already flushed, it's visited first
+			const Transform& parent_tr = m_transforms[h.parent.index];
+			if (data.dirty_transform == WORLD) h.local_transform = parent_tr.inverted() * m_transforms[entity.index];
+			else m_transforms[entity.index] = parent_tr * h.local_transform;
+		}
+	}
+	data.dirty_transform = NONE;
+	moved.push(entity);
+
+	if (hierarchy_idx < 0) return;
+	EntityPtr child = m_hierarchy[hierarchy_idx].first_child;
+	while (child.isValid()) {
+		flushTransform((EntityRef)child, moved);
+		child = m_hierarchy[m_entities[child.index].hierarchy].next_sibling;
+	}
+}
+
+
+void Universe::flushTransforms()
+{
+	if (m_dirty_transforms.empty()) return;
+	PROFILE_FUNCTION();
+
+	// subtrees of dirty entities without a dirty ancestor do not overlap
+	Array<EntityRef> roots(m_allocator);
+	for (EntityRef e : m_dirty_transforms) {
+		if (!hasDirtyAncestor(e)) roots.push(e);
+	}
+	m_dirty_transforms.clear();
+
+	Array<EntityRef> moved(m_allocator);
+	Mutex mutex;
+	jobs::forEach(roots.size(), 64, [&](i32 from, i32 to){
+		Array<EntityRef> tmp(m_allocator);
+		for (i32 i = from; i < to; ++i) flushTransform(roots[i], tmp);
+		MutexGuard lock(mutex);
+		const u32 offset = moved.size();
+		moved.resize(offset + tmp.size());
+		memcpy(moved.begin() + offset, tmp.begin(), tmp.byte_size());
+	});
+
+	notifyMoved(moved);
+}
+
+
+void Universe::setTransformsDeferred(bool deferred)
+{
+	m_transforms_deferred = deferred;
+	if (!deferred) flushTransforms();
+}
+
+
 void Universe::setRotation(EntityRef entity, const Quat& rot)
 {
 	m_transforms[entity.index].rot = rot;
@@ -165,11 +306,12 @@ bool Universe::hasEntity(EntityRef entity) const
 
 void Universe::setTransformKeepChildren(EntityRef entity, const Transform& transform)
 {
+	flushTransforms();
 	Transform& tmp = m_transforms[entity.index];
 	tmp = transform;
 	
 	int hierarchy_idx = m_entities[entity.index].hierarchy;
-	entityTransformed().invoke(entity);
+	notifyMoved(Span(&entity, 1));
 	if (hierarchy_idx >= 0)
 	{
 		Hierarchy& h = m_hierarchy[hierarchy_idx];
@@ -242,6 +384,60 @@ void Universe::setPosition(EntityRef entity, const DVec3& pos)
 }
 
 
+static u64 getNameIndexKey(EntityPtr parent, const char* name)
+{
+	return RuntimeHash(name).getHashValue() ^ (u64(u32(parent.index)) * 0x9E3779B97F4A7C15);
+}
+
+
+void Universe::buildNameIndex()
+{
+	m_name_index.clear();
+	for (const EntityName& name : m_names) addToNameIndex(name.entity);
+	m_name_index_valid = true;
+}
+
+
+void Universe::addToNameIndex(EntityRef entity)
+{
+	EntityName& name = m_names[m_entities[entity.index].name];
+	const u64 key = getNameIndexKey(getParent(entity), name.name);
+	auto iter = m_name_index.find(key);
+	if (iter.isValid()) {
+		name.next_in_index = iter.value();
+		iter.value() = entity;
+	}
+	else {
+		name.next_in_index = INVALID_ENTITY;
+		m_name_index.insert(key, entity);
+	}
+}
+
+
+void Universe::removeFromNameIndex(EntityRef entity)
+{
+	const EntityName& name = m_names[m_entities[entity.index].name];
+	auto iter = m_name_index.find(getNameIndexKey(getParent(entity), name.name));
+	ASSERT(iter.isValid());
+	
+	if (iter.value() == entity) {
+		if (name.next_in_index.isValid()) iter.value() = (EntityRef)name.next_in_index;
+		else m_name_index.erase(iter);
+		return;
+	}
+
+	EntityName* prev = &m_names[m_entities[iter.value().index].name];
+	while (prev->next_in_index.isValid()) {
+		if (prev->next_in_index == entity) {
+			prev->next_in_index = name.next_in_index;
+			return;
+		}
+		prev = &m_names[m_entities[prev->next_in_index.index].name];
+	}
+	ASSERT(false);
+}
+
+
 void Universe::setEntityName(EntityRef entity, const char* name)
 {
 	int name_idx = m_entities[entity.index].name;
@@ -255,8 +451,10 @@ void Universe::setEntityName(EntityRef entity, const char* name)
 	}
 	else
 	{
+		if (m_name_index_valid) removeFromNameIndex(entity);
 		copyString(m_names[name_idx].name, name);
 	}
+	if (m_name_index_valid) addToNameIndex(entity);
 }
 
 
@@ -270,29 +468,16 @@ const char* Universe::getEntityName(EntityRef entity) const
 
 EntityPtr Universe::findByName(EntityPtr parent, const char* name)
 {
-	if (parent.isValid()) {
-		int h_idx = m_entities[parent.index].hierarchy;
-		if (h_idx < 0) return INVALID_ENTITY;
+	if (!m_name_index_valid) buildNameIndex();
 
-		EntityPtr e = m_hierarchy[h_idx].first_child;
-		while (e.isValid()) {
-			const EntityData& data = m_entities[e.index];
-			int name_idx = data.name;
-			if (name_idx >= 0) {
-				if (equalStrings(m_names[name_idx].name, name)) return e;
-			}
-			e = m_hierarchy[data.hierarchy].next_sibling;
-		}
-	}
-	else
-	{
-		for (int i = 0, c = m_names.size(); i < c; ++i) {
-			if (equalStrings(m_names[i].name, name)) {
-				const EntityData& data = m_entities[m_names[i].entity.index];
-				if (data.hierarchy < 0) return m_names[i].entity;
-				if (!m_hierarchy[data.hierarchy].parent.isValid()) return m_names[i].entity;
-			}
-		}
+	auto iter = m_name_index.find(getNameIndexKey(parent, name));
+	if (!iter.isValid()) return INVALID_ENTITY;
+
+	// chain contains all entities with colliding keys
+	for (EntityPtr e = iter.value(); e.isValid();) {
+		const EntityName& n = m_names[m_entities[e.index].name];
+		if (equalStrings(n.name, name) && getParent((EntityRef)e) == parent) return e;
+		e = n.next_in_index;
 	}
 
 	return INVALID_ENTITY;
@@ -305,7 +490,10 @@ void Universe::emplaceEntity(EntityRef entity)
 	{
 		EntityData& data = m_entities.emplace();
 		Transform& tr = m_transforms.emplace();
+		m_positions.emplace();
+		m_scales.push(-1);
 		data.valid = false;
+		data.dirty_transform = NONE;
 		data.prev = -1;
 		data.name = -1;
 		data.hierarchy = -1;
@@ -334,10 +522,13 @@ void Universe::emplaceEntity(EntityRef entity)
 	tr.pos = DVec3(0, 0, 0);
 	tr.rot.set(0, 0, 0, 1);
 	tr.scale = 1;
+	m_positions[entity.index] = tr.pos;
+	m_scales[entity.index] = tr.scale;
 	data.name = -1;
 	data.hierarchy = -1;
 	data.components = 0;
 	data.valid = true;
+	data.dirty_transform = NONE;
 
 	m_entity_created.invoke(entity);
 }
@@ -361,20 +552,56 @@ EntityRef Universe::createEntity(const DVec3& position, const Quat& rotation)
 		entity.index = m_entities.size();
 		data = &m_entities.emplace();
 		tr = &m_transforms.emplace();
+		m_positions.emplace();
+		m_scales.emplace();
 	}
 	tr->pos = position;
 	tr->rot = rotation;
 	tr->scale = 1;
+	m_positions[entity.index] = position;
+	m_scales[entity.index] = 1;
 	data->name = -1;
 	data->hierarchy = -1;
 	data->components = 0;
 	data->valid = true;
+	data->dirty_transform = NONE;
 	m_entity_created.invoke(entity);
 
 	return entity;
 }
 
 
+void Universe::createEntities(Span<const Transform> transforms, Span<EntityRef> entities)
+{
+	ASSERT(transforms.length() == entities.length());
+	
+	// free slots are reused first
+	u32 free_count = 0;
+	for (i32 i = m_first_free_slot; i >= 0 && free_count < transforms.length(); i = m_entities[i].next) ++free_count;
+	const u32 size = m_entities.size() + transforms.length() - free_count;
+	m_entities.reserve(size);
+	m_transforms.reserve(size);
+	m_positions.reserve(size);
+	m_scales.reserve(size);
+
+	for (u32 i = 0, c = transforms.length(); i < c; ++i) {
+		const Transform& tr = transforms[i];
+		const EntityRef e = createEntity(tr.pos, tr.rot);
+		m_transforms[e.index].scale = tr.scale;
+		m_scales[e.index] = tr.scale;
+		entities[i] = e;
+	}
+}
+
+
+void Universe::destroyEntities(Span<const EntityRef> entities)
+{
+	// so setParent in destroyEntity does not have to
+	flushTransforms();
+	for (EntityRef e : entities) destroyEntity(e);
+}
+
+
 void Universe::destroyEntity(EntityRef entity)
 {
 	EntityData& entity_data = m_entities[entity.index];
@@ -398,6 +625,11 @@ void Universe::destroyEntity(EntityRef entity)
 		}
 	}
 
+	if (entity_data.dirty_transform != NONE) {
+		m_dirty_transforms.swapAndPopItem(entity);
+		entity_data.dirty_transform = NONE;
+	}
+
 	entity_data.next = m_first_free_slot;
 	entity_data.prev = -1;
 	entity_data.hierarchy = -1;
@@ -410,6 +642,7 @@ void Universe::destroyEntity(EntityRef entity)
 
 	if (entity_data.name >= 0)
 	{
+		if (m_name_index_valid) removeFromNameIndex(entity);
 		m_entities[m_names.back().entity.index].name = entity_data.name;
 		m_names.swapAndPop(entity_data.name);
 		entity_data.name = -1;
@@ -483,6 +716,11 @@ void Universe::setParent(EntityPtr new_parent, EntityRef child)
 		logError("Hierarchy can not contains a cycle.");
 		return;
 	}
+	// local transform is computed from world transforms
+	flushTransforms();
+	// key contains the parent
+	const bool reindex_name = m_name_index_valid && m_entities[child.index].name >= 0;
+	if (reindex_name) removeFromNameIndex(child);
 
 	auto collectGarbage = [this](EntityRef entity) {
 		Hierarchy& h = m_hierarchy[m_entities[entity.index].hierarchy];
@@ -557,6 +795,7 @@ void Universe::setParent(EntityPtr new_parent, EntityRef child)
 	{
 		if (child_idx >= 0) collectGarbage(child);
 	}
+	if (reindex_name) addToNameIndex(child);
 }
 
 
@@ -581,6 +820,10 @@ void Universe::setLocalPosition(EntityRef entity, const DVec3& pos)
 	}
 
 	m_hierarchy[hierarchy_idx].local_transform.pos = pos;
+	if (m_transforms_deferred) {
+		markTransformDirty(entity, LOCAL);
+		return;
+	}
 	updateGlobalTransform(entity);
 }
 
@@ -594,6 +837,10 @@ void Universe::setLocalRotation(EntityRef entity, const Quat& rot)
 		return;
 	}
 	m_hierarchy[hierarchy_idx].local_transform.rot = rot;
+	if (m_transforms_deferred) {
+		markTransformDirty(entity, LOCAL);
+		return;
+	}
 	updateGlobalTransform(entity);
 }
 
@@ -609,6 +856,10 @@ void Universe::setLocalTransform(EntityRef entity, const Transform& transform)
 
 	Hierarchy& h = m_hierarchy[hierarchy_idx];
 	h.local_transform = transform;
+	if (m_transforms_deferred) {
+		markTransformDirty(entity, LOCAL);
+		return;
+	}
 	updateGlobalTransform(entity);
 }
 
@@ -639,15 +890,12 @@ float Universe::getLocalScale(EntityRef entity) const
 
 void Universe::serialize(OutputMemoryStream& serializer)
 {
+	// dense, so it can be copied as is when loaded to an empty universe
 	serializer.write((u32)m_entities.size());
-
-	for (u32 i = 0, c = m_entities.size(); i < c; ++i) {
-		if (!m_entities[i].valid) continue;
-		const EntityRef e = {(i32)i};
-		serializer.write(e);
-		serializer.write(m_transforms[i]);
+	for (const EntityData& data : m_entities) {
+		serializer.write(u8(data.valid ? 1 : 0));
 	}
-	serializer.write(INVALID_ENTITY);
+	if (!m_transforms.empty()) serializer.write(m_transforms.begin(), m_transforms.byte_size());
 
 	serializer.write((u32)m_names.size());
 	for (const EntityName& name : m_names) {
@@ -663,21 +911,84 @@ void Universe::setName(const char* name) {
 	copyString(m_name, name);
 }
 
-void Universe::deserialize(InputMemoryStream& serializer, EntityMap& entity_map)
+void Universe::deserialize(InputMemoryStream& serializer, EntityMap& entity_map, bool dense)
 {
+	// names and hierarchy are read directly, index is rebuilt by next findByName
+	m_name_index_valid = false;
+	m_name_index.clear();
+
 	u32 to_reserve;
 	serializer.read(to_reserve);
 	entity_map.reserve(to_reserve);
 
-	for (EntityPtr e = serializer.read<EntityPtr>(); e.isValid(); e = serializer.read<EntityPtr>()) {
-		EntityRef orig = (EntityRef)e;
-		const EntityRef new_e = createEntity({0, 0, 0}, {0, 0, 0, 1});
-		entity_map.set(orig, new_e);
-		serializer.read(m_transforms[new_e.index]);
+	if (!dense) {
+		for (EntityPtr e = serializer.read<EntityPtr>(); e.isValid(); e = serializer.read<EntityPtr>()) {
+			EntityRef orig = (EntityRef)e;
+			const EntityRef new_e = createEntity({0, 0, 0}, {0, 0, 0, 1});
+			entity_map.set(orig, new_e);
+			Transform& tr = m_transforms[new_e.index];
+			serializer.read(tr);
+			m_positions[new_e.index] = tr.pos;
+			m_scales[new_e.index] = tr.scale;
+		}
+	}
+	else if (m_entities.empty()) {
+		// entities keep their indices, so arrays are copied as they are
+		const u8* valid = (const u8*)serializer.skip(to_reserve);
+		m_entities.resize(to_reserve);
+		m_transforms.resize(to_reserve);
+		m_positions.resize(to_reserve);
+		m_scales.resize(to_reserve);
+		if (to_reserve > 0) serializer.read(m_transforms.begin(), m_transforms.byte_size());
+
+		m_first_free_slot = -1;
+		for (u32 i = 0; i < to_reserve; ++i) {
+			EntityData& data = m_entities[i];
+			data.name = -1;
+			data.hierarchy = -1;
+			data.dirty_transform = NONE;
+			data.valid = valid[i] != 0;
+			m_positions[i] = m_transforms[i].pos;
+			m_scales[i] = m_transforms[i].scale;
+			if (data.valid) {
+				data.components = 0;
+				entity_map.set(EntityRef{(i32)i}, EntityRef{(i32)i});
+				continue;
+			}
+			data.prev = -1;
+			data.next = m_first_free_slot;
+			if (m_first_free_slot >= 0) m_entities[m_first_free_slot].prev = i;
+			m_first_free_slot = i;
+		}
+
+		for (u32 i = 0; i < to_reserve; ++i) {
+			if (m_entities[i].valid) m_entity_created.invoke(EntityRef{(i32)i});
+		}
+	}
+	else {
+		const u8* valid = (const u8*)serializer.skip(to_reserve);
+		const Transform* transforms = (const Transform*)serializer.skip(to_reserve * sizeof(Transform));
+		Array<Transform> to_create(m_allocator);
+		Array<EntityRef> src_entities(m_allocator);
+		to_create.reserve(to_reserve);
+		src_entities.reserve(to_reserve);
+		for (u32 i = 0; i < to_reserve; ++i) {
+			if (!valid[i]) continue;
+			to_create.push(transforms[i]);
+			src_entities.push(EntityRef{(i32)i});
+		}
+
+		Array<EntityRef> created(m_allocator);
+		created.resize(to_create.size());
+		createEntities(to_create, created);
+		for (i32 i = 0, c = created.size(); i < c; ++i) {
+			entity_map.set(src_entities[i], created[i]);
+		}
 	}
 
 	u32 count;
 	serializer.read(count);
+	m_names.reserve(m_names.size() + count);
 	for (u32 i = 0; i < count; ++i) {
 		EntityName& name = m_names.emplace();
 		serializer.read(name.entity);
@@ -746,6 +1057,38 @@ ComponentUID Universe::getNextComponent(const ComponentUID& cmp) const
 }
 
 
+bool Universe::getComponentChunks(ComponentType type, Span<const ComponentType> with, u32 max_chunk_size, Array<ComponentChunk>& chunks) const
+{
+	ASSERT(max_chunk_size > 0);
+	IScene* scene = m_component_type_map[type.index].scene;
+	if (!scene) return false;
+	
+	ComponentChunk all;
+	if (!scene->getComponentChunk(type, all)) return false;
+
+	u64 mask = 0;
+	for (ComponentType t : with) mask |= u64(1) << t.index;
+	
+	// runs of matching entities are contiguous in the scene's storage
+	u8* data = (u8*)all.data;
+	u32 i = 0;
+	while (i < all.count) {
+		while (i < all.count && (m_entities[all.entities[i].index].components & mask) != mask) ++i;
+		if (i == all.count) break;
+
+		const u32 from = i;
+		while (i < all.count && i - from < max_chunk_size && (m_entities[all.entities[i].index].components & mask) == mask) ++i;
+		
+		ComponentChunk& chunk = chunks.emplace();
+		chunk.entities = all.entities + from;
+		chunk.data = data + from * all.stride;
+		chunk.stride = all.stride;
+		chunk.count = i - from;
+	}
+	return true;
+}
+
+
 ComponentUID Universe::getComponent(EntityRef entity, ComponentType component_type) const
 {
 	u64 mask = m_entities[entity.index].components;
@@ -775,6 +1118,7 @@ void Universe::onComponentDestroyed(EntityRef entity, ComponentType component_ty
 	mask &= ~((u64)1 << component_type.index);
 	ASSERT(old_mask != mask);
 	m_entities[entity.index].components = mask;
+	if (m_track_changes) m_component_stamps.erase(((u64)entity.index << 8) | (u64)component_type.index);
 	m_component_destroyed.invoke(ComponentUID(entity, component_type, scene));
 }
 
@@ -787,6 +1131,14 @@ void Universe::createComponent(ComponentType type, EntityRef entity)
 }
 
 
+void Universe::createComponents(ComponentType type, Span<const EntityRef> entities)
+{
+	IScene* scene = m_component_type_map[type.index].scene;
+	auto create_method = m_component_type_map[type.index].create;
+	for (EntityRef e : entities) create_method(scene, e);
+}
+
+
 void Universe::destroyComponent(EntityRef entity, ComponentType type)
 {
 	IScene* scene = m_component_type_map[type.index].scene;
@@ -795,8 +1147,34 @@ void Universe::destroyComponent(EntityRef entity, ComponentType type)
 }
 
 
+void Universe::beginDeferredComponents(Span<IScene* const> scenes) {
+	ASSERT(m_deferred_components.empty());
+	// not reallocated later, workers push to their items
+	m_deferred_components.reserve(scenes.length());
+	for (IScene* scene : scenes) {
+		m_deferred_components.emplace(m_allocator).scene = scene;
+	}
+}
+
+void Universe::endDeferredComponents() {
+	PROFILE_FUNCTION();
+	const Array<DeferredComponents> deferred(m_deferred_components.move());
+	for (const DeferredComponents& components : deferred) {
+		for (u32 i = 0, c = components.entities.size(); i < c; ++i) {
+			onComponentCreated(components.entities[i], components.types[i], components.scene);
+		}
+	}
+}
+
 void Universe::onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene)
 {
+	for (DeferredComponents& deferred : m_deferred_components) {
+		if (deferred.scene != scene) continue;
+		deferred.entities.push(entity);
+		deferred.types.push(component_type);
+		return;
+	}
+
 	ComponentUID cmp(entity, component_type, scene);
 	m_entities[entity.index].components |= (u64)1 << component_type.index;
 	m_component_added.invoke(cmp);
@@ -837,4 +1215,280 @@ ChildrenRange::Iterator ChildrenRange::end() const {
 	return iter;
 }
 
+static constexpr double POSITION_QUANTIZATION = 1024;
+// bits per component of the smallest three quaternion components
+static constexpr u32 QUAT_BITS = 10;
+
+namespace {
+
+struct DeltaWriteVisitor : reflection::IPropertyVisitor {
+	DeltaWriteVisitor(OutputMemoryStream& blob, ComponentUID cmp, IAllocator& allocator)
+		: blob(blob)
+		, cmp(cmp)
+		, allocator(allocator)
+	{}
+
+	template <typename T>
+	void write(const reflection::Property<T>& prop) {
+		if (prop.isReadonly()) return;
+		blob.write(prop.get(cmp, idx));
+	}
+
+	void visit(const reflection::Property<float>& prop) override { write(prop); }
+	void visit(const reflection::Property<int>& prop) override { write(prop); }
+	void visit(const reflection::Property<u32>& prop) override { write(prop); }
+	void visit(const reflection::Property<EntityPtr>& prop) override { write(prop); }
+	void visit(const reflection::Property<Vec2>& prop) override { write(prop); }
+	void visit(const reflection::Property<Vec3>& prop) override { write(prop); }
+	void visit(const reflection::Property<IVec3>& prop) override { write(prop); }
+	void visit(const reflection::Property<Vec4>& prop) override { write(prop); }
+	void visit(const reflection::Property<bool>& prop) override { write(prop); }
+
+	void visit(const reflection::Property<Path>& prop) override {
+		if (prop.isReadonly()) return;
+		blob.writeString(prop.get(cmp, idx).c_str());
+	}
+
+	void visit(const reflection::Property<const char*>& prop) override {
+		if (prop.isReadonly()) return;
+		blob.writeString(prop.get(cmp, idx));
+	}
+
+	void visit(const reflection::BlobProperty& prop) override {
+		// size prefixed, so the reader does not depend on the setter reading everything
+		OutputMemoryStream tmp(allocator);
+		prop.getValue(cmp, idx, tmp);
+		blob.write((u32)tmp.size());
+		blob.write(tmp.data(), tmp.size());
+	}
+
+	void visit(const reflection::DynamicProperties& prop) override {
+		const u32 c = prop.getCount(cmp, idx);
+		blob.write(c);
+		for (u32 i = 0; i < c; ++i) {
+			blob.writeString(prop.getName(cmp, idx, i));
+			const reflection::DynamicProperties::Type type = prop.getType(cmp, idx, i);
+			blob.write(type);
+			const reflection::DynamicProperties::Value v = prop.getValue(cmp, idx, i);
+			switch (type) {
+				case reflection::DynamicProperties::RESOURCE:
+				case reflection::DynamicProperties::STRING: blob.writeString(v.s); break;
+				default: blob.write(v); break;
+			}
+		}
+	}
+
+	void visit(const reflection::ArrayProperty& prop) override {
+		const u32 count = prop.getCount(cmp);
+		blob.write(count);
+		const u32 idx_backup = idx;
+		for (u32 i = 0; i < count; ++i) {
+			idx = i;
+			prop.visitChildren(*this);
+		}
+		idx = idx_backup;
+	}
+
+	OutputMemoryStream& blob;
+	ComponentUID cmp;
+	IAllocator& allocator;
+	u32 idx = -1;
+};
+
+struct DeltaReadVisitor : reflection::IPropertyVisitor {
+	DeltaReadVisitor(InputMemoryStream& blob, ComponentUID cmp, const EntityMap& entity_map)
+		: blob(blob)
+		, cmp(cmp)
+		, entity_map(entity_map)
+	{}
+
+	template <typename T>
+	void read(const reflection::Property<T>& prop) {
+		if (prop.isReadonly()) return;
+		prop.set(cmp, idx, blob.read<T>());
+	}
+
+	void visit(const reflection::Property<float>& prop) override { read(prop); }
+	void visit(const reflection::Property<int>& prop) override { read(prop); }
+	void visit(const reflection::Property<u32>& prop) override { read(prop); }
+	void visit(const reflection::Property<Vec2>& prop) override { read(prop); }
+	void visit(const reflection::Property<Vec3>& prop) override { read(prop); }
+	void visit(const reflection::Property<IVec3>& prop) override { read(prop); }
+	void visit(const reflection::Property<Vec4>& prop) override { read(prop); }
+	void visit(const reflection::Property<bool>& prop) override { read(prop); }
+
+	void visit(const reflection::Property<EntityPtr>& prop) override {
+		if (prop.isReadonly()) return;
+		prop.set(cmp, idx, entity_map.get(blob.read<EntityPtr>()));
+	}
+
+	void visit(const reflection::Property<Path>& prop) override {
+		if (prop.isReadonly()) return;
+		prop.set(cmp, idx, Path(blob.readString()));
+	}
+
+	void visit(const reflection::Property<const char*>& prop) override {
+		if (prop.isReadonly()) return;
+		prop.set(cmp, idx, blob.readString());
+	}
+
+	void visit(const reflection::BlobProperty& prop) override {
+		const u32 size = blob.read<u32>();
+		InputMemoryStream tmp(blob.skip(size), size);
+		prop.setValue(cmp, idx, tmp);
+	}
+
+	void visit(const reflection::DynamicProperties& prop) override {
+		const u32 c = blob.read<u32>();
+		for (u32 i = 0; i < c; ++i) {
+			const char* name = blob.readString();
+			reflection::DynamicProperties::Type type;
+			blob.read(type);
+			reflection::DynamicProperties::Value v;
+			switch (type) {
+				case reflection::DynamicProperties::RESOURCE:
+				case reflection::DynamicProperties::STRING: v.s = blob.readString(); break;
+				default: blob.read(v); break;
+			}
+			prop.set(cmp, idx, name, type, v);
+		}
+	}
+
+	void visit(const reflection::ArrayProperty& prop) override {
+		const u32 count = blob.read<u32>();
+		while (prop.getCount(cmp) > count) prop.removeItem(cmp, prop.getCount(cmp) - 1);
+		while (prop.getCount(cmp) < count) prop.addItem(cmp, -1);
+		const u32 idx_backup = idx;
+		for (u32 i = 0; i < count; ++i) {
+			idx = i;
+			prop.visitChildren(*this);
+		}
+		idx = idx_backup;
+	}
+
+	InputMemoryStream& blob;
+	ComponentUID cmp;
+	const EntityMap& entity_map;
+	u32 idx = -1;
+};
+
+} // anonymous namespace
+
+
+void Universe::setChangeTracking(bool enable)
+{
+	m_track_changes = enable;
+	if (!enable) {
+		m_transform_stamps.clear();
+		m_component_stamps.clear();
+	}
+}
+
+
+u32 Universe::advanceChangeStamp()
+{
+	const u32 baseline = m_change_stamp;
+	++m_change_stamp;
+	return baseline;
+}
+
+
+void Universe::markComponentChanged(EntityRef entity, ComponentType type)
+{
+	if (!m_track_changes) return;
+	const u64 key = ((u64)entity.index << 8) | (u64)type.index;
+	auto iter = m_component_stamps.find(key);
+	if (iter.isValid()) iter.value() = m_change_stamp;
+	else m_component_stamps.insert(key, m_change_stamp);
+}
+
+
+void Universe::serializeDelta(OutputMemoryStream& serializer, u32 baseline)
+{
+	ASSERT(m_track_changes);
+	PROFILE_FUNCTION();
+
+	const u64 count_offset = serializer.size();
+	u32 count = 0;
+	serializer.write(count);
+	// entities are sorted, so only the gap from the previous one is written
+	u32 prev_entity = 0;
+	for (u32 i = 0, c = m_transform_stamps.size(); i < c; ++i) {
+		if (m_transform_stamps[i] <= baseline || !m_entities[i].valid) continue;
+		const Transform& tr = m_transforms[i];
+		serializer.writeVarint(i - prev_entity);
+		prev_entity = i;
+		serializer.writeZigzag(i64(tr.pos.x * POSITION_QUANTIZATION + (tr.pos.x < 0 ? -0.5 : 0.5)));
+		serializer.writeZigzag(i64(tr.pos.y * POSITION_QUANTIZATION + (tr.pos.y < 0 ? -0.5 : 0.5)));
+		serializer.writeZigzag(i64(tr.pos.z * POSITION_QUANTIZATION + (tr.pos.z < 0 ? -0.5 : 0.5)));
+		BitWriter bits(serializer);
+		bits.writeQuat(tr.rot, QUAT_BITS);
+		bits.flush();
+		serializer.write(tr.scale);
+		++count;
+	}
+	memcpy(serializer.getMutableData() + count_offset, &count, sizeof(count));
+
+	const u64 cmp_count_offset = serializer.size();
+	count = 0;
+	serializer.write(count);
+	for (auto iter = m_component_stamps.begin(), end = m_component_stamps.end(); iter != end; ++iter) {
+		if (iter.value() <= baseline) continue;
+		const EntityRef e = {i32(iter.key() >> 8)};
+		const ComponentType type = {i32(iter.key() & 0xff)};
+		if (!hasEntity(e) || !hasComponent(e, type)) continue;
+
+		serializer.writeVarint(e.index);
+		serializer.write((u8)type.index);
+		const u64 size_offset = serializer.size();
+		serializer.write(u32(0));
+		DeltaWriteVisitor visitor(serializer, ComponentUID(e, type, m_component_type_map[type.index].scene), m_allocator);
+		reflection::getComponent(type)->visit(visitor);
+		const u32 size = u32(serializer.size() - size_offset - sizeof(u32));
+		memcpy(serializer.getMutableData() + size_offset, &size, sizeof(size));
+		++count;
+	}
+	memcpy(serializer.getMutableData() + cmp_count_offset, &count, sizeof(count));
+}
+
+
+void Universe::deserializeDelta(InputMemoryStream& serializer, const EntityMap& entity_map)
+{
+	PROFILE_FUNCTION();
+	u32 count;
+	serializer.read(count);
+	EntityRef e = {0};
+	for (u32 i = 0; i < count; ++i) {
+		e.index += (i32)serializer.readVarint();
+		DVec3 p;
+		p.x = serializer.readZigzag() / POSITION_QUANTIZATION;
+		p.y = serializer.readZigzag() / POSITION_QUANTIZATION;
+		p.z = serializer.readZigzag() / POSITION_QUANTIZATION;
+		BitReader bits(serializer);
+		const Quat rot = bits.readQuat(QUAT_BITS);
+		float scale;
+		serializer.read(scale);
+		const EntityPtr local = entity_map.get((EntityPtr)e);
+		if (!local.isValid()) continue;
+		setTransform((EntityRef)local, p, rot, scale);
+	}
+
+	serializer.read(count);
+	for (u32 i = 0; i < count; ++i) {
+		const EntityRef e = {(i32)serializer.readVarint()};
+		u8 type_idx;
+		u32 size;
+		serializer.read(type_idx);
+		serializer.read(size);
+		InputMemoryStream blob(serializer.skip(size), size);
+		const EntityPtr local = entity_map.get((EntityPtr)e);
+		const ComponentType type = {type_idx};
+		if (!local.isValid() || !hasComponent((EntityRef)local, type)) continue;
+
+		DeltaReadVisitor visitor(blob, ComponentUID(local, type, m_component_type_map[type.index].scene), entity_map);
+		reflection::getComponent(type)->visit(visitor);
+	}
+}
+
+
 } // namespace Lumix
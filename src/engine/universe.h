@@ -3,6 +3,7 @@
 
 #include "engine/array.h"
 #include "engine/delegate_list.h"
+#include "engine/hash_map.h"
 #include "engine/lumix.h"
 #include "engine/math.h"
 
@@ -74,6 +75,8 @@ struct LUMIX_ENGINE_API Universe {
 			};
 		};
 		bool valid;
+		// DirtyTransform
+		u8 dirty_transform;
 	};
 
 	explicit Universe(struct Engine& engine, IAllocator& allocator);
@@ -81,18 +84,33 @@ struct LUMIX_ENGINE_API Universe {
 
 	IAllocator& getAllocator() { return m_allocator; }
 	const Transform* getTransforms() const { return m_transforms.begin(); }
+	// same as getTransforms()[i].pos and .scale, as separate streams for bulk readers
+	// updated when entitiesTransformed() is called, so while deferred, they are stale until flush
+	Span<const DVec3> getPositions() const { return m_positions; }
+	Span<const float> getScales() const { return m_scales; }
 	void emplaceEntity(EntityRef entity);
 	EntityRef createEntity(const DVec3& position, const Quat& rotation);
 	void destroyEntity(EntityRef entity);
+	// arrays are grown once for all entities, entities[i] is created with transforms[i]
+	void createEntities(Span<const Transform> transforms, Span<EntityRef> entities);
+	void destroyEntities(Span<const EntityRef> entities);
 	void createComponent(ComponentType type, EntityRef entity);
+	void createComponents(ComponentType type, Span<const EntityRef> entities);
 	void destroyComponent(EntityRef entity, ComponentType type);
 	void onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene);
+	// components created by `scenes` are only queued, so the scenes can create them on job workers
+	void beginDeferredComponents(Span<IScene* const> scenes);
+	// adds queued components and notifies observers, scene by scene
+	void endDeferredComponents();
 	void onComponentDestroyed(EntityRef entity, ComponentType component_type, IScene* scene);
     u64 getComponentsMask(EntityRef entity) const;
     bool hasComponent(EntityRef entity, ComponentType component_type) const;
 	ComponentUID getComponent(EntityRef entity, ComponentType type) const;
 	ComponentUID getFirstComponent(EntityRef entity) const;
 	ComponentUID getNextComponent(const ComponentUID& cmp) const;
+	// splits the dense storage of `type` to chunks of at most max_chunk_size entities, which also have all components in `with`
+	// returns false if the scene of `type` does not store it densely, see IScene::getComponentChunk
+	bool getComponentChunks(ComponentType type, Span<const ComponentType> with, u32 max_chunk_size, Array<struct ComponentChunk>& chunks) const;
 
 	bool isValid(EntityRef e) const { return m_entities[e.index].valid; }
 	EntityPtr getFirstEntity() const;
@@ -131,14 +149,37 @@ struct LUMIX_ENGINE_API Universe {
 	const char* getName() const { return m_name; }
 	void setName(const char* name);
 
+	// while deferred, transform setters only mark entities, children and observers are updated in flushTransforms
+	// so transforms of descendants of a moved entity are stale until then
+	void setTransformsDeferred(bool deferred);
+	bool areTransformsDeferred() const { return m_transforms_deferred; }
+	// propagates marked entities to their descendants, independent subtrees in parallel
+	void flushTransforms();
+
+	// tracks which transforms and reflected properties changed, for serializeDelta
+	void setChangeTracking(bool enable);
+	bool isTrackingChanges() const { return m_track_changes; }
+	// changes made after this call are newer than the returned stamp, pass it to serializeDelta as baseline
+	u32 advanceChangeStamp();
+	void markComponentChanged(EntityRef entity, ComponentType type);
+	// only transforms and properties changed after baseline, quantized
+	// entities and components must already exist on the receiving side
+	void serializeDelta(struct OutputMemoryStream& serializer, u32 baseline);
+	void deserializeDelta(struct InputMemoryStream& serializer, const EntityMap& entity_map);
+
 	DelegateList<void(EntityRef)>& entityCreated() { return m_entity_created; }
 	DelegateList<void(EntityRef)>& entityTransformed() { return m_entity_moved; }
+	// all entities moved by a single setter or flush, including descendants
+	DelegateList<void(Span<const EntityRef>)>& entitiesTransformed() { return m_entities_moved; }
+	// same entities as entitiesTransformed(), buffered for readers processing them in their update
+	EventChannel<EntityRef>& transformedEvents() { return m_transformed_events; }
 	DelegateList<void(EntityRef)>& entityDestroyed() { return m_entity_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentDestroyed() { return m_component_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentAdded() { return m_component_added; }
 
 	void serialize(struct OutputMemoryStream& serializer);
-	void deserialize(struct InputMemoryStream& serializer, EntityMap& entity_map);
+	// dense = false for data serialized before entities were stored densely
+	void deserialize(struct InputMemoryStream& serializer, EntityMap& entity_map, bool dense);
 
 	IScene* getScene(ComponentType type) const;
 	IScene* getScene(const char* name) const;
@@ -146,7 +187,23 @@ struct LUMIX_ENGINE_API Universe {
 	void addScene(UniquePtr<IScene>&& scene);
 
 private:
+	enum DirtyTransform : u8 {
+		NONE,
+		// world transform was set, local transform is recomputed
+		WORLD,
+		// local transform was set, world transform is recomputed
+		LOCAL
+	};
+
 	void transformEntity(EntityRef entity, bool update_local);
+	void propagateTransform(EntityRef entity, bool update_local, Array<EntityRef>& moved);
+	void flushTransform(EntityRef entity, Array<EntityRef>& moved);
+	void markTransformDirty(EntityRef entity, DirtyTransform dirty);
+	bool hasDirtyAncestor(EntityRef entity) const;
+	void notifyMoved(Span<const EntityRef> entities);
+	void buildNameIndex();
+	void addToNameIndex(EntityRef entity);
+	void removeFromNameIndex(EntityRef entity);
 	void updateGlobalTransform(EntityRef entity);
 
 	struct Hierarchy {
@@ -161,6 +218,15 @@ private:
 	struct EntityName {
 		EntityRef entity;
 		char name[ENTITY_NAME_MAX_LENGTH];
+		// next entity with the same key in m_name_index
+		EntityPtr next_in_index;
+	};
+
+	struct DeferredComponents {
+		explicit DeferredComponents(IAllocator& allocator) : entities(allocator), types(allocator) {}
+		IScene* scene;
+		Array<EntityRef> entities;
+		Array<ComponentType> types;
 	};
 
 	struct ComponentTypeEntry {
@@ -174,16 +240,37 @@ private:
 	ComponentTypeEntry m_component_type_map[ComponentType::MAX_TYPES_COUNT];
 	Array<UniquePtr<IScene>> m_scenes;
 	Array<Transform> m_transforms;
+	Array<DVec3> m_positions;
+	Array<float> m_scales;
 	Array<EntityData> m_entities;
 	Array<Hierarchy> m_hierarchy;
 	Array<EntityName> m_names;
 	DelegateList<void(EntityRef)> m_entity_created;
 	DelegateList<void(EntityRef)> m_entity_moved;
+	DelegateList<void(Span<const EntityRef>)> m_entities_moved;
+	EventChannel<EntityRef> m_transformed_events;
 	DelegateList<void(EntityRef)> m_entity_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_added;
+	// each is written only by the worker deserializing its scene
+	Array<DeferredComponents> m_deferred_components;
 	int m_first_free_slot;
 	char m_name[64];
+	bool m_transforms_deferred = false;
+	Array<EntityRef> m_dirty_transforms;
+	// reused by transform setters, unless an observer moves entities while being notified
+	Array<EntityRef> m_moved;
+	u32 m_notify_depth = 0;
+	bool m_track_changes = false;
+	u32 m_change_stamp = 1;
+	// per entity, stamp of the last transform change
+	Array<u32> m_transform_stamps;
+	// key is entity index << 8 | component type index
+	HashMap<u64, u32> m_component_stamps;
+	// key is hash of (parent, name), value is the first entity of a chain linked by EntityName::next_in_index
+	// built by the first findByName, kept up to date after that
+	HashMap<u64, EntityRef> m_name_index;
+	bool m_name_index_valid = false;
 };
 
 struct LUMIX_ENGINE_API ComponentUID final {
@@ -24,6 +24,11 @@ i32 atomicAdd(i32 volatile* addend, i32 value)
 	return _InterlockedExchangeAdd((volatile long*)addend, value);
 }
 
+i64 atomicAdd(i64 volatile* addend, i64 value)
+{
+	return _InterlockedExchangeAdd64((volatile long long*)addend, value);
+}
+
 i32 atomicSubtract(i32 volatile* addend, i32 value)
 {
 	return _InterlockedExchangeAdd((volatile long*)addend, -value);
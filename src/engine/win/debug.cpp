@@ -820,6 +820,7 @@ static LONG WINAPI unhandledExceptionHandler(LPEXCEPTION_POINTERS info)
 	StaticString<4096> message;
 	getStack(*info->ContextRecord, Span(message.data));
 	logError(message);
+	flushLog();
 
 	return EXCEPTION_CONTINUE_SEARCH;
 }
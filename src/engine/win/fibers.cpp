@@ -17,9 +17,10 @@ void initThread(FiberProc proc, Handle* out)
 }
 
 
+// only reserve the stack, pages are committed on demand behind the OS guard page
 Handle create(int stack_size, FiberProc proc, void* parameter)
 {
-	return CreateFiber(stack_size, proc, parameter);
+	return CreateFiberEx(0, stack_size, 0, proc, parameter);
 }
 
 
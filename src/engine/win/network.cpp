@@ -0,0 +1,133 @@
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "engine/os.h"
+#include "engine/string.h"
+
+
+#pragma comment(lib, "Ws2_32.lib")
+
+
+namespace Lumix::os {
+
+
+static bool initWinsock() {
+	static bool initialized = [](){
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return initialized;
+}
+
+
+Socket::Socket() : m_handle((uintptr)INVALID_SOCKET) {}
+
+
+Socket::~Socket() { close(); }
+
+
+bool Socket::isOpen() const { return m_handle != (uintptr)INVALID_SOCKET; }
+
+
+void Socket::close() {
+	if (m_handle == (uintptr)INVALID_SOCKET) return;
+	closesocket((SOCKET)m_handle);
+	m_handle = (uintptr)INVALID_SOCKET;
+}
+
+
+bool Socket::listen(u16 port) {
+	close();
+	if (!initWinsock()) return false;
+
+	const SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) return false;
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(s, 1) != 0) {
+		closesocket(s);
+		return false;
+	}
+	u_long non_blocking = 1;
+	ioctlsocket(s, FIONBIO, &non_blocking);
+	m_handle = (uintptr)s;
+	return true;
+}
+
+
+bool Socket::accept(Socket& client) {
+	if (m_handle == (uintptr)INVALID_SOCKET) return false;
+	const SOCKET s = ::accept((SOCKET)m_handle, nullptr, nullptr);
+	if (s == INVALID_SOCKET) return false;
+
+	// accepted sockets inherit non blocking mode
+	u_long non_blocking = 0;
+	ioctlsocket(s, FIONBIO, &non_blocking);
+	BOOL nodelay = TRUE;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+	client.close();
+	client.m_handle = (uintptr)s;
+	return true;
+}
+
+
+bool Socket::connect(const char* host, u16 port) {
+	close();
+	if (!initWinsock()) return false;
+
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	addrinfo* result;
+	char port_str[8];
+	toCString(port, Span(port_str));
+	if (getaddrinfo(host, port_str, &hints, &result) != 0) return false;
+
+	const SOCKET s = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	if (s == INVALID_SOCKET || ::connect(s, result->ai_addr, (int)result->ai_addrlen) != 0) {
+		if (s != INVALID_SOCKET) closesocket(s);
+		freeaddrinfo(result);
+		return false;
+	}
+	freeaddrinfo(result);
+	m_handle = (uintptr)s;
+	return true;
+}
+
+
+bool Socket::send(const void* data, u32 size) {
+	if (m_handle == (uintptr)INVALID_SOCKET) return false;
+	const char* ptr = (const char*)data;
+	while (size > 0) {
+		const int sent = ::send((SOCKET)m_handle, ptr, (int)size, 0);
+		if (sent <= 0) return false;
+		ptr += sent;
+		size -= (u32)sent;
+	}
+	return true;
+}
+
+
+i32 Socket::receive(void* data, u32 size) {
+	if (m_handle == (uintptr)INVALID_SOCKET) return -1;
+
+	fd_set set;
+	FD_ZERO(&set);
+	FD_SET((SOCKET)m_handle, &set);
+	timeval timeout = {};
+	const int ready = select(0, &set, nullptr, nullptr, &timeout);
+	if (ready == 0) return 0;
+	if (ready < 0) return -1;
+
+	// readable with nothing to read means the connection is closed
+	const int received = recv((SOCKET)m_handle, (char*)data, (int)size, 0);
+	return received > 0 ? received : -1;
+}
+
+
+} // namespace Lumix::os
@@ -247,6 +247,44 @@ u32 getCPUsCount() {
 	return num;
 }
 
+// only processor group 0 is used, the same as affinity masks
+u32 getCPUTopology(Span<CPUInfo> cpus) {
+	const u32 count = minimum(getCPUsCount(), 64u);
+	for (u32 i = 0; i < minimum(count, cpus.length()); ++i) cpus[i] = {};
+
+	DWORD size = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+	if (size == 0) return count;
+
+	DefaultAllocator allocator;
+	u8* buffer = (u8*)allocator.allocate(size);
+	if (GetLogicalProcessorInformationEx(RelationAll, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)buffer, &size)) {
+		for (DWORD offset = 0; offset < size;) {
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+			offset += info->Size;
+
+			KAFFINITY mask = 0;
+			if (info->Relationship == RelationProcessorCore && info->Processor.GroupMask[0].Group == 0) {
+				mask = info->Processor.GroupMask[0].Mask;
+			}
+			else if (info->Relationship == RelationNumaNode && info->NumaNode.GroupMask.Group == 0) {
+				mask = info->NumaNode.GroupMask.Mask;
+			}
+			for (u32 i = 0; i < minimum(count, cpus.length()); ++i) {
+				if ((mask & ((KAFFINITY)1 << i)) == 0) continue;
+				if (info->Relationship == RelationProcessorCore) {
+					cpus[i].efficiency_class = info->Processor.EfficiencyClass;
+				}
+				else {
+					cpus[i].numa_node = (u8)info->NumaNode.NodeNumber;
+				}
+			}
+		}
+	}
+	allocator.deallocate(buffer);
+	return count;
+}
+
 void logInfo() {
 	DWORD dwVersion = 0;
 	DWORD dwMajorVersion = 0;
@@ -630,8 +668,10 @@ WindowHandle createWindow(const InitWindowArgs& args) {
 		DragAcceptFiles(hwnd, TRUE);
 	}
 
-	ShowWindow(hwnd, SW_SHOW);
-	UpdateWindow(hwnd);
+	if (!(args.flags & InitWindowArgs::HIDDEN)) {
+		ShowWindow(hwnd, SW_SHOW);
+		UpdateWindow(hwnd);
+	}
 
 	if (!G.raw_input_registered) {
 		RAWINPUTDEVICE device;
@@ -887,6 +927,22 @@ void memRelease(void* ptr, size_t size) {
 	VirtualFree(ptr, 0, MEM_RELEASE);
 }
 
+void memDecommit(void* ptr, size_t size) {
+	VirtualFree(ptr, size, MEM_DECOMMIT);
+}
+
+size_t getLargeMemPageSize() {
+	return GetLargePageMinimum();
+}
+
+void* memReserveLargePages(size_t size) {
+	const size_t large_page_size = getLargeMemPageSize();
+	if (large_page_size == 0) return nullptr;
+	ASSERT(size % large_page_size == 0);
+	// fails without SeLockMemoryPrivilege
+	return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
 struct FileIterator
 {
 	HANDLE handle;
@@ -1177,6 +1233,38 @@ size_t getFileSize(const char* path)
 }
 
 
+const void* mapFile(const char* path, u64& size)
+{
+	const WCharStr<LUMIX_MAX_PATH> wpath(path);
+	HANDLE file = CreateFile(wpath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) return nullptr;
+
+	// view keeps the mapping alive
+	const void* mem = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!mem) return nullptr;
+
+	size = file_size.QuadPart;
+	return mem;
+}
+
+
+void unmapFile(const void* ptr, u64 size)
+{
+	UnmapViewOfFile(ptr);
+}
+
+
 bool fileExists(const char* path)
 {
 	const WCharStr<LUMIX_MAX_PATH> wpath(path);
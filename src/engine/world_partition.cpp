@@ -0,0 +1,297 @@
+#include "engine/array.h"
+#include "engine/engine.h"
+#include "engine/file_system.h"
+#include "engine/hash_map.h"
+#include "engine/log.h"
+#include "engine/math.h"
+#include "engine/os.h"
+#include "engine/path.h"
+#include "engine/profiler.h"
+#include "engine/stream.h"
+#include "engine/universe.h"
+#include "engine/world_partition.h"
+
+
+namespace Lumix
+{
+
+
+struct Sector {
+	enum class State : u8 {
+		UNLOADED,
+		LOADING,
+		LOADED, // data are in memory, waiting to be instantiated
+		INSTANTIATED,
+		UNLOADING, // entities are being destroyed
+		FAILED
+	};
+
+	explicit Sector(IAllocator& allocator)
+		: data(allocator)
+		, entities(allocator)
+	{}
+
+	void fileLoaded(u64 size, const u8* mem, bool success);
+
+	Path path;
+	DVec3 min;
+	DVec3 max;
+	State state = State::UNLOADED;
+	bool wanted = false;
+	FileSystem::AsyncHandle async_op = FileSystem::AsyncHandle::invalid();
+	OutputMemoryStream data;
+	Array<EntityRef> entities;
+};
+
+
+struct WorldPartitionImpl final : WorldPartition {
+	// entities destroyed between two checks of the frame budget
+	static constexpr u32 DESTROY_BATCH_SIZE = 64;
+
+	WorldPartitionImpl(Engine& engine, Universe& universe, IAllocator& allocator)
+		: m_engine(engine)
+		, m_universe(universe)
+		, m_allocator(allocator)
+		, m_sectors(allocator)
+		, m_sources(allocator)
+		, m_entity_sector(allocator)
+	{
+		m_universe.entityDestroyed().bind<&WorldPartitionImpl::onEntityDestroyed>(this);
+		m_loaded_counter = profiler::createCounter("Loaded sectors", 0);
+	}
+
+	~WorldPartitionImpl() {
+		m_universe.entityDestroyed().unbind<&WorldPartitionImpl::onEntityDestroyed>(this);
+		FileSystem& fs = m_engine.getFileSystem();
+		for (Sector& sector : m_sectors) {
+			if (sector.async_op.isValid()) fs.cancel(sector.async_op);
+		}
+	}
+
+	bool load(InputMemoryStream& blob) override {
+		ASSERT(m_sectors.empty());
+		WorldPartitionHeader header;
+		blob.read(header);
+		if (header.magic != WorldPartitionHeader::MAGIC) {
+			logError("Wrong or corrupted world partition file");
+			return false;
+		}
+		if ((u32)header.version > (u32)WorldPartitionHeader::Version::LATEST) {
+			logError("Unsupported world partition version");
+			return false;
+		}
+
+		const u32 count = blob.read<u32>();
+		// sectors are referenced by pending file system callbacks, the array must not grow later
+		m_sectors.reserve(count);
+		for (u32 i = 0; i < count; ++i) {
+			Sector& sector = m_sectors.emplace(m_allocator);
+			blob.read(sector.min);
+			blob.read(sector.max);
+			sector.path = blob.readString();
+		}
+
+		EntityMap entity_map(m_allocator);
+		return m_engine.deserialize(m_universe, blob, entity_map);
+	}
+
+	void setStreamingDistance(float load_distance, float unload_distance) override {
+		m_load_distance = load_distance;
+		m_unload_distance = maximum(load_distance, unload_distance);
+	}
+
+	void setFrameBudget(float ms) override { m_frame_budget = ms; }
+
+	void addSource(EntityRef e) override {
+		if (m_sources.indexOf(e) < 0) m_sources.push(e);
+	}
+
+	void removeSource(EntityRef e) override { m_sources.eraseItem(e); }
+
+	u32 getSectorsCount() const override { return m_sectors.size(); }
+
+	u32 getLoadedSectorsCount() const override {
+		u32 res = 0;
+		for (const Sector& sector : m_sectors) {
+			if (sector.state == Sector::State::INSTANTIATED) ++res;
+		}
+		return res;
+	}
+
+	void onEntityDestroyed(EntityRef e) {
+		m_sources.eraseItem(e);
+		// entity of an instantiated sector destroyed by the game
+		auto iter = m_entity_sector.find(e);
+		if (!iter.isValid()) return;
+		m_sectors[iter.value()].entities.swapAndPopItem(e);
+		m_entity_sector.erase(iter);
+	}
+
+	static double squaredDistance(const DVec3& p, const Sector& sector) {
+		const DVec3 clamped = minimum(maximum(p, sector.min), sector.max);
+		return squaredLength(p - clamped);
+	}
+
+	void updateWanted() {
+		const double load_dist2 = (double)m_load_distance * m_load_distance;
+		const double unload_dist2 = (double)m_unload_distance * m_unload_distance;
+		for (Sector& sector : m_sectors) {
+			const bool is_resident = sector.state != Sector::State::UNLOADED && sector.state != Sector::State::UNLOADING;
+			const double dist2 = is_resident ? unload_dist2 : load_dist2;
+			sector.wanted = false;
+			for (EntityRef src : m_sources) {
+				if (squaredDistance(m_universe.getPosition(src), sector) < dist2) {
+					sector.wanted = true;
+					break;
+				}
+			}
+		}
+	}
+
+	void instantiate(Sector& sector) {
+		PROFILE_BLOCK("instantiate sector");
+		EntityMap entity_map(m_allocator);
+		InputMemoryStream blob(sector.data);
+		const bool success = m_engine.deserialize(m_universe, blob, entity_map);
+		sector.data.free();
+
+		const u32 sector_idx = u32(&sector - m_sectors.begin());
+		for (EntityPtr e : entity_map.m_map) {
+			if (!e.isValid()) continue;
+			sector.entities.push((EntityRef)e);
+			m_entity_sector.insert((EntityRef)e, sector_idx);
+		}
+
+		if (!success) {
+			logError("Failed to deserialize ", sector.path);
+			while (!sector.entities.empty()) destroyBatch(sector);
+			sector.state = Sector::State::FAILED;
+			return;
+		}
+		sector.state = Sector::State::INSTANTIATED;
+	}
+
+	void destroyBatch(Sector& sector) {
+		PROFILE_BLOCK("destroy sector entities");
+		EntityRef batch[DESTROY_BATCH_SIZE];
+		const u32 count = minimum(DESTROY_BATCH_SIZE, sector.entities.size());
+		for (u32 i = 0; i < count; ++i) {
+			batch[i] = sector.entities.back();
+			sector.entities.pop();
+			m_entity_sector.erase(batch[i]);
+		}
+		m_universe.destroyEntities(Span(batch, count));
+		if (sector.entities.empty()) sector.state = Sector::State::UNLOADED;
+	}
+
+	// returns false if there is nothing to load or unload
+	bool stream(float budget_ms) {
+		FileSystem& fs = m_engine.getFileSystem();
+		bool has_work = false;
+		for (Sector& sector : m_sectors) {
+			switch (sector.state) {
+				case Sector::State::UNLOADED:
+					if (sector.wanted) {
+						sector.state = Sector::State::LOADING;
+						sector.async_op = fs.getContent(sector.path, makeDelegate<&Sector::fileLoaded>(&sector));
+						has_work = true;
+					}
+					break;
+				case Sector::State::LOADING:
+					if (!sector.wanted) {
+						fs.cancel(sector.async_op);
+						sector.async_op = FileSystem::AsyncHandle::invalid();
+						sector.state = Sector::State::UNLOADED;
+					}
+					else {
+						has_work = true;
+					}
+					break;
+				case Sector::State::LOADED:
+					if (!sector.wanted) {
+						sector.data.free();
+						sector.state = Sector::State::UNLOADED;
+					}
+					else {
+						has_work = true;
+					}
+					break;
+				case Sector::State::INSTANTIATED:
+					if (!sector.wanted) {
+						sector.state = Sector::State::UNLOADING;
+						has_work = true;
+					}
+					break;
+				case Sector::State::UNLOADING: has_work = true; break;
+				case Sector::State::FAILED: break;
+			}
+		}
+
+		// destroy first, so memory is released before new sectors are created
+		os::Timer timer;
+		bool first = true;
+		for (Sector& sector : m_sectors) {
+			while (sector.state == Sector::State::UNLOADING) {
+				if (!first && timer.getTimeSinceStart() * 1000 > budget_ms) return has_work;
+				first = false;
+				destroyBatch(sector);
+			}
+		}
+		for (Sector& sector : m_sectors) {
+			if (sector.state != Sector::State::LOADED) continue;
+			if (!first && timer.getTimeSinceStart() * 1000 > budget_ms) return has_work;
+			first = false;
+			instantiate(sector);
+		}
+		return has_work;
+	}
+
+	void update() override {
+		PROFILE_FUNCTION();
+		updateWanted();
+		stream(m_frame_budget);
+		profiler::pushCounter(m_loaded_counter, (float)getLoadedSectorsCount());
+	}
+
+	void flush() override {
+		PROFILE_FUNCTION();
+		FileSystem& fs = m_engine.getFileSystem();
+		updateWanted();
+		while (stream(FLT_MAX)) {
+			if (fs.hasWork()) os::sleep(1);
+			fs.processCallbacks();
+		}
+	}
+
+	Engine& m_engine;
+	Universe& m_universe;
+	IAllocator& m_allocator;
+	Array<Sector> m_sectors;
+	Array<EntityRef> m_sources;
+	HashMap<EntityRef, u32> m_entity_sector;
+	float m_load_distance = 200;
+	float m_unload_distance = 250;
+	float m_frame_budget = 2;
+	u32 m_loaded_counter;
+};
+
+
+void Sector::fileLoaded(u64 size, const u8* mem, bool success) {
+	ASSERT(state == State::LOADING);
+	async_op = FileSystem::AsyncHandle::invalid();
+	if (!success) {
+		logError("Failed to load sector ", path);
+		state = State::FAILED;
+		return;
+	}
+	data.write(mem, size);
+	state = State::LOADED;
+}
+
+
+UniquePtr<WorldPartition> WorldPartition::create(Engine& engine, Universe& universe, IAllocator& allocator) {
+	return UniquePtr<WorldPartitionImpl>::create(allocator, engine, universe, allocator);
+}
+
+
+} // namespace Lumix
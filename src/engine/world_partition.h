@@ -0,0 +1,51 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+template <typename T> struct UniquePtr;
+
+
+// written by the editor next to the universe file (universes/<name>.lwp), see WorldEditor::saveUniverse
+// WorldPartitionHeader, u32 sector count, sectors (min, max, path), persistent entities (Engine::serialize)
+// sector files contain Engine::serialize of entities in the sector
+struct WorldPartitionHeader {
+	static constexpr u32 MAGIC = '_LWP';
+	enum class Version : u32 {
+		FIRST,
+
+		LATEST
+	};
+
+	u32 magic = MAGIC;
+	Version version = Version::LATEST;
+};
+
+
+// loads sectors of a universe around streaming sources (cameras, players) and unloads them when the sources leave
+struct LUMIX_ENGINE_API WorldPartition {
+	static UniquePtr<WorldPartition> create(struct Engine& engine, struct Universe& universe, struct IAllocator& allocator);
+
+	virtual ~WorldPartition() {}
+	// reads sector table and deserializes persistent entities
+	virtual bool load(struct InputMemoryStream& blob) = 0;
+	// sectors closer than `load_distance` to any source are loaded, those farther than `unload_distance` from all sources are unloaded
+	virtual void setStreamingDistance(float load_distance, float unload_distance) = 0;
+	// max time spent creating and destroying entities in a single update, at least one sector is processed per update
+	virtual void setFrameBudget(float ms) = 0;
+	virtual void addSource(EntityRef e) = 0;
+	virtual void removeSource(EntityRef e) = 0;
+	virtual void update() = 0;
+	// blocks until all sectors around sources are loaded, e.g. before the game starts
+	virtual void flush() = 0;
+	virtual u32 getSectorsCount() const = 0;
+	virtual u32 getLoadedSectorsCount() const = 0;
+};
+
+
+} // namespace Lumix
@@ -51,6 +51,8 @@ struct SpritePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	bool canCreateResource() const override { return true; }
 	const char* getDefaultExtension() const override { return "spr"; }
 
@@ -126,6 +128,8 @@ struct SpritePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 				break;
 			case Sprite::Type::SIMPLE: break;
 		}
+		ImGuiEx::Label("Atlas");
+		changed = ImGui::Checkbox("##atlas", &sprite->atlas) || changed;
 		return changed;
 	}
 
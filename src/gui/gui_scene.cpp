@@ -6,6 +6,7 @@
 #include "engine/input_system.h"
 #include "engine/log.h"
 #include "engine/os.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/string.h"
@@ -158,8 +159,31 @@ struct GUISceneImpl final : GUIScene
 {
 	enum class Version : i32 {
 		CANVAS_3D,
+		CANVAS_VIRTUAL_SIZE,
 		LATEST
 	};
+
+	// draw data of a retained canvas
+	struct CanvasCache {
+		CanvasCache(IAllocator& allocator) : draw(allocator) {}
+
+		Draw2D draw;
+		Vec2 size = Vec2(-1);
+		u32 atlas_version = 0;
+		u32 sprite_atlas_version = 0;
+		bool dirty = true;
+		bool is_main = false;
+		// hovered buttons depend on cursor position
+		bool has_buttons = false;
+		// text cursor of the focused input field blinks
+		bool has_focus = false;
+		// some font or sprite is not loaded yet
+		bool is_incomplete = false;
+		IVec2 cursor_pos;
+		bool cursor_set = false;
+		os::CursorType cursor_type = os::CursorType::DEFAULT;
+	};
+
 	GUISceneImpl(GUISystem& system, Universe& context, IAllocator& allocator)
 		: m_allocator(allocator)
 		, m_universe(context)
@@ -167,6 +191,7 @@ struct GUISceneImpl final : GUIScene
 		, m_rects(allocator)
 		, m_buttons(allocator)
 		, m_canvas(allocator)
+		, m_canvas_cache(allocator)
 		, m_rect_hovered(allocator)
 		, m_draw_2d(allocator)
 		, m_rect_hovered_out(allocator)
@@ -185,6 +210,7 @@ struct GUISceneImpl final : GUIScene
 	{
 		if (!rect.input_field) return;
 		if (m_focused_entity != rect.entity) return;
+		if (m_recorded_cache) m_recorded_cache->has_focus = true;
 		if (rect.input_field->anim > CURSOR_BLINK_PERIOD * 0.5f) return;
 
 		const char* text = rect.text->text.c_str();
@@ -212,6 +238,14 @@ struct GUISceneImpl final : GUIScene
 		auto button_iter = m_buttons.find(rect.entity);
 		const Color* img_color = rect.image ? (Color*)&rect.image->color : nullptr;
 		const Color* txt_color = rect.text ? (Color*)&rect.text->color : nullptr;
+		if (m_recorded_cache) {
+			if (button_iter.isValid()) m_recorded_cache->has_buttons = true;
+			if (rect.text && !rect.text->getFont()) m_recorded_cache->is_incomplete = true;
+			if (rect.image && rect.image->sprite) {
+				Texture* tex = rect.image->sprite->getTexture();
+				if (!rect.image->sprite->isReady() || !tex || !tex->isReady()) m_recorded_cache->is_incomplete = true;
+			}
+		}
 		if (is_main && button_iter.isValid()) {
 			GUIButton& button = button_iter.value();
 			if (m_cursor_pos.x >= l && m_cursor_pos.x <= r && m_cursor_pos.y >= t && m_cursor_pos.y <= b) {
@@ -231,6 +265,13 @@ struct GUISceneImpl final : GUIScene
 			{
 				Sprite* sprite = rect.image->sprite;
 				Texture* tex = sprite->getTexture();
+				gpu::TextureHandle* tex_handle = &tex->handle;
+				Vec2 uv0(0), uv1(1);
+				if (m_system.getSpriteAtlas().pack(*sprite)) {
+					tex_handle = sprite->atlas_texture;
+					uv0 = sprite->atlas_uv0;
+					uv1 = sprite->atlas_uv1;
+				}
 				if (sprite->type == Sprite::PATCH9)
 				{
 					struct Quad {
@@ -247,28 +288,19 @@ struct GUISceneImpl final : GUIScene
 					if (pos.t > pos.b) {
 						pos.t = pos.b = (pos.t + pos.b) * 0.5f;
 					}
+					const Vec2 uv_size = uv1 - uv0;
 					Quad uvs = {
-						sprite->left / (float)tex->width,
-						sprite->top / (float)tex->height,
-						sprite->right / (float)tex->width,
-						sprite->bottom / (float)tex->height
+						uv0.x + uv_size.x * sprite->left / (float)tex->width,
+						uv0.y + uv_size.y * sprite->top / (float)tex->height,
+						uv0.x + uv_size.x * sprite->right / (float)tex->width,
+						uv0.y + uv_size.y * sprite->bottom / (float)tex->height
 					};
 
-					draw.addImage(&tex->handle, { l, t }, { pos.l, pos.t }, { 0, 0 }, { uvs.l, uvs.t }, color);
-					draw.addImage(&tex->handle, { pos.l, t }, { pos.r, pos.t }, { uvs.l, 0 }, { uvs.r, uvs.t }, color);
-					draw.addImage(&tex->handle, { pos.r, t }, { r, pos.t }, { uvs.r, 0 }, { 1, uvs.t }, color);
-
-					draw.addImage(&tex->handle, { l, pos.t }, { pos.l, pos.b }, { 0, uvs.t }, { uvs.l, uvs.b }, color);
-					draw.addImage(&tex->handle, { pos.l, pos.t }, { pos.r, pos.b }, { uvs.l, uvs.t }, { uvs.r, uvs.b }, color);
-					draw.addImage(&tex->handle, { pos.r, pos.t }, { r, pos.b }, { uvs.r, uvs.t }, { 1, uvs.b }, color);
-
-					draw.addImage(&tex->handle, { l, pos.b }, { pos.l, b }, { 0, uvs.b }, { uvs.l, 1 }, color);
-					draw.addImage(&tex->handle, { pos.l, pos.b }, { pos.r, b }, { uvs.l, uvs.b }, { uvs.r, 1 }, color);
-					draw.addImage(&tex->handle, { pos.r, pos.b }, { r, b }, { uvs.r, uvs.b }, { 1, 1 }, color);
+					draw.addImage9Slice(tex_handle, { l, t }, { r, b }, { pos.l, pos.t }, { pos.r, pos.b }, uv0, uv1, { uvs.l, uvs.t }, { uvs.r, uvs.b }, color);
 				}
 				else
 				{
-					draw.addImage(&tex->handle, { l, t }, { r, b }, {0, 0}, {1, 1}, color);
+					draw.addImage(tex_handle, { l, t }, { r, b }, uv0, uv1, color);
 				}
 			}
 			else
@@ -318,17 +350,79 @@ struct GUISceneImpl final : GUIScene
 
 	IVec2 getCursorPosition() override { return m_cursor_pos; }
 
-	void draw3D(GUICanvas& canvas, Pipeline& pipeline) {
-		m_draw_2d.clear({2, 2});
+	void draw3D(GUICanvas& canvas, Draw2D& draw) {
+		draw.clear({2, 2});
 
 		for (EntityRef child : m_universe.childrenOf(canvas.entity)) {
 			auto iter = m_rects.find(child);
 			if (iter.isValid()) {
-				renderRect(*iter.value(), m_draw_2d, { 0, 0, canvas.virtual_size.x, canvas.virtual_size.y }, false);
+				renderRect(*iter.value(), draw, { 0, 0, canvas.virtual_size.x, canvas.virtual_size.y }, false);
 			}
 		}
+	}
 
-		pipeline.render3DUI(canvas.entity, m_draw_2d, canvas.virtual_size, canvas.orient_to_camera);
+	CanvasCache& getCanvasCache(EntityRef canvas) {
+		auto iter = m_canvas_cache.find(canvas);
+		if (iter.isValid()) return *iter.value();
+		return *m_canvas_cache.insert(canvas, UniquePtr<CanvasCache>::create(m_allocator, m_allocator)).value();
+	}
+
+	bool isCacheValid(const CanvasCache& cache, const Vec2& size, bool is_main) const {
+		if (cache.dirty || cache.is_incomplete || cache.has_focus) return false;
+		if (cache.size.x != size.x || cache.size.y != size.y) return false;
+		if (cache.is_main != is_main) return false;
+		if (cache.atlas_version != m_font_manager->getAtlasVersion()) return false;
+		if (cache.sprite_atlas_version != m_system.getSpriteAtlas().getVersion()) return false;
+		if (is_main && cache.has_buttons && cache.cursor_pos != m_cursor_pos) return false;
+		return true;
+	}
+
+	// rebuilds draw data of the canvas if anything changed since the last time
+	const CanvasCache& updateCanvasCache(GUICanvas& canvas, const Vec2& size, Vec2 atlas_size, bool is_main) {
+		CanvasCache& cache = getCanvasCache(canvas.entity);
+		if (isCacheValid(cache, size, is_main)) return cache;
+
+		PROFILE_BLOCK("rebuild retained canvas");
+		cache.dirty = false;
+		cache.size = size;
+		cache.is_main = is_main;
+		cache.atlas_version = m_font_manager->getAtlasVersion();
+		cache.sprite_atlas_version = m_system.getSpriteAtlas().getVersion();
+		cache.cursor_pos = m_cursor_pos;
+		cache.has_buttons = false;
+		cache.has_focus = false;
+		cache.is_incomplete = false;
+
+		// cursor type is recorded only for this canvas, so it can be replayed when the cache is used
+		const bool prev_cursor_set = m_cursor_set;
+		const os::CursorType prev_cursor_type = m_cursor_type;
+		m_cursor_set = false;
+		m_recorded_cache = &cache;
+		if (canvas.is_3d) {
+			draw3D(canvas, cache.draw);
+		}
+		else {
+			cache.draw.clear(atlas_size);
+			auto iter = m_rects.find(canvas.entity);
+			if (iter.isValid()) renderRect(*iter.value(), cache.draw, {0, 0, size.x, size.y}, is_main);
+		}
+		m_recorded_cache = nullptr;
+		cache.cursor_set = m_cursor_set;
+		cache.cursor_type = m_cursor_type;
+		m_cursor_set = prev_cursor_set;
+		m_cursor_type = prev_cursor_type;
+		return cache;
+	}
+
+	void invalidate(EntityRef entity) override {
+		for (EntityPtr e = entity; e.isValid(); e = m_universe.getParent((EntityRef)e)) {
+			auto iter = m_canvas_cache.find((EntityRef)e);
+			if (iter.isValid()) iter.value()->dirty = true;
+		}
+	}
+
+	void invalidate(EntityPtr entity) {
+		if (entity.isValid()) invalidate((EntityRef)entity);
 	}
 
 	void render(Pipeline& pipeline, const Vec2& canvas_size, bool is_main) override {
@@ -337,15 +431,31 @@ struct GUISceneImpl final : GUIScene
 			m_cursor_type = os::CursorType::DEFAULT;
 			m_cursor_set = false;
 		}
+		Draw2D& draw = pipeline.getDraw2D();
 		for (GUICanvas& canvas : m_canvas) {
-			if (canvas.is_3d) {
-				draw3D(canvas, pipeline);
+			if (canvas.is_retained) {
+				const Vec2 size = canvas.is_3d ? canvas.virtual_size : canvas_size;
+				const CanvasCache& cache = updateCanvasCache(canvas, size, draw.getAtlasSize(), is_main);
+				if (is_main && cache.cursor_set && !m_cursor_set) {
+					m_cursor_type = cache.cursor_type;
+					m_cursor_set = true;
+				}
+				if (canvas.is_3d) {
+					pipeline.render3DUI(canvas.entity, cache.draw, canvas.virtual_size, canvas.orient_to_camera);
+				}
+				else {
+					draw.append(cache.draw);
+				}
+			}
+			else if (canvas.is_3d) {
+				draw3D(canvas, m_draw_2d);
+				pipeline.render3DUI(canvas.entity, m_draw_2d, canvas.virtual_size, canvas.orient_to_camera);
 			}
 			else {
 				auto iter = m_rects.find(canvas.entity);
 				if (iter.isValid()) {
 					GUIRect* r = iter.value();
-					renderRect(*r, pipeline.getDraw2D(), {0, 0, canvas_size.x, canvas_size.y}, is_main);
+					renderRect(*r, draw, {0, 0, canvas_size.x, canvas_size.y}, is_main);
 				}
 			}
 		}
@@ -360,6 +470,7 @@ struct GUISceneImpl final : GUIScene
 	void setButtonHoveredColorRGBA(EntityRef entity, const Vec4& color) override
 	{
 		m_buttons[entity].hovered_color = RGBAVec4ToABGRu32(color);
+		invalidate(entity);
 	}
 
 	os::CursorType getButtonHoveredCursor(EntityRef entity) override {
@@ -370,7 +481,7 @@ struct GUISceneImpl final : GUIScene
 		m_buttons[entity].hovered_cursor = cursor;
 	}
 
-	void enableImage(EntityRef entity, bool enable) override { m_rects[entity]->image->flags.set(GUIImage::IS_ENABLED, enable); }
+	void enableImage(EntityRef entity, bool enable) override { m_rects[entity]->image->flags.set(GUIImage::IS_ENABLED, enable); invalidate(entity); }
 	bool isImageEnabled(EntityRef entity) override { return m_rects[entity]->image->flags.isSet(GUIImage::IS_ENABLED); }
 
 
@@ -409,7 +520,9 @@ struct GUISceneImpl final : GUIScene
 		return image->sprite ? image->sprite->getPath() : Path();
 	}
 
+	// caller can change the canvas through the reference
 	GUICanvas& getCanvas(EntityRef entity) override {
+		invalidate(entity);
 		return m_canvas[entity];
 	}
 
@@ -426,6 +539,7 @@ struct GUISceneImpl final : GUIScene
 		} else {
 			image->sprite = manager.load<Sprite>(path);
 		}
+		invalidate(entity);
 	}
 
 
@@ -433,6 +547,7 @@ struct GUISceneImpl final : GUIScene
 	{
 		GUIImage* image = m_rects[entity]->image;
 		image->color = RGBAVec4ToABGRu32(color);
+		invalidate(entity);
 	}
 
 
@@ -529,34 +644,35 @@ struct GUISceneImpl final : GUIScene
 		return { l, t, r - l, b - t };
 	}
 
-	void setRectClip(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_CLIP, enable); }
+	void setRectClip(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_CLIP, enable); invalidate(entity); }
 	bool getRectClip(EntityRef entity) override { return m_rects[entity]->flags.isSet(GUIRect::IS_CLIP); }
-	void enableRect(EntityRef entity, bool enable) override { return m_rects[entity]->flags.set(GUIRect::IS_ENABLED, enable); }
+	void enableRect(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_ENABLED, enable); invalidate(entity); }
 	bool isRectEnabled(EntityRef entity) override { return m_rects[entity]->flags.isSet(GUIRect::IS_ENABLED); }
 	float getRectLeftPoints(EntityRef entity) override { return m_rects[entity]->left.points; }
-	void setRectLeftPoints(EntityRef entity, float value) override { m_rects[entity]->left.points = value; }
+	void setRectLeftPoints(EntityRef entity, float value) override { m_rects[entity]->left.points = value; invalidate(entity); }
 	float getRectLeftRelative(EntityRef entity) override { return m_rects[entity]->left.relative; }
-	void setRectLeftRelative(EntityRef entity, float value) override { m_rects[entity]->left.relative = value; }
+	void setRectLeftRelative(EntityRef entity, float value) override { m_rects[entity]->left.relative = value; invalidate(entity); }
 
 	float getRectRightPoints(EntityRef entity) override { return m_rects[entity]->right.points; }
-	void setRectRightPoints(EntityRef entity, float value) override { m_rects[entity]->right.points = value; }
+	void setRectRightPoints(EntityRef entity, float value) override { m_rects[entity]->right.points = value; invalidate(entity); }
 	float getRectRightRelative(EntityRef entity) override { return m_rects[entity]->right.relative; }
-	void setRectRightRelative(EntityRef entity, float value) override { m_rects[entity]->right.relative = value; }
+	void setRectRightRelative(EntityRef entity, float value) override { m_rects[entity]->right.relative = value; invalidate(entity); }
 
 	float getRectTopPoints(EntityRef entity) override { return m_rects[entity]->top.points; }
-	void setRectTopPoints(EntityRef entity, float value) override { m_rects[entity]->top.points = value; }
+	void setRectTopPoints(EntityRef entity, float value) override { m_rects[entity]->top.points = value; invalidate(entity); }
 	float getRectTopRelative(EntityRef entity) override { return m_rects[entity]->top.relative; }
-	void setRectTopRelative(EntityRef entity, float value) override { m_rects[entity]->top.relative = value; }
+	void setRectTopRelative(EntityRef entity, float value) override { m_rects[entity]->top.relative = value; invalidate(entity); }
 
 	float getRectBottomPoints(EntityRef entity) override { return m_rects[entity]->bottom.points; }
-	void setRectBottomPoints(EntityRef entity, float value) override { m_rects[entity]->bottom.points = value; }
+	void setRectBottomPoints(EntityRef entity, float value) override { m_rects[entity]->bottom.points = value; invalidate(entity); }
 	float getRectBottomRelative(EntityRef entity) override { return m_rects[entity]->bottom.relative; }
-	void setRectBottomRelative(EntityRef entity, float value) override { m_rects[entity]->bottom.relative = value; }
+	void setRectBottomRelative(EntityRef entity, float value) override { m_rects[entity]->bottom.relative = value; invalidate(entity); }
 
 	void setTextFontSize(EntityRef entity, int value) override
 	{
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->setFontSize(value);
+		invalidate(entity);
 	}
 	
 	
@@ -578,6 +694,7 @@ struct GUISceneImpl final : GUIScene
 	{
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->color = RGBAVec4ToABGRu32(color);
+		invalidate(entity);
 	}
 
 
@@ -593,6 +710,7 @@ struct GUISceneImpl final : GUIScene
 		GUIText* gui_text = m_rects[entity]->text;
 		FontResource* res = path.isEmpty() ? nullptr : m_font_manager->getOwner().load<FontResource>(path);
 		gui_text->setFontResource(res);
+		invalidate(entity);
 	}
 
 
@@ -610,12 +728,14 @@ struct GUISceneImpl final : GUIScene
 	void setTextVAlign(EntityRef entity, TextVAlign align) override {
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->vertical_align = align;
+		invalidate(entity);
 	}
 
 	void setTextHAlign(EntityRef entity, TextHAlign value) override
 	{
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->horizontal_align = value;
+		invalidate(entity);
 	}
 
 
@@ -623,6 +743,7 @@ struct GUISceneImpl final : GUIScene
 	{
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->text = value;
+		invalidate(entity);
 	}
 
 
@@ -646,6 +767,7 @@ struct GUISceneImpl final : GUIScene
 		}
 		m_rects.clear();
 		m_buttons.clear();
+		m_canvas_cache.clear();
 	}
 
 
@@ -738,6 +860,8 @@ struct GUISceneImpl final : GUIScene
 				if (rect.input_field && is_up) {
 					handled = true;
 					m_focused_entity = rect.entity;
+					// canvas which lost focus is rebuilt anyway, see CanvasCache::has_focus
+					invalidate(rect.entity);
 					if (rect.text)
 					{
 						rect.input_field->cursor = rect.text->text.length();
@@ -921,6 +1045,7 @@ struct GUISceneImpl final : GUIScene
 		rect->entity = entity;
 		rect->flags.set(GUIRect::IS_VALID);
 		rect->flags.set(GUIRect::IS_ENABLED);
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_RECT_TYPE, this);
 	}
 
@@ -936,6 +1061,7 @@ struct GUISceneImpl final : GUIScene
 		GUIRect& rect = *iter.value();
 		rect.text = LUMIX_NEW(m_allocator, GUIText)(m_allocator);
 
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_TEXT_TYPE, this);
 	}
 
@@ -949,6 +1075,7 @@ struct GUISceneImpl final : GUIScene
 			iter = m_rects.find(entity);
 		}
 		iter.value()->render_target = &EMPTY_RENDER_TARGET;
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_RENDER_TARGET_TYPE, this);
 	}
 
@@ -966,6 +1093,7 @@ struct GUISceneImpl final : GUIScene
 		if (image) {
 			button.hovered_color = image->color;
 		}
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_BUTTON_TYPE, this);
 	}
 	
@@ -988,6 +1116,7 @@ struct GUISceneImpl final : GUIScene
 		GUIRect& rect = *iter.value();
 		rect.input_field = LUMIX_NEW(m_allocator, GUIInputField);
 
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_INPUT_FIELD_TYPE, this);
 	}
 
@@ -1004,6 +1133,7 @@ struct GUISceneImpl final : GUIScene
 		rect.image = LUMIX_NEW(m_allocator, GUIImage);
 		rect.image->flags.set(GUIImage::IS_ENABLED);
 
+		invalidate(entity);
 		m_universe.onComponentCreated(entity, GUI_IMAGE_TYPE, this);
 	}
 
@@ -1017,6 +1147,7 @@ struct GUISceneImpl final : GUIScene
 			LUMIX_DELETE(m_allocator, rect);
 			m_rects.erase(entity);
 		}
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_RECT_TYPE, this);
 	}
 
@@ -1024,11 +1155,13 @@ struct GUISceneImpl final : GUIScene
 	void destroyButton(EntityRef entity)
 	{
 		m_buttons.erase(entity);
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_BUTTON_TYPE, this);
 	}
 
 	void destroyCanvas(EntityRef entity) {
 		m_canvas.erase(entity);
+		m_canvas_cache.erase(entity);
 		m_universe.onComponentDestroyed(entity, GUI_CANVAS_TYPE, this);
 	}
 
@@ -1036,6 +1169,7 @@ struct GUISceneImpl final : GUIScene
 	{
 		GUIRect* rect = m_rects[entity];
 		rect->render_target = nullptr;
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_RENDER_TARGET_TYPE, this);
 		checkGarbage(*rect);
 	}
@@ -1046,6 +1180,7 @@ struct GUISceneImpl final : GUIScene
 		GUIRect* rect = m_rects[entity];
 		LUMIX_DELETE(m_allocator, rect->input_field);
 		rect->input_field = nullptr;
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_INPUT_FIELD_TYPE, this);
 		checkGarbage(*rect);
 	}
@@ -1069,6 +1204,7 @@ struct GUISceneImpl final : GUIScene
 		GUIRect* rect = m_rects[entity];
 		LUMIX_DELETE(m_allocator, rect->image);
 		rect->image = nullptr;
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_IMAGE_TYPE, this);
 		checkGarbage(*rect);
 	}
@@ -1079,6 +1215,7 @@ struct GUISceneImpl final : GUIScene
 		GUIRect* rect = m_rects[entity];
 		LUMIX_DELETE(m_allocator, rect->text);
 		rect->text = nullptr;
+		invalidate(entity);
 		m_universe.onComponentDestroyed(entity, GUI_TEXT_TYPE, this);
 		checkGarbage(*rect);
 	}
@@ -1135,6 +1272,7 @@ struct GUISceneImpl final : GUIScene
 			serializer.write(c.is_3d);
 			serializer.write(c.orient_to_camera);
 			serializer.write(c.virtual_size);
+			serializer.write(c.is_retained);
 		}
 	}
 
@@ -1231,12 +1369,17 @@ struct GUISceneImpl final : GUIScene
 				serializer.read(canvas.orient_to_camera);
 				serializer.read(canvas.virtual_size);
 			}
+			if (version > (i32)Version::CANVAS_VIRTUAL_SIZE) {
+				serializer.read(canvas.is_retained);
+			}
 
 			canvas.entity = entity_map.get(canvas.entity);
 			m_canvas.insert(canvas.entity, canvas);
 			
 			m_universe.onComponentCreated(canvas.entity, GUI_CANVAS_TYPE, this);
 		}
+
+		for (UniquePtr<CanvasCache>& cache : m_canvas_cache) cache->dirty = true;
 	}
 	
 	GUISystem* getSystem() override { return &m_system; }
@@ -1244,6 +1387,7 @@ struct GUISceneImpl final : GUIScene
 	void setRenderTarget(EntityRef entity, gpu::TextureHandle* texture_handle) override
 	{
 		m_rects[entity]->render_target = texture_handle;
+		invalidate(entity);
 	}
 
 	DelegateList<void(EntityRef)>& buttonClicked() override { return m_button_clicked; }
@@ -1262,6 +1406,9 @@ struct GUISceneImpl final : GUIScene
 	HashMap<EntityRef, GUIRect*> m_rects;
 	HashMap<EntityRef, GUIButton> m_buttons;
 	HashMap<EntityRef, GUICanvas> m_canvas;
+	HashMap<EntityRef, UniquePtr<CanvasCache>> m_canvas_cache;
+	// set while retained canvas is rebuilt
+	CanvasCache* m_recorded_cache = nullptr;
 	EntityRef m_buttons_down[16];
 	u32 m_buttons_down_count;
 	EntityPtr m_focused_entity = INVALID_ENTITY;
@@ -1349,6 +1496,7 @@ void GUIScene::reflect() {
 			.var_prop<&GUIScene::getCanvas, &GUICanvas::is_3d>("Is 3D")
 			.var_prop<&GUIScene::getCanvas, &GUICanvas::orient_to_camera>("Orient to camera")
 			.var_prop<&GUIScene::getCanvas, &GUICanvas::virtual_size>("Virtual size")
+			.var_prop<&GUIScene::getCanvas, &GUICanvas::is_retained>("Retained")
 		.LUMIX_CMP(Button, "gui_button", "GUI / Button")
 			.LUMIX_PROP(ButtonHoveredColorRGBA, "Hovered color").colorAttribute()
 			.LUMIX_ENUM_PROP(ButtonHoveredCursor, "Cursor").attribute<CursorEnum>()
@@ -16,6 +16,8 @@ struct GUICanvas {
 	bool is_3d = false;
 	bool orient_to_camera = true;
 	Vec2 virtual_size = Vec2(1000);
+	// draw data is kept between frames and rebuilt only when something in the canvas changes
+	bool is_retained = false;
 };
 
 struct GUIScene : IScene
@@ -92,6 +94,8 @@ struct GUIScene : IScene
 	virtual void setImageSprite(EntityRef entity, const Path& path) = 0;
 
 	virtual GUICanvas& getCanvas(EntityRef entity) = 0;
+	// rebuilds retained canvas containing entity, call after changes GUIScene does not know about, e.g. reparenting
+	virtual void invalidate(EntityRef entity) = 0;
 
 	virtual void setText(EntityRef entity, const char* text) = 0;
 	virtual const char* getText(EntityRef entity) = 0;
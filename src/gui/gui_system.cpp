@@ -70,9 +70,18 @@ struct GUISystemImpl final : GUISystem
 	}
 
 
-	~GUISystemImpl() { m_sprite_manager.destroy(); }
+	~GUISystemImpl() {
+		m_sprite_atlas.clear();
+		m_sprite_manager.destroy();
+	}
+
+	void init() override {
+		auto* renderer = (Renderer*)m_engine.getPluginManager().getPlugin("renderer");
+		m_sprite_atlas.init(*renderer);
+	}
 
 	Engine& getEngine() override { return m_engine; }
+	SpriteAtlas& getSpriteAtlas() override { return m_sprite_atlas; }
 
 	void createScenes(Universe& universe) override
 	{
@@ -115,6 +124,7 @@ struct GUISystemImpl final : GUISystem
 
 	void stopGame() override
 	{
+		if (!m_interface) return;
 		Pipeline* pipeline = m_interface->getPipeline();
 		pipeline->clearDraw2D();
 	}
@@ -128,6 +138,7 @@ struct GUISystemImpl final : GUISystem
 
 	Engine& m_engine;
 	SpriteManager m_sprite_manager;
+	SpriteAtlas m_sprite_atlas;
 	Interface* m_interface;
 };
 
@@ -28,6 +28,7 @@ struct GUISystem : IPlugin
 	virtual void enableCursor(bool enable) = 0;
 	virtual void setCursor(os::CursorType type) = 0;
 	virtual Engine& getEngine() = 0;
+	virtual struct SpriteAtlas& getSpriteAtlas() = 0;
 };
 
 
@@ -4,6 +4,8 @@
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/string.h"
+#include "renderer/draw_stream.h"
+#include "renderer/renderer.h"
 #include "renderer/texture.h"
 
 
@@ -23,6 +25,8 @@ Sprite::Sprite(const Path& path, ResourceManager& manager, IAllocator& allocator
 
 void Sprite::unload()
 {
+	atlas_texture = nullptr;
+	atlas_source = gpu::INVALID_TEXTURE;
 	if (!m_texture) return;
 	
 	m_texture->decRefCount();
@@ -35,6 +39,8 @@ void Sprite::setTexture(const Path& path)
 	if (m_texture) {
 		m_texture->decRefCount();
 	}
+	atlas_texture = nullptr;
+	atlas_source = gpu::INVALID_TEXTURE;
 
 	if (path.isEmpty()) {
 		m_texture = nullptr;
@@ -52,6 +58,7 @@ void Sprite::serialize(OutputMemoryStream& out)
 	out << "bottom(" << bottom << ")\n";
 	out << "left(" << left << ")\n";
 	out << "right(" << right << ")\n";
+	out << "atlas(" << (atlas ? "true" : "false") << ")\n";
 	out << "texture \"" << (m_texture ? m_texture->getPath().c_str() : "") << "\"";
 }
 
@@ -105,6 +112,14 @@ namespace LuaSpriteAPI {
 		sprite->right = LuaWrapper::checkArg<i32>(L, 1);
 		return 0;
 	}
+
+	static int atlas(lua_State* L) {
+		lua_getfield(L, LUA_GLOBALSINDEX, "this");
+		Sprite* sprite = (Sprite*)lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		sprite->atlas = LuaWrapper::checkArg<bool>(L, 1);
+		return 0;
+	}
 }
 
 bool Sprite::load(u64 size, const u8* mem)
@@ -121,6 +136,7 @@ bool Sprite::load(u64 size, const u8* mem)
 	DEFINE_LUA_FUNC(bottom);
 	DEFINE_LUA_FUNC(left);
 	DEFINE_LUA_FUNC(right);
+	DEFINE_LUA_FUNC(atlas);
 
 	lua_pushlightuserdata(L, this);
 	lua_setfield(L, LUA_GLOBALSINDEX, "this"); 
@@ -134,4 +150,105 @@ bool Sprite::load(u64 size, const u8* mem)
 }
 
 
+SpriteAtlas::~SpriteAtlas()
+{
+	ASSERT(m_pages_count == 0);
+}
+
+
+void SpriteAtlas::clear()
+{
+	if (m_pages_count == 0) return;
+
+	DrawStream& stream = m_renderer->getEndFrameDrawStream();
+	for (u32 i = 0; i < m_pages_count; ++i) {
+		stream.destroy(m_pages[i].texture);
+	}
+	m_pages_count = 0;
+	++m_version;
+}
+
+
+// shelf packing, sprites are placed in rows, a new row starts when the current one is full
+bool SpriteAtlas::allocate(Page& page, u32 w, u32 h, u32& x, u32& y)
+{
+	if (page.x + w > PAGE_SIZE) {
+		if (page.shelf_y + page.shelf_h + h > PAGE_SIZE) return false;
+		page.shelf_y += page.shelf_h;
+		page.shelf_h = 0;
+		page.x = 0;
+	}
+	if (page.shelf_y + h > PAGE_SIZE) return false;
+
+	x = page.x;
+	y = page.shelf_y;
+	page.x += w;
+	page.shelf_h = maximum(page.shelf_h, h);
+	return true;
+}
+
+
+bool SpriteAtlas::pack(Sprite& sprite)
+{
+	Texture* tex = sprite.getTexture();
+	if (!tex || !tex->isReady()) return false;
+	if (!sprite.atlas) {
+		sprite.atlas_texture = nullptr;
+		sprite.atlas_source = gpu::INVALID_TEXTURE;
+		return false;
+	}
+	// already packed, or it does not fit
+	if (sprite.atlas_source == tex->handle) return sprite.atlas_texture;
+	
+	sprite.atlas_texture = nullptr;
+	if (!m_renderer) return false;
+	sprite.atlas_source = tex->handle;
+
+	if (tex->is_cubemap || tex->depth > 1 || tex->isStreamed()) return false;
+	if (tex->format != gpu::TextureFormat::RGBA8 && tex->format != gpu::TextureFormat::SRGBA && tex->format != gpu::TextureFormat::BGRA8) return false;
+	if (tex->width > MAX_SPRITE_SIZE || tex->height > MAX_SPRITE_SIZE) return false;
+
+	const bool srgb = u32(tex->getGPUFlags() & gpu::TextureFlags::SRGB);
+	const u32 w = tex->width + PADDING;
+	const u32 h = tex->height + PADDING;
+	u32 x, y;
+	Page* page = nullptr;
+	for (u32 i = 0; i < m_pages_count; ++i) {
+		Page& p = m_pages[i];
+		if (p.format == tex->format && p.srgb == srgb && allocate(p, w, h, x, y)) {
+			page = &p;
+			break;
+		}
+	}
+
+	DrawStream& stream = m_renderer->getDrawStream();
+	if (!page) {
+		if (m_pages_count == MAX_PAGES) return false;
+
+		page = &m_pages[m_pages_count];
+		page->texture = gpu::allocTextureHandle();
+		if (!page->texture) return false;
+
+		++m_pages_count;
+		page->format = tex->format;
+		page->srgb = srgb;
+		page->x = 0;
+		page->shelf_y = 0;
+		page->shelf_h = 0;
+		const gpu::TextureFlags flags = gpu::TextureFlags::NO_MIPS | gpu::TextureFlags::CLAMP_U | gpu::TextureFlags::CLAMP_V | (srgb ? gpu::TextureFlags::SRGB : gpu::TextureFlags::NONE);
+		stream.createTexture(page->texture, PAGE_SIZE, PAGE_SIZE, 1, tex->format, flags, "gui_sprite_atlas");
+		allocate(*page, w, h, x, y);
+	}
+
+	stream.copy(page->texture, tex->handle, x, y);
+	
+	// half a texel inside, so bilinear filtering does not sample the padding
+	sprite.atlas_texture = &page->texture;
+	sprite.atlas_uv0 = Vec2(x + 0.5f, y + 0.5f) / float(PAGE_SIZE);
+	sprite.atlas_uv1 = Vec2(x + tex->width - 0.5f, y + tex->height - 0.5f) / float(PAGE_SIZE);
+	++m_version;
+	return true;
+}
+
+
 } // namespace Lumix
\ No newline at end of file
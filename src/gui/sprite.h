@@ -1,7 +1,9 @@
 #pragma once
 
 
+#include "engine/math.h"
 #include "engine/resource.h"
+#include "renderer/gpu/gpu.h"
 
 
 namespace Lumix
@@ -32,6 +34,15 @@ public:
 	int bottom = 0;
 	int left = 0;
 	int right = 0;
+	// copied to a shared atlas, so it does not break batching of neighbouring images
+	bool atlas = true;
+
+	// set by SpriteAtlas, null if the sprite is drawn from its own texture
+	gpu::TextureHandle* atlas_texture = nullptr;
+	Vec2 atlas_uv0 = Vec2(0);
+	Vec2 atlas_uv1 = Vec2(1);
+	// texture copied to the atlas, the sprite is packed again if its texture is reloaded
+	gpu::TextureHandle atlas_source = gpu::INVALID_TEXTURE;
 
 	static const ResourceType TYPE;
 
@@ -40,4 +51,43 @@ private:
 };
 
 
+// packs small uncompressed sprite textures into shared pages, so a whole HUD is drawn with a handful of textures
+// space of sprites which are unloaded is not reused
+struct SpriteAtlas {
+	static constexpr u32 PAGE_SIZE = 2048;
+	static constexpr u32 MAX_PAGES = 4;
+	// bigger textures are drawn on their own
+	static constexpr u32 MAX_SPRITE_SIZE = 512;
+	// between sprites, so filtering does not bleed from neighbours
+	static constexpr u32 PADDING = 2;
+
+	~SpriteAtlas();
+
+	void init(struct Renderer& renderer) { m_renderer = &renderer; }
+	void clear();
+	// returns true if the sprite can be drawn from the atlas, copies its texture there if it's not yet
+	bool pack(Sprite& sprite);
+	// changes every time a sprite is packed, i.e. recorded draws can use stale uvs
+	u32 getVersion() const { return m_version; }
+
+private:
+	struct Page {
+		gpu::TextureHandle texture;
+		gpu::TextureFormat format;
+		bool srgb;
+		u32 x;
+		u32 shelf_y;
+		u32 shelf_h;
+	};
+
+	static bool allocate(Page& page, u32 w, u32 h, u32& x, u32& y);
+
+	Renderer* m_renderer = nullptr;
+	// fixed, sprites point to page textures
+	Page m_pages[MAX_PAGES];
+	u32 m_pages_count = 0;
+	u32 m_version = 0;
+};
+
+
 } // namespace Lumix
\ No newline at end of file
@@ -51,6 +51,8 @@ struct AssetPlugin : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	
 	bool onGUI(Span<Resource*> resources) override
 	{
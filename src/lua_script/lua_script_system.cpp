@@ -5,9 +5,12 @@
 #include "engine/hash.h"
 #include "engine/debug.h"
 #include "engine/engine.h"
+#include "engine/file_system.h"
 #include "engine/flag_set.h"
 #include "engine/allocator.h"
+#include "engine/allocators.h"
 #include "engine/input_system.h"
+#include "engine/job_system.h"
 #include "engine/metaprogramming.h"
 #include "engine/plugin.h"
 #include "engine/log.h"
@@ -17,6 +20,7 @@
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/string.h"
+#include "engine/sync.h"
 #include "engine/universe.h"
 #include "gui/gui_scene.h"
 #include "lua_script/lua_script.h"
@@ -216,6 +220,7 @@ namespace Lumix
 	{
 		HASH64,
 		INLINE_SCRIPT,
+		SCRIPT_GROUPS,
 
 		LATEST
 	};
@@ -291,24 +296,81 @@ namespace Lumix
 		bool deserialize(u32 version, InputMemoryStream& stream) override { return version == 0; }
 
 		Engine& m_engine;
-		IAllocator& m_allocator;
+		TagAllocator m_allocator;
 		LuaScriptManager m_script_manager;
 	};
 
 
 	struct LuaScriptSceneImpl final : LuaScriptScene
 	{
+		// slot of a timer, handle is slot index and generation, so cancel is O(1) and stale handles are ignored
 		struct TimerData
 		{
-			float time;
 			lua_State* state;
-			int func;
+			int func = LUA_NOREF;
+			u32 generation = 0;
+		};
+
+		// min-heap by expiry, entries of cancelled timers stay in the heap and are skipped when they expire
+		struct TimerHeapEntry
+		{
+			double expiry;
+			u32 slot;
+			u32 generation;
+		};
+
+		static constexpr u32 TIMER_SLOT_BITS = 20;
+		static constexpr u32 TIMER_SLOT_MASK = (1 << TIMER_SLOT_BITS) - 1;
+		static constexpr u32 TIMER_GENERATION_MASK = 0x7ff;
+
+		// slots are preallocated, so futures can be signaled from any thread
+		struct Future
+		{
+			enum State : i32 {
+				FREE,
+				PENDING,
+				SUCCESS,
+				FAILURE
+			};
+
+			volatile i32 state = FREE;
+			u32 generation = 0;
+			// coroutine waiting in LuaScript.await, the ref keeps it alive
+			lua_State* coroutine = nullptr;
+			int coroutine_ref = LUA_NOREF;
+			// value passed to the coroutine with the success flag, e.g. file content
+			lua_State* result_state = nullptr;
+			int result_ref = LUA_NOREF;
+			// futures from LuaScript.sleep are resolved when timers' time reaches expiry
+			double expiry = -1;
 		};
 
+		struct FileLoad
+		{
+			void callback(u64 size, const u8* data, bool success);
+
+			LuaScriptSceneImpl* scene;
+			lua_State* state;
+			u32 future;
+			FileSystem::AsyncHandle handle = FileSystem::AsyncHandle::invalid();
+		};
+
+		static constexpr u32 MAX_FUTURES = 4096;
+		static constexpr u32 FUTURE_SLOT_BITS = 12;
+		static constexpr u32 FUTURE_SLOT_MASK = (1 << FUTURE_SLOT_BITS) - 1;
+		static constexpr u32 FUTURE_GENERATION_MASK = 0x7ffff;
+		static_assert(MAX_FUTURES == 1 << FUTURE_SLOT_BITS);
+
 		struct CallbackData
 		{
 			lua_State* state;
 			int environment;
+			// registry ref of the callback, only for updates
+			int func = LUA_NOREF;
+			// bytes allocated by the last call, only if the state uses LuaAllocator
+			u64 allocated = 0;
+			// input handler with onInputEvents, it gets all events of the frame in one call
+			bool is_batched = false;
 		};
 
 		struct ScriptComponent;
@@ -317,6 +379,62 @@ namespace Lumix
 			lua_State* m_state = nullptr;
 			int m_environment = -1;
 			int m_thread_ref = -1;
+			u32 m_group = 0;
+		};
+
+		// scripts of a group > 0 live in the group's own lua state, groups update in parallel on workers,
+		// so they can only read the universe and their transform changes are deferred to the sync point
+		struct ScriptGroup {
+			struct Command {
+				enum Type : u32 {
+					SET_POSITION,
+					SET_ROTATION,
+					SET_SCALE
+				};
+
+				Type type;
+				EntityRef entity;
+				DVec3 position;
+				Quat rotation;
+				float scale;
+			};
+
+			ScriptGroup(LuaScriptSceneImpl& scene, u32 id, IAllocator& allocator)
+				: id(id)
+				, allocator(allocator)
+				, commands(allocator)
+				, updates(allocator)
+			{
+				state = lua_newstate(LuaAllocator::luaAlloc, &this->allocator);
+				// lua_newstate does not support custom allocators in some luajit builds
+				if (!state) state = luaL_newstate();
+				luaL_openlibs(state);
+				registerGroupAPI(*this);
+			}
+
+			~ScriptGroup() {
+				lua_close(state);
+			}
+
+			void update(float time_delta, float gc_budget) {
+				PROFILE_BLOCK("lua script group");
+				for (CallbackData& update : updates) {
+					LuaWrapper::DebugGuard guard(state);
+					const u64 total = allocator.getStats().total;
+					lua_rawgeti(state, LUA_REGISTRYINDEX, update.func);
+					lua_pushnumber(state, time_delta);
+					LuaWrapper::pcall(state, 1, 0);
+					update.allocated = allocator.getStats().total - total;
+				}
+				LuaWrapper::stepGC(state, gc_budget);
+			}
+
+			u32 id;
+			// pools are not thread safe, but a group's state is used by one worker at a time
+			LuaAllocator allocator;
+			lua_State* state;
+			Array<Command> commands;
+			Array<CallbackData> updates;
 		};
 
 		struct ScriptInstance : ScriptEnvironment
@@ -332,8 +450,8 @@ namespace Lumix
 				, m_cmp(&cmp)
 			{
 				LuaScriptSceneImpl& scene = cmp.m_scene;
-				Engine& engine = scene.m_system.m_engine;
-				lua_State* L = engine.getState();
+				m_group = cmp.m_group;
+				lua_State* L = scene.getGroupState(m_group);
 				m_state = lua_newthread(L);
 				m_thread_ref = luaL_ref(L, LUA_REGISTRYINDEX); // []
 				lua_newtable(m_state); // [env]
@@ -376,6 +494,7 @@ namespace Lumix
 				m_environment = rhs.m_environment;
 				m_thread_ref = rhs.m_thread_ref;
 				m_state = rhs.m_state;
+				m_group = rhs.m_group;
 				rhs.m_script = nullptr;
 				rhs.m_flags.set(MOVED_FROM);
 			}
@@ -389,6 +508,7 @@ namespace Lumix
 				m_cmp = rhs.m_cmp;
 				m_script = rhs.m_script;
 				m_state = rhs.m_state;
+				m_group = rhs.m_group;
 				m_flags = rhs.m_flags;
 				rhs.m_script = nullptr;
 				rhs.m_flags.set(MOVED_FROM);
@@ -416,8 +536,7 @@ namespace Lumix
 
 					m_cmp->m_scene.disableScript(*this);
 
-					Engine& engine = m_cmp->m_scene.m_system.m_engine;
-					lua_State* L = engine.getState();
+					lua_State* L = m_cmp->m_scene.getGroupState(m_group);
 					luaL_unref(L, LUA_REGISTRYINDEX, m_thread_ref);
 					luaL_unref(m_state, LUA_REGISTRYINDEX, m_environment);
 				}
@@ -646,6 +765,7 @@ namespace Lumix
 			Array<ScriptInstance> m_scripts;
 			LuaScriptSceneImpl& m_scene;
 			EntityRef m_entity;
+			u32 m_group = 0;
 		};
 
 
@@ -704,16 +824,38 @@ namespace Lumix
 			, m_scripts(system.m_allocator)
 			, m_inline_scripts(system.m_allocator)
 			, m_updates(system.m_allocator)
+			, m_groups(system.m_allocator)
 			, m_input_handlers(system.m_allocator)
 			, m_timers(system.m_allocator)
+			, m_free_timers(system.m_allocator)
+			, m_timer_heap(system.m_allocator)
+			, m_futures(system.m_allocator)
+			, m_free_futures(system.m_allocator)
+			, m_waiting_futures(system.m_allocator)
+			, m_ready_futures(system.m_allocator)
+			, m_file_loads(system.m_allocator)
 			, m_property_names(system.m_allocator)
 			, m_is_game_running(false)
 			, m_is_api_registered(false)
 			, m_animation_scene(nullptr)
 		{
 			m_function_call.is_in_progress = false;
+			m_futures.resize(MAX_FUTURES);
+			m_free_futures.reserve(MAX_FUTURES);
+			for (u32 i = MAX_FUTURES; i > 0; --i) m_free_futures.push(i - 1);
 			
 			registerAPI();
+			createUpdateDispatcher();
+		}
+
+
+		~LuaScriptSceneImpl()
+		{
+			clearFutures();
+			destroyGroups();
+			lua_State* L = m_system.m_engine.getState();
+			luaL_unref(L, LUA_REGISTRYINDEX, m_update_dispatcher);
+			luaL_unref(L, LUA_REGISTRYINDEX, m_update_list);
 		}
 
 
@@ -804,6 +946,7 @@ namespace Lumix
 				LUMIX_DELETE(m_system.m_allocator, script_cmp);
 			}
 			m_scripts.clear();
+			destroyGroups();
 		}
 
 
@@ -905,18 +1048,12 @@ namespace Lumix
 			}
 			lua_getfield(instance.m_state, -1, "update");
 			if (lua_type(instance.m_state, -1) == LUA_TFUNCTION) {
-				auto& update_data = scene->m_updates.emplace();
-				update_data.state = instance.m_state;
-				update_data.environment = instance.m_environment;
+				scene->addUpdate(instance); // pops the function
 			}
-			lua_pop(instance.m_state, 1);
-			lua_getfield(instance.m_state, -1, "onInputEvent");
-			if (lua_type(instance.m_state, -1) == LUA_TFUNCTION) {
-				auto& callback = scene->m_input_handlers.emplace();
-				callback.state = instance.m_state;
-				callback.environment = instance.m_environment;
+			else {
+				lua_pop(instance.m_state, 1);
 			}
-			lua_pop(instance.m_state, 1);
+			scene->addInputHandler(instance);
 			lua_pop(instance.m_state, 1);
 
 			return 0;
@@ -1360,16 +1497,57 @@ namespace Lumix
 			}
 		}
 
-		void cancelTimer(int timer_func)
+		void freeTimer(u32 slot)
 		{
-			for (int i = 0, c = m_timers.size(); i < c; ++i)
-			{
-				if (m_timers[i].func == timer_func)
-				{
-					m_timers.swapAndPop(i);
-					break;
-				}
+			TimerData& timer = m_timers[slot];
+			luaL_unref(timer.state, LUA_REGISTRYINDEX, timer.func);
+			timer.func = LUA_NOREF;
+			timer.generation = (timer.generation + 1) & TIMER_GENERATION_MASK;
+			m_free_timers.push(slot);
+		}
+
+
+		void cancelTimer(int handle)
+		{
+			const u32 slot = u32(handle) & TIMER_SLOT_MASK;
+			const u32 generation = u32(handle) >> TIMER_SLOT_BITS;
+			if (slot >= (u32)m_timers.size()) return;
+			const TimerData& timer = m_timers[slot];
+			if (timer.func == LUA_NOREF || timer.generation != generation) return;
+			freeTimer(slot);
+		}
+
+
+		void pushTimer(const TimerHeapEntry& entry)
+		{
+			m_timer_heap.push(entry);
+			u32 i = m_timer_heap.size() - 1;
+			while (i > 0) {
+				const u32 parent = (i - 1) / 2;
+				if (m_timer_heap[parent].expiry <= m_timer_heap[i].expiry) break;
+				swap(m_timer_heap[parent], m_timer_heap[i]);
+				i = parent;
+			}
+		}
+
+
+		TimerHeapEntry popTimer()
+		{
+			const TimerHeapEntry top = m_timer_heap[0];
+			m_timer_heap[0] = m_timer_heap.last();
+			m_timer_heap.pop();
+			const u32 count = m_timer_heap.size();
+			u32 i = 0;
+			for (;;) {
+				const u32 left = i * 2 + 1;
+				if (left >= count) break;
+				const u32 right = left + 1;
+				const u32 child = right < count && m_timer_heap[right].expiry < m_timer_heap[left].expiry ? right : left;
+				if (m_timer_heap[i].expiry <= m_timer_heap[child].expiry) break;
+				swap(m_timer_heap[i], m_timer_heap[child]);
+				i = child;
 			}
+			return top;
 		}
 
 
@@ -1378,13 +1556,226 @@ namespace Lumix
 			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
 			float time = LuaWrapper::checkArg<float>(L, 2);
 			if (!lua_isfunction(L, 3)) LuaWrapper::argError(L, 3, "function");
-			TimerData& timer = scene->m_timers.emplace();
-			timer.time = time;
+
+			u32 slot;
+			if (scene->m_free_timers.empty()) {
+				slot = scene->m_timers.size();
+				if (slot > TIMER_SLOT_MASK) luaL_error(L, "too many timers");
+				scene->m_timers.emplace();
+			}
+			else {
+				slot = scene->m_free_timers.last();
+				scene->m_free_timers.pop();
+			}
+			TimerData& timer = scene->m_timers[slot];
 			timer.state = L;
 			lua_pushvalue(L, 3);
 			timer.func = luaL_ref(L, LUA_REGISTRYINDEX);
+			scene->pushTimer({scene->m_timer_time + time, slot, timer.generation});
+			LuaWrapper::push(L, i32(slot | (timer.generation << TIMER_SLOT_BITS)));
+			return 1;
+		}
+
+
+		u32 createFuture() override
+		{
+			MutexGuard guard(m_futures_mutex);
+			if (m_free_futures.empty()) return INVALID_FUTURE;
+
+			const u32 slot = m_free_futures.last();
+			m_free_futures.pop();
+			Future& future = m_futures[slot];
+			future.expiry = -1;
+			future.state = Future::PENDING;
+			return slot | (future.generation << FUTURE_SLOT_BITS);
+		}
+
+
+		Future* getFuture(u32 handle)
+		{
+			Future& future = m_futures[handle & FUTURE_SLOT_MASK];
+			if (future.state == Future::FREE || future.generation != handle >> FUTURE_SLOT_BITS) return nullptr;
+			return &future;
+		}
+
+
+		void signalFuture(u32 handle, bool success) override
+		{
+			if (handle == INVALID_FUTURE) return;
+			Future* future = getFuture(handle);
+			if (future) compareAndExchange(&future->state, success ? Future::SUCCESS : Future::FAILURE, Future::PENDING);
+		}
+
+
+		void freeFuture(u32 slot)
+		{
+			Future& future = m_futures[slot];
+			if (future.result_ref != LUA_NOREF) luaL_unref(future.result_state, LUA_REGISTRYINDEX, future.result_ref);
+			if (future.coroutine_ref != LUA_NOREF) luaL_unref(future.coroutine, LUA_REGISTRYINDEX, future.coroutine_ref);
+			future.result_ref = LUA_NOREF;
+			future.coroutine_ref = LUA_NOREF;
+			future.coroutine = nullptr;
+			future.result_state = nullptr;
+			future.generation = (future.generation + 1) & FUTURE_GENERATION_MASK;
+			future.state = Future::FREE;
+			MutexGuard guard(m_futures_mutex);
+			m_free_futures.push(slot);
+		}
+
+
+		// pushes success flag and result of a finished future and frees it
+		int popFutureResult(lua_State* L, u32 slot)
+		{
+			Future& future = m_futures[slot];
+			lua_pushboolean(L, future.state == Future::SUCCESS);
+			if (future.result_ref != LUA_NOREF) {
+				lua_rawgeti(future.result_state, LUA_REGISTRYINDEX, future.result_ref);
+				if (future.result_state != L) lua_xmove(future.result_state, L, 1);
+			}
+			else {
+				lua_pushnil(L);
+			}
+			freeFuture(slot);
+			return 2;
+		}
+
+
+		void clearFutures()
+		{
+			FileSystem& fs = m_system.m_engine.getFileSystem();
+			for (FileLoad* load : m_file_loads) {
+				fs.cancel(load->handle);
+				LUMIX_DELETE(m_system.m_allocator, load);
+			}
+			m_file_loads.clear();
+			for (u32 i = 0; i < MAX_FUTURES; ++i) {
+				if (m_futures[i].state != Future::FREE) freeFuture(i);
+			}
+			m_waiting_futures.clear();
+		}
+
+
+		// the coroutine yields futures' handles from LuaScript.await, it's resumed when the future is done
+		void resumeCoroutine(lua_State* co, int co_ref, int nargs)
+		{
+			const int status = lua_resume(co, nargs);
+			if (status == LUA_YIELD) {
+				Future* future = lua_gettop(co) > 0 && lua_isnumber(co, -1) ? getFuture((u32)lua_tonumber(co, -1)) : nullptr;
+				lua_settop(co, 0);
+				if (future) {
+					future->coroutine = co;
+					future->coroutine_ref = co_ref;
+					MutexGuard guard(m_futures_mutex);
+					m_waiting_futures.push(u32(future - m_futures.begin()));
+					return;
+				}
+				logError("Coroutine started with LuaScript.async yielded without a future, use LuaScript.await");
+			}
+			else if (status != 0) {
+				logError(lua_tostring(co, -1));
+			}
+			luaL_unref(co, LUA_REGISTRYINDEX, co_ref);
+		}
+
+
+		// coroutines are resumed on the main thread, their futures can be signaled from anywhere
+		void updateFutures()
+		{
+			{
+				MutexGuard guard(m_futures_mutex);
+				for (i32 i = m_waiting_futures.size() - 1; i >= 0; --i) {
+					const u32 slot = m_waiting_futures[i];
+					Future& future = m_futures[slot];
+					if (future.expiry >= 0 && future.expiry <= m_timer_time) future.state = Future::SUCCESS;
+					if (future.state == Future::PENDING) continue;
+
+					m_ready_futures.push(slot);
+					m_waiting_futures.swapAndPop(i);
+				}
+			}
+
+			for (u32 slot : m_ready_futures) {
+				Future& future = m_futures[slot];
+				lua_State* co = future.coroutine;
+				const int co_ref = future.coroutine_ref;
+				future.coroutine_ref = LUA_NOREF;
+				const int nargs = popFutureResult(co, slot);
+				resumeCoroutine(co, co_ref, nargs);
+			}
+			m_ready_futures.clear();
+		}
+
+
+		// LuaScript.async(scene, fn, ...) calls fn(...) in a new coroutine
+		static int async(lua_State* L)
+		{
+			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
+			if (!lua_isfunction(L, 2)) LuaWrapper::argError(L, 2, "function");
+
+			const int nargs = lua_gettop(L) - 2;
+			lua_State* co = lua_newthread(L);
+			const int co_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			lua_xmove(L, co, nargs + 1);
+			scene->resumeCoroutine(co, co_ref, nargs);
+			return 0;
+		}
+
+
+		// LuaScript.await(scene, future) returns success flag and the future's result, yields until the future is done
+		static int await(lua_State* L)
+		{
+			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
+			const u32 handle = LuaWrapper::checkArg<u32>(L, 2);
+			Future* future = scene->getFuture(handle);
+			if (!future) LuaWrapper::argError(L, 2, "future");
+			if (future->coroutine) luaL_error(L, "future is already awaited");
+
+			if (future->expiry >= 0 && future->expiry <= scene->m_timer_time) future->state = Future::SUCCESS;
+			if (future->state != Future::PENDING) return scene->popFutureResult(L, handle & FUTURE_SLOT_MASK);
+
+			if (lua_pushthread(L)) luaL_error(L, "LuaScript.await can be called only from LuaScript.async");
 			lua_pop(L, 1);
-			LuaWrapper::push(L, timer.func);
+			lua_settop(L, 2);
+			return lua_yield(L, 1);
+		}
+
+
+		// LuaScript.sleep(scene, seconds) returns a future done after the time elapses
+		static int sleep(lua_State* L)
+		{
+			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
+			const float time = LuaWrapper::checkArg<float>(L, 2);
+			const u32 handle = scene->createFuture();
+			if (handle == INVALID_FUTURE) luaL_error(L, "too many futures");
+
+			scene->m_futures[handle & FUTURE_SLOT_MASK].expiry = scene->m_timer_time + time;
+			LuaWrapper::push(L, handle);
+			return 1;
+		}
+
+
+		// LuaScript.loadFile(scene, path) returns a future with the file's content, the file is read on IO threads
+		static int loadFile(lua_State* L)
+		{
+			auto* scene = LuaWrapper::checkArg<LuaScriptSceneImpl*>(L, 1);
+			const char* path = LuaWrapper::checkArg<const char*>(L, 2);
+			const u32 handle = scene->createFuture();
+			if (handle == INVALID_FUTURE) luaL_error(L, "too many futures");
+
+			FileLoad* load = LUMIX_NEW(scene->m_system.m_allocator, FileLoad);
+			load->scene = scene;
+			load->state = L;
+			load->future = handle;
+			FileSystem& fs = scene->m_system.m_engine.getFileSystem();
+			load->handle = fs.getContent(Path(path), makeDelegate<&FileLoad::callback>(load));
+			if (load->handle.isValid()) {
+				scene->m_file_loads.push(load);
+			}
+			else {
+				scene->signalFuture(handle, false);
+				LUMIX_DELETE(scene->m_system.m_allocator, load);
+			}
+			LuaWrapper::push(L, handle);
 			return 1;
 		}
 
@@ -1413,6 +1804,10 @@ namespace Lumix
 			#undef REGISTER_FUNCTION
 
 			LuaWrapper::createSystemFunction(engine_state, "LuaScript", "setTimer", &LuaScriptSceneImpl::setTimer);
+			LuaWrapper::createSystemFunction(engine_state, "LuaScript", "async", &LuaScriptSceneImpl::async);
+			LuaWrapper::createSystemFunction(engine_state, "LuaScript", "await", &LuaScriptSceneImpl::await);
+			LuaWrapper::createSystemFunction(engine_state, "LuaScript", "sleep", &LuaScriptSceneImpl::sleep);
+			LuaWrapper::createSystemFunction(engine_state, "LuaScript", "loadFile", &LuaScriptSceneImpl::loadFile);
 		}
 
 
@@ -1590,33 +1985,348 @@ namespace Lumix
 		}
 
 
-		static void* luaAllocator(void* ud, void* ptr, size_t osize, size_t nsize)
+		// expects the update function on the top of inst's stack, pops it
+		void addUpdate(const ScriptEnvironment& inst)
 		{
-			auto& allocator = *static_cast<IAllocator*>(ud);
-			if (nsize == 0)
-			{
-				allocator.deallocate(ptr);
-				return nullptr;
+			if (inst.m_group != 0) {
+				CallbackData& update_data = getGroup(inst.m_group).updates.emplace();
+				update_data.state = inst.m_state;
+				update_data.environment = inst.m_environment;
+				update_data.func = luaL_ref(inst.m_state, LUA_REGISTRYINDEX);
+				return;
 			}
-			if (ptr == nullptr) return allocator.allocate(nsize);
 
-			void* new_mem = allocator.allocate(nsize);
-			memcpy(new_mem, ptr, minimum(osize, nsize));
-			allocator.deallocate(ptr);
-			return new_mem;
+			CallbackData& update_data = m_updates.emplace();
+			update_data.state = inst.m_state;
+			update_data.environment = inst.m_environment;
+			lua_pushvalue(inst.m_state, -1);
+			update_data.func = luaL_ref(inst.m_state, LUA_REGISTRYINDEX);
+
+			// keep the dispatcher's list in sync with m_updates
+			lua_rawgeti(inst.m_state, LUA_REGISTRYINDEX, m_update_list);
+			lua_insert(inst.m_state, -2);
+			lua_rawseti(inst.m_state, -2, m_updates.size());
+			lua_pop(inst.m_state, 1);
+		}
+
+
+		// expects the environment on the top of inst's stack
+		void addInputHandler(const ScriptEnvironment& inst)
+		{
+			lua_State* L = inst.m_state;
+			lua_getfield(L, -1, "onInputEvents");
+			const bool is_batched = lua_type(L, -1) == LUA_TFUNCTION;
+			lua_pop(L, 1);
+			lua_getfield(L, -1, "onInputEvent");
+			const bool is_handler = is_batched || lua_type(L, -1) == LUA_TFUNCTION;
+			lua_pop(L, 1);
+			if (!is_handler) return;
+
+			CallbackData& callback = m_input_handlers.emplace();
+			callback.state = L;
+			callback.environment = inst.m_environment;
+			callback.is_batched = is_batched;
 		}
 
 
+		void removeUpdate(int idx)
+		{
+			lua_State* L = m_system.m_engine.getState();
+			const int last = m_updates.size();
+			lua_rawgeti(L, LUA_REGISTRYINDEX, m_update_list);
+			lua_rawgeti(L, -1, last);
+			lua_rawseti(L, -2, idx + 1);
+			lua_pushnil(L);
+			lua_rawseti(L, -2, last);
+			lua_pop(L, 1);
+
+			luaL_unref(L, LUA_REGISTRYINDEX, m_updates[idx].func);
+			m_updates.swapAndPop(idx);
+		}
+
+
+		static int logDispatchError(lua_State* L)
+		{
+			logError(lua_tostring(L, 1));
+			return 0;
+		}
+
+
+		// all updates are called from a single lua loop, so there is only one C->lua transition per frame
+		void createUpdateDispatcher()
+		{
+			lua_State* L = m_system.m_engine.getState();
+			LuaWrapper::DebugGuard guard(L);
+			lua_newtable(L);
+			m_update_list = luaL_ref(L, LUA_REGISTRYINDEX);
+
+			static const char dispatcher_src[] =
+				"local pcall = pcall\n"
+				"return function(updates, count, time_delta, on_error)\n"
+				"	for i = 1, count do\n"
+				"		local f = updates[i]\n"
+				"		if f then\n"
+				"			local ok, err = pcall(f, time_delta)\n"
+				"			if not ok then on_error(err) end\n"
+				"		end\n"
+				"	end\n"
+				"end\n";
+			if (!LuaWrapper::execute(L, Span(dispatcher_src, stringLength(dispatcher_src)), "update dispatcher", 1)) return;
+			m_update_dispatcher = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+
+		void dispatchUpdates(float time_delta)
+		{
+			lua_State* L = m_system.m_engine.getState();
+			LuaWrapper::DebugGuard guard(L);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, m_update_dispatcher);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, m_update_list);
+			lua_pushinteger(L, m_updates.size());
+			lua_pushnumber(L, time_delta);
+			lua_pushcfunction(L, logDispatchError);
+			LuaWrapper::pcall(L, 4, 0);
+		}
+
+
+		ScriptGroup& getGroup(u32 id) {
+			ASSERT(id != 0);
+			for (ScriptGroup* group : m_groups) {
+				if (group->id == id) return *group;
+			}
+			ScriptGroup* group = LUMIX_NEW(m_system.m_allocator, ScriptGroup)(*this, id, m_system.m_allocator);
+			group->commands.reserve(64);
+			m_groups.push(group);
+			return *group;
+		}
+
+
+		lua_State* getGroupState(u32 id) {
+			return id == 0 ? m_system.m_engine.getState() : getGroup(id).state;
+		}
+
+
+		void destroyGroups() {
+			for (ScriptGroup* group : m_groups) LUMIX_DELETE(m_system.m_allocator, group);
+			m_groups.clear();
+		}
+
+
+		static ScriptGroup* getGroupUpvalue(lua_State* L) {
+			return (ScriptGroup*)lua_touserdata(L, lua_upvalueindex(1));
+		}
+
+
+		static int LUA_groupGetEntityPosition(lua_State* L) {
+			Universe* universe = LuaWrapper::checkArg<Universe*>(L, 1);
+			const EntityRef entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			LuaWrapper::push(L, universe->getPosition(entity));
+			return 1;
+		}
+
+
+		static int LUA_groupGetEntityRotation(lua_State* L) {
+			Universe* universe = LuaWrapper::checkArg<Universe*>(L, 1);
+			const EntityRef entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			LuaWrapper::push(L, universe->getRotation(entity));
+			return 1;
+		}
+
+
+		static int LUA_groupGetEntityScale(lua_State* L) {
+			Universe* universe = LuaWrapper::checkArg<Universe*>(L, 1);
+			const EntityRef entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			LuaWrapper::push(L, universe->getScale(entity));
+			return 1;
+		}
+
+
+		static int LUA_groupSetEntityPosition(lua_State* L) {
+			ScriptGroup::Command& cmd = getGroupUpvalue(L)->commands.emplace();
+			cmd.type = ScriptGroup::Command::SET_POSITION;
+			cmd.entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			cmd.position = LuaWrapper::checkArg<DVec3>(L, 3);
+			return 0;
+		}
+
+
+		static int LUA_groupSetEntityRotation(lua_State* L) {
+			ScriptGroup::Command& cmd = getGroupUpvalue(L)->commands.emplace();
+			cmd.type = ScriptGroup::Command::SET_ROTATION;
+			cmd.entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			cmd.rotation = LuaWrapper::checkArg<Quat>(L, 3);
+			return 0;
+		}
+
+
+		static int LUA_groupSetEntityScale(lua_State* L) {
+			ScriptGroup::Command& cmd = getGroupUpvalue(L)->commands.emplace();
+			cmd.type = ScriptGroup::Command::SET_SCALE;
+			cmd.entity = {LuaWrapper::checkArg<i32>(L, 2)};
+			cmd.scale = LuaWrapper::checkArg<float>(L, 3);
+			return 0;
+		}
+
+
+		static void LUA_groupLogError(const char* text) { logError(text); }
+		static void LUA_groupLogInfo(const char* text) { logInfo(text); }
+
+
+		// subset of the engine api, safe to use from a worker
+		static void registerGroupAPI(ScriptGroup& group) {
+			lua_State* L = group.state;
+			LuaWrapper::createSystemFunction(L, "LumixAPI", "getEntityPosition", &LUA_groupGetEntityPosition);
+			LuaWrapper::createSystemFunction(L, "LumixAPI", "getEntityRotation", &LUA_groupGetEntityRotation);
+			LuaWrapper::createSystemFunction(L, "LumixAPI", "getEntityScale", &LUA_groupGetEntityScale);
+			LuaWrapper::createSystemClosure(L, "LumixAPI", &group, "setEntityPosition", &LUA_groupSetEntityPosition);
+			LuaWrapper::createSystemClosure(L, "LumixAPI", &group, "setEntityRotation", &LUA_groupSetEntityRotation);
+			LuaWrapper::createSystemClosure(L, "LumixAPI", &group, "setEntityScale", &LUA_groupSetEntityScale);
+			LuaWrapper::createSystemFunction(L, "LumixAPI", "logError", &LuaWrapper::wrap<&LUA_groupLogError>);
+			LuaWrapper::createSystemFunction(L, "LumixAPI", "logInfo", &LuaWrapper::wrap<&LUA_groupLogInfo>);
+
+			// reads see the universe as it was at the start of the update
+			const char* src = R"#(
+				Lumix = {}
+				Lumix.Entity = {}
+				function Lumix.Entity:new(universe, entity)
+					local e = { _entity = entity, _universe = universe }
+					setmetatable(e, self)
+					return e
+				end
+				Lumix.Entity.__index = function(table, key)
+					if key == "position" then
+						return LumixAPI.getEntityPosition(table._universe, table._entity)
+					elseif key == "rotation" then
+						return LumixAPI.getEntityRotation(table._universe, table._entity)
+					elseif key == "scale" then
+						return LumixAPI.getEntityScale(table._universe, table._entity)
+					end
+					return Lumix.Entity[key]
+				end
+				Lumix.Entity.__newindex = function(table, key, value)
+					if key == "position" then
+						LumixAPI.setEntityPosition(table._universe, table._entity, value)
+					elseif key == "rotation" then
+						LumixAPI.setEntityRotation(table._universe, table._entity, value)
+					elseif key == "scale" then
+						LumixAPI.setEntityScale(table._universe, table._entity, value)
+					else
+						error("key " .. tostring(key) .. " not available in script groups")
+					end
+				end
+			)#";
+			if (!LuaWrapper::execute(L, Span(src, stringLength(src)), "script group api", 0)) {
+				logError("Failed to init script group api");
+			}
+		}
+
+
+		void updateGroups(float time_delta) {
+			if (m_groups.empty()) return;
+
+			PROFILE_FUNCTION();
+			const float gc_budget = LuaWrapper::getGCBudget(time_delta);
+			jobs::forEach(m_groups.size(), 1, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) m_groups[i]->update(time_delta, gc_budget);
+			});
+
+			// sync point
+			for (ScriptGroup* group : m_groups) {
+				for (const ScriptGroup::Command& cmd : group->commands) {
+					if (!m_universe.hasEntity(cmd.entity)) continue;
+					switch (cmd.type) {
+						case ScriptGroup::Command::SET_POSITION: m_universe.setPosition(cmd.entity, cmd.position); break;
+						case ScriptGroup::Command::SET_ROTATION: m_universe.setRotation(cmd.entity, cmd.rotation); break;
+						case ScriptGroup::Command::SET_SCALE: m_universe.setScale(cmd.entity, cmd.scale); break;
+					}
+				}
+				group->commands.clear();
+			}
+		}
+
+
+		u32 getScriptGroup(EntityRef entity) override { return m_scripts[entity]->m_group; }
+
+
+		u64 getGroupMemory(u32 group) override {
+			if (group == 0) return u64(lua_gc(m_system.m_engine.getState(), LUA_GCCOUNT, 0)) * 1024;
+			for (ScriptGroup* g : m_groups) {
+				if (g->id == group) return g->allocator.getStats().allocated;
+			}
+			return 0;
+		}
+
+
+		u64 getScriptUpdateAllocations(EntityRef entity, int scr_index) override {
+			const ScriptInstance& inst = m_scripts[entity]->m_scripts[scr_index];
+			const Array<CallbackData>& updates = inst.m_group == 0 ? m_updates : getGroup(inst.m_group).updates;
+			for (const CallbackData& update : updates) {
+				if (update.state == inst.m_state && update.environment == inst.m_environment) return update.allocated;
+			}
+			return 0;
+		}
+
+
+		// instances live in their group's lua state, so they are recreated, properties are kept
+		void setScriptGroup(EntityRef entity, u32 group) override {
+			ScriptComponent* cmp = m_scripts[entity];
+			if (cmp->m_group == group) return;
+
+			struct Saved {
+				Path path;
+				Array<Property> properties;
+				bool enabled;
+			};
+			Array<Saved> saved(m_system.m_allocator);
+			for (ScriptInstance& scr : cmp->m_scripts) {
+				if (scr.m_script && scr.m_script->isReady()) {
+					for (Property& prop : scr.m_properties) {
+						auto iter = m_property_names.find(prop.name_hash);
+						if (!iter.isValid()) continue;
+						char tmp[1024];
+						getProperty(prop, iter.value().c_str(), scr, Span(tmp));
+						prop.stored_value = tmp;
+					}
+				}
+				saved.push({scr.m_script ? scr.m_script->getPath() : Path(), scr.m_properties.move(), scr.m_flags.isSet(ScriptInstance::ENABLED)});
+			}
+
+			cmp->m_scripts.clear();
+			cmp->m_group = group;
+			for (Saved& s : saved) {
+				ScriptInstance& inst = cmp->m_scripts.emplace(*cmp, m_system.m_allocator);
+				inst.m_properties = s.properties.move();
+				inst.m_flags.set(ScriptInstance::ENABLED, s.enabled);
+				setPath(*cmp, inst, s.path);
+			}
+		}
+
+
+		void setBatchUpdates(bool enable) override { m_batch_updates = enable; }
+		bool areUpdatesBatched() override { return m_batch_updates; }
+
+
 		void disableScript(ScriptEnvironment& inst)
 		{
 			if (!inst.m_state) return;
 			for (int i = 0; i < m_timers.size(); ++i)
 			{
-				if (m_timers[i].state == inst.m_state)
+				if (m_timers[i].func != LUA_NOREF && m_timers[i].state == inst.m_state)
 				{
-					luaL_unref(m_timers[i].state, LUA_REGISTRYINDEX, m_timers[i].func);
-					m_timers.swapAndPop(i);
-					--i;
+					freeTimer(i);
+				}
+			}
+
+			if (inst.m_group != 0) {
+				Array<CallbackData>& updates = getGroup(inst.m_group).updates;
+				for (int i = 0; i < updates.size(); ++i)
+				{
+					if (updates[i].state == inst.m_state)
+					{
+						luaL_unref(inst.m_state, LUA_REGISTRYINDEX, updates[i].func);
+						updates.swapAndPop(i);
+						break;
+					}
 				}
 			}
 
@@ -1624,7 +2334,7 @@ namespace Lumix
 			{
 				if (m_updates[i].state == inst.m_state)
 				{
-					m_updates.swapAndPop(i);
+					removeUpdate(i);
 					break;
 				}
 			}
@@ -1681,19 +2391,13 @@ namespace Lumix
 			lua_getfield(instance.m_state, -1, "update");
 			if (lua_type(instance.m_state, -1) == LUA_TFUNCTION)
 			{
-				auto& update_data = m_updates.emplace();
-				update_data.state = instance.m_state;
-				update_data.environment = instance.m_environment;
+				addUpdate(instance); // pops the function
 			}
-			lua_pop(instance.m_state, 1);
-			lua_getfield(instance.m_state, -1, "onInputEvent");
-			if (lua_type(instance.m_state, -1) == LUA_TFUNCTION)
+			else
 			{
-				auto& callback = m_input_handlers.emplace();
-				callback.state = instance.m_state;
-				callback.environment = instance.m_environment;
+				lua_pop(instance.m_state, 1);
 			}
-			lua_pop(instance.m_state, 1);
+			addInputHandler(instance);
 
 			if (!is_reload)
 			{
@@ -1782,9 +2486,18 @@ namespace Lumix
 			m_gui_scene = nullptr;
 			m_scripts_start_called = false;
 			m_is_game_running = false;
-			m_updates.clear();
+			while (!m_updates.empty()) removeUpdate(m_updates.size() - 1);
+			for (ScriptGroup* group : m_groups) {
+				for (const CallbackData& update : group->updates) luaL_unref(group->state, LUA_REGISTRYINDEX, update.func);
+				group->updates.clear();
+				group->commands.clear();
+			}
 			m_input_handlers.clear();
-			m_timers.clear();
+			for (int i = 0; i < m_timers.size(); ++i) {
+				if (m_timers[i].func != LUA_NOREF) freeTimer(i);
+			}
+			m_timer_heap.clear();
+			clearFutures();
 			m_animation_scene = nullptr;
 		}
 
@@ -1957,6 +2670,7 @@ namespace Lumix
 			for (ScriptComponent* script_cmp : m_scripts)
 			{
 				serializer.write(script_cmp->m_entity);
+				serializer.write(script_cmp->m_group);
 				serializer.write(script_cmp->m_scripts.size());
 				for (auto& scr : script_cmp->m_scripts)
 				{
@@ -2008,6 +2722,7 @@ namespace Lumix
 				serializer.read(entity);
 				entity = entity_map.get(entity);
 				ScriptComponent* script = LUMIX_NEW(allocator, ScriptComponent)(*this, entity, allocator);
+				if (version > (i32)LuaSceneVersion::INLINE_SCRIPT) serializer.read(script->m_group);
 
 				m_scripts.insert(script->m_entity, script);
 				int scr_count;
@@ -2082,48 +2797,37 @@ namespace Lumix
 		}
 
 
+		// cost depends only on the number of expired timers
 		void updateTimers(float time_delta)
 		{
-			int timers_to_remove[1024];
-			u32 timers_to_remove_count = 0;
-			for (int i = 0, c = m_timers.size(); i < c; ++i)
+			m_timer_time += time_delta;
+			// timers set by callbacks with zero time are called next frame
+			while (!m_timer_heap.empty() && m_timer_heap[0].expiry < m_timer_time)
 			{
-				auto& timer = m_timers[i];
-				timer.time -= time_delta;
-				if (timer.time < 0)
+				const TimerHeapEntry entry = popTimer();
+				TimerData& timer = m_timers[entry.slot];
+				if (timer.func == LUA_NOREF || timer.generation != entry.generation) continue;
+
+				lua_State* state = timer.state;
+				lua_rawgeti(state, LUA_REGISTRYINDEX, timer.func);
+				if (lua_type(state, -1) != LUA_TFUNCTION)
 				{
-					lua_rawgeti(timer.state, LUA_REGISTRYINDEX, timer.func);
-					if (lua_type(timer.state, -1) != LUA_TFUNCTION)
-					{
-						ASSERT(false);
-					}
+					ASSERT(false);
+				}
+				// free before the call, the callback can set new timers and reuse the slot
+				freeTimer(entry.slot);
 
-					if (lua_pcall(timer.state, 0, 0, 0) != 0)
-					{
-						logError(lua_tostring(timer.state, -1));
-						lua_pop(timer.state, 1);
-					}
-					timers_to_remove[timers_to_remove_count] = i;
-					++timers_to_remove_count;
-					if (timers_to_remove_count >= lengthOf(timers_to_remove))
-					{
-						logError("Too many lua timers in one frame, some are not executed");
-						break;
-					}
+				if (lua_pcall(state, 0, 0, 0) != 0)
+				{
+					logError(lua_tostring(state, -1));
+					lua_pop(state, 1);
 				}
 			}
-			for (u32 i = timers_to_remove_count - 1; i != 0xffFFffFF; --i)
-			{
-				auto& timer = m_timers[timers_to_remove[i]];
-				luaL_unref(timer.state, LUA_REGISTRYINDEX, timer.func);
-				m_timers.swapAndPop(timers_to_remove[i]);
-			}
 		}
 
 
-		void processInputEvent(const CallbackData& callback, const InputSystem::Event& event)
+		static void pushInputEvent(lua_State* L, const InputSystem::Event& event)
 		{
-			lua_State* L = callback.state;
 			lua_newtable(L); // [lua_event]
 			LuaWrapper::push(L, (u32)event.type); // [lua_event, event.type]
 			lua_setfield(L, -2, "type"); // [lua_event]
@@ -2167,43 +2871,75 @@ namespace Lumix
 					lua_setfield(L, -2, "text"); // [lua_event]
 					break;
 			}
+			lua_pushnumber(L, double(event.timestamp) / os::Timer::getFrequency()); // [lua_event, time]
+			lua_setfield(L, -2, "time"); // [lua_event]
+		}
 
 
-			lua_rawgeti(L, LUA_REGISTRYINDEX, callback.environment);
-			if (lua_type(L, -1) != LUA_TTABLE) // [lua_event, environment]
+		// calls callback's func_name with the value of arg_ref
+		static void callInputHandler(const CallbackData& callback, const char* func_name, int arg_ref)
+		{
+			lua_State* L = callback.state;
+			lua_rawgeti(L, LUA_REGISTRYINDEX, callback.environment); // [environment]
+			if (lua_type(L, -1) != LUA_TTABLE)
 			{
 				ASSERT(false);
 			}
-			lua_getfield(L, -1, "onInputEvent");
-			if (lua_type(L, -1) != LUA_TFUNCTION)  // [lua_event, environment, func]
+			lua_getfield(L, -1, func_name);
+			if (lua_type(L, -1) != LUA_TFUNCTION)  // [environment, func]
 			{
-				lua_pop(L, 3); // []
+				lua_pop(L, 2); // []
 				return;
 			}
 
-			lua_pushvalue(L, -3); // [lua_event, environment, func, lua_event]
+			lua_rawgeti(L, LUA_REGISTRYINDEX, arg_ref); // [environment, func, arg]
 			
-			if (lua_pcall(L, 1, 0, 0) != 0)// [lua_event, environment]
+			if (lua_pcall(L, 1, 0, 0) != 0)// [environment]
 			{
 				logError(lua_tostring(L, -1));
 				lua_pop(L, 1); // []
 			}
-			lua_pop(L, 2); // []
+			lua_pop(L, 1); // []
 		}
 
 
+		// event tables are created once per frame and shared by all handlers
+		// batched handlers get all events in one call, others get one call per event
 		void processInputEvents()
 		{
 			if (m_input_handlers.empty()) return;
 			InputSystem& input_system = m_system.m_engine.getInputSystem();
 			const InputSystem::Event* events = input_system.getEvents();
-			for (int i = 0, c = input_system.getEventsCount(); i < c; ++i)
-			{
-				for (const CallbackData& cb : m_input_handlers)
-				{
-					processInputEvent(cb, events[i]);
+			const int count = input_system.getEventsCount();
+			if (count == 0) return;
+
+			lua_State* L = m_system.m_engine.getState();
+			lua_createtable(L, count, 0); // [events]
+			for (int i = 0; i < count; ++i) {
+				pushInputEvent(L, events[i]); // [events, event]
+				lua_rawseti(L, -2, i + 1); // [events]
+			}
+			const int events_ref = luaL_ref(L, LUA_REGISTRYINDEX); // []
+
+			bool has_unbatched = false;
+			for (const CallbackData& cb : m_input_handlers) {
+				if (cb.is_batched) callInputHandler(cb, "onInputEvents", events_ref);
+				else has_unbatched = true;
+			}
+
+			if (has_unbatched) {
+				lua_rawgeti(L, LUA_REGISTRYINDEX, events_ref); // [events]
+				for (int i = 0; i < count; ++i) {
+					lua_rawgeti(L, -1, i + 1); // [events, event]
+					const int event_ref = luaL_ref(L, LUA_REGISTRYINDEX); // [events]
+					for (const CallbackData& cb : m_input_handlers) {
+						if (!cb.is_batched) callInputHandler(cb, "onInputEvent", event_ref);
+					}
+					luaL_unref(L, LUA_REGISTRYINDEX, event_ref);
 				}
+				lua_pop(L, 1); // []
 			}
+			luaL_unref(L, LUA_REGISTRYINDEX, events_ref);
 		}
 
 
@@ -2218,26 +2954,28 @@ namespace Lumix
 
 			processInputEvents();
 			updateTimers(time_delta);
+			updateFutures();
+			updateGroups(time_delta);
 
+			if (m_updates.empty()) return;
+			if (m_batch_updates && m_update_dispatcher != LUA_NOREF) {
+				dispatchUpdates(time_delta);
+				return;
+			}
+
+			LuaAllocator* lua_allocator = m_system.m_engine.getLuaAllocator();
 			for (int i = 0; i < m_updates.size(); ++i)
 			{
 				CallbackData update_item = m_updates[i];
 				LuaWrapper::DebugGuard guard(update_item.state, 0);
-				lua_rawgeti(update_item.state, LUA_REGISTRYINDEX, update_item.environment);
-				if (lua_type(update_item.state, -1) != LUA_TTABLE)
-				{
-					ASSERT(false);
-				}
-				lua_getfield(update_item.state, -1, "update");
-				if (lua_type(update_item.state, -1) != LUA_TFUNCTION)
-				{
-					lua_pop(update_item.state, 2);
-					continue;
-				}
-
+				const u64 total = lua_allocator ? lua_allocator->getStats().total : 0;
+				lua_rawgeti(update_item.state, LUA_REGISTRYINDEX, update_item.func);
 				lua_pushnumber(update_item.state, time_delta);
 				LuaWrapper::pcall(update_item.state, 1, 0);
-				lua_pop(update_item.state, 1);
+				// the update could have removed itself
+				if (lua_allocator && i < m_updates.size() && m_updates[i].func == update_item.func) {
+					m_updates[i].allocated = lua_allocator->getStats().total - total;
+				}
 			}
 		}
 
@@ -2369,7 +3107,21 @@ namespace Lumix
 		Array<CallbackData> m_input_handlers;
 		Universe& m_universe;
 		Array<CallbackData> m_updates;
+		// registry refs of the lua side update loop and of its list of functions, same order as m_updates
+		int m_update_dispatcher = LUA_NOREF;
+		int m_update_list = LUA_NOREF;
+		bool m_batch_updates = true;
+		Array<ScriptGroup*> m_groups;
 		Array<TimerData> m_timers;
+		Array<u32> m_free_timers;
+		Array<TimerHeapEntry> m_timer_heap;
+		Mutex m_futures_mutex;
+		Array<Future> m_futures;
+		Array<u32> m_free_futures;
+		Array<u32> m_waiting_futures;
+		Array<u32> m_ready_futures;
+		Array<FileLoad*> m_file_loads;
+		double m_timer_time = 0;
 		FunctionCall m_function_call;
 		ScriptInstance* m_current_script_instance;
 		bool m_scripts_start_called = false;
@@ -2379,6 +3131,18 @@ namespace Lumix
 		AnimationScene* m_animation_scene;
 	};
 
+	void LuaScriptSceneImpl::FileLoad::callback(u64 size, const u8* data, bool success) {
+		Future* f = scene->getFuture(future);
+		if (f && success) {
+			lua_pushlstring(state, (const char*)data, size);
+			f->result_state = state;
+			f->result_ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		}
+		scene->signalFuture(future, success);
+		scene->m_file_loads.eraseItem(this);
+		LUMIX_DELETE(scene->m_system.m_allocator, this);
+	}
+
 	void LuaScriptSceneImpl::ScriptInstance::onScriptUnloaded(LuaScriptSceneImpl& scene, struct ScriptComponent& cmp, int scr_index) {
 		LuaWrapper::DebugGuard guard(m_state);
 		lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_environment); // [env]
@@ -2575,7 +3339,7 @@ namespace Lumix
 
 	LuaScriptSystemImpl::LuaScriptSystemImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_allocator(engine.getAllocator(), "lua_script")
 		, m_script_manager(m_allocator)
 	{
 		m_script_manager.create(LuaScript::TYPE, engine.getResourceManager());
@@ -2584,6 +3348,7 @@ namespace Lumix
 			.LUMIX_CMP(InlineScriptComponent, "lua_script_inline", "Lua Script / Inline") 
 				.LUMIX_PROP(InlineScriptCode, "Code").multilineAttribute()
 			.LUMIX_CMP(ScriptComponent, "lua_script", "Lua Script / File") 
+				.LUMIX_PROP(ScriptGroup, "Group")
 			.begin_array<&LuaScriptScene::getScriptCount, &LuaScriptScene::addScript, &LuaScriptScene::removeScript>("scripts")
 				.prop<&LuaScriptScene::isScriptEnabled, &LuaScriptScene::enableScript>("Enabled")
 				.LUMIX_PROP(ScriptPath, "Path").resourceAttribute(LuaScript::TYPE)
@@ -83,6 +83,24 @@ struct LuaScriptScene : IScene
 	virtual ResourceType getPropertyResourceType(EntityRef entity, int scr_index, int prop_index) = 0;
 	virtual const char* getInlineScriptCode(EntityRef entity) = 0;
 	virtual void setInlineScriptCode(EntityRef entity, const char* value) = 0;
+	// batched updates are called from a single lua loop instead of one lua_pcall per script
+	virtual void setBatchUpdates(bool enable) = 0;
+	virtual bool areUpdatesBatched() = 0;
+	// scripts in a group other than 0 have their own lua state and update in parallel with other groups,
+	// they can only read the universe and set transforms, which are applied after all groups are updated
+	virtual u32 getScriptGroup(EntityRef entity) = 0;
+	virtual void setScriptGroup(EntityRef entity, u32 group) = 0;
+	// bytes, group 0 is the engine's lua state
+	virtual u64 getGroupMemory(u32 group) = 0;
+	// bytes allocated by the script's last update, 0 if its lua state does not use LuaAllocator
+	virtual u64 getScriptUpdateAllocations(EntityRef entity, int scr_index) = 0;
+
+	// coroutines started with LuaScript.async wait for futures with LuaScript.await,
+	// a waiting coroutine is resumed on the main thread in the first update after its future is signaled
+	static constexpr u32 INVALID_FUTURE = 0xffFFffFF;
+	virtual u32 createFuture() = 0;
+	// thread safe, e.g. for jobs finishing work a coroutine waits for
+	virtual void signalFuture(u32 future, bool success) = 0;
 };
 
 
@@ -13,6 +13,7 @@
 #include "engine/universe.h"
 #include "imgui/IconsFontAwesome5.h"
 #include "lua_script/lua_script_system.h"
+#include "lz4/lz4.h"
 #include "renderer/material.h"
 #include "renderer/model.h"
 #include "renderer/render_scene.h"
@@ -32,6 +33,7 @@ enum class NavigationSceneVersion : i32 {
 	ZONE_GUID,
 	DETAILED,
 	GENERATOR_PARAMS,
+	PATH_PRIORITY,
 	LATEST
 };
 
@@ -39,7 +41,35 @@ enum class NavigationSceneVersion : i32 {
 static const ComponentType LUA_SCRIPT_TYPE = reflection::getComponentType("lua_script");
 static const ComponentType NAVMESH_ZONE_TYPE = reflection::getComponentType("navmesh_zone");
 static const ComponentType NAVMESH_AGENT_TYPE = reflection::getComponentType("navmesh_agent");
+static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("model_instance");
 static const int CELLS_PER_TILE_SIDE = 256;
+static const i32 MAX_TILE_REBUILDS = 8; // tiles rebuilt at once in runtime
+static const i32 MAX_PATH_POLYS = 256; // same as dtCrowd's max path result
+static const float NAV_TILE_TIMEOUT = 5; // seconds, streamed tile not needed for this long is unloaded
+static const u32 NAV_FILE_MAGIC = 0x5641'4e4c; // 'LNAV', files without it contain uncompressed tiles
+
+
+enum class NavFileVersion : u32 {
+	COMPRESSED_TILES,
+	LATEST
+};
+
+
+// LZ4 compressed tiles of a loaded zone, in game only tiles around agents and the camera are in the navmesh
+struct NavTileCache {
+	struct Tile {
+		Tile(IAllocator& allocator) : compressed(allocator) {}
+
+		Array<u8> compressed;
+		i32 size = 0; // 0 - no geometry in the tile
+		float idle_time = 0;
+		bool resident = false;
+	};
+
+	NavTileCache(IAllocator& allocator) : tiles(allocator) {}
+
+	Array<Tile> tiles;
+};
 
 
 struct RecastZone {
@@ -51,6 +81,7 @@ struct RecastZone {
 	dtNavMeshQuery* navquery = nullptr;
 	dtNavMesh* navmesh = nullptr;
 	dtCrowd* crowd = nullptr;
+	NavTileCache* tile_cache = nullptr;
 
 	i32 getWalkableRadius() const { return (i32)(zone.agent_radius / zone.cell_size + 0.99f); }
 	float getBorderSize() const { return getWalkableRadius() + 3.f; }
@@ -77,6 +108,51 @@ struct Agent
 	float speed = 0;
 	float yaw_diff = 0;
 	float stop_distance = 0;
+	// agents with higher priority get their paths first
+	i32 path_priority = 0;
+	bool is_path_pending = false;
+};
+
+
+struct PathRequest {
+	EntityRef entity;
+	i32 priority;
+	dtPolyRef end_ref;
+	Vec3 end_pos;
+	// resolved before queries run
+	RecastZone* zone;
+	i32 agent;
+};
+
+
+// model which can change navmesh when it's moved, created or destroyed while game is running
+struct Obstacle {
+	Transform tr;
+	AABB aabb;
+};
+
+
+struct DirtyTile {
+	EntityRef zone;
+	i32 x;
+	i32 z;
+};
+
+
+struct TileRebuild {
+	enum class State : u8 {
+		SKIPPED, // out of time budget, tile stays dirty
+		FAILED,
+		BUILT
+	};
+
+	// copy, so the build does not access m_zones
+	RecastZone zone;
+	i32 x;
+	i32 z;
+	u8* data = nullptr;
+	i32 data_size = 0;
+	State state = State::SKIPPED;
 };
 
 
@@ -88,36 +164,93 @@ struct NavigationSceneImpl final : NavigationScene
 		, m_system(system)
 		, m_engine(engine)
 		, m_agents(m_allocator)
+		, m_agent_map(m_allocator)
 		, m_zones(m_allocator)
 		, m_script_scene(nullptr)
 		, m_on_update(m_allocator)
+		, m_crowd_zones(m_allocator)
+		, m_finished_agents(m_allocator)
+		, m_obstacles(m_allocator)
+		, m_pending_obstacles(m_allocator)
+		, m_dirty_tiles(m_allocator)
+		, m_tile_rebuilds(m_allocator)
+		, m_path_requests(m_allocator)
+		, m_path_queries(m_allocator)
 	{
 		m_universe.entityTransformed().bind<&NavigationSceneImpl::onEntityMoved>(this);
+		m_universe.componentAdded().bind<&NavigationSceneImpl::onComponentAdded>(this);
+		m_universe.componentDestroyed().bind<&NavigationSceneImpl::onComponentDestroyed>(this);
 	}
 
 
 	~NavigationSceneImpl()
 	{
+		cancelTileRebuilds();
+		for (dtNavMeshQuery* query : m_path_queries) dtFreeNavMeshQuery(query);
 		m_universe.entityTransformed().unbind<&NavigationSceneImpl::onEntityMoved>(this);
+		m_universe.componentAdded().unbind<&NavigationSceneImpl::onComponentAdded>(this);
+		m_universe.componentDestroyed().unbind<&NavigationSceneImpl::onComponentDestroyed>(this);
 	}
 
 
 	void clear() override
 	{
+		cancelTileRebuilds();
+		m_path_requests.clear();
+		m_obstacles.clear();
+		m_pending_obstacles.clear();
 		for(RecastZone& zone : m_zones) {
 			clearNavmesh(zone);
 		}
 		m_agents.clear();
+		m_agent_map.clear();
 		m_zones.clear();
 	}
 
 
+	void onComponentAdded(const ComponentUID& cmp) {
+		if (!m_is_game_running) return;
+		if (cmp.type != MODEL_INSTANCE_TYPE) return;
+
+		// model is usually not loaded yet, it's registered in updateObstacles
+		m_pending_obstacles.push((EntityRef)cmp.entity);
+	}
+
+
+	void onComponentDestroyed(const ComponentUID& cmp) {
+		if (cmp.type != MODEL_INSTANCE_TYPE) return;
+
+		const EntityRef entity = (EntityRef)cmp.entity;
+		m_pending_obstacles.eraseItem(entity);
+		auto iter = m_obstacles.find(entity);
+		if (!iter.isValid()) return;
+
+		markDirtyTiles(iter.value());
+		m_obstacles.erase(iter);
+	}
+
+
+	void onObstacleMoved(EntityRef entity) {
+		auto iter = m_obstacles.find(entity);
+		if (!iter.isValid()) return;
+
+		// tiles at both the old and the new position are affected
+		Obstacle& obstacle = iter.value();
+		markDirtyTiles(obstacle);
+		obstacle.tr = m_universe.getTransform(entity);
+		markDirtyTiles(obstacle);
+	}
+
+
 	void onEntityMoved(EntityRef entity)
 	{
-		auto iter = m_agents.find(entity);
-		if (!iter.isValid()) return;
-		if (m_moving_agent == entity) return;
-		Agent& agent = iter.value();
+		if (m_is_moving_agents) return;
+		Agent* agent_ptr = findAgent(entity);
+		if (!agent_ptr) {
+			if (m_is_game_running) onObstacleMoved(entity);
+			return;
+		}
+		Agent& agent = *agent_ptr;
 		
 		if (agent.agent < 0) {
 			assignZone(agent);
@@ -127,7 +260,7 @@ struct NavigationSceneImpl final : NavigationScene
 		RecastZone& zone = m_zones[(EntityRef)agent.zone];
 		if (!zone.crowd) return;
 
-		const DVec3 agent_pos = m_universe.getPosition(iter.key());
+		const DVec3 agent_pos = m_universe.getPosition(entity);
 		const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
 		const Transform zone_tr = m_universe.getTransform((EntityRef)agent.zone);
 		const Vec3 pos = Vec3(zone_tr.inverted().transform(agent_pos));
@@ -136,8 +269,11 @@ struct NavigationSceneImpl final : NavigationScene
 			const DVec3 target_pos = old_zone_tr.transform(*(Vec3*)dt_agent->targetPos);
 			float speed = dt_agent->params.maxSpeed;
 			zone.crowd->removeAgent(agent.agent);
-			addCrowdAgent(iter.value(), zone);
-			if (!agent.is_finished) {
+			// agent could be teleported to streamed out tiles
+			if (zone.tile_cache) loadCachedTilesAround(zone, agent_pos);
+			addCrowdAgent(agent, zone);
+			// pending request already has the new target
+			if (!agent.is_finished && !agent.is_path_pending) {
 				navigate({entity.index}, target_pos, speed, agent.stop_distance);
 			}
 		}
@@ -151,12 +287,117 @@ struct NavigationSceneImpl final : NavigationScene
 		rcFreeHeightField(zone.debug_heightfield);
 		rcFreeContourSet(zone.debug_contours);
 		dtFreeCrowd(zone.crowd);
+		LUMIX_DELETE(m_allocator, zone.tile_cache);
 		zone.navquery = nullptr;
 		zone.navmesh = nullptr;
 		zone.debug_compact_heightfield = nullptr;
 		zone.debug_heightfield = nullptr;
 		zone.debug_contours = nullptr;
 		zone.crowd = nullptr;
+		zone.tile_cache = nullptr;
+	}
+
+
+	static bool compressTile(const u8* data, i32 size, NavTileCache::Tile& tile) {
+		tile.size = size;
+		tile.compressed.clear();
+		if (size == 0) return true;
+
+		tile.compressed.resize(LZ4_compressBound(size));
+		const i32 compressed_size = LZ4_compress_default((const char*)data, (char*)tile.compressed.begin(), size, tile.compressed.size());
+		if (compressed_size <= 0) {
+			logError("Could not compress navmesh tile.");
+			tile.size = 0;
+			tile.compressed.clear();
+			return false;
+		}
+		tile.compressed.resize(compressed_size);
+		return true;
+	}
+
+
+	// keeps cached copy in sync with tile changed in navmesh
+	void cacheTile(RecastZone& zone, i32 x, i32 z) {
+		if (!zone.tile_cache) return;
+
+		NavTileCache::Tile& tile = zone.tile_cache->tiles[x + z * zone.m_num_tiles_x];
+		const dtMeshTile* mesh_tile = zone.navmesh->getTileAt(x, z, 0);
+		const bool has_data = mesh_tile && mesh_tile->header;
+		compressTile(has_data ? mesh_tile->data : nullptr, has_data ? mesh_tile->dataSize : 0, tile);
+		tile.resident = has_data;
+		tile.idle_time = 0;
+	}
+
+
+	void loadCachedTile(RecastZone& zone, i32 x, i32 z) {
+		NavTileCache::Tile& tile = zone.tile_cache->tiles[x + z * zone.m_num_tiles_x];
+		tile.idle_time = 0;
+		if (tile.resident || tile.size == 0) return;
+
+		u8* data = (u8*)dtAlloc(tile.size, DT_ALLOC_PERM);
+		if (LZ4_decompress_safe((const char*)tile.compressed.begin(), (char*)data, tile.compressed.size(), tile.size) != tile.size) {
+			logError("Could not decompress navmesh tile, GUID ", zone.zone.guid);
+			dtFree(data);
+			return;
+		}
+		if (dtStatusFailed(zone.navmesh->addTile(data, tile.size, DT_TILE_FREE_DATA, 0, nullptr))) {
+			logError("Could not add Detour tile.");
+			dtFree(data);
+			return;
+		}
+		tile.resident = true;
+	}
+
+
+	void loadAllCachedTiles(RecastZone& zone) {
+		for (u32 z = 0; z < zone.m_num_tiles_z; ++z) {
+			for (u32 x = 0; x < zone.m_num_tiles_x; ++x) {
+				loadCachedTile(zone, x, z);
+			}
+		}
+	}
+
+
+	void loadCachedTilesAround(RecastZone& zone, const DVec3& world_pos) {
+		const Vec3 pos = Vec3(m_universe.getTransform(zone.entity).inverted().transform(world_pos));
+		const Vec3 min = -zone.zone.extents;
+		const float tile_size = CELLS_PER_TILE_SIDE * zone.zone.cell_size;
+		const i32 from_x = maximum(0, (i32)floorf((pos.x - min.x - m_tile_stream_distance) / tile_size));
+		const i32 from_z = maximum(0, (i32)floorf((pos.z - min.z - m_tile_stream_distance) / tile_size));
+		const i32 to_x = minimum((i32)zone.m_num_tiles_x - 1, (i32)floorf((pos.x - min.x + m_tile_stream_distance) / tile_size));
+		const i32 to_z = minimum((i32)zone.m_num_tiles_z - 1, (i32)floorf((pos.z - min.z + m_tile_stream_distance) / tile_size));
+		for (i32 z = from_z; z <= to_z; ++z) {
+			for (i32 x = from_x; x <= to_x; ++x) {
+				loadCachedTile(zone, x, z);
+			}
+		}
+	}
+
+
+	// tiles around agents and the active camera are decompressed into navmesh, tiles not needed for a while are removed
+	void streamTiles(RecastZone& zone, float time_delta) {
+		PROFILE_FUNCTION();
+		for (NavTileCache::Tile& tile : zone.tile_cache->tiles) {
+			if (tile.resident) tile.idle_time += time_delta;
+		}
+
+		for (const Agent& agent : m_agents) {
+			if (agent.zone == zone.entity) loadCachedTilesAround(zone, m_universe.getPosition(agent.entity));
+		}
+		auto* render_scene = static_cast<RenderScene*>(m_universe.getScene("renderer"));
+		const EntityPtr camera = render_scene ? render_scene->getActiveCamera() : INVALID_ENTITY;
+		if (camera.isValid()) loadCachedTilesAround(zone, m_universe.getPosition((EntityRef)camera));
+
+		for (u32 z = 0; z < zone.m_num_tiles_z; ++z) {
+			for (u32 x = 0; x < zone.m_num_tiles_x; ++x) {
+				NavTileCache::Tile& tile = zone.tile_cache->tiles[x + z * zone.m_num_tiles_x];
+				if (!tile.resident || tile.idle_time < NAV_TILE_TIMEOUT) continue;
+
+				// navmesh owns the data, DT_TILE_FREE_DATA
+				zone.navmesh->removeTile(zone.navmesh->getTileRefAt(x, z, 0), nullptr, nullptr);
+				tile.resident = false;
+			}
+		}
 	}
 
 
@@ -244,7 +485,8 @@ struct NavigationSceneImpl final : NavigationScene
 		if (!model_aabb.overlaps(zone_aabb)) return;;
 		const float walkable_threshold = cosf(degreesToRadians(45));
 
-		auto lod = model->getLODIndices()[0];
+		// streamed models contribute their finest resident lod
+		auto lod = model->getLODIndices()[model->getResidentLOD()];
 		for (int mesh_idx = lod.from; mesh_idx <= lod.to; ++mesh_idx) {
 			Mesh& mesh = model->getMesh(mesh_idx);
 			bool is16 = mesh.areIndices16();
@@ -355,33 +597,45 @@ struct NavigationSceneImpl final : NavigationScene
 
 	bool isFinished(EntityRef entity) override
 	{
-		return m_agents[entity].is_finished;
+		return getAgent(entity).is_finished;
 	}
 
 
 	float getAgentSpeed(EntityRef entity) override
 	{
-		return m_agents[entity].speed;
+		return getAgent(entity).speed;
 	}
 
 
 	float getAgentYawDiff(EntityRef entity) override
 	{
-		return m_agents[entity].yaw_diff;
+		return getAgent(entity).yaw_diff;
 	}
 
 
+	Agent& getAgent(EntityRef entity) { return m_agents[m_agent_map[entity]]; }
+
+	Agent* findAgent(EntityRef entity) {
+		auto iter = m_agent_map.find(entity);
+		return iter.isValid() ? &m_agents[iter.value()] : nullptr;
+	}
+
+	// agent of crowd's slot, userData is set in addCrowdAgent
+	Agent& getAgent(const dtCrowdAgent& dt_agent) {
+		return getAgent(EntityRef{(i32)(intptr_t)dt_agent.params.userData});
+	}
+
+	// runs in parallel with other zones, it must not write to the universe
 	void update(RecastZone& zone, float time_delta) {
-		if (!zone.crowd) return;
+		PROFILE_FUNCTION();
 		zone.crowd->update(time_delta, nullptr);
 
-		for (auto& agent : m_agents) {
-			if (agent.agent < 0) continue;
-			if (agent.zone != zone.entity) continue;
-			
-			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
+		for (i32 i = 0, c = zone.crowd->getAgentCount(); i < c; ++i) {
+			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(i);
+			if (!dt_agent->active) continue;
 			//if (dt_agent->paused) continue;
 
+			Agent& agent = getAgent(*dt_agent);
 			const Quat rot = m_universe.getRotation(agent.entity);
 
 			const Vec3 velocity = *(Vec3*)dt_agent->nvel;
@@ -395,32 +649,168 @@ struct NavigationSceneImpl final : NavigationScene
 		}
 	}
 
+	SceneUpdateAccess getUpdateAccess() const override {
+		// lateUpdate moves agents and calls onPathFinished in scripts
+		return {true, SceneUpdateAccess::TRANSFORMS, SceneUpdateAccess::TRANSFORMS | SceneUpdateAccess::SCRIPTS};
+	}
+
+	// zones' crowds are independent, so they are updated in parallel
+	void gatherCrowds() {
+		m_crowd_zones.clear();
+		for (RecastZone& zone : m_zones) {
+			if (zone.crowd) m_crowd_zones.push(&zone);
+		}
+	}
+
+	void markDirtyTiles(const Obstacle& obstacle) {
+		for (RecastZone& zone : m_zones) {
+			if (!zone.navmesh) continue;
+
+			const Transform rel_tr = m_universe.getTransform(zone.entity).inverted() * obstacle.tr;
+			Matrix mtx = rel_tr.rot.toMatrix();
+			mtx.setTranslation(Vec3(rel_tr.pos));
+			mtx.multiply3x3(rel_tr.scale);
+			AABB aabb = obstacle.aabb;
+			aabb.transform(mtx);
+			const Vec3 min = -zone.zone.extents;
+			if (!aabb.overlaps(AABB(min, zone.zone.extents))) continue;
+
+			// neighbours see the obstacle in their borders
+			const float tile_size = CELLS_PER_TILE_SIDE * zone.zone.cell_size;
+			const float border = (1 + zone.getBorderSize()) * zone.zone.cell_size;
+			const i32 from_x = maximum(0, (i32)floorf((aabb.min.x - min.x - border) / tile_size));
+			const i32 from_z = maximum(0, (i32)floorf((aabb.min.z - min.z - border) / tile_size));
+			const i32 to_x = minimum((i32)zone.m_num_tiles_x - 1, (i32)floorf((aabb.max.x - min.x + border) / tile_size));
+			const i32 to_z = minimum((i32)zone.m_num_tiles_z - 1, (i32)floorf((aabb.max.z - min.z + border) / tile_size));
+			for (i32 z = from_z; z <= to_z; ++z) {
+				for (i32 x = from_x; x <= to_x; ++x) {
+					const i32 idx = m_dirty_tiles.find([&](const DirtyTile& tile){
+						return tile.zone == zone.entity && tile.x == x && tile.z == z;
+					});
+					if (idx < 0) m_dirty_tiles.push({zone.entity, x, z});
+				}
+			}
+		}
+	}
+
+
+	// registers models created while game is running, once they are loaded
+	void updateObstacles() {
+		if (m_pending_obstacles.empty()) return;
+
+		auto* render_scene = static_cast<RenderScene*>(m_universe.getScene("renderer"));
+		for (i32 i = m_pending_obstacles.size() - 1; i >= 0; --i) {
+			const EntityRef entity = m_pending_obstacles[i];
+			Model* model = render_scene->getModelInstanceModel(entity);
+			if (model && !model->isReady() && !model->isFailure()) continue;
+
+			m_pending_obstacles.swapAndPop(i);
+			if (!model || model->isFailure() || m_agent_map.find(entity).isValid()) continue;
+
+			Obstacle obstacle;
+			obstacle.tr = m_universe.getTransform(entity);
+			obstacle.aabb = model->getAABB();
+			m_obstacles.insert(entity, obstacle);
+			markDirtyTiles(obstacle);
+		}
+	}
+
+
+	void cancelTileRebuilds() {
+		jobs::wait(&m_tile_rebuild_signal);
+		for (TileRebuild& rebuild : m_tile_rebuilds) {
+			dtFree(rebuild.data);
+		}
+		m_tile_rebuilds.clear();
+		m_dirty_tiles.clear();
+	}
+
+
+	// dirty tiles are built in background, finished tiles are swapped in here, when crowds are not updated
+	void updateTileRebuilds() {
+		PROFILE_FUNCTION();
+		if (m_tile_rebuilds_running > 0) return;
+
+		for (TileRebuild& rebuild : m_tile_rebuilds) {
+			auto iter = m_zones.find(rebuild.zone.entity);
+			// navmesh was regenerated, reloaded or destroyed in the meantime
+			const bool is_valid = iter.isValid() && iter.value().navmesh == rebuild.zone.navmesh;
+			if (is_valid && rebuild.state == TileRebuild::State::BUILT) {
+				dtNavMesh* navmesh = rebuild.zone.navmesh;
+				navmesh->removeTile(navmesh->getTileRefAt(rebuild.x, rebuild.z, 0), 0, 0);
+				if (rebuild.data && dtStatusFailed(navmesh->addTile(rebuild.data, rebuild.data_size, DT_TILE_FREE_DATA, 0, nullptr))) {
+					logError("Could not add Detour tile.");
+					dtFree(rebuild.data);
+				}
+				cacheTile(iter.value(), rebuild.x, rebuild.z);
+				continue;
+			}
+
+			dtFree(rebuild.data);
+			if (is_valid && rebuild.state == TileRebuild::State::SKIPPED) {
+				m_dirty_tiles.push({rebuild.zone.entity, rebuild.x, rebuild.z});
+			}
+		}
+		m_tile_rebuilds.clear();
+
+		const i32 count = minimum(m_dirty_tiles.size(), MAX_TILE_REBUILDS);
+		for (i32 i = 0; i < count; ++i) {
+			const DirtyTile tile = m_dirty_tiles.last();
+			m_dirty_tiles.pop();
+			auto iter = m_zones.find(tile.zone);
+			if (!iter.isValid() || !iter.value().navmesh) continue;
+
+			TileRebuild& rebuild = m_tile_rebuilds.emplace();
+			rebuild.zone = iter.value();
+			rebuild.x = tile.x;
+			rebuild.z = tile.z;
+		}
+
+		m_tile_rebuild_timer.tick();
+		m_tile_rebuilds_running = m_tile_rebuilds.size();
+		for (i32 i = 0; i < m_tile_rebuilds.size(); ++i) {
+			jobs::runLambda([this, i](){
+				TileRebuild& rebuild = m_tile_rebuilds[i];
+				// first tile is always built, so rebuilding progresses even if workers are busy
+				if (i == 0 || m_tile_rebuild_timer.getTimeSinceTick() < m_tile_rebuild_budget) {
+					const bool built = buildTile(rebuild.zone, rebuild.zone.entity, rebuild.x, rebuild.z, false, rebuild.data, rebuild.data_size);
+					rebuild.state = built ? TileRebuild::State::BUILT : TileRebuild::State::FAILED;
+				}
+				atomicDecrement(&m_tile_rebuilds_running);
+			}, &m_tile_rebuild_signal, jobs::ANY_WORKER, jobs::Priority::BACKGROUND);
+		}
+	}
+
+
 	void update(float time_delta, bool paused) override {
 		PROFILE_FUNCTION();
 		if (paused) return;
 		if (!m_is_game_running) return;
-		
+
+		updateObstacles();
+		updateTileRebuilds();
 		for (RecastZone& zone : m_zones) {
-			update(zone, time_delta);
+			if (zone.tile_cache) streamTiles(zone, time_delta);
 		}
+		updatePathRequests();
+
+		gatherCrowds();
+		jobs::forEach(m_crowd_zones.size(), 1, [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) update(*m_crowd_zones[i], time_delta);
+		});
 	}
 
 	void lateUpdate(RecastZone& zone, float time_delta) {
-		if (!zone.crowd) return;
-		
 		const Transform zone_tr = m_universe.getTransform(zone.entity);
+		const Transform inv_zone_tr = zone_tr.inverted();
 
-		zone.crowd->doMove(time_delta);
-
-		for (auto& agent : m_agents) {
-			if (agent.agent < 0) continue;
-			if (agent.zone != zone.entity) continue;
-
-			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
+		for (i32 i = 0, c = zone.crowd->getAgentCount(); i < c; ++i) {
+			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(i);
+			if (!dt_agent->active) continue;
 			//if (dt_agent->paused) continue;
 
+			Agent& agent = getAgent(*dt_agent);
 			if (agent.flags & Agent::MOVE_ENTITY) {
-				m_moving_agent = agent.entity;
 				m_universe.setPosition(agent.entity, zone_tr.transform(*(Vec3*)dt_agent->npos));
 
 				Vec3 vel = *(Vec3*)dt_agent->nvel;
@@ -436,14 +826,17 @@ struct NavigationSceneImpl final : NavigationScene
 				}
 			}
 			else {
-				*(Vec3*)dt_agent->npos = Vec3(zone_tr.inverted().transform(m_universe.getPosition(agent.entity)));
+				*(Vec3*)dt_agent->npos = Vec3(inv_zone_tr.transform(m_universe.getPosition(agent.entity)));
 			}
 
+			// new target is waiting for its path
+			if (agent.is_path_pending) continue;
+
 			if (dt_agent->ncorners == 0 && dt_agent->targetState != DT_CROWDAGENT_TARGET_REQUESTING) {
 				if (!agent.is_finished) {
 					zone.crowd->resetMoveTarget(agent.agent);
 					agent.is_finished = true;
-					onPathFinished(agent);
+					m_finished_agents.push(agent.entity);
 				}
 			}
 			else if (dt_agent->ncorners == 1 && agent.stop_distance > 0) {
@@ -451,13 +844,12 @@ struct NavigationSceneImpl final : NavigationScene
 				if (squaredLength(diff) < agent.stop_distance * agent.stop_distance) {
 					zone.crowd->resetMoveTarget(agent.agent);
 					agent.is_finished = true;
-					onPathFinished(agent);
+					m_finished_agents.push(agent.entity);
 				}
 			}
 			else {
 				agent.is_finished = false;
 			}
-			m_moving_agent = INVALID_ENTITY;
 		}
 	}
 
@@ -466,9 +858,28 @@ struct NavigationSceneImpl final : NavigationScene
 		if (paused) return;
 		if (!m_is_game_running) return;
 
-		for (RecastZone& zone : m_zones) {
-			lateUpdate(zone, time_delta);
+		gatherCrowds();
+		jobs::forEach(m_crowd_zones.size(), 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("doMove");
+			for (i32 i = from; i < to; ++i) m_crowd_zones[i]->crowd->doMove(time_delta);
+		});
+
+		// hierarchies are propagated once for all agents
+		const bool was_deferred = m_universe.areTransformsDeferred();
+		m_universe.setTransformsDeferred(true);
+		for (RecastZone* zone : m_crowd_zones) {
+			lateUpdate(*zone, time_delta);
 		}
+		m_is_moving_agents = true;
+		m_universe.flushTransforms();
+		m_is_moving_agents = false;
+		m_universe.setTransformsDeferred(was_deferred);
+
+		// scripts run after all agents are moved, they can destroy agents
+		for (EntityRef e : m_finished_agents) {
+			if (Agent* agent = findAgent(e)) onPathFinished(*agent);
+		}
+		m_finished_agents.clear();
 	}
 
 	static float distancePtLine2d(const float* pt, const float* p, const float* q)
@@ -531,10 +942,10 @@ struct NavigationSceneImpl final : NavigationScene
 
 	const dtCrowdAgent* getDetourAgent(EntityRef entity) override
 	{
-		auto iter = m_agents.find(entity);
-		if (!iter.isValid()) return nullptr;
+		const Agent* agent_ptr = findAgent(entity);
+		if (!agent_ptr) return nullptr;
 		
-		const Agent& agent = iter.value();
+		const Agent& agent = *agent_ptr;
 		if (agent.agent < 0) return nullptr;
 		if (!agent.zone.isValid()) return nullptr;
 
@@ -554,10 +965,10 @@ struct NavigationSceneImpl final : NavigationScene
 		auto render_scene = static_cast<RenderScene*>(m_universe.getScene("renderer"));
 		if (!render_scene) return;
 		
-		auto agent_iter = m_agents.find(entity);
-		if (!agent_iter.isValid()) return;
+		const Agent* agent_ptr = findAgent(entity);
+		if (!agent_ptr) return;
 
-		const Agent& agent = agent_iter.value();
+		const Agent& agent = *agent_ptr;
 		if (agent.agent < 0) return;
 
 		const RecastZone& zone = m_zones[(EntityRef)agent.zone];
@@ -655,6 +1066,14 @@ struct NavigationSceneImpl final : NavigationScene
 			}
 
 			InputMemoryStream file(mem, size);
+			const u32 magic = file.read<u32>();
+			if (magic == NAV_FILE_MAGIC) {
+				loadCompressed(zone, file);
+				LUMIX_DELETE(scene.m_allocator, this);
+				return;
+			}
+
+			file.rewind();
 			file.read(zone.m_num_tiles_x);
 			file.read(zone.m_num_tiles_z);
 			dtNavMeshParams params;
@@ -683,6 +1102,38 @@ struct NavigationSceneImpl final : NavigationScene
 			LUMIX_DELETE(scene.m_allocator, this);
 		}
 
+		void loadCompressed(RecastZone& zone, InputMemoryStream& file) {
+			const NavFileVersion version = (NavFileVersion)file.read<u32>();
+			if (version > NavFileVersion::LATEST) {
+				logError("Unsupported navmesh version, GUID ", zone.zone.guid);
+				return;
+			}
+
+			file.read(zone.m_num_tiles_x);
+			file.read(zone.m_num_tiles_z);
+			dtNavMeshParams params;
+			file.read(&params, sizeof(params));
+			if (dtStatusFailed(zone.navmesh->init(&params))) {
+				logError("Could not init Detour navmesh");
+				return;
+			}
+
+			zone.tile_cache = LUMIX_NEW(scene.m_allocator, NavTileCache)(scene.m_allocator);
+			zone.tile_cache->tiles.reserve(zone.m_num_tiles_x * zone.m_num_tiles_z);
+			for (u32 i = 0, c = zone.m_num_tiles_x * zone.m_num_tiles_z; i < c; ++i) {
+				NavTileCache::Tile& tile = zone.tile_cache->tiles.emplace(scene.m_allocator);
+				file.read(tile.size);
+				tile.compressed.resize(file.read<i32>());
+				file.read(tile.compressed.begin(), tile.compressed.byte_size());
+			}
+
+			// in game, only tiles around agents are needed, so they can be placed on the navmesh
+			if (scene.m_is_game_running) scene.streamTiles(zone, 0);
+			else scene.loadAllCachedTiles(zone);
+
+			if (!zone.crowd) scene.initCrowd(zone);
+		}
+
 		NavigationSceneImpl& scene;
 		EntityRef entity;
 	};
@@ -708,15 +1159,26 @@ struct NavigationSceneImpl final : NavigationScene
 		StaticString<LUMIX_MAX_PATH> path("universes/navzones/", zone.zone.guid, ".nav");
 		if (!fs.open(path, file)) return false;
 
-		bool success = file.write(zone.m_num_tiles_x);
+		bool success = file.write(NAV_FILE_MAGIC);
+		success = success && file.write((u32)NavFileVersion::LATEST);
+		success = success && file.write(zone.m_num_tiles_x);
 		success = success && file.write(zone.m_num_tiles_z);
 		const dtNavMeshParams* params = zone.navmesh->getParams();
 		success = success && file.write(params, sizeof(*params));
+		NavTileCache::Tile tmp(m_allocator);
 		for (u32 j = 0; j < zone.m_num_tiles_z; ++j) {
 			for (u32 i = 0; i < zone.m_num_tiles_x; ++i) {
-				const auto* tile = zone.navmesh->getTileAt(i, j, 0);
-				success = success && file.write(&tile->dataSize, sizeof(tile->dataSize));
-				success = success && file.write(tile->data, tile->dataSize);
+				// tiles streamed out are saved as they are in the cache
+				const NavTileCache::Tile* tile = zone.tile_cache ? &zone.tile_cache->tiles[i + j * zone.m_num_tiles_x] : nullptr;
+				if (!tile || tile->resident) {
+					const dtMeshTile* mesh_tile = zone.navmesh->getTileAt(i, j, 0);
+					const bool has_data = mesh_tile && mesh_tile->header;
+					compressTile(has_data ? mesh_tile->data : nullptr, has_data ? mesh_tile->dataSize : 0, tmp);
+					tile = &tmp;
+				}
+				success = success && file.write(tile->size);
+				success = success && file.write(tile->compressed.size());
+				success = success && file.write(tile->compressed.begin(), tile->compressed.byte_size());
 			}
 		}
 
@@ -954,6 +1416,14 @@ struct NavigationSceneImpl final : NavigationScene
 	void stopGame() override
 	{
 		m_is_game_running = false;
+		cancelTileRebuilds();
+		m_path_requests.clear();
+		for (Agent& agent : m_agents) agent.is_path_pending = false;
+		for (RecastZone& zone : m_zones) {
+			if (zone.tile_cache) loadAllCachedTiles(zone);
+		}
+		m_obstacles.clear();
+		m_pending_obstacles.clear();
 		for (RecastZone& zone : m_zones) {
 			if (zone.crowd) {
 				for (Agent& agent : m_agents) {
@@ -978,6 +1448,26 @@ struct NavigationSceneImpl final : NavigationScene
 		for (RecastZone& zone : m_zones) {
 			if (zone.navmesh && !zone.crowd) initCrowd(zone);
 		}
+
+		// existing models are already in navmesh, tiles are rebuilt only when they move
+		auto* render_scene = static_cast<RenderScene*>(m_universe.getScene("renderer"));
+		if (!render_scene || m_zones.empty()) return;
+		for (EntityPtr e = render_scene->getFirstModelInstance(); e.isValid(); e = render_scene->getNextModelInstance(e)) {
+			const EntityRef entity = (EntityRef)e;
+			if (m_agent_map.find(entity).isValid()) continue;
+
+			Model* model = render_scene->getModelInstanceModel(entity);
+			if (!model) continue;
+			if (!model->isReady()) {
+				m_pending_obstacles.push(entity);
+				continue;
+			}
+
+			Obstacle obstacle;
+			obstacle.tr = m_universe.getTransform(entity);
+			obstacle.aabb = model->getAABB();
+			m_obstacles.insert(entity, obstacle);
+		}
 	}
 
 
@@ -995,8 +1485,7 @@ struct NavigationSceneImpl final : NavigationScene
 		const Vec3 min = -zone.zone.extents;
 		const Vec3 max = zone.zone.extents;
 
-		for (auto iter = m_agents.begin(), end = m_agents.end(); iter != end; ++iter) {
-			Agent& agent = iter.value();
+		for (Agent& agent : m_agents) {
 			if (agent.zone.isValid() && agent.agent >= 0) continue;
 
 			const Vec3 pos = Vec3(inv_zone_tr.transform(m_universe.getPosition(agent.entity)));
@@ -1016,10 +1505,10 @@ struct NavigationSceneImpl final : NavigationScene
 	}
 
 	void cancelNavigation(EntityRef entity) override {
-		auto iter = m_agents.find(entity);
-		if (iter == m_agents.end()) return;
+		Agent* agent_ptr = findAgent(entity);
+		if (!agent_ptr) return;
 
-		Agent& agent = iter.value();
+		Agent& agent = *agent_ptr;
 		if (agent.agent < 0) return;
 		
 		RecastZone* zone = getZone(agent);
@@ -1027,6 +1516,7 @@ struct NavigationSceneImpl final : NavigationScene
 		if (zone) {
 			zone->crowd->resetMoveTarget(agent.agent);
 		}
+		agent.is_path_pending = false;
 	}
 
 
@@ -1048,10 +1538,10 @@ struct NavigationSceneImpl final : NavigationScene
 
 	bool navigate(EntityRef entity, const DVec3& world_dest, float speed, float stop_distance) override
 	{
-		auto iter = m_agents.find(entity);
-		if (iter == m_agents.end()) return false;
+		Agent* agent_ptr = findAgent(entity);
+		if (!agent_ptr) return false;
 		
-		Agent& agent = iter.value();
+		Agent& agent = *agent_ptr;
 		if (agent.agent < 0) return false;
 		if (!agent.zone.isValid()) return false;
 
@@ -1071,15 +1561,111 @@ struct NavigationSceneImpl final : NavigationScene
 		dtCrowdAgentParams params = zone.crowd->getAgent(agent.agent)->params;
 		params.maxSpeed = speed;
 		zone.crowd->updateAgentParameters(agent.agent, &params);
-		if (zone.crowd->requestMoveTarget(agent.agent, end_poly_ref, &dest.x)) {
-			agent.stop_distance = stop_distance;
-			agent.is_finished = false;
-		}
-		else {
+		if (!end_poly_ref) {
 			logError("requestMoveTarget failed");
 			agent.is_finished = true;
+			return false;
+		}
+
+		// path is found in updatePathRequests, agent keeps its current target until then
+		const i32 idx = m_path_requests.find([&](const PathRequest& req){ return req.entity == entity; });
+		PathRequest& req = idx < 0 ? m_path_requests.emplace() : m_path_requests[idx];
+		req.entity = entity;
+		req.priority = agent.path_priority;
+		req.end_ref = end_poly_ref;
+		req.end_pos = dest;
+		agent.stop_distance = stop_distance;
+		agent.is_finished = false;
+		agent.is_path_pending = true;
+		return true;
+	}
+
+
+	void findPath(dtNavMeshQuery& query, const PathRequest& req) {
+		dtCrowd* crowd = req.zone->crowd;
+		dtCrowdAgent* ag = crowd->getEditableAgent(req.agent);
+		if (query.getAttachedNavMesh() != req.zone->navmesh) query.init(req.zone->navmesh, 2048);
+
+		dtPolyRef path[MAX_PATH_POLYS];
+		i32 path_count = 0;
+		const dtQueryFilter* filter = crowd->getFilter(ag->params.queryFilterType);
+		const dtPolyRef start_ref = ag->corridor.getFirstPoly();
+		const dtStatus status = query.findPath(start_ref, req.end_ref, ag->npos, &req.end_pos.x, filter, path, &path_count, MAX_PATH_POLYS);
+		if (!start_ref || dtStatusFailed(status) || path_count == 0) {
+			ag->targetRef = 0;
+			ag->targetState = DT_CROWDAGENT_TARGET_FAILED;
+			return;
+		}
+
+		// same as in dtCrowd, partial path ends at the closest point to the target
+		Vec3 target = req.end_pos;
+		if (path[path_count - 1] != req.end_ref) {
+			query.closestPointOnPoly(path[path_count - 1], &req.end_pos.x, &target.x, nullptr);
+		}
+
+		ag->corridor.setCorridor(&target.x, path, path_count);
+		ag->boundary.reset();
+		ag->targetRef = path[path_count - 1];
+		*(Vec3*)ag->targetPos = target;
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = false;
+		ag->targetReplanTime = 0;
+		ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+	}
+
+
+	// queued paths are found by all workers, each with its own query, until the time budget runs out
+	// agents are independent, so the corridors are set directly from the workers
+	void updatePathRequests() {
+		PROFILE_FUNCTION();
+		if (m_path_requests.empty()) return;
+
+		for (i32 i = m_path_requests.size() - 1; i >= 0; --i) {
+			PathRequest& req = m_path_requests[i];
+			const Agent* agent = findAgent(req.entity);
+			RecastZone* zone = agent ? getZone(*agent) : nullptr;
+			if (!zone || !zone->crowd || agent->agent < 0 || !agent->is_path_pending) {
+				m_path_requests.swapAndPop(i);
+				continue;
+			}
+			req.zone = zone;
+			req.agent = agent->agent;
+		}
+
+		qsort(m_path_requests.begin(), m_path_requests.size(), sizeof(PathRequest), [](const void* a, const void* b){
+			const i32 pa = ((const PathRequest*)a)->priority;
+			const i32 pb = ((const PathRequest*)b)->priority;
+			return pa > pb ? -1 : (pa < pb ? 1 : 0);
+		});
+
+		if (m_path_queries.empty()) {
+			for (u8 i = 0; i < jobs::getWorkersCount(); ++i) m_path_queries.push(dtAllocNavMeshQuery());
+		}
+
+		const i32 count = m_path_requests.size();
+		volatile i32 worker_counter = 0;
+		volatile i32 next = 0;
+		os::Timer timer;
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("find paths");
+			dtNavMeshQuery& query = *m_path_queries[atomicIncrement(&worker_counter) - 1];
+			for (;;) {
+				// at least one path is found each frame
+				if (next > 0 && timer.getTimeSinceStart() > m_path_query_budget) break;
+				const i32 idx = atomicIncrement(&next) - 1;
+				if (idx >= count) break;
+				findPath(query, m_path_requests[idx]);
+			}
+		});
+
+		const i32 processed = minimum(next, count);
+		for (i32 i = 0; i < processed; ++i) {
+			getAgent(m_path_requests[i].entity).is_path_pending = false;
+		}
+		for (i32 i = processed; i < count; ++i) {
+			m_path_requests[i - processed] = m_path_requests[i];
 		}
-		return !agent.is_finished;
+		m_path_requests.resize(count - processed);
 	}
 
 	bool generateTileAt(EntityRef zone_entity, const DVec3& world_pos, bool keep_data) override {
@@ -1094,10 +1680,29 @@ struct NavigationSceneImpl final : NavigationScene
 		zone.navmesh->removeTile(zone.navmesh->getTileRefAt(x, z, 0), 0, 0);
 
 		Mutex mutex;
-		return generateTile(zone, zone_entity, x, z, keep_data, mutex);
+		const bool res = generateTile(zone, zone_entity, x, z, keep_data, mutex);
+		cacheTile(zone, x, z);
+		return res;
 	}
 
 	bool generateTile(RecastZone& zone, EntityRef zone_entity, int x, int z, bool keep_data, Mutex& mutex) {
+		u8* data = nullptr;
+		i32 data_size = 0;
+		if (!buildTile(zone, zone_entity, x, z, keep_data, data, data_size)) return false;
+		// no geometry in tile
+		if (!data) return true;
+
+		MutexGuard guard(mutex);
+		if (dtStatusFailed(zone.navmesh->addTile(data, data_size, DT_TILE_FREE_DATA, 0, nullptr))) {
+			logError("Could not add Detour tile.");
+			dtFree(data);
+			return false;
+		}
+		return true;
+	}
+
+	// does not touch zone's navmesh, data is null if there's no geometry in the tile
+	bool buildTile(RecastZone& zone, EntityRef zone_entity, int x, int z, bool keep_data, u8*& data, i32& data_size) {
 		PROFILE_FUNCTION();
 		// TODO some stuff leaks on errors
 		ASSERT(zone.navmesh);
@@ -1259,7 +1864,6 @@ struct NavigationSceneImpl final : NavigationScene
 		params.ch = config.ch;
 		params.buildBvTree = false;
 
-		MutexGuard guard(mutex);
 		if (!dtCreateNavMeshData(&params, &nav_data, &nav_data_size)) {
 			if (polymesh->npolys == 0) {
 				// no geometry in tile
@@ -1274,11 +1878,8 @@ struct NavigationSceneImpl final : NavigationScene
 		rcFreePolyMesh(polymesh);
 		if (detail_mesh) rcFreePolyMeshDetail(detail_mesh);
 
-		if (dtStatusFailed(zone.navmesh->addTile(nav_data, nav_data_size, DT_TILE_FREE_DATA, 0, nullptr))) {
-			logError("Could not add Detour tile.");
-			return false;
-		}
-
+		data = nav_data;
+		data_size = nav_data_size;
 		return true;
 	}
 
@@ -1337,7 +1938,7 @@ struct NavigationSceneImpl final : NavigationScene
 				}
 
 				pushJob();
-			}, &signal);
+			}, &signal, jobs::ANY_WORKER, jobs::Priority::BACKGROUND);
 		}
 
 		void run() {
@@ -1413,6 +2014,7 @@ struct NavigationSceneImpl final : NavigationScene
 		params.maxSpeed = 10.0f;
 		params.collisionQueryRange = params.radius * 12.0f;
 		params.pathOptimizationRange = params.radius * 30.0f;
+		params.userData = (void*)(intptr_t)agent.entity.index;
 		params.updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_SEPARATION | DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_OPTIMIZE_TOPO | DT_CROWD_OPTIMIZE_VIS;
 		agent.agent = zone.crowd->addAgent(&pos.x, &params);
 		if (agent.agent < 0) {
@@ -1446,6 +2048,7 @@ struct NavigationSceneImpl final : NavigationScene
 			dtFreeCrowd(zone.crowd);
 		}
 
+		LUMIX_DELETE(m_allocator, zone.tile_cache);
 		m_zones.erase(iter);
 		m_universe.onComponentDestroyed(entity, NAVMESH_ZONE_TYPE, this);
 	}
@@ -1476,19 +2079,23 @@ struct NavigationSceneImpl final : NavigationScene
 		agent.agent = -1;
 		agent.flags = Agent::MOVE_ENTITY;
 		agent.is_finished = true;
-		m_agents.insert(entity, agent);
 		assignZone(agent);
+		m_agent_map.insert(entity, m_agents.size());
+		m_agents.push(agent);
 		m_universe.onComponentCreated(entity, NAVMESH_AGENT_TYPE, this);
 	}
 
 	void destroyAgent(EntityRef entity) {
-		auto iter = m_agents.find(entity);
-		const Agent& agent = iter.value();
+		const u32 idx = m_agent_map[entity];
+		const Agent& agent = m_agents[idx];
 		if (agent.zone.isValid()) {
 			RecastZone& zone = m_zones[(EntityRef)agent.zone];
 			if (zone.crowd && agent.agent >= 0) zone.crowd->removeAgent(agent.agent);
-			m_agents.erase(iter);
 		}
+		// crowd agents reference agents by entity, so moving the last one is safe
+		m_agent_map[m_agents.back().entity] = idx;
+		m_agent_map.erase(entity);
+		m_agents.swapAndPop(idx);
 		m_universe.onComponentDestroyed(entity, NAVMESH_AGENT_TYPE, this);
 	}
 
@@ -1515,11 +2122,12 @@ struct NavigationSceneImpl final : NavigationScene
 
 		count = m_agents.size();
 		serializer.write(count);
-		for (auto iter = m_agents.begin(), end = m_agents.end(); iter != end; ++iter) {
-			serializer.write(iter.key());
-			serializer.write(iter.value().radius);
-			serializer.write(iter.value().height);
-			serializer.write(iter.value().flags);
+		for (const Agent& agent : m_agents) {
+			serializer.write(agent.entity);
+			serializer.write(agent.radius);
+			serializer.write(agent.height);
+			serializer.write(agent.flags);
+			serializer.write(agent.path_priority);
 		}
 	}
 
@@ -1566,6 +2174,7 @@ struct NavigationSceneImpl final : NavigationScene
 
 		serializer.read(count);
 		m_agents.reserve(count + m_agents.size());
+		m_agent_map.reserve(count + m_agent_map.size());
 		for (u32 i = 0; i < count; ++i) {
 			Agent agent;
 			serializer.read(agent.entity);
@@ -1573,10 +2182,14 @@ struct NavigationSceneImpl final : NavigationScene
 			serializer.read(agent.radius);
 			serializer.read(agent.height);
 			serializer.read(agent.flags);
+			if (version > (i32)NavigationSceneVersion::PATH_PRIORITY) {
+				serializer.read(agent.path_priority);
+			}
 			agent.is_finished = true;
 			agent.agent = -1;
 			assignZone(agent);
-			m_agents.insert(agent.entity, agent);
+			m_agent_map.insert(agent.entity, m_agents.size());
+			m_agents.push(agent);
 			m_universe.onComponentCreated(agent.entity, NAVMESH_AGENT_TYPE, this);
 		}
 	}
@@ -1584,40 +2197,52 @@ struct NavigationSceneImpl final : NavigationScene
 
 	bool getAgentMoveEntity(EntityRef entity) override
 	{
-		return (m_agents[entity].flags & Agent::MOVE_ENTITY) != 0;
+		return (getAgent(entity).flags & Agent::MOVE_ENTITY) != 0;
 	}
 
 
 	void setAgentMoveEntity(EntityRef entity, bool value) override
 	{
 		if (value)
-			m_agents[entity].flags |= Agent::MOVE_ENTITY;
+			getAgent(entity).flags |= Agent::MOVE_ENTITY;
 		else
-			m_agents[entity].flags &= ~Agent::MOVE_ENTITY;
+			getAgent(entity).flags &= ~Agent::MOVE_ENTITY;
+	}
+
+
+	i32 getAgentPathPriority(EntityRef entity) override
+	{
+		return getAgent(entity).path_priority;
+	}
+
+
+	void setAgentPathPriority(EntityRef entity, i32 value) override
+	{
+		getAgent(entity).path_priority = value;
 	}
 
 
 	void setAgentRadius(EntityRef entity, float radius) override
 	{
-		m_agents[entity].radius = radius;
+		getAgent(entity).radius = radius;
 	}
 
 
 	float getAgentRadius(EntityRef entity) override
 	{
-		return m_agents[entity].radius;
+		return getAgent(entity).radius;
 	}
 
 
 	void setAgentHeight(EntityRef entity, float height) override
 	{
-		m_agents[entity].height = height;
+		getAgent(entity).height = height;
 	}
 
 
 	float getAgentHeight(EntityRef entity) override
 	{
-		return m_agents[entity].height;
+		return getAgent(entity).height;
 	}
 	
 	NavmeshZone& getZone(EntityRef entity) override {
@@ -1650,9 +2275,32 @@ struct NavigationSceneImpl final : NavigationScene
 	IPlugin& m_system;
 	Engine& m_engine;
 	HashMap<EntityRef, RecastZone> m_zones;
-	HashMap<EntityRef, Agent> m_agents;
-	EntityPtr m_moving_agent = INVALID_ENTITY;
+	// dense, so per-frame loops over agents are linear, kept compact with swap-and-pop
+	Array<Agent> m_agents;
+	HashMap<EntityRef, u32> m_agent_map;
+	// agents' transforms are being set from their crowds
+	bool m_is_moving_agents = false;
+	Array<RecastZone*> m_crowd_zones;
+	// path finished in lateUpdate, scripts are notified at its end
+	Array<EntityRef> m_finished_agents;
 	bool m_is_game_running = false;
+	HashMap<EntityRef, Obstacle> m_obstacles;
+	// models created in game, waiting to be loaded
+	Array<EntityRef> m_pending_obstacles;
+	Array<DirtyTile> m_dirty_tiles;
+	Array<TileRebuild> m_tile_rebuilds;
+	volatile i32 m_tile_rebuilds_running = 0;
+	jobs::Signal m_tile_rebuild_signal;
+	os::Timer m_tile_rebuild_timer;
+	// tiles not started within this time (seconds) after the batch was pushed are postponed
+	float m_tile_rebuild_budget = 0.005f;
+	Array<PathRequest> m_path_requests;
+	// one per worker
+	Array<dtNavMeshQuery*> m_path_queries;
+	// seconds per frame
+	float m_path_query_budget = 0.002f;
+	// tiles closer than this (meters) to agents or the camera are kept in navmesh
+	float m_tile_stream_distance = 100.f;
 	
 	Vec3 m_debug_tile_origin;
 	LuaScriptScene* m_script_scene;
@@ -1694,6 +2342,7 @@ void NavigationScene::reflect() {
 			.LUMIX_PROP(AgentRadius, "Radius").minAttribute(0)
 			.LUMIX_PROP(AgentHeight, "Height").minAttribute(0)
 			.LUMIX_PROP(AgentMoveEntity, "Move entity")
+			.LUMIX_PROP(AgentPathPriority, "Path priority")
 			.prop<&NavigationSceneImpl::getAgentSpeed>("Speed");
 }
 
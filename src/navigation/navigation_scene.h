@@ -61,6 +61,8 @@ struct NavigationScene : IScene
 	virtual float getAgentHeight(EntityRef entity) = 0;
 	virtual bool getAgentMoveEntity(EntityRef entity) = 0;
 	virtual void setAgentMoveEntity(EntityRef entity, bool value) = 0;
+	virtual i32 getAgentPathPriority(EntityRef entity) = 0;
+	virtual void setAgentPathPriority(EntityRef entity, i32 value) = 0;
 	virtual NavmeshBuildJob* generateNavmesh(EntityRef zone) = 0;
 	virtual void free(NavmeshBuildJob* job) = 0;
 	virtual bool generateTileAt(EntityRef zone, const DVec3& pos, bool keep_data) = 0;
@@ -1,5 +1,6 @@
 #include "navigation_scene.h"
 #include "animation/animation_scene.h"
+#include "engine/allocators.h"
 #include "engine/engine.h"
 #include "engine/lumix.h"
 #include "engine/math.h"
@@ -24,7 +25,7 @@ enum class NavigationSceneVersion : int
 struct NavigationSystem final : IPlugin {
 	explicit NavigationSystem(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_allocator(engine.getAllocator(), "navigation")
 	{
 		ASSERT(s_instance == nullptr);
 		s_instance = this;
@@ -53,7 +54,7 @@ struct NavigationSystem final : IPlugin {
 
 	static NavigationSystem* s_instance;
 
-	IAllocator& m_allocator;
+	TagAllocator m_allocator;
 	Engine& m_engine;
 };
 
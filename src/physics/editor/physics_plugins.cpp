@@ -485,6 +485,22 @@ struct PhysicsUIPlugin final : StudioApp::GUIPlugin
 	void toggleUI() { m_is_window_open = !m_is_window_open; }
 
 
+	void onSimulationGUI()
+	{
+		PhysicsSystem* system = static_cast<PhysicsSystem*>(m_app.getEngine().getPluginManager().getPlugin("physics"));
+		if (!ImGui::CollapsingHeader("Simulation")) return;
+
+		int rate = (int)system->getSimulationRate();
+		if (ImGui::DragInt("Steps per second", &rate, 1, 0, 1000)) system->setSimulationRate((u32)maximum(rate, 0));
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("0 - one variable step per frame");
+		int max_substeps = (int)system->getMaxSubsteps();
+		if (ImGui::DragInt("Max substeps", &max_substeps, 1, 1, 32)) system->setMaxSubsteps((u32)maximum(max_substeps, 1));
+		bool parallel_controllers = system->areControllersParallel();
+		if (ImGui::Checkbox("Parallel controllers", &parallel_controllers)) system->setParallelControllers(parallel_controllers);
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("Move controllers which can not touch each other in parallel");
+	}
+
+
 	void onLayersGUI()
 	{
 		PhysicsSystem* system = static_cast<PhysicsSystem*>(m_app.getEngine().getPluginManager().getPlugin("physics"));
@@ -804,6 +820,7 @@ struct PhysicsUIPlugin final : StudioApp::GUIPlugin
 		if (ImGui::Begin("Physics", &m_is_window_open))
 		{
 			WorldEditor& editor = m_app.getWorldEditor();
+			onSimulationGUI();
 			onLayersGUI();
 			onCollisionMatrixGUI();
 			onRagdollGUI(editor);
@@ -879,6 +896,8 @@ struct PhysicsMaterialPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugi
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	bool save(PhysicsMaterial* mat) {
 		FileSystem& fs = m_app.getEngine().getFileSystem();
 	
@@ -1,4 +1,6 @@
+#include <common/PxCollection.h>
 #include <cooking/PxConvexMeshDesc.h>
+#include <extensions/PxSerialization.h>
 #include <foundation/PxIO.h>
 #include <geometry/PxTriangleMesh.h>
 #include <PxMaterial.h>
@@ -38,6 +40,7 @@ const ResourceType PhysicsGeometry::TYPE("physics_geometry");
 PhysicsGeometry::PhysicsGeometry(const Path& path, ResourceManager& resource_manager, PhysicsSystem& system, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, system(system)
+	, m_allocator(allocator)
 	, convex_mesh(nullptr)
 	, tri_mesh(nullptr)
 {
@@ -70,6 +73,26 @@ bool PhysicsGeometry::load(u64 size, const u8* mem)
 
 
 	const bool is_convex = header.m_convex != 0;
+	if (header.m_version > (u32)Versions::BINARY_COLLECTION) {
+		// binary collections are deserialized in place, so the memory must be aligned and kept until unload
+		const u64 data_size = size - file.getPosition();
+		collection_mem = m_allocator.allocate_aligned(data_size, PX_SERIAL_FILE_ALIGN);
+		memcpy(collection_mem, (const u8*)file.getBuffer() + file.getPosition(), data_size);
+		physx::PxCollection* collection = physx::PxSerialization::createCollectionFromBinary(collection_mem, *system.getSerializationRegistry());
+		if (!collection || collection->getNbObjects() == 0) {
+			logError("Failed to deserialize ", getPath());
+			if (collection) collection->release();
+			m_allocator.deallocate_aligned(collection_mem);
+			collection_mem = nullptr;
+			return false;
+		}
+		physx::PxBase& object = collection->getObject(0);
+		if (is_convex) convex_mesh = object.is<physx::PxConvexMesh>();
+		else tri_mesh = object.is<physx::PxTriangleMesh>();
+		collection->release();
+		return convex_mesh || tri_mesh;
+	}
+
 	InputStream read_buffer(file);
 	if (is_convex) {
 		convex_mesh = system.getPhysics()->createConvexMesh(read_buffer);
@@ -87,6 +110,10 @@ void PhysicsGeometry::unload()
 	if (tri_mesh) tri_mesh->release();
 	convex_mesh = nullptr;
 	tri_mesh = nullptr;
+	if (collection_mem) {
+		m_allocator.deallocate_aligned(collection_mem);
+		collection_mem = nullptr;
+	}
 }
 
 
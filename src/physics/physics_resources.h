@@ -72,6 +72,7 @@ struct PhysicsGeometry final : Resource
 		{
 			FIRST,
 			COOKED,
+			BINARY_COLLECTION,
 
 			LAST
 		};
@@ -89,6 +90,9 @@ struct PhysicsGeometry final : Resource
 
 	private:
 		PhysicsSystem& system;
+		IAllocator& m_allocator;
+		// binary collection the meshes were deserialized from in place, must outlive them
+		void* collection_mem = nullptr;
 
 		void unload() override;
 		bool load(u64 size, const u8* mem) override;
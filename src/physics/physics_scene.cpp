@@ -39,7 +39,6 @@
 #include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
-#include "engine/os.h"
 #include "engine/path.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
@@ -217,6 +216,19 @@ struct Vehicle
 };
 
 
+// vehicles updated by one job
+static constexpr u32 VEHICLE_GROUP_SIZE = 16;
+
+
+// suspension raycasts of a group of vehicles
+struct VehicleQuery
+{
+	PxBatchQuery* query = nullptr;
+	PxRaycastQueryResult* results = nullptr;
+	u8 mem[(sizeof(PxRaycastQueryResult) + sizeof(PxRaycastHit)) * VEHICLE_GROUP_SIZE * 4];
+};
+
+
 struct Wheel
 {
 	float mass = 1;
@@ -236,35 +248,60 @@ struct Wheel
 };
 
 
+// quads per side of a heightfield tile
+static constexpr u32 HEIGHTFIELD_TILE_SIZE = 256;
+// seconds a tile is kept after no body is close to it
+static constexpr float HEIGHTFIELD_TILE_TIMEOUT = 5;
+
+
 struct Heightfield {
+	// part of the heightfield with its own actor, in game, tiles of large heightfields exist only close to moving bodies
+	struct Tile {
+		PxRigidActor* actor = nullptr;
+		// seconds since a body was close to the tile
+		float idle_time = 0;
+	};
+
+	Heightfield() {}
+	Heightfield(Heightfield&& rhs);
 	~Heightfield();
 	void heightmapLoaded(Resource::State, Resource::State new_state, Resource&);
+	u32 getTilesCount() const { return m_tiles_x * m_tiles_y; }
 
 	struct PhysicsSceneImpl* m_scene;
 	EntityRef m_entity;
-	PxRigidActor* m_actor = nullptr;
 	Texture* m_heightmap = nullptr;
 	float m_xz_scale = 1.f;
 	float m_y_scale = 1.f;
 	i32 m_layer = 0;
+	// m_tiles_x * m_tiles_y, row-major
+	Tile* m_tiles = nullptr;
+	u32 m_tiles_x = 0;
+	u32 m_tiles_y = 0;
 };
 
 
 struct PhysicsSceneImpl final : PhysicsScene
 {
+	struct Controller;
+
 	struct CPUDispatcher : physx::PxCpuDispatcher
 	{
+		// the task itself is the job's data, simulation is on the frame's critical path so it goes first
 		void submitTask(PxBaseTask& task) override
 		{
-			jobs::runLambda([&task]() {
-					PROFILE_BLOCK(task.getName());
+			jobs::run(&task, [](void* data) {
+					PxBaseTask* task = (PxBaseTask*)data;
+					PROFILE_BLOCK(task->getName());
 					profiler::blockColor(0x50, 0xff, 0x50);
-					task.run();
-					task.release();
+					task->run();
+					task->release();
 				},
-				nullptr);
+				nullptr,
+				jobs::Priority::HIGH);
 		}
-		PxU32 getWorkerCount() const override { return os::getCPUsCount(); }
+		// physx splits work by this, it must match the job system and not the number of cores
+		PxU32 getWorkerCount() const override { return jobs::getWorkersCount(); }
 	};
 
 
@@ -345,6 +382,9 @@ struct PhysicsSceneImpl final : PhysicsScene
 			, next_with_mesh(rhs.next_with_mesh)
 			, dynamic_type(rhs.dynamic_type)
 			, is_trigger(rhs.is_trigger)
+			, prev_pose(rhs.prev_pose)
+			, pose(rhs.pose)
+			, moved(rhs.moved)
 		{
 			rhs.mesh = nullptr;
 			rhs.material = nullptr;
@@ -375,24 +415,30 @@ struct PhysicsSceneImpl final : PhysicsScene
 		EntityPtr next_with_mesh = INVALID_ENTITY;
 		DynamicType dynamic_type = DynamicType::STATIC;
 		bool is_trigger = false;
+		// pose before the last step the actor moved in, entity's transform is interpolated between it and `pose`
+		PxTransform prev_pose = PxTransform(PxIdentity);
+		// pose after the last step the actor moved in
+		PxTransform pose = PxTransform(PxIdentity);
+		// in m_moved_actors
+		bool moved = false;
 	};
 
 
 	PhysicsSceneImpl(Engine& engine, Universe& context, PhysicsSystem& system, IAllocator& allocator);
 
 
-	PxBatchQuery* createVehicleBatchQuery(u8* mem)
+	PxBatchQuery* createVehicleBatchQuery(VehicleQuery& query)
 	{
-		const PxU32 maxNumQueriesInBatch = 64;
-		const PxU32 maxNumHitResultsInBatch = 64;
+		const PxU32 maxNumQueriesInBatch = VEHICLE_GROUP_SIZE * 4;
+		const PxU32 maxNumHitResultsInBatch = VEHICLE_GROUP_SIZE * 4;
 
 		PxBatchQueryDesc desc(maxNumQueriesInBatch, maxNumQueriesInBatch, 0);
 
-		desc.queryMemory.userRaycastResultBuffer = (PxRaycastQueryResult*)(mem + sizeof(PxRaycastHit) * 64);
-		desc.queryMemory.userRaycastTouchBuffer = (PxRaycastHit*)mem;
+		desc.queryMemory.userRaycastResultBuffer = (PxRaycastQueryResult*)(query.mem + sizeof(PxRaycastHit) * maxNumHitResultsInBatch);
+		desc.queryMemory.userRaycastTouchBuffer = (PxRaycastHit*)query.mem;
 		desc.queryMemory.raycastTouchBufferSize = maxNumHitResultsInBatch;
 
-		m_vehicle_results = desc.queryMemory.userRaycastResultBuffer;
+		query.results = desc.queryMemory.userRaycastResultBuffer;
 
 		desc.preFilterShader = [](PxFilterData queryFilterData, PxFilterData objectFilterData, const void* constantBlock, PxU32 constantBlockSize, PxHitFlags& hitFlags) -> PxQueryHitType::Enum {
 			if (objectFilterData.word3 == (u32)FilterFlags::VEHICLE) return PxQueryHitType::eNONE;
@@ -421,7 +467,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 
 	~PhysicsSceneImpl()
 	{
-		m_vehicle_batch_query->release();
+		waitForSimulation();
+		for (UniquePtr<VehicleQuery>& q : m_vehicle_queries) q->query->release();
 		m_vehicle_frictions->release();
 		m_controller_manager->release();
 		m_default_material->release();
@@ -435,6 +482,7 @@ struct PhysicsSceneImpl final : PhysicsScene
 
 	void clear() override
 	{
+		waitForSimulation();
 		for (auto& controller : m_controllers)
 		{
 			controller.controller->release();
@@ -473,6 +521,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 
 		m_actors.clear();
 		m_dynamic_actors.clear();
+		m_moved_actors.clear();
+		m_interpolated_actors.clear();
 
 		m_terrains.clear();
 	}
@@ -830,21 +880,28 @@ struct PhysicsSceneImpl final : PhysicsScene
 		auto& terrain = m_terrains[entity];
 		terrain.m_layer = layer;
 
-		if (terrain.m_actor)
-		{
-			PxFilterData data;
-			data.word0 = 1 << layer;
-			data.word1 = m_layers.filter[layer];
-			PxShape* shapes[8];
-			int shapes_count = terrain.m_actor->getShapes(shapes, lengthOf(shapes));
-			for (int i = 0; i < shapes_count; ++i)
-			{
-				shapes[i]->setSimulationFilterData(data);
-			}
+		for (u32 i = 0, c = terrain.getTilesCount(); i < c; ++i) {
+			if (terrain.m_tiles[i].actor) updateFilterData(terrain.m_tiles[i].actor, layer);
+		}
+	}
+
+
+	static PxHeightFieldSample toHeightfieldSample(const u8* data, u32 idx, u32 bytes_per_pixel) {
+		PxHeightFieldSample sample;
+		if (bytes_per_pixel == 2) {
+			sample.height = PxI16((i32)((const i16*)data)[idx] - 0x7fff);
 		}
+		else {
+			ASSERT(bytes_per_pixel == 1);
+			sample.height = PxI16((i32)data[idx] - 0x7f);
+		}
+		sample.materialIndex0 = sample.materialIndex1 = 0;
+		sample.setTessFlag();
+		return sample;
 	}
 
 
+	// only tiles with actors which overlap the edited rectangle are modified, other tiles are created from the updated heightmap
 	void updateHeighfieldData(EntityRef entity,
 		int x,
 		int y,
@@ -855,54 +912,51 @@ struct PhysicsSceneImpl final : PhysicsScene
 	{
 		PROFILE_FUNCTION();
 		Heightfield& terrain = m_terrains[entity];
+		if (!terrain.m_heightmap) return;
+
+		const i32 hm_width = terrain.m_heightmap->width;
+		const i32 hm_height = terrain.m_heightmap->height;
+		Array<PxHeightFieldSample> samples(m_allocator);
+		for (u32 ty = 0; ty < terrain.m_tiles_y; ++ty) {
+			for (u32 tx = 0; tx < terrain.m_tiles_x; ++tx) {
+				Heightfield::Tile& tile = terrain.m_tiles[tx + ty * terrain.m_tiles_x];
+				if (!tile.actor) continue;
+
+				// rows go along heightmap's x, columns along its y
+				const i32 row0 = tx * HEIGHTFIELD_TILE_SIZE;
+				const i32 col0 = ty * HEIGHTFIELD_TILE_SIZE;
+				const i32 from_row = maximum(x, row0);
+				const i32 to_row = minimum(x + width, row0 + (i32)HEIGHTFIELD_TILE_SIZE + 1, hm_width);
+				const i32 from_col = maximum(y, col0);
+				const i32 to_col = minimum(y + height, col0 + (i32)HEIGHTFIELD_TILE_SIZE + 1, hm_height);
+				if (from_row >= to_row || from_col >= to_col) continue;
+
+				const i32 rows = to_row - from_row;
+				const i32 cols = to_col - from_col;
+				samples.resize(rows * cols);
+				for (i32 r = 0; r < rows; ++r) {
+					for (i32 c = 0; c < cols; ++c) {
+						const u32 idx = (from_row + r - x) + (from_col + c - y) * width;
+						samples[r * cols + c] = toHeightfieldSample(src_data, idx, bytes_per_pixel);
+					}
+				}
 
-		PxShape* shape;
-		terrain.m_actor->getShapes(&shape, 1);
-		PxHeightFieldGeometry geom;
-		shape->getHeightFieldGeometry(geom);
+				PxShape* shape;
+				tile.actor->getShapes(&shape, 1);
+				PxHeightFieldGeometry geom;
+				shape->getHeightFieldGeometry(geom);
 
-		Array<PxHeightFieldSample> heights(m_allocator);
+				PxHeightFieldDesc hfDesc;
+				hfDesc.format = PxHeightFieldFormat::eS16_TM;
+				hfDesc.nbColumns = cols;
+				hfDesc.nbRows = rows;
+				hfDesc.samples.data = samples.begin();
+				hfDesc.samples.stride = sizeof(PxHeightFieldSample);
 
-		heights.resize(width * height);
-		if (bytes_per_pixel == 2)
-		{
-			const i16* LUMIX_RESTRICT data = (const i16*)src_data;
-			for (int j = 0; j < height; ++j)
-			{
-				for (int i = 0; i < width; ++i)
-				{
-					int idx = j + i * height;
-					int idx2 = i + j * width;
-					heights[idx].height = PxI16((i32)data[idx2] - 0x7fff);
-					heights[idx].materialIndex0 = heights[idx].materialIndex1 = 0;
-				}
+				geom.heightField->modifySamples(from_col - col0, from_row - row0, hfDesc);
+				shape->setGeometry(geom);
 			}
 		}
-		else
-		{
-			ASSERT(bytes_per_pixel == 1);
-			const u8* LUMIX_RESTRICT data = src_data;
-			for (int j = 0; j < height; ++j)
-			{
-				for (int i = 0; i < width; ++i)
-				{
-					int idx = j + i * height;
-					int idx2 = i + j * width;
-					heights[idx].height = PxI16((i32)data[idx2] - 0x7f);
-					heights[idx].materialIndex0 = heights[idx].materialIndex1 = 0;
-				}
-			}
-		}
-
-		PxHeightFieldDesc hfDesc;
-		hfDesc.format = PxHeightFieldFormat::eS16_TM;
-		hfDesc.nbColumns = height;
-		hfDesc.nbRows = width;
-		hfDesc.samples.data = &heights[0];
-		hfDesc.samples.stride = sizeof(PxHeightFieldSample);
-
-		geom.heightField->modifySamples(y, x, hfDesc);
-		shape->setGeometry(geom);
 	}
 
 
@@ -1284,6 +1338,7 @@ struct PhysicsSceneImpl final : PhysicsScene
 
 	void destroyHeightfield(EntityRef entity)
 	{
+		releaseHeightfieldTiles(m_terrains[entity]);
 		m_terrains.erase(entity);
 		m_universe.onComponentDestroyed(entity, HEIGHTFIELD_TYPE, this);
 	}
@@ -1354,6 +1409,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 		actor.setPhysxActor(nullptr);
 		m_actors.erase(entity);
 		m_dynamic_actors.eraseItem(entity);
+		m_moved_actors.eraseItem(entity);
+		m_interpolated_actors.eraseItem(entity);
 		m_universe.onComponentDestroyed(entity, RIGID_ACTOR_TYPE, this);
 		if (m_is_game_running)
 		{
@@ -1453,7 +1510,6 @@ struct PhysicsSceneImpl final : PhysicsScene
 		Heightfield& terrain = m_terrains.insert(entity);
 		terrain.m_heightmap = nullptr;
 		terrain.m_scene = this;
-		terrain.m_actor = nullptr;
 		terrain.m_entity = entity;
 
 		m_universe.onComponentCreated(entity, HEIGHTFIELD_TYPE, this);
@@ -1690,40 +1746,72 @@ struct PhysicsSceneImpl final : PhysicsScene
 	}
 
 
-	void updateDynamicActors(bool vehicles)
+	// `extrapolate` - seconds dynamic bodies are moved forward by their velocities, to hide latency of async simulation
+	// `alpha` - position between the pose before the last fixed step and the current pose
+	// only actors moved by the simulation since the last call are synchronized, sleeping ones are skipped
+	void updateDynamicActors(bool vehicles, float extrapolate = 0, float alpha = 1)
 	{
 		PROFILE_FUNCTION();
-		for (EntityRef e : m_dynamic_actors)
+		// hierarchies are propagated once for all actors
+		const bool was_deferred = m_universe.areTransformsDeferred();
+		m_universe.setTransformsDeferred(true);
+
+		// actors which stopped moving since the last interpolated update are snapped to their final pose
+		for (EntityRef e : m_interpolated_actors) {
+			RigidActor& actor = m_actors[e];
+			if (actor.moved) continue;
+			actor.prev_pose = actor.pose;
+			m_universe.setTransform(actor.entity, fromPhysx(actor.pose));
+		}
+		m_interpolated_actors.clear();
+
+		for (EntityRef e : m_moved_actors)
 		{
 			RigidActor& actor = m_actors[e];
-			m_update_in_progress = &actor;
-			PxTransform trans = actor.physx_actor->getGlobalPose();
+			actor.moved = false;
+			PxTransform trans = actor.pose;
+			PxRigidDynamic* body = actor.physx_actor->is<PxRigidDynamic>();
+			if (extrapolate > 0 && body && !body->getRigidBodyFlags().isSet(PxRigidBodyFlag::eKINEMATIC) && !body->isSleeping()) {
+				const PxVec3 w = body->getAngularVelocity();
+				trans.p += body->getLinearVelocity() * extrapolate;
+				trans.q += PxQuat(w.x, w.y, w.z, 0) * trans.q * (0.5f * extrapolate);
+				trans.q.normalize();
+			}
+			if (alpha < 1) {
+				trans.p = actor.prev_pose.p + (trans.p - actor.prev_pose.p) * alpha;
+				trans.q = toPhysx(nlerp(fromPhysx(actor.prev_pose.q), fromPhysx(trans.q), alpha));
+				m_interpolated_actors.push(e);
+			}
 			m_universe.setTransform(actor.entity, fromPhysx(trans));
 		}
-		m_update_in_progress = nullptr;
-
-		if (!vehicles) return;
-
-		for (auto iter = m_vehicles.begin(), end = m_vehicles.end(); iter != end; ++iter) {
-			Vehicle* veh = iter.value().get();
-			if (veh->actor) {
-				const PxTransform car_trans = veh->actor->getGlobalPose();
-				m_universe.setTransform(iter.key(), fromPhysx(car_trans));
-
-				EntityPtr wheels[4];
-				getWheels(iter.key(), Span(wheels));
-
-				PxShape* shapes[5];
-				veh->actor->getShapes(shapes, 5);
-				for (u32 i = 0; i < 4; ++i) {
-					if (!wheels[i].isValid()) continue;
-					const PxTransform trans = shapes[i]->getLocalPose();
-					m_universe.setTransform((EntityRef)wheels[i], fromPhysx(car_trans * trans));
-				
+		m_moved_actors.clear();
+
+		// chassis and wheels are flushed in the same batch
+		if (vehicles) {
+			for (auto iter = m_vehicles.begin(), end = m_vehicles.end(); iter != end; ++iter) {
+				Vehicle* veh = iter.value().get();
+				if (veh->actor) {
+					const PxTransform car_trans = veh->actor->getGlobalPose();
+					m_universe.setTransform(iter.key(), fromPhysx(car_trans));
+
+					EntityPtr wheels[4];
+					getWheels(iter.key(), Span(wheels));
+
+					PxShape* shapes[5];
+					veh->actor->getShapes(shapes, 5);
+					for (u32 i = 0; i < 4; ++i) {
+						if (!wheels[i].isValid()) continue;
+						const PxTransform trans = shapes[i]->getLocalPose();
+						m_universe.setTransform((EntityRef)wheels[i], fromPhysx(car_trans * trans));
+					}
 				}
-
 			}
 		}
+
+		m_is_updating_dynamic_actors = true;
+		m_universe.flushTransforms();
+		m_is_updating_dynamic_actors = false;
+		m_universe.setTransformsDeferred(was_deferred);
 	}
 
 
@@ -1738,105 +1826,306 @@ struct PhysicsSceneImpl final : PhysicsScene
 	{
 		PROFILE_FUNCTION();
 		m_scene->fetchResults(true);
+		gatherMovedActors();
 	}
 
 
-	void updateControllers(float time_delta)
-	{
+	void markMoved(EntityRef entity, RigidActor& actor) {
+		if (actor.moved) return;
+		actor.moved = true;
+		m_moved_actors.push(entity);
+	}
+
+
+	// physx reports only actors which were awake in the last step, we remember their poses for updateDynamicActors
+	void gatherMovedActors() {
 		PROFILE_FUNCTION();
-		for (auto& controller : m_controllers)
+		PxU32 count;
+		PxActor** actors = m_scene->getActiveActors(count);
+		for (PxU32 i = 0; i < count; ++i) {
+			const EntityRef entity = {(int)(intptr_t)actors[i]->userData};
+			auto iter = m_actors.find(entity);
+			// controllers, vehicles, ...
+			if (!iter.isValid()) continue;
+			RigidActor& actor = iter.value();
+			if (actor.physx_actor != actors[i] || actor.dynamic_type != DynamicType::DYNAMIC) continue;
+
+			actor.prev_pose = actor.pose;
+			actor.pose = actor.physx_actor->getGlobalPose();
+			markMoved(entity, actor);
+		}
+	}
+
+
+	// finishes step started by async simulation, if there's any
+	void waitForSimulation() {
+		if (!m_is_simulating) return;
+		fetchResults();
+		m_is_simulating = false;
+	}
+
+
+	void setAsyncSimulation(bool enable) override {
+		waitForSimulation();
+		m_async_simulation = enable;
+	}
+
+
+	bool isAsyncSimulation() const override { return m_async_simulation; }
+
+
+	// returns true if the controller moved, does not touch the universe, so it can run in parallel
+	bool stepController(Controller& controller, float time_delta, float scene_gravity) {
+		Vec3 dif = controller.frame_change;
+		controller.frame_change = Vec3(0, 0, 0);
+
+		PxControllerState state;
+		controller.controller->getState(state);
+		const float gravity_acceleration = controller.custom_gravity ? -controller.custom_gravity_acceleration : scene_gravity;
+
+		bool apply_gravity = (state.collisionFlags & PxControllerCollisionFlag::eCOLLISION_DOWN) == 0;
+		if (apply_gravity)
+		{
+			dif.y += controller.gravity_speed * time_delta;
+			controller.gravity_speed += time_delta * gravity_acceleration;
+		}
+		else
 		{
-			Vec3 dif = controller.frame_change;
-			controller.frame_change = Vec3(0, 0, 0);
+			controller.gravity_speed = 0;
+		}
 
-			PxControllerState state;
-			controller.controller->getState(state);
-			float gravity_acceleration = 0.0f;
-			if (controller.custom_gravity)
-			{
-				gravity_acceleration = controller.custom_gravity_acceleration * -1.0f;
-			}
-			else
-			{
-				gravity_acceleration = m_scene->getGravity().y;
-			}
+		if (squaredLength(dif) <= 0.00001f) return false;
 
-			bool apply_gravity = (state.collisionFlags & PxControllerCollisionFlag::eCOLLISION_DOWN) == 0;
-			if (apply_gravity)
-			{
-				dif.y += controller.gravity_speed * time_delta;
-				controller.gravity_speed += time_delta * gravity_acceleration;
-			}
-			else
-			{
-				controller.gravity_speed = 0;
-			}
+		FilterCallback filter_callback;
+		filter_callback.m_filter_data = controller.filter_data;
+		PxControllerFilters filters(nullptr, &filter_callback);
+		controller.controller->move(toPhysx(dif), 0.001f, time_delta, filters);
+		return true;
+	}
 
-			if (squaredLength(dif) > 0.00001f) {
-				m_filter_callback.m_filter_data = controller.filter_data;
-				PxControllerFilters filters(nullptr, &m_filter_callback);
-				controller.controller->move(toPhysx(dif), 0.001f, time_delta, filters);
-				PxExtendedVec3 p = controller.controller->getFootPosition();
+	// controllers are sorted to cells of a grid, cells with the same parity in both axes are at least one cell apart,
+	// cell is bigger than anything a controller can reach in this step, so they can not touch each other
+	// each parity is one parallel batch, controllers in one cell are moved serially
+	void moveControllersParallel(float time_delta, float scene_gravity) {
+		float cell_size = 0;
+		for (const Controller& ctrl : m_controllers) {
+			const float move = length(ctrl.frame_change) + fabsf(ctrl.gravity_speed * time_delta) + ctrl.height;
+			const float reach = ctrl.radius + ctrl.controller->getContactOffset() + move;
+			cell_size = maximum(cell_size, 2 * reach);
+		}
 
+		m_controller_cells.clear();
+		for (Controller& ctrl : m_controllers) {
+			const PxExtendedVec3 p = ctrl.controller->getFootPosition();
+			const i64 x = (i64)floor(p.x / cell_size);
+			const i64 z = (i64)floor(p.z / cell_size);
+			// parity in the highest bits, so each batch is a continuous range
+			const u64 parity = u64((x & 1) | ((z & 1) << 1));
+			const u64 key = (parity << 62) | ((u64(x) & 0x7fffFFFF) << 31) | (u64(z) & 0x7fffFFFF);
+			m_controller_cells.push({key, &ctrl, false});
+		}
+		qsort(m_controller_cells.begin(), m_controller_cells.size(), sizeof(m_controller_cells[0]), [](const void* a, const void* b) -> int {
+			const u64 ka = ((const ControllerCellItem*)a)->key;
+			const u64 kb = ((const ControllerCellItem*)b)->key;
+			return ka < kb ? -1 : (ka > kb ? 1 : 0);
+		});
+
+		m_controller_cell_ranges.clear();
+		for (u32 i = 0, c = m_controller_cells.size(); i < c; ++i) {
+			if (i == 0 || m_controller_cells[i].key != m_controller_cells[i - 1].key) m_controller_cell_ranges.push(i);
+		}
+		m_controller_cell_ranges.push(m_controller_cells.size());
+
+		u32 batch_begin = 0;
+		const u32 cells_count = m_controller_cell_ranges.size() - 1;
+		while (batch_begin < cells_count) {
+			const u64 parity = m_controller_cells[m_controller_cell_ranges[batch_begin]].key >> 62;
+			u32 batch_end = batch_begin + 1;
+			while (batch_end < cells_count && (m_controller_cells[m_controller_cell_ranges[batch_end]].key >> 62) == parity) ++batch_end;
+
+			jobs::forEach(batch_end - batch_begin, 1, [&](i32 from, i32 to){
+				PROFILE_BLOCK("controllers");
+				for (i32 cell = from; cell < to; ++cell) {
+					const u32 cell_begin = m_controller_cell_ranges[batch_begin + cell];
+					const u32 cell_end = m_controller_cell_ranges[batch_begin + cell + 1];
+					for (u32 i = cell_begin; i < cell_end; ++i) {
+						ControllerCellItem& item = m_controller_cells[i];
+						item.moved = stepController(*item.controller, time_delta, scene_gravity);
+					}
+				}
+			});
+			batch_begin = batch_end;
+		}
+
+		for (const ControllerCellItem& item : m_controller_cells) {
+			if (!item.moved) continue;
+			const PxExtendedVec3 p = item.controller->controller->getFootPosition();
+			m_universe.setPosition(item.controller->entity, {p.x, p.y, p.z});
+		}
+	}
+
+	void updateControllers(float time_delta)
+	{
+		PROFILE_FUNCTION();
+		// positions of all controllers are propagated to children at once
+		const bool was_deferred = m_universe.areTransformsDeferred();
+		m_universe.setTransformsDeferred(true);
+		m_is_updating_controllers = true;
+
+		const float scene_gravity = m_scene->getGravity().y;
+		if (m_system->areControllersParallel() && m_controllers.size() > 1) {
+			moveControllersParallel(time_delta, scene_gravity);
+		}
+		else {
+			for (Controller& controller : m_controllers) {
+				if (!stepController(controller, time_delta, scene_gravity)) continue;
+				const PxExtendedVec3 p = controller.controller->getFootPosition();
 				m_universe.setPosition(controller.entity, {p.x, p.y, p.z});
 			}
 		}
+
+		m_universe.flushTransforms();
+		m_is_updating_controllers = false;
+		m_universe.setTransformsDeferred(was_deferred);
+
+		// hits are reported from move, which can run on any thread, scripts are called here on the main thread
+		for (const ControllerHit& hit : m_controller_hits) onControllerHit(hit.controller, hit.obj);
+		m_controller_hits.clear();
 	}
 
+	// groups of VEHICLE_GROUP_SIZE vehicles are updated in parallel, each with its own batch query
 	void updateVehicles(float time_delta) {
-		PxVehicleWheels* vehicles[16];
-
-		u32 valid_count = 0;
+		PROFILE_FUNCTION();
+		m_vehicle_drives.clear();
 		for (auto iter = m_vehicles.begin(), end = m_vehicles.end(); iter != end; ++iter) {
 			Vehicle* veh = iter.value().get();
 			if (veh->drive) {
-				vehicles[valid_count] = veh->drive;
 				PxVehicleDrive4WSmoothAnalogRawInputsAndSetAnalogInputs(pad_smoothing, steer_vs_forward_speed, veh->raw_input, time_delta, false, *veh->drive);
-				++valid_count;
-
-				if (valid_count == lengthOf(vehicles)) {
-					PxVehicleSuspensionRaycasts(m_vehicle_batch_query, valid_count, vehicles, valid_count * 4, m_vehicle_results);
-					PxVehicleUpdates(time_delta, m_scene->getGravity(), *m_vehicle_frictions, valid_count, vehicles, nullptr);
-					valid_count = 0;
-				}
+				m_vehicle_drives.push(veh->drive);
 			}
 		}
 
-		if (valid_count > 0) {
-			PxVehicleSuspensionRaycasts(m_vehicle_batch_query, valid_count, vehicles, valid_count * 4, m_vehicle_results);
-			PxVehicleUpdates(time_delta, m_scene->getGravity(), *m_vehicle_frictions, valid_count, vehicles, nullptr);
+		const u32 count = m_vehicle_drives.size();
+		if (count == 0) return;
+
+		const u32 groups_count = (count + VEHICLE_GROUP_SIZE - 1) / VEHICLE_GROUP_SIZE;
+		while ((u32)m_vehicle_queries.size() < groups_count) {
+			UniquePtr<VehicleQuery>& q = m_vehicle_queries.emplace(UniquePtr<VehicleQuery>::create(m_allocator));
+			q->query = createVehicleBatchQuery(*q);
 		}
+
+		m_vehicle_updates.clear();
+		m_vehicle_wheel_updates.clear();
+		m_vehicle_wheel_updates.resize(count * 4);
+		for (u32 i = 0; i < count; ++i) {
+			PxVehicleConcurrentUpdateData& data = m_vehicle_updates.emplace();
+			data.concurrentWheelUpdates = &m_vehicle_wheel_updates[i * 4];
+			data.nbConcurrentWheelUpdates = 4;
+		}
+
+		const PxVec3 gravity = m_scene->getGravity();
+		jobs::forEach(groups_count, 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("vehicles");
+			for (i32 group = from; group < to; ++group) {
+				const u32 first = group * VEHICLE_GROUP_SIZE;
+				const u32 n = minimum(VEHICLE_GROUP_SIZE, count - first);
+				VehicleQuery& q = *m_vehicle_queries[group];
+				PxVehicleWheels** drives = &m_vehicle_drives[first];
+				PxVehicleSuspensionRaycasts(q.query, n, drives, n * 4, q.results);
+				PxVehicleUpdates(time_delta, gravity, *m_vehicle_frictions, n, drives, nullptr, &m_vehicle_updates[first]);
+			}
+		});
+
+		// writes to actors are not safe in parallel updates, physx deferred them
+		PxVehiclePostUpdates(m_vehicle_updates.begin(), count, m_vehicle_drives.begin());
 	}
 
 	void lateUpdate(float time_delta, bool paused) override {
 		if (!m_is_game_running || paused) return;
 
 		AnimationScene* anim_scene = (AnimationScene*)m_universe.getScene("animation");
-		if (!anim_scene) return;
-
-		for (Controller& ctrl : m_controllers) {
-			if (ctrl.use_root_motion) {
-				const LocalRigidTransform tr = anim_scene->getAnimatorRootMotion(ctrl.entity);
-				const Quat rot = m_universe.getRotation(ctrl.entity);
-				ctrl.frame_change += rot.rotate(tr.pos);
-				m_universe.setRotation(ctrl.entity, rot * tr.rot);
+		if (anim_scene) {
+			for (Controller& ctrl : m_controllers) {
+				if (ctrl.use_root_motion) {
+					const LocalRigidTransform tr = anim_scene->getAnimatorRootMotion(ctrl.entity);
+					const Quat rot = m_universe.getRotation(ctrl.entity);
+					ctrl.frame_change += rot.rotate(tr.pos);
+					m_universe.setRotation(ctrl.entity, rot * tr.rot);
+				}
 			}
 		}
+
+		// runs while the frame is rendered, fetched in the next update
+		if (m_async_simulation && !m_is_simulating) {
+			simulateScene(minimum(1 / 20.0f, time_delta));
+			m_is_simulating = true;
+		}
 	}
 	
 	const Array<EntityRef>& getDynamicActors() override { return m_dynamic_actors; }
 
 	void forceUpdateDynamicActors(float time_delta) override {
+		waitForSimulation();
 		simulateScene(time_delta);
 		fetchResults();
 		updateDynamicActors(false);
 	}
 
+	// deterministic steps of the same length, entities are interpolated between the last two steps
+	void updateFixedSteps(float time_delta, u32 rate) {
+		PROFILE_FUNCTION();
+		const float step = 1.f / rate;
+		const u32 max_substeps = m_system->getMaxSubsteps();
+		m_accumulated_time += time_delta;
+		const u32 steps = minimum(u32(m_accumulated_time / step), max_substeps);
+		if (steps == max_substeps) m_accumulated_time = minimum(m_accumulated_time, step * (steps + 1));
+
+		// no new poses, actors moving in the last step keep being interpolated
+		if (steps == 0) {
+			for (EntityRef e : m_interpolated_actors) markMoved(e, m_actors[e]);
+		}
+
+		for (u32 i = 0; i < steps; ++i) {
+			updateVehicles(step);
+			simulateScene(step);
+			fetchResults();
+			m_accumulated_time -= step;
+		}
+
+		// in [0, 1), how far between the last two steps the rendered frame is
+		const float alpha = clamp(m_accumulated_time / step, 0.f, 1.f);
+		updateDynamicActors(true, 0, alpha);
+		updateControllers(time_delta);
+
+		render();
+	}
+
+
 	void update(float time_delta, bool paused) override
 	{
 		if (!m_is_game_running || paused) return;
 
+		// async simulation may be running now, tiles are streamed once it's fetched
+		if (!m_async_simulation) streamHeightfieldTiles(time_delta);
+
+		const u32 rate = m_system->getSimulationRate();
+		if (rate > 0 && !m_async_simulation) {
+			updateFixedSteps(time_delta, rate);
+			return;
+		}
+
 		time_delta = minimum(1 / 20.0f, time_delta);
+		if (m_async_simulation) {
+			// results are one step behind, see lateUpdate
+			waitForSimulation();
+			streamHeightfieldTiles(time_delta);
+			updateDynamicActors(true, time_delta);
+			updateVehicles(time_delta);
+			updateControllers(time_delta);
+			render();
+			return;
+		}
+
 		updateVehicles(time_delta);
 		simulateScene(time_delta);
 		fetchResults();
@@ -2237,7 +2526,14 @@ struct PhysicsSceneImpl final : PhysicsScene
 	}
 
 
-	void stopGame() override { m_is_game_running = false; }
+	void stopGame() override {
+		waitForSimulation();
+		m_is_game_running = false;
+		// editor queries expect the whole heightfield
+		for (Heightfield& terrain : m_terrains) {
+			if (terrain.m_heightmap && terrain.m_heightmap->isReady()) createHeightfieldTiles(terrain);
+		}
+	}
 
 
 	float getControllerRadius(EntityRef entity) override { return m_controllers[entity].radius; }
@@ -2420,6 +2716,71 @@ struct PhysicsSceneImpl final : PhysicsScene
 		return status;
 	}
 
+
+	void raycastBatch(Span<const RaycastQuery> queries, Span<RaycastHit> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(results.length() >= queries.length());
+		jobs::forEach(queries.length(), 64, [&](i32 from, i32 to){
+			PROFILE_BLOCK("raycasts");
+			for (i32 i = from; i < to; ++i) {
+				const RaycastQuery& q = queries[i];
+				if (!raycastEx(q.origin, q.dir, q.distance, results[i], q.ignored, q.layer)) results[i].entity = INVALID_ENTITY;
+			}
+		});
+	}
+
+
+	void sweepBatch(Span<const SweepQuery> queries, Span<RaycastHit> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(results.length() >= queries.length());
+		jobs::forEach(queries.length(), 32, [&](i32 from, i32 to){
+			PROFILE_BLOCK("sweeps");
+			Filter filter;
+			filter.scene = this;
+			PxQueryFilterData filter_data;
+			filter_data.flags = PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER;
+			const PxHitFlags flags = PxHitFlag::ePOSITION | PxHitFlag::eNORMAL;
+			for (i32 i = from; i < to; ++i) {
+				const SweepQuery& q = queries[i];
+				RaycastHit& result = results[i];
+				filter.entity = q.ignored;
+				filter.layer = q.layer;
+				PxSweepBuffer hit;
+				result.entity = INVALID_ENTITY;
+				if (!m_scene->sweep(PxSphereGeometry(q.radius), PxTransform(toPhysx(q.origin)), toPhysx(q.dir), q.distance, hit, flags, filter_data, &filter)) continue;
+
+				result.position = fromPhysx(hit.block.position);
+				result.normal = fromPhysx(hit.block.normal);
+				if (hit.block.actor) result.entity = EntityPtr{(int)(intptr_t)hit.block.actor->userData};
+			}
+		});
+	}
+
+
+	void overlapBatch(Span<const OverlapQuery> queries, Span<EntityPtr> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(results.length() >= queries.length());
+		jobs::forEach(queries.length(), 32, [&](i32 from, i32 to){
+			PROFILE_BLOCK("overlaps");
+			Filter filter;
+			filter.scene = this;
+			PxQueryFilterData filter_data;
+			filter_data.flags = PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER | PxQueryFlag::eANY_HIT;
+			for (i32 i = from; i < to; ++i) {
+				const OverlapQuery& q = queries[i];
+				filter.entity = q.ignored;
+				filter.layer = q.layer;
+				PxOverlapBuffer hit;
+				results[i] = INVALID_ENTITY;
+				if (!m_scene->overlap(PxSphereGeometry(q.radius), PxTransform(toPhysx(q.center)), hit, filter_data, &filter)) continue;
+				if (hit.block.actor) results[i] = EntityPtr{(int)(intptr_t)hit.block.actor->userData};
+			}
+		});
+	}
+
 	void onEntityDestroyed(EntityRef entity)
 	{
 		for (int i = 0, c = m_joints.size(); i < c; ++i)
@@ -2436,7 +2797,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 		const u64 cmp_mask = m_universe.getComponentsMask(entity);
 		if ((cmp_mask & m_physics_cmps_mask) == 0) return;
 		
-		if (m_universe.hasComponent(entity, CONTROLLER_TYPE)) {
+		// controller's position was just set from physx
+		if (!m_is_updating_controllers && m_universe.hasComponent(entity, CONTROLLER_TYPE)) {
 			auto iter = m_controllers.find(entity);
 			if (iter.isValid())
 			{
@@ -2451,7 +2813,9 @@ struct PhysicsSceneImpl final : PhysicsScene
 			auto iter = m_actors.find(entity);
 			if (iter.isValid()) {
 				RigidActor& actor = iter.value();
-				if (actor.physx_actor && m_update_in_progress != &actor)
+				// dynamic actors' transforms were just set from physx
+				const bool from_physx = m_is_updating_dynamic_actors && actor.dynamic_type == DynamicType::DYNAMIC;
+				if (actor.physx_actor && !from_physx)
 				{
 					Transform trans = m_universe.getTransform(entity);
 					if (actor.dynamic_type == DynamicType::KINEMATIC)
@@ -2461,7 +2825,10 @@ struct PhysicsSceneImpl final : PhysicsScene
 					}
 					else
 					{
-						actor.physx_actor->setGlobalPose(toPhysx(trans.getRigidPart()), false);
+						// teleported, do not interpolate from the old pose
+						actor.pose = toPhysx(trans.getRigidPart());
+						actor.prev_pose = actor.pose;
+						actor.physx_actor->setGlobalPose(actor.pose, false);
 					}
 					if (actor.mesh && actor.scale != trans.scale)
 					{
@@ -2476,100 +2843,165 @@ struct PhysicsSceneImpl final : PhysicsScene
 	void heightmapLoaded(Heightfield& terrain)
 	{
 		PROFILE_FUNCTION();
-		Array<PxHeightFieldSample> heights(m_allocator);
+		releaseHeightfieldTiles(terrain);
 
-		int width = terrain.m_heightmap->width;
-		int height = terrain.m_heightmap->height;
-		heights.resize(width * height);
-		PxHeightFieldSample* heights_ptr = heights.begin();
-		if (terrain.m_heightmap->format == gpu::TextureFormat::R16)
-		{
-			PROFILE_BLOCK("copyData");
-			const i16* LUMIX_RESTRICT data = (const i16*)terrain.m_heightmap->getData();
-			for (int j = 0; j < height; ++j)
-			{
-				int idx = j * width;
-				for (int i = 0; i < width; ++i)
-				{
-					int idx2 = j + i * height;
-					heights_ptr[idx].height = PxI16((i32)data[idx2] - 0x7fff);
-					heights_ptr[idx].materialIndex0 = heights_ptr[idx].materialIndex1 = 0;
-					heights_ptr[idx].setTessFlag();
-					++idx;
-				}
+		Texture* hm = terrain.m_heightmap;
+		if (hm->format != gpu::TextureFormat::R16 && hm->format != gpu::TextureFormat::R8) {
+			logError("Unsupported physics heightmap format ", hm->getPath());
+			return;
+		}
+		if (hm->width < 2 || hm->height < 2) {
+			logError("Physics heightmap ", hm->getPath(), " is too small");
+			return;
+		}
+
+		terrain.m_tiles_x = (hm->width - 2) / HEIGHTFIELD_TILE_SIZE + 1;
+		terrain.m_tiles_y = (hm->height - 2) / HEIGHTFIELD_TILE_SIZE + 1;
+		const u32 count = terrain.getTilesCount();
+		terrain.m_tiles = (Heightfield::Tile*)m_allocator.allocate(sizeof(Heightfield::Tile) * count);
+		for (u32 i = 0; i < count; ++i) {
+			new (NewPlaceholder(), &terrain.m_tiles[i]) Heightfield::Tile;
+		}
+
+		// in game, tiles of large heightfields are created by streamHeightfieldTiles
+		if (!m_is_game_running || count == 1) createHeightfieldTiles(terrain);
+	}
+
+
+	void createHeightfieldTiles(Heightfield& terrain) {
+		for (u32 ty = 0; ty < terrain.m_tiles_y; ++ty) {
+			for (u32 tx = 0; tx < terrain.m_tiles_x; ++tx) {
+				if (!terrain.m_tiles[tx + ty * terrain.m_tiles_x].actor) createHeightfieldTile(terrain, tx, ty);
 			}
 		}
-		else if (terrain.m_heightmap->format == gpu::TextureFormat::R8)
+	}
+
+
+	void createHeightfieldTile(Heightfield& terrain, u32 tx, u32 ty)
+	{
+		PROFILE_FUNCTION();
+		Texture* hm = terrain.m_heightmap;
+		const u32 bytes_per_pixel = hm->format == gpu::TextureFormat::R16 ? 2 : 1;
+		// neighbours share the border samples; rows go along heightmap's x, columns along its y
+		const u32 row0 = tx * HEIGHTFIELD_TILE_SIZE;
+		const u32 col0 = ty * HEIGHTFIELD_TILE_SIZE;
+		const u32 rows = minimum(HEIGHTFIELD_TILE_SIZE + 1, hm->width - row0);
+		const u32 cols = minimum(HEIGHTFIELD_TILE_SIZE + 1, hm->height - col0);
+
+		Array<PxHeightFieldSample> samples(m_allocator);
+		samples.resize(rows * cols);
 		{
 			PROFILE_BLOCK("copyData");
-			const u8* data = terrain.m_heightmap->getData();
-			for (int j = 0; j < height; ++j)
-			{
-				for (int i = 0; i < width; ++i)
-				{
-					int idx = i + j * width;
-					int idx2 = j + i * height;
-					heights_ptr[idx].height = PxI16((i32)data[idx2] - 0x7f);
-					heights_ptr[idx].materialIndex0 = heights_ptr[idx].materialIndex1 = 0;
-					heights_ptr[idx].setTessFlag();
+			const u8* data = hm->getData();
+			for (u32 r = 0; r < rows; ++r) {
+				for (u32 c = 0; c < cols; ++c) {
+					samples[r * cols + c] = toHeightfieldSample(data, (row0 + r) + (col0 + c) * hm->width, bytes_per_pixel);
 				}
 			}
 		}
-		else {
-			logError("Unsupported physics heightmap format ", terrain.m_heightmap->getPath());
+
+		PROFILE_BLOCK("physX");
+		PxHeightFieldDesc hfDesc;
+		hfDesc.format = PxHeightFieldFormat::eS16_TM;
+		hfDesc.nbColumns = cols;
+		hfDesc.nbRows = rows;
+		hfDesc.samples.data = samples.begin();
+		hfDesc.samples.stride = sizeof(PxHeightFieldSample);
+
+		PxHeightField* heightfield = m_system->getCooking()->createHeightField(
+			hfDesc, m_system->getPhysics()->getPhysicsInsertionCallback());
+		const float height_scale = bytes_per_pixel == 2 ? 1 / (256 * 256.0f - 1) : 1 / 255.0f;
+		PxHeightFieldGeometry hfGeom(heightfield,
+			PxMeshGeometryFlags(),
+			height_scale * terrain.m_y_scale,
+			terrain.m_xz_scale,
+			terrain.m_xz_scale);
+
+		PxTransform transform = toPhysx(m_universe.getTransform(terrain.m_entity).getRigidPart());
+		transform.p += transform.q.rotate(PxVec3(row0 * terrain.m_xz_scale, 0, col0 * terrain.m_xz_scale));
+		transform.p.y += terrain.m_y_scale * 0.5f;
+
+		PxRigidActor* actor = PxCreateStatic(*m_system->getPhysics(), transform, hfGeom, *m_default_material);
+		heightfield->release();
+		if (!actor) {
+			logError("Could not create PhysX heightfield ", hm->getPath());
 			return;
 		}
 
-		{ // PROFILE_BLOCK scope
-			PROFILE_BLOCK("physX");
-			PxHeightFieldDesc hfDesc;
-			hfDesc.format = PxHeightFieldFormat::eS16_TM;
-			hfDesc.nbColumns = width;
-			hfDesc.nbRows = height;
-			hfDesc.samples.data = &heights[0];
-			hfDesc.samples.stride = sizeof(PxHeightFieldSample);
-
-			PxHeightField* heightfield = m_system->getCooking()->createHeightField(
-				hfDesc, m_system->getPhysics()->getPhysicsInsertionCallback());
-			float height_scale = terrain.m_heightmap->format == gpu::TextureFormat::R16 ? 1 / (256 * 256.0f - 1) : 1 / 255.0f;
-			PxHeightFieldGeometry hfGeom(heightfield,
-				PxMeshGeometryFlags(),
-				height_scale * terrain.m_y_scale,
-				terrain.m_xz_scale,
-				terrain.m_xz_scale);
-			if (terrain.m_actor)
-			{
-				PxRigidActor* actor = terrain.m_actor;
-				m_scene->removeActor(*actor);
-				actor->release();
-				terrain.m_actor = nullptr;
-			}
+		actor->userData = (void*)(intptr_t)terrain.m_entity.index;
+		m_scene->addActor(*actor);
+		updateFilterData(actor, terrain.m_layer);
+		actor->setActorFlag(PxActorFlag::eVISUALIZATION, true);
+		Heightfield::Tile& tile = terrain.m_tiles[tx + ty * terrain.m_tiles_x];
+		tile.actor = actor;
+		tile.idle_time = 0;
+	}
 
-			PxTransform transform = toPhysx(m_universe.getTransform(terrain.m_entity).getRigidPart());
-			transform.p.y += terrain.m_y_scale * 0.5f;
 
-			PxRigidActor* actor = PxCreateStatic(*m_system->getPhysics(), transform, hfGeom, *m_default_material);
-			if (actor)
-			{
-				actor->userData = (void*)(intptr_t)terrain.m_entity.index;
-				m_scene->addActor(*actor);
-				terrain.m_actor = actor;
-
-				PxFilterData data;
-				int terrain_layer = terrain.m_layer;
-				data.word0 = 1 << terrain_layer;
-				data.word1 = m_layers.filter[terrain_layer];
-				PxShape* shapes[8];
-				int shapes_count = actor->getShapes(shapes, lengthOf(shapes));
-				for (int i = 0; i < shapes_count; ++i)
-				{
-					shapes[i]->setSimulationFilterData(data);
+	void releaseHeightfieldTiles(Heightfield& terrain) {
+		for (u32 i = 0, c = terrain.getTilesCount(); i < c; ++i) {
+			if (terrain.m_tiles[i].actor) terrain.m_tiles[i].actor->release();
+		}
+		if (terrain.m_tiles) m_allocator.deallocate(terrain.m_tiles);
+		terrain.m_tiles = nullptr;
+		terrain.m_tiles_x = terrain.m_tiles_y = 0;
+	}
+
+
+	// creates tiles close to awake bodies, controllers and vehicles, releases tiles no body came close to for a while
+	// bodies sleeping on a released tile are not woken up, but they fall through if something wakes them before their tile is back
+	void streamHeightfieldTiles(float time_delta)
+	{
+		PROFILE_FUNCTION();
+		const float distance = m_heightfield_stream_distance;
+		for (Heightfield& terrain : m_terrains) {
+			if (terrain.getTilesCount() <= 1) continue;
+			if (!terrain.m_heightmap || !terrain.m_heightmap->isReady()) continue;
+
+			const Transform tr = m_universe.getTransform(terrain.m_entity);
+			const Quat inv_rot = tr.rot.conjugated();
+			const float tile_size = HEIGHTFIELD_TILE_SIZE * terrain.m_xz_scale;
+			for (u32 i = 0, c = terrain.getTilesCount(); i < c; ++i) terrain.m_tiles[i].idle_time += time_delta;
+
+			auto touch = [&](const DVec3& pos){
+				const Vec3 local = inv_rot.rotate(Vec3(pos - tr.pos));
+				const i32 x0 = (i32)floorf((local.x - distance) / tile_size);
+				const i32 x1 = (i32)floorf((local.x + distance) / tile_size);
+				const i32 y0 = (i32)floorf((local.z - distance) / tile_size);
+				const i32 y1 = (i32)floorf((local.z + distance) / tile_size);
+				if (x1 < 0 || y1 < 0 || x0 >= (i32)terrain.m_tiles_x || y0 >= (i32)terrain.m_tiles_y) return;
+
+				for (i32 y = maximum(y0, 0), ye = minimum(y1, (i32)terrain.m_tiles_y - 1); y <= ye; ++y) {
+					for (i32 x = maximum(x0, 0), xe = minimum(x1, (i32)terrain.m_tiles_x - 1); x <= xe; ++x) {
+						terrain.m_tiles[x + y * terrain.m_tiles_x].idle_time = 0;
+					}
 				}
-				terrain.m_actor->setActorFlag(PxActorFlag::eVISUALIZATION, true);
+			};
+
+			// actors awake in the last step
+			PxU32 active_count;
+			PxActor** active = m_scene->getActiveActors(active_count);
+			for (PxU32 i = 0; i < active_count; ++i) {
+				const PxRigidActor* actor = active[i]->is<PxRigidActor>();
+				if (actor) touch(DVec3(fromPhysx(actor->getGlobalPose().p)));
 			}
-			else
-			{
-				logError("Could not create PhysX heightfield ", terrain.m_heightmap->getPath());
+			for (const Controller& ctrl : m_controllers) touch(m_universe.getPosition(ctrl.entity));
+			for (auto iter = m_vehicles.begin(), end = m_vehicles.end(); iter != end; ++iter) {
+				touch(m_universe.getPosition(iter.key()));
+			}
+
+			for (u32 ty = 0; ty < terrain.m_tiles_y; ++ty) {
+				for (u32 tx = 0; tx < terrain.m_tiles_x; ++tx) {
+					Heightfield::Tile& tile = terrain.m_tiles[tx + ty * terrain.m_tiles_x];
+					if (tile.idle_time == 0 && !tile.actor) {
+						createHeightfieldTile(terrain, tx, ty);
+					}
+					else if (tile.actor && tile.idle_time > HEIGHTFIELD_TILE_TIMEOUT) {
+						m_scene->removeActor(*tile.actor, false);
+						tile.actor->release();
+						tile.actor = nullptr;
+					}
+				}
 			}
 		}
 	}
@@ -2650,17 +3082,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 
 		for (auto& terrain : m_terrains)
 		{
-			if (!terrain.m_actor) continue;
-
-			PxFilterData data;
-			int terrain_layer = terrain.m_layer;
-			data.word0 = 1 << terrain_layer;
-			data.word1 = m_layers.filter[terrain_layer];
-			PxShape* shapes[8];
-			int shapes_count = terrain.m_actor->getShapes(shapes, lengthOf(shapes));
-			for (int i = 0; i < shapes_count; ++i)
-			{
-				shapes[i]->setSimulationFilterData(data);
+			for (u32 i = 0, c = terrain.getTilesCount(); i < c; ++i) {
+				if (terrain.m_tiles[i].actor) updateFilterData(terrain.m_tiles[i].actor, terrain.m_layer);
 			}
 		}
 	}
@@ -2952,6 +3375,9 @@ struct PhysicsSceneImpl final : PhysicsScene
 		}
 		else {
 			m_dynamic_actors.swapAndPopItem(entity);
+			m_moved_actors.eraseItem(entity);
+			m_interpolated_actors.eraseItem(entity);
+			actor.moved = false;
 		}
 		if (!actor.physx_actor) return;
 
@@ -3487,7 +3913,7 @@ struct PhysicsSceneImpl final : PhysicsScene
 			serializer.read(terrain.m_y_scale);
 			serializer.read(terrain.m_layer);
 
-			m_terrains.insert(terrain.m_entity, terrain);
+			m_terrains.insert(terrain.m_entity, static_cast<Heightfield&&>(terrain));
 			setHeightmapSource(terrain.m_entity, Path(tmp));
 			m_universe.onComponentCreated(terrain.m_entity, HEIGHTFIELD_TYPE, this);
 		}
@@ -3744,7 +4170,8 @@ struct PhysicsSceneImpl final : PhysicsScene
 			const EntityRef e1 {(i32)(uintptr)user_data};
 			const EntityRef e2 {(i32)(uintptr)hit.actor->userData};
 
-			scene.onControllerHit(e1, e2);
+			MutexGuard guard(scene.m_controller_hits_mutex);
+			scene.m_controller_hits.push({e1, e2});
 		}
 		void onControllerHit(const PxControllersHit& hit) override {}
 		void onObstacleHit(const PxControllerObstacleHit& hit) override {}
@@ -3752,6 +4179,17 @@ struct PhysicsSceneImpl final : PhysicsScene
 		PhysicsSceneImpl& scene;
 	} ;
 
+	struct ControllerHit {
+		EntityRef controller;
+		EntityRef obj;
+	};
+
+	struct ControllerCellItem {
+		u64 key;
+		Controller* controller;
+		bool moved;
+	};
+
 	struct InstancedCube {
 		InstancedCube(IAllocator& allocator) : actors(allocator) {}
 		Vec3 half_extents;
@@ -3778,27 +4216,45 @@ struct PhysicsSceneImpl final : PhysicsScene
 	PxRigidDynamic* m_dummy_actor;
 	PxControllerManager* m_controller_manager;
 	PxMaterial* m_default_material;
-	FilterCallback m_filter_callback;
 
 	HashMap<EntityRef, RigidActor> m_actors;
 	HashMap<PhysicsGeometry*, EntityRef> m_resource_actor_map;
 	AssociativeArray<EntityRef, Joint> m_joints;
 	HashMap<EntityRef, Controller> m_controllers;
+	Array<ControllerCellItem> m_controller_cells;
+	// m_controller_cell_ranges[i] is the first item of i-th cell in m_controller_cells
+	Array<u32> m_controller_cell_ranges;
+	// queued by HitReport, dispatched in updateControllers
+	Array<ControllerHit> m_controller_hits;
+	Mutex m_controller_hits_mutex;
 	HashMap<EntityRef, Heightfield> m_terrains;
+	// heightfield tiles are created within this distance of moving bodies
+	float m_heightfield_stream_distance = 50;
 	HashMap<EntityRef, UniquePtr<Vehicle>> m_vehicles;
 	HashMap<EntityRef, Wheel> m_wheels;
 	HashMap<EntityRef, InstancedCube> m_instanced_cubes;
 	HashMap<EntityRef, InstancedMesh> m_instanced_meshes;
 	PxVehicleDrivableSurfaceToTireFrictionPairs* m_vehicle_frictions;
-	PxBatchQuery* m_vehicle_batch_query;
-	u8 m_vehicle_query_mem[sizeof(PxRaycastQueryResult) * 64 + sizeof(PxRaycastHit) * 64];
-	PxRaycastQueryResult* m_vehicle_results;
+	Array<UniquePtr<VehicleQuery>> m_vehicle_queries;
+	Array<PxVehicleWheels*> m_vehicle_drives;
+	Array<PxVehicleConcurrentUpdateData> m_vehicle_updates;
+	Array<PxVehicleWheelConcurrentUpdateData> m_vehicle_wheel_updates;
 	u64 m_physics_cmps_mask;
 
 	Array<EntityRef> m_dynamic_actors;
-	RigidActor* m_update_in_progress;
+	// dynamic actors moved by simulation since the last updateDynamicActors
+	Array<EntityRef> m_moved_actors;
+	// actors interpolated in the last updateDynamicActors
+	Array<EntityRef> m_interpolated_actors;
+	bool m_is_updating_dynamic_actors;
+	bool m_is_updating_controllers = false;
 	DelegateList<void(const ContactData&)> m_contact_callbacks;
 	bool m_is_game_running;
+	bool m_async_simulation = false;
+	// simulation time not covered by fixed steps yet
+	float m_accumulated_time = 0;
+	// step started by async simulation, not fetched yet
+	bool m_is_simulating = false;
 	u32 m_debug_visualization_flags;
 	CPUDispatcher m_cpu_dispatcher;
 	CollisionLayers& m_layers;
@@ -3808,11 +4264,16 @@ PhysicsSceneImpl::PhysicsSceneImpl(Engine& engine, Universe& context, PhysicsSys
 	: m_allocator(allocator)
 	, m_engine(engine)
 	, m_controllers(m_allocator)
+	, m_controller_cells(m_allocator)
+	, m_controller_cell_ranges(m_allocator)
+	, m_controller_hits(m_allocator)
 	, m_actors(m_allocator)
 	, m_vehicles(m_allocator)
 	, m_wheels(m_allocator)
 	, m_terrains(m_allocator)
 	, m_dynamic_actors(m_allocator)
+	, m_moved_actors(m_allocator)
+	, m_interpolated_actors(m_allocator)
 	, m_instanced_cubes(m_allocator)
 	, m_instanced_meshes(m_allocator)
 	, m_universe(context)
@@ -3822,8 +4283,11 @@ PhysicsSceneImpl::PhysicsSceneImpl(Engine& engine, Universe& context, PhysicsSys
 	, m_joints(m_allocator)
 	, m_script_scene(nullptr)
 	, m_debug_visualization_flags(0)
-	, m_update_in_progress(nullptr)
-	, m_vehicle_batch_query(nullptr)
+	, m_is_updating_dynamic_actors(false)
+	, m_vehicle_queries(m_allocator)
+	, m_vehicle_drives(m_allocator)
+	, m_vehicle_updates(m_allocator)
+	, m_vehicle_wheel_updates(m_allocator)
 	, m_system(&system)
 	, m_hit_report(*this)
 	, m_layers(m_system->getCollisionLayers())
@@ -3853,6 +4317,8 @@ UniquePtr<PhysicsScene> PhysicsScene::create(PhysicsSystem& system, Universe& co
 
 	sceneDesc.filterShader = impl->filterShader;
 	sceneDesc.simulationEventCallback = &impl->m_contact_callback;
+	// dynamic actors are synchronized only if they moved
+	sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS | PxSceneFlag::eEXCLUDE_KINEMATICS_FROM_ACTIVE_ACTORS;
 
 	impl->m_scene = system.getPhysics()->createScene(sceneDesc);
 	if (!impl->m_scene)
@@ -3866,7 +4332,6 @@ UniquePtr<PhysicsScene> PhysicsScene::create(PhysicsSystem& system, Universe& co
 	impl->m_default_material = impl->m_system->getPhysics()->createMaterial(0.5f, 0.5f, 0.1f);
 	PxSphereGeometry geom(1);
 	impl->m_dummy_actor = PxCreateDynamic(impl->m_scene->getPhysics(), PxTransform(PxIdentity), geom, *impl->m_default_material, 1);
-	impl->m_vehicle_batch_query = impl->createVehicleBatchQuery(impl->m_vehicle_query_mem);
 	return UniquePtr<PhysicsSceneImpl>(impl, &allocator);
 }
 
@@ -3923,6 +4388,7 @@ void PhysicsScene::reflect() {
 
 	LUMIX_SCENE(PhysicsSceneImpl, "physics")
 		.LUMIX_FUNC(PhysicsScene::raycast)
+		.LUMIX_FUNC(PhysicsScene::setAsyncSimulation)
 		.LUMIX_CMP(D6Joint, "d6_joint", "Physics / Joint / D6")
 			.LUMIX_PROP(JointConnectedBody, "Connected body")
 			.LUMIX_PROP(JointAxisPosition, "Axis position")
@@ -4090,6 +4556,8 @@ void PhysicsSceneImpl::RigidActor::setPhysxActor(PxRigidActor* actor)
 	physx_actor = actor;
 	if (actor)
 	{
+		pose = actor->getGlobalPose();
+		prev_pose = pose;
 		scene.m_scene->addActor(*actor);
 		actor->userData = (void*)(intptr_t)entity.index;
 		scene.updateFilterData(actor, layer);
@@ -4152,9 +4620,30 @@ void PhysicsSceneImpl::RigidActor::setMesh(PhysicsGeometry* new_value)
 }
 
 
+Heightfield::Heightfield(Heightfield&& rhs)
+	: m_scene(rhs.m_scene)
+	, m_entity(rhs.m_entity)
+	, m_heightmap(rhs.m_heightmap)
+	, m_xz_scale(rhs.m_xz_scale)
+	, m_y_scale(rhs.m_y_scale)
+	, m_layer(rhs.m_layer)
+	, m_tiles(rhs.m_tiles)
+	, m_tiles_x(rhs.m_tiles_x)
+	, m_tiles_y(rhs.m_tiles_y)
+{
+	if (m_heightmap) {
+		m_heightmap->getObserverCb().unbind<&Heightfield::heightmapLoaded>(&rhs);
+		m_heightmap->getObserverCb().bind<&Heightfield::heightmapLoaded>(this);
+	}
+	rhs.m_heightmap = nullptr;
+	rhs.m_tiles = nullptr;
+	rhs.m_tiles_x = rhs.m_tiles_y = 0;
+}
+
+
 Heightfield::~Heightfield()
 {
-	if (m_actor) m_actor->release();
+	if (m_tiles) m_scene->releaseHeightfieldTiles(*this);
 	if (m_heightmap)
 	{
 		m_heightmap->decRefCount();
@@ -2,6 +2,7 @@
 
 
 #include "engine/allocator.h"
+#include "engine/crt.h"
 #include "engine/lumix.h"
 #include "engine/plugin.h"
 #include "engine/math.h"
@@ -48,6 +49,39 @@ struct RaycastHit
 };
 
 
+// `layer` < 0 hits all layers
+struct RaycastQuery
+{
+	Vec3 origin;
+	Vec3 dir;
+	float distance = FLT_MAX;
+	EntityPtr ignored = INVALID_ENTITY;
+	i32 layer = -1;
+};
+
+
+// sphere moved from `origin` along `dir`
+struct SweepQuery
+{
+	Vec3 origin;
+	Vec3 dir;
+	float radius;
+	float distance = FLT_MAX;
+	EntityPtr ignored = INVALID_ENTITY;
+	i32 layer = -1;
+};
+
+
+// sphere at `center`, result is any overlapping entity
+struct OverlapQuery
+{
+	Vec3 center;
+	float radius;
+	EntityPtr ignored = INVALID_ENTITY;
+	i32 layer = -1;
+};
+
+
 struct LUMIX_PHYSICS_API PhysicsScene : IScene
 {
 	enum class D6Motion : int
@@ -89,10 +123,19 @@ struct LUMIX_PHYSICS_API PhysicsScene : IScene
 
 	virtual ~PhysicsScene() {}
 	virtual void forceUpdateDynamicActors(float time_delta) = 0;
+	// simulation step is started in lateUpdate and its results are fetched in the next update, so it runs while the frame is rendered;
+	// until then, only scene queries and PhysX's buffered writes are allowed, dynamic actors are extrapolated to hide the latency
+	virtual void setAsyncSimulation(bool enable) = 0;
+	virtual bool isAsyncSimulation() const = 0;
 	virtual const Array<EntityRef>& getDynamicActors() = 0;
 	virtual void render() = 0;
 	virtual EntityPtr raycast(const Vec3& origin, const Vec3& dir, EntityPtr ignore_entity) = 0;
 	virtual bool raycastEx(const Vec3& origin, const Vec3& dir, float distance, RaycastHit& result, EntityPtr ignored, int layer) = 0;
+	// batched queries are split between workers, `results` must be at least as long as `queries`,
+	// missed queries have INVALID_ENTITY in the result; do not modify the scene while they run
+	virtual void raycastBatch(Span<const RaycastQuery> queries, Span<RaycastHit> results) = 0;
+	virtual void sweepBatch(Span<const SweepQuery> queries, Span<RaycastHit> results) = 0;
+	virtual void overlapBatch(Span<const OverlapQuery> queries, Span<EntityPtr> results) = 0;
 	virtual PhysicsSystem& getSystem() const = 0;
 
 	virtual DelegateList<void(const ContactData&)>& onContact() = 0;
@@ -12,6 +12,10 @@
 #include <vehicle/PxVehicleSDK.h>
 
 #include "cooking/PxCooking.h"
+#include "extensions/PxDefaultStreams.h"
+#include "extensions/PxSerialization.h"
+#include "engine/allocators.h"
+#include "engine/array.h"
 #include "engine/engine.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
@@ -107,10 +111,122 @@ namespace Lumix
 		return 1;
 	}
 
+	// LuaJIT FFI version of raycast, `hit` matches LumixRaycastHit, see lua_api.cpp
+	extern "C" {
+	static bool FFI_raycast(PhysicsScene* scene, const Vec3* origin, const Vec3* dir, float distance, i32 layer, RaycastHit* hit) {
+		return scene->raycastEx(*origin, *dir, distance, *hit, INVALID_ENTITY, layer);
+	}
+	}
+	static_assert(sizeof(RaycastHit) == 2 * sizeof(Vec3) + sizeof(i32));
+
+	static void pushHits(lua_State* L, Span<const RaycastHit> hits, Universe& universe)
+	{
+		lua_createtable(L, hits.length(), 0);
+		for (u32 i = 0; i < hits.length(); ++i) {
+			const RaycastHit& hit = hits[i];
+			if (hit.entity.isValid()) {
+				lua_createtable(L, 0, 3);
+				LuaWrapper::pushEntity(L, hit.entity, &universe);
+				lua_setfield(L, -2, "entity");
+				LuaWrapper::push(L, hit.position);
+				lua_setfield(L, -2, "position");
+				LuaWrapper::push(L, hit.normal);
+				lua_setfield(L, -2, "normal");
+			}
+			else {
+				LuaWrapper::push(L, false);
+			}
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+
+	// Physics.raycastBatch(scene, origins, dirs [, layer]) -> array of {entity, position, normal} or false
+	static int LUA_raycastBatch(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<PhysicsScene*>(L, 1);
+		const int layer = lua_gettop(L) > 3 ? LuaWrapper::checkArg<int>(L, 4) : -1;
+		Universe& universe = scene->getUniverse();
+		Array<RaycastQuery> queries(universe.getAllocator());
+		LuaWrapper::forEachArrayItem<Vec3>(L, 2, "array of vec3 expected", [&](const Vec3& v){
+			RaycastQuery& q = queries.emplace();
+			q.origin = v;
+			q.layer = layer;
+		});
+		u32 i = 0;
+		LuaWrapper::forEachArrayItem<Vec3>(L, 3, "array of vec3 expected", [&](const Vec3& v){
+			if (i < (u32)queries.size()) queries[i].dir = v;
+			++i;
+		});
+		if (i != (u32)queries.size()) luaL_argerror(L, 3, "origins and dirs must have the same length");
+
+		Array<RaycastHit> hits(universe.getAllocator());
+		hits.resize(queries.size());
+		scene->raycastBatch(queries, hits);
+		pushHits(L, hits, universe);
+		return 1;
+	}
+
+	// Physics.sweepBatch(scene, origins, dirs, radius [, distance] [, layer]) -> array of {entity, position, normal} or false
+	static int LUA_sweepBatch(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<PhysicsScene*>(L, 1);
+		const float radius = LuaWrapper::checkArg<float>(L, 4);
+		const float distance = lua_gettop(L) > 4 ? LuaWrapper::checkArg<float>(L, 5) : FLT_MAX;
+		const int layer = lua_gettop(L) > 5 ? LuaWrapper::checkArg<int>(L, 6) : -1;
+		Universe& universe = scene->getUniverse();
+		Array<SweepQuery> queries(universe.getAllocator());
+		LuaWrapper::forEachArrayItem<Vec3>(L, 2, "array of vec3 expected", [&](const Vec3& v){
+			SweepQuery& q = queries.emplace();
+			q.origin = v;
+			q.radius = radius;
+			q.distance = distance;
+			q.layer = layer;
+		});
+		u32 i = 0;
+		LuaWrapper::forEachArrayItem<Vec3>(L, 3, "array of vec3 expected", [&](const Vec3& v){
+			if (i < (u32)queries.size()) queries[i].dir = v;
+			++i;
+		});
+		if (i != (u32)queries.size()) luaL_argerror(L, 3, "origins and dirs must have the same length");
+
+		Array<RaycastHit> hits(universe.getAllocator());
+		hits.resize(queries.size());
+		scene->sweepBatch(queries, hits);
+		pushHits(L, hits, universe);
+		return 1;
+	}
+
+	// Physics.overlapBatch(scene, centers, radius [, layer]) -> array of entities or false
+	static int LUA_overlapBatch(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<PhysicsScene*>(L, 1);
+		const float radius = LuaWrapper::checkArg<float>(L, 3);
+		const int layer = lua_gettop(L) > 3 ? LuaWrapper::checkArg<int>(L, 4) : -1;
+		Universe& universe = scene->getUniverse();
+		Array<OverlapQuery> queries(universe.getAllocator());
+		LuaWrapper::forEachArrayItem<Vec3>(L, 2, "array of vec3 expected", [&](const Vec3& v){
+			OverlapQuery& q = queries.emplace();
+			q.center = v;
+			q.radius = radius;
+			q.layer = layer;
+		});
+
+		Array<EntityPtr> hits(universe.getAllocator());
+		hits.resize(queries.size());
+		scene->overlapBatch(queries, hits);
+		lua_createtable(L, hits.size(), 0);
+		for (i32 i = 0; i < hits.size(); ++i) {
+			if (hits[i].isValid()) LuaWrapper::pushEntity(L, hits[i], &universe);
+			else LuaWrapper::push(L, false);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
 	struct PhysicsSystemImpl final : PhysicsSystem
 	{
 		explicit PhysicsSystemImpl(Engine& engine)
-			: m_allocator(engine.getAllocator())
+			: m_allocator(engine.getAllocator(), "physics")
 			, m_engine(engine)
 			, m_geometry_manager(*this, engine.getAllocator())
 			, m_material_manager(*this, engine.getAllocator())
@@ -131,7 +247,13 @@ namespace Lumix
 			m_material_manager.create(PhysicsMaterial::TYPE, engine.getResourceManager());
 			m_geometry_manager.create(PhysicsGeometry::TYPE, engine.getResourceManager());
 			LuaWrapper::createSystemFunction(engine.getState(), "Physics", "raycast", &LUA_raycast);
+			LuaWrapper::createSystemFunction(engine.getState(), "Physics", "raycastBatch", &LUA_raycastBatch);
+			LuaWrapper::createSystemFunction(engine.getState(), "Physics", "sweepBatch", &LUA_sweepBatch);
+			LuaWrapper::createSystemFunction(engine.getState(), "Physics", "overlapBatch", &LUA_overlapBatch);
+			LuaWrapper::createFFIFunction(engine.getState(), "raycast", "bool(*)(void*, const LumixVec3*, const LumixVec3*, float, int32_t, LumixRaycastHit*)", (void*)&FFI_raycast);
+		}
 
+		void initAsync() override {
 			m_foundation = PxCreateFoundation(PX_PHYSICS_VERSION, m_physx_allocator, m_error_callback);
 
 			#ifdef LUMIX_DEBUG
@@ -145,6 +267,7 @@ namespace Lumix
 
 			physx::PxTolerancesScale scale;
 			m_cooking = PxCreateCooking(PX_PHYSICS_VERSION, *m_foundation, physx::PxCookingParams(scale));
+			m_serialization_registry = physx::PxSerialization::createSerializationRegistry(*m_physics);
 
 			if (!PxInitVehicleSDK(*m_physics)) {
 				ASSERT(false);
@@ -159,6 +282,7 @@ namespace Lumix
 			m_material_manager.destroy();
 			m_geometry_manager.destroy();
 			physx::PxCloseVehicleSDK();
+			m_serialization_registry->release();
 			m_cooking->release();
 			m_physics->release();
 			if (m_pvd) {
@@ -169,23 +293,48 @@ namespace Lumix
 			m_foundation->release();
 		}
 
-		u32 getVersion() const override { return 0; }
+		enum class Version : u32 {
+			FIRST,
+			SIMULATION_RATE,
+			PARALLEL_CONTROLLERS,
+
+			LATEST = PARALLEL_CONTROLLERS
+		};
+
+		u32 getVersion() const override { return (u32)Version::LATEST; }
 
 		void serialize(OutputMemoryStream& serializer) const override {
 			serializer.write(m_layers.count);
 			serializer.write(m_layers.names);
 			serializer.write(m_layers.filter);
+			serializer.write(m_simulation_rate);
+			serializer.write(m_max_substeps);
+			serializer.write(m_parallel_controllers);
 		}
 
 		bool deserialize(u32 version, InputMemoryStream& serializer) override {
-			if (version != 0) return false;
+			if (version > (u32)Version::LATEST) return false;
 
 			serializer.read(m_layers.count);
 			serializer.read(m_layers.names);
 			serializer.read(m_layers.filter);
+			if (version >= (u32)Version::SIMULATION_RATE) {
+				serializer.read(m_simulation_rate);
+				serializer.read(m_max_substeps);
+			}
+			if (version >= (u32)Version::PARALLEL_CONTROLLERS) {
+				serializer.read(m_parallel_controllers);
+			}
 			return true;
 		}
 
+		void setSimulationRate(u32 steps_per_second) override { m_simulation_rate = steps_per_second; }
+		u32 getSimulationRate() const override { return m_simulation_rate; }
+		void setMaxSubsteps(u32 count) override { m_max_substeps = maximum(count, 1); }
+		u32 getMaxSubsteps() const override { return m_max_substeps; }
+		void setParallelControllers(bool enable) override { m_parallel_controllers = enable; }
+		bool areControllersParallel() const override { return m_parallel_controllers; }
+
 		void createScenes(Universe& universe) override
 		{
 			UniquePtr<PhysicsScene> scene = PhysicsScene::create(*this, universe, m_engine, m_allocator);
@@ -194,6 +343,7 @@ namespace Lumix
 
 		physx::PxPhysics* getPhysics() override { return m_physics; }
 		physx::PxCooking* getCooking() override { return m_cooking; }
+		physx::PxSerializationRegistry* getSerializationRegistry() override { return m_serialization_registry; }
 		CollisionLayers& getCollisionLayers() override { return m_layers; }
 
 		bool connect2VisualDebugger()
@@ -232,6 +382,24 @@ namespace Lumix
 			return m_cooking->cookConvexMesh(meshDesc, writeBuffer);
 		}
 
+		bool cookCollection(Span<const Vec3> verts, Span<const u32> indices, bool convex, IOutputStream& blob) override {
+			OutputMemoryStream cooked(m_allocator);
+			if (convex ? !cookConvex(verts, cooked) : !cookTriMesh(verts, indices, cooked)) return false;
+
+			physx::PxDefaultMemoryInputData input((physx::PxU8*)cooked.data(), (physx::PxU32)cooked.size());
+			physx::PxBase* mesh = convex ? (physx::PxBase*)m_physics->createConvexMesh(input) : (physx::PxBase*)m_physics->createTriangleMesh(input);
+			if (!mesh) return false;
+
+			physx::PxCollection* collection = PxCreateCollection();
+			collection->add(*mesh);
+			physx::PxSerialization::complete(*collection, *m_serialization_registry);
+			OutputStream writeBuffer(blob);
+			const bool res = physx::PxSerialization::serializeCollectionToBinary(writeBuffer, *collection, *m_serialization_registry);
+			collection->release();
+			mesh->release();
+			return res;
+		}
+
 		int getCollisionsLayersCount() const override { return m_layers.count; }
 		void addCollisionLayer() override { m_layers.count = minimum(lengthOf(m_layers.names), m_layers.count + 1); }
 		void removeCollisionLayer() override { m_layers.count = maximum(0, m_layers.count - 1); }
@@ -251,17 +419,21 @@ namespace Lumix
 		}
 
 
-		IAllocator& m_allocator;
+		TagAllocator m_allocator;
 		physx::PxPhysics* m_physics;
 		physx::PxFoundation* m_foundation;
 		physx::PxControllerManager* m_controller_manager;
 		AssertNullAllocator m_physx_allocator;
 		CustomErrorCallback m_error_callback;
 		physx::PxCooking* m_cooking;
+		physx::PxSerializationRegistry* m_serialization_registry;
 		PhysicsGeometryManager m_geometry_manager;
 		PhysicsMaterialManager m_material_manager;
 		Engine& m_engine;
 		CollisionLayers m_layers;
+		u32 m_simulation_rate = 0;
+		u32 m_max_substeps = 4;
+		bool m_parallel_controllers = false;
 		physx::PxPvd* m_pvd = nullptr;
 		physx::PxPvdTransport* m_pvd_transport = nullptr;
 	};
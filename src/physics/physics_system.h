@@ -7,6 +7,7 @@ namespace physx {
 	class PxControllerManager;
 	class PxCooking;
 	class PxPhysics;
+	class PxSerializationRegistry;
 } // namespace physx
 
 namespace Lumix {
@@ -25,6 +26,7 @@ struct PhysicsSystem : IPlugin {
 	
 	virtual physx::PxPhysics* getPhysics() = 0;
 	virtual physx::PxCooking* getCooking() = 0;
+	virtual physx::PxSerializationRegistry* getSerializationRegistry() = 0;
 	virtual CollisionLayers& getCollisionLayers() = 0;
 	virtual const char* getCollisionLayerName(int index) = 0;
 	virtual void setCollisionLayerName(int index, const char* name) = 0;
@@ -35,6 +37,19 @@ struct PhysicsSystem : IPlugin {
 	virtual void removeCollisionLayer() = 0;
 	virtual bool cookTriMesh(Span<const struct Vec3> verts, Span<const u32> indices, struct IOutputStream& blob) = 0;
 	virtual bool cookConvex(Span<const Vec3> verts, IOutputStream& blob) = 0;
+	// cooks the mesh and writes it as a physx binary collection, which is deserialized in place when loaded;
+	// the collection is platform specific
+	virtual bool cookCollection(Span<const Vec3> verts, Span<const u32> indices, bool convex, IOutputStream& blob) = 0;
+	// fixed steps per second, 0 means one variable step per update; not used by async simulation
+	virtual void setSimulationRate(u32 steps_per_second) = 0;
+	virtual u32 getSimulationRate() const = 0;
+	// steps simulated in one update at most, the rest of the time is dropped so slow frames do not spiral
+	virtual void setMaxSubsteps(u32 count) = 0;
+	virtual u32 getMaxSubsteps() const = 0;
+	// controllers which can not touch each other are moved in parallel, physx does not document
+	// concurrent PxController::move calls, so it's opt-in
+	virtual void setParallelControllers(bool enable) = 0;
+	virtual bool areControllersParallel() const = 0;
 };
 
 
@@ -10,7 +10,6 @@
 #include "engine/math.h"
 #include "engine/page_allocator.h"
 #include "engine/profiler.h"
-#include "engine/simd.h"
 
 
 namespace Lumix
@@ -63,6 +62,130 @@ struct alignas(4096) CellPage {
 static_assert(sizeof(CellPage) == PageAllocator::PAGE_SIZE);
 
 
+// tests spheres of a page, page is CellPage or OctreePage
+template <typename Page>
+LUMIX_FORCE_INLINE static void doCulling(const Page& cell
+	, const Frustum& frustum
+	, CullResult* LUMIX_RESTRICT results
+	, PagedList<CullResult>& list
+	, u8 type)
+{
+	const EntityPtr* LUMIX_RESTRICT sphere_to_entity_map = cell.entities;
+
+	u32 visible[Page::MAX_COUNT];
+	const u32 visible_count = frustum.cullSpheres(cell.spheres, cell.header.count, visible);
+	int cursor = results->header.count;
+
+	for (u32 i : Span(visible, visible_count)) {
+		if(cursor == lengthOf(results->entities)) {
+			results->header.count = cursor;
+			results = list.push();
+			results->header.type = type;
+			cursor = 0;
+		}
+
+		results->entities[cursor] = (EntityRef)sphere_to_entity_map[i];
+		++cursor;
+	}
+	results->header.count = cursor;
+}
+
+
+// page is completely inside the frustum, returns the last result
+template <typename Page>
+static CullResult* copyAll(const Page& cell, CullResult* result, PagedList<CullResult>& list, u8 type)
+{
+	int to_cpy = cell.header.count;
+	int src_offset = 0;
+	while (to_cpy > 0) {
+		if(result->header.count == lengthOf(result->entities)) {
+			result = list.push();
+			result->header.type = type;
+		}
+		const int rem_space = lengthOf(result->entities) - result->header.count;
+		const int step = minimum(to_cpy, rem_space);
+		memcpy(result->entities + result->header.count, cell.entities + src_offset, step * sizeof(cell.entities[0]));
+		src_offset += step;
+		result->header.count += step;
+		to_cpy -= step;
+	}
+	return result;
+}
+
+
+// one list per frustum in multi frustum culling
+struct MultiCullLists {
+	static_assert(CullingSystem::MAX_CULL_FRUSTA == 8);
+	MultiCullLists(PageAllocator& allocator)
+		: lists{allocator, allocator, allocator, allocator, allocator, allocator, allocator, allocator}
+	{}
+
+	void detach(Span<CullResult*> results) {
+		for (u32 i = 0; i < results.length(); ++i) results[i] = lists[i].detach();
+	}
+
+	PagedList<CullResult> lists[CullingSystem::MAX_CULL_FRUSTA];
+};
+
+
+// returns `result` if entities of `type` can be added to it, otherwise a new result
+static LUMIX_FORCE_INLINE CullResult* getResult(CullResult* result, PagedList<CullResult>& list, u8 type) {
+	if (result && result->header.type == type) return result;
+	result = list.push();
+	result->header.type = type;
+	return result;
+}
+
+
+// adds entities whose bit is set in `masks` to `result`, returns the last result, Entity is EntityPtr or EntityRef
+template <typename Entity>
+static CullResult* addMasked(const Entity* entities, const u8* masks, u32 count, u8 bit, CullResult* result, PagedList<CullResult>& list, u8 type) {
+	u32 cursor = result->header.count;
+	for (u32 i = 0; i < count; ++i) {
+		if ((masks[i] & bit) == 0) continue;
+		if (cursor == lengthOf(result->entities)) {
+			result->header.count = cursor;
+			result = list.push();
+			result->header.type = type;
+			cursor = 0;
+		}
+		result->entities[cursor] = (EntityRef)entities[i];
+		++cursor;
+	}
+	result->header.count = cursor;
+	return result;
+}
+
+
+// tests spheres of a page against frusta whose bit is set in `frusta_mask`, page is CellPage or OctreePage
+template <typename Page>
+static void doMultiCulling(const Page& page
+	, Span<const ShiftedFrustum> frusta
+	, u32 frusta_mask
+	, CullResult** results
+	, MultiCullLists& lists
+	, u8 type)
+{
+	Frustum relative[CullingSystem::MAX_CULL_FRUSTA];
+	u8 frustum_idx[CullingSystem::MAX_CULL_FRUSTA];
+	u32 count = 0;
+	for (u32 i = 0; i < frusta.length(); ++i) {
+		if ((frusta_mask & (1 << i)) == 0) continue;
+		relative[count] = frusta[i].getRelative(page.header.origin);
+		frustum_idx[count] = i;
+		++count;
+	}
+
+	u8 masks[Page::MAX_COUNT];
+	Frustum::intersectSpheres(Span<const Frustum>(relative, count), page.spheres, page.header.count, masks);
+	for (u32 i = 0; i < count; ++i) {
+		const u32 idx = frustum_idx[i];
+		CullResult* result = getResult(results[idx], lists.lists[idx], type);
+		results[idx] = addMasked(page.entities, masks, page.header.count, 1 << i, result, lists.lists[idx], type);
+	}
+}
+
+
 struct CullingSystemImpl final : CullingSystem
 {
 	CullingSystemImpl(IAllocator& allocator, PageAllocator& page_allocator) 
@@ -70,6 +193,7 @@ struct CullingSystemImpl final : CullingSystem
 		, m_cell_map(allocator)
 		, m_entity_to_cell(allocator)
 		, m_cells(allocator)
+		, m_to_move(allocator)
 		, m_cell_size(300.0f)
 		, m_page_allocator(page_allocator)
 	{
@@ -205,6 +329,12 @@ struct CullingSystemImpl final : CullingSystem
 		return m_entity_to_cell[entity.index]->radius;
 	}
 
+	DVec3 getPosition(EntityRef entity) override
+	{
+		const Sphere* sphere = m_entity_to_cell[entity.index];
+		return getCell(*sphere).header.origin + DVec3(sphere->position);
+	}
+
 	void set(EntityRef entity, const DVec3& pos, float radius) override {
 		Sphere* sphere = m_entity_to_cell[entity.index];
 		CellPage& cell = getCell(*sphere);
@@ -224,6 +354,38 @@ struct CullingSystemImpl final : CullingSystem
 		add(entity, type, pos, radius);
 	}
 	
+	void set(Span<const EntityRef> entities, Span<const DVec3> positions, Span<const float> radii) override {
+		PROFILE_FUNCTION();
+		ASSERT(entities.length() == positions.length());
+		ASSERT(entities.length() == radii.length());
+		
+		// entities leaving their cell are moved after all others are updated in place,
+		// moving relocates spheres so it can't be mixed with the in place loop
+		m_to_move.clear();
+		for (u32 i = 0, c = entities.length(); i < c; ++i) {
+			Sphere* sphere = m_entity_to_cell[entities[i].index];
+			CellPage& cell = getCell(*sphere);
+			const DVec3& pos = positions[i];
+			const float radius = radii[i];
+			const IVec3 new_indices(pos * (1 / m_cell_size));
+			const bool is_big = radius > m_cell_size;
+			if (is_big == cell.header.indices.is_big && new_indices == cell.header.indices.pos) {
+				sphere->radius = radius;
+				sphere->position = Vec3(pos - cell.header.origin);
+			}
+			else {
+				m_to_move.push(i);
+			}
+		}
+
+		for (u32 i : m_to_move) {
+			const EntityRef entity = entities[i];
+			const u8 type = getCell(*m_entity_to_cell[entity.index]).header.indices.type;
+			remove(entity);
+			add(entity, type, positions[i], radii[i]);
+		}
+	}
+	
 	void setRadius(EntityRef entity, float radius) override
 	{
 		Sphere* sphere = m_entity_to_cell[entity.index];
@@ -243,6 +405,21 @@ struct CullingSystemImpl final : CullingSystem
 	}
 
 
+	Structure getStructure() const override { return Structure::GRID; }
+	u32 getStaticCount() const override { return 0; }
+	void update() override {}
+
+	void moveTo(CullingSystem& dst) override
+	{
+		for (const CellPage* cell : m_cells) {
+			for (int i = 0; i < cell->header.count; ++i) {
+				const Sphere& sphere = cell->spheres[i];
+				dst.add((EntityRef)cell->entities[i], cell->header.indices.type, cell->header.origin + sphere.position, sphere.radius);
+			}
+		}
+		clear();
+	}
+
 	void clear() override
 	{
 		for(CellPage* page : m_cell_map) {
@@ -261,55 +438,6 @@ struct CullingSystemImpl final : CullingSystem
 		m_entity_to_cell.clear();
 	}
 
-	LUMIX_FORCE_INLINE void doCulling(const CellPage& cell
-		, const Frustum& frustum
-		, CullResult* LUMIX_RESTRICT results
-		, PagedList<CullResult>& list
-		, u8 type)
-	{
-		const Sphere* LUMIX_RESTRICT start = cell.spheres;
-		const Sphere* LUMIX_RESTRICT end = cell.spheres + cell.header.count;
-		const EntityPtr* LUMIX_RESTRICT sphere_to_entity_map = cell.entities;
-
-		const float4 px = f4Load(frustum.xs);
-		const float4 py = f4Load(frustum.ys);
-		const float4 pz = f4Load(frustum.zs);
-		const float4 pd = f4Load(frustum.ds);
-		const float4 px2 = f4Load(&frustum.xs[4]);
-		const float4 py2 = f4Load(&frustum.ys[4]);
-		const float4 pz2 = f4Load(&frustum.zs[4]);
-		const float4 pd2 = f4Load(&frustum.ds[4]);
-		int cursor = results->header.count;
-
-		int i = 0;
-
-		for (const Sphere *sphere = start; sphere < end; ++sphere, ++i) {
-			const float4 cx = f4Splat(sphere->position.x);
-			const float4 cy = f4Splat(sphere->position.y);
-			const float4 cz = f4Splat(sphere->position.z);
-			const float4 r = f4Splat(-sphere->radius);
-
-			float4 t = cx * px + cy * py + cz * pz + pd;
-			t = t - r;
-			if (f4MoveMask(t)) continue;
-
-			t = cx * px2 + cy * py2 + cz * pz2 + pd2;
-			t = t - r;
-			if (f4MoveMask(t)) continue;
-
-			if(cursor == lengthOf(results->entities)) {
-				results->header.count = cursor;
-				results = list.push();
-				results->header.type = type;
-				cursor = 0;
-			}
-
-			results->entities[cursor] = (EntityRef)sphere_to_entity_map[i];
-			++cursor;
-		}
-		results->header.count = cursor;
-	}
-
 	CullResult* cull(const ShiftedFrustum& frustum, u8 type) override
 	{
 		ASSERT(type != 0xff); // 0xff type is reserved for `all types`
@@ -350,20 +478,7 @@ struct CullingSystemImpl final : CullingSystem
 					doCulling(cell, frustum.getRelative(cell.header.origin), result, list, cell.header.indices.type);
 				}
 				else if (frustum.containsAABB(cell.header.origin + v3_cell_size, v3_cell_size)) {
-					int to_cpy = cell.header.count;
-					int src_offset = 0;
-					while (to_cpy > 0) {
-						if(result->header.count == lengthOf(result->entities)) {
-							result = list.push();
-							result->header.type = cell.header.indices.type;
-						}
-						const int rem_space = lengthOf(result->entities) - result->header.count;
-						const int step = minimum(to_cpy, rem_space);
-						memcpy(result->entities + result->header.count, cell.entities + src_offset, step * sizeof(cell.entities[0]));
-						src_offset += step;
-						result->header.count += step;
-						to_cpy -= step;
-					}
+					result = copyAll(cell, result, list, cell.header.indices.type);
 				}
 				else if (frustum.intersectsAABB(cell.header.origin - v3_cell_size, v3_2_cell_size)) {
 					doCulling(cell, frustum.getRelative(cell.header.origin), result, list, cell.header.indices.type);
@@ -374,6 +489,45 @@ struct CullingSystemImpl final : CullingSystem
 
 		return list.detach();
 	}
+
+	void cull(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) override
+	{
+		ASSERT(frusta.length() == results.length());
+		ASSERT(frusta.length() <= MAX_CULL_FRUSTA);
+		for (CullResult*& r : results) r = nullptr;
+		if (m_cells.empty()) return;
+
+		volatile i32 cell_idx = 0;
+		MultiCullLists lists(m_page_allocator);
+
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("multi frustum culling");
+			const Vec3 v3_cell_size(m_cell_size);
+			const Vec3 v3_2_cell_size(2 * m_cell_size);
+			CullResult* current[MAX_CULL_FRUSTA] = {};
+			for(;;) {
+				const i32 idx = atomicIncrement(&cell_idx) - 1;
+				if (idx >= m_cells.size()) return;
+
+				const CellPage& cell = *m_cells[idx];
+				const u8 type = cell.header.indices.type;
+				u32 test_mask = 0;
+				for (u32 i = 0; i < frusta.length(); ++i) {
+					if (!cell.header.indices.is_big) {
+						if (frusta[i].containsAABB(cell.header.origin + v3_cell_size, v3_cell_size)) {
+							current[i] = copyAll(cell, getResult(current[i], lists.lists[i], type), lists.lists[i], type);
+							continue;
+						}
+						if (!frusta[i].intersectsAABB(cell.header.origin - v3_cell_size, v3_2_cell_size)) continue;
+					}
+					test_mask |= 1 << i;
+				}
+				if (test_mask) doMultiCulling(cell, frusta, test_mask, current, lists, type);
+			}
+		});
+
+		lists.detach(results);
+	}
 	
 
 	bool isAdded(EntityRef entity) override
@@ -387,11 +541,1104 @@ struct CullingSystemImpl final : CullingSystem
 	HashMap<CellIndices, CellPage*, CellIndicesHasher> m_cell_map;
 	Array<CellPage*> m_cells;
 	Array<Sphere*> m_entity_to_cell;
+	// scratch for batched set
+	Array<u32> m_to_move;
 	float m_cell_size;
 };
 
 
 
+struct alignas(4096) OctreePage {
+	struct {
+		OctreePage* next = nullptr;
+		DVec3 origin;
+		i32 node;
+		int count = 0;
+		u8 type;
+	} header;
+
+	enum { MAX_COUNT = (PageAllocator::PAGE_SIZE - sizeof(header)) / (sizeof(Sphere) + sizeof(EntityPtr)) };
+
+	Sphere spheres[MAX_COUNT];
+	EntityPtr entities[MAX_COUNT];
+};
+
+static_assert(sizeof(OctreePage) == PageAllocator::PAGE_SIZE);
+
+
+// sphere is stored in the deepest node whose half size is at least its radius and which contains its center,
+// but nodes are split only once they have more than SPLIT_COUNT spheres, so sparse areas stay shallow
+// node's loose bounds are center +- 2 * half_size
+struct OctreeCullingSystem final : CullingSystem
+{
+	static constexpr float ROOT_HALF_SIZE = 65536;
+	static constexpr u32 MAX_DEPTH = 14;
+	static constexpr u32 SPLIT_COUNT = 64;
+
+	struct Node {
+		DVec3 center;
+		float half_size;
+		i32 parent;
+		// or next free node
+		i32 children[8];
+		OctreePage* pages;
+		u32 count;
+		u8 depth;
+		bool is_split;
+	};
+
+	struct Entry {
+		EntityRef entity;
+		u8 type;
+		DVec3 pos;
+		float radius;
+	};
+
+	struct CullItem {
+		const OctreePage* page;
+		bool inside;
+	};
+
+	// bit per frustum
+	struct MultiCullItem {
+		const OctreePage* page;
+		u8 inside;
+		u8 intersecting;
+	};
+
+	OctreeCullingSystem(IAllocator& allocator, PageAllocator& page_allocator) 
+		: m_allocator(allocator)
+		, m_page_allocator(page_allocator)
+		, m_nodes(allocator)
+		, m_entity_to_sphere(allocator)
+		, m_to_move(allocator)
+		, m_tmp_entries(allocator)
+	{
+		initRoot();
+	}
+
+	~OctreeCullingSystem()
+	{
+		clear();
+	}
+
+	void initRoot()
+	{
+		Node& root = m_nodes.emplace();
+		root.center = DVec3(0, 0, 0);
+		root.half_size = ROOT_HALF_SIZE;
+		root.parent = -1;
+		for (i32& c : root.children) c = -1;
+		root.pages = nullptr;
+		root.count = 0;
+		root.depth = 0;
+		root.is_split = false;
+	}
+
+	Structure getStructure() const override { return Structure::LOOSE_OCTREE; }
+	u32 getStaticCount() const override { return 0; }
+	void update() override {}
+
+	static bool fits(const Node& node, const DVec3& pos, float radius)
+	{
+		const float h = node.half_size;
+		if (radius > h) return false;
+		const DVec3 d = pos - node.center;
+		return d.x >= -h && d.x <= h && d.y >= -h && d.y <= h && d.z >= -h && d.z <= h;
+	}
+
+	static u32 getChildIndex(const Node& node, const DVec3& pos)
+	{
+		return (pos.x >= node.center.x ? 1 : 0) | (pos.y >= node.center.y ? 2 : 0) | (pos.z >= node.center.z ? 4 : 0);
+	}
+
+	OctreePage& getPage(const Sphere& sphere) const
+	{
+		const intptr_t ptr = (intptr_t)&sphere;
+		const intptr_t page_ptr = ptr - (ptr % PageAllocator::PAGE_SIZE);
+		return *(OctreePage*)page_ptr;
+	}
+
+	i32 getOrCreateChild(i32 node_idx, u32 child_idx)
+	{
+		if (m_nodes[node_idx].children[child_idx] >= 0) return m_nodes[node_idx].children[child_idx];
+
+		i32 idx;
+		if (m_first_free_node >= 0) {
+			idx = m_first_free_node;
+			m_first_free_node = m_nodes[idx].children[0];
+		}
+		else {
+			idx = m_nodes.size();
+			m_nodes.emplace();
+		}
+
+		const Node& parent = m_nodes[node_idx];
+		Node& child = m_nodes[idx];
+		const double q = parent.half_size * 0.5;
+		child.center = parent.center + DVec3(child_idx & 1 ? q : -q, child_idx & 2 ? q : -q, child_idx & 4 ? q : -q);
+		child.half_size = float(q);
+		child.parent = node_idx;
+		for (i32& c : child.children) c = -1;
+		child.pages = nullptr;
+		child.count = 0;
+		child.depth = parent.depth + 1;
+		child.is_split = false;
+		m_nodes[node_idx].children[child_idx] = idx;
+		return idx;
+	}
+
+	void addToNode(i32 node_idx, EntityRef entity, u8 type, const DVec3& pos, float radius)
+	{
+		Node& node = m_nodes[node_idx];
+		OctreePage* page = node.pages;
+		while (page && (page->header.type != type || page->header.count == OctreePage::MAX_COUNT)) page = page->header.next;
+
+		if (!page) {
+			void* mem = m_page_allocator.allocate(true);
+			page = new (Lumix::NewPlaceholder(), mem) OctreePage;
+			page->header.origin = node.center;
+			page->header.node = node_idx;
+			page->header.type = type;
+			page->header.next = node.pages;
+			node.pages = page;
+		}
+
+		const int idx = page->header.count;
+		page->spheres[idx] = {Vec3(pos - page->header.origin), radius};
+		page->entities[idx] = entity;
+		++page->header.count;
+		++node.count;
+		m_entity_to_sphere[entity.index] = &page->spheres[idx];
+	}
+
+	// moves spheres which fit in children down
+	void split(i32 node_idx)
+	{
+		m_nodes[node_idx].is_split = true;
+		const float child_half_size = m_nodes[node_idx].half_size * 0.5f;
+		
+		m_tmp_entries.clear();
+		for (const OctreePage* page = m_nodes[node_idx].pages; page; page = page->header.next) {
+			for (int i = 0; i < page->header.count; ++i) {
+				const Sphere& sphere = page->spheres[i];
+				if (sphere.radius > child_half_size) continue;
+				m_tmp_entries.push({(EntityRef)page->entities[i], page->header.type, page->header.origin + sphere.position, sphere.radius});
+			}
+		}
+
+		for (const Entry& e : m_tmp_entries) {
+			const u32 child_idx = getChildIndex(m_nodes[node_idx], e.pos);
+			const i32 child = getOrCreateChild(node_idx, child_idx);
+			// root contains also spheres outside of its bounds
+			if (!fits(m_nodes[child], e.pos, e.radius)) continue;
+			removeFromPage(e.entity);
+			addToNode(child, e.entity, e.type, e.pos, e.radius);
+		}
+
+		// children created for spheres outside of root
+		for (i32& child : m_nodes[node_idx].children) {
+			if (child >= 0 && m_nodes[child].count == 0) {
+				freeNode(child);
+				child = -1;
+			}
+		}
+	}
+
+	void freeNode(i32 node_idx)
+	{
+		ASSERT(!m_nodes[node_idx].pages);
+		m_nodes[node_idx].children[0] = m_first_free_node;
+		m_first_free_node = node_idx;
+	}
+
+	// removes nodes without any spheres in their subtree
+	void collectGarbage(i32 node_idx)
+	{
+		while (node_idx > 0) {
+			Node& node = m_nodes[node_idx];
+			if (node.count > 0) return;
+			for (i32 c : node.children) {
+				if (c >= 0) return;
+			}
+			
+			const i32 parent = node.parent;
+			for (i32& c : m_nodes[parent].children) {
+				if (c == node_idx) c = -1;
+			}
+			freeNode(node_idx);
+			node_idx = parent;
+		}
+	}
+
+	// does not collect garbage
+	i32 removeFromPage(EntityRef entity)
+	{
+		Sphere* sphere = m_entity_to_sphere[entity.index];
+		OctreePage& page = getPage(*sphere);
+		const i32 node_idx = page.header.node;
+		Node& node = m_nodes[node_idx];
+
+		const int idx = int(sphere - page.spheres);
+		const int last = page.header.count - 1;
+		if (idx != last) {
+			page.spheres[idx] = page.spheres[last];
+			page.entities[idx] = page.entities[last];
+			m_entity_to_sphere[page.entities[idx].index] = &page.spheres[idx];
+		}
+		--page.header.count;
+		--node.count;
+		m_entity_to_sphere[entity.index] = nullptr;
+
+		if (page.header.count == 0) {
+			OctreePage** iter = &node.pages;
+			while (*iter != &page) iter = &(*iter)->header.next;
+			*iter = page.header.next;
+			page.~OctreePage();
+			m_page_allocator.deallocate(&page, true);
+		}
+		return node_idx;
+	}
+
+	void add(EntityRef entity, u8 type, const DVec3& pos, float radius) override
+	{
+		if (m_entity_to_sphere.size() <= entity.index) {
+			m_entity_to_sphere.reserve(entity.index);
+			while (m_entity_to_sphere.size() <= entity.index) {
+				m_entity_to_sphere.push(nullptr);
+			}
+		}
+
+		i32 node_idx = 0;
+		for (;;) {
+			if (!m_nodes[node_idx].is_split) {
+				const Node& node = m_nodes[node_idx];
+				if (node.count < SPLIT_COUNT || node.depth == MAX_DEPTH) break;
+				split(node_idx);
+			}
+			
+			const Node& node = m_nodes[node_idx];
+			if (node.depth == MAX_DEPTH || radius > node.half_size * 0.5f) break;
+			const u32 child_idx = getChildIndex(node, pos);
+			const i32 child = node.children[child_idx];
+			if (child >= 0) {
+				if (!fits(m_nodes[child], pos, radius)) break;
+				node_idx = child;
+				continue;
+			}
+
+			const i32 new_child = getOrCreateChild(node_idx, child_idx);
+			if (!fits(m_nodes[new_child], pos, radius)) {
+				// outside of root
+				m_nodes[node_idx].children[child_idx] = -1;
+				freeNode(new_child);
+				break;
+			}
+			node_idx = new_child; 
+		}
+
+		addToNode(node_idx, entity, type, pos, radius);
+	}
+
+	void remove(EntityRef entity) override
+	{
+		if (!isAdded(entity)) return;
+		collectGarbage(removeFromPage(entity));
+	}
+
+	bool isAdded(EntityRef entity) override
+	{
+		return entity.index < m_entity_to_sphere.size() && m_entity_to_sphere[entity.index] != nullptr;
+	}
+
+	float getRadius(EntityRef entity) override
+	{
+		return m_entity_to_sphere[entity.index]->radius;
+	}
+
+	DVec3 getPosition(EntityRef entity) override
+	{
+		const Sphere* sphere = m_entity_to_sphere[entity.index];
+		return getPage(*sphere).header.origin + DVec3(sphere->position);
+	}
+
+	// root is not culled, so spheres can stay there wherever they move
+	bool canStay(i32 node_idx, const DVec3& pos, float radius) const
+	{
+		return node_idx == 0 || fits(m_nodes[node_idx], pos, radius);
+	}
+
+	void set(EntityRef entity, const DVec3& pos, float radius) override
+	{
+		Sphere* sphere = m_entity_to_sphere[entity.index];
+		OctreePage& page = getPage(*sphere);
+		if (canStay(page.header.node, pos, radius)) {
+			sphere->position = Vec3(pos - page.header.origin);
+			sphere->radius = radius;
+			return;
+		}
+
+		const u8 type = page.header.type;
+		remove(entity);
+		add(entity, type, pos, radius);
+	}
+
+	void setPosition(EntityRef entity, const DVec3& pos) override
+	{
+		set(entity, pos, m_entity_to_sphere[entity.index]->radius);
+	}
+
+	void setRadius(EntityRef entity, float radius) override
+	{
+		const Sphere* sphere = m_entity_to_sphere[entity.index];
+		set(entity, getPage(*sphere).header.origin + sphere->position, radius);
+	}
+
+	void set(Span<const EntityRef> entities, Span<const DVec3> positions, Span<const float> radii) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(entities.length() == positions.length());
+		ASSERT(entities.length() == radii.length());
+
+		// moving relocates spheres, so it's done after all in place updates
+		m_to_move.clear();
+		for (u32 i = 0, c = entities.length(); i < c; ++i) {
+			Sphere* sphere = m_entity_to_sphere[entities[i].index];
+			const OctreePage& page = getPage(*sphere);
+			if (canStay(page.header.node, positions[i], radii[i])) {
+				sphere->position = Vec3(positions[i] - page.header.origin);
+				sphere->radius = radii[i];
+			}
+			else {
+				m_to_move.push(i);
+			}
+		}
+
+		for (u32 i : m_to_move) {
+			const EntityRef entity = entities[i];
+			const u8 type = getPage(*m_entity_to_sphere[entity.index]).header.type;
+			remove(entity);
+			add(entity, type, positions[i], radii[i]);
+		}
+	}
+
+	void moveTo(CullingSystem& dst) override
+	{
+		for (const Node& node : m_nodes) {
+			for (const OctreePage* page = node.pages; page; page = page->header.next) {
+				for (int i = 0; i < page->header.count; ++i) {
+					const Sphere& sphere = page->spheres[i];
+					dst.add((EntityRef)page->entities[i], page->header.type, page->header.origin + sphere.position, sphere.radius);
+				}
+			}
+		}
+		clear();
+	}
+
+	void clear() override
+	{
+		for (Node& node : m_nodes) {
+			OctreePage* page = node.pages;
+			while (page) {
+				OctreePage* tmp = page;
+				page = page->header.next;
+				tmp->~OctreePage();
+				m_page_allocator.deallocate(tmp, true);
+			}
+			// free nodes have null pages too
+			node.pages = nullptr;
+		}
+		m_nodes.clear();
+		m_entity_to_sphere.clear();
+		m_first_free_node = -1;
+		initRoot();
+	}
+
+	void gatherPages(i32 node_idx, const ShiftedFrustum& frustum, u8 type, bool inside, Array<CullItem>& items) const
+	{
+		const Node& node = m_nodes[node_idx];
+		// root is not tested, it contains also spheres outside of its bounds
+		if (!inside && node_idx != 0) {
+			const float loose_half_size = 2 * node.half_size;
+			const DVec3 min = node.center - DVec3(loose_half_size);
+			const Vec3 size(2 * loose_half_size);
+			if (!frustum.intersectsAABB(min, size)) return;
+			inside = frustum.containsAABB(min, size);
+		}
+
+		for (const OctreePage* page = node.pages; page; page = page->header.next) {
+			if (type == 0xff || page->header.type == type) items.push({page, inside});
+		}
+
+		for (i32 c : node.children) {
+			if (c >= 0) gatherPages(c, frustum, type, inside, items);
+		}
+	}
+
+	void gatherPages(i32 node_idx, Span<const ShiftedFrustum> frusta, u8 visible, u8 inside, Array<MultiCullItem>& items) const
+	{
+		const Node& node = m_nodes[node_idx];
+		// root is not tested, it contains also spheres outside of its bounds
+		if (node_idx != 0 && visible != inside) {
+			const float loose_half_size = 2 * node.half_size;
+			const DVec3 min = node.center - DVec3(loose_half_size);
+			const Vec3 size(2 * loose_half_size);
+			for (u32 i = 0; i < frusta.length(); ++i) {
+				const u8 bit = 1 << i;
+				if ((visible & bit) == 0 || (inside & bit)) continue;
+				if (!frusta[i].intersectsAABB(min, size)) visible &= ~bit;
+				else if (frusta[i].containsAABB(min, size)) inside |= bit;
+			}
+			if (!visible) return;
+		}
+
+		for (const OctreePage* page = node.pages; page; page = page->header.next) {
+			items.push({page, inside, u8(visible & ~inside)});
+		}
+
+		for (i32 c : node.children) {
+			if (c >= 0) gatherPages(c, frusta, visible, inside, items);
+		}
+	}
+
+	CullResult* cull(const ShiftedFrustum& frustum, u8 type) override
+	{
+		ASSERT(type != 0xff); // 0xff type is reserved for `all types`
+		return cullInternal(frustum, type);
+	}
+
+	CullResult* cull(const ShiftedFrustum& frustum) override
+	{
+		return cullInternal(frustum, 0xff);
+	}
+
+	void cull(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) override
+	{
+		ASSERT(frusta.length() == results.length());
+		ASSERT(frusta.length() <= MAX_CULL_FRUSTA);
+		for (CullResult*& r : results) r = nullptr;
+		if (frusta.length() == 0) return;
+
+		// tree is walked once for all frusta, subtrees are rejected per frustum
+		Array<MultiCullItem> items(m_allocator);
+		const u8 all = u8((1 << frusta.length()) - 1);
+		gatherPages(0, frusta, all, 0, items);
+		if (items.empty()) return;
+
+		volatile i32 item_idx = 0;
+		MultiCullLists lists(m_page_allocator);
+
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("multi frustum culling");
+			CullResult* current[MAX_CULL_FRUSTA] = {};
+			for(;;) {
+				const i32 idx = atomicIncrement(&item_idx) - 1;
+				if (idx >= items.size()) break;
+
+				const MultiCullItem& item = items[idx];
+				const OctreePage& page = *item.page;
+				const u8 type = page.header.type;
+				for (u32 i = 0; i < frusta.length(); ++i) {
+					if ((item.inside & (1 << i)) == 0) continue;
+					current[i] = copyAll(page, getResult(current[i], lists.lists[i], type), lists.lists[i], type);
+				}
+				if (item.intersecting) doMultiCulling(page, frusta, item.intersecting, current, lists, type);
+			}
+		});
+
+		lists.detach(results);
+	}
+
+	CullResult* cullInternal(const ShiftedFrustum& frustum, u8 type)
+	{
+		// subtrees are rejected here, pages of visible nodes are tested on workers
+		Array<CullItem> items(m_allocator);
+		gatherPages(0, frustum, type, false, items);
+		if (items.empty()) return nullptr;
+
+		volatile i32 item_idx = 0;
+		PagedList<CullResult> list(m_page_allocator);
+
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("culling");
+			CullResult* result = nullptr;
+			u32 total_count = 0;
+			for(;;) {
+				const i32 idx = atomicIncrement(&item_idx) - 1;
+				if (idx >= items.size()) break;
+
+				const OctreePage& page = *items[idx].page;
+				if (!result || result->header.type != page.header.type) {
+					result = list.push();
+					result->header.type = page.header.type;
+				}
+
+				total_count += page.header.count;
+				if (items[idx].inside) {
+					result = copyAll(page, result, list, page.header.type);
+				}
+				else {
+					doCulling(page, frustum.getRelative(page.header.origin), result, list, page.header.type);
+				}
+			}
+			profiler::pushInt("count", total_count);
+		});
+
+		return list.detach();
+	}
+
+	IAllocator& m_allocator;
+	PageAllocator& m_page_allocator;
+	// root is always m_nodes[0]
+	Array<Node> m_nodes;
+	i32 m_first_free_node = -1;
+	Array<Sphere*> m_entity_to_sphere;
+	// scratch for batched set
+	Array<u32> m_to_move;
+	// scratch for split
+	Array<Entry> m_tmp_entries;
+};
+
+
+// positions and radii in separate arrays, so 4 spheres are tested at once
+struct alignas(4096) StaticPage {
+	struct {
+		// positions and bounds are relative to origin
+		DVec3 origin;
+		Vec3 min;
+		Vec3 max;
+		u32 count = 0;
+		// unique among all static pages, changes whenever the page changes
+		u32 generation;
+		u8 type;
+	} header;
+
+	enum { MAX_COUNT = 200 };
+
+	alignas(16) float xs[MAX_COUNT];
+	alignas(16) float ys[MAX_COUNT];
+	alignas(16) float zs[MAX_COUNT];
+	alignas(16) float rs[MAX_COUNT];
+	EntityRef entities[MAX_COUNT];
+};
+
+static_assert(sizeof(StaticPage) == PageAllocator::PAGE_SIZE);
+
+
+// renderables which do not move for a while are packed to static pages, which are never updated in place,
+// the rest stays in the wrapped structure, moving a static renderable moves it back there
+struct StaticDynamicCullingSystem final : CullingSystem
+{
+	// renderable is static if it did not move for this many updates
+	static constexpr u32 SETTLE_UPDATES = 30;
+	static constexpr u32 MIN_BAKE_COUNT = 64;
+	// maximal extent of a static page, so page bounds stay tight
+	static constexpr float MAX_PAGE_EXTENT = 1024;
+	static constexpr u32 INVALID_INDEX = 0xffFFffFF;
+
+	struct DynamicEntry {
+		EntityRef entity;
+		u8 type;
+		DVec3 pos;
+		float radius;
+		u32 last_moved;
+	};
+
+	struct BakeEntry {
+		u64 key;
+		u32 dynamic_idx;
+	};
+
+	StaticDynamicCullingSystem(IAllocator& allocator, PageAllocator& page_allocator, UniquePtr<CullingSystem>&& dynamic)
+		: m_allocator(allocator)
+		, m_page_allocator(page_allocator)
+		, m_dynamic(dynamic.move())
+		, m_static_pages(allocator)
+		, m_static_loc(allocator)
+		, m_dynamic_entries(allocator)
+		, m_dynamic_idx(allocator)
+		, m_dynamic_scratch(allocator)
+		, m_positions_scratch(allocator)
+		, m_radii_scratch(allocator)
+	{}
+
+	~StaticDynamicCullingSystem()
+	{
+		clearStatic();
+	}
+
+	Structure getStructure() const override { return m_dynamic->getStructure(); }
+
+	u32 getStaticCount() const override { return m_static_count; }
+
+	void reserveEntity(EntityRef entity)
+	{
+		while (m_static_loc.size() <= (u32)entity.index) {
+			m_static_loc.push(INVALID_INDEX);
+			m_dynamic_idx.push(INVALID_INDEX);
+		}
+	}
+
+	bool isStatic(EntityRef entity) const
+	{
+		return (u32)entity.index < m_static_loc.size() && m_static_loc[entity.index] != INVALID_INDEX;
+	}
+
+	StaticPage& getStaticPage(EntityRef entity) const { return *m_static_pages[m_static_loc[entity.index] >> 8]; }
+	u32 getStaticSlot(EntityRef entity) const { return m_static_loc[entity.index] & 0xff; }
+
+	void addDynamic(EntityRef entity, u8 type, const DVec3& pos, float radius)
+	{
+		m_dynamic->add(entity, type, pos, radius);
+		m_dynamic_idx[entity.index] = m_dynamic_entries.size();
+		m_dynamic_entries.push({entity, type, pos, radius, m_update_counter});
+	}
+
+	void removeDynamic(EntityRef entity)
+	{
+		m_dynamic->remove(entity);
+		const u32 idx = m_dynamic_idx[entity.index];
+		m_dynamic_idx[m_dynamic_entries.back().entity.index] = idx;
+		m_dynamic_entries.swapAndPop(idx);
+		m_dynamic_idx[entity.index] = INVALID_INDEX;
+	}
+
+	void removeStatic(EntityRef entity)
+	{
+		const u32 page_idx = m_static_loc[entity.index] >> 8;
+		const u32 slot = getStaticSlot(entity);
+		StaticPage& page = *m_static_pages[page_idx];
+		
+		// bounds are not shrinked, they stay conservative
+		const u32 last = page.header.count - 1;
+		if (slot != last) {
+			page.xs[slot] = page.xs[last];
+			page.ys[slot] = page.ys[last];
+			page.zs[slot] = page.zs[last];
+			page.rs[slot] = page.rs[last];
+			page.entities[slot] = page.entities[last];
+			m_static_loc[page.entities[slot].index] = (page_idx << 8) | slot;
+		}
+		--page.header.count;
+		--m_static_count;
+		page.header.generation = newGeneration();
+		m_static_loc[entity.index] = INVALID_INDEX;
+
+		if (page.header.count == 0) {
+			page.~StaticPage();
+			m_page_allocator.deallocate(&page, true);
+			m_static_pages.swapAndPop(page_idx);
+			if (page_idx < (u32)m_static_pages.size()) {
+				const StaticPage& moved = *m_static_pages[page_idx];
+				for (u32 i = 0; i < moved.header.count; ++i) {
+					m_static_loc[moved.entities[i].index] = (page_idx << 8) | i;
+				}
+			}
+		}
+	}
+
+	// moves static renderable to the dynamic structure, where it can be cheaply moved
+	void makeDynamic(EntityRef entity, const DVec3& pos, float radius)
+	{
+		const u8 type = getStaticPage(entity).header.type;
+		removeStatic(entity);
+		addDynamic(entity, type, pos, radius);
+	}
+
+	void add(EntityRef entity, u8 type, const DVec3& pos, float radius) override
+	{
+		reserveEntity(entity);
+		addDynamic(entity, type, pos, radius);
+	}
+
+	void remove(EntityRef entity) override
+	{
+		if ((u32)entity.index >= m_static_loc.size()) return;
+		if (isStatic(entity)) removeStatic(entity);
+		else if (m_dynamic_idx[entity.index] != INVALID_INDEX) removeDynamic(entity);
+	}
+
+	bool isAdded(EntityRef entity) override
+	{
+		return isStatic(entity) || ((u32)entity.index < m_dynamic_idx.size() && m_dynamic_idx[entity.index] != INVALID_INDEX);
+	}
+
+	float getRadius(EntityRef entity) override
+	{
+		if (isStatic(entity)) return getStaticPage(entity).rs[getStaticSlot(entity)];
+		return m_dynamic_entries[m_dynamic_idx[entity.index]].radius;
+	}
+
+	DVec3 getPosition(EntityRef entity) override
+	{
+		if (isStatic(entity)) {
+			const StaticPage& page = getStaticPage(entity);
+			const u32 slot = getStaticSlot(entity);
+			return page.header.origin + DVec3(page.xs[slot], page.ys[slot], page.zs[slot]);
+		}
+		return m_dynamic_entries[m_dynamic_idx[entity.index]].pos;
+	}
+
+	void set(EntityRef entity, const DVec3& pos, float radius) override
+	{
+		if (isStatic(entity)) {
+			makeDynamic(entity, pos, radius);
+			return;
+		}
+		
+		DynamicEntry& e = m_dynamic_entries[m_dynamic_idx[entity.index]];
+		e.pos = pos;
+		e.radius = radius;
+		e.last_moved = m_update_counter;
+		m_dynamic->set(entity, pos, radius);
+	}
+
+	void setPosition(EntityRef entity, const DVec3& pos) override
+	{
+		set(entity, pos, getRadius(entity));
+	}
+
+	void setRadius(EntityRef entity, float radius) override
+	{
+		if (isStatic(entity)) {
+			// does not move, so it can stay
+			StaticPage& page = getStaticPage(entity);
+			const u32 slot = getStaticSlot(entity);
+			page.rs[slot] = radius;
+			const Vec3 p(page.xs[slot], page.ys[slot], page.zs[slot]);
+			page.header.min = minimum(page.header.min, p - Vec3(radius));
+			page.header.max = maximum(page.header.max, p + Vec3(radius));
+			return;
+		}
+
+		DynamicEntry& e = m_dynamic_entries[m_dynamic_idx[entity.index]];
+		e.radius = radius;
+		m_dynamic->setRadius(entity, radius);
+	}
+
+	void set(Span<const EntityRef> entities, Span<const DVec3> positions, Span<const float> radii) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(entities.length() == positions.length());
+		ASSERT(entities.length() == radii.length());
+		
+		m_dynamic_scratch.clear();
+		m_positions_scratch.clear();
+		m_radii_scratch.clear();
+		for (u32 i = 0, c = entities.length(); i < c; ++i) {
+			const EntityRef entity = entities[i];
+			if (isStatic(entity)) {
+				makeDynamic(entity, positions[i], radii[i]);
+				continue;
+			}
+
+			DynamicEntry& e = m_dynamic_entries[m_dynamic_idx[entity.index]];
+			e.pos = positions[i];
+			e.radius = radii[i];
+			e.last_moved = m_update_counter;
+			m_dynamic_scratch.push(entity);
+			m_positions_scratch.push(positions[i]);
+			m_radii_scratch.push(radii[i]);
+		}
+		
+		if (m_dynamic_scratch.size() == (i32)entities.length()) {
+			m_dynamic->set(entities, positions, radii);
+		}
+		else if (!m_dynamic_scratch.empty()) {
+			m_dynamic->set(m_dynamic_scratch, m_positions_scratch, m_radii_scratch);
+		}
+	}
+
+	static u32 newGeneration()
+	{
+		// shared by all culling systems, so generations stay unique when the structure changes
+		static volatile i32 generation = 0;
+		return (u32)atomicIncrement(&generation);
+	}
+
+	static u64 getBakeKey(u8 type, const DVec3& pos)
+	{
+		// morton code of 32-unit cells, so pages contain nearby renderables
+		auto spread = [](double v) -> u64 {
+			const i64 cell = clamp(i64(v * (1 / 32.0)) + (1 << 17), (i64)0, (i64)(1 << 18) - 1);
+			u64 x = (u64)cell;
+			u64 res = 0;
+			for (u32 i = 0; i < 18; ++i) res |= ((x >> i) & 1) << (3 * i);
+			return res;
+		};
+		return (u64(type) << 56) | spread(pos.x) | (spread(pos.y) << 1) | (spread(pos.z) << 2);
+	}
+
+	void bake(Array<BakeEntry>& to_bake)
+	{
+		PROFILE_FUNCTION();
+		qsort(to_bake.begin(), to_bake.size(), sizeof(to_bake[0]), [](const void* a, const void* b) -> int {
+			const u64 ka = ((const BakeEntry*)a)->key;
+			const u64 kb = ((const BakeEntry*)b)->key;
+			return ka < kb ? -1 : (ka > kb ? 1 : 0);
+		});
+
+		StaticPage* page = nullptr;
+		for (const BakeEntry& b : to_bake) {
+			const DynamicEntry& e = m_dynamic_entries[b.dynamic_idx];
+			if (page) {
+				const Vec3 p = Vec3(e.pos - page->header.origin);
+				const Vec3 new_min = minimum(page->header.min, p - Vec3(e.radius));
+				const Vec3 new_max = maximum(page->header.max, p + Vec3(e.radius));
+				const Vec3 extent = new_max - new_min;
+				const bool fits = page->header.count < StaticPage::MAX_COUNT
+					&& page->header.type == e.type
+					&& maximum(extent.x, maximum(extent.y, extent.z)) <= MAX_PAGE_EXTENT;
+				if (!fits) page = nullptr;
+			}
+
+			if (!page) {
+				void* mem = m_page_allocator.allocate(true);
+				page = new (Lumix::NewPlaceholder(), mem) StaticPage;
+				page->header.origin = e.pos;
+				page->header.type = e.type;
+				page->header.generation = newGeneration();
+				page->header.min = Vec3(-e.radius);
+				page->header.max = Vec3(e.radius);
+				m_static_pages.push(page);
+			}
+
+			const u32 slot = page->header.count;
+			const Vec3 p = Vec3(e.pos - page->header.origin);
+			page->xs[slot] = p.x;
+			page->ys[slot] = p.y;
+			page->zs[slot] = p.z;
+			page->rs[slot] = e.radius;
+			page->entities[slot] = e.entity;
+			page->header.min = minimum(page->header.min, p - Vec3(e.radius));
+			page->header.max = maximum(page->header.max, p + Vec3(e.radius));
+			++page->header.count;
+			++m_static_count;
+			m_static_loc[e.entity.index] = ((m_static_pages.size() - 1) << 8) | slot;
+		}
+
+		// m_dynamic_entries indices change here, so it's done after all are baked
+		for (const BakeEntry& b : to_bake) {
+			m_dynamic->remove(m_dynamic_entries[b.dynamic_idx].entity);
+		}
+		for (i32 i = m_dynamic_entries.size() - 1; i >= 0; --i) {
+			const EntityRef entity = m_dynamic_entries[i].entity;
+			if (!isStatic(entity)) continue;
+			m_dynamic_idx[m_dynamic_entries.back().entity.index] = i;
+			m_dynamic_entries.swapAndPop(i);
+			m_dynamic_idx[entity.index] = INVALID_INDEX;
+		}
+	}
+
+	void update() override
+	{
+		++m_update_counter;
+		if (m_update_counter % SETTLE_UPDATES != 0) return;
+		
+		Array<BakeEntry> to_bake(m_allocator);
+		for (u32 i = 0, c = m_dynamic_entries.size(); i < c; ++i) {
+			const DynamicEntry& e = m_dynamic_entries[i];
+			if (m_update_counter - e.last_moved < SETTLE_UPDATES) continue;
+			to_bake.push({getBakeKey(e.type, e.pos), i});
+		}
+		if (to_bake.size() < MIN_BAKE_COUNT) return;
+		bake(to_bake);
+	}
+
+	void clearStatic()
+	{
+		for (StaticPage* page : m_static_pages) {
+			page->~StaticPage();
+			m_page_allocator.deallocate(page, true);
+		}
+		m_static_pages.clear();
+		m_static_count = 0;
+	}
+
+	void clear() override
+	{
+		clearStatic();
+		m_dynamic->clear();
+		m_static_loc.clear();
+		m_dynamic_entries.clear();
+		m_dynamic_idx.clear();
+	}
+
+	void moveTo(CullingSystem& dst) override
+	{
+		for (const StaticPage* page : m_static_pages) {
+			for (u32 i = 0; i < page->header.count; ++i) {
+				const DVec3 pos = page->header.origin + Vec3(page->xs[i], page->ys[i], page->zs[i]);
+				dst.add(page->entities[i], page->header.type, pos, page->rs[i]);
+			}
+		}
+		m_dynamic->moveTo(dst);
+		clear();
+	}
+
+	static void cullStaticPage(const StaticPage& page, const Frustum& frustum, CullResult*& result, PagedList<CullResult>& list)
+	{
+		u32 visible[StaticPage::MAX_COUNT];
+		const u32 visible_count = frustum.cullSpheres(page.xs, page.ys, page.zs, page.rs, page.header.count, visible);
+		for (u32 i : Span(visible, visible_count)) {
+			if (result->header.count == lengthOf(result->entities)) {
+				result = list.push();
+				result->header.type = page.header.type;
+			}
+			result->entities[result->header.count] = page.entities[i];
+			++result->header.count;
+		}
+	}
+
+	CullResult* cullStatic(const ShiftedFrustum& frustum, u8 type)
+	{
+		if (m_static_pages.empty()) return nullptr;
+
+		volatile i32 page_idx = 0;
+		PagedList<CullResult> list(m_page_allocator);
+
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("culling static");
+			CullResult* result = nullptr;
+			u32 total_count = 0;
+			for(;;) {
+				const i32 idx = atomicIncrement(&page_idx) - 1;
+				if (idx >= m_static_pages.size()) break;
+
+				const StaticPage& page = *m_static_pages[idx];
+				if (type != 0xff && page.header.type != type) continue;
+				
+				const DVec3 min = page.header.origin + page.header.min;
+				const Vec3 size = page.header.max - page.header.min;
+				if (!frustum.intersectsAABB(min, size)) continue;
+				
+				total_count += page.header.count;
+
+				if (frustum.containsAABB(min, size)) {
+					// whole page in its own result, renderer can cache data per cell
+					static_assert(StaticPage::MAX_COUNT <= sizeof(CullResult::entities) / sizeof(EntityRef));
+					CullResult* cell_result = list.push();
+					cell_result->header.type = page.header.type;
+					cell_result->header.cell_generation = page.header.generation;
+					copyAll(page, cell_result, list, page.header.type);
+					result = nullptr;
+				}
+				else {
+					if (!result || result->header.type != page.header.type) {
+						result = list.push();
+						result->header.type = page.header.type;
+					}
+					cullStaticPage(page, frustum.getRelative(page.header.origin), result, list);
+				}
+			}
+			profiler::pushInt("count", total_count);
+		});
+
+		return list.detach();
+	}
+
+	void cullStatic(Span<const ShiftedFrustum> frusta, Span<CullResult*> results)
+	{
+		for (CullResult*& r : results) r = nullptr;
+		if (m_static_pages.empty()) return;
+
+		volatile i32 page_idx = 0;
+		MultiCullLists lists(m_page_allocator);
+
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("multi frustum culling static");
+			CullResult* current[MAX_CULL_FRUSTA] = {};
+			for(;;) {
+				const i32 idx = atomicIncrement(&page_idx) - 1;
+				if (idx >= m_static_pages.size()) break;
+
+				const StaticPage& page = *m_static_pages[idx];
+				const u8 type = page.header.type;
+				const DVec3 min = page.header.origin + page.header.min;
+				const Vec3 size = page.header.max - page.header.min;
+
+				Frustum relative[MAX_CULL_FRUSTA];
+				u8 frustum_idx[MAX_CULL_FRUSTA];
+				u32 relative_count = 0;
+				for (u32 i = 0; i < frusta.length(); ++i) {
+					const ShiftedFrustum& frustum = frusta[i];
+					if (!frustum.intersectsAABB(min, size)) continue;
+					if (frustum.containsAABB(min, size)) {
+						// whole page in its own result, renderer can cache data per cell
+						CullResult* cell_result = lists.lists[i].push();
+						cell_result->header.type = type;
+						cell_result->header.cell_generation = page.header.generation;
+						copyAll(page, cell_result, lists.lists[i], type);
+						current[i] = nullptr;
+						continue;
+					}
+					relative[relative_count] = frustum.getRelative(page.header.origin);
+					frustum_idx[relative_count] = i;
+					++relative_count;
+				}
+				if (relative_count == 0) continue;
+
+				u8 masks[StaticPage::MAX_COUNT];
+				Frustum::intersectSpheres(Span<const Frustum>(relative, relative_count), page.xs, page.ys, page.zs, page.rs, page.header.count, masks);
+				for (u32 i = 0; i < relative_count; ++i) {
+					const u32 fidx = frustum_idx[i];
+					CullResult* result = getResult(current[fidx], lists.lists[fidx], type);
+					current[fidx] = addMasked(page.entities, masks, page.header.count, 1 << i, result, lists.lists[fidx], type);
+				}
+			}
+		});
+
+		lists.detach(results);
+	}
+
+	static CullResult* merge(CullResult* a, CullResult* b)
+	{
+		if (!a) return b;
+		if (b) a->merge(b);
+		return a;
+	}
+
+	CullResult* cull(const ShiftedFrustum& frustum, u8 type) override
+	{
+		ASSERT(type != 0xff); // 0xff type is reserved for `all types`
+		return merge(m_dynamic->cull(frustum, type), cullStatic(frustum, type));
+	}
+
+	CullResult* cull(const ShiftedFrustum& frustum) override
+	{
+		return merge(m_dynamic->cull(frustum), cullStatic(frustum, 0xff));
+	}
+
+	void cull(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) override
+	{
+		ASSERT(frusta.length() == results.length());
+		ASSERT(frusta.length() <= MAX_CULL_FRUSTA);
+		CullResult* dynamic[MAX_CULL_FRUSTA];
+		m_dynamic->cull(frusta, Span(dynamic, frusta.length()));
+		cullStatic(frusta, results);
+		for (u32 i = 0; i < results.length(); ++i) {
+			results[i] = merge(dynamic[i], results[i]);
+		}
+	}
+
+	IAllocator& m_allocator;
+	PageAllocator& m_page_allocator;
+	UniquePtr<CullingSystem> m_dynamic;
+	Array<StaticPage*> m_static_pages;
+	u32 m_static_count = 0;
+	// page index << 8 | slot, per entity
+	Array<u32> m_static_loc;
+	// everything in m_dynamic, to know which renderables settled
+	Array<DynamicEntry> m_dynamic_entries;
+	Array<u32> m_dynamic_idx;
+	u32 m_update_counter = 0;
+	// scratch for batched set
+	Array<EntityRef> m_dynamic_scratch;
+	Array<DVec3> m_positions_scratch;
+	Array<float> m_radii_scratch;
+};
+
+
 void CullResult::free(PageAllocator& allocator)
 {
 	CullResult* i = this;
@@ -403,9 +1650,14 @@ void CullResult::free(PageAllocator& allocator)
 }
 
 
-UniquePtr<CullingSystem> CullingSystem::create(IAllocator& allocator, PageAllocator& page_allocator)
+UniquePtr<CullingSystem> CullingSystem::create(IAllocator& allocator, PageAllocator& page_allocator, Structure structure)
 {
-	return UniquePtr<CullingSystemImpl>::create(allocator, allocator, page_allocator);
+	UniquePtr<CullingSystem> dynamic;
+	switch (structure) {
+		case Structure::LOOSE_OCTREE: dynamic = UniquePtr<OctreeCullingSystem>::create(allocator, allocator, page_allocator); break;
+		case Structure::GRID: dynamic = UniquePtr<CullingSystemImpl>::create(allocator, allocator, page_allocator); break;
+	}
+	return UniquePtr<StaticDynamicCullingSystem>::create(allocator, allocator, page_allocator, dynamic.move());
 }
 
 }
\ No newline at end of file
@@ -51,6 +51,8 @@ struct CullResult {
 	struct {
 		CullResult* next = nullptr;
 		u32 count = 0;
+		// nonzero if this contains exactly all entities of a static cell, changes whenever the cell changes
+		u32 cell_generation = 0;
 		u8 type;
 	} header;
 
@@ -59,15 +61,33 @@ struct CullResult {
 
 struct LUMIX_RENDERER_API CullingSystem
 {
+	enum class Structure : u8 {
+		// hashed uniform grid 
+		GRID,
+		// adapts to density, whole subtrees are accepted or rejected by frustum
+		LOOSE_OCTREE
+	};
+
+	static constexpr u32 MAX_CULL_FRUSTA = 8;
+
 	CullingSystem() { }
 	virtual ~CullingSystem() { }
 
-	static UniquePtr<CullingSystem> create(IAllocator& allocator, PageAllocator& page_allocator);
+	static UniquePtr<CullingSystem> create(IAllocator& allocator, PageAllocator& page_allocator, Structure structure = Structure::GRID);
 
+	// structure of the dynamic partition, renderables which do not move are kept in a separate static one
+	virtual Structure getStructure() const = 0;
+	// renderables which did not move for a while are packed to the static partition, call once per frame
+	virtual void update() = 0;
+	virtual u32 getStaticCount() const = 0;
+	// adds all entities to `dst` and removes them from this
+	virtual void moveTo(CullingSystem& dst) = 0;
 	virtual void clear() = 0;
 
 	virtual CullResult* cull(const ShiftedFrustum& frustum, u8 type) = 0;
 	virtual CullResult* cull(const ShiftedFrustum& frustum) = 0;
+	// culls all types with up to MAX_CULL_FRUSTA frusta in one traversal, results[i] belongs to frusta[i]
+	virtual void cull(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) = 0;
 
 	virtual bool isAdded(EntityRef entity) = 0;
 	virtual void add(EntityRef entity, u8 type, const DVec3& pos, float radius) = 0;
@@ -76,8 +96,11 @@ struct LUMIX_RENDERER_API CullingSystem
 	virtual void setPosition(EntityRef entity, const DVec3& pos) = 0;
 	virtual void setRadius(EntityRef entity, float radius) = 0;
 	virtual void set(EntityRef entity, const DVec3& pos, float radius) = 0;
+	// all entities must be added
+	virtual void set(Span<const EntityRef> entities, Span<const DVec3> positions, Span<const float> radii) = 0;
 
 	virtual float getRadius(EntityRef entity) = 0;
+	virtual DVec3 getPosition(EntityRef entity) = 0;
 };
 
 } // namespace Lumix
@@ -5,11 +5,17 @@
 namespace Lumix {
 
 
+// text runs not drawn for this many frames are dropped from the cache
+static constexpr u32 TEXT_RUN_LIFETIME = 64;
+
+
 Draw2D::Draw2D(IAllocator& allocator) 
-	: m_cmds(allocator)
+	: m_allocator(allocator)
+	, m_cmds(allocator)
 	, m_indices(allocator)
 	, m_vertices(allocator)
 	, m_clip_queue(allocator)
+	, m_text_runs(allocator)
 {
 	clear({1, 1});
 }
@@ -27,6 +33,41 @@ void Draw2D::clear(Vec2 atlas_size) {
 	cmd.clip_size = { -1, -1 };
 	m_clip_queue.clear();
 	m_clip_queue.push({{-1, -1}, {-2, -2}});
+
+	++m_frame;
+	if (m_frame % TEXT_RUN_LIFETIME == 0) {
+		const u32 frame = m_frame;
+		m_text_runs.eraseIf([frame](const TextRun& run){ return frame - run.last_used_frame > TEXT_RUN_LIFETIME; });
+	}
+}
+
+// continues the last command if it uses the same texture and clip rect, so consecutive quads end up in one draw call
+Draw2D::Cmd& Draw2D::getCmd(gpu::TextureHandle* tex) {
+	Cmd* cmd = &m_cmds.back();
+	if (cmd->texture != tex && cmd->indices_count != 0) {
+		cmd = &m_cmds.emplace();
+		const Rect& r = m_clip_queue.back();
+		cmd->clip_pos = r.from;
+		cmd->clip_size = r.to - r.from;
+		cmd->indices_count = 0;
+		cmd->index_offset = m_indices.size();
+	}
+	cmd->texture = tex;
+	return *cmd;
+}
+
+void Draw2D::setClipRect(const Rect& r) {
+	const Vec2 size = r.to - r.from;
+	Cmd* cmd = &m_cmds.back();
+	if (cmd->indices_count != 0) {
+		if (cmd->clip_pos.x == r.from.x && cmd->clip_pos.y == r.from.y && cmd->clip_size.x == size.x && cmd->clip_size.y == size.y) return;
+		cmd = &m_cmds.emplace();
+		cmd->texture = nullptr;
+		cmd->indices_count = 0;
+		cmd->index_offset = m_indices.size();
+	}
+	cmd->clip_pos = r.from;
+	cmd->clip_size = size;
 }
 
 void Draw2D::pushClipRect(const Vec2& from, const Vec2& to) {
@@ -44,41 +85,20 @@ void Draw2D::pushClipRect(const Vec2& from, const Vec2& to) {
 	r.to.y = maximum(r.from.y, r.to.y);
 
 	m_clip_queue.push({r.from, r.to});
-	Cmd& cmd = m_cmds.emplace();
-	cmd.texture = nullptr;
-	cmd.clip_pos = r.from;
-	cmd.clip_size = r.to - r.from;
-	cmd.indices_count = 0;
-	cmd.index_offset = m_indices.size();
+	setClipRect(r);
 }
 
 void Draw2D::popClipRect() {
 	m_clip_queue.pop();
-	const Rect& r = m_clip_queue.back();
-	Cmd& cmd = m_cmds.emplace();
-	cmd.texture = nullptr;
-	cmd.clip_pos = r.from;
-	cmd.clip_size = r.to - r.from;
-	cmd.indices_count = 0;
-	cmd.index_offset = m_indices.size();
+	setClipRect(m_clip_queue.back());
 }
 
 void Draw2D::addLine(const Vec2& p0, const Vec2& p1, Color color, float width) {
-	Cmd* cmd = &m_cmds.back();
-
-	if (cmd->texture != nullptr && cmd->indices_count != 0) {
-		cmd = &m_cmds.emplace();
-		const Rect& r = m_clip_queue.back();
-		cmd->clip_pos = r.from;
-		cmd->clip_size = r.to - r.from;
-		cmd->indices_count = 0;
-		cmd->index_offset = m_indices.size();
-	}
+	Cmd& cmd = getCmd(nullptr);
 	
 	Vec2 from = p0 + Vec2(0.5f);
 	Vec2 to = p1 + Vec2(0.5f);
 
-	cmd->texture = nullptr;
 	const Vec2 uv = Vec2(0.5f) / m_atlas_size;
 	const Vec2 dir = normalize(to - from);
 	const Vec2 n = Vec2(dir.y, -dir.x) * (width * 0.5f);
@@ -100,7 +120,7 @@ void Draw2D::addLine(const Vec2& p0, const Vec2& p1, Color color, float width) {
 	m_indices.push(voff + 2);
 	m_indices.push(voff + 3);
 
-	cmd->indices_count += 6;
+	cmd.indices_count += 6;
 }
 
 void Draw2D::addRect(const Vec2& from, const Vec2& to, Color color, float width) {
@@ -111,18 +131,8 @@ void Draw2D::addRect(const Vec2& from, const Vec2& to, Color color, float width)
 }
 
 void Draw2D::addRectFilled(const Vec2& from, const Vec2& to, Color color) {
-	Cmd* cmd = &m_cmds.back();
-
-	if (cmd->texture != nullptr && cmd->indices_count != 0) {
-		cmd = &m_cmds.emplace();
-		const Rect& r = m_clip_queue.back();
-		cmd->clip_pos = r.from;
-		cmd->clip_size = r.to - r.from;
-		cmd->indices_count = 0;
-		cmd->index_offset = m_indices.size();
-	}
+	Cmd& cmd = getCmd(nullptr);
 
-	cmd->texture = nullptr;
 	const u32 voff = m_vertices.size();
 	m_indices.push(voff);
 	m_indices.push(voff + 1);
@@ -139,22 +149,12 @@ void Draw2D::addRectFilled(const Vec2& from, const Vec2& to, Color color) {
 	m_vertices.push({to, uv, color});
 	m_vertices.push({{to.x, from.y}, uv, color});
 	
-	cmd->indices_count += 6;
+	cmd.indices_count += 6;
 }
 
 void Draw2D::addImage(gpu::TextureHandle* tex, const Vec2& from, const Vec2& to, const Vec2& uv0, const Vec2& uv1, Color color) {
-	Cmd* cmd = &m_cmds.back();
+	Cmd& cmd = getCmd(tex);
 
-	if (cmd->texture != tex && cmd->indices_count != 0) {
-		cmd = &m_cmds.emplace();
-		const Rect& r = m_clip_queue.back();
-		cmd->clip_pos = r.from;
-		cmd->clip_size = r.to - r.from;
-		cmd->indices_count = 0;
-		cmd->index_offset = m_indices.size();
-	}
-
-	cmd->texture = tex;
 	const u32 voff = m_vertices.size();
 	m_indices.push(voff);
 	m_indices.push(voff + 1);
@@ -169,32 +169,75 @@ void Draw2D::addImage(gpu::TextureHandle* tex, const Vec2& from, const Vec2& to,
 	m_vertices.push({to, uv1, color});
 	m_vertices.push({{to.x, from.y}, {uv1.x, uv0.y}, color});
 	
-	cmd->indices_count += 6;
+	cmd.indices_count += 6;
 }
 
-void Draw2D::addText(const Font& font, const Vec2& pos, Color color, const char* str) {
-	if (!*str) return;
-	Cmd* cmd = &m_cmds.back();
+void Draw2D::addImage9Slice(gpu::TextureHandle* tex, const Vec2& from, const Vec2& to, const Vec2& inner_from, const Vec2& inner_to, const Vec2& uv0, const Vec2& uv1, const Vec2& inner_uv0, const Vec2& inner_uv1, Color color) {
+	Cmd& cmd = getCmd(tex);
 
-	if (cmd->texture != nullptr && cmd->indices_count != 0) {
-		cmd = &m_cmds.emplace();
-		const Rect& r = m_clip_queue.back();
-		cmd->clip_pos = r.from;
-		cmd->clip_size = r.to - r.from;
-		cmd->indices_count = 0;
-		cmd->index_offset = m_indices.size();
+	const float xs[] = { from.x, inner_from.x, inner_to.x, to.x };
+	const float ys[] = { from.y, inner_from.y, inner_to.y, to.y };
+	const float us[] = { uv0.x, inner_uv0.x, inner_uv1.x, uv1.x };
+	const float vs[] = { uv0.y, inner_uv0.y, inner_uv1.y, uv1.y };
+
+	const u32 voff = m_vertices.size();
+	for (u32 j = 0; j < 4; ++j) {
+		for (u32 i = 0; i < 4; ++i) {
+			m_vertices.push({{xs[i], ys[j]}, {us[i], vs[j]}, color});
+		}
 	}
 
-	cmd->texture = nullptr;
-	
-	Vec2 p = pos;
-	p.x = float(int(p.x));
-	p.y = float(int(p.y));
+	for (u32 j = 0; j < 3; ++j) {
+		for (u32 i = 0; i < 3; ++i) {
+			const u32 v = voff + i + j * 4;
+			m_indices.push(v);
+			m_indices.push(v + 4);
+			m_indices.push(v + 5);
+
+			m_indices.push(v);
+			m_indices.push(v + 5);
+			m_indices.push(v + 1);
+		}
+	}
+
+	cmd.indices_count += 54;
+}
+
+void Draw2D::append(const Draw2D& src) {
+	const u32 voff = m_vertices.size();
+	const u32 ioff = m_indices.size();
+	m_vertices.reserve(voff + src.m_vertices.size());
+	for (const Vertex& v : src.m_vertices) m_vertices.push(v);
+	m_indices.reserve(ioff + src.m_indices.size());
+	for (u32 idx : src.m_indices) m_indices.push(idx + voff);
+
+	for (const Cmd& src_cmd : src.m_cmds) {
+		if (src_cmd.indices_count == 0) continue;
+		Cmd* cmd = &m_cmds.back();
+		if (cmd->indices_count != 0) cmd = &m_cmds.emplace();
+		*cmd = src_cmd;
+		cmd->index_offset += ioff;
+	}
+	// following draws use our clip rect again
+	setClipRect(m_clip_queue.back());
+}
+
+const Draw2D::TextRun& Draw2D::getTextRun(const Font& font, const char* text) {
+	const u64 text_hash = RuntimeHash(text).getHashValue();
+	const RuntimeHash key = RuntimeHash::fromU64(text_hash ^ (u64(getFontID(font)) * 0x9E3779B97F4A7C15ULL));
+	auto iter = m_text_runs.find(key);
+	if (iter.isValid()) {
+		iter.value().last_used_frame = m_frame;
+		return iter.value();
+	}
 
-	for (const char* c = str; *c; ++c) {
+	TextRun run(m_allocator);
+	run.last_used_frame = m_frame;
+	Vec2 p(0);
+	for (const char* c = text; *c; ++c) {
 		if (*c == '\r') continue;
 		if (*c == '\n') {
-			p.x = float(int(pos.x));
+			p.x = 0;
 			p.y += getAdvanceY(font);
 			continue;
 		}
@@ -203,24 +246,42 @@ void Draw2D::addText(const Font& font, const Vec2& pos, Color color, const char*
 			p.x += 16;
 			continue;
 		}
-	
-		const u32 voff = m_vertices.size();
-		m_indices.push(voff);
-		m_indices.push(voff + 1);
-		m_indices.push(voff + 2);
-
-		m_indices.push(voff);
-		m_indices.push(voff + 2);
-		m_indices.push(voff + 3);
-
-		m_vertices.push({ p + Vec2(glyph->x0, glyph->y0), { glyph->u0, glyph->v0 }, color });
-		m_vertices.push({ p + Vec2(glyph->x1, glyph->y0), { glyph->u1, glyph->v0 }, color });
-		m_vertices.push({ p + Vec2(glyph->x1, glyph->y1), { glyph->u1, glyph->v1 }, color });
-		m_vertices.push({ p + Vec2(glyph->x0, glyph->y1), { glyph->u0, glyph->v1 }, color });
-		
+		run.glyphs.push({p, glyph});
 		p.x += glyph->advance_x;
-		cmd->indices_count += 6;
 	}
+	return m_text_runs.insert(key, static_cast<TextRun&&>(run)).value();
+}
+
+void Draw2D::addText(const Font& font, const Vec2& pos, Color color, const char* str) {
+	if (!*str) return;
+	Cmd& cmd = getCmd(nullptr);
+	
+	Vec2 p = pos;
+	p.x = float(int(p.x));
+	p.y = float(int(p.y));
+
+	const TextRun& run = getTextRun(font, str);
+	const u32 voff = m_vertices.size();
+	m_vertices.reserve(voff + run.glyphs.size() * 4);
+	m_indices.reserve(m_indices.size() + run.glyphs.size() * 6);
+	for (u32 i = 0, c = run.glyphs.size(); i < c; ++i) {
+		const Glyph* glyph = run.glyphs[i].glyph;
+		const Vec2 gp = p + run.glyphs[i].pos;
+		const u32 v = voff + i * 4;
+		m_indices.push(v);
+		m_indices.push(v + 1);
+		m_indices.push(v + 2);
+
+		m_indices.push(v);
+		m_indices.push(v + 2);
+		m_indices.push(v + 3);
+
+		m_vertices.push({ gp + Vec2(glyph->x0, glyph->y0), { glyph->u0, glyph->v0 }, color });
+		m_vertices.push({ gp + Vec2(glyph->x1, glyph->y0), { glyph->u1, glyph->v0 }, color });
+		m_vertices.push({ gp + Vec2(glyph->x1, glyph->y1), { glyph->u1, glyph->v1 }, color });
+		m_vertices.push({ gp + Vec2(glyph->x0, glyph->y1), { glyph->u0, glyph->v1 }, color });
+	}
+	cmd.indices_count += run.glyphs.size() * 6;
 }
 
 } // namespace Lumix
\ No newline at end of file
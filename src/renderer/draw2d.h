@@ -1,6 +1,8 @@
 #pragma once
 
 #include "engine/array.h"
+#include "engine/hash.h"
+#include "engine/hash_map.h"
 #include "engine/math.h"
 #include "renderer/gpu/gpu.h"
 
@@ -9,6 +11,7 @@ namespace Lumix
 {
 
 struct Font;
+struct Glyph;
 
 struct LUMIX_RENDERER_API Draw2D {
 	struct Cmd {
@@ -35,6 +38,11 @@ struct LUMIX_RENDERER_API Draw2D {
 	void addRectFilled(const Vec2& from, const Vec2& to, Color color);
 	void addText(const Font& font, const Vec2& pos, Color color, const char* text);
 	void addImage(gpu::TextureHandle* tex, const Vec2& from, const Vec2& to, const Vec2& uv0, const Vec2& uv1, Color color);
+	// nine-slice image as a single 4x4 vertex grid, inner_* is the stretched middle part
+	void addImage9Slice(gpu::TextureHandle* tex, const Vec2& from, const Vec2& to, const Vec2& inner_from, const Vec2& inner_to, const Vec2& uv0, const Vec2& uv1, const Vec2& inner_uv0, const Vec2& inner_uv1, Color color);
+	// appends everything drawn to src, src's clip rects are absolute
+	void append(const Draw2D& src);
+	Vec2 getAtlasSize() const { return m_atlas_size; }
 	const Array<Vertex>& getVertices() const { return m_vertices; }
 	const Array<u32>& getIndices() const { return m_indices; }
 	const Array<Cmd>& getCmds() const { return m_cmds; }
@@ -45,11 +53,31 @@ private:
 		Vec2 to;
 	};
 
+	struct TextGlyph {
+		Vec2 pos;
+		const Glyph* glyph;
+	};
+
+	// laid out text, kept between frames while it's drawn
+	struct TextRun {
+		TextRun(IAllocator& allocator) : glyphs(allocator) {}
+		Array<TextGlyph> glyphs;
+		u32 last_used_frame;
+	};
+
+	Cmd& getCmd(gpu::TextureHandle* tex);
+	void setClipRect(const Rect& r);
+	const TextRun& getTextRun(const Font& font, const char* text);
+
+	IAllocator& m_allocator;
 	Vec2 m_atlas_size;
 	Array<Cmd> m_cmds;
 	Array<u32> m_indices;
 	Array<Vertex> m_vertices;
 	Array<Rect> m_clip_queue;
+	// key is hash of font's id and the text
+	HashMap<RuntimeHash, TextRun> m_text_runs;
+	u32 m_frame = 0;
 };
 
 } //namespace Lumix
\ No newline at end of file
@@ -46,6 +46,7 @@ enum class DrawStream::Instruction : u8 {
 	CREATE_TEXTURE,
 	BIND_IMAGE_TEXTURE,
 	COPY_TEXTURE,
+	SWAP_TEXTURES,
 	COPY_BUFFER,
 	READ_TEXTURE,
 	DESTROY_BIND_GROUP,
@@ -67,7 +68,8 @@ enum class DrawStream::Instruction : u8 {
 	SUBSTREAM,
 	BEGIN_PROFILE_BLOCK,
 	END_PROFILE_BLOCK,
-	USER_ALLOC
+	USER_ALLOC,
+	NOP
 };
 
 namespace {
@@ -86,6 +88,26 @@ namespace Dirty {
 	};
 }
 
+// calls f(bits, a_field, b_field, size) for fields selected by mask, in the order DIRTY_CACHE stores them
+template <typename C0, typename C1, typename F>
+void forEachCacheField(C0& a, C1& b, u32 mask, const F& f) {
+	if (mask & Dirty::PROGRAM) f(Dirty::PROGRAM, &a.program, &b.program, (u32)sizeof(a.program));
+	if (mask & Dirty::INDEX_BUFFER) f(Dirty::INDEX_BUFFER, &a.index_buffer, &b.index_buffer, (u32)sizeof(a.index_buffer));
+	if (mask & Dirty::INDIRECT_BUFFER) f(Dirty::INDIRECT_BUFFER, &a.indirect_buffer, &b.indirect_buffer, (u32)sizeof(a.indirect_buffer));
+	if (mask & Dirty::VERTEX_BUFFER0) f(Dirty::VERTEX_BUFFER0, &a.vertex_buffers[0], &b.vertex_buffers[0], (u32)sizeof(a.vertex_buffers[0]));
+	if (mask & Dirty::VERTEX_BUFFER1) f(Dirty::VERTEX_BUFFER1, &a.vertex_buffers[1], &b.vertex_buffers[1], (u32)sizeof(a.vertex_buffers[1]));
+	if (mask & Dirty::BIND_GROUP0) f(Dirty::BIND_GROUP0, &a.group0, &b.group0, (u32)sizeof(a.group0));
+	if (mask & Dirty::BIND_GROUP1) f(Dirty::BIND_GROUP1, &a.group1, &b.group1, (u32)sizeof(a.group1));
+}
+
+static u32 popCount(u32 v) {
+	#ifdef _WIN32
+		return __popcnt(v);
+	#else
+		return __builtin_popcount(v);
+	#endif
+}
+
 struct UpdateBufferData {
 	gpu::BufferHandle buffer;
 	const void* data;
@@ -138,6 +160,7 @@ struct DrawIndexedInstancedDat {
 struct DrawIndirectData {
 	gpu::DataType index_type;
 	u32 indirect_buffer_offset;
+	u32 draw_count;
 };
 struct MemoryBarrierData {
 	gpu::MemoryBarrierType type;
@@ -157,6 +180,11 @@ struct CopyTextureData {
 	u32 dst_y;
 };
 
+struct SwapTexturesData {
+	gpu::TextureHandle a;
+	gpu::TextureHandle b;
+};
+
 struct CopyBufferData {
 	gpu::BufferHandle dst;
 	gpu::BufferHandle src;
@@ -255,7 +283,12 @@ DrawStream::DrawStream(DrawStream&& rhs)
 {
 	first = rhs.first;
 	current = rhs.current;
+	run_called = rhs.run_called;
+	m_cache = rhs.m_cache;
+	m_head_state = rhs.m_head_state;
+	m_head_sealed = rhs.m_head_sealed;
 	rhs.first = rhs.current = nullptr;
+	rhs.m_head_state = nullptr;
 }
 
 DrawStream::DrawStream(Renderer& renderer)
@@ -297,6 +330,11 @@ void DrawStream::copy(gpu::TextureHandle dst, gpu::TextureHandle src, u32 dst_x,
 	write(Instruction::COPY_TEXTURE, data);
 };
 
+void DrawStream::swap(gpu::TextureHandle a, gpu::TextureHandle b) {
+	SwapTexturesData data = {a, b};
+	write(Instruction::SWAP_TEXTURES, data);
+}
+
 void DrawStream::copy(gpu::BufferHandle dst, gpu::BufferHandle src, u32 dst_offset, u32 src_offset, u32 size) {
 	CopyBufferData data = {dst, src, dst_offset, src_offset, size};
 	write(Instruction::COPY_BUFFER, data);
@@ -323,12 +361,75 @@ void DrawStream::merge(DrawStream& rhs) {
 	ASSERT(!run_called);
 	ASSERT(!rhs.run_called);
 
+	// rhs does not see our pending state, so it must be in the stream before rhs
+	submitCached();
+	if (rhs.m_head_state) rhs.dropRedundantHead(*this);
+
 	const Instruction end_instr = Instruction::END;
 	memcpy(current->data + current->header.size, &end_instr, sizeof(end_instr));
 	run_called = rhs.run_called;
 	current->header.next = rhs.first;
 	current = rhs.current;
 	rhs.first = rhs.current = nullptr;
+
+	// state at the end of rhs is our state now
+	if (rhs.m_cache.lost) {
+		m_cache.known = 0;
+		m_cache.lost = true;
+	}
+	forEachCacheField(m_cache, rhs.m_cache, rhs.m_cache.known | rhs.m_cache.dirty, [](u32, void* dst, const void* src, u32 size){
+		memcpy(dst, src, size);
+	});
+	m_cache.known |= rhs.m_cache.known;
+	m_cache.dirty = rhs.m_cache.dirty;
+	if (!m_head_sealed) {
+		m_head_state = rhs.m_head_state;
+		m_head_sealed = rhs.m_head_sealed;
+	}
+	rhs.m_head_state = nullptr;
+}
+
+// removes fields from the first DIRTY_CACHE which have the same value in prev
+// removed bytes are replaced by NOPs, so nothing has to be moved
+void DrawStream::dropRedundantHead(const DrawStream& prev) {
+	u8* ptr = m_head_state;
+	ASSERT(*ptr == (u8)Instruction::DIRTY_CACHE);
+	u32 dirty;
+	memcpy(&dirty, ptr + sizeof(Instruction), sizeof(dirty));
+	const u32 size = sizeof(Instruction) + sizeof(dirty) + popCount(dirty) * sizeof(u32);
+
+	CacheEx head;
+	const u8* src = ptr + sizeof(Instruction) + sizeof(dirty);
+	forEachCacheField(head, head, dirty, [&](u32, void* dst, void*, u32 field_size){
+		memcpy(dst, src, field_size);
+		src += field_size;
+	});
+
+	u32 keep = dirty;
+	forEachCacheField(head, prev.m_cache, dirty & prev.m_cache.known, [&](u32 bits, const void* a, const void* b, u32 field_size){
+		if (memcmp(a, b, field_size) == 0) keep &= ~bits;
+	});
+	if (keep == dirty) return;
+
+	u8* dst = ptr;
+	if (keep != 0) {
+		const Instruction instr = Instruction::DIRTY_CACHE;
+		memcpy(dst, &instr, sizeof(instr));
+		dst += sizeof(instr);
+		memcpy(dst, &keep, sizeof(keep));
+		dst += sizeof(keep);
+		forEachCacheField(head, head, keep, [&](u32, const void* field, const void*, u32 field_size){
+			memcpy(dst, field, field_size);
+			dst += field_size;
+		});
+	}
+	memset(dst, (u8)Instruction::NOP, size - u32(dst - ptr));
+}
+
+void DrawStream::invalidateCache() {
+	m_cache.known = 0;
+	m_cache.lost = true;
+	m_head_sealed = true;
 }
 
 
@@ -368,6 +469,7 @@ void DrawStream::createTexture(gpu::TextureHandle handle, u32 w, u32 h, u32 dept
 DrawStream& DrawStream::createSubstream() {
 	u8* data = alloc(sizeof(Instruction) + sizeof(DrawStream));
 	WRITE_CONST(Instruction::SUBSTREAM);
+	invalidateCache();
 	return *new (NewPlaceholder(), data) DrawStream(renderer);
 }
 
@@ -510,9 +612,9 @@ void DrawStream::bindIndirectBuffer(gpu::BufferHandle buffer) {
 }
 
 
-void DrawStream::drawIndirect(gpu::DataType index_type, u32 indirect_buffer_offset) {
+void DrawStream::drawIndirect(gpu::DataType index_type, u32 indirect_buffer_offset, u32 draw_count) {
 	submitCached();
-	DrawIndirectData data = { index_type, indirect_buffer_offset };
+	DrawIndirectData data = { index_type, indirect_buffer_offset, draw_count };
 	write(Instruction::DRAW_INDIRECT, data);
 }
 
@@ -560,6 +662,7 @@ u8* DrawStream::pushFunction(void (*func)(void*), u32 payload_size) {
 	WRITE_CONST(Instruction::FUNCTION);
 	WRITE(payload_size);
 	WRITE(func);
+	invalidateCache();
 	return data;
 }
 
@@ -631,6 +734,11 @@ void DrawStream::reset() {
 	
 	current = first;
 	run_called = false;
+	m_cache.dirty = 0;
+	m_cache.known = 0;
+	m_cache.lost = false;
+	m_head_state = nullptr;
+	m_head_sealed = false;
 }
 
 void DrawStream::submitCached() {
@@ -638,7 +746,9 @@ void DrawStream::submitCached() {
 	if (dirty == 0) return;
 	
 	m_cache.dirty = 0;
-	if (dirty == Dirty::BIND) {
+	m_cache.known |= dirty;
+	// head is patched in merge, so it's always in DIRTY_CACHE format
+	if (dirty == Dirty::BIND && m_head_sealed) {
 		u8* ptr = alloc(sizeof(Instruction) + sizeof(Cache));
 		const Instruction instr = Instruction::BIND;
 		memcpy(ptr, &instr, sizeof(instr));
@@ -647,12 +757,12 @@ void DrawStream::submitCached() {
 		return;
 	}
 
-	#ifdef _WIN32
-		const u32 count = __popcnt(dirty);
-	#else
-		const u32 count = __builtin_popcount (dirty);
-	#endif
+	const u32 count = popCount(dirty);
 	u8* ptr = alloc(sizeof(Instruction) + sizeof(dirty) + count * sizeof(u32));
+	if (!m_head_sealed) {
+		m_head_state = ptr;
+		m_head_sealed = true;
+	}
 	Instruction instr = Instruction::DIRTY_CACHE;
 	#define WRITE(V) do { memcpy(ptr, &V, sizeof(V)); ptr += sizeof(V); } while(false)
 	WRITE(instr);
@@ -681,6 +791,7 @@ void DrawStream::run() {
 			READ(Instruction, instr);
 			switch(instr) {
 				case Instruction::END: goto next_page;
+				case Instruction::NOP: break;
 				case Instruction::BIND: {
 					READ(Cache, cache);
 					gpu::bind(cache.group0);
@@ -724,7 +835,7 @@ void DrawStream::run() {
 				}
 				case Instruction::DRAW_INDIRECT: {
 					READ(DrawIndirectData, data);
-					gpu::drawIndirect(data.index_type, data.indirect_buffer_offset);
+					gpu::drawIndirect(data.index_type, data.indirect_buffer_offset, data.draw_count);
 					break;
 				}
 				case Instruction::MEMORY_BARRIER: {
@@ -858,6 +969,11 @@ void DrawStream::run() {
 					gpu::copy(data.dst, data.src, data.dst_x, data.dst_y);
 					break;
 				}
+				case Instruction::SWAP_TEXTURES: {
+					READ(SwapTexturesData, data);
+					gpu::swap(data.a, data.b);
+					break;
+				}
 				case Instruction::COPY_BUFFER: {
 					READ(CopyBufferData, data);
 					gpu::copy(data.dst, data.src, data.dst_offset, data.src_offset, data.size);
@@ -50,7 +50,7 @@ struct DrawStream {
 	void bindImageTexture(gpu::TextureHandle texture, u32 unit);
 
 	void drawArrays(u32 offset, u32 count);
-	void drawIndirect(gpu::DataType index_type, u32 indirect_buffer_offset);
+	void drawIndirect(gpu::DataType index_type, u32 indirect_buffer_offset, u32 draw_count);
 	void drawIndexed(u32 offset, u32 count, gpu::DataType type);
 	void drawArraysInstanced(u32 indices_count, u32 instances_count);
 	void drawIndexedInstanced(u32 indices_count, u32 instances_count, gpu::DataType index_type);
@@ -60,6 +60,7 @@ struct DrawStream {
 	
 	void copy(gpu::TextureHandle dst, gpu::TextureHandle src, u32 dst_x, u32 dst_y);
 	void copy(gpu::BufferHandle dst, gpu::BufferHandle src, u32 dst_offset, u32 src_offset, u32 size);
+	void swap(gpu::TextureHandle a, gpu::TextureHandle b);
 	
 	void readTexture(gpu::TextureHandle texture, u32 mip, Span<u8> buf);
 	void generateMipmaps(gpu::TextureHandle texture);
@@ -76,6 +77,8 @@ struct DrawStream {
 
 	void run();
 	void reset();
+	// appends rhs's pages without copying them, rhs is left empty
+	// state binds at the start of rhs which are already bound by this stream are dropped
 	void merge(DrawStream& rhs);
 
 	struct Page;
@@ -88,6 +91,8 @@ private:
 
 	LUMIX_FORCE_INLINE u8* alloc(u32 size);
 	LUMIX_FORCE_INLINE void submitCached();
+	void invalidateCache();
+	void dropRedundantHead(const DrawStream& prev);
 	
 	template <typename T>
 	LUMIX_FORCE_INLINE void write(Instruction instruction, const T& val) {
@@ -116,8 +121,15 @@ private:
 		gpu::BindGroupHandle group1;
 		gpu::BufferHandle indirect_buffer;
 		u32 dirty = 0;
+		// values already submitted to the stream, valid only for fields which are not dirty
+		u32 known = 0;
+		// some instruction could change the state without going through the cache
+		bool lost = false;
 	};
 	CacheEx m_cache;
+	// first state submit in this stream, before it nothing depends on the state
+	u8* m_head_state = nullptr;
+	bool m_head_sealed = false;
 };
 
 template <typename F>
@@ -2,6 +2,7 @@
 #include "engine/crt.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/os.h"
@@ -48,6 +49,10 @@ enum class CompositeTexture::NodeType : u32 {
 };
 
 enum { OUTPUT_FLAG = 1 << 31 };
+// node outputs are not cached once the cache holds this many bytes
+static constexpr u64 CACHE_BUDGET = 512 * 1024 * 1024;
+// rows of generated images are processed in chunks of this size on worker threads
+static constexpr i32 ROWS_PER_JOB = 32;
 
 void CompositeTexture::Node::inputSlot() {
 	ImGuiEx::Pin(m_id | (m_input_counter << 16), true);
@@ -74,10 +79,17 @@ struct CompositeTexture::Node::Input {
 
 	operator bool() const { return node; }
 	bool getPixelData(CompositeTexture::PixelData* data) const {
-		return node->getPixelData(data, output_idx);
+		return node->m_resource->getCachedPixelData(*node, output_idx, data);
 	}
 };
 
+bool CompositeTexture::Node::error(const char* msg) const {
+	// inputs can be evaluated on multiple workers at once
+	jobs::MutexGuard guard(m_resource->m_mutex);
+	m_resource->m_error = msg;
+	return false;
+}
+
 void CompositeTexture::deleteSelectedNodes() {
 	for (i32 i = m_nodes.size() - 1; i > 0; --i) { // we really don't want to delete node 0 (output)
 		Node* node = m_nodes[i];
@@ -146,6 +158,13 @@ void makeSameSize(CompositeTexture::PixelData* a, CompositeTexture::PixelData* b
 	}
 }
 
+template <typename F>
+void forEachRow(u32 h, const F& f) {
+	jobs::forEach(h, ROWS_PER_JOB, [&](i32 from, i32 to){
+		for (i32 j = from; j < to; ++j) f(u32(j));
+	});
+}
+
 struct SplitNode final : CompositeTexture::Node {
 	CompositeTexture::NodeType getType() const override { return CompositeTexture::NodeType::SPLIT; }
 	
@@ -190,8 +209,16 @@ struct MergeNode final : CompositeTexture::Node {
 		const Input inputs[] = { getInput(0), getInput(1), getInput(2), getInput(3) };
 		for (const Input& i : inputs) if (!i) return error("Missing input");
 		
-		CompositeTexture::PixelData first_pd(m_resource->m_app.getAllocator());
-		if (!inputs[0].getPixelData(&first_pd)) return false;
+		IAllocator& allocator = m_resource->m_app.getAllocator();
+		CompositeTexture::PixelData channels[] = { allocator, allocator, allocator, allocator };
+		bool success[4];
+		// channels are independent branches of the graph
+		jobs::forEach(4, 1, [&](i32 i, i32){
+			success[i] = inputs[i].getPixelData(&channels[i]);
+		});
+		for (bool s : success) if (!s) return false;
+
+		const CompositeTexture::PixelData& first_pd = channels[0];
 		if (first_pd.channels != 1) return error("Incorrect number of channels");
 
 		data->w = first_pd.w;
@@ -205,8 +232,7 @@ struct MergeNode final : CompositeTexture::Node {
 		}
 
 		for (u32 i = 1; i < 4; ++i) {
-			CompositeTexture::PixelData tmp(m_resource->m_app.getAllocator());
-			if (!inputs[i].getPixelData(&tmp)) return false;
+			CompositeTexture::PixelData& tmp = channels[i];
 			if (tmp.channels != 1) return false;
 			resize(&tmp, first_pd.w, first_pd.h);
 			
@@ -624,7 +650,7 @@ struct WaveNoiseNode final : CompositeTexture::Node {
 		data->h = h;
 		data->channels = 1;
 		data->pixels.resize(w * h);
-		for (u32 j = 0; j < h; ++j) {
+		forEachRow(h, [&](u32 j){
 			const float v = j / float(h - 1);
 			for (u32 i = 0; i < w; ++i) {
 				float u = i / float(w - 1);
@@ -632,7 +658,7 @@ struct WaveNoiseNode final : CompositeTexture::Node {
 				d = clamp(d * 255.f, 0.f, 255.f);
 				data->pixels[i + j * w] = u8(d + 0.5f);
 			}
-		}
+		});
 		return true;
 	}
 
@@ -701,7 +727,7 @@ struct SimplexNode final : CompositeTexture::Node {
 		data->h = h;
 		data->channels = 1;
 		data->pixels.resize(w * h);
-		for (u32 j = 0; j < h; ++j) {
+		forEachRow(h, [&](u32 j){
 			const float v = j / float(h - 1);
 			for (u32 i = 0; i < w; ++i) {
 				float u = i / float(w - 1);
@@ -709,7 +735,7 @@ struct SimplexNode final : CompositeTexture::Node {
 				d = clamp(d * 255.f, 0.f, 255.f);
 				data->pixels[i + j * w] = u8(d + 0.5f);
 			}
-		}
+		});
 		return true;
 	}
 
@@ -770,7 +796,7 @@ struct CellularNoiseNode final : CompositeTexture::Node {
 		data->h = h;
 		data->channels = 1;
 		data->pixels.resize(w * h);
-		for (u32 j = 0; j < h; ++j) {
+		forEachRow(h, [&](u32 j){
 			const float v = j / float(h - 1);
 			for (u32 i = 0; i < w; ++i) {
 				float u = i / float(w - 1);
@@ -778,7 +804,7 @@ struct CellularNoiseNode final : CompositeTexture::Node {
 				d = clamp(d * 255.f, 0.f, 255.f);
 				data->pixels[i + j * w] = u8(d + 0.5f);
 			}
-		}
+		});
 		return true;
 	}
 
@@ -954,7 +980,8 @@ struct SharpenNode final : CompositeTexture::Node {
 			-inv, -inv, -inv
 		};
 
-		for (i32 j = 0; j < (i32)data->h; ++j) {
+		forEachRow(data->h, [&](u32 row){
+			const i32 j = (i32)row;
 			for (i32 i = 0; i < (i32)data->w; ++i) {
 				for (u32 ch = 0; ch < data->channels; ++ch) {
 					float v = 0;
@@ -969,7 +996,7 @@ struct SharpenNode final : CompositeTexture::Node {
 					data->pixels[(i + j * data->w) * data->channels + ch] = u8(v + 0.5f);
 				}
 			}
-		}
+		});
 		return true;
 	}
 	
@@ -1167,7 +1194,7 @@ struct CircleNode final : CompositeTexture::Node {
 		data->w = w;
 		data->h = h;
 
-		for (u32 j = 0; j < h; ++j) {
+		forEachRow(h, [&](u32 j){
 			for (u32 i = 0; i < w; ++i) {
 				Vec2 v(i / float(w - 1) - 0.5f
 					, j / float(h - 1) - 0.5f);
@@ -1175,7 +1202,7 @@ struct CircleNode final : CompositeTexture::Node {
 				d = clamp(d * 255.f, 0.f, 255.f);
 				data->pixels[i + j * w] = u8(d + 0.5f);
 			}
-		}
+		});
 		return true;
 	}
 	
@@ -1452,10 +1479,11 @@ struct InputNode final : CompositeTexture::Node {
 	bool gui() override {
 		ImGuiEx::NodeTitle("Input");
 		outputSlot(); 
-		Span<char> span(m_texture.beginUpdate(), m_texture.capacity());
-		bool res = m_resource->m_app.getAssetBrowser().resourceInput("Source", span, Texture::TYPE, 150);
-		m_texture.endUpdate();
-		return res;
+		char tmp[LUMIX_MAX_PATH];
+		copyString(Span(tmp), m_texture.c_str());
+		if (!m_resource->m_app.getAssetBrowser().resourceInput("Source", Span(tmp), Texture::TYPE, 150)) return false;
+		m_texture = tmp;
+		return true;
 	}
 
 	Path m_texture;
@@ -1591,6 +1619,7 @@ CompositeTexture::CompositeTexture(StudioApp& app, IAllocator& allocator)
 	, m_nodes(allocator)
 	, m_links(allocator)
 	, m_error(allocator)
+	, m_cache(allocator)
 {}
 
 CompositeTexture::~CompositeTexture() {
@@ -1614,6 +1643,7 @@ void CompositeTexture::clear() {
 	}
 	m_nodes.clear();
 	m_node_id_generator = 1;
+	clearCache();
 }
 
 bool CompositeTexture::loadSync(FileSystem& fs, const Path& path) {
@@ -1774,7 +1804,90 @@ void CompositeTexture::addArrayLayer(const char* path) {
 	++node->m_layers_count;
 }
 
+struct CompositeTexture::CacheEntry {
+	CacheEntry(IAllocator& allocator) : data(allocator) {}
+	PixelData data;
+	u32 generation;
+};
+
+// the key covers everything the output depends on - the node, its upstream nodes, the links between them and source files' timestamps
+static void writeCacheKey(const CompositeTexture& ct, const CompositeTexture::Node& node, u32 output_idx, OutputMemoryStream& blob) {
+	blob.write(node.getType());
+	blob.write(output_idx);
+	node.serialize(blob);
+	if (node.getType() == CompositeTexture::NodeType::INPUT) {
+		const Path& path = ((const InputNode&)node).m_texture;
+		FileSystem& fs = ct.m_app.getEngine().getFileSystem();
+		blob.write(path.isEmpty() ? 0 : fs.getLastModified(path.c_str()));
+	}
+	for (const CompositeTexture::Link& link : ct.m_links) {
+		if (link.getToNode() != node.m_id) continue;
+		const CompositeTexture::Node* from = ct.getNodeByID(link.getFromNode());
+		if (!from) continue;
+		blob.write(link.getToPin());
+		writeCacheKey(ct, *from, link.getFromPin(), blob);
+	}
+}
+
+static void copyPixelData(const CompositeTexture::PixelData& src, CompositeTexture::PixelData* dst) {
+	dst->w = src.w;
+	dst->h = src.h;
+	dst->channels = src.channels;
+	dst->pixels = src.pixels;
+}
+
+bool CompositeTexture::getCachedPixelData(Node& node, u32 output_idx, PixelData* data) {
+	OutputMemoryStream key_blob(m_allocator);
+	writeCacheKey(*this, node, output_idx, key_blob);
+	const RuntimeHash key(key_blob.data(), (u32)key_blob.size());
+
+	CacheEntry* cached = nullptr;
+	{
+		jobs::MutexGuard guard(m_mutex);
+		auto iter = m_cache.find(key);
+		if (iter.isValid()) {
+			cached = iter.value();
+			cached->generation = m_cache_generation;
+		}
+	}
+	// entries are only removed by generate() and clear(), never while nodes are evaluated
+	if (cached) {
+		copyPixelData(cached->data, data);
+		return true;
+	}
+
+	if (!node.getPixelData(data, output_idx)) return false;
+
+	jobs::MutexGuard guard(m_mutex);
+	if (m_cache.find(key).isValid()) return true;
+	if (m_cache_size + data->pixels.size() > CACHE_BUDGET) return true;
+
+	CacheEntry* entry = LUMIX_NEW(m_allocator, CacheEntry)(m_allocator);
+	copyPixelData(*data, &entry->data);
+	entry->generation = m_cache_generation;
+	m_cache_size += data->pixels.size();
+	m_cache.insert(key, entry);
+	return true;
+}
+
+void CompositeTexture::clearCache() {
+	for (CacheEntry* entry : m_cache) {
+		LUMIX_DELETE(m_allocator, entry);
+	}
+	m_cache.clear();
+	m_cache_size = 0;
+}
+
 bool CompositeTexture::generate(Result* result) {
+	// keep only outputs used by the previous generate(), the rest belongs to parts of the graph which were edited since
+	m_cache.eraseIf([&](CacheEntry* entry){
+		if (entry->generation == m_cache_generation) return false;
+		m_cache_size -= entry->data.pixels.size();
+		LUMIX_DELETE(m_allocator, entry);
+		return true;
+	});
+	++m_cache_generation;
+
 	const OutputNode* node = (OutputNode*)m_nodes[0];
 	switch(node->m_output_type) {
 		case OutputNode::OutputType::SIMPLE: {
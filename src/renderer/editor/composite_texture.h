@@ -1,6 +1,9 @@
 #pragma once
 
 #include "engine/array.h"
+#include "engine/hash.h"
+#include "engine/hash_map.h"
+#include "engine/job_system.h"
 #include "engine/path.h"
 #include "editor/studio_app.h"
 #include "editor/utils.h"
@@ -39,10 +42,7 @@ struct CompositeTexture {
 		Input getInput(u32 pin_idx) const;
 		bool getInputPixelData(u32 pin_idx, PixelData* pd) const;
 		
-		bool error(const char* msg) const {
-			m_resource->m_error = msg;
-			return false;
-		}
+		bool error(const char* msg) const;
 
 		bool m_selected = false;
 		u32 m_input_counter;
@@ -66,6 +66,9 @@ struct CompositeTexture {
 	void serialize(OutputMemoryStream& blob);
 	bool deserialize(InputMemoryStream& blob);
 	bool generate(Result* result);
+	// returns the output of the node, reusing the result of a previous evaluation if the node, its inputs and its sources did not change
+	bool getCachedPixelData(Node& node, u32 output_idx, PixelData* data);
+	void clearCache();
 	
 	void addArrayLayer(const char* path);
 	void removeArrayLayer(u32 idx);
@@ -79,6 +82,12 @@ struct CompositeTexture {
 	Array<Link> m_links;
 	u32 m_node_id_generator = 1;
 	String m_error;
+
+	struct CacheEntry;
+	HashMap<RuntimeHash, CacheEntry*> m_cache;
+	u64 m_cache_size = 0;
+	u32 m_cache_generation = 0;
+	jobs::Mutex m_mutex;
 };
 
 struct CompositeTextureEditor final : StudioApp::GUIPlugin, NodeEditor {
@@ -626,6 +626,41 @@ FBXImporter::ImportGeometry& FBXImporter::getImportGeometry(const ofbx::Geometry
 	return m_geometries[0];
 }
 
+// reorders indices so triangles of each meshlet are contiguous, meshlets can then be drawn as index ranges
+static void buildMeshlets(FBXImporter::ImportMesh& mesh, u32 vertex_size, IAllocator& allocator) {
+	const u32 vertex_count = u32(mesh.vertex_data.size() / vertex_size);
+	Array<meshopt_Meshlet> meshlets(allocator);
+	meshlets.resize((u32)meshopt_buildMeshletsBound(mesh.indices.size(), 64, 126));
+	const u32 meshlet_count = (u32)meshopt_buildMeshlets(meshlets.begin(), mesh.indices.begin(), mesh.indices.size(), vertex_count, 64, 126);
+
+	Array<u32> indices(allocator);
+	indices.reserve(mesh.indices.size());
+	mesh.meshlets.clear();
+	mesh.meshlets.reserve(meshlet_count);
+	for (u32 i = 0; i < meshlet_count; ++i) {
+		const meshopt_Meshlet& src = meshlets[i];
+		const meshopt_Bounds bounds = meshopt_computeMeshletBounds(&src, (const float*)mesh.vertex_data.data(), vertex_count, vertex_size);
+
+		Mesh::Meshlet& meshlet = mesh.meshlets.emplace();
+		meshlet.center = Vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+		meshlet.radius = bounds.radius;
+		meshlet.cone_apex = Vec3(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]);
+		meshlet.cone_cutoff = bounds.cone_cutoff;
+		meshlet.cone_axis = Vec3(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]);
+		meshlet.first_index = indices.size();
+		meshlet.index_count = src.triangle_count * 3;
+		memset(meshlet.padding, 0, sizeof(meshlet.padding));
+
+		for (u32 j = 0; j < src.triangle_count; ++j) {
+			indices.push(src.vertices[src.indices[j][0]]);
+			indices.push(src.vertices[src.indices[j][1]]);
+			indices.push(src.vertices[src.indices[j][2]]);
+		}
+	}
+	ASSERT(indices.size() == mesh.indices.size());
+	mesh.indices.swap(indices);
+}
+
 void FBXImporter::postprocessMeshes(const ImportConfig& cfg, const char* path)
 {
 	jobs::forEach(m_geometries.size(), 1, [&](i32 geom_idx, i32){
@@ -675,144 +710,173 @@ void FBXImporter::postprocessMeshes(const ImportConfig& cfg, const char* path)
 	
 	if (cfg.bake_vertex_ao) bakeVertexAO(cfg);
 
-	jobs::forEach(m_meshes.size(), 1, [&](i32 mesh_idx, i32){
-		ImportMesh& import_mesh = m_meshes[mesh_idx];
-		import_mesh.vertex_data.clear();
-		import_mesh.indices.clear();
+	// like jobs::forEach, but every worker keeps its scratch buffers for all the meshes it processes
+	volatile i32 mesh_counter = 0;
+	jobs::runOnWorkers([&](){
+		Array<u32> intramat_idx(m_allocator);
+		Array<Skin> skinning(m_allocator);
+		for (;;) {
+			const i32 mesh_idx = atomicIncrement(&mesh_counter) - 1;
+			if (mesh_idx >= m_meshes.size()) break;
+
+			ImportMesh& import_mesh = m_meshes[mesh_idx];
+			import_mesh.vertex_data.clear();
+			import_mesh.indices.clear();
 	
-		const ofbx::Mesh& mesh = *import_mesh.fbx;
-		const ofbx::Geometry* geom = import_mesh.fbx->getGeometry();
-		const ImportGeometry& import_geom = getImportGeometry(geom);
+			const ofbx::Mesh& mesh = *import_mesh.fbx;
+			const ofbx::Geometry* geom = import_mesh.fbx->getGeometry();
+			const ImportGeometry& import_geom = getImportGeometry(geom);
 		
-		int vertex_count = geom->getVertexCount();
-		const ofbx::Vec3* vertices = geom->getVertices();
-		const ofbx::Vec3* normals = geom->getNormals();
-		const ofbx::Vec3* tangents = geom->getTangents();
-		const ofbx::Vec4* colors = cfg.import_vertex_colors ? geom->getColors() : nullptr;
-		const ofbx::Vec2* uvs = geom->getUVs();
-
-		if (!normals) normals = import_geom.computed_normals.begin();
-
-		Matrix transform_matrix = Matrix::IDENTITY;
-		Matrix geometry_matrix = toLumix(mesh.getGeometricMatrix());
-		transform_matrix = toLumix(mesh.getGlobalTransform()) * geometry_matrix;
-		if (cancel_mesh_transforms) transform_matrix.setTranslation({0, 0, 0});
-		if (cfg.origin != ImportConfig::Origin::SOURCE) {
-			const bool bottom = cfg.origin == FBXImporter::ImportConfig::Origin::BOTTOM;
-			centerMesh(vertices, vertex_count, bottom, transform_matrix, import_mesh.origin);
-		}
-		import_mesh.transform_matrix = transform_matrix.inverted();
+			int vertex_count = geom->getVertexCount();
+			const ofbx::Vec3* vertices = geom->getVertices();
+			const ofbx::Vec3* normals = geom->getNormals();
+			const ofbx::Vec3* tangents = geom->getTangents();
+			const ofbx::Vec4* colors = cfg.import_vertex_colors ? geom->getColors() : nullptr;
+			const ofbx::Vec2* uvs = geom->getUVs();
+
+			if (!normals) normals = import_geom.computed_normals.begin();
+
+			Matrix transform_matrix = Matrix::IDENTITY;
+			Matrix geometry_matrix = toLumix(mesh.getGeometricMatrix());
+			transform_matrix = toLumix(mesh.getGlobalTransform()) * geometry_matrix;
+			if (cancel_mesh_transforms) transform_matrix.setTranslation({0, 0, 0});
+			if (cfg.origin != ImportConfig::Origin::SOURCE) {
+				const bool bottom = cfg.origin == FBXImporter::ImportConfig::Origin::BOTTOM;
+				centerMesh(vertices, vertex_count, bottom, transform_matrix, import_mesh.origin);
+			}
+			import_mesh.transform_matrix = transform_matrix.inverted();
 
-		const bool flip_handness = doesFlipHandness(transform_matrix);
-		if (flip_handness) {
-			logError("Mesh ", mesh.name, " in ", path, " flips handness. This is not supported and the mesh will not display correctly.");
-		}
+			const bool flip_handness = doesFlipHandness(transform_matrix);
+			if (flip_handness) {
+				logError("Mesh ", mesh.name, " in ", path, " flips handness. This is not supported and the mesh will not display correctly.");
+			}
 
-		const int vertex_size = getVertexSize(*geom, import_mesh.is_skinned, cfg);
-		import_mesh.vertex_data.reserve(import_geom.unique_vertex_count * vertex_size);
+			const int vertex_size = getVertexSize(*geom, import_mesh.is_skinned, cfg);
+			import_mesh.vertex_data.reserve(import_geom.unique_vertex_count * vertex_size);
 
-		Array<Skin> skinning(m_allocator);
-		if (import_mesh.is_skinned) fillSkinInfo(skinning, import_mesh);
+			if (import_mesh.is_skinned) fillSkinInfo(skinning, import_mesh);
 
-		AABB aabb = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
-		float origin_radius_squared = 0;
+			AABB aabb = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+			float origin_radius_squared = 0;
 
-		int material_idx = getMaterialIndex(mesh, *import_mesh.fbx_mat);
-		ASSERT(material_idx >= 0);
+			int material_idx = getMaterialIndex(mesh, *import_mesh.fbx_mat);
+			ASSERT(material_idx >= 0);
 
-		const int* geom_materials = geom->getMaterials();
-		if (!tangents && import_geom.computed_tangents.size()) {
-			tangents = import_geom.computed_tangents.begin();
-		}
+			const int* geom_materials = geom->getMaterials();
+			if (!tangents && import_geom.computed_tangents.size()) {
+				tangents = import_geom.computed_tangents.begin();
+			}
 		
-		Array<u32> intramat_idx(m_allocator);
-		intramat_idx.resize(import_geom.unique_vertex_count);
-		memset(intramat_idx.begin(), 0xff, intramat_idx.byte_size());
-
-		u32 written_idx = 0;
-		for (int i = 0; i < vertex_count; ++i) {
-			if (geom_materials && geom_materials[i / 3] != material_idx) continue;
-			if (intramat_idx[import_geom.indices[i]] != 0xffFFffFF) continue;
-
-			intramat_idx[import_geom.indices[i]] = written_idx;
-			++written_idx;
-
-			ofbx::Vec3 cp = vertices[i];
-			// premultiply control points here, so we can have constantly-scaled meshes without scale in bones
-			Vec3 pos = transform_matrix.transformPoint(toLumixVec3(cp)) * cfg.mesh_scale * m_fbx_scale;
-			pos = fixOrientation(pos);
-			import_mesh.vertex_data.write(pos);
-
-			float sq_len = squaredLength(pos);
-			origin_radius_squared = maximum(origin_radius_squared, sq_len);
-
-			aabb.min.x = minimum(aabb.min.x, pos.x);
-			aabb.min.y = minimum(aabb.min.y, pos.y);
-			aabb.min.z = minimum(aabb.min.z, pos.z);
-			aabb.max.x = maximum(aabb.max.x, pos.x);
-			aabb.max.y = maximum(aabb.max.y, pos.y);
-			aabb.max.z = maximum(aabb.max.z, pos.z);
-
-			if (normals) writePackedVec3(normals[i], transform_matrix, &import_mesh.vertex_data);
-			if (uvs) writeUV(uvs[i], &import_mesh.vertex_data);
-			if (cfg.bake_vertex_ao) {
-				const float ao = import_geom.computed_ao[i];
-				u32 ao8 = u8(clamp(ao * 255.f, 0.f, 255.f) + 0.5f);
-				u32 ao32 = ao8 | ao8 << 8 | ao8 << 16 | ao8 << 24;
-				import_mesh.vertex_data.write(ao32);
+			intramat_idx.resize(import_geom.unique_vertex_count);
+			memset(intramat_idx.begin(), 0xff, intramat_idx.byte_size());
+
+			u32 written_idx = 0;
+			for (int i = 0; i < vertex_count; ++i) {
+				if (geom_materials && geom_materials[i / 3] != material_idx) continue;
+				if (intramat_idx[import_geom.indices[i]] != 0xffFFffFF) continue;
+
+				intramat_idx[import_geom.indices[i]] = written_idx;
+				++written_idx;
+
+				ofbx::Vec3 cp = vertices[i];
+				// premultiply control points here, so we can have constantly-scaled meshes without scale in bones
+				Vec3 pos = transform_matrix.transformPoint(toLumixVec3(cp)) * cfg.mesh_scale * m_fbx_scale;
+				pos = fixOrientation(pos);
+				import_mesh.vertex_data.write(pos);
+
+				float sq_len = squaredLength(pos);
+				origin_radius_squared = maximum(origin_radius_squared, sq_len);
+
+				aabb.min.x = minimum(aabb.min.x, pos.x);
+				aabb.min.y = minimum(aabb.min.y, pos.y);
+				aabb.min.z = minimum(aabb.min.z, pos.z);
+				aabb.max.x = maximum(aabb.max.x, pos.x);
+				aabb.max.y = maximum(aabb.max.y, pos.y);
+				aabb.max.z = maximum(aabb.max.z, pos.z);
+
+				if (normals) writePackedVec3(normals[i], transform_matrix, &import_mesh.vertex_data);
+				if (uvs) writeUV(uvs[i], &import_mesh.vertex_data);
+				if (cfg.bake_vertex_ao) {
+					const float ao = import_geom.computed_ao[i];
+					u32 ao8 = u8(clamp(ao * 255.f, 0.f, 255.f) + 0.5f);
+					u32 ao32 = ao8 | ao8 << 8 | ao8 << 16 | ao8 << 24;
+					import_mesh.vertex_data.write(ao32);
+				}
+				if (colors) {
+					if (cfg.vertex_color_is_ao) {
+						const u8 ao[4] = { u8(colors[i].x * 255.f + 0.5f) };
+						import_mesh.vertex_data.write(ao);
+					} else {
+						writeColor(colors[i], &import_mesh.vertex_data);
+					}
+				}
+				if (tangents) writePackedVec3(tangents[i], transform_matrix, &import_mesh.vertex_data);
+				if (import_mesh.is_skinned) writeSkin(skinning[i], &import_mesh.vertex_data);
 			}
-			if (colors) {
-				if (cfg.vertex_color_is_ao) {
-					const u8 ao[4] = { u8(colors[i].x * 255.f + 0.5f) };
-					import_mesh.vertex_data.write(ao);
-				} else {
-					writeColor(colors[i], &import_mesh.vertex_data);
+
+			for (int i = 0; i < vertex_count; ++i) {
+				if (geom_materials && geom_materials[i / 3] != material_idx) continue;
+				const u32 orig_idx = import_geom.indices[i];
+				if (intramat_idx[orig_idx] != 0xffFFffFF) {
+					import_mesh.indices.push(intramat_idx[orig_idx]);
 				}
 			}
-			if (tangents) writePackedVec3(tangents[i], transform_matrix, &import_mesh.vertex_data);
-			if (import_mesh.is_skinned) writeSkin(skinning[i], &import_mesh.vertex_data);
-		}
 
-		for (int i = 0; i < vertex_count; ++i) {
-			if (geom_materials && geom_materials[i / 3] != material_idx) continue;
-			const u32 orig_idx = import_geom.indices[i];
-			if (intramat_idx[orig_idx] != 0xffFFffFF) {
-				import_mesh.indices.push(intramat_idx[orig_idx]);
+			import_mesh.aabb = aabb;
+			import_mesh.origin_radius_squared = origin_radius_squared;
+			import_mesh.center_radius_squared = 0;
+			const Vec3 center = (aabb.max + aabb.min) * 0.5f;
+
+			const u8* mem = import_mesh.vertex_data.data();
+			for (u32 i = 0; i < written_idx; ++i) {
+				Vec3 p;
+				memcpy(&p, mem, sizeof(p));
+				import_mesh.center_radius_squared = maximum(import_mesh.center_radius_squared, squaredLength(p - center));
+				mem += vertex_size;
 			}
 		}
+	});
 
+	// each LOD of each mesh is simplified in its own job, so a single big mesh does not serialize all its LODs
+	struct AutoLODJob { u32 mesh; u32 lod; };
+	Array<AutoLODJob> autolod_jobs(m_allocator);
+	for (ImportMesh& import_mesh : m_meshes) {
+		if (import_mesh.lod != 0 || import_mesh.indices.empty()) continue;
 		for (u32 i = 0; i < cfg.lod_count; ++i) {
 			if ((cfg.autolod_mask & (1 << i)) == 0) continue;
-			if (import_mesh.lod != 0) continue;
-			
 			import_mesh.autolod_indices[i].create(m_allocator);
-			import_mesh.autolod_indices[i]->resize(import_mesh.indices.size());
-			const size_t lod_index_count = meshopt_simplify(import_mesh.autolod_indices[i]->begin()
-				, import_mesh.indices.begin()
-				, import_mesh.indices.size()
-				, (const float*)import_mesh.vertex_data.data()
-				, u32(import_mesh.vertex_data.size() / vertex_size)
-				, vertex_size
-				, size_t(import_mesh.indices.size() * cfg.autolod_coefs[i])
-				, 9001.f // TODO
-				);
-			import_mesh.autolod_indices[i]->resize((u32)lod_index_count);
-		}
-
-		import_mesh.aabb = aabb;
-		import_mesh.origin_radius_squared = origin_radius_squared;
-		import_mesh.center_radius_squared = 0;
-		const Vec3 center = (aabb.max + aabb.min) * 0.5f;
-
-		const u8* mem = import_mesh.vertex_data.data();
-		for (u32 i = 0; i < written_idx; ++i) {
-			Vec3 p;
-			memcpy(&p, mem, sizeof(p));
-			import_mesh.center_radius_squared = maximum(import_mesh.center_radius_squared, squaredLength(p - center));
-			mem += vertex_size;
-		}
+			autolod_jobs.push({u32(&import_mesh - m_meshes.begin()), i});
+		}
+	}
+
+	jobs::forEach(autolod_jobs.size(), 1, [&](i32 job_idx, i32){
+		const AutoLODJob& job = autolod_jobs[job_idx];
+		ImportMesh& import_mesh = m_meshes[job.mesh];
+		const u32 vertex_size = getVertexSize(*import_mesh.fbx->getGeometry(), import_mesh.is_skinned, cfg);
+		Array<u32>& lod_indices = *import_mesh.autolod_indices[job.lod];
+		lod_indices.resize(import_mesh.indices.size());
+		const size_t lod_index_count = meshopt_simplify(lod_indices.begin()
+			, import_mesh.indices.begin()
+			, import_mesh.indices.size()
+			, (const float*)import_mesh.vertex_data.data()
+			, u32(import_mesh.vertex_data.size() / vertex_size)
+			, vertex_size
+			, size_t(import_mesh.indices.size() * cfg.autolod_coefs[job.lod])
+			, 9001.f // TODO
+			);
+		lod_indices.resize((u32)lod_index_count);
 	});
 
+	// meshlets reorder indices, so they are built after autolods
+	if (cfg.meshlets) {
+		jobs::forEach(m_meshes.size(), 1, [&](i32 mesh_idx, i32){
+			ImportMesh& import_mesh = m_meshes[mesh_idx];
+			if (import_mesh.indices.empty()) return;
+			const u32 vertex_size = getVertexSize(*import_mesh.fbx->getGeometry(), import_mesh.is_skinned, cfg);
+			buildMeshlets(import_mesh, vertex_size, m_allocator);
+		});
+	}
+
 	for (int mesh_idx = m_meshes.size() - 1; mesh_idx >= 0; --mesh_idx)
 	{
 		if (m_meshes[mesh_idx].indices.empty()) m_meshes.swapAndPop(mesh_idx);
@@ -904,9 +968,11 @@ FBXImporter::FBXImporter(StudioApp& app)
 
 
 static void ofbx_job_processor(ofbx::JobFunction fn, void*, void* data, u32 size, u32 count) {
-	jobs::forEach(count, 1, [data, size, fn](i32 i, i32){
+	jobs::forEach(count, [data, size, fn](i32 from, i32 to){
 		u8* ptr = (u8*)data;
-		fn(ptr + i * size);
+		for (i32 i = from; i < to; ++i) {
+			fn(ptr + i * size);
+		}
 	});
 }
 
@@ -1099,6 +1165,7 @@ bool FBXImporter::createImpostorTextures(Model* model, Array<u32>& gb0_rgba, Arr
 					stream.useProgram(program);
 					stream.bindIndexBuffer(mesh.index_buffer_handle);
 					stream.bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+					if (mesh.quantization_buffer) stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 					stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
 					stream.drawIndexed(0, mesh.indices_count, mesh.index_type);
 				}
@@ -1185,7 +1252,16 @@ bool FBXImporter::createImpostorTextures(Model* model, Array<u32>& gb0_rgba, Arr
 	renderer->frame();
 	renderer->waitForRender();
 
-	const PathInfo src_info(model->getPath().c_str());
+	const AABB& aabb = model->getAABB();
+	writeImpostorMaterial(model->getPath().c_str(), (aabb.max + aabb.min).y * 0.5f, model->getCenterBoundingRadius(), bake_normals);
+
+	return true;
+}
+
+
+void FBXImporter::writeImpostorMaterial(const char* src, float center_y, float radius, bool bake_normals)
+{
+	const PathInfo src_info(src);
 	const StaticString<LUMIX_MAX_PATH> mat_src(src_info.m_dir, src_info.m_basename, "_impostor.mat");
 	os::OutputFile f;
 	if (!m_filesystem.fileExists(mat_src)) {
@@ -1193,18 +1269,21 @@ bool FBXImporter::createImpostorTextures(Model* model, Array<u32>& gb0_rgba, Arr
 			logError("Failed to create ", mat_src);
 		}
 		else {
-			const AABB& aabb = model->getAABB();
-			const Vec3 center = (aabb.max + aabb.min) * 0.5f;
 			f << "shader \"/pipelines/impostor.shd\"\n";
 			f << "texture \"" << src_info.m_basename << "_impostor0.tga\"\n";
-			f << "texture \"\"\n";
+			if (bake_normals) {
+				f << "texture \"" << src_info.m_basename << "_impostor1.tga\"\n";
+			}
+			else {
+				f << "texture \"\"\n";
+			}
 			f << "texture \"" << src_info.m_basename << "_impostor2.tga\"\n";
 			f << "texture \"" << src_info.m_basename << "_impostor_depth.raw\"\n";
 			f << "defines { \"ALPHA_CUTOUT\" }\n";
 			f << "layer \"impostor\"\n";
 			f << "backface_culling(false)\n";
-			f << "uniform(\"Center\", { 0, " << center.y << ", 0 })\n";
-			f << "uniform(\"Radius\", " << model->getCenterBoundingRadius() << ")\n";
+			f << "uniform(\"Center\", { 0, " << center_y << ", 0 })\n";
+			f << "uniform(\"Radius\", " << radius << ")\n";
 			f.close();
 		}
 	}
@@ -1219,8 +1298,6 @@ bool FBXImporter::createImpostorTextures(Model* model, Array<u32>& gb0_rgba, Arr
 			f.close();
 		}
 	}
-
-	return true;
 }
 
 
@@ -1289,6 +1366,20 @@ void FBXImporter::writeMaterials(const char* src, const ImportConfig& cfg)
 		}
 		f.close();
 	}
+
+	if (cfg.create_impostor) {
+		// same bounds as in writeBounds
+		AABB aabb = {{0, 0, 0}, {0, 0, 0}};
+		float center_radius_squared = 0;
+		for (const ImportMesh& import_mesh : m_meshes) {
+			if (!import_mesh.import) continue;
+			aabb.merge(import_mesh.aabb);
+			center_radius_squared = maximum(center_radius_squared, import_mesh.center_radius_squared);
+		}
+		center_radius_squared = maximum(center_radius_squared, squaredLength(aabb.max - aabb.min) * 0.5f);
+		const float center_y = (aabb.max + aabb.min).y * 0.5f * cfg.bounding_scale;
+		writeImpostorMaterial(src, center_y, sqrtf(center_radius_squared) * cfg.bounding_scale, cfg.bake_impostor_normals);
+	}
 }
 
 static void convert(const ofbx::Matrix& mtx, Vec3& pos, Quat& rot)
@@ -1526,9 +1617,40 @@ static bool isBindPosePositionTrack(u32 count, const Array<FBXImporter::Key>& ke
 	return true;
 }
 
+// smallest three, see Animation::Version
+static void quantizeRotation(const Quat& rot, u16* out) {
+	const Quat q = normalize(rot);
+	const float c[] = { q.x, q.y, q.z, q.w };
+	u32 largest = 0;
+	for (u32 i = 1; i < 4; ++i) {
+		if (fabsf(c[i]) > fabsf(c[largest])) largest = i;
+	}
+	const float sign = c[largest] < 0 ? -1.f : 1.f;
+	u32 j = 0;
+	for (u32 i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		const float v = clamp(c[i] * sign * 1.41421356f, -1.f, 1.f);
+		out[j] = u16((v * 0.5f + 0.5f) * 0x7fff + 0.5f);
+		++j;
+	}
+	out[0] |= u16((largest >> 1) << 15);
+	out[1] |= u16((largest & 1) << 15);
+}
+
 void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 {
 	PROFILE_FUNCTION();
+	// scratch buffers, reused by all clips and blocks
+	Array<Array<Key>> all_keys(m_allocator);
+	Array<Array<Quat>> all_rotations(m_allocator);
+	Array<Vec3> positions(m_allocator);
+	all_keys.reserve(m_bones.size());
+	all_rotations.reserve(m_bones.size());
+	for (i32 i = 0; i < m_bones.size(); ++i) {
+		all_keys.emplace(m_allocator);
+		all_rotations.emplace(m_allocator);
+	}
+
 	for (const FBXImporter::ImportAnimation& anim : m_animations) { 
 		ASSERT(anim.import);
 
@@ -1553,8 +1675,8 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 			continue;
 		}
 
-		auto write_animation = [&](const char* name, u32 from_frame, u32 to_frame) {
-			out_file.clear();
+		// appends complete non-streamed animation of frames [from_frame, to_frame] to out_file
+		auto write_animation_data = [&](u32 from_frame, u32 to_frame) {
 			const double anim_len = double(to_frame - from_frame) / fps;
 			Animation::Header header;
 			header.magic = Animation::HEADER_MAGIC;
@@ -1562,30 +1684,52 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 			header.length = Time::fromSeconds((float)anim_len);
 			header.frame_count = to_frame - from_frame;
 			write(header);
+			write(u32(0)); // block_frames
 
 			const i64 from_fbx_time = ofbx::secondsToFbxTime((double)from_frame / fps);
 			const i64 to_fbx_time = ofbx::secondsToFbxTime((double)to_frame / fps);
 
-			Array<Array<Key>> all_keys(m_allocator);
 			auto fbx_to_anim_time = [anim_len](i64 fbx_time){
 				const double t = clamp(ofbx::fbxTimeToSeconds(fbx_time) / anim_len, 0.0, 1.0);
 				return u16(t * 0xffFF);
 			};
 
-			all_keys.reserve(m_bones.size());
-			for (const ofbx::Object* bone : m_bones) {
-				Array<Key>& keys = all_keys.emplace(m_allocator);
+			// bones are independent, so curves are evaluated, compressed and sampled in parallel,
+			// only writing to out_file is serial
+			jobs::forEach(m_bones.size(), 1, [&](i32 bone_idx, i32){
+				const ofbx::Object* bone = m_bones[bone_idx];
+				Array<Key>& keys = all_keys[bone_idx];
+				keys.clear();
 				fill(*bone, *layer, keys, from_fbx_time, to_fbx_time);
-			}
 
-			for (const ofbx::Object*& bone : m_bones) {
-				Array<Key>& keys = all_keys[u32(&bone - m_bones.begin())];
 				ofbx::Object* parent = bone->getParent();
 				const float parent_scale = parent ? (float)getScaleX(parent->getGlobalTransform()) : 1;
 				// TODO skip curves which do not change anything
 				compressRotations(keys);
 				compressPositions(parent_scale, keys);
-			}
+
+				Array<Quat>& rotations = all_rotations[bone_idx];
+				rotations.clear();
+				u32 count = 0;
+				for (Key& key : keys) {
+					if ((key.flags & 2) == 0) ++count;
+				}
+				if (count == 0) return;
+
+				// 3 x u16 per quantized key
+				if (shouldSample(count, float(anim_len), fps, sizeof(u16) * 3)) {
+					count = u32(anim_len * fps + 0.5f);
+					for (u32 i = 0; i < count; ++i) {
+						const float t = float(anim_len * ((float)i / (count - 1)));
+						rotations.push(fixOrientation(sample(*bone, *layer, t + from_frame / fps).rot));
+					}
+				}
+				else {
+					for (Key& key : keys) {
+						if ((key.flags & 2) == 0) rotations.push(fixOrientation(key.rot));
+					}
+				}
+			});
 
 			const u64 stream_translations_count_pos = out_file.size();
 			u32 translation_curves_count = 0;
@@ -1619,21 +1763,46 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 
 				if (isBindPosePositionTrack(count, keys, bind_pos)) continue;
 			
-				const BoneNameHash name_hash(bone->name);
-				write(name_hash);
-				write(Animation::CurveType::KEYFRAMED);
-				write(count);
-
+				positions.clear();
+				AABB range(Vec3(FLT_MAX), Vec3(-FLT_MAX));
 				for (Key& key : keys) {
 					if ((key.flags & 1) == 0) {
-						write(fbx_to_anim_time(key.time));
+						positions.push(fixOrientation(key.pos * cfg.mesh_scale * m_fbx_scale));
+						range.addPoint(positions.back());
 					}
 				}
-				for (Key& key : keys) {
-					if ((key.flags & 1) == 0) {
-						write(fixOrientation(key.pos * cfg.mesh_scale * m_fbx_scale));
+				const Vec3 extents = range.max - range.min;
+				const bool is_constant = maximum(extents.x, extents.y, extents.z) < 1e-5f;
+
+				const BoneNameHash name_hash(bone->name);
+				write(name_hash);
+				if (is_constant) {
+					write(Animation::CurveType::CONSTANT);
+					write(u32(1));
+				}
+				else {
+					write(Animation::CurveType::KEYFRAMED);
+					write(count);
+					for (Key& key : keys) {
+						if ((key.flags & 1) == 0) {
+							write(fbx_to_anim_time(key.time));
+						}
 					}
 				}
+
+				// quantized relative to the curve's range
+				write(range.min);
+				write(extents * (1 / 65535.f));
+				for (const Vec3& p : positions) {
+					const Vec3 rel = p - range.min;
+					const u16 k[] = {
+						u16(extents.x > 0 ? rel.x / extents.x * 65535 + 0.5f : 0),
+						u16(extents.y > 0 ? rel.y / extents.y * 65535 + 0.5f : 0),
+						u16(extents.z > 0 ? rel.z / extents.z * 65535 + 0.5f : 0)
+					};
+					write(k);
+					if (is_constant) break;
+				}
 				++translation_curves_count;
 			}
 			memcpy(out_file.getMutableData() + stream_translations_count_pos, &translation_curves_count, sizeof(translation_curves_count));
@@ -1672,14 +1841,28 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 
 				const BoneNameHash name_hash(bone->name);
 				write(name_hash);
-				if (shouldSample(count, float(anim_len), fps, sizeof(Quat))) {
+
+				// already computed in parallel above
+				const bool is_sampled = shouldSample(count, float(anim_len), fps, sizeof(u16) * 3);
+				const Array<Quat>& rotations = all_rotations[bone_idx];
+				if (is_sampled) count = rotations.size();
+
+				bool is_constant = true;
+				for (const Quat& q : rotations) {
+					const Quat& q0 = rotations[0];
+					if (fabsf(q.x * q0.x + q.y * q0.y + q.z * q0.z + q.w * q0.w) < 1 - 1e-7f) {
+						is_constant = false;
+						break;
+					}
+				}
+
+				if (is_constant) {
+					write(Animation::CurveType::CONSTANT);
+					write(u32(1));
+				}
+				else if (is_sampled) {
 					write(Animation::CurveType::SAMPLED);
-					count = u32(anim_len * fps + 0.5f);
 					write(count);
-					for (u32 i = 0; i < count; ++i) {
-						const float t = float(anim_len * ((float)i / (count - 1)));
-						write(fixOrientation(sample(*bone, *layer, t + from_frame / fps).rot));
-					}
 				}
 				else {
 					write(Animation::CurveType::KEYFRAMED);
@@ -1689,18 +1872,56 @@ void FBXImporter::writeAnimations(const char* src, const ImportConfig& cfg)
 							write(fbx_to_anim_time(key.time));
 						}
 					}
-					for (Key& key : keys) {
-						if ((key.flags & 2) == 0) {
-							write(fixOrientation(key.rot));
-						}
-					}
+				}
+				for (const Quat& q : rotations) {
+					u16 k[3];
+					quantizeRotation(q, k);
+					write(k);
+					if (is_constant) break;
 				}
 				++rotation_curves_count;
 			}
 
 			memcpy(out_file.getMutableData() + stream_rotations_count_pos, &rotation_curves_count, sizeof(rotation_curves_count));
+		};
 
+		auto write_animation = [&](const char* name, u32 from_frame, u32 to_frame) {
+			// long clips, e.g. cinematics, are split into blocks streamed at runtime, see Animation::Version
+			constexpr float STREAMING_MIN_LENGTH = 30; // seconds
+			constexpr float BLOCK_LENGTH = 2; // seconds
 			const StaticString<LUMIX_MAX_PATH> anim_path(name, ".ani:", src);
+			out_file.clear();
+			const u32 frame_count = to_frame - from_frame;
+			const u32 block_frames = maximum(u32(BLOCK_LENGTH * fps + 0.5f), 1);
+			if (frame_count / fps <= STREAMING_MIN_LENGTH || frame_count <= block_frames) {
+				write_animation_data(from_frame, to_frame);
+				m_compiler.writeCompiledResource(anim_path, Span(out_file.data(), (i32)out_file.size()));
+				return;
+			}
+
+			// neighbouring blocks share the boundary frame, so every block can interpolate on its own
+			const u32 blocks_count = (frame_count + block_frames - 1) / block_frames;
+			Array<u64> offsets(m_allocator);
+			for (u32 i = 0; i < blocks_count; ++i) {
+				offsets.push(out_file.size());
+				write_animation_data(from_frame + i * block_frames, minimum(from_frame + (i + 1) * block_frames, to_frame));
+			}
+			offsets.push(out_file.size());
+			const StaticString<LUMIX_MAX_PATH> blocks_path(name, ".ani_blocks:", src);
+			m_compiler.writeCompiledResource(blocks_path, Span(out_file.data(), (i32)out_file.size()), false);
+
+			out_file.clear();
+			Animation::Header header;
+			header.magic = Animation::HEADER_MAGIC;
+			header.version = Animation::Version::LAST;
+			header.length = Time::fromSeconds(frame_count / fps);
+			header.frame_count = frame_count;
+			write(header);
+			write(block_frames);
+			write(Time::fromSeconds(block_frames / fps));
+			write(blocks_count);
+			out_file.write(offsets.begin(), offsets.byte_size());
+			out_file.writeString(blocks_path);
 			m_compiler.writeCompiledResource(anim_path, Span(out_file.data(), (i32)out_file.size()));
 		};
 		if (cfg.clips.length() == 0) {
@@ -1853,6 +2074,10 @@ void FBXImporter::writeImpostorVertices(const AABB& aabb)
 
 	const u32 vertex_data_size = sizeof(vertices);
 	write(vertex_data_size);
+	const u32 encoded_size = 0;
+	write(encoded_size);
+	write(Vec3(0)); // position offset
+	write(Vec3(1)); // position scale
 	for (const Vertex& vertex : vertices) {
 		write(vertex.pos);
 		write(vertex.uv);
@@ -1860,141 +2085,120 @@ void FBXImporter::writeImpostorVertices(const AABB& aabb)
 }
 
 
+// chunk is prefixed with its size, so loader can skip it, see Model::parseLODChunks
+u64 FBXImporter::beginLODChunk()
+{
+	const u64 chunk_start = out_file.size();
+	write((u32)0);
+	return chunk_start;
+}
+
+
+void FBXImporter::endLODChunk(u64 chunk_start)
+{
+	const u32 chunk_size = u32(out_file.size() - chunk_start - sizeof(u32));
+	memcpy(out_file.getMutableData() + chunk_start, &chunk_size, sizeof(chunk_size));
+}
+
+
 void FBXImporter::writeGeometry(int mesh_idx, const ImportConfig& cfg)
 {
-	float origin_radius_squared = 0;
-	float center_radius_squared = 0;
-	OutputMemoryStream vertices_blob(m_allocator);
 	const ImportMesh& import_mesh = m_meshes[mesh_idx];
 	
-	bool are_indices_16_bit = areIndices16Bit(import_mesh, cfg);
-	if (are_indices_16_bit)
-	{
-		int index_size = sizeof(u16);
-		write(index_size);
-		write(import_mesh.indices.size());
-		for (int i : import_mesh.indices)
-		{
-			ASSERT(i <= (1 << 16));
-			u16 index = (u16)i;
-			write(index);
-		}
-	}
-	else
-	{
-		int index_size = sizeof(import_mesh.indices[0]);
-		write(index_size);
-		write(import_mesh.indices.size());
-		write(&import_mesh.indices[0], sizeof(import_mesh.indices[0]) * import_mesh.indices.size());
-	}
-	origin_radius_squared = maximum(origin_radius_squared, import_mesh.origin_radius_squared);
-	center_radius_squared = maximum(center_radius_squared, import_mesh.center_radius_squared);
-
-	write((i32)import_mesh.vertex_data.size());
-	write(import_mesh.vertex_data.data(), import_mesh.vertex_data.size());
-
-	write(sqrtf(origin_radius_squared));
-	write(sqrtf(center_radius_squared));
-	write(import_mesh.aabb);
+	const u64 chunk_start = beginLODChunk();
+	const bool are_indices_16_bit = areIndices16Bit(import_mesh, cfg);
+	const u32 vertex_count = u32(import_mesh.vertex_data.size() / getVertexSize(*import_mesh.fbx->getGeometry(), import_mesh.is_skinned, cfg));
+	writeIndices(import_mesh.indices, vertex_count, are_indices_16_bit, cfg);
+	writeVertices(import_mesh, cfg);
+	writeMeshlets(import_mesh);
+	endLODChunk(chunk_start);
 }
 
 static bool hasAutoLOD(const FBXImporter::ImportConfig& cfg, u32 idx) {
 	return cfg.autolod_mask & (1 << idx);
 }
 
-void FBXImporter::writeGeometry(const ImportConfig& cfg)
+// returns AABB of imported meshes without bounding_scale
+AABB FBXImporter::writeBounds(const ImportConfig& cfg)
 {
 	AABB aabb = {{0, 0, 0}, {0, 0, 0}};
 	float origin_radius_squared = 0;
 	float center_radius_squared = 0;
-	OutputMemoryStream vertices_blob(m_allocator);
+	for (const ImportMesh& import_mesh : m_meshes) {
+		if (!import_mesh.import) continue;
 
-	for (u32 lod = 0; lod < cfg.lod_count - (cfg.create_impostor ? 1 : 0); ++lod) {
-		for (const ImportMesh& import_mesh : m_meshes)
-		{
+		origin_radius_squared = maximum(origin_radius_squared, import_mesh.origin_radius_squared);
+		center_radius_squared = maximum(center_radius_squared, import_mesh.center_radius_squared);
+		aabb.merge(import_mesh.aabb);
+	}
+
+	if (cfg.create_impostor) {
+		const float r = maximum(squaredLength(aabb.max), squaredLength(aabb.min));
+		origin_radius_squared = maximum(origin_radius_squared, r);
+		center_radius_squared = maximum(center_radius_squared, squaredLength(aabb.max - aabb.min) * 0.5f);
+	}
+
+	write(sqrtf(origin_radius_squared) * cfg.bounding_scale);
+	write(sqrtf(center_radius_squared) * cfg.bounding_scale);
+	write(aabb * cfg.bounding_scale);
+	return aabb;
+}
+
+// one chunk per lod, from the coarsest one, meshes are in the same order as in writeMeshes
+// autolods do not have meshlets
+void FBXImporter::writeGeometry(const ImportConfig& cfg, const AABB& aabb)
+{
+	const u32 mesh_lods = cfg.lod_count - (cfg.create_impostor ? 1 : 0);
+	for (u32 lod = cfg.lod_count; lod-- > 0;) {
+		const u64 chunk_start = beginLODChunk();
+		if (lod == mesh_lods) {
+			const int index_size = sizeof(u16);
+			write(index_size);
+			const u16 indices[] = {0, 1, 2, 0, 2, 3};
+			const u32 len = lengthOf(indices);
+			write(len);
+			const u32 encoded_size = 0;
+			write(encoded_size);
+			write(indices, sizeof(indices));
+			writeImpostorVertices(aabb);
+			write((u32)0);
+			endLODChunk(chunk_start);
+			continue;
+		}
+
+		for (const ImportMesh& import_mesh : m_meshes) {
 			if (!import_mesh.import) continue;
 
 			const bool are_indices_16_bit = areIndices16Bit(import_mesh, cfg);
-			origin_radius_squared = maximum(origin_radius_squared, import_mesh.origin_radius_squared);
-			center_radius_squared = maximum(center_radius_squared, import_mesh.center_radius_squared);
-			aabb.merge(import_mesh.aabb);
-			
+			const u32 vertex_count = u32(import_mesh.vertex_data.size() / getVertexSize(*import_mesh.fbx->getGeometry(), import_mesh.is_skinned, cfg));
 			if (import_mesh.lod == lod && !hasAutoLOD(cfg, lod)) {
-
-				if (are_indices_16_bit)
-				{
-					const i32 index_size = sizeof(u16);
-					write(index_size);
-					write(import_mesh.indices.size());
-					for (int i : import_mesh.indices)
-					{
-						ASSERT(i <= (1 << 16));
-						u16 index = (u16)i;
-						write(index);
-					}
-				}
-				else
-				{
-					int index_size = sizeof(import_mesh.indices[0]);
-					write(index_size);
-					write(import_mesh.indices.size());
-					write(&import_mesh.indices[0], sizeof(import_mesh.indices[0]) * import_mesh.indices.size());
-				}
+				writeIndices(import_mesh.indices, vertex_count, are_indices_16_bit, cfg);
 			}
 			else if (import_mesh.lod == 0 && hasAutoLOD(cfg, lod)) {
-				const auto& lod_indices = *import_mesh.autolod_indices[lod].get();
-				if (are_indices_16_bit) {
-					const i32 index_size = sizeof(u16);
-					write(index_size);
-					write(lod_indices.size());
-					for (u32 i : lod_indices)
-					{
-						ASSERT(i <= (1 << 16));
-						u16 index = (u16)i;
-						write(index);
-					}
-				}
-				else
-				{
-					i32 index_size = sizeof(lod_indices[0]);
-					write(index_size);
-					write(lod_indices.size());
-					write(lod_indices.begin(), import_mesh.autolod_indices[lod]->byte_size());
-				}
+				writeIndices(*import_mesh.autolod_indices[lod].get(), vertex_count, are_indices_16_bit, cfg);
 			}
 		}
-	}
-
-	if (cfg.create_impostor) {
-		const int index_size = sizeof(u16);
-		write(index_size);
-		const u16 indices[] = {0, 1, 2, 0, 2, 3};
-		const u32 len = lengthOf(indices);
-		write(len);
-		write(indices, sizeof(indices));
-	}
 
-	for (u32 lod = 0; lod < cfg.lod_count - (cfg.create_impostor ? 1 : 0); ++lod) {
 		for (const ImportMesh& import_mesh : m_meshes) {
 			if (!import_mesh.import) continue;
 			
 			if ((import_mesh.lod == lod && !hasAutoLOD(cfg, lod)) || (import_mesh.lod == 0 && hasAutoLOD(cfg, lod))) {
-				write((i32)import_mesh.vertex_data.size());
-				write(import_mesh.vertex_data.data(), import_mesh.vertex_data.size());
+				writeVertices(import_mesh, cfg);
 			}
 		}
-	}
-	if (cfg.create_impostor) {
-		writeImpostorVertices(aabb);
-		const float r = maximum(squaredLength(aabb.max), squaredLength(aabb.min));
-		origin_radius_squared = maximum(origin_radius_squared, r);
-		center_radius_squared = maximum(center_radius_squared, squaredLength(aabb.max - aabb.min) * 0.5f);
 
-	}
+		for (const ImportMesh& import_mesh : m_meshes) {
+			if (!import_mesh.import) continue;
 
-	write(sqrtf(origin_radius_squared) * cfg.bounding_scale);
-	write(sqrtf(center_radius_squared) * cfg.bounding_scale);
-	write(aabb * cfg.bounding_scale);
+			if (import_mesh.lod == lod && !hasAutoLOD(cfg, lod)) {
+				writeMeshlets(import_mesh);
+			}
+			else if (import_mesh.lod == 0 && hasAutoLOD(cfg, lod)) {
+				write((u32)0);
+			}
+		}
+		endLODChunk(chunk_start);
+	}
 }
 
 
@@ -2049,17 +2253,19 @@ void FBXImporter::writeMeshes(const char* src, int mesh_idx, const ImportConfig&
 		i32 attribute_count = getAttributeCount(import_mesh, cfg);
 		write(attribute_count);
 
+		// must match quantizeVertices
+		const bool quantized = isQuantized(import_mesh, cfg);
 		write(Mesh::AttributeSemantic::POSITION);
-		write(gpu::AttributeType::FLOAT);
-		write((u8)3);
+		write(quantized ? gpu::AttributeType::I16 : gpu::AttributeType::FLOAT);
+		write(quantized ? (u8)4 : (u8)3);
 		write(Mesh::AttributeSemantic::NORMAL);
-		write(gpu::AttributeType::I8);
-		write((u8)4);
+		write(quantized ? gpu::AttributeType::I16 : gpu::AttributeType::I8);
+		write(quantized ? (u8)2 : (u8)4);
 
 		const ofbx::Geometry* geom = mesh.getGeometry();
 		if (geom->getUVs()) {
 			write(Mesh::AttributeSemantic::TEXCOORD0);
-			write(gpu::AttributeType::FLOAT);
+			write(quantized ? gpu::AttributeType::HALF : gpu::AttributeType::FLOAT);
 			write((u8)2);
 		}
 		if (cfg.bake_vertex_ao) {
@@ -2081,8 +2287,8 @@ void FBXImporter::writeMeshes(const char* src, int mesh_idx, const ImportConfig&
 		}
 		if (hasTangents(*geom)) {
 			write(Mesh::AttributeSemantic::TANGENT);
-			write(gpu::AttributeType::I8);
-			write((u8)4);
+			write(quantized ? gpu::AttributeType::I16 : gpu::AttributeType::I8);
+			write(quantized ? (u8)2 : (u8)4);
 		}
 
 		if (import_mesh.is_skinned) {
@@ -2216,6 +2422,148 @@ bool FBXImporter::areIndices16Bit(const ImportMesh& mesh, const ImportConfig& cf
 	return !(mesh.import && mesh.vertex_data.size() / vertex_size > (1 << 16));
 }
 
+bool FBXImporter::isQuantized(const ImportMesh& mesh, const ImportConfig& cfg) const
+{
+	// skinning needs float positions
+	return cfg.quantize_vertices && !mesh.is_skinned;
+}
+
+
+static Vec3 unpackF4u(u32 packed)
+{
+	const i8* v = (const i8*)&packed;
+	return Vec3((v[0] + 128) / 255.f, (v[1] + 128) / 255.f, (v[2] + 128) / 255.f) * 2.f - 1.f;
+}
+
+
+// inverse of decodeOctahedral in common.glsl
+static void writeOctahedral(const Vec3& v, OutputMemoryStream& blob)
+{
+	const float sum = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	Vec2 e = sum > 0 ? Vec2(v.x / sum, v.y / sum) : Vec2(0);
+	if (sum > 0 && v.z < 0) {
+		e = Vec2((1 - fabsf(e.y)) * (e.x >= 0 ? 1 : -1), (1 - fabsf(e.x)) * (e.y >= 0 ? 1 : -1));
+	}
+	blob.write((i16)meshopt_quantizeSnorm(e.x, 16));
+	blob.write((i16)meshopt_quantizeSnorm(e.y, 16));
+}
+
+
+void FBXImporter::quantizeVertices(const ImportMesh& mesh, const ImportConfig& cfg, OutputMemoryStream& out, Vec3& offset, Vec3& scale) const
+{
+	const ofbx::Geometry* geom = mesh.fbx->getGeometry();
+	const u32 vertex_size = getVertexSize(*geom, mesh.is_skinned, cfg);
+	const u32 vertex_count = u32(mesh.vertex_data.size() / vertex_size);
+	const u8* vertices = mesh.vertex_data.data();
+	const bool has_uvs = geom->getUVs();
+	const bool has_tangents = hasTangents(*geom);
+	const u32 uv_size = has_uvs ? sizeof(Vec2) : 0;
+	const u32 tangent_size = has_tangents ? sizeof(u32) : 0;
+	// ao and color are copied as they are
+	const u32 rest_size = vertex_size - sizeof(Vec3) - sizeof(u32) - uv_size - tangent_size;
+
+	Vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (u32 i = 0; i < vertex_count; ++i) {
+		const Vec3 p = *(const Vec3*)&vertices[i * vertex_size];
+		min = minimum(min, p);
+		max = maximum(max, p);
+	}
+	offset = (min + max) * 0.5f;
+	scale = (max - min) * 0.5f;
+	if (scale.x == 0) scale.x = 1;
+	if (scale.y == 0) scale.y = 1;
+	if (scale.z == 0) scale.z = 1;
+
+	out.reserve(vertex_count * (vertex_size - sizeof(Vec3) - sizeof(Vec2) + sizeof(i16) * 4 + sizeof(u16) * 2));
+	for (u32 i = 0; i < vertex_count; ++i) {
+		const u8* v = &vertices[i * vertex_size];
+		const Vec3 p = (*(const Vec3*)v - offset) / scale;
+		out.write((i16)meshopt_quantizeSnorm(p.x, 16));
+		out.write((i16)meshopt_quantizeSnorm(p.y, 16));
+		out.write((i16)meshopt_quantizeSnorm(p.z, 16));
+		out.write((i16)0);
+		v += sizeof(Vec3);
+
+		writeOctahedral(unpackF4u(*(const u32*)v), out);
+		v += sizeof(u32);
+
+		if (has_uvs) {
+			const Vec2 uv = *(const Vec2*)v;
+			out.write(meshopt_quantizeHalf(uv.x));
+			out.write(meshopt_quantizeHalf(uv.y));
+			v += sizeof(Vec2);
+		}
+
+		out.write(v, rest_size);
+		v += rest_size;
+
+		if (has_tangents) writeOctahedral(unpackF4u(*(const u32*)v), out);
+	}
+}
+
+
+void FBXImporter::writeIndices(const Array<u32>& indices, u32 vertex_count, bool are_indices_16_bit, const ImportConfig& cfg)
+{
+	const i32 index_size = are_indices_16_bit ? sizeof(u16) : sizeof(u32);
+	write(index_size);
+	write(indices.size());
+
+	if (cfg.compress_buffers) {
+		OutputMemoryStream encoded(m_allocator);
+		encoded.resize(meshopt_encodeIndexBufferBound(indices.size(), vertex_count));
+		const u32 encoded_size = (u32)meshopt_encodeIndexBuffer(encoded.getMutableData(), encoded.size(), indices.begin(), indices.size());
+		ASSERT(encoded_size > 0);
+		write(encoded_size);
+		write(encoded.data(), encoded_size);
+		return;
+	}
+
+	const u32 encoded_size = 0;
+	write(encoded_size);
+	if (are_indices_16_bit) {
+		for (u32 i : indices) {
+			ASSERT(i <= (1 << 16));
+			write((u16)i);
+		}
+	}
+	else {
+		write(indices.begin(), indices.byte_size());
+	}
+}
+
+
+void FBXImporter::writeVertices(const ImportMesh& mesh, const ImportConfig& cfg)
+{
+	Vec3 offset(0);
+	Vec3 scale(1);
+	OutputMemoryStream quantized(m_allocator);
+	const bool is_quantized = isQuantized(mesh, cfg);
+	if (is_quantized) quantizeVertices(mesh, cfg, quantized, offset, scale);
+	const OutputMemoryStream& vertices = is_quantized ? quantized : mesh.vertex_data;
+	const u32 vertex_count = u32(mesh.vertex_data.size() / getVertexSize(*mesh.fbx->getGeometry(), mesh.is_skinned, cfg));
+	const u32 vertex_size = vertex_count > 0 ? u32(vertices.size() / vertex_count) : 0;
+
+	write((i32)vertices.size());
+	if (cfg.compress_buffers && vertex_count > 0) {
+		OutputMemoryStream encoded(m_allocator);
+		encoded.resize(meshopt_encodeVertexBufferBound(vertex_count, vertex_size));
+		const u32 encoded_size = (u32)meshopt_encodeVertexBuffer(encoded.getMutableData(), encoded.size(), vertices.data(), vertex_count, vertex_size);
+		ASSERT(encoded_size > 0);
+		write(encoded_size);
+		write(offset);
+		write(scale);
+		write(encoded.data(), encoded_size);
+		return;
+	}
+
+	const u32 encoded_size = 0;
+	write(encoded_size);
+	write(offset);
+	write(scale);
+	write(vertices.data(), vertices.size());
+}
+
+
 void FBXImporter::bakeVertexAO(const ImportConfig& cfg) {
 	PROFILE_FUNCTION();
 
@@ -2261,6 +2609,20 @@ void FBXImporter::bakeVertexAO(const ImportConfig& cfg) {
 	}
 }
 
+void FBXImporter::writeModelFlags(const ImportConfig& cfg)
+{
+	FlagSet<Model::Flags, u8> flags;
+	flags.set(Model::Flags::OCCLUDER, cfg.occluder);
+	flags.set(Model::Flags::STREAMED_LODS, cfg.stream_lods && cfg.lod_count > 1);
+	write(flags);
+}
+
+void FBXImporter::writeMeshlets(const ImportMesh& mesh)
+{
+	write(mesh.meshlets.size());
+	if (!mesh.meshlets.empty()) write(mesh.meshlets.begin(), mesh.meshlets.byte_size());
+}
+
 void FBXImporter::writeModelHeader()
 {
 	Model::FileHeader header;
@@ -2309,13 +2671,8 @@ void FBXImporter::writePhysics(const char* src, const ImportConfig& cfg)
 		}
 	}
 
-	if (to_convex) {
-		if (!ps->cookConvex(verts, out_file)) {
-			logError("Failed to cook ", src);
-			return;
-		}
-	} else {
-		Array<u32> indices(m_allocator);
+	Array<u32> indices(m_allocator);
+	if (!to_convex) {
 		i32 count = 0;
 		for (auto& mesh : m_meshes) {
 			count += mesh.indices.size();
@@ -2331,12 +2688,34 @@ void FBXImporter::writePhysics(const char* src, const ImportConfig& cfg)
 			int vertex_count = (i32)(mesh.vertex_data.size() / vertex_size);
 			offset += vertex_count;
 		}
+	}
 
-		if (!ps->cookTriMesh(verts, indices, out_file)) {
+	// cooking is slow, the same geometry (e.g. reimport with different render settings) reuses the cooked data
+	const u64 key[] = {
+		StableHash(verts.begin(), verts.byte_size()).getHashValue(),
+		StableHash(indices.begin(), indices.byte_size()).getHashValue(),
+		(u64)to_convex,
+		(u64)PhysicsGeometry::Versions::LAST
+	};
+	const StableHash cache_hash(key, sizeof(key));
+	const char* cache_dir = ".lumix/physics_cache";
+	const StaticString<LUMIX_MAX_PATH> cache_path(cache_dir, "/", cache_hash.getHashValue(), ".bin");
+	OutputMemoryStream cooked(m_allocator);
+	if (!m_filesystem.fileExists(cache_path) || !m_filesystem.getContentSync(Path(cache_path), cooked)) {
+		cooked.clear();
+		if (!ps->cookCollection(verts, indices, to_convex, cooked)) {
 			logError("Failed to cook ", src);
 			return;
 		}
+		const StaticString<LUMIX_MAX_PATH> cache_dir_abs(m_filesystem.getBasePath(), cache_dir);
+		if (!os::dirExists(cache_dir_abs) && !os::makePath(cache_dir_abs)) {
+			logWarning("Could not create ", cache_dir_abs);
+		}
+		else if (!m_filesystem.saveContentSync(Path(cache_path), cooked)) {
+			logWarning("Could not write ", cache_path);
+		}
 	}
+	out_file.write(cooked.data(), cooked.size());
 
 	const StaticString<LUMIX_MAX_PATH> phy_path(".phy:", src);
 	m_compiler.writeCompiledResource(phy_path, Span(out_file.data(), (i32)out_file.size()));
@@ -2394,7 +2773,9 @@ void FBXImporter::writeSubmodels(const char* src, const ImportConfig& cfg)
 		out_file.clear();
 		writeModelHeader();
 		writeMeshes(src, i, cfg);
-		writeGeometry(i, cfg);
+		write(sqrtf(m_meshes[i].origin_radius_squared));
+		write(sqrtf(m_meshes[i].center_radius_squared));
+		write(m_meshes[i].aabb);
 		if (m_meshes[i].is_skinned) {
 			writeSkeleton(cfg);
 		}
@@ -2410,6 +2791,8 @@ void FBXImporter::writeSubmodels(const char* src, const ImportConfig& cfg)
 		write(lod_count);
 		write(to_mesh);
 		write(factor);
+		writeModelFlags(cfg);
+		writeGeometry(i, cfg);
 
 		StaticString<LUMIX_MAX_PATH> resource_locator(name, ".fbx:", src);
 
@@ -2432,9 +2815,11 @@ void FBXImporter::writeModel(const char* src, const ImportConfig& cfg)
 	out_file.clear();
 	writeModelHeader();
 	writeMeshes(src, -1, cfg);
-	writeGeometry(cfg);
+	const AABB aabb = writeBounds(cfg);
 	writeSkeleton(cfg);
 	writeLODs(cfg);
+	writeModelFlags(cfg);
+	writeGeometry(cfg, aabb);
 
 	m_compiler.writeCompiledResource(src, Span(out_file.data(), (i32)out_file.size()));
 }
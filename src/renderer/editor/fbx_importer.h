@@ -9,6 +9,7 @@
 #include "engine/stream.h"
 #include "engine/string.h"
 #include "openfbx/ofbx.h"
+#include "renderer/model.h"
 
 
 namespace Lumix
@@ -39,10 +40,19 @@ struct FBXImporter
 		float mesh_scale;
 		Origin origin = Origin::SOURCE;
 		bool create_impostor = false;
+		bool bake_impostor_normals = false;
 		bool mikktspace_tangents = false;
 		bool import_vertex_colors = true;
 		bool vertex_color_is_ao = false;
 		bool bake_vertex_ao = false;
+		bool occluder = false;
+		bool meshlets = false;
+		// positions relative to AABB in i16, octahedral normals and tangents, half float UVs; skinned meshes are kept in floats
+		bool quantize_vertices = false;
+		// index and vertex buffers are compressed with meshoptimizer's codecs, decoded when the model is loaded
+		bool compress_buffers = false;
+		// only the coarsest lod is loaded with the model, finer lods are streamed when they are needed
+		bool stream_lods = false;
 		Physics physics = Physics::NONE;
 		u32 lod_count = 1;
 		float lods_distances[4] = {-10, -100, -1000, -10000};
@@ -138,6 +148,7 @@ struct FBXImporter
 		ImportMesh(IAllocator& allocator)
 			: vertex_data(allocator)
 			, indices(allocator)
+			, meshlets(allocator)
 		{
 		}
 
@@ -151,6 +162,7 @@ struct FBXImporter
 		OutputMemoryStream vertex_data;
 		Array<u32> indices;
 		Local<Array<u32>> autolod_indices[4];
+		Array<Mesh::Meshlet> meshlets;
 		AABB aabb;
 		float origin_radius_squared;
 		float center_radius_squared;
@@ -206,15 +218,25 @@ private:
 	Vec3 fixOrientation(const Vec3& v) const;
 	Quat fixOrientation(const Quat& v) const;
 	void writeImpostorVertices(const AABB& aabb);
-	void writeGeometry(const ImportConfig& cfg);
+	void writeImpostorMaterial(const char* src, float center_y, float radius, bool bake_normals);
+	AABB writeBounds(const ImportConfig& cfg);
+	void writeGeometry(const ImportConfig& cfg, const AABB& aabb);
 	void writeGeometry(int mesh_idx, const ImportConfig& cfg);
+	u64 beginLODChunk();
+	void endLODChunk(u64 chunk_start);
 	void writeImpostorMesh(const char* dir, const char* model_name);
 	void writeMeshes(const char* src, int mesh_idx, const ImportConfig& cfg);
 	void writeSkeleton(const ImportConfig& cfg);
 	void writeLODs(const ImportConfig& cfg);
 	int getAttributeCount(const ImportMesh& mesh, const ImportConfig& cfg) const;
 	bool areIndices16Bit(const ImportMesh& mesh, const ImportConfig& cfg) const;
+	bool isQuantized(const ImportMesh& mesh, const ImportConfig& cfg) const;
+	void quantizeVertices(const ImportMesh& mesh, const ImportConfig& cfg, OutputMemoryStream& out, Vec3& offset, Vec3& scale) const;
+	void writeIndices(const Array<u32>& indices, u32 vertex_count, bool are_indices_16_bit, const ImportConfig& cfg);
+	void writeVertices(const ImportMesh& mesh, const ImportConfig& cfg);
 	void writeModelHeader();
+	void writeModelFlags(const ImportConfig& cfg);
+	void writeMeshlets(const ImportMesh& mesh);
 	void bakeVertexAO(const ImportConfig& cfg);
 	
 	IAllocator& m_allocator;
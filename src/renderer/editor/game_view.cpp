@@ -8,11 +8,14 @@
 #include "editor/utils.h"
 #include "editor/world_editor.h"
 #include "engine/engine.h"
+#include "engine/file_system.h"
 #include "engine/geometry.h"
 #include "engine/input_system.h"
+#include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/profiler.h"
 #include "engine/resource_manager.h"
+#include "engine/stream.h"
 #include "engine/universe.h"
 #include "gui/gui_system.h"
 #include "renderer/gpu/gpu.h"
@@ -256,10 +259,28 @@ void GameView::controlsGUI(WorldEditor& editor) {
 	ImGui::SameLine();
 	ImGui::Checkbox("Stats", &m_show_stats);
 	ImGui::SameLine();
+	Renderer& renderer = m_pipeline->getRenderer();
+	bool record_shaders = renderer.isRecordingShaderUsage();
+	if (ImGui::Checkbox("Record shaders", &record_shaders)) {
+		renderer.recordShaderUsage(record_shaders);
+		if (!record_shaders) saveShaderUsage(renderer);
+	}
+	if (ImGui::IsItemHovered()) ImGui::SetTooltip("Shaders used while recording are compiled on game start");
+	ImGui::SameLine();
 	m_pipeline->callLuaFunction("onGUI");
 }
 
 
+void GameView::saveShaderUsage(Renderer& renderer) {
+	OutputMemoryStream blob(m_app.getAllocator());
+	renderer.saveShaderUsage(blob);
+	FileSystem& fs = m_app.getEngine().getFileSystem();
+	if (!fs.saveContentSync(Path(Renderer::SHADER_USAGE_PATH), blob)) {
+		logError("Could not save ", Renderer::SHADER_USAGE_PATH);
+	}
+}
+
+
 void GameView::onWindowGUI()
 {
 	PROFILE_FUNCTION();
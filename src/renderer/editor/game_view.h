@@ -53,6 +53,7 @@ private:
 	void setFullscreen(bool fullscreen);
 	void onStatsGUI(const ImVec2& view_pos);
 	void controlsGUI(WorldEditor& editor);
+	void saveShaderUsage(struct Renderer& renderer);
 
 private:
 	UniquePtr<Pipeline> m_pipeline;
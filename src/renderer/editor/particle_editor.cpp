@@ -30,6 +30,8 @@ struct ParticleEditorResource {
 
 	enum class Version {
 		LINK_ID_REMOVED,
+		GPU,
+		LOD,
 		LAST
 	};
 
@@ -1185,6 +1187,13 @@ struct ParticleEditorResource {
 
 		blob.read(m_last_id);
 		m_mat_path = blob.readString();
+		if (header.version > Version::GPU) {
+			blob.read(m_gpu);
+			blob.read(m_max_gpu_particles);
+		}
+		if (header.version > Version::LOD) {
+			blob.read(m_lod);
+		}
 		
 		i32 count;
 
@@ -1235,6 +1244,9 @@ struct ParticleEditorResource {
 		blob.write(header);
 		blob.write(m_last_id);
 		blob.writeString(m_mat_path.data);
+		blob.write(m_gpu);
+		blob.write(m_max_gpu_particles);
+		blob.write(m_lod);
 		
 		blob.write((i32)m_streams.size());
 		blob.write(m_streams.begin(), m_streams.byte_size());
@@ -1352,6 +1364,9 @@ struct ParticleEditorResource {
 
 	IAllocator& m_allocator;
 	StaticString<LUMIX_MAX_PATH> m_mat_path;
+	bool m_gpu = false;
+	u32 m_max_gpu_particles = 16 * 1024;
+	ParticleEmitterResource::LOD m_lod;
 	Array<Stream> m_streams;
 	Array<Output> m_outputs;
 	Array<Constant> m_consts;
@@ -1611,6 +1626,25 @@ struct ParticleEditorImpl : ParticleEditor, NodeEditor {
 	void leftColumnGUI() {
 		ImGuiEx::Label("Material");
 		m_app.getAssetBrowser().resourceInput("material", Span(m_resource->m_mat_path.data), Material::TYPE);
+		ImGuiEx::Label("GPU simulation");
+		if (ImGui::Checkbox("##gpu", &m_resource->m_gpu)) pushUndo(NO_MERGE_UNDO);
+		if (m_resource->m_gpu) {
+			ImGuiEx::Label("Max particles");
+			if (ImGui::DragScalar("##max_particles", ImGuiDataType_U32, &m_resource->m_max_gpu_particles)) pushUndo(ImGui::GetItemID());
+		}
+		if (ImGui::CollapsingHeader("LOD")) {
+			ParticleEmitterResource::LOD& lod = m_resource->m_lod;
+			ImGuiEx::Label("Distance");
+			if (ImGui::DragFloat("##lod_dist", &lod.distance, 1, 0, FLT_MAX)) pushUndo(ImGui::GetItemID());
+			ImGuiEx::Label("Emit rate scale");
+			if (ImGui::DragFloat("##lod_emit", &lod.emit_rate_scale, 0.01f, 0, 1)) pushUndo(ImGui::GetItemID());
+			ImGuiEx::Label("Update interval");
+			if (ImGui::DragScalar("##lod_interval", ImGuiDataType_U32, &lod.update_interval)) pushUndo(ImGui::GetItemID());
+			ImGuiEx::Label("Offscreen timeout");
+			if (ImGui::DragFloat("##lod_timeout", &lod.offscreen_timeout, 0.1f, -1, FLT_MAX)) pushUndo(ImGui::GetItemID());
+			ImGuiEx::Label("Bounding radius");
+			if (ImGui::DragFloat("##lod_radius", &lod.radius, 0.1f, 0, FLT_MAX)) pushUndo(ImGui::GetItemID());
+		}
 		if (ImGui::CollapsingHeader("Streams", ImGuiTreeNodeFlags_DefaultOpen)) {
 			for (ParticleEditorResource::Stream& s : m_resource->m_streams) {
 				ImGui::PushID(&s);
@@ -1703,7 +1737,10 @@ struct ParticleEditorImpl : ParticleEditor, NodeEditor {
 			, u32(m_resource->m_update.size() + m_resource->m_emit.size())
 			, getCount(m_resource->m_streams)
 			, m_resource->m_registers_count
-			, getCount(m_resource->m_outputs));
+			, getCount(m_resource->m_outputs)
+			, m_resource->m_gpu
+			, m_resource->m_max_gpu_particles);
+		emitter->getResource()->setLOD(m_resource->m_lod);
 		emitter->getResource()->setMaterial(Path(m_resource->m_mat_path));
 	}
 
@@ -1922,6 +1959,9 @@ struct ParticleEditorImpl : ParticleEditor, NodeEditor {
 		output.write(getCount(res.m_streams));
 		output.write((u32)res.m_registers_count);
 		output.write(getCount(res.m_outputs));
+		output.write(res.m_gpu);
+		output.write(res.m_max_gpu_particles);
+		output.write(res.m_lod);
 		return true;
 	}
 
@@ -35,6 +35,7 @@
 #include "engine/profiler.h"
 #include "engine/queue.h"
 #include "engine/resource_manager.h"
+#include "engine/sync.h"
 #include "engine/universe.h"
 #include "fbx_importer.h"
 #include "game_view.h"
@@ -77,14 +78,23 @@ static const ComponentType ENVIRONMENT_PROBE_TYPE = reflection::getComponentType
 static const ComponentType REFLECTION_PROBE_TYPE = reflection::getComponentType("reflection_probe");
 static const ComponentType FUR_TYPE = reflection::getComponentType("fur");
 static const ComponentType PROCEDURAL_GEOM_TYPE = reflection::getComponentType("procedural_geom");
+static const ComponentType SPLINE_TYPE = reflection::getComponentType("spline");
 
 namespace TextureCompressor {
 
+enum class Quality : u32 {
+	FAST,
+	NORMAL,
+	// BC7 instead of BC1 and BC3
+	HIGH
+};
+
 struct Options {
 	bool compress = true;
 	bool generate_mipmaps = false;
 	bool stochastic_mipmap = false;
 	float scale_coverage_ref = -0.5f;
+	Quality quality = Quality::NORMAL;
 };
 
 struct Input {
@@ -219,7 +229,17 @@ static void computeMip(Span<const u8> src, Span<u8> dst, u32 w, u32 h, u32 dst_w
 	}
 }
 
-static void compressBC1(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h) {
+static u32 getRGBCXLevel(const Options& options) {
+	switch (options.quality) {
+		case Quality::FAST: return 0;
+		case Quality::NORMAL: return 10;
+		case Quality::HIGH: return rgbcx::MAX_LEVEL;
+	}
+	ASSERT(false);
+	return 10;
+}
+
+static void compressBC1(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h, const Options& options) {
 	PROFILE_FUNCTION();
 	
 	const u32 dst_block_size = 8;
@@ -244,17 +264,17 @@ static void compressBC1(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32
 
 			const u32 bi = i >> 2;
 			const u32 bj = j >> 2;
-			rgbcx::encode_bc1(10, &out[(bi + bj * ((w + 3) >> 2)) * dst_block_size], (const u8*)tmp, true, false);
+			rgbcx::encode_bc1(getRGBCXLevel(options), &out[(bi + bj * ((w + 3) >> 2)) * dst_block_size], (const u8*)tmp, true, false);
 		}
 	});
 }
 
-static void compressRGBA(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h) {
+static void compressRGBA(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h, const Options& options) {
 	PROFILE_FUNCTION();
 	dst.write(src.begin(), src.length());
 }
 
-static void compressBC5(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h) {
+static void compressBC5(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h, const Options& options) {
 	PROFILE_FUNCTION();
 	
 	const u32 dst_block_size = 16;
@@ -284,7 +304,7 @@ static void compressBC5(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32
 	});
 }
 
-static void compressBC3(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h) {
+static void compressBC3(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h, const Options& options) {
 	PROFILE_FUNCTION();
 	
 	const u32 dst_block_size = 16;
@@ -309,7 +329,211 @@ static void compressBC3(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32
 
 			const u32 bi = i >> 2;
 			const u32 bj = j >> 2;
-			rgbcx::encode_bc3(10, &out[(bi + bj * ((w + 3) >> 2)) * dst_block_size], (const u8*)tmp);
+			rgbcx::encode_bc3(getRGBCXLevel(options), &out[(bi + bj * ((w + 3) >> 2)) * dst_block_size], (const u8*)tmp);
+		}
+	});
+}
+
+// BC7 mode 6 - single subset, RGBA endpoints with 7 bits and a p-bit per endpoint, 4 bit indices
+namespace BC7 {
+	static constexpr u32 WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Endpoints {
+		u8 c[2][4]; // 7 bits
+		u8 p[2];
+		
+		u8 get(u32 e, u32 ch) const { return (c[e][ch] << 1) | p[e]; }
+	};
+
+	// opaque blocks must keep alpha == 255, that's possible only with p-bit set
+	static void quantize(const float (&v)[2][4], bool opaque, Endpoints& out) {
+		for (u32 e = 0; e < 2; ++e) {
+			float best_err = FLT_MAX;
+			for (u8 p = opaque ? 1 : 0; p < 2; ++p) {
+				float err = 0;
+				u8 c[4];
+				for (u32 ch = 0; ch < 4; ++ch) {
+					c[ch] = (u8)clamp(i32((v[e][ch] - p) * 0.5f + 0.5f), 0, 127);
+					const float d = v[e][ch] - ((c[ch] << 1) | p);
+					err += d * d;
+				}
+				if (err < best_err) {
+					best_err = err;
+					out.p[e] = p;
+					memcpy(out.c[e], c, sizeof(c));
+				}
+			}
+		}
+	}
+
+	static u32 computeIndices(const u8* pixels, const Endpoints& endpoints, u8 (&indices)[16]) {
+		i32 palette[16][4];
+		for (u32 i = 0; i < 16; ++i) {
+			for (u32 ch = 0; ch < 4; ++ch) {
+				palette[i][ch] = ((64 - WEIGHTS[i]) * endpoints.get(0, ch) + WEIGHTS[i] * endpoints.get(1, ch) + 32) >> 6;
+			}
+		}
+
+		u32 total_err = 0;
+		for (u32 i = 0; i < 16; ++i) {
+			const u8* px = &pixels[i * 4];
+			u32 best_err = 0xffFFffFF;
+			for (u8 j = 0; j < 16; ++j) {
+				u32 err = 0;
+				for (u32 ch = 0; ch < 4; ++ch) {
+					const i32 d = px[ch] - palette[j][ch];
+					err += d * d;
+				}
+				if (err < best_err) {
+					best_err = err;
+					indices[i] = j;
+				}
+			}
+			total_err += best_err;
+		}
+		return total_err;
+	}
+
+	// least squares fit of endpoints to pixels with fixed indices, false if all pixels use the same index
+	static bool fitEndpoints(const u8* pixels, const u8 (&indices)[16], float (&v)[2][4]) {
+		float aa = 0, ab = 0, bb = 0;
+		float ax[4] = {}, bx[4] = {};
+		for (u32 i = 0; i < 16; ++i) {
+			const float b = WEIGHTS[indices[i]] / 64.f;
+			const float a = 1 - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (u32 ch = 0; ch < 4; ++ch) {
+				ax[ch] += a * pixels[i * 4 + ch];
+				bx[ch] += b * pixels[i * 4 + ch];
+			}
+		}
+		const float det = aa * bb - ab * ab;
+		if (fabsf(det) < 1e-6f) return false;
+		for (u32 ch = 0; ch < 4; ++ch) {
+			v[0][ch] = clamp((ax[ch] * bb - bx[ch] * ab) / det, 0.f, 255.f);
+			v[1][ch] = clamp((bx[ch] * aa - ax[ch] * ab) / det, 0.f, 255.f);
+		}
+		return true;
+	}
+
+	static void encodeBlock(const u8* pixels, u8* out, u32 refine_iterations) {
+		// initial endpoints on the principal axis of the block
+		float mean[4] = {};
+		bool opaque = true;
+		for (u32 i = 0; i < 16; ++i) {
+			for (u32 ch = 0; ch < 4; ++ch) mean[ch] += pixels[i * 4 + ch] / 16.f;
+			opaque = opaque && pixels[i * 4 + 3] == 0xff;
+		}
+		float cov[4][4] = {};
+		for (u32 i = 0; i < 16; ++i) {
+			float d[4];
+			for (u32 ch = 0; ch < 4; ++ch) d[ch] = pixels[i * 4 + ch] - mean[ch];
+			for (u32 r = 0; r < 4; ++r) {
+				for (u32 c = 0; c < 4; ++c) cov[r][c] += d[r] * d[c];
+			}
+		}
+		float axis[4] = { 1, 1, 1, 1 };
+		for (u32 iter = 0; iter < 8; ++iter) {
+			float tmp[4] = {};
+			for (u32 r = 0; r < 4; ++r) {
+				for (u32 c = 0; c < 4; ++c) tmp[r] += cov[r][c] * axis[c];
+			}
+			const float len = sqrtf(tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2] + tmp[3] * tmp[3]);
+			if (len < 1e-6f) break;
+			for (u32 ch = 0; ch < 4; ++ch) axis[ch] = tmp[ch] / len;
+		}
+		float t_min = FLT_MAX, t_max = -FLT_MAX;
+		for (u32 i = 0; i < 16; ++i) {
+			float t = 0;
+			for (u32 ch = 0; ch < 4; ++ch) t += (pixels[i * 4 + ch] - mean[ch]) * axis[ch];
+			t_min = minimum(t_min, t);
+			t_max = maximum(t_max, t);
+		}
+		float v[2][4];
+		for (u32 ch = 0; ch < 4; ++ch) {
+			v[0][ch] = clamp(mean[ch] + axis[ch] * t_min, 0.f, 255.f);
+			v[1][ch] = clamp(mean[ch] + axis[ch] * t_max, 0.f, 255.f);
+		}
+
+		Endpoints best;
+		u8 best_indices[16];
+		quantize(v, opaque, best);
+		u32 best_err = computeIndices(pixels, best, best_indices);
+		u8 indices[16];
+		memcpy(indices, best_indices, sizeof(indices));
+		for (u32 iter = 0; iter < refine_iterations && best_err > 0; ++iter) {
+			if (!fitEndpoints(pixels, indices, v)) break;
+			Endpoints endpoints;
+			quantize(v, opaque, endpoints);
+			const u32 err = computeIndices(pixels, endpoints, indices);
+			if (err >= best_err) break;
+			best_err = err;
+			best = endpoints;
+			memcpy(best_indices, indices, sizeof(indices));
+		}
+
+		// msb of the first index is implicit zero
+		if (best_indices[0] & 8) {
+			for (u32 ch = 0; ch < 4; ++ch) swap(best.c[0][ch], best.c[1][ch]);
+			swap(best.p[0], best.p[1]);
+			for (u8& idx : best_indices) idx = 15 - idx;
+		}
+
+		u64 bits[2] = {};
+		u32 pos = 0;
+		auto put = [&](u32 value, u32 count){
+			if (pos < 64) {
+				bits[0] |= u64(value) << pos;
+				if (pos + count > 64) bits[1] |= u64(value) >> (64 - pos);
+			}
+			else {
+				bits[1] |= u64(value) << (pos - 64);
+			}
+			pos += count;
+		};
+		put(1 << 6, 7);
+		for (u32 ch = 0; ch < 4; ++ch) {
+			put(best.c[0][ch], 7);
+			put(best.c[1][ch], 7);
+		}
+		put(best.p[0], 1);
+		put(best.p[1], 1);
+		put(best_indices[0], 3);
+		for (u32 i = 1; i < 16; ++i) put(best_indices[i], 4);
+		ASSERT(pos == 128);
+		memcpy(out, bits, sizeof(bits));
+	}
+} // namespace BC7
+
+static void compressBC7(Span<const u8> src, OutputMemoryStream& dst, u32 w, u32 h, const Options& options) {
+	PROFILE_FUNCTION();
+	
+	const u32 dst_block_size = 16;
+	const u32 size = getCompressedMipSize(w, h, dst_block_size);
+	const u64 offset = dst.size();
+	dst.resize(offset + size);
+	u8* out = dst.getMutableData() + offset;
+	const u32 refine_iterations = options.quality == Quality::HIGH ? 4 : 1;
+
+	jobs::forEach(h, 4, [&](i32 j, i32){
+		PROFILE_FUNCTION();
+		u32 tmp[16] = {};
+		const u8* src_row_begin = &src[j * w * 4];
+
+		const u32 src_block_h = minimum(h - j, 4);
+		for (u32 i = 0; i < w; i += 4) {
+			const u8* src_block_begin = src_row_begin + i * 4;
+			
+			const u32 src_block_w = minimum(w - i, 4);
+			for (u32 jj = 0; jj < src_block_h; ++jj) {
+				memcpy(&tmp[jj * 4], &src_block_begin[jj * w * 4], 4 * src_block_w);
+			}
+
+			const u32 bi = i >> 2;
+			const u32 bj = j >> 2;
+			BC7::encodeBlock((const u8*)tmp, &out[(bi + bj * ((w + 3) >> 2)) * dst_block_size], refine_iterations);
 		}
 	});
 }
@@ -361,10 +585,11 @@ static void scaleCoverage(Span<u8> data, u32 w, u32 h, float ref_norm, float wan
 	}
 }
 
-static void compress(void (*compressor)(Span<const u8>, OutputMemoryStream&, u32, u32), const Input& src_data, const Options& options, OutputMemoryStream& dst, IAllocator& allocator) {
+using Compressor = void (*)(Span<const u8>, OutputMemoryStream&, u32, u32, const Options&);
+
+static void compress(Compressor compressor, u32 block_size, const Input& src_data, const Options& options, OutputMemoryStream& dst, IAllocator& allocator) {
 	const u32 mips = options.generate_mipmaps ? 1 + log2(maximum(src_data.w, src_data.h)) : src_data.mips;
 	const u32 faces = src_data.is_cubemap ? 6 : 1;
-	const u32 block_size = src_data.has_alpha || src_data.is_normalmap ? 16 : 8;
 	const u32 total_compressed_size = getCompressedSize(src_data.w, src_data.h, mips, faces, block_size);
 	dst.reserve(dst.size() + total_compressed_size);
 	Array<u8> mip_data(allocator);
@@ -382,7 +607,7 @@ static void compress(void (*compressor)(Span<const u8>, OutputMemoryStream&, u32
 				if (options.generate_mipmaps) {
 					if (mip == 0) {
 						const Input::Image& src_mip = src_data.get(face, slice, mip);
-						compressor(src_mip.pixels, dst, mip_w, mip_h);
+						compressor(src_mip.pixels, dst, mip_w, mip_h, options);
 					}
 					else {
 						mip_data.resize(mip_w * mip_h * 4);
@@ -392,13 +617,13 @@ static void compress(void (*compressor)(Span<const u8>, OutputMemoryStream&, u32
 						if (options.scale_coverage_ref >= 0.f) {
 							scaleCoverage(mip_data, mip_w, mip_h, options.scale_coverage_ref, coverage);
 						}
-						compressor(mip_data, dst, mip_w, mip_h);
+						compressor(mip_data, dst, mip_w, mip_h, options);
 						prev_mip.swap(mip_data);
 					}
 				}
 				else {
 					const Input::Image& src_mip = src_data.get(face, slice, mip);
-					compressor(src_mip.pixels, dst, mip_w, mip_h);
+					compressor(src_mip.pixels, dst, mip_w, mip_h, options);
 				}
 			}
 		}
@@ -428,22 +653,19 @@ static bool isValid(const Input& src_data, const Options& options) {
 	const bool can_compress = options.compress && (src_data.w % 4) == 0 && (src_data.h % 4) == 0;
 	if (!can_compress) format = gpu::TextureFormat::RGBA8;
 	else if (src_data.is_normalmap) format = gpu::TextureFormat::BC5;
+	else if (options.quality == Quality::HIGH) format = gpu::TextureFormat::BC7;
 	else if (src_data.has_alpha) format = gpu::TextureFormat::BC3;
 	else format = gpu::TextureFormat::BC1;
 		
 	writeLBCHeader(dst, src_data.w, src_data.h, src_data.slices, mips, format, false, src_data.is_cubemap);
 
-	if (!can_compress) {
-		compress(compressRGBA, src_data, options, dst, allocator);
-	}
-	if (src_data.is_normalmap) {
-		compress(compressBC5, src_data, options, dst, allocator);
-	}
-	else if (src_data.has_alpha) {
-		compress(compressBC3, src_data, options, dst, allocator);
-	}
-	else {
-		compress(compressBC1, src_data, options, dst, allocator);
+	switch (format) {
+		case gpu::TextureFormat::RGBA8: compress(compressRGBA, 4 * 16, src_data, options, dst, allocator); break;
+		case gpu::TextureFormat::BC5: compress(compressBC5, 16, src_data, options, dst, allocator); break;
+		case gpu::TextureFormat::BC7: compress(compressBC7, 16, src_data, options, dst, allocator); break;
+		case gpu::TextureFormat::BC3: compress(compressBC3, 16, src_data, options, dst, allocator); break;
+		case gpu::TextureFormat::BC1: compress(compressBC1, 8, src_data, options, dst, allocator); break;
+		default: ASSERT(false); return false;
 	}
 	return true;
 }
@@ -657,6 +879,8 @@ struct FontPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	bool onGUI(Span<Resource*> resources) override { return false; }
 	void onResourceUnloaded(Resource* resource) override {}
 	const char* getName() const override { return "Font"; }
@@ -678,6 +902,8 @@ struct PipelinePlugin final : AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 	StudioApp& m_app;
 };
 
@@ -836,6 +1062,8 @@ struct MaterialPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
+	bool isThreadSafe() const override { return true; }
+
 
 	void saveMaterial(Material* material)
 	{
@@ -1118,6 +1346,7 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		float scale_coverage = -0.5f;
 		bool stochastic_mipmap = false;
 		bool compress = true;
+		TextureCompressor::Quality quality = TextureCompressor::Quality::NORMAL;
 		WrapMode wrap_mode_u = WrapMode::REPEAT;
 		WrapMode wrap_mode_v = WrapMode::REPEAT;
 		WrapMode wrap_mode_w = WrapMode::REPEAT;
@@ -1352,6 +1581,7 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		options.generate_mipmaps = meta.mips;
 		options.stochastic_mipmap = meta.stochastic_mipmap;
 		options.scale_coverage_ref = meta.scale_coverage;
+		options.quality = meta.quality;
 		return TextureCompressor::compress(input, options, dst, allocator);
 	}
 
@@ -1444,6 +1674,7 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			options.stochastic_mipmap = meta.stochastic_mipmap; 
 			options.scale_coverage_ref = meta.scale_coverage;
 			options.compress = meta.compress;
+			options.quality = meta.quality;
 			const bool res = TextureCompressor::compress(input, options, dst, m_app.getAllocator());
 			stbi_image_free(stb_data);
 			return res;
@@ -1467,6 +1698,11 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "invert_green", &meta.invert_normal_y);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "mips", &meta.mips);
 			char tmp[32];
+			if(LuaWrapper::getOptionalStringField(L, LUA_GLOBALSINDEX, "quality", Span(tmp))) {
+				if (equalIStrings(tmp, "fast")) meta.quality = TextureCompressor::Quality::FAST;
+				else if (equalIStrings(tmp, "high")) meta.quality = TextureCompressor::Quality::HIGH;
+				else meta.quality = TextureCompressor::Quality::NORMAL;
+			}
 			if(LuaWrapper::getOptionalStringField(L, LUA_GLOBALSINDEX, "filter", Span(tmp))) {
 				if (equalIStrings(tmp, "point")) {
 					meta.filter = Meta::Filter::POINT;
@@ -1531,6 +1767,16 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		return m_app.getAssetCompiler().writeCompiledResource(src.c_str(), Span(out.data(), (i32)out.size()));
 	}
 
+	const char* toString(TextureCompressor::Quality quality) {
+		switch (quality) {
+			case TextureCompressor::Quality::FAST: return "fast";
+			case TextureCompressor::Quality::NORMAL: return "normal";
+			case TextureCompressor::Quality::HIGH: return "high";
+		}
+		ASSERT(false);
+		return "normal";
+	}
+
 	const char* toString(Meta::Filter filter) {
 		switch (filter) {
 			case Meta::Filter::POINT: return "point";
@@ -1599,6 +1845,7 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			case gpu::TextureFormat::BC3: format = "BC3"; break;
 			case gpu::TextureFormat::BC4: format = "BC4"; break;
 			case gpu::TextureFormat::BC5: format = "BC5"; break;
+			case gpu::TextureFormat::BC7: format = "BC7"; break;
 		}
 		ImGuiEx::Label("Format");
 		ImGui::TextUnformatted(format);
@@ -1688,6 +1935,10 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			if (m_meta.compress && (texture->width % 4 != 0 || texture->height % 4 != 0)) {
 				ImGui::TextUnformatted(ICON_FA_EXCLAMATION_TRIANGLE " Block compression will not be used because texture size is not multiple of 4");
 			}
+			else if (m_meta.compress) {
+				ImGuiEx::Label("Quality");
+				changed = ImGui::Combo("##quality", (int*)&m_meta.quality, "Fast\0Normal\0High (BC7)\0") || changed;
+			}
 
 			bool scale_coverage = m_meta.scale_coverage >= 0;
 			ImGuiEx::Label("Mipmap scale coverage");
@@ -1720,6 +1971,7 @@ struct TexturePlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			if (ImGui::Button(ICON_FA_CHECK "Apply")) {
 				const StaticString<512> src("srgb = ", m_meta.srgb ? "true" : "false"
 					, "\ncompress = ", m_meta.compress ? "true" : "false"
+					, "\nquality = \"", toString(m_meta.quality), "\""
 					, "\nstochastic_mip = ", m_meta.stochastic_mipmap ? "true" : "false"
 					, "\nmip_scale_coverage = ", m_meta.scale_coverage
 					, "\nmips = ", m_meta.mips ? "true" : "false"
@@ -1841,6 +2093,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		bool create_impostor = false;
 		bool bake_impostor_normals = false;
 		bool bake_vertex_ao = false;
+		bool occluder = false;
+		bool meshlets = false;
+		bool quantize_vertices = false;
+		bool compress_buffers = false;
+		bool stream_lods = false;
 		bool use_mikktspace = false;
 		bool force_skin = false;
 		bool import_vertex_colors = false;
@@ -1862,6 +2119,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		, m_tile(app.getAllocator())
 		, m_fbx_importer(app)
 		, m_meta(app.getAllocator())
+		, m_impostor_requests(app.getAllocator())
+		, m_impostor_bakes(app.getAllocator())
 		, AssetBrowser::Plugin(app.getAllocator())
 	{
 		app.getAssetCompiler().registerExtension("fbx", Model::TYPE);
@@ -1872,6 +2131,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 	{
 		if (m_downscale_program) m_pipeline->getRenderer().getEndFrameDrawStream().destroy(m_downscale_program);
 		jobs::wait(&m_subres_signal);
+		for (Model* model : m_impostor_bakes) model->decRefCount();
+		if (m_impostor_shadow_shader) m_impostor_shadow_shader->decRefCount();
 		auto& engine = m_app.getEngine();
 		engine.destroyUniverse(*m_universe);
 		m_pipeline.reset();
@@ -1888,6 +2149,7 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		m_viewport.near = 0.f;
 		m_viewport.far = 1000.f;
 		m_fbx_importer.init();
+		m_impostor_shadow_shader = engine.getResourceManager().load<Shader>(Path("pipelines/impostor_shadow.shd"));
 	}
 
 
@@ -1903,6 +2165,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "split", &meta.split);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "bake_impostor_normals", &meta.bake_impostor_normals);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "bake_vertex_ao", &meta.bake_vertex_ao);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "occluder", &meta.occluder);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "meshlets", &meta.meshlets);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "quantize_vertices", &meta.quantize_vertices);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "compress_buffers", &meta.compress_buffers);
+			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "stream_lods", &meta.stream_lods);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "create_impostor", &meta.create_impostor);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "import_vertex_colors", &meta.import_vertex_colors);
 			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "vertex_color_is_ao", &meta.vertex_color_is_ao);
@@ -2016,11 +2283,17 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		cfg.bounding_scale = meta.culling_scale;
 		cfg.physics = meta.physics;
 		cfg.bake_vertex_ao = meta.bake_vertex_ao;
+		cfg.occluder = meta.occluder;
+		cfg.meshlets = meta.meshlets;
+		cfg.quantize_vertices = meta.quantize_vertices;
+		cfg.compress_buffers = meta.compress_buffers;
+		cfg.stream_lods = meta.stream_lods;
 		cfg.import_vertex_colors = meta.import_vertex_colors;
 		cfg.vertex_color_is_ao = meta.vertex_color_is_ao;
 		cfg.lod_count = meta.lod_count;
 		memcpy(cfg.lods_distances, meta.lods_distances, sizeof(meta.lods_distances));
 		cfg.create_impostor = meta.create_impostor;
+		cfg.bake_impostor_normals = meta.bake_impostor_normals;
 		cfg.clips = meta.clips;
 		const PathInfo src_info(filepath);
 		m_fbx_importer.setSource(filepath, false, meta.force_skin);
@@ -2046,6 +2319,18 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		m_fbx_importer.writeMaterials(filepath, cfg);
 		m_fbx_importer.writeAnimations(filepath, cfg);
 		m_fbx_importer.writePhysics(filepath, cfg);
+
+		if (meta.create_impostor && !m_fbx_importer.getMeshes().empty()) {
+			// impostor material needs its textures to load, placeholders are used until the model is loaded and baked
+			const StaticString<LUMIX_MAX_PATH> albedo_path(src_info.m_dir, src_info.m_basename, "_impostor0.tga");
+			if (!m_app.getEngine().getFileSystem().fileExists(albedo_path)) {
+				const u32 texel = 0;
+				const u16 depth = 0;
+				saveImpostorTextures(filepath, Span(&texel, 1), Span(&texel, 1), Span(&depth, 1), Span(&texel, 1), IVec2(1));
+			}
+			MutexGuard guard(m_impostor_mutex);
+			m_impostor_requests.push(Path(filepath));
+		}
 		return true;
 	}
 
@@ -2207,6 +2492,102 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 	}
 
 
+	// writes atlases referenced by the impostor material, size is in texels
+	void saveImpostorTextures(const char* model_path, Span<const u32> gb0, Span<const u32> gb1, Span<const u16> depth, Span<const u32> shadow, const IVec2& size) {
+		IAllocator& allocator = m_app.getAllocator();
+		const PathInfo fi(model_path);
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		os::OutputFile file;
+
+		auto saveTGA = [&](const char* suffix, Span<const u32> data){
+			const StaticString<LUMIX_MAX_PATH> img_path(fi.m_dir, fi.m_basename, suffix);
+			if (fs.open(img_path, file)) {
+				Texture::saveTGA(&file, size.x, size.y, gpu::TextureFormat::RGBA8, (const u8*)data.begin(), gpu::isOriginBottomLeft(), Path(img_path), allocator);
+				file.close();
+			}
+			else {
+				logError("Failed to open ", img_path);
+			}
+		};
+		saveTGA("_impostor0.tga", gb0);
+		saveTGA("_impostor1.tga", gb1);
+		saveTGA("_impostor2.tga", shadow);
+
+		const StaticString<LUMIX_MAX_PATH> img_path(fi.m_dir, fi.m_basename, "_impostor_depth.raw");
+		if (fs.open(img_path, file)) {
+			RawTextureHeader header;
+			header.width = size.x;
+			header.height = size.y;
+			header.depth = 1;
+			header.channel_type = RawTextureHeader::ChannelType::U16;
+			header.channels_count = 1;
+			bool res = file.write(header);
+			if (gpu::isOriginBottomLeft()) {
+				res = file.write(depth.begin(), depth.length() * sizeof(depth[0])) && res;
+			} else {
+				Array<u16> flipped_depth(allocator);
+				flipped_depth.resize(depth.length());
+				for (u32 j = 0; j < header.height; ++j) {
+					for (u32 i = 0; i < header.width; ++i) {
+						flipped_depth[i + j * header.width] = depth[i + (header.height - j - 1) * header.width];
+					}
+				}
+				res = file.write(flipped_depth.begin(), flipped_depth.byte_size()) && res;
+			}
+			if (!res) logError("Failed to write ", img_path);
+			file.close();
+		}
+		else {
+			logError("Failed to open ", img_path);
+		}
+	}
+
+	void bakeImpostor(Model& model, bool bake_normals) {
+		FBXImporter importer(m_app);
+		importer.init();
+		IAllocator& allocator = m_app.getAllocator();
+		Array<u32> gb0(allocator); 
+		Array<u32> gb1(allocator);
+		Array<u16> gbdepth(allocator);
+		Array<u32> shadow(allocator); 
+		IVec2 tile_size;
+		importer.createImpostorTextures(&model, gb0, gb1, gbdepth, shadow, tile_size, bake_normals);
+		postprocessImpostor(gb0, gb1, shadow, tile_size, allocator);
+		ASSERT(gb0.size() == tile_size.x * 9 * tile_size.y * 9);
+		saveImpostorTextures(model.getPath().c_str(), gb0, gb1, gbdepth, shadow, tile_size * 9);
+	}
+
+	// bakes impostors of imported models once they are loaded
+	void updateImpostorBakes() {
+		{
+			MutexGuard guard(m_impostor_mutex);
+			for (const Path& path : m_impostor_requests) {
+				m_impostor_bakes.push(m_app.getEngine().getResourceManager().load<Model>(path));
+			}
+			m_impostor_requests.clear();
+		}
+
+		for (i32 i = m_impostor_bakes.size() - 1; i >= 0; --i) {
+			Model* model = m_impostor_bakes[i];
+			if (model->isFailure()) {
+				logError("Could not bake impostor of ", model->getPath(), ", model failed to load");
+			}
+			else if (model->isReady() && model->getResidentLOD() > 0) {
+				// impostors are rendered from lod 0
+				model->requestLOD(0);
+				continue;
+			}
+			else if (model->isReady() && m_impostor_shadow_shader->isReady()) {
+				bakeImpostor(*model, getMeta(model->getPath()).bake_impostor_normals);
+			}
+			else {
+				continue;
+			}
+			model->decRefCount();
+			m_impostor_bakes.swapAndPop(i);
+		}
+	}
+
 	static void postprocessImpostor(Array<u32>& gb0, Array<u32>& gb1, Array<u32>& shadow, const IVec2& tile_size, IAllocator& allocator) {
 		struct Cell {
 			i16 x, y;
@@ -2340,6 +2721,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		blob.read(m_meta.create_impostor);
 		blob.read(m_meta.bake_impostor_normals);
 		blob.read(m_meta.bake_vertex_ao);
+		blob.read(m_meta.occluder);
+		blob.read(m_meta.meshlets);
+		blob.read(m_meta.quantize_vertices);
+		blob.read(m_meta.compress_buffers);
+		blob.read(m_meta.stream_lods);
 		blob.read(m_meta.use_mikktspace);
 		blob.read(m_meta.force_skin);
 		blob.read(m_meta.import_vertex_colors);
@@ -2363,6 +2749,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 		blob.write(m_meta.create_impostor);
 		blob.write(m_meta.bake_impostor_normals);
 		blob.write(m_meta.bake_vertex_ao);
+		blob.write(m_meta.occluder);
+		blob.write(m_meta.meshlets);
+		blob.write(m_meta.quantize_vertices);
+		blob.write(m_meta.compress_buffers);
+		blob.write(m_meta.stream_lods);
 		blob.write(m_meta.use_mikktspace);
 		blob.write(m_meta.force_skin);
 		blob.write(m_meta.import_vertex_colors);
@@ -2497,6 +2888,16 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			}
 			ImGuiEx::Label("Bake vertex AO");
 			changed = ImGui::Checkbox("##impnrm", &m_meta.bake_vertex_ao) || changed;
+			ImGuiEx::Label("Occluder");
+			changed = ImGui::Checkbox("##occluder", &m_meta.occluder) || changed;
+			ImGuiEx::Label("Meshlets");
+			changed = ImGui::Checkbox("##meshlets", &m_meta.meshlets) || changed;
+			ImGuiEx::Label("Quantize vertices");
+			changed = ImGui::Checkbox("##quantize", &m_meta.quantize_vertices) || changed;
+			ImGuiEx::Label("Compress buffers");
+			changed = ImGui::Checkbox("##compress", &m_meta.compress_buffers) || changed;
+			ImGuiEx::Label("Stream LODs");
+			changed = ImGui::Checkbox("##stream_lods", &m_meta.stream_lods) || changed;
 			ImGuiEx::Label("Mikktspace tangents");
 			changed = ImGui::Checkbox("##mikktspace", &m_meta.use_mikktspace) || changed;
 			ImGuiEx::Label("Force skinned");
@@ -2658,6 +3059,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 				String src(m_app.getAllocator());
 				src.cat("create_impostor = ").cat(m_meta.create_impostor ? "true" : "false")
 					.cat("\nbake_vertex_ao = ").cat(m_meta.bake_vertex_ao ? "true" : "false")
+					.cat("\noccluder = ").cat(m_meta.occluder ? "true" : "false")
+					.cat("\nmeshlets = ").cat(m_meta.meshlets ? "true" : "false")
+					.cat("\nquantize_vertices = ").cat(m_meta.quantize_vertices ? "true" : "false")
+					.cat("\ncompress_buffers = ").cat(m_meta.compress_buffers ? "true" : "false")
+					.cat("\nstream_lods = ").cat(m_meta.stream_lods ? "true" : "false")
 					.cat("\nbake_impostor_normals = ").cat(m_meta.bake_impostor_normals ? "true" : "false")
 					.cat("\nuse_mikktspace = ").cat(m_meta.use_mikktspace ? "true" : "false")
 					.cat("\nforce_skin = ").cat(m_meta.force_skin ? "true" : "false")
@@ -2696,84 +3102,20 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("Create impostor texture")) {
-				FBXImporter importer(m_app);
-				importer.init();
-				IAllocator& allocator = m_app.getAllocator();
-				Array<u32> gb0(allocator); 
-				Array<u32> gb1(allocator);
-				Array<u16> gbdepth(allocator);
-				Array<u32> shadow(allocator); 
-				IVec2 tile_size;
-				importer.createImpostorTextures(model, gb0, gb1, gbdepth, shadow, tile_size, m_meta.bake_impostor_normals);
-				postprocessImpostor(gb0, gb1, shadow, tile_size, allocator);
-				const PathInfo fi(model->getPath().c_str());
-				StaticString<LUMIX_MAX_PATH> img_path(fi.m_dir, fi.m_basename, "_impostor0.tga");
-				ASSERT(gb0.size() == tile_size.x * 9 * tile_size.y * 9);
-				
-				os::OutputFile file;
-				FileSystem& fs = m_app.getEngine().getFileSystem();
-				if (fs.open(img_path, file)) {
-					Texture::saveTGA(&file, tile_size.x * 9, tile_size.y * 9, gpu::TextureFormat::RGBA8, (const u8*)gb0.begin(), gpu::isOriginBottomLeft(), Path(img_path), allocator);
-					file.close();
+				if (model->getResidentLOD() == 0) {
+					bakeImpostor(*model, m_meta.bake_impostor_normals);
 				}
 				else {
-					logError("Failed to open ", img_path);
-				}
-
-				img_path = fi.m_dir;
-				img_path << fi.m_basename << "_impostor1.tga";
-				if (fs.open(img_path, file)) {
-					Texture::saveTGA(&file, tile_size.x * 9, tile_size.y * 9, gpu::TextureFormat::RGBA8, (const u8*)gb1.begin(), gpu::isOriginBottomLeft(), Path(img_path), allocator);
-					file.close();
-				}
-				else {
-					logError("Failed to open ", img_path);
-				}
-
-				img_path = fi.m_dir;
-				img_path << fi.m_basename << "_impostor_depth.raw";
-				if (fs.open(img_path, file)) {
-					RawTextureHeader header;
-					header.width = tile_size.x * 9;
-					header.height = tile_size.y * 9;
-					header.depth = 1;
-					header.channel_type = RawTextureHeader::ChannelType::U16;
-					header.channels_count = 1;
-					bool res = file.write(header);
-					if (gpu::isOriginBottomLeft()) {
-						res = file.write(gbdepth.begin(), gbdepth.byte_size()) && res;
-					} else {
-						Array<u16> flipped_depth(m_app.getAllocator());
-						flipped_depth.resize(gbdepth.size());
-						for (u32 j = 0; j < header.height; ++j) {
-							for (u32 i = 0; i < header.width; ++i) {
-								flipped_depth[i + j * header.width] = gbdepth[i + (header.height - j - 1) * header.width];
-							}
-						}
-						res = file.write(flipped_depth.begin(), flipped_depth.byte_size()) && res;
-					}
-					if (!res) logError("Failed to write ", img_path);
-					file.close();
-				}
-				else {
-					logError("Failed to open ", img_path);
-				}
-
-				img_path = fi.m_dir;
-				img_path << fi.m_basename << "_impostor2.tga";
-				if (fs.open(img_path, file)) {
-					Texture::saveTGA(&file, tile_size.x * 9, tile_size.y * 9, gpu::TextureFormat::RGBA8, (const u8*)shadow.begin(), gpu::isOriginBottomLeft(), Path(img_path), allocator);
-					file.close();
-				}
-				else {
-					logError("Failed to open ", img_path);
+					// baked once lod 0 is streamed in
+					model->incRefCount();
+					m_impostor_bakes.push(model);
 				}
 			}
 			ImGui::SameLine();
 			ImGui::TextDisabled("(?)");
 			if (ImGui::IsItemHovered())
-				ImGui::SetTooltip("%s", "To use impostors, check `Create impostor mesh` and press this button. "
-				"When the mesh changes, you need to regenerate the impostor texture by pressing this button again.");
+				ImGui::SetTooltip("%s", "Impostor textures are baked automatically when a model with `Create impostor mesh` is imported. "
+				"Press this button to bake them again.");
 			}
 
 		showPreview(*model);
@@ -2828,6 +3170,8 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 
 	void update() override
 	{
+		updateImpostorBakes();
+
 		if (m_tile.waiting) {
 			if (!m_app.getEngine().getFileSystem().hasWork()) {
 				renderPrefabSecondStage();
@@ -3138,6 +3482,11 @@ struct ModelPlugin final : AssetBrowser::Plugin, AssetCompiler::IPlugin
 	int m_captured_mouse_y;
 	TexturePlugin* m_texture_plugin;
 	FBXImporter m_fbx_importer;
+	Shader* m_impostor_shadow_shader = nullptr;
+	Mutex m_impostor_mutex;
+	// filled by compile on asset compiler's thread
+	Array<Path> m_impostor_requests;
+	Array<Model*> m_impostor_bakes;
 	jobs::Signal m_subres_signal;
 	Meta m_meta;
 	FilePathHash m_meta_res;
@@ -3372,12 +3721,17 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 	explicit EnvironmentProbePlugin(StudioApp& app)
 		: m_app(app)
 		, m_probes(app.getAllocator())
+		, m_dirty_probes(app.getAllocator())
 	{
 	}
 
 
 	~EnvironmentProbePlugin()
 	{
+		WorldEditor& editor = m_app.getWorldEditor();
+		editor.universeCreated().unbind<&EnvironmentProbePlugin::onUniverseCreated>(this);
+		editor.universeDestroyed().unbind<&EnvironmentProbePlugin::onUniverseDestroyed>(this);
+		onUniverseDestroyed();
 		m_ibl_filter_shader->decRefCount();
 	}
 
@@ -3390,6 +3744,56 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		PipelineResource* pres = rm.load<PipelineResource>(Path("pipelines/main.pln"));
 		m_pipeline = Pipeline::create(*renderer, pres, "PROBE", allocator);
 		m_ibl_filter_shader = rm.load<Shader>(Path("pipelines/ibl_filter.shd"));
+
+		WorldEditor& editor = m_app.getWorldEditor();
+		editor.universeCreated().bind<&EnvironmentProbePlugin::onUniverseCreated>(this);
+		editor.universeDestroyed().bind<&EnvironmentProbePlugin::onUniverseDestroyed>(this);
+		if (editor.getUniverse()) onUniverseCreated();
+	}
+
+	void onUniverseCreated() {
+		m_universe = m_app.getWorldEditor().getUniverse();
+		m_universe->entityTransformed().bind<&EnvironmentProbePlugin::onEntityTransformed>(this);
+		m_universe->entitiesTransformed().bind<&EnvironmentProbePlugin::onEntitiesTransformed>(this);
+		m_universe->componentAdded().bind<&EnvironmentProbePlugin::onComponentChanged>(this);
+		m_universe->componentDestroyed().bind<&EnvironmentProbePlugin::onComponentChanged>(this);
+	}
+
+	void onUniverseDestroyed() {
+		if (!m_universe) return;
+		m_universe->entityTransformed().unbind<&EnvironmentProbePlugin::onEntityTransformed>(this);
+		m_universe->entitiesTransformed().unbind<&EnvironmentProbePlugin::onEntitiesTransformed>(this);
+		m_universe->componentAdded().unbind<&EnvironmentProbePlugin::onComponentChanged>(this);
+		m_universe->componentDestroyed().unbind<&EnvironmentProbePlugin::onComponentChanged>(this);
+		m_universe = nullptr;
+		m_dirty_probes.clear();
+	}
+
+	void onEntityTransformed(EntityRef e) { markProbesDirty(e); }
+	void onComponentChanged(const ComponentUID& cmp) { markProbesDirty((EntityRef)cmp.entity); }
+	
+	void onEntitiesTransformed(Span<const EntityRef> entities) {
+		for (EntityRef e : entities) markProbesDirty(e);
+	}
+
+	void markProbeDirty(EntityRef probe) {
+		if (m_dirty_probes.indexOf(probe) < 0) m_dirty_probes.push(probe);
+	}
+
+	// mark all probes which can see the changed entity, so only those are rebaked by "Generate changed"
+	void markProbesDirty(EntityRef e) {
+		RenderScene* scene = (RenderScene*)m_universe->getScene(ENVIRONMENT_PROBE_TYPE);
+		if (!scene) return;
+		const DVec3 pos = m_universe->getPosition(e);
+		
+		for (EntityRef p : scene->getEnvironmentProbesEntities()) {
+			const float r = length(scene->getEnvironmentProbe(p).outer_range);
+			if (p == e || squaredLength(Vec3(m_universe->getPosition(p) - pos)) <= r * r) markProbeDirty(p);
+		}
+		for (EntityRef p : scene->getReflectionProbesEntities()) {
+			const float r = length(scene->getReflectionProbe(p).half_extents);
+			if (p == e || squaredLength(Vec3(m_universe->getPosition(p) - pos)) <= r * r) markProbeDirty(p);
+		}
 	}
 
 	bool saveCubemap(u64 probe_guid, const Vec4* data, u32 texture_size, u32 mips_count) {
@@ -3439,7 +3843,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 	}
 
 
-	void generateCubemaps(bool bounce, Universe& universe) {
+	void generateCubemaps(bool bounce, Universe& universe, bool only_changed) {
 		ASSERT(m_probes.empty());
 
 		m_pipeline->setIndirectLightMultiplier(bounce ? 1.f : 0.f);
@@ -3450,6 +3854,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		m_probes.reserve(env_probes.length() + reflection_probes.length());
 		IAllocator& allocator = m_app.getAllocator();
 		for (EntityRef p : env_probes) {
+			if (only_changed && m_dirty_probes.indexOf(p) < 0) continue;
 			ProbeJob* job = LUMIX_NEW(m_app.getAllocator(), ProbeJob)(*this, universe, p, allocator);
 			
 			job->env_probe = scene->getEnvironmentProbe(p);
@@ -3460,6 +3865,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		}
 
 		for (EntityRef p : reflection_probes) {
+			if (only_changed && m_dirty_probes.indexOf(p) < 0) continue;
 			ProbeJob* job = LUMIX_NEW(m_app.getAllocator(), ProbeJob)(*this, universe, p, allocator);
 			
 			job->reflection_probe = scene->getReflectionProbe(p);
@@ -3470,6 +3876,18 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		}
 
 		m_probe_counter += m_probes.size();
+		m_dirty_probes.clear();
+	}
+
+	void generatorGUI(Universe& universe) {
+		if (!ImGui::CollapsingHeader("Generator")) return;
+		if (ImGui::Button("Generate")) generateCubemaps(false, universe, false);
+		ImGui::SameLine();
+		if (ImGui::Button("Add bounce")) generateCubemaps(true, universe, false);
+		if (m_dirty_probes.empty()) return;
+		ImGui::SameLine();
+		const StaticString<64> label("Generate changed (", m_dirty_probes.size(), ")");
+		if (ImGui::Button(label)) generateCubemaps(false, universe, true);
 	}
 
 	struct ProbeJob {
@@ -3503,7 +3921,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		captureCubemap(m_app, job.universe, *m_pipeline, texture_size, job.position, job.data, [&job](){
 			jobs::runLambda([&job]() {
 				job.plugin.processData(job);
-			}, nullptr);
+			}, nullptr, jobs::ANY_WORKER, jobs::Priority::BACKGROUND);
 
 		});
 	}
@@ -3725,11 +4143,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 		if (cmp_type == ENVIRONMENT_PROBE_TYPE) {
 			if (m_probe_counter) ImGui::Text("Generating...");
 			else {
-				if (ImGui::CollapsingHeader("Generator")) {
-					if (ImGui::Button("Generate")) generateCubemaps(false, universe);
-					ImGui::SameLine();
-					if (ImGui::Button("Add bounce")) generateCubemaps(true, universe);
-				}
+				generatorGUI(universe);
 			}
 		}
 
@@ -3743,11 +4157,7 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 					ImGui::TextUnformatted(path);
 					if (ImGui::Button("View radiance")) m_app.getAssetBrowser().selectResource(Path(path), true, false);
 				}
-				if (ImGui::CollapsingHeader("Generator")) {
-					if (ImGui::Button("Generate")) generateCubemaps(false, universe);
-					ImGui::SameLine();
-					if (ImGui::Button("Add bounce")) generateCubemaps(true, universe);
-				}
+				generatorGUI(universe);
 			}
 		}
 	}
@@ -3760,6 +4170,8 @@ struct EnvironmentProbePlugin final : PropertyGrid::IPlugin
 	
 	// TODO to be used with http://casual-effects.blogspot.com/2011/08/plausible-environment-lighting-in-two.html
 	Array<ProbeJob*> m_probes;
+	Array<EntityRef> m_dirty_probes;
+	Universe* m_universe = nullptr;
 	u32 m_done_counter = 0;
 	u32 m_probe_counter = 0;
 };
@@ -4481,6 +4893,358 @@ struct ProceduralGeomPlugin final : PropertyGrid::IPlugin, StudioApp::MousePlugi
 	bool m_paint_as_color = false;
 };
 
+// generates a road-like ribbon along a spline into dynamic procedural geometry of the same entity,
+// if the spline has generate_mesh set, generation runs on a worker and only pieces around changed control points are rebuilt
+struct SplineMeshPlugin final : StudioApp::GUIPlugin, PropertyGrid::IPlugin {
+	// each control point owns a piece of the curve, between midpoints of its neighbouring segments
+	static constexpr u32 PIECE_STEPS = 10;
+	static constexpr u32 PIECE_VERTICES = (PIECE_STEPS + 1) * 2;
+	static constexpr u32 PIECE_INDICES = PIECE_STEPS * 6;
+
+	struct Vertex {
+		Vec3 pos;
+		Vec2 uv;
+		Vec3 normal;
+		Vec3 tangent;
+	};
+
+	struct Job {
+		Job(IAllocator& allocator)
+			: points(allocator)
+			, vertices(allocator)
+			, indices(allocator)
+		{}
+
+		void execute() {
+			PROFILE_FUNCTION();
+			for (u32 piece = from; piece < to; ++piece) {
+				// an edit happened after the job started, results are thrown away
+				if (canceled) break;
+				const u32 offset = piece - from;
+				generatePiece(piece, &vertices[offset * PIECE_VERTICES], &indices[offset * PIECE_INDICES]);
+			}
+			atomicIncrement(&finished);
+		}
+
+		void generatePiece(u32 piece, Vertex* out_vertices, u32* out_indices) const {
+			const u32 last = points.size() - 1;
+			const Vec3 b = points[piece];
+			const Vec3 a = piece == 0 ? b : lerp(points[piece - 1], b, 0.5f);
+			const Vec3 c = piece == last ? b : lerp(b, points[piece + 1], 0.5f);
+			const float half_width = width * 0.5f;
+
+			for (u32 i = 0; i <= PIECE_STEPS; ++i) {
+				const float t = i / (float)PIECE_STEPS;
+				const Vec3 p = lerp(lerp(a, b, t), lerp(b, c, t), t);
+				Vec3 dir = (b - a) * (2 * (1 - t)) + (c - b) * (2 * t);
+				// derivative is zero at the ends of the first and the last piece
+				if (squaredLength(dir) < 1e-10f) dir = c - a;
+				if (squaredLength(dir) < 1e-10f) dir = Vec3(0, 0, 1);
+				dir = normalize(dir);
+				Vec3 side = cross(dir, Vec3(0, 1, 0));
+				side = squaredLength(side) < 1e-10f ? Vec3(1, 0, 0) : normalize(side);
+				const Vec3 normal = cross(side, dir);
+
+				Vertex& v0 = out_vertices[i * 2];
+				Vertex& v1 = out_vertices[i * 2 + 1];
+				v0.pos = p + side * half_width;
+				v0.uv = Vec2(0, piece + t);
+				v1.pos = p - side * half_width;
+				v1.uv = Vec2(1, piece + t);
+				v0.normal = v1.normal = normal;
+				v0.tangent = v1.tangent = side;
+			}
+
+			const u32 base = piece * PIECE_VERTICES;
+			for (u32 i = 0; i < PIECE_STEPS; ++i) {
+				const u32 row = base + i * 2;
+				u32* idx = out_indices + i * 6;
+				idx[0] = row;
+				idx[1] = row + 2;
+				idx[2] = row + 1;
+				idx[3] = row + 1;
+				idx[4] = row + 2;
+				idx[5] = row + 3;
+			}
+		}
+
+		Array<Vec3> points;
+		float width;
+		// range of pieces
+		u32 from;
+		u32 to;
+		Array<Vertex> vertices;
+		Array<u32> indices;
+		volatile i32 canceled = 0;
+		volatile i32 finished = 0;
+		jobs::Signal signal;
+	};
+
+	// enabling generation replaces procedural geometry of the entity, undo restores the previous geometry
+	struct SetGenerateMeshCommand final : IEditorCommand {
+		SetGenerateMeshCommand(SplineMeshPlugin& plugin, EntityRef entity, bool value)
+			: m_plugin(plugin)
+			, m_entity(entity)
+			, m_value(value)
+			, m_old_geometry(plugin.m_app.getAllocator())
+			, m_undo_payload(m_old_geometry)
+		{
+			if (!value) return;
+			const ProceduralGeometry& pg = getRenderScene().getProceduralGeometry(entity);
+			m_old_geometry.write(&pg.vertex_decl, sizeof(pg.vertex_decl));
+			m_old_geometry.write(pg.index_type);
+			m_old_geometry.write((u32)pg.vertex_data.size());
+			m_old_geometry.write(pg.vertex_data.data(), pg.vertex_data.size());
+			m_old_geometry.write((u32)pg.index_data.size());
+			m_old_geometry.write(pg.index_data.data(), pg.index_data.size());
+		}
+
+		RenderScene& getRenderScene() const { return *(RenderScene*)m_plugin.m_app.getWorldEditor().getUniverse()->getScene(PROCEDURAL_GEOM_TYPE); }
+		Spline& getSpline() const { return ((CoreScene*)m_plugin.m_app.getWorldEditor().getUniverse()->getScene(SPLINE_TYPE))->getSpline(m_entity); }
+
+		void setGenerateMesh(bool value) {
+			getSpline().generate_mesh = value;
+			// geometry is not generated from the spline at this point
+			if (value && m_plugin.m_stale.indexOf(m_entity) < 0) m_plugin.m_stale.push(m_entity);
+		}
+
+		bool execute() override {
+			setGenerateMesh(m_value);
+			return true;
+		}
+
+		void undo() override {
+			setGenerateMesh(!m_value);
+			if (!m_value) return;
+
+			InputMemoryStream blob(m_old_geometry);
+			gpu::VertexDecl decl(gpu::PrimitiveType::NONE);
+			blob.read(&decl, sizeof(decl));
+			const gpu::DataType index_type = blob.read<gpu::DataType>();
+			const u32 vertices_size = blob.read<u32>();
+			const Span<const u8> vertices((const u8*)blob.skip(vertices_size), vertices_size);
+			const u32 indices_size = blob.read<u32>();
+			const Span<const u8> indices((const u8*)blob.skip(indices_size), indices_size);
+			getRenderScene().setProceduralGeometry(m_entity, vertices, decl, indices, index_type);
+		}
+
+		const char* getType() override { return "set_spline_generate_mesh"; }
+		bool merge(IEditorCommand& command) override { return false; }
+		void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
+
+		SplineMeshPlugin& m_plugin;
+		EntityRef m_entity;
+		bool m_value;
+		OutputMemoryStream m_old_geometry;
+		UndoPayload m_undo_payload;
+	};
+
+	explicit SplineMeshPlugin(StudioApp& app)
+		: m_app(app)
+		, m_vertex_decl(gpu::PrimitiveType::TRIANGLES)
+		, m_points(app.getAllocator())
+		, m_canceled_jobs(app.getAllocator())
+		, m_stale(app.getAllocator())
+	{
+		m_vertex_decl.addAttribute(0, offsetof(Vertex, pos), 3, gpu::AttributeType::FLOAT, 0);
+		m_vertex_decl.addAttribute(1, offsetof(Vertex, uv), 2, gpu::AttributeType::FLOAT, 0);
+		m_vertex_decl.addAttribute(2, offsetof(Vertex, normal), 3, gpu::AttributeType::FLOAT, 0);
+		m_vertex_decl.addAttribute(3, offsetof(Vertex, tangent), 3, gpu::AttributeType::FLOAT, 0);
+	}
+
+	~SplineMeshPlugin() {
+		cancelJob();
+		for (Job* job : m_canceled_jobs) destroyJob(job);
+	}
+
+	const char* getName() const override { return "spline_mesh"; }
+	void onWindowGUI() override {}
+
+	void destroyJob(Job* job) {
+		// finished is set at the very end of the job, this does not block for long
+		jobs::wait(&job->signal);
+		LUMIX_DELETE(m_app.getAllocator(), job);
+	}
+
+	void cancelJob() {
+		if (!m_job) return;
+		atomicIncrement(&m_job->canceled);
+		m_canceled_jobs.push(m_job);
+		m_job = nullptr;
+	}
+
+	EntityPtr getSplineEntity() const {
+		WorldEditor& editor = m_app.getWorldEditor();
+		const Array<EntityRef>& selected = editor.getSelectedEntities();
+		if (selected.size() != 1) return INVALID_ENTITY;
+		const Universe& universe = *editor.getUniverse();
+		if (!universe.hasComponent(selected[0], SPLINE_TYPE)) return INVALID_ENTITY;
+		if (!universe.hasComponent(selected[0], PROCEDURAL_GEOM_TYPE)) return INVALID_ENTITY;
+		CoreScene* core_scene = (CoreScene*)universe.getScene(SPLINE_TYPE);
+		if (!core_scene->getSpline(selected[0]).generate_mesh) return INVALID_ENTITY;
+		return selected[0];
+	}
+
+	void markDirty(u32 from, u32 to) {
+		m_dirty_from = minimum(m_dirty_from, from);
+		m_dirty_to = maximum(m_dirty_to, to);
+	}
+
+	// pieces depend on the control point and its neighbours
+	bool markChangedPoints(const Array<Vec3>& points) {
+		const u32 count = points.size();
+		const u32 prev_count = m_points.size();
+		u32 first = 0;
+		while (first < count && first < prev_count && points[first] == m_points[first]) ++first;
+		if (first == count && count == prev_count) return false;
+		
+		u32 last = count;
+		if (count == prev_count) {
+			while (last > first && points[last - 1] == m_points[last - 1]) --last;
+		}
+		markDirty(first > 0 ? first - 1 : 0, minimum(last + 1, count));
+		m_points = points.makeCopy();
+		return true;
+	}
+
+	void startJob(EntityRef entity) {
+		const u32 count = m_points.size();
+		RenderScene* scene = (RenderScene*)m_app.getWorldEditor().getUniverse()->getScene(PROCEDURAL_GEOM_TYPE);
+		if (count < 2) {
+			if (scene->getProceduralGeometry(entity).dynamic) scene->setProceduralGeometryCounts(entity, 0, 0);
+			m_dirty_from = 0xffFFffFF;
+			m_dirty_to = 0;
+			return;
+		}
+
+		// reallocation drops the old content
+		if (count > m_capacity || !scene->getProceduralGeometry(entity).dynamic) markDirty(0, count);
+		m_dirty_to = minimum(m_dirty_to, count);
+		if (m_dirty_from >= m_dirty_to) {
+			scene->setProceduralGeometryCounts(entity, count * PIECE_VERTICES, count * PIECE_INDICES);
+			m_dirty_from = 0xffFFffFF;
+			m_dirty_to = 0;
+			return;
+		}
+
+		IAllocator& allocator = m_app.getAllocator();
+		Job* job = LUMIX_NEW(allocator, Job)(allocator);
+		job->points = m_points.makeCopy();
+		job->width = m_width;
+		job->from = m_dirty_from;
+		job->to = m_dirty_to;
+		job->vertices.resize((job->to - job->from) * PIECE_VERTICES);
+		job->indices.resize((job->to - job->from) * PIECE_INDICES);
+		jobs::runLambda([job](){ job->execute(); }, &job->signal);
+		m_job = job;
+	}
+
+	void applyJob(EntityRef entity) {
+		Job* job = m_job;
+		m_job = nullptr;
+
+		RenderScene* scene = (RenderScene*)m_app.getWorldEditor().getUniverse()->getScene(PROCEDURAL_GEOM_TYPE);
+		const u32 count = job->points.size();
+		if (count > m_capacity || !scene->getProceduralGeometry(entity).dynamic) {
+			m_capacity = maximum(count * 2, 16u);
+			scene->setProceduralGeometryDynamic(entity, m_vertex_decl, m_capacity * PIECE_VERTICES, gpu::DataType::U32, m_capacity * PIECE_INDICES);
+		}
+		scene->setProceduralGeometryCounts(entity, count * PIECE_VERTICES, count * PIECE_INDICES);
+
+		const u32 pieces = job->to - job->from;
+		const Span<u8> vertices = scene->writeProceduralGeometryVertices(entity, job->from * PIECE_VERTICES, pieces * PIECE_VERTICES);
+		memcpy(vertices.begin(), job->vertices.begin(), vertices.length());
+		const Span<u8> indices = scene->writeProceduralGeometryIndices(entity, job->from * PIECE_INDICES, pieces * PIECE_INDICES);
+		memcpy(indices.begin(), job->indices.begin(), indices.length());
+
+		m_dirty_from = 0xffFFffFF;
+		m_dirty_to = 0;
+		destroyJob(job);
+	}
+
+	void update(float) override {
+		PROFILE_FUNCTION();
+		for (i32 i = m_canceled_jobs.size() - 1; i >= 0; --i) {
+			if (!m_canceled_jobs[i]->finished) continue;
+			destroyJob(m_canceled_jobs[i]);
+			m_canceled_jobs.swapAndPop(i);
+		}
+
+		const EntityPtr entity = getSplineEntity();
+		Universe& universe = *m_app.getWorldEditor().getUniverse();
+		CoreScene* core_scene = (CoreScene*)universe.getScene(SPLINE_TYPE);
+		const bool is_stale = entity.isValid() && m_stale.indexOf(*entity) >= 0;
+		if (entity != m_entity || is_stale) {
+			cancelJob();
+			m_entity = entity;
+			m_capacity = 0;
+			m_dirty_from = 0xffFFffFF;
+			m_dirty_to = 0;
+			m_points.clear();
+			if (!entity.isValid()) return;
+
+			const Spline& spline = core_scene->getSpline(*entity);
+			m_width = spline.mesh_width;
+			// keep the existing mesh until the spline is edited, unless generation was just enabled
+			RenderScene* scene = (RenderScene*)universe.getScene(PROCEDURAL_GEOM_TYPE);
+			if (is_stale) {
+				m_stale.eraseItem(*entity);
+			}
+			else if (scene->getProceduralGeometry(*entity).getVertexCount() > 0) {
+				m_points = spline.points.makeCopy();
+			}
+		}
+		if (!entity.isValid()) return;
+
+		if (m_job && m_job->finished) applyJob(*entity);
+
+		const Spline& spline = core_scene->getSpline(*entity);
+		bool changed = markChangedPoints(spline.points);
+		if (spline.mesh_width != m_width) {
+			m_width = spline.mesh_width;
+			markDirty(0, m_points.size());
+			changed = true;
+		}
+		if (!changed) return;
+
+		cancelJob();
+		startJob(*entity);
+	}
+
+	void onGUI(PropertyGrid& grid, Span<const EntityRef> entities, ComponentType cmp_type, WorldEditor& editor) override {
+		if (cmp_type != SPLINE_TYPE) return;
+		if (entities.length() != 1) return;
+		if (!editor.getUniverse()->hasComponent(entities[0], PROCEDURAL_GEOM_TYPE)) return;
+
+		CoreScene* core_scene = (CoreScene*)editor.getUniverse()->getScene(SPLINE_TYPE);
+		bool generate = core_scene->getSpline(entities[0]).generate_mesh;
+		ImGuiEx::Label("Generate mesh");
+		if (ImGui::Checkbox("##generate_mesh", &generate)) {
+			UniquePtr<SetGenerateMeshCommand> cmd = UniquePtr<SetGenerateMeshCommand>::create(editor.getAllocator(), *this, entities[0], generate);
+			editor.executeCommand(cmd.move());
+		}
+		if (m_job) ImGui::TextUnformatted("Generating mesh...");
+	}
+
+	StudioApp& m_app;
+	gpu::VertexDecl m_vertex_decl;
+	EntityPtr m_entity = INVALID_ENTITY;
+	// control points the current geometry or the running job is made of
+	Array<Vec3> m_points;
+	// pieces which must be regenerated, kept until a job generating them is applied
+	u32 m_dirty_from = 0xffFFffFF;
+	u32 m_dirty_to = 0;
+	// in pieces
+	u32 m_capacity = 0;
+	// width the current geometry or the running job is made with
+	float m_width = 4;
+	Job* m_job = nullptr;
+	// canceled jobs can not be destroyed until they finish
+	Array<Job*> m_canceled_jobs;
+	// entities which must be fully regenerated once selected, their geometry was not generated from the spline
+	Array<EntityRef> m_stale;
+};
+
 struct TerrainPlugin final : PropertyGrid::IPlugin
 {
 	explicit TerrainPlugin(StudioApp& app)
@@ -5030,6 +5794,7 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		, m_terrain_plugin(app)
 		, m_instanced_model_plugin(app)
 		, m_model_plugin(app)
+		, m_spline_mesh_plugin(app)
 		, m_composite_texture_editor(app)
 	{}
 
@@ -5098,12 +5863,14 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_app.addPlugin(m_game_view);
 		m_app.addPlugin(m_editor_ui_render_plugin);
 		m_app.addPlugin(m_procedural_geom_plugin);
+		m_app.addPlugin(m_spline_mesh_plugin);
 
 		PropertyGrid& property_grid = m_app.getPropertyGrid();
 		property_grid.addPlugin(m_model_properties_plugin);
 		property_grid.addPlugin(m_env_probe_plugin);
 		property_grid.addPlugin(m_terrain_plugin);
 		property_grid.addPlugin(m_procedural_geom_plugin);
+		property_grid.addPlugin(m_spline_mesh_plugin);
 		property_grid.addPlugin(m_instanced_model_plugin);
 		property_grid.addPlugin(m_particle_emitter_property_plugin);
 
@@ -5332,12 +6099,14 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_app.removePlugin(m_game_view);
 		m_app.removePlugin(m_editor_ui_render_plugin);
 		m_app.removePlugin(m_procedural_geom_plugin);
+		m_app.removePlugin(m_spline_mesh_plugin);
 
 		PropertyGrid& property_grid = m_app.getPropertyGrid();
 
 		property_grid.removePlugin(m_model_properties_plugin);
 		property_grid.removePlugin(m_env_probe_plugin);
 		property_grid.removePlugin(m_procedural_geom_plugin);
+		property_grid.removePlugin(m_spline_mesh_plugin);
 		property_grid.removePlugin(m_terrain_plugin);
 		property_grid.removePlugin(m_instanced_model_plugin);
 		property_grid.removePlugin(m_particle_emitter_property_plugin);
@@ -5363,6 +6132,7 @@ struct StudioAppPlugin : StudioApp::IPlugin
 	ProceduralGeomPlugin m_procedural_geom_plugin;
 	InstancedModelPlugin m_instanced_model_plugin;
 	ModelPlugin m_model_plugin;
+	SplineMeshPlugin m_spline_mesh_plugin;
 };
 
 LUMIX_STUDIO_ENTRY(renderer)
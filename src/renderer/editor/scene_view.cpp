@@ -807,6 +807,7 @@ void SceneView::renderIcons() {
 				stream.useProgram(program);
 				stream.bindIndexBuffer(mesh.index_buffer_handle);
 				stream.bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+				if (mesh.quantization_buffer) stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 				stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
 				stream.drawIndexed(0, mesh.indices_count, mesh.index_type);
 			}
@@ -837,7 +838,9 @@ void SceneView::renderSelection()
 			if (!model || !model->isReady()) continue;
 
 			const Pose* pose = scene->lockPose(e);
-			for (int i = 0; i <= model->getLODIndices()[0].to; ++i) {
+			// streamed models can miss lod 0
+			const LODMeshIndices& lod = model->getLODIndices()[model->getResidentLOD()];
+			for (int i = lod.from; i <= lod.to; ++i) {
 				const Mesh& mesh = model->getMesh(i);
 					
 				Material* material = mesh.material;
@@ -884,6 +887,7 @@ void SceneView::renderSelection()
 				stream.useProgram(program);
 				stream.bindIndexBuffer(mesh.index_buffer_handle);
 				stream.bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+				if (mesh.quantization_buffer) stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 				stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
 				stream.drawIndexed(0, mesh.indices_count, mesh.index_type);
 			}
@@ -1285,12 +1289,16 @@ void SceneView::searchUI() {
 					ImGui::CloseCurrentPopup();
 				};
 				AssetBrowser& ab = m_app.getAssetBrowser();
+				Array<Path> found(m_app.getAllocator());
+				if (m_search_models) m_app.getAssetCompiler().findResources(m_search_buf, found);
 				const auto& resources = m_app.getAssetCompiler().lockResources();
 				if (m_search_models) {
 					u32 idx = 0;
-					for (const auto& res : resources) {
+					for (const Path& path : found) {
+						auto iter = resources.find(path.getHash());
+						if (!iter.isValid()) continue;
+						const AssetCompiler::ResourceItem& res = iter.value();
 						if (res.type != Model::TYPE) continue;
-						if (stristr(res.path.c_str(), m_search_buf) == 0) continue;
 
 						const bool selected = idx == m_search_selected;
 						if (m_search_preview) {
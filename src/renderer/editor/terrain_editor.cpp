@@ -12,6 +12,7 @@
 #include "engine/engine.h"
 #include "engine/geometry.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/os.h"
@@ -48,6 +49,8 @@ static const char* SPLATMAP_SLOT_NAME = "Splatmap";
 static const char* DETAIL_ALBEDO_SLOT_NAME = "Detail albedo";
 static const char* DETAIL_NORMAL_SLOT_NAME = "Detail normal";
 static const float MIN_BRUSH_SIZE = 0.5f;
+// brush rows are rasterized in chunks of this size on worker threads, small brushes stay on the calling thread
+static const i32 BRUSH_ROWS_PER_JOB = 16;
 
 struct FillClearGrassCommand final : IEditorCommand {
 	FillClearGrassCommand(u32 grass_idx, bool fill, EntityRef terrain, WorldEditor& editor)
@@ -56,6 +59,7 @@ struct FillClearGrassCommand final : IEditorCommand {
 		, m_grass_idx(grass_idx)
 		, m_fill(fill)
 		, m_old_data(editor.getAllocator())
+		, m_undo_payload(m_old_data)
 	{}
 
 	Texture* getDestinationTexture() const
@@ -65,6 +69,7 @@ struct FillClearGrassCommand final : IEditorCommand {
 	}
 
 	bool merge(IEditorCommand& command) override { return false; }
+	void getUndoPayloads(Array<UndoPayload*>& payloads) override { payloads.push(&m_undo_payload); }
 	
 	bool execute() override {
 		Texture* texture = getDestinationTexture();
@@ -93,9 +98,6 @@ struct FillClearGrassCommand final : IEditorCommand {
 		}
 		texture->onDataUpdated(0, 0, texture->width, texture->height);
 
-		RenderScene* scene = (RenderScene*)m_world_editor.getUniverse()->getScene(TERRAIN_TYPE);
-		scene->getTerrain(m_terrain)->setGrassDirty();
-
 		return true;
 	}
 
@@ -112,9 +114,6 @@ struct FillClearGrassCommand final : IEditorCommand {
 
 		memcpy(data, m_old_data.begin(), m_old_data.byte_size());
 		texture->onDataUpdated(0, 0, texture->width, texture->height);
-
-		RenderScene* scene = (RenderScene*)m_world_editor.getUniverse()->getScene(TERRAIN_TYPE);
-		scene->getTerrain(m_terrain)->setGrassDirty();
 	}
 	const char* getType() override { return "fill_clear_grass"; }
 
@@ -124,6 +123,7 @@ struct FillClearGrassCommand final : IEditorCommand {
 	bool m_fill;
 
 	Array<u8> m_old_data;
+	UndoPayload m_undo_payload;
 };
 
 struct PaintTerrainCommand final : IEditorCommand
@@ -156,6 +156,8 @@ struct PaintTerrainCommand final : IEditorCommand
 		, m_can_be_merged(can_be_merged)
 		, m_new_data(editor.getAllocator())
 		, m_old_data(editor.getAllocator())
+		, m_new_payload(m_new_data)
+		, m_old_payload(m_old_data)
 		, m_items(editor.getAllocator())
 		, m_action_type(action_type)
 		, m_textures_mask(textures_mask)
@@ -226,6 +228,11 @@ struct PaintTerrainCommand final : IEditorCommand
 		return false;
 	}
 
+	void getUndoPayloads(Array<UndoPayload*>& payloads) override {
+		payloads.push(&m_new_payload);
+		payloads.push(&m_old_payload);
+	}
+
 private:
 	struct Item
 	{
@@ -281,17 +288,28 @@ private:
 	}
 
 
-	float getAttenuation(Item& item, int i, int j, int texture_size) const
+	float getAttenuation(const Item& item, int i, int j, int texture_size) const
 	{
 		float dist =
 			((texture_size * item.m_local_pos.x - 0.5f - i) * (texture_size * item.m_local_pos.x - 0.5f - i) +
 				 (texture_size * item.m_local_pos.z - 0.5f - j) * (texture_size * item.m_local_pos.z - 0.5f - j));
-		dist = powf(dist, 4);
+		dist = dist * dist;
+		dist = dist * dist;
 		float max_dist = powf(texture_size * item.m_radius, 8);
 		return 1.0f - minimum(dist / max_dist, 1.0f);
 	}
 
 
+	// rows of a brush item touch disjoint parts of the destination, so they can be rasterized in parallel
+	template <typename F>
+	static void forEachRow(const Rectangle& rect, const F& f)
+	{
+		jobs::forEach(rect.to_y - rect.from_y, BRUSH_ROWS_PER_JOB, [&](i32 from, i32 to){
+			for (i32 j = rect.from_y + from; j < rect.from_y + to; ++j) f(j);
+		});
+	}
+
+
 	bool isMasked(float x, float y)
 	{
 		if (m_mask.size() == 0) return true;
@@ -378,12 +396,12 @@ private:
 			return;
 		}
 
-		float fx = 0;
-		float fstepx = 1.0f / (r.to_x - r.from_x);
-		float fstepy = 1.0f / (r.to_y - r.from_y);
-		for (int i = r.from_x, end = r.to_x; i < end; ++i, fx += fstepx) {
-			float fy = 0;
-			for (int j = r.from_y, end2 = r.to_y; j < end2; ++j, fy += fstepy) {
+		const float fstepx = 1.0f / (r.to_x - r.from_x);
+		const float fstepy = 1.0f / (r.to_y - r.from_y);
+		forEachRow(r, [&](int j){
+			const float fy = (j - r.from_y) * fstepy;
+			float fx = 0;
+			for (int i = r.from_x, end = r.to_x; i < end; ++i, fx += fstepx) {
 				if (isMasked(fx, fy)) {
 					int offset = 4 * (i - m_x + (j - m_y) * m_width) + 2;
 					float attenuation = getAttenuation(item, i, j, texture_size);
@@ -399,7 +417,7 @@ private:
 					}
 				}
 			}
-		}
+		});
 	}
 
 
@@ -411,9 +429,8 @@ private:
 		Rectangle rect = item.getBoundingRectangle(texture_size);
 
 		float avg = computeAverage16(texture, rect.from_x, rect.to_x, rect.from_y, rect.to_y);
-		for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
-		{
-			for (int j = rect.from_y, end2 = rect.to_y; j < end2; ++j)
+		forEachRow(rect, [&](int j){
+			for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
 			{
 				float attenuation = getAttenuation(item, i, j, texture_size);
 				int offset = i - m_x + (j - m_y) * m_width;
@@ -421,7 +438,7 @@ private:
 				x += u16((avg - x) * item.m_amount * attenuation);
 				((u16*)&data[0])[offset] = x;
 			}
-		}
+		});
 	}
 
 
@@ -432,9 +449,8 @@ private:
 		int texture_size = texture->width;
 		Rectangle rect = item.getBoundingRectangle(texture_size);
 
-		for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
-		{
-			for (int j = rect.from_y, end2 = rect.to_y; j < end2; ++j)
+		forEachRow(rect, [&](int j){
+			for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
 			{
 				int offset = i - m_x + (j - m_y) * m_width;
 				float dist = sqrtf(
@@ -446,7 +462,7 @@ private:
 				u16 old_value = ((u16*)&data[0])[offset];
 				((u16*)&data[0])[offset] = (u16)(m_flat_height * t + old_value * (1-t));
 			}
-		}
+		});
 	}
 
 
@@ -481,9 +497,8 @@ private:
 		const float STRENGTH_MULTIPLICATOR = 256.0f;
 		float amount = maximum(item.m_amount * item.m_amount * STRENGTH_MULTIPLICATOR, 1.0f);
 
-		for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
-		{
-			for (int j = rect.from_y, end2 = rect.to_y; j < end2; ++j)
+		forEachRow(rect, [&](int j){
+			for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
 			{
 				float attenuation = getAttenuation(item, i, j, texture_size);
 				int offset = i - m_x + (j - m_y) * m_width;
@@ -494,7 +509,7 @@ private:
 														   : maximum(-add, -x);
 				((u16*)&data[0])[offset] = x;
 			}
-		}
+		});
 	}
 
 
@@ -528,18 +543,13 @@ private:
 		m_width = rect.to_x - rect.from_x;
 		m_height = rect.to_y - rect.from_y;
 		m_old_data.resize(bpp * (rect.to_x - rect.from_x) * (rect.to_y - rect.from_y));
+		if (m_old_data.empty()) return;
 
-		int index = 0;
 		for (int j = rect.from_y, end2 = rect.to_y; j < end2; ++j)
 		{
-			for (int i = rect.from_x, end = rect.to_x; i < end; ++i)
-			{
-				for (u32 k = 0; k < bpp; ++k)
-				{
-					m_old_data[index] = texture->getData()[(i + j * texture->width) * bpp + k];
-					++index;
-				}
-			}
+			memcpy(&m_old_data[(j - rect.from_y) * m_width * bpp],
+				&texture->getData()[(rect.from_x + j * texture->width) * bpp],
+				m_width * bpp);
 		}
 	}
 
@@ -548,17 +558,13 @@ private:
 	{
 		auto texture = getDestinationTexture();
 		const u32 bpp = gpu::getBytesPerPixel(texture->format);
+		if (m_width <= 0 || m_height <= 0) return;
 
 		for (int j = m_y; j < m_y + m_height; ++j)
 		{
-			for (int i = m_x; i < m_x + m_width; ++i)
-			{
-				int index = bpp * (i + j * texture->width);
-				for (u32 k = 0; k < bpp; ++k)
-				{
-					texture->getData()[index + k] = data[bpp * (i - m_x + (j - m_y) * m_width) + k];
-				}
-			}
+			memcpy(&texture->getData()[bpp * (m_x + j * texture->width)],
+				&data[bpp * (j - m_y) * m_width],
+				bpp * m_width);
 		}
 		texture->onDataUpdated(m_x, m_y, m_width, m_height);
 
@@ -572,10 +578,6 @@ private:
 
 			phy_scene->updateHeighfieldData(m_terrain, m_x, m_y, m_width, m_height, &data[0], bpp);
 		}
-		else {
-			RenderScene* scene = (RenderScene*)m_world_editor.getUniverse()->getScene(TERRAIN_TYPE);
-			return scene->getTerrain(m_terrain)->setGrassDirty();
-		}
 	}
 
 
@@ -651,6 +653,8 @@ private:
 	WorldEditor& m_world_editor;
 	Array<u8> m_new_data;
 	Array<u8> m_old_data;
+	UndoPayload m_new_payload;
+	UndoPayload m_old_payload;
 	u64 m_textures_mask;
 	u16 m_grass_mask;
 	int m_width;
@@ -949,7 +953,6 @@ struct TerrainTextureChangeCommand : IEditorCommand {
 
 		memcpy(data, blob.data(), blob.size());
 		texture->onDataUpdated(0, 0, texture->width, texture->height);
-		terrain->setGrassDirty();
 		return true;
 	}
 
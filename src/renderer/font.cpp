@@ -22,6 +22,7 @@ struct Font {
 	FontResource* resource;
 	HashMap<u32, Glyph> glyphs;
 	u32 font_size = 0;
+	u32 id = 0;
 	float descender = 0;
 	float ascender = 0;
 	u32 ref = 0;
@@ -30,6 +31,7 @@ struct Font {
 float getAdvanceY(const Font& font) { return float(font.font_size); }
 float getDescender(const Font& font) { return font.descender; }
 float getAscender(const Font& font) { return font.ascender; }
+u32 getFontID(const Font& font) { return font.id; }
 
 const Glyph* findGlyph(const Font& font, u32 codepoint) {
 	auto iter = font.glyphs.find(codepoint);
@@ -222,6 +224,7 @@ bool FontManager::build()
 		m_atlas_texture = LUMIX_NEW(m_allocator, Texture)(Path("draw2d_atlas"), texture_manager, m_renderer, m_allocator);
 	}
 	m_atlas_texture->create(w, h, gpu::TextureFormat::RGBA8, pixels.begin(), pixels.byte_size());
+	++m_atlas_version;
 
 	FT_Done_Library(ft_library);
 	return true;
@@ -261,6 +264,7 @@ Font* FontResource::addRef(int font_size)
 	font->ref = 1;
 	font->resource = this;
 	font->font_size = font_size;
+	font->id = manager.m_next_font_id++;
 	for(u32 cp = 0x20; cp < 0xff; ++cp) {
 		Glyph c;
 		c.codepoint = cp;
@@ -30,6 +30,8 @@ LUMIX_RENDERER_API const Glyph* findGlyph(const Font& font, u32 codepoint);
 LUMIX_RENDERER_API float getAdvanceY(const Font& font);
 LUMIX_RENDERER_API float getDescender(const Font& font);
 LUMIX_RENDERER_API float getAscender(const Font& font);
+// unique for every font created by FontManager, never reused
+LUMIX_RENDERER_API u32 getFontID(const Font& font);
 
 
 struct LUMIX_RENDERER_API FontResource final : Resource
@@ -56,6 +58,8 @@ public:
 	~FontManager();
 
 	Texture* getAtlasTexture();
+	// changes every time the atlas is rebuilt, i.e. glyphs' uvs are invalidated
+	u32 getAtlasVersion() const { return m_atlas_version; }
 
 private:
 	Resource* createResource(const Path& path) override;
@@ -67,6 +71,8 @@ private:
 	Renderer& m_renderer;
 	Texture* m_atlas_texture;
 	Array<Font*> m_fonts;
+	u32 m_next_font_id = 0;
+	u32 m_atlas_version = 0;
 	bool m_dirty = true;
 };
 
@@ -61,6 +61,7 @@ GPU_GL_IMPORT(PFNGLDELETEQUERIESPROC, glDeleteQueries);
 GPU_GL_IMPORT(PFNGLDELETESHADERPROC, glDeleteShader);
 GPU_GL_IMPORT(PFNGLDELETESYNCPROC, glDeleteSync);
 GPU_GL_IMPORT(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays);
+GPU_GL_IMPORT(PFNGLDETACHSHADERPROC, glDetachShader);
 GPU_GL_IMPORT(PFNGLDISABLEVERTEXATTRIBARRAYPROC, glDisableVertexAttribArray);
 GPU_GL_IMPORT(PFNGLDISPATCHCOMPUTEPROC, glDispatchCompute);
 GPU_GL_IMPORT(PFNGLDRAWARRAYSINSTANCEDARBPROC, glDrawArraysInstanced);
@@ -81,6 +82,7 @@ GPU_GL_IMPORT(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays);
 GPU_GL_IMPORT(PFNGLGETACTIVEUNIFORMPROC, glGetActiveUniform);
 GPU_GL_IMPORT(PFNGLGETDEBUGMESSAGELOGPROC, glGetDebugMessageLog);
 GPU_GL_IMPORT(PFNGLGETFRAMEBUFFERATTACHMENTPARAMETERIVPROC, glGetFramebufferAttachmentParameteriv);
+GPU_GL_IMPORT(PFNGLGETPROGRAMBINARYPROC, glGetProgramBinary);
 GPU_GL_IMPORT(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog);
 GPU_GL_IMPORT(PFNGLGETPROGRAMIVPROC, glGetProgramiv);
 GPU_GL_IMPORT(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v);
@@ -103,6 +105,8 @@ GPU_GL_IMPORT(PFNGLNAMEDFRAMEBUFFERTEXTURELAYERPROC, glNamedFramebufferTextureLa
 GPU_GL_IMPORT(PFNGLNAMEDFRAMEBUFFERTEXTUREPROC, glNamedFramebufferTexture);
 GPU_GL_IMPORT(PFNGLOBJECTLABELPROC, glObjectLabel);
 GPU_GL_IMPORT(PFNGLPOPDEBUGGROUPPROC, glPopDebugGroup);
+GPU_GL_IMPORT(PFNGLPROGRAMBINARYPROC, glProgramBinary);
+GPU_GL_IMPORT(PFNGLPROGRAMPARAMETERIPROC, glProgramParameteri);
 GPU_GL_IMPORT(PFNGLPUSHDEBUGGROUPPROC, glPushDebugGroup);
 GPU_GL_IMPORT(PFNGLQUERYCOUNTERPROC, glQueryCounter);
 GPU_GL_IMPORT(PFNGLSHADERSOURCEPROC, glShaderSource);
@@ -62,6 +62,7 @@ int getSize(AttributeType type)
 		case AttributeType::I8: return 1;
 		case AttributeType::U8: return 1;
 		case AttributeType::I16: return 2;
+		case AttributeType::HALF: return 2;
 	}
 	ASSERT(false);
 	return 0;
@@ -7,6 +7,7 @@
 namespace Lumix {
 
 struct IAllocator;
+struct OutputMemoryStream;
 struct PageAllocator;
 
 namespace gpu {
@@ -56,7 +57,9 @@ enum class QueryType : u32 {
 
 enum class MemoryBarrierType : u32 {
 	SSBO = 1 << 0,
-	COMMAND = 1 << 1
+	COMMAND = 1 << 1,
+	IMAGE = 1 << 2,
+	VERTEX = 1 << 3
 };
 
 enum class PrimitiveType : u8 {
@@ -126,7 +129,8 @@ enum class AttributeType : u8 {
 	U8,
 	FLOAT,
 	I16,
-	I8
+	I8,
+	HALF
 };
 
 
@@ -152,7 +156,8 @@ enum class TextureFormat : u32 {
 	BC3,
 	BC4,
 	BC5,
-	R11G11B10F
+	R11G11B10F,
+	BC7
 };
 
 enum class BindShaderBufferFlags : u32 {
@@ -182,6 +187,8 @@ enum class BufferFlags : u32 {
 	UNIFORM_BUFFER = 1 << 1,
 	SHADER_BUFFER = 1 << 2,
 	COMPUTE_WRITE = 1 << 3,
+	// persistently mapped, map returns the same pointer until destroy and unmap does nothing
+	// writes are visible to the GPU without unmapping, the user must not overwrite data the GPU still reads
 	MAPPABLE = 1 << 4,
 };
 
@@ -195,7 +202,9 @@ struct Attribute {
 	enum Flags {
 		NORMALIZED = 1 << 0,
 		AS_INT = 1 << 1,
-		INSTANCED = 1 << 2
+		INSTANCED = 1 << 2,
+		// shaders get _QUANTIZED_ATTRn define and decode the value themselves
+		QUANTIZED = 1 << 3
 	};
 	u8 idx;
 	u8 components_count;
@@ -238,6 +247,11 @@ struct MemoryStats {
 	u64 render_target_mem;
 	u64 buffer_mem;
 	u64 texture_mem;
+	// MAPPABLE buffers, included in buffer_mem
+	u64 transient_mem;
+	u32 render_target_count;
+	u32 buffer_count;
+	u32 texture_count;
 };
 
 struct BindGroupEntryDesc {
@@ -259,17 +273,29 @@ void preinit(IAllocator& allocator, bool load_renderdoc);
 IAllocator& getAllocator();
 bool init(void* window_handle, InitFlags flags);
 void captureRenderDocFrame();
+// memory allocated through gpu is always filled, returns false if the driver does not report available memory
 bool getMemoryStats(MemoryStats& stats);
+// linked programs are cached by hash of their sources and defines, cache from a different driver is ignored
+// both are thread safe
+void loadProgramCache(Span<const u8> data);
+// returns false if no program was added since loadProgramCache
+bool saveProgramCache(OutputMemoryStream& blob);
 u32 swapBuffers();
 void waitFrame(u32 frame);
 bool frameFinished(u32 frame);
 LUMIX_RENDERER_API bool isOriginBottomLeft();
+// GL_ARB_bindless_texture, shaders can sample any texture through LUMIX_BINDLESS table
+bool isBindlessSupported();
+// index of texture in the bindless table, valid from allocTextureHandle until destroy, thread safe
+u32 getBindlessIndex(TextureHandle texture);
 void checkThread();
 void shutdown();
 int getSize(AttributeType type);
 u32 getSize(TextureFormat format, u32 w, u32 h);
 u32 getBytesPerPixel(TextureFormat format);
 
+// handles can be allocated on any thread, DrawStream records them before the objects exist
+// functions below create and use the objects, they are called only on the render thread by DrawStream::run
 TextureHandle allocTextureHandle();
 BufferHandle allocBufferHandle();
 ProgramHandle allocProgramHandle();
@@ -313,7 +339,7 @@ void bindShaderBuffer(BufferHandle buffer, u32 binding_idx, BindShaderBufferFlag
 void bindImageTexture(TextureHandle texture, u32 unit);
 
 void drawArrays(u32 offset, u32 count);
-void drawIndirect(DataType index_type, u32 indirect_buffer_offset);
+void drawIndirect(DataType index_type, u32 indirect_buffer_offset, u32 draw_count);
 void drawIndexed(u32 offset, u32 count, DataType type);
 void drawArraysInstanced(u32 indices_count, u32 instances_count);
 void drawIndexedInstanced(u32 indices_count, u32 instances_count, DataType index_type);
@@ -322,6 +348,8 @@ void dispatch(u32 num_groups_x, u32 num_groups_y, u32 num_groups_z);
 void memoryBarrier(MemoryBarrierType type, BufferHandle);
 	
 void copy(TextureHandle dst, TextureHandle src, u32 dst_x, u32 dst_y);
+// exchanges underlying textures, bind groups referencing the handles see the change
+void swap(TextureHandle a, TextureHandle b);
 void copy(BufferHandle dst, BufferHandle src, u32 dst_offset, u32 src_offset, u32 size);
 	
 void readTexture(TextureHandle texture, u32 mip, Span<u8> buf);
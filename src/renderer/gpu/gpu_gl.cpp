@@ -42,6 +42,18 @@ namespace gpu {
 #undef GPU_GL_IMPORT_TYPEDEFS
 #undef GPU_GL_IMPORT
 
+// GL_ARB_bindless_texture is optional, loaded in init only if it's supported
+static PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB;
+static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB;
+static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB;
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile are optional as well
+static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+
+static constexpr u32 MAX_BINDLESS_TEXTURES = 64 * 1024;
+// must match binding of LumixBindlessTable in createProgram
+static constexpr u32 BINDLESS_TABLE_BINDING = 15;
+static constexpr u32 INVALID_BINDLESS_INDEX = 0xffFFffFF;
+
 struct Buffer {
 	~Buffer() {
 		if (gl_handle) glDeleteBuffers(1, &gl_handle);
@@ -50,6 +62,8 @@ struct Buffer {
 	GLuint gl_handle;
 	BufferFlags flags;
 	u64 size;
+	// MAPPABLE buffers stay mapped for their whole life
+	void* mapped = nullptr;
 };
 
 struct BindGroup {
@@ -82,14 +96,19 @@ struct Texture {
 	u32 depth;
 	u32 bytes_size;
 	TextureFlags flags;
+	u32 bindless_idx = INVALID_BINDLESS_INDEX;
+	GLuint64 bindless_handle = 0;
 	#ifdef LUMIX_DEBUG
 		StaticString<64> name;
 	#endif
 };
 
 struct Program {
+	static constexpr u32 MAX_SHADERS = 16;
+
 	Program() : decl(PrimitiveType::NONE) {}
 	~Program() {
+		for (u32 i = 0; i < pending_shaders_count; ++i) glDeleteShader(pending_shaders[i]);
 		if(gl_handle) glDeleteProgram(gl_handle);
 	}
 
@@ -100,6 +119,14 @@ struct Program {
 	#ifdef LUMIX_DEBUG
 		StaticString<64> name;
 	#endif
+
+	// driver compiles and links the program in background, draws using the program are skipped until it's done
+	bool pending = false;
+	GLuint pending_shaders[MAX_SHADERS];
+	ShaderType pending_types[MAX_SHADERS];
+	u32 pending_shaders_count = 0;
+	StableHash cache_key;
+	StaticString<128> pending_name;
 };
 
 struct WindowContext {
@@ -112,8 +139,31 @@ struct WindowContext {
 	#endif
 };
 
+struct CachedProgram {
+	GLenum format;
+	u32 offset;
+	u32 size;
+};
+
+#pragma pack(1)
+struct ProgramCacheHeader {
+	static constexpr u32 MAGIC = 'LPGC';
+	static constexpr u32 VERSION = 0;
+	u32 magic = MAGIC;
+	u32 version = VERSION;
+	// vendor, renderer and version of the driver which created the binaries
+	StableHash driver;
+	u32 count = 0;
+};
+#pragma pack()
+
 struct GL {
-	GL(IAllocator& allocator) : allocator(allocator) {}
+	GL(IAllocator& allocator)
+		: allocator(allocator)
+		, program_cache(allocator)
+		, program_cache_data(allocator)
+		, bindless_free(allocator)
+	{}
 
 	IAllocator& allocator;
 	u32 frame = 0;
@@ -122,6 +172,8 @@ struct GL {
 	Lumix::os::ThreadID thread;
 	int max_vertex_attributes = 16;
 	ProgramHandle last_program = INVALID_PROGRAM;
+	// last used program is still being compiled
+	bool skip_draws = false;
 	StateFlags last_state = StateFlags::NONE;
 	GLuint framebuffer = 0;
 	GLuint helper_indirect_buffer = 0;
@@ -130,7 +182,23 @@ struct GL {
 	u64 buffer_allocated_mem = 0;
 	u64 texture_allocated_mem = 0;
 	u64 render_target_allocated_mem = 0;
+	u64 transient_allocated_mem = 0;
+	u32 buffer_count = 0;
+	u32 texture_count = 0;
+	u32 render_target_count = 0;
 	float max_anisotropy = 0;
+	StableHash driver;
+	Mutex program_cache_mutex;
+	HashMap<StableHash, CachedProgram> program_cache;
+	OutputMemoryStream program_cache_data;
+	bool program_cache_dirty = false;
+	bool has_bindless = false;
+	bool has_parallel_compile = false;
+	// u64 handles indexed by Texture::bindless_idx
+	GLuint bindless_table = 0;
+	Mutex bindless_mutex;
+	Array<u32> bindless_free;
+	u32 bindless_count = 0;
 };
 
 Local<GL> gl;
@@ -151,6 +219,7 @@ struct FormatDesc {
 			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : return get(TextureFormat::BC3);
 			case GL_COMPRESSED_RED_RGTC1 : return get(TextureFormat::BC4);
 			case GL_COMPRESSED_RG_RGTC2 : return get(TextureFormat::BC5);
+			case GL_COMPRESSED_RGBA_BPTC_UNORM : return get(TextureFormat::BC7);
 			case GL_R16 : return get(TextureFormat::R16);
 			case GL_R8 : return get(TextureFormat::R8);
 			case GL_RG8 : return get(TextureFormat::RG8);
@@ -174,6 +243,7 @@ struct FormatDesc {
 			case TextureFormat::BC3: return {			true,		false,	16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,	GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT};
 			case TextureFormat::BC4: return {			true,		false,	8,	GL_COMPRESSED_RED_RGTC1,			GL_ZERO};
 			case TextureFormat::BC5: return {			true,		false,	16, GL_COMPRESSED_RG_RGTC2,				GL_ZERO};
+			case TextureFormat::BC7: return {			true,		false,	16, GL_COMPRESSED_RGBA_BPTC_UNORM,		GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM};
 			case TextureFormat::R16: return {			false,		false,	2,	GL_R16,								GL_ZERO, GL_RED, GL_UNSIGNED_SHORT};
 			case TextureFormat::R8: return {			false,		false,	1,	GL_R8,								GL_ZERO, GL_RED, GL_UNSIGNED_BYTE};
 			case TextureFormat::RG8: return {			false,		false,	2,	GL_RG8,								GL_ZERO, GL_RG, GL_UNSIGNED_BYTE};
@@ -237,6 +307,9 @@ static void logVersion() {
 		logInfo("OpenGL version: ", version);
 		logInfo("OpenGL vendor: ", vendor);
 		logInfo("OpenGL renderer: ", renderer);
+		// program binaries are valid only for the driver which created them
+		const StaticString<1024> driver(vendor, "|", renderer, "|", version);
+		gl->driver = StableHash(driver.data);
 	}
 }
 
@@ -487,6 +560,7 @@ static void setVAO(const VertexDecl& decl) {
 			case AttributeType::FLOAT: gl_attr_type = GL_FLOAT; break;
 			case AttributeType::I8: gl_attr_type = GL_BYTE; break;
 			case AttributeType::U8: gl_attr_type = GL_UNSIGNED_BYTE; break;
+			case AttributeType::HALF: gl_attr_type = GL_HALF_FLOAT; break;
 		}
 
 		const bool instanced = attr.flags & Attribute::INSTANCED;
@@ -513,6 +587,7 @@ static void setVAO(const VertexDecl& decl) {
 void dispatch(u32 num_groups_x, u32 num_groups_y, u32 num_groups_z)
 {
 	GPU_PROFILE();
+	if (gl->skip_draws) return;
 	glDispatchCompute(num_groups_x, num_groups_y, num_groups_z);
 }
 
@@ -625,9 +700,17 @@ static void setState(StateFlags state)
 }
 
 
+static bool finishPendingProgram(Program& program);
+
 void useProgram(ProgramHandle program)
 {
 	GPU_PROFILE();
+	if (program && program->pending && !finishPendingProgram(*program)) {
+		gl->skip_draws = true;
+		return;
+	}
+	gl->skip_draws = false;
+
 	const Program* prev = gl->last_program;
 	if (prev != program) {
 		gl->last_program = program;
@@ -716,20 +799,23 @@ void drawIndexed(u32 offset, u32 count, DataType type)
 		default: ASSERT(0); break;
 	}
 
+	if (gl->skip_draws) return;
 	glDrawElements(gl->last_program->primitive_type, count, t, (void*)(intptr_t)offset);
 }
 
-void drawIndirect(DataType index_type, u32 indirect_buffer_offset)
+void drawIndirect(DataType index_type, u32 indirect_buffer_offset, u32 draw_count)
 {
 	GPU_PROFILE();
+	if (gl->skip_draws) return;
 	const GLenum type = index_type == DataType::U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
-	glMultiDrawElementsIndirect(gl->last_program->primitive_type, type, (const void*)(uintptr)indirect_buffer_offset, 1, 0);
+	glMultiDrawElementsIndirect(gl->last_program->primitive_type, type, (const void*)(uintptr)indirect_buffer_offset, draw_count, 0);
 }
 
 void drawIndexedInstanced(u32 indices_count, u32 instances_count, DataType index_type)
 {
 	GPU_PROFILE();
 	checkThread();
+	if (gl->skip_draws) return;
 
 	const GLenum type = index_type == DataType::U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 	if (instances_count * indices_count > 4096) {
@@ -759,6 +845,7 @@ void drawIndexedInstanced(u32 indices_count, u32 instances_count, DataType index
 void drawArraysInstanced(u32 indices_count, u32 instances_count)
 {
 	GPU_PROFILE();
+	if (gl->skip_draws) return;
 	glDrawArraysInstanced(gl->last_program->primitive_type, 0, indices_count, instances_count);
 }
 
@@ -767,6 +854,7 @@ void drawArrays(u32 offset, u32 count)
 {
 	GPU_PROFILE();
 	checkThread();
+	if (gl->skip_draws) return;
 	glDrawArrays(gl->last_program->primitive_type, offset, count);
 }
 
@@ -782,6 +870,7 @@ void* map(BufferHandle buffer, size_t size)
 	checkThread();
 	ASSERT(buffer);
 	ASSERT(u32(buffer->flags & BufferFlags::IMMUTABLE) == 0);
+	if (buffer->mapped) return buffer->mapped;
 	const GLbitfield gl_flags = GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_WRITE_BIT;
 	return glMapNamedBufferRange(buffer->gl_handle, 0, size, gl_flags);
 }
@@ -792,6 +881,7 @@ void unmap(BufferHandle buffer)
 	GPU_PROFILE();
 	checkThread();
 	ASSERT(buffer);
+	if (buffer->mapped) return;
 	glUnmapNamedBuffer(buffer->gl_handle);
 }
 
@@ -989,12 +1079,17 @@ void createBuffer(BufferHandle buffer, BufferFlags flags, size_t size, const voi
 	
 	GLbitfield gl_flags = 0;
 	if (u64(flags & BufferFlags::IMMUTABLE) == 0) gl_flags |= GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT | GL_MAP_READ_BIT;
+	const bool persistent = u64(flags & BufferFlags::MAPPABLE);
+	if (persistent) gl_flags |= GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 	glNamedBufferStorage(buf, size, data, gl_flags);
 
+	buffer->mapped = persistent ? glMapNamedBufferRange(buf, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT) : nullptr;
 	buffer->gl_handle = buf;
 	buffer->flags = flags;
 	buffer->size = size;
 	gl->buffer_allocated_mem += size;
+	if (persistent) gl->transient_allocated_mem += size;
+	++gl->buffer_count;
 }
 
 void destroy(ProgramHandle program)
@@ -1085,9 +1180,45 @@ BindGroupHandle allocBindGroupHandle() {
 TextureHandle allocTextureHandle() {
 	Texture* t = LUMIX_NEW(gl->allocator, Texture);
 	t->gl_handle = 0;
+	if (gl->has_bindless) {
+		MutexGuard lock(gl->bindless_mutex);
+		if (!gl->bindless_free.empty()) {
+			t->bindless_idx = gl->bindless_free.back();
+			gl->bindless_free.pop();
+		}
+		else if (gl->bindless_count < MAX_BINDLESS_TEXTURES) {
+			t->bindless_idx = gl->bindless_count;
+			++gl->bindless_count;
+		}
+		else {
+			logError("Too many bindless textures");
+		}
+	}
 	return t;
 }
 
+bool isBindlessSupported() { return gl->has_bindless; }
+
+u32 getBindlessIndex(TextureHandle texture) {
+	ASSERT(texture);
+	return texture->bindless_idx == INVALID_BINDLESS_INDEX ? 0 : texture->bindless_idx;
+}
+
+static void releaseBindless(Texture& texture) {
+	if (!texture.bindless_handle) return;
+	glMakeTextureHandleNonResidentARB(texture.bindless_handle);
+	texture.bindless_handle = 0;
+}
+
+// must be called after texture's sampler is set, texture can not be changed while resident
+static void makeBindless(Texture& texture) {
+	if (texture.bindless_idx == INVALID_BINDLESS_INDEX) return;
+	releaseBindless(texture);
+	texture.bindless_handle = glGetTextureHandleARB(texture.gl_handle);
+	glMakeTextureHandleResidentARB(texture.bindless_handle);
+	glNamedBufferSubData(gl->bindless_table, texture.bindless_idx * sizeof(GLuint64), sizeof(GLuint64), &texture.bindless_handle);
+}
+
 void createBindGroup(BindGroupHandle group, Span<const BindGroupEntryDesc> descriptors) {
 	for (const BindGroupEntryDesc& desc : descriptors) {
 		switch(desc.type) {
@@ -1128,6 +1259,7 @@ void createTextureView(TextureHandle view, TextureHandle texture, u32 layer)
 	ASSERT(view);
 
 	if (view->gl_handle != 0) {
+		releaseBindless(*view);
 		glDeleteTextures(1, &view->gl_handle);
 	}
 
@@ -1140,6 +1272,7 @@ void createTextureView(TextureHandle view, TextureHandle texture, u32 layer)
 
 	view->width = texture->width;
 	view->height = texture->height;
+	makeBindless(*view);
 }
 
 void createTexture(TextureHandle handle, u32 w, u32 h, u32 depth, TextureFormat format, TextureFlags flags, const char* debug_name)
@@ -1204,10 +1337,13 @@ void createTexture(TextureHandle handle, u32 w, u32 h, u32 depth, TextureFormat
 	}
 	if (u32(flags & TextureFlags::RENDER_TARGET)) {
 		gl->render_target_allocated_mem += handle->bytes_size;
+		++gl->render_target_count;
 	}
 	else {
 		gl->texture_allocated_mem += handle->bytes_size;
+		++gl->texture_count;
 	}
+	makeBindless(*handle);
 }
 
 void generateMipmaps(TextureHandle texture)
@@ -1227,9 +1363,16 @@ void destroy(TextureHandle texture)
 	checkThread();
 	if (u32(texture->flags & TextureFlags::RENDER_TARGET)) {
 		gl->render_target_allocated_mem -= texture->bytes_size;
+		--gl->render_target_count;
 	}
 	else {
 		gl->texture_allocated_mem -= texture->bytes_size;
+		--gl->texture_count;
+	}
+	releaseBindless(*texture);
+	if (texture->bindless_idx != INVALID_BINDLESS_INDEX) {
+		MutexGuard lock(gl->bindless_mutex);
+		gl->bindless_free.push(texture->bindless_idx);
 	}
 	LUMIX_DELETE(gl->allocator, texture);
 }
@@ -1237,6 +1380,8 @@ void destroy(TextureHandle texture)
 void destroy(BufferHandle buffer) {
 	checkThread();
 	gl->buffer_allocated_mem -= buffer->size;
+	if (u64(buffer->flags & BufferFlags::MAPPABLE)) gl->transient_allocated_mem -= buffer->size;
+	--gl->buffer_count;
 	LUMIX_DELETE(gl->allocator, buffer);
 }
 
@@ -1245,6 +1390,7 @@ void clear(ClearFlags flags, const float* color, float depth)
 	GPU_PROFILE();
 	glUseProgram(0);
 	gl->last_program = INVALID_PROGRAM;
+	gl->skip_draws = false;
 	glDisable(GL_SCISSOR_TEST);
 	glDisable(GL_BLEND);
 	gl->last_state = gl->last_state & ~StateFlags(0xffFF << 6);
@@ -1279,10 +1425,39 @@ static const char* shaderTypeToString(ShaderType type)
 }
 
 
-void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl, const char** srcs, const ShaderType* types, u32 num, const char** prefixes, u32 prefixes_count, const char* name)
+static void logShaderError(GLuint shd, ShaderType type, const char* name) {
+	GLint log_len = 0;
+	glGetShaderiv(shd, GL_INFO_LOG_LENGTH, &log_len);
+	if (log_len > 0) {
+		Array<char> log_buf(gl->allocator);
+		log_buf.resize(log_len);
+		glGetShaderInfoLog(shd, log_len, &log_len, &log_buf[0]);
+		logError(name, " - ", shaderTypeToString(type), ": ", &log_buf[0]);
+	}
+	else {
+		logError("Failed to compile shader ", name, " - ", shaderTypeToString(type));
+	}
+}
+
+static void logLinkError(GLuint prg, const char* name) {
+	GLint log_len = 0;
+	glGetProgramiv(prg, GL_INFO_LOG_LENGTH, &log_len);
+	if (log_len > 0) {
+		Array<char> log_buf(gl->allocator);
+		log_buf.resize(log_len);
+		glGetProgramInfoLog(prg, log_len, &log_len, &log_buf[0]);
+		logError(name, ": ", &log_buf[0]);
+	}
+	else {
+		logError("Failed to link program ", name);
+	}
+}
+
+// if `pending` is not null, shaders are compiled and linked without waiting for the driver,
+// they are stored in `pending` and the result is checked later in finishPendingProgram
+static bool compileProgram(GLuint prg, const VertexDecl& decl, const char** srcs, const ShaderType* types, u32 num, const char** prefixes, u32 prefixes_count, const char* name, Program* pending)
 {
-	GPU_PROFILE();
-	checkThread();
+	PROFILE_FUNCTION();
 
 	static const char* attr_defines[] = {
 		"#define _HAS_ATTR0\n",
@@ -1300,20 +1475,24 @@ void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl,
 		"#define _HAS_ATTR12\n"
 	};
 
-	const char* combined_srcs[32];
-	ASSERT(prefixes_count < lengthOf(combined_srcs) - 1); 
-	enum { MAX_SHADERS_PER_PROGRAM = 16 };
-
-	if (num > MAX_SHADERS_PER_PROGRAM) {
-		logError("Too many shaders per program in ", name);
-		return;
-	}
-
-	const GLuint prg = glCreateProgram();
-	if (name && name[0]) {
-		glObjectLabel(GL_PROGRAM, prg, stringLength(name), name);
-	}
+	static const char* quantized_attr_defines[] = {
+		"#define _QUANTIZED_ATTR0\n",
+		"#define _QUANTIZED_ATTR1\n",
+		"#define _QUANTIZED_ATTR2\n",
+		"#define _QUANTIZED_ATTR3\n",
+		"#define _QUANTIZED_ATTR4\n",
+		"#define _QUANTIZED_ATTR5\n",
+		"#define _QUANTIZED_ATTR6\n",
+		"#define _QUANTIZED_ATTR7\n",
+		"#define _QUANTIZED_ATTR8\n",
+		"#define _QUANTIZED_ATTR9\n",
+		"#define _QUANTIZED_ATTR10\n",
+		"#define _QUANTIZED_ATTR11\n",
+		"#define _QUANTIZED_ATTR12\n"
+	};
 
+	const char* combined_srcs[48];
+	ASSERT(prefixes_count < lengthOf(combined_srcs) - 2); 
 	for (u32 i = 0; i < num; ++i) {
 		GLenum shader_type;
 		u32 src_idx = 0;
@@ -1326,6 +1505,16 @@ void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl,
 			#define _ORIGIN_BOTTOM_LEFT
 		)#";
 		++src_idx;
+		if (gl->has_bindless) {
+			combined_srcs[src_idx] = R"#(
+				#extension GL_ARB_bindless_texture : require
+				#define LUMIX_BINDLESS
+				layout(std430, binding = 15) readonly buffer LumixBindlessTable {
+					uvec2 lumix_bindless_textures[];
+				};
+			)#";
+			++src_idx;
+		}
 		switch (types[i]) {
 			case ShaderType::GEOMETRY: {
 				combined_srcs[src_idx] = "#define LUMIX_GEOMETRY_SHADER\n"; 
@@ -1352,6 +1541,10 @@ void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl,
 		for (u32 j = 0; j < decl.attributes_count; ++j) {
 			combined_srcs[src_idx] = attr_defines[decl.attributes[j].idx];
 			++src_idx;
+			if (decl.attributes[j].flags & Attribute::QUANTIZED) {
+				combined_srcs[src_idx] = quantized_attr_defines[decl.attributes[j].idx];
+				++src_idx;
+			}
 		}
 		const GLuint shd = glCreateShader(shader_type);
 		for (u32 j = 0; j < prefixes_count; ++j) {
@@ -1364,22 +1557,20 @@ void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl,
 		glShaderSource(shd, src_idx, combined_srcs, 0);
 		glCompileShader(shd);
 
+		if (pending) {
+			glAttachShader(prg, shd);
+			pending->pending_shaders[pending->pending_shaders_count] = shd;
+			pending->pending_types[pending->pending_shaders_count] = types[i];
+			++pending->pending_shaders_count;
+			continue;
+		}
+
 		GLint compile_status;
 		glGetShaderiv(shd, GL_COMPILE_STATUS, &compile_status);
 		if (compile_status == GL_FALSE) {
-			GLint log_len = 0;
-			glGetShaderiv(shd, GL_INFO_LOG_LENGTH, &log_len);
-			if (log_len > 0) {
-				Array<char> log_buf(gl->allocator);
-				log_buf.resize(log_len);
-				glGetShaderInfoLog(shd, log_len, &log_len, &log_buf[0]);
-				logError(name, " - ", shaderTypeToString(types[i]), ": ", &log_buf[0]);
-			}
-			else {
-				logError("Failed to compile shader ", name, " - ", shaderTypeToString(types[i]));
-			}
+			logShaderError(shd, types[i], name);
 			glDeleteShader(shd);
-			return;
+			return false;
 		}
 
 		glAttachShader(prg, shd);
@@ -1387,26 +1578,149 @@ void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl,
 	}
 
 	glLinkProgram(prg);
+	if (pending) return true;
+
 	GLint linked;
 	glGetProgramiv(prg, GL_LINK_STATUS, &linked);
 
 	if (linked == GL_FALSE) {
-		GLint log_len = 0;
-		glGetProgramiv(prg, GL_INFO_LOG_LENGTH, &log_len);
-		if (log_len > 0) {
-			Array<char> log_buf(gl->allocator);
-			log_buf.resize(log_len);
-			glGetProgramInfoLog(prg, log_len, &log_len, &log_buf[0]);
-			logError(name, ": ", &log_buf[0]);
-		}
-		else {
-			logError("Failed to link program ", name);
+		logLinkError(prg, name);
+		return false;
+	}
+	return true;
+}
+
+static StableHash getProgramCacheKey(const VertexDecl& decl, const char** srcs, const ShaderType* types, u32 num, const char** prefixes, u32 prefixes_count) {
+	RollingStableHasher hasher;
+	hasher.begin();
+	for (u32 i = 0; i < num; ++i) {
+		hasher.update(&types[i], sizeof(types[i]));
+		hasher.update(srcs[i], stringLength(srcs[i]));
+	}
+	for (u32 i = 0; i < decl.attributes_count; ++i) {
+		hasher.update(&decl.attributes[i].idx, sizeof(decl.attributes[i].idx));
+	}
+	for (u32 i = 0; i < prefixes_count; ++i) {
+		hasher.update(prefixes[i], stringLength(prefixes[i]));
+	}
+	return hasher.end64();
+}
+
+static bool loadProgramBinary(GLuint prg, StableHash key) {
+	MutexGuard lock(gl->program_cache_mutex);
+	auto iter = gl->program_cache.find(key);
+	if (!iter.isValid()) return false;
+
+	const CachedProgram& cached = iter.value();
+	glProgramBinary(prg, cached.format, gl->program_cache_data.data() + cached.offset, cached.size);
+	GLint linked;
+	glGetProgramiv(prg, GL_LINK_STATUS, &linked);
+	// driver can reject binaries even if it's the same version
+	if (linked == GL_FALSE) {
+		gl->program_cache.erase(iter);
+		gl->program_cache_dirty = true;
+		return false;
+	}
+	return true;
+}
+
+static void storeProgramBinary(GLuint prg, StableHash key) {
+	GLint size;
+	glGetProgramiv(prg, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0) return;
+
+	MutexGuard lock(gl->program_cache_mutex);
+	if (gl->program_cache.find(key).isValid()) return;
+	
+	CachedProgram cached;
+	cached.offset = (u32)gl->program_cache_data.size();
+	gl->program_cache_data.resize(cached.offset + size);
+	GLsizei len = 0;
+	glGetProgramBinary(prg, size, &len, &cached.format, gl->program_cache_data.getMutableData() + cached.offset);
+	if (len <= 0) {
+		gl->program_cache_data.resize(cached.offset);
+		return;
+	}
+	cached.size = len;
+	gl->program_cache_data.resize(cached.offset + len);
+	gl->program_cache.insert(key, cached);
+	gl->program_cache_dirty = true;
+}
+
+// returns false while the driver is still compiling the program
+static bool finishPendingProgram(Program& program) {
+	ASSERT(program.pending);
+	GLint completed = GL_FALSE;
+	glGetProgramiv(program.gl_handle, GL_COMPLETION_STATUS_KHR, &completed);
+	if (completed == GL_FALSE) return false;
+
+	program.pending = false;
+	GLint linked;
+	glGetProgramiv(program.gl_handle, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		bool shader_error = false;
+		for (u32 i = 0; i < program.pending_shaders_count; ++i) {
+			GLint compile_status;
+			glGetShaderiv(program.pending_shaders[i], GL_COMPILE_STATUS, &compile_status);
+			if (compile_status == GL_FALSE) {
+				logShaderError(program.pending_shaders[i], program.pending_types[i], program.pending_name);
+				shader_error = true;
+			}
 		}
-		glDeleteProgram(prg);
+		if (!shader_error) logLinkError(program.gl_handle, program.pending_name);
+	}
+
+	for (u32 i = 0; i < program.pending_shaders_count; ++i) {
+		glDetachShader(program.gl_handle, program.pending_shaders[i]);
+		glDeleteShader(program.pending_shaders[i]);
+	}
+	program.pending_shaders_count = 0;
+
+	if (linked == GL_FALSE) {
+		// same fallback as when createProgram fails right away
+		glDeleteProgram(program.gl_handle);
+		program.gl_handle = gl->default_program ? gl->default_program->gl_handle : 0;
+		return true;
+	}
+
+	storeProgramBinary(program.gl_handle, program.cache_key);
+	return true;
+}
+
+void createProgram(ProgramHandle prog, StateFlags state, const VertexDecl& decl, const char** srcs, const ShaderType* types, u32 num, const char** prefixes, u32 prefixes_count, const char* name)
+{
+	GPU_PROFILE();
+	checkThread();
+
+	if (num > Program::MAX_SHADERS) {
+		logError("Too many shaders per program in ", name);
 		return;
 	}
 
+	const GLuint prg = glCreateProgram();
+	if (name && name[0]) {
+		glObjectLabel(GL_PROGRAM, prg, stringLength(name), name);
+	}
+
 	ASSERT(prog);
+	const StableHash cache_key = getProgramCacheKey(decl, srcs, types, num, prefixes, prefixes_count);
+	if (!loadProgramBinary(prg, cache_key)) {
+		glProgramParameteri(prg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		Program* pending = gl->has_parallel_compile ? prog : nullptr;
+		if (!compileProgram(prg, decl, srcs, types, num, prefixes, prefixes_count, name, pending)) {
+			glDeleteProgram(prg);
+			return;
+		}
+		if (pending) {
+			prog->pending = true;
+			prog->cache_key = cache_key;
+			prog->pending_name = name ? name : "";
+		}
+		else {
+			storeProgramBinary(prg, cache_key);
+		}
+	}
+
 	switch (decl.primitive_type) {
 		case PrimitiveType::TRIANGLES: prog->primitive_type = GL_TRIANGLES; break;
 		case PrimitiveType::TRIANGLE_STRIP: prog->primitive_type = GL_TRIANGLE_STRIP; break;
@@ -1440,13 +1754,80 @@ void memoryBarrier(MemoryBarrierType type, BufferHandle) {
 	GLbitfield gl = 0;
 	if (u32(type & MemoryBarrierType::SSBO)) gl |= GL_SHADER_STORAGE_BARRIER_BIT;
 	if (u32(type & MemoryBarrierType::COMMAND)) gl |= GL_COMMAND_BARRIER_BIT;
+	if (u32(type & MemoryBarrierType::IMAGE)) gl |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT;
+	if (u32(type & MemoryBarrierType::VERTEX)) gl |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT;
 	glMemoryBarrier(gl);
 }
 
 
+void loadProgramCache(Span<const u8> data) {
+	InputMemoryStream blob(data.begin(), data.length());
+	ProgramCacheHeader header;
+	if (!blob.read(&header, sizeof(header))) return;
+	if (header.magic != ProgramCacheHeader::MAGIC || header.version != ProgramCacheHeader::VERSION) return;
+	if (header.driver != gl->driver) {
+		logInfo("Driver changed, program cache is ignored");
+		MutexGuard lock(gl->program_cache_mutex);
+		gl->program_cache_dirty = true;
+		return;
+	}
+
+	MutexGuard lock(gl->program_cache_mutex);
+	for (u32 i = 0; i < header.count; ++i) {
+		StableHash key;
+		GLenum format;
+		u32 size;
+		if (!blob.read(&key, sizeof(key))) break;
+		if (!blob.read(&format, sizeof(format))) break;
+		if (!blob.read(&size, sizeof(size))) break;
+		if (blob.getPosition() + size > blob.size()) break;
+		const u8* bin = (const u8*)blob.skip(size);
+		if (gl->program_cache.find(key).isValid()) continue;
+
+		CachedProgram cached;
+		cached.format = format;
+		cached.size = size;
+		cached.offset = (u32)gl->program_cache_data.size();
+		gl->program_cache_data.write(bin, size);
+		gl->program_cache.insert(key, cached);
+	}
+}
+
+bool saveProgramCache(OutputMemoryStream& blob) {
+	MutexGuard lock(gl->program_cache_mutex);
+	if (!gl->program_cache_dirty) return false;
+
+	ProgramCacheHeader header;
+	header.driver = gl->driver;
+	header.count = gl->program_cache.size();
+	blob.write(header);
+	for (auto iter = gl->program_cache.begin(), end = gl->program_cache.end(); iter != end; ++iter) {
+		const CachedProgram& cached = iter.value();
+		blob.write(iter.key());
+		blob.write(cached.format);
+		blob.write(cached.size);
+		blob.write(gl->program_cache_data.data() + cached.offset, cached.size);
+	}
+	gl->program_cache_dirty = false;
+	return true;
+}
+
 bool getMemoryStats(MemoryStats& stats) {
 	GPU_PROFILE();
-	if (!gl->has_gpu_mem_info_ext) return false;
+	stats.buffer_mem = gl->buffer_allocated_mem;
+	stats.texture_mem = gl->texture_allocated_mem;
+	stats.render_target_mem = gl->render_target_allocated_mem;
+	stats.transient_mem = gl->transient_allocated_mem;
+	stats.buffer_count = gl->buffer_count;
+	stats.texture_count = gl->texture_count;
+	stats.render_target_count = gl->render_target_count;
+
+	if (!gl->has_gpu_mem_info_ext) {
+		stats.total_available_mem = 0;
+		stats.current_available_mem = 0;
+		stats.dedicated_vidmem = 0;
+		return false;
+	}
 
 	GLint tmp;
 	glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &tmp);
@@ -1457,10 +1838,6 @@ bool getMemoryStats(MemoryStats& stats) {
 
 	glGetIntegerv(GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &tmp);
 	stats.dedicated_vidmem = (u64)tmp * 1024;
-	
-	stats.buffer_mem = gl->buffer_allocated_mem;
-	stats.texture_mem = gl->texture_allocated_mem;
-	stats.render_target_mem = gl->render_target_allocated_mem;
 
 	return true;
 }
@@ -1488,17 +1865,36 @@ bool init(void* window_handle, InitFlags init_flags)
 	int extensions_count;
 	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_count);
 	gl->has_gpu_mem_info_ext = false; 
+	gl->has_bindless = false;
+	bool has_parallel_compile = false;
 	for(int i = 0; i < extensions_count; ++i) {
 		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
 		if (equalStrings(ext, "GL_NVX_gpu_memory_info")) {
 			gl->has_gpu_mem_info_ext = true; 
-			break;
+		}
+		if (equalStrings(ext, "GL_ARB_bindless_texture")) {
+			gl->has_bindless = true;
+		}
+		if (equalStrings(ext, "GL_KHR_parallel_shader_compile") || equalStrings(ext, "GL_ARB_parallel_shader_compile")) {
+			has_parallel_compile = true;
 		}
 		//OutputDebugString(ext);
 		//OutputDebugString("\n");
 	}
 	//const unsigned char* version = glGetString(GL_VERSION);
 
+	if (gl->has_bindless) {
+		glGetTextureHandleARB = (PFNGLGETTEXTUREHANDLEARBPROC)getGLFunc("glGetTextureHandleARB");
+		glMakeTextureHandleResidentARB = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)getGLFunc("glMakeTextureHandleResidentARB");
+		glMakeTextureHandleNonResidentARB = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)getGLFunc("glMakeTextureHandleNonResidentARB");
+		gl->has_bindless = glGetTextureHandleARB && glMakeTextureHandleResidentARB && glMakeTextureHandleNonResidentARB;
+	}
+	if (gl->has_bindless) {
+		glCreateBuffers(1, &gl->bindless_table);
+		glNamedBufferStorage(gl->bindless_table, MAX_BINDLESS_TEXTURES * sizeof(GLuint64), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDLESS_TABLE_BINDING, gl->bindless_table);
+	}
+
 	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
 	glDepthFunc(GL_GREATER);
 
@@ -1520,6 +1916,17 @@ bool init(void* window_handle, InitFlags init_flags)
 	const char* default_srcs[] = { "void main() {}", "void main() { gl_Position = vec4(0); }" };
 	const ShaderType default_types[] = { ShaderType::FRAGMENT, ShaderType::VERTEX };
 	createProgram(gl->default_program, StateFlags::NONE, VertexDecl(PrimitiveType::NONE), default_srcs, default_types, 2, nullptr, 0, "default shader");
+
+	// enabled after the default program is created, since other programs fall back to it
+	if (has_parallel_compile) {
+		glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)getGLFunc("glMaxShaderCompilerThreadsKHR");
+		if (!glMaxShaderCompilerThreadsKHR) glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)getGLFunc("glMaxShaderCompilerThreadsARB");
+		if (glMaxShaderCompilerThreadsKHR) {
+			// let the driver pick the number of threads
+			glMaxShaderCompilerThreadsKHR(0xffFFffFF);
+			gl->has_parallel_compile = true;
+		}
+	}
 	
 	glGenVertexArrays(1, &gl->contexts[0].vao);
 	glBindVertexArray(gl->contexts[0].vao);
@@ -1540,6 +1947,22 @@ bool init(void* window_handle, InitFlags init_flags)
 bool isOriginBottomLeft() { return true; }
 
 
+void swap(TextureHandle a, TextureHandle b) {
+	checkThread();
+	ASSERT(a && b);
+	Texture tmp = *a;
+	*a = *b;
+	*b = tmp;
+	// tmp must not delete the gl texture it was moved from
+	tmp.gl_handle = 0;
+	// table slots stay with handles, so shaders see the swap too
+	if (gl->has_bindless) {
+		Lumix::swap(a->bindless_idx, b->bindless_idx);
+		glNamedBufferSubData(gl->bindless_table, a->bindless_idx * sizeof(GLuint64), sizeof(GLuint64), &a->bindless_handle);
+		glNamedBufferSubData(gl->bindless_table, b->bindless_idx * sizeof(GLuint64), sizeof(GLuint64), &b->bindless_handle);
+	}
+}
+
 void copy(TextureHandle dst, TextureHandle src, u32 dst_x, u32 dst_y) {
 	GPU_PROFILE();
 	checkThread();
@@ -1,4 +1,5 @@
 #include "renderer/material.h"
+#include "engine/atomic.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/hash.h"
@@ -130,6 +131,7 @@ void Material::unload()
 
 	m_renderer.getEndFrameDrawStream().destroy(m_bind_group);
 	m_bind_group = gpu::INVALID_BIND_GROUP;
+	m_renderer.invalidateSortKeyStates();
 	for (Texture*& tex : m_textures) tex = nullptr;
 	
 	setShader(nullptr);
@@ -367,6 +369,7 @@ void Material::onBeforeReady()
 
 void Material::updateRenderData(bool on_before_ready)
 {
+	m_renderer.invalidateSortKeyStates();
 	if (!m_shader) return;
 	if (!on_before_ready && !isReady()) return;
 
@@ -388,6 +391,15 @@ void Material::updateRenderData(bool on_before_ready)
 		}
 	}
 
+	// shader samples textures through gpu's bindless table, so they are not in the bind group
+	const bool bindless = m_shader->m_texture_indices_offset >= 0;
+	if (bindless) {
+		i32* indices = (i32*)((u8*)cs + m_shader->m_texture_indices_offset);
+		for (u32 i = 0; i < m_texture_count; ++i) {
+			indices[i] = m_textures[i] && m_textures[i]->handle ? gpu::getBindlessIndex(m_textures[i]->handle) : 0;
+		}
+	}
+
 	m_material_constants = m_renderer.createMaterialConstants(Span(cs));
 
 	DrawStream& stream = m_renderer.getDrawStream();
@@ -395,17 +407,36 @@ void Material::updateRenderData(bool on_before_ready)
 	m_bind_group = gpu::allocBindGroupHandle();
 	
 	gpu::BindGroupEntryDesc descs[MAX_TEXTURE_COUNT + 1];
-	for(u32 i = 0; i < m_texture_count; ++i) {
+	const u32 bound_textures_count = bindless ? 0 : m_texture_count;
+	for(u32 i = 0; i < bound_textures_count; ++i) {
 		descs[i].texture = m_textures[i] ? m_textures[i]->handle : gpu::INVALID_TEXTURE;
 		descs[i].type = gpu::BindGroupEntryDesc::TEXTURE;
 		descs[i].bind_point = i;
 	}
-	descs[m_texture_count].type = gpu::BindGroupEntryDesc::UNIFORM_BUFFER;
-	descs[m_texture_count].buffer = m_renderer.getMaterialUniformBuffer();
-	descs[m_texture_count].size = MAX_UNIFORMS_BYTES;
-	descs[m_texture_count].offset = m_material_constants * MAX_UNIFORMS_BYTES;
-	descs[m_texture_count].bind_point = UniformBuffer::MATERIAL;
-	stream.createBindGroup(m_bind_group, Span(descs, m_texture_count + 1));
+	descs[bound_textures_count].type = gpu::BindGroupEntryDesc::UNIFORM_BUFFER;
+	descs[bound_textures_count].buffer = m_renderer.getMaterialUniformBuffer(m_material_constants, descs[bound_textures_count].offset);
+	descs[bound_textures_count].size = MAX_UNIFORMS_BYTES;
+	descs[bound_textures_count].bind_point = UniformBuffer::MATERIAL;
+	stream.createBindGroup(m_bind_group, Span(descs, bound_textures_count + 1));
+}
+
+
+void Material::requestTextureResolution(u32 pixels)
+{
+	const i32 value = (i32)minimum(pixels, (u32)0x7fffFFFF);
+	for (;;) {
+		const i32 prev = m_requested_texture_resolution;
+		if (prev >= value) return;
+		if (compareAndExchange(&m_requested_texture_resolution, value, prev)) return;
+	}
+}
+
+
+u32 Material::takeRequestedTextureResolution()
+{
+	const i32 res = m_requested_texture_resolution;
+	m_requested_texture_resolution = 0;
+	return (u32)res;
 }
 
 
@@ -460,6 +491,7 @@ void Material::enableBackfaceCulling(bool enable)
 	else {
 		m_render_states = m_render_states & ~gpu::StateFlags::CULL_BACK;
 	}
+	m_renderer.invalidateSortKeyStates();
 }
 
 bool Material::isBackfaceCulling() const
@@ -687,6 +719,7 @@ bool Material::wireframe() const {
 void Material::setWireframe(bool enable) {
 	if (enable) m_render_states = m_render_states | gpu::StateFlags::WIREFRAME;
 	else m_render_states = m_render_states & ~gpu::StateFlags::WIREFRAME;
+	m_renderer.invalidateSortKeyStates();
 }
 
 bool Material::load(u64 size, const u8* mem)
@@ -713,6 +746,43 @@ bool Material::load(u64 size, const u8* mem)
 	return true;
 }
 
+// only textures, uniforms, defines and states are updated, changing the shader needs a full reload
+bool Material::reloadInPlace(u64 size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+
+	// parse into a scratch material, so textures which did not change keep their references
+	Material tmp(getPath(), m_resource_manager, m_renderer, m_renderer.getAllocator());
+	tmp.m_desired_state = State::READY;
+	const bool compatible = tmp.load(size, mem) && tmp.m_shader == m_shader;
+	if (compatible) {
+		u32 texture_defines = 0;
+		for (u32 i = 0; i < m_shader->m_texture_slot_count; ++i) {
+			const int define_idx = m_shader->m_texture_slots[i].define_idx;
+			if (define_idx >= 0) texture_defines |= 1 << define_idx;
+		}
+
+		for (u32 i = 0, c = maximum(m_texture_count, tmp.m_texture_count); i < c; ++i) {
+			Texture* texture = i < tmp.m_texture_count ? tmp.m_textures[i] : nullptr;
+			if (texture == getTexture(i)) continue;
+			if (texture) texture->incRefCount();
+			setTexture(i, texture);
+		}
+
+		m_uniforms.clear();
+		for (const Uniform& u : tmp.m_uniforms) m_uniforms.push(u);
+		m_render_states = tmp.m_render_states;
+		m_custom_flags = tmp.m_custom_flags;
+		m_define_mask = (m_define_mask & texture_defines) | (tmp.m_define_mask & ~texture_defines);
+		setLayer(tmp.m_layer);
+		updateRenderData(false);
+	}
+
+	tmp.unload();
+	tmp.m_desired_state = State::EMPTY;
+	return compatible;
+}
+
 lua_State* MaterialManager::getState(Material& material) const {
 	lua_pushlightuserdata(m_state, &material);
 	lua_setfield(m_state, LUA_GLOBALSINDEX, "this");
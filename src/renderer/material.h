@@ -60,6 +60,7 @@ struct LUMIX_RENDERER_API Material final : Resource {
 	~Material();
 
 	ResourceType getType() const override { return TYPE; }
+	FileSystem::Priority getLoadPriority() const override { return FileSystem::Priority::HIGH; }
 	Renderer& getRenderer() { return m_renderer; }
 	void enableBackfaceCulling(bool enable);
 	bool isBackfaceCulling() const;
@@ -72,6 +73,10 @@ struct LUMIX_RENDERER_API Material final : Resource {
 	Texture* getTexture(u32 i) const { return i < m_texture_count ? m_textures[i] : nullptr; }
 	Texture* getTextureByName(const char* name) const;
 	bool isTextureDefine(u8 define_idx) const;
+	// thread safe, resolution in pixels a mesh with this material is displayed at, used for texture streaming
+	void requestTextureResolution(u32 pixels);
+	// max requested resolution since the last call
+	u32 takeRequestedTextureResolution();
 	void setTexture(u32 i, Texture* texture);
 	void setTexturePath(int i, const Path& path);
 	int getUniformCount() const { return m_uniforms.size(); }
@@ -110,6 +115,8 @@ private:
 	void onBeforeReady() override;
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
+	bool isReloadedInPlace() const override { return true; }
+	bool reloadInPlace(u64 size, const u8* mem) override;
 
 	static int uniform(lua_State* L);
 	static int int_uniform(lua_State* L);
@@ -122,6 +129,7 @@ private:
 	u32 m_define_mask;
 	u32 m_material_constants = 0;
 	u32 m_texture_count;
+	volatile i32 m_requested_texture_resolution = 0;
 
 	Array<Uniform> m_uniforms;
 	u32 m_custom_flags;
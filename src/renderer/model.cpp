@@ -1,15 +1,18 @@
 #include "engine/lumix.h"
 
 #include "engine/array.h"
+#include "engine/atomic.h"
 #include "engine/crt.h"
 #include "engine/file_system.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/path.h"
 #include "engine/profiler.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
+#include "meshoptimizer/meshoptimizer.h"
 #include "renderer/draw_stream.h"
 #include "renderer/material.h"
 #include "renderer/model.h"
@@ -42,12 +45,19 @@ Mesh::Mesh(Material* mat,
 	, indices(allocator)
 	, vertices(allocator)
 	, skin(allocator)
+	, meshlets(allocator)
+	, bvh(allocator)
+	, bvh_triangles(allocator)
 	, vertex_decl(vertex_decl)
+	, rigid_vertex_decl(vertex_decl.primitive_type)
 	, renderer(renderer)
 	, vb_stride(vb_stride)
 	, vertex_buffer_handle(gpu::INVALID_BUFFER)
 	, index_buffer_handle(gpu::INVALID_BUFFER)
+	, meshlet_buffer(gpu::INVALID_BUFFER)
+	, quantization_buffer(gpu::INVALID_BUFFER)
 	, index_type(gpu::DataType::U32)
+	, indices_count(0)
 {
 	for(AttributeSemantic& attr : attributes_semantic) {
 		attr = AttributeSemantic::NONE;
@@ -58,6 +68,14 @@ Mesh::Mesh(Material* mat,
 		}
 	}
 
+	for (u32 i = 0; i < vertex_decl.attributes_count; ++i) {
+		const gpu::Attribute& attr = vertex_decl.attributes[i];
+		if (attr.idx == 4 || attr.idx == 5) continue;
+		rigid_vertex_decl.addAttribute(attr.idx, attr.byte_offset, attr.components_count, attr.type, attr.flags);
+	}
+	rigid_vertex_decl.addAttribute(4, 0, 4, gpu::AttributeType::FLOAT, gpu::Attribute::INSTANCED);
+	rigid_vertex_decl.addAttribute(5, 16, 4, gpu::AttributeType::FLOAT, gpu::Attribute::INSTANCED);
+
 	sort_key = renderer.allocSortKey(this);
 }
 
@@ -66,12 +84,16 @@ Mesh::Mesh(Mesh&& rhs)
 	, indices(rhs.indices)
 	, vertices(rhs.vertices.move())
 	, skin(rhs.skin.move())
+	, meshlets(rhs.meshlets.move())
+	, bvh(rhs.bvh.move())
+	, bvh_triangles(rhs.bvh_triangles.move())
 	, flags(rhs.flags)
 	, sort_key(rhs.sort_key)
 	, layer(rhs.layer)
 	, name(rhs.name)
 	, material(rhs.material)
 	, vertex_decl(rhs.vertex_decl)
+	, rigid_vertex_decl(rhs.rigid_vertex_decl)
 	, lod(rhs.lod)
 	, renderer(rhs.renderer)
 {
@@ -96,6 +118,7 @@ void Mesh::setMaterial(Material* new_material, Model& model, Renderer& renderer)
 	if (material) material->decRefCount();
 	material = new_material;
 	type = model.getBoneCount() == 0 || skin.empty() ? Mesh::RIGID : Mesh::SKINNED;
+	renderer.invalidateSortKeyStates();
 }
 
 
@@ -152,6 +175,114 @@ bool Model::isSkinned() const
 }
 
 
+// two-sided, t is in units of dir's length
+static bool castRayTriangle(const Vec3& origin, const Vec3& dir, const Vec3& p0, const Vec3& p1, const Vec3& p2, float& t)
+{
+	const Vec3 normal = cross(p1 - p0, p2 - p0);
+	const float q = dot(normal, dir);
+	if (q == 0) return false;
+
+	const float d = -dot(normal, p0);
+	t = -(dot(normal, origin) + d) / q;
+	if (t < 0) return false;
+
+	const Vec3 hit_point = origin + dir * t;
+	if (dot(normal, cross(p1 - p0, hit_point - p0)) < 0) return false;
+	if (dot(normal, cross(p2 - p1, hit_point - p1)) < 0) return false;
+	if (dot(normal, cross(p0 - p2, hit_point - p2)) < 0) return false;
+	return true;
+}
+
+
+static bool castRayAABB(const Vec3& origin, const Vec3& inv_dir, const Vec3& min, const Vec3& max, float max_t)
+{
+	const Vec3 t0 = (min - origin) * inv_dir;
+	const Vec3 t1 = (max - origin) * inv_dir;
+	const float tmin = maximum(minimum(t0.x, t1.x), minimum(t0.y, t1.y), minimum(t0.z, t1.z));
+	const float tmax = minimum(maximum(t0.x, t1.x), maximum(t0.y, t1.y), maximum(t0.z, t1.z));
+	return tmax >= maximum(tmin, 0.f) && tmin <= max_t;
+}
+
+
+static u32 getIndex(const Mesh& mesh, u32 i)
+{
+	if (mesh.areIndices16()) return ((const u16*)mesh.indices.data())[i];
+	return ((const u32*)mesh.indices.data())[i];
+}
+
+
+// top-down, triangles are split by the middle of their centroids' bounds along the longest axis
+static void buildBVH(Mesh& mesh, IAllocator& allocator)
+{
+	static constexpr u32 MAX_LEAF_TRIANGLES = 4;
+
+	const u32 triangles_count = mesh.indices_count / 3;
+	mesh.bvh.clear();
+	mesh.bvh_triangles.resize(triangles_count);
+	if (triangles_count == 0) return;
+
+	Array<Vec3> centroids(allocator);
+	centroids.resize(triangles_count);
+	const Vec3* vertices = mesh.vertices.begin();
+	for (u32 i = 0; i < triangles_count; ++i) {
+		mesh.bvh_triangles[i] = i;
+		centroids[i] = (vertices[getIndex(mesh, i * 3)] + vertices[getIndex(mesh, i * 3 + 1)] + vertices[getIndex(mesh, i * 3 + 2)]) * (1 / 3.f);
+	}
+
+	struct Range {
+		u32 node;
+		u32 from;
+		u32 to;
+	};
+	Array<Range> stack(allocator);
+	mesh.bvh.reserve(2 * triangles_count / MAX_LEAF_TRIANGLES + 1);
+	mesh.bvh.emplace();
+	stack.push({0, 0, triangles_count});
+	while (!stack.empty()) {
+		const Range range = stack.back();
+		stack.pop();
+
+		AABB aabb(Vec3(FLT_MAX), Vec3(-FLT_MAX));
+		AABB centroids_aabb(Vec3(FLT_MAX), Vec3(-FLT_MAX));
+		for (u32 i = range.from; i < range.to; ++i) {
+			const u32 tri = mesh.bvh_triangles[i];
+			aabb.addPoint(vertices[getIndex(mesh, tri * 3)]);
+			aabb.addPoint(vertices[getIndex(mesh, tri * 3 + 1)]);
+			aabb.addPoint(vertices[getIndex(mesh, tri * 3 + 2)]);
+			centroids_aabb.addPoint(centroids[tri]);
+		}
+		mesh.bvh[range.node].min = aabb.min;
+		mesh.bvh[range.node].max = aabb.max;
+
+		if (range.to - range.from <= MAX_LEAF_TRIANGLES) {
+			mesh.bvh[range.node].first = range.from;
+			mesh.bvh[range.node].count = range.to - range.from;
+			continue;
+		}
+
+		const Vec3 extent = centroids_aabb.max - centroids_aabb.min;
+		const u32 axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		const float split = (&centroids_aabb.min.x)[axis] + (&extent.x)[axis] * 0.5f;
+		u32 mid = range.from;
+		u32 end = range.to;
+		while (mid < end) {
+			if ((&centroids[mesh.bvh_triangles[mid]].x)[axis] < split) ++mid;
+			else swap(mesh.bvh_triangles[mid], mesh.bvh_triangles[--end]);
+		}
+		// all centroids are in the same place
+		if (mid == range.from || mid == range.to) mid = (range.from + range.to) / 2;
+
+		const u32 first_child = mesh.bvh.size();
+		mesh.bvh.emplace();
+		mesh.bvh.emplace();
+		mesh.bvh[range.node].first = first_child;
+		mesh.bvh[range.node].count = 0;
+		stack.push({first_child, range.from, mid});
+		stack.push({first_child + 1, mid, range.to});
+	}
+}
+
+
 RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose* pose, EntityPtr entity, const RayCastModelHit::Filter* filter)
 {
 	static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("model_instance");
@@ -160,10 +291,12 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 	hit.is_hit = false;
 	if (!isReady()) return hit;
 
+	// streamed models are tested against the finest resident lod
+	const LODMeshIndices& lod = m_lod_indices[m_resident_lod];
 	Matrix matrices[256];
 	ASSERT(!pose || pose->count <= lengthOf(matrices));
 	bool is_skinned = false;
-	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
+	for (int mesh_index = lod.from; mesh_index <= lod.to; ++mesh_index) {
 		Mesh& mesh = m_meshes[mesh_index];
 		is_skinned = pose && !mesh.skin.empty() && pose->count <= lengthOf(matrices);
 	}
@@ -171,58 +304,24 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 		computeSkinMatrices(*pose, *this, matrices);
 	}
 
-	for (int mesh_index = m_lod_indices[0].from; mesh_index <= m_lod_indices[0].to; ++mesh_index) {
+	const Vec3 inv_dir(1 / dir.x, 1 / dir.y, 1 / dir.z);
+	for (int mesh_index = lod.from; mesh_index <= lod.to; ++mesh_index) {
 		const Mesh& mesh = m_meshes[mesh_index];
 		const bool is_mesh_skinned = !mesh.skin.empty() && is_skinned;
-		const u16* indices16 = (const u16*)mesh.indices.data();
-		const u32* indices32 = (const u32*)mesh.indices.data();
-		const bool is16 = mesh.flags.isSet(Mesh::Flags::INDICES_16_BIT);
-		const int index_size = is16 ? 2 : 4;
 		const Vec3* vertices = mesh.vertices.begin();
-		
-		for (i32 i = 0, c = (i32)mesh.indices.size() / index_size; i < c; i += 3) {
-			Vec3 p0, p1, p2;
-			if (is16) {
-				p0 = vertices[indices16[i]];
-				p1 = vertices[indices16[i + 1]];
-				p2 = vertices[indices16[i + 2]];
-				if (is_mesh_skinned) {
-					p0 = evaluateSkin(p0, mesh.skin[indices16[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices16[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices16[i + 2]], matrices);
-				}
-			} else {
-				p0 = vertices[indices32[i]];
-				p1 = vertices[indices32[i + 1]];
-				p2 = vertices[indices32[i + 2]];
-				if (is_mesh_skinned) {
-					p0 = evaluateSkin(p0, mesh.skin[indices32[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices32[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices32[i + 2]], matrices);
-				}
-			}
-
-			Vec3 normal = cross(p1 - p0, p2 - p0);
-			float q = dot(normal, dir);
-			if (q == 0)	continue;
-
-			float d = -dot(normal, p0);
-			float t = -(dot(normal, origin) + d) / q;
-			if (t < 0) continue;
 
-			Vec3 hit_point = origin + dir * t;
-
-			Vec3 edge0 = p1 - p0;
-			Vec3 VP0 = hit_point - p0;
-			if (dot(normal, cross(edge0, VP0)) < 0) continue;
-
-			Vec3 edge1 = p2 - p1;
-			Vec3 VP1 = hit_point - p1;
-			if (dot(normal, cross(edge1, VP1)) < 0) continue;
+		auto testTriangle = [&](u32 i){
+			Vec3 p0 = vertices[getIndex(mesh, i)];
+			Vec3 p1 = vertices[getIndex(mesh, i + 1)];
+			Vec3 p2 = vertices[getIndex(mesh, i + 2)];
+			if (is_mesh_skinned) {
+				p0 = evaluateSkin(p0, mesh.skin[getIndex(mesh, i)], matrices);
+				p1 = evaluateSkin(p1, mesh.skin[getIndex(mesh, i + 1)], matrices);
+				p2 = evaluateSkin(p2, mesh.skin[getIndex(mesh, i + 2)], matrices);
+			}
 
-			Vec3 edge2 = p0 - p2;
-			Vec3 VP2 = hit_point - p2;
-			if (dot(normal, cross(edge2, VP2)) < 0) continue;
+			float t;
+			if (!castRayTriangle(origin, dir, p0, p1, p2, t)) return;
 
 			if (!hit.is_hit || hit.t > t)
 			{
@@ -234,6 +333,36 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 				hit.component_type = MODEL_INSTANCE_TYPE;
 				if (filter && !filter->invoke(hit)) hit = prev;
 			}
+		};
+
+		// bvh is built from bind pose
+		if (is_mesh_skinned || mesh.bvh.empty()) {
+			for (u32 i = 0, c = (u32)mesh.indices_count; i < c; i += 3) {
+				testTriangle(i);
+			}
+			continue;
+		}
+
+		u32 stack[64];
+		u32 stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size > 0) {
+			const Mesh::BVHNode& node = mesh.bvh[stack[--stack_size]];
+			if (!castRayAABB(origin, inv_dir, node.min, node.max, hit.is_hit ? hit.t : FLT_MAX)) continue;
+
+			if (node.count > 0) {
+				for (u32 i = node.first, end = node.first + node.count; i < end; ++i) {
+					testTriangle(mesh.bvh_triangles[i] * 3);
+				}
+			}
+			else if (stack_size + 2 <= lengthOf(stack)) {
+				stack[stack_size++] = node.first + 1;
+				stack[stack_size++] = node.first;
+			}
+			else {
+				// too deep, should not happen with sane meshes
+				ASSERT(false);
+			}
 		}
 	}
 	hit.origin = DVec3(origin.x, origin.y, origin.z);
@@ -253,6 +382,7 @@ void Model::getRelativePose(Pose& pose)
 		rot[i] = m_bones[i].relative_transform.rot;
 	}
 	pose.is_absolute = false;
+	pose.is_skinning_valid = false;
 }
 
 
@@ -267,6 +397,7 @@ void Model::getPose(Pose& pose)
 		rot[i] = m_bones[i].transform.rot;
 	}
 	pose.is_absolute = true;
+	pose.is_skinning_valid = false;
 }
 
 
@@ -303,8 +434,16 @@ static bool parseVertexDecl(IInputStream& file, gpu::VertexDecl* vertex_decl, Me
 		const u8 idx = getIndexBySemantic(semantics[i]);
 
 		switch(semantics[i]) {
-			case Mesh::AttributeSemantic::WEIGHTS:
 			case Mesh::AttributeSemantic::POSITION:
+				if (type == gpu::AttributeType::FLOAT) {
+					vertex_decl->addAttribute(idx, offset, cmp_count, type, 0);
+				}
+				else {
+					// relative to the mesh's AABB, see Mesh::quantization_buffer
+					vertex_decl->addAttribute(idx, offset, cmp_count, type, gpu::Attribute::NORMALIZED | gpu::Attribute::QUANTIZED);
+				}
+				break;
+			case Mesh::AttributeSemantic::WEIGHTS:
 			case Mesh::AttributeSemantic::TEXCOORD0:
 				vertex_decl->addAttribute(idx, offset, cmp_count, type, 0);
 				break;
@@ -317,6 +456,10 @@ static bool parseVertexDecl(IInputStream& file, gpu::VertexDecl* vertex_decl, Me
 				if (type == gpu::AttributeType::FLOAT) {
 					vertex_decl->addAttribute(idx, offset, cmp_count, type, 0);
 				}
+				else if (cmp_count == 2) {
+					// octahedral encoding
+					vertex_decl->addAttribute(idx, offset, cmp_count, type, gpu::Attribute::NORMALIZED | gpu::Attribute::QUANTIZED);
+				}
 				else {
 					vertex_decl->addAttribute(idx, offset, cmp_count, type, gpu::Attribute::NORMALIZED);
 				}
@@ -347,6 +490,7 @@ void Model::onBeforeReady()
 		mesh.type = getBoneCount() == 0 || mesh.skin.empty() ? Mesh::RIGID : Mesh::SKINNED;
 		mesh.layer = mesh.material->getLayer();
 	}
+	m_renderer.invalidateSortKeyStates();
 
 	for (u32 i = 0; i < 4; ++i) {
 		if (m_lod_indices[i].from < 0) continue;
@@ -449,6 +593,41 @@ static int getAttributeOffset(Mesh& mesh, Mesh::AttributeSemantic attr)
 }
 
 
+// fills mesh's CPU copy of positions and skin, used by raycasts and CPU occlusion culling
+static void extractVertices(Mesh& mesh, const u8* vertices, u32 vertex_count, const Vec3& position_offset, const Vec3& position_scale)
+{
+	const int position_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::POSITION);
+	const int weights_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::WEIGHTS);
+	const int bone_indices_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::INDICES);
+	const bool keep_skin = hasAttribute(mesh, Mesh::AttributeSemantic::WEIGHTS) && hasAttribute(mesh, Mesh::AttributeSemantic::INDICES);
+	const bool quantized = mesh.vertex_decl.attributes[0].flags & gpu::Attribute::QUANTIZED;
+
+	const u32 vertex_size = mesh.vb_stride;
+	mesh.vertices.resize(vertex_count);
+	if (keep_skin) mesh.skin.resize(vertex_count);
+	for (u32 j = 0; j < vertex_count; ++j)
+	{
+		const u32 offset = j * vertex_size;
+		if (keep_skin)
+		{
+			mesh.skin[j].weights = *(const Vec4*)&vertices[offset + weights_attribute_offset];
+			memcpy(mesh.skin[j].indices,
+				&vertices[offset + bone_indices_attribute_offset],
+				sizeof(mesh.skin[j].indices));
+		}
+		if (quantized) {
+			// same as normalized attribute in shader
+			const i16* q = (const i16*)&vertices[offset + position_attribute_offset];
+			const Vec3 v(maximum(q[0] / 32767.f, -1.f), maximum(q[1] / 32767.f, -1.f), maximum(q[2] / 32767.f, -1.f));
+			mesh.vertices[j] = position_offset + v * position_scale;
+		}
+		else {
+			mesh.vertices[j] = *(const Vec3*)&vertices[offset + position_attribute_offset];
+		}
+	}
+}
+
+
 bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 {
 	int object_count = 0;
@@ -484,9 +663,39 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 		addDependency(*material);
 	}
 
+	if (version < FileVersion::LOD_CHUNKS) {
+		if (!parseGeometry(file, version, 0, object_count - 1)) return false;
+	}
+	file.read(m_origin_bounding_radius);
+	file.read(m_center_bounding_radius);
+	file.read(m_aabb);
+	return true;
+}
+
+
+// index and vertex buffers of meshes from_mesh..to_mesh, decoded and uploaded
+bool Model::parseGeometry(InputMemoryStream& file, FileVersion version, i32 from_mesh, i32 to_mesh)
+{
+	const i32 object_count = to_mesh - from_mesh + 1;
+
+	// compressed buffers are decoded on workers once all meshes are read
+	struct MeshData {
+		const u8* encoded_indices = nullptr;
+		u32 encoded_indices_size = 0;
+		const u8* encoded_vertices = nullptr;
+		u32 encoded_vertices_size = 0;
+		Renderer::MemRef vertices;
+		// positions are dequantized as offset + value * scale
+		Vec4 position_offset = Vec4(0);
+		Vec4 position_scale = Vec4(1);
+		bool valid = true;
+	};
+	Array<MeshData> data(m_allocator);
+	data.resize(object_count);
+
 	for (int i = 0; i < object_count; ++i)
 	{
-		Mesh& mesh = m_meshes[i];
+		Mesh& mesh = m_meshes[from_mesh + i];
 		int index_size;
 		int indices_count;
 		file.read(index_size);
@@ -495,52 +704,88 @@ bool Model::parseMeshes(InputMemoryStream& file, FileVersion version)
 		if (indices_count <= 0) return false;
 		mesh.indices.resize(index_size * indices_count);
 		mesh.indices_count = indices_count;
-		file.read(mesh.indices.getMutableData(), mesh.indices.size());
+		if (version > FileVersion::MESHLETS) file.read(data[i].encoded_indices_size);
+		if (data[i].encoded_indices_size > 0) {
+			data[i].encoded_indices = (const u8*)file.skip(data[i].encoded_indices_size);
+		}
+		else {
+			file.read(mesh.indices.getMutableData(), mesh.indices.size());
+		}
 
 		if (index_size == 2) mesh.flags.set(Mesh::Flags::INDICES_16_BIT);
-		const Renderer::MemRef mem = m_renderer.copy(mesh.indices.data(), (u32)mesh.indices.size());
-		mesh.index_buffer_handle = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
 		mesh.index_type = index_size == 2 ? gpu::DataType::U16 : gpu::DataType::U32;
-		if (!mesh.index_buffer_handle) return false;
 	}
 
 	for (int i = 0; i < object_count; ++i)
 	{
-		Mesh& mesh = m_meshes[i];
+		MeshData& mesh_data = data[i];
 		int data_size;
 		file.read(data_size);
-		Renderer::MemRef vertices_mem = m_renderer.allocate(data_size);
-		file.read(vertices_mem.data, data_size);
-
-		int position_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::POSITION);
-		int weights_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::WEIGHTS);
-		int bone_indices_attribute_offset = getAttributeOffset(mesh, Mesh::AttributeSemantic::INDICES);
-		bool keep_skin = hasAttribute(mesh, Mesh::AttributeSemantic::WEIGHTS) && hasAttribute(mesh, Mesh::AttributeSemantic::INDICES);
-
-		int vertex_size = mesh.vb_stride;
-		int mesh_vertex_count = data_size / vertex_size;
-		mesh.vertices.resize(mesh_vertex_count);
-		if (keep_skin) mesh.skin.resize(mesh_vertex_count);
-		const u8* vertices = (const u8*)vertices_mem.data;
-		for (int j = 0; j < mesh_vertex_count; ++j)
-		{
-			int offset = j * vertex_size;
-			if (keep_skin)
-			{
-				mesh.skin[j].weights = *(const Vec4*)&vertices[offset + weights_attribute_offset];
-				memcpy(mesh.skin[j].indices,
-					&vertices[offset + bone_indices_attribute_offset],
-					sizeof(mesh.skin[j].indices));
+		if (version > FileVersion::MESHLETS) {
+			file.read(mesh_data.encoded_vertices_size);
+			Vec3 offset, scale;
+			file.read(offset);
+			file.read(scale);
+			mesh_data.position_offset = Vec4(offset, 0);
+			mesh_data.position_scale = Vec4(scale, 0);
+		}
+		mesh_data.vertices = m_renderer.allocate(data_size);
+		if (mesh_data.encoded_vertices_size > 0) {
+			mesh_data.encoded_vertices = (const u8*)file.skip(mesh_data.encoded_vertices_size);
+		}
+		else {
+			file.read(mesh_data.vertices.data, data_size);
+		}
+	}
+
+	jobs::forEach(object_count, 1, [&](i32 from, i32 to){
+		PROFILE_BLOCK("decode meshes");
+		for (i32 i = from; i < to; ++i) {
+			Mesh& mesh = m_meshes[from_mesh + i];
+			MeshData& mesh_data = data[i];
+			if (mesh_data.encoded_indices) {
+				const u32 index_size = mesh.areIndices16() ? 2 : 4;
+				if (meshopt_decodeIndexBuffer(mesh.indices.getMutableData(), mesh.indices_count, index_size, mesh_data.encoded_indices, mesh_data.encoded_indices_size) != 0) {
+					mesh_data.valid = false;
+					continue;
+				}
 			}
-			mesh.vertices[j] = *(const Vec3*)&vertices[offset + position_attribute_offset];
+			const u32 vertex_count = mesh_data.vertices.size / mesh.vb_stride;
+			if (mesh_data.encoded_vertices) {
+				if (meshopt_decodeVertexBuffer(mesh_data.vertices.data, vertex_count, mesh.vb_stride, mesh_data.encoded_vertices, mesh_data.encoded_vertices_size) != 0) {
+					mesh_data.valid = false;
+					continue;
+				}
+			}
+			extractVertices(mesh, (const u8*)mesh_data.vertices.data, vertex_count, mesh_data.position_offset.xyz(), mesh_data.position_scale.xyz());
+			buildBVH(mesh, m_allocator);
+		}
+	});
+
+	for (int i = 0; i < object_count; ++i)
+	{
+		Mesh& mesh = m_meshes[from_mesh + i];
+		MeshData& mesh_data = data[i];
+		if (!mesh_data.valid) {
+			logError("Could not decode mesh ", mesh.name, " in ", getPath());
+			for (int j = i; j < object_count; ++j) m_renderer.free(data[j].vertices);
+			return false;
+		}
+
+		const Renderer::MemRef mem = m_renderer.copy(mesh.indices.data(), (u32)mesh.indices.size());
+		mesh.index_buffer_handle = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
+		mesh.vertex_buffer_handle = m_renderer.createBuffer(mesh_data.vertices, gpu::BufferFlags::IMMUTABLE);
+		if (!mesh.index_buffer_handle || !mesh.vertex_buffer_handle) return false;
+
+		if (mesh.vertex_decl.attributes[0].flags & gpu::Attribute::QUANTIZED) {
+			const Vec4 quantization[] = { mesh_data.position_offset, mesh_data.position_scale };
+			const Renderer::MemRef quantization_mem = m_renderer.copy(quantization, sizeof(quantization));
+			mesh.quantization_buffer = m_renderer.createBuffer(quantization_mem, gpu::BufferFlags::IMMUTABLE | gpu::BufferFlags::UNIFORM_BUFFER);
+			if (!mesh.quantization_buffer) return false;
 		}
-		mesh.vertex_buffer_handle = m_renderer.createBuffer(vertices_mem, gpu::BufferFlags::IMMUTABLE);
-		if (!mesh.vertex_buffer_handle) return false;
 	}
-	file.read(m_origin_bounding_radius);
-	file.read(m_center_bounding_radius);
-	file.read(m_aabb);
 
+	m_renderer.invalidateSortKeyStates();
 	return true;
 }
 
@@ -563,11 +808,135 @@ bool Model::parseLODs(InputMemoryStream& file)
 		file.read(m_lod_indices[i].to);
 		file.read(m_lod_distances[i]);
 		m_lod_indices[i].from = i > 0 ? m_lod_indices[i - 1].to + 1 : 0;
+		if (m_lod_indices[i].to >= (i32)m_meshes.size()) return false;
+	}
+	m_lod_count = lod_count;
+	return true;
+}
+
+
+bool Model::parseMeshlets(InputMemoryStream& file, i32 from_mesh, i32 to_mesh)
+{
+	for (i32 i = from_mesh; i <= to_mesh; ++i) {
+		Mesh& mesh = m_meshes[i];
+		u32 count;
+		file.read(count);
+		if (count == 0) continue;
+
+		mesh.meshlets.resize(count);
+		file.read(mesh.meshlets.begin(), mesh.meshlets.byte_size());
+		for (const Mesh::Meshlet& meshlet : mesh.meshlets) {
+			if (meshlet.first_index + meshlet.index_count > (u32)mesh.indices_count) return false;
+		}
+		const Renderer::MemRef mem = m_renderer.copy(mesh.meshlets.begin(), mesh.meshlets.byte_size());
+		mesh.meshlet_buffer = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE | gpu::BufferFlags::SHADER_BUFFER);
+		if (!mesh.meshlet_buffer) return false;
+	}
+	m_renderer.invalidateSortKeyStates();
+	return true;
+}
+
+
+static void destroyBuffers(Mesh& mesh, DrawStream& stream)
+{
+	if (mesh.index_buffer_handle) stream.destroy(mesh.index_buffer_handle);
+	if (mesh.vertex_buffer_handle) stream.destroy(mesh.vertex_buffer_handle);
+	if (mesh.meshlet_buffer) stream.destroy(mesh.meshlet_buffer);
+	if (mesh.quantization_buffer) stream.destroy(mesh.quantization_buffer);
+	mesh.index_buffer_handle = gpu::INVALID_BUFFER;
+	mesh.vertex_buffer_handle = gpu::INVALID_BUFFER;
+	mesh.meshlet_buffer = gpu::INVALID_BUFFER;
+	mesh.quantization_buffer = gpu::INVALID_BUFFER;
+	mesh.renderer.invalidateSortKeyStates();
+}
+
+
+// chunks are ordered from the coarsest lod, so the model can be drawn once the first one is parsed
+// chunks of resident lods are skipped
+bool Model::parseLODChunks(InputMemoryStream& file, FileVersion version, u32 finest_lod)
+{
+	for (u32 lod = m_lod_count; lod-- > finest_lod;) {
+		u32 chunk_size;
+		file.read(chunk_size);
+		if (file.getPosition() + chunk_size > file.size()) return false;
+		if (lod >= m_resident_lod) {
+			file.skip(chunk_size);
+			continue;
+		}
+
+		const LODMeshIndices& indices = m_lod_indices[lod];
+		if (!parseGeometry(file, version, indices.from, indices.to) || !parseMeshlets(file, indices.from, indices.to)) {
+			for (i32 i = indices.from; i <= indices.to; ++i) destroyBuffers(m_meshes[i], m_renderer.getDrawStream());
+			return false;
+		}
+		m_resident_lod = lod;
 	}
 	return true;
 }
 
 
+void Model::requestLOD(u32 lod)
+{
+	for (;;) {
+		const i32 requested = m_requested_lod;
+		if (requested <= (i32)lod) return;
+		if (compareAndExchange(&m_requested_lod, lod, requested)) return;
+	}
+}
+
+
+u32 Model::takeRequestedLOD()
+{
+	for (;;) {
+		const i32 requested = m_requested_lod;
+		if (compareAndExchange(&m_requested_lod, MAX_LOD_COUNT, requested)) return (u32)requested;
+	}
+}
+
+
+bool Model::streamLODs(u32 lod)
+{
+	ASSERT(lod < m_resident_lod);
+	if (m_stream_op.isValid()) return false;
+
+	m_stream_target_lod = lod;
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	m_stream_op = fs.getContent(getCompiledPath(), makeDelegate<&Model::lodsLoaded>(this), FileSystem::Priority::LOW);
+	return true;
+}
+
+
+void Model::lodsLoaded(u64 size, const u8* mem, bool success)
+{
+	PROFILE_FUNCTION();
+	m_stream_op = FileSystem::AsyncHandle::invalid();
+	if (!success || !isReady()) return;
+
+	OutputMemoryStream tmp(m_allocator);
+	u64 content_size = 0;
+	u64 resource_size = 0;
+	const u8* content = unpack(size, mem, tmp, content_size, resource_size);
+	if (!content || content_size < m_lod_chunks_offset) return;
+
+	InputMemoryStream file(content, content_size);
+	FileHeader header;
+	file.read(header);
+	// file changed since the model was loaded, it's going to be reloaded
+	if (header.magic != FILE_MAGIC || header.version < (u32)FileVersion::LOD_CHUNKS || header.version > (u32)FileVersion::LATEST) return;
+
+	const u32 prev_resident_lod = m_resident_lod;
+	file.setPosition(m_lod_chunks_offset);
+	if (!parseLODChunks(file, (FileVersion)header.version, m_stream_target_lod)) {
+		logError("Could not stream lods of ", getPath());
+	}
+
+	for (i32 i = m_lod_indices[m_resident_lod].from; i <= m_lod_indices[prev_resident_lod - 1].to; ++i) {
+		Mesh& mesh = m_meshes[i];
+		mesh.type = getBoneCount() == 0 || mesh.skin.empty() ? Mesh::RIGID : Mesh::SKINNED;
+	}
+}
+
+
 bool Model::load(u64 size, const u8* mem)
 {
 	PROFILE_FUNCTION();
@@ -587,14 +956,23 @@ bool Model::load(u64 size, const u8* mem)
 		return false;
 	}
 
-	if (parseMeshes(file, (FileVersion)header.version)
-		&& parseBones(file)
-		&& parseLODs(file))
-	{
+	const FileVersion version = (FileVersion)header.version;
+	if (!parseMeshes(file, version) || !parseBones(file) || !parseLODs(file)) return false;
+
+	m_flags.clear();
+	if (version > FileVersion::FIRST) file.read(m_flags);
+	if (version < FileVersion::LOD_CHUNKS) {
+		m_flags.set(Flags::STREAMED_LODS, false);
+		m_resident_lod = 0;
+		if (version > FileVersion::FLAGS) return parseMeshlets(file, 0, m_meshes.size() - 1);
 		return true;
 	}
 
-	return false;
+	m_lod_chunks_offset = file.getPosition();
+	m_resident_lod = m_lod_count;
+	if (!parseLODChunks(file, version, isStreamed() ? m_lod_count - 1 : 0)) return false;
+	if (m_resident_lod > 0) m_renderer.addStreamedModel(*this);
+	return true;
 }
 
 
@@ -605,12 +983,18 @@ void Model::unload()
 		m_meshes[i].material->decRefCount();
 	}
 
+	if (m_stream_op.isValid()) {
+		FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+		fs.cancel(m_stream_op);
+		m_stream_op = FileSystem::AsyncHandle::invalid();
+	}
+	if (isStreamed()) m_renderer.removeStreamedModel(*this);
+	m_resident_lod = 0;
+	m_requested_lod = MAX_LOD_COUNT;
+	m_lod_count = 0;
+
 	for (Mesh& mesh : m_meshes) {
-		DrawStream& stream = m_renderer.getDrawStream();
-		if (mesh.index_buffer_handle) stream.destroy(mesh.index_buffer_handle);
-		if (mesh.vertex_buffer_handle) stream.destroy(mesh.vertex_buffer_handle);
-		mesh.index_buffer_handle = gpu::INVALID_BUFFER;
-		mesh.vertex_buffer_handle = gpu::INVALID_BUFFER;
+		destroyBuffers(mesh, m_renderer.getDrawStream());
 	}
 	m_meshes.clear();
 	m_bones.clear();
@@ -76,6 +76,29 @@ struct LUMIX_RENDERER_API Mesh {
 
 	enum Flags : u8 { INDICES_16_BIT = 1 << 0 };
 
+	// cluster of up to 126 triangles, its indices are contiguous in the index buffer
+	// matches Meshlet in pipelines/meshlets.shd
+	struct Meshlet {
+		Vec3 center;
+		float radius;
+		Vec3 cone_apex;
+		float cone_cutoff;
+		Vec3 cone_axis;
+		u32 first_index;
+		u32 index_count;
+		u32 padding[3];
+	};
+
+	// bounding volume hierarchy over mesh's triangles, used by ray casts
+	struct BVHNode {
+		Vec3 min;
+		// inner node - index of the first child, the second child follows it; leaf - offset in bvh_triangles
+		u32 first;
+		Vec3 max;
+		// number of triangles in a leaf, 0 for inner nodes
+		u32 count;
+	};
+
 	Mesh(Material* mat,
 		const gpu::VertexDecl& vertex_decl,
 		u8 vb_stride,
@@ -95,12 +118,18 @@ struct LUMIX_RENDERER_API Mesh {
 	OutputMemoryStream indices;
 	Array<Vec3> vertices;
 	Array<Skin> skin;
+	Array<Meshlet> meshlets;
+	// built from vertices when the mesh is loaded, root is the first node; empty for meshes without triangles
+	Array<BVHNode> bvh;
+	Array<u32> bvh_triangles;
 	FlagSet<Flags, u8> flags;
 	u32 sort_key;
 	u8 layer;
 	String name;
 	Material* material;
 	gpu::VertexDecl vertex_decl;
+	// vertex_decl without bone attributes and with instance data, used to draw vertices skinned by pipelines/skinning.shd
+	gpu::VertexDecl rigid_vertex_decl;
 	AttributeSemantic attributes_semantic[gpu::VertexDecl::MAX_ATTRIBUTES];
 	Renderer& renderer;
 	float lod = 0;
@@ -108,6 +137,10 @@ struct LUMIX_RENDERER_API Mesh {
 	gpu::BufferHandle vertex_buffer_handle;
 	u32 vb_stride;
 	gpu::BufferHandle index_buffer_handle;
+	gpu::BufferHandle meshlet_buffer;
+	// offset and scale of positions quantized to the mesh's AABB, bound to UniformBuffer::DRAWCALL2 when the mesh is drawn
+	// invalid if positions are not quantized
+	gpu::BufferHandle quantization_buffer;
 	gpu::DataType index_type;
 	int indices_count;
 };
@@ -135,9 +168,22 @@ public:
 
 	enum class FileVersion : u32
 	{
+		FIRST,
+		FLAGS,
+		MESHLETS,
+		VERTEX_ENCODING,
+		// geometry is split to chunks per lod, from the coarsest lod to lod 0
+		LOD_CHUNKS,
 		LATEST // keep this last
 	};
 
+	enum Flags : u8 {
+		// lod 0 is rasterized by CPU occlusion culling
+		OCCLUDER = 1 << 0,
+		// only the coarsest lod is loaded with the model, finer lods are streamed when they are selected
+		STREAMED_LODS = 1 << 1
+	};
+
 	struct Bone
 	{
 		enum { MAX_COUNT = 196 };
@@ -171,6 +217,20 @@ public:
 		return 4;
 	}
 
+	// continuous lod, integer part is the lod index, fractional part is how far is the crossfade to the next lod
+	// crossfade happens in the last LOD_CROSSFADE_RANGE of each lod's distance range
+	float getLOD(float squared_distance) const {
+		for (u32 i = 0; i < MAX_LOD_COUNT; ++i) {
+			const float d = m_lod_distances[i];
+			if (squared_distance >= d) continue;
+			
+			const float fade_start = d * (1 - LOD_CROSSFADE_RANGE) * (1 - LOD_CROSSFADE_RANGE);
+			if (squared_distance <= fade_start) return float(i);
+			return i + minimum((squared_distance - fade_start) / (d - fade_start), 0.999f);
+		}
+		return float(MAX_LOD_COUNT);
+	}
+
 	Mesh& getMesh(u32 index) { return m_meshes[index]; }
 	const Mesh& getMesh(u32 index) const { return m_meshes[index]; }
 	int getMeshCount() const { return m_meshes.size(); }
@@ -191,10 +251,29 @@ public:
 	const float* getLODDistances() const { return m_lod_distances; }
 	float* getLODDistances() { return m_lod_distances; }
 	const LODMeshIndices* getLODIndices() const { return m_lod_indices; }
+	bool isOccluder() const { return m_flags.isSet(Flags::OCCLUDER); }
+
+	bool isStreamed() const { return m_flags.isSet(Flags::STREAMED_LODS); }
+	// finest lod with meshes on GPU, coarser lods are resident too
+	u32 getResidentLOD() const { return m_resident_lod; }
+	// continuous lod clamped to resident lods, missing lods are requested
+	float clampLOD(float lod) {
+		if (lod >= m_resident_lod) return lod;
+		requestLOD(u32(lod));
+		return float(m_resident_lod);
+	}
+	// can be called from any thread, the finest requested lod is streamed by renderer
+	void requestLOD(u32 lod);
+	// finest lod requested since the last call, MAX_LOD_COUNT if there was no request
+	u32 takeRequestedLOD();
+	// asynchronously loads lods from lod to the resident lod
+	bool streamLODs(u32 lod);
+	bool isStreaming() const { return m_stream_op.isValid(); }
 
 public:
 	static const u32 FILE_MAGIC = 0x5f4c4d4f; // == '_LM2'
 	static const u32 MAX_LOD_COUNT = 4;
+	static constexpr float LOD_CROSSFADE_RANGE = 0.1f;
 
 private:
 	Model(const Model&);
@@ -202,7 +281,11 @@ private:
 
 	bool parseBones(InputMemoryStream& file);
 	bool parseMeshes(InputMemoryStream& file, FileVersion version);
+	bool parseGeometry(InputMemoryStream& file, FileVersion version, i32 from_mesh, i32 to_mesh);
 	bool parseLODs(InputMemoryStream& file);
+	bool parseMeshlets(InputMemoryStream& file, i32 from_mesh, i32 to_mesh);
+	bool parseLODChunks(InputMemoryStream& file, FileVersion version, u32 finest_lod);
+	void lodsLoaded(u64 size, const u8* mem, bool success);
 	int getBoneIdx(const char* name);
 
 	void unload() override;
@@ -220,6 +303,15 @@ private:
 	BoneMap m_bone_map;
 	AABB m_aabb;
 	int m_first_nonroot_bone_index;
+	FlagSet<Flags, u8> m_flags;
+	u32 m_lod_count = 0;
+
+	u32 m_resident_lod = 0;
+	volatile i32 m_requested_lod = MAX_LOD_COUNT;
+	u32 m_stream_target_lod = 0;
+	// position of the first lod chunk in the file
+	u64 m_lod_chunks_offset = 0;
+	FileSystem::AsyncHandle m_stream_op = FileSystem::AsyncHandle::invalid();
 };
 
 
@@ -0,0 +1,197 @@
+#include "occlusion_buffer.h"
+#include "engine/allocator.h"
+#include "engine/crt.h"
+#include "engine/simd.h"
+
+
+namespace Lumix
+{
+
+
+OcclusionBuffer::OcclusionBuffer(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_triangles(allocator)
+	, m_transformed(allocator)
+{
+	m_depth = (float*)m_allocator.allocate_aligned(WIDTH * HEIGHT * sizeof(float), 16);
+}
+
+
+OcclusionBuffer::~OcclusionBuffer() {
+	m_allocator.deallocate_aligned(m_depth);
+}
+
+
+void OcclusionBuffer::begin(const Matrix& view, float x_scale, float y_scale, float near_plane) {
+	m_view = view;
+	m_x_scale = x_scale;
+	m_y_scale = y_scale;
+	m_near = near_plane;
+	m_triangles.clear();
+}
+
+
+void OcclusionBuffer::addOccluder(const Matrix& model_view, Span<const Vec3> vertices, const u8* indices, u32 index_count, bool indices16) {
+	m_transformed.resize(vertices.length());
+	for (u32 i = 0, c = vertices.length(); i < c; ++i) {
+		m_transformed[i] = model_view.transformPoint(vertices[i]);
+	}
+
+	auto toScreen = [&](const Vec3& v) {
+		const float inv_dist = 1 / -v.z;
+		return Vec3(
+			(v.x * m_x_scale * inv_dist * 0.5f + 0.5f) * WIDTH,
+			(0.5f - v.y * m_y_scale * inv_dist * 0.5f) * HEIGHT,
+			inv_dist);
+	};
+
+	const u16* indices16_ptr = (const u16*)indices;
+	const u32* indices32_ptr = (const u32*)indices;
+	for (u32 i = 0; i + 2 < index_count; i += 3) {
+		u32 idx[3];
+		for (u32 j = 0; j < 3; ++j) idx[j] = indices16 ? indices16_ptr[i + j] : indices32_ptr[i + j];
+		if (idx[0] >= (u32)m_transformed.size() || idx[1] >= (u32)m_transformed.size() || idx[2] >= (u32)m_transformed.size()) continue;
+
+		const Vec3& a = m_transformed[idx[0]];
+		const Vec3& b = m_transformed[idx[1]];
+		const Vec3& c = m_transformed[idx[2]];
+		// triangles crossing near plane would have to be clipped, skipping them only makes the occluder smaller
+		if (-a.z < m_near || -b.z < m_near || -c.z < m_near) continue;
+
+		Vec3 v0 = toScreen(a);
+		Vec3 v1 = toScreen(b);
+		Vec3 v2 = toScreen(c);
+
+		Triangle t;
+		t.min_x = minimum(v0.x, v1.x, v2.x);
+		t.min_y = minimum(v0.y, v1.y, v2.y);
+		t.max_x = maximum(v0.x, v1.x, v2.x);
+		t.max_y = maximum(v0.y, v1.y, v2.y);
+		if (t.max_x < 0 || t.max_y < 0 || t.min_x >= WIDTH || t.min_y >= HEIGHT) continue;
+
+		// occluders are rendered without backface culling, so only the winding is fixed
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+		if (area == 0) continue;
+		if (area < 0) {
+			const Vec3 tmp = v1;
+			v1 = v2;
+			v2 = tmp;
+			area = -area;
+		}
+
+		auto edge = [](const Vec3& p0, const Vec3& p1) {
+			const float a = p0.y - p1.y;
+			const float b = p1.x - p0.x;
+			return Vec3(a, b, -(a * p0.x + b * p0.y));
+		};
+		t.edges[0] = edge(v0, v1);
+		t.edges[1] = edge(v1, v2);
+		t.edges[2] = edge(v2, v0);
+
+		const float dx1 = v1.x - v0.x;
+		const float dy1 = v1.y - v0.y;
+		const float dx2 = v2.x - v0.x;
+		const float dy2 = v2.y - v0.y;
+		const float dz1 = v1.z - v0.z;
+		const float dz2 = v2.z - v0.z;
+		const float zx = (dz1 * dy2 - dy1 * dz2) / area;
+		const float zy = (dx1 * dz2 - dz1 * dx2) / area;
+		t.depth = Vec3(zx, zy, v0.z - zx * v0.x - zy * v0.y);
+
+		m_triangles.push(t);
+	}
+}
+
+
+void OcclusionBuffer::rasterize(u32 from_row, u32 to_row) {
+	to_row = minimum(to_row, HEIGHT);
+	if (from_row >= to_row) return;
+	memset(m_depth + from_row * WIDTH, 0, (to_row - from_row) * WIDTH * sizeof(float));
+
+	alignas(16) static const float x_offsets[] = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const float4 offsets = f4Load(x_offsets);
+	const float4 zero = f4Splat(0);
+	// turns positive edge distance to a big number, so covered = min(depth, max(0, edge * BIG)) without masks
+	const float4 big = f4Splat(1e6f);
+
+	for (const Triangle& t : m_triangles) {
+		const i32 y0 = maximum((i32)floorf(t.min_y), (i32)from_row);
+		const i32 y1 = minimum((i32)floorf(t.max_y), (i32)to_row - 1);
+		const i32 x0 = maximum((i32)floorf(t.min_x), 0) & ~3;
+		const i32 x1 = minimum((i32)floorf(t.max_x), (i32)WIDTH - 1);
+		if (y0 > y1 || x0 > x1) continue;
+
+		const float4 e0_step = f4Splat(t.edges[0].x * 4);
+		const float4 e1_step = f4Splat(t.edges[1].x * 4);
+		const float4 e2_step = f4Splat(t.edges[2].x * 4);
+		const float4 z_step = f4Splat(t.depth.x * 4);
+		const float4 xs = f4Add(f4Splat((float)x0), offsets);
+		const float4 e0_x = f4Mul(xs, f4Splat(t.edges[0].x));
+		const float4 e1_x = f4Mul(xs, f4Splat(t.edges[1].x));
+		const float4 e2_x = f4Mul(xs, f4Splat(t.edges[2].x));
+		const float4 z_x = f4Mul(xs, f4Splat(t.depth.x));
+
+		for (i32 y = y0; y <= y1; ++y) {
+			const float py = y + 0.5f;
+			float4 e0 = f4Add(e0_x, f4Splat(t.edges[0].y * py + t.edges[0].z));
+			float4 e1 = f4Add(e1_x, f4Splat(t.edges[1].y * py + t.edges[1].z));
+			float4 e2 = f4Add(e2_x, f4Splat(t.edges[2].y * py + t.edges[2].z));
+			float4 z = f4Add(z_x, f4Splat(t.depth.y * py + t.depth.z));
+			float* LUMIX_RESTRICT row = m_depth + y * WIDTH;
+			for (i32 x = x0; x <= x1; x += 4) {
+				const float4 inside = f4Min(e0, f4Min(e1, e2));
+				const float4 covered = f4Min(z, f4Max(zero, f4Mul(inside, big)));
+				f4Store(row + x, f4Max(f4Load(row + x), covered));
+				e0 = f4Add(e0, e0_step);
+				e1 = f4Add(e1, e1_step);
+				e2 = f4Add(e2, e2_step);
+				z = f4Add(z, z_step);
+			}
+		}
+	}
+}
+
+
+bool OcclusionBuffer::isVisible(const Vec3& pos, float radius) const {
+	const Vec3 center = m_view.transformPoint(pos);
+	const float dist = -center.z;
+	const float near_dist = dist - radius;
+	if (near_dist < m_near) return true;
+	const float far_dist = dist + radius;
+
+	// screen space bounds of the sphere's view space box
+	auto project = [&](float v, float& out_min, float& out_max) {
+		const float lo = v - radius;
+		const float hi = v + radius;
+		out_min = lo >= 0 ? lo / far_dist : lo / near_dist;
+		out_max = hi >= 0 ? hi / near_dist : hi / far_dist;
+	};
+	float min_x, max_x, min_y, max_y;
+	project(center.x, min_x, max_x);
+	project(center.y, min_y, max_y);
+
+	const float px0 = (min_x * m_x_scale * 0.5f + 0.5f) * WIDTH;
+	const float px1 = (max_x * m_x_scale * 0.5f + 0.5f) * WIDTH;
+	const float py0 = (0.5f - max_y * m_y_scale * 0.5f) * HEIGHT;
+	const float py1 = (0.5f - min_y * m_y_scale * 0.5f) * HEIGHT;
+	if (px1 < 0 || py1 < 0 || px0 >= WIDTH || py0 >= HEIGHT) return true;
+
+	const i32 x0 = maximum((i32)floorf(px0), 0) & ~3;
+	const i32 x1 = minimum((i32)floorf(px1), (i32)WIDTH - 1);
+	const i32 y0 = maximum((i32)floorf(py0), 0);
+	const i32 y1 = minimum((i32)floorf(py1), (i32)HEIGHT - 1);
+
+	// visible if any pixel of occluders is farther than the nearest point of the sphere
+	// pixels right of x1 in the last 4 are tested too, it only makes the test more conservative
+	const float4 nearest = f4Splat(1 / near_dist);
+	for (i32 y = y0; y <= y1; ++y) {
+		const float* LUMIX_RESTRICT row = m_depth + y * WIDTH;
+		for (i32 x = x0; x <= x1; x += 4) {
+			if (f4MoveMask(f4CmpLT(f4Load(row + x), nearest))) return true;
+		}
+	}
+	return false;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,51 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/math.h"
+
+
+namespace Lumix
+{
+
+
+// low resolution depth buffer rasterized on CPU from a few authored occluders
+// renderables completely hidden behind occluders can be culled before any draw call is created
+struct LUMIX_RENDERER_API OcclusionBuffer {
+	static constexpr u32 WIDTH = 256;
+	static constexpr u32 HEIGHT = 128;
+
+	explicit OcclusionBuffer(IAllocator& allocator);
+	~OcclusionBuffer();
+
+	// view is relative to camera, x_scale and y_scale are projection.columns[0].x and projection.columns[1].y
+	void begin(const Matrix& view, float x_scale, float y_scale, float near_plane);
+	// model_view transforms vertices to view space
+	void addOccluder(const Matrix& model_view, Span<const Vec3> vertices, const u8* indices, u32 index_count, bool indices16);
+	// clears and rasterizes rows [from_row, to_row), different rows can be rasterized on different workers
+	void rasterize(u32 from_row, u32 to_row);
+	// pos is relative to camera, call after all rows are rasterized
+	bool isVisible(const Vec3& pos, float radius) const;
+	u32 getTriangleCount() const { return m_triangles.size(); }
+
+private:
+	// in pixels, edge functions are positive inside
+	struct Triangle {
+		float min_x, min_y, max_x, max_y;
+		Vec3 edges[3];
+		// depth plane, depth is 1 / view space distance so it's linear in screen space
+		Vec3 depth;
+	};
+
+	IAllocator& m_allocator;
+	float* m_depth;
+	Array<Triangle> m_triangles;
+	Array<Vec3> m_transformed;
+	Matrix m_view;
+	float m_x_scale = 1;
+	float m_y_scale = 1;
+	float m_near = 0.1f;
+};
+
+
+} // namespace Lumix
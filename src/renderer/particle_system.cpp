@@ -12,8 +12,12 @@
 #include "engine/stream.h"
 #include "editor/gizmo.h"
 #include "editor/world_editor.h"
+#include "engine/string.h"
+#include "renderer/draw_stream.h"
 #include "renderer/material.h"
+#include "renderer/pipeline.h"
 #include "renderer/render_scene.h"
+#include "renderer/renderer.h"
 #include "engine/universe.h"
 
 
@@ -23,6 +27,13 @@ namespace Lumix
 using DataStream = ParticleEmitterResource::DataStream;
 using InstructionType = ParticleEmitterResource::InstructionType;
 
+// number of particles processed by a single job, each register has one value per particle in a chunk
+static constexpr u32 CHUNK_SIZE = 1024;
+static constexpr u32 CHUNK_SIZE_F4 = CHUNK_SIZE / 4;
+
+// Array<float4> would drop __m128's alignment attribute on gcc (-Wignored-attributes)
+struct alignas(16) Register { float4 value; };
+
 const ResourceType ParticleEmitterResource::TYPE = ResourceType("particle_emitter");
 
 
@@ -31,13 +42,27 @@ ParticleEmitterResource::ParticleEmitterResource(const Path& path
 	, Renderer& renderer
 	, IAllocator& allocator)
 	: Resource(path, manager, allocator)
+	, m_renderer(renderer)
 	, m_instructions(allocator)
 	, m_material(nullptr)
 	, m_vertex_decl(gpu::PrimitiveType::TRIANGLE_STRIP)
+	, m_compute_source(allocator)
 {
 }
 
 
+ParticleEmitterResource::~ParticleEmitterResource() {
+	destroyComputeProgram();
+}
+
+
+void ParticleEmitterResource::destroyComputeProgram() {
+	if (!m_compute_program) return;
+	m_renderer.getEndFrameDrawStream().destroy(m_compute_program);
+	m_compute_program = gpu::INVALID_PROGRAM;
+}
+
+
 void ParticleEmitterResource::unload()
 {
 	if (m_material) {
@@ -47,6 +72,8 @@ void ParticleEmitterResource::unload()
 		tmp->decRefCount();
 	}
 	m_instructions.clear();
+	m_compute_source.clear();
+	destroyComputeProgram();
 }
 
 
@@ -55,7 +82,9 @@ void ParticleEmitterResource::overrideData(OutputMemoryStream&& instructions,
 	u32 output_offset,
 	u32 channels_count,
 	u32 registers_count,
-	u32 outputs_count
+	u32 outputs_count,
+	bool gpu,
+	u32 max_gpu_particles
 )
 {
 	++m_empty_dep_count;
@@ -67,6 +96,9 @@ void ParticleEmitterResource::overrideData(OutputMemoryStream&& instructions,
 	m_channels_count = channels_count;
 	m_registers_count = registers_count;
 	m_outputs_count = outputs_count;
+	m_gpu = gpu;
+	m_max_gpu_particles = max_gpu_particles;
+	generateComputeSource();
 	
 	--m_empty_dep_count;
 	checkState();
@@ -122,10 +154,272 @@ bool ParticleEmitterResource::load(u64 size, const u8* mem) {
 	blob.read(m_registers_count);
 	blob.read(m_outputs_count);
 
+	m_gpu = false;
+	m_max_gpu_particles = 0;
+	if (header.version > Version::GPU) {
+		blob.read(m_gpu);
+		blob.read(m_max_gpu_particles);
+	}
+	m_lod = {};
+	if (header.version > Version::LOD) {
+		blob.read(m_lod);
+	}
+	generateComputeSource();
+
 	return true;
 }
 
 
+static void writeGLSL(OutputMemoryStream& out, const char* str) {
+	out.write(str, stringLength(str));
+}
+
+
+// expression for `stream`, particle data are accessed through CH and OUT macros, which are defined differently in each section
+static void writeGLSL(OutputMemoryStream& out, DataStream stream) {
+	StaticString<64> tmp;
+	switch (stream.type) {
+		case DataStream::CHANNEL: tmp << "CH(" << u32(stream.index) << ")"; break;
+		case DataStream::OUT: tmp << "OUT(" << u32(stream.index) << ")"; break;
+		case DataStream::REGISTER: tmp << "r" << u32(stream.index); break;
+		case DataStream::CONST: tmp << "u_consts[" << u32(stream.index / 4) << "][" << u32(stream.index % 4) << "]"; break;
+		case DataStream::LITERAL: {
+			// bit exact, printing floats as decimal strings loses precision
+			u32 bits;
+			memcpy(&bits, &stream.value, sizeof(bits));
+			tmp << "uintBitsToFloat(" << bits << "u)";
+			break;
+		}
+		case DataStream::NONE: tmp << "0.0"; break;
+	}
+	writeGLSL(out, tmp);
+}
+
+
+static void writeGLSL(OutputMemoryStream& out, float value) {
+	DataStream stream;
+	stream.type = DataStream::LITERAL;
+	stream.value = value;
+	writeGLSL(out, stream);
+}
+
+
+// translates one section of instructions (until END) to GLSL statements, returns false on instructions without GPU support
+static bool generateGLSL(InputMemoryStream& ip, OutputMemoryStream& out) {
+	for (;;) {
+		const InstructionType type = ip.read<InstructionType>();
+		switch (type) {
+			case InstructionType::END: return true;
+			case InstructionType::ADD:
+			case InstructionType::SUB:
+			case InstructionType::MUL:
+			case InstructionType::DIV: {
+				const DataStream dst = ip.read<DataStream>();
+				const DataStream op0 = ip.read<DataStream>();
+				const DataStream op1 = ip.read<DataStream>();
+				const char* op = " + ";
+				switch (type) {
+					case InstructionType::SUB: op = " - "; break;
+					case InstructionType::MUL: op = " * "; break;
+					case InstructionType::DIV: op = " / "; break;
+					default: break;
+				}
+				writeGLSL(out, "\t"); writeGLSL(out, dst); writeGLSL(out, " = ");
+				writeGLSL(out, op0); writeGLSL(out, op); writeGLSL(out, op1); writeGLSL(out, ";\n");
+				break;
+			}
+			case InstructionType::MULTIPLY_ADD:
+			case InstructionType::MIX: {
+				const DataStream dst = ip.read<DataStream>();
+				const DataStream op0 = ip.read<DataStream>();
+				const DataStream op1 = ip.read<DataStream>();
+				const DataStream op2 = ip.read<DataStream>();
+				writeGLSL(out, "\t"); writeGLSL(out, dst); writeGLSL(out, " = ");
+				if (type == InstructionType::MIX) {
+					writeGLSL(out, "mix("); writeGLSL(out, op0); writeGLSL(out, ", "); writeGLSL(out, op1);
+					writeGLSL(out, ", "); writeGLSL(out, op2); writeGLSL(out, ");\n");
+				}
+				else {
+					writeGLSL(out, op0); writeGLSL(out, " * "); writeGLSL(out, op1);
+					writeGLSL(out, " + "); writeGLSL(out, op2); writeGLSL(out, ";\n");
+				}
+				break;
+			}
+			case InstructionType::SIN:
+			case InstructionType::COS:
+			case InstructionType::MOV: {
+				const DataStream dst = ip.read<DataStream>();
+				const DataStream op0 = ip.read<DataStream>();
+				writeGLSL(out, "\t"); writeGLSL(out, dst); writeGLSL(out, " = ");
+				if (type == InstructionType::SIN) writeGLSL(out, "sin(");
+				else if (type == InstructionType::COS) writeGLSL(out, "cos(");
+				else writeGLSL(out, "(");
+				writeGLSL(out, op0); writeGLSL(out, ");\n");
+				break;
+			}
+			case InstructionType::RAND: {
+				const DataStream dst = ip.read<DataStream>();
+				const float from = ip.read<float>();
+				const float to = ip.read<float>();
+				writeGLSL(out, "\t"); writeGLSL(out, dst); writeGLSL(out, " = mix(");
+				writeGLSL(out, from); writeGLSL(out, ", "); writeGLSL(out, to); writeGLSL(out, ", randFloat());\n");
+				break;
+			}
+			case InstructionType::GRADIENT: {
+				const DataStream dst = ip.read<DataStream>();
+				const DataStream op0 = ip.read<DataStream>();
+				const u32 count = ip.read<u32>();
+				float keys[8];
+				float values[8];
+				if (count == 0 || count > lengthOf(keys)) return false;
+				ip.read(keys, sizeof(keys[0]) * count);
+				ip.read(values, sizeof(values[0]) * count);
+				
+				writeGLSL(out, "\t{\n\t\tfloat t = "); writeGLSL(out, op0); writeGLSL(out, ";\n");
+				writeGLSL(out, "\t\tfloat g = "); writeGLSL(out, values[count - 1]); writeGLSL(out, ";\n");
+				writeGLSL(out, "\t\tif (t < "); writeGLSL(out, keys[0]); writeGLSL(out, ") g = "); writeGLSL(out, values[0]); writeGLSL(out, ";\n");
+				for (u32 k = 1; k < count; ++k) {
+					writeGLSL(out, "\t\telse if (t < "); writeGLSL(out, keys[k]); writeGLSL(out, ") g = mix(");
+					writeGLSL(out, values[k - 1]); writeGLSL(out, ", "); writeGLSL(out, values[k]); writeGLSL(out, ", (t - ");
+					writeGLSL(out, keys[k - 1]); writeGLSL(out, ") / "); writeGLSL(out, keys[k] - keys[k - 1]); writeGLSL(out, ");\n");
+				}
+				writeGLSL(out, "\t\t"); writeGLSL(out, dst); writeGLSL(out, " = g;\n\t}\n");
+				break;
+			}
+			case InstructionType::LT:
+			case InstructionType::GT: {
+				const DataStream op0 = ip.read<DataStream>();
+				const DataStream op1 = ip.read<DataStream>();
+				if (ip.read<InstructionType>() != InstructionType::KILL) return false;
+				writeGLSL(out, "\tif ("); writeGLSL(out, op0); writeGLSL(out, type == InstructionType::LT ? " < " : " > ");
+				writeGLSL(out, op1); writeGLSL(out, ") return false;\n");
+				break;
+			}
+			default: return false;
+		}
+	}
+}
+
+
+void ParticleEmitterResource::generateComputeSource() {
+	m_compute_source.clear();
+	destroyComputeProgram();
+	if (!m_gpu) return;
+
+	OutputMemoryStream& out = m_compute_source;
+	StaticString<256> defines("#define CHANNELS ", m_channels_count, "\n#define OUTPUTS ", m_outputs_count, "\n");
+	writeGLSL(out, defines);
+	writeGLSL(out, R"#(
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+// channels are stored as structure of arrays, u_capacity floats per channel
+layout(std430, binding = 0) buffer Src { float b_src[]; };
+layout(std430, binding = 1) buffer Dst { float b_dst[]; };
+layout(std430, binding = 2) writeonly buffer Instances { float b_instances[]; };
+layout(std430, binding = 3) buffer Counters {
+	uint b_count;
+	uint b_new_count;
+	uint b_indirect[5]; // indices count, instances count, first index, base vertex, base instance
+};
+
+layout(std140, binding = 4) uniform Data {
+	vec4 u_consts[4];
+	uint u_capacity;
+	uint u_emit_count;
+	uint u_pass;
+	uint u_seed;
+};
+
+uint g_rng;
+
+uint hash(uint x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float randFloat() {
+	g_rng = hash(g_rng);
+	return float(g_rng >> 8) / 16777216.0;
+}
+
+#define CH(c) b_src[u_capacity * (c) + id]
+bool update(uint id) {
+)#");
+	
+	StaticString<1024> registers;
+	for (u32 i = 0; i < m_registers_count; ++i) {
+		registers << "\tfloat r" << i << " = 0;\n";
+	}
+	writeGLSL(out, registers);
+
+	InputMemoryStream ip(m_instructions);
+	bool valid = generateGLSL(ip, out);
+	writeGLSL(out, "\treturn true;\n}\n#undef CH\n#define CH(c) b_dst[u_capacity * (c) + id]\n#define OUT(o) b_instances[id * OUTPUTS + (o)]\n\nvoid emit(uint id) {\n");
+	writeGLSL(out, registers);
+	ip.setPosition(m_emit_offset);
+	valid = valid && generateGLSL(ip, out);
+	writeGLSL(out, "}\n\nvoid output(uint id) {\n");
+	writeGLSL(out, registers);
+	ip.setPosition(m_output_offset);
+	valid = valid && generateGLSL(ip, out);
+	writeGLSL(out, R"#(}
+
+void main() {
+	uint id = gl_GlobalInvocationID.x;
+	if (u_pass == 0) {
+		if (id == 0) b_new_count = 0;
+	}
+	else if (u_pass == 1) {
+		// update alive particles and compact them to destination buffer
+		if (id >= b_count) return;
+		g_rng = hash(id ^ u_seed);
+		if (!update(id)) return;
+		uint dst = atomicAdd(b_new_count, 1);
+		for (uint c = 0; c < CHANNELS; ++c) {
+			b_dst[u_capacity * c + dst] = b_src[u_capacity * c + id];
+		}
+		output(dst);
+	}
+	else if (u_pass == 2) {
+		// emit, particles which do not fit are dropped
+		if (id >= u_emit_count) return;
+		uint dst = atomicAdd(b_new_count, 1);
+		if (dst >= u_capacity) return;
+		g_rng = hash(id ^ hash(u_seed));
+		emit(dst);
+		output(dst);
+	}
+	else if (id == 0) {
+		b_count = min(b_new_count, u_capacity);
+		b_indirect[1] = b_count;
+	}
+}
+)#");
+	out.write('\0');
+
+	if (!valid) {
+		logError(getPath(), ": unsupported instruction for GPU simulation, emitter will be simulated on CPU");
+		m_compute_source.clear();
+		m_gpu = false;
+	}
+}
+
+
+gpu::ProgramHandle ParticleEmitterResource::getComputeProgram(DrawStream& stream) {
+	if (m_compute_program || m_compute_source.empty()) return m_compute_program;
+	
+	m_compute_program = gpu::allocProgramHandle();
+	const char* src = (const char*)m_compute_source.data();
+	const gpu::ShaderType type = gpu::ShaderType::COMPUTE;
+	stream.createProgram(m_compute_program, gpu::StateFlags::NONE, gpu::VertexDecl(gpu::PrimitiveType::NONE), &src, &type, 1, nullptr, 0, getPath().c_str());
+	return m_compute_program;
+}
+
+
 ParticleEmitter::ParticleEmitter(EntityPtr entity, IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_entity(entity)
@@ -138,12 +432,17 @@ ParticleEmitter::ParticleEmitter(ParticleEmitter&& rhs)
 	, m_emit_buffer(static_cast<OutputMemoryStream&&>(rhs.m_emit_buffer))
 	, m_capacity(rhs.m_capacity)
 	, m_emit_timer(rhs.m_emit_timer)
+	, m_lod_dt(rhs.m_lod_dt)
+	, m_lod_frame(rhs.m_lod_frame)
+	, m_offscreen_time(rhs.m_offscreen_time)
 	, m_resource(rhs.m_resource)
 	, m_entity(rhs.m_entity)
 	, m_emit_rate(rhs.m_emit_rate)
 	, m_particles_count(rhs.m_particles_count)
 	, m_autodestroy(rhs.m_autodestroy)
+	, m_gpu(rhs.m_gpu)
 {
+	rhs.m_gpu = {};
 	memcpy(m_channels, rhs.m_channels, sizeof(m_channels));
 	memcpy(m_constants, rhs.m_constants, sizeof(m_constants));
 	memset(rhs.m_channels, 0, sizeof(rhs.m_channels));
@@ -162,6 +461,19 @@ ParticleEmitter::~ParticleEmitter()
 	for (const Channel& c : m_channels) {
 		m_allocator.deallocate_aligned(c.data);
 	}
+	releaseGPUData();
+}
+
+void ParticleEmitter::releaseGPUData() {
+	if (!m_gpu.renderer) return;
+
+	DrawStream& stream = m_gpu.renderer->getEndFrameDrawStream();
+	stream.destroy(m_gpu.channels[0]);
+	stream.destroy(m_gpu.channels[1]);
+	stream.destroy(m_gpu.instances);
+	stream.destroy(m_gpu.counters);
+	stream.destroy(m_gpu.indices);
+	m_gpu = {};
 }
 
 void ParticleEmitter::onResourceChanged(Resource::State old_state, Resource::State new_state, Resource&) {
@@ -172,6 +484,7 @@ void ParticleEmitter::onResourceChanged(Resource::State old_state, Resource::Sta
 		m_allocator.deallocate_aligned(c.data);
 		c.data = nullptr;
 	}
+	releaseGPUData();
 }
 
 void ParticleEmitter::setResource(ParticleEmitterResource* res)
@@ -207,6 +520,12 @@ float ParticleEmitter::readSingleValue(InputMemoryStream& blob) const
 
 void ParticleEmitter::emit(const float* args)
 {
+	if (m_resource->isGPU()) {
+		// emitted in simulateGPU
+		++m_gpu.emit_count;
+		return;
+	}
+
 	if (m_particles_count == m_capacity) {
 		const u32 channels_count = m_resource->getChannelsCount();
 		u32 new_capacity = maximum(16, m_capacity << 1);
@@ -275,7 +594,7 @@ static float4* getStream(const ParticleEmitter& emitter
 {
 	switch (stream.type) {
 		case DataStream::CHANNEL: return (float4*)emitter.getChannelData(stream.index) + offset;
-		case DataStream::REGISTER: return register_mem + 256 * stream.index;
+		case DataStream::REGISTER: return register_mem + CHUNK_SIZE_F4 * stream.index;
 		default: ASSERT(false); return nullptr;
 	}
 }
@@ -319,7 +638,7 @@ struct RegisterGetter {
 	RegisterGetter(DataStream stream) : stream(stream) {}
 
 	float4* get(const ParticleEmitter& emitter, i32, i32 stepf4, float4* reg_mem) {
-		return reg_mem + 256 * stream.index;
+		return reg_mem + CHUNK_SIZE_F4 * stream.index;
 	}
 
 	static void step(float4*& val) { ++val; }
@@ -377,7 +696,7 @@ struct BinaryHelper {
 
 struct TernaryHelper {
 	static float4 madd(float4 a, float4 b, float4 c) {
-		return f4Add(f4Mul(a, b), c);
+		return f4MulAdd(a, b, c);
 	}
 
 	static float4 mix(float4 a, float4 b, float4 c) {
@@ -435,19 +754,43 @@ struct TernaryHelper {
 };
 
 
-bool ParticleEmitter::update(float dt, PageAllocator& allocator)
+bool ParticleEmitter::update(float dt, PageAllocator& allocator) {
+	return update(dt, allocator, 0, true, true);
+}
+
+
+bool ParticleEmitter::update(float dt, PageAllocator& allocator, float distance, bool visible, bool can_emit)
 {
 	if (!m_resource || !m_resource->isReady()) return false;
 	
-	if (m_emit_rate > 0) {
+	const ParticleEmitterResource::LOD& lod = m_resource->getLOD();
+	m_offscreen_time = visible ? 0 : m_offscreen_time + dt;
+	if (lod.offscreen_timeout >= 0 && m_offscreen_time > lod.offscreen_timeout) return false;
+
+	const bool is_far = lod.distance > 0 && distance > lod.distance;
+	m_lod_dt += dt;
+	++m_lod_frame;
+	if (is_far && m_lod_frame < lod.update_interval) return false;
+	dt = m_lod_dt;
+	m_lod_dt = 0;
+	m_lod_frame = 0;
+
+	const float emit_rate = is_far ? m_emit_rate * lod.emit_rate_scale : (float)m_emit_rate;
+	if (can_emit && emit_rate > 0) {
 		m_emit_timer += dt;
-		const float d = 1.f / m_emit_rate;
+		const float d = 1.f / emit_rate;
 		while(m_emit_timer > 0) {
 			emit(nullptr);
 			m_emit_timer -= d;
 		}
 	}
 
+	if (m_resource->isGPU()) {
+		m_constants[0] = dt;
+		m_gpu.simulate = true;
+		return false;
+	}
+
 	if (m_particles_count == 0) return false;
 
 	profiler::pushInt("particle count", m_particles_count);
@@ -457,16 +800,17 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 	volatile i32 kill_counter = 0;
 
 	volatile i32 counter = 0;
-	jobs::runOnWorkers([&](){
+	auto simulate = [&](){
 		PROFILE_FUNCTION();
-		Array<float4> reg_mem(m_allocator);
-		reg_mem.resize(m_resource->getRegistersCount() * 256);
+		Array<Register> registers(m_allocator);
+		registers.resize(m_resource->getRegistersCount() * CHUNK_SIZE_F4);
+		float4* reg_mem = (float4*)registers.begin();
 		for (;;) {
-			const i32 from = atomicAdd(&counter, 1024);
+			const i32 from = atomicAdd(&counter, CHUNK_SIZE);
 			if (from >= (i32)m_particles_count) return;
 
 			const i32 fromf4 = from / 4;
-			const i32 stepf4 = minimum(1024, m_particles_count - from + 3) / 4;
+			const i32 stepf4 = minimum(CHUNK_SIZE, m_particles_count - from + 3) / 4;
 			InputMemoryStream ip = InputMemoryStream(m_resource->getInstructions());
 			InstructionType itype = ip.read<InstructionType>();
 
@@ -476,12 +820,12 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::GT: {
 						DataStream dst = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float4* arg0 = getStream(*this, dst, fromf4, reg_mem.begin());
+						const float4* arg0 = getStream(*this, dst, fromf4, reg_mem);
 						const float4* end = arg0 + stepf4;
 						const InstructionType inner_type = ip.read<InstructionType>();
 
 						auto helper = [&](auto f, auto arg1_getter){
-							float4* arg1 = arg1_getter.get(*this, fromf4, stepf4, reg_mem.begin());
+							float4* arg1 = arg1_getter.get(*this, fromf4, stepf4, reg_mem);
 							for (const float4* beg = arg0; arg0 != end; ++arg0) {
 								const float4 tmp = f(*arg0, *arg1);
 								const int m = f4MoveMask(tmp);
@@ -539,25 +883,27 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Mul>(dst, ip);
+						break;
 					}
 					case InstructionType::DIV: {
 						BinaryHelper helper;
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Div>(dst, ip);
+						break;
 					}
 					case InstructionType::MULTIPLY_ADD: {
 						TernaryHelper helper;
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::madd>(dst, ip);
 						break;
@@ -567,7 +913,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						const DataStream dst = ip.read<DataStream>();
 						helper.run<f4Add>(dst, ip);
 						break;
@@ -575,7 +921,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::MOV: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						float4* result = getStream(*this, dst, fromf4, reg_mem.begin());
+						float4* result = getStream(*this, dst, fromf4, reg_mem);
 						const float4* const end = result + stepf4;
 				
 						if (op0.type == DataStream::CONST) {
@@ -586,7 +932,7 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 							}
 						}
 						else {
-							const float4* src = getStream(*this, op0, fromf4, reg_mem.begin());
+							const float4* src = getStream(*this, op0, fromf4, reg_mem);
 
 							for (; result != end; ++result, ++src) {
 								*result = *src;
@@ -598,8 +944,8 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::COS: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
-						float* result = (float*)getStream(*this, dst, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
+						float* result = (float*)getStream(*this, dst, fromf4, reg_mem);
 						const float* const end = result + stepf4 * 4;
 
 						for (; result != end; ++result, ++arg) {
@@ -610,8 +956,8 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 					case InstructionType::SIN: {
 						const DataStream dst = ip.read<DataStream>();
 						const DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
-						float* result = (float*)getStream(*this, dst, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
+						float* result = (float*)getStream(*this, dst, fromf4, reg_mem);
 						const float* const end = result + stepf4 * 4;
 
 						for (; result != end; ++result, ++arg) {
@@ -626,7 +972,11 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 				itype = ip.read<InstructionType>();
 			}
 		}
-	});
+	};
+
+	// small emitters are not worth the job overhead, many of them are updated in parallel by the scene
+	if (m_particles_count > CHUNK_SIZE) jobs::runOnWorkers(simulate);
+	else simulate();
 
 	if (kill_counter > 0) {
 		ASSERT(kill_counter <= (i32)m_particles_count);
@@ -655,6 +1005,78 @@ bool ParticleEmitter::update(float dt, PageAllocator& allocator)
 }
 
 
+void ParticleEmitter::simulateGPU(Renderer& renderer) {
+	if (!m_resource || !m_resource->isReady() || !m_resource->isGPU()) return;
+	if (!m_gpu.simulate) return;
+	m_gpu.simulate = false;
+
+	DrawStream& stream = renderer.getDrawStream();
+	const gpu::ProgramHandle program = m_resource->getComputeProgram(stream);
+	if (!program) return;
+
+	const gpu::BufferFlags flags = gpu::BufferFlags::SHADER_BUFFER | gpu::BufferFlags::COMPUTE_WRITE;
+	if (!m_gpu.renderer) {
+		m_gpu.renderer = &renderer;
+		m_gpu.capacity = maximum(m_resource->getMaxGPUParticles(), 1);
+		
+		Renderer::MemRef mem;
+		mem.own = false;
+		mem.data = nullptr;
+		mem.size = maximum(m_gpu.capacity * m_resource->getChannelsCount() * (u32)sizeof(float), 16);
+		m_gpu.channels[0] = renderer.createBuffer(mem, flags);
+		m_gpu.channels[1] = renderer.createBuffer(mem, flags);
+		mem.size = maximum(m_gpu.capacity * m_resource->getOutputsCount() * (u32)sizeof(float), 16);
+		m_gpu.instances = renderer.createBuffer(mem, flags);
+		
+		// count, new count, DrawElementsIndirect command
+		const u32 counters[] = { 0, 0, 4, 0, 0, 0, 0 };
+		m_gpu.counters = renderer.createBuffer(renderer.copy(counters, sizeof(counters)), flags);
+		const u16 indices[] = { 0, 1, 2, 3 };
+		m_gpu.indices = renderer.createBuffer(renderer.copy(indices, sizeof(indices)), gpu::BufferFlags::IMMUTABLE);
+	}
+
+	struct {
+		float consts[16];
+		u32 capacity;
+		u32 emit_count;
+		u32 pass;
+		u32 seed;
+	} ub_data;
+	static_assert(sizeof(ub_data.consts) == sizeof(m_constants));
+	memcpy(ub_data.consts, m_constants, sizeof(m_constants));
+	ub_data.capacity = m_gpu.capacity;
+	ub_data.emit_count = minimum(m_gpu.emit_count, m_gpu.capacity);
+	ub_data.seed = rand();
+	m_gpu.emit_count = 0;
+
+	stream.useProgram(program);
+	stream.bindShaderBuffer(m_gpu.channels[m_gpu.current], 0, gpu::BindShaderBufferFlags::OUTPUT);
+	stream.bindShaderBuffer(m_gpu.channels[1 - m_gpu.current], 1, gpu::BindShaderBufferFlags::OUTPUT);
+	stream.bindShaderBuffer(m_gpu.instances, 2, gpu::BindShaderBufferFlags::OUTPUT);
+	stream.bindShaderBuffer(m_gpu.counters, 3, gpu::BindShaderBufferFlags::OUTPUT);
+
+	auto pass = [&](u32 idx, u32 threads) {
+		ub_data.pass = idx;
+		const Renderer::TransientSlice ub = renderer.allocUniform(&ub_data, sizeof(ub_data));
+		stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+		stream.dispatch((threads + 255) / 256, 1, 1);
+		stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, m_gpu.counters);
+	};
+
+	pass(0, 1);
+	// alive count is known only on GPU
+	pass(1, m_gpu.capacity);
+	if (ub_data.emit_count > 0) pass(2, ub_data.emit_count);
+	pass(3, 1);
+	stream.memoryBarrier(gpu::MemoryBarrierType::COMMAND | gpu::MemoryBarrierType::VERTEX, m_gpu.instances);
+
+	for (u32 i = 0; i < 4; ++i) {
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, i, gpu::BindShaderBufferFlags::NONE);
+	}
+	m_gpu.current = 1 - m_gpu.current;
+}
+
+
 u32 ParticleEmitter::getParticlesDataSizeBytes() const
 {
 	return m_resource ? ((m_particles_count + 3) & ~3) * m_resource->getOutputsCount() * sizeof(float) : 0;
@@ -665,15 +1087,16 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 	if (m_particles_count == 0) return;
 
 	volatile i32 counter = 0;
-	jobs::runOnWorkers([&](){
+	auto fill = [&](){
 		PROFILE_FUNCTION();
-		Array<float4> reg_mem(m_allocator);
-		reg_mem.resize(m_resource->getRegistersCount() * 256);
+		Array<Register> registers(m_allocator);
+		registers.resize(m_resource->getRegistersCount() * CHUNK_SIZE_F4);
+		float4* reg_mem = (float4*)registers.begin();
 		for (;;) {
-			const u32 from = (u32)atomicAdd(&counter, 1024);
+			const u32 from = (u32)atomicAdd(&counter, CHUNK_SIZE);
 			if (from >= m_particles_count) return;
 			const u32 fromf4 = from / 4;
-			const u32 stepf4 = minimum(1024, m_particles_count - from + 3) / 4;
+			const u32 stepf4 = minimum(CHUNK_SIZE, m_particles_count - from + 3) / 4;
 
 			InputMemoryStream ip(m_resource->getInstructions());
 			ip.skip(m_resource->getOutputOffset());
@@ -684,7 +1107,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 					case InstructionType::SIN: {
 						DataStream dst_stream = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						
 						if (dst_stream.type == DataStream::OUT) {
 							u8 output_idx = dst_stream.index;
@@ -695,7 +1118,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem.begin());
+							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem);
 							const float* const end = result + stepf4 * 4;
 
 							for (; result != end; ++result, ++arg) {
@@ -707,7 +1130,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 					case InstructionType::COS: {
 						DataStream dst_stream = ip.read<DataStream>();
 						DataStream op0 = ip.read<DataStream>();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						if (dst_stream.type == DataStream::OUT) {
 							i32 output_idx = dst_stream.index;
 							const u32 stride = m_resource->getOutputsCount();
@@ -717,7 +1140,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem.begin());
+							float* result = (float*)getStream(*this, dst_stream, fromf4, reg_mem);
 							const float* const end = result + stepf4 * 4;
 
 							for (; result != end; ++result, ++arg) {
@@ -731,7 +1154,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::madd>(dst, ip);
@@ -742,7 +1165,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<TernaryHelper::mix>(dst, ip);
@@ -753,7 +1176,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Mul>(dst, ip);
@@ -764,7 +1187,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Div>(dst, ip);
@@ -775,7 +1198,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						helper.emitter = this;
 						helper.fromf4 = fromf4;
 						helper.stepf4 = stepf4;
-						helper.reg_mem = reg_mem.begin();
+						helper.reg_mem = reg_mem;
 						helper.out_mem = data;
 						DataStream dst = ip.read<DataStream>();
 						helper.run<f4Add>(dst, ip);
@@ -793,7 +1216,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 						ASSERT(dst.type == DataStream::OUT);
 						const u8 output_idx = dst.index;
 						const u32 stride = m_resource->getOutputsCount();
-						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+						const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 						float* out = data + output_idx + fromf4 * 4 * stride;
 						for (u32 i = 0, j = 0; i < stepf4 * 4; ++i, j += stride) {
 							if (arg[i] < keys[0]) {
@@ -830,7 +1253,7 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 							}
 						}
 						else {
-							const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem.begin());
+							const float* arg = (float*)getStream(*this, op0, fromf4, reg_mem);
 							ASSERT(dst.type == DataStream::OUT);
 							u8 output_idx = dst.index;
 							float* res = data + output_idx + fromf4 * 4 * stride;
@@ -847,7 +1270,11 @@ void ParticleEmitter::fillInstanceData(float* data) const {
 				itype = ip.read<InstructionType>();
 			}
 		}
-	});
+	};
+
+	// called from pipeline's jobs, small emitters are not worth spawning more jobs
+	if (m_particles_count > CHUNK_SIZE) jobs::runOnWorkers(fill);
+	else fill();
 }
 
 
@@ -13,6 +13,7 @@ namespace Lumix
 {
 
 
+struct DrawStream;
 struct DVec3;
 struct Material;
 struct Renderer;
@@ -21,6 +22,8 @@ struct Renderer;
 struct ParticleEmitterResource final : Resource {
 	enum class Version : u32{
 		VERTEX_DECL,
+		GPU,
+		LOD,
 		LAST
 	};
 	struct Header {
@@ -65,11 +68,24 @@ struct ParticleEmitterResource final : Resource {
 		DIV
 	};
 
+	struct LOD {
+		// emitters farther from camera use the reduced settings below, 0 - LOD disabled
+		float distance = 0;
+		float emit_rate_scale = 1;
+		// simulation runs once in this many frames, with time step accumulated over skipped frames
+		u32 update_interval = 1;
+		// seconds outside of camera's frustum after which simulation pauses, negative - never pauses
+		float offscreen_timeout = -1;
+		// bounding sphere of particles, used for frustum test
+		float radius = 10;
+	};
+
 	static const ResourceType TYPE;
 
 	ParticleEmitterResource(const Path& path, ResourceManager& manager, Renderer& renderer, IAllocator& allocator);
 
 	ResourceType getType() const override { return TYPE; }
+	~ParticleEmitterResource();
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
 	const OutputMemoryStream& getInstructions() const { return m_instructions; }
@@ -85,11 +101,23 @@ struct ParticleEmitterResource final : Resource {
 		u32 output_offset,
 		u32 channels_count,
 		u32 registers_count,
-		u32 outputs_count
+		u32 outputs_count,
+		bool gpu,
+		u32 max_gpu_particles
 	);
 	const gpu::VertexDecl& getVertexDecl() const { return m_vertex_decl; }
+	const LOD& getLOD() const { return m_lod; }
+	void setLOD(const LOD& lod) { m_lod = lod; }
+	bool isGPU() const { return m_gpu; }
+	u32 getMaxGPUParticles() const { return m_max_gpu_particles; }
+	// compute program generated from instructions, created lazily in `stream`
+	gpu::ProgramHandle getComputeProgram(DrawStream& stream);
 
 private:
+	void generateComputeSource();
+	void destroyComputeProgram();
+
+	Renderer& m_renderer;
 	OutputMemoryStream m_instructions;
 	u32 m_emit_offset;
 	u32 m_output_offset;
@@ -98,6 +126,11 @@ private:
 	u32 m_outputs_count;
 	Material* m_material;
 	gpu::VertexDecl m_vertex_decl;
+	LOD m_lod;
+	bool m_gpu = false;
+	u32 m_max_gpu_particles = 0;
+	OutputMemoryStream m_compute_source;
+	gpu::ProgramHandle m_compute_program = gpu::INVALID_PROGRAM;
 };
 
 
@@ -114,6 +147,8 @@ public:
 	void serialize(OutputMemoryStream& blob) const;
 	void deserialize(InputMemoryStream& blob, bool has_autodestroy, ResourceManagerHub& manager);
 	bool update(float dt, struct PageAllocator& allocator);
+	// `distance` - from camera, `visible` - inside camera's frustum, `can_emit` - false if particle budget is exhausted
+	bool update(float dt, struct PageAllocator& allocator, float distance, bool visible, bool can_emit);
 	void emit(const float* args);
 	void fillInstanceData(float* data) const;
 	u32 getParticlesDataSizeBytes() const;
@@ -122,6 +157,27 @@ public:
 	u32 getParticlesCount() const { return m_particles_count; }
 	float* getChannelData(u32 idx) const { return m_channels[idx].data; }
 	void reset() { m_particles_count = 0; }
+	bool isGPU() const { return m_resource && m_resource->isGPU(); }
+	// records simulation of GPU emitters to renderer's draw stream, noop for CPU emitters
+	void simulateGPU(Renderer& renderer);
+
+	struct GPUData {
+		// offset of DrawElementsIndirect command in `counters`
+		static constexpr u32 INDIRECT_OFFSET = 8;
+
+		Renderer* renderer = nullptr;
+		gpu::BufferHandle channels[2] = { gpu::INVALID_BUFFER, gpu::INVALID_BUFFER };
+		gpu::BufferHandle instances = gpu::INVALID_BUFFER;
+		gpu::BufferHandle counters = gpu::INVALID_BUFFER;
+		gpu::BufferHandle indices = gpu::INVALID_BUFFER;
+		u32 capacity = 0;
+		u32 current = 0;
+		u32 emit_count = 0;
+		// set when update advanced the simulation, which can skip frames
+		bool simulate = false;
+	};
+
+	const GPUData& getGPUData() const { return m_gpu; }
 
 	EntityPtr m_entity;
 	u32 m_emit_rate = 10;
@@ -139,13 +195,18 @@ private:
 	void operator =(ParticleEmitter&& rhs) = delete;
 	float readSingleValue(InputMemoryStream& blob) const;
 	void onResourceChanged(Resource::State old_state, Resource::State new_state, Resource&);
+	void releaseGPUData();
 
 	IAllocator& m_allocator;
 	OutputMemoryStream m_emit_buffer;
 	Channel m_channels[16];
 	u32 m_capacity = 0;
 	float m_emit_timer = 0;
+	float m_lod_dt = 0;
+	u32 m_lod_frame = 0;
+	float m_offscreen_time = 0;
 	ParticleEmitterResource* m_resource = nullptr;
+	GPUData m_gpu;
 };
 
 
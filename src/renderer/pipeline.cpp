@@ -25,6 +25,7 @@
 #include "font.h"
 #include "material.h"
 #include "model.h"
+#include "occlusion_buffer.h"
 #include "particle_system.h"
 #include "pipeline.h"
 #include "pose.h"
@@ -47,11 +48,42 @@ namespace Lumix
 // instance group 15 - 0; if instanced
 
 static constexpr u32 INSTANCED_MESHES_BUFFER_SIZE = 64 * 1024 * 1024; // TODO dynamic
+// 48B header (batch offset, lod counts, lod offsets) followed by 32B per instance
+static constexpr u32 INSTANCED_MESHES_OUTPUT_CAPACITY = (INSTANCED_MESHES_BUFFER_SIZE - 48) / 32;
+// instanced models with at least this many instances skip per-cell culling on CPU
+static constexpr u32 GPU_DRIVEN_MIN_INSTANCES = 64 * 1024;
+static constexpr u32 MAX_DISPATCH_GROUPS = 65535;
+// smaller views are sorted by radixSort after Sorter::pack
+static constexpr u32 PARALLEL_RADIX_SORT_MIN_COUNT = 64 * 1024;
+// ~16k keys per block
+static constexpr u32 RADIX_SORT_PAGES_PER_BLOCK = 64;
+// keys encoded by one worker, views with fewer keys are encoded directly to buckets' streams
+static constexpr u32 COMMANDS_CHUNK_SIZE = 4 * 1024;
+// one indirect draw per meshlet per instance
+static constexpr u32 MESHLET_INDIRECT_BUFFER_SIZE = 4 * 1024 * 1024;
+// instance data of autoinstanced meshes computed on GPU, for all views in a frame, 32 bytes per instance
+static constexpr u32 EXPANDED_INSTANCES_BUFFER_SIZE = 32 * 1024 * 1024;
+// cluster map of GPU light clustering has room for this many lights and probes per cluster on average
+static constexpr u32 GPU_CLUSTER_MAP_ITEMS = 32;
+// grass instances generated on GPU for one grass type, 32B per instance
+static constexpr u32 GRASS_MAX_INSTANCES = 512 * 1024;
+// meshes of a grass model's LOD 0, one indirect draw per mesh
+static constexpr u32 GRASS_MAX_MESHES = 16;
+// cells per side of the area where grass instances are generated
+static constexpr u32 GRASS_MAX_CELLS = 2048;
+// vertices skinned in one frame, shared by all views
+static constexpr u32 SKINNED_VERTICES_BUFFER_SIZE = 32 * 1024 * 1024;
+static constexpr u32 INVALID_SKINNED_OFFSET = 0xffFFffFF;
+// cached sort keys of a static cell are freed after this many frames without use
+static constexpr u32 CELL_SORT_KEYS_LIFETIME = 60;
 static constexpr u32 SORT_VALUE_TYPE_MASK = (1 << 5) - 1;
 static constexpr u64 SORT_KEY_BUCKET_SHIFT = 56;
 static constexpr u64 SORT_KEY_INSTANCED_FLAG = (u64)1 << 55;
 static constexpr u64 SORT_KEY_INSTANCER_SHIFT = 16;
 static constexpr u64 SORT_KEY_MESH_IDX_SHIFT = 40;
+// material and mesh sort keys are allocated independently, renderables keyed by material
+// (decals, particles) have their type in the key so they never batch with other renderables
+static constexpr u64 SORT_KEY_TYPE_SHIFT = 48;
 
 struct CameraParams
 {
@@ -329,6 +361,7 @@ struct ShadowAtlas {
 			if (!inv_map[i].isValid()) {
 				map.insert(e, i);
 				inv_map[i] = e;
+				slots[i].baked = false;
 				return i;
 			}
 		}
@@ -336,6 +369,38 @@ struct ShadowAtlas {
 		return -1;
 	}
 
+	// slot content is valid as long as the light does not change and no caster in its range changes
+	bool needsBake(u32 idx, const DVec3& pos, const Quat& rot, float fov, float range) const {
+		const Slot& slot = slots[idx];
+		return !slot.baked
+			|| squaredLength(slot.pos - pos) > 0
+			|| slot.rot.x != rot.x || slot.rot.y != rot.y || slot.rot.z != rot.z || slot.rot.w != rot.w
+			|| slot.fov != fov
+			|| slot.range != range;
+	}
+
+	void baked(u32 idx, const DVec3& pos, const Quat& rot, float fov, float range) {
+		Slot& slot = slots[idx];
+		slot.baked = true;
+		slot.pos = pos;
+		slot.rot = rot;
+		slot.fov = fov;
+		slot.range = range;
+	}
+
+	void invalidate(const DVec3& pos, float radius) {
+		for (u32 i = 0; i < lengthOf(slots); ++i) {
+			Slot& slot = slots[i];
+			if (!slot.baked) continue;
+			const float r = slot.range + radius;
+			if (squaredLength(slot.pos - pos) < double(r) * r) slot.baked = false;
+		}
+	}
+
+	void invalidateAll() {
+		for (Slot& slot : slots) slot.baked = false;
+	}
+
 	void remove(EntityRef e) {
 		auto iter = map.find(e);
 		u32 idx = iter.value();
@@ -343,9 +408,194 @@ struct ShadowAtlas {
 		inv_map[idx] = INVALID_ENTITY;
 	}
 
+	struct Slot {
+		bool baked = false;
+		DVec3 pos;
+		Quat rot;
+		float fov;
+		float range;
+	};
+
 	gpu::TextureHandle texture = gpu::INVALID_TEXTURE;
 	HashMap<EntityRef, u32> map;
 	EntityPtr inv_map[64];
+	Slot slots[64];
+	// absolute index of the first shadow caster change not yet applied to slots
+	u64 consumed_caster_changes = 0;
+};
+
+
+// runtime virtual texture of a terrain's detail layers
+// terrain.shd reports pages it needs to a feedback image, the image is read back a few frames later,
+// missing pages are baked into the atlas by terrain_vt.shd, least recently used pages are evicted
+struct TerrainVT {
+	static constexpr u32 PAGE_SIZE = 128; // texels, including border
+	static constexpr u32 PAGE_BORDER = 4;
+	static constexpr u32 ATLAS_SIZE = 4096;
+	static constexpr u32 ATLAS_PAGES = ATLAS_SIZE / PAGE_SIZE; // per side
+	static constexpr float PAGE_WORLD_SIZE = 4; // meters covered by a page in level 0
+	static constexpr u32 MAX_LEVELS = 8;
+	static constexpr u32 MAX_PAGES_PER_SIDE = 512; // feedback can encode up to 4096
+	static constexpr u32 FEEDBACK_SCALE = 16; // one feedback texel per 16x16 pixels
+	static constexpr u32 FEEDBACK_SIZE = 256;
+	static constexpr u32 MAX_BAKES = 16; // per frame
+	static constexpr u32 READBACKS_COUNT = 3;
+	static constexpr u32 INVALID_PAGE = 0xffFFffFF;
+
+	// must match VTPageTable in terrain.shd
+	struct Header {
+		u32 levels_count;
+		u32 atlas_pages;
+		u32 feedback_scale;
+		u32 padding;
+		Vec4 params;
+		// x - offset in page table, y - columns, z - rows
+		IVec4 levels[MAX_LEVELS];
+	};
+
+	struct Slot {
+		u32 page = INVALID_PAGE;
+		u32 last_used_frame = 0;
+	};
+
+	struct Bake {
+		IVec4 page; // x - slot, y - level, zw - page
+		IVec4 entry; // x - page table index, y - evicted page table index or -1
+	};
+
+	struct Readback {
+		enum State : i32 {
+			FREE,
+			COPIED,
+			READING,
+			READY
+		};
+		gpu::TextureHandle staging = gpu::INVALID_TEXTURE;
+		volatile i32 state = FREE;
+		u32 frame;
+		IVec2 size;
+	};
+
+	TerrainVT(IAllocator& allocator)
+		: page_table(allocator)
+		, slots(allocator)
+		, requests(allocator)
+		, readback_data(allocator)
+	{}
+
+	void reset(EntityRef entity, const Vec2& size) {
+		terrain = entity;
+		terrain_size = size;
+		const float page_world_size = maximum(PAGE_WORLD_SIZE, maximum(size.x, size.y) / MAX_PAGES_PER_SIDE);
+		header.levels_count = 0;
+		header.atlas_pages = ATLAS_PAGES;
+		header.feedback_scale = FEEDBACK_SCALE;
+		header.padding = 0;
+		header.params = Vec4(page_world_size, float(PAGE_SIZE - 2 * PAGE_BORDER), float(PAGE_SIZE) / ATLAS_SIZE, float(PAGE_BORDER) / ATLAS_SIZE);
+		u32 offset = 0;
+		for (u32 level = 0; level < MAX_LEVELS; ++level) {
+			const float s = page_world_size * (1 << level);
+			const i32 cols = maximum(1, (i32)ceilf(size.x / s));
+			const i32 rows = maximum(1, (i32)ceilf(size.y / s));
+			header.levels[level] = IVec4(offset, cols, rows, 0);
+			offset += cols * rows;
+			header.levels_count = level + 1;
+			if (cols == 1 && rows == 1) break;
+		}
+		page_table.resize(offset);
+		memset(page_table.begin(), 0, page_table.byte_size());
+		slots.clear();
+		slots.resize(ATLAS_PAGES * ATLAS_PAGES);
+	}
+
+	// collects requested pages which are not resident, touches resident ones
+	void processFeedback(const u32* data, const IVec2& size, u32 frame) {
+		for (i32 j = 0; j < size.y; ++j) {
+			for (i32 i = 0; i < size.x; ++i) {
+				const u32 v = data[i + j * FEEDBACK_SIZE];
+				if ((v & (1 << 31)) == 0) continue;
+
+				const u32 level = (v >> 24) & 0x7f;
+				const i32 x = v & 0xfff;
+				const i32 y = (v >> 12) & 0xfff;
+				if (level >= header.levels_count) continue;
+				const IVec4& l = header.levels[level];
+				if (x >= l.y || y >= l.z) continue;
+
+				const u32 idx = l.x + x + y * l.y;
+				if (page_table[idx] != 0) {
+					slots[page_table[idx] - 1].last_used_frame = frame;
+				}
+				else if (requests.indexOf(idx) < 0) {
+					requests.push(idx);
+				}
+			}
+		}
+	}
+
+	u32 getLevel(u32 page_idx) const {
+		for (u32 i = header.levels_count - 1; i > 0; --i) {
+			if (page_idx >= (u32)header.levels[i].x) return i;
+		}
+		return 0;
+	}
+
+	// assigns slots to requested pages, coarser pages first, returns number of pages to bake
+	u32 allocate(Span<Bake> bakes, u32 frame) {
+		qsort(requests.begin(), requests.size(), sizeof(requests[0]), [](const void* a, const void* b){
+			const u32 i = *(const u32*)a;
+			const u32 j = *(const u32*)b;
+			// higher index is coarser level
+			return i < j ? 1 : (i > j ? -1 : 0);
+		});
+
+		u32 count = 0;
+		for (u32 page_idx : requests) {
+			if (count == bakes.length()) break;
+
+			u32 victim = 0;
+			for (u32 i = 1, c = slots.size(); i < c; ++i) {
+				if (slots[i].last_used_frame < slots[victim].last_used_frame) victim = i;
+			}
+			// everything in the atlas is still needed
+			if (slots[victim].page != INVALID_PAGE && slots[victim].last_used_frame == frame) break;
+
+			Slot& slot = slots[victim];
+			Bake& bake = bakes[count];
+			bake.entry = IVec4(page_idx, -1, 0, 0);
+			if (slot.page != INVALID_PAGE) {
+				page_table[slot.page] = 0;
+				bake.entry.y = slot.page;
+			}
+			slot.page = page_idx;
+			slot.last_used_frame = frame;
+			page_table[page_idx] = victim + 1;
+
+			const u32 level = getLevel(page_idx);
+			const IVec4& l = header.levels[level];
+			const i32 local = page_idx - l.x;
+			bake.page = IVec4(victim, level, local % l.y, local / l.y);
+			++count;
+		}
+		requests.clear();
+		return count;
+	}
+
+	EntityPtr terrain = INVALID_ENTITY;
+	Vec2 terrain_size = Vec2(0);
+	Header header;
+	// 0 - not resident, otherwise atlas slot + 1
+	Array<u32> page_table;
+	Array<Slot> slots;
+	Array<u32> requests;
+	gpu::TextureHandle albedo = gpu::INVALID_TEXTURE;
+	gpu::TextureHandle normal = gpu::INVALID_TEXTURE;
+	gpu::TextureHandle feedback = gpu::INVALID_TEXTURE;
+	gpu::BufferHandle page_table_buffer = gpu::INVALID_BUFFER;
+	Readback readbacks[READBACKS_COUNT];
+	// FEEDBACK_SIZE * FEEDBACK_SIZE texels per readback
+	Array<u32> readback_data;
+	u32 update_frame = 0xffFFffFF;
 };
 
 
@@ -386,6 +636,8 @@ struct PipelineImpl final : Pipeline
 		Type type = FIXED;
 		IVec2 fixed_size;
 		Vec2 rel_size;
+		// relative to output size instead of scene render size, i.e. not affected by dynamic resolution
+		bool native = false;
 		gpu::TextureFormat format;
 		gpu::TextureFlags flags;
 		StaticString<32> debug_name;
@@ -397,6 +649,7 @@ struct PipelineImpl final : Pipeline
 		IVec2 size;
 		gpu::TextureFormat format;
 		gpu::TextureFlags flags;
+		bool native;
 	};
 
 	struct ShaderRef {
@@ -404,6 +657,62 @@ struct PipelineImpl final : Pipeline
 		int id;
 	};
 
+	// passes declared by renderGraphPass, culled, executed and cleared by executeRenderGraph
+	// transient renderbuffers are allocated before their first pass and released after their last one,
+	// so later passes of the same frame reuse them
+	struct RenderGraph {
+		struct Resource {
+			RenderbufferDescHandle desc;
+			// renderbuffer table seen by Lua, its value is set while the renderbuffer is allocated
+			int lua_ref;
+			i32 renderbuffer = -1;
+			i32 first_pass = -1;
+			i32 last_pass = -1;
+			bool keep = false;
+			bool needed = false;
+		};
+
+		struct Pass {
+			StaticString<32> name;
+			int fn_ref;
+			// ranges in pass_resources
+			u32 inputs_offset;
+			u32 inputs_count;
+			u32 outputs_offset;
+			u32 outputs_count;
+			// writes to something outside of the graph, never culled
+			bool side_effects;
+			bool culled;
+		};
+
+		RenderGraph(IAllocator& allocator)
+			: resources(allocator)
+			, passes(allocator)
+			, pass_resources(allocator)
+		{}
+
+		Array<Resource> resources;
+		Array<Pass> passes;
+		Array<u32> pass_resources;
+	};
+
+	// min depth pyramid for occlusion culling, all levels are packed in one texture
+	struct HiZ {
+		static constexpr u32 MAX_LEVELS = 16;
+		gpu::TextureHandle texture = gpu::INVALID_TEXTURE;
+		IVec2 atlas_size = IVec2(0);
+		IVec2 depth_size;
+		u32 level_count = 0;
+		// xy - offset in atlas, zw - size
+		IVec4 levels[MAX_LEVELS];
+		// relative to camera_pos
+		Matrix view_projection;
+		DVec3 camera_pos;
+		// built in this frame, valid is true if it was built in the previous frame
+		bool built = false;
+		bool valid = false;
+	};
+
 	struct Bucket {
 		Bucket(Renderer& renderer) : stream(renderer) {}
 		enum Sort {
@@ -528,7 +837,11 @@ struct PipelineImpl final : Pipeline
 				p = p->header.next;
 			}
 
-			p = first_page;
+			freePages();
+		}
+
+		void freePages() {
+			Page* p = first_page;
 			page_allocator.lock();
 			while (p) {
 				Page* n = p->header.next;
@@ -590,6 +903,7 @@ struct PipelineImpl final : Pipeline
 		void init(u32 count) {
 			instances.resize(count);
 			memset(instances.begin(), 0, instances.byte_size());
+			expanded_count = 0;
 		}
 
 		~AutoInstancer() {
@@ -623,6 +937,31 @@ struct PipelineImpl final : Pipeline
 			++g->count;
 		}
 
+		void add(u32 sort_key, const u64* renderables, u32 count) {
+			while (count > 0) {
+				Page::Group* g = instances[sort_key].end;
+				if (!g || g->count == lengthOf(g->renderables)) {
+					Page::Group* n = getNewGroup();
+					if (g) {
+						n->offset = g->offset + g->count;
+						g->next = n;
+					}
+					else {
+						ASSERT(!instances[sort_key].begin);
+						instances[sort_key].begin = n;
+					}
+					g = n;
+					instances[sort_key].end = g;
+				}
+
+				const u32 step = minimum(count, u32(lengthOf(g->renderables) - g->count));
+				memcpy(&g->renderables[g->count], renderables, step * sizeof(renderables[0]));
+				g->count += step;
+				renderables += step;
+				count -= step;
+			}
+		}
+
 		Page* getNewPage() {
 			void* mem = page_allocator.allocate(true);
 			Page* p = new (NewPlaceholder(), mem) Page;
@@ -647,11 +986,64 @@ struct PipelineImpl final : Pipeline
 		};
 
 		Array<Instances> instances;
+		// entity index and lod per instance, expanded to instance data by pipelines/instance_data.shd
+		Renderer::TransientSlice indices;
+		u32 expanded_offset = 0; // in instances
+		u32 expanded_count = 0;
 		Page* last_page = nullptr;
 		Page* first_page = nullptr;
 		PageAllocator& page_allocator;
 	};
 	
+	// sort keys of a static culling cell completely inside a view, reused in following frames
+	// as long as no mesh in the cell changes its lod
+	struct CellSortKeys {
+		struct Group {
+			u32 sort_key;
+			u32 from;
+			u32 count;
+			u32 texture_resolution;
+		};
+
+		struct DepthSorted {
+			u64 subrenderable;
+			u32 bucket;
+			u32 texture_resolution;
+		};
+
+		CellSortKeys(IAllocator& allocator)
+			: groups(allocator)
+			, renderables(allocator)
+			, depth_sorted(allocator)
+		{}
+
+		bool isValid(const DVec3& ref_point, float multiplier, u32 sort_keys_generation) const {
+			return lod_multiplier == multiplier
+				&& sort_keys_generation == this->sort_keys_generation
+				&& squaredLength(ref_point - lod_ref_point) < double(lod_slack) * lod_slack;
+		}
+
+		DVec3 lod_ref_point;
+		float lod_multiplier;
+		// lod reference point can move this far before any mesh in the cell switches lod
+		float lod_slack;
+		u32 sort_keys_generation;
+		u32 last_used_frame;
+		Array<Group> groups;
+		// instanced subrenderables, grouped by sort key
+		Array<u64> renderables;
+		Array<DepthSorted> depth_sorted;
+	};
+
+	// mesh of a model instance skinned by pipelines/skinning.shd, values match SkinnedMesh uniform block
+	struct SkinningMesh {
+		EntityRef entity;
+		u32 mesh_idx;
+		IVec4 mesh;
+		IVec4 offsets;
+		IVec4 formats;
+	};
+
 	struct View {
 		View(LinearAllocator& allocator, PageAllocator& page_allocator) 
 			: sorter(allocator, page_allocator)
@@ -667,7 +1059,12 @@ struct PipelineImpl final : Pipeline
 		Array<AutoInstancer> instancers;
 		Sorter sorter;
 		CullResult* renderables = nullptr;
+		CameraParamsHandle cp_handle;
+		// scene's persistent instance data, invalid if instances are filled on CPU
+		gpu::BufferHandle instance_data = gpu::INVALID_BUFFER;
 		CameraParams cp;
+		HiZ hiz;
+		bool cpu_occlusion = false;
 		u8 layer_to_bucket[255];
 		jobs::Signal ready;
 	};
@@ -694,8 +1091,13 @@ struct PipelineImpl final : Pipeline
 		, m_output(-1)
 		, m_renderbuffer_descs(allocator)
 		, m_renderbuffers(allocator)
+		, m_render_graph(allocator)
 		, m_shaders(allocator)
 		, m_shadow_atlas(allocator)
+		, m_terrain_vt(allocator)
+		, m_skinned_instances(allocator)
+		, m_skinned_mesh_offsets(allocator)
+		, m_skinning_meshes(allocator)
 		, m_textures(allocator)
 		, m_buffers(allocator)
 		, m_views(allocator)
@@ -705,12 +1107,22 @@ struct PipelineImpl final : Pipeline
 		, m_decal_decl(gpu::PrimitiveType::TRIANGLES)
 		, m_curve_decal_decl(gpu::PrimitiveType::TRIANGLES)
 		, m_2D_decl(gpu::PrimitiveType::TRIANGLES)
+		, m_cell_sort_keys(allocator)
+		, m_retired_cell_sort_keys(allocator)
+		, m_gpu_pass_stats(allocator)
 	{
 		m_viewport.w = m_viewport.h = 800;
 		ResourceManagerHub& rm = renderer.getEngine().getResourceManager();
 		m_draw2d_shader = rm.load<Shader>(Path("pipelines/draw2d.shd"));
 		m_debug_shape_shader = rm.load<Shader>(Path("pipelines/debug_shape.shd"));
 		m_instancing_shader = rm.load<Shader>(Path("pipelines/instancing.shd"));
+		m_hiz_shader = rm.load<Shader>(Path("pipelines/hiz.shd"));
+		m_light_clusters_shader = rm.load<Shader>(Path("pipelines/light_clusters.shd"));
+		m_meshlets_shader = rm.load<Shader>(Path("pipelines/meshlets.shd"));
+		m_instance_data_shader = rm.load<Shader>(Path("pipelines/instance_data.shd"));
+		m_grass_shader = rm.load<Shader>(Path("pipelines/grass.shd"));
+		m_terrain_vt_shader = rm.load<Shader>(Path("pipelines/terrain_vt.shd"));
+		m_skinning_shader = rm.load<Shader>(Path("pipelines/skinning.shd"));
 		
 		m_draw2d.clear({1, 1});
 
@@ -753,6 +1165,19 @@ struct PipelineImpl final : Pipeline
 		const Renderer::MemRef ind_mem = { 64 * 1024, nullptr, false }; // TODO size
 		m_indirect_buffer = m_renderer.createBuffer(ind_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
 
+		const Renderer::MemRef meshlet_ind_mem = { MESHLET_INDIRECT_BUFFER_SIZE, nullptr, false };
+		m_meshlet_indirect_buffer = m_renderer.createBuffer(meshlet_ind_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
+
+		const Renderer::MemRef expanded_mem = { EXPANDED_INSTANCES_BUFFER_SIZE, nullptr, false };
+		m_expanded_instances_buffer = m_renderer.createBuffer(expanded_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
+
+		const Renderer::MemRef grass_mem = { GRASS_MAX_INSTANCES * 32, nullptr, false };
+		m_grass_instances_buffer = m_renderer.createBuffer(grass_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
+		const Renderer::MemRef grass_ind_mem = { GRASS_MAX_MESHES * sizeof(Indirect), nullptr, false };
+		m_grass_indirect_buffer = m_renderer.createBuffer(grass_ind_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
+		const Renderer::MemRef skinned_mem = { SKINNED_VERTICES_BUFFER_SIZE, nullptr, false };
+		m_skinned_vertices_buffer = m_renderer.createBuffer(skinned_mem, gpu::BufferFlags::COMPUTE_WRITE | gpu::BufferFlags::SHADER_BUFFER);
+
 		m_base_vertex_decl.addAttribute(0, 0, 3, gpu::AttributeType::FLOAT, 0);
 		m_base_vertex_decl.addAttribute(1, 12, 4, gpu::AttributeType::U8, gpu::Attribute::NORMALIZED);
 
@@ -783,13 +1208,21 @@ struct PipelineImpl final : Pipeline
 		for (gpu::TextureHandle t : m_textures) stream.destroy(t);
 		for (gpu::BufferHandle b : m_buffers) stream.destroy(b);
 
-		m_renderer.frame();
-		m_renderer.frame();
-		m_renderer.frame();
+		for (u32 i = 0; i < m_renderer.getFramesInFlight(); ++i) m_renderer.frame();
+
+		for (CellSortKeys* cell : m_cell_sort_keys) LUMIX_DELETE(m_allocator, cell);
+		for (CellSortKeys* cell : m_retired_cell_sort_keys) LUMIX_DELETE(m_allocator, cell);
 
 		m_draw2d_shader->decRefCount();
 		m_debug_shape_shader->decRefCount();
 		m_instancing_shader->decRefCount();
+		m_hiz_shader->decRefCount();
+		m_light_clusters_shader->decRefCount();
+		m_meshlets_shader->decRefCount();
+		m_instance_data_shader->decRefCount();
+		m_grass_shader->decRefCount();
+		m_terrain_vt_shader->decRefCount();
+		m_skinning_shader->decRefCount();
 
 		for (const Renderbuffer& rb : m_renderbuffers) {
 			stream.destroy(rb.handle);
@@ -804,12 +1237,27 @@ struct PipelineImpl final : Pipeline
 		stream.destroy(m_cube_vb);
 		stream.destroy(m_instanced_meshes_buffer);
 		stream.destroy(m_indirect_buffer);
+		stream.destroy(m_meshlet_indirect_buffer);
+		stream.destroy(m_expanded_instances_buffer);
+		stream.destroy(m_grass_instances_buffer);
+		stream.destroy(m_grass_indirect_buffer);
+		stream.destroy(m_skinned_vertices_buffer);
+		if (m_terrain_vt.albedo) {
+			stream.destroy(m_terrain_vt.albedo);
+			stream.destroy(m_terrain_vt.normal);
+			stream.destroy(m_terrain_vt.feedback);
+			for (const TerrainVT::Readback& rb : m_terrain_vt.readbacks) stream.destroy(rb.staging);
+		}
+		if (m_terrain_vt.page_table_buffer) stream.destroy(m_terrain_vt.page_table_buffer);
+		if (m_hiz.texture) stream.destroy(m_hiz.texture);
 		stream.destroy(m_shadow_atlas.texture);
 		stream.destroy(m_cluster_buffers.clusters.buffer);
 		stream.destroy(m_cluster_buffers.lights.buffer);
 		stream.destroy(m_cluster_buffers.maps.buffer);
 		stream.destroy(m_cluster_buffers.env_probes.buffer);
 		stream.destroy(m_cluster_buffers.refl_probes.buffer);
+		stream.destroy(m_cluster_buffers.bounds.buffer);
+		stream.destroy(m_cluster_buffers.counter.buffer);
 
 		clearBuffers();
 	}
@@ -1081,7 +1529,8 @@ struct PipelineImpl final : Pipeline
 			global_state.shadow_cam_depth_range = SHADOW_CAM_FAR;
 			global_state.shadow_cam_rcp_depth_range = 1.f / SHADOW_CAM_FAR;
 
-			//findExtraShadowcasterPlanes(light_forward, camera_frustum, &cp.frustum);
+			m_shadow_camera_frusta[slice] = vp.getFrustum();
+			findExtraShadowcasterPlanes(light_forward, camera_frustum, -shadow_cam_pos, &m_shadow_camera_frusta[slice]);
 		}
 	}
 
@@ -1096,6 +1545,7 @@ struct PipelineImpl final : Pipeline
 		PROFILE_FUNCTION();
 		const Universe& universe = m_scene->getUniverse();
 		const Viewport backup_viewport = m_viewport;
+		const IVec2 backup_render_size = m_render_size;
 
 		const Vec4 uv = ShadowAtlas::getUV(atlas_idx);
 		m_viewport.is_ortho = false;
@@ -1106,6 +1556,7 @@ struct PipelineImpl final : Pipeline
 		m_viewport.far = light.range;
 		m_viewport.w = u32(ShadowAtlas::SIZE * uv.z + 0.5f);
 		m_viewport.h = u32(ShadowAtlas::SIZE * uv.w + 0.5f);;
+		m_render_size = IVec2(m_viewport.w, m_viewport.h);
 
 		LuaWrapper::DebugGuard lua_debug_guard(m_lua_state);
 		lua_rawgeti(m_lua_state, LUA_REGISTRYINDEX, m_lua_env);
@@ -1135,9 +1586,10 @@ struct PipelineImpl final : Pipeline
 		});
 
 		m_viewport = backup_viewport;
+		m_render_size = backup_render_size;
 		lua_rawgeti(m_lua_state, LUA_REGISTRYINDEX, m_lua_env);
-		LuaWrapper::setField(m_lua_state, -1, "viewport_w", m_viewport.w);
-		LuaWrapper::setField(m_lua_state, -1, "viewport_h", m_viewport.h);
+		LuaWrapper::setField(m_lua_state, -1, "viewport_w", m_render_size.x);
+		LuaWrapper::setField(m_lua_state, -1, "viewport_h", m_render_size.y);
 		lua_pop(m_lua_state, 1);
 		return true;
 	}
@@ -1160,6 +1612,36 @@ struct PipelineImpl final : Pipeline
 		renderUIHelper(drawdata, true, matrix);
 	}
 
+	// picks the fraction of output resolution the scene is rendered in, so GPU frame time stays close to the target
+	void updateRenderScale() {
+		bool dynamic_resolution = false;
+		float target_ms = 16.6f;
+		float min_scale = 0.5f;
+		LuaWrapper::getOptionalField(m_lua_state, -1, "DYNAMIC_RESOLUTION", &dynamic_resolution);
+		LuaWrapper::getOptionalField(m_lua_state, -1, "DYNAMIC_RESOLUTION_TARGET_MS", &target_ms);
+		LuaWrapper::getOptionalField(m_lua_state, -1, "DYNAMIC_RESOLUTION_MIN_SCALE", &min_scale);
+		if (!dynamic_resolution) {
+			m_render_scale = m_desired_render_scale = 1;
+			return;
+		}
+
+		m_renderer.getGPUPassStats(m_gpu_pass_stats);
+		float gpu_ms = 0;
+		for (const Renderer::GPUPassStats& s : m_gpu_pass_stats) {
+			if (s.depth == 0 && equalStrings(s.name, "frame")) gpu_ms = s.last_ms;
+		}
+		if (gpu_ms <= 0 || target_ms <= 0) return;
+
+		// cost is roughly proportional to the number of pixels
+		min_scale = clamp(min_scale, 0.1f, 1.f);
+		const float desired = clamp(m_render_scale * sqrtf(target_ms / gpu_ms), min_scale, 1.f);
+		// timings lag a few frames behind, move slowly and in steps so renderbuffers are not recreated every frame
+		const float STEP = 0.05f;
+		m_desired_render_scale = lerp(m_desired_render_scale, desired, 0.1f);
+		if (fabsf(m_desired_render_scale - m_render_scale) < STEP * 0.75f) return;
+		m_render_scale = clamp(floorf(m_desired_render_scale / STEP + 0.5f) * STEP, min_scale, 1.f);
+	}
+
 	static Matrix computeReprojection(const Viewport& current, const Viewport& prev) {
 		Matrix translation = Matrix::IDENTITY;
 		translation.setTranslation(Vec3(current.pos - prev.pos));
@@ -1186,15 +1668,31 @@ struct PipelineImpl final : Pipeline
 		}
 
 		m_renderer.waitCanSetup();
+		if (m_scene) m_scene->uploadProceduralGeometries();
+		m_instance_data = gpu::INVALID_BUFFER;
+		if (m_scene) {
+			// if the shader is not ready, only full uploads are possible
+			const gpu::ProgramHandle scatter_program = m_instance_data_shader->isReady()
+				? m_instance_data_shader->getProgram(1 << m_renderer.getShaderDefineIdx("SCATTER"))
+				: gpu::INVALID_PROGRAM;
+			const bool is_uploaded = m_scene->uploadInstanceData(scatter_program);
+			if (is_uploaded && m_instance_data_shader->isReady()) m_instance_data = m_scene->getInstanceDataBuffer();
+		}
 		clearBuffers();
+		// passes declared without executeRenderGraph
+		clearRenderGraph();
 
 		bool pixel_jitter = false;
 		LuaWrapper::getOptionalField(m_lua_state, -1, "PIXEL_JITTER", &pixel_jitter);
 		m_viewport.pixel_offset = Vec2(0);
 
+		updateRenderScale();
+		m_render_size.x = maximum(1, i32(m_viewport.w * m_render_scale + 0.5f));
+		m_render_size.y = maximum(1, i32(m_viewport.h * m_render_scale + 0.5f));
+
 		if (pixel_jitter) {
-			m_viewport.pixel_offset.x = (halton(m_renderer.frameNumber() % 8 + 1, 2) * 2 - 1) / m_viewport.w;
-			m_viewport.pixel_offset.y = (halton(m_renderer.frameNumber() % 8 + 1, 3) * 2 - 1) / m_viewport.h;
+			m_viewport.pixel_offset.x = (halton(m_renderer.frameNumber() % 8 + 1, 2) * 2 - 1) / m_render_size.x;
+			m_viewport.pixel_offset.y = (halton(m_renderer.frameNumber() % 8 + 1, 3) * 2 - 1) / m_render_size.y;
 		}
 
 		const Matrix view = m_viewport.getViewRotation();
@@ -1212,11 +1710,14 @@ struct PipelineImpl final : Pipeline
 		global_state.frame_time_delta = m_timer.getTimeSinceTick();
 		global_state.camera_reprojection = computeReprojection(m_viewport, m_prev_viewport);
 		m_timer.tick();
-		global_state.framebuffer_size.x = m_viewport.w;
-		global_state.framebuffer_size.y = m_viewport.h;
+		global_state.framebuffer_size = m_render_size;
 		global_state.cam_world_pos = Vec4(Vec3(m_viewport.pos), 1);
 		m_prev_viewport = m_viewport;
 		m_indirect_buffer_offset = 0;
+		m_meshlet_indirect_offset = 0;
+		m_expanded_instances_offset = 0;
+		m_hiz.valid = m_hiz.built;
+		m_hiz.built = false;
 
 		if(m_scene) {
 			const EntityPtr global_light = m_scene->getActiveEnvironment();
@@ -1252,8 +1753,11 @@ struct PipelineImpl final : Pipeline
 
 		LuaWrapper::DebugGuard lua_debug_guard(m_lua_state);
 		lua_rawgeti(m_lua_state, LUA_REGISTRYINDEX, m_lua_env);
-		LuaWrapper::setField(m_lua_state, -1, "viewport_w", m_viewport.w);
-		LuaWrapper::setField(m_lua_state, -1, "viewport_h", m_viewport.h);
+		// scene is rendered in viewport_w x viewport_h, upscaled to output_w x output_h
+		LuaWrapper::setField(m_lua_state, -1, "viewport_w", m_render_size.x);
+		LuaWrapper::setField(m_lua_state, -1, "viewport_h", m_render_size.y);
+		LuaWrapper::setField(m_lua_state, -1, "output_w", m_viewport.w);
+		LuaWrapper::setField(m_lua_state, -1, "output_h", m_viewport.h);
 		lua_getfield(m_lua_state, -1, "main");
 		bool has_main = true;
 		if (lua_type(m_lua_state, -1) != LUA_TFUNCTION) {
@@ -1276,10 +1780,25 @@ struct PipelineImpl final : Pipeline
 		m_renderer.waitForCommandSetup();
 
 		m_views.clear();
+		releaseSharedCull();
+		evictCellSortKeys();
 
 		return true;
 	}
 
+	void evictCellSortKeys() {
+		// no view is being prepared now, nobody can be reading the cached keys
+		for (CellSortKeys* cell : m_retired_cell_sort_keys) LUMIX_DELETE(m_allocator, cell);
+		m_retired_cell_sort_keys.clear();
+
+		const u32 frame = m_renderer.frameNumber();
+		m_cell_sort_keys.eraseIf([&](CellSortKeys* cell){
+			if (frame - cell->last_used_frame < CELL_SORT_KEYS_LIFETIME) return false;
+			LUMIX_DELETE(m_allocator, cell);
+			return true;
+		});
+	}
+
 	void renderDebugTriangles() {
 		const Array<DebugTriangle>& tris = m_scene->getDebugTriangles();
 		if (tris.empty() || !m_debug_shape_shader->isReady()) return;
@@ -1504,12 +2023,175 @@ struct PipelineImpl final : Pipeline
 		}
 	}
 
+	static i32 toRenderGraphResource(lua_State* L, int idx) {
+		if (!lua_istable(L, idx)) return -1;
+		lua_getfield(L, idx, "render_graph_resource");
+		const i32 res = lua_isnumber(L, -1) ? (i32)lua_tointeger(L, -1) : -1;
+		lua_pop(L, 1);
+		return res;
+	}
+
+	// returns renderbuffer which is allocated only while passes using it are executed
+	static int renderGraphTexture(lua_State* L) {
+		PipelineImpl* pipeline = getClosureThis(L);
+		const RenderbufferDescHandle desc = LuaWrapper::checkArg<RenderbufferDescHandle>(L, 1);
+		if (desc >= (u32)pipeline->m_renderbuffer_descs.size()) luaL_argerror(L, 1, "invalid renderbuffer desc");
+
+		RenderGraph& graph = pipeline->m_render_graph;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "lumix_resource", "renderbuffer");
+		LuaWrapper::setField(L, -1, "value", -1);
+		LuaWrapper::setField(L, -1, "render_graph_resource", graph.resources.size());
+		lua_pushvalue(L, -1);
+		RenderGraph::Resource& res = graph.resources.emplace();
+		res.desc = desc;
+		res.lua_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		return 1;
+	}
+
+	static int renderGraphPass(lua_State* L) {
+		PipelineImpl* pipeline = getClosureThis(L);
+		LuaWrapper::checkTableArg(L, 1);
+		RenderGraph& graph = pipeline->m_render_graph;
+
+		RenderGraph::Pass pass;
+		char name[32] = "render_graph_pass";
+		LuaWrapper::getOptionalStringField(L, 1, "name", Span(name));
+		pass.name = name;
+		pass.side_effects = false;
+		pass.culled = false;
+		LuaWrapper::getOptionalField(L, 1, "side_effects", &pass.side_effects);
+
+		auto getResources = [&](const char* field, u32& offset, u32& count, bool is_output){
+			offset = graph.pass_resources.size();
+			count = 0;
+			if (LuaWrapper::getField(L, 1, field) == LUA_TTABLE) {
+				for (i32 i = 1, c = (i32)lua_objlen(L, -1); i <= c; ++i) {
+					lua_rawgeti(L, -1, i);
+					const i32 res = toRenderGraphResource(L, -1);
+					lua_pop(L, 1);
+					if (res < 0 || res >= graph.resources.size()) {
+						// renderbuffer created outside of the graph
+						if (is_output) pass.side_effects = true;
+						continue;
+					}
+					graph.pass_resources.push(res);
+					++count;
+				}
+			}
+			lua_pop(L, 1);
+		};
+		getResources("inputs", pass.inputs_offset, pass.inputs_count, false);
+		getResources("outputs", pass.outputs_offset, pass.outputs_count, true);
+
+		if (LuaWrapper::getField(L, 1, "fn") != LUA_TFUNCTION) luaL_argerror(L, 1, "missing fn");
+		pass.fn_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		graph.passes.push(pass);
+		return 0;
+	}
+
+	// arguments are render graph textures which are used after the graph, they are released like normal renderbuffers
+	static int executeRenderGraph(lua_State* L) {
+		PROFILE_FUNCTION();
+		PipelineImpl* pipeline = getClosureThis(L);
+		RenderGraph& graph = pipeline->m_render_graph;
+
+		for (i32 i = 1, c = lua_gettop(L); i <= c; ++i) {
+			const i32 res = toRenderGraphResource(L, i);
+			if (res < 0 || res >= graph.resources.size()) luaL_argerror(L, i, "render graph texture expected");
+			graph.resources[res].keep = true;
+			graph.resources[res].needed = true;
+		}
+
+		// passes are declared in execution order, so we can cull them in one backward sweep
+		for (i32 i = graph.passes.size() - 1; i >= 0; --i) {
+			RenderGraph::Pass& pass = graph.passes[i];
+			bool needed = pass.side_effects;
+			for (u32 j = 0; j < pass.outputs_count; ++j) {
+				needed = needed || graph.resources[graph.pass_resources[pass.outputs_offset + j]].needed;
+			}
+			pass.culled = !needed;
+			if (!needed) continue;
+			for (u32 j = 0; j < pass.inputs_count; ++j) {
+				graph.resources[graph.pass_resources[pass.inputs_offset + j]].needed = true;
+			}
+		}
+
+		for (i32 i = 0; i < graph.passes.size(); ++i) {
+			const RenderGraph::Pass& pass = graph.passes[i];
+			if (pass.culled) continue;
+			for (u32 j = 0; j < pass.outputs_count; ++j) {
+				RenderGraph::Resource& res = graph.resources[graph.pass_resources[pass.outputs_offset + j]];
+				if (res.first_pass < 0) res.first_pass = i;
+				res.last_pass = i;
+			}
+			for (u32 j = 0; j < pass.inputs_count; ++j) {
+				RenderGraph::Resource& res = graph.resources[graph.pass_resources[pass.inputs_offset + j]];
+				if (res.first_pass < 0) {
+					logError(pipeline->getPath(), ": render graph pass ", pass.name, " reads a texture before it's written");
+					res.first_pass = i;
+				}
+				res.last_pass = i;
+			}
+		}
+
+		auto setLuaValue = [&](const RenderGraph::Resource& res){
+			lua_rawgeti(L, LUA_REGISTRYINDEX, res.lua_ref);
+			LuaWrapper::setField(L, -1, "value", res.renderbuffer);
+			lua_pop(L, 1);
+		};
+
+		DrawStream& stream = pipeline->m_renderer.getDrawStream();
+		for (i32 i = 0; i < graph.passes.size(); ++i) {
+			const RenderGraph::Pass& pass = graph.passes[i];
+			if (pass.culled) continue;
+
+			bool barrier = false;
+			for (u32 j = 0; j < pass.inputs_count + pass.outputs_count; ++j) {
+				RenderGraph::Resource& res = graph.resources[graph.pass_resources[pass.inputs_offset + j]];
+				if (res.first_pass == i && res.renderbuffer < 0) {
+					res.renderbuffer = pipeline->createRenderbuffer(res.desc).renderbuffer;
+					setLuaValue(res);
+				}
+				// inputs written by compute shaders in previous passes
+				const gpu::TextureFlags flags = pipeline->m_renderbuffer_descs[res.desc].flags;
+				if (j < pass.inputs_count && u32(flags & gpu::TextureFlags::COMPUTE_WRITE)) barrier = true;
+			}
+			if (barrier) stream.memoryBarrier(gpu::MemoryBarrierType::IMAGE, gpu::INVALID_BUFFER);
+
+			pipeline->beginBlock(pass.name);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, pass.fn_ref);
+			LuaWrapper::pcall(L, 0, 0);
+			pipeline->endBlock();
+
+			for (u32 j = 0; j < pass.inputs_count + pass.outputs_count; ++j) {
+				RenderGraph::Resource& res = graph.resources[graph.pass_resources[pass.inputs_offset + j]];
+				if (res.last_pass != i || res.keep || res.renderbuffer < 0) continue;
+				pipeline->m_renderbuffers[res.renderbuffer].frame_counter = 2;
+				res.renderbuffer = -1;
+				setLuaValue(res);
+			}
+		}
+
+		pipeline->clearRenderGraph();
+		return 0;
+	}
+
+	void clearRenderGraph() {
+		for (const RenderGraph::Resource& res : m_render_graph.resources) luaL_unref(m_lua_state, LUA_REGISTRYINDEX, res.lua_ref);
+		for (const RenderGraph::Pass& pass : m_render_graph.passes) luaL_unref(m_lua_state, LUA_REGISTRYINDEX, pass.fn_ref);
+		m_render_graph.resources.clear();
+		m_render_graph.passes.clear();
+		m_render_graph.pass_resources.clear();
+	}
+
 	PipelineTexture createRenderbuffer(RenderbufferDescHandle desc_handle) {
 		PipelineTexture res;
 		res.type = PipelineTexture::RENDERBUFFER;
 
 		const RenderbufferDesc& desc = m_renderbuffer_descs[desc_handle];
-		const IVec2 size = desc.type == RenderbufferDesc::FIXED ? desc.fixed_size : IVec2(i32(desc.rel_size.x * m_viewport.w), i32(desc.rel_size.y * m_viewport.h));
+		const IVec2 base_size = desc.native ? IVec2(m_viewport.w, m_viewport.h) : m_render_size;
+		const IVec2 size = desc.type == RenderbufferDesc::FIXED ? desc.fixed_size : IVec2(i32(desc.rel_size.x * base_size.x), i32(desc.rel_size.y * base_size.y));
 		for (Renderbuffer& rb : m_renderbuffers) {
 			if (!rb.handle) {
 				rb.frame_counter = 0;
@@ -1517,6 +2199,7 @@ struct PipelineImpl final : Pipeline
 				rb.flags = desc.flags;
 				rb.format = desc.format;
 				rb.size = size;
+				rb.native = desc.native;
 				res.renderbuffer = u32(&rb - m_renderbuffers.begin());
 				return res;
 			}
@@ -1527,6 +2210,7 @@ struct PipelineImpl final : Pipeline
 				if (rb.flags != desc.flags) continue;
 			}
 			rb.frame_counter = 0;
+			rb.native = desc.native;
 			res.renderbuffer = u32(&rb - m_renderbuffers.begin());
 			return res;
 		}
@@ -1537,6 +2221,7 @@ struct PipelineImpl final : Pipeline
 		rb.flags = desc.flags;
 		rb.format = desc.format;
 		rb.size = size;
+		rb.native = desc.native;
 		res.renderbuffer = m_renderbuffers.size() - 1;
 		return res;
 	}
@@ -1551,6 +2236,7 @@ struct PipelineImpl final : Pipeline
 		char debug_name[64] = "";
 		bool point_filter = false;
 		bool compute_write = false;
+		bool native = false;
 		RenderbufferDesc::Type type = RenderbufferDesc::FIXED;
 		if (!LuaWrapper::getOptionalField(L, 1, "size", &fixed_size)) {
 			if (!LuaWrapper::getOptionalField(L, 1, "rel_size", &rel_size)) {
@@ -1566,6 +2252,7 @@ struct PipelineImpl final : Pipeline
 		LuaWrapper::getOptionalStringField(L, 1, "debug_name", Span(debug_name));
 		LuaWrapper::getOptionalField(L, 1, "point_filter", &point_filter);
 		LuaWrapper::getOptionalField(L, 1, "compute_write", &compute_write);
+		LuaWrapper::getOptionalField(L, 1, "native", &native);
 		gpu::TextureFlags flags = gpu::TextureFlags::RENDER_TARGET 
 			| gpu::TextureFlags::NO_MIPS
 			| gpu::TextureFlags::CLAMP_U
@@ -1578,6 +2265,7 @@ struct PipelineImpl final : Pipeline
 		RenderbufferDesc& rb = m_renderbuffer_descs.emplace();
 		rb.fixed_size = fixed_size;
 		rb.rel_size = rel_size;
+		rb.native = native;
 		rb.format = format;
 		rb.flags = flags;
 		rb.type = type;
@@ -1610,10 +2298,11 @@ struct PipelineImpl final : Pipeline
 			case CameraParamsEnum::SHADOW1:
 			case CameraParamsEnum::SHADOW2:
 			case CameraParamsEnum::SHADOW3: {
-				const Viewport& vp = m_shadow_camera_viewports[(u32)handle - (u32)CameraParamsEnum::SHADOW0];
+				const u32 slice = (u32)handle - (u32)CameraParamsEnum::SHADOW0;
+				const Viewport& vp = m_shadow_camera_viewports[slice];
 				CameraParams cp;
 				cp.pos = vp.pos;
-				cp.frustum = vp.getFrustum();
+				cp.frustum = m_shadow_camera_frusta[slice];
 				cp.lod_multiplier = m_scene->getCameraLODMultiplier(vp.fov, vp.is_ortho);
 				cp.is_shadow = true;
 				cp.view = vp.getView(cp.pos);
@@ -1624,12 +2313,181 @@ struct PipelineImpl final : Pipeline
 		return {};
 	}
 
+	// handles feedback and bakes pages of the first terrain using virtual texturing, once per frame
+	void updateTerrainVT() {
+		PROFILE_FUNCTION();
+		const u32 frame = m_renderer.frameNumber();
+		if (m_terrain_vt.update_frame == frame) return;
+		m_terrain_vt.update_frame = frame;
+
+		Terrain* terrain = nullptr;
+		for (Terrain* t : m_scene->getTerrains()) {
+			if (!t->m_virtual_texturing || t->getTilesCount() > 0) continue;
+			if (!t->m_heightmap || !t->m_heightmap->isReady()) continue;
+			if (!t->m_splatmap || !t->m_splatmap->isReady()) continue;
+			if (!t->m_material || !t->m_material->isReady()) continue;
+			terrain = t;
+			break;
+		}
+		if (!terrain || !m_terrain_vt_shader->isReady()) {
+			m_terrain_vt.terrain = INVALID_ENTITY;
+			return;
+		}
+
+		Material* material = terrain->m_material;
+		Texture* detail_albedo = material->getTextureByName("Detail albedo");
+		Texture* detail_normal = material->getTextureByName("Detail normal");
+		Texture* noise = material->getTextureByName("Noise");
+		if (!detail_albedo || !detail_normal || !noise) {
+			m_terrain_vt.terrain = INVALID_ENTITY;
+			return;
+		}
+
+		DrawStream& stream = m_renderer.getDrawStream();
+		const u32 feedback_texels = TerrainVT::FEEDBACK_SIZE * TerrainVT::FEEDBACK_SIZE;
+		const bool create = !m_terrain_vt.albedo;
+		if (create) {
+			const gpu::TextureFlags flags = gpu::TextureFlags::NO_MIPS | gpu::TextureFlags::COMPUTE_WRITE | gpu::TextureFlags::CLAMP_U | gpu::TextureFlags::CLAMP_V;
+			m_terrain_vt.albedo = gpu::allocTextureHandle();
+			m_terrain_vt.normal = gpu::allocTextureHandle();
+			m_terrain_vt.feedback = gpu::allocTextureHandle();
+			stream.createTexture(m_terrain_vt.albedo, TerrainVT::ATLAS_SIZE, TerrainVT::ATLAS_SIZE, 1, gpu::TextureFormat::RGBA8, flags, "terrain_vt_albedo");
+			stream.createTexture(m_terrain_vt.normal, TerrainVT::ATLAS_SIZE, TerrainVT::ATLAS_SIZE, 1, gpu::TextureFormat::RGBA8, flags, "terrain_vt_normal");
+			stream.createTexture(m_terrain_vt.feedback, TerrainVT::FEEDBACK_SIZE, TerrainVT::FEEDBACK_SIZE, 1, gpu::TextureFormat::RGBA8, gpu::TextureFlags::NO_MIPS | gpu::TextureFlags::COMPUTE_WRITE, "terrain_vt_feedback");
+			for (TerrainVT::Readback& rb : m_terrain_vt.readbacks) {
+				rb.staging = gpu::allocTextureHandle();
+				stream.createTexture(rb.staging, TerrainVT::FEEDBACK_SIZE, TerrainVT::FEEDBACK_SIZE, 1, gpu::TextureFormat::RGBA8, gpu::TextureFlags::NO_MIPS | gpu::TextureFlags::READBACK, "terrain_vt_staging");
+			}
+			m_terrain_vt.readback_data.resize(TerrainVT::READBACKS_COUNT * feedback_texels);
+		}
+
+		const Vec2 terrain_size = terrain->getSize();
+		const bool reset = m_terrain_vt.terrain != terrain->m_entity || m_terrain_vt.terrain_size.x != terrain_size.x || m_terrain_vt.terrain_size.y != terrain_size.y;
+		if (reset) {
+			m_terrain_vt.reset(terrain->m_entity, terrain_size);
+			if (m_terrain_vt.page_table_buffer) stream.destroy(m_terrain_vt.page_table_buffer);
+			m_terrain_vt.page_table_buffer = gpu::allocBufferHandle();
+			const u32 size = sizeof(TerrainVT::Header) + m_terrain_vt.page_table.byte_size();
+			const Renderer::MemRef mem = m_renderer.allocate(size);
+			memcpy(mem.data, &m_terrain_vt.header, sizeof(TerrainVT::Header));
+			memset((u8*)mem.data + sizeof(TerrainVT::Header), 0, m_terrain_vt.page_table.byte_size());
+			stream.createBuffer(m_terrain_vt.page_table_buffer, gpu::BufferFlags::SHADER_BUFFER | gpu::BufferFlags::COMPUTE_WRITE, size, mem.data);
+			stream.freeMemory(mem.data, m_renderer.getAllocator());
+		}
+
+		// feedback from pages of the previous terrain is dropped
+		for (u32 i = 0; i < TerrainVT::READBACKS_COUNT; ++i) {
+			TerrainVT::Readback& rb = m_terrain_vt.readbacks[i];
+			if (!compareAndExchange(&rb.state, TerrainVT::Readback::FREE, TerrainVT::Readback::READY)) continue;
+			if (!reset) m_terrain_vt.processFeedback(&m_terrain_vt.readback_data[i * feedback_texels], rb.size, frame);
+		}
+
+		struct {
+			Vec4 terrain;
+			Vec4 detail;
+			IVec4 pass;
+			IVec4 feedback_size;
+			IVec4 pages[TerrainVT::MAX_BAKES];
+			IVec4 entries[TerrainVT::MAX_BAKES];
+		} ub_values;
+
+		auto getUniform = [material](const char* name, float default_value){
+			const Material::Uniform* u = material->findUniform(RuntimeHash(name));
+			return u ? u->float_value : default_value;
+		};
+
+		TerrainVT::Bake bakes[TerrainVT::MAX_BAKES];
+		const u32 bakes_count = m_terrain_vt.allocate(Span(bakes, TerrainVT::MAX_BAKES), frame);
+		ub_values.terrain = Vec4(terrain_size.x, terrain_size.y, getUniform("Detail scale", 1), getUniform("Noise UV scale", 1));
+		ub_values.detail = Vec4(getUniform("Detail diffusion", 0), getUniform("Detail power", 1), m_terrain_vt.header.params.x, 0);
+		ub_values.pass = IVec4(0, TerrainVT::PAGE_SIZE, TerrainVT::PAGE_BORDER, 0);
+		ub_values.feedback_size = IVec4(TerrainVT::FEEDBACK_SIZE, TerrainVT::FEEDBACK_SIZE, 0, 0);
+		for (u32 i = 0; i < bakes_count; ++i) {
+			ub_values.pages[i] = bakes[i].page;
+			ub_values.entries[i] = bakes[i].entry;
+		}
+		const gpu::ProgramHandle program = m_terrain_vt_shader->getProgram(0);
+
+		if (bakes_count > 0) {
+			const Renderer::TransientSlice ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+			const gpu::TextureHandle textures[] = { detail_albedo->handle, detail_normal->handle, terrain->m_splatmap->handle, noise->handle };
+			stream.bindTextures(textures, 0, lengthOf(textures));
+			stream.bindImageTexture(m_terrain_vt.albedo, 0);
+			stream.bindImageTexture(m_terrain_vt.normal, 1);
+			stream.bindShaderBuffer(m_terrain_vt.page_table_buffer, 0, gpu::BindShaderBufferFlags::OUTPUT);
+			stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+			stream.useProgram(program);
+			stream.dispatch(TerrainVT::PAGE_SIZE / 8, TerrainVT::PAGE_SIZE / 8, bakes_count);
+			stream.bindShaderBuffer(m_terrain_vt.page_table_buffer, 0, gpu::BindShaderBufferFlags::NONE);
+			stream.memoryBarrier(gpu::MemoryBarrierType::IMAGE, gpu::INVALID_BUFFER);
+			stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, m_terrain_vt.page_table_buffer);
+		}
+
+		// GPU should be done with feedback copied at least two frames ago, so reading it does not stall
+		for (u32 i = 0; i < TerrainVT::READBACKS_COUNT; ++i) {
+			TerrainVT::Readback& rb = m_terrain_vt.readbacks[i];
+			if (rb.state != TerrainVT::Readback::COPIED || frame - rb.frame < 2) continue;
+
+			rb.state = TerrainVT::Readback::READING;
+			stream.readTexture(rb.staging, 0, Span((u8*)&m_terrain_vt.readback_data[i * feedback_texels], feedback_texels * sizeof(u32)));
+			volatile i32* state = &rb.state;
+			stream.pushLambda([state](){
+				compareAndExchange(state, TerrainVT::Readback::READY, TerrainVT::Readback::READING);
+			});
+			break;
+		}
+
+		// feedback written by terrain draws in the previous frame, newly created feedback texture is only cleared
+		if (!create) {
+			for (TerrainVT::Readback& rb : m_terrain_vt.readbacks) {
+				if (rb.state != TerrainVT::Readback::FREE) continue;
+
+				rb.state = TerrainVT::Readback::COPIED;
+				rb.frame = frame;
+				rb.size.x = minimum((m_render_size.x + TerrainVT::FEEDBACK_SCALE - 1) / TerrainVT::FEEDBACK_SCALE, TerrainVT::FEEDBACK_SIZE);
+				rb.size.y = minimum((m_render_size.y + TerrainVT::FEEDBACK_SCALE - 1) / TerrainVT::FEEDBACK_SCALE, TerrainVT::FEEDBACK_SIZE);
+				stream.memoryBarrier(gpu::MemoryBarrierType::IMAGE, gpu::INVALID_BUFFER);
+				stream.copy(rb.staging, m_terrain_vt.feedback, 0, 0);
+				break;
+			}
+		}
+
+		ub_values.pass.x = 1;
+		const Renderer::TransientSlice clear_ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+		stream.bindImageTexture(m_terrain_vt.feedback, 2);
+		stream.bindUniformBuffer(UniformBuffer::DRAWCALL, clear_ub.buffer, clear_ub.offset, clear_ub.size);
+		stream.useProgram(program);
+		stream.dispatch(TerrainVT::FEEDBACK_SIZE / 8, TerrainVT::FEEDBACK_SIZE / 8, 1);
+		stream.memoryBarrier(gpu::MemoryBarrierType::IMAGE, gpu::INVALID_BUFFER);
+	}
+
 	void renderTerrains(CameraParamsHandle cp_handle, RenderStateHandle render_state_handle, LuaWrapper::Optional<const char*> define) {
 		const CameraParams cp = resolveCameraParams(cp_handle);
 		const u32 define_mask = define.valid && define.value[0] ? 1 << m_renderer.getShaderDefineIdx(define.value) : 0;
 		const gpu::StateFlags render_state = m_render_states[render_state_handle];
 
-		m_renderer.pushJob("terrain", [this, cp, render_state, define_mask](DrawStream& stream){
+		if (!cp.is_shadow) {
+			for (Terrain* terrain : m_scene->getTerrains()) {
+				terrain->streamTiles(cp.pos, m_renderer.frameNumber());
+			}
+			updateTerrainVT();
+		}
+
+		struct {
+			EntityPtr terrain;
+			u32 define_mask;
+			gpu::TextureHandle textures[2];
+			gpu::BufferHandle page_table;
+			gpu::TextureHandle feedback;
+		} vt;
+		vt.terrain = cp.is_shadow ? INVALID_ENTITY : m_terrain_vt.terrain;
+		vt.define_mask = 1 << m_renderer.getShaderDefineIdx("VT");
+		vt.textures[0] = m_terrain_vt.albedo;
+		vt.textures[1] = m_terrain_vt.normal;
+		vt.page_table = m_terrain_vt.page_table_buffer;
+		vt.feedback = m_terrain_vt.feedback;
+
+		m_renderer.pushJob("terrain", [this, cp, render_state, define_mask, vt](DrawStream& stream){
 			const HashMap<EntityRef, Terrain*>& terrains = m_scene->getTerrains();
 			if(terrains.empty()) return;
 
@@ -1647,7 +2505,9 @@ struct PipelineImpl final : Pipeline
 				const Vec3 scale = terrain->getScale();
 				const Vec2 hm_size = terrain->getSize();
 				Shader* shader = terrain->m_material->getShader();
-				const gpu::ProgramHandle program = shader->getProgram(render_state, decl, define_mask | terrain->m_material->getDefineMask());
+				const bool use_vt = vt.terrain == terrain->m_entity;
+				const u32 terrain_define_mask = use_vt ? define_mask | vt.define_mask : define_mask;
+				const gpu::ProgramHandle program = shader->getProgram(render_state, decl, terrain_define_mask | terrain->m_material->getDefineMask());
 				const Material* material = terrain->m_material;
 				if (isinf(pos.x) || isinf(pos.y) || isinf(pos.z)) continue;
 
@@ -1657,19 +2517,16 @@ struct PipelineImpl final : Pipeline
 					Vec4 pos;
 					Vec4 lpos;
 					Vec4 terrain_scale;
+					// area covered by bound textures, xy - origin, zw - size
+					Vec4 tex_rect;
+					Vec2 tile_origin;
 					Vec2 hm_size;
 					float cell_size;
 				};
 
 				Quad quad;
-				quad.pos = Vec4(pos, 0);
-				quad.lpos = Vec4(rot.conjugated().rotate(-pos), 0);
-				quad.hm_size = hm_size;
-
+				quad.terrain_scale = Vec4(scale, 0);
 				ref_pos = rot.conjugated().rotate(-ref_pos);
-				IVec4 prev_from_to;
-				float s = scale.x / terrain->m_tesselation;
-				bool first = true;
 				
 				stream.useProgram(program);
 				stream.bindIndexBuffer(gpu::INVALID_BUFFER);
@@ -1677,49 +2534,101 @@ struct PipelineImpl final : Pipeline
 				stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
 
 				stream.bind(0, material->m_bind_group);
-				for (;;) {
-					// round 
-					IVec2 from = IVec2((ref_pos.xz() + Vec2(0.5f * s)) / float(s)) - IVec2(terrain->m_base_grid_res / 2);
-					from.x = from.x & ~1;
-					from.y = from.y & ~1;
-					IVec2 to = from + IVec2(terrain->m_base_grid_res);
-
-					// clamp
-					quad.from_to_sup = IVec4(from, to);
-					
-					from.x = clamp(from.x, 0, (int)ceil(hm_size.x / s));
-					from.y = clamp(from.y, 0, (int)ceil(hm_size.y / s));
-					to.x = clamp(to.x, 0, (int)ceil(hm_size.x / s));
-					to.y = clamp(to.y, 0, (int)ceil(hm_size.y / s));
-
-					auto draw_rect = [&](const IVec2& subfrom, const IVec2& subto){
-						if (subfrom.x >= subto.x || subfrom.y >= subto.y) return;
-						quad.from_to = IVec4(subfrom, subto);
-						quad.terrain_scale = Vec4(scale, 0);
-						quad.cell_size = s;
-					
-						const Renderer::TransientSlice ub = m_renderer.allocUniform(&quad, sizeof(quad));
+				if (use_vt) {
+					stream.bindTextures(vt.textures, 6, lengthOf(vt.textures));
+					stream.bindShaderBuffer(vt.page_table, 6, gpu::BindShaderBufferFlags::NONE);
+					stream.bindImageTexture(vt.feedback, 0);
+				}
+				
+				// nested rings of cells around camera, cell size doubles with each ring
+				// `origin` and `size` - area to cover, in terrain's local space
+				auto draw_rings = [&](const Vec2& origin, const Vec2& size){
+					quad.pos = Vec4(pos + rot.rotate(Vec3(origin.x, 0, origin.y)), 0);
+					quad.lpos = Vec4(rot.conjugated().rotate(-pos) - Vec3(origin.x, 0, origin.y), 0);
+					quad.tile_origin = origin;
+					quad.hm_size = size;
+					const Vec2 local_ref_pos = ref_pos.xz() - origin;
+
+					IVec4 prev_from_to;
+					float s = scale.x / terrain->m_tesselation;
+					bool first = true;
+					for (;;) {
+						// round 
+						IVec2 from = IVec2((local_ref_pos + Vec2(0.5f * s)) / float(s)) - IVec2(terrain->m_base_grid_res / 2);
+						from.x = from.x & ~1;
+						from.y = from.y & ~1;
+						IVec2 to = from + IVec2(terrain->m_base_grid_res);
+
+						// clamp
+						quad.from_to_sup = IVec4(from, to);
+						
+						from.x = clamp(from.x, 0, (int)ceil(size.x / s));
+						from.y = clamp(from.y, 0, (int)ceil(size.y / s));
+						to.x = clamp(to.x, 0, (int)ceil(size.x / s));
+						to.y = clamp(to.y, 0, (int)ceil(size.y / s));
+
+						auto draw_rect = [&](const IVec2& subfrom, const IVec2& subto){
+							if (subfrom.x >= subto.x || subfrom.y >= subto.y) return;
+							quad.from_to = IVec4(subfrom, subto);
+							quad.cell_size = s;
+						
+							const Renderer::TransientSlice ub = m_renderer.allocUniform(&quad, sizeof(quad));
 
-						stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
-						stream.drawArraysInstanced((subto.x - subfrom.x) * 2 + 2, subto.y - subfrom.y);
-					};
+							stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+							stream.drawArraysInstanced((subto.x - subfrom.x) * 2 + 2, subto.y - subfrom.y);
+						};
 
-					if (first) {
-						draw_rect(from, to);
-						first = false;
-					}
-					else {
-						draw_rect(from, IVec2(to.x, prev_from_to.y));
-						draw_rect(IVec2(from.x, prev_from_to.w), to);
+						if (first) {
+							draw_rect(from, to);
+							first = false;
+						}
+						else {
+							draw_rect(from, IVec2(to.x, prev_from_to.y));
+							draw_rect(IVec2(from.x, prev_from_to.w), to);
+							
+							draw_rect(IVec2(prev_from_to.z, prev_from_to.y), IVec2(to.x, prev_from_to.w));
+							draw_rect(IVec2(from.x, prev_from_to.y), IVec2(prev_from_to.x, prev_from_to.w));
+						}
 						
-						draw_rect(IVec2(prev_from_to.z, prev_from_to.y), IVec2(to.x, prev_from_to.w));
-						draw_rect(IVec2(from.x, prev_from_to.y), IVec2(prev_from_to.x, prev_from_to.w));
+						if (from.x <= 0 && from.y <= 0 && to.x * s >= size.x && to.y * s >= size.y) break;
+
+						s *= 2;
+						prev_from_to = IVec4(from / 2, to / 2);
 					}
-					
-					if (from.x <= 0 && from.y <= 0 && to.x * s >= hm_size.x && to.y * s >= hm_size.y) break;
+				};
+
+				const u32 tiles_count = terrain->getTilesCount();
+				if (tiles_count == 0) {
+					quad.tex_rect = Vec4(0, 0, hm_size.x, hm_size.y);
+					draw_rings(Vec2(0), hm_size);
+					continue;
+				}
 
-					s *= 2;
-					prev_from_to = IVec4(from / 2, to / 2);
+				// tiles which are not streamed in yet use material's textures
+				Texture* base_colormap = material->getTextureByName("Satellite");
+				const gpu::TextureHandle base_textures[] = {
+					terrain->m_heightmap->handle,
+					terrain->m_splatmap ? terrain->m_splatmap->handle : gpu::INVALID_TEXTURE,
+					base_colormap ? base_colormap->handle : gpu::INVALID_TEXTURE
+				};
+				const Vec2 tile_size = hm_size / float(tiles_count);
+				for (u32 j = 0; j < tiles_count; ++j) {
+					for (u32 i = 0; i < tiles_count; ++i) {
+						const Terrain::Tile& tile = terrain->getTile(i, j);
+						const Vec2 origin = Vec2(float(i), float(j)) * tile_size;
+						if (tile.isReady()) {
+							stream.bindTextures(&tile.heightmap->handle, 0, 1);
+							if (tile.splatmap) stream.bindTextures(&tile.splatmap->handle, 3, 1);
+							if (tile.colormap) stream.bindTextures(&tile.colormap->handle, 4, 1);
+							quad.tex_rect = Vec4(origin.x, origin.y, tile_size.x, tile_size.y);
+						}
+						else {
+							stream.bindTextures(&base_textures[0], 0, 1);
+							stream.bindTextures(&base_textures[1], 3, 2);
+							quad.tex_rect = Vec4(0, 0, hm_size.x, hm_size.y);
+						}
+						draw_rings(origin, tile_size);
+					}
 				}
 			}
 		});
@@ -1728,14 +2637,6 @@ struct PipelineImpl final : Pipeline
 	void renderGrass(lua_State* L, CameraParamsHandle cp_handle, LuaWrapper::Optional<RenderStateHandle> state_handle) {
 		PROFILE_FUNCTION();
 		const CameraParams cp = resolveCameraParams(cp_handle);
-		if (!cp.is_shadow) {
-			for (Terrain* terrain : m_scene->getTerrains()) {
-				const Transform tr = m_scene->getUniverse().getTransform(terrain->m_entity);
-				Transform rel_tr = tr;
-				rel_tr.pos = tr.pos - cp.pos;
-				terrain->createGrass(Vec2(-(float)rel_tr.pos.x, -(float)rel_tr.pos.z), m_renderer.frameNumber());
-			}
-		}
 
 		u32 define_mask = 0;
 		if (lua_istable(L, 2)) {
@@ -1754,28 +2655,95 @@ struct PipelineImpl final : Pipeline
 		gpu::StateFlags render_state = state_handle.valid ? m_render_states[state_handle.value] : gpu::StateFlags::NONE;
 
 		m_renderer.pushJob("grass", [this, cp, define_mask, render_state](DrawStream& stream){
+			if (!m_grass_shader->isReady()) return;
+			const gpu::ProgramHandle grass_program = m_grass_shader->getProgram(0);
 			const HashMap<EntityRef, Terrain*>& terrains = m_scene->getTerrains();
 			const Universe& universe = m_scene->getUniverse();
 			const float global_lod_multiplier = m_renderer.getLODMultiplier();
 
-			u32 quad_count = 0;
-			u32 culled_count = 0;
-			u32 total_instance_count = 0;
-
+			u32 types_count = 0;
 			for (const Terrain* terrain : terrains) {
+				if (!terrain->m_heightmap || !terrain->m_heightmap->isReady()) continue;
+				if (!terrain->m_splatmap || !terrain->m_splatmap->isReady()) continue;
+
 				const Transform tr = universe.getTransform(terrain->m_entity);
-				Transform rel_tr = tr;
-				rel_tr.pos = tr.pos - cp.pos;
-				const Vec3 rel_pos(rel_tr.pos);
+				const Vec3 rel_pos(tr.pos - cp.pos);
 				const Vec3 ref_lod_pos = Vec3(m_viewport.pos - tr.pos);
 				const Frustum frustum = cp.frustum.getRelative(tr.pos);
+				const Vec2 terrain_size = terrain->getSize();
 
-				for (const Terrain::GrassType& type : terrain->m_grass_types) {
+				for (i32 type_idx = 0; type_idx < terrain->m_grass_types.size(); ++type_idx) {
+					const Terrain::GrassType& type = terrain->m_grass_types[type_idx];
 					if (!type.m_grass_model || !type.m_grass_model->isReady()) continue;
-
-					const i32 to_mesh = type.m_grass_model->getLODIndices()[0].to;
-					const HashMap<u64, Terrain::GrassQuad>& quads = type.m_quads;
-					for (i32 i = 0; i <= to_mesh; ++i) {
+					if (type.m_spacing <= 0) continue;
+
+					// instances fade out in (half_range, 2 * half_range), nothing is generated beyond that
+					const float half_range = type.m_distance * 0.5f * global_lod_multiplier;
+					const Vec2 from = maximum(ref_lod_pos.xz() - Vec2(2 * half_range), Vec2(0));
+					const Vec2 to = minimum(ref_lod_pos.xz() + Vec2(2 * half_range), terrain_size);
+					if (from.x >= to.x || from.y >= to.y) continue;
+
+					const IVec2 first_cell = IVec2(from / type.m_spacing);
+					const IVec2 last_cell = IVec2(to / type.m_spacing);
+					const IVec2 cells(minimum(last_cell.x - first_cell.x + 1, (i32)GRASS_MAX_CELLS), minimum(last_cell.y - first_cell.y + 1, (i32)GRASS_MAX_CELLS));
+					if (type.m_grass_model->getResidentLOD() > 0) {
+						// grass draws only lod 0
+						type.m_grass_model->requestLOD(0);
+						continue;
+					}
+					const u32 meshes_count = minimum(type.m_grass_model->getLODIndices()[0].to + 1, (i32)GRASS_MAX_MESHES);
+
+					Indirect* commands = (Indirect*)stream.userAlloc(sizeof(Indirect) * meshes_count);
+					for (u32 i = 0; i < meshes_count; ++i) {
+						commands[i].vertex_count = type.m_grass_model->getMesh(i).indices_count;
+						commands[i].instance_count = 0;
+						commands[i].first_index = 0;
+						commands[i].base_vertex = 0;
+						commands[i].base_instance = 0;
+					}
+					stream.update(m_grass_indirect_buffer, commands, sizeof(Indirect) * meshes_count);
+
+					struct {
+						Vec4 planes[6];
+						Vec4 camera;
+						Vec4 terrain;
+						IVec4 cells;
+						IVec4 params;
+						Vec4 grass;
+						IVec4 pass;
+					} ub_values;
+					for (u32 i = 0; i < 6; ++i) {
+						ub_values.planes[i] = Vec4(frustum.getNormal((Frustum::Planes)i), frustum.ds[i]);
+					}
+					ub_values.camera = Vec4(ref_lod_pos, half_range);
+					ub_values.terrain = Vec4(terrain_size.x, terrain_size.y, terrain->getXZScale(), terrain->getYScale());
+					ub_values.cells = IVec4(first_cell, cells);
+					ub_values.params = IVec4(type_idx, (i32)type.m_rotation_mode, GRASS_MAX_INSTANCES, meshes_count);
+					ub_values.grass = Vec4(type.m_spacing, type.m_grass_model->getOriginBoundingRadius(), 0, 0);
+					ub_values.pass = IVec4(0);
+					const Renderer::TransientSlice generate_ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+					ub_values.pass.x = 1;
+					const Renderer::TransientSlice finalize_ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+
+					const gpu::TextureHandle textures[] = { terrain->m_heightmap->handle, terrain->m_splatmap->handle };
+					stream.bindTextures(textures, 0, lengthOf(textures));
+					stream.bindShaderBuffer(m_grass_instances_buffer, 0, gpu::BindShaderBufferFlags::OUTPUT);
+					stream.bindShaderBuffer(m_grass_indirect_buffer, 1, gpu::BindShaderBufferFlags::OUTPUT);
+					stream.useProgram(grass_program);
+					stream.bindUniformBuffer(UniformBuffer::DRAWCALL, generate_ub.buffer, generate_ub.offset, generate_ub.size);
+					stream.dispatch((cells.x + 15) / 16, (cells.y + 15) / 16, 1);
+					stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, m_grass_indirect_buffer);
+					stream.bindUniformBuffer(UniformBuffer::DRAWCALL, finalize_ub.buffer, finalize_ub.offset, finalize_ub.size);
+					stream.dispatch(1, 1, 1);
+					stream.memoryBarrier(gpu::MemoryBarrierType::COMMAND, m_grass_indirect_buffer);
+					stream.memoryBarrier(gpu::MemoryBarrierType::VERTEX, m_grass_instances_buffer);
+					stream.bindShaderBuffer(m_grass_instances_buffer, 0, gpu::BindShaderBufferFlags::NONE);
+					stream.bindShaderBuffer(m_grass_indirect_buffer, 1, gpu::BindShaderBufferFlags::NONE);
+
+					const Vec4 drawcall_data(rel_pos, 0);
+					const Renderer::TransientSlice drawcall_ub = m_renderer.allocUniform(&drawcall_data, sizeof(drawcall_data));
+					stream.bindIndirectBuffer(m_grass_indirect_buffer);
+					for (u32 i = 0; i < meshes_count; ++i) {
 						const Mesh& mesh = type.m_grass_model->getMesh(i);
 
 						Shader* shader = mesh.material->getShader();
@@ -1786,45 +2754,18 @@ struct PipelineImpl final : Pipeline
 
 						stream.useProgram(shader->getProgram(state, mesh.vertex_decl, define_mask | material->getDefineMask()));
 						stream.bind(0, material->m_bind_group);
+						stream.bindUniformBuffer(UniformBuffer::DRAWCALL, drawcall_ub.buffer, drawcall_ub.offset, drawcall_ub.size);
 						stream.bindIndexBuffer(mesh.index_buffer_handle);
 						stream.bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
-						
-						for (const Terrain::GrassQuad& quad : quads) {
-							if (quad.instances_count == 0) continue;
-							if (!frustum.intersectAABB(quad.aabb)) {
-								++culled_count;
-								continue;
-							}
-
-							const Vec2 quad_size(type.m_spacing * 32);
-							const Vec2 quad_center = Vec2(quad.ij) * quad_size + quad_size * 0.5f;
-							const float distance = length(quad_center - ref_lod_pos.xz());
-
-							const float half_range = type.m_distance * 0.5f * global_lod_multiplier;
-							float count_scale = 1 - clamp(distance - half_range, 0.f, half_range) / half_range; 
-							count_scale *= count_scale;
-							count_scale *= count_scale;
-
-							const u32 instance_count = u32(quad.instances_count * count_scale);
-							if (instance_count  == 0) {
-								++culled_count;
-								continue;
-							}
-
-							const Vec4 drawcall_data(rel_pos, distance);
-							const Renderer::TransientSlice drawcall_ub = m_renderer.allocUniform(&drawcall_data, sizeof(drawcall_data));
-							stream.bindUniformBuffer(UniformBuffer::DRAWCALL, drawcall_ub.buffer, drawcall_ub.offset, drawcall_ub.size);
-							stream.bindVertexBuffer(1, quad.instances, 0, sizeof(Vec4) * 2);
-							stream.drawIndexedInstanced(mesh.indices_count, instance_count, mesh.index_type);
-							++quad_count;
-							total_instance_count += instance_count;
-						}
+						if (mesh.quantization_buffer) stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
+						stream.bindVertexBuffer(1, m_grass_instances_buffer, 0, sizeof(Vec4) * 2);
+						stream.drawIndirect(mesh.index_type, u32(sizeof(Indirect) * i), 1);
 					}
+					stream.bindIndirectBuffer(gpu::INVALID_BUFFER);
+					++types_count;
 				}
 			}
-			profiler::pushInt("Quad count", quad_count);
-			profiler::pushInt("Culled", culled_count);
-			profiler::pushInt("Instances", total_instance_count);
+			profiler::pushInt("Grass types", types_count);
 
 			stream.bindVertexBuffer(0, gpu::INVALID_BUFFER, 0, 0);
 			stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
@@ -1847,15 +2788,21 @@ struct PipelineImpl final : Pipeline
 			const u8 bucket_idx = view.layer_to_bucket[material->getLayer()];
 			if (bucket_idx == 0xff) continue;
 
-			const u32 particles_count = emitter.getParticlesCount();
-			if (particles_count == 0) continue;
+			if (emitter.isGPU()) {
+				// particles count is known only on GPU
+				if (!emitter.getGPUData().counters) continue;
+			}
+			else {
+				const u32 particles_count = emitter.getParticlesCount();
+				if (particles_count == 0) continue;
 
-			const u32 size = emitter.getParticlesDataSizeBytes();
-			if (size == 0) continue;
+				const u32 size = emitter.getParticlesDataSizeBytes();
+				if (size == 0) continue;
+			}
 
 			const u64 type_mask = (u64)RenderableTypes::PARTICLES << 32;
 			const u64 subrenderable = emitter.m_entity.index | type_mask;
-			inserter.push(material->getSortKey() | ((u64)bucket_idx << SORT_KEY_BUCKET_SHIFT), subrenderable);
+			inserter.push(material->getSortKey() | ((u64)RenderableTypes::PARTICLES << SORT_KEY_TYPE_SHIFT) | ((u64)bucket_idx << SORT_KEY_BUCKET_SHIFT), subrenderable);
 		}
 	}
 
@@ -1971,6 +2918,70 @@ struct PipelineImpl final : Pipeline
 		stream.dispatch(num_groups_x, num_groups_y, num_groups_z);
 	}
 
+	// builds min depth pyramid, instanced models are tested against it in the next frame
+	void buildHiZ(PipelineTexture depth_buffer) {
+		if (!m_hiz_shader->isReady()) return;
+		const gpu::TextureHandle depth = toHandle(depth_buffer);
+		if (!depth) return;
+
+		const gpu::ProgramHandle init_program = m_hiz_shader->getProgram(1 << m_renderer.getShaderDefineIdx("PASS0"));
+		const gpu::ProgramHandle downsample_program = m_hiz_shader->getProgram(0);
+		if (!init_program || !downsample_program) return;
+
+		const IVec2 depth_size = depth_buffer.type == PipelineTexture::RENDERBUFFER
+			? m_renderbuffers[depth_buffer.renderbuffer].size
+			: IVec2(m_viewport.w, m_viewport.h);
+		if (depth_size.x <= 0 || depth_size.y <= 0) return;
+
+		// level 0 is half the resolution of depth buffer, other levels are stacked to the right of it
+		IVec2 size((depth_size.x + 1) / 2, (depth_size.y + 1) / 2);
+		IVec2 offset(0);
+		IVec2 atlas_size(0);
+		u32 level_count = 0;
+		for (;;) {
+			m_hiz.levels[level_count] = IVec4(offset, size);
+			atlas_size.x = maximum(atlas_size.x, offset.x + size.x);
+			atlas_size.y = maximum(atlas_size.y, offset.y + size.y);
+			++level_count;
+			if ((size.x == 1 && size.y == 1) || level_count == HiZ::MAX_LEVELS) break;
+
+			offset = level_count == 1 ? IVec2(size.x, 0) : IVec2(offset.x, offset.y + size.y);
+			size = IVec2((size.x + 1) / 2, (size.y + 1) / 2);
+		}
+
+		DrawStream& stream = m_renderer.getDrawStream();
+		if (m_hiz.atlas_size != atlas_size) {
+			if (m_hiz.texture) stream.destroy(m_hiz.texture);
+			const gpu::TextureFlags flags = gpu::TextureFlags::COMPUTE_WRITE
+				| gpu::TextureFlags::NO_MIPS
+				| gpu::TextureFlags::POINT_FILTER
+				| gpu::TextureFlags::CLAMP_U
+				| gpu::TextureFlags::CLAMP_V;
+			m_hiz.texture = m_renderer.createTexture(atlas_size.x, atlas_size.y, 1, gpu::TextureFormat::R32F, flags, Renderer::MemRef(), "hiz");
+			m_hiz.atlas_size = atlas_size;
+		}
+
+		stream.bindTextures(&depth, 0, 1);
+		stream.bindImageTexture(m_hiz.texture, 0);
+		for (u32 i = 0; i < level_count; ++i) {
+			const IVec4 src = i == 0 ? IVec4(IVec2(0), depth_size) : m_hiz.levels[i - 1];
+			const IVec4 dst = m_hiz.levels[i];
+			const IVec4 ub_values[] = { src, dst };
+			const Renderer::TransientSlice ub = m_renderer.allocUniform(ub_values, sizeof(ub_values));
+			stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+			stream.useProgram(i == 0 ? init_program : downsample_program);
+			stream.dispatch((dst.z + 15) / 16, (dst.w + 15) / 16, 1);
+			stream.memoryBarrier(gpu::MemoryBarrierType::IMAGE, gpu::INVALID_BUFFER);
+		}
+		stream.bindImageTexture(gpu::INVALID_TEXTURE, 0);
+
+		m_hiz.depth_size = depth_size;
+		m_hiz.level_count = level_count;
+		m_hiz.camera_pos = m_viewport.pos;
+		m_hiz.view_projection = m_viewport.getProjectionNoJitter() * m_viewport.getView(m_viewport.pos);
+		m_hiz.built = true;
+	}
+
 	gpu::TextureHandle toHandle(PipelineTexture tex) const {
 		switch (tex.type) {
 			case PipelineTexture::RENDERBUFFER: return tex.renderbuffer < (u32)m_renderbuffers.size() ? m_renderbuffers[tex.renderbuffer].handle : gpu::INVALID_TEXTURE;
@@ -2103,12 +3114,18 @@ struct PipelineImpl final : Pipeline
 
 	CameraParamsHandle getCameraParams() { return (CameraParamsHandle)CameraParamsEnum::MAIN; }
 
+	// caster-receiver extrusion - planes through silhouette edges of the camera frustum, parallel to light, are put in extra planes
+	// of the shadow frustum, casters outside of them can not shadow anything visible
+	// `camera_offset` is the origin of `camera_frustum` relative to the origin of `shadow_camera_frustum`
 	static void findExtraShadowcasterPlanes(const Vec3& light_forward
 		, const Frustum& camera_frustum
+		, const Vec3& camera_offset
 		, ShiftedFrustum* shadow_camera_frustum)
 	{
 		static const Frustum::Planes planes[] = {
 			Frustum::Planes::LEFT, Frustum::Planes::TOP, Frustum::Planes::RIGHT, Frustum::Planes::BOTTOM };
+		// corner on the edge shared by planes[i] and the previous plane
+		static const u32 edge_points[] = { 2, 1, 0, 3 };
 		bool prev_side = dot(light_forward, camera_frustum.getNormal(planes[lengthOf(planes) - 1])) < 0;
 		int out_plane = (int)Frustum::Planes::EXTRA0;
 		Vec3 camera_frustum_center = camera_frustum.computeBoundingSphere().position;
@@ -2120,9 +3137,16 @@ struct PipelineImpl final : Pipeline
 				Vec3 n0 = camera_frustum.getNormal(planes[i]);
 				Vec3 n1 = camera_frustum.getNormal(planes[(i + lengthOf(planes) - 1) % lengthOf(planes)]);
 				Vec3 line_dir = cross(n1, n0);
-				Vec3 n = normalize(cross(light_forward, line_dir));
-				if (dot(camera_frustum_center, n) < 0) n = -n;
-				shadow_camera_frustum->setPlane((Frustum::Planes)out_plane, n, Vec3::ZERO);
+				Vec3 n = cross(light_forward, line_dir);
+				// edge parallel to light
+				if (squaredLength(n) < 1e-8f) {
+					prev_side = side;
+					continue;
+				}
+				n = normalize(n);
+				const Vec3 point = camera_frustum.points[edge_points[i]];
+				if (dot(camera_frustum_center - point, n) < 0) n = -n;
+				shadow_camera_frustum->setPlane((Frustum::Planes)out_plane, n, point + camera_offset);
 				++out_plane;
 				if (out_plane >(int)Frustum::Planes::EXTRA1) break;
 			}
@@ -2203,6 +3227,17 @@ struct PipelineImpl final : Pipeline
 		Light lights[64];
 	};
 
+	// continuous lod of a furry model, selected the same way as for regular model instances
+	float getFurLOD(Model& model, float scale, float squared_distance) const {
+		const float lod_multiplier = m_renderer.getLODMultiplier() / m_scene->getCameraLODMultiplier(m_viewport.fov, m_viewport.is_ortho);
+		return model.clampLOD(model.getLOD(squared_distance / (lod_multiplier * scale * scale)));
+	}
+
+	// all shells are drawn as instances of one draw call, distant furs get fewer shells spread over the same thickness
+	static u32 getFurLayers(const FurComponent& fur, float lod) {
+		return maximum(u32(fur.layers / (1 + lod)), 1u);
+	}
+
 	void setupFur(View& view) {
 		if (view.cp.is_shadow) return;
 
@@ -2210,23 +3245,28 @@ struct PipelineImpl final : Pipeline
 		if (furs.empty()) return;
 
 		Span<const ModelInstance> mi = m_scene->getModelInstances();
+		const Transform* entity_data = m_scene->getUniverse().getTransforms();
 		Sorter::Inserter inserter(view.sorter);
 		
 		const u64 type_mask = (u64)RenderableTypes::FUR << 32;
 		
-		// TODO frustum culling
-		// TODO render correct LOD
 		for (auto iter = furs.begin(); iter.isValid(); ++iter) {
 			const EntityRef e = iter.key();
 			if (e.index >= (i32)mi.length()) continue;
 			if (!mi[e.index].flags.isSet(ModelInstance::VALID)) continue;
 			if (!iter.value().enabled) continue;
 
-			const Model* model = mi[e.index].model;
+			Model* model = mi[e.index].model;
 			if (!model) continue;
 			if (!model->isReady()) continue;
 
-			for (i32 i = 0; i < model->getMeshCount(); ++i) {
+			const Transform& tr = entity_data[e.index];
+			const float radius = model->getOriginBoundingRadius() * tr.scale;
+			if (!view.cp.frustum.intersectsAABB(tr.pos - Vec3(radius), Vec3(2 * radius))) continue;
+
+			const float lod = getFurLOD(*model, tr.scale, (float)squaredLength(tr.pos - view.cp.pos));
+			const LODMeshIndices& lod_indices = model->getLODIndices()[u32(lod)];
+			for (i32 i = lod_indices.from; i <= lod_indices.to; ++i) {
 				const Mesh& mesh = model->getMesh(i);
 				if (mesh.type != Mesh::SKINNED) continue;
 
@@ -2247,7 +3287,9 @@ struct PipelineImpl final : Pipeline
 		const DVec3 camera_pos = view.cp.pos;
 		for (auto iter = geometries.begin(), end = geometries.end(); iter != end; ++iter) {
 			const ProceduralGeometry& pg = iter.value();
-			if (!pg.vertex_buffer) continue;
+			const ProceduralGeometryDynamic* dyn = pg.dynamic;
+			// dynamic geometry is drawn once its region for this frame is uploaded
+			if (dyn ? dyn->uploaded_frame != m_renderer.frameNumber() || pg.vertex_data.empty() : !pg.vertex_buffer) continue;
 			if (!pg.material || !pg.material->isReady()) continue;
 
 			u8 bucket_idx = view.layer_to_bucket[pg.material->getLayer()];
@@ -2266,13 +3308,22 @@ struct PipelineImpl final : Pipeline
 			
 			bucket.stream.useProgram(program);
 			bucket.stream.bind(0, pg.material->m_bind_group);
-			bucket.stream.bindIndexBuffer(pg.index_buffer);
-			bucket.stream.bindVertexBuffer(0, pg.vertex_buffer, 0, stride);
+			gpu::BufferHandle vertex_buffer = pg.vertex_buffer;
+			gpu::BufferHandle index_buffer = pg.index_buffer;
+			u32 vertex_offset = 0;
+			u32 index_offset = 0;
+			if (dyn) {
+				vertex_buffer = dyn->buffer;
+				index_buffer = pg.index_data.empty() ? gpu::INVALID_BUFFER : dyn->buffer;
+				vertex_offset = dyn->region * dyn->region_size;
+				index_offset = vertex_offset + dyn->index_offset;
+			}
+			bucket.stream.bindIndexBuffer(index_buffer);
+			bucket.stream.bindVertexBuffer(0, vertex_buffer, vertex_offset, stride);
 			bucket.stream.bindVertexBuffer(1, gpu::INVALID_BUFFER, 0, 0);
 
-			if (pg.index_buffer) {
-				const u32 count = (u32)pg.index_data.size() / (pg.index_type == gpu::DataType::U16 ? 2 : 4);
-				bucket.stream.drawIndexed(0, count, pg.index_type);
+			if (index_buffer) {
+				bucket.stream.drawIndexed(index_offset, pg.getIndexCount(), pg.index_type);
 			}
 			else {
 				const u32 vertex_count = (u32)pg.vertex_data.size() / stride;
@@ -2296,24 +3347,44 @@ struct PipelineImpl final : Pipeline
 			u32 indirect_offset;
 			float radius;
 			u32 batch_size;
-			float padding;
+			u32 output_capacity;
 			Vec4 camera_planes[6];
 			IVec4 indices_count[32];
+			Matrix hiz_view_projection;
+			Vec4 hiz_camera_offset;
+			IVec4 hiz_size;
+			IVec4 hiz_levels[HiZ::MAX_LEVELS];
 		};
 
 		UBValues ub_values;
 		toPlanes(view.cp, Span(ub_values.camera_planes));
+		const bool occlusion = view.hiz.valid && !view.cp.is_shadow;
+		if (occlusion) {
+			ub_values.hiz_view_projection = view.hiz.view_projection;
+			ub_values.hiz_size = IVec4(view.hiz.depth_size, IVec2(view.hiz.level_count, 0));
+			memcpy(ub_values.hiz_levels, view.hiz.levels, sizeof(view.hiz.levels));
+			stream.bindImageTexture(view.hiz.texture, 0);
+		}
 
 		const gpu::BufferHandle culled_buffer = m_instanced_meshes_buffer;
 		stream.bindShaderBuffer(m_indirect_buffer, 2, gpu::BindShaderBufferFlags::OUTPUT);
-		const gpu::ProgramHandle gather_shader = m_instancing_shader->getProgram(1 << m_renderer.getShaderDefineIdx("PASS3"));
+		// gather must see the same visibility as cull
+		const u32 occlusion_define = occlusion ? 1 << m_renderer.getShaderDefineIdx("OCCLUSION") : 0;
+		const gpu::ProgramHandle gather_shader = m_instancing_shader->getProgram(occlusion_define | 1 << m_renderer.getShaderDefineIdx("PASS3"));
 		const gpu::ProgramHandle indirect_shader = m_instancing_shader->getProgram(1 << m_renderer.getShaderDefineIdx("PASS2"));
-		u32 cull_shader_defines = 1 << m_renderer.getShaderDefineIdx("PASS1");
+		u32 cull_shader_defines = occlusion_define | 1 << m_renderer.getShaderDefineIdx("PASS1");
 		if (!view.cp.is_shadow) cull_shader_defines |= 1 << m_renderer.getShaderDefineIdx("UPDATE_LODS");
 		const gpu::ProgramHandle cull_shader = m_instancing_shader->getProgram(cull_shader_defines);
 		const gpu::ProgramHandle init_shader = m_instancing_shader->getProgram(1 << m_renderer.getShaderDefineIdx("PASS0"));
 		const gpu::ProgramHandle update_lods_shader = m_instancing_shader->getProgram(1 << m_renderer.getShaderDefineIdx("UPDATE_LODS"));
 
+		// 256 threads per group, big batches are split in rows of at most MAX_DISPATCH_GROUPS groups
+		auto dispatchInstances = [&](u32 count) {
+			const u32 groups = (count + 255) / 256;
+			const u32 groups_x = minimum(groups, MAX_DISPATCH_GROUPS);
+			stream.dispatch(groups_x, (groups + groups_x - 1) / groups_x, 1);
+		};
+
 		for (auto iter = ims.begin(), end = ims.end(); iter != end; ++iter) {
 			const InstancedModel& im = iter.value();
 			Model* m = im.model;
@@ -2344,32 +3415,60 @@ struct PipelineImpl final : Pipeline
 			} cells[16];
 			u32 cell_count = 0;
 
-			for (u32 i = 0; i < 16; ++i) {
-				const InstancedModel::Grid::Cell& cell = im.grid.cells[i];
-
-				if (cell.instance_count > 0) {
-					const bool visible = frustum.intersectAABBWithOffset(cell.aabb, radius);
-					const Vec3 cell_center = (cell.aabb.max + cell.aabb.min) * 0.5f;
-					const Vec3 cell_half_extents = (cell.aabb.max - cell.aabb.min) * 0.5f;
-					const float cell_radius = length(cell_half_extents);
-					if (length(origin.pos - view.cp.pos + cell_center) - cell_radius < draw_distance) {
-						const bool can_merge = cell_count > 0 && cells[cell_count - 1].visible == visible  && cells[cell_count - 1].offset + cells[cell_count - 1].count == cell.from_instance;
-						if (can_merge) {
-							cells[cell_count - 1].count += cell.instance_count;
-							u32* tmp =(u32*)cells[cell_count - 1].ub.ptr;
-							tmp[1] += cell.instance_count;
-						}
-						else {
-							cells[cell_count].visible = visible;
-							cells[cell_count].count = cell.instance_count;
-							cells[cell_count].offset = cell.from_instance;
-							const Renderer::TransientSlice ub = m_renderer.allocUniform(sizeof(u32) * 2);
-							u32* tmp =(u32*)ub.ptr;
-							tmp[0] = cell.from_instance;
-							tmp[1] = cell.instance_count;
-							cells[cell_count].ub = ub;
-							++cell_count;
-						}
+			if (im.instances.size() >= GPU_DRIVEN_MIN_INSTANCES) {
+				// whole batch is culled per instance on GPU, CPU cost does not depend on instance count
+				const AABB& aabb = im.grid.aabb;
+				const Vec3 center = (aabb.max + aabb.min) * 0.5f;
+				const float aabb_radius = length((aabb.max - aabb.min) * 0.5f);
+				if (length(origin.pos - view.cp.pos + center) - aabb_radius < draw_distance) {
+					cells[0].visible = frustum.intersectAABBWithOffset(aabb, radius);
+					cells[0].offset = 0;
+					cells[0].count = im.instances.size();
+					const Renderer::TransientSlice ub = m_renderer.allocUniform(sizeof(u32) * 2);
+					u32* tmp = (u32*)ub.ptr;
+					tmp[0] = 0;
+					tmp[1] = im.instances.size();
+					cells[0].ub = ub;
+					cell_count = 1;
+				}
+			}
+			else {
+				// all cells against frustum at once
+				float min_x[16], min_y[16], min_z[16], max_x[16], max_y[16], max_z[16];
+				for (u32 i = 0; i < 16; ++i) {
+					const AABB& aabb = im.grid.cells[i].aabb;
+					min_x[i] = aabb.min.x; min_y[i] = aabb.min.y; min_z[i] = aabb.min.z;
+					max_x[i] = aabb.max.x; max_y[i] = aabb.max.y; max_z[i] = aabb.max.z;
+				}
+				u32 visible_cells;
+				frustum.intersectAABBs(min_x, min_y, min_z, max_x, max_y, max_z, 16, radius, &visible_cells);
+				for (u32 i = 0; i < 16; ++i) {
+					const InstancedModel::Grid::Cell& cell = im.grid.cells[i];
+
+					if (cell.instance_count > 0) {
+						const bool visible = visible_cells & (1 << i);
+						const Vec3 cell_center = (cell.aabb.max + cell.aabb.min) * 0.5f;
+						const Vec3 cell_half_extents = (cell.aabb.max - cell.aabb.min) * 0.5f;
+						const float cell_radius = length(cell_half_extents);
+						if (length(origin.pos - view.cp.pos + cell_center) - cell_radius < draw_distance) {
+							const bool can_merge = cell_count > 0 && cells[cell_count - 1].visible == visible  && cells[cell_count - 1].offset + cells[cell_count - 1].count == cell.from_instance;
+							if (can_merge) {
+								cells[cell_count - 1].count += cell.instance_count;
+								u32* tmp =(u32*)cells[cell_count - 1].ub.ptr;
+								tmp[1] += cell.instance_count;
+							}
+							else {
+								cells[cell_count].visible = visible;
+								cells[cell_count].count = cell.instance_count;
+								cells[cell_count].offset = cell.from_instance;
+								const Renderer::TransientSlice ub = m_renderer.allocUniform(sizeof(u32) * 2);
+								u32* tmp =(u32*)ub.ptr;
+								tmp[0] = cell.from_instance;
+								tmp[1] = cell.instance_count;
+								cells[cell_count].ub = ub;
+								++cell_count;
+							}
+						}
 					}
 				}
 			}
@@ -2381,6 +3480,14 @@ struct PipelineImpl final : Pipeline
 			if (lod_distances.z < 0) lod_distances.z = FLT_MAX;
 			if (lod_distances.y < 0) lod_distances.y = FLT_MAX;
 			if (lod_distances.x < 0) lod_distances.x = FLT_MAX;
+			if (m->getResidentLOD() > 0) {
+				// lods are selected on GPU, request the one of the closest instance and do not let GPU select missing lods
+				const AABB& aabb = im.grid.aabb;
+				const float aabb_radius = length((aabb.max - aabb.min) * 0.5f);
+				const float dist = maximum(length(origin.pos - view.cp.pos + (aabb.max + aabb.min) * 0.5f) - aabb_radius, 0.f);
+				m->requestLOD(u32(m->getLOD(dist * dist / global_lod_multiplier)));
+				for (u32 i = 0; i < m->getResidentLOD() && i < 4; ++i) (&lod_distances.x)[i] = -1;
+			}
 			IVec4 lod_indices;
 			lod_indices.x = m->getLODIndices()[0].to;
 			lod_indices.y = maximum(lod_indices.x, m->getLODIndices()[1].to);
@@ -2391,11 +3498,13 @@ struct PipelineImpl final : Pipeline
 			const u32 indirect_offset = atomicAdd(&m_indirect_buffer_offset, m->getMeshCount());
 
 			ub_values.camera_offset = Vec4(Vec3(origin.pos - view.cp.pos), 1);
+			if (occlusion) ub_values.hiz_camera_offset = Vec4(Vec3(origin.pos - view.hiz.camera_pos), 1);
 			ub_values.lod_distances = lod_distances;
 			ub_values.lod_indices = lod_indices;
 			ub_values.indirect_offset = indirect_offset;
 			ub_values.radius = m->getOriginBoundingRadius();
 			ub_values.batch_size = instance_count;
+			ub_values.output_capacity = INSTANCED_MESHES_OUTPUT_CAPACITY;
 			ASSERT((u32)m->getMeshCount() < lengthOf(ub_values.indices_count)); // TODO
 			for (i32 i = 0; i < m->getMeshCount(); ++i) {
 				const Mesh& mesh = m->getMesh(i);
@@ -2420,7 +3529,7 @@ struct PipelineImpl final : Pipeline
 				for (u32 i = 0; i < cell_count; ++i) {
 					if (!cells[i].visible) {
 						stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, cells[i].ub.buffer, cells[i].ub.offset, cells[i].ub.size);
-						stream.dispatch((cells[i].count + 255) / 256, 1, 1);
+						dispatchInstances(cells[i].count);
 					}
 				}
 			}
@@ -2429,7 +3538,7 @@ struct PipelineImpl final : Pipeline
 			for (u32 i = 0; i < cell_count; ++i) {
 				if (cells[i].visible) {
 					stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, cells[i].ub.buffer, cells[i].ub.offset, cells[i].ub.size);
-					stream.dispatch((cells[i].count + 255) / 256, 1, 1);
+					dispatchInstances(cells[i].count);
 				}
 			}
 			stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, culled_buffer);
@@ -2446,7 +3555,7 @@ struct PipelineImpl final : Pipeline
 			for (u32 i = 0; i < cell_count; ++i) {
 				if (cells[i].visible) {
 					stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, cells[i].ub.buffer, cells[i].ub.offset, cells[i].ub.size);
-					stream.dispatch((cells[i].count + 255) / 256, 1, 1);
+					dispatchInstances(cells[i].count);
 				}
 			}
 
@@ -2469,10 +3578,11 @@ struct PipelineImpl final : Pipeline
 				bucket.stream.bind(0, material->m_bind_group);
 				bucket.stream.bindIndexBuffer(mesh.index_buffer_handle);
 				bucket.stream.bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+				if (mesh.quantization_buffer) bucket.stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 				bucket.stream.bindVertexBuffer(1, m_instanced_meshes_buffer, 48, 32);
 				
 				bucket.stream.bindIndirectBuffer(m_indirect_buffer);
-				bucket.stream.drawIndirect(mesh.index_type, u32(sizeof(Indirect) * (indirect_offset + i)));
+				bucket.stream.drawIndirect(mesh.index_type, u32(sizeof(Indirect) * (indirect_offset + i)), 1);
 
 				bucket.stream.bindIndirectBuffer(gpu::INVALID_BUFFER);
 				bucket.stream.bindIndexBuffer(gpu::INVALID_BUFFER);
@@ -2486,23 +3596,245 @@ struct PipelineImpl final : Pipeline
 		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 0, gpu::BindShaderBufferFlags::NONE);
 		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 1, gpu::BindShaderBufferFlags::NONE);
 		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 2, gpu::BindShaderBufferFlags::NONE);	
+		if (occlusion) stream.bindImageTexture(gpu::INVALID_TEXTURE, 0);
 
 		stream.memoryBarrier(gpu::MemoryBarrierType::COMMAND, m_indirect_buffer);
 	}
 
+	// word offsets of a skinned mesh's vertex attributes for pipelines/skinning.shd, false if the shader can not read the layout
+	static bool getSkinningLayout(const Mesh& mesh, IVec4& offsets, IVec4& formats) {
+		if (mesh.vb_stride % 4 != 0) return false;
+
+		offsets = IVec4(-1);
+		formats = IVec4(-1, 0, 0, 0);
+		for (u32 i = 0; i < mesh.vertex_decl.attributes_count; ++i) {
+			const gpu::Attribute& attr = mesh.vertex_decl.attributes[i];
+			if (attr.byte_offset % 4 != 0) return false;
+
+			const i32 offset = attr.byte_offset / 4;
+			const bool is_float = attr.type == gpu::AttributeType::FLOAT;
+			const bool is_packed = attr.type == gpu::AttributeType::I8 && attr.components_count == 4;
+			switch (mesh.attributes_semantic[i]) {
+				case Mesh::AttributeSemantic::POSITION:
+					if (!is_float) return false;
+					offsets.x = offset;
+					break;
+				case Mesh::AttributeSemantic::NORMAL:
+					if (!is_float && !is_packed) return false;
+					offsets.y = offset;
+					formats.y = is_float ? 1 : 0;
+					break;
+				case Mesh::AttributeSemantic::TANGENT:
+					if (!is_float && !is_packed) return false;
+					offsets.z = offset;
+					formats.z = is_float ? 1 : 0;
+					break;
+				case Mesh::AttributeSemantic::INDICES:
+					if (attr.type != gpu::AttributeType::I16 || attr.components_count != 4) return false;
+					offsets.w = offset;
+					break;
+				case Mesh::AttributeSemantic::WEIGHTS:
+					if (!is_float || attr.components_count != 4) return false;
+					formats.x = offset;
+					break;
+				default: break;
+			}
+		}
+		return offsets.x >= 0 && offsets.y >= 0 && offsets.w >= 0 && formats.x >= 0;
+	}
+
+	// skins animated model instances once per frame, before the first view is prepared
+	// all views, including shadows, then draw the skinned vertices as rigid meshes,
+	// so bones are converted and uploaded once per instance instead of once per mesh per view
+	void skinModelInstances() {
+		PROFILE_FUNCTION();
+		const u32 frame = m_renderer.frameNumber();
+		if (m_skinning_frame == frame) return;
+		m_skinning_frame = frame;
+		m_skinned_instances.clear();
+		m_skinned_mesh_offsets.clear();
+		m_skinning_meshes.clear();
+		if (!m_skinning_shader->isReady()) return;
+
+		const Universe& universe = m_scene->getUniverse();
+		const Span<const ModelInstance> model_instances = m_scene->getModelInstances();
+		const HashMap<EntityRef, FurComponent>& furs = m_scene->getFurs();
+		u32 buffer_offset = 0;
+		for (i32 i = 0, c = (i32)model_instances.length(); i < c; ++i) {
+			const ModelInstance& mi = model_instances[i];
+			if (!mi.flags.isSet(ModelInstance::VALID) || !mi.flags.isSet(ModelInstance::ENABLED)) continue;
+			if (!mi.pose || !mi.model || !mi.model->isReady() || !mi.model->isSkinned()) continue;
+			// same limit as bones in surface_base.inc
+			if (mi.pose->count > 255) continue;
+
+			const EntityRef e = {i};
+			// fur is drawn in layers from the bind pose
+			if (furs.find(e).isValid()) continue;
+
+			// views can not see instances beyond the far plane of the main camera
+			const Transform tr = universe.getTransform(e);
+			const double radius = m_viewport.far + mi.model->getOriginBoundingRadius() * tr.scale;
+			if (squaredLength(tr.pos - m_viewport.pos) > radius * radius) continue;
+
+			const u32 first_mesh = m_skinned_mesh_offsets.size();
+			for (u32 j = 0; j < mi.mesh_count; ++j) m_skinned_mesh_offsets.push(INVALID_SKINNED_OFFSET);
+
+			// LODs the instance is blending between, other LODs, e.g. in shadows, use the vertex shader skinning
+			const u32 lod = minimum(u32(mi.lod), Model::MAX_LOD_COUNT - 1);
+			const u32 last_lod = minimum(lod + 1, Model::MAX_LOD_COUNT - 1);
+			bool any = false;
+			for (u32 l = lod; l <= last_lod; ++l) {
+				const LODMeshIndices& lod_indices = mi.model->getLODIndices()[l];
+				for (i32 mesh_idx = lod_indices.from; mesh_idx <= lod_indices.to; ++mesh_idx) {
+					const Mesh& mesh = mi.meshes[mesh_idx];
+					if (mesh.type != Mesh::SKINNED) continue;
+
+					SkinningMesh sm;
+					if (!getSkinningLayout(mesh, sm.offsets, sm.formats)) continue;
+
+					const u32 vertex_count = mesh.vertices.size();
+					const u32 size = vertex_count * mesh.vb_stride;
+					if (buffer_offset + size > SKINNED_VERTICES_BUFFER_SIZE) continue;
+
+					sm.entity = e;
+					sm.mesh_idx = mesh_idx;
+					sm.mesh = IVec4(vertex_count, mesh.vb_stride / 4, buffer_offset / 4, 0);
+					m_skinning_meshes.push(sm);
+					m_skinned_mesh_offsets[first_mesh + mesh_idx] = buffer_offset;
+					buffer_offset += size;
+					any = true;
+				}
+			}
+
+			if (any) {
+				m_skinned_instances.insert(e, first_mesh);
+			}
+			else {
+				m_skinned_mesh_offsets.resize(first_mesh);
+			}
+		}
+		profiler::pushInt("Skinned meshes", m_skinning_meshes.size());
+		if (m_skinning_meshes.empty()) return;
+
+		m_renderer.pushJob("skinning", [this](DrawStream& stream){
+			PROFILE_BLOCK("skinning");
+			const ModelInstance* LUMIX_RESTRICT model_instances = m_scene->getModelInstances().begin();
+			stream.useProgram(m_skinning_shader->getProgram(0));
+			stream.bindShaderBuffer(m_skinned_vertices_buffer, 1, gpu::BindShaderBufferFlags::OUTPUT);
+			EntityPtr prev_entity = INVALID_ENTITY;
+			for (const SkinningMesh& sm : m_skinning_meshes) {
+				const ModelInstance& mi = model_instances[sm.entity.index];
+				if (prev_entity != sm.entity) {
+					prev_entity = sm.entity;
+					const Pose& pose = *mi.pose;
+					const Model& model = *mi.model;
+					const Renderer::TransientSlice bones_ub = m_renderer.allocUniform(sizeof(DualQuat) * pose.count);
+					DualQuat* bones = (DualQuat*)bones_ub.ptr;
+					if (pose.is_skinning_valid) {
+						memcpy(bones, pose.skinning, sizeof(DualQuat) * pose.count);
+					}
+					else {
+						for (int j = 0, c = pose.count; j < c; ++j) {
+							const Model::Bone& bone = model.getBone(j);
+							const LocalRigidTransform tmp = {pose.positions[j], pose.rotations[j]};
+							bones[j] = (tmp * bone.inv_bind_transform).toDualQuat();
+						}
+					}
+					stream.bindUniformBuffer(UniformBuffer::DRAWCALL, bones_ub.buffer, bones_ub.offset, bones_ub.size);
+				}
+
+				const Mesh& mesh = mi.meshes[sm.mesh_idx];
+				const IVec4 mesh_values[] = { sm.mesh, sm.offsets, sm.formats };
+				const Renderer::TransientSlice mesh_ub = m_renderer.allocUniform(mesh_values, sizeof(mesh_values));
+				stream.bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh_ub.buffer, mesh_ub.offset, mesh_ub.size);
+				stream.bindShaderBuffer(mesh.vertex_buffer_handle, 0, gpu::BindShaderBufferFlags::NONE);
+				stream.dispatch((sm.mesh.x + 63) / 64, 1, 1);
+			}
+			stream.bindShaderBuffer(gpu::INVALID_BUFFER, 0, gpu::BindShaderBufferFlags::NONE);
+			stream.bindShaderBuffer(m_skinned_vertices_buffer, 1, gpu::BindShaderBufferFlags::NONE);
+			stream.memoryBarrier(gpu::MemoryBarrierType::VERTEX, m_skinned_vertices_buffer);
+		});
+	}
+
+	// culls renderables of all passed camera params in one job, which traverses the culling structure only once,
+	// views created by `cull` with any of these camera params take their renderables from it
+	static int cullShared(lua_State* L) {
+		PROFILE_FUNCTION();
+
+		PipelineImpl* pipeline = getClosureThis(L);
+		SharedCull& shared = pipeline->m_shared_cull;
+		const i32 count = lua_gettop(L);
+		if (shared.count != 0) luaL_error(L, "cullShared can be called only once per frame");
+		if (count > (i32)CullingSystem::MAX_CULL_FRUSTA) luaL_error(L, "too many camera params, at most %d supported", CullingSystem::MAX_CULL_FRUSTA);
+		if (count == 0) return 0;
+
+		for (i32 i = 0; i < count; ++i) {
+			shared.cp_handles[i] = LuaWrapper::checkArg<CameraParamsHandle>(L, 1 + i);
+			shared.frusta[i] = pipeline->resolveCameraParams(shared.cp_handles[i]).frustum;
+			shared.results[i] = nullptr;
+			shared.taken[i] = 0;
+		}
+		shared.count = count;
+
+		jobs::runLambda([pipeline](){
+			PROFILE_BLOCK("shared cull");
+			SharedCull& shared = pipeline->m_shared_cull;
+			pipeline->m_scene->getRenderables(Span<const ShiftedFrustum>(shared.frusta, shared.count), Span(shared.results, shared.count));
+		}, &shared.ready, jobs::ANY_WORKER, jobs::Priority::HIGH);
+		return 0;
+	}
+
+	// returns false if `cp_handle` was not culled by cullShared, or if its result was already taken by another view
+	bool takeSharedRenderables(CameraParamsHandle cp_handle, CullResult** renderables) {
+		for (u32 i = 0; i < m_shared_cull.count; ++i) {
+			if (m_shared_cull.cp_handles[i] != cp_handle) continue;
+			if (!compareAndExchange(&m_shared_cull.taken[i], 1, 0)) return false;
+
+			jobs::wait(&m_shared_cull.ready);
+			*renderables = m_shared_cull.results[i];
+			m_shared_cull.results[i] = nullptr;
+			return true;
+		}
+		return false;
+	}
+
+	// frees results no view has taken, call when no view is being prepared
+	void releaseSharedCull() {
+		if (m_shared_cull.count == 0) return;
+
+		jobs::wait(&m_shared_cull.ready);
+		PageAllocator& page_allocator = m_renderer.getEngine().getPageAllocator();
+		for (u32 i = 0; i < m_shared_cull.count; ++i) {
+			if (m_shared_cull.results[i]) m_shared_cull.results[i]->free(page_allocator);
+		}
+		m_shared_cull.count = 0;
+	}
+
+	// every view (main camera, shadow cascade, atlas slice, probe) is culled, sorted and encoded in its own job,
+	// each bucket records to its own DrawStream; renderBucket only queues a merge, which waits for the view,
+	// so streams are joined in the order of renderBucket calls regardless of which view finishes first
 	static int cull(lua_State* L) {
 		PROFILE_FUNCTION();
-		
+
 		PipelineImpl* pipeline = getClosureThis(L);
 		const CameraParamsHandle cp_handle = LuaWrapper::checkArg<CameraParamsHandle>(L, 1);
 		const CameraParams cp = pipeline->resolveCameraParams(cp_handle);
 		const i32 bucket_count = lua_gettop(L) - 1;
 		for (i32 i = 0; i < bucket_count; ++i) LuaWrapper::checkTableArg(L, 2 + i);
 		
+		pipeline->skinModelInstances();
+
 		UniquePtr<View>& view = pipeline->m_views.emplace();
 		LinearAllocator& allocator = pipeline->m_renderer.getCurrentFrameAllocator();
 		view = UniquePtr<View>::create(allocator, allocator, pipeline->m_renderer.getEngine().getPageAllocator());
 		view->cp = cp;
+		view->cp_handle = cp_handle;
+		view->instance_data = pipeline->m_instance_data;
+		// pyramid is built from the main camera's depth
+		if (cp_handle == (CameraParamsHandle)CameraParamsEnum::MAIN && pipeline->m_hiz.valid) view->hiz = pipeline->m_hiz;
+		view->cpu_occlusion = cp_handle == (CameraParamsHandle)CameraParamsEnum::MAIN
+			&& !pipeline->m_viewport.is_ortho
+			&& pipeline->m_renderer.isCPUOcclusionCulling();
 		memset(view->layer_to_bucket, 0xff, sizeof(view->layer_to_bucket));
 
 		view->buckets.reserve(bucket_count);
@@ -2556,13 +3888,17 @@ struct PipelineImpl final : Pipeline
 			pipeline->encodeInstancedModels(stream, *view_ptr);
 			pipeline->encodeProceduralGeometry(*view_ptr);
 
-			view_ptr->renderables = pipeline->m_scene->getRenderables(view_ptr->cp.frustum);
+			if (!pipeline->takeSharedRenderables(view_ptr->cp_handle, &view_ptr->renderables)) {
+				view_ptr->renderables = pipeline->m_scene->getRenderables(view_ptr->cp.frustum);
+			}
+			if (view_ptr->renderables && view_ptr->cpu_occlusion) pipeline->cullOccluded(*view_ptr);
 			
 			if (view_ptr->renderables) {
 				pipeline->createSortKeys(*view_ptr);
+				pipeline->expandInstances(stream, *view_ptr);
 				view_ptr->renderables->free(pipeline->m_renderer.getEngine().getPageAllocator());
+				pipeline->sortKeys(view_ptr->sorter);
 				if (!view_ptr->sorter.keys.empty()) {
-					pipeline->radixSort(view_ptr->sorter.keys.begin(), view_ptr->sorter.values.begin(), view_ptr->sorter.keys.size());
 					pipeline->createCommands(*view_ptr);
 				}
 			}
@@ -2579,17 +3915,203 @@ struct PipelineImpl final : Pipeline
 		return 1;
 	}
 
+	// removes renderables hidden behind the biggest on screen occluders from view.renderables
+	void cullOccluded(View& view) {
+		PROFILE_FUNCTION();
+		static constexpr u32 MAX_OCCLUDERS = 32;
+		const Universe& universe = m_scene->getUniverse();
+		const ModelInstance* LUMIX_RESTRICT model_instances = m_scene->getModelInstances().begin();
+		const DVec3* LUMIX_RESTRICT positions = universe.getPositions().begin();
+		const float* LUMIX_RESTRICT scales = universe.getScales().begin();
+		const DVec3 camera_pos = view.cp.pos;
+
+		struct Occluder {
+			EntityRef entity;
+			float size;
+		};
+		Occluder occluders[MAX_OCCLUDERS];
+		u32 occluders_count = 0;
+		for (const CullResult* page = view.renderables; page; page = page->header.next) {
+			const RenderableTypes type = (RenderableTypes)page->header.type;
+			// skinned meshes are not rasterized in their bind pose
+			if (type != RenderableTypes::MESH && type != RenderableTypes::MESH_MATERIAL_OVERRIDE) continue;
+			
+			for (u32 i = 0, c = page->header.count; i < c; ++i) {
+				const EntityRef e = page->entities[i];
+				const Model* model = model_instances[e.index].model;
+				if (!model->isOccluder()) continue;
+				
+				const float radius = model->getOriginBoundingRadius() * scales[e.index];
+				const float squared_dist = (float)squaredLength(positions[e.index] - camera_pos);
+				// solid angle, keep the biggest ones
+				const float size = radius * radius / maximum(squared_dist, 0.01f);
+				u32 idx = occluders_count;
+				while (idx > 0 && occluders[idx - 1].size < size) --idx;
+				if (idx == MAX_OCCLUDERS) continue;
+				
+				if (occluders_count < MAX_OCCLUDERS) ++occluders_count;
+				memmove(&occluders[idx + 1], &occluders[idx], sizeof(occluders[0]) * (occluders_count - idx - 1));
+				occluders[idx] = { e, size };
+			}
+		}
+		profiler::pushInt("Occluders", occluders_count);
+		if (occluders_count == 0) return;
+
+		OcclusionBuffer buffer(m_allocator);
+		buffer.begin(view.cp.view, view.cp.projection.columns[0].x, view.cp.projection.columns[1].y, m_viewport.near);
+		for (u32 i = 0; i < occluders_count; ++i) {
+			const EntityRef e = occluders[i].entity;
+			const Model* model = model_instances[e.index].model;
+			// coarser lods could occlude more than lod 0
+			if (model->getResidentLOD() > 0) continue;
+			const Matrix model_view = view.cp.view * universe.getRelativeMatrix(e, camera_pos);
+			const LODMeshIndices& lod = model->getLODIndices()[0];
+			for (i32 j = lod.from; j <= lod.to; ++j) {
+				const Mesh& mesh = model->getMesh(j);
+				buffer.addOccluder(model_view, mesh.vertices, mesh.indices.data(), mesh.indices_count, mesh.areIndices16());
+			}
+		}
+		if (buffer.getTriangleCount() == 0) return;
+
+		jobs::forEach(OcclusionBuffer::HEIGHT, 8, [&](i32 from, i32 to){
+			PROFILE_BLOCK("rasterize occluders");
+			buffer.rasterize(from, to);
+		});
+
+		PagedListIterator<CullResult> iterator(view.renderables);
+		jobs::runOnWorkers([&](){
+			PROFILE_BLOCK("test occlusion");
+			for (;;) {
+				CullResult* page = iterator.next();
+				if (!page) break;
+				
+				switch ((RenderableTypes)page->header.type) {
+					case RenderableTypes::MESH:
+					case RenderableTypes::SKINNED:
+					case RenderableTypes::MESH_MATERIAL_OVERRIDE:
+					case RenderableTypes::FUR: break;
+					// no bounding sphere at hand, these are kept
+					default: continue;
+				}
+
+				u32 count = 0;
+				for (u32 i = 0, c = page->header.count; i < c; ++i) {
+					const EntityRef e = page->entities[i];
+					const float radius = model_instances[e.index].model->getOriginBoundingRadius() * scales[e.index];
+					if (buffer.isVisible(Vec3(positions[e.index] - camera_pos), radius)) {
+						page->entities[count] = e;
+						++count;
+					}
+				}
+				page->header.count = count;
+			}
+		});
+	}
+
 	static Vec4 packRotationLOD(const Quat& rot, float lod) {
 		return rot.w > 0 ? Vec4(rot.x, rot.y, rot.z, lod) : Vec4(-rot.x, -rot.y, -rot.z, lod);
 	}
 
+	// frustum and backface cone culling of meshlets of all instances, writes one indirect draw per meshlet per instance
+	// returns offset in m_meshlet_indirect_buffer or -1 if the mesh should be drawn as a whole
+	i32 cullMeshlets(DrawStream& stream, const View& view, gpu::BufferHandle meshlet_buffer, u32 meshlet_count, gpu::StateFlags state, const Renderer::TransientSlice& instances, u32 instance_count) {
+		if (!meshlet_buffer || !m_meshlets_shader->isReady()) return -1;
+
+		const i32 offset = atomicAdd(&m_meshlet_indirect_offset, meshlet_count * instance_count);
+		if ((offset + meshlet_count * instance_count) * sizeof(Indirect) > MESHLET_INDIRECT_BUFFER_SIZE) return -1;
+
+		struct {
+			Vec4 camera_planes[6];
+			u32 meshlet_count;
+			u32 instance_offset;
+			u32 indirect_offset;
+			u32 cone_culling;
+		} ub_values;
+		toPlanes(view.cp, Span(ub_values.camera_planes));
+		ub_values.meshlet_count = meshlet_count;
+		ub_values.instance_offset = instances.offset / sizeof(Vec4);
+		ub_values.indirect_offset = offset;
+		// backfaces are rendered in shadows and by double sided materials
+		ub_values.cone_culling = !view.cp.is_shadow && u64(state & gpu::StateFlags::CULL_BACK) ? 1 : 0;
+		const Renderer::TransientSlice ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+
+		stream.useProgram(m_meshlets_shader->getProgram(0));
+		stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+		stream.bindShaderBuffer(meshlet_buffer, 0, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(instances.buffer, 1, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(m_meshlet_indirect_buffer, 2, gpu::BindShaderBufferFlags::OUTPUT);
+		stream.dispatch((meshlet_count + 63) / 64, instance_count, 1);
+		stream.memoryBarrier(gpu::MemoryBarrierType::COMMAND, m_meshlet_indirect_buffer);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 0, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 1, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 2, gpu::BindShaderBufferFlags::NONE);
+		return offset;
+	}
+
+	void drawMeshlets(DrawStream& stream, gpu::DataType index_type, u32 meshlet_count, i32 indirect_offset, u32 instance_count) {
+		stream.bindIndirectBuffer(m_meshlet_indirect_buffer);
+		stream.drawIndirect(index_type, u32(sizeof(Indirect) * indirect_offset), meshlet_count * instance_count);
+		stream.bindIndirectBuffer(gpu::INVALID_BUFFER);
+	}
+
+	// chunks are recorded to separate streams on workers and merged into buckets' streams in key order
 	void createCommands(View& view)
 	{
 		PROFILE_FUNCTION();
 		const u32 keys_count = (u32)view.sorter.keys.size();
 		profiler::pushInt("Count", keys_count);
 		if (keys_count == 0) return;
-		
+
+		const u64* LUMIX_RESTRICT sort_keys = view.sorter.keys.begin();
+
+		struct Chunk {
+			u32 from;
+			u32 to;
+			u8 bucket;
+		};
+		IAllocator& allocator = jobs::getFrameAllocator();
+		StackArray<Chunk, 64> chunks(allocator);
+		for (u32 from = 0; from < keys_count;) {
+			const u8 bucket = sort_keys[from] >> SORT_KEY_BUCKET_SHIFT;
+			u32 to = minimum(from + COMMANDS_CHUNK_SIZE, keys_count);
+			if (u8(sort_keys[to - 1] >> SORT_KEY_BUCKET_SHIFT) != bucket) {
+				to = from + 1;
+				while (u8(sort_keys[to] >> SORT_KEY_BUCKET_SHIFT) == bucket) ++to;
+			}
+			else {
+				// equal keys are encoded in one draw call
+				while (to < keys_count && sort_keys[to] == sort_keys[to - 1]) ++to;
+			}
+			chunks.push({from, to, bucket});
+			from = to;
+		}
+
+		if (chunks.size() == 1) {
+			createCommands(view, 0, keys_count, view.buckets[chunks[0].bucket].stream);
+			return;
+		}
+
+		Array<DrawStream> streams(allocator);
+		streams.reserve(chunks.size());
+		for (u32 i = 0; i < (u32)chunks.size(); ++i) streams.emplace(m_renderer);
+
+		jobs::forEach(chunks.size(), 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("record chunk");
+			for (i32 i = from; i < to; ++i) {
+				createCommands(view, chunks[i].from, chunks[i].to, streams[i]);
+			}
+		});
+
+		// merge drops binds which are already bound by the previous chunk
+		for (u32 i = 0; i < (u32)chunks.size(); ++i) {
+			view.buckets[chunks[i].bucket].stream.merge(streams[i]);
+		}
+	}
+
+	// [from, to) must be in a single bucket
+	void createCommands(View& view, u32 from, u32 to, DrawStream& out_stream)
+	{
+		const u32 keys_count = to;
 		const u64* LUMIX_RESTRICT renderables = view.sorter.values.begin();
 		const u64* LUMIX_RESTRICT sort_keys = view.sorter.keys.begin();
 
@@ -2599,32 +4121,24 @@ struct PipelineImpl final : Pipeline
 		const Transform* LUMIX_RESTRICT entity_data = universe.getTransforms(); 
 		const DVec3 camera_pos = view.cp.pos;
 		
-		u64 instance_key_mask;
-		u32 define_mask;
-		u32 instanced_define_mask;
-		u32 skinned_define_mask;
-		u32 fur_define_mask;
 		const Mesh** sort_key_to_mesh = m_renderer.getSortKeyToMeshMap();
-		u8 prev_bucket = (sort_keys[0] >> SORT_KEY_BUCKET_SHIFT) + 1; // make sure it's different from the first bucket, so first iteration is properly initialized
-		DrawStream* stream = nullptr;
-		gpu::StateFlags render_state;
-
-		for (u32 i = 0; i < keys_count; ++i) {
+		// null if meshes or materials changed since the last frame, they are read directly then
+		const SortKeyState* LUMIX_RESTRICT sort_key_states = m_renderer.getSortKeyStates();
+		DrawStream* stream = &out_stream;
+
+		const u8 bucket = sort_keys[from] >> SORT_KEY_BUCKET_SHIFT;
+		const u32 define_mask = view.buckets[bucket].define_mask;
+		const u32 instanced_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("INSTANCED"));
+		const u32 skinned_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("SKINNED"));
+		const u32 fur_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("FUR"));
+		const bool sort_depth = view.buckets[bucket].sort == Bucket::DEPTH;
+		const u64 instance_key_mask = sort_depth ? 0xff00'0000'00ff'ffff : 0xffff'ffff'0000'0000;
+		const gpu::StateFlags render_state = view.buckets[bucket].state;
+
+		for (u32 i = from; i < keys_count; ++i) {
 			const EntityRef entity = {int(renderables[i] & 0xFFffFFff)};
 			const RenderableTypes type = RenderableTypes((renderables[i] >> 32) & SORT_VALUE_TYPE_MASK);
-			const u8 bucket = sort_keys[i] >> SORT_KEY_BUCKET_SHIFT;
-
-			if (bucket != prev_bucket) {
-				prev_bucket = bucket;
-				stream = &view.buckets[bucket].stream;
-				define_mask = view.buckets[bucket].define_mask;
-				instanced_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("INSTANCED"));
-				skinned_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("SKINNED"));
-				fur_define_mask = define_mask | (1 << m_renderer.getShaderDefineIdx("FUR"));
-				const bool sort_depth = view.buckets[bucket].sort == Bucket::DEPTH;
-				instance_key_mask = sort_depth ? 0xff00'0000'00ff'ffff : 0xffff'ffff'0000'0000;
-				render_state = view.buckets[bucket].state;
-			}
+			ASSERT(u8(sort_keys[i] >> SORT_KEY_BUCKET_SHIFT) == bucket);
 
 			switch(type) {
 				case RenderableTypes::PARTICLES: {
@@ -2638,14 +4152,26 @@ struct PipelineImpl final : Pipeline
 					const gpu::VertexDecl& decl = res->getVertexDecl();
 					const gpu::StateFlags state = material->m_render_states | render_state;
 					gpu::ProgramHandle program = material->getShader()->getProgram(state, decl, define_mask | material->getDefineMask());
-					const Renderer::TransientSlice slice = m_renderer.allocTransient(emitter.getParticlesDataSizeBytes());
-					emitter.fillInstanceData((float*)slice.ptr);
 					const Matrix mtx(lpos, tr.rot);
 
 					const Renderer::TransientSlice ub = m_renderer.allocUniform(&mtx, sizeof(Matrix));
 					stream->bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
 					stream->bind(0, material->m_bind_group);
 					stream->useProgram(program);
+					if (emitter.isGPU()) {
+						// instance data and count are written by simulation compute shader
+						const ParticleEmitter::GPUData& gpu_data = emitter.getGPUData();
+						stream->bindIndexBuffer(gpu_data.indices);
+						stream->bindVertexBuffer(0, gpu::INVALID_BUFFER, 0, 0);
+						stream->bindVertexBuffer(1, gpu_data.instances, 0, res->getOutputsCount() * sizeof(float));
+						stream->bindIndirectBuffer(gpu_data.counters);
+						stream->drawIndirect(gpu::DataType::U16, ParticleEmitter::GPUData::INDIRECT_OFFSET, 1);
+						stream->bindIndirectBuffer(gpu::INVALID_BUFFER);
+						break;
+					}
+
+					const Renderer::TransientSlice slice = m_renderer.allocTransient(emitter.getParticlesDataSizeBytes());
+					emitter.fillInstanceData((float*)slice.ptr);
 					stream->bindIndexBuffer(gpu::INVALID_BUFFER);
 					stream->bindVertexBuffer(0, gpu::INVALID_BUFFER, 0, 0);
 					stream->bindVertexBuffer(1, slice.buffer, slice.offset, 40);
@@ -2680,6 +4206,7 @@ struct PipelineImpl final : Pipeline
 						stream->bind(0, material->m_bind_group);
 						stream->bindIndexBuffer(mesh.index_buffer_handle);
 						stream->bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+						if (mesh.quantization_buffer) stream->bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 						stream->bindVertexBuffer(1, slice.buffer, slice.offset, 32);
 						stream->drawIndexedInstanced(mesh.indices_count, 1, mesh.index_type);
 					}
@@ -2691,20 +4218,31 @@ struct PipelineImpl final : Pipeline
 						const u32 instancer_idx = (renderables[i] >> SORT_KEY_INSTANCER_SHIFT) & 0xffFF;
 						const AutoInstancer::Instances& instances = view.instancers[instancer_idx].instances[group_idx];
 						const u32 total_count = instances.end->offset + instances.end->count;
-						const Mesh& mesh = *sort_key_to_mesh[group_idx];
 
-						const Material* material = mesh.material;
-						Shader* shader = material->getShader();
-						const gpu::StateFlags state = material->m_render_states | render_state;
-						const u32 defines = instanced_define_mask | material->getDefineMask();
-						const gpu::ProgramHandle program = shader->getProgram(state, mesh.vertex_decl, defines);
+						SortKeyState tmp_key_state;
+						if (!sort_key_states) tmp_key_state.set(*sort_key_to_mesh[group_idx]);
+						const SortKeyState& key_state = sort_key_states ? sort_key_states[group_idx] : tmp_key_state;
+						const gpu::StateFlags state = key_state.render_states | render_state;
+						gpu::ProgramHandle program = key_state.getProgram(render_state, instanced_define_mask);
+						if (!program) {
+							const Mesh& mesh = *sort_key_to_mesh[group_idx];
+							program = key_state.shader->getProgram(state, mesh.vertex_decl, instanced_define_mask | key_state.define_mask);
+							if (sort_key_states) m_renderer.requestSortKeyProgram(group_idx, render_state, instanced_define_mask);
+						}
+						const i32 meshlets_offset = cullMeshlets(*stream, view, key_state.meshlet_buffer, key_state.meshlets_count, state, instances.slice, total_count);
 						
 						stream->useProgram(program);
-						stream->bind(0, material->m_bind_group);
-						stream->bindIndexBuffer(mesh.index_buffer_handle);
-						stream->bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+						stream->bind(0, key_state.bind_group);
+						stream->bindIndexBuffer(key_state.index_buffer);
+						stream->bindVertexBuffer(0, key_state.vertex_buffer, 0, key_state.vb_stride);
+						if (key_state.quantization_buffer) stream->bindUniformBuffer(UniformBuffer::DRAWCALL2, key_state.quantization_buffer, 0, sizeof(Vec4) * 2);
 						stream->bindVertexBuffer(1, instances.slice.buffer, instances.slice.offset, 32);
-						stream->drawIndexedInstanced(mesh.indices_count, total_count, mesh.index_type);
+						if (meshlets_offset >= 0) {
+							drawMeshlets(*stream, key_state.index_type, key_state.meshlets_count, meshlets_offset, total_count);
+						}
+						else {
+							stream->drawIndexedInstanced(key_state.indices_count, total_count, key_state.index_type);
+						}
 					}
 					else {
 						const u32 mesh_idx = u32(renderables[i] >> SORT_KEY_MESH_IDX_SHIFT);
@@ -2738,13 +4276,20 @@ struct PipelineImpl final : Pipeline
 						const gpu::StateFlags state = material->m_render_states | render_state;
 						const u32 defines = instanced_define_mask | material->getDefineMask();
 						const gpu::ProgramHandle program = shader->getProgram(state, mesh.vertex_decl, defines);
+						const i32 meshlets_offset = cullMeshlets(*stream, view, mesh.meshlet_buffer, mesh.meshlets.size(), state, slice, count);
 						
 						stream->useProgram(program);
 						stream->bind(0, material->m_bind_group);
 						stream->bindIndexBuffer(mesh.index_buffer_handle);
 						stream->bindVertexBuffer(0, mesh.vertex_buffer_handle, 0, mesh.vb_stride);
+						if (mesh.quantization_buffer) stream->bindUniformBuffer(UniformBuffer::DRAWCALL2, mesh.quantization_buffer, 0, sizeof(Vec4) * 2);
 						stream->bindVertexBuffer(1, slice.buffer, slice.offset, 32);
-						stream->drawIndexedInstanced(mesh.indices_count, count, mesh.index_type);
+						if (meshlets_offset >= 0) {
+							drawMeshlets(*stream, mesh.index_type, mesh.meshlets.size(), meshlets_offset, count);
+						}
+						else {
+							stream->drawIndexedInstanced(mesh.indices_count, count, mesh.index_type);
+						}
 						--i;
 					}
 					break;
@@ -2757,6 +4302,31 @@ struct PipelineImpl final : Pipeline
 					const Vec3 rel_pos = Vec3(tr.pos - camera_pos);
 					const Mesh& mesh = mi->meshes[mesh_idx];
 					Shader* shader = mesh.material->getShader();
+
+					if (type == RenderableTypes::SKINNED) {
+						auto skinned_iter = m_skinned_instances.find(entity);
+						const u32 skinned_offset = skinned_iter.isValid() ? m_skinned_mesh_offsets[skinned_iter.value() + mesh_idx] : INVALID_SKINNED_OFFSET;
+						if (skinned_offset != INVALID_SKINNED_OFFSET) {
+							// already skinned this frame, drawn like a rigid mesh
+							const Renderer::TransientSlice slice = m_renderer.allocTransient(sizeof(Vec4) * 2);
+							const Vec4 rot_lod = packRotationLOD(tr.rot, mi->lod - mesh.lod);
+							memcpy(slice.ptr, &rot_lod, sizeof(rot_lod));
+							memcpy(slice.ptr + sizeof(rot_lod), &rel_pos, sizeof(rel_pos));
+							memcpy(slice.ptr + sizeof(rot_lod) + sizeof(rel_pos), &tr.scale, sizeof(tr.scale));
+
+							const Material* material = mesh.material;
+							const gpu::StateFlags state = material->m_render_states | render_state;
+							const gpu::ProgramHandle program = shader->getProgram(state, mesh.rigid_vertex_decl, instanced_define_mask | material->getDefineMask());
+							stream->useProgram(program);
+							stream->bind(0, material->m_bind_group);
+							stream->bindIndexBuffer(mesh.index_buffer_handle);
+							stream->bindVertexBuffer(0, m_skinned_vertices_buffer, skinned_offset, mesh.vb_stride);
+							stream->bindVertexBuffer(1, slice.buffer, slice.offset, 32);
+							stream->drawIndexedInstanced(mesh.indices_count, 1, mesh.index_type);
+							break;
+						}
+					}
+
 					u32 defines = skinned_define_mask | mesh.material->getDefineMask();
 					if (type == RenderableTypes::FUR) defines |= fur_define_mask;
 
@@ -2782,17 +4352,23 @@ struct PipelineImpl final : Pipeline
 					u32 layers = 1;
 					if (type == RenderableTypes::FUR) {
 						FurComponent& fur = m_scene->getFur(entity);
-						layers = fur.layers;
+						layers = getFurLayers(fur, getFurLOD(model, tr.scale, squaredLength(rel_pos)));
 						prefix->fur_scale = fur.scale;
 						prefix->gravity = fur.gravity;
 					}
 					prefix->layers = float(layers);
 
 					DualQuat* bones_ub_array = (DualQuat*)(ub.ptr + sizeof(UBPrefix));
-					for (int j = 0, c = mi->pose->count; j < c; ++j) {
-						const Model::Bone& bone = model.getBone(j);
-						const LocalRigidTransform tmp = {positions[j], rotations[j]};
-						bones_ub_array[j] = (tmp * bone.inv_bind_transform).toDualQuat();
+					// animated poses come with skinning computed in animation jobs
+					if (mi->pose->is_skinning_valid) {
+						memcpy(bones_ub_array, mi->pose->skinning, sizeof(DualQuat) * mi->pose->count);
+					}
+					else {
+						for (int j = 0, c = mi->pose->count; j < c; ++j) {
+							const Model::Bone& bone = model.getBone(j);
+							const LocalRigidTransform tmp = {positions[j], rotations[j]};
+							bones_ub_array[j] = (tmp * bone.inv_bind_transform).toDualQuat();
+						}
 					}
 					
 					const Material* material = mesh.material;
@@ -2992,8 +4568,8 @@ struct PipelineImpl final : Pipeline
 
 		LinearAllocator& frame_allocator = m_renderer.getCurrentFrameAllocator();
 		const IVec3 size(
-			(m_viewport.w + 63) / 64,
-			(m_viewport.h + 63) / 64,
+			(m_render_size.x + 63) / 64,
+			(m_render_size.y + 63) / 64,
 			16);
 		const u32 clusters_count = size.x * size.y * size.z;
 		Cluster* clusters = (Cluster*)frame_allocator.allocate(sizeof(Cluster) * clusters_count);
@@ -3047,18 +4623,34 @@ struct PipelineImpl final : Pipeline
 			m_shadow_atlas.texture = m_renderer.createTexture(ShadowAtlas::SIZE, ShadowAtlas::SIZE, 1, gpu::TextureFormat::D32, gpu::TextureFlags::NO_MIPS, Renderer::MemRef(), "shadow_atlas");
 		}
 
+		u64 first_change;
+		const Span<const RenderScene::ShadowCasterChange> caster_changes = m_scene->getShadowCasterChanges(first_change);
+		if (first_change > m_shadow_atlas.consumed_caster_changes) {
+			// we missed some changes, e.g. pipeline was not rendered for a few frames
+			m_shadow_atlas.invalidateAll();
+		}
+		else {
+			for (u64 j = m_shadow_atlas.consumed_caster_changes - first_change; j < caster_changes.length(); ++j) {
+				m_shadow_atlas.invalidate(caster_changes[(u32)j].pos, caster_changes[(u32)j].radius);
+			}
+		}
+		m_shadow_atlas.consumed_caster_changes = first_change + caster_changes.length();
+
 		Matrix shadow_atlas_matrices[128];
 		for (u32 i = 0; i < atlas_sorter.count; ++i) {
 			ClusterLight& light = lights[atlas_sorter.lights[i].idx];
 			EntityRef e = atlas_sorter.lights[i].entity;
 			PointLight& pl = m_scene->getPointLight(e);
-			// TODO bakeShadow reenters m_lua_state, this is not safe since it's inside another job
 			if (light.atlas_idx == -1) {
 				light.atlas_idx = m_shadow_atlas.add(ShadowAtlas::getGroup(i), e);
-				bakeShadow(pl, light.atlas_idx);
 			}
-			else if (pl.flags.isSet(PointLight::DYNAMIC)) {
-				bakeShadow(pl, light.atlas_idx);
+			const DVec3 light_pos = universe.getPosition(e);
+			const Quat light_rot = universe.getRotation(e);
+			// TODO bakeShadow reenters m_lua_state, this is not safe since it's inside another job
+			if (pl.flags.isSet(PointLight::DYNAMIC) || m_shadow_atlas.needsBake(light.atlas_idx, light_pos, light_rot, pl.fov, pl.range)) {
+				if (bakeShadow(pl, light.atlas_idx)) {
+					m_shadow_atlas.baked(light.atlas_idx, light_pos, light_rot, pl.fov, pl.range);
+				}
 			}
 			shadow_atlas_matrices[light.atlas_idx] = getShadowMatrix(pl, light.atlas_idx);
 		}
@@ -3168,6 +4760,73 @@ struct PipelineImpl final : Pipeline
 				return m3 > n3 ? 1 : 0;
 			});
 	
+			const u32 env_probes_count = scene_env_probes.length();
+			const u32 refl_probes_count = scene_refl_probes.length();
+			bind(m_cluster_buffers.lights, lights, lights_count * sizeof(lights[0]), 11, stream);
+			bind(m_cluster_buffers.env_probes, env_probes, env_probes_count * sizeof(env_probes[0]), 14, stream);
+			bind(m_cluster_buffers.refl_probes, refl_probes, refl_probes_count * sizeof(refl_probes[0]), 15, stream);
+
+			// lights first, then env probes, then refl probes, this is also their order in a cluster's map
+			const u32 items_count = lights_count + env_probes_count + refl_probes_count;
+			Vec4* bounds = (Vec4*)frame_allocator.allocate(sizeof(Vec4) * items_count);
+			for (u32 i = 0; i < lights_count; ++i) {
+				bounds[i] = Vec4(lights[i].pos, lights[i].radius);
+			}
+			for (u32 i = 0; i < env_probes_count; ++i) {
+				bounds[lights_count + i] = Vec4(env_probes[i].pos, length(env_probes[i].outer_range));
+			}
+			for (u32 i = 0; i < refl_probes_count; ++i) {
+				bounds[lights_count + env_probes_count + i] = Vec4(refl_probes[i].pos, length(refl_probes[i].half_extents));
+			}
+
+			const gpu::ProgramHandle clusters_program = m_gpu_light_clustering && m_light_clusters_shader->isReady()
+				? m_light_clusters_shader->getProgram(0)
+				: gpu::INVALID_PROGRAM;
+			if (clusters_program) {
+				auto reserve = [](auto& buffer, u32 size, DrawStream& stream){
+					const u32 capacity = (size + 15) & ~15;
+					if (buffer.capacity >= capacity) return;
+					if (buffer.buffer) stream.destroy(buffer.buffer);
+					buffer.buffer = gpu::allocBufferHandle();
+					stream.createBuffer(buffer.buffer, gpu::BufferFlags::SHADER_BUFFER | gpu::BufferFlags::COMPUTE_WRITE, capacity, nullptr);
+					buffer.capacity = capacity;
+				};
+
+				struct {
+					IVec4 size;
+					IVec4 counts;
+					Vec4 xplanes[65];
+					Vec4 yplanes[65];
+					Vec4 zplanes[17];
+				} ub_values;
+				const u32 map_capacity = clusters_count * GPU_CLUSTER_MAP_ITEMS;
+				ub_values.size = IVec4(size.x, size.y, size.z, 0);
+				ub_values.counts = IVec4(lights_count, env_probes_count, refl_probes_count, map_capacity);
+				memcpy(ub_values.xplanes, xplanes, sizeof(xplanes));
+				memcpy(ub_values.yplanes, yplanes, sizeof(yplanes));
+				memcpy(ub_values.zplanes, zplanes, sizeof(zplanes));
+				const Renderer::TransientSlice ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+
+				reserve(m_cluster_buffers.clusters, sizeof(clusters[0]) * clusters_count, stream);
+				reserve(m_cluster_buffers.maps, map_capacity * sizeof(i32), stream);
+				reserve(m_cluster_buffers.counter, sizeof(i32), stream);
+				// data are read when the stream is executed, after this job returns
+				static const i32 zero = 0;
+				stream.update(m_cluster_buffers.counter.buffer, &zero, sizeof(zero));
+
+				bind(m_cluster_buffers.bounds, bounds, items_count * sizeof(bounds[0]), 1, stream);
+				stream.bindShaderBuffer(m_cluster_buffers.counter.buffer, 0, gpu::BindShaderBufferFlags::OUTPUT);
+				stream.bindShaderBuffer(m_cluster_buffers.clusters.buffer, 12, gpu::BindShaderBufferFlags::OUTPUT);
+				stream.bindShaderBuffer(m_cluster_buffers.maps.buffer, 13, gpu::BindShaderBufferFlags::OUTPUT);
+				stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+				stream.useProgram(clusters_program);
+				stream.dispatch((clusters_count + 63) / 64, 1, 1);
+				stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, m_cluster_buffers.clusters.buffer);
+				stream.bindShaderBuffer(m_cluster_buffers.clusters.buffer, 12, gpu::BindShaderBufferFlags::NONE);
+				stream.bindShaderBuffer(m_cluster_buffers.maps.buffer, 13, gpu::BindShaderBufferFlags::NONE);
+				return;
+			}
+
 			auto range = [](const Vec3& p, float r, i32 size, const Vec4* planes){
 				IVec2 range = { -1, -1 };
 				if (planeDist(planes[0], p) < -r) return range;
@@ -3190,82 +4849,46 @@ struct PipelineImpl final : Pipeline
 				}
 				return range;
 			};
-	
-			// TODO tighter fit
-			auto for_each_light_pair = [&](auto f){
-				for (i32 i = 0, c = lights_count; i < c; ++i) {
-					ClusterLight& light = lights[i];
-					const float r = light.radius;
-					const Vec3 p = light.pos;
-	
-					const IVec2 xrange = range(p, r, size.x, xplanes);
-					const IVec2 yrange = range(p, r, size.y, yplanes);
-					const IVec2 zrange = range(p, r, size.z, zplanes);
-	
-					for (i32 z = zrange.x; z < zrange.y; ++z) {
-						for (i32 y = yrange.x; y < yrange.y; ++y) {
-							for (i32 x = xrange.x; x < xrange.y; ++x) {
-								const u32 idx = x + y * size.x + z * size.x * size.y;
-								Cluster& cluster = clusters[idx];
-								f(cluster, i);
-							}
-						}
-					}
-				}
+
+			struct ClusterRange {
+				IVec2 x, y, z;
 			};
-		
-			auto for_each_env_probe_pair = [&](auto f){
-				for (i32 i = 0, c = scene_env_probes.length(); i < c; ++i) {
-					const Vec3 p = env_probes[i].pos;
-					const float r = length(env_probes[i].outer_range);
-			
-					const IVec2 xrange = range(p, r, size.x, xplanes);
-					const IVec2 yrange = range(p, r, size.y, yplanes);
-					const IVec2 zrange = range(p, r, size.z, zplanes);
-	
-					for (i32 z = zrange.x; z < zrange.y; ++z) {
-						for (i32 y = yrange.x; y < yrange.y; ++y) {
-							for (i32 x = xrange.x; x < xrange.y; ++x) {
-								const u32 idx = x + y * size.x + z * size.x * size.y;
-								Cluster& cluster = clusters[idx];
-								f(cluster, i);
-							}
-						}
-					}
+			ClusterRange* ranges = (ClusterRange*)frame_allocator.allocate(sizeof(ClusterRange) * items_count);
+			jobs::forEach(items_count, 64, [&](i32 from, i32 to){
+				for (i32 i = from; i < to; ++i) {
+					const Vec3 p = bounds[i].xyz();
+					const float r = bounds[i].w;
+					ranges[i].x = range(p, r, size.x, xplanes);
+					ranges[i].y = range(p, r, size.y, yplanes);
+					ranges[i].z = range(p, r, size.z, zplanes);
 				}
-			};
-	
-			auto for_each_refl_probe_pair = [&](auto f){
-				for (i32 i = 0, c = scene_refl_probes.length(); i < c; ++i) {
-					const Vec3 p = refl_probes[i].pos;
-					const float r = length(refl_probes[i].half_extents);
-			
-					const IVec2 xrange = range(p, r, size.x, xplanes);
-					const IVec2 yrange = range(p, r, size.y, yplanes);
-					const IVec2 zrange = range(p, r, size.z, zplanes);
-	
-					for (i32 z = zrange.x; z < zrange.y; ++z) {
-						for (i32 y = yrange.x; y < yrange.y; ++y) {
-							for (i32 x = xrange.x; x < xrange.y; ++x) {
-								const u32 idx = x + y * size.x + z * size.x * size.y;
-								Cluster& cluster = clusters[idx];
-								f(cluster, i);
-							}
+			});
+
+			// TODO tighter fit
+			// calls f(cluster, item_idx) for every item touching a cluster in slice z; slices are processed in parallel
+			auto for_each_pair = [&](i32 z, auto f){
+				for (u32 i = 0; i < items_count; ++i) {
+					const ClusterRange& r = ranges[i];
+					if (z < r.z.x || z >= r.z.y) continue;
+					for (i32 y = r.y.x; y < r.y.y; ++y) {
+						for (i32 x = r.x.x; x < r.x.y; ++x) {
+							const u32 idx = x + y * size.x + z * size.x * size.y;
+							f(clusters[idx], i);
 						}
 					}
 				}
 			};
-	
-			for_each_light_pair([](Cluster& cluster, i32 light_idx){
-				++cluster.lights_count;
-			});
-	
-			for_each_env_probe_pair([](Cluster& cluster, i32){
-				++cluster.env_probes_count;
-			});
-	
-			for_each_refl_probe_pair([](Cluster& cluster, i32){
-				++cluster.refl_probes_count;
+
+			const u32 env_probes_start = lights_count;
+			const u32 refl_probes_start = lights_count + env_probes_count;
+			jobs::forEach(size.z, 1, [&](i32 from, i32 to){
+				for (i32 z = from; z < to; ++z) {
+					for_each_pair(z, [&](Cluster& cluster, u32 item_idx){
+						if (item_idx < env_probes_start) ++cluster.lights_count;
+						else if (item_idx < refl_probes_start) ++cluster.env_probes_count;
+						else ++cluster.refl_probes_count;
+					});
+				}
 			});
 	
 			u32 offset = 0;
@@ -3277,19 +4900,15 @@ struct PipelineImpl final : Pipeline
 		
 			i32* map = (i32*)frame_allocator.allocate(offset * sizeof(i32));
 	
-			for_each_light_pair([&](Cluster& cluster, i32 light_idx){
-				map[cluster.offset] = light_idx;
-				++cluster.offset;
-			});
-	
-			for_each_env_probe_pair([&](Cluster& cluster, i32 probe_idx){
-				map[cluster.offset] = probe_idx;
-				++cluster.offset;
-			});
-	
-			for_each_refl_probe_pair([&](Cluster& cluster, i32 probe_idx){
-				map[cluster.offset] = probe_idx;
-				++cluster.offset;
+			jobs::forEach(size.z, 1, [&](i32 from, i32 to){
+				for (i32 z = from; z < to; ++z) {
+					for_each_pair(z, [&](Cluster& cluster, u32 item_idx){
+						if (item_idx < env_probes_start) map[cluster.offset] = item_idx;
+						else if (item_idx < refl_probes_start) map[cluster.offset] = item_idx - env_probes_start;
+						else map[cluster.offset] = item_idx - refl_probes_start;
+						++cluster.offset;
+					});
+				}
 			});
 	
 			for (u32 i = 0; i < clusters_count; ++i) {
@@ -3297,24 +4916,21 @@ struct PipelineImpl final : Pipeline
 				cluster.offset -= cluster.lights_count + cluster.env_probes_count + cluster.refl_probes_count;
 			}
 		
-			bind(m_cluster_buffers.lights, lights, lights_count * sizeof(lights[0]), 11, stream);
 			bind(m_cluster_buffers.maps, map, offset * sizeof(i32), 13, stream);
-			bind(m_cluster_buffers.env_probes, env_probes, scene_env_probes.length() * sizeof(env_probes[0]), 14, stream);
-			bind(m_cluster_buffers.refl_probes, refl_probes, scene_refl_probes.length() * sizeof(refl_probes[0]), 15, stream);
 			bind(m_cluster_buffers.clusters, clusters, sizeof(clusters[0]) * clusters_count, 12, stream);
 		});
 	}
 
 	CameraParamsHandle getShadowCameraParams(i32 slice) { return (CameraParamsHandle)CameraParamsEnum::SHADOW0 + slice; }
 	
-	void setRenderTargets(Span<gpu::TextureHandle> renderbuffers, gpu::TextureHandle ds, bool readonly_ds, bool srgb) {
+	void setRenderTargets(Span<gpu::TextureHandle> renderbuffers, gpu::TextureHandle ds, bool readonly_ds, bool srgb, IVec2 size) {
 		gpu::FramebufferFlags flags = srgb ? gpu::FramebufferFlags::SRGB : gpu::FramebufferFlags::NONE;
 		if (readonly_ds) {
 			flags = flags | gpu::FramebufferFlags::READONLY_DEPTH_STENCIL;
 		}
 		DrawStream& stream = m_renderer.getDrawStream();
 		stream.setFramebuffer(renderbuffers.begin(), renderbuffers.length(), ds, flags);
-		stream.viewport(0, 0, m_viewport.w, m_viewport.h);
+		stream.viewport(0, 0, size.x, size.y);
 	}
 
 	static int setRenderTargets(lua_State* L, bool has_ds, bool readonly_ds) {
@@ -3328,18 +4944,23 @@ struct PipelineImpl final : Pipeline
 			return 0;
 		}
 
+		// backbuffer and native renderbuffers are in output resolution, the rest in scene render resolution
+		bool native = rb_count == 0 && !has_ds;
 		for(u32 i = 0; i < rb_count; ++i) {
 			const i32 rb_idx = pipeline->toRenderbufferIdx(L, i + 1);
 			rbs[i] = pipeline->m_renderbuffers[rb_idx].handle;
+			native = native || pipeline->m_renderbuffers[rb_idx].native;
 		}
 
 		gpu::TextureHandle ds = gpu::INVALID_TEXTURE;
 		if (has_ds) {
 			const int ds_idx = pipeline->toRenderbufferIdx(L, rb_count + 1);
 			ds = pipeline->m_renderbuffers[ds_idx].handle;
+			native = native || pipeline->m_renderbuffers[ds_idx].native;
 		}
 
-		pipeline->setRenderTargets(Span(rbs, rb_count), ds, readonly_ds, true);
+		const IVec2 size = native ? IVec2(pipeline->m_viewport.w, pipeline->m_viewport.h) : pipeline->m_render_size;
+		pipeline->setRenderTargets(Span(rbs, rb_count), ds, readonly_ds, true, size);
 		return 0;
 	}
 
@@ -3365,10 +4986,27 @@ struct PipelineImpl final : Pipeline
 			view.instancers.emplace(allocator, m_renderer.getEngine().getPageAllocator());
 		}
 
-		const float global_lod_multiplier = m_renderer.getLODMultiplier();
-		const float global_lod_multiplier_rcp = 1 / global_lod_multiplier;
-		const float time_delta = m_renderer.getEngine().getLastTimeDelta();
+		// lods are selected by projected size, lod distances are authored for unscaled models seen by a camera with 60 degrees fov
+		// all views use the main camera, so shadows and other views pick the same lod
+		const float lod_multiplier = m_renderer.getLODMultiplier() / m_scene->getCameraLODMultiplier(m_viewport.fov, m_viewport.is_ortho);
+		const float lod_multiplier_rcp = 1 / lod_multiplier;
+		auto get_lod = [&](const ModelInstance& mi, float scale, float squared_distance) {
+			return mi.model->getLOD(squared_distance * lod_multiplier_rcp / (scale * scale));
+		};
 		volatile i32 worker_idx = 0;
+		// pixels per world unit (at distance 1 if not ortho), meshes report how big their textures are on screen
+		const bool request_texture_resolution = !view.cp.is_shadow && m_renderer.getTextureStreamingBudget() > 0;
+		const bool is_ortho = m_viewport.is_ortho;
+		const float texture_resolution_scale = is_ortho ? m_viewport.h / m_viewport.ortho_size : m_viewport.h / tanf(m_viewport.fov * 0.5f);
+		auto compute_texture_resolution = [&](const ModelInstance& mi, float scale, float squared_distance) -> u32 {
+			const float radius = mi.model->getOriginBoundingRadius() * scale;
+			const float res = radius * texture_resolution_scale / (is_ortho ? 1.f : maximum(sqrtf(squared_distance), 0.01f));
+			return u32(minimum(res, 65536.f));
+		};
+		auto get_texture_resolution = [&](const ModelInstance& mi, float scale, float squared_distance) -> u32 {
+			if (!request_texture_resolution) return 0;
+			return compute_texture_resolution(mi, scale, squared_distance);
+		};
 
 		u32 bucket_map[255];
 		for (u32 i = 0; i < 255; ++i) {
@@ -3380,12 +5018,18 @@ struct PipelineImpl final : Pipeline
 				bucket_map[i] |= 0x100;
 			}
 		}
+		const u32 bucket_map_hash = RuntimeHash32(bucket_map, sizeof(bucket_map)).getHashValue();
+		const u32 sort_keys_generation = m_renderer.getSortKeysGeneration();
+		const u32 frame = m_renderer.frameNumber();
 		jobs::runOnWorkers([&](){
 			PROFILE_BLOCK("create keys");
 			int total = 0;
 			RenderScene* scene = m_scene;
 			ModelInstance* LUMIX_RESTRICT model_instances = scene->getModelInstances().begin();
 			const Transform* LUMIX_RESTRICT entity_data = scene->getUniverse().getTransforms();
+			// lod and sort keys need only positions and scales, read them from the separate streams
+			const DVec3* LUMIX_RESTRICT positions = scene->getUniverse().getPositions().begin();
+			const float* LUMIX_RESTRICT scales = scene->getUniverse().getScales().begin();
 			const DVec3 camera_pos = view.cp.pos;
 			const DVec3 lod_ref_point = m_viewport.pos;
 			Sorter::Inserter inserter(view.sorter);
@@ -3393,6 +5037,146 @@ struct PipelineImpl final : Pipeline
 			const i32 instancer_idx = atomicIncrement(&worker_idx) - 1;
 			AutoInstancer& instancer = view.instancers[instancer_idx];
 			instancer.init(m_renderer.getMaxSortKey() + 1);
+			const Mesh** sort_key_to_mesh = m_renderer.getSortKeyToMeshMap();
+			// null if meshes or materials changed since the last frame, they are read directly then
+			const SortKeyState* LUMIX_RESTRICT sort_key_states = m_renderer.getSortKeyStates();
+
+			// nullptr if some mesh in the cell is switching lods or is too close to a lod boundary
+			auto build_cell = [&](const CullResult& page) -> CellSortKeys* {
+				ASSERT((RenderableTypes)page.header.type == RenderableTypes::MESH);
+				const u64 type_mask = (u64)RenderableTypes::MESH << 32;
+				// texture resolution is stored too, so also limit how much it can change
+				const float min_slack = 1.f;
+				const float max_relative_slack = 0.25f;
+
+				struct Instanced {
+					u32 sort_key;
+					u32 texture_resolution;
+					u64 subrenderable;
+				};
+				Array<Instanced> instanced(m_allocator);
+				CellSortKeys* cell = LUMIX_NEW(m_allocator, CellSortKeys)(m_allocator);
+				float slack = FLT_MAX;
+				for (u32 i = 0, c = page.header.count; i < c; ++i) {
+					const EntityRef e = page.entities[i];
+					const ModelInstance& mi = model_instances[e.index];
+					const float squared_length = float(squaredLength(positions[e.index] - lod_ref_point));
+					const float scale = scales[e.index];
+					const float lod = get_lod(mi, scale, squared_length);
+					const u32 lod_idx = u32(lod);
+					// cached cells do not request lods, streamed models are drawn per entity until their lod is loaded
+					if (lod < mi.model->getResidentLOD()) {
+						LUMIX_DELETE(m_allocator, cell);
+						return nullptr;
+					}
+
+					const float distance = sqrtf(squared_length);
+					const float* lod_distances = mi.model->getLODDistances();
+					slack = minimum(slack, distance * max_relative_slack);
+					for (u32 j = 0; j < Model::MAX_LOD_COUNT; ++j) {
+						const float threshold = sqrtf(maximum(lod_distances[j] * lod_multiplier, 0.f)) * scale;
+						slack = minimum(slack, fabsf(distance - threshold));
+						slack = minimum(slack, fabsf(distance - threshold * (1 - Model::LOD_CROSSFADE_RANGE)));
+					}
+
+					if (mi.lod != lod || lod != lod_idx || slack < min_slack) {
+						LUMIX_DELETE(m_allocator, cell);
+						return nullptr;
+					}
+
+					const u32 texture_resolution = compute_texture_resolution(mi, scale, squared_length);
+					const LODMeshIndices& lod_indices = mi.model->getLODIndices()[lod_idx];
+					for (int mesh_idx = lod_indices.from; mesh_idx <= lod_indices.to; ++mesh_idx) {
+						const Mesh& mesh = mi.meshes[mesh_idx];
+						const u32 bucket = bucket_map[mesh.layer];
+						const u64 subrenderable = e.index | type_mask | ((u64)mesh_idx << SORT_KEY_MESH_IDX_SHIFT);
+						if (bucket < 0xff) {
+							instanced.push({mesh.sort_key, texture_resolution, subrenderable});
+						}
+						else if (bucket < 0xffFF) {
+							cell->depth_sorted.push({subrenderable, bucket, texture_resolution});
+						}
+					}
+				}
+
+				qsort(instanced.begin(), instanced.size(), sizeof(instanced[0]), [](const void* a, const void* b){
+					const u32 ka = ((const Instanced*)a)->sort_key;
+					const u32 kb = ((const Instanced*)b)->sort_key;
+					return ka < kb ? -1 : (ka > kb ? 1 : 0);
+				});
+				cell->renderables.reserve(instanced.size());
+				for (const Instanced& inst : instanced) {
+					if (cell->groups.empty() || cell->groups.last().sort_key != inst.sort_key) {
+						cell->groups.push({inst.sort_key, (u32)cell->renderables.size(), 0, 0});
+					}
+					CellSortKeys::Group& group = cell->groups.last();
+					++group.count;
+					group.texture_resolution = maximum(group.texture_resolution, inst.texture_resolution);
+					cell->renderables.push(inst.subrenderable);
+				}
+
+				cell->lod_ref_point = lod_ref_point;
+				cell->lod_multiplier = lod_multiplier;
+				cell->lod_slack = slack;
+				cell->sort_keys_generation = sort_keys_generation;
+				return cell;
+			};
+
+			// static cell completely inside the view, reuse its keys from previous frames or from other views
+			auto encode_cell = [&](const CullResult& page) -> bool {
+				const u64 cache_key = ((u64)page.header.cell_generation << 32) | bucket_map_hash;
+				CellSortKeys* cell = nullptr;
+				{
+					jobs::MutexGuard guard(m_cell_sort_keys_mutex);
+					auto iter = m_cell_sort_keys.find(cache_key);
+					if (iter.isValid()) cell = iter.value();
+				}
+
+				if (!cell || !cell->isValid(lod_ref_point, lod_multiplier, sort_keys_generation)) {
+					CellSortKeys* new_cell = build_cell(page);
+					if (!new_cell) return false;
+
+					jobs::MutexGuard guard(m_cell_sort_keys_mutex);
+					auto iter = m_cell_sort_keys.find(cache_key);
+					if (!iter.isValid()) {
+						m_cell_sort_keys.insert(cache_key, new_cell);
+					}
+					else if (iter.value() == cell) {
+						// other views can still use the old one this frame
+						m_retired_cell_sort_keys.push(cell);
+						iter.value() = new_cell;
+					}
+					else {
+						// built by another view in the meantime
+						LUMIX_DELETE(m_allocator, new_cell);
+						new_cell = iter.value();
+					}
+					cell = new_cell;
+				}
+				cell->last_used_frame = frame;
+
+				for (const CellSortKeys::Group& group : cell->groups) {
+					instancer.add(group.sort_key, &cell->renderables[group.from], group.count);
+					if (request_texture_resolution && group.texture_resolution) {
+						Material* material = sort_key_states ? sort_key_states[group.sort_key].material : sort_key_to_mesh[group.sort_key]->material;
+						material->requestTextureResolution(group.texture_resolution);
+					}
+				}
+
+				for (const CellSortKeys::DepthSorted& ds : cell->depth_sorted) {
+					const u32 entity_index = u32(ds.subrenderable & 0xffFFffFF);
+					if (request_texture_resolution && ds.texture_resolution) {
+						const u32 mesh_idx = u32(ds.subrenderable >> SORT_KEY_MESH_IDX_SHIFT);
+						model_instances[entity_index].meshes[mesh_idx].material->requestTextureResolution(ds.texture_resolution);
+					}
+					const DVec3 rel_pos = positions[entity_index] - camera_pos;
+					const float squared_length = float(rel_pos.x * rel_pos.x + rel_pos.y * rel_pos.y + rel_pos.z * rel_pos.z);
+					const u32 depth_bits = floatFlip(*(u32*)&squared_length);
+					const u64 key = ((u64)ds.bucket << SORT_KEY_BUCKET_SHIFT) | depth_bits;
+					inserter.push(key, ds.subrenderable);
+				}
+				return true;
+			};
 
 			for(;;) {
 				const CullResult* page = iterator.next();
@@ -3411,9 +5195,8 @@ struct PipelineImpl final : Pipeline
 							const int layer = material->getLayer();
 							const u8 bucket = bucket_map[layer];
 							if (bucket < 0xff) {
-								// TODO material can have the same sort key as mesh
 								const u64 subrenderable = e.index | type_mask;
-								inserter.push(material->getSortKey() | ((u64)bucket << SORT_KEY_BUCKET_SHIFT), subrenderable);
+								inserter.push(material->getSortKey() | (u64(type) << SORT_KEY_TYPE_SHIFT) | ((u64)bucket << SORT_KEY_BUCKET_SHIFT), subrenderable);
 							}
 						}
 						break;
@@ -3425,9 +5208,8 @@ struct PipelineImpl final : Pipeline
 							const int layer = material->getLayer();
 							const u8 bucket = bucket_map[layer];
 							if (bucket < 0xff) {
-								// TODO material can have the same sort key as mesh
 								const u64 subrenderable = e.index | type_mask;
-								inserter.push(material->getSortKey() | ((u64)bucket << SORT_KEY_BUCKET_SHIFT), subrenderable);
+								inserter.push(material->getSortKey() | (u64(type) << SORT_KEY_TYPE_SHIFT) | ((u64)bucket << SORT_KEY_BUCKET_SHIFT), subrenderable);
 							}
 						}
 						break;
@@ -3436,15 +5218,18 @@ struct PipelineImpl final : Pipeline
 					case RenderableTypes::MESH_MATERIAL_OVERRIDE: {
 						for (int i = 0, c = page->header.count; i < c; ++i) {
 							const EntityRef e = renderables[i];
-							const DVec3 pos = entity_data[e.index].pos;
+							const DVec3 pos = positions[e.index];
 							ModelInstance& mi = model_instances[e.index];
 							const float squared_length = float(squaredLength(pos - lod_ref_point));
 								
-							const u32 lod_idx = mi.model->getLODMeshIndices(squared_length * global_lod_multiplier_rcp);
+							const float lod = mi.model->clampLOD(get_lod(mi, scales[e.index], squared_length));
+							const u32 lod_idx = u32(lod);
+							const u32 texture_resolution = get_texture_resolution(mi, scales[e.index], squared_length);
 
 							auto create_key = [&](const LODMeshIndices& lod){
 								for (int mesh_idx = lod.from; mesh_idx <= lod.to; ++mesh_idx) {
 									const Mesh& mesh = mi.meshes[mesh_idx];
+									if (texture_resolution) (mi.custom_material ? mi.custom_material : mesh.material)->requestTextureResolution(texture_resolution);
 									const u8 layer = mi.custom_material ? mi.custom_material->getLayer() : mesh.layer;
 									const u32 bucket = bucket_map[layer];
 									const u32 mesh_sort_key = mi.custom_material ? 0x00FFffFF : mesh.sort_key;
@@ -3454,7 +5239,7 @@ struct PipelineImpl final : Pipeline
 										const u64 key = mesh_sort_key | ((u64)bucket << SORT_KEY_BUCKET_SHIFT);
 										inserter.push(key, subrenderable);
 									} else if (bucket < 0xffFF) {
-										const DVec3 pos = entity_data[e.index].pos;
+										const DVec3 pos = positions[e.index];
 										const DVec3 rel_pos = pos - camera_pos;
 										const float squared_length = float(rel_pos.x * rel_pos.x + rel_pos.y * rel_pos.y + rel_pos.z * rel_pos.z);
 										const u32 depth_bits = floatFlip(*(u32*)&squared_length);
@@ -3464,54 +5249,38 @@ struct PipelineImpl final : Pipeline
 								}
 							};
 
-							if (mi.lod != lod_idx) {
-								if (view.cp.is_shadow) {
-									const u32 shadow_lod_idx = maximum((u32)mi.lod, lod_idx);
-									create_key(mi.model->getLODIndices()[shadow_lod_idx]);
-								}
-								else {
-									const float d = lod_idx - mi.lod;
-									const float ad = fabsf(d);
-									
-									if (ad <= time_delta) {
-										mi.lod = float(lod_idx);
-										create_key(mi.model->getLODIndices()[lod_idx]);
-									}
-									else {
-										mi.lod += d / ad * time_delta;
-										const u32 cur_lod_idx = u32(mi.lod);
-										create_key(mi.model->getLODIndices()[cur_lod_idx]);
-										if (cur_lod_idx < 3) create_key(mi.model->getLODIndices()[cur_lod_idx + 1]);
-									}
-								}
-							}
-							else {
-								const LODMeshIndices& lod = mi.model->getLODIndices()[lod_idx];
-								create_key(lod);
-							}
+							// both lods are drawn dithered in the crossfade range
+							mi.lod = lod;
+							mi.visible_frame = frame;
+							create_key(mi.model->getLODIndices()[lod_idx]);
+							if (lod != float(lod_idx)) create_key(mi.model->getLODIndices()[lod_idx + 1]);
 						}
 						break;
 					}
 					case RenderableTypes::MESH: {
-						const bool is_shadow = view.cp.is_shadow;
+						if (page->header.cell_generation != 0 && encode_cell(*page)) break;
+
 						for (int i = 0, c = page->header.count; i < c; ++i) {
 							const EntityRef e = renderables[i];
-							const DVec3 pos = entity_data[e.index].pos;
+							const DVec3 pos = positions[e.index];
 							ModelInstance& mi = model_instances[e.index];
 							const float squared_length = float(squaredLength(pos - lod_ref_point));
 								
-							const u32 lod_idx = mi.model->getLODMeshIndices(squared_length * global_lod_multiplier_rcp);
+							const float lod = mi.model->clampLOD(get_lod(mi, scales[e.index], squared_length));
+							const u32 lod_idx = u32(lod);
+							const u32 texture_resolution = get_texture_resolution(mi, scales[e.index], squared_length);
 
 							auto create_key = [&](const LODMeshIndices& lod){
 								for (int mesh_idx = lod.from; mesh_idx <= lod.to; ++mesh_idx) {
 									const Mesh& mesh = mi.meshes[mesh_idx];
+									if (texture_resolution) mesh.material->requestTextureResolution(texture_resolution);
 									const u32 bucket = bucket_map[mesh.layer];
 									ASSERT(!mi.custom_material);
 									const u64 subrenderable = e.index | type_mask | ((u64)mesh_idx << SORT_KEY_MESH_IDX_SHIFT);
 									if (bucket < 0xff) {
 										instancer.add(mesh.sort_key, subrenderable);
 									} else if (bucket < 0xffFF) {
-										const DVec3 pos = entity_data[e.index].pos;
+										const DVec3 pos = positions[e.index];
 										const DVec3 rel_pos = pos - camera_pos;
 										const float squared_length = float(rel_pos.x * rel_pos.x + rel_pos.y * rel_pos.y + rel_pos.z * rel_pos.z);
 										const u32 depth_bits = floatFlip(*(u32*)&squared_length);
@@ -3521,25 +5290,10 @@ struct PipelineImpl final : Pipeline
 								}
 							};
 
-							if (mi.lod != lod_idx) {
-								const float d = lod_idx - mi.lod;
-								const float ad = fabsf(d);
-									
-								if (ad <= time_delta) {
-									mi.lod = float(lod_idx);
-									create_key(mi.model->getLODIndices()[lod_idx]);
-								}
-								else {
-									if (!is_shadow) mi.lod += d / ad * time_delta;
-									const u32 cur_lod_idx = u32(mi.lod);
-									create_key(mi.model->getLODIndices()[cur_lod_idx]);
-									if (cur_lod_idx < 3) create_key(mi.model->getLODIndices()[cur_lod_idx + 1]);
-								}
-							}
-							else {
-								const LODMeshIndices& lod = mi.model->getLODIndices()[lod_idx];
-								create_key(lod);
-							}
+							// both lods are drawn dithered in the crossfade range
+							mi.lod = lod;
+							create_key(mi.model->getLODIndices()[lod_idx]);
+							if (lod != float(lod_idx)) create_key(mi.model->getLODIndices()[lod_idx + 1]);
 						}
 						break;
 					}
@@ -3552,28 +5306,63 @@ struct PipelineImpl final : Pipeline
 			}
 			profiler::pushInt("count", total);
 
-			const Mesh** sort_key_to_mesh = m_renderer.getSortKeyToMeshMap();
 			for (u32 i = 0, c = (u32)instancer.instances.size(); i < c; ++i) {
 				if (!instancer.instances[i].begin) continue;
 
-				const Mesh* mesh = sort_key_to_mesh[i];
-				const u8 bucket = view.layer_to_bucket[mesh->layer];
+				const u8 layer = sort_key_states ? sort_key_states[i].layer : sort_key_to_mesh[i]->layer;
+				const u8 bucket = view.layer_to_bucket[layer];
 				inserter.push(SORT_KEY_INSTANCED_FLAG | i | ((u64)bucket << SORT_KEY_BUCKET_SHIFT), i | (instancer_idx << SORT_KEY_INSTANCER_SHIFT));
 			}
 
 			PROFILE_BLOCK("fill instance data");
+			// transforms are already on GPU, so only entity indices and lods are written and expanded by a compute shader
+			bool expand = false;
+			u32* indices = nullptr;
+			if (view.instance_data) {
+				u32 instancer_count = 0;
+				for (const AutoInstancer::Instances& instances : instancer.instances) {
+					if (instances.begin) instancer_count += instances.end->offset + instances.end->count;
+				}
+				const i32 offset = atomicAdd(&m_expanded_instances_offset, instancer_count);
+				expand = instancer_count > 0 && (offset + instancer_count) * 2 * sizeof(Vec4) <= EXPANDED_INSTANCES_BUFFER_SIZE;
+				if (expand) {
+					instancer.indices = m_renderer.allocTransient(instancer_count * 2 * sizeof(u32));
+					instancer.expanded_offset = offset;
+					instancer.expanded_count = instancer_count;
+					indices = (u32*)instancer.indices.ptr;
+				}
+			}
+
+			u32 expanded_offset = instancer.expanded_offset;
 			for (AutoInstancer::Instances& instances : instancer.instances) {
 				const AutoInstancer::Page::Group* group = instances.begin;
 				if (!group) continue;
 
 				const u32 count = instances.end->offset + instances.end->count;
-				instances.slice = m_renderer.allocTransient(count * (2 * sizeof(Vec4)));
-				u8* instance_data = instances.slice.ptr;
 				const u32 sort_key = u32(&instances - instancer.instances.begin());
-				const Mesh* mesh = sort_key_to_mesh[sort_key];
-
-				const float mesh_lod = mesh->lod;
+				const float mesh_lod = sort_key_states ? sort_key_states[sort_key].lod : sort_key_to_mesh[sort_key]->lod;
+
+				if (expand) {
+					instances.slice.buffer = m_expanded_instances_buffer;
+					instances.slice.offset = expanded_offset * 2 * sizeof(Vec4);
+					instances.slice.size = count * 2 * sizeof(Vec4);
+					instances.slice.ptr = nullptr;
+					expanded_offset += count;
+					while (group) {
+						for (u32 i = 0; i < group->count; ++i) {
+							const EntityRef e = { (i32)group->renderables[i] };
+							const float lod_d = model_instances[e.index].lod - mesh_lod;
+							indices[0] = e.index;
+							memcpy(&indices[1], &lod_d, sizeof(lod_d));
+							indices += 2;
+						}
+						group = group->next;
+					}
+					continue;
+				}
 
+				instances.slice = m_renderer.allocTransient(count * (2 * sizeof(Vec4)));
+				u8* instance_data = instances.slice.ptr;
 				while (group) {
 					for (u32 i = 0; i < group->count; ++i) {
 						const EntityRef e = { (i32)group->renderables[i] };
@@ -3592,8 +5381,50 @@ struct PipelineImpl final : Pipeline
 				}
 			}
 		});
+	}
+
+	// computes instance data of autoinstanced meshes from entity indices written by createSortKeys
+	void expandInstances(DrawStream& stream, const View& view) {
+		if (!view.instance_data) return;
+
+		struct {
+			Vec4 camera_pos_high;
+			Vec4 camera_pos_low;
+			u32 indices_offset;
+			u32 output_offset;
+			u32 count;
+			u32 padding;
+		} ub_values;
+		// same split as the scene's instance data, so relative positions are precise
+		const Vec3 camera_pos_high = Vec3(view.cp.pos);
+		ub_values.camera_pos_high = Vec4(camera_pos_high, 0);
+		ub_values.camera_pos_low = Vec4(Vec3(view.cp.pos - DVec3(camera_pos_high)), 0);
+
+		bool any = false;
+		for (const AutoInstancer& instancer : view.instancers) {
+			if (instancer.expanded_count == 0) continue;
+			
+			if (!any) {
+				any = true;
+				stream.useProgram(m_instance_data_shader->getProgram(0));
+				stream.bindShaderBuffer(view.instance_data, 1, gpu::BindShaderBufferFlags::NONE);
+				stream.bindShaderBuffer(m_expanded_instances_buffer, 2, gpu::BindShaderBufferFlags::OUTPUT);
+			}
+			ub_values.indices_offset = instancer.indices.offset / (2 * sizeof(u32));
+			ub_values.output_offset = instancer.expanded_offset * 2;
+			ub_values.count = instancer.expanded_count;
+			const Renderer::TransientSlice ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+			stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+			stream.bindShaderBuffer(instancer.indices.buffer, 0, gpu::BindShaderBufferFlags::NONE);
+			stream.dispatch((instancer.expanded_count + 63) / 64, 1, 1);
+		}
+		if (!any) return;
 
-		view.sorter.pack();
+		// read as vertex data and by meshlet culling
+		stream.memoryBarrier(gpu::MemoryBarrierType::VERTEX | gpu::MemoryBarrierType::SSBO, m_expanded_instances_buffer);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 0, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 1, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 2, gpu::BindShaderBufferFlags::NONE);
 	}
 
 	struct Histogram {
@@ -3656,7 +5487,7 @@ struct PipelineImpl final : Pipeline
 		profiler::pushInt("count", size);
 		if (size == 0) return;
 
-		Array<u64> tmp_mem(m_allocator);
+		Array<u64> tmp_mem(jobs::getFrameAllocator());
 
 		u64* keys = _keys;
 		u64* values = _values;
@@ -3705,6 +5536,154 @@ struct PipelineImpl final : Pipeline
 		}
 	}
 
+	// histogram, prefix sum and scatter are all done per block of keys on workers
+	// first pass scatters directly from sorter's pages, so keys are not copied by Sorter::pack
+	void parallelRadixSort(Sorter& sorter, Span<Sorter::Page*> pages, u32 size) {
+		PROFILE_FUNCTION();
+		profiler::pushInt("count", size);
+		
+		struct Block {
+			u32 histogram[Histogram::SIZE];
+			u64 first_key;
+			u64 last_key;
+			bool sorted;
+		};
+
+		IAllocator& allocator = jobs::getFrameAllocator();
+		sorter.keys.resize(size);
+		sorter.values.resize(size);
+		Array<u64> tmp_mem(allocator);
+		tmp_mem.resize(size * 2);
+
+		const u32 block_size = RADIX_SORT_PAGES_PER_BLOCK * Sorter::Page::MAX_COUNT;
+		const u32 page_block_count = (pages.length() + RADIX_SORT_PAGES_PER_BLOCK - 1) / RADIX_SORT_PAGES_PER_BLOCK;
+		const u32 array_block_count = (size + block_size - 1) / block_size;
+		Array<Block> blocks(allocator);
+		blocks.resize(maximum(page_block_count, array_block_count));
+
+		// nullptr means keys are still in pages
+		// first pass goes to tmp_mem, so the last (even) pass ends in sorter's arrays
+		u64* src_keys = nullptr;
+		u64* src_values = nullptr;
+		u64* dst_keys = tmp_mem.begin();
+		u64* dst_values = &tmp_mem[size];
+		u64* other_keys = sorter.keys.begin();
+		u64* other_values = sorter.values.begin();
+
+		auto forEachRange = [&](u32 block_idx, auto f) {
+			if (src_keys) {
+				const u32 from = block_idx * block_size;
+				f(src_keys + from, src_values + from, minimum(block_size, size - from));
+				return;
+			}
+			const u32 to_page = minimum((block_idx + 1) * RADIX_SORT_PAGES_PER_BLOCK, pages.length());
+			for (u32 i = block_idx * RADIX_SORT_PAGES_PER_BLOCK; i < to_page; ++i) {
+				f(pages[i]->keys, pages[i]->values, pages[i]->header.count);
+			}
+		};
+
+		u16 shift = 0;
+		for (u32 pass = 0; pass < 6; ++pass) {
+			const u32 block_count = src_keys ? array_block_count : page_block_count;
+			jobs::forEach(block_count, 1, [&](i32 from, i32 to){
+				PROFILE_BLOCK("compute histogram");
+				for (i32 block_idx = from; block_idx < to; ++block_idx) {
+					Block& block = blocks[block_idx];
+					memset(block.histogram, 0, sizeof(block.histogram));
+					block.sorted = true;
+					bool first = true;
+					u64 prev_key = 0;
+					forEachRange(block_idx, [&](const u64* LUMIX_RESTRICT keys, const u64*, u32 count){
+						for (u32 i = 0; i < count; ++i) {
+							const u64 key = keys[i];
+							++block.histogram[(key >> shift) & Histogram::BIT_MASK];
+							if (first) {
+								block.first_key = key;
+								first = false;
+							}
+							block.sorted &= prev_key <= key;
+							prev_key = key;
+						}
+					});
+					if (first) block.first_key = 0;
+					block.last_key = prev_key;
+				}
+			});
+
+			// pages must be packed even if they are sorted
+			if (src_keys) {
+				bool sorted = true;
+				for (u32 i = 0; i < block_count; ++i) {
+					sorted = sorted && blocks[i].sorted && (i == 0 || blocks[i - 1].last_key <= blocks[i].first_key);
+				}
+				if (sorted) {
+					if (src_keys != sorter.keys.begin()) {
+						memcpy(sorter.keys.begin(), src_keys, size * sizeof(u64));
+						memcpy(sorter.values.begin(), src_values, size * sizeof(u64));
+					}
+					return;
+				}
+			}
+
+			// stable, dst position of a key depends on its digit and block
+			u32 offset = 0;
+			for (u32 digit = 0; digit < Histogram::SIZE; ++digit) {
+				for (u32 i = 0; i < block_count; ++i) {
+					const u32 count = blocks[i].histogram[digit];
+					blocks[i].histogram[digit] = offset;
+					offset += count;
+				}
+			}
+
+			jobs::forEach(block_count, 1, [&](i32 from, i32 to){
+				PROFILE_BLOCK("scatter");
+				for (i32 block_idx = from; block_idx < to; ++block_idx) {
+					u32* LUMIX_RESTRICT histogram = blocks[block_idx].histogram;
+					forEachRange(block_idx, [&](const u64* LUMIX_RESTRICT keys, const u64* LUMIX_RESTRICT values, u32 count){
+						for (u32 i = 0; i < count; ++i) {
+							const u64 key = keys[i];
+							const u32 dest = histogram[(key >> shift) & Histogram::BIT_MASK]++;
+							dst_keys[dest] = key;
+							dst_values[dest] = values[i];
+						}
+					});
+				}
+			});
+
+			if (!src_keys) {
+				sorter.freePages();
+				src_keys = other_keys;
+				src_values = other_values;
+			}
+			swap(src_keys, dst_keys);
+			swap(src_values, dst_values);
+			shift += Histogram::BITS;
+		}
+		ASSERT(src_keys == sorter.keys.begin());
+	}
+
+	void sortKeys(Sorter& sorter) {
+		u32 size = 0;
+		u32 page_count = 0;
+		for (Sorter::Page* p = sorter.first_page; p; p = p->header.next) {
+			size += p->header.count;
+			++page_count;
+		}
+
+		if (size < PARALLEL_RADIX_SORT_MIN_COUNT) {
+			sorter.pack();
+			radixSort(sorter.keys.begin(), sorter.values.begin(), sorter.keys.size());
+			return;
+		}
+
+		Array<Sorter::Page*> pages(jobs::getFrameAllocator());
+		pages.reserve(page_count);
+		for (Sorter::Page* p = sorter.first_page; p; p = p->header.next) {
+			if (p->header.count > 0) pages.push(p);
+		}
+		parallelRadixSort(sorter, pages, size);
+	}
+
 	void clear(u32 flags, float r, float g, float b, float a, float depth) {
 		const Vec4 color = Vec4(r, g, b, a);
 		DrawStream& stream = m_renderer.getDrawStream();
@@ -3836,6 +5815,7 @@ struct PipelineImpl final : Pipeline
 		REGISTER_FUNCTION(bindImageTexture);
 		REGISTER_FUNCTION(bindShaderBuffer);
 		REGISTER_FUNCTION(bindTextures);
+		REGISTER_FUNCTION(buildHiZ);
 		REGISTER_FUNCTION(clear);
 		REGISTER_FUNCTION(createBuffer);
 		REGISTER_FUNCTION(createRenderbufferDesc);
@@ -3885,7 +5865,11 @@ struct PipelineImpl final : Pipeline
 		registerConst("STENCIL_REPLACE", (u32)gpu::StencilOps::REPLACE);
 
 		registerCFunction("cull", PipelineImpl::cull);
+		registerCFunction("cullShared", PipelineImpl::cullShared);
 		registerCFunction("drawcallUniforms", PipelineImpl::drawcallUniforms);
+		registerCFunction("executeRenderGraph", PipelineImpl::executeRenderGraph);
+		registerCFunction("renderGraphPass", PipelineImpl::renderGraphPass);
+		registerCFunction("renderGraphTexture", PipelineImpl::renderGraphTexture);
 		registerCFunction("setRenderTargets", PipelineImpl::setRenderTargets);
 		registerCFunction("setRenderTargetsDS", PipelineImpl::setRenderTargetsDS);
 		registerCFunction("setRenderTargetsReadonlyDS", PipelineImpl::setRenderTargetsReadonlyDS);
@@ -3929,6 +5913,7 @@ struct PipelineImpl final : Pipeline
 	}
 	
 	void setIndirectLightMultiplier(float value) override { m_indirect_light_multiplier = value; }
+	void setGPULightClustering(bool enable) override { m_gpu_light_clustering = enable; }
 
 	IAllocator& m_allocator;
 	Renderer& m_renderer;
@@ -3945,21 +5930,57 @@ struct PipelineImpl final : Pipeline
 	jobs::Signal m_buckets_ready;
 	Viewport m_viewport;
 	Viewport m_prev_viewport;
+	// scene is rendered in m_render_size = m_render_scale * viewport size and upscaled by the pipeline
+	float m_render_scale = 1;
+	float m_desired_render_scale = 1;
+	IVec2 m_render_size = IVec2(800);
+	Array<Renderer::GPUPassStats> m_gpu_pass_stats;
 	float m_indirect_light_multiplier = 1;
 	bool m_first_set_viewport = true;
 	int m_output;
 	Shader* m_debug_shape_shader;
 	Shader* m_instancing_shader;
+	Shader* m_hiz_shader;
+	Shader* m_light_clusters_shader;
+	Shader* m_meshlets_shader;
+	Shader* m_instance_data_shader;
+	Shader* m_grass_shader;
+	Shader* m_terrain_vt_shader;
+	Shader* m_skinning_shader;
+	HiZ m_hiz;
 	Array<CustomCommandHandler> m_custom_commands_handlers;
 	Array<RenderbufferDesc> m_renderbuffer_descs;
 	Array<Renderbuffer> m_renderbuffers;
+	RenderGraph m_render_graph;
 	Array<ShaderRef> m_shaders;
 	Array<gpu::TextureHandle> m_textures;
 	Array<gpu::BufferHandle> m_buffers;
 	os::Timer m_timer;
 	volatile i32 m_indirect_buffer_offset;
+	volatile i32 m_meshlet_indirect_offset;
+	volatile i32 m_expanded_instances_offset;
+	// scene's instance data buffer if it's up to date this frame
+	gpu::BufferHandle m_instance_data = gpu::INVALID_BUFFER;
+	HashMap<u64, CellSortKeys*> m_cell_sort_keys;
+	// replaced entries, still used by views prepared this frame
+	Array<CellSortKeys*> m_retired_cell_sort_keys;
+	jobs::Mutex m_cell_sort_keys_mutex;
 	gpu::BufferHandle m_instanced_meshes_buffer;
 	gpu::BufferHandle m_indirect_buffer;
+	gpu::BufferHandle m_meshlet_indirect_buffer;
+	gpu::BufferHandle m_expanded_instances_buffer;
+	// shared by all grass types, types are generated and drawn one after another
+	gpu::BufferHandle m_grass_instances_buffer;
+	gpu::BufferHandle m_grass_indirect_buffer;
+	// skinned meshes of model instances, filled once per frame before any view is prepared
+	gpu::BufferHandle m_skinned_vertices_buffer;
+	// entity -> index of the first mesh in m_skinned_mesh_offsets, valid only in m_skinning_frame
+	HashMap<EntityRef, u32> m_skinned_instances;
+	// byte offset in m_skinned_vertices_buffer for each mesh of a skinned instance, INVALID_SKINNED_OFFSET if not skinned
+	Array<u32> m_skinned_mesh_offsets;
+	// dispatched by skinModelInstances, grouped by entity
+	Array<SkinningMesh> m_skinning_meshes;
+	u32 m_skinning_frame = 0xffFFffFF;
 	gpu::VertexDecl m_base_vertex_decl;
 	gpu::VertexDecl m_base_line_vertex_decl;
 	gpu::VertexDecl m_2D_decl;
@@ -3969,6 +5990,7 @@ struct PipelineImpl final : Pipeline
 	gpu::BufferHandle m_cube_ib;
 	
 	ShadowAtlas m_shadow_atlas;
+	TerrainVT m_terrain_vt;
 
 	struct {
 		struct Buffer {
@@ -3980,8 +6002,23 @@ struct PipelineImpl final : Pipeline
 		Buffer maps;
 		Buffer env_probes;
 		Buffer refl_probes;
+		// used only by GPU clustering
+		Buffer bounds;
+		Buffer counter;
 	} m_cluster_buffers;
+	bool m_gpu_light_clustering = true;
+	// results of cullShared, valid until the end of frame
+	struct SharedCull {
+		CameraParamsHandle cp_handles[CullingSystem::MAX_CULL_FRUSTA];
+		ShiftedFrustum frusta[CullingSystem::MAX_CULL_FRUSTA];
+		CullResult* results[CullingSystem::MAX_CULL_FRUSTA];
+		volatile i32 taken[CullingSystem::MAX_CULL_FRUSTA];
+		u32 count = 0;
+		jobs::Signal ready;
+	} m_shared_cull;
 	Viewport m_shadow_camera_viewports[4];
+	// with caster-receiver extrusion planes, see findExtraShadowcasterPlanes
+	ShiftedFrustum m_shadow_camera_frusta[4] = {};
 };
 
 
@@ -80,6 +80,8 @@ struct LUMIX_RENDERER_API Pipeline {
 	virtual Viewport getViewport() = 0;
 	virtual void define(const char* define, bool enable) = 0;
 	virtual void setIndirectLightMultiplier(float value) = 0;
+	// lights and probes are assigned to clusters by a compute shader, otherwise on CPU
+	virtual void setGPULightClustering(bool enable) = 0;
 
 	virtual Draw2D& getDraw2D() = 0;
 	virtual void clearDraw2D() = 0;
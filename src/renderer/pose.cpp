@@ -14,8 +14,10 @@ Pose::Pose(IAllocator& allocator)
 {
 	positions = nullptr;
 	rotations = nullptr;
+	skinning = nullptr;
 	count = 0;
 	is_absolute = false;
+	is_skinning_valid = false;
 }
 
 
@@ -23,6 +25,7 @@ Pose::~Pose()
 {
 	allocator.deallocate(positions);
 	allocator.deallocate(rotations);
+	allocator.deallocate(skinning);
 }
 
 
@@ -32,6 +35,7 @@ void Pose::blend(Pose& rhs, float weight)
 	if (weight <= 0.001f) return;
 	weight = clamp(weight, 0.0f, 1.0f);
 	float inv = 1.0f - weight;
+	is_skinning_valid = false;
 	for (int i = 0, c = count; i < c; ++i)
 	{
 		positions[i] = positions[i] * inv + rhs.positions[i] * weight;
@@ -43,18 +47,22 @@ void Pose::blend(Pose& rhs, float weight)
 void Pose::resize(int count)
 {
 	is_absolute = false;
+	is_skinning_valid = false;
 	allocator.deallocate(positions);
 	allocator.deallocate(rotations);
+	allocator.deallocate(skinning);
 	this->count = count;
 	if (count)
 	{
 		positions = static_cast<Vec3*>(allocator.allocate(sizeof(Vec3) * count));
 		rotations = static_cast<Quat*>(allocator.allocate(sizeof(Quat) * count));
+		skinning = static_cast<DualQuat*>(allocator.allocate(sizeof(DualQuat) * count));
 	}
 	else
 	{
 		positions = nullptr;
 		rotations = nullptr;
+		skinning = nullptr;
 	}
 }
 
@@ -62,6 +70,7 @@ void Pose::resize(int count)
 void Pose::computeAbsolute(Model& model)
 {
 	if (is_absolute) return;
+	is_skinning_valid = false;
 	for (u32 i = model.getFirstNonrootBoneIndex(); i < count; ++i)
 	{
 		int parent = model.getBone(i).parent_idx;
@@ -72,9 +81,32 @@ void Pose::computeAbsolute(Model& model)
 }
 
 
+void Pose::computeSkinning(Model& model)
+{
+	if (is_absolute && is_skinning_valid) return;
+	// bones are sorted so parents come first, absolute transforms and skinning are computed in the same pass
+	const u32 first_nonroot = is_absolute ? count : model.getFirstNonrootBoneIndex();
+	for (u32 i = 0; i < count; ++i)
+	{
+		const Model::Bone& bone = model.getBone(i);
+		if (i >= first_nonroot)
+		{
+			const int parent = bone.parent_idx;
+			positions[i] = rotations[parent].rotate(positions[i]) + positions[parent];
+			rotations[i] = rotations[parent] * rotations[i];
+		}
+		const LocalRigidTransform tmp = {positions[i], rotations[i]};
+		skinning[i] = (tmp * bone.inv_bind_transform).toDualQuat();
+	}
+	is_absolute = true;
+	is_skinning_valid = true;
+}
+
+
 void Pose::computeRelative(Model& model)
 {
 	if (!is_absolute) return;
+	is_skinning_valid = false;
 	for (int i = count - 1; i >= model.getFirstNonrootBoneIndex(); --i)
 	{
 		int parent = model.getBone(i).parent_idx;
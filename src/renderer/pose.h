@@ -8,6 +8,7 @@ namespace Lumix
 {
 
 
+struct DualQuat;
 struct IAllocator;
 struct Matrix;
 struct Model;
@@ -23,13 +24,19 @@ struct LUMIX_RENDERER_API Pose
 	void resize(int count);
 	void computeAbsolute(Model& model);
 	void computeRelative(Model& model);
+	// computes absolute pose and skinning transforms, so renderer does not need to do any per-bone work
+	void computeSkinning(Model& model);
 	void blend(Pose& rhs, float weight);
 
 	IAllocator& allocator;
 	bool is_absolute;
+	// anything changing the pose must reset this
+	bool is_skinning_valid;
 	u32 count;
 	Vec3* positions;
 	Quat* rotations;
+	// absolute transform * inverse bind transform, valid only if is_skinning_valid
+	DualQuat* skinning;
 	
 	private:
 		Pose(const Pose&);
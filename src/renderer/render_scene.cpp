@@ -5,8 +5,10 @@
 #include "engine/crt.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
+#include "engine/flat_hash_map.h"
 #include "engine/geometry.h"
 #include "engine/hash.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/math.h"
@@ -100,7 +102,8 @@ struct RenderSceneImpl final : RenderScene {
 	~RenderSceneImpl()
 	{
 		m_renderer.getEndFrameDrawStream().destroy(m_reflection_probes_texture);
-		m_universe.entityTransformed().unbind<&RenderSceneImpl::onEntityMoved>(this);
+		if (m_instance_data_buffer) m_renderer.getEndFrameDrawStream().destroy(m_instance_data_buffer);
+		m_universe.entitiesTransformed().unbind<&RenderSceneImpl::onEntitiesMoved>(this);
 		m_universe.entityDestroyed().unbind<&RenderSceneImpl::onEntityDestroyed>(this);
 		m_culling_system.reset();
 	}
@@ -201,6 +204,7 @@ struct RenderSceneImpl final : RenderScene {
 			if (pg.material) pg.material->decRefCount();
 			if (pg.vertex_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.vertex_buffer);
 			if (pg.index_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.index_buffer);
+			destroyDynamic(pg);
 		}
 		m_procedural_geometries.clear();
 
@@ -265,6 +269,23 @@ struct RenderSceneImpl final : RenderScene {
 	IPlugin& getPlugin() const override { return m_renderer; }
 
 
+	bool getComponentChunk(ComponentType type, ComponentChunk& chunk) override {
+		if (type == BONE_ATTACHMENT_TYPE) {
+			chunk = ComponentChunk::fromArrays(m_bone_attachments.keys(), m_bone_attachments.values());
+			return true;
+		}
+		if (type == ENVIRONMENT_PROBE_TYPE) {
+			chunk = ComponentChunk::fromArrays(m_environment_probes.keys(), m_environment_probes.values());
+			return true;
+		}
+		if (type == REFLECTION_PROBE_TYPE) {
+			chunk = ComponentChunk::fromArrays(m_reflection_probes.keys(), m_reflection_probes.values());
+			return true;
+		}
+		return false;
+	}
+
+
 	void getRay(EntityRef camera_entity,
 		const Vec2& screen_pos,
 		DVec3& origin,
@@ -543,22 +564,117 @@ struct RenderSceneImpl final : RenderScene {
 	void update(float dt, bool paused) override {
 		PROFILE_FUNCTION();
 
+		// keep changes of the previous update, so pipelines rendered after it still see them
+		const u32 expired = m_shadow_caster_changes_prev_count;
+		for (u32 i = expired, c = m_shadow_caster_changes.size(); i < c; ++i) {
+			m_shadow_caster_changes[i - expired] = m_shadow_caster_changes[i];
+		}
+		m_shadow_caster_changes.resize(m_shadow_caster_changes.size() - expired);
+		m_first_shadow_caster_change += expired;
+		m_shadow_caster_changes_prev_count = m_shadow_caster_changes.size();
+
+		m_culling_system->update();
 		if (!m_is_game_running) return;
 		if (paused) return;
 
-		Array<EntityRef> to_delete(m_allocator);
+		// emitters are independent, update them in parallel; big emitters split their particles further
+		Array<ParticleEmitter*> emitters(m_allocator);
+		emitters.reserve(m_particle_emitters.size());
 		for (ParticleEmitter& emitter : m_particle_emitters) {
-			if (emitter.update(dt, m_engine.getPageAllocator())) {
-				to_delete.push(*emitter.m_entity);
+			emitters.push(&emitter);
+		}
+		Array<ParticleEmitterLOD> lods(m_allocator);
+		lods.resize(emitters.size());
+		computeParticleEmittersLOD(emitters, lods);
+
+		Array<bool> destroy(m_allocator);
+		destroy.resize(emitters.size());
+		jobs::forEach(emitters.size(), 1, [&](i32 from, i32 to){
+			PROFILE_BLOCK("update particles");
+			for (i32 i = from; i < to; ++i) {
+				const ParticleEmitterLOD& lod = lods[i];
+				destroy[i] = emitters[i]->update(dt, m_engine.getPageAllocator(), lod.distance, lod.visible, lod.can_emit);
 			}
+		});
+
+		Array<EntityRef> to_delete(m_allocator);
+		for (i32 i = 0; i < emitters.size(); ++i) {
+			emitters[i]->simulateGPU(m_renderer);
+			if (destroy[i]) to_delete.push(*emitters[i]->m_entity);
 		}
 		for (EntityRef e : to_delete) {
 			m_universe.destroyEntity(e);
 		}
 	}
 
+	struct ParticleEmitterLOD {
+		float distance = 0;
+		bool visible = true;
+		bool can_emit = true;
+	};
+
+	void computeParticleEmittersLOD(Span<ParticleEmitter* const> emitters, Span<ParticleEmitterLOD> lods) {
+		if (!m_active_camera.isValid()) return;
+		
+		const EntityRef camera = (EntityRef)m_active_camera;
+		const Viewport vp = getCameraViewport(camera);
+		// screen size is not known until camera is rendered
+		const bool has_frustum = vp.w > 0 && vp.h > 0;
+		const ShiftedFrustum frustum = has_frustum ? vp.getFrustum() : ShiftedFrustum();
+		for (u32 i = 0; i < emitters.length(); ++i) {
+			const ParticleEmitter& emitter = *emitters[i];
+			const DVec3 pos = m_universe.getPosition((EntityRef)emitter.m_entity);
+			lods[i].distance = (float)length(pos - vp.pos);
+			const ParticleEmitterResource* res = emitter.getResource();
+			if (has_frustum && res && res->isReady()) {
+				const float r = res->getLOD().radius;
+				lods[i].visible = frustum.intersectsAABB(pos - Vec3(r), Vec3(2 * r));
+			}
+		}
+
+		if (m_particle_budget == 0) return;
+
+		// closest emitters get the budget first
+		struct SortItem {
+			float distance;
+			u32 idx;
+		};
+		Array<SortItem> order(m_allocator);
+		order.resize(emitters.length());
+		for (u32 i = 0; i < emitters.length(); ++i) order[i] = { lods[i].distance, i };
+		qsort(order.begin(), order.size(), sizeof(order[0]), [](const void* a, const void* b) -> int {
+			const float i = ((const SortItem*)a)->distance;
+			const float j = ((const SortItem*)b)->distance;
+			if (i < j) return -1;
+			if (i > j) return 1;
+			return 0;
+		});
+		u32 total = 0;
+		for (const SortItem& item : order) {
+			lods[item.idx].can_emit = total < m_particle_budget;
+			const ParticleEmitter& emitter = *emitters[item.idx];
+			// GPU emitters' particle count is not read back, assume they are full
+			total += emitter.isGPU() ? emitter.getGPUData().capacity : emitter.getParticlesCount();
+		}
+	}
+
+	void setParticleBudget(u32 count) override { m_particle_budget = count; }
+	u32 getParticleBudget() const override { return m_particle_budget; }
+
 	int getVersion() const override { return (int)RenderSceneVersion::LATEST; }
 
+	Span<const ShadowCasterChange> getShadowCasterChanges(u64& first_idx) override {
+		first_idx = m_first_shadow_caster_change;
+		return m_shadow_caster_changes;
+	}
+
+	void shadowCasterChanged(EntityRef entity) {
+		if (!m_culling_system->isAdded(entity)) return;
+		ShadowCasterChange& change = m_shadow_caster_changes.emplace();
+		change.pos = m_culling_system->getPosition(entity);
+		change.radius = m_culling_system->getRadius(entity);
+	}
+
 	void serializeBoneAttachments(OutputMemoryStream& serializer)
 	{
 		serializer.write((i32)m_bone_attachments.size());
@@ -827,7 +943,7 @@ struct RenderSceneImpl final : RenderScene {
 		
 		probe.load_job = LUMIX_NEW(m_allocator, ReflectionProbe::LoadJob)(*this, entity, m_allocator);
 		FileSystem::ContentCallback cb = makeDelegate<&ReflectionProbe::LoadJob::callback>(probe.load_job);
-		probe.load_job->m_handle = m_engine.getFileSystem().getContent(Path(path_str), cb);
+		probe.load_job->m_handle = m_engine.getFileSystem().getContent(Path(path_str), cb, FileSystem::Priority::LOW);
 	}
 
 	void deserializeEnvironmentProbes(InputMemoryStream& serializer, const EntityMap& entity_map)
@@ -982,6 +1098,7 @@ struct RenderSceneImpl final : RenderScene {
 					setModelInstanceMaterialOverride(e, Path(mat_path));
 				}
 
+				markInstanceDataDirty(e);
 				m_universe.onComponentCreated(e, MODEL_INSTANCE_TYPE, this);
 			}
 		}
@@ -1028,6 +1145,7 @@ struct RenderSceneImpl final : RenderScene {
 					setModelInstanceMaterialOverride(e, Path(mat_path));
 				}
 
+				markInstanceDataDirty(e);
 				m_universe.onComponentCreated(e, MODEL_INSTANCE_TYPE, this);
 			}
 		}
@@ -1450,20 +1568,29 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
-	void onEntityMoved(EntityRef entity)
+	void onEntitiesMoved(Span<const EntityRef> entities)
 	{
-		const u64 cmp_mask = m_universe.getComponentsMask(entity);
-		if ((cmp_mask & m_render_cmps_mask) == 0) {
-			return;
-		}
+		// model instances are updated in culling system in one batch
+		m_moved_entities.clear();
+		m_moved_positions.clear();
+		m_moved_radii.clear();
+		for (EntityRef entity : entities) {
+			const u64 cmp_mask = m_universe.getComponentsMask(entity);
+			if ((cmp_mask & m_render_cmps_mask) == 0) continue;
+			// instance data are kept up to date even if the instance is not rendered yet, e.g. its model is loading
+			if (m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) markInstanceDataDirty(entity);
+			if (!m_culling_system->isAdded(entity)) continue;
 
-		if (m_culling_system->isAdded(entity)) {
 			if (m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) {
 				const Transform& tr = m_universe.getTransform(entity);
 				const Model* model = m_model_instances[entity.index].model;
 				ASSERT(model);
 				const float bounding_radius = model->getOriginBoundingRadius();
-				m_culling_system->set(entity, tr.pos, bounding_radius * tr.scale);
+				shadowCasterChanged(entity);
+				m_shadow_caster_changes.push({tr.pos, bounding_radius * tr.scale});
+				m_moved_entities.push(entity);
+				m_moved_positions.push(tr.pos);
+				m_moved_radii.push(bounding_radius * tr.scale);
 			}
 			else if (m_universe.hasComponent(entity, DECAL_TYPE)) {
 				auto iter = m_decals.find(entity);
@@ -1482,7 +1609,23 @@ struct RenderSceneImpl final : RenderScene {
 				m_culling_system->setPosition(entity, pos);
 			}
 		}
+		if (!m_moved_entities.empty()) {
+			m_culling_system->set(m_moved_entities, m_moved_positions, m_moved_radii);
+		}
+
+		if (m_bone_attachments.size() == 0) return;
+
+		// can move other entities, so it's after culling system is updated
+		for (EntityRef entity : entities) {
+			const u64 cmp_mask = m_universe.getComponentsMask(entity);
+			if ((cmp_mask & m_render_cmps_mask) == 0) continue;
+			updateAttachments(entity);
+		}
+	}
+
 
+	void updateAttachments(EntityRef entity)
+	{
 		bool was_updating = m_is_updating_attachments;
 		m_is_updating_attachments = true;
 		for (auto& attachment : m_bone_attachments)
@@ -1557,6 +1700,18 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
+	void getTerrainHeightsAt(EntityRef entity, Span<const Vec2> points, Span<float> heights) override
+	{
+		m_terrains[entity]->getHeights(points, heights);
+	}
+
+
+	void getTerrainNormalsAt(EntityRef entity, Span<const Vec2> points, Span<Vec3> normals) override
+	{
+		m_terrains[entity]->getNormals(points, normals);
+	}
+
+
 	AABB getTerrainAABB(EntityRef entity) override
 	{
 		return m_terrains[entity]->getAABB();
@@ -1746,6 +1901,30 @@ struct RenderSceneImpl final : RenderScene {
 		return m_terrains[entity]->m_base_grid_res; 
 	}
 
+	void setTerrainTilesCount(EntityRef entity, u32 value) override {
+		m_terrains[entity]->setTilesCount(value);
+	}
+
+	u32 getTerrainTilesCount(EntityRef entity) override {
+		return m_terrains[entity]->getTilesCount();
+	}
+
+	void setTerrainTileStreamDistance(EntityRef entity, float value) override {
+		m_terrains[entity]->m_tile_stream_distance = value;
+	}
+
+	float getTerrainTileStreamDistance(EntityRef entity) override {
+		return m_terrains[entity]->m_tile_stream_distance;
+	}
+
+	void setTerrainVirtualTexturing(EntityRef entity, bool enable) override {
+		m_terrains[entity]->m_virtual_texturing = enable;
+	}
+
+	bool getTerrainVirtualTexturing(EntityRef entity) override {
+		return m_terrains[entity]->m_virtual_texturing;
+	}
+
 	void setTerrainTesselation(EntityRef entity, u32 value) override {
 		m_terrains[entity]->m_tesselation = maximum(1, value);
 	}
@@ -1776,6 +1955,7 @@ struct RenderSceneImpl final : RenderScene {
 		ProceduralGeometry& pg = m_procedural_geometries[entity];
 		pg.index_data.clear();
 		pg.vertex_data.clear();
+		destroyDynamic(pg);
 		if (pg.vertex_buffer) {
 			m_renderer.getEndFrameDrawStream().destroy(pg.vertex_buffer);
 			pg.vertex_buffer = gpu::INVALID_BUFFER;
@@ -1837,6 +2017,9 @@ struct RenderSceneImpl final : RenderScene {
 		
 		if (pg.index_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.index_buffer);
 		if (pg.vertex_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.vertex_buffer);
+		pg.index_buffer = gpu::INVALID_BUFFER;
+		pg.vertex_buffer = gpu::INVALID_BUFFER;
+		destroyDynamic(pg);
 		
 		if (indices.length() > 0) {
 			pg.index_data.write(indices.begin(), indices.length());
@@ -1844,11 +2027,233 @@ struct RenderSceneImpl final : RenderScene {
 			pg.index_buffer = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
 		}
 		
-		const Renderer::MemRef mem = m_renderer.copy(vertex_data.begin(), vertex_data.length());
-		pg.vertex_buffer = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
+		if (vertex_data.length() > 0) {
+			const Renderer::MemRef mem = m_renderer.copy(vertex_data.begin(), vertex_data.length());
+			pg.vertex_buffer = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
+		}
 		computeAABB(pg);
 	}
 	
+	void destroyDynamic(ProceduralGeometry& pg) {
+		if (!pg.dynamic) return;
+		DrawStream& stream = m_renderer.getEndFrameDrawStream();
+		stream.destroy(pg.dynamic->buffer);
+		// buffer can be mapped by a job in this frame's draw stream, which runs before the end frame stream
+		stream.freeMemory(pg.dynamic, m_allocator);
+		pg.dynamic = nullptr;
+	}
+
+	static void markDirty(ProceduralGeometryDynamic::Range (&ranges)[ProceduralGeometryDynamic::REGIONS_COUNT], u32 from, u32 to) {
+		for (ProceduralGeometryDynamic::Range& range : ranges) range.add(from, to);
+	}
+
+	void setProceduralGeometryDynamic(EntityRef entity
+		, const gpu::VertexDecl& vertex_decl
+		, u32 vertex_capacity
+		, gpu::DataType index_type
+		, u32 index_capacity) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(vertex_capacity > 0);
+		ProceduralGeometry& pg = m_procedural_geometries[entity];
+		if (pg.index_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.index_buffer);
+		if (pg.vertex_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.vertex_buffer);
+		pg.index_buffer = gpu::INVALID_BUFFER;
+		pg.vertex_buffer = gpu::INVALID_BUFFER;
+		destroyDynamic(pg);
+
+		pg.vertex_decl = vertex_decl;
+		pg.index_type = index_type;
+		pg.vertex_data.clear();
+		pg.index_data.clear();
+
+		ProceduralGeometryDynamic* dyn = new (NewPlaceholder(), m_allocator.allocate(sizeof(ProceduralGeometryDynamic))) ProceduralGeometryDynamic;
+		dyn->vertex_capacity = vertex_capacity * vertex_decl.getStride();
+		dyn->index_capacity = index_capacity * (index_type == gpu::DataType::U16 ? 2 : 4);
+		dyn->index_offset = (dyn->vertex_capacity + 15) & ~15;
+		// offsets of regions are aligned so any vertex format can be bound at them
+		dyn->region_size = (dyn->index_offset + dyn->index_capacity + 255) & ~255;
+		pg.vertex_data.reserve(dyn->vertex_capacity);
+		pg.index_data.reserve(dyn->index_capacity);
+
+		const u32 size = dyn->region_size * ProceduralGeometryDynamic::REGIONS_COUNT;
+		dyn->buffer = gpu::allocBufferHandle();
+		DrawStream& stream = m_renderer.getDrawStream();
+		stream.createBuffer(dyn->buffer, gpu::BufferFlags::MAPPABLE, size, nullptr);
+		stream.pushLambda([dyn, size](){
+			dyn->ptr = (u8*)gpu::map(dyn->buffer, size);
+		});
+		pg.dynamic = dyn;
+		computeAABB(pg);
+	}
+
+	void setProceduralGeometryCounts(EntityRef entity, u32 vertex_count, u32 index_count) override {
+		ProceduralGeometry& pg = m_procedural_geometries[entity];
+		ProceduralGeometryDynamic* dyn = pg.dynamic;
+		ASSERT(dyn);
+		const u32 vertices_size = vertex_count * pg.vertex_decl.getStride();
+		const u32 indices_size = index_count * (pg.index_type == gpu::DataType::U16 ? 2 : 4);
+		ASSERT(vertices_size <= dyn->vertex_capacity);
+		ASSERT(indices_size <= dyn->index_capacity);
+
+		const u32 prev_vertices_size = (u32)pg.vertex_data.size();
+		const u32 prev_indices_size = (u32)pg.index_data.size();
+		pg.vertex_data.resize(vertices_size);
+		pg.index_data.resize(indices_size);
+		if (vertices_size > prev_vertices_size) markDirty(dyn->dirty_vertices, prev_vertices_size, vertices_size);
+		if (indices_size > prev_indices_size) markDirty(dyn->dirty_indices, prev_indices_size, indices_size);
+		dyn->aabb_dirty = true;
+	}
+
+	Span<u8> writeProceduralGeometryVertices(EntityRef entity, u32 first, u32 count) override {
+		ProceduralGeometry& pg = m_procedural_geometries[entity];
+		ASSERT(pg.dynamic);
+		const u32 stride = pg.vertex_decl.getStride();
+		ASSERT((first + count) * stride <= pg.vertex_data.size());
+		markDirty(pg.dynamic->dirty_vertices, first * stride, (first + count) * stride);
+		pg.dynamic->aabb_dirty = true;
+		return Span(pg.vertex_data.getMutableData() + first * stride, count * stride);
+	}
+
+	Span<u8> writeProceduralGeometryIndices(EntityRef entity, u32 first, u32 count) override {
+		ProceduralGeometry& pg = m_procedural_geometries[entity];
+		ASSERT(pg.dynamic);
+		const u32 index_size = pg.index_type == gpu::DataType::U16 ? 2 : 4;
+		ASSERT((first + count) * index_size <= pg.index_data.size());
+		markDirty(pg.dynamic->dirty_indices, first * index_size, (first + count) * index_size);
+		return Span(pg.index_data.getMutableData() + first * index_size, count * index_size);
+	}
+
+	void uploadProceduralGeometries() override {
+		// pipeline waited for this frame's data to be free, so the GPU does not read the frame's region anymore
+		const u32 frame = m_renderer.frameNumber();
+		if (frame == m_procedural_geometries_upload_frame) return;
+		m_procedural_geometries_upload_frame = frame;
+
+		PROFILE_FUNCTION();
+		const u32 region = frame % ProceduralGeometryDynamic::REGIONS_COUNT;
+		for (ProceduralGeometry& pg : m_procedural_geometries) {
+			ProceduralGeometryDynamic* dyn = pg.dynamic;
+			if (!dyn) continue;
+			if (dyn->aabb_dirty) {
+				computeAABB(pg);
+				dyn->aabb_dirty = false;
+			}
+
+			u8* ptr = dyn->ptr;
+			// not mapped yet, dirty ranges are kept for later
+			if (!ptr) continue;
+
+			u8* dst = ptr + region * dyn->region_size;
+			ProceduralGeometryDynamic::Range& vertices = dyn->dirty_vertices[region];
+			const u32 vertices_end = minimum(vertices.end, (u32)pg.vertex_data.size());
+			if (vertices.begin < vertices_end) {
+				memcpy(dst + vertices.begin, pg.vertex_data.data() + vertices.begin, vertices_end - vertices.begin);
+			}
+			vertices = {};
+
+			ProceduralGeometryDynamic::Range& indices = dyn->dirty_indices[region];
+			const u32 indices_end = minimum(indices.end, (u32)pg.index_data.size());
+			if (indices.begin < indices_end) {
+				memcpy(dst + dyn->index_offset + indices.begin, pg.index_data.data() + indices.begin, indices_end - indices.begin);
+			}
+			indices = {};
+
+			dyn->region = region;
+			dyn->uploaded_frame = frame;
+		}
+	}
+
+	// see uploadInstanceData, same layout as in pipelines/instance_data.shd
+	struct InstanceData {
+		Vec4 rot_scale;
+		Vec4 pos_high;
+		Vec4 pos_low;
+	};
+
+	InstanceData getInstanceData(EntityRef entity) const {
+		const Transform& tr = m_universe.getTransform(entity);
+		// w is reconstructed in shaders, so it must not be negative
+		const Quat rot = tr.rot.w > 0 ? tr.rot : Quat(-tr.rot.x, -tr.rot.y, -tr.rot.z, -tr.rot.w);
+		const Vec3 pos_high = Vec3(tr.pos);
+		InstanceData res;
+		res.rot_scale = Vec4(rot.x, rot.y, rot.z, tr.scale);
+		res.pos_high = Vec4(pos_high, 0);
+		res.pos_low = Vec4(Vec3(tr.pos - DVec3(pos_high)), 0);
+		return res;
+	}
+
+	void markInstanceDataDirty(EntityRef entity) {
+		// entities out of capacity are uploaded together with all others when the buffer grows
+		if (entity.index >= (i32)m_instance_data_capacity) return;
+		if (m_instance_data_dirty_flags[entity.index]) return;
+		m_instance_data_dirty_flags[entity.index] = 1;
+		m_instance_data_dirty.push(entity);
+	}
+
+	bool uploadInstanceData(gpu::ProgramHandle scatter_program) override {
+		PROFILE_FUNCTION();
+		const u32 count = m_model_instances.size();
+		if (count > m_instance_data_capacity) {
+			const u32 capacity = maximum(nextPow2(count), 4096u);
+			if (m_instance_data_buffer) m_renderer.getEndFrameDrawStream().destroy(m_instance_data_buffer);
+			const Renderer::MemRef mem = m_renderer.allocate(capacity * sizeof(InstanceData));
+			InstanceData* data = (InstanceData*)mem.data;
+			memset(data, 0, mem.size);
+			for (u32 i = 0; i < count; ++i) {
+				if (m_model_instances[i].flags.isSet(ModelInstance::VALID)) data[i] = getInstanceData({(i32)i});
+			}
+			m_instance_data_buffer = m_renderer.createBuffer(mem, gpu::BufferFlags::SHADER_BUFFER | gpu::BufferFlags::COMPUTE_WRITE);
+			m_instance_data_capacity = capacity;
+			m_instance_data_dirty.clear();
+			m_instance_data_dirty_flags.resize(capacity);
+			memset(m_instance_data_dirty_flags.begin(), 0, capacity);
+			profiler::pushInt("count", count);
+			return true;
+		}
+
+		if (m_instance_data_dirty.empty()) return true;
+		if (!scatter_program) return false;
+
+		struct Update {
+			u32 index[4];
+			InstanceData data;
+		};
+
+		const u32 dirty_count = m_instance_data_dirty.size();
+		profiler::pushInt("count", dirty_count);
+		// transient memory is aligned only to 16 bytes
+		const Renderer::TransientSlice slice = m_renderer.allocTransient((dirty_count + 1) * sizeof(Update));
+		const u32 offset = (slice.offset + sizeof(Update) - 1) & ~u32(sizeof(Update) - 1);
+		Update* updates = (Update*)(slice.ptr + offset - slice.offset);
+		for (u32 i = 0; i < dirty_count; ++i) {
+			const EntityRef e = m_instance_data_dirty[i];
+			updates[i].index[0] = e.index;
+			updates[i].data = getInstanceData(e);
+			m_instance_data_dirty_flags[e.index] = 0;
+		}
+		m_instance_data_dirty.clear();
+
+		struct {
+			u32 offset;
+			u32 count;
+		} ub_values = { offset / (u32)sizeof(Update), dirty_count };
+		const Renderer::TransientSlice ub = m_renderer.allocUniform(&ub_values, sizeof(ub_values));
+
+		DrawStream& stream = m_renderer.getDrawStream();
+		stream.useProgram(scatter_program);
+		stream.bindUniformBuffer(UniformBuffer::DRAWCALL, ub.buffer, ub.offset, ub.size);
+		stream.bindShaderBuffer(slice.buffer, 0, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(m_instance_data_buffer, 1, gpu::BindShaderBufferFlags::OUTPUT);
+		stream.dispatch((dirty_count + 63) / 64, 1, 1);
+		stream.memoryBarrier(gpu::MemoryBarrierType::SSBO, m_instance_data_buffer);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 0, gpu::BindShaderBufferFlags::NONE);
+		stream.bindShaderBuffer(gpu::INVALID_BUFFER, 1, gpu::BindShaderBufferFlags::NONE);
+		return true;
+	}
+
+	gpu::BufferHandle getInstanceDataBuffer() const override { return m_instance_data_buffer; }
+
 	ProceduralGeometry& getProceduralGeometry(EntityRef e) override {
 		return m_procedural_geometries[e];
 	}
@@ -1917,10 +2322,12 @@ struct RenderSceneImpl final : RenderScene {
 			if (!m_culling_system->isAdded(entity)) {
 				const RenderableTypes type = getRenderableType(*model_instance.model, model_instance.custom_material);
 				m_culling_system->add(entity, (u8)type, pos, radius);
+				shadowCasterChanged(entity);
 			}
 		}
 		else
 		{
+			shadowCasterChanged(entity);
 			m_culling_system->remove(entity);
 		}
 	}
@@ -1993,6 +2400,139 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
+	// attributes are float vectors, `attributes` is an array of their component counts
+	static int LUA_setProceduralGeometryDynamic(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		gpu::VertexDecl decl(gpu::PrimitiveType::TRIANGLES);
+		u8 offset = 0;
+		LuaWrapper::forEachArrayItem<u32>(L, 3, "array of component counts expected", [&](u32 components){
+			if (components == 0 || components > 4) luaL_argerror(L, 3, "component count must be 1 - 4");
+			decl.addAttribute(decl.attributes_count, offset, components, gpu::AttributeType::FLOAT, 0);
+			offset += u8(components * sizeof(float));
+		});
+		const u32 vertex_capacity = LuaWrapper::checkArg<u32>(L, 4);
+		const u32 index_capacity = LuaWrapper::checkArg<u32>(L, 5);
+		if (decl.attributes_count == 0 || vertex_capacity == 0) luaL_error(L, "empty vertex format or zero capacity");
+		scene->setProceduralGeometryDynamic(entity, decl, vertex_capacity, gpu::DataType::U32, index_capacity);
+		return 0;
+	}
+
+	// writes an array of floats to vertices starting at `first`, all components of a vertex in a row
+	static int LUA_writeProceduralGeometryVertices(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		const u32 first = LuaWrapper::checkArg<u32>(L, 3);
+		LuaWrapper::checkTableArg(L, 4);
+		const ProceduralGeometry* pg = scene->m_procedural_geometries.find(entity).isValid() ? &scene->m_procedural_geometries[entity] : nullptr;
+		if (!pg || !pg->dynamic) luaL_error(L, "entity does not have dynamic procedural geometry");
+
+		const u32 floats_count = (u32)lua_objlen(L, 4);
+		const u32 stride = pg->vertex_decl.getStride();
+		const u32 count = floats_count * sizeof(float) / stride;
+		if (count * stride != floats_count * sizeof(float)) luaL_error(L, "partial vertex");
+		if ((first + count) > pg->getVertexCount()) luaL_error(L, "out of range, call setProceduralGeometryCounts first");
+
+		float* dst = (float*)scene->writeProceduralGeometryVertices(entity, first, count).begin();
+		for (u32 i = 0; i < floats_count; ++i) {
+			lua_rawgeti(L, 4, i + 1);
+			dst[i] = (float)lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		return 0;
+	}
+
+	static int LUA_writeProceduralGeometryIndices(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		const u32 first = LuaWrapper::checkArg<u32>(L, 3);
+		LuaWrapper::checkTableArg(L, 4);
+		const ProceduralGeometry* pg = scene->m_procedural_geometries.find(entity).isValid() ? &scene->m_procedural_geometries[entity] : nullptr;
+		if (!pg || !pg->dynamic) luaL_error(L, "entity does not have dynamic procedural geometry");
+
+		const u32 count = (u32)lua_objlen(L, 4);
+		if ((first + count) > pg->getIndexCount()) luaL_error(L, "out of range, call setProceduralGeometryCounts first");
+
+		u32* dst = (u32*)scene->writeProceduralGeometryIndices(entity, first, count).begin();
+		for (u32 i = 0; i < count; ++i) {
+			lua_rawgeti(L, 4, i + 1);
+			dst[i] = (u32)lua_tointeger(L, -1);
+			lua_pop(L, 1);
+		}
+		return 0;
+	}
+
+	static int LUA_setProceduralGeometryCounts(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		const u32 vertex_count = LuaWrapper::checkArg<u32>(L, 3);
+		const u32 index_count = LuaWrapper::checkArg<u32>(L, 4);
+		auto iter = scene->m_procedural_geometries.find(entity);
+		if (!iter.isValid() || !iter.value().dynamic) luaL_error(L, "entity does not have dynamic procedural geometry");
+		const ProceduralGeometry& pg = iter.value();
+		if (vertex_count * pg.vertex_decl.getStride() > pg.dynamic->vertex_capacity || index_count * sizeof(u32) > pg.dynamic->index_capacity) {
+			luaL_error(L, "counts exceed capacity");
+		}
+		scene->setProceduralGeometryCounts(entity, vertex_count, index_count);
+		return 0;
+	}
+
+	// points are an array of x, z pairs in terrain space, returns an array of heights
+	static int LUA_getTerrainHeights(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		LuaWrapper::checkTableArg(L, 3);
+		if (!scene->m_terrains.find(entity).isValid()) luaL_argerror(L, 2, "entity does not have terrain");
+
+		Array<Vec2> points(scene->m_allocator);
+		if (!readTerrainPoints(L, 3, points)) luaL_argerror(L, 3, "array of x, z pairs expected");
+		Array<float> heights(scene->m_allocator);
+		heights.resize(points.size());
+		scene->getTerrainHeightsAt(entity, points, heights);
+
+		lua_createtable(L, heights.size(), 0);
+		for (u32 i = 0; i < heights.size(); ++i) {
+			lua_pushnumber(L, heights[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
+	// same as getTerrainHeights, returns an array of x, y, z triplets
+	static int LUA_getTerrainNormals(lua_State* L) {
+		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 2);
+		LuaWrapper::checkTableArg(L, 3);
+		if (!scene->m_terrains.find(entity).isValid()) luaL_argerror(L, 2, "entity does not have terrain");
+
+		Array<Vec2> points(scene->m_allocator);
+		if (!readTerrainPoints(L, 3, points)) luaL_argerror(L, 3, "array of x, z pairs expected");
+		Array<Vec3> normals(scene->m_allocator);
+		normals.resize(points.size());
+		scene->getTerrainNormalsAt(entity, points, normals);
+
+		lua_createtable(L, normals.size() * 3, 0);
+		for (u32 i = 0; i < normals.size(); ++i) {
+			for (u32 j = 0; j < 3; ++j) {
+				lua_pushnumber(L, (&normals[i].x)[j]);
+				lua_rawseti(L, -2, i * 3 + j + 1);
+			}
+		}
+		return 1;
+	}
+
+	static bool readTerrainPoints(lua_State* L, int idx, Array<Vec2>& points) {
+		const u32 floats_count = (u32)lua_objlen(L, idx);
+		if (floats_count % 2 != 0) return false;
+		points.resize(floats_count / 2);
+		for (u32 i = 0; i < floats_count; ++i) {
+			lua_rawgeti(L, idx, i + 1);
+			(&points[i / 2].x)[i % 2] = (float)lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		return true;
+	}
+
 	static int LUA_castCameraRay(lua_State* L)
 	{
 		auto* scene = LuaWrapper::checkArg<RenderSceneImpl*>(L, 1);
@@ -2067,7 +2607,6 @@ struct RenderSceneImpl final : RenderScene {
 	{
 		Terrain* terrain = m_terrains[entity];
 		terrain->setGrassTypeSpacing(index, spacing);
-		terrain->setGrassDirty();
 	}
 
 
@@ -2105,7 +2644,6 @@ struct RenderSceneImpl final : RenderScene {
 	{
 		Terrain* terrain = m_terrains[entity];
 		terrain->removeGrassType(index);
-		terrain->setGrassDirty();
 	}
 
 
@@ -2153,6 +2691,28 @@ struct RenderSceneImpl final : RenderScene {
 	}
 
 
+	void getRenderables(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) const override
+	{
+		m_culling_system->cull(frusta, results);
+	}
+
+
+	void setCullingStructure(CullingSystem::Structure structure) override
+	{
+		if (m_culling_system->getStructure() == structure) return;
+
+		UniquePtr<CullingSystem> culling_system = CullingSystem::create(m_allocator, m_engine.getPageAllocator(), structure);
+		m_culling_system->moveTo(*culling_system);
+		m_culling_system = culling_system.move();
+	}
+
+
+	CullingSystem::Structure getCullingStructure() const override
+	{
+		return m_culling_system->getStructure();
+	}
+
+
 	float getCameraScreenWidth(EntityRef camera) override { return m_cameras[camera].screen_width; }
 	float getCameraScreenHeight(EntityRef camera) override { return m_cameras[camera].screen_height; }
 
@@ -2498,11 +3058,34 @@ struct RenderSceneImpl final : RenderScene {
 		return hit;
 	}
 
+	void castRaysTerrain(Span<const RayCastQuery> rays, Span<RayCastModelHit> hits) override {
+		PROFILE_FUNCTION();
+		ASSERT(rays.length() == hits.length());
+		jobs::forEach(rays.length(), 16, [&](i32 from, i32 to){
+			PROFILE_BLOCK("cast terrain rays");
+			for (i32 i = from; i < to; ++i) {
+				hits[i] = castRayTerrain(rays[i].origin, rays[i].dir);
+			}
+		});
+	}
+
 	RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignored_model_instance) override {
 		return castRay(origin, dir, [&](const RayCastModelHit& hit) -> bool {
 			return hit.entity != ignored_model_instance || !ignored_model_instance.isValid();
 		});
 	}
+
+	void castRays(Span<const RayCastQuery> rays, Span<RayCastModelHit> hits) override {
+		PROFILE_FUNCTION();
+		ASSERT(rays.length() == hits.length());
+		jobs::forEach(rays.length(), 16, [&](i32 from, i32 to){
+			PROFILE_BLOCK("cast rays");
+			for (i32 i = from; i < to; ++i) {
+				const RayCastQuery& ray = rays[i];
+				hits[i] = castRay(ray.origin, ray.dir, ray.ignore);
+			}
+		});
+	}
 	
 	RayCastModelHit castRayInstancedModels(const DVec3& ray_origin, const Vec3& ray_dir, const RayCastModelHit::Filter& filter) override {
 		RayCastModelHit hit;
@@ -2796,6 +3379,7 @@ struct RenderSceneImpl final : RenderScene {
 		LUMIX_DELETE(m_allocator, r.pose);
 		r.pose = nullptr;
 
+		shadowCasterChanged(entity);
 		m_culling_system->remove(entity);
 	}
 
@@ -2812,6 +3396,7 @@ struct RenderSceneImpl final : RenderScene {
 		if(r.flags.isSet(ModelInstance::ENABLED)) {
 			const RenderableTypes type = getRenderableType(*model, r.custom_material);
 			m_culling_system->add(entity, (u8)type, pos, radius);
+			shadowCasterChanged(entity);
 		}
 		ASSERT(!r.pose);
 		if (model->getBoneCount() > 0)
@@ -3109,10 +3694,11 @@ struct RenderSceneImpl final : RenderScene {
 	}
 	
 	void destroyProceduralGeometry(EntityRef entity) {
-		const ProceduralGeometry& pg = m_procedural_geometries[entity];
+		ProceduralGeometry& pg = m_procedural_geometries[entity];
 		if (pg.material) pg.material->decRefCount();
 		if (pg.vertex_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.vertex_buffer);
 		if (pg.index_buffer) m_renderer.getEndFrameDrawStream().destroy(pg.index_buffer);
+		destroyDynamic(pg);
 		m_procedural_geometries.erase(entity);
 		m_universe.onComponentDestroyed(entity, PROCEDURAL_GEOM_TYPE, this);
 	}
@@ -3174,6 +3760,7 @@ struct RenderSceneImpl final : RenderScene {
 		r.flags.set(ModelInstance::VALID);
 		r.flags.set(ModelInstance::ENABLED);
 		r.mesh_count = 0;
+		markInstanceDataDirty(entity);
 		m_universe.onComponentCreated(entity, MODEL_INSTANCE_TYPE, this);
 	}
 
@@ -3208,19 +3795,26 @@ struct RenderSceneImpl final : RenderScene {
 
 	EntityPtr m_active_global_light_entity;
 	HashMap<EntityRef, PointLight> m_point_lights;
-	HashMap<EntityRef, Decal> m_decals;
-	HashMap<EntityRef, CurveDecal> m_curve_decals;
+	FlatHashMap<EntityRef, Decal> m_decals;
+	FlatHashMap<EntityRef, CurveDecal> m_curve_decals;
 	Array<ModelInstance> m_model_instances;
 	HashMap<EntityRef, InstancedModel> m_instanced_models;
 	HashMap<EntityRef, Environment> m_environments;
-	HashMap<EntityRef, Camera> m_cameras;
+	FlatHashMap<EntityRef, Camera> m_cameras;
 	EntityPtr m_active_camera = INVALID_ENTITY;
 	AssociativeArray<EntityRef, BoneAttachment> m_bone_attachments;
 	AssociativeArray<EntityRef, EnvironmentProbe> m_environment_probes;
 	AssociativeArray<EntityRef, ReflectionProbe> m_reflection_probes;
 	HashMap<EntityRef, ProceduralGeometry> m_procedural_geometries;
+	u32 m_procedural_geometries_upload_frame = 0xffFFffFF;
+	gpu::BufferHandle m_instance_data_buffer = gpu::INVALID_BUFFER;
+	u32 m_instance_data_capacity = 0;
+	// entities with model instances moved or created since the last upload
+	Array<EntityRef> m_instance_data_dirty;
+	Array<u8> m_instance_data_dirty_flags;
 	HashMap<EntityRef, Terrain*> m_terrains;
 	HashMap<EntityRef, ParticleEmitter> m_particle_emitters;
+	u32 m_particle_budget = 0;
 	gpu::TextureHandle m_reflection_probes_texture = gpu::INVALID_TEXTURE;
 
 	Array<DebugTriangle> m_debug_triangles;
@@ -3229,6 +3823,13 @@ struct RenderSceneImpl final : RenderScene {
 
 	bool m_is_updating_attachments;
 	bool m_is_game_running;
+	// scratch for onEntitiesMoved
+	Array<EntityRef> m_moved_entities;
+	Array<DVec3> m_moved_positions;
+	Array<float> m_moved_radii;
+	Array<ShadowCasterChange> m_shadow_caster_changes;
+	u64 m_first_shadow_caster_change = 0;
+	u32 m_shadow_caster_changes_prev_count = 0;
 
 	HashMap<Model*, EntityRef> m_model_entity_map;
 	HashMap<Material*, EntityRef> m_material_decal_map;
@@ -3328,6 +3929,7 @@ void RenderScene::reflect() {
 		.LUMIX_FUNC(RenderScene::addDebugLine)
 		.LUMIX_FUNC(RenderScene::addDebugTriangle)
 		.LUMIX_FUNC(RenderScene::setActiveCamera)
+		.LUMIX_FUNC(RenderScene::setParticleBudget)
 		.LUMIX_CMP(ProceduralGeometry, "procedural_geom", "Render / Procedural geometry")
 			.LUMIX_PROP(ProceduralGeometryMaterial, "Material").resourceAttribute(Material::TYPE)
 		.LUMIX_CMP(BoneAttachment, "bone_attachment", "Render / Bone attachment")
@@ -3402,6 +4004,9 @@ void RenderScene::reflect() {
 			.LUMIX_PROP(TerrainYScale, "Height scale").minAttribute(0)
 			.LUMIX_PROP(TerrainTesselation, "Tesselation").minAttribute(1)
 			.LUMIX_PROP(TerrainBaseGridResolution, "Grid resolution").minAttribute(8)
+			.LUMIX_PROP(TerrainTilesCount, "Streamed tiles")
+			.LUMIX_PROP(TerrainTileStreamDistance, "Tile stream distance").minAttribute(0)
+			.LUMIX_PROP(TerrainVirtualTexturing, "Virtual texturing")
 			.begin_array<&RenderScene::getGrassCount, &RenderScene::addGrass, &RenderScene::removeGrass>("grass")
 				.LUMIX_PROP(GrassPath, "Mesh").resourceAttribute(Model::TYPE)
 				.LUMIX_PROP(GrassDistance, "Distance").minAttribute(1)
@@ -3442,9 +4047,15 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_material_decal_map(m_allocator)
 	, m_material_curve_decal_map(m_allocator)
 	, m_furs(m_allocator)
+	, m_moved_entities(m_allocator)
+	, m_moved_positions(m_allocator)
+	, m_moved_radii(m_allocator)
+	, m_shadow_caster_changes(m_allocator)
+	, m_instance_data_dirty(m_allocator)
+	, m_instance_data_dirty_flags(m_allocator)
 {
 
-	m_universe.entityTransformed().bind<&RenderSceneImpl::onEntityMoved>(this);
+	m_universe.entitiesTransformed().bind<&RenderSceneImpl::onEntitiesMoved>(this);
 	m_universe.entityDestroyed().bind<&RenderSceneImpl::onEntityDestroyed>(this);
 	m_culling_system = CullingSystem::create(m_allocator, engine.getPageAllocator());
 	m_model_instances.reserve(5000);
@@ -3492,9 +4103,19 @@ void RenderScene::registerLuaAPI(lua_State* L, Renderer& renderer)
 	REGISTER_FUNCTION(getModelBoneIndex);
 
 	LuaWrapper::createSystemFunction(L, "Renderer", "castCameraRay", &RenderSceneImpl::LUA_castCameraRay);
+	LuaWrapper::createSystemFunction(L, "Renderer", "getTerrainHeights", &RenderSceneImpl::LUA_getTerrainHeights);
+	LuaWrapper::createSystemFunction(L, "Renderer", "getTerrainNormals", &RenderSceneImpl::LUA_getTerrainNormals);
+	LuaWrapper::createSystemFunction(L, "Renderer", "setProceduralGeometryDynamic", &RenderSceneImpl::LUA_setProceduralGeometryDynamic);
+	LuaWrapper::createSystemFunction(L, "Renderer", "setProceduralGeometryCounts", &RenderSceneImpl::LUA_setProceduralGeometryCounts);
+	LuaWrapper::createSystemFunction(L, "Renderer", "writeProceduralGeometryVertices", &RenderSceneImpl::LUA_writeProceduralGeometryVertices);
+	LuaWrapper::createSystemFunction(L, "Renderer", "writeProceduralGeometryIndices", &RenderSceneImpl::LUA_writeProceduralGeometryIndices);
 
 	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "setLODMultiplier", &LuaWrapper::wrapMethodClosure<&Renderer::setLODMultiplier>);
 	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "getLODMultiplier", &LuaWrapper::wrapMethodClosure<&Renderer::getLODMultiplier>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "setCPUOcclusionCulling", &LuaWrapper::wrapMethodClosure<&Renderer::setCPUOcclusionCulling>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "isCPUOcclusionCulling", &LuaWrapper::wrapMethodClosure<&Renderer::isCPUOcclusionCulling>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "setFramesInFlight", &LuaWrapper::wrapMethodClosure<&Renderer::setFramesInFlight>);
+	LuaWrapper::createSystemClosure(L, "Renderer", &renderer, "getFramesInFlight", &LuaWrapper::wrapMethodClosure<&Renderer::getFramesInFlight>);
 
 	#undef REGISTER_FUNCTION
 }
@@ -10,6 +10,7 @@
 #include "engine/plugin.h"
 #include "engine/stream.h"
 #include "gpu/gpu.h"
+#include "renderer/culling_system.h"
 
 
 struct lua_State;
@@ -40,6 +41,35 @@ template <typename T> struct Array;
 template <typename T> struct Delegate;
 template <typename T, typename T2> struct AssociativeArray;
 
+// persistently mapped storage of dynamic procedural geometry, it has a region for each frame in flight
+// changes are made in ProceduralGeometry::vertex_data and index_data, only ranges changed since a region
+// was last used are copied to it
+struct ProceduralGeometryDynamic {
+	static constexpr u32 REGIONS_COUNT = 3;
+
+	struct Range {
+		void add(u32 from, u32 to) { begin = minimum(begin, from); end = maximum(end, to); }
+		u32 begin = 0xffFFffFF;
+		u32 end = 0;
+	};
+
+	gpu::BufferHandle buffer = gpu::INVALID_BUFFER;
+	// mapped on the render thread, null until then
+	u8* volatile ptr = nullptr;
+	// in bytes
+	u32 vertex_capacity = 0;
+	u32 index_capacity = 0;
+	// of indices in a region
+	u32 index_offset = 0;
+	u32 region_size = 0;
+	// region used by the current frame
+	u32 region = 0;
+	u32 uploaded_frame = 0xffFFffFF;
+	Range dirty_vertices[REGIONS_COUNT];
+	Range dirty_indices[REGIONS_COUNT];
+	bool aabb_dirty = false;
+};
+
 struct ProceduralGeometry {
 	ProceduralGeometry(IAllocator& allocator) 
 		: vertex_data(allocator)
@@ -54,12 +84,20 @@ struct ProceduralGeometry {
 	gpu::DataType index_type;
 	gpu::BufferHandle vertex_buffer = gpu::INVALID_BUFFER;
 	gpu::BufferHandle index_buffer = gpu::INVALID_BUFFER;
+	// not null if the geometry is dynamic, buffers above are not used then
+	ProceduralGeometryDynamic* dynamic = nullptr;
 	AABB aabb;
 	
 	u32 getVertexCount() const;
 	u32 getIndexCount() const;
 };
 
+struct RayCastQuery {
+	DVec3 origin;
+	Vec3 dir;
+	EntityPtr ignore = INVALID_ENTITY;
+};
+
 struct Camera
 {
 	EntityRef entity;
@@ -173,6 +211,8 @@ struct ModelInstance
 	EntityPtr next_model = INVALID_ENTITY;
 	EntityPtr prev_model = INVALID_ENTITY;
 	float lod = 4;
+	// renderer's frame number when the instance was last drawn in any view, skinned instances only
+	u32 visible_frame = 0;
 	FlagSet<Flags, u8> flags;
 	u16 mesh_count;
 };
@@ -277,6 +317,8 @@ enum class RenderSceneVersion : i32 {
 	PROCEDURAL_GEOMETRY_INDEX_BUFFER,
 	TESSELATED_TERRAIN,
 	REMOVED_SPLINE_GEOMETRY,
+	TERRAIN_TILES,
+	TERRAIN_VIRTUAL_TEXTURING,
 
 	LATEST
 };
@@ -292,7 +334,11 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 
 	virtual RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, const Delegate<bool (const RayCastModelHit&)> filter) = 0;
 	virtual RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignore) = 0;
+	// casts rays in parallel on job workers, hits[i] is the result of rays[i]; scene must not be modified until it returns
+	virtual void castRays(Span<const RayCastQuery> rays, Span<RayCastModelHit> hits) = 0;
 	virtual RayCastModelHit castRayTerrain(const DVec3& origin, const Vec3& dir) = 0;
+	// RayCastQuery::ignore is not used
+	virtual void castRaysTerrain(Span<const RayCastQuery> rays, Span<RayCastModelHit> hits) = 0;
 	virtual RayCastModelHit castRayInstancedModels(const DVec3& ray_origin, const Vec3& ray_dir, const Delegate<bool (const RayCastModelHit&)>& filter) = 0;
 	virtual void getRay(EntityRef entity, const Vec2& screen_pos, DVec3& origin, Vec3& dir) = 0;
 
@@ -350,6 +396,9 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual void setParticleEmitterPath(EntityRef entity, const Path& path) = 0;
 	virtual Path getParticleEmitterPath(EntityRef entity) = 0;
 	virtual void updateParticleEmitter(EntityRef entity, float dt) = 0;
+	// emitters farther from active camera stop emitting once there are `count` particles, 0 - unlimited
+	virtual void setParticleBudget(u32 count) = 0;
+	virtual u32 getParticleBudget() const = 0;
 	virtual const HashMap<EntityRef, struct ParticleEmitter>& getParticleEmitters() const = 0;
 	virtual ParticleEmitter& getParticleEmitter(EntityRef e) = 0;
 
@@ -372,6 +421,11 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual Path getModelInstanceMaterialOverride(EntityRef entity) = 0;
 	virtual CullResult* getRenderables(const ShiftedFrustum& frustum, RenderableTypes type) const = 0;
 	virtual CullResult* getRenderables(const ShiftedFrustum& frustum) const = 0;
+	// culls with several frusta in one traversal, see CullingSystem::MAX_CULL_FRUSTA
+	virtual void getRenderables(Span<const ShiftedFrustum> frusta, Span<CullResult*> results) const = 0;
+	// GRID by default, switching moves all renderables to the new structure
+	virtual void setCullingStructure(CullingSystem::Structure structure) = 0;
+	virtual CullingSystem::Structure getCullingStructure() const = 0;
 	virtual EntityPtr getFirstModelInstance() = 0;
 	virtual EntityPtr getNextModelInstance(EntityPtr entity) = 0;
 	virtual Model* getModelInstanceModel(EntityRef entity) = 0;
@@ -398,6 +452,8 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual const HashMap<EntityRef, Terrain*>& getTerrains() = 0;
 	virtual float getTerrainHeightAt(EntityRef entity, float x, float z) = 0;
 	virtual Vec3 getTerrainNormalAt(EntityRef entity, float x, float z) = 0;
+	virtual void getTerrainHeightsAt(EntityRef entity, Span<const Vec2> points, Span<float> heights) = 0;
+	virtual void getTerrainNormalsAt(EntityRef entity, Span<const Vec2> points, Span<Vec3> normals) = 0;
 	virtual void setTerrainMaterialPath(EntityRef entity, const Path& path) = 0;
 	virtual Path getTerrainMaterialPath(EntityRef entity) = 0;
 	virtual Material* getTerrainMaterial(EntityRef entity) = 0;
@@ -407,6 +463,12 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual u32 getTerrainTesselation(EntityRef entity) = 0;
 	virtual void setTerrainBaseGridResolution(EntityRef entity, u32 value) = 0;
 	virtual u32 getTerrainBaseGridResolution(EntityRef entity) = 0;
+	virtual void setTerrainTilesCount(EntityRef entity, u32 value) = 0;
+	virtual u32 getTerrainTilesCount(EntityRef entity) = 0;
+	virtual void setTerrainTileStreamDistance(EntityRef entity, float value) = 0;
+	virtual float getTerrainTileStreamDistance(EntityRef entity) = 0;
+	virtual void setTerrainVirtualTexturing(EntityRef entity, bool enable) = 0;
+	virtual bool getTerrainVirtualTexturing(EntityRef entity) = 0;
 	virtual void setTerrainYScale(EntityRef entity, float scale) = 0;
 	virtual float getTerrainYScale(EntityRef entity) = 0;
 	virtual Vec2 getTerrainSize(EntityRef entity) = 0;
@@ -436,10 +498,37 @@ struct LUMIX_RENDERER_API RenderScene : IScene
 	virtual Path getProceduralGeometryMaterial(EntityRef entity) = 0;
 	virtual const HashMap<EntityRef, ProceduralGeometry>& getProceduralGeometries() = 0;
 	virtual ProceduralGeometry& getProceduralGeometry(EntityRef e) = 0;
+	// capacities are in vertices and indices, GPU storage is allocated once and content is changed
+	// without reallocation by the functions below, use for geometry changing every frame
+	virtual void setProceduralGeometryDynamic(EntityRef entity
+		, const gpu::VertexDecl& vertex_decl
+		, u32 vertex_capacity
+		, gpu::DataType index_type
+		, u32 index_capacity) = 0;
+	// number of vertices and indices drawn, must fit in the capacity
+	virtual void setProceduralGeometryCounts(EntityRef entity, u32 vertex_count, u32 index_count) = 0;
+	// returns memory of vertices [first, first + count) to be written, it's uploaded before the next render
+	virtual Span<u8> writeProceduralGeometryVertices(EntityRef entity, u32 first, u32 count) = 0;
+	virtual Span<u8> writeProceduralGeometryIndices(EntityRef entity, u32 first, u32 count) = 0;
+	// copies changed ranges of dynamic geometries to GPU, called by pipelines, does the work once per frame
+	virtual void uploadProceduralGeometries() = 0;
+	// transforms of model instances in a persistent GPU buffer indexed by entity, layout is in pipelines/instance_data.shd
+	// entries changed since the last call are scattered by scatter_program, called by pipelines before rendering
+	// returns false if the buffer is not up to date, e.g. because scatter_program is not ready yet
+	virtual bool uploadInstanceData(gpu::ProgramHandle scatter_program) = 0;
+	virtual gpu::BufferHandle getInstanceDataBuffer() const = 0;
 
 	virtual bool getEnvironmentCastShadows(EntityRef entity) = 0;
 	virtual void setEnvironmentCastShadows(EntityRef entity, bool enable) = 0;
 	virtual Environment& getEnvironment(EntityRef entity) = 0;
+	// bounding sphere of a model instance which moved, appeared or disappeared, used to invalidate cached shadows
+	struct ShadowCasterChange {
+		DVec3 pos;
+		float radius;
+	};
+	// changes from the last two updates, first_idx is the absolute index of the first returned change
+	virtual Span<const ShadowCasterChange> getShadowCasterChanges(u64& first_idx) = 0;
+
 	virtual const HashMap<EntityRef, PointLight>& getPointLights() = 0;
 	virtual PointLight& getPointLight(EntityRef entity) = 0;
 	virtual float getLightRange(EntityRef entity) = 0;
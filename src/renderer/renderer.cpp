@@ -6,10 +6,13 @@
 #include "engine/command_line_parser.h"
 #include "engine/debug.h"
 #include "engine/engine.h"
+#include "engine/file_system.h"
 #include "engine/hash.h"
 #include "engine/log.h"
 #include "engine/job_system.h"
 #include "engine/page_allocator.h"
+#include "engine/path.h"
+#include "engine/stream.h"
 #include "engine/sync.h"
 #include "engine/thread.h"
 #include "engine/os.h"
@@ -36,18 +39,49 @@ namespace Lumix {
 static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("model_instance");
 
 
+void SortKeyState::set(const Mesh& mesh) {
+	material = mesh.material;
+	shader = material->getShader();
+	bind_group = material->m_bind_group;
+	render_states = material->m_render_states;
+	define_mask = material->getDefineMask();
+	vertex_buffer = mesh.vertex_buffer_handle;
+	index_buffer = mesh.index_buffer_handle;
+	quantization_buffer = mesh.quantization_buffer;
+	meshlet_buffer = mesh.meshlet_buffer;
+	meshlets_count = mesh.meshlets.size();
+	vb_stride = mesh.vb_stride;
+	indices_count = mesh.indices_count;
+	index_type = mesh.index_type;
+	layer = mesh.layer;
+	lod = mesh.lod;
+	programs_count = 0;
+}
+
+
+// each frame in flight has its own persistently mapped region, it's reused once the frame's fence is signaled
+// size follows the high-water mark of previous frames, overflow is only a fallback for sudden spikes
 template <u32 ALIGN>
 struct TransientBuffer {
 	static constexpr u32 INIT_SIZE = 1024 * 1024;
 	static constexpr u32 OVERFLOW_BUFFER_SIZE = 512 * 1024 * 1024;
+	// high-water mark loses 1/HIGH_WATER_DECAY of itself every frame
+	static constexpr u32 HIGH_WATER_DECAY = 64;
 	
-	void init(gpu::BufferFlags flags) {
+	// counters are shared by all frames
+	void init(gpu::BufferFlags flags, u32 bytes_counter, u32 overflows_counter) {
 		m_flags = flags;
-		m_buffer = gpu::allocBufferHandle();
 		m_offset = 0;
-		gpu::createBuffer(m_buffer, gpu::BufferFlags::MAPPABLE | flags, INIT_SIZE, nullptr);
-		m_size = INIT_SIZE;
-		m_ptr = (u8*)gpu::map(m_buffer, INIT_SIZE);
+		createBuffer(INIT_SIZE);
+		m_bytes_counter = bytes_counter;
+		m_overflows_counter = overflows_counter;
+	}
+
+	void createBuffer(u32 size) {
+		m_buffer = gpu::allocBufferHandle();
+		gpu::createBuffer(m_buffer, gpu::BufferFlags::MAPPABLE | m_flags, size, nullptr);
+		m_size = size;
+		m_ptr = (u8*)gpu::map(m_buffer, size);
 	}
 
 	Renderer::TransientSlice alloc(u32 size) {
@@ -81,33 +115,39 @@ struct TransientBuffer {
 	} 
 
 	void prepareToRender() {
-		gpu::unmap(m_buffer);
-		m_ptr = nullptr;
+		const u32 used = minimum((u32)m_offset, m_size) + m_overflow.size;
+		m_high_water = maximum(used, m_high_water - m_high_water / HIGH_WATER_DECAY);
+		profiler::pushCounter(m_bytes_counter, float(used / 1024.0));
 
+		profiler::pushCounter(m_overflows_counter, m_overflow.buffer ? 1.f : 0.f);
 		if (m_overflow.buffer) {
 			gpu::createBuffer(m_overflow.buffer, gpu::BufferFlags::MAPPABLE | m_flags, nextPow2(m_overflow.size + m_size), nullptr);
 			void* mem = gpu::map(m_overflow.buffer, m_overflow.size + m_size);
-			if (mem) {
-				memcpy(mem, m_overflow.data, m_overflow.size);
-				gpu::unmap(m_overflow.buffer);
-			}
+			if (mem) memcpy(mem, m_overflow.data, m_overflow.size);
 			os::memRelease(m_overflow.data, OVERFLOW_BUFFER_SIZE);
 			m_overflow.data = nullptr;
 			m_overflow.commit = 0;
 		}
 	}
 
+	// GPU does not use the buffer anymore, so it can be replaced
 	void renderDone() {
 		if (m_overflow.buffer) {
-			m_size = nextPow2(m_overflow.size + m_size);
 			gpu::destroy(m_buffer);
+			m_size = nextPow2(m_overflow.size + m_size);
 			m_buffer = m_overflow.buffer;
+			m_ptr = (u8*)gpu::map(m_buffer, m_size);
 			m_overflow.buffer = gpu::INVALID_BUFFER;
 			m_overflow.size = 0;
 		}
-
-		ASSERT(!m_ptr);
-		m_ptr = (u8*)gpu::map(m_buffer, m_size);
+		else {
+			// 50% headroom, shrink only when the buffer is more than twice as big as needed
+			const u32 wanted = maximum(INIT_SIZE, nextPow2(m_high_water + m_high_water / 2));
+			if (wanted > m_size || wanted < m_size / 2) {
+				gpu::destroy(m_buffer);
+				createBuffer(wanted);
+			}
+		}
 		m_offset = 0;
 	}
 
@@ -117,6 +157,9 @@ struct TransientBuffer {
 	u8* m_ptr = nullptr;
 	jobs::Mutex m_mutex;
 	gpu::BufferFlags m_flags = gpu::BufferFlags::NONE;
+	u32 m_high_water = 0;
+	u32 m_bytes_counter;
+	u32 m_overflows_counter;
 
 	struct {
 		gpu::BufferHandle buffer = gpu::INVALID_BUFFER;
@@ -192,11 +235,29 @@ struct GPUProfiler
 		bool is_frame;
 	};
 
+	// GPU time of all blocks with the same name and depth in a frame
+	struct PassTiming {
+		StaticString<32> name;
+		u32 depth;
+		float history[Renderer::GPUPassStats::HISTORY_SIZE];
+		u32 history_count = 0;
+		u32 history_head = 0;
+		float current = 0;
+		bool touched = false;
+	};
+
+	struct OpenBlock {
+		u32 pass;
+		u64 begin;
+	};
+
 
 	GPUProfiler(IAllocator& allocator) 
 		: m_queries(allocator)
 		, m_pool(allocator)
 		, m_stats_pool(allocator)
+		, m_passes(allocator)
+		, m_open_blocks(allocator)
 		, m_gpu_to_cpu_offset(0)
 	{
 	}
@@ -340,10 +401,12 @@ struct GPUProfiler
 					m_stats_pool.push(q.stats);
 				}
 				profiler::endGPUBlock(timestamp);
+				endPassTiming(timestamp);
 			}
 			else {
 				const u64 timestamp = toCPUTimestamp(gpu::getQueryResult(q.handle));
 				profiler::beginGPUBlock(q.name, timestamp, q.profiler_link);
+				beginPassTiming(q.name, timestamp);
 			}
 			m_pool.push(q.handle);
 			m_queries.erase(0);
@@ -351,9 +414,71 @@ struct GPUProfiler
 	}
 
 
+	void beginPassTiming(const char* name, u64 timestamp) {
+		const u32 depth = m_open_blocks.size();
+		u32 pass_idx = 0;
+		while (pass_idx < (u32)m_passes.size()) {
+			const PassTiming& p = m_passes[pass_idx];
+			if (p.depth == depth && equalStrings(p.name, name)) break;
+			++pass_idx;
+		}
+		if (pass_idx == (u32)m_passes.size()) {
+			PassTiming& p = m_passes.emplace();
+			p.name = name;
+			p.depth = depth;
+		}
+		m_open_blocks.push({pass_idx, timestamp});
+	}
+
+	void endPassTiming(u64 timestamp) {
+		if (m_open_blocks.empty()) return;
+
+		const OpenBlock block = m_open_blocks.back();
+		m_open_blocks.pop();
+		PassTiming& pass = m_passes[block.pass];
+		pass.current += float(double(timestamp - block.begin) / os::Timer::getFrequency() * 1000);
+		pass.touched = true;
+
+		// whole GPU frame is resolved, move its timings to history
+		if (m_open_blocks.empty() && equalStrings(pass.name, "frame")) {
+			for (PassTiming& p : m_passes) {
+				if (!p.touched) continue;
+				p.history[p.history_head] = p.current;
+				p.history_head = (p.history_head + 1) % lengthOf(p.history);
+				p.history_count = minimum(p.history_count + 1, (u32)lengthOf(p.history));
+				p.current = 0;
+				p.touched = false;
+			}
+		}
+	}
+
+	void getPassStats(Array<Renderer::GPUPassStats>& stats) {
+		jobs::MutexGuard lock(m_mutex);
+		stats.clear();
+		for (const PassTiming& p : m_passes) {
+			if (p.history_count == 0) continue;
+
+			Renderer::GPUPassStats& s = stats.emplace();
+			copyString(s.name, p.name);
+			s.depth = p.depth;
+			s.last_ms = p.history[(p.history_head + lengthOf(p.history) - 1) % lengthOf(p.history)];
+			s.max_ms = 0;
+			float sum = 0;
+			for (u32 i = 0; i < p.history_count; ++i) {
+				const u32 idx = (p.history_head + lengthOf(p.history) - 1 - i) % lengthOf(p.history);
+				sum += p.history[idx];
+				s.max_ms = maximum(s.max_ms, p.history[idx]);
+			}
+			s.avg_ms = sum / p.history_count;
+		}
+	}
+
+
 	Array<Query> m_queries;
 	Array<gpu::QueryHandle> m_pool;
 	Array<gpu::QueryHandle> m_stats_pool;
+	Array<PassTiming> m_passes;
+	Array<OpenBlock> m_open_blocks;
 	jobs::Mutex m_mutex;
 	i64 m_gpu_to_cpu_offset;
 	u32 m_stats_counter = 0;
@@ -365,7 +490,7 @@ struct RendererImpl final : Renderer
 {
 	explicit RendererImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_allocator(engine.getAllocator(), "renderer")
 		, m_texture_manager(*this, m_allocator)
 		, m_pipeline_manager(*this, m_allocator)
 		, m_model_manager(*this, m_allocator)
@@ -378,8 +503,16 @@ struct RendererImpl final : Renderer
 		, m_layers(m_allocator)
 		, m_material_buffer(m_allocator)
 		, m_plugins(m_allocator)
+		, m_shader_usage(m_allocator)
+		, m_shader_warmup(m_allocator)
+		, m_shader_reloads(m_allocator)
+		, m_streamed_textures(m_allocator)
+		, m_streamed_models(m_allocator)
+		, m_uploads(m_allocator)
 		, m_free_sort_keys(m_allocator)
 		, m_sort_key_to_mesh_map(m_allocator)
+		, m_sort_key_states(m_allocator)
+		, m_sort_key_program_requests(m_allocator)
 	{
 		RenderScene::reflect();
 
@@ -390,13 +523,19 @@ struct RendererImpl final : Renderer
 		m_shader_defines.reserve(32);
 
 		gpu::preinit(m_allocator, shouldLoadRenderdoc());
-		m_frames[0].create(*this, m_allocator, m_engine.getPageAllocator());
-		m_frames[1].create(*this, m_allocator, m_engine.getPageAllocator());
-		m_frames[2].create(*this, m_allocator, m_engine.getPageAllocator());
+		for (Local<FrameData>& frame : m_frames) {
+			frame.create(*this, m_allocator, m_engine.getPageAllocator());
+		}
 	}
 
 	float getLODMultiplier() const override { return m_lod_multiplier; }
 	void setLODMultiplier(float value) override { m_lod_multiplier = maximum(0.f, value); }
+	void setCPUOcclusionCulling(bool enable) override { m_cpu_occlusion_culling = enable; }
+	bool isCPUOcclusionCulling() const override { return m_cpu_occlusion_culling; }
+	void setFramesInFlight(u32 count) override { m_requested_frames_in_flight = clamp(count, 1u, MAX_FRAMES_IN_FLIGHT); }
+	u32 getFramesInFlight() const override { return m_requested_frames_in_flight; }
+	void setLatencyMode(LatencyMode mode) override { m_latency_mode = mode; }
+	LatencyMode getLatencyMode() const override { return m_latency_mode; }
 
 	u32 getVersion() const override { return 0; }
 	void serialize(OutputMemoryStream& stream) const override {}
@@ -404,32 +543,58 @@ struct RendererImpl final : Renderer
 
 	~RendererImpl()
 	{
+		if (m_program_cache_op.isValid()) m_engine.getFileSystem().cancel(m_program_cache_op);
+		for (ShaderWarmup& warmup : m_shader_warmup) warmup.shader->decRefCount();
+		m_shader_warmup.clear();
+
 		m_particle_emitter_manager.destroy();
 		m_pipeline_manager.destroy();
 		m_texture_manager.destroy();
+		m_streamed_textures.clear();
 		m_model_manager.destroy();
 		m_material_manager.destroy();
 		m_shader_manager.destroy();
 		m_font_manager->destroy();
 		LUMIX_DELETE(m_allocator, m_font_manager);
 
-		frame();
-		frame();
-		frame();
+		for (u32 i = 0; i < m_frames_in_flight; ++i) frame();
 
 		waitForRender();
 		
+		OutputMemoryStream program_cache(m_allocator);
+		bool save_program_cache = false;
 		jobs::Signal signal;
-		jobs::runLambda([this]() {
+		jobs::runLambda([&]() {
 			for (const Local<FrameData>& frame : m_frames) {
 				gpu::destroy(frame->transient_buffer.m_buffer);
 				gpu::destroy(frame->uniform_buffer.m_buffer);
 			}
-			gpu::destroy(m_material_buffer.buffer);
+			for (gpu::BufferHandle page : m_material_buffer.pages) gpu::destroy(page);
 			m_profiler.clear();
+			save_program_cache = gpu::saveProgramCache(program_cache);
 			gpu::shutdown();
 		}, &signal, 1);
 		jobs::wait(&signal);
+		if (save_program_cache) saveProgramCache(program_cache);
+	}
+
+	void programCacheLoaded(u64 size, const u8* mem, bool success) {
+		m_program_cache_op = FileSystem::AsyncHandle::invalid();
+		if (!success) return;
+		gpu::loadProgramCache(Span(mem, (u32)size));
+	}
+
+	void saveProgramCache(const OutputMemoryStream& blob) {
+		FileSystem& fs = m_engine.getFileSystem();
+		os::OutputFile file;
+		if (!fs.open(PROGRAM_CACHE_PATH, file)) {
+			logWarning("Could not save ", PROGRAM_CACHE_PATH);
+			return;
+		}
+		if (!file.write(blob.data(), blob.size())) {
+			logWarning("Could not write ", PROGRAM_CACHE_PATH);
+		}
+		file.close();
 	}
 
 	static bool shouldLoadRenderdoc() {
@@ -451,12 +616,23 @@ struct RendererImpl final : Renderer
 		os::getCommandLine(Span(cmd_line));
 		CommandLineParser cmd_line_parser(cmd_line);
 		while (cmd_line_parser.next()) {
-			if (cmd_line_parser.currentEquals("-no_vsync")) {
+			// dedicated server (-server in app) does not present anything, so it must not wait for vsync
+			if (cmd_line_parser.currentEquals("-no_vsync") || cmd_line_parser.currentEquals("-server")) {
 				flags = flags & ~gpu::InitFlags::VSYNC;
 			}
 			else if (cmd_line_parser.currentEquals("-debug_opengl")) {
 				flags = flags | gpu::InitFlags::DEBUG_OUTPUT;
 			}
+			else if (cmd_line_parser.currentEquals("-no_texture_streaming")) {
+				m_texture_streaming_budget = 0;
+			}
+			else if (cmd_line_parser.currentEquals("-texture_budget")) {
+				if (!cmd_line_parser.next()) break;
+				char tmp[32];
+				cmd_line_parser.getCurrent(tmp, lengthOf(tmp));
+				u64 mb;
+				if (fromCString(Span(tmp, stringLength(tmp)), mb)) m_texture_streaming_budget = mb * 1024 * 1024;
+			}
 		}
 
 		jobs::Signal signal;
@@ -475,9 +651,13 @@ struct RendererImpl final : Renderer
 					"dedicated: ", (mem_stats.dedicated_vidmem/ (1024.f * 1024.f)), "MB\n");
 			}
 
+			const u32 transient_counter = profiler::createCounter("Transient buffer (KB)", 0);
+			const u32 transient_overflow_counter = profiler::createCounter("Transient buffer overflow", 0);
+			const u32 uniform_counter = profiler::createCounter("Uniform buffer (KB)", 0);
+			const u32 uniform_overflow_counter = profiler::createCounter("Uniform buffer overflow", 0);
 			for (const Local<FrameData>& frame : m_frames) {
-				frame->transient_buffer.init(gpu::BufferFlags::NONE);
-				frame->uniform_buffer.init(gpu::BufferFlags::UNIFORM_BUFFER);
+				frame->transient_buffer.init(gpu::BufferFlags::NONE, transient_counter, transient_overflow_counter);
+				frame->uniform_buffer.init(gpu::BufferFlags::UNIFORM_BUFFER, uniform_counter, uniform_overflow_counter);
 			}
 			m_profiler.init();
 		}, &signal, 1);
@@ -486,29 +666,19 @@ struct RendererImpl final : Renderer
 		m_cpu_frame = m_frames[0].get();
 		m_gpu_frame = m_frames[0].get();
 
+		// programs queued before the cache is loaded are compiled from sources
+		FileSystem& fs = m_engine.getFileSystem();
+		m_program_cache_op = fs.getContent(Path(PROGRAM_CACHE_PATH), makeDelegate<&RendererImpl::programCacheLoaded>(this), FileSystem::Priority::HIGH);
+
 		MaterialBuffer& mb = m_material_buffer;
-		const u32 MAX_MATERIAL_CONSTS_COUNT = 400;
-		mb.buffer = gpu::allocBufferHandle();
+		addMaterialBufferPage();
 		mb.map.insert(RuntimeHash(), 0);
-		mb.data.resize(MAX_MATERIAL_CONSTS_COUNT);
+		mb.first_free = mb.data[0].next_free;
 		mb.data[0].hash = RuntimeHash();
 		mb.data[0].ref_count = 1;
-		mb.first_free = 1;
-		for (int i = 1; i < MAX_MATERIAL_CONSTS_COUNT; ++i) {
-			mb.data[i].ref_count = 0;
-			mb.data[i].next_free = i + 1;
-		}
-		mb.data.back().next_free = -1;
-			
-		DrawStream& stream = m_cpu_frame->draw_stream;
-		stream.createBuffer(mb.buffer
-			, gpu::BufferFlags::UNIFORM_BUFFER
-			, Material::MAX_UNIFORMS_BYTES * MAX_MATERIAL_CONSTS_COUNT
-			, nullptr
-		);
 
 		float default_mat[Material::MAX_UNIFORMS_FLOATS] = {};
-		stream.update(mb.buffer, &default_mat, sizeof(default_mat));
+		m_cpu_frame->draw_stream.update(mb.pages[0], &default_mat, sizeof(default_mat));
 
 		ResourceManagerHub& manager = m_engine.getResourceManager();
 		m_pipeline_manager.create(PipelineResource::TYPE, manager);
@@ -569,6 +739,15 @@ struct RendererImpl final : Renderer
 		gpu::popDebugGroup();
 	}
 
+	void getGPUPassStats(Array<GPUPassStats>& stats) override {
+		m_profiler.getPassStats(stats);
+	}
+
+	gpu::MemoryStats getGPUMemoryStats() override {
+		jobs::MutexGuard lock(m_gpu_memory_stats_mutex);
+		return m_gpu_memory_stats;
+	}
+
 	TransientSlice allocTransient(u32 size) override
 	{
 		jobs::wait(&m_cpu_frame->can_setup);
@@ -588,8 +767,31 @@ struct RendererImpl final : Renderer
 		return m_cpu_frame->uniform_buffer.alloc(size);
 	}
 	
-	gpu::BufferHandle getMaterialUniformBuffer() override {
-		return m_material_buffer.buffer;
+	gpu::BufferHandle getMaterialUniformBuffer(u32 id, u32& offset) override {
+		offset = (id % MaterialBuffer::PAGE_SIZE) * Material::MAX_UNIFORMS_BYTES;
+		return m_material_buffer.pages[id / MaterialBuffer::PAGE_SIZE];
+	}
+
+	// existing slots never move, so bind groups created before the growth stay valid
+	void addMaterialBufferPage() {
+		MaterialBuffer& mb = m_material_buffer;
+		ASSERT(mb.first_free == -1);
+		const u32 first = mb.data.size();
+		mb.data.resize(first + MaterialBuffer::PAGE_SIZE);
+		for (u32 i = first; i < first + MaterialBuffer::PAGE_SIZE; ++i) {
+			mb.data[i].ref_count = 0;
+			mb.data[i].next_free = i + 1;
+		}
+		mb.data.back().next_free = -1;
+		mb.first_free = first;
+
+		const gpu::BufferHandle buffer = gpu::allocBufferHandle();
+		mb.pages.push(buffer);
+		m_cpu_frame->draw_stream.createBuffer(buffer
+			, gpu::BufferFlags::UNIFORM_BUFFER
+			, Material::MAX_UNIFORMS_BYTES * MaterialBuffer::PAGE_SIZE
+			, nullptr
+		);
 	}
 
 	u32 createMaterialConstants(Span<const float> data) override {
@@ -600,10 +802,10 @@ struct RendererImpl final : Renderer
 			idx = iter.value();
 		}
 		else {
+			jobs::wait(&m_cpu_frame->can_setup);
 			if (m_material_buffer.first_free == -1) {
-				ASSERT(false);
-				++m_material_buffer.data[0].ref_count;
-				return 0;
+				addMaterialBufferPage();
+				logInfo("Material constants buffer grown to ", m_material_buffer.data.size(), " slots");
 			}
 			idx = m_material_buffer.first_free;
 			m_material_buffer.first_free = m_material_buffer.data[m_material_buffer.first_free].next_free;
@@ -611,11 +813,13 @@ struct RendererImpl final : Renderer
 			m_material_buffer.data[idx].hash = RuntimeHash(data.begin(), data.length() * sizeof(float));
 			m_material_buffer.map.insert(hash, idx);
 			
-			jobs::wait(&m_cpu_frame->can_setup);
+			// only the new slot is uploaded
 			const u32 size = u32(data.length() * sizeof(float));
 			const TransientSlice slice = m_cpu_frame->uniform_buffer.alloc(size);
 			memcpy(slice.ptr, data.begin(), size);
-			m_cpu_frame->draw_stream.copy(m_material_buffer.buffer, slice.buffer, idx * Material::MAX_UNIFORMS_BYTES, slice.offset, size);
+			u32 offset;
+			const gpu::BufferHandle buffer = getMaterialUniformBuffer(idx, offset);
+			m_cpu_frame->draw_stream.copy(buffer, slice.buffer, offset, slice.offset, size);
 		}
 		++m_material_buffer.data[idx].ref_count;
 		return idx;
@@ -670,6 +874,54 @@ struct RendererImpl final : Renderer
 		return m_sort_key_to_mesh_map.begin();
 	}
 
+	const SortKeyState* getSortKeyStates() const override {
+		return m_sort_key_states_dirty ? nullptr : m_sort_key_states.begin();
+	}
+
+	void invalidateSortKeyStates() override { m_sort_key_states_dirty = 1; }
+
+	void requestSortKeyProgram(u32 sort_key, gpu::StateFlags state, u32 defines) override {
+		jobs::MutexGuard guard(m_sort_key_program_requests_mutex);
+		m_sort_key_program_requests.push({sort_key, state, defines});
+	}
+
+	// must not run while pipelines record commands, i.e. between setup_done and the next frame's setup
+	void updateSortKeyStates() {
+		PROFILE_FUNCTION();
+		if (m_sort_key_states_dirty) {
+			m_sort_key_states_dirty = 0;
+			m_sort_key_states.resize(m_sort_key_to_mesh_map.size());
+			for (u32 key = 0, c = m_sort_key_states.size(); key < c; ++key) {
+				const Mesh* mesh = m_sort_key_to_mesh_map[key];
+				if (mesh) m_sort_key_states[key].set(*mesh);
+				else m_sort_key_states[key] = {};
+			}
+			profiler::pushInt("Count", m_sort_key_states.size());
+		}
+
+		jobs::MutexGuard guard(m_sort_key_program_requests_mutex);
+		for (const SortKeyProgramRequest& req : m_sort_key_program_requests) {
+			if (req.sort_key >= (u32)m_sort_key_states.size()) continue;
+			const Mesh* mesh = m_sort_key_to_mesh_map[req.sort_key];
+			SortKeyState& state = m_sort_key_states[req.sort_key];
+			if (!mesh || !state.shader || !state.shader->isReady()) continue;
+			// requested by several views or draws
+			if (state.getProgram(req.state, req.defines)) continue;
+			
+			if (state.programs_count == SortKeyState::MAX_PROGRAMS) {
+				// the oldest program is dropped
+				memmove(&state.programs[0], &state.programs[1], sizeof(state.programs[0]) * (SortKeyState::MAX_PROGRAMS - 1));
+				--state.programs_count;
+			}
+			SortKeyState::Program& program = state.programs[state.programs_count];
+			program.state = req.state;
+			program.defines = req.defines;
+			program.program = state.shader->getProgram(state.render_states | req.state, mesh->vertex_decl, req.defines | state.define_mask);
+			++state.programs_count;
+		}
+		m_sort_key_program_requests.clear();
+	}
+
 	u32 allocSortKey(Mesh* mesh) override {
 		if (!m_free_sort_keys.empty()) {
 			const u32 key = m_free_sort_keys.back();
@@ -678,6 +930,7 @@ struct RendererImpl final : Renderer
 			if ((u32)m_sort_key_to_mesh_map.size() < key + 1)
 				m_sort_key_to_mesh_map.resize(key + 1);
 			m_sort_key_to_mesh_map[key] = mesh;
+			invalidateSortKeyStates();
 			return key;
 		}
 		++m_max_sort_key;
@@ -686,12 +939,16 @@ struct RendererImpl final : Renderer
 		if ((u32)m_sort_key_to_mesh_map.size() < key + 1)
 			m_sort_key_to_mesh_map.resize(key + 1);
 		m_sort_key_to_mesh_map[key] = mesh;
+		invalidateSortKeyStates();
 		return key;
 	}
 
 	void freeSortKey(u32 key) override {
 		if (key != 0) {
 			m_free_sort_keys.push(key);
+			m_sort_key_to_mesh_map[key] = nullptr;
+			++m_sort_keys_generation;
+			invalidateSortKeyStates();
 		}
 	}
 	
@@ -699,6 +956,10 @@ struct RendererImpl final : Renderer
 		return m_max_sort_key;
 	}
 
+	u32 getSortKeysGeneration() const override {
+		return m_sort_keys_generation;
+	}
+
 	gpu::TextureHandle createTexture(u32 w, u32 h, u32 depth, gpu::TextureFormat format, gpu::TextureFlags flags, const MemRef& memory, const char* debug_name) override
 	{
 		gpu::TextureHandle handle = gpu::allocTextureHandle();
@@ -717,7 +978,7 @@ struct RendererImpl final : Renderer
 
 
 	void setupJob(void* user_ptr, void(*task)(void*)) override {
-		jobs::run(user_ptr, task, &m_cpu_frame->setup_done);
+		jobs::run(user_ptr, task, &m_cpu_frame->setup_done, jobs::Priority::HIGH);
 	}
 
 	void addPlugin(RenderPlugin& plugin) override {
@@ -732,6 +993,108 @@ struct RendererImpl final : Renderer
 
 
 	ResourceManager& getTextureManager() override { return m_texture_manager; }
+
+	void setTextureStreamingBudget(u64 bytes) override { m_texture_streaming_budget = bytes; }
+	u64 getTextureStreamingBudget() const override { return m_texture_streaming_budget; }
+	u64 getStreamedTexturesSize() const override { return m_streamed_textures_size; }
+	void addStreamedTexture(Texture& texture) override { m_streamed_textures.push(&texture); }
+	void removeStreamedTexture(Texture& texture) override { m_streamed_textures.swapAndPopItem(&texture); }
+	void addStreamedModel(Model& model) override { m_streamed_models.push(&model); }
+	void removeStreamedModel(Model& model) override { m_streamed_models.swapAndPopItem(&model); }
+
+	// lods requested by pipelines since the last frame, lods are not streamed out until the model is unloaded
+	void updateModelStreaming() {
+		if (m_streamed_models.empty()) return;
+		PROFILE_FUNCTION();
+
+		u32 requests = 0;
+		for (Model* model : m_streamed_models) {
+			if (model->isStreaming()) ++requests;
+		}
+
+		static constexpr u32 MAX_STREAMING_REQUESTS = 8;
+		for (i32 i = m_streamed_models.size() - 1; i >= 0; --i) {
+			Model* model = m_streamed_models[i];
+			if (model->getResidentLOD() == 0) {
+				m_streamed_models.swapAndPop(i);
+				continue;
+			}
+
+			const u32 wanted = model->takeRequestedLOD();
+			if (requests >= MAX_STREAMING_REQUESTS || model->isStreaming()) continue;
+			if (wanted >= model->getResidentLOD()) continue;
+
+			model->streamLODs(wanted);
+			++requests;
+		}
+
+		static u32 requests_counter = profiler::createCounter("Model streaming requests", 0);
+		profiler::pushCounter(requests_counter, (float)requests);
+	}
+
+	void updateTextureStreaming() {
+		if (m_streamed_textures.empty()) return;
+		PROFILE_FUNCTION();
+
+		const u32 frame = m_frame_number;
+		for (Resource* res : m_material_manager.getResourceTable()) {
+			Material* material = static_cast<Material*>(res);
+			const u32 resolution = material->takeRequestedTextureResolution();
+			if (resolution == 0) continue;
+			for (i32 i = 0, c = material->getTextureCount(); i < c; ++i) {
+				Texture* texture = material->getTexture(i);
+				if (texture && texture->isStreamed()) texture->requestResolution(resolution, frame);
+			}
+		}
+
+		// count what's being loaded too, so we do not overshoot the budget
+		u64 size = 0;
+		u32 requests = 0;
+		for (Texture* texture : m_streamed_textures) {
+			if (texture->isStreaming()) {
+				size += texture->getGPUSize(minimum(texture->resident_mip, texture->getStreamTargetMip()));
+				++requests;
+			}
+			else {
+				size += texture->getGPUSize(texture->resident_mip);
+			}
+		}
+
+		// over budget, drop mips which are not needed
+		for (Texture* texture : m_streamed_textures) {
+			if (size <= m_texture_streaming_budget) break;
+			if (texture->isStreaming()) continue;
+			
+			const u32 wanted = texture->getWantedMip(frame);
+			if (wanted <= texture->resident_mip) continue;
+
+			size -= texture->getGPUSize(texture->resident_mip) - texture->getGPUSize(wanted);
+			texture->streamMips(wanted);
+		}
+
+		// load missing mips if they fit in the budget
+		static constexpr u32 MAX_STREAMING_REQUESTS = 8;
+		for (Texture* texture : m_streamed_textures) {
+			if (requests >= MAX_STREAMING_REQUESTS) break;
+			if (texture->isStreaming()) continue;
+
+			const u32 wanted = texture->getWantedMip(frame);
+			if (wanted >= texture->resident_mip) continue;
+			
+			const u64 extra = texture->getGPUSize(wanted) - texture->getGPUSize(texture->resident_mip);
+			if (size + extra > m_texture_streaming_budget) continue;
+
+			size += extra;
+			++requests;
+			texture->streamMips(wanted);
+		}
+
+		m_streamed_textures_size = size;
+		static u32 size_counter = profiler::createCounter("Streamed textures (MB)", 0);
+		static u32 requests_counter = profiler::createCounter("Texture streaming requests", 0);
+		profiler::pushCounter(size_counter, float(double(size) / (1024.0 * 1024.0)));
+		profiler::pushCounter(requests_counter, (float)requests);
+	}
 	FontManager& getFontManager() override { return *m_font_manager; }
 
 	void createScenes(Universe& ctx) override
@@ -767,9 +1130,131 @@ struct RendererImpl final : Renderer
 		gpu::ProgramHandle program = gpu::allocProgramHandle();
 		shader.compile(program, state, decl, defines, m_cpu_frame->begin_frame_draw_stream);
 		m_cpu_frame->to_compile_shaders.push({&shader, decl, defines, program, state});
+		if (m_record_shader_usage) addShaderUsage(shader, state, decl, defines);
 		return program;
 	}
 
+	void reloadShaderPrograms(Shader& shader) override {
+		cancelShaderReload(shader);
+		jobs::MutexGuard lock(m_cpu_frame->shader_mutex);
+		auto queue = [&](gpu::StateFlags state, const gpu::VertexDecl& decl, u32 defines){
+			ShaderReload& reload = m_shader_reloads.emplace();
+			reload.shader = &shader;
+			reload.key.state = state;
+			reload.key.defines = defines;
+			reload.key.decl_hash = decl.hash;
+			reload.program = gpu::allocProgramHandle();
+			reload.frame = m_frame_number + m_frames_in_flight;
+			shader.compile(reload.program, state, decl, defines, m_cpu_frame->begin_frame_draw_stream);
+		};
+		for (const Shader::ProgramPair& p : shader.m_programs) {
+			queue(p.key.state, p.decl, p.key.defines);
+		}
+		// queued this frame with old sources, added to m_programs in frame()
+		for (const auto& i : m_cpu_frame->to_compile_shaders) {
+			if (i.shader == &shader) queue(i.state, i.decl, i.defines);
+		}
+	}
+
+	void cancelShaderReload(Shader& shader) override {
+		for (i32 i = m_shader_reloads.size() - 1; i >= 0; --i) {
+			if (m_shader_reloads[i].shader != &shader) continue;
+			getEndFrameDrawStream().destroy(m_shader_reloads[i].program);
+			m_shader_reloads.swapAndPop(i);
+		}
+	}
+
+	void addShaderUsage(Shader& shader, gpu::StateFlags state, const gpu::VertexDecl& decl, u32 defines) {
+		jobs::MutexGuard lock(m_shader_usage_mutex);
+		if (!m_record_shader_usage) return;
+		for (const ShaderUsage& usage : m_shader_usage) {
+			if (usage.path == shader.getPath() && usage.state == state && usage.decl.hash == decl.hash && usage.defines == defines) return;
+		}
+		m_shader_usage.push({shader.getPath(), state, decl, defines});
+	}
+
+	void recordShaderUsage(bool enable) override {
+		jobs::MutexGuard lock(m_shader_usage_mutex);
+		if (enable && !m_record_shader_usage) m_shader_usage.clear();
+		m_record_shader_usage = enable;
+	}
+
+	bool isRecordingShaderUsage() const override { return m_record_shader_usage; }
+
+	void saveShaderUsage(OutputMemoryStream& blob) override {
+		jobs::MutexGuard lock(m_shader_usage_mutex);
+		ShaderUsageHeader header;
+		header.defines_count = m_shader_defines.size();
+		header.count = m_shader_usage.size();
+		blob.write(header);
+		// defines are saved by name, their indices can be different next time
+		for (const StaticString<32>& define : m_shader_defines) {
+			blob.writeString(define);
+		}
+		for (const ShaderUsage& usage : m_shader_usage) {
+			blob.writeString(usage.path.c_str());
+			blob.write(usage.state);
+			blob.write(usage.decl);
+			blob.write(usage.defines);
+		}
+	}
+
+	bool warmupShaders(InputMemoryStream& blob) override {
+		ShaderUsageHeader header;
+		if (!blob.read(&header, sizeof(header))) return false;
+		if (header.magic != ShaderUsageHeader::MAGIC || header.version != ShaderUsageHeader::VERSION) {
+			logError("Unsupported shader usage file");
+			return false;
+		}
+		if (header.defines_count > MAX_SHADER_DEFINES) return false;
+
+		u8 define_map[MAX_SHADER_DEFINES];
+		for (u32 i = 0; i < header.defines_count; ++i) {
+			define_map[i] = getShaderDefineIdx(blob.readString());
+		}
+
+		ResourceManagerHub& rm = m_engine.getResourceManager();
+		m_shader_warmup.reserve(m_shader_warmup.size() + header.count);
+		for (u32 i = 0; i < header.count; ++i) {
+			const char* path = blob.readString();
+			gpu::StateFlags state;
+			gpu::VertexDecl decl(gpu::PrimitiveType::NONE);
+			u32 file_defines;
+			blob.read(state);
+			blob.read(decl);
+			if (!blob.read(&file_defines, sizeof(file_defines))) break;
+
+			u32 defines = 0;
+			for (u32 j = 0; j < header.defines_count; ++j) {
+				if (file_defines & (1 << j)) defines |= 1 << define_map[j];
+			}
+			Shader* shader = rm.load<Shader>(Path(path));
+			if (shader) m_shader_warmup.push({shader, state, decl, defines});
+		}
+		return true;
+	}
+
+	bool isShaderWarmupFinished() const override { return m_shader_warmup.empty(); }
+
+	void updateShaderWarmup() {
+		if (m_shader_warmup.empty()) return;
+		PROFILE_FUNCTION();
+		
+		// so the loading screen does not freeze
+		static constexpr u32 MAX_WARMUP_COMPILES_PER_FRAME = 32;
+		u32 compiled = 0;
+		for (i32 i = m_shader_warmup.size() - 1; i >= 0 && compiled < MAX_WARMUP_COMPILES_PER_FRAME; --i) {
+			ShaderWarmup& warmup = m_shader_warmup[i];
+			if (warmup.shader->isEmpty()) continue;
+			if (warmup.shader->isReady()) {
+				warmup.shader->getProgram(warmup.state, warmup.decl, warmup.defines);
+				++compiled;
+			}
+			warmup.shader->decRefCount();
+			m_shader_warmup.swapAndPop(i);
+		}
+	}
+
 
 	u8 getShaderDefineIdx(const char* define) override
 	{
@@ -795,7 +1280,7 @@ struct RendererImpl final : Renderer
 	void render() {
 		jobs::MutexGuard guard(m_render_mutex);
 
-		FrameData* next_frame = m_frames[(getFrameIndex(m_gpu_frame) + 1) % lengthOf(m_frames)].get();
+		FrameData* next_frame = m_frames[(getFrameIndex(m_gpu_frame) + 1) % m_frames_in_flight].get();
 
 		if (next_frame->gpu_frame != 0xffFFffFF && gpu::frameFinished(next_frame->gpu_frame)) {
 			next_frame->gpu_frame = 0xFFffFFff;   
@@ -810,21 +1295,30 @@ struct RendererImpl final : Renderer
 		frame.uniform_buffer.prepareToRender();
 		
 		gpu::MemoryStats mem_stats;
-		if (gpu::getMemoryStats(mem_stats)) {
+		const bool has_driver_mem_stats = gpu::getMemoryStats(mem_stats);
+		{
+			jobs::MutexGuard lock(m_gpu_memory_stats_mutex);
+			m_gpu_memory_stats = mem_stats;
+		}
+		auto to_MB = [](u64 B){
+			return float(double(B) / (1024.0 * 1024.0));
+		};
+		if (has_driver_mem_stats) {
 			//static u32 total_counter = profiler::createCounter("Total GPU memory (MB)", 0);
 			static u32 available_counter = profiler::createCounter("Available GPU memory (MB)", 0);
 			//static u32 dedicated_counter = profiler::createCounter("Dedicate Vid memory (MB)", 0);
-			static u32 buffer_counter = profiler::createCounter("Buffer memory (MB)", 0);
-			static u32 texture_counter = profiler::createCounter("Texture memory (MB)", 0);
-			auto to_MB = [](u64 B){
-				return float(double(B) / (1024.0 * 1024.0));
-			};
 			//profiler::pushCounter(total_counter, to_MB(mem_stats.total_available_mem));
 			profiler::pushCounter(available_counter, to_MB(mem_stats.current_available_mem));
 			//profiler::pushCounter(dedicated_counter, to_MB(mem_stats.dedicated_vidmem));
-			profiler::pushCounter(buffer_counter, to_MB(mem_stats.buffer_mem));
-			profiler::pushCounter(texture_counter, to_MB(mem_stats.texture_mem));
 		}
+		static u32 buffer_counter = profiler::createCounter("Buffer memory (MB)", 0);
+		static u32 texture_counter = profiler::createCounter("Texture memory (MB)", 0);
+		static u32 render_target_counter = profiler::createCounter("Render target memory (MB)", 0);
+		static u32 transient_mem_counter = profiler::createCounter("Transient GPU memory (MB)", 0);
+		profiler::pushCounter(buffer_counter, to_MB(mem_stats.buffer_mem));
+		profiler::pushCounter(texture_counter, to_MB(mem_stats.texture_mem));
+		profiler::pushCounter(render_target_counter, to_MB(mem_stats.render_target_mem));
+		profiler::pushCounter(transient_mem_counter, to_MB(mem_stats.transient_mem));
 
 		m_profiler.beginQuery("frame", 0, false);
 		frame.begin_frame_draw_stream.run();
@@ -841,7 +1335,7 @@ struct RendererImpl final : Renderer
 
 		jobs::enableBackupWorker(true);
 
-		FrameData* prev_frame = m_frames[(getFrameIndex(m_gpu_frame) + lengthOf(m_frames) - 1) % lengthOf(m_frames)].get();
+		FrameData* prev_frame = m_frames[(getFrameIndex(m_gpu_frame) + m_frames_in_flight - 1) % m_frames_in_flight].get();
 		if (prev_frame->gpu_frame != 0xffFFffFF && gpu::frameFinished(prev_frame->gpu_frame)) {
 			prev_frame->gpu_frame = 0xFFffFFff;   
 			prev_frame->transient_buffer.renderDone();
@@ -857,7 +1351,7 @@ struct RendererImpl final : Renderer
 		jobs::enableBackupWorker(false);
 		m_profiler.frame();
 
-		m_gpu_frame = m_frames[(getFrameIndex(m_gpu_frame) + 1) % lengthOf(m_frames)].get();
+		m_gpu_frame = m_frames[(getFrameIndex(m_gpu_frame) + 1) % m_frames_in_flight].get();
 
 		if (m_gpu_frame->gpu_frame != 0xffFFffFF) {
 			gpu::waitFrame(m_gpu_frame->gpu_frame);
@@ -884,6 +1378,35 @@ struct RendererImpl final : Renderer
 		jobs::wait(&m_last_render);
 	}
 
+	// waits until GPU finishes all submitted frames, so all frames can be set up again
+	void waitForGPU() {
+		PROFILE_FUNCTION();
+		waitForRender();
+		jobs::Signal signal;
+		jobs::runLambda([this](){
+			for (const Local<FrameData>& frame : m_frames) {
+				if (frame->gpu_frame == 0xffFFffFF) continue;
+				gpu::waitFrame(frame->gpu_frame);
+				frame->gpu_frame = 0xffFFffFF;
+				frame->transient_buffer.renderDone();
+				frame->uniform_buffer.renderDone();
+				jobs::setGreen(&frame->can_setup);
+			}
+		}, &signal, 1);
+		jobs::wait(&signal);
+	}
+
+	// called after current cpu frame is submitted, when the new cpu frame has nothing recorded yet
+	void applyFramesInFlight() {
+		waitForGPU();
+		// all frames are idle now, so the ring can start from the beginning
+		const u32 frame_number = m_cpu_frame->frame_number;
+		m_frames_in_flight = m_requested_frames_in_flight;
+		m_cpu_frame = m_frames[0].get();
+		m_gpu_frame = m_cpu_frame;
+		m_cpu_frame->frame_number = frame_number;
+	}
+
 	i32 getFrameIndex(FrameData* frame) const {
 		for (i32 i = 0; i < (i32)lengthOf(m_frames); ++i) {
 			if (frame == m_frames[i].get()) return i;
@@ -894,10 +1417,47 @@ struct RendererImpl final : Renderer
 
 	u32 frameNumber() const override { return m_cpu_frame->frame_number; }
 
+	void queueUpload(GPUUpload& upload) override {
+		ASSERT(m_uploads.indexOf(&upload) < 0);
+		m_uploads.push(&upload);
+	}
+
+	void cancelUpload(GPUUpload& upload) override {
+		const i32 idx = m_uploads.indexOf(&upload);
+		if (idx >= 0) m_uploads.erase(idx);
+	}
+
+	void setUploadBudget(u32 bytes_per_frame) override { m_upload_budget = bytes_per_frame; }
+
+	void updateUploads() {
+		PROFILE_FUNCTION();
+		u64 uploaded = 0;
+		DrawStream& stream = getDrawStream();
+		// at least one upload per frame, even if it's bigger than the budget
+		while (!m_uploads.empty()) {
+			GPUUpload* upload = m_uploads[0];
+			const u32 size = upload->getUploadSize();
+			if (uploaded > 0 && uploaded + size > m_upload_budget) break;
+			uploaded += size;
+			// upload can make a resource ready, its callbacks can queue or cancel uploads
+			m_uploads.erase(0);
+			upload->upload(stream);
+		}
+
+		static u32 uploaded_counter = profiler::createCounter("GPU uploads (kB)", 0);
+		static u32 queued_counter = profiler::createCounter("Queued GPU uploads", 0);
+		profiler::pushCounter(uploaded_counter, float(double(uploaded) / 1024.0));
+		profiler::pushCounter(queued_counter, (float)m_uploads.size());
+	}
+
 	void frame() override
 	{
 		PROFILE_FUNCTION();
 		
+		updateTextureStreaming();
+		updateModelStreaming();
+		updateShaderWarmup();
+		updateUploads();
 		jobs::wait(&m_cpu_frame->setup_done);
 
 		m_cpu_frame->draw_stream.useProgram(gpu::INVALID_PROGRAM);
@@ -913,10 +1473,30 @@ struct RendererImpl final : Renderer
 			key.defines = i.defines;
 			key.decl_hash = i.decl.hash;
 			key.state = i.state;
-			i.shader->m_programs.push({key, i.program});
+			i.shader->m_programs.push({key, i.program, i.decl});
 		}
 		m_cpu_frame->to_compile_shaders.clear();
 
+		// programs of shaders reloaded in place are swapped in once the render thread created them
+		for (i32 i = m_shader_reloads.size() - 1; i >= 0; --i) {
+			ShaderReload& reload = m_shader_reloads[i];
+			if (reload.frame > m_frame_number) continue;
+			invalidateSortKeyStates();
+			for (Shader::ProgramPair& p : reload.shader->m_programs) {
+				if (p.key == reload.key) {
+					m_cpu_frame->end_frame_draw_stream.destroy(p.program);
+					p.program = reload.program;
+					reload.program = gpu::INVALID_PROGRAM;
+					break;
+				}
+			}
+			if (reload.program != gpu::INVALID_PROGRAM) m_cpu_frame->end_frame_draw_stream.destroy(reload.program);
+			m_shader_reloads.swapAndPop(i);
+		}
+
+		// programs compiled this frame are in shaders now, so requested programs can be found
+		updateSortKeyStates();
+
 		u32 frame_data_mem = 0;
 		for (const Local<FrameData>& fd : m_frames) {
 			frame_data_mem += fd->linear_allocator.getCommited();
@@ -926,17 +1506,24 @@ struct RendererImpl final : Renderer
 
 		jobs::setRed(&m_cpu_frame->can_setup);
 		
-		m_cpu_frame = m_frames[(getFrameIndex(m_cpu_frame) + 1) % lengthOf(m_frames)].get();
+		m_cpu_frame = m_frames[(getFrameIndex(m_cpu_frame) + 1) % m_frames_in_flight].get();
 		++m_frame_number;
 		m_cpu_frame->frame_number = m_frame_number;
 		
 		jobs::runLambda([this](){
 			render();
 		}, &m_last_render, 1);
+
+		if (m_requested_frames_in_flight != m_frames_in_flight) {
+			applyFramesInFlight();
+		}
+		else if (m_latency_mode == LatencyMode::LOW_LATENCY) {
+			waitForGPU();
+		}
 	}
 
 	Engine& m_engine;
-	IAllocator& m_allocator;
+	TagAllocator m_allocator;
 	Array<StaticString<32>> m_shader_defines;
 	jobs::Mutex m_render_mutex;
 	jobs::Mutex m_shader_defines_mutex;
@@ -950,22 +1537,93 @@ struct RendererImpl final : Renderer
 	RenderResourceManager<Texture> m_texture_manager;
 	Array<u32> m_free_sort_keys;
 	Array<const Mesh*> m_sort_key_to_mesh_map;
+	Array<SortKeyState> m_sort_key_states;
+	volatile i32 m_sort_key_states_dirty = 1;
+	struct SortKeyProgramRequest {
+		u32 sort_key;
+		gpu::StateFlags state;
+		u32 defines;
+	};
+	jobs::Mutex m_sort_key_program_requests_mutex;
+	Array<SortKeyProgramRequest> m_sort_key_program_requests;
 	u32 m_max_sort_key = 0;
+	u32 m_sort_keys_generation = 0;
 	u32 m_frame_number = 0;
 	float m_lod_multiplier = 1;
+	bool m_cpu_occlusion_culling = false;
 
 	Array<RenderPlugin*> m_plugins;
-	Local<FrameData> m_frames[3];
+
+	struct ShaderUsage {
+		Path path;
+		gpu::StateFlags state;
+		gpu::VertexDecl decl;
+		u32 defines;
+	};
+
+	struct ShaderWarmup {
+		Shader* shader;
+		gpu::StateFlags state;
+		gpu::VertexDecl decl;
+		u32 defines;
+	};
+
+	#pragma pack(1)
+	struct ShaderUsageHeader {
+		static constexpr u32 MAGIC = 'LSHU';
+		static constexpr u32 VERSION = 0;
+		u32 magic = MAGIC;
+		u32 version = VERSION;
+		u32 defines_count = 0;
+		u32 count = 0;
+	};
+	#pragma pack()
+
+	jobs::Mutex m_shader_usage_mutex;
+	bool m_record_shader_usage = false;
+	Array<ShaderUsage> m_shader_usage;
+	Array<ShaderWarmup> m_shader_warmup;
+
+	struct ShaderReload {
+		Shader* shader;
+		Shader::ShaderKey key;
+		gpu::ProgramHandle program;
+		u32 frame; // render thread created the program before this frame
+	};
+	Array<ShaderReload> m_shader_reloads;
+
+	static constexpr const char* PROGRAM_CACHE_PATH = ".lumix/program_cache.bin";
+	FileSystem::AsyncHandle m_program_cache_op = FileSystem::AsyncHandle::invalid();
+
+	u64 m_texture_streaming_budget = 512 * 1024 * 1024;
+	u64 m_streamed_textures_size = 0;
+	Array<Texture*> m_streamed_textures;
+	Array<Model*> m_streamed_models;
+
+	Array<GPUUpload*> m_uploads;
+	u32 m_upload_budget = 32 * 1024 * 1024;
+
+	// only first m_frames_in_flight are used
+	Local<FrameData> m_frames[MAX_FRAMES_IN_FLIGHT];
+	u32 m_frames_in_flight = 3;
+	u32 m_requested_frames_in_flight = 3;
+	LatencyMode m_latency_mode = LatencyMode::OVERLAPPED;
 	FrameData* m_gpu_frame = nullptr;
 	FrameData* m_cpu_frame = nullptr;
 	jobs::Signal m_last_render;
 
 	GPUProfiler m_profiler;
+	jobs::Mutex m_gpu_memory_stats_mutex;
+	gpu::MemoryStats m_gpu_memory_stats = {};
 
 	struct MaterialBuffer {
+		// slots per gpu buffer, buffers are added when all slots are used
+		static constexpr u32 PAGE_SIZE = 400;
+
 		MaterialBuffer(IAllocator& alloc) 
 			: map(alloc)
 			, data(alloc)
+			, pages(alloc)
 		{}
 
 		struct Data {
@@ -977,9 +1635,9 @@ struct RendererImpl final : Renderer
 			};
 		};
 
-		gpu::BufferHandle buffer = gpu::INVALID_BUFFER;
+		Array<gpu::BufferHandle> pages;
 		Array<Data> data;
-		int first_free;
+		int first_free = -1;
 		HashMap<RuntimeHash, u32> map;
 	} m_material_buffer;
 };
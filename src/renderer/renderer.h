@@ -20,6 +20,54 @@ struct RenderPlugin {
 };
 
 struct DrawStream;
+template <typename T> struct Array;
+
+// gpu data of a resource, created in a later frame by the renderer's upload queue
+struct GPUUpload {
+	virtual ~GPUUpload() {}
+	virtual u32 getUploadSize() const = 0;
+	// main thread, records creation of gpu objects to stream
+	virtual void upload(DrawStream& stream) = 0;
+};
+
+// render state of a mesh stored in a contiguous table indexed by the mesh's sort key, so draw calls
+// are recorded without dereferencing meshes and materials, see Renderer::getSortKeyStates
+struct LUMIX_RENDERER_API SortKeyState {
+	static constexpr u32 MAX_PROGRAMS = 4;
+
+	// bucket's state and defines, material's states and defines are included in the program
+	struct Program {
+		gpu::StateFlags state;
+		u32 defines;
+		gpu::ProgramHandle program;
+	};
+
+	void set(const struct Mesh& mesh);
+	gpu::ProgramHandle getProgram(gpu::StateFlags state, u32 defines) const {
+		for (u32 i = 0; i < programs_count; ++i) {
+			if (programs[i].state == state && programs[i].defines == defines) return programs[i].program;
+		}
+		return gpu::INVALID_PROGRAM;
+	}
+
+	struct Material* material = nullptr;
+	struct Shader* shader = nullptr;
+	gpu::BindGroupHandle bind_group = gpu::INVALID_BIND_GROUP;
+	gpu::StateFlags render_states = gpu::StateFlags::NONE;
+	u32 define_mask = 0;
+	gpu::BufferHandle vertex_buffer = gpu::INVALID_BUFFER;
+	gpu::BufferHandle index_buffer = gpu::INVALID_BUFFER;
+	gpu::BufferHandle quantization_buffer = gpu::INVALID_BUFFER;
+	gpu::BufferHandle meshlet_buffer = gpu::INVALID_BUFFER;
+	u32 meshlets_count = 0;
+	u32 vb_stride = 0;
+	u32 indices_count = 0;
+	gpu::DataType index_type = gpu::DataType::U32;
+	u8 layer = 0;
+	float lod = 0;
+	u32 programs_count = 0;
+	Program programs[MAX_PROGRAMS];
+};
 
 struct LUMIX_RENDERER_API Renderer : IPlugin {
 	struct MemRef {
@@ -35,7 +83,25 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 		u8* ptr;
 	};
 
+	// GPU time of blocks from beginProfileBlock, aggregated by name over last HISTORY_SIZE frames
+	struct GPUPassStats {
+		enum { HISTORY_SIZE = 64 };
+		char name[32];
+		u32 depth;
+		float last_ms;
+		float avg_ms;
+		float max_ms;
+	};
+
 	enum { MAX_SHADER_DEFINES = 32 };
+	static constexpr u32 MAX_FRAMES_IN_FLIGHT = 4;
+
+	enum class LatencyMode : u8 {
+		// simulation of next frames overlaps with rendering, up to frames in flight
+		OVERLAPPED,
+		// frame() returns once GPU finished the frame, so input of the next frame is sampled as late as possible
+		LOW_LATENCY
+	};
 
 	virtual void frame() = 0;
 	virtual u32 frameNumber() const = 0;
@@ -45,6 +111,14 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 	virtual struct Engine& getEngine() = 0;
 	virtual float getLODMultiplier() const = 0;
 	virtual void setLODMultiplier(float value) = 0;
+	// main camera's renderables are tested against occluders rasterized on CPU, for GPU bound hardware
+	virtual void setCPUOcclusionCulling(bool enable) = 0;
+	virtual bool isCPUOcclusionCulling() const = 0;
+	// 1 to MAX_FRAMES_IN_FLIGHT, default is 3, applied in next frame() once all frames are rendered
+	virtual void setFramesInFlight(u32 count) = 0;
+	virtual u32 getFramesInFlight() const = 0;
+	virtual void setLatencyMode(LatencyMode mode) = 0;
+	virtual LatencyMode getLatencyMode() const = 0;
 	
 	virtual struct LinearAllocator& getCurrentFrameAllocator() = 0;
 	virtual IAllocator& getAllocator() = 0;
@@ -66,13 +140,30 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 	virtual void freeSortKey(u32 key) = 0;
 	virtual u32 getMaxSortKey() const = 0;
 	virtual const Mesh** getSortKeyToMeshMap() const = 0;
+	// indexed by sort key, rebuilt in frame() after invalidateSortKeyStates, null if it's not up to date
+	virtual const SortKeyState* getSortKeyStates() const = 0;
+	// call when a mesh or a material changes its render state
+	virtual void invalidateSortKeyStates() = 0;
+	// thread safe, program not found in SortKeyState::programs, it's added there in the next frame()
+	virtual void requestSortKeyProgram(u32 sort_key, gpu::StateFlags state, u32 defines) = 0;
+	// changes whenever a sort key is freed, so it can be reused by another mesh
+	virtual u32 getSortKeysGeneration() const = 0;
 	
 	virtual struct FontManager& getFontManager() = 0;
 	virtual struct ResourceManager& getTextureManager() = 0;
+	// GPU memory for mip streamed textures, 0 - textures are not streamed
+	virtual void setTextureStreamingBudget(u64 bytes) = 0;
+	virtual u64 getTextureStreamingBudget() const = 0;
+	virtual u64 getStreamedTexturesSize() const = 0;
+	virtual void addStreamedTexture(struct Texture& texture) = 0;
+	virtual void removeStreamedTexture(Texture& texture) = 0;
+	virtual void addStreamedModel(struct Model& model) = 0;
+	virtual void removeStreamedModel(Model& model) = 0;
 	
 	virtual u32 createMaterialConstants(Span<const float> data) = 0;
 	virtual void destroyMaterialConstants(u32 id) = 0;
-	virtual gpu::BufferHandle getMaterialUniformBuffer() = 0;
+	// buffer containing material constants `id`, offset is where they start in the buffer
+	virtual gpu::BufferHandle getMaterialUniformBuffer(u32 id, u32& offset) = 0;
 	
 	virtual TransientSlice allocTransient(u32 size) = 0;
 	virtual TransientSlice allocUniform(u32 size) = 0;
@@ -80,8 +171,23 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 	
 	virtual gpu::BufferHandle createBuffer(const MemRef& memory, gpu::BufferFlags flags) = 0;
 	virtual gpu::TextureHandle createTexture(u32 w, u32 h, u32 depth, gpu::TextureFormat format, gpu::TextureFlags flags, const MemRef& memory, const char* debug_name) = 0;
+	// uploads are spread over frames within a per frame budget, so big loads do not stall a single frame
+	virtual void queueUpload(GPUUpload& upload) = 0;
+	virtual void cancelUpload(GPUUpload& upload) = 0;
+	virtual void setUploadBudget(u32 bytes_per_frame) = 0;
 
 	virtual gpu::ProgramHandle queueShaderCompile(struct Shader& shader, gpu::StateFlags state, gpu::VertexDecl decl, u32 defines) = 0;
+	// compiles used programs of a shader reloaded in place, they replace the current programs once they are created
+	virtual void reloadShaderPrograms(Shader& shader) = 0;
+	virtual void cancelShaderReload(Shader& shader) = 0;
+	// shader permutations compiled while recording, so they can be compiled ahead in warmupShaders
+	static constexpr const char* SHADER_USAGE_PATH = "pipelines/shader_usage.lsu";
+	virtual void recordShaderUsage(bool enable) = 0;
+	virtual bool isRecordingShaderUsage() const = 0;
+	virtual void saveShaderUsage(struct OutputMemoryStream& blob) = 0;
+	// loads shaders from recorded usage, their programs are queued for compilation during next frames
+	virtual bool warmupShaders(struct InputMemoryStream& blob) = 0;
+	virtual bool isShaderWarmupFinished() const = 0;
 	virtual DrawStream& getDrawStream() = 0;
 	virtual DrawStream& getEndFrameDrawStream() = 0;
 
@@ -90,6 +196,10 @@ struct LUMIX_RENDERER_API Renderer : IPlugin {
 
 	virtual void beginProfileBlock(const char* name, i64 link, bool stats = false) = 0;
 	virtual void endProfileBlock() = 0;
+	// results lag a few frames behind, since GPU queries are resolved asynchronously
+	virtual void getGPUPassStats(Array<GPUPassStats>& stats) = 0;
+	// updated by render thread every frame
+	virtual gpu::MemoryStats getGPUMemoryStats() = 0;
 
 protected:
 	virtual void setupJob(void* user_ptr, void(*task)(void*)) = 0;
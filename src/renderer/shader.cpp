@@ -9,6 +9,7 @@
 #include "engine/profiler.h"
 #include "engine/resource_manager.h"
 #include "renderer/draw_stream.h"
+#include "renderer/material.h"
 #include "renderer/renderer.h"
 #include "renderer/texture.h"
 
@@ -89,6 +90,10 @@ void Shader::compile(gpu::ProgramHandle program
 			++defines_count;
 		}
 	}
+	if (m_texture_indices_offset >= 0) {
+		prefixes[defines_count] = "#define LUMIX_BINDLESS_TEXTURES\n";
+		++defines_count;
+	}
 	prefixes[defines_count] = m_sources.common.length() == 0 ? "" : m_sources.common.c_str();
 
 	stream.createProgram(program, state, decl, codes, types, m_sources.stages.size(), prefixes, 1 + defines_count, m_sources.path.c_str());
@@ -213,6 +218,14 @@ int define(lua_State* L)
 }
 
 
+int bindless_textures(lua_State* L)
+{
+	Shader* shader = getShader(L);
+	shader->m_bindless_textures = true;
+	return 0;
+}
+
+
 int texture_slot(lua_State* L)
 {
 	LuaWrapper::checkTableArg(L, 1);
@@ -385,6 +398,8 @@ bool Shader::load(u64 size, const u8* mem)
 	lua_setfield(L, LUA_GLOBALSINDEX, "import");
 	lua_pushcfunction(L, LuaAPI::texture_slot);
 	lua_setfield(L, LUA_GLOBALSINDEX, "texture_slot");
+	lua_pushcfunction(L, LuaAPI::bindless_textures);
+	lua_setfield(L, LUA_GLOBALSINDEX, "bindless_textures");
 	lua_pushcfunction(L, LuaAPI::define);
 	lua_setfield(L, LUA_GLOBALSINDEX, "define");
 	lua_pushcfunction(L, LuaAPI::uniform);
@@ -401,8 +416,20 @@ bool Shader::load(u64 size, const u8* mem)
 }
 
 
+void Shader::releaseDefaultTextures() {
+	for (u32 i = 0; i < m_texture_slot_count; ++i) {
+		if (m_texture_slots[i].default_texture) {
+			Texture* t = m_texture_slots[i].default_texture;
+			t->decRefCount();
+			m_texture_slots[i].default_texture = nullptr;
+		}
+	}
+}
+
+
 void Shader::unload()
 {
+	m_renderer.cancelShaderReload(*this);
 	for (const ProgramPair& p : m_programs) {
 		m_renderer.getEndFrameDrawStream().destroy(p.program);
 	}
@@ -410,17 +437,74 @@ void Shader::unload()
 	m_sources.stages.clear();
 	m_programs.clear();
 	m_uniforms.clear();
-	for (u32 i = 0; i < m_texture_slot_count; ++i) {
-		if (m_texture_slots[i].default_texture) {
-			Texture* t = m_texture_slots[i].default_texture;
-			t->decRefCount();
-			m_texture_slots[i].default_texture = nullptr;
-		}
-	}
+	releaseDefaultTextures();
 	m_texture_slot_count = 0;
+	m_bindless_textures = false;
+	m_texture_indices_offset = -1;
 	m_all_defines_mask = 0;
 }
 
+
+// materials keep their constants and bind groups, so only shaders with the same uniforms and texture slots are reloaded in place
+bool Shader::reloadInPlace(u64 size, const u8* mem) {
+	PROFILE_FUNCTION();
+	Array<Uniform> old_uniforms(m_uniforms.move());
+	Array<u8> old_defines(m_defines.move());
+	Sources old_sources(m_sources);
+	TextureSlot old_slots[lengthOf(m_texture_slots)];
+	memcpy(old_slots, m_texture_slots, sizeof(old_slots));
+	const u32 old_slot_count = m_texture_slot_count;
+	const bool old_bindless = m_bindless_textures;
+	const i32 old_indices_offset = m_texture_indices_offset;
+
+	m_sources.common = "";
+	m_sources.stages.clear();
+	for (TextureSlot& slot : m_texture_slots) slot = TextureSlot();
+	m_texture_slot_count = 0;
+	m_bindless_textures = false;
+	m_texture_indices_offset = -1;
+
+	bool compatible = load(size, mem);
+	if (compatible) onBeforeReady();
+	compatible = compatible
+		&& m_uniforms.size() == old_uniforms.size()
+		&& m_texture_slot_count == old_slot_count
+		&& m_texture_indices_offset == old_indices_offset
+		&& m_defines.size() == old_defines.size();
+	for (i32 i = 0; compatible && i < m_uniforms.size(); ++i) {
+		const Uniform& u = m_uniforms[i];
+		const Uniform& old = old_uniforms[i];
+		compatible = u.name_hash == old.name_hash && u.type == old.type && u.offset == old.offset;
+	}
+	for (u32 i = 0; compatible && i < m_texture_slot_count; ++i) {
+		compatible = equalStrings(m_texture_slots[i].name, old_slots[i].name) && m_texture_slots[i].define_idx == old_slots[i].define_idx;
+	}
+	for (i32 i = 0; compatible && i < m_defines.size(); ++i) {
+		compatible = m_defines[i] == old_defines[i];
+	}
+
+	if (!compatible) {
+		releaseDefaultTextures();
+		m_uniforms = old_uniforms.move();
+		m_defines = old_defines.move();
+		m_sources.common = old_sources.common;
+		m_sources.stages = old_sources.stages.move();
+		memcpy(m_texture_slots, old_slots, sizeof(old_slots));
+		m_texture_slot_count = old_slot_count;
+		m_bindless_textures = old_bindless;
+		m_texture_indices_offset = old_indices_offset;
+		return false;
+	}
+
+	for (u32 i = 0; i < old_slot_count; ++i) {
+		if (old_slots[i].default_texture) old_slots[i].default_texture->decRefCount();
+	}
+	// only variants which were already used are compiled, they replace the current programs when ready
+	m_renderer.reloadShaderPrograms(*this);
+	logInfo(getPath(), " reloaded in place");
+	return true;
+}
+
 static const char* toString(Shader::Uniform::Type type) {
 	switch(type) {
 		case Shader::Uniform::COLOR: return "vec4";
@@ -468,7 +552,18 @@ void Shader::toTextureVarName(Span<char> out, const char* in) {
 }
 
 void Shader::onBeforeReady() {
-	if (m_uniforms.empty()) return;
+	bool bindless = m_bindless_textures && gpu::isBindlessSupported();
+	u32 indices_offset = 0;
+	if (bindless) {
+		// texture indices follow uniforms, ivec4 is aligned to 16B in std140
+		if (!m_uniforms.empty()) indices_offset = m_uniforms.back().offset + m_uniforms.back().size();
+		indices_offset = (indices_offset + 15) & ~15;
+		if (indices_offset + sizeof(i32) * lengthOf(m_texture_slots) > Material::MAX_UNIFORMS_BYTES) {
+			logWarning(getPath(), ": uniforms leave no space for bindless texture indices, binding textures instead");
+			bindless = false;
+		}
+	}
+	if (m_uniforms.empty() && !bindless) return;
 
 	m_sources.common.cat("layout (std140, binding = 2) uniform MaterialState {");
 
@@ -481,6 +576,11 @@ void Shader::onBeforeReady() {
 		m_sources.common.cat(";\n");
 	}
 
+	if (bindless) {
+		m_texture_indices_offset = indices_offset;
+		m_sources.common.cat("ivec4 u_texture_indices[4];\n");
+	}
+
 	m_sources.common.cat("};\n");
 }
 
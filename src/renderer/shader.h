@@ -95,6 +95,7 @@ public:
 	~Shader();
 
 	ResourceType getType() const override { return TYPE; }
+	FileSystem::Priority getLoadPriority() const override { return FileSystem::Priority::HIGH; }
 	bool hasDefine(u8 define) const;
 	
 	gpu::ProgramHandle getProgram(u32 defines);
@@ -115,11 +116,16 @@ public:
 	u32 m_all_defines_mask;
 	TextureSlot m_texture_slots[16];
 	u32 m_texture_slot_count;
+	// set by bindless_textures() in shader's source, used only if gpu supports bindless textures
+	bool m_bindless_textures = false;
+	// offset of texture indices in material constants, -1 if textures are bound to bind points
+	i32 m_texture_indices_offset = -1;
 	Array<Uniform> m_uniforms;
 	Array<u8> m_defines;
 	struct ProgramPair {
 		ShaderKey key;
 		gpu::ProgramHandle program;
+		gpu::VertexDecl decl; // to compile the program again when the shader is reloaded
 	};
 	Array<ProgramPair> m_programs;
 	Sources m_sources;
@@ -131,6 +137,9 @@ private:
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
 	void onBeforeReady() override;
+	bool isReloadedInPlace() const override { return true; }
+	bool reloadInPlace(u64 size, const u8* mem) override;
+	void releaseDefaultTextures();
 };
 
 template<>
@@ -2,11 +2,15 @@
 #include "engine/crt.h"
 #include "engine/engine.h"
 #include "engine/geometry.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
+#include "engine/path.h"
 #include "engine/profiler.h"
 #include "engine/resource_manager.h"
+#include "engine/simd.h"
 #include "engine/stream.h"
+#include "engine/string.h"
 #include "renderer/draw_stream.h"
 #include "renderer/material.h"
 #include "renderer/model.h"
@@ -27,121 +31,6 @@ struct Sample
 	float u, v;
 };
 
-void Terrain::createGrass(const Vec2& center, u32 frame) {
-	PROFILE_FUNCTION();
-	if (m_is_grass_dirty) {
-		for (GrassType& type : m_grass_types) {
-			for (const GrassQuad& quad : type.m_quads) {
-				m_renderer.getEndFrameDrawStream().destroy(quad.instances);
-			}
-			type.m_quads.clear();
-		}
-		m_is_grass_dirty = false;
-	}
-
-	if (!m_heightmap) return;
-	if (!m_heightmap->isReady()) return;
-	if (!m_splatmap) return;
-	if (!m_splatmap->isReady()) return;
-
-	for (GrassType& type : m_grass_types) {
-		HashMap<u64, GrassQuad>& quads = type.m_quads;
-		quads.eraseIf([&](const GrassQuad& q){
-			if (q.last_used_frame < frame - 3) {
-				m_renderer.getEndFrameDrawStream().destroy(q.instances);
-				return true;
-			}
-			return false;
-		});
-	}
-
-	for (u32 type_idx = 0; type_idx < (u32)m_grass_types.size(); ++type_idx) {
-		Terrain::GrassType& type = m_grass_types[type_idx];
-		if (type.m_spacing <= 0) continue;
-
-		HashMap<u64, GrassQuad>& quads = type.m_quads;
-		const Vec2 half_extents(type.m_distance);
-		const Vec2 size(type.m_distance * 2);
-		const Vec2 quad_size(type.m_spacing * 32);
-		const IVec2 ij = maximum(IVec2((center - half_extents) / quad_size), IVec2(0));
-		
-		struct Instance {
-			Vec3 position;
-			float scale;
-			Quat rotation;
-		};
-
-		Array<Instance> instances(m_allocator);
-		
-		const u32 cols = 1 + u32(size.x / quad_size.x);
-		const u32 rows = 1 + u32(size.y / quad_size.y);
-
-		for (u32 j = ij.y; j < ij.y + rows; ++j) {
-			for (u32 i = ij.x; i < ij.x + cols; ++i) {
-				
-				const u64 key = (u64(i) << 32) | u32(j);
-				auto quad_iter = quads.find(key);
-
-				if (quad_iter.isValid()) {
-					quad_iter.value().last_used_frame = frame;
-					continue;
-				}
-
-				PROFILE_BLOCK("create grass quad")
-				const Vec2 from = Vec2((float)i, (float)j) * quad_size;
-
-				instances.clear();
-				AABB aabb(Vec3(FLT_MAX), Vec3(-FLT_MAX));
-				RandomGenerator rg(i, j);
-
-				for (u32 k = 0; k < 1024; ++k) {
-					const Vec2 pn = Vec2(rg.randFloat(), rg.randFloat());
-					Vec4 p;
-					p.x = from.x + pn.x * quad_size.x;
-					p.z = from.y + pn.y * quad_size.y;
-					const u32 splat = m_splatmap->getPixelNearest(u32(p.x / m_scale.x), u32(p.z / m_scale.x));
-					if ((splat >> 16) & (1 << type_idx)) {
-						p.y = getHeight(p.x, p.z);
-						p.w = rg.randFloat(0.7f, 1.f);
-						Instance& inst = instances.emplace();
-						inst.position = p.xyz();
-						inst.scale = p.w;
-						switch (type.m_rotation_mode) {
-							case GrassType::RotationMode::Y_UP: {
-								const float angle = rg.randFloat();
-								inst.rotation = Quat(0, sinf(angle * PI), 0, cosf(angle * PI));
-								break;
-							}
-							case GrassType::RotationMode::ALL_RANDOM: {
-								const Vec3 axis = normalize(Vec3(rg.randFloat(), rg.randFloat(), rg.randFloat()) * 2.f - 1.f);
-								inst.rotation = Quat(axis, rg.randFloat() * 2 * PI);
-								break;
-							}
-							default: 
-								inst.rotation = Quat::IDENTITY;
-								ASSERT(false);
-								break;
-						}
-						instances.push(inst);
-						aabb.addPoint(p.xyz());
-					}
-				}
-
-				GrassQuad& quad = quads.insert(key);
-				quad.aabb = aabb;
-				quad.ij = IVec2(i, j);
-				quad.type = type_idx;
-				quad.last_used_frame = frame;
-				if (!instances.empty()) {
-					const Renderer::MemRef mem = m_renderer.copy(instances.begin(), instances.byte_size());
-					quad.instances = m_renderer.createBuffer(mem, gpu::BufferFlags::IMMUTABLE);
-					quad.instances_count = instances.size();
-				}
-			}
-		}
-	}
-}
-
 Terrain::Terrain(Renderer& renderer, EntityPtr entity, RenderScene& scene, IAllocator& allocator)
 	: m_material(nullptr)
 	, m_albedomap(nullptr)
@@ -158,6 +47,7 @@ Terrain::Terrain(Renderer& renderer, EntityPtr entity, RenderScene& scene, IAllo
 	, m_renderer(renderer)
 	, m_tesselation(1)
 	, m_base_grid_res(64)
+	, m_tiles(allocator)
 {
 }
 
@@ -171,11 +61,7 @@ Terrain::GrassType::~GrassType()
 
 Terrain::~Terrain()
 {
-	for (const GrassType& type : m_grass_types) {
-		for (const GrassQuad& quad : type.m_quads) {
-			m_renderer.getEndFrameDrawStream().destroy(quad.instances);
-		}
-	}
+	releaseTiles();
 	setMaterial(nullptr);
 }
 
@@ -186,14 +72,12 @@ Terrain::GrassType::GrassType(GrassType&& rhs)
 	, m_distance(rhs.m_distance)
 	, m_idx(rhs.m_idx)
 	, m_rotation_mode(rhs.m_rotation_mode)
-	, m_quads(rhs.m_quads.move())
 {
 	rhs.m_grass_model = nullptr;
 }
 
 Terrain::GrassType::GrassType(Terrain& terrain)
 	: m_terrain(terrain)
-	, m_quads(terrain.m_allocator)
 {
 	m_grass_model = nullptr;
 	m_spacing = 1.f;
@@ -324,6 +208,80 @@ void Terrain::setMaterial(Material* material)
 	}
 }
 
+bool Terrain::Tile::isReady() const {
+	return heightmap && heightmap->isReady()
+		&& (!splatmap || splatmap->isReady())
+		&& (!colormap || colormap->isReady());
+}
+
+
+void Terrain::releaseTiles() {
+	for (Tile& tile : m_tiles) {
+		if (tile.heightmap) tile.heightmap->decRefCount();
+		if (tile.splatmap) tile.splatmap->decRefCount();
+		if (tile.colormap) tile.colormap->decRefCount();
+		tile = {};
+	}
+}
+
+
+void Terrain::setTilesCount(u32 count) {
+	releaseTiles();
+	m_tiles_count = count;
+	m_tiles.clear();
+	m_tiles.resize(count * count);
+}
+
+
+static Texture* loadTileTexture(ResourceManagerHub& rm, const Texture* base, u32 x, u32 y) {
+	if (!base) return nullptr;
+	
+	const char* base_path = base->getPath().c_str();
+	const Span<const char> ext = Path::getExtension(Span(base_path, stringLength(base_path)));
+	const StaticString<LUMIX_MAX_PATH> path(Path::getDir(base_path), Path::getBasename(base_path), "_", x, "_", y, ".", ext);
+	return rm.load<Texture>(Path(path));
+}
+
+
+void Terrain::streamTiles(const DVec3& camera_pos, u32 frame) {
+	if (m_tiles_count == 0) return;
+	if (!m_material || !m_material->isReady()) return;
+	
+	PROFILE_FUNCTION();
+	// keep tiles for a while after they go out of range, so they are not reloaded when camera moves back and forth
+	const u32 keep_frames = 300;
+	const Transform tr = m_scene.getUniverse().getTransform(m_entity);
+	const Vec3 local_cam = tr.rot.conjugated().rotate(Vec3(camera_pos - tr.pos));
+	const Vec2 tile_size = getSize() / float(m_tiles_count);
+	ResourceManagerHub& rm = m_scene.getEngine().getResourceManager();
+	Texture* colormap = m_material->getTextureByName("Satellite");
+
+	for (u32 j = 0; j < m_tiles_count; ++j) {
+		for (u32 i = 0; i < m_tiles_count; ++i) {
+			Tile& tile = m_tiles[i + j * m_tiles_count];
+			const Vec2 min = Vec2(float(i), float(j)) * tile_size;
+			const Vec2 closest = clamp(local_cam.xz(), min, min + tile_size);
+			const bool in_range = squaredLength(closest - local_cam.xz()) < m_tile_stream_distance * m_tile_stream_distance;
+			
+			if (in_range) {
+				tile.last_used_frame = frame;
+				if (!tile.heightmap) {
+					tile.heightmap = loadTileTexture(rm, m_heightmap, i, j);
+					tile.splatmap = loadTileTexture(rm, m_splatmap, i, j);
+					tile.colormap = loadTileTexture(rm, colormap, i, j);
+				}
+			}
+			else if (tile.heightmap && frame - tile.last_used_frame > keep_frames) {
+				tile.heightmap->decRefCount();
+				if (tile.splatmap) tile.splatmap->decRefCount();
+				if (tile.colormap) tile.colormap->decRefCount();
+				tile = {};
+			}
+		}
+	}
+}
+
+
 void Terrain::deserialize(EntityRef entity, InputMemoryStream& serializer, Universe& universe, RenderScene& scene, i32 version)
 {
 	m_entity = entity;
@@ -335,6 +293,15 @@ void Terrain::deserialize(EntityRef entity, InputMemoryStream& serializer, Unive
 		serializer.read(m_tesselation);
 		serializer.read(m_base_grid_res);
 	}
+	u32 tiles_count = 0;
+	if (version > (i32)RenderSceneVersion::TERRAIN_TILES) {
+		serializer.read(tiles_count);
+		serializer.read(m_tile_stream_distance);
+	}
+	setTilesCount(tiles_count);
+	if (version > (i32)RenderSceneVersion::TERRAIN_VIRTUAL_TEXTURING) {
+		serializer.read(m_virtual_texturing);
+	}
 	m_scale.z = m_scale.x;
 	setMaterial(scene.getEngine().getResourceManager().load<Material>(Path(material_path)));
 	i32 count;
@@ -369,6 +336,9 @@ void Terrain::serialize(OutputMemoryStream& serializer)
 	serializer.write(m_scale.y);
 	serializer.write(m_tesselation);
 	serializer.write(m_base_grid_res);
+	serializer.write(m_tiles_count);
+	serializer.write(m_tile_stream_distance);
+	serializer.write(m_virtual_texturing);
 	serializer.write((i32)m_grass_types.size());
 	for(int i = 0; i < m_grass_types.size(); ++i)
 	{
@@ -431,6 +401,143 @@ float Terrain::getHeight(float x, float z) const
 }
 	
 
+// heightmap quads under 4 points, in SoA layout
+struct HeightmapQuads {
+	float h00[4];
+	float h10[4];
+	float h11[4];
+	float h01[4];
+	// position inside the quad, 0..1
+	float dx[4];
+	float dz[4];
+};
+
+
+// reads heightmap texels directly, without per sample checks done by Terrain::getHeight(int, int)
+struct HeightmapSampler {
+	explicit HeightmapSampler(const Terrain& terrain)
+		: data(terrain.m_heightmap->getData())
+		, is_r16(terrain.m_heightmap->format == gpu::TextureFormat::R16)
+		, width(terrain.m_width)
+		, height(terrain.m_height)
+		, xz_scale(terrain.m_scale.x)
+		, y_scale(terrain.m_scale.y)
+	{
+		ASSERT(is_r16 || terrain.m_heightmap->format == gpu::TextureFormat::RGBA8);
+	}
+
+	float sample(i32 x, i32 z) const {
+		const i32 idx = clamp(x, 0, width - 1) + clamp(z, 0, height - 1) * width;
+		if (is_r16) return y_scale * (1 / 65535.f) * ((const u16*)data)[idx];
+		return y_scale * (1 / 255.f) * (((const u32*)data)[idx] & 0xff);
+	}
+
+	// missing points are padded with the last one
+	void gather(const Vec2* points, u32 count, HeightmapQuads& quads) const {
+		const float inv_scale = 1 / xz_scale;
+		for (u32 i = 0; i < 4; ++i) {
+			const Vec2 p = points[minimum(i, count - 1)];
+			const i32 x = i32(p.x * inv_scale);
+			const i32 z = i32(p.y * inv_scale);
+			quads.dx[i] = (p.x - x * xz_scale) * inv_scale;
+			quads.dz[i] = (p.y - z * xz_scale) * inv_scale;
+			quads.h00[i] = sample(x, z);
+			quads.h10[i] = sample(x + 1, z);
+			quads.h11[i] = sample(x + 1, z + 1);
+			quads.h01[i] = sample(x, z + 1);
+		}
+	}
+
+	const void* data;
+	bool is_r16;
+	i32 width;
+	i32 height;
+	float xz_scale;
+	float y_scale;
+};
+
+
+void Terrain::getHeights(Span<const Vec2> points, Span<float> heights) const
+{
+	PROFILE_FUNCTION();
+	ASSERT(points.length() == heights.length());
+	if (!m_heightmap || !m_heightmap->getData()) {
+		for (float& h : heights) h = 0;
+		return;
+	}
+
+	const HeightmapSampler sampler(*this);
+	jobs::forEach(points.length(), 4096, [&](i32 from, i32 to){
+		PROFILE_BLOCK("terrain heights");
+		for (i32 i = from; i < to; i += 4) {
+			const u32 count = minimum(to - i, 4);
+			HeightmapQuads quads;
+			sampler.gather(&points[i], count, quads);
+
+			const float4 dx = f4LoadUnaligned(quads.dx);
+			const float4 dz = f4LoadUnaligned(quads.dz);
+			const float4 h00 = f4LoadUnaligned(quads.h00);
+			const float4 h10 = f4LoadUnaligned(quads.h10);
+			const float4 h11 = f4LoadUnaligned(quads.h11);
+			const float4 h01 = f4LoadUnaligned(quads.h01);
+			// same triangles as getHeight
+			const float4 upper = f4MulAdd(f4Sub(h11, h10), dz, f4MulAdd(f4Sub(h10, h00), dx, h00));
+			const float4 lower = f4MulAdd(f4Sub(h11, h01), dx, f4MulAdd(f4Sub(h01, h00), dz, h00));
+			float tmp[4];
+			f4StoreUnaligned(tmp, f4Blend(lower, upper, f4CmpGT(dx, dz)));
+			memcpy(&heights[i], tmp, count * sizeof(float));
+		}
+	});
+}
+
+
+void Terrain::getNormals(Span<const Vec2> points, Span<Vec3> normals) const
+{
+	PROFILE_FUNCTION();
+	ASSERT(points.length() == normals.length());
+	if (!m_heightmap || !m_heightmap->getData()) {
+		for (Vec3& n : normals) n = Vec3(0, 1, 0);
+		return;
+	}
+
+	const HeightmapSampler sampler(*this);
+	const float4 s = f4Splat(m_scale.x);
+	// y of the unnormalized normal and its square
+	const float4 s2 = f4Splat(m_scale.x * m_scale.x);
+	const float4 s4 = f4Mul(s2, s2);
+	jobs::forEach(points.length(), 4096, [&](i32 from, i32 to){
+		PROFILE_BLOCK("terrain normals");
+		for (i32 i = from; i < to; i += 4) {
+			const u32 count = minimum(to - i, 4);
+			HeightmapQuads quads;
+			sampler.gather(&points[i], count, quads);
+
+			const float4 dx = f4LoadUnaligned(quads.dx);
+			const float4 dz = f4LoadUnaligned(quads.dz);
+			const float4 h00 = f4LoadUnaligned(quads.h00);
+			const float4 h10 = f4LoadUnaligned(quads.h10);
+			const float4 h11 = f4LoadUnaligned(quads.h11);
+			const float4 h01 = f4LoadUnaligned(quads.h01);
+			// cross products from getNormal, expanded
+			const float4 upper_x = f4Mul(s, f4Sub(h00, h10));
+			const float4 upper_z = f4Mul(s, f4Sub(h10, h11));
+			const float4 lower_x = f4Mul(s, f4Sub(h01, h11));
+			const float4 lower_z = f4Mul(s, f4Sub(h00, h01));
+			const float4 mask = f4CmpGT(dx, dz);
+			const float4 x = f4Blend(lower_x, upper_x, mask);
+			const float4 z = f4Blend(lower_z, upper_z, mask);
+			const float4 inv_len = f4Div(f4Splat(1), f4Sqrt(f4MulAdd(x, x, f4MulAdd(z, z, s4))));
+
+			float nx[4], ny[4], nz[4];
+			f4StoreUnaligned(nx, f4Mul(x, inv_len));
+			f4StoreUnaligned(ny, f4Mul(s2, inv_len));
+			f4StoreUnaligned(nz, f4Mul(z, inv_len));
+			for (u32 j = 0; j < count; ++j) normals[i + j] = Vec3(nx[j], ny[j], nz[j]);
+		}
+	});
+}
+
+
 float Terrain::getHeight(int x, int z) const
 {
 	const float DIV64K = 1.0f / 65535.0f;
@@ -547,6 +654,8 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 	PROFILE_FUNCTION();
 	if (new_state == Resource::State::READY)
 	{
+		// tile paths are derived from material's textures
+		releaseTiles();
 		m_heightmap = m_material->getTextureByName("Heightmap");
 		if (m_heightmap && m_heightmap->getData() == nullptr)
 		{
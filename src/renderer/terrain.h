@@ -30,15 +30,6 @@ struct Universe;
 
 
 struct Terrain {
-	struct GrassQuad {
-		gpu::BufferHandle instances = gpu::INVALID_BUFFER;
-		u32 instances_count = 0;
-		IVec2 ij;
-		u32 type;
-		u32 last_used_frame;
-		AABB aabb;
-	};
-
 	struct GrassType {
 		explicit GrassType(Terrain& terrain);
 		
@@ -49,7 +40,6 @@ struct Terrain {
 		GrassType(GrassType&& rhs);
 		~GrassType();
 
-		HashMap<u64, GrassQuad> m_quads;
 		Model* m_grass_model;
 		Terrain& m_terrain;
 		float m_spacing;
@@ -65,6 +55,17 @@ struct Terrain {
 		RotationMode m_rotation_mode = RotationMode::Y_UP;
 	};
 
+	// part of a tiled terrain, textures are streamed in only when the tile is close to the camera
+	// tile textures are found next to the material's textures, e.g. heightmap_3_7.raw for tile x = 3, y = 7
+	struct Tile {
+		Texture* heightmap = nullptr;
+		Texture* splatmap = nullptr;
+		Texture* colormap = nullptr;
+		u32 last_used_frame = 0;
+
+		bool isReady() const;
+	};
+
 	Terrain(Renderer& renderer, EntityPtr entity, RenderScene& scene, IAllocator& allocator);
 	~Terrain();
 
@@ -76,6 +77,9 @@ struct Terrain {
 	EntityRef getEntity() const { return m_entity; }
 	Vec3 getNormal(float x, float z);
 	float getHeight(float x, float z) const;
+	// same as getHeight / getNormal for many points, 4 points at once, big batches are split between workers
+	void getHeights(Span<const Vec2> points, Span<float> heights) const;
+	void getNormals(Span<const Vec2> points, Span<Vec3> normals) const;
 	float getXZScale() const { return m_scale.x; }
 	float getYScale() const { return m_scale.y; }
 	Path getGrassTypePath(int index);
@@ -88,6 +92,8 @@ struct Terrain {
 	float getGrassTypeDistance(int index) const;
 	GrassType::RotationMode getGrassTypeRotationMode(int index) const;
 	int getGrassTypeCount() const { return m_grass_types.size(); }
+	u32 getTilesCount() const { return m_tiles_count; }
+	const Tile& getTile(u32 x, u32 y) const { return m_tiles[x + y * m_tiles_count]; }
 
 	float getHeight(int x, int z) const;
 	void setHeight(int x, int z, float height);
@@ -98,6 +104,9 @@ struct Terrain {
 	void setGrassTypeDistance(int index, float value);
 	void setGrassTypeRotationMode(int index, GrassType::RotationMode mode);
 	void setMaterial(Material* material);
+	void setTilesCount(u32 count);
+	// loads tiles within m_tile_stream_distance of `camera_pos`, releases tiles not requested for a while
+	void streamTiles(const DVec3& camera_pos, u32 frame);
 
 	RayCastModelHit castRay(const DVec3& origin, const Vec3& dir);
 	void serialize(OutputMemoryStream& serializer);
@@ -105,8 +114,6 @@ struct Terrain {
 
 	void addGrassType(int index);
 	void removeGrassType(int index);
-	void createGrass(const Vec2& center, u32 frame);
-	void setGrassDirty() { m_is_grass_dirty = true; }
 
 	IAllocator& m_allocator;
 	i32 m_width;
@@ -123,10 +130,17 @@ struct Terrain {
 	RenderScene& m_scene;
 	Array<GrassType> m_grass_types;
 	Renderer& m_renderer;
-	bool m_is_grass_dirty = false;
+	// tiles per side, 0 - terrain is not tiled
+	u32 m_tiles_count = 0;
+	float m_tile_stream_distance = 500;
+	Array<Tile> m_tiles;
+	// detail layers are blended into a cache of pages instead of per pixel, see TerrainVT in pipeline.cpp
+	// not used by tiled terrains
+	bool m_virtual_texturing = false;
 
 private: 
 	void onMaterialLoaded(Resource::State, Resource::State new_state, Resource&);
+	void releaseTiles();
 };
 
 
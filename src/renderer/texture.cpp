@@ -548,36 +548,73 @@ u8* Texture::getLBCInfo(const void* data, gpu::TextureDesc& desc) {
 	return (u8*)data + sizeof(*hdr);
 }
 
-static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc& desc, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
+static u32 getMipOffset(const gpu::TextureDesc& desc, u32 mip) {
+	u32 offset = 0;
+	for (u32 i = 0; i < mip; ++i) {
+		const u32 w = maximum(desc.width >> i, 1);
+		const u32 h = maximum(desc.height >> i, 1);
+		offset += gpu::getSize(desc.format, w, h);
+	}
+	return offset;
+}
+
+// memory contains mips from top_mip, top_mip > 0 only for 2D textures
+static void uploadTexture(DrawStream& stream, Renderer& renderer, gpu::TextureHandle handle, const gpu::TextureDesc& desc, u32 top_mip, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
 {
 	ASSERT(memory.size > 0);
+	ASSERT(top_mip == 0 || (desc.depth == 1 && !desc.is_cubemap));
 
-	const gpu::TextureHandle handle = gpu::allocTextureHandle();
-	if (!handle) return handle;
-
-	DrawStream& stream = renderer.getDrawStream();
 	if (desc.is_cubemap) flags = flags | gpu::TextureFlags::IS_CUBE;
-	if (desc.mips < 2) flags = flags | gpu::TextureFlags::NO_MIPS;
-	stream.createTexture(handle, desc.width, desc.height, desc.depth, desc.format, flags, debug_name);
+	if (desc.mips - top_mip < 2) flags = flags | gpu::TextureFlags::NO_MIPS;
+	const u32 top_w = maximum(desc.width >> top_mip, 1);
+	const u32 top_h = maximum(desc.height >> top_mip, 1);
+	stream.createTexture(handle, top_w, top_h, desc.depth, desc.format, flags, debug_name);
 				
 	const u8* ptr = (const u8*)memory.data;
 	for (u32 layer = 0; layer < desc.depth; ++layer) {
 		for(int side = 0; side < (desc.is_cubemap ? 6 : 1); ++side) {
 			const u32 z = layer * (desc.is_cubemap ? 6 : 1) + side;
-			for (u32 mip = 0; mip < desc.mips; ++mip) {
+			for (u32 mip = top_mip; mip < desc.mips; ++mip) {
 				const u32 w = maximum(desc.width >> mip, 1);
 				const u32 h = maximum(desc.height >> mip, 1);
 				const u32 mip_size_bytes = gpu::getSize(desc.format, w, h);
-				stream.update(handle, mip, 0, 0, z, w, h, desc.format, ptr, mip_size_bytes);
+				stream.update(handle, mip - top_mip, 0, 0, z, w, h, desc.format, ptr, mip_size_bytes);
 				ptr += mip_size_bytes;
 			}
 		}
 	}
 	ASSERT(memory.own);
 	stream.freeMemory(memory.data, renderer.getAllocator());
+}
+
+static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc& desc, u32 top_mip, const Renderer::MemRef& memory, gpu::TextureFlags flags, const char* debug_name)
+{
+	const gpu::TextureHandle handle = gpu::allocTextureHandle();
+	if (!handle) return handle;
+
+	uploadTexture(renderer.getDrawStream(), renderer, handle, desc, top_mip, memory, flags, debug_name);
 	return handle;
 }
 
+struct TextureUpload final : GPUUpload {
+	TextureUpload(Texture& texture) : texture(texture) {}
+
+	u32 getUploadSize() const override { return memory.size; }
+
+	void upload(DrawStream& stream) override {
+		uploadTexture(stream, texture.renderer, texture.handle, desc, top_mip, memory, texture.getGPUFlags(), texture.getPath().c_str());
+		memory = {};
+		texture.uploaded();
+	}
+
+	bool isPending() const { return memory.data; }
+
+	Texture& texture;
+	gpu::TextureDesc desc;
+	u32 top_mip = 0;
+	Renderer::MemRef memory;
+};
+
 #ifdef LUMIX_BASIS_UNIVERSAL
 	static bool loadBasisU(Texture& texture, IInputStream& file)
 	{
@@ -638,7 +675,7 @@ static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc
 					}
 					
 					Renderer::MemRef mem = texture.renderer.copy(tmp.data(), (u32)tmp.size());
-					texture.handle = loadTexture(texture.renderer, desc, mem, texture.getGPUFlags(), texture.getPath().c_str());
+					texture.handle = loadTexture(texture.renderer, desc, 0, mem, texture.getGPUFlags(), texture.getPath().c_str());
 					if (texture.handle) {
 						texture.mips = info.m_total_levels;
 						texture.width = desc.width;
@@ -657,7 +694,8 @@ static gpu::TextureHandle loadTexture(Renderer& renderer, const gpu::TextureDesc
 #endif
 
 
-static bool loadLBC(Texture& texture, const u8* data, u32 size)
+// gpu texture is created later by the upload queue
+static bool loadLBC(Texture& texture, const u8* data, u32 size, TextureUpload& upload)
 {
 	gpu::TextureDesc desc;
 	const u8* image_data = Texture::getLBCInfo(data, desc);
@@ -679,15 +717,36 @@ static bool loadLBC(Texture& texture, const u8* data, u32 size)
 		}
 	}
 
-	Renderer::MemRef mem = texture.renderer.copy(image_data, size - offset);
-	texture.handle = loadTexture(texture.renderer, desc, mem, texture.getGPUFlags(), texture.getPath().c_str());
+	// streamed textures start with only the small mips, the rest is loaded on demand
+	u32 top_mip = 0;
+	const bool streamable = texture.renderer.getTextureStreamingBudget() > 0
+		&& texture.data_reference == 0
+		&& desc.depth == 1
+		&& !desc.is_cubemap;
+	if (streamable) {
+		while (top_mip + 1 < desc.mips
+			&& maximum(desc.width >> top_mip, desc.height >> top_mip) > Texture::STREAMING_MIN_RESOLUTION
+			&& minimum(desc.width >> (top_mip + 1), desc.height >> (top_mip + 1)) >= 4)
+		{
+			++top_mip;
+		}
+	}
+	const u32 top_offset = getMipOffset(desc, top_mip);
+	if (top_offset >= size - offset) return false;
+
+	texture.handle = gpu::allocTextureHandle();
 	if (texture.handle) {
+		upload.memory = texture.renderer.copy(image_data + top_offset, size - offset - top_offset);
+		upload.desc = desc;
+		upload.top_mip = top_mip;
 		texture.width = desc.width;
 		texture.height = desc.height;
 		texture.mips = desc.mips;
 		texture.depth = desc.depth;
 		texture.is_cubemap = desc.is_cubemap;
 		texture.format = desc.format;
+		texture.resident_mip = top_mip;
+		texture.streamed_mips = top_mip;
 	}
 
 	return texture.handle;
@@ -743,7 +802,13 @@ bool Texture::load(u64 size, const u8* mem)
 	}
 	
 	if (equalIStrings(ext, "lbc")) {
-		loaded = loadLBC(*this, (const u8*)file.getBuffer() + file.getPosition(), u32(file.size() - file.getPosition()));
+		if (!upload) upload = LUMIX_NEW(allocator, TextureUpload)(*this);
+		loaded = loadLBC(*this, (const u8*)file.getBuffer() + file.getPosition(), u32(file.size() - file.getPosition()), *upload);
+		if (loaded) {
+			// ready once uploaded
+			++m_empty_dep_count;
+			renderer.queueUpload(*upload);
+		}
 	}
 	else if (equalIStrings(ext, "raw")) {
 		loaded = loadRaw(*this, file, allocator);
@@ -756,12 +821,136 @@ bool Texture::load(u64 size, const u8* mem)
 		return false;
 	}
 
+	if (isStreamed()) {
+		stream_load_frame = renderer.frameNumber();
+		stream_window_frame = stream_load_frame;
+		renderer.addStreamedTexture(*this);
+	}
+
+	return true;
+}
+
+
+void Texture::requestResolution(u32 pixels, u32 frame)
+{
+	if (frame - stream_window_frame > STREAMING_STALE_FRAMES) {
+		stream_prev_resolution = stream_resolution;
+		stream_resolution = 0;
+		stream_window_frame = frame;
+	}
+	stream_resolution = maximum(stream_resolution, pixels);
+	stream_request_frame = frame;
+	stream_requested = true;
+}
+
+
+u32 Texture::getWantedMip(u32 frame) const
+{
+	if (!stream_requested) {
+		// not drawn with meshes (ui, terrain, ...), we have no idea how big it is on screen
+		return frame - stream_load_frame > STREAMING_STALE_FRAMES ? 0 : resident_mip;
+	}
+	if (frame - stream_request_frame > STREAMING_STALE_FRAMES) return streamed_mips;
+
+	const u32 resolution = maximum(stream_resolution, stream_prev_resolution);
+	const u32 size = maximum(width, height);
+	u32 mip = 0;
+	while (mip < streamed_mips && (size >> (mip + 1)) >= resolution) ++mip;
+	return mip;
+}
+
+
+u64 Texture::getGPUSize(u32 top_mip) const
+{
+	u64 res = 0;
+	for (u32 mip = top_mip; mip < mips; ++mip) {
+		const u32 w = maximum(width >> mip, 1);
+		const u32 h = maximum(height >> mip, 1);
+		res += gpu::getSize(format, w, h);
+	}
+	return res * depth;
+}
+
+
+bool Texture::streamMips(u32 top_mip)
+{
+	ASSERT(isStreamed());
+	ASSERT(top_mip <= streamed_mips);
+	if (stream_op.isValid()) return false;
+	if (top_mip == resident_mip) return false;
+
+	stream_target_mip = top_mip;
+	FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	stream_op = fs.getContent(getCompiledPath(), makeDelegate<&Texture::mipsLoaded>(this), FileSystem::Priority::LOW);
 	return true;
 }
 
 
+void Texture::mipsLoaded(u64 size, const u8* mem, bool success)
+{
+	PROFILE_FUNCTION();
+	stream_op = FileSystem::AsyncHandle::invalid();
+	if (!success || !isReady()) return;
+
+	OutputMemoryStream tmp(allocator);
+	u64 content_size = 0;
+	u64 resource_size = 0;
+	const u8* content = unpack(size, mem, tmp, content_size, resource_size);
+	// extension and flags, see load()
+	const u32 prefix_size = 3 + sizeof(u32);
+	if (!content || content_size < prefix_size + sizeof(LBCHeader)) return;
+
+	gpu::TextureDesc desc;
+	const u8* image_data = getLBCInfo(content + prefix_size, desc);
+	// file changed since the texture was loaded, it's going to be reloaded
+	if (!image_data || desc.width != width || desc.height != height || desc.mips != mips || desc.format != format) return;
+
+	const u32 image_size = u32(content_size - (image_data - content));
+	const u32 top_offset = getMipOffset(desc, stream_target_mip);
+	if (top_offset >= image_size) return;
+
+	Renderer::MemRef mip_mem = renderer.copy(image_data + top_offset, image_size - top_offset);
+	gpu::TextureHandle new_handle = loadTexture(renderer, desc, stream_target_mip, mip_mem, getGPUFlags(), getPath().c_str());
+	if (!new_handle) return;
+
+	// bind groups reference `handle`, so we swap the GPU textures instead of replacing the handle
+	renderer.getDrawStream().swap(handle, new_handle);
+	renderer.getEndFrameDrawStream().destroy(new_handle);
+	resident_mip = stream_target_mip;
+}
+
+
+void Texture::uploaded()
+{
+	--m_empty_dep_count;
+	checkState();
+}
+
+
 void Texture::unload()
 {
+	if (upload) {
+		if (upload->isPending()) {
+			renderer.cancelUpload(*upload);
+			renderer.free(upload->memory);
+			--m_empty_dep_count;
+		}
+		LUMIX_DELETE(allocator, upload);
+		upload = nullptr;
+	}
+
+	if (stream_op.isValid()) {
+		FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+		fs.cancel(stream_op);
+		stream_op = FileSystem::AsyncHandle::invalid();
+	}
+	if (streamed_mips > 0) renderer.removeStreamedTexture(*this);
+	streamed_mips = 0;
+	resident_mip = 0;
+	stream_requested = false;
+	stream_resolution = 0;
+	stream_prev_resolution = 0;
+
 	if (handle) {
 		renderer.getEndFrameDrawStream().destroy(handle);
 		handle = gpu::INVALID_TEXTURE;
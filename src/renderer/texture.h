@@ -84,6 +84,8 @@ struct LUMIX_RENDERER_API Texture final : Resource {
 	~Texture();
 
 	ResourceType getType() const override { return TYPE; }
+	// big, so they do not delay shaders and materials
+	FileSystem::Priority getLoadPriority() const override { return FileSystem::Priority::LOW; }
 
 	bool create(u32 w, u32 h, gpu::TextureFormat format, const void* data, u32 size);
 	void destroy();
@@ -102,6 +104,19 @@ struct LUMIX_RENDERER_API Texture final : Resource {
 	u32 getPixel(float x, float y) const;
 	gpu::TextureFlags getGPUFlags() const;
 
+	// mip streaming of 2D LBC textures, only the smallest mips are loaded with the texture, the rest on demand
+	bool isStreamed() const { return streamed_mips > 0; }
+	// resolution in pixels the texture is displayed at
+	void requestResolution(u32 pixels, u32 frame);
+	// top mip the texture should have on GPU
+	u32 getWantedMip(u32 frame) const;
+	// GPU memory used with mips from top_mip to the smallest one
+	u64 getGPUSize(u32 top_mip) const;
+	// asynchronously loads mips from top_mip to the smallest one and replaces the GPU texture
+	bool streamMips(u32 top_mip);
+	bool isStreaming() const { return stream_op.isValid(); }
+	u32 getStreamTargetMip() const { return stream_target_mip; }
+
 	static u8* getLBCInfo(const void* data, gpu::TextureDesc& desc);
 	static bool saveTGA(IOutputStream* file,
 		int width,
@@ -126,11 +141,36 @@ struct LUMIX_RENDERER_API Texture final : Resource {
 	u32 data_reference;
 	OutputMemoryStream data;
 	Renderer& renderer;
+	// top mip on GPU, 0 - full resolution
+	u32 resident_mip = 0;
+	// number of top mips which can be streamed out, 0 - not streamed
+	u32 streamed_mips = 0;
+
+	// textures are loaded at this resolution, if they are streamed
+	static constexpr u32 STREAMING_MIN_RESOLUTION = 128;
+	// not requested for this many frames - not visible
+	static constexpr u32 STREAMING_STALE_FRAMES = 60;
 
 private:
+	friend struct TextureUpload;
+
+	void uploaded();
+	void mipsLoaded(u64 size, const u8* mem, bool success);
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
 	bool loadTGA(IInputStream& file);
+
+	FileSystem::AsyncHandle stream_op = FileSystem::AsyncHandle::invalid();
+	u32 stream_target_mip = 0;
+	// max requested resolution in current and previous window, so the wanted mip does not jump when a window starts
+	u32 stream_resolution = 0;
+	u32 stream_prev_resolution = 0;
+	u32 stream_window_frame = 0;
+	u32 stream_request_frame = 0;
+	u32 stream_load_frame = 0;
+	bool stream_requested = false;
+	// LBC data waiting in renderer's upload queue, the texture is not ready until they are uploaded
+	struct TextureUpload* upload = nullptr;
 };
 
 
@@ -1,3 +1,4 @@
+#include "engine/job_system.h"
 #include "engine/profiler.h"
 #include "renderer/model.h"
 #include "voxels.h"
@@ -30,10 +31,15 @@ static void forEachTriangle(const Mesh& mesh, const F& f) {
 	}
 }
 
+static IVec3 toBrick(const IVec3& voxel) {
+	return IVec3(voxel.x / Voxels::BRICK_SIZE, voxel.y / Voxels::BRICK_SIZE, voxel.z / Voxels::BRICK_SIZE);
+}
+
 Voxels::Voxels(IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_voxels(allocator)
 	, m_ao(allocator)
+	, m_bricks(allocator)
 {
 }
 
@@ -44,6 +50,9 @@ void Voxels::set(const Voxels& rhs) {
 	m_voxel_size = rhs.m_voxel_size;
 	m_ao.resize(rhs.m_ao.size());
 	memcpy(m_ao.begin(), rhs.m_ao.begin(), m_ao.byte_size());
+	m_brick_resolution = rhs.m_brick_resolution;
+	m_bricks.resize(rhs.m_bricks.size());
+	memcpy(m_bricks.begin(), rhs.m_bricks.begin(), m_bricks.byte_size());
 }
 
 bool Voxels::sample(const Vec3& p, u8* out) const {
@@ -79,17 +88,60 @@ bool Voxels::sample(i32 x, i32 y, i32 z, u8* out) const {
 	return true;
 }
 
+// DDA through voxels, whole empty bricks are skipped
 bool Voxels::castRay(Vec3 p, Vec3 d) const {
-	Vec3 s = Vec3(m_grid_resolution);
-	auto sample = [&](Vec3 p){
-		IVec3 i(p);
-		return m_voxels[i.x + (i.y + i.z * m_grid_resolution.y) * m_grid_resolution.x];
+	const Vec3 s = Vec3(m_grid_resolution);
+	p += d;
+
+	const float step_x = d.x > 0 ? 1.f : -1.f;
+	const float step_y = d.y > 0 ? 1.f : -1.f;
+	const float step_z = d.z > 0 ? 1.f : -1.f;
+	const Vec3 inv_d(d.x != 0 ? 1 / fabsf(d.x) : FLT_MAX, d.y != 0 ? 1 / fabsf(d.y) : FLT_MAX, d.z != 0 ? 1 / fabsf(d.z) : FLT_MAX);
+
+	// distance along d to the next cell boundary on axis, cells are `size` voxels big
+	auto toBoundary = [](float p, float d, float size, float inv_d) {
+		if (d == 0) return FLT_MAX;
+		const float cell = floorf(p / size) * size;
+		return (d > 0 ? cell + size - p : p - cell) * inv_d;
 	};
 
-	p += d;
-	while (p.x > 0 && p.y > 0 && p.z > 0 && p.x < s.x  && p.y < s.y && p.z < s.z) {
-		if (sample(p)) return true;
-		p += d;
+	while (p.x > 0 && p.y > 0 && p.z > 0 && p.x < s.x && p.y < s.y && p.z < s.z) {
+		const IVec3 brick = toBrick(IVec3(p));
+		if (!m_bricks[brick.x + (brick.y + brick.z * m_brick_resolution.y) * m_brick_resolution.x]) {
+			const float brick_size = (float)BRICK_SIZE;
+			const float t = minimum(toBoundary(p.x, d.x, brick_size, inv_d.x), toBoundary(p.y, d.y, brick_size, inv_d.y), toBoundary(p.z, d.z, brick_size, inv_d.z));
+			p += d * (t + 1e-3f);
+			continue;
+		}
+
+		// walk voxels until the ray leaves the brick
+		IVec3 voxel(p);
+		Vec3 t_max(toBoundary(p.x, d.x, 1, inv_d.x), toBoundary(p.y, d.y, 1, inv_d.y), toBoundary(p.z, d.z, 1, inv_d.z));
+		float t = 0;
+		for (;;) {
+			if (voxel.x < 0 || voxel.y < 0 || voxel.z < 0) return false;
+			if (voxel.x >= m_grid_resolution.x || voxel.y >= m_grid_resolution.y || voxel.z >= m_grid_resolution.z) return false;
+			const IVec3 voxel_brick = toBrick(voxel);
+			if (voxel_brick.x != brick.x || voxel_brick.y != brick.y || voxel_brick.z != brick.z) break;
+			if (m_voxels[voxel.x + (voxel.y + voxel.z * m_grid_resolution.y) * m_grid_resolution.x]) return true;
+
+			if (t_max.x < t_max.y && t_max.x < t_max.z) {
+				t = t_max.x;
+				t_max.x += inv_d.x;
+				voxel.x += (i32)step_x;
+			}
+			else if (t_max.y < t_max.z) {
+				t = t_max.y;
+				t_max.y += inv_d.y;
+				voxel.y += (i32)step_y;
+			}
+			else {
+				t = t_max.z;
+				t_max.z += inv_d.z;
+				voxel.z += (i32)step_z;
+			}
+		}
+		p += d * (t + 1e-3f);
 	}
 	return false;
 }
@@ -120,27 +172,34 @@ float Voxels::computeAO(const Vec3& p, u32 ray_count) {
 }
 
 void Voxels::computeAO(u32 ray_count) {
+	PROFILE_FUNCTION();
 	m_ao.resize(m_grid_resolution.x * m_grid_resolution.y * m_grid_resolution.z);
-	for (i32 z = 0; z < m_grid_resolution.z; ++z) {
-		for (i32 y = 0; y < m_grid_resolution.y; ++y) {
-			for (i32 x = 0; x < m_grid_resolution.x; ++x) {
-				float ao = 1;
-				for (u32 d = 0; d < ray_count; ++d) {
-					Vec3 dir = Vec3(randFloat(), randFloat(), randFloat()) * 2.f - 1.f;
-					dir /= maximum(fabsf(dir.x), fabsf(dir.y), fabsf(dir.z));
-					Vec3 p((float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f);
-					p += dir;
-					if (castRay(p, dir)) {
-						ao -= 1.f / ray_count;
+	// one slice per job, each slice has its own random generator so the result does not depend on scheduling
+	jobs::forEach(m_grid_resolution.z, 1, [&](i32 from, i32 to){
+		PROFILE_BLOCK("ao");
+		for (i32 z = from; z < to; ++z) {
+			RandomGenerator rg(521288629 + z, 362436069 ^ (z * 2654435761u));
+			for (i32 y = 0; y < m_grid_resolution.y; ++y) {
+				for (i32 x = 0; x < m_grid_resolution.x; ++x) {
+					float ao = 1;
+					for (u32 d = 0; d < ray_count; ++d) {
+						Vec3 dir = Vec3(rg.randFloat(), rg.randFloat(), rg.randFloat()) * 2.f - 1.f;
+						dir /= maximum(fabsf(dir.x), fabsf(dir.y), fabsf(dir.z));
+						Vec3 p((float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f);
+						p += dir;
+						if (castRay(p, dir)) {
+							ao -= 1.f / ray_count;
+						}
 					}
+					m_ao[x + (y + z * m_grid_resolution.y) * m_grid_resolution.x] = ao;
 				}
-				m_ao[x + (y + z * m_grid_resolution.y) * m_grid_resolution.x] = ao;
 			}
 		}
-	}
+	});
 }
 
 void Voxels::blurAO() {
+	PROFILE_FUNCTION();
 	Array<float> blurred(m_allocator);
 	blurred.resize(m_ao.size());
 	auto sampleAO = [&](i32 x, i32 y, i32 z){
@@ -150,22 +209,24 @@ void Voxels::blurAO() {
 		const u32 idx = x + (y + z * m_grid_resolution.y) * m_grid_resolution.x;
 		return m_ao[idx];
 	};
-	for (i32 z = 0; z < m_grid_resolution.z; ++z) {
-		for (i32 y = 0; y < m_grid_resolution.y; ++y) {
-			for (i32 x = 0; x < m_grid_resolution.x; ++x) {
-				float v = 0;
-				for (i32 c = -1; c <= 1; ++c) {
-					for (i32 b = -1; b <= 1; ++b) {
-						for (i32 a = -1; a <= 1; ++a) {
-							v += sampleAO(x + a, y + b, z + c);
+	jobs::forEach(m_grid_resolution.z, 1, [&](i32 from, i32 to){
+		for (i32 z = from; z < to; ++z) {
+			for (i32 y = 0; y < m_grid_resolution.y; ++y) {
+				for (i32 x = 0; x < m_grid_resolution.x; ++x) {
+					float v = 0;
+					for (i32 c = -1; c <= 1; ++c) {
+						for (i32 b = -1; b <= 1; ++b) {
+							for (i32 a = -1; a <= 1; ++a) {
+								v += sampleAO(x + a, y + b, z + c);
+							}
 						}
 					}
+					const u32 idx = x + (y + z * m_grid_resolution.y) * m_grid_resolution.x;
+					blurred[idx] = v / 9.f;
 				}
-				const u32 idx = x + (y + z * m_grid_resolution.y) * m_grid_resolution.x;
-				blurred[idx] = v / 9.f;
 			}
 		}
-	}
+	});
 	m_ao = blurred.move();
 }
 
@@ -180,6 +241,9 @@ void Voxels::beginRaster(AABB aabb, u32 max_res) {
 	m_voxels.resize(resolution.x * resolution.y * resolution.z);
 	memset(m_voxels.getMutableData(), 0, m_voxels.size());
 	m_grid_resolution = resolution;
+	m_brick_resolution = toBrick(resolution + IVec3(BRICK_SIZE - 1));
+	m_bricks.resize(m_brick_resolution.x * m_brick_resolution.y * m_brick_resolution.z);
+	memset(m_bricks.begin(), 0, m_bricks.byte_size());
 	m_voxel_size = voxel_size;
 	m_aabb = {min, max};
 }
@@ -206,6 +270,8 @@ void Voxels::raster(const Vec3& p0, const Vec3& p1, const Vec3& p2) {
 		if (k >= m_grid_resolution.z) return;
 
 		m_voxels[i + j * (m_grid_resolution.x) + k * (m_grid_resolution.x * m_grid_resolution.y)] = value;
+		const IVec3 brick = toBrick(IVec3(i, j, k));
+		m_bricks[brick.x + (brick.y + brick.z * m_brick_resolution.y) * m_brick_resolution.x] = 1;
 	};
 
 	AABB aabb;
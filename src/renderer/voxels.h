@@ -8,6 +8,9 @@
 namespace Lumix {
 
 struct Voxels {
+	// edge of a brick in voxels, empty bricks are skipped by castRay
+	static constexpr i32 BRICK_SIZE = 4;
+
 	Voxels(IAllocator& allocator);
 	
 	void set(const Voxels& rhs);
@@ -17,6 +20,7 @@ struct Voxels {
 	void computeAO(u32 ray_count);
 	float computeAO(const Vec3& p, u32 ray_count);
 	void blurAO();
+	// p and d are in grid space
 	bool castRay(Vec3 p, Vec3 d) const;
 	bool sample(i32 x, i32 y, i32 z, u8* out) const;
 	bool sampleAO(i32 x, i32 y, i32 z, float* out) const;
@@ -28,6 +32,9 @@ struct Voxels {
 	OutputMemoryStream m_voxels;
 	AABB m_aabb;
 	Array<float> m_ao;
+	// 1 if any voxel in the brick is set
+	Array<u8> m_bricks;
+	IVec3 m_brick_resolution;
 	float m_voxel_size;
 };
 